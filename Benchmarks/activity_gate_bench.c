@@ -0,0 +1,377 @@
+//
+//  activity_gate_bench.c
+//  RTSP Rotator Benchmarks
+//
+//  Benchmark for RTSPActivityGate on a simulated site: 32 cameras at 15 fps
+//  for ten minutes of simulated time. Most cameras watch still scenes
+//  (sensor noise plus an occasional one-frame lighting flicker), some see
+//  people pass every minute or so, and a few are busy nearly all the time.
+//  Compares the fixed "every 3rd frame" rate against the gate, with and
+//  without a global budget, reporting:
+//
+//    - inferences per second over all cameras
+//    - effective inference FPS and skipped-frame ratio of still cameras
+//    - inference FPS while an event is in view
+//    - detection latency: event start to its first inferred frame
+//
+//  Checks: still cameras drop to the idle rate; events are seen on their
+//  first frame and covered at the active rate (within a second under the
+//  budget, when an event follows another and waits for its share); the
+//  budget holds to within the onset frames and is shared evenly between
+//  busy cameras; the gate's own statistics match what it admitted.
+//
+//  Build (Linux / macOS):
+//    cc -O2 -std=c11 -I"../RTSP Rotator" activity_gate_bench.c "../RTSP Rotator/RTSPActivityGate.c" -lpthread -lm -o activity_gate_bench
+//
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "RTSPActivityGate.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_CAMERAS 32
+#define BENCH_QUIET_CAMERAS 20
+#define BENCH_BUSY_CAMERAS 4            // The rest see occasional events
+#define BENCH_FPS 15.0
+#define BENCH_SECONDS 600.0
+#define BENCH_FIXED_INTERVAL 3          // The old inferenceInterval
+#define BENCH_BUDGET 40.0
+#define BENCH_MAX_EVENTS 4096
+
+#define BENCH_TARGET_QUIET_FPS 0.5      // Effective FPS of a still camera
+#define BENCH_TARGET_SAVINGS 0.5        // Gate inferences / fixed-rate inferences
+#define BENCH_TARGET_EVENT_FPS 9.0      // While an event is in view, unlimited budget
+#define BENCH_TARGET_LATENCY 0.1        // Seconds from event start to first inference
+#define BENCH_TARGET_BUDGET_LATENCY 1.0 // Same, budgeted: an event right after another waits for its share
+#define BENCH_BUDGET_SLACK 1.05         // Onset frames are inferred outside the budget
+
+static double BenchNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static unsigned BenchCheck(bool condition, const char *what) {
+    if (!condition) {
+        fprintf(stderr, "  check failed: %s\n", what);
+    }
+    return condition ? 0 : 1;
+}
+
+static uint32_t BenchRandom(uint32_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static double BenchUniform(uint32_t *state, double low, double high) {
+    return low + (high - low) * (BenchRandom(state) / 4294967296.0);
+}
+
+static double BenchExponential(uint32_t *state, double mean) {
+    return -mean * log(BenchUniform(state, 1e-12, 1.0));
+}
+
+#pragma mark - Scene
+
+typedef enum {
+    BenchSceneQuiet,
+    BenchSceneOccasional,
+    BenchSceneBusy
+} BenchScene;
+
+typedef struct {
+    double start;
+    double end;
+    uint32_t camera;
+    double firstInference;          // NAN until seen
+    uint64_t framesInView;
+    uint64_t framesInferred;
+} BenchEvent;
+
+typedef struct {
+    BenchScene scene;
+    double nextFlicker;
+    double nextEvent;
+    int event;                      // Index of the event in view, or -1
+    double motion;                  // Level during the current event
+} BenchCamera;
+
+typedef struct {
+    BenchCamera cameras[BENCH_CAMERAS];
+    BenchEvent events[BENCH_MAX_EVENTS];
+    size_t eventCount;
+    uint32_t seed;
+} BenchSite;
+
+static void BenchSiteInit(BenchSite *site) {
+    memset(site, 0, sizeof(*site));
+    site->seed = 0x5EED1234u;
+    for (uint32_t c = 0; c < BENCH_CAMERAS; c++) {
+        BenchCamera *camera = &site->cameras[c];
+        camera->scene = c < BENCH_QUIET_CAMERAS ? BenchSceneQuiet
+                      : c < BENCH_CAMERAS - BENCH_BUSY_CAMERAS ? BenchSceneOccasional : BenchSceneBusy;
+        camera->nextFlicker = BenchExponential(&site->seed, 120.0);
+        camera->nextEvent = camera->scene == BenchSceneQuiet ? INFINITY : BenchExponential(&site->seed, 20.0);
+        camera->event = -1;
+    }
+}
+
+/// Motion fraction and moving tracks seen by `camera` at time `t`
+static float BenchSiteFrame(BenchSite *site, uint32_t c, double t, uint32_t *movingTracks) {
+    BenchCamera *camera = &site->cameras[c];
+    *movingTracks = 0;
+    float motion = (float)BenchUniform(&site->seed, 0.0, 0.003);     // Sensor noise
+
+    if (camera->event >= 0 && t >= site->events[camera->event].end) {
+        double gap = camera->scene == BenchSceneBusy ? 5.0 : 60.0;
+        camera->nextEvent = t + BenchExponential(&site->seed, gap);
+        camera->event = -1;
+    }
+    if (camera->event < 0 && t >= camera->nextEvent && site->eventCount < BENCH_MAX_EVENTS) {
+        double duration = camera->scene == BenchSceneBusy ? BenchUniform(&site->seed, 20.0, 40.0)
+                                                          : BenchUniform(&site->seed, 5.0, 20.0);
+        BenchEvent *event = &site->events[site->eventCount];
+        *event = (BenchEvent){.start = t, .end = t + duration, .camera = c, .firstInference = NAN};
+        camera->event = (int)site->eventCount++;
+        camera->motion = BenchUniform(&site->seed, 0.02, 0.2);
+    }
+    if (camera->event >= 0) {
+        BenchEvent *event = &site->events[camera->event];
+        // Someone walking: motion comes and goes as they pause, the tracker keeps them
+        double phase = fmod(t - event->start, 4.0);
+        motion = phase < 3.0 ? (float)camera->motion : 0.002f;
+        *movingTracks = t - event->start > 0.5 ? 1 : 0;
+        event->framesInView++;
+    }
+    if (t >= camera->nextFlicker) {
+        motion = 0.03f;     // Lighting change: one frame of motion, nothing there
+        camera->nextFlicker = t + BenchExponential(&site->seed, 120.0);
+    }
+    return motion;
+}
+
+#pragma mark - Runs
+
+typedef struct {
+    const char *name;
+    double inferencesPerSecond;
+    double quietFPS;
+    double quietSkipped;
+    double eventFPS;
+    double meanLatency;
+    double maxLatency;
+    uint64_t missedEvents;
+    double busyFairness;            // Fewest / most inferences among busy cameras
+    double peakWindowRate;          // Highest inferences / s over any 1 s window, all cameras
+    double offerNanoseconds;
+    unsigned statisticsMismatches;
+} BenchResult;
+
+/// budget < 0: the fixed interval instead of the gate
+static BenchResult BenchRun(const char *name, double budget) {
+    BenchResult result = {.name = name};
+    BenchSite site;
+    BenchSiteInit(&site);
+
+    RTSPActivityGateRef gate = NULL;
+    if (budget >= 0) {
+        RTSPActivityGateConfig config;
+        RTSPActivityGateConfigInit(&config);
+        config.budget = budget;
+        gate = RTSPActivityGateCreate(&config);
+    }
+
+    uint64_t inferred[BENCH_CAMERAS] = {0};
+    uint64_t offered[BENCH_CAMERAS] = {0};
+    uint64_t frameIndex[BENCH_CAMERAS] = {0};
+    uint64_t total = 0;
+    uint64_t windowCount = 0;
+    double windowStart = 0;
+    double offerTime = 0;
+    uint64_t offers = 0;
+
+    double frameInterval = 1.0 / BENCH_FPS;
+    uint64_t frames = (uint64_t)(BENCH_SECONDS * BENCH_FPS);
+    for (uint64_t f = 0; f < frames; f++) {
+        for (uint32_t c = 0; c < BENCH_CAMERAS; c++) {
+            // Cameras are out of phase with each other
+            double t = (double)f * frameInterval + (double)c * frameInterval / BENCH_CAMERAS;
+            uint32_t moving;
+            float motion = BenchSiteFrame(&site, c, t, &moving);
+            bool infer;
+            if (gate) {
+                double start = BenchNow();
+                infer = RTSPActivityGateOfferFrame(gate, c, t, motion, moving);
+                offerTime += BenchNow() - start;
+                offers++;
+            } else {
+                infer = frameIndex[c] % BENCH_FIXED_INTERVAL == 0;
+            }
+            frameIndex[c]++;
+            offered[c]++;
+            if (infer) {
+                inferred[c]++;
+                total++;
+                windowCount++;
+                int e = site.cameras[c].event;
+                if (e >= 0) {
+                    BenchEvent *event = &site.events[e];
+                    event->framesInferred++;
+                    if (isnan(event->firstInference)) {
+                        event->firstInference = t;
+                    }
+                }
+            }
+            if (t - windowStart >= 1.0) {
+                double rate = (double)windowCount / (t - windowStart);
+                if (rate > result.peakWindowRate && windowStart > 5.0) {
+                    result.peakWindowRate = rate;
+                }
+                windowStart = t;
+                windowCount = 0;
+            }
+        }
+    }
+
+    result.inferencesPerSecond = (double)total / BENCH_SECONDS;
+    double quietInferred = 0, quietOffered = 0;
+    for (uint32_t c = 0; c < BENCH_QUIET_CAMERAS; c++) {
+        quietInferred += (double)inferred[c];
+        quietOffered += (double)offered[c];
+    }
+    result.quietFPS = quietInferred / BENCH_QUIET_CAMERAS / BENCH_SECONDS;
+    result.quietSkipped = 1.0 - quietInferred / quietOffered;
+
+    double latencySum = 0, inView = 0, inViewInferred = 0;
+    size_t seen = 0;
+    for (size_t e = 0; e < site.eventCount; e++) {
+        BenchEvent *event = &site.events[e];
+        if (event->end > BENCH_SECONDS) {
+            continue;
+        }
+        if (isnan(event->firstInference)) {
+            result.missedEvents++;
+            continue;
+        }
+        double latency = event->firstInference - event->start;
+        latencySum += latency;
+        result.maxLatency = latency > result.maxLatency ? latency : result.maxLatency;
+        inView += (double)event->framesInView;
+        inViewInferred += (double)event->framesInferred;
+        seen++;
+    }
+    result.meanLatency = seen ? latencySum / (double)seen : 0;
+    result.eventFPS = inView > 0 ? inViewInferred / inView * BENCH_FPS : 0;
+
+    uint64_t fewest = UINT64_MAX, most = 0;
+    for (uint32_t c = BENCH_CAMERAS - BENCH_BUSY_CAMERAS; c < BENCH_CAMERAS; c++) {
+        fewest = inferred[c] < fewest ? inferred[c] : fewest;
+        most = inferred[c] > most ? inferred[c] : most;
+    }
+    result.busyFairness = most ? (double)fewest / (double)most : 0;
+
+    if (gate) {
+        result.offerNanoseconds = offerTime / (double)offers * 1e9;
+        double end = (double)frames * frameInterval;
+        for (uint32_t c = 0; c < BENCH_CAMERAS; c++) {
+            RTSPActivityGateCameraStatistics statistics;
+            if (!RTSPActivityGateGetCameraStatistics(gate, c, end, &statistics) ||
+                statistics.framesOffered != offered[c] || statistics.framesInferred != inferred[c] ||
+                statistics.skippedRatio < 0 || statistics.skippedRatio > 1) {
+                result.statisticsMismatches++;
+            }
+        }
+        RTSPActivityGateStatistics statistics = RTSPActivityGateGetStatistics(gate, end);
+        if (statistics.cameras != BENCH_CAMERAS || (budget > 0 && statistics.allocatedRate > budget + 1e-6)) {
+            result.statisticsMismatches++;
+        }
+        RTSPActivityGateRelease(gate);
+    }
+    return result;
+}
+
+static void BenchPrint(const BenchResult *r) {
+    printf("  %-14s %6.1f inferences/s, still cameras %5.2f fps (%4.1f%% skipped), events %5.2f fps, "
+           "latency mean %3.0f ms max %4.0f ms, peak %5.1f/s\n",
+           r->name, r->inferencesPerSecond, r->quietFPS, r->quietSkipped * 100.0, r->eventFPS, r->meanLatency * 1000.0,
+           r->maxLatency * 1000.0, r->peakWindowRate);
+}
+
+#pragma mark - Behaviour Checks
+
+static unsigned BenchCheckBehaviour(void) {
+    unsigned failures = 0;
+    RTSPActivityGateConfig config;
+    RTSPActivityGateConfigInit(&config);
+    config.maxCameras = 2;
+    RTSPActivityGateRef gate = RTSPActivityGateCreate(&config);
+
+    // The first frame is inferred; unknown motion runs at the active rate
+    failures += BenchCheck(RTSPActivityGateOfferFrame(gate, 0, 0.0, 0.0f, 0), "first frame inferred");
+    unsigned count = 0;
+    for (int f = 1; f <= 150; f++) {
+        count += RTSPActivityGateOfferFrame(gate, 1, f / 15.0, -1.0f, 0);
+    }
+    failures += BenchCheck(count >= 98 && count <= 102, "unknown motion runs at the active rate");
+    failures += BenchCheck(!RTSPActivityGateOfferFrame(gate, 2, 0.0, 0.5f, 0), "camera beyond maxCameras refused");
+
+    // Removing a camera resets it: its next frame counts as a first frame
+    RTSPActivityGateRemoveCamera(gate, 1);
+    RTSPActivityGateCameraStatistics statistics;
+    failures += BenchCheck(!RTSPActivityGateGetCameraStatistics(gate, 1, 10.0, &statistics), "removed camera forgotten");
+    failures += BenchCheck(RTSPActivityGateOfferFrame(gate, 1, 10.0, 0.0f, 0), "re-added camera inferred at once");
+    RTSPActivityGateRelease(gate);
+    printf("  first frame, unknown motion and removal checks: %s\n", failures ? "FAILED" : "ok");
+    return failures;
+}
+
+#pragma mark - Main
+
+int main(void) {
+    printf("activity_gate_bench\n");
+    unsigned failures = BenchCheckBehaviour();
+    printf("  %d cameras at %.0f fps for %.0f s: %d still, %d with occasional events, %d busy\n", BENCH_CAMERAS,
+           BENCH_FPS, BENCH_SECONDS, BENCH_QUIET_CAMERAS, BENCH_CAMERAS - BENCH_QUIET_CAMERAS - BENCH_BUSY_CAMERAS,
+           BENCH_BUSY_CAMERAS);
+
+    BenchResult fixed = BenchRun("every 3rd", -1);
+    BenchResult adaptive = BenchRun("gate", 0);
+    BenchResult budgeted = BenchRun("gate, 40/s", BENCH_BUDGET);
+    BenchPrint(&fixed);
+    BenchPrint(&adaptive);
+    BenchPrint(&budgeted);
+    printf("  gate: %.2fx the fixed rate's inferences, %.0f ns per frame offered; budgeted busy-camera fairness %.2f\n",
+           adaptive.inferencesPerSecond / fixed.inferencesPerSecond, adaptive.offerNanoseconds, budgeted.busyFairness);
+
+    char what[160];
+    snprintf(what, sizeof(what), "still cameras at %.2f fps (target <= %.1f)", adaptive.quietFPS, BENCH_TARGET_QUIET_FPS);
+    failures += BenchCheck(adaptive.quietFPS <= BENCH_TARGET_QUIET_FPS, what);
+    snprintf(what, sizeof(what), "gate runs %.2fx the fixed inferences (target <= %.2f)",
+             adaptive.inferencesPerSecond / fixed.inferencesPerSecond, BENCH_TARGET_SAVINGS);
+    failures += BenchCheck(adaptive.inferencesPerSecond <= BENCH_TARGET_SAVINGS * fixed.inferencesPerSecond, what);
+    snprintf(what, sizeof(what), "events covered at %.2f fps (target >= %.1f)", adaptive.eventFPS, BENCH_TARGET_EVENT_FPS);
+    failures += BenchCheck(adaptive.eventFPS >= BENCH_TARGET_EVENT_FPS, what);
+    for (int i = 0; i < 2; i++) {
+        const BenchResult *r = i == 0 ? &adaptive : &budgeted;
+        double target = i == 0 ? BENCH_TARGET_LATENCY : BENCH_TARGET_BUDGET_LATENCY;
+        snprintf(what, sizeof(what), "%s: event latency max %.0f ms (target <= %.0f ms), %llu events missed", r->name,
+                 r->maxLatency * 1000.0, target * 1000.0, (unsigned long long)r->missedEvents);
+        failures += BenchCheck(r->maxLatency <= target && r->missedEvents == 0, what);
+        snprintf(what, sizeof(what), "%s: %u statistics mismatches", r->name, r->statisticsMismatches);
+        failures += BenchCheck(r->statisticsMismatches == 0, what);
+    }
+    snprintf(what, sizeof(what), "budgeted: %.1f inferences/s over a budget of %.0f", budgeted.inferencesPerSecond, BENCH_BUDGET);
+    failures += BenchCheck(budgeted.inferencesPerSecond <= BENCH_BUDGET * BENCH_BUDGET_SLACK, what);
+    snprintf(what, sizeof(what), "budgeted: busy-camera fairness %.2f", budgeted.busyFairness);
+    failures += BenchCheck(budgeted.busyFairness >= 0.8, what);
+
+    printf("%s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,685 @@
+//
+//  clip_recorder_bench.c
+//  RTSP Rotator Benchmarks
+//
+//  Benchmark for RTSPClipRecorder, stream-copy recording with an in-RAM
+//  pre-roll. A forked child runs the loopback RTSP camera simulator
+//  (synthetic 1080p H.264 over interleaved RTP); the parent remuxes N
+//  streams with RTSPRemuxEngine, first on their own and then with a
+//  recorder per stream holding the pre-roll and writing a triggered clip
+//  to disk. Reports CPU per stream for each phase, so the difference is
+//  what recording costs, next to a floor for transcoding the same frames:
+//  one copy and one frame difference per decoded 1080p frame, far less
+//  than a real decoder and encoder do.
+//
+//  Checks: the pre-roll covers its duration in whole GOPs and honours the
+//  byte limit; clips open on a keyframe with the pre-roll, run the
+//  post-roll past the last trigger, and continuous recordings until
+//  stopped; every file parses as ftyp + moov + moof/mdat with fragments
+//  numbered from 1 and contiguous decode times from 0; reconnects with the
+//  same parameter sets keep recording, new ones end the clip; write
+//  failures are reported and end the clip.
+//
+//  Build (Linux):
+//    cc -O2 -std=gnu11 -I"../RTSP Rotator" clip_recorder_bench.c rtsp_loopback_server.c "../RTSP Rotator/RTSPClipRecorder.c" "../RTSP Rotator/RTSPRemuxEngine.c" "../RTSP Rotator/RTSPTransport.c" "../RTSP Rotator/RTSPProtocol.c" "../RTSP Rotator/RTSPRTPDepacketizer.c" "../RTSP Rotator/RTSPFMP4Writer.c" "../RTSP Rotator/RTSPCodecConfig.c" "../RTSP Rotator/RTSPByteBuffer.c" -lssl -lcrypto -lpthread -lm -o clip_recorder_bench
+//
+//  Usage: clip_recorder_bench [--streams N] [--seconds S] [--bitrate KBPS]
+//
+
+#define _GNU_SOURCE
+
+#include "RTSPClipRecorder.h"
+#include "RTSPFMP4Writer.h"
+#include "RTSPRemuxEngine.h"
+#include "rtsp_loopback_server.h"
+
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_TARGET_RECORD_CPU 1.0     // Percent of one core per recorded stream
+#define BENCH_FPS 30
+#define BENCH_GOP 30                    // Frames per keyframe in the synthetic streams
+#define BENCH_PART_FRAMES 6             // 0.2 s parts, as the engine cuts them
+
+static double BenchNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static double BenchCPUSeconds(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (double)usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+           (double)usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+static unsigned BenchCheck(bool condition, const char *what) {
+    if (!condition) {
+        fprintf(stderr, "  check failed: %s\n", what);
+    }
+    return condition ? 0 : 1;
+}
+
+static uint32_t BenchU32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+#pragma mark - Finished Clips
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    unsigned count;
+    RTSPClipInfo last;
+    char path[256];
+} BenchClips;
+
+static void BenchClipsInit(BenchClips *clips) {
+    memset(clips, 0, sizeof(*clips));
+    pthread_mutex_init(&clips->lock, NULL);
+    pthread_cond_init(&clips->changed, NULL);
+}
+
+static void BenchClipsDestroy(BenchClips *clips) {
+    pthread_cond_destroy(&clips->changed);
+    pthread_mutex_destroy(&clips->lock);
+}
+
+static void BenchClipFinished(void *context, const RTSPClipInfo *clip) {
+    BenchClips *clips = context;
+    pthread_mutex_lock(&clips->lock);
+    clips->last = *clip;
+    snprintf(clips->path, sizeof(clips->path), "%s", clip->path);
+    clips->last.path = clips->path;
+    clips->count++;
+    pthread_cond_broadcast(&clips->changed);
+    pthread_mutex_unlock(&clips->lock);
+}
+
+/// Wait until `count` clips have finished; false after two seconds
+static bool BenchClipsWait(BenchClips *clips, unsigned count) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += 2;
+    pthread_mutex_lock(&clips->lock);
+    int result = 0;
+    while (clips->count < count && result == 0) {
+        result = pthread_cond_timedwait(&clips->changed, &clips->lock, &deadline);
+    }
+    bool done = clips->count >= count;
+    pthread_mutex_unlock(&clips->lock);
+    return done;
+}
+
+#pragma mark - File Check
+
+typedef struct {
+    bool valid;
+    bool startsWithKeyframe;
+    uint32_t fragments;
+    double duration;
+    uint64_t bytes;
+} BenchFile;
+
+/// Parse a recorded file: ftyp, moov, then moof + mdat pairs numbered from
+/// 1 whose decode times continue exactly where the previous one ended
+static BenchFile BenchReadFile(const char *path) {
+    BenchFile result = {0};
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return result;
+    }
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t *data = malloc(length > 0 ? (size_t)length : 1);
+    bool read = data && fread(data, 1, (size_t)length, file) == (size_t)length;
+    fclose(file);
+    if (!read) {
+        free(data);
+        return result;
+    }
+    result.bytes = (uint64_t)length;
+
+    bool valid = true;
+    uint64_t decodeTime = 0;
+    size_t offset = 0;
+    for (unsigned box = 0; valid && offset + 8 <= (size_t)length; box++) {
+        const uint8_t *p = data + offset;
+        size_t size = BenchU32(p);
+        valid = size >= 8 && size <= (size_t)length - offset;
+        const char *expected = box == 0 ? "ftyp" : box == 1 ? "moov" : box % 2 == 0 ? "moof" : "mdat";
+        valid = valid && memcmp(p + 4, expected, 4) == 0;
+        if (valid && box >= 2 && box % 2 == 0) {
+            // moof: mfhd, then traf with tfhd, tfdt (version 1) and trun
+            const uint8_t *mfhd = p + 8;
+            const uint8_t *traf = mfhd + BenchU32(mfhd);
+            const uint8_t *tfhd = traf + 8;
+            const uint8_t *tfdt = tfhd + BenchU32(tfhd);
+            const uint8_t *trun = tfdt + BenchU32(tfdt);
+            valid = memcmp(mfhd + 4, "mfhd", 4) == 0 && memcmp(traf + 4, "traf", 4) == 0 &&
+                    memcmp(tfdt + 4, "tfdt", 4) == 0 && tfdt[8] == 1 && memcmp(trun + 4, "trun", 4) == 0 &&
+                    BenchU32(mfhd + 12) == result.fragments + 1 &&
+                    (((uint64_t)BenchU32(tfdt + 12) << 32) | BenchU32(tfdt + 16)) == decodeTime;
+            uint32_t flags = BenchU32(trun + 8) & 0xFFFFFF;
+            uint32_t samples = BenchU32(trun + 12);
+            const uint8_t *field = trun + 16 + (flags & 0x1 ? 4 : 0) + (flags & 0x4 ? 4 : 0);
+            valid = valid && (flags & 0x100) && (flags & 0x400) && !(flags & 0x4);
+            for (uint32_t i = 0; valid && i < samples; i++) {
+                decodeTime += BenchU32(field);
+                if (result.fragments == 0 && i == 0) {
+                    const uint8_t *sampleFlags = field + 4 + (flags & 0x200 ? 4 : 0);
+                    result.startsWithKeyframe = BenchU32(sampleFlags) == 0x02000000u;
+                }
+                field += 4 * (1 + !!(flags & 0x200) + 1 + !!(flags & 0x800));
+            }
+            result.fragments++;
+        }
+        offset += size;
+    }
+    result.valid = valid && offset == (size_t)length && result.fragments > 0;
+    result.duration = (double)decodeTime / RTSP_FMP4_TIMESCALE;
+    free(data);
+    return result;
+}
+
+#pragma mark - Synthetic Engine Output
+
+/// Parts the way RTSPRemuxEngine emits them: 0.2 s of 30 fps video, the
+/// first part of every GOP independent
+typedef struct {
+    uint32_t initID;
+    uint32_t sequence;
+    uint64_t frame;
+    RTSPByteBuffer fragment;
+    uint8_t *payload;
+} BenchSynth;
+
+static const uint8_t BenchInitA[] = {
+    0, 0, 0, 16, 'f', 't', 'y', 'p', 'i', 's', 'o', '6', 0, 0, 0, 0,
+    0, 0, 0, 8, 'm', 'o', 'o', 'v',
+};
+static const uint8_t BenchInitB[] = {
+    0, 0, 0, 16, 'f', 't', 'y', 'p', 'i', 's', 'o', '6', 0, 0, 0, 1,
+    0, 0, 0, 8, 'm', 'o', 'o', 'v',
+};
+
+static void BenchSynthInit(BenchSynth *synth, uint32_t initID) {
+    memset(synth, 0, sizeof(*synth));
+    synth->initID = initID;
+    RTSPByteBufferInit(&synth->fragment);
+    synth->payload = calloc(1, 120000);
+}
+
+static void BenchSynthFree(BenchSynth *synth) {
+    RTSPByteBufferFree(&synth->fragment);
+    free(synth->payload);
+}
+
+/// Feed `seconds` of parts
+static void BenchSynthFeed(BenchSynth *synth, RTSPClipRecorderRef recorder, double seconds) {
+    uint64_t parts = (uint64_t)llround(seconds * BENCH_FPS / BENCH_PART_FRAMES);
+    for (uint64_t p = 0; p < parts; p++) {
+        RTSPFMP4Sample samples[BENCH_PART_FRAMES];
+        size_t payloadLength = 0;
+        bool independent = synth->frame % BENCH_GOP == 0;
+        for (unsigned i = 0; i < BENCH_PART_FRAMES; i++) {
+            bool keyframe = (synth->frame + i) % BENCH_GOP == 0;
+            samples[i] = (RTSPFMP4Sample){keyframe ? 60000 : 8000, RTSP_FMP4_TIMESCALE / BENCH_FPS, keyframe};
+            payloadLength += samples[i].size;
+        }
+        RTSPByteBufferReset(&synth->fragment);
+        RTSPFMP4WriteFragment(++synth->sequence, synth->frame * (RTSP_FMP4_TIMESCALE / BENCH_FPS),
+                              samples, BENCH_PART_FRAMES, synth->payload, payloadLength, &synth->fragment);
+        RTSPRemuxMediaInfo info = {
+            .sequence = synth->sequence,
+            .initID = synth->initID,
+            .duration = (double)BENCH_PART_FRAMES / BENCH_FPS,
+            .independent = independent,
+        };
+        RTSPClipRecorderAddMedia(recorder, &info, synth->fragment.data, synth->fragment.length);
+        synth->frame += BENCH_PART_FRAMES;
+    }
+}
+
+#pragma mark - Checks
+
+static unsigned BenchCheckPreRoll(void) {
+    unsigned failures = 0;
+    BenchClips clips;
+    BenchClipsInit(&clips);
+    RTSPClipRecorderConfig config;
+    RTSPClipRecorderConfigInit(&config);
+    RTSPClipRecorderRef recorder = RTSPClipRecorderCreate(&config, BenchClipFinished, &clips);
+    BenchSynth synth;
+    BenchSynthInit(&synth, 1);
+
+    failures += BenchCheck(RTSPClipRecorderTrigger(recorder, "/tmp/unused.mp4") == 0, "no clip before any media");
+    RTSPClipRecorderAddInitSegment(recorder, 1, BenchInitA, sizeof(BenchInitA));
+    BenchSynthFeed(&synth, recorder, 40.0);
+    RTSPClipRecorderStatistics statistics = RTSPClipRecorderGetStatistics(recorder);
+    failures += BenchCheck(statistics.preRollDuration >= 15.0 - 1e-6 && statistics.preRollDuration < 16.0 - 1e-6,
+                           "pre-roll covers 15 s in whole GOPs");
+    failures += BenchCheck(statistics.clipID == 0 && statistics.bytesWritten == 0, "idle recorder writes nothing");
+
+    RTSPClipRecorderRelease(recorder);
+    BenchSynthFree(&synth);
+
+    // A byte limit below one GOP keeps only the current GOP
+    config.maxPreRollBytes = 1;
+    recorder = RTSPClipRecorderCreate(&config, NULL, NULL);
+    BenchSynthInit(&synth, 1);
+    RTSPClipRecorderAddInitSegment(recorder, 1, BenchInitA, sizeof(BenchInitA));
+    BenchSynthFeed(&synth, recorder, 10.4);
+    statistics = RTSPClipRecorderGetStatistics(recorder);
+    failures += BenchCheck(fabs(statistics.preRollDuration - 0.4) < 1e-6, "byte limit keeps the current GOP only");
+    RTSPClipRecorderRelease(recorder);
+    BenchSynthFree(&synth);
+    BenchClipsDestroy(&clips);
+    return failures;
+}
+
+static unsigned BenchCheckClips(const char *directory) {
+    unsigned failures = 0;
+    char path[256], other[256];
+    snprintf(path, sizeof(path), "%s/triggered.mp4", directory);
+    snprintf(other, sizeof(other), "%s/ignored.mp4", directory);
+    BenchClips clips;
+    BenchClipsInit(&clips);
+    RTSPClipRecorderConfig config;
+    RTSPClipRecorderConfigInit(&config);
+    RTSPClipRecorderRef recorder = RTSPClipRecorderCreate(&config, BenchClipFinished, &clips);
+    BenchSynth synth;
+    BenchSynthInit(&synth, 1);
+    RTSPClipRecorderAddInitSegment(recorder, 1, BenchInitA, sizeof(BenchInitA));
+    BenchSynthFeed(&synth, recorder, 40.4);
+
+    // Triggered clip: pre-roll, a second trigger 5 s in, then 10 s of post-roll
+    uint32_t clipID = RTSPClipRecorderTrigger(recorder, path);
+    failures += BenchCheck(clipID != 0, "trigger starts a clip");
+    failures += BenchCheck(RTSPClipRecorderStart(recorder, other, true) == 0, "no second clip while recording");
+    BenchSynthFeed(&synth, recorder, 5.0);
+    failures += BenchCheck(RTSPClipRecorderTrigger(recorder, other) == clipID, "trigger extends the running clip");
+    BenchSynthFeed(&synth, recorder, 9.8);
+    failures += BenchCheck(RTSPClipRecorderGetStatistics(recorder).clipID == clipID, "clip runs through the post-roll");
+    BenchSynthFeed(&synth, recorder, 0.4);
+    failures += BenchCheck(BenchClipsWait(&clips, 1), "clip ends after the post-roll");
+    RTSPClipInfo info = clips.last;
+    BenchFile file = BenchReadFile(path);
+    failures += BenchCheck(info.clipID == clipID && info.reason == RTSPClipEndPostRollElapsed, "post-roll end reason");
+    failures += BenchCheck(file.valid && file.startsWithKeyframe, "clip file parses and opens on a keyframe");
+    failures += BenchCheck(file.bytes == info.bytes && file.fragments == info.fragments &&
+                           fabs(file.duration - info.duration) < 1e-6, "clip info matches the file");
+    failures += BenchCheck(info.preRoll >= 15.0 - 1e-6 && info.preRoll < 16.4 + 1e-6, "clip opens with the pre-roll");
+    failures += BenchCheck(info.duration - info.preRoll > 14.9 && info.duration - info.preRoll < 15.3,
+                           "clip ends 10 s after the last trigger");
+    failures += BenchCheck(access(other, F_OK) != 0, "extended clip keeps its own path");
+
+    // Continuous recording started mid-GOP opens at that GOP's keyframe
+    snprintf(path, sizeof(path), "%s/continuous.mp4", directory);
+    clipID = RTSPClipRecorderStart(recorder, path, false);
+    failures += BenchCheck(clipID != 0, "start records");
+    failures += BenchCheck(RTSPClipRecorderTrigger(recorder, other) == clipID, "trigger joins a continuous recording");
+    BenchSynthFeed(&synth, recorder, 20.0);
+    RTSPClipRecorderStatistics statistics = RTSPClipRecorderGetStatistics(recorder);
+    failures += BenchCheck(statistics.clipID == clipID && !statistics.triggered, "continuous recording ignores the post-roll");
+
+    // A reconnect with the same parameter sets keeps recording; new ones end the clip
+    synth.initID = 2;
+    RTSPClipRecorderAddInitSegment(recorder, 2, BenchInitA, sizeof(BenchInitA));
+    BenchSynthFeed(&synth, recorder, 1.0);
+    failures += BenchCheck(RTSPClipRecorderGetStatistics(recorder).clipID == clipID, "same parameter sets keep recording");
+    RTSPClipRecorderAddInitSegment(recorder, 3, BenchInitB, sizeof(BenchInitB));
+    failures += BenchCheck(BenchClipsWait(&clips, 2), "new parameter sets end the clip");
+    info = clips.last;
+    file = BenchReadFile(path);
+    failures += BenchCheck(info.reason == RTSPClipEndConfigurationChanged, "configuration change end reason");
+    failures += BenchCheck(fabs(info.preRoll - 0.6) < 1e-6 && fabs(info.duration - 21.6) < 1e-6,
+                           "continuous recording spans the current GOP to the change");
+    failures += BenchCheck(file.valid && file.startsWithKeyframe && file.bytes == info.bytes, "continuous file parses");
+    statistics = RTSPClipRecorderGetStatistics(recorder);
+    failures += BenchCheck(statistics.preRollDuration == 0 && statistics.preRollBytes == 0, "new parameter sets clear the pre-roll");
+
+    // Old media and media before the next keyframe are dropped
+    uint64_t dropped = statistics.droppedMedia;
+    BenchSynthFeed(&synth, recorder, 0.2);
+    synth.initID = 3;
+    BenchSynthFeed(&synth, recorder, 0.2);
+    failures += BenchCheck(RTSPClipRecorderGetStatistics(recorder).droppedMedia == dropped + 2, "media without init or keyframe dropped");
+    BenchSynthFeed(&synth, recorder, 2.0);
+    failures += BenchCheck(fabs(RTSPClipRecorderGetStatistics(recorder).preRollDuration - 2.0) < 1e-6, "recording resumes at a keyframe");
+
+    // Write failures are reported and end the clip
+    clipID = RTSPClipRecorderStart(recorder, "/nonexistent-directory/clip.mp4", true);
+    for (unsigned i = 0; i < 2000 && RTSPClipRecorderGetStatistics(recorder).clipID == clipID; i++) {
+        usleep(1000);
+        BenchSynthFeed(&synth, recorder, 0.2);
+    }
+    failures += BenchCheck(RTSPClipRecorderGetStatistics(recorder).clipID == 0, "write failure ends the clip");
+    failures += BenchCheck(BenchClipsWait(&clips, 3), "failed clip finishes");
+    failures += BenchCheck(clips.last.clipID == clipID && clips.last.reason == RTSPClipEndWriteFailed &&
+                           clips.last.error == ENOENT, "write failure reported");
+
+    // Release closes a running clip
+    snprintf(path, sizeof(path), "%s/released.mp4", directory);
+    RTSPClipRecorderStart(recorder, path, true);
+    RTSPClipRecorderRelease(recorder);
+    failures += BenchCheck(clips.count == 4 && clips.last.reason == RTSPClipEndStopped, "release stops the clip");
+    failures += BenchCheck(BenchReadFile(path).valid, "released clip parses");
+
+    BenchSynthFree(&synth);
+    BenchClipsDestroy(&clips);
+    return failures;
+}
+
+#pragma mark - Live Streams
+
+typedef struct {
+    pthread_mutex_t lock;
+    uint8_t *init;
+    size_t initLength;
+    uint32_t initID;
+    _Atomic(RTSPClipRecorderRef) recorder;
+    atomic_uint parts;
+    atomic_uint errors;
+    BenchClips clips;
+} BenchStream;
+
+static void BenchInitSegment(void *context, uint32_t initID, const uint8_t *data, size_t length) {
+    BenchStream *stream = context;
+    pthread_mutex_lock(&stream->lock);
+    free(stream->init);
+    stream->init = malloc(length);
+    memcpy(stream->init, data, length);
+    stream->initLength = length;
+    stream->initID = initID;
+    RTSPClipRecorderRef recorder = atomic_load(&stream->recorder);
+    if (recorder) {
+        RTSPClipRecorderAddInitSegment(recorder, initID, data, length);
+    }
+    pthread_mutex_unlock(&stream->lock);
+}
+
+static void BenchPart(void *context, const RTSPRemuxMediaInfo *info, const uint8_t *data, size_t length) {
+    BenchStream *stream = context;
+    RTSPClipRecorderRef recorder = atomic_load(&stream->recorder);
+    if (recorder) {
+        RTSPClipRecorderAddMedia(recorder, info, data, length);
+    }
+    atomic_fetch_add(&stream->parts, 1);
+}
+
+static void BenchStateChanged(void *context, RTSPRemuxStreamState state, const char *message) {
+    BenchStream *stream = context;
+    if (state == RTSPRemuxStreamReconnecting) {
+        atomic_fetch_add(&stream->errors, 1);
+        fprintf(stderr, "  stream failed: %s\n", message ? message : "(no message)");
+    }
+}
+
+static void BenchAttach(BenchStream *stream, RTSPClipRecorderRef recorder) {
+    pthread_mutex_lock(&stream->lock);
+    if (recorder && stream->init) {
+        RTSPClipRecorderAddInitSegment(recorder, stream->initID, stream->init, stream->initLength);
+    }
+    atomic_store(&stream->recorder, recorder);
+    pthread_mutex_unlock(&stream->lock);
+}
+
+static pid_t BenchStartServer(const RTSPLoopbackConfig *config, uint16_t *port, int *control) {
+    int portPipe[2], controlPipe[2];
+    if (pipe(portPipe) != 0 || pipe(controlPipe) != 0) {
+        return -1;
+    }
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(portPipe[0]);
+        close(controlPipe[1]);
+        RTSPLoopbackServerRef server = RTSPLoopbackServerStart(config);
+        uint16_t serverPort = RTSPLoopbackServerPort(server);
+        if (write(portPipe[1], &serverPort, sizeof(serverPort)) != sizeof(serverPort)) {
+            _exit(1);
+        }
+        char byte;
+        while (read(controlPipe[0], &byte, 1) > 0) {
+        }
+        RTSPLoopbackServerStop(server);
+        _exit(0);
+    }
+    close(portPipe[1]);
+    close(controlPipe[0]);
+    if (read(portPipe[0], port, sizeof(*port)) != sizeof(*port) || *port == 0) {
+        return -1;
+    }
+    close(portPipe[0]);
+    *control = controlPipe[1];
+    return pid;
+}
+
+#pragma mark - Transcode Floor
+
+static volatile uint64_t gSink;
+
+/// CPU seconds per frame for the least a transcode must do with every
+/// decoded 1080p NV12 frame: write it out of the decoder and read it into
+/// the encoder's motion search once (a zero-vector difference)
+static double BenchTranscodeFloor(void) {
+    size_t size = 1920 * 1080 * 3 / 2;
+    uint8_t *decoded = malloc(size), *reference = malloc(size), *input = malloc(size);
+    uint32_t state = 1;
+    for (size_t i = 0; i < size; i++) {
+        state = state * 1664525u + 1013904223u;
+        decoded[i] = (uint8_t)(state >> 24);
+        reference[i] = (uint8_t)(state >> 16);
+    }
+    unsigned frames = 120;
+    double start = BenchCPUSeconds();
+    for (unsigned frame = 0; frame < frames; frame++) {
+        decoded[frame] ^= 1;
+        memcpy(input, decoded, size);
+        uint64_t sad = 0;
+        for (size_t i = 0; i < size; i++) {
+            sad += (uint64_t)abs((int)input[i] - (int)reference[i]);
+        }
+        gSink += sad;
+    }
+    double perFrame = (BenchCPUSeconds() - start) / frames;
+    free(decoded);
+    free(reference);
+    free(input);
+    return perFrame;
+}
+
+int main(int argc, char **argv) {
+    unsigned streams = 4;
+    double seconds = 10.0;
+    RTSPLoopbackConfig serverConfig;
+    RTSPLoopbackConfigInit(&serverConfig);
+    serverConfig.fps = BENCH_FPS;
+    serverConfig.gop = BENCH_GOP;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--streams") == 0 && i + 1 < argc) {
+            streams = (unsigned)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            seconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--bitrate") == 0 && i + 1 < argc) {
+            serverConfig.bitrateKbps = (unsigned)atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--streams N] [--seconds S] [--bitrate KBPS]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (streams == 0) {
+        streams = 1;
+    }
+    if (seconds < 4.0) {
+        seconds = 4.0;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    char directory[] = "/tmp/clip_recorder_bench.XXXXXX";
+    if (!mkdtemp(directory)) {
+        fprintf(stderr, "mkdtemp failed\n");
+        return 1;
+    }
+
+    unsigned failures = BenchCheckPreRoll();
+    failures += BenchCheckClips(directory);
+
+    uint16_t port = 0;
+    int control = -1;
+    pid_t server = BenchStartServer(&serverConfig, &port, &control);
+    if (server < 0) {
+        fprintf(stderr, "failed to start loopback server\n");
+        return 1;
+    }
+    printf("clip_recorder_bench: %u RTSP streams, 1080p H.264 @ %u fps, %u kbps, GOP %u, %.0f s per phase\n",
+           streams, serverConfig.fps, serverConfig.bitrateKbps, serverConfig.gop, seconds);
+
+    RTSPRemuxEngineRef engine = RTSPRemuxEngineCreate(NULL);
+    BenchStream *contexts = calloc(streams, sizeof(*contexts));
+    uint32_t *identifiers = calloc(streams, sizeof(*identifiers));
+    RTSPClipRecorderRef *recorders = calloc(streams, sizeof(*recorders));
+    RTSPRemuxSink sink = {
+        .initSegment = BenchInitSegment,
+        .part = BenchPart,
+        .stateChanged = BenchStateChanged,
+    };
+    for (unsigned i = 0; i < streams; i++) {
+        char url[128];
+        snprintf(url, sizeof(url), "rtsp://127.0.0.1:%u/cam%u", port, i);
+        pthread_mutex_init(&contexts[i].lock, NULL);
+        BenchClipsInit(&contexts[i].clips);
+        identifiers[i] = RTSPRemuxEngineAddStream(engine, url, &sink, &contexts[i]);
+    }
+
+    // Warm up: every stream delivering parts
+    double start = BenchNow();
+    bool ready = false;
+    while (!ready && BenchNow() - start < 15.0) {
+        usleep(10000);
+        ready = true;
+        for (unsigned i = 0; i < streams; i++) {
+            ready = ready && atomic_load(&contexts[i].parts) > 10;
+        }
+    }
+    failures += BenchCheck(ready, "streams start within 15 s");
+
+    // Phase 1: remux only
+    double cpuBefore = BenchCPUSeconds();
+    double phaseStart = BenchNow();
+    usleep((useconds_t)(seconds * 1e6));
+    double remuxCPU = (BenchCPUSeconds() - cpuBefore) / (BenchNow() - phaseStart);
+
+    // Phase 2: pre-roll for the first half, then a triggered clip per stream
+    RTSPClipRecorderConfig config;
+    RTSPClipRecorderConfigInit(&config);
+    config.preRollDuration = floor(seconds / 2) - 1;
+    config.postRollDuration = seconds * 10;
+    cpuBefore = BenchCPUSeconds();
+    phaseStart = BenchNow();
+    for (unsigned i = 0; i < streams; i++) {
+        recorders[i] = RTSPClipRecorderCreate(&config, BenchClipFinished, &contexts[i].clips);
+        BenchAttach(&contexts[i], recorders[i]);
+    }
+    usleep((useconds_t)(seconds / 2 * 1e6));
+    double preRollHeld = 0;
+    for (unsigned i = 0; i < streams; i++) {
+        char path[256];
+        snprintf(path, sizeof(path), "%s/cam%u.mp4", directory, i);
+        preRollHeld += RTSPClipRecorderGetStatistics(recorders[i]).preRollBytes;
+        if (RTSPClipRecorderTrigger(recorders[i], path) == 0) {
+            failures += BenchCheck(false, "live trigger starts a clip");
+        }
+    }
+    usleep((useconds_t)(seconds / 2 * 1e6));
+    for (unsigned i = 0; i < streams; i++) {
+        RTSPClipRecorderStop(recorders[i]);
+    }
+    for (unsigned i = 0; i < streams; i++) {
+        failures += BenchCheck(BenchClipsWait(&contexts[i].clips, 1), "live clip finishes");
+    }
+    double recordCPU = (BenchCPUSeconds() - cpuBefore) / (BenchNow() - phaseStart);
+
+    uint64_t written = 0, accessUnits = 0;
+    unsigned clipFailures = 0;
+    for (unsigned i = 0; i < streams; i++) {
+        BenchAttach(&contexts[i], NULL);
+        RTSPClipRecorderStatistics statistics = RTSPClipRecorderGetStatistics(recorders[i]);
+        written += statistics.bytesWritten;
+        RTSPClipInfo info = contexts[i].clips.last;
+        BenchFile file = BenchReadFile(info.path);
+        bool ok = info.reason == RTSPClipEndStopped && file.valid && file.startsWithKeyframe &&
+                  file.bytes == info.bytes && fabs(file.duration - info.duration) < 1e-3 &&
+                  info.preRoll >= config.preRollDuration - 0.25 && info.preRoll <= config.preRollDuration + 1.5 &&
+                  info.duration - info.preRoll > seconds / 2 - 1.0 && atomic_load(&contexts[i].errors) == 0;
+        if (!ok && clipFailures++ < 4) {
+            fprintf(stderr, "  stream %u: reason %d valid %d keyframe %d %.2f s (pre-roll %.2f s) %llu B, file %.2f s %llu B\n",
+                    i, info.reason, file.valid, file.startsWithKeyframe, info.duration, info.preRoll,
+                    (unsigned long long)info.bytes, file.duration, (unsigned long long)file.bytes);
+        }
+        RTSPRemuxStreamStatistics remux;
+        RTSPRemuxEngineGetStatistics(engine, identifiers[i], &remux);
+        accessUnits += remux.accessUnits;
+    }
+    failures += BenchCheck(clipFailures == 0, "live clips parse, open on a keyframe and hold the pre-roll");
+
+    for (unsigned i = 0; i < streams; i++) {
+        RTSPRemuxEngineRemoveStream(engine, identifiers[i]);
+        RTSPClipRecorderRelease(recorders[i]);
+    }
+    RTSPRemuxEngineRelease(engine);
+    close(control);
+    waitpid(server, NULL, 0);
+
+    double floorPerFrame = BenchTranscodeFloor();
+    double fps = (double)accessUnits / streams / (BenchNow() - start);
+    double remuxPerStream = remuxCPU * 100.0 / streams;
+    double recordPerStream = recordCPU * 100.0 / streams;
+    double transcodePerStream = floorPerFrame * fps * 100.0;
+    printf("  remux only:                                  %8.3f %% of one core per stream\n", remuxPerStream);
+    printf("  remux + pre-roll + clip to disk:             %8.3f %% of one core per stream\n", recordPerStream);
+    printf("  recording (difference):                      %8.3f %% of one core per stream\n", recordPerStream - remuxPerStream);
+    printf("  transcode floor (copy + SAD per frame):      %8.3f %% of one core per stream (%.2f ms per 1080p frame, %.0f fps)\n",
+           transcodePerStream, floorPerFrame * 1000.0, fps);
+    printf("  pre-roll held:                               %8.2f MB per stream (%.0f s)\n",
+           preRollHeld / streams / (1024.0 * 1024.0), config.preRollDuration);
+    printf("  written:                                     %8.2f MB per stream\n", written / (double)streams / (1024.0 * 1024.0));
+
+    failures += BenchCheck(recordPerStream - remuxPerStream <= BENCH_TARGET_RECORD_CPU, "recording CPU per stream");
+    failures += BenchCheck(recordPerStream - remuxPerStream < transcodePerStream, "stream copy below the transcode floor");
+
+    for (unsigned i = 0; i < streams; i++) {
+        char path[256];
+        snprintf(path, sizeof(path), "%s/cam%u.mp4", directory, i);
+        unlink(path);
+        free(contexts[i].init);
+        pthread_mutex_destroy(&contexts[i].lock);
+        BenchClipsDestroy(&contexts[i].clips);
+    }
+    const char *names[] = {"triggered.mp4", "continuous.mp4", "released.mp4"};
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        char path[256];
+        snprintf(path, sizeof(path), "%s/%s", directory, names[i]);
+        unlink(path);
+    }
+    rmdir(directory);
+    free(contexts);
+    free(identifiers);
+    free(recorders);
+
+    printf(failures ? "FAILED (%u)\n" : "OK\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,729 @@
+//
+//  detection_decoder_bench.c
+//  RTSP Rotator Benchmarks
+//
+//  Benchmark for RTSPDetectionDecoder and RTSPDetectionPreprocessor.
+//
+//  Decoding: synthetic YOLOv8 outputs (8400 anchors x 80 classes, channels
+//  first) with clusters of overlapping boxes around a few dozen objects
+//  and low-score clutter, at the alert threshold (0.25) and the tracker's
+//  low threshold (0.1); plus a YOLOv5 output (25200 anchors, objectness,
+//  anchors first). Each backend is timed against a naive decoder that
+//  finds every anchor's best class with strided reads, allocates each
+//  candidate and runs an all-pairs NMS per class.
+//
+//  Preprocessing: 1080p and 4K NV12 frames letterboxed to 640x640 planar
+//  float RGB, each backend against a per-pixel bilinear conversion.
+//
+//  Checks: every backend keeps exactly the reference's boxes; class
+//  filtering, maxDetections, batches and both layouts; boxes survive the
+//  letterbox round trip; preprocessed pixels match a double-precision
+//  reference, padding is grey 114 and backends agree.
+//
+//  Build (Linux / macOS):
+//    cc -O2 -std=c11 -I"../RTSP Rotator" detection_decoder_bench.c "../RTSP Rotator/RTSPDetectionDecoder.c" "../RTSP Rotator/RTSPDetectionPreprocessor.c" -lm -o detection_decoder_bench
+//
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "RTSPDetectionDecoder.h"
+#include "RTSPDetectionPreprocessor.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_INPUT 640
+#define BENCH_ANCHORS 8400
+#define BENCH_CLASSES 80
+#define BENCH_V5_ANCHORS 25200
+#define BENCH_OBJECTS 40
+#define BENCH_CLUTTER 400                   // Anchors scoring 0.1 - 0.3
+#define BENCH_ITERATIONS 300
+#define BENCH_FRAMES 20
+
+#define BENCH_TARGET_DECODE_SPEEDUP 2.0     // Best backend against the naive decoder, 8400 anchors
+#define BENCH_TARGET_DECODE_P99 2.0         // ms, 8400 anchors
+#define BENCH_TARGET_PREPROCESS_SPEEDUP 1.5 // Best backend against per-pixel conversion, 1080p
+
+static double BenchNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static uint32_t BenchRandom(uint32_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static float BenchUniform(uint32_t *state, float low, float high) {
+    return low + (high - low) * (float)(BenchRandom(state) >> 8) / 16777216.0f;
+}
+
+static int BenchCompareDouble(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double BenchPercentile(double *samples, size_t count, double percentile) {
+    qsort(samples, count, sizeof(*samples), BenchCompareDouble);
+    size_t index = (size_t)(percentile * (double)(count - 1) + 0.5);
+    return samples[index < count ? index : count - 1];
+}
+
+static unsigned BenchCheck(bool condition, const char *what) {
+    if (!condition) {
+        fprintf(stderr, "  check failed: %s\n", what);
+    }
+    return condition ? 0 : 1;
+}
+
+#pragma mark - Synthetic Outputs
+
+typedef struct {
+    RTSPDetectionLayout layout;
+    uint32_t anchors;
+    uint32_t classes;
+    size_t length;
+    float *data;
+} BenchTensor;
+
+static void BenchSet(BenchTensor *tensor, uint32_t anchor, uint32_t field, float value) {
+    if (tensor->layout == RTSPDetectionLayoutChannelsFirst) {
+        tensor->data[(size_t)field * tensor->anchors + anchor] = value;
+    } else {
+        tensor->data[(size_t)anchor * (5 + tensor->classes) + field] = value;
+    }
+}
+
+static float BenchGet(const BenchTensor *tensor, uint32_t anchor, uint32_t field) {
+    if (tensor->layout == RTSPDetectionLayoutChannelsFirst) {
+        return tensor->data[(size_t)field * tensor->anchors + anchor];
+    }
+    return tensor->data[(size_t)anchor * (5 + tensor->classes) + field];
+}
+
+/// Field of class `c`: 4 + c channels first, 5 + c anchors first
+static uint32_t BenchClassField(const BenchTensor *tensor, uint32_t c) {
+    return (tensor->layout == RTSPDetectionLayoutChannelsFirst ? 4 : 5) + c;
+}
+
+/// Near-zero background, clusters of jittered boxes around objects, and clutter
+static void BenchMakeTensor(BenchTensor *tensor, RTSPDetectionLayout layout, uint32_t anchors, uint32_t classes,
+                            uint32_t seed) {
+    tensor->layout = layout;
+    tensor->anchors = anchors;
+    tensor->classes = classes;
+    uint32_t channels = layout == RTSPDetectionLayoutChannelsFirst ? 4 + classes : 5 + classes;
+    tensor->length = (size_t)channels * anchors;
+    tensor->data = malloc(tensor->length * sizeof(float));
+
+    for (uint32_t a = 0; a < anchors; a++) {
+        BenchSet(tensor, a, 0, BenchUniform(&seed, 0, BENCH_INPUT));
+        BenchSet(tensor, a, 1, BenchUniform(&seed, 0, BENCH_INPUT));
+        BenchSet(tensor, a, 2, BenchUniform(&seed, 4, 120));
+        BenchSet(tensor, a, 3, BenchUniform(&seed, 4, 120));
+        if (layout == RTSPDetectionLayoutAnchorsFirst) {
+            BenchSet(tensor, a, 4, BenchUniform(&seed, 0, 0.02f));
+        }
+        for (uint32_t c = 0; c < classes; c++) {
+            float u = BenchUniform(&seed, 0, 1);
+            BenchSet(tensor, a, BenchClassField(tensor, c), u * u * u * u * 0.04f);
+        }
+    }
+    for (uint32_t o = 0; o < BENCH_OBJECTS; o++) {
+        float cx = BenchUniform(&seed, 40, BENCH_INPUT - 40), cy = BenchUniform(&seed, 40, BENCH_INPUT - 40);
+        float w = BenchUniform(&seed, 20, 200), h = BenchUniform(&seed, 20, 300);
+        uint32_t c = BenchRandom(&seed) % (classes < 8 ? classes : 8);       // Mostly people and vehicles
+        uint32_t members = 10 + BenchRandom(&seed) % 30;
+        for (uint32_t m = 0; m < members; m++) {
+            uint32_t a = BenchRandom(&seed) % anchors;
+            BenchSet(tensor, a, 0, cx + BenchUniform(&seed, -0.08f, 0.08f) * w);
+            BenchSet(tensor, a, 1, cy + BenchUniform(&seed, -0.08f, 0.08f) * h);
+            BenchSet(tensor, a, 2, w * BenchUniform(&seed, 0.85f, 1.15f));
+            BenchSet(tensor, a, 3, h * BenchUniform(&seed, 0.85f, 1.15f));
+            BenchSet(tensor, a, BenchClassField(tensor, c), BenchUniform(&seed, 0.3f, 0.95f));
+            BenchSet(tensor, a, BenchClassField(tensor, (c + 1) % classes), BenchUniform(&seed, 0.05f, 0.3f));
+            if (layout == RTSPDetectionLayoutAnchorsFirst) {
+                BenchSet(tensor, a, 4, BenchUniform(&seed, 0.6f, 1.0f));
+            }
+        }
+    }
+    for (uint32_t n = 0; n < BENCH_CLUTTER; n++) {
+        uint32_t a = BenchRandom(&seed) % anchors;
+        BenchSet(tensor, a, BenchClassField(tensor, BenchRandom(&seed) % classes), BenchUniform(&seed, 0.1f, 0.3f));
+        if (layout == RTSPDetectionLayoutAnchorsFirst) {
+            BenchSet(tensor, a, 4, BenchUniform(&seed, 0.5f, 1.0f));
+        }
+    }
+}
+
+#pragma mark - Naive Reference
+
+typedef struct {
+    uint32_t anchor;
+    uint32_t classID;
+    float score;
+    float x1, y1, x2, y2;
+} BenchBox;
+
+typedef struct {
+    uint32_t count;
+    BenchBox boxes[1024];
+} BenchBoxes;
+
+static int BenchCompareBoxes(const void *a, const void *b) {
+    const BenchBox *x = *(BenchBox *const *)a, *y = *(BenchBox *const *)b;
+    if (x->score != y->score) {
+        return x->score > y->score ? -1 : 1;
+    }
+    return (x->anchor > y->anchor) - (x->anchor < y->anchor);
+}
+
+static int BenchCompareKept(const void *a, const void *b) {
+    const BenchBox *x = a, *y = b;
+    if (x->score != y->score) {
+        return x->score > y->score ? -1 : 1;
+    }
+    return (x->anchor > y->anchor) - (x->anchor < y->anchor);
+}
+
+/// Best class per anchor with strided reads, one allocation per candidate,
+/// then sort and all-pairs NMS per class
+static void BenchNaiveDecode(const BenchTensor *tensor, float threshold, float iou, const bool *enabled,
+                             uint32_t maxDetections, BenchBoxes *out) {
+    BenchBox **candidates = malloc(tensor->anchors * sizeof(*candidates));
+    uint32_t found = 0;
+    for (uint32_t a = 0; a < tensor->anchors; a++) {
+        float objectness = tensor->layout == RTSPDetectionLayoutAnchorsFirst ? BenchGet(tensor, a, 4) : 1.0f;
+        float best = -1.0f;
+        uint32_t bestClass = 0;
+        for (uint32_t c = 0; c < tensor->classes; c++) {
+            float score = BenchGet(tensor, a, BenchClassField(tensor, c));
+            if ((!enabled || enabled[c]) && score > best) {
+                best = score;
+                bestClass = c;
+            }
+        }
+        float score = best * objectness;
+        if (best < 0 || score < threshold) {
+            continue;
+        }
+        float cx = BenchGet(tensor, a, 0), cy = BenchGet(tensor, a, 1);
+        float w = BenchGet(tensor, a, 2), h = BenchGet(tensor, a, 3);
+        BenchBox *box = malloc(sizeof(*box));
+        *box = (BenchBox){a, bestClass, score, cx - w * 0.5f, cy - h * 0.5f, cx + w * 0.5f, cy + h * 0.5f};
+        candidates[found++] = box;
+    }
+
+    out->count = 0;
+    bool *suppressed = calloc(found ? found : 1, sizeof(bool));
+    BenchBox **group = malloc((found ? found : 1) * sizeof(*group));
+    for (uint32_t c = 0; c < tensor->classes; c++) {
+        uint32_t n = 0;
+        for (uint32_t i = 0; i < found; i++) {
+            if (candidates[i]->classID == c) {
+                group[n++] = candidates[i];
+            }
+        }
+        qsort(group, n, sizeof(*group), BenchCompareBoxes);
+        memset(suppressed, 0, n * sizeof(bool));
+        for (uint32_t i = 0; i < n; i++) {
+            if (suppressed[i]) {
+                continue;
+            }
+            if (out->count < 1024) {
+                out->boxes[out->count++] = *group[i];
+            }
+            for (uint32_t j = i + 1; j < n; j++) {
+                const BenchBox *p = group[i], *q = group[j];
+                float iw = fminf(p->x2, q->x2) - fmaxf(p->x1, q->x1);
+                float ih = fminf(p->y2, q->y2) - fmaxf(p->y1, q->y1);
+                float inter = fmaxf(iw, 0.0f) * fmaxf(ih, 0.0f);
+                float areaP = (p->x2 - p->x1) * (p->y2 - p->y1), areaQ = (q->x2 - q->x1) * (q->y2 - q->y1);
+                if (inter / (areaP + areaQ - inter) > iou) {
+                    suppressed[j] = true;
+                }
+            }
+        }
+    }
+    qsort(out->boxes, out->count, sizeof(BenchBox), BenchCompareKept);
+    if (out->count > maxDetections) {
+        out->count = maxDetections;
+    }
+    for (uint32_t i = 0; i < found; i++) {
+        free(candidates[i]);
+    }
+    free(candidates);
+    free(suppressed);
+    free(group);
+}
+
+/// Whether the decoder kept exactly the reference's boxes, in order
+static bool BenchSameBoxes(const RTSPDetectionBuffer *detections, const BenchBoxes *reference,
+                           const RTSPLetterbox *letterbox) {
+    if (detections->count != reference->count) {
+        return false;
+    }
+    float scaleX = letterbox->scale * (float)letterbox->sourceWidth;
+    float scaleY = letterbox->scale * (float)letterbox->sourceHeight;
+    for (uint32_t i = 0; i < reference->count; i++) {
+        const BenchBox *box = &reference->boxes[i];
+        float x1 = fminf(fmaxf((box->x1 - letterbox->padX) / scaleX, 0.0f), 1.0f);
+        float y1 = fminf(fmaxf((box->y1 - letterbox->padY) / scaleY, 0.0f), 1.0f);
+        float x2 = fminf(fmaxf((box->x2 - letterbox->padX) / scaleX, 0.0f), 1.0f);
+        if (detections->classID[i] != box->classID || detections->score[i] != box->score ||
+            fabsf(detections->x[i] - x1) > 1e-5f || fabsf(detections->y[i] - y1) > 1e-5f ||
+            fabsf(detections->width[i] - (x2 - x1)) > 1e-5f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#pragma mark - Decoder Runs
+
+typedef struct {
+    double p50;
+    double p99;
+    uint32_t kept;
+    bool matches;
+} BenchTiming;
+
+static BenchTiming BenchTimeDecoder(const BenchTensor *tensor, RTSPDetectionBackend backend, float threshold,
+                                    const BenchBoxes *reference, const RTSPLetterbox *letterbox) {
+    RTSPDetectionDecoderConfig config;
+    RTSPDetectionDecoderConfigInit(&config, tensor->anchors, tensor->classes);
+    config.layout = tensor->layout;
+    config.confidenceThreshold = threshold;
+    config.backend = backend;
+    RTSPDetectionDecoderRef decoder = RTSPDetectionDecoderCreate(&config);
+    RTSPDetectionBuffer detections;
+    RTSPDetectionBufferInit(&detections, config.maxDetections);
+
+    double samples[BENCH_ITERATIONS];
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        double start = BenchNow();
+        RTSPDetectionDecoderDecode(decoder, tensor->data, letterbox, &detections);
+        samples[i] = (BenchNow() - start) * 1000.0;
+    }
+    BenchTiming timing = {
+        .p50 = BenchPercentile(samples, BENCH_ITERATIONS, 0.50),
+        .p99 = BenchPercentile(samples, BENCH_ITERATIONS, 0.99),
+        .kept = detections.count,
+        .matches = BenchSameBoxes(&detections, reference, letterbox),
+    };
+    RTSPDetectionBufferFree(&detections);
+    RTSPDetectionDecoderRelease(decoder);
+    return timing;
+}
+
+static BenchTiming BenchTimeNaive(const BenchTensor *tensor, float threshold, BenchBoxes *reference) {
+    double samples[BENCH_ITERATIONS];
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        double start = BenchNow();
+        BenchNaiveDecode(tensor, threshold, 0.45f, NULL, 300, reference);
+        samples[i] = (BenchNow() - start) * 1000.0;
+    }
+    return (BenchTiming){
+        .p50 = BenchPercentile(samples, BENCH_ITERATIONS, 0.50),
+        .p99 = BenchPercentile(samples, BENCH_ITERATIONS, 0.99),
+        .kept = reference->count,
+        .matches = true,
+    };
+}
+
+static const RTSPDetectionBackend BenchBackends[] = {
+    RTSPDetectionBackendScalar, RTSPDetectionBackendSSE2, RTSPDetectionBackendAVX2, RTSPDetectionBackendNEON
+};
+#define BENCH_BACKEND_COUNT (sizeof(BenchBackends) / sizeof(BenchBackends[0]))
+
+/// Time every backend on one tensor; returns the naive p50 over the best backend's
+static double BenchDecodeScenario(const char *name, const BenchTensor *tensor, float threshold, unsigned *failures,
+                                  double *bestP99) {
+    RTSPLetterbox letterbox = RTSPLetterboxMake(1920, 1080, BENCH_INPUT, BENCH_INPUT);
+    BenchBoxes *reference = malloc(sizeof(*reference));
+    BenchTiming naive = BenchTimeNaive(tensor, threshold, reference);
+    printf("  %s, threshold %.2f: %u boxes kept\n", name, threshold, reference->count);
+    printf("    %-8s p50 %7.3f ms  p99 %7.3f ms\n", "naive", naive.p50, naive.p99);
+
+    double best = INFINITY;
+    *bestP99 = INFINITY;
+    for (size_t b = 0; b < BENCH_BACKEND_COUNT; b++) {
+        if (!RTSPDetectionBackendAvailable(BenchBackends[b])) {
+            continue;
+        }
+        BenchTiming timing = BenchTimeDecoder(tensor, BenchBackends[b], threshold, reference, &letterbox);
+        printf("    %-8s p50 %7.3f ms  p99 %7.3f ms  %5.1fx%s\n", RTSPDetectionBackendName(BenchBackends[b]),
+               timing.p50, timing.p99, naive.p50 / timing.p50, timing.matches ? "" : "  MISMATCH");
+        char what[160];
+        snprintf(what, sizeof(what), "%s %s threshold %.2f: kept %u boxes, reference %u", name,
+                 RTSPDetectionBackendName(BenchBackends[b]), threshold, timing.kept, reference->count);
+        *failures += BenchCheck(timing.matches, what);
+        if (timing.p50 < best) {
+            best = timing.p50;
+            *bestP99 = timing.p99;
+        }
+    }
+    free(reference);
+    return naive.p50 / best;
+}
+
+#pragma mark - Decoder Checks
+
+static unsigned BenchCheckDecoder(const BenchTensor *tensor) {
+    unsigned failures = 0;
+    RTSPLetterbox letterbox = RTSPLetterboxMake(1920, 1080, BENCH_INPUT, BENCH_INPUT);
+    RTSPDetectionDecoderConfig config;
+    RTSPDetectionDecoderConfigInit(&config, tensor->anchors, tensor->classes);
+    RTSPDetectionBuffer detections;
+    RTSPDetectionBufferInit(&detections, 1000);
+    BenchBoxes *reference = malloc(sizeof(*reference));
+
+    // Class filtering
+    RTSPDetectionDecoderRef decoder = RTSPDetectionDecoderCreate(&config);
+    uint32_t classes[] = {0, 2};
+    bool enabled[BENCH_CLASSES] = {[0] = true, [2] = true};
+    RTSPDetectionDecoderSetEnabledClasses(decoder, classes, 2);
+    RTSPDetectionDecoderDecode(decoder, tensor->data, &letterbox, &detections);
+    BenchNaiveDecode(tensor, config.confidenceThreshold, config.iouThreshold, enabled, 300, reference);
+    bool onlyEnabled = detections.count > 0;
+    for (uint32_t i = 0; i < detections.count; i++) {
+        onlyEnabled = onlyEnabled && (detections.classID[i] == 0 || detections.classID[i] == 2);
+    }
+    failures += BenchCheck(onlyEnabled && BenchSameBoxes(&detections, reference, &letterbox), "class filtering");
+    RTSPDetectionDecoderRelease(decoder);
+
+    // maxDetections, and a buffer smaller than it
+    config.maxDetections = 5;
+    decoder = RTSPDetectionDecoderCreate(&config);
+    RTSPDetectionDecoderDecode(decoder, tensor->data, &letterbox, &detections);
+    BenchNaiveDecode(tensor, config.confidenceThreshold, config.iouThreshold, NULL, 5, reference);
+    failures += BenchCheck(detections.count == 5 && BenchSameBoxes(&detections, reference, &letterbox), "maxDetections");
+    RTSPDetectionDecoderRelease(decoder);
+    config.maxDetections = 300;
+    RTSPDetectionBuffer small;
+    RTSPDetectionBufferInit(&small, 3);
+    decoder = RTSPDetectionDecoderCreate(&config);
+    RTSPDetectionDecoderDecode(decoder, tensor->data, &letterbox, &small);
+    failures += BenchCheck(small.count == 3, "buffer capacity caps the output");
+    RTSPDetectionBufferFree(&small);
+
+    // A batch decodes like its images one at a time
+    enum { BatchSize = 4 };
+    size_t length = RTSPDetectionDecoderOutputLength(decoder);
+    float *batch = malloc(BatchSize * length * sizeof(float));
+    BenchTensor others[BatchSize];
+    RTSPLetterbox letterboxes[BatchSize];
+    RTSPDetectionBuffer results[BatchSize];
+    for (int i = 0; i < BatchSize; i++) {
+        BenchMakeTensor(&others[i], RTSPDetectionLayoutChannelsFirst, tensor->anchors, tensor->classes, 77u + i);
+        memcpy(batch + i * length, others[i].data, length * sizeof(float));
+        letterboxes[i] = RTSPLetterboxMake(1280 + 640 * i, 720 + 360 * i, BENCH_INPUT, BENCH_INPUT);
+        RTSPDetectionBufferInit(&results[i], 300);
+    }
+    bool batched = RTSPDetectionDecoderDecodeBatch(decoder, batch, BatchSize, letterboxes, results);
+    for (int i = 0; i < BatchSize; i++) {
+        BenchNaiveDecode(&others[i], config.confidenceThreshold, config.iouThreshold, NULL, 300, reference);
+        batched = batched && BenchSameBoxes(&results[i], reference, &letterboxes[i]);
+        RTSPDetectionBufferFree(&results[i]);
+        free(others[i].data);
+    }
+    failures += BenchCheck(batched, "batch decode matches single decodes");
+    free(batch);
+    RTSPDetectionDecoderRelease(decoder);
+
+    // Letterbox round trip: boxes placed on a portrait source come back where they were
+    BenchTensor placed;
+    BenchMakeTensor(&placed, RTSPDetectionLayoutChannelsFirst, 64, 4, 5u);
+    memset(placed.data + 4 * placed.anchors, 0, 4 * placed.anchors * sizeof(float));
+    RTSPLetterbox portrait = RTSPLetterboxMake(720, 1280, BENCH_INPUT, BENCH_INPUT);
+    float truth[3][4] = {{0.10f, 0.20f, 0.30f, 0.25f}, {0.55f, 0.05f, 0.40f, 0.10f}, {0.70f, 0.60f, 0.20f, 0.35f}};
+    for (uint32_t i = 0; i < 3; i++) {
+        float x = truth[i][0] * 720 * portrait.scale + portrait.padX, y = truth[i][1] * 1280 * portrait.scale + portrait.padY;
+        float w = truth[i][2] * 720 * portrait.scale, h = truth[i][3] * 1280 * portrait.scale;
+        BenchSet(&placed, i * 7, 0, x + w / 2);
+        BenchSet(&placed, i * 7, 1, y + h / 2);
+        BenchSet(&placed, i * 7, 2, w);
+        BenchSet(&placed, i * 7, 3, h);
+        BenchSet(&placed, i * 7, 4 + i, 0.9f - 0.1f * (float)i);
+    }
+    RTSPDetectionDecoderConfigInit(&config, 64, 4);
+    decoder = RTSPDetectionDecoderCreate(&config);
+    RTSPDetectionDecoderDecode(decoder, placed.data, &portrait, &detections);
+    bool roundTrip = detections.count == 3;
+    for (uint32_t i = 0; roundTrip && i < 3; i++) {
+        roundTrip = fabsf(detections.x[i] - truth[i][0]) < 1e-4f && fabsf(detections.y[i] - truth[i][1]) < 1e-4f &&
+                    fabsf(detections.width[i] - truth[i][2]) < 1e-4f && fabsf(detections.height[i] - truth[i][3]) < 1e-4f;
+    }
+    failures += BenchCheck(roundTrip, "letterbox round trip");
+    RTSPDetectionDecoderRelease(decoder);
+    free(placed.data);
+
+    RTSPDetectionBufferFree(&detections);
+    free(reference);
+    printf("  class filter, maxDetections, batch and letterbox checks: %s\n", failures ? "FAILED" : "ok");
+    return failures;
+}
+
+#pragma mark - Preprocessing
+
+typedef struct {
+    uint32_t width;
+    uint32_t height;
+    size_t lumaStride;
+    size_t chromaStride;
+    uint8_t *luma;
+    uint8_t *chroma;
+} BenchFrame;
+
+/// Gradients, texture and a few saturated patches, on padded rows
+static void BenchMakeFrame(BenchFrame *frame, uint32_t width, uint32_t height, uint32_t seed) {
+    frame->width = width;
+    frame->height = height;
+    frame->lumaStride = width + 64;
+    frame->chromaStride = width + 64;
+    frame->luma = malloc(frame->lumaStride * height);
+    frame->chroma = malloc(frame->chromaStride * (height / 2));
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            frame->luma[y * frame->lumaStride + x] = (uint8_t)((x * 255 / width + y * 97 / height + (BenchRandom(&seed) & 15)) & 255);
+        }
+    }
+    for (uint32_t y = 0; y < height / 2; y++) {
+        for (uint32_t x = 0; x < width / 2; x++) {
+            frame->chroma[y * frame->chromaStride + 2 * x] = (uint8_t)(64 + (x * 128) / (width / 2));
+            frame->chroma[y * frame->chromaStride + 2 * x + 1] = (uint8_t)(192 - (y * 128) / (height / 2));
+        }
+    }
+}
+
+static void BenchFreeFrame(BenchFrame *frame) {
+    free(frame->luma);
+    free(frame->chroma);
+}
+
+static double BenchClampCoordinate(double value, uint32_t size) {
+    return value < 0 ? 0 : value > size - 1 ? size - 1 : value;
+}
+
+/// Per-pixel letterbox: every output pixel does its own four luma and four
+/// chroma taps. `precise` uses doubles as the reference; otherwise floats
+/// as the naive baseline.
+static void BenchPerPixel(const BenchFrame *frame, float *output, bool precise) {
+    RTSPLetterbox box = RTSPLetterboxMake(frame->width, frame->height, BENCH_INPUT, BENCH_INPUT);
+    size_t plane = (size_t)BENCH_INPUT * BENCH_INPUT;
+    uint32_t chromaWidth = frame->width / 2, chromaHeight = frame->height / 2;
+    float pad = 114.0f / 255.0f;
+    double right = box.padX + frame->width * box.scale, bottom = box.padY + frame->height * box.scale;
+    for (uint32_t oy = 0; oy < BENCH_INPUT; oy++) {
+        for (uint32_t ox = 0; ox < BENCH_INPUT; ox++) {
+            size_t index = (size_t)oy * BENCH_INPUT + ox;
+            if (ox + 0.5 < box.padX || ox + 0.5 >= right || oy + 0.5 < box.padY || oy + 0.5 >= bottom) {
+                output[index] = output[plane + index] = output[2 * plane + index] = pad;
+                continue;
+            }
+            double sx = (ox + 0.5 - box.padX) / box.scale, sy = (oy + 0.5 - box.padY) / box.scale;
+            double lx = BenchClampCoordinate(sx - 0.5, frame->width), ly = BenchClampCoordinate(sy - 0.5, frame->height);
+            double cx = BenchClampCoordinate(sx * 0.5 - 0.5, chromaWidth), cy = BenchClampCoordinate(sy * 0.5 - 0.5, chromaHeight);
+            if (!precise) {
+                lx = (float)lx; ly = (float)ly; cx = (float)cx; cy = (float)cy;
+            }
+            uint32_t x0 = (uint32_t)lx, y0 = (uint32_t)ly, x1 = x0 + 1 < frame->width ? x0 + 1 : x0;
+            uint32_t y1 = y0 + 1 < frame->height ? y0 + 1 : y0;
+            double fx = lx - x0, fy = ly - y0;
+            const uint8_t *l0 = frame->luma + y0 * frame->lumaStride, *l1 = frame->luma + y1 * frame->lumaStride;
+            double top = l0[x0] + fx * (l0[x1] - l0[x0]), low = l1[x0] + fx * (l1[x1] - l1[x0]);
+            double Y = top + fy * (low - top);
+
+            uint32_t c0 = (uint32_t)cx, r0 = (uint32_t)cy, c1 = c0 + 1 < chromaWidth ? c0 + 1 : c0;
+            uint32_t r1 = r0 + 1 < chromaHeight ? r0 + 1 : r0;
+            double gx = cx - c0, gy = cy - r0;
+            double uv[2];
+            for (int k = 0; k < 2; k++) {
+                const uint8_t *p0 = frame->chroma + r0 * frame->chromaStride, *p1 = frame->chroma + r1 * frame->chromaStride;
+                double a = p0[2 * c0 + k] + gx * (p0[2 * c1 + k] - p0[2 * c0 + k]);
+                double b = p1[2 * c0 + k] + gx * (p1[2 * c1 + k] - p1[2 * c0 + k]);
+                uv[k] = a + gy * (b - a) - 128.0;
+            }
+            output[index] = (float)((Y + 1.5748 * uv[1]) / 255.0);
+            output[plane + index] = (float)((Y - 0.1873 * uv[0] - 0.4681 * uv[1]) / 255.0);
+            output[2 * plane + index] = (float)((Y + 1.8556 * uv[0]) / 255.0);
+        }
+    }
+}
+
+static float BenchMaxDifference(const float *a, const float *b, size_t count) {
+    float worst = 0;
+    for (size_t i = 0; i < count; i++) {
+        float d = fabsf(a[i] - b[i]);
+        worst = d > worst ? d : worst;
+    }
+    return worst;
+}
+
+static double BenchPreprocessScenario(const char *name, uint32_t width, uint32_t height, unsigned *failures) {
+    BenchFrame frames[2];
+    BenchMakeFrame(&frames[0], width, height, 1u);
+    BenchMakeFrame(&frames[1], width, height, 2u);
+    size_t length = 3 * (size_t)BENCH_INPUT * BENCH_INPUT;
+    float *reference = malloc(length * sizeof(float));
+    float *output = malloc(length * sizeof(float));
+    float *scalar = malloc(length * sizeof(float));
+
+    double start = BenchNow();
+    for (int i = 0; i < BENCH_FRAMES; i++) {
+        BenchPerPixel(&frames[i & 1], output, false);
+    }
+    double naive = (BenchNow() - start) * 1000.0 / BENCH_FRAMES;
+    BenchPerPixel(&frames[0], reference, true);
+    printf("  %s NV12 -> %dx%d float RGB\n", name, BENCH_INPUT, BENCH_INPUT);
+    printf("    %-8s %7.2f ms/frame\n", "per-pixel", naive);
+
+    double best = INFINITY;
+    for (size_t b = 0; b < BENCH_BACKEND_COUNT; b++) {
+        if (!RTSPDetectionBackendAvailable(BenchBackends[b])) {
+            continue;
+        }
+        RTSPDetectionPreprocessorConfig config;
+        RTSPDetectionPreprocessorConfigInit(&config, BENCH_INPUT, BENCH_INPUT);
+        config.backend = BenchBackends[b];
+        RTSPDetectionPreprocessorRef preprocessor = RTSPDetectionPreprocessorCreate(&config);
+        RTSPLetterbox letterbox;
+        start = BenchNow();
+        for (int i = 0; i < BENCH_FRAMES; i++) {
+            const BenchFrame *frame = &frames[i & 1];
+            RTSPDetectionPreprocessNV12(preprocessor, frame->luma, frame->lumaStride, frame->chroma, frame->chromaStride,
+                                        width, height, output, 0, &letterbox);
+        }
+        double elapsed = (BenchNow() - start) * 1000.0 / BENCH_FRAMES;
+        RTSPDetectionPreprocessNV12(preprocessor, frames[0].luma, frames[0].lumaStride, frames[0].chroma,
+                                    frames[0].chromaStride, width, height, output, 0, &letterbox);
+        if (BenchBackends[b] == RTSPDetectionBackendScalar) {
+            memcpy(scalar, output, length * sizeof(float));
+        }
+        float error = BenchMaxDifference(output, reference, length);
+        float drift = BenchMaxDifference(output, scalar, length);
+        printf("    %-8s %7.2f ms/frame  %5.1fx  max error %.1e\n", RTSPDetectionBackendName(BenchBackends[b]), elapsed,
+               naive / elapsed, error);
+        char what[160];
+        snprintf(what, sizeof(what), "%s %s: max error %.1e against the reference, %.1e against scalar", name,
+                 RTSPDetectionBackendName(BenchBackends[b]), error, drift);
+        *failures += BenchCheck(error < 2e-4f && drift < 1e-5f, what);
+        best = elapsed < best ? elapsed : best;
+        RTSPDetectionPreprocessorRelease(preprocessor);
+    }
+    free(reference);
+    free(output);
+    free(scalar);
+    BenchFreeFrame(&frames[0]);
+    BenchFreeFrame(&frames[1]);
+    return naive / best;
+}
+
+static unsigned BenchCheckPreprocessor(void) {
+    unsigned failures = 0;
+    BenchFrame frame;
+    BenchMakeFrame(&frame, 1280, 720, 3u);
+    RTSPDetectionPreprocessorConfig config;
+    RTSPDetectionPreprocessorConfigInit(&config, BENCH_INPUT, BENCH_INPUT);
+    size_t plane = (size_t)BENCH_INPUT * BENCH_INPUT;
+
+    // Planar float: padding is grey 114 and the decoder's letterbox matches
+    RTSPDetectionPreprocessorRef preprocessor = RTSPDetectionPreprocessorCreate(&config);
+    float *planar = malloc(3 * plane * sizeof(float));
+    RTSPLetterbox letterbox;
+    RTSPDetectionPreprocessNV12(preprocessor, frame.luma, frame.lumaStride, frame.chroma, frame.chromaStride, 1280, 720,
+                                planar, 0, &letterbox);
+    RTSPLetterbox expected = RTSPLetterboxMake(1280, 720, BENCH_INPUT, BENCH_INPUT);
+    failures += BenchCheck(memcmp(&letterbox, &expected, sizeof(letterbox)) == 0, "letterbox reported");
+    failures += BenchCheck(planar[0] == 114.0f / 255.0f && planar[2 * plane + plane - 1] == 114.0f / 255.0f, "grey padding");
+    RTSPDetectionPreprocessorRelease(preprocessor);
+
+    // BGRA8 rows with padding between them match the float path
+    config.format = RTSPDetectionInputBGRA8;
+    preprocessor = RTSPDetectionPreprocessorCreate(&config);
+    size_t stride = 4 * BENCH_INPUT + 32;
+    uint8_t *bgra = malloc(RTSPDetectionPreprocessorInputLength(preprocessor, stride));
+    RTSPDetectionPreprocessNV12(preprocessor, frame.luma, frame.lumaStride, frame.chroma, frame.chromaStride, 1280, 720,
+                                bgra, stride, NULL);
+    int worst = 0;
+    for (uint32_t y = 0; y < BENCH_INPUT; y++) {
+        for (uint32_t x = 0; x < BENCH_INPUT; x++) {
+            const uint8_t *pixel = bgra + y * stride + 4 * x;
+            for (int c = 0; c < 3; c++) {
+                float value = planar[(size_t)c * plane + (size_t)y * BENCH_INPUT + x] * 255.0f;
+                float clamped = value < 0 ? 0 : value > 255 ? 255 : value;
+                int d = abs((int)pixel[2 - c] - (int)lroundf(clamped));
+                worst = d > worst ? d : worst;
+            }
+            worst = pixel[3] != 255 ? 255 : worst;
+        }
+    }
+    failures += BenchCheck(worst <= 1, "BGRA8 output matches planar float");
+    RTSPDetectionPreprocessorRelease(preprocessor);
+
+    // Mean / std normalisation
+    RTSPDetectionPreprocessorConfigInit(&config, BENCH_INPUT, BENCH_INPUT);
+    const float mean[3] = {0.485f, 0.456f, 0.406f}, std[3] = {0.229f, 0.224f, 0.225f};
+    memcpy(config.mean, mean, sizeof(mean));
+    memcpy(config.std, std, sizeof(std));
+    preprocessor = RTSPDetectionPreprocessorCreate(&config);
+    float *normalized = malloc(3 * plane * sizeof(float));
+    RTSPDetectionPreprocessNV12(preprocessor, frame.luma, frame.lumaStride, frame.chroma, frame.chromaStride, 1280, 720,
+                                normalized, 0, NULL);
+    float error = 0;
+    for (size_t c = 0; c < 3; c++) {
+        for (size_t i = 0; i < plane; i += 97) {
+            float d = fabsf(normalized[c * plane + i] - (planar[c * plane + i] - mean[c]) / std[c]);
+            error = d > error ? d : error;
+        }
+    }
+    failures += BenchCheck(error < 1e-4f, "mean / std normalisation");
+    RTSPDetectionPreprocessorRelease(preprocessor);
+
+    free(planar);
+    free(bgra);
+    free(normalized);
+    BenchFreeFrame(&frame);
+    printf("  padding, BGRA8 and normalisation checks: %s\n", failures ? "FAILED" : "ok");
+    return failures;
+}
+
+#pragma mark - Main
+
+int main(void) {
+    printf("detection_decoder_bench\n");
+    unsigned failures = 0;
+
+    BenchTensor v8, v5;
+    BenchMakeTensor(&v8, RTSPDetectionLayoutChannelsFirst, BENCH_ANCHORS, BENCH_CLASSES, 1234u);
+    BenchMakeTensor(&v5, RTSPDetectionLayoutAnchorsFirst, BENCH_V5_ANCHORS, BENCH_CLASSES, 4321u);
+    failures += BenchCheckDecoder(&v8);
+
+    double p99;
+    double speedup = BenchDecodeScenario("YOLOv8 8400x80", &v8, 0.25f, &failures, &p99);
+    char what[160];
+    snprintf(what, sizeof(what), "8400 anchors: %.1fx the naive decoder (target >= %.1fx), p99 %.3f ms (target <= %.1f ms)",
+             speedup, BENCH_TARGET_DECODE_SPEEDUP, p99, BENCH_TARGET_DECODE_P99);
+    failures += BenchCheck(speedup >= BENCH_TARGET_DECODE_SPEEDUP && p99 <= BENCH_TARGET_DECODE_P99, what);
+    BenchDecodeScenario("YOLOv8 8400x80", &v8, 0.10f, &failures, &p99);
+    BenchDecodeScenario("YOLOv5 25200x85", &v5, 0.25f, &failures, &p99);
+
+    failures += BenchCheckPreprocessor();
+    speedup = BenchPreprocessScenario("1080p", 1920, 1080, &failures);
+    snprintf(what, sizeof(what), "1080p preprocessing %.1fx per-pixel (target >= %.1fx)", speedup,
+             BENCH_TARGET_PREPROCESS_SPEEDUP);
+    failures += BenchCheck(speedup >= BENCH_TARGET_PREPROCESS_SPEEDUP, what);
+    BenchPreprocessScenario("4K", 3840, 2160, &failures);
+
+    free(v8.data);
+    free(v5.data);
+    printf("%s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
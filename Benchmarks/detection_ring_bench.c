@@ -0,0 +1,385 @@
+//
+//  detection_ring_bench.c
+//  RTSP Rotator Benchmarks
+//
+//  Benchmark for RTSPDetectionRing: one producer pushes detection records
+//  while reader threads poll the way a dashboard does, alternating a
+//  snapshot of the newest events with a statistics call. Two setups are
+//  compared:
+//
+//    locked   the old history: a circular array behind one lock, with
+//             statistics counted by scanning it under the lock (the
+//             serial eventQueue with dispatch_sync readers)
+//    ring     RTSPDetectionRing with seqlock snapshots and atomic counts
+//
+//  Reports producer push latency p50/p99/p99.9/max with 0 and N readers, and the
+//  polls per second the readers managed.
+//
+//  Checks: snapshots are the newest records in order after wrapping; the
+//  class and camera counts match a recount of the ring across wraps and
+//  clears; no reader ever sees a torn record or a snapshot out of order
+//  while the producer runs; readers slow the producer by no more than the
+//  target; out-of-range IDs and a zero capacity are rejected.
+//
+//  Build (Linux / macOS):
+//    cc -O2 -std=gnu11 -I"../RTSP Rotator" detection_ring_bench.c "../RTSP Rotator/RTSPDetectionRing.c" -lpthread -lm -o detection_ring_bench
+//
+//  Usage: detection_ring_bench [--readers N] [--pushes N]
+//
+
+#define _GNU_SOURCE
+
+#include "RTSPDetectionRing.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_CAPACITY 1000             // RTSPObjectDetector's history size
+#define BENCH_SNAPSHOT 50               // Events a dashboard asks for
+#define BENCH_CLASSES 80
+#define BENCH_CAMERAS 32
+#define BENCH_TARGET_P99_NS 2000.0      // Ring push p99 with readers polling
+
+static double BenchNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static int BenchCompareDouble(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double BenchPercentile(const double *sorted, size_t count, double percentile) {
+    if (count == 0) {
+        return 0;
+    }
+    size_t index = (size_t)(percentile * (double)(count - 1) + 0.5);
+    return sorted[index < count ? index : count - 1];
+}
+
+static unsigned BenchCheck(bool condition, const char *what) {
+    if (!condition) {
+        fprintf(stderr, "  check failed: %s\n", what);
+    }
+    return condition ? 0 : 1;
+}
+
+#pragma mark - Records
+
+/// Every field derives from the sequence, so a reader can tell a torn copy
+static RTSPDetectionRecord BenchRecord(uint64_t sequence) {
+    RTSPDetectionRecord record;
+    memset(&record, 0, sizeof(record));
+    uint32_t hash = (uint32_t)(sequence * 2654435761u);
+    record.timestamp = 1.7e9 + (double)sequence * 0.01;
+    record.detectedAt = record.timestamp - 0.05;
+    record.x = (float)(hash & 0xff) / 256.0f;
+    record.y = (float)((hash >> 8) & 0xff) / 256.0f;
+    record.width = 0.1f;
+    record.height = 0.2f;
+    record.confidence = (float)((hash >> 16) & 0xff) / 255.0f;
+    record.classID = (uint16_t)(sequence % BENCH_CLASSES);
+    record.cameraID = (uint16_t)((sequence / 3) % BENCH_CAMERAS);
+    record.trackID = sequence ^ 0x5555555555555555ull;
+    record.zoneSetID = (uint16_t)(hash >> 24);
+    record.flags = (uint16_t)(sequence & 1 ? RTSPDetectionRecordFlagTracked : 0);
+    return record;
+}
+
+static bool BenchRecordIntact(const RTSPDetectionRecord *record) {
+    RTSPDetectionRecord expected = BenchRecord(record->sequence);
+    expected.sequence = record->sequence;
+    return memcmp(&expected, record, sizeof(expected)) == 0;
+}
+
+#pragma mark - Locked history
+
+typedef struct {
+    pthread_mutex_t lock;
+    RTSPDetectionRecord *records;       // Circular, like NSMutableArray's storage
+    uint32_t count;
+    uint64_t pushed;
+} BenchLockedHistory;
+
+static void BenchLockedPush(BenchLockedHistory *history, const RTSPDetectionRecord *record) {
+    pthread_mutex_lock(&history->lock);
+    RTSPDetectionRecord *slot = &history->records[history->pushed % BENCH_CAPACITY];
+    *slot = *record;
+    slot->sequence = history->pushed++;
+    if (history->count < BENCH_CAPACITY) {
+        history->count++;
+    }
+    pthread_mutex_unlock(&history->lock);
+}
+
+static uint32_t BenchLockedSnapshot(BenchLockedHistory *history, RTSPDetectionRecord *records, uint32_t maxCount) {
+    pthread_mutex_lock(&history->lock);
+    uint32_t count = history->count < maxCount ? history->count : maxCount;
+    for (uint32_t i = 0; i < count; i++) {
+        records[i] = history->records[(history->pushed - count + i) % BENCH_CAPACITY];
+    }
+    pthread_mutex_unlock(&history->lock);
+    return count;
+}
+
+static uint32_t BenchLockedStatistics(BenchLockedHistory *history, uint32_t *classCounts, uint32_t *cameraCounts) {
+    pthread_mutex_lock(&history->lock);
+    memset(classCounts, 0, BENCH_CLASSES * sizeof(uint32_t));
+    memset(cameraCounts, 0, BENCH_CAMERAS * sizeof(uint32_t));
+    for (uint32_t i = 0; i < history->count; i++) {
+        classCounts[history->records[i].classID]++;
+        cameraCounts[history->records[i].cameraID]++;
+    }
+    uint32_t count = history->count;
+    pthread_mutex_unlock(&history->lock);
+    return count;
+}
+
+#pragma mark - Runs
+
+typedef struct {
+    bool useRing;
+    RTSPDetectionRingRef ring;
+    BenchLockedHistory *locked;
+    atomic_bool stop;
+    atomic_uint_fast64_t polls;
+    atomic_uint_fast64_t torn;          // Records that failed the intact check
+    atomic_uint_fast64_t disordered;    // Snapshots not in sequence order
+} BenchShared;
+
+static void *BenchReader(void *argument) {
+    BenchShared *shared = argument;
+    RTSPDetectionRecord records[BENCH_SNAPSHOT];
+    uint32_t classCounts[BENCH_CLASSES], cameraCounts[BENCH_CAMERAS];
+    uint64_t polls = 0;
+    while (!atomic_load_explicit(&shared->stop, memory_order_relaxed)) {
+        uint32_t count;
+        if (shared->useRing) {
+            count = RTSPDetectionRingSnapshot(shared->ring, records, BENCH_SNAPSHOT);
+            for (uint16_t c = 0; c < BENCH_CLASSES; c++) classCounts[c] = RTSPDetectionRingClassCount(shared->ring, c);
+            for (uint16_t c = 0; c < BENCH_CAMERAS; c++) cameraCounts[c] = RTSPDetectionRingCameraCount(shared->ring, c);
+        } else {
+            count = BenchLockedSnapshot(shared->locked, records, BENCH_SNAPSHOT);
+            BenchLockedStatistics(shared->locked, classCounts, cameraCounts);
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            if (!BenchRecordIntact(&records[i])) {
+                atomic_fetch_add(&shared->torn, 1);
+            }
+            if (i > 0 && records[i].sequence <= records[i - 1].sequence) {
+                atomic_fetch_add(&shared->disordered, 1);
+            }
+        }
+        polls++;
+    }
+    atomic_fetch_add(&shared->polls, polls);
+    return NULL;
+}
+
+typedef struct {
+    double p50, p99, p999, max;         // Push latency, ns
+    double pollsPerSecond;
+    uint64_t torn, disordered;
+} BenchResult;
+
+static BenchResult BenchRun(bool useRing, unsigned readers, uint32_t pushes) {
+    BenchShared shared;
+    memset(&shared, 0, sizeof(shared));
+    shared.useRing = useRing;
+    BenchLockedHistory locked;
+    if (useRing) {
+        shared.ring = RTSPDetectionRingCreate(BENCH_CAPACITY);
+    } else {
+        pthread_mutex_init(&locked.lock, NULL);
+        locked.records = malloc(BENCH_CAPACITY * sizeof(RTSPDetectionRecord));
+        locked.count = 0;
+        locked.pushed = 0;
+        shared.locked = &locked;
+    }
+
+    pthread_t threads[64];
+    for (unsigned r = 0; r < readers; r++) {
+        pthread_create(&threads[r], NULL, BenchReader, &shared);
+    }
+
+    double *latencies = malloc(pushes * sizeof(double));
+    double started = BenchNow();
+    for (uint32_t i = 0; i < pushes; i++) {
+        RTSPDetectionRecord record = BenchRecord(i);
+        double t0 = BenchNow();
+        if (useRing) {
+            RTSPDetectionRingPush(shared.ring, &record);
+        } else {
+            BenchLockedPush(&locked, &record);
+        }
+        latencies[i] = (BenchNow() - t0) * 1e9;
+    }
+    double elapsed = BenchNow() - started;
+
+    atomic_store(&shared.stop, true);
+    for (unsigned r = 0; r < readers; r++) {
+        pthread_join(threads[r], NULL);
+    }
+
+    qsort(latencies, pushes, sizeof(double), BenchCompareDouble);
+    BenchResult result = {
+        BenchPercentile(latencies, pushes, 0.5),
+        BenchPercentile(latencies, pushes, 0.99),
+        BenchPercentile(latencies, pushes, 0.999),
+        latencies[pushes - 1],
+        elapsed > 0 ? (double)atomic_load(&shared.polls) / elapsed : 0,
+        atomic_load(&shared.torn),
+        atomic_load(&shared.disordered),
+    };
+    free(latencies);
+    if (useRing) {
+        RTSPDetectionRingRelease(shared.ring);
+    } else {
+        free(locked.records);
+        pthread_mutex_destroy(&locked.lock);
+    }
+    return result;
+}
+
+static void BenchPrint(const char *name, unsigned readers, const BenchResult *result) {
+    printf("  %-6s %2u readers  push p50 %5.0f ns  p99 %6.0f ns  p99.9 %8.0f ns  max %9.0f ns", name, readers,
+           result->p50, result->p99, result->p999, result->max);
+    if (readers > 0) {
+        printf("  %9.0f polls/s", result->pollsPerSecond);
+    }
+    printf("\n");
+}
+
+#pragma mark - Behaviour
+
+/// Counts recomputed from a snapshot of the whole ring
+static unsigned BenchCheckCounts(RTSPDetectionRingRef ring, const char *when) {
+    RTSPDetectionRecord records[BENCH_CAPACITY];
+    uint32_t count = RTSPDetectionRingSnapshot(ring, records, BENCH_CAPACITY);
+    uint32_t classCounts[BENCH_CLASSES] = {0}, cameraCounts[BENCH_CAMERAS] = {0};
+    for (uint32_t i = 0; i < count; i++) {
+        classCounts[records[i].classID]++;
+        cameraCounts[records[i].cameraID]++;
+    }
+    bool match = RTSPDetectionRingGetStats(ring).count == count;
+    for (uint16_t c = 0; c < BENCH_CLASSES; c++) match &= RTSPDetectionRingClassCount(ring, c) == classCounts[c];
+    for (uint16_t c = 0; c < BENCH_CAMERAS; c++) match &= RTSPDetectionRingCameraCount(ring, c) == cameraCounts[c];
+    if (!match) {
+        fprintf(stderr, "  check failed: counts match a recount %s\n", when);
+    }
+    return match ? 0 : 1;
+}
+
+static unsigned BenchCheckBehaviour(void) {
+    unsigned failures = 0;
+    failures += BenchCheck(RTSPDetectionRingCreate(0) == NULL, "zero capacity rejected");
+
+    RTSPDetectionRingRef ring = RTSPDetectionRingCreate(BENCH_CAPACITY);
+    RTSPDetectionRecord records[BENCH_CAPACITY];
+    failures += BenchCheck(RTSPDetectionRingSnapshot(ring, records, BENCH_CAPACITY) == 0, "new ring is empty");
+    failures += BenchCheckCounts(ring, "when empty");
+
+    for (uint64_t i = 0; i < 700; i++) {
+        RTSPDetectionRecord record = BenchRecord(i);
+        failures += BenchCheck(RTSPDetectionRingPush(ring, &record) == i, "push returns the sequence");
+    }
+    failures += BenchCheckCounts(ring, "before wrapping");
+
+    for (uint64_t i = 700; i < 2500; i++) {
+        RTSPDetectionRecord record = BenchRecord(i);
+        RTSPDetectionRingPush(ring, &record);
+    }
+    uint32_t count = RTSPDetectionRingSnapshot(ring, records, BENCH_CAPACITY);
+    bool newest = count == BENCH_CAPACITY;
+    for (uint32_t i = 0; newest && i < count; i++) {
+        newest = records[i].sequence == 1500 + i && BenchRecordIntact(&records[i]);
+    }
+    failures += BenchCheck(newest, "snapshot holds the newest records in order after wrapping");
+    failures += BenchCheckCounts(ring, "after wrapping");
+
+    count = RTSPDetectionRingSnapshot(ring, records, 10);
+    failures += BenchCheck(count == 10 && records[0].sequence == 2490 && records[9].sequence == 2499,
+                           "short snapshot takes the newest");
+
+    RTSPDetectionRingStats stats = RTSPDetectionRingGetStats(ring);
+    failures += BenchCheck(stats.pushed == 2500 && stats.count == BENCH_CAPACITY && stats.capacity == BENCH_CAPACITY,
+                           "stats after wrapping");
+
+    // A clear must not let the records it dropped leave the counts again when overwritten
+    RTSPDetectionRingClear(ring);
+    failures += BenchCheck(RTSPDetectionRingSnapshot(ring, records, BENCH_CAPACITY) == 0, "clear empties the ring");
+    failures += BenchCheckCounts(ring, "after clearing");
+    for (uint64_t i = 2500; i < 2800; i++) {
+        RTSPDetectionRecord record = BenchRecord(i);
+        RTSPDetectionRingPush(ring, &record);
+    }
+    failures += BenchCheckCounts(ring, "refilling after a clear");
+    count = RTSPDetectionRingSnapshot(ring, records, BENCH_CAPACITY);
+    failures += BenchCheck(count == 300 && records[0].sequence == 2500, "only records since the clear");
+    for (uint64_t i = 2800; i < 4100; i++) {
+        RTSPDetectionRecord record = BenchRecord(i);
+        RTSPDetectionRingPush(ring, &record);
+    }
+    failures += BenchCheckCounts(ring, "wrapping after a clear");
+
+    RTSPDetectionRecord invalid = BenchRecord(0);
+    invalid.classID = RTSP_DETECTION_RING_MAX_CLASSES;
+    failures += BenchCheck(RTSPDetectionRingPush(ring, &invalid) == UINT64_MAX, "out-of-range class rejected");
+    invalid = BenchRecord(0);
+    invalid.cameraID = RTSP_DETECTION_RING_MAX_CAMERAS;
+    failures += BenchCheck(RTSPDetectionRingPush(ring, &invalid) == UINT64_MAX, "out-of-range camera rejected");
+    failures += BenchCheck(RTSPDetectionRingGetStats(ring).pushed == 4100, "rejected records not pushed");
+    failures += BenchCheck(RTSPDetectionRingClassCount(ring, RTSP_DETECTION_RING_MAX_CLASSES) == 0,
+                           "out-of-range class count");
+
+    RTSPDetectionRingRelease(ring);
+    RTSPDetectionRingRelease(NULL);
+    return failures;
+}
+
+#pragma mark - Main
+
+int main(int argc, char **argv) {
+    unsigned readers = 4;
+    uint32_t pushes = 1000000;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--readers") == 0 && i + 1 < argc) {
+            readers = (unsigned)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--pushes") == 0 && i + 1 < argc) {
+            pushes = (uint32_t)atoi(argv[++i]);
+        }
+    }
+    if (readers > 64) readers = 64;
+    if (pushes < 1000) pushes = 1000;
+
+    printf("detection_ring_bench\n");
+    unsigned failures = BenchCheckBehaviour();
+
+    printf("  %u pushes into %d slots, readers poll %d events and %d class / %d camera counts\n", pushes,
+           BENCH_CAPACITY, BENCH_SNAPSHOT, BENCH_CLASSES, BENCH_CAMERAS);
+    BenchResult lockedAlone = BenchRun(false, 0, pushes);
+    BenchPrint("locked", 0, &lockedAlone);
+    BenchResult lockedPolled = BenchRun(false, readers, pushes);
+    BenchPrint("locked", readers, &lockedPolled);
+    BenchResult ringAlone = BenchRun(true, 0, pushes);
+    BenchPrint("ring", 0, &ringAlone);
+    BenchResult ringPolled = BenchRun(true, readers, pushes);
+    BenchPrint("ring", readers, &ringPolled);
+
+    failures += BenchCheck(lockedPolled.torn == 0 && ringPolled.torn == 0, "no torn records");
+    failures += BenchCheck(lockedPolled.disordered == 0 && ringPolled.disordered == 0, "snapshots in order");
+    printf("  ring push p99 with %u readers: %.0f ns (target <= %.0f ns), locked %.0f ns\n", readers, ringPolled.p99,
+           BENCH_TARGET_P99_NS, lockedPolled.p99);
+    if (readers > 0) {
+        failures += BenchCheck(ringPolled.p99 <= BENCH_TARGET_P99_NS, "ring push p99 with readers");
+    }
+
+    printf(failures ? "FAILED (%u)\n" : "OK\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,630 @@
+//
+//  dvr_store_bench.c
+//  RTSP Rotator Benchmarks
+//
+//  Benchmark for RTSPDVRStore, the per-camera ring of fMP4 segment files
+//  with a memory-mapped time index. Three phases:
+//
+//    1. Checks on a small ring (six 2 s segments) fed synthetic engine
+//       parts: 30 fps H.264-shaped fragments, one keyframe per second.
+//    2. A full 24 h ring (8640 × 10 s) filled with tiny fragments and
+//       wrapped: seek latency through the index against one listing of the
+//       segment directory, which is what finding a time without an index
+//       would start with.
+//    3. N cameras recorded in real time order at a given bitrate with the
+//       default segment geometry and preallocation: append CPU per camera
+//       and write throughput.
+//
+//  Checks: the ring holds slotCount segments, overwrites the oldest in
+//  place and never creates more slot files; every segment reads back as
+//  init + moof/mdat fragments opening on a keyframe; seeks land on the last
+//  keyframe at or before the requested time; reads of an overwritten
+//  segment fail; the index survives reopening and is discarded when the
+//  geometry changes; reconnects with the same init segment continue the
+//  segment, new ones cut it and mark a discontinuity; the playlist covers
+//  the range with an init segment per configuration.
+//
+//  Build (Linux):
+//    cc -O2 -std=gnu11 -I"../RTSP Rotator" dvr_store_bench.c "../RTSP Rotator/RTSPDVRStore.c" "../RTSP Rotator/RTSPFMP4Writer.c" "../RTSP Rotator/RTSPCodecConfig.c" "../RTSP Rotator/RTSPByteBuffer.c" -lpthread -lm -o dvr_store_bench
+//
+//  Usage: dvr_store_bench [--cameras N] [--seconds S] [--bitrate KBPS] [--seeks N]
+//
+
+#define _GNU_SOURCE
+
+#include "RTSPDVRStore.h"
+#include "RTSPFMP4Writer.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_TARGET_SEEK_US 20.0       // Mean seek through a full 24 h index
+#define BENCH_TARGET_APPEND_CPU 1.0     // Percent of one core per camera recording in real time
+#define BENCH_FPS 30
+#define BENCH_GOP 30                    // Frames per keyframe
+#define BENCH_PART_FRAMES 6             // 0.2 s parts, as the engine cuts them
+#define BENCH_EPOCH 1760000000000000LL  // Wall clock the synthetic cameras start at (µs)
+
+static double BenchNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static double BenchCPUSeconds(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (double)usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+           (double)usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+static unsigned BenchCheck(bool condition, const char *what) {
+    if (!condition) {
+        fprintf(stderr, "  check failed: %s\n", what);
+    }
+    return condition ? 0 : 1;
+}
+
+static uint64_t gRandomState = 0x9E3779B97F4A7C15ull;
+
+static uint64_t BenchRandom(void) {
+    gRandomState ^= gRandomState << 13;
+    gRandomState ^= gRandomState >> 7;
+    gRandomState ^= gRandomState << 17;
+    return gRandomState;
+}
+
+static uint32_t BenchU32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static bool BenchFileExists(const char *directory, const char *name) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", directory, name);
+    struct stat info;
+    return stat(path, &info) == 0;
+}
+
+/// YES if any segment-NNNNN.m4s has a slot number of `slotCount` or more
+static bool BenchHasSlotBeyond(const char *directory, uint32_t slotCount) {
+    DIR *dir = opendir(directory);
+    if (!dir) {
+        return false;
+    }
+    bool found = false;
+    struct dirent *entry;
+    unsigned slot;
+    while (!found && (entry = readdir(dir))) {
+        found = sscanf(entry->d_name, "segment-%u.m4s", &slot) == 1 && slot >= slotCount;
+    }
+    closedir(dir);
+    return found;
+}
+
+static void BenchRemoveDirectory(const char *directory) {
+    DIR *dir = opendir(directory);
+    if (!dir) {
+        return;
+    }
+    struct dirent *entry;
+    char path[PATH_MAX];
+    while ((entry = readdir(dir))) {
+        if (entry->d_name[0] != '.') {
+            snprintf(path, sizeof(path), "%s/%s", directory, entry->d_name);
+            unlink(path);
+        }
+    }
+    closedir(dir);
+    rmdir(directory);
+}
+
+#pragma mark - Segment Check
+
+typedef struct {
+    bool valid;
+    bool startsWithKeyframe;
+    uint32_t fragments;
+    double duration;
+} BenchSegment;
+
+/// Parse a stored segment: ftyp, moov, then moof + mdat pairs with
+/// consecutive sequence numbers and decode times that continue exactly
+static BenchSegment BenchParseSegment(const uint8_t *data, size_t length) {
+    BenchSegment result = {0};
+    bool valid = true;
+    uint64_t decodeTime = 0;
+    uint64_t firstDecodeTime = 0;
+    uint32_t sequence = 0;
+    size_t offset = 0;
+    for (unsigned box = 0; valid && offset + 8 <= length; box++) {
+        const uint8_t *p = data + offset;
+        size_t size = BenchU32(p);
+        valid = size >= 8 && size <= length - offset;
+        const char *expected = box == 0 ? "ftyp" : box == 1 ? "moov" : box % 2 == 0 ? "moof" : "mdat";
+        valid = valid && memcmp(p + 4, expected, 4) == 0;
+        if (valid && box >= 2 && box % 2 == 0) {
+            const uint8_t *mfhd = p + 8;
+            const uint8_t *traf = mfhd + BenchU32(mfhd);
+            const uint8_t *tfhd = traf + 8;
+            const uint8_t *tfdt = tfhd + BenchU32(tfhd);
+            const uint8_t *trun = tfdt + BenchU32(tfdt);
+            uint64_t fragmentTime = ((uint64_t)BenchU32(tfdt + 12) << 32) | BenchU32(tfdt + 16);
+            if (result.fragments == 0) {
+                decodeTime = firstDecodeTime = fragmentTime;
+                sequence = BenchU32(mfhd + 12);
+            }
+            valid = memcmp(mfhd + 4, "mfhd", 4) == 0 && memcmp(tfdt + 4, "tfdt", 4) == 0 &&
+                    memcmp(trun + 4, "trun", 4) == 0 && BenchU32(mfhd + 12) == sequence + result.fragments &&
+                    fragmentTime == decodeTime;
+            uint32_t flags = BenchU32(trun + 8) & 0xFFFFFF;
+            uint32_t samples = BenchU32(trun + 12);
+            const uint8_t *field = trun + 16 + (flags & 0x1 ? 4 : 0) + (flags & 0x4 ? 4 : 0);
+            for (uint32_t i = 0; valid && i < samples; i++) {
+                decodeTime += BenchU32(field);
+                if (result.fragments == 0 && i == 0) {
+                    const uint8_t *sampleFlags = field + 4 + (flags & 0x200 ? 4 : 0);
+                    result.startsWithKeyframe = BenchU32(sampleFlags) == 0x02000000u;
+                }
+                field += 4 * (1 + !!(flags & 0x200) + 1 + !!(flags & 0x800));
+            }
+            result.fragments++;
+        }
+        offset += size;
+    }
+    result.valid = valid && offset == length && result.fragments > 0;
+    result.duration = (double)(decodeTime - firstDecodeTime) / RTSP_FMP4_TIMESCALE;
+    return result;
+}
+
+#pragma mark - Synthetic Engine Output
+
+/// Parts the way RTSPRemuxEngine emits them: 0.2 s of 30 fps video, the
+/// first part of every GOP independent, on a wall clock from BENCH_EPOCH
+typedef struct {
+    uint32_t initID;
+    uint32_t sequence;
+    uint64_t frame;
+    uint32_t keyframeBytes;
+    uint32_t frameBytes;
+    RTSPByteBuffer fragment;
+    uint8_t *payload;
+} BenchSynth;
+
+static const uint8_t BenchInitA[] = {
+    0, 0, 0, 16, 'f', 't', 'y', 'p', 'i', 's', 'o', '6', 0, 0, 0, 0,
+    0, 0, 0, 8, 'm', 'o', 'o', 'v',
+};
+static const uint8_t BenchInitB[] = {
+    0, 0, 0, 16, 'f', 't', 'y', 'p', 'i', 's', 'o', '6', 0, 0, 0, 1,
+    0, 0, 0, 8, 'm', 'o', 'o', 'v',
+};
+
+static void BenchSynthInit(BenchSynth *synth, uint32_t initID, uint32_t keyframeBytes, uint32_t frameBytes) {
+    memset(synth, 0, sizeof(*synth));
+    synth->initID = initID;
+    synth->keyframeBytes = keyframeBytes;
+    synth->frameBytes = frameBytes;
+    RTSPByteBufferInit(&synth->fragment);
+    synth->payload = calloc(1, keyframeBytes + (size_t)frameBytes * BENCH_PART_FRAMES);
+}
+
+static void BenchSynthFree(BenchSynth *synth) {
+    RTSPByteBufferFree(&synth->fragment);
+    free(synth->payload);
+}
+
+static int64_t BenchSynthTime(const BenchSynth *synth) {
+    return BENCH_EPOCH + (int64_t)(synth->frame * 1000000 / BENCH_FPS);
+}
+
+/// Feed one part
+static void BenchSynthPart(BenchSynth *synth, RTSPDVRStoreRef store) {
+    RTSPFMP4Sample samples[BENCH_PART_FRAMES];
+    size_t payloadLength = 0;
+    bool independent = synth->frame % BENCH_GOP == 0;
+    for (unsigned i = 0; i < BENCH_PART_FRAMES; i++) {
+        bool keyframe = (synth->frame + i) % BENCH_GOP == 0;
+        samples[i] = (RTSPFMP4Sample){keyframe ? synth->keyframeBytes : synth->frameBytes,
+                                      RTSP_FMP4_TIMESCALE / BENCH_FPS, keyframe};
+        payloadLength += samples[i].size;
+    }
+    RTSPByteBufferReset(&synth->fragment);
+    RTSPFMP4WriteFragment(++synth->sequence, synth->frame * (RTSP_FMP4_TIMESCALE / BENCH_FPS),
+                          samples, BENCH_PART_FRAMES, synth->payload, payloadLength, &synth->fragment);
+    RTSPRemuxMediaInfo info = {
+        .sequence = synth->sequence,
+        .initID = synth->initID,
+        .duration = (double)BENCH_PART_FRAMES / BENCH_FPS,
+        .independent = independent,
+    };
+    RTSPDVRStoreAddMedia(store, &info, synth->fragment.data, synth->fragment.length, BenchSynthTime(synth));
+    synth->frame += BENCH_PART_FRAMES;
+}
+
+/// Feed `seconds` of parts
+static void BenchSynthFeed(BenchSynth *synth, RTSPDVRStoreRef store, double seconds) {
+    uint64_t parts = (uint64_t)llround(seconds * BENCH_FPS / BENCH_PART_FRAMES);
+    for (uint64_t p = 0; p < parts; p++) {
+        BenchSynthPart(synth, store);
+    }
+}
+
+#pragma mark - Checks
+
+static RTSPDVRStoreConfig BenchSmallConfig(void) {
+    RTSPDVRStoreConfig config;
+    RTSPDVRStoreConfigInit(&config);
+    config.slotCount = 6;
+    config.slotBytes = 1 << 20;
+    config.segmentDuration = 2.0;
+    return config;
+}
+
+/// Ring bounds, segment contents, seeks and overwritten reads
+static unsigned BenchCheckRing(const char *directory) {
+    unsigned failures = 0;
+    RTSPDVRStoreConfig config = BenchSmallConfig();
+    RTSPDVRStoreRef store = RTSPDVRStoreOpen(directory, &config);
+    failures += BenchCheck(store != NULL, "store opens");
+    if (!store) {
+        return failures;
+    }
+    BenchSynth synth;
+    BenchSynthInit(&synth, 1, 60000, 8000);
+    RTSPDVRStoreAddInitSegment(store, 1, BenchInitA, sizeof(BenchInitA));
+    BenchSynthFeed(&synth, store, 20.0);
+
+    // Ten 2 s segments, the newest six held
+    RTSPDVRStoreStatistics statistics = RTSPDVRStoreGetStatistics(store);
+    failures += BenchCheck(statistics.segments == 6, "ring holds slotCount segments");
+    failures += BenchCheck(statistics.overwritten == 4, "oldest segments are overwritten");
+    failures += BenchCheck(statistics.oldestTime == BENCH_EPOCH + 8000000, "ring starts at the oldest held segment");
+    failures += BenchCheck(statistics.newestTime == BENCH_EPOCH + 20000000, "ring ends at the newest media");
+    failures += BenchCheck(statistics.droppedMedia == 0 && statistics.writeErrors == 0, "nothing dropped");
+    failures += BenchCheck(BenchFileExists(directory, "segment-00005.m4s") &&
+                           !BenchFileExists(directory, "segment-00006.m4s"), "no slot files beyond slotCount");
+
+    RTSPDVRSegmentInfo segments[8];
+    size_t count = RTSPDVRStoreFindSegments(store, 0, INT64_MAX, segments, 8);
+    bool contents = count == 6;
+    RTSPByteBuffer buffer;
+    RTSPByteBufferInit(&buffer);
+    for (size_t i = 0; contents && i < count; i++) {
+        RTSPByteBufferReset(&buffer);
+        contents = RTSPDVRStoreRead(store, segments[i].sequence, 0, UINT64_MAX, &buffer) &&
+                   buffer.length == segments[i].length && segments[i].mediaOffset == sizeof(BenchInitA);
+        BenchSegment segment = BenchParseSegment(buffer.data, buffer.length);
+        contents = contents && segment.valid && segment.startsWithKeyframe && fabs(segment.duration - 2.0) < 1e-6 &&
+                   segment.fragments == 10 && segments[i].keyframes == 2 && segments[i].sequence == 5 + i &&
+                   segments[i].complete == (i + 1 < count);
+    }
+    failures += BenchCheck(contents, "segments read back as init + fragments from a keyframe");
+    count = RTSPDVRStoreFindSegments(store, BENCH_EPOCH + 11000000, BENCH_EPOCH + 13000000, segments, 8);
+    failures += BenchCheck(count == 2 && segments[0].sequence == 6 && segments[1].sequence == 7,
+                           "range lookup returns the overlapping segments");
+
+    // Seeks land on the last keyframe at or before the time
+    bool seeks = true;
+    for (unsigned i = 0; seeks && i < 200; i++) {
+        int64_t time = statistics.oldestTime + (int64_t)(BenchRandom() % 12000000);
+        RTSPDVRSeekPoint point;
+        RTSPByteBufferReset(&buffer);
+        seeks = RTSPDVRStoreSeek(store, time, &point) && point.time <= time && time - point.time < 1000000 &&
+                (point.time - BENCH_EPOCH) % 1000000 == 0 &&
+                RTSPDVRStoreRead(store, point.sequence, point.offset, 8, &buffer) && buffer.length == 8 &&
+                memcmp(buffer.data + 4, "moof", 4) == 0;
+    }
+    failures += BenchCheck(seeks, "seek finds the keyframe at or before the time");
+    RTSPDVRSeekPoint point;
+    failures += BenchCheck(RTSPDVRStoreSeek(store, 0, &point) && point.sequence == 5 &&
+                           point.time == statistics.oldestTime, "seek before the ring lands on its start");
+    failures += BenchCheck(RTSPDVRStoreSeek(store, INT64_MAX, &point) && point.sequence == 10 &&
+                           point.time == BENCH_EPOCH + 19000000, "seek past the end lands on the last keyframe");
+
+    // The next segment takes segment 5's slot
+    BenchSynthFeed(&synth, store, 2.2);
+    RTSPByteBufferReset(&buffer);
+    RTSPDVRSegmentInfo segment;
+    failures += BenchCheck(!RTSPDVRStoreRead(store, 5, 0, UINT64_MAX, &buffer) && buffer.length == 0 &&
+                           !RTSPDVRStoreGetSegment(store, 5, &segment), "overwritten segment reads fail");
+    failures += BenchCheck(RTSPDVRStoreGetSegment(store, 11, &segment) && segment.complete, "ring wraps in place");
+    RTSPDVRStoreRelease(store);
+
+    // Reopen: same ring, sequence numbers continue after a gap
+    store = RTSPDVRStoreOpen(directory, &config);
+    statistics = RTSPDVRStoreGetStatistics(store);
+    failures += BenchCheck(store && statistics.segments == 6 && statistics.oldestTime == BENCH_EPOCH + 12000000,
+                           "index survives reopening");
+    failures += BenchCheck(RTSPDVRStoreGetSegment(store, 12, &segment) && segment.complete &&
+                           segment.endTime == BENCH_EPOCH + 22200000, "segment open at close is finished on reopen");
+    RTSPDVRStoreAddInitSegment(store, 7, BenchInitA, sizeof(BenchInitA));
+    synth.initID = 7;
+    synth.frame += 3 * BENCH_GOP - synth.frame % BENCH_GOP;
+    BenchSynthFeed(&synth, store, 1.0);
+    failures += BenchCheck(RTSPDVRStoreGetSegment(store, 13, &segment) && segment.discontinuity &&
+                           segment.startTime == BENCH_EPOCH + 25000000, "appending after reopen starts a new segment");
+    RTSPDVRStoreRelease(store);
+
+    config.slotCount = 8;
+    store = RTSPDVRStoreOpen(directory, &config);
+    statistics = RTSPDVRStoreGetStatistics(store);
+    failures += BenchCheck(store && statistics.segments == 0, "index with other geometry is discarded");
+    RTSPDVRStoreRelease(store);
+
+    RTSPByteBufferFree(&buffer);
+    BenchSynthFree(&synth);
+    return failures;
+}
+
+/// Init segment changes, dropped media and the playlist
+static unsigned BenchCheckPlaylist(const char *directory) {
+    unsigned failures = 0;
+    RTSPDVRStoreConfig config = BenchSmallConfig();
+    RTSPDVRStoreRef store = RTSPDVRStoreOpen(directory, &config);
+    if (!store) {
+        return BenchCheck(false, "store opens");
+    }
+    BenchSynth synth;
+    BenchSynthInit(&synth, 1, 60000, 8000);
+    BenchSynthFeed(&synth, store, 0.4);
+    failures += BenchCheck(RTSPDVRStoreGetStatistics(store).droppedMedia == 2, "media before the init segment is dropped");
+    synth.frame = 0;
+
+    RTSPDVRStoreAddInitSegment(store, 1, BenchInitA, sizeof(BenchInitA));
+    BenchSynthFeed(&synth, store, 3.0);
+    RTSPDVRStoreAddInitSegment(store, 2, BenchInitA, sizeof(BenchInitA));
+    synth.initID = 2;
+    BenchSynthFeed(&synth, store, 1.0);
+    RTSPDVRStoreStatistics statistics = RTSPDVRStoreGetStatistics(store);
+    failures += BenchCheck(statistics.segments == 2 && statistics.droppedMedia == 2,
+                           "reconnect with the same init segment continues");
+
+    RTSPDVRStoreAddInitSegment(store, 3, BenchInitB, sizeof(BenchInitB));
+    BenchSynthFeed(&synth, store, 0.2);
+    synth.initID = 3;
+    synth.frame += BENCH_PART_FRAMES;
+    BenchSynthFeed(&synth, store, 1.0);
+    statistics = RTSPDVRStoreGetStatistics(store);
+    failures += BenchCheck(statistics.segments == 3 && statistics.droppedMedia == 6,
+                           "new init segment cuts; stale and mid-GOP media is dropped");
+    RTSPDVRSegmentInfo segment;
+    failures += BenchCheck(RTSPDVRStoreGetSegment(store, 3, &segment) && segment.discontinuity &&
+                           segment.startTime == BENCH_EPOCH + 5000000, "new configuration starts on its keyframe");
+
+    RTSPByteBuffer playlist;
+    RTSPByteBufferInit(&playlist);
+    bool written = RTSPDVRStoreWritePlaylist(store, BENCH_EPOCH + 1500000, INT64_MAX, "dvr/", "?key=k", &playlist);
+    RTSPByteBufferAppendU8(&playlist, 0);
+    const char *text = (const char *)playlist.data;
+    unsigned maps = 0;
+    unsigned media = 0;
+    for (const char *p = text; written && (p = strstr(p, "#EXT-X-MAP:")); p++) {
+        maps++;
+    }
+    for (const char *p = text; written && (p = strstr(p, "\ndvr/segments/")); p++) {
+        media++;
+    }
+    failures += BenchCheck(written && maps == 2 && media == 3 && strstr(text, "#EXT-X-DISCONTINUITY\n") &&
+                           strstr(text, "#EXT-X-MAP:URI=\"dvr/init/3?key=k\"") &&
+                           strstr(text, "#EXT-X-START:TIME-OFFSET=1.500,PRECISE=YES") &&
+                           strstr(text, "#EXT-X-PROGRAM-DATE-TIME:2025-10-09T08:53:20.000Z") &&
+                           strstr(text, "#EXT-X-ENDLIST"), "playlist covers the range");
+    RTSPByteBufferReset(&playlist);
+    failures += BenchCheck(!RTSPDVRStoreWritePlaylist(store, 0, BENCH_EPOCH, NULL, NULL, &playlist),
+                           "no playlist outside the ring");
+    RTSPByteBufferFree(&playlist);
+    RTSPDVRStoreRelease(store);
+    BenchSynthFree(&synth);
+    return failures;
+}
+
+#pragma mark - Seek Latency
+
+static int BenchCompareDouble(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/// Fills a 24 h ring past one wrap, then times seeks against a directory listing
+static unsigned BenchSeekLatency(const char *directory, unsigned seeks) {
+    unsigned failures = 0;
+    RTSPDVRStoreConfig config;
+    RTSPDVRStoreConfigInit(&config);
+    config.slotBytes = 64 << 10;
+    config.reserveSpace = false;
+    RTSPDVRStoreRef store = RTSPDVRStoreOpen(directory, &config);
+    if (!store) {
+        return BenchCheck(false, "24 h store opens");
+    }
+    BenchSynth synth;
+    BenchSynthInit(&synth, 1, 200, 20);
+    RTSPDVRStoreAddInitSegment(store, 1, BenchInitA, sizeof(BenchInitA));
+    double retention = config.slotCount * config.segmentDuration;
+    double fillStart = BenchNow();
+    BenchSynthFeed(&synth, store, retention * 1.05);
+    double fill = BenchNow() - fillStart;
+    RTSPDVRStoreStatistics statistics = RTSPDVRStoreGetStatistics(store);
+    failures += BenchCheck(statistics.segments == config.slotCount, "24 h ring is full");
+
+    double *latencies = malloc(seeks * sizeof(*latencies));
+    bool correct = true;
+    int64_t span = statistics.newestTime - statistics.oldestTime;
+    for (unsigned i = 0; i < seeks; i++) {
+        int64_t time = statistics.oldestTime + (int64_t)(BenchRandom() % (uint64_t)span);
+        RTSPDVRSeekPoint point;
+        double start = BenchNow();
+        bool found = RTSPDVRStoreSeek(store, time, &point);
+        latencies[i] = (BenchNow() - start) * 1e6;
+        correct = correct && found && point.time <= time && time - point.time < 1000000;
+    }
+    failures += BenchCheck(correct, "24 h seeks land on the keyframe before the time");
+    qsort(latencies, seeks, sizeof(*latencies), BenchCompareDouble);
+    double mean = 0;
+    for (unsigned i = 0; i < seeks; i++) {
+        mean += latencies[i] / seeks;
+    }
+
+    // Without the index, finding a time starts by listing the segments
+    double listStart = BenchNow();
+    unsigned files = 0;
+    DIR *dir = opendir(directory);
+    struct dirent *entry;
+    char path[PATH_MAX];
+    while (dir && (entry = readdir(dir))) {
+        struct stat info;
+        snprintf(path, sizeof(path), "%s/%s", directory, entry->d_name);
+        if (entry->d_name[0] != '.' && stat(path, &info) == 0) {
+            files++;
+        }
+    }
+    if (dir) {
+        closedir(dir);
+    }
+    double listing = (BenchNow() - listStart) * 1e6;
+    failures += BenchCheck(files == config.slotCount + 1, "24 h ring uses slotCount files and the index");
+
+    printf("  24 h index        %u × %.0f s segments, filled %.0f s of media in %.2f s (%llu overwritten)\n",
+           config.slotCount, config.segmentDuration, retention * 1.05, fill,
+           (unsigned long long)statistics.overwritten);
+    printf("  seek              mean %.2f µs, p50 %.2f µs, p99 %.2f µs over %u seeks (target mean ≤ %.0f µs)\n",
+           mean, latencies[seeks / 2], latencies[seeks * 99 / 100], seeks, BENCH_TARGET_SEEK_US);
+    printf("  directory listing %.0f µs for %u files (%.0f× one seek)\n", listing, files, listing / mean);
+    failures += BenchCheck(mean <= BENCH_TARGET_SEEK_US, "seek latency");
+    free(latencies);
+    RTSPDVRStoreRelease(store);
+    BenchSynthFree(&synth);
+    return failures;
+}
+
+#pragma mark - Recording Throughput
+
+/// Records `cameras` streams for `seconds` of media each, interleaved per
+/// part as the engine delivers them
+static unsigned BenchRecord(const char *root, unsigned cameras, double seconds, unsigned bitrateKbps) {
+    unsigned failures = 0;
+    RTSPDVRStoreConfig config;
+    RTSPDVRStoreConfigInit(&config);
+    config.slotCount = 4;               // Wraps in runs over 40 s; preallocation included
+    RTSPDVRStoreRef *stores = calloc(cameras, sizeof(*stores));
+    BenchSynth *synths = calloc(cameras, sizeof(*synths));
+    char path[PATH_MAX];
+    // A keyframe the size of four other frames at the requested bitrate
+    uint32_t frameBytes = (uint32_t)((uint64_t)bitrateKbps * 125 * BENCH_GOP / BENCH_FPS / (BENCH_GOP + 3));
+    for (unsigned c = 0; c < cameras; c++) {
+        snprintf(path, sizeof(path), "%s/camera-%02u", root, c);
+        stores[c] = RTSPDVRStoreOpen(path, &config);
+        if (!stores[c]) {
+            fprintf(stderr, "open %s: %s\n", path, strerror(errno));
+            return failures + 1;
+        }
+        BenchSynthInit(&synths[c], 1, frameBytes * 4, frameBytes);
+        RTSPDVRStoreAddInitSegment(stores[c], 1, BenchInitA, sizeof(BenchInitA));
+    }
+
+    uint64_t parts = (uint64_t)llround(seconds * BENCH_FPS / BENCH_PART_FRAMES);
+    double wallStart = BenchNow();
+    double cpuStart = BenchCPUSeconds();
+    for (uint64_t p = 0; p < parts; p++) {
+        for (unsigned c = 0; c < cameras; c++) {
+            BenchSynthPart(&synths[c], stores[c]);
+        }
+    }
+    for (unsigned c = 0; c < cameras; c++) {
+        RTSPDVRStoreCut(stores[c]);
+    }
+    double cpu = BenchCPUSeconds() - cpuStart;
+    double wall = BenchNow() - wallStart;
+
+    uint64_t written = 0;
+    bool bounded = true;
+    for (unsigned c = 0; c < cameras; c++) {
+        RTSPDVRStoreStatistics statistics = RTSPDVRStoreGetStatistics(stores[c]);
+        written += statistics.bytesWritten;
+        // Short runs may not fill the ring; none may grow past it
+        bounded = bounded && statistics.segments <= config.slotCount && statistics.writeErrors == 0;
+        RTSPDVRStoreRelease(stores[c]);
+        BenchSynthFree(&synths[c]);
+        snprintf(path, sizeof(path), "%s/camera-%02u", root, c);
+        bounded = bounded && !BenchHasSlotBeyond(path, config.slotCount);
+        BenchRemoveDirectory(path);
+    }
+    failures += BenchCheck(bounded, "recording stays within the ring");
+
+    double percent = cpu / (cameras * seconds) * 100.0;
+    printf("  recording         %u cameras × %.0f s at %u kbps: %.1f MB in %.2f s (%.0f MB/s)\n",
+           cameras, seconds, bitrateKbps, written / 1e6, wall, written / 1e6 / wall);
+    printf("  append CPU        %.3f%% of a core per camera in real time (target ≤ %.1f%%)\n",
+           percent, BENCH_TARGET_APPEND_CPU);
+    failures += BenchCheck(percent <= BENCH_TARGET_APPEND_CPU, "append CPU per camera");
+    free(stores);
+    free(synths);
+    return failures;
+}
+
+int main(int argc, char **argv) {
+    unsigned cameras = 16;
+    double seconds = 60.0;
+    unsigned bitrateKbps = 4000;
+    unsigned seeks = 100000;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--cameras") == 0 && i + 1 < argc) {
+            cameras = (unsigned)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            seconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--bitrate") == 0 && i + 1 < argc) {
+            bitrateKbps = (unsigned)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seeks") == 0 && i + 1 < argc) {
+            seeks = (unsigned)atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--cameras N] [--seconds S] [--bitrate KBPS] [--seeks N]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (cameras == 0) {
+        cameras = 1;
+    }
+    if (seconds < 10.0) {
+        seconds = 10.0;
+    }
+    if (seeks < 100) {
+        seeks = 100;
+    }
+
+    char root[] = "/tmp/dvr_store_bench.XXXXXX";
+    if (!mkdtemp(root)) {
+        fprintf(stderr, "mkdtemp failed\n");
+        return 1;
+    }
+    char directory[PATH_MAX];
+    printf("dvr_store_bench: %u cameras, %u kbps, %.0f s recorded per camera\n", cameras, bitrateKbps, seconds);
+
+    snprintf(directory, sizeof(directory), "%s/ring", root);
+    unsigned failures = BenchCheckRing(directory);
+    BenchRemoveDirectory(directory);
+    snprintf(directory, sizeof(directory), "%s/playlist", root);
+    failures += BenchCheckPlaylist(directory);
+    BenchRemoveDirectory(directory);
+    snprintf(directory, sizeof(directory), "%s/day", root);
+    failures += BenchSeekLatency(directory, seeks);
+    BenchRemoveDirectory(directory);
+    failures += BenchRecord(root, cameras, seconds, bitrateKbps);
+    rmdir(root);
+
+    if (failures) {
+        printf("FAILED (%u)\n", failures);
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,456 @@
+//
+//  event_export_bench.c
+//  RTSP Rotator Benchmarks
+//
+//  Streaming export benchmark for RTSPEventExporter: N synthetic events
+//  (default 1M) exported as CSV, NDJSON and the text report, unfiltered and
+//  through a timeline query. Reports events/s, MB/s and the memory the
+//  export held: the exporter's chunk buffer peak, and on Linux the growth
+//  of anonymous resident memory, against the document size a
+//  whole-string export would have held.
+//
+//  Checks: the cached timestamp formatter against localtime_r/strftime
+//  across DST transitions and before 1970; every CSV record parses (quotes,
+//  newlines and commas inside fields) and every NDJSON line is a JSON
+//  object whose strings round-trip; the chunk buffer peak is the same for
+//  10k and 1M events.
+//
+//  Build (Linux / macOS):
+//    cc -O2 -std=gnu11 -I"../RTSP Rotator" event_export_bench.c "../RTSP Rotator/RTSPEventExporter.c" "../RTSP Rotator/RTSPEventStoreQuery.c" "../RTSP Rotator/RTSPEventStore.c" "../RTSP Rotator/RTSPEventTextIndex.c" "../RTSP Rotator/RTSPByteBuffer.c" -o event_export_bench
+//
+//  Usage: event_export_bench [--events N] [--dir PATH]
+//
+
+#define _GNU_SOURCE
+
+#include "RTSPEventExporter.h"
+
+#include <fcntl.h>
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// Exporting must not grow the process by more than a few chunks
+#define BENCH_TARGET_MEMORY_GROWTH_MB 8.0
+
+#define BENCH_FEEDS 16
+#define BENCH_BASE_TIMESTAMP 1709800000000000LL     // March 2024, across the US DST change
+#define BENCH_STEP_US 1000000LL
+
+static double BenchNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static unsigned BenchCheck(bool condition, const char *what) {
+    if (!condition) {
+        fprintf(stderr, "  check failed: %s\n", what);
+    }
+    return condition ? 0 : 1;
+}
+
+static int BenchRemoveEntry(const char *path, const struct stat *info, int flag, struct FTW *ftw) {
+    (void)info;
+    (void)flag;
+    (void)ftw;
+    return remove(path);
+}
+
+/// Anonymous resident memory in MB (resident minus file-backed), Linux only
+static double BenchAnonymousMB(void) {
+#ifdef __linux__
+    FILE *file = fopen("/proc/self/statm", "r");
+    unsigned long size = 0, resident = 0, shared = 0;
+    if (file) {
+        if (fscanf(file, "%lu %lu %lu", &size, &resident, &shared) != 3) {
+            resident = shared = 0;
+        }
+        fclose(file);
+    }
+    return (double)(resident - shared) * (double)sysconf(_SC_PAGESIZE) / 1e6;
+#else
+    return 0;
+#endif
+}
+
+#pragma mark - Fixtures
+
+static char BenchFeeds[BENCH_FEEDS][64];
+
+static const char *const BenchTypeNames[] = {
+    "Feed Switch", "Snapshot", "Recording Started", "Recording Stopped", "Motion Detected", "Audio Alert",
+    "Connection Failed", "Failover", "Bookmark Activated", "Schedule Activated", "Error", "Warning", "Info"
+};
+
+// Every 1000th event carries text that needs escaping in both formats
+static const char BenchTrickyTitle[] = "Door \"Front\", left\nopen\tat 5\\6 \x01 caf\xC3\xA9";
+
+static void BenchMakeEvent(uint64_t i, RTSPEventStoreEvent *event, char *title, char *details) {
+    memset(event, 0, sizeof(*event));
+    event->timestamp = BENCH_BASE_TIMESTAMP + (int64_t)i * BENCH_STEP_US;
+    event->type = (uint16_t)(i % 13);
+    memcpy(event->uuid, &i, sizeof(i));
+    event->feed = i % 5 ? BenchFeeds[i % BENCH_FEEDS] : NULL;
+    event->title = title;
+    if (i % 1000 == 0) {
+        memcpy(title, BenchTrickyTitle, sizeof(BenchTrickyTitle));
+        event->titleLength = sizeof(BenchTrickyTitle) - 1;
+    } else {
+        event->titleLength = (size_t)snprintf(title, 64, "Motion detected on camera %llu", (unsigned long long)(i % BENCH_FEEDS));
+    }
+    if (i % 3) {
+        event->details = details;
+        event->detailsLength = (size_t)snprintf(details, 128, "person at 0.%02llu, zone %llu", (unsigned long long)(i % 100),
+                                                (unsigned long long)(i % 9));
+    }
+    if (i % 7 == 0) {
+        static const char metadata[] = "{\"objects\":[\"person\"],\"score\":0.91}";
+        event->metadata = (const uint8_t *)metadata;
+        event->metadataLength = sizeof(metadata) - 1;
+    }
+}
+
+#pragma mark - Format checks
+
+static unsigned BenchFormatterChecks(void) {
+    unsigned failures = 0;
+    setenv("TZ", "America/New_York", 1);
+    tzset();
+
+    RTSPEventTimestampFormatter local, utc;
+    RTSPEventTimestampFormatterInit(&local, true);
+    RTSPEventTimestampFormatterInit(&utc, false);
+    bool localOK = true, utcOK = true;
+    // Every 7 minutes 13 seconds across 2024 (both DST changes), then before 1970
+    int64_t starts[] = {1704067200LL, -86400LL * 400};
+    for (size_t s = 0; s < 2; s++) {
+        for (int64_t seconds = starts[s]; seconds < starts[s] + 366 * 86400LL; seconds += 433) {
+            int64_t timestamp = seconds * 1000000 + 123456;
+            char expected[64], actual[32];
+            time_t clock = (time_t)seconds;
+            struct tm parts;
+            strftime(expected, sizeof(expected), "%Y-%m-%d %H:%M:%S", localtime_r(&clock, &parts));
+            RTSPEventTimestampFormatterFormat(&local, timestamp, actual);
+            localOK &= strcmp(expected, actual) == 0;
+            strftime(expected, sizeof(expected), "%Y-%m-%dT%H:%M:%S.123Z", gmtime_r(&clock, &parts));
+            RTSPEventTimestampFormatterFormatISO8601(&utc, timestamp, actual);
+            utcOK &= strcmp(expected, actual) == 0;
+        }
+    }
+    failures += BenchCheck(localOK, "local timestamps match localtime_r across DST and before 1970");
+    failures += BenchCheck(utcOK, "UTC timestamps match gmtime_r");
+    char actual[32];
+    RTSPEventTimestampFormatterFormatISO8601(&utc, -1, actual);
+    failures += BenchCheck(strcmp(actual, "1969-12-31T23:59:59.999Z") == 0, "negative microseconds round down");
+    return failures;
+}
+
+/// Parse CSV records (quoted fields may hold commas, quotes and newlines)
+static bool BenchParseCSV(const char *data, size_t length, uint64_t *records, char *firstTrickyTitle, size_t titleCapacity) {
+    *records = 0;
+    size_t i = 0;
+    bool header = true;
+    firstTrickyTitle[0] = '\0';
+    while (i < length) {
+        unsigned field = 0;
+        while (true) {
+            char value[256];
+            size_t valueLength = 0;
+            if (data[i] == '"') {
+                i++;
+                while (i < length) {
+                    if (data[i] == '"') {
+                        if (i + 1 < length && data[i + 1] == '"') {
+                            if (valueLength < sizeof(value) - 1) value[valueLength++] = '"';
+                            i += 2;
+                            continue;
+                        }
+                        i++;
+                        break;
+                    }
+                    if (valueLength < sizeof(value) - 1) value[valueLength++] = data[i];
+                    i++;
+                }
+            } else {
+                while (i < length && data[i] != ',' && data[i] != '\n') {
+                    i++;
+                }
+            }
+            value[valueLength] = '\0';
+            if (field == 2 && !header && !firstTrickyTitle[0] && strchr(value, '\n')) {
+                snprintf(firstTrickyTitle, titleCapacity, "%s", value);
+            }
+            field++;
+            if (i < length && data[i] == ',') {
+                i++;
+                continue;
+            }
+            if (i < length && data[i] != '\n') {
+                return false;
+            }
+            i++;
+            break;
+        }
+        if (field != 5) {
+            return false;
+        }
+        *records += header ? 0 : 1;
+        header = false;
+    }
+    return true;
+}
+
+/// Each line one JSON object: strings well-formed, no raw control bytes
+static bool BenchCheckNDJSON(const char *data, size_t length, uint64_t *lines, bool *trickyRoundTrip) {
+    *lines = 0;
+    *trickyRoundTrip = false;
+    size_t i = 0;
+    while (i < length) {
+        if (data[i] != '{') {
+            return false;
+        }
+        int depth = 0;
+        for (; i < length && data[i] != '\n'; i++) {
+            char c = data[i];
+            if ((unsigned char)c < 0x20) {
+                return false;
+            }
+            if (c == '{' || c == '[') {
+                depth++;
+            } else if (c == '}' || c == ']') {
+                depth--;
+            } else if (c == '"') {
+                char decoded[256];
+                size_t decodedLength = 0;
+                for (i++; i < length && data[i] != '"'; i++) {
+                    if ((unsigned char)data[i] < 0x20) {
+                        return false;
+                    }
+                    char out = data[i];
+                    if (data[i] == '\\') {
+                        char e = data[++i];
+                        if (e == 'u') {
+                            out = (char)strtol((char[]){data[i + 3], data[i + 4], 0}, NULL, 16);
+                            i += 4;
+                        } else {
+                            out = e == 'n' ? '\n' : e == 't' ? '\t' : e == 'r' ? '\r' : e;
+                        }
+                    }
+                    if (decodedLength < sizeof(decoded) - 1) decoded[decodedLength++] = out;
+                }
+                decoded[decodedLength] = '\0';
+                if (strcmp(decoded, BenchTrickyTitle) == 0) {
+                    *trickyRoundTrip = true;
+                }
+            }
+        }
+        if (depth != 0 || i >= length) {
+            return false;
+        }
+        (*lines)++;
+        i++;
+    }
+    return true;
+}
+
+#pragma mark - Benchmark
+
+typedef struct {
+    uint64_t events;
+    uint64_t bytes;
+    double seconds;
+    size_t peakBuffer;
+    double growthMB;
+} BenchExport;
+
+static BenchExport BenchRunExport(RTSPEventStoreRef store, const RTSPEventStoreQuery *query, RTSPEventExportFormat format,
+                                  const char *path, uint64_t sliceEvents) {
+    BenchExport result = {0};
+    RTSPEventExportConfig config;
+    RTSPEventExportConfigInit(&config);
+    config.format = format;
+    config.typeNames = BenchTypeNames;
+    config.typeNameCount = sizeof(BenchTypeNames) / sizeof(BenchTypeNames[0]);
+
+    double baseline = BenchAnonymousMB();
+    double peak = baseline;
+    double start = BenchNow();
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    RTSPEventStoreCursorRef cursor = RTSPEventStoreCursorCreate(store, query);
+    RTSPEventExporterRef exporter = RTSPEventExporterCreate(fd, &config);
+    if (format == RTSPEventExportFormatText) {
+        RTSPEventExporterWriteText(exporter, "RTSP Rotator Event Timeline\n\n", 29);
+    }
+    // Slices, as the logger exports between other work on the store queue
+    while (!RTSPEventStoreCursorExhausted(cursor)) {
+        if (RTSPEventExporterWrite(exporter, store, cursor, sliceEvents) < 0) {
+            break;
+        }
+        double now = BenchAnonymousMB();
+        peak = now > peak ? now : peak;
+    }
+    RTSPEventExporterFlush(exporter);
+    close(fd);
+    result.seconds = BenchNow() - start;
+    RTSPEventExporterStatistics statistics = RTSPEventExporterGetStatistics(exporter);
+    result.events = statistics.events;
+    result.bytes = statistics.bytes;
+    result.peakBuffer = statistics.peakBuffer;
+    result.growthMB = peak - baseline;
+    RTSPEventExporterRelease(exporter);
+    RTSPEventStoreCursorRelease(cursor);
+    return result;
+}
+
+static char *BenchReadFile(const char *path, size_t *length) {
+    int fd = open(path, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0 || info.st_size == 0) {
+        if (fd >= 0) close(fd);
+        return NULL;
+    }
+    char *data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    *length = (size_t)info.st_size;
+    return data == MAP_FAILED ? NULL : data;
+}
+
+int main(int argc, char **argv) {
+    uint64_t events = 1000000;
+    const char *parent = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--events") == 0 && i + 1 < argc) {
+            events = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--dir") == 0 && i + 1 < argc) {
+            parent = argv[++i];
+        } else {
+            fprintf(stderr, "usage: %s [--events N] [--dir PATH]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (events < 20000) {
+        events = 20000;
+    }
+    for (int i = 0; i < BENCH_FEEDS; i++) {
+        snprintf(BenchFeeds[i], sizeof(BenchFeeds[i]), "rtsp://192.168.1.%d:554/stream1", 10 + i);
+    }
+    char root[1024];
+    snprintf(root, sizeof(root), "%s/event_export_bench.XXXXXX", parent ? parent : "/tmp");
+    if (!mkdtemp(root)) {
+        perror("mkdtemp");
+        return 2;
+    }
+
+    printf("event_export_bench: %llu events\n", (unsigned long long)events);
+    unsigned failures = BenchFormatterChecks();
+    printf("  formatter checks: %s\n", failures ? "FAILED" : "ok");
+
+    char path[1100];
+    snprintf(path, sizeof(path), "%s/events", root);
+    RTSPEventStoreConfig storeConfig;
+    RTSPEventStoreConfigInit(&storeConfig);
+    storeConfig.maxEvents = 0;
+    storeConfig.syncOnCommit = false;
+    RTSPEventStoreRef store = RTSPEventStoreOpen(path, &storeConfig);
+    if (!store) {
+        perror("open");
+        return 2;
+    }
+    char title[64], details[128];
+    for (uint64_t i = 0; i < events; i++) {
+        RTSPEventStoreEvent event;
+        BenchMakeEvent(i, &event, title, details);
+        RTSPEventStoreAppend(store, &event);
+        if (RTSPEventStorePendingCount(store) >= 256) {
+            RTSPEventStoreCommit(store);
+        }
+    }
+    RTSPEventStoreCommit(store);
+
+    RTSPEventStoreQuery all;
+    RTSPEventStoreQueryInit(&all);
+    static const struct {
+        const char *name;
+        RTSPEventExportFormat format;
+        const char *file;
+    } formats[] = {
+        {"CSV", RTSPEventExportFormatCSV, "events.csv"},
+        {"NDJSON", RTSPEventExportFormatNDJSON, "events.ndjson"},
+        {"text report", RTSPEventExportFormatText, "events.txt"},
+    };
+    bool memoryMet = true;
+    for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+        char output[1200];
+        snprintf(output, sizeof(output), "%s/%s", root, formats[f].file);
+        BenchExport small = BenchRunExport(store, &(RTSPEventStoreQuery){.hasTimeRange = true, .from = BENCH_BASE_TIMESTAMP,
+                                                                         .to = BENCH_BASE_TIMESTAMP + 9999 * BENCH_STEP_US},
+                                           formats[f].format, output, 4096);
+        BenchExport large = BenchRunExport(store, &all, formats[f].format, output, 4096);
+        failures += BenchCheck(small.events == 10000 && large.events == events, "every event exported");
+        failures += BenchCheck(large.peakBuffer <= 64 * 1024 + 1024 && large.peakBuffer <= small.peakBuffer + 1024,
+                               "chunk buffer flat in event count");
+        memoryMet &= large.growthMB <= BENCH_TARGET_MEMORY_GROWTH_MB;
+        printf("  %-12s %8.0f events/s  %6.1f MB/s  %7.1f MB written  buffer peak %5.1f KB  RSS growth %4.1f MB"
+               " (UTF-16 string export: %.0f MB)\n",
+               formats[f].name, (double)large.events / large.seconds, (double)large.bytes / 1e6 / large.seconds,
+               (double)large.bytes / 1e6, (double)large.peakBuffer / 1024.0, large.growthMB, (double)large.bytes * 2 / 1e6);
+
+        size_t length = 0;
+        char *data = BenchReadFile(output, &length);
+        if (formats[f].format == RTSPEventExportFormatCSV) {
+            uint64_t records = 0;
+            char tricky[256];
+            failures += BenchCheck(data && BenchParseCSV(data, length, &records, tricky, sizeof(tricky)) && records == events,
+                                   "CSV parses into one record per event");
+            failures += BenchCheck(strcmp(tricky, BenchTrickyTitle) == 0, "CSV escaping round-trips");
+            static const char firstLines[] = "Timestamp,Type,Title,Details,Feed URL\n\"2024-03-07 03:26:40\",\"Feed Switch\",";
+            failures += BenchCheck(data && length > sizeof(firstLines) && memcmp(data, firstLines, sizeof(firstLines) - 1) == 0,
+                                   "CSV header and first record");
+        } else if (formats[f].format == RTSPEventExportFormatNDJSON) {
+            uint64_t lines = 0;
+            bool roundTrip = false;
+            failures += BenchCheck(data && BenchCheckNDJSON(data, length, &lines, &roundTrip) && lines == events,
+                                   "NDJSON has one object per event");
+            failures += BenchCheck(roundTrip, "NDJSON escaping round-trips");
+            failures += BenchCheck(data && strstr(data, "\"timestamp\":\"2024-03-07T08:26:40.000Z\"") &&
+                                   strstr(data, "\"metadata\":{\"objects\":[\"person\"],\"score\":0.91}"),
+                                   "NDJSON timestamp and metadata");
+        } else {
+            failures += BenchCheck(data && strstr(data, "[2024-03-07 03:26:40] Feed Switch\nTitle: Door \"Front\""),
+                                   "text report layout");
+        }
+        if (data) {
+            munmap(data, length);
+        }
+        unlink(output);
+    }
+
+    // Filtered export through the timeline's query
+    char output[1200];
+    snprintf(output, sizeof(output), "%s/motion.csv", root);
+    RTSPEventStoreQuery motion = {.types = 1ull << 4, .feed = BenchFeeds[4]};
+    BenchExport filtered = BenchRunExport(store, &motion, RTSPEventExportFormatCSV, output, 0);
+    uint64_t expected = 0;
+    for (uint64_t i = 0; i < events; i++) {
+        expected += i % 13 == 4 && i % 5 != 0 && i % BENCH_FEEDS == 4;
+    }
+    failures += BenchCheck(filtered.events == expected, "filtered export matches the query");
+    printf("  filtered CSV (type AND feed): %llu events in %.1f ms\n", (unsigned long long)filtered.events,
+           filtered.seconds * 1000.0);
+
+    RTSPEventStoreClose(store);
+    nftw(root, BenchRemoveEntry, 16, FTW_DEPTH | FTW_PHYS);
+    printf("  target: export grows anonymous memory by <= %.0f MB\n", BENCH_TARGET_MEMORY_GROWTH_MB);
+    if (failures > 0 || !memoryMet) {
+        fprintf(stderr, "FAIL: %u check(s)%s\n", failures, memoryMet ? "" : ", memory target missed");
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,372 @@
+//
+//  event_query_bench.c
+//  RTSP Rotator Benchmarks
+//
+//  Query benchmark for RTSPEventStoreQuery over a store of N synthetic
+//  events (default 1M): type, feed, time-range and text queries alone and
+//  composed, each timed for the first page (what the timeline shows) and
+//  for draining every match, against a full scan that tests every event
+//  with the same predicate (what RTSPEventLogger's NSPredicate filters did).
+//  Every query's results are checked against that scan, in both
+//  directions. The trigram index build (done on the first text query) is
+//  timed separately. A cursor is checked to stay consistent while the
+//  store is appended to and trimmed under it, and the trigram index to
+//  compact as retention drops segments.
+//
+//  Build (Linux / macOS):
+//    cc -O2 -std=gnu11 -I"../RTSP Rotator" event_query_bench.c "../RTSP Rotator/RTSPEventStoreQuery.c" "../RTSP Rotator/RTSPEventStore.c" "../RTSP Rotator/RTSPEventTextIndex.c" "../RTSP Rotator/RTSPByteBuffer.c" -o event_query_bench
+//
+//  Usage: event_query_bench [--events N] [--dir PATH]
+//
+
+#define _GNU_SOURCE
+
+#include "RTSPEventStoreQuery.h"
+
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// A first page of any indexed query must be interactive
+#define BENCH_TARGET_FIRST_PAGE_MS 10.0
+
+#define BENCH_PAGE 100
+#define BENCH_FEEDS 64
+#define BENCH_TYPES 13
+#define BENCH_BASE_TIMESTAMP 1760000000000000LL
+#define BENCH_STEP_US 2500000LL     // One event every 2.5 s: 1M events span a month
+
+static double BenchNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static unsigned BenchCheck(bool condition, const char *what) {
+    if (!condition) {
+        fprintf(stderr, "  check failed: %s\n", what);
+    }
+    return condition ? 0 : 1;
+}
+
+static int BenchRemoveEntry(const char *path, const struct stat *info, int flag, struct FTW *ftw) {
+    (void)info;
+    (void)flag;
+    (void)ftw;
+    return remove(path);
+}
+
+#pragma mark - Fixtures
+
+static char BenchFeeds[BENCH_FEEDS][64];
+
+static const char *BenchCameras[] = {"Front Door", "Driveway", "Backyard", "Garage", "Side Gate", "Porch", "Lobby"};
+static const char *BenchObjects[] = {"person", "vehicle", "package", "animal", "bicycle"};
+
+static uint64_t BenchHash(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDull;
+    x ^= x >> 33;
+    return x;
+}
+
+/// Event i: skewed types (motion dominates, like a real log), 64 feeds,
+/// details naming a camera, an object and a zone
+static void BenchMakeEvent(uint64_t i, RTSPEventStoreEvent *event, char *title, char *details) {
+    uint64_t h = BenchHash(i + 1);
+    memset(event, 0, sizeof(*event));
+    event->timestamp = BENCH_BASE_TIMESTAMP + (int64_t)i * BENCH_STEP_US;
+    event->type = (uint16_t)(h % 4 == 0 ? h / 4 % BENCH_TYPES : 4);
+    memcpy(event->uuid, &h, sizeof(h));
+    event->feed = BenchFeeds[h / 64 % BENCH_FEEDS];
+    event->title = title;
+    event->titleLength = (size_t)snprintf(title, 64, "%s #%llu", event->type == 4 ? "Motion detected" : "Camera event",
+                                          (unsigned long long)i);
+    event->details = details;
+    event->detailsLength = (size_t)snprintf(details, 128, "%s: %s at 0.%02llu in zone %llu",
+                                            BenchCameras[h / 4096 % 7], BenchObjects[h / 65536 % 5],
+                                            (unsigned long long)(h / 1048576 % 100), (unsigned long long)(h / 16777216 % 9));
+}
+
+typedef struct {
+    const char *name;
+    RTSPEventStoreQuery query;
+} BenchQuery;
+
+/// Every match by testing each event, oldest first
+static uint64_t *BenchScan(RTSPEventStoreRef store, const RTSPEventStoreQuery *query, size_t *count) {
+    RTSPEventStoreStatistics statistics = RTSPEventStoreGetStatistics(store);
+    uint32_t feed = query->feed ? RTSPEventStoreFeedID(store, query->feed) : 0;
+    uint64_t *matches = malloc((size_t)(statistics.events + 1) * sizeof(*matches));
+    *count = 0;
+    for (uint64_t sequence = statistics.firstSequence; sequence && sequence < statistics.nextSequence; sequence++) {
+        RTSPEventStoreEntry entry;
+        if (RTSPEventStoreGet(store, sequence, &entry) && (!query->feed || feed) && RTSPEventStoreQueryMatches(query, feed, &entry)) {
+            matches[(*count)++] = sequence;
+        }
+    }
+    return matches;
+}
+
+/// Drain a cursor in pages
+static uint64_t *BenchDrain(RTSPEventStoreRef store, const RTSPEventStoreQuery *query, size_t *count, double *firstPageMs,
+                            RTSPEventStoreCursorStatistics *statistics) {
+    double start = BenchNow();
+    RTSPEventStoreCursorRef cursor = RTSPEventStoreCursorCreate(store, query);
+    size_t capacity = 1024;
+    uint64_t *results = malloc(capacity * sizeof(*results));
+    *count = 0;
+    bool first = true;
+    while (cursor && !RTSPEventStoreCursorExhausted(cursor)) {
+        if (*count + BENCH_PAGE > capacity) {
+            capacity *= 2;
+            results = realloc(results, capacity * sizeof(*results));
+        }
+        *count += RTSPEventStoreCursorNext(cursor, store, results + *count, BENCH_PAGE);
+        if (first) {
+            *firstPageMs = (BenchNow() - start) * 1000.0;
+            first = false;
+        }
+    }
+    if (first) {
+        *firstPageMs = (BenchNow() - start) * 1000.0;
+    }
+    *statistics = RTSPEventStoreCursorGetStatistics(cursor);
+    RTSPEventStoreCursorRelease(cursor);
+    return results;
+}
+
+static const char *BenchPlanName(RTSPEventStoreQueryPlan plan) {
+    switch (plan) {
+        case RTSPEventStoreQueryPlanEmpty: return "empty";
+        case RTSPEventStoreQueryPlanScan: return "scan";
+        case RTSPEventStoreQueryPlanType: return "type";
+        case RTSPEventStoreQueryPlanTypes: return "types";
+        case RTSPEventStoreQueryPlanFeed: return "feed";
+        case RTSPEventStoreQueryPlanTime: return "time";
+        case RTSPEventStoreQueryPlanText: return "text";
+    }
+    return "?";
+}
+
+/// Run one query both ways and compare with the scan
+static unsigned BenchRunQuery(RTSPEventStoreRef store, const BenchQuery *bench, double *worstFirstPage) {
+    unsigned failures = 0;
+    RTSPEventStoreQuery query = bench->query;
+
+    double start = BenchNow();
+    size_t expectedCount = 0;
+    uint64_t *expected = BenchScan(store, &query, &expectedCount);
+    double scanMs = (BenchNow() - start) * 1000.0;
+
+    size_t count = 0;
+    double firstPageMs = 0;
+    RTSPEventStoreCursorStatistics statistics;
+    start = BenchNow();
+    uint64_t *results = BenchDrain(store, &query, &count, &firstPageMs, &statistics);
+    double drainMs = (BenchNow() - start) * 1000.0;
+    failures += BenchCheck(count == expectedCount && memcmp(results, expected, count * sizeof(*results)) == 0, bench->name);
+    free(results);
+
+    query.newestFirst = true;
+    double newestFirstPageMs = 0;
+    RTSPEventStoreCursorStatistics newestStatistics;
+    results = BenchDrain(store, &query, &count, &newestFirstPageMs, &newestStatistics);
+    bool reversed = count == expectedCount;
+    for (size_t i = 0; i < count && reversed; i++) {
+        reversed = results[i] == expected[expectedCount - 1 - i];
+    }
+    failures += BenchCheck(reversed, "newest-first order");
+    free(results);
+    free(expected);
+
+    double worst = firstPageMs > newestFirstPageMs ? firstPageMs : newestFirstPageMs;
+    if (statistics.plan != RTSPEventStoreQueryPlanScan && worst > *worstFirstPage) {
+        *worstFirstPage = worst;
+    }
+    printf("  %-34s %7zu matches  plan %-5s %8llu candidates  first page %7.3f ms  all %8.2f ms  scan %7.1f ms\n",
+           bench->name, expectedCount, BenchPlanName(statistics.plan), (unsigned long long)statistics.candidates, worst, drainMs,
+           scanMs);
+    return failures;
+}
+
+#pragma mark - Cursor stability
+
+static unsigned BenchCursorChecks(RTSPEventStoreRef store, uint64_t events) {
+    unsigned failures = 0;
+    RTSPEventStoreQuery query;
+    RTSPEventStoreQueryInit(&query);
+    query.types = 1ull << 4;
+    query.newestFirst = true;
+
+    RTSPEventStoreCursorRef cursor = RTSPEventStoreCursorCreate(store, &query);
+    uint64_t page[BENCH_PAGE];
+    size_t count = RTSPEventStoreCursorNext(cursor, store, page, BENCH_PAGE);
+    uint64_t lastOfFirstPage = count ? page[count - 1] : 0;
+
+    // New events are not returned by a cursor created before them
+    char title[64], details[128];
+    for (uint64_t i = events; i < events + 1000; i++) {
+        RTSPEventStoreEvent event;
+        BenchMakeEvent(i, &event, title, details);
+        RTSPEventStoreAppend(store, &event);
+    }
+    RTSPEventStoreCommit(store);
+    count = RTSPEventStoreCursorNext(cursor, store, page, BENCH_PAGE);
+    failures += BenchCheck(count == BENCH_PAGE && page[0] < lastOfFirstPage, "cursor continues past appends");
+
+    // Trimming under a cursor: the rest of the pages skip removed events
+    RTSPEventStoreTrimBefore(store, BENCH_BASE_TIMESTAMP + (int64_t)(events / 2) * BENCH_STEP_US);
+    uint64_t remaining = 0;
+    bool inRange = true;
+    while (!RTSPEventStoreCursorExhausted(cursor)) {
+        count = RTSPEventStoreCursorNext(cursor, store, page, BENCH_PAGE);
+        for (size_t i = 0; i < count; i++) {
+            inRange &= page[i] > events / 2;
+        }
+        remaining += count;
+    }
+    failures += BenchCheck(inRange && remaining > 0, "cursor skips trimmed events");
+    RTSPEventStoreCursorRelease(cursor);
+    return failures;
+}
+
+/// Retention drops segments under a built trigram index, which compacts
+static unsigned BenchRetentionChecks(const char *root) {
+    char directory[1100];
+    snprintf(directory, sizeof(directory), "%s/retention", root);
+    RTSPEventStoreConfig config;
+    RTSPEventStoreConfigInit(&config);
+    config.recordsPerSegment = 1000;
+    config.maxEvents = 2000;
+    config.syncOnCommit = false;
+    RTSPEventStoreRef store = RTSPEventStoreOpen(directory, &config);
+    if (!store) {
+        return BenchCheck(false, "retention store opens");
+    }
+    RTSPEventTextIndexRef text = RTSPEventStoreTextIndex(store);
+    char title[64], details[128];
+    for (uint64_t i = 0; i < 20000; i++) {
+        RTSPEventStoreEvent event;
+        BenchMakeEvent(i, &event, title, details);
+        RTSPEventStoreAppend(store, &event);
+        if (RTSPEventStorePendingCount(store) >= 256) {
+            RTSPEventStoreCommit(store);
+        }
+    }
+    RTSPEventStoreCommit(store);
+
+    RTSPEventStoreQuery query = {.text = "package", .textLength = 7};
+    size_t expectedCount = 0, count = 0;
+    uint64_t *expected = BenchScan(store, &query, &expectedCount);
+    uint64_t *candidates = NULL;
+    RTSPEventTextIndexCandidates(text, "package", 7, 0, &candidates, &count);
+    unsigned failures = BenchCheck(RTSPEventTextIndexGetStatistics(text).compactions > 0, "trigram index compacts after retention");
+    failures += BenchCheck(count >= expectedCount && count <= expectedCount + expectedCount / 2 && candidates &&
+                           candidates[0] >= RTSPEventStoreGetStatistics(store).firstSequence,
+                           "compacted candidates cover retained events only");
+    free(candidates);
+    free(expected);
+    RTSPEventStoreClose(store);
+    return failures;
+}
+
+#pragma mark - Benchmark
+
+int main(int argc, char **argv) {
+    uint64_t events = 1000000;
+    const char *parent = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--events") == 0 && i + 1 < argc) {
+            events = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--dir") == 0 && i + 1 < argc) {
+            parent = argv[++i];
+        } else {
+            fprintf(stderr, "usage: %s [--events N] [--dir PATH]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (events < 10000) {
+        events = 10000;
+    }
+    for (int i = 0; i < BENCH_FEEDS; i++) {
+        snprintf(BenchFeeds[i], sizeof(BenchFeeds[i]), "rtsp://192.168.1.%d:554/stream1", 10 + i);
+    }
+    char root[1024];
+    snprintf(root, sizeof(root), "%s/event_query_bench.XXXXXX", parent ? parent : "/tmp");
+    if (!mkdtemp(root)) {
+        perror("mkdtemp");
+        return 2;
+    }
+
+    RTSPEventStoreConfig config;
+    RTSPEventStoreConfigInit(&config);
+    config.maxEvents = 0;
+    config.syncOnCommit = false;
+    char directory[1100];
+    snprintf(directory, sizeof(directory), "%s/events", root);
+    RTSPEventStoreRef store = RTSPEventStoreOpen(directory, &config);
+    if (!store) {
+        perror("open");
+        return 2;
+    }
+    char title[64], details[128];
+    for (uint64_t i = 0; i < events; i++) {
+        RTSPEventStoreEvent event;
+        BenchMakeEvent(i, &event, title, details);
+        RTSPEventStoreAppend(store, &event);
+        if (RTSPEventStorePendingCount(store) >= 256) {
+            RTSPEventStoreCommit(store);
+        }
+    }
+    RTSPEventStoreCommit(store);
+    printf("event_query_bench: %llu events, pages of %d\n", (unsigned long long)events, BENCH_PAGE);
+
+    double start = BenchNow();
+    RTSPEventTextIndexRef text = RTSPEventStoreTextIndex(store);
+    double buildMs = (BenchNow() - start) * 1000.0;
+    RTSPEventTextIndexStatistics textStatistics = RTSPEventTextIndexGetStatistics(text);
+    printf("  trigram index: built in %.0f ms, %u trigrams, %llu postings in %.1f MB\n", buildMs, textStatistics.trigrams,
+           (unsigned long long)textStatistics.postings, (double)textStatistics.postingBytes / 1e6);
+
+    int64_t middle = BENCH_BASE_TIMESTAMP + (int64_t)(events / 2) * BENCH_STEP_US;
+    const int64_t hour = 3600LL * 1000000LL;
+    BenchQuery queries[] = {
+        {"type = Failover", {.types = 1ull << 7}},
+        {"type = Motion", {.types = 1ull << 4}},
+        {"feed", {.feed = BenchFeeds[17]}},
+        {"time: one hour", {.hasTimeRange = true, .from = middle, .to = middle + hour}},
+        {"text \"package\"", {.text = "package", .textLength = 7}},
+        {"text \"SIDE GATE: bicycle\"", {.text = "SIDE GATE: bicycle", .textLength = 18}},
+        {"text \"#4242\"", {.text = "#4242", .textLength = 5}},
+        {"text \"#9\" (too short to index)", {.text = "#9", .textLength = 2}},
+        {"text \"no such words\"", {.text = "no such words", .textLength = 13}},
+        {"Motion AND feed AND one day", {.types = 1ull << 4, .feed = BenchFeeds[5], .hasTimeRange = true, .from = middle, .to = middle + 24 * hour}},
+        {"3 types AND feed", {.types = (1ull << 1) | (1ull << 2) | (1ull << 3), .feed = BenchFeeds[40]}},
+        {"text AND type AND one week", {.text = "person", .textLength = 6, .types = 1ull << 4, .hasTimeRange = true, .from = middle, .to = middle + 168 * hour}},
+        {"unknown feed", {.feed = "rtsp://10.0.0.1/none"}},
+        {"everything", {0}},
+    };
+    unsigned failures = 0;
+    double worstFirstPage = 0;
+    for (size_t i = 0; i < sizeof(queries) / sizeof(queries[0]); i++) {
+        failures += BenchRunQuery(store, &queries[i], &worstFirstPage);
+    }
+    failures += BenchCursorChecks(store, events);
+    failures += BenchRetentionChecks(root);
+    printf("  cursor checks: %s\n", failures ? "FAILED" : "ok");
+    printf("  target: first page of an indexed query <= %.0f ms (worst %.3f ms)\n", BENCH_TARGET_FIRST_PAGE_MS, worstFirstPage);
+
+    RTSPEventStoreClose(store);
+    nftw(root, BenchRemoveEntry, 16, FTW_DEPTH | FTW_PHYS);
+
+    bool met = worstFirstPage <= BENCH_TARGET_FIRST_PAGE_MS;
+    if (failures > 0 || !met) {
+        fprintf(stderr, "FAIL: %u check(s)%s\n", failures, met ? "" : ", first-page target missed");
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,376 @@
+//
+//  event_store_bench.c
+//  RTSP Rotator Benchmarks
+//
+//  Throughput and startup benchmark for RTSPEventStore, the append-only log
+//  behind RTSPEventLogger. It measures:
+//
+//    - append throughput with group commits of 256 events (what the logger
+//      does under an event storm), and commit latency with and without fsync
+//    - startup: reopening a store of N events (memory-mapping the segments
+//      and rebuilding the time, type and feed indexes)
+//    - index lookups against a linear scan of the same events
+//
+//  Correctness checks cover reads of pending events, reopen, torn-record
+//  recovery, retention by whole segments, trimming, clearing and the
+//  single-writer lock.
+//
+//  Build (Linux / macOS):
+//    cc -O2 -std=gnu11 -I"../RTSP Rotator" event_store_bench.c "../RTSP Rotator/RTSPEventStore.c" "../RTSP Rotator/RTSPEventTextIndex.c" "../RTSP Rotator/RTSPByteBuffer.c" -o event_store_bench
+//
+//  Usage: event_store_bench [--events N] [--dir PATH]
+//
+
+#define _GNU_SOURCE
+
+#include "RTSPEventStore.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Opening a million-event log must not hold up app launch
+#define BENCH_TARGET_STARTUP_MS 1000.0
+
+#define BENCH_COMMIT_BATCH 256
+#define BENCH_FEEDS 64
+#define BENCH_TYPES 12
+#define BENCH_BASE_TIMESTAMP 1760000000000000LL
+
+static double BenchNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static int BenchCompareDouble(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double BenchPercentile(const double *sorted, size_t count, double percentile) {
+    if (count == 0) {
+        return 0;
+    }
+    size_t index = (size_t)(percentile * (double)(count - 1) + 0.5);
+    return sorted[index < count ? index : count - 1];
+}
+
+static unsigned BenchCheck(bool condition, const char *what) {
+    if (!condition) {
+        fprintf(stderr, "  check failed: %s\n", what);
+    }
+    return condition ? 0 : 1;
+}
+
+static int BenchRemoveEntry(const char *path, const struct stat *info, int flag, struct FTW *ftw) {
+    (void)info;
+    (void)flag;
+    (void)ftw;
+    return remove(path);
+}
+
+static void BenchRemoveTree(const char *path) {
+    nftw(path, BenchRemoveEntry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+#pragma mark - Fixtures
+
+static char BenchFeeds[BENCH_FEEDS][64];
+
+/// Event i: one of 64 cameras, 12 types, one event per 10 ms
+static void BenchMakeEvent(uint64_t i, RTSPEventStoreEvent *event, char *title, size_t titleSize, char *details, size_t detailsSize) {
+    memset(event, 0, sizeof(*event));
+    event->timestamp = BENCH_BASE_TIMESTAMP + (int64_t)i * 10000;
+    event->type = (uint16_t)(i % BENCH_TYPES);
+    memcpy(event->uuid, &i, sizeof(i));
+    event->feed = BenchFeeds[i % BENCH_FEEDS];
+    event->title = title;
+    event->titleLength = (size_t)snprintf(title, titleSize, "Motion detected #%llu", (unsigned long long)i);
+    event->details = details;
+    event->detailsLength = (size_t)snprintf(details, detailsSize, "Camera %llu, zone %llu, confidence 0.%02llu",
+                                            (unsigned long long)(i % BENCH_FEEDS), (unsigned long long)(i % 7),
+                                            (unsigned long long)(i % 100));
+    if (i % 4 == 0) {
+        static const char metadata[] = "{\"objects\":[\"person\"]}";
+        event->metadata = (const uint8_t *)metadata;
+        event->metadataLength = sizeof(metadata) - 1;
+    }
+}
+
+static bool BenchEntryIs(RTSPEventStoreRef store, uint64_t sequence, uint64_t i) {
+    RTSPEventStoreEntry entry;
+    if (!RTSPEventStoreGet(store, sequence, &entry)) {
+        return false;
+    }
+    char title[64], details[96];
+    RTSPEventStoreEvent expected;
+    BenchMakeEvent(i, &expected, title, sizeof(title), details, sizeof(details));
+    return entry.record->timestamp == expected.timestamp && entry.record->type == expected.type &&
+           entry.record->titleLength == expected.titleLength && memcmp(entry.title, title, expected.titleLength) == 0 &&
+           entry.record->detailsLength == expected.detailsLength && memcmp(entry.details, details, expected.detailsLength) == 0 &&
+           entry.record->metadataLength == expected.metadataLength && entry.feed && strcmp(entry.feed, expected.feed) == 0;
+}
+
+static uint64_t BenchAppend(RTSPEventStoreRef store, uint64_t first, uint64_t count, double *commitTimes, size_t *commitCount) {
+    char title[64], details[96];
+    uint64_t appended = 0;
+    for (uint64_t i = first; i < first + count; i++) {
+        RTSPEventStoreEvent event;
+        BenchMakeEvent(i, &event, title, sizeof(title), details, sizeof(details));
+        appended += RTSPEventStoreAppend(store, &event) != 0;
+        if (RTSPEventStorePendingCount(store) >= BENCH_COMMIT_BATCH) {
+            double start = BenchNow();
+            RTSPEventStoreCommit(store);
+            if (commitTimes) {
+                commitTimes[(*commitCount)++] = (BenchNow() - start) * 1000.0;
+            }
+        }
+    }
+    RTSPEventStoreCommit(store);
+    return appended;
+}
+
+#pragma mark - Checks
+
+static unsigned BenchRecoveryChecks(const char *root) {
+    unsigned failures = 0;
+    char directory[1100];
+    snprintf(directory, sizeof(directory), "%s/recovery", root);
+
+    RTSPEventStoreConfig config;
+    RTSPEventStoreConfigInit(&config);
+    config.recordsPerSegment = 1000;
+    config.maxEvents = 0;
+    config.syncOnCommit = false;
+
+    // Pending events are readable before they are committed
+    RTSPEventStoreRef store = RTSPEventStoreOpen(directory, &config);
+    failures += BenchCheck(store != NULL, "store opens");
+    if (!store) {
+        return failures;
+    }
+    char title[64], details[96];
+    RTSPEventStoreEvent event;
+    for (uint64_t i = 0; i < 2500; i++) {
+        BenchMakeEvent(i, &event, title, sizeof(title), details, sizeof(details));
+        RTSPEventStoreAppend(store, &event);
+        if (i == 1499) {
+            RTSPEventStoreCommit(store);
+        }
+    }
+    failures += BenchCheck(RTSPEventStorePendingCount(store) > 0 && BenchEntryIs(store, 2500, 2499), "pending event readable");
+    failures += BenchCheck(BenchEntryIs(store, 1, 0) && BenchEntryIs(store, 1500, 1499), "committed events readable");
+    size_t typeCount = 0;
+    RTSPEventStoreTypePostings(store, 3, &typeCount);
+    failures += BenchCheck(typeCount == 2500 / BENCH_TYPES + (3 < 2500 % BENCH_TYPES), "type postings include pending events");
+
+    // One writer at a time
+    RTSPEventStoreRef second = RTSPEventStoreOpen(directory, &config);
+    failures += BenchCheck(second == NULL && errno == EWOULDBLOCK, "second open refused while the store is open");
+    RTSPEventStoreClose(second);
+    RTSPEventStoreClose(store);
+
+    // Close commits; segments continue across reopen
+    store = RTSPEventStoreOpen(directory, &config);
+    RTSPEventStoreStatistics statistics = RTSPEventStoreGetStatistics(store);
+    failures += BenchCheck(statistics.events == 2500 && statistics.segments == 3 && statistics.nextSequence == 2501,
+                           "reopen restores every event");
+    failures += BenchCheck(BenchEntryIs(store, 2500, 2499) && BenchEntryIs(store, 1001, 1000), "reopened events intact");
+    failures += BenchCheck(RTSPEventStoreFeedID(store, BenchFeeds[5]) != 0 && RTSPEventStoreFeedID(store, "rtsp://unknown") == 0,
+                           "feeds reloaded");
+    RTSPEventStoreClose(store);
+
+    // Tear the last record: flip a byte in its payload
+    char path[1200];
+    snprintf(path, sizeof(path), "%s/events-00000003.seg", directory);
+    int fd = open(path, O_RDWR);
+    off_t lastRecord = 64 + (off_t)(2500 - 2000 - 1) * RTSP_EVENT_STORE_RECORD_SIZE;
+    uint8_t byte = 0;
+    failures += BenchCheck(fd >= 0 && pread(fd, &byte, 1, lastRecord + 20) == 1, "read last record");
+    byte ^= 0x5A;
+    failures += BenchCheck(pwrite(fd, &byte, 1, lastRecord + 20) == 1, "tear last record");
+    if (fd >= 0) {
+        close(fd);
+    }
+    store = RTSPEventStoreOpen(directory, &config);
+    statistics = RTSPEventStoreGetStatistics(store);
+    failures += BenchCheck(statistics.events == 2499 && statistics.recoveredTornRecords == 1 && statistics.nextSequence == 2500,
+                           "torn record discarded on open");
+    failures += BenchCheck(!RTSPEventStoreGet(store, 2500, &(RTSPEventStoreEntry){0}), "torn record unreadable");
+    BenchMakeEvent(2499, &event, title, sizeof(title), details, sizeof(details));
+    failures += BenchCheck(RTSPEventStoreAppend(store, &event) == 2500 && RTSPEventStoreCommit(store) == 1, "append after recovery");
+    RTSPEventStoreClose(store);
+    store = RTSPEventStoreOpen(directory, &config);
+    statistics = RTSPEventStoreGetStatistics(store);
+    failures += BenchCheck(statistics.events == 2500 && statistics.recoveredTornRecords == 0 && BenchEntryIs(store, 2500, 2499),
+                           "recovered log reopens clean");
+
+    // Trim: events are 10 ms apart, so event 1200 is 12 s after the first
+    failures += BenchCheck(RTSPEventStoreTrimBefore(store, BENCH_BASE_TIMESTAMP + 1200 * 10000), "trim");
+    statistics = RTSPEventStoreGetStatistics(store);
+    failures += BenchCheck(statistics.events == 1300 && statistics.segments == 2, "trim hides old events, drops whole segments");
+    failures += BenchCheck(!RTSPEventStoreGet(store, 1200, &(RTSPEventStoreEntry){0}) && BenchEntryIs(store, 1201, 1200),
+                           "trim boundary");
+    size_t count = 0;
+    const RTSPEventStoreTimeEntry *time = RTSPEventStoreTimeIndex(store, &count);
+    failures += BenchCheck(count == 1300 && time[0].sequence == 1201 && RTSPEventStoreTimeLowerBound(store, BENCH_BASE_TIMESTAMP) == 0,
+                           "time index after trim");
+    RTSPEventStoreClose(store);
+    store = RTSPEventStoreOpen(directory, &config);
+    failures += BenchCheck(RTSPEventStoreCount(store) == 1300, "trim survives reopen");
+
+    // Clear keeps sequence numbers increasing
+    failures += BenchCheck(RTSPEventStoreClear(store) && RTSPEventStoreCount(store) == 0, "clear");
+    failures += BenchCheck(RTSPEventStoreAppend(store, &event) == 2501, "sequence continues after clear");
+    RTSPEventStoreClose(store);
+    store = RTSPEventStoreOpen(directory, &config);
+    statistics = RTSPEventStoreGetStatistics(store);
+    failures += BenchCheck(statistics.events == 1 && statistics.segments == 1 && statistics.nextSequence == 2502 &&
+                           BenchEntryIs(store, 2501, 2499), "clear survives reopen");
+    RTSPEventStoreClose(store);
+
+    // Retention drops whole segments, oldest first
+    snprintf(directory, sizeof(directory), "%s/retention", root);
+    config.maxEvents = 2000;
+    store = RTSPEventStoreOpen(directory, &config);
+    BenchAppend(store, 0, 5500, NULL, NULL);
+    statistics = RTSPEventStoreGetStatistics(store);
+    failures += BenchCheck(statistics.events >= 2000 && statistics.events < 3000 && statistics.firstSequence == 3001,
+                           "retention keeps maxEvents in whole segments");
+    failures += BenchCheck(!RTSPEventStoreGet(store, 3000, &(RTSPEventStoreEntry){0}) && BenchEntryIs(store, 3001, 3000),
+                           "retention boundary");
+    RTSPEventStoreTypePostings(store, 0, &typeCount);
+    failures += BenchCheck(typeCount == 2500 / BENCH_TYPES || typeCount == 2500 / BENCH_TYPES + 1, "postings follow retention");
+    RTSPEventStoreClose(store);
+    return failures;
+}
+
+#pragma mark - Benchmark
+
+int main(int argc, char **argv) {
+    uint64_t events = 1000000;
+    const char *parent = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--events") == 0 && i + 1 < argc) {
+            events = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--dir") == 0 && i + 1 < argc) {
+            parent = argv[++i];
+        } else {
+            fprintf(stderr, "usage: %s [--events N] [--dir PATH]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (events < 1000) {
+        events = 1000;
+    }
+    for (int i = 0; i < BENCH_FEEDS; i++) {
+        snprintf(BenchFeeds[i], sizeof(BenchFeeds[i]), "rtsp://192.168.1.%d:554/stream1", 10 + i);
+    }
+    char root[1024];
+    snprintf(root, sizeof(root), "%s/event_store_bench.XXXXXX", parent ? parent : "/tmp");
+    if (!mkdtemp(root)) {
+        perror("mkdtemp");
+        return 2;
+    }
+
+    printf("event_store_bench: %llu events, commits of %d\n", (unsigned long long)events, BENCH_COMMIT_BATCH);
+    unsigned failures = BenchRecoveryChecks(root);
+    printf("  recovery checks: %s\n", failures ? "FAILED" : "ok");
+
+    char directory[1100];
+    snprintf(directory, sizeof(directory), "%s/large", root);
+    RTSPEventStoreConfig config;
+    RTSPEventStoreConfigInit(&config);
+    config.maxEvents = 0;
+    config.syncOnCommit = false;
+
+    // Append
+    size_t commitCapacity = (size_t)(events / BENCH_COMMIT_BATCH + 2);
+    double *commitTimes = malloc(commitCapacity * sizeof(double));
+    size_t commitCount = 0;
+    RTSPEventStoreRef store = RTSPEventStoreOpen(directory, &config);
+    failures += BenchCheck(store != NULL, "large store opens");
+    if (!store) {
+        BenchRemoveTree(root);
+        return 1;
+    }
+    double start = BenchNow();
+    uint64_t appended = BenchAppend(store, 0, events, commitTimes, &commitCount);
+    double appendSeconds = BenchNow() - start;
+    RTSPEventStoreStatistics statistics = RTSPEventStoreGetStatistics(store);
+    qsort(commitTimes, commitCount, sizeof(double), BenchCompareDouble);
+    failures += BenchCheck(appended == events && statistics.events == events, "every event appended");
+    printf("  append:      %.0f events/s, %.1f MB records + %.1f MB text, %u segments\n", (double)events / appendSeconds,
+           (double)statistics.recordBytes / 1e6, (double)statistics.textBytes / 1e6, statistics.segments);
+    printf("  commit:      p50 %.3f ms  p99 %.3f ms  (%d events, no fsync)\n", BenchPercentile(commitTimes, commitCount, 0.50),
+           BenchPercentile(commitTimes, commitCount, 0.99), BENCH_COMMIT_BATCH);
+    RTSPEventStoreClose(store);
+
+    // Startup
+    start = BenchNow();
+    store = RTSPEventStoreOpen(directory, &config);
+    double startupMs = (BenchNow() - start) * 1000.0;
+    statistics = RTSPEventStoreGetStatistics(store);
+    failures += BenchCheck(store && statistics.events == events && statistics.recoveredTornRecords == 0, "large store reopens");
+    bool intact = true;
+    for (uint64_t i = 0; i < events && store; i += events / 97 + 1) {
+        intact &= BenchEntryIs(store, i + 1, i);
+    }
+    failures += BenchCheck(intact && store && BenchEntryIs(store, events, events - 1), "sampled events intact after reopen");
+    printf("  startup:     %.1f ms to open and index %llu events\n", startupMs, (unsigned long long)events);
+
+    // Queries: the index answers directly; the old logger scanned everything
+    if (store) {
+        uint32_t feed = RTSPEventStoreFeedID(store, BenchFeeds[17]);
+        size_t feedCount = 0, typeCount = 0;
+        start = BenchNow();
+        RTSPEventStoreFeedPostings(store, feed, &feedCount);
+        RTSPEventStoreTypePostings(store, 5, &typeCount);
+        size_t from = RTSPEventStoreTimeLowerBound(store, BENCH_BASE_TIMESTAMP + (int64_t)(events / 2) * 10000);
+        double indexedUs = (BenchNow() - start) * 1e6;
+        failures += BenchCheck(feedCount == events / BENCH_FEEDS + (17 < events % BENCH_FEEDS) &&
+                               typeCount == events / BENCH_TYPES + (5 < events % BENCH_TYPES) && from == events / 2,
+                               "index lookups");
+
+        start = BenchNow();
+        size_t scanned = 0;
+        for (uint64_t sequence = 1; sequence <= events; sequence++) {
+            RTSPEventStoreEntry entry;
+            if (RTSPEventStoreGet(store, sequence, &entry) && entry.feed && strcmp(entry.feed, BenchFeeds[17]) == 0) {
+                scanned++;
+            }
+        }
+        double scanMs = (BenchNow() - start) * 1000.0;
+        failures += BenchCheck(scanned == feedCount, "scan agrees with feed index");
+        printf("  lookup:      feed + type + time range %.1f us indexed, feed by scan %.1f ms\n", indexedUs, scanMs);
+    }
+    RTSPEventStoreClose(store);
+
+    // Durable commits, as the logger runs them
+    snprintf(directory, sizeof(directory), "%s/sync", root);
+    config.syncOnCommit = true;
+    store = RTSPEventStoreOpen(directory, &config);
+    commitCount = 0;
+    BenchAppend(store, 0, 64 * BENCH_COMMIT_BATCH, commitTimes, &commitCount);
+    qsort(commitTimes, commitCount, sizeof(double), BenchCompareDouble);
+    printf("  sync commit: p50 %.3f ms  p99 %.3f ms  (%d events, fsync)\n", BenchPercentile(commitTimes, commitCount, 0.50),
+           BenchPercentile(commitTimes, commitCount, 0.99), BENCH_COMMIT_BATCH);
+    RTSPEventStoreClose(store);
+    free(commitTimes);
+    BenchRemoveTree(root);
+
+    bool met = startupMs <= BENCH_TARGET_STARTUP_MS || events > 1000000;
+    printf("  target: open 1M events in <= %.0f ms\n", BENCH_TARGET_STARTUP_MS);
+    if (failures > 0 || !met) {
+        fprintf(stderr, "FAIL: %u check(s)%s\n", failures, met ? "" : ", startup target missed");
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
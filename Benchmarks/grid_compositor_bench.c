@@ -0,0 +1,388 @@
+//
+//  grid_compositor_bench.c
+//  RTSP Rotator Benchmarks
+//
+//  Frame-time benchmark for RTSPGridCompositor's software backend, the
+//  headless stand-in for the Metal renderer behind RTSPMultiViewGrid. It
+//  runs on machines without a GPU. For each wall:
+//
+//    - full redraw: every camera delivered a frame since the last render
+//    - one tile: a single camera's frame arrived (the common case at
+//      staggered camera frame rates)
+//    - clock tick: only the timestamp overlay changed
+//
+//  Sources are synthetic NV12 frames (what the decoder hands RTSPFrameBus),
+//  scaled with nearest-neighbour sampling; overlays use a synthetic glyph
+//  atlas with the metrics of the real one. Before timing, pixel checks cover
+//  NV12 conversion, aspect-fit letterboxing, overlays, the focus ring, the
+//  status dot and damage tracking.
+//
+//  Build (Linux / macOS):
+//    cc -O2 -std=gnu11 -I"../RTSP Rotator" grid_compositor_bench.c "../RTSP Rotator/RTSPGridCompositor.c" -lm -o grid_compositor_bench
+//
+//  Usage: grid_compositor_bench [--frames N]
+//
+
+#define _GNU_SOURCE
+
+#include "RTSPGridCompositor.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// One core must keep a 4x4 wall of substreams at 30 fps on a 1080p surface
+#define BENCH_TARGET_FULL_P99_MS 33.0
+
+#define BENCH_GLYPH_CELL_WIDTH 8
+#define BENCH_GLYPH_CELL_HEIGHT 14
+
+static double BenchNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static int BenchCompareDouble(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double BenchPercentile(const double *sorted, size_t count, double percentile) {
+    if (count == 0) {
+        return 0;
+    }
+    size_t index = (size_t)(percentile * (double)(count - 1) + 0.5);
+    return sorted[index < count ? index : count - 1];
+}
+
+static unsigned BenchCheck(bool condition, const char *what) {
+    if (!condition) {
+        fprintf(stderr, "  check failed: %s\n", what);
+    }
+    return condition ? 0 : 1;
+}
+
+#pragma mark - Fixtures
+
+/// Every glyph a solid 6x9 box: same metrics as an 11 pt system font at 1x
+static void BenchMakeAtlas(RTSPGridCompositorAtlas *atlas, uint8_t **storage) {
+    memset(atlas, 0, sizeof(*atlas));
+    atlas->width = 16 * BENCH_GLYPH_CELL_WIDTH;
+    atlas->height = 6 * BENCH_GLYPH_CELL_HEIGHT;
+    atlas->bytesPerRow = atlas->width;
+    atlas->lineHeight = 14;
+    atlas->ascent = 11;
+    *storage = calloc(atlas->bytesPerRow * atlas->height, 1);
+    for (unsigned i = 0; i < RTSP_GRID_COMPOSITOR_GLYPH_COUNT; i++) {
+        RTSPGridCompositorGlyph *glyph = &atlas->glyphs[i];
+        glyph->x = (uint16_t)((i % 16) * BENCH_GLYPH_CELL_WIDTH);
+        glyph->y = (uint16_t)((i / 16) * BENCH_GLYPH_CELL_HEIGHT);
+        glyph->advance = 7;
+        if (i == 0) {
+            continue; // Space
+        }
+        glyph->width = 6;
+        glyph->height = 9;
+        glyph->bearingX = 1;
+        glyph->bearingY = 9;
+        for (unsigned y = 0; y < glyph->height; y++) {
+            memset(*storage + (glyph->y + y) * atlas->bytesPerRow + glyph->x, 255, glyph->width);
+        }
+    }
+    atlas->coverage = *storage;
+}
+
+typedef struct {
+    uint8_t *luma;
+    uint8_t *chroma;
+    RTSPGridCompositorImage image;
+} BenchFrame;
+
+static void BenchMakeNV12(BenchFrame *frame, uint32_t width, uint32_t height, uint8_t y, uint8_t cb, uint8_t cr, bool pattern) {
+    frame->luma = malloc((size_t)width * height);
+    frame->chroma = malloc((size_t)width * (height / 2));
+    for (uint32_t row = 0; row < height; row++) {
+        for (uint32_t x = 0; x < width; x++) {
+            frame->luma[(size_t)row * width + x] = pattern ? (uint8_t)(16 + ((x * 7 + row * 3) & 0xBF)) : y;
+        }
+    }
+    for (size_t i = 0; i < (size_t)width * (height / 2); i += 2) {
+        frame->chroma[i] = cb;
+        frame->chroma[i + 1] = cr;
+    }
+    frame->image = (RTSPGridCompositorImage){
+        .format = RTSPGridCompositorPixelFormatNV12,
+        .width = width,
+        .height = height,
+        .planes = {frame->luma, frame->chroma},
+        .bytesPerRow = {width, width}
+    };
+}
+
+static void BenchFreeFrame(BenchFrame *frame) {
+    free(frame->luma);
+    free(frame->chroma);
+}
+
+static uint32_t BenchPixel(const uint8_t *target, size_t bytesPerRow, int x, int y) {
+    uint32_t pixel;
+    memcpy(&pixel, target + (size_t)y * bytesPerRow + 4 * (size_t)x, 4);
+    return pixel;
+}
+
+static bool BenchNear(uint32_t pixel, int r, int g, int b, int tolerance) {
+    int pr = (pixel >> 16) & 0xFF, pg = (pixel >> 8) & 0xFF, pb = pixel & 0xFF;
+    return abs(pr - r) <= tolerance && abs(pg - g) <= tolerance && abs(pb - b) <= tolerance;
+}
+
+#pragma mark - Checks
+
+static unsigned BenchPixelChecks(const RTSPGridCompositorAtlas *atlas) {
+    unsigned failures = 0;
+    const uint32_t width = 640, height = 360;
+    size_t bytesPerRow = width * 4;
+    uint8_t *target = calloc(bytesPerRow * height, 1);
+    uint8_t *before = malloc(bytesPerRow * height);
+
+    RTSPGridCompositorConfig config;
+    RTSPGridCompositorConfigInit(&config, width, height, 2, 2);
+    config.atlas = atlas;
+    RTSPGridCompositorRef compositor = RTSPGridCompositorCreate(&config);
+    failures += BenchCheck(compositor != NULL, "compositor created");
+    if (!compositor) {
+        free(target);
+        free(before);
+        return failures;
+    }
+
+    // Tile 0: saturated red NV12. Tile 1: 4:3 BGRA in a 16:9 tile. Tile 2:
+    // no frame, focused. Tile 3: white NV12 with label, timestamp and status.
+    BenchFrame red, white;
+    BenchMakeNV12(&red, 320, 180, 81, 90, 240, false);
+    BenchMakeNV12(&white, 320, 180, 255, 128, 128, false);
+    uint32_t *bgra = malloc(320 * 240 * 4);
+    for (size_t i = 0; i < 320 * 240; i++) {
+        bgra[i] = 0xFF2080C0u;
+    }
+    RTSPGridCompositorImage images[4] = {
+        red.image,
+        {.format = RTSPGridCompositorPixelFormatBGRA8, .width = 320, .height = 240,
+         .planes = {(const uint8_t *)bgra, NULL}, .bytesPerRow = {320 * 4, 0}},
+        {0},
+        white.image
+    };
+    RTSPGridCompositorTile tiles[4] = {
+        {.frameWidth = 320, .frameHeight = 180, .showTimestamp = true},
+        {.frameWidth = 320, .frameHeight = 240},
+        {.focused = true},
+        {.frameWidth = 320, .frameHeight = 180, .statusColor = 0xFF00FF00u, .showLabel = true, .showTimestamp = true,
+         .label = "Front Door"}
+    };
+    for (uint32_t i = 0; i < 4; i++) {
+        RTSPGridCompositorSetTile(compositor, i, &tiles[i]);
+    }
+    RTSPGridCompositorSetTimestamp(compositor, "12:00:00");
+    RTSPGridCompositorBuild(compositor, NULL, NULL);
+    uint32_t drawn = RTSPGridCompositorRenderSoftware(compositor, images, target, bytesPerRow);
+    failures += BenchCheck(drawn == 4, "first render draws every tile");
+
+    float rect[4][4];
+    for (uint32_t i = 0; i < 4; i++) {
+        RTSPGridCompositorTileRect(compositor, i, rect[i]);
+    }
+    int cx0 = (int)(rect[0][0] + rect[0][2] / 2), cy0 = (int)(rect[0][1] + rect[0][3] / 2);
+    // r = 81 + 1.5748 * 112 (clamped), g = 81 - 0.1873 * -38 - 0.4681 * 112, b = 81 + 1.8556 * -38
+    failures += BenchCheck(BenchNear(BenchPixel(target, bytesPerRow, cx0, cy0), 255, 36, 10, 2), "NV12 full-range BT.709 conversion");
+    failures += BenchCheck(BenchPixel(target, bytesPerRow, 0, 0) == 0xFF000000u, "spacing stays black");
+
+    int cy1 = (int)(rect[1][1] + rect[1][3] / 2);
+    failures += BenchCheck(BenchPixel(target, bytesPerRow, (int)rect[1][0] + 2, cy1) == 0xFF000000u, "pillarbox band is black");
+    failures += BenchCheck(BenchPixel(target, bytesPerRow, (int)(rect[1][0] + rect[1][2] / 2), cy1) == 0xFF2080C0u, "BGRA source copied");
+
+    failures += BenchCheck(BenchPixel(target, bytesPerRow, (int)(rect[2][0] + rect[2][2] / 2), (int)rect[2][1]) == 0xFF0A84FFu,
+                           "focus ring drawn");
+    failures += BenchCheck(BenchPixel(target, bytesPerRow, (int)(rect[2][0] + rect[2][2] / 2), (int)(rect[2][1] + rect[2][3] / 2)) == 0xFF000000u,
+                           "tile without a frame is black");
+
+    int dotX = (int)rect[3][0] + 8 + 6, dotY = (int)rect[3][1] + 8 + 6;
+    failures += BenchCheck(BenchPixel(target, bytesPerRow, dotX, dotY) == 0xFF00FF00u, "status dot drawn");
+    int barX = (int)lroundf(rect[3][0] + 8), barY = (int)lroundf(rect[3][1] + rect[3][3] - 28);
+    failures += BenchCheck(BenchNear(BenchPixel(target, bytesPerRow, barX + 7, barY + 9), 255, 255, 255, 0), "label glyph drawn");
+    failures += BenchCheck(BenchNear(BenchPixel(target, bytesPerRow, barX + 100, barY + 2), 77, 77, 77, 2), "label bar darkens the frame");
+
+    // Damage: nothing changed, then one frame, then a clock tick
+    RTSPGridCompositorBuild(compositor, NULL, NULL);
+    failures += BenchCheck(RTSPGridCompositorRenderSoftware(compositor, images, target, bytesPerRow) == 0, "no redraw without changes");
+    memcpy(before, target, bytesPerRow * height);
+    RTSPGridCompositorStatistics statistics = RTSPGridCompositorGetStatistics(compositor);
+    RTSPGridCompositorMarkFrame(compositor, 1);
+    RTSPGridCompositorBuild(compositor, NULL, NULL);
+    failures += BenchCheck(RTSPGridCompositorRenderSoftware(compositor, images, target, bytesPerRow) == 1 &&
+                           memcmp(before, target, bytesPerRow * height) == 0, "frame arrival redraws one tile");
+    failures += BenchCheck(RTSPGridCompositorGetStatistics(compositor).overlayRebuilds == statistics.overlayRebuilds,
+                           "frame arrival reuses the overlay batch");
+    RTSPGridCompositorSetTimestamp(compositor, "12:00:01");
+    RTSPGridCompositorBuild(compositor, NULL, NULL);
+    failures += BenchCheck(RTSPGridCompositorRenderSoftware(compositor, images, target, bytesPerRow) == 2, "clock tick redraws timestamped tiles");
+
+    RTSPGridCompositorRelease(compositor);
+    BenchFreeFrame(&red);
+    BenchFreeFrame(&white);
+    free(bgra);
+    free(target);
+    free(before);
+    return failures;
+}
+
+#pragma mark - Timing
+
+typedef struct {
+    const char *name;
+    uint32_t width;
+    uint32_t height;
+    float scale;
+    uint32_t rows;
+    uint32_t columns;
+    uint32_t sourceWidth;
+    uint32_t sourceHeight;
+    bool gated;
+} BenchWall;
+
+typedef struct {
+    double p50;
+    double p99;
+} BenchTiming;
+
+static BenchTiming BenchSummarize(double *samples, size_t count) {
+    qsort(samples, count, sizeof(double), BenchCompareDouble);
+    return (BenchTiming){BenchPercentile(samples, count, 0.50) * 1e3, BenchPercentile(samples, count, 0.99) * 1e3};
+}
+
+static bool BenchRunWall(const BenchWall *wall, const RTSPGridCompositorAtlas *atlas, unsigned frames) {
+    uint32_t tiles = wall->rows * wall->columns;
+    size_t bytesPerRow = (size_t)wall->width * 4;
+    uint8_t *target = calloc(bytesPerRow * wall->height, 1);
+    BenchFrame *sources = calloc(tiles, sizeof(*sources));
+    RTSPGridCompositorImage *images = calloc(tiles, sizeof(*images));
+
+    RTSPGridCompositorConfig config;
+    RTSPGridCompositorConfigInit(&config, wall->width, wall->height, wall->rows, wall->columns);
+    config.scale = wall->scale;
+    config.atlas = atlas;
+    RTSPGridCompositorRef compositor = RTSPGridCompositorCreate(&config);
+    for (uint32_t i = 0; i < tiles; i++) {
+        BenchMakeNV12(&sources[i], wall->sourceWidth, wall->sourceHeight, 0, (uint8_t)(96 + i * 4), (uint8_t)(160 - i * 4), true);
+        images[i] = sources[i].image;
+        char label[32];
+        snprintf(label, sizeof(label), "Camera %u - Driveway", i + 1);
+        RTSPGridCompositorTile state = {
+            .frameWidth = wall->sourceWidth, .frameHeight = wall->sourceHeight,
+            .statusColor = 0xFF00FF00u, .focused = i == 0,
+            .showLabel = true, .showTimestamp = true, .showDiagnostics = true,
+            .label = label, .diagnostics = "1920x1080 30fps 42ms"
+        };
+        RTSPGridCompositorSetTile(compositor, i, &state);
+    }
+    RTSPGridCompositorSetTimestamp(compositor, "12:00:00");
+    RTSPGridCompositorBuild(compositor, NULL, NULL);
+    RTSPGridCompositorRenderSoftware(compositor, images, target, bytesPerRow);
+
+    double *full = malloc(frames * sizeof(double));
+    double *single = malloc(frames * sizeof(double));
+    double *tick = malloc(frames * sizeof(double));
+    for (unsigned f = 0; f < frames; f++) {
+        double start = BenchNow();
+        for (uint32_t i = 0; i < tiles; i++) {
+            RTSPGridCompositorMarkFrame(compositor, i);
+        }
+        RTSPGridCompositorBuild(compositor, NULL, NULL);
+        RTSPGridCompositorRenderSoftware(compositor, images, target, bytesPerRow);
+        full[f] = BenchNow() - start;
+
+        start = BenchNow();
+        RTSPGridCompositorMarkFrame(compositor, f % tiles);
+        RTSPGridCompositorBuild(compositor, NULL, NULL);
+        RTSPGridCompositorRenderSoftware(compositor, images, target, bytesPerRow);
+        single[f] = BenchNow() - start;
+
+        char timestamp[16];
+        snprintf(timestamp, sizeof(timestamp), "12:%02u:%02u", (f / 60) % 60, f % 60);
+        start = BenchNow();
+        RTSPGridCompositorSetTimestamp(compositor, timestamp);
+        RTSPGridCompositorBuild(compositor, NULL, NULL);
+        RTSPGridCompositorRenderSoftware(compositor, images, target, bytesPerRow);
+        tick[f] = BenchNow() - start;
+    }
+    RTSPGridCompositorStatistics statistics = RTSPGridCompositorGetStatistics(compositor);
+    BenchTiming fullTiming = BenchSummarize(full, frames);
+    BenchTiming singleTiming = BenchSummarize(single, frames);
+    BenchTiming tickTiming = BenchSummarize(tick, frames);
+    bool met = !wall->gated || fullTiming.p99 <= BENCH_TARGET_FULL_P99_MS;
+
+    printf("  %s: %ux%u @%.0fx, %ux%u tiles of %ux%u NV12\n", wall->name, wall->width, wall->height, wall->scale,
+           wall->columns, wall->rows, wall->sourceWidth, wall->sourceHeight);
+    printf("    quads per frame:  %u video + %u overlay (%u glyphs), 1 surface\n",
+           statistics.videoQuads, statistics.overlayQuads, statistics.glyphQuads);
+    printf("    full redraw:      p50 %6.2f ms   p99 %6.2f ms   %s\n", fullTiming.p50, fullTiming.p99,
+           wall->gated ? (met ? "ok" : "MISSED") : "(informational)");
+    printf("    one tile:         p50 %6.2f ms   p99 %6.2f ms\n", singleTiming.p50, singleTiming.p99);
+    printf("    clock tick:       p50 %6.2f ms   p99 %6.2f ms\n", tickTiming.p50, tickTiming.p99);
+
+    RTSPGridCompositorRelease(compositor);
+    for (uint32_t i = 0; i < tiles; i++) {
+        BenchFreeFrame(&sources[i]);
+    }
+    free(sources);
+    free(images);
+    free(target);
+    free(full);
+    free(single);
+    free(tick);
+    return met;
+}
+
+int main(int argc, char **argv) {
+    unsigned frames = 120;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frames = (unsigned)atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--frames N]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (frames == 0) {
+        frames = 1;
+    }
+
+    uint8_t *atlasStorage = NULL;
+    RTSPGridCompositorAtlas atlas;
+    BenchMakeAtlas(&atlas, &atlasStorage);
+
+    printf("grid_compositor_bench: software backend, %u frames per case\n", frames);
+    unsigned failures = BenchPixelChecks(&atlas);
+    printf("  pixel checks: %s\n", failures ? "FAILED" : "ok");
+
+    // A 4x4 wall replaces 16 AVPlayerLayers, 64 text/indicator views and 16 timers
+    static const BenchWall walls[] = {
+        {"4x4 substreams", 1920, 1080, 1.0f, 4, 4, 640, 360, true},
+        {"4x4 main streams, Retina", 3840, 2160, 2.0f, 4, 4, 1920, 1080, false},
+        {"2x2 main streams", 1920, 1080, 1.0f, 2, 2, 1920, 1080, false},
+    };
+    bool met = true;
+    for (size_t i = 0; i < sizeof(walls) / sizeof(walls[0]); i++) {
+        met &= BenchRunWall(&walls[i], &atlas, frames);
+    }
+    printf("  target: 4x4 substream full redraw p99 <= %.0f ms on one core\n", BENCH_TARGET_FULL_P99_MS);
+    free(atlasStorage);
+
+    if (failures > 0 || !met) {
+        fprintf(stderr, "FAIL: %u pixel check(s)%s\n", failures, met ? "" : ", frame-time target missed");
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
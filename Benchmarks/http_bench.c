@@ -0,0 +1,610 @@
+//
+//  http_bench.c
+//  RTSP Rotator Benchmarks
+//
+//  wrk2-style load test for RTSPHTTPServer. Serves /api/feeds and
+//  /api/current through the same routes RTSPAPIServer registers, then
+//  holds N keep-alive connections open from a few client threads. Each
+//  connection sends one request at a time on a fixed schedule (the total
+//  --rate is spread evenly across connections, like dashboards polling),
+//  and latency is measured from the scheduled send time so a stalled
+//  server cannot hide queueing delay. p50/p99 per endpoint are checked
+//  against fixed targets. --rate 0 runs closed loop as fast as possible,
+//  which measures throughput instead (latency is then just N / throughput).
+//
+//  Before the load phase the protocol handling is checked: pipelined
+//  requests come back in order, requests trickled in a few bytes at a time
+//  are parsed incrementally, and 404/405/431, HEAD and POST bodies behave.
+//
+//  Build (Linux / macOS):
+//    cc -O2 -std=gnu11 -I"../RTSP Rotator" http_bench.c "../RTSP Rotator/RTSPHTTPServer.c" "../RTSP Rotator/RTSPHTTPRouter.c" "../RTSP Rotator/RTSPWebSocket.c" "../RTSP Rotator/RTSPByteBuffer.c" -lpthread -lm -o http_bench
+//
+//  Usage: http_bench [--connections N] [--rate REQ/S] [--seconds S] [--threads T] [--workers W] [--feeds F] [--close]
+//    --rate   total request rate across all connections (default 10000, 0 = closed loop)
+//    --close  open a new connection per request (the old server's behaviour)
+//
+
+#define _GNU_SOURCE
+
+#include "RTSPHTTPServer.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+// Latency targets at 1k concurrent connections on loopback
+#define BENCH_TARGET_P50_MS 2.0
+#define BENCH_TARGET_P99_MS 10.0
+
+#define BENCH_RESPONSE_CAPACITY 16384
+
+enum { BenchFeeds = 0, BenchCurrent, BenchEndpointCount };
+
+static const char *const BenchRequests[BenchEndpointCount] = {
+    "GET /api/feeds HTTP/1.1\r\nHost: 127.0.0.1\r\nUser-Agent: http_bench\r\nAccept: application/json\r\n\r\n",
+    "GET /api/current HTTP/1.1\r\nHost: 127.0.0.1\r\nUser-Agent: http_bench\r\nAccept: application/json\r\n\r\n",
+};
+
+static const char *const BenchEndpointNames[BenchEndpointCount] = {"/api/feeds", "/api/current"};
+
+static double BenchNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+#pragma mark - API Handlers
+
+typedef struct {
+    unsigned feedCount;
+    atomic_int currentIndex;
+} BenchAPI;
+
+static void BenchAppendJSON(RTSPHTTPResponse *response, const char *json) {
+    RTSPHTTPResponseSetContentType(response, "application/json");
+    RTSPHTTPResponseAppendBody(response, json, strlen(json));
+}
+
+static void BenchHandleFeeds(void *context, const RTSPHTTPRequest *request, RTSPHTTPResponse *response) {
+    (void)request;
+    BenchAPI *api = context;
+    char json[BENCH_RESPONSE_CAPACITY / 2];
+    size_t length = (size_t)snprintf(json, sizeof(json), "{\"success\":true,\"count\":%u,\"feeds\":[", api->feedCount);
+    for (unsigned i = 0; i < api->feedCount && length < sizeof(json) - 128; i++) {
+        length += (size_t)snprintf(json + length, sizeof(json) - length,
+                                   "%s\"rtsps://192.168.1.1:7441/camera-%02u-high-quality-stream\"",
+                                   i ? "," : "", i);
+    }
+    snprintf(json + length, sizeof(json) - length, "]}");
+    BenchAppendJSON(response, json);
+}
+
+static void BenchHandleCurrent(void *context, const RTSPHTTPRequest *request, RTSPHTTPResponse *response) {
+    (void)request;
+    BenchAPI *api = context;
+    char json[64];
+    snprintf(json, sizeof(json), "{\"success\":true,\"index\":%d}", atomic_load(&api->currentIndex));
+    BenchAppendJSON(response, json);
+}
+
+static void BenchHandleSwitch(void *context, const RTSPHTTPRequest *request, RTSPHTTPResponse *response) {
+    BenchAPI *api = context;
+    const char *value = NULL;
+    size_t length = 0;
+    char digits[16] = "";
+    if (RTSPHTTPRequestParam(request, "index", &value, &length) && length < sizeof(digits)) {
+        memcpy(digits, value, length);
+        digits[length] = '\0';
+    }
+    atomic_store(&api->currentIndex, atoi(digits));
+    char json[96];
+    snprintf(json, sizeof(json), "{\"success\":true,\"index\":%d,\"body\":%zu}",
+             atomic_load(&api->currentIndex), request->bodyLength);
+    BenchAppendJSON(response, json);
+}
+
+static void BenchHandleNotFound(void *context, const RTSPHTTPRequest *request, RTSPHTTPResponse *response) {
+    (void)context;
+    (void)request;
+    RTSPHTTPResponseSetStatus(response, 404);
+    BenchAppendJSON(response, "{\"error\":\"Endpoint not found\"}");
+}
+
+#pragma mark - Blocking Client (protocol checks)
+
+typedef struct {
+    int fd;
+    char data[BENCH_RESPONSE_CAPACITY * 2];
+    size_t length;
+} BenchReader;
+
+static int BenchConnect(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in address = {.sin_family = AF_INET, .sin_port = htons(port)};
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+/// Returns the length of a complete response at the front of `data`, 0 if incomplete, -1 if malformed
+static long BenchResponseLength(const char *data, size_t length, bool headOnly, int *status, size_t *bodyOffset) {
+    const char *end = memmem(data, length, "\r\n\r\n", 4);
+    if (!end) {
+        return 0;
+    }
+    size_t head = (size_t)(end - data) + 4;
+    if (sscanf(data, "HTTP/1.1 %d", status) != 1) {
+        return -1;
+    }
+    size_t contentLength = 0;
+    for (const char *line = data; line < end; ) {
+        const char *lineEnd = memmem(line, (size_t)(end - line) + 2, "\r\n", 2);
+        if (strncasecmp(line, "Content-Length:", 15) == 0) {
+            contentLength = strtoul(line + 15, NULL, 10);
+        }
+        line = lineEnd + 2;
+    }
+    *bodyOffset = head;
+    size_t total = head + (headOnly ? 0 : contentLength);
+    return length >= total ? (long)total : 0;
+}
+
+/// Reads one response; copies its head and body (NUL terminated) into `out`
+static int BenchReadResponse(BenchReader *reader, bool headOnly, char *out, size_t capacity) {
+    for (;;) {
+        int status = 0;
+        size_t bodyOffset = 0;
+        long total = BenchResponseLength(reader->data, reader->length, headOnly, &status, &bodyOffset);
+        if (total < 0) {
+            return -1;
+        }
+        if (total > 0) {
+            size_t copy = (size_t)total < capacity - 1 ? (size_t)total : capacity - 1;
+            memcpy(out, reader->data, copy);
+            out[copy] = '\0';
+            memmove(reader->data, reader->data + total, reader->length - (size_t)total);
+            reader->length -= (size_t)total;
+            return status;
+        }
+        if (reader->length == sizeof(reader->data)) {
+            return -1;
+        }
+        ssize_t count = recv(reader->fd, reader->data + reader->length, sizeof(reader->data) - reader->length, 0);
+        if (count <= 0) {
+            return -1;
+        }
+        reader->length += (size_t)count;
+    }
+}
+
+static bool BenchSendAll(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+        if (sent <= 0) {
+            return false;
+        }
+        data += sent;
+        length -= (size_t)sent;
+    }
+    return true;
+}
+
+static unsigned BenchCheck(bool condition, const char *what) {
+    if (!condition) {
+        fprintf(stderr, "  check failed: %s\n", what);
+    }
+    return condition ? 0 : 1;
+}
+
+static unsigned BenchProtocolChecks(uint16_t port) {
+    unsigned failures = 0;
+    BenchReader reader = {.fd = BenchConnect(port)};
+    char response[BENCH_RESPONSE_CAPACITY];
+    if (reader.fd < 0) {
+        return BenchCheck(false, "connect");
+    }
+
+    // Pipelined requests are answered in order, even with several workers
+    const char *pipelined =
+        "GET /api/current HTTP/1.1\r\nHost: x\r\n\r\n"
+        "POST /api/switch/7 HTTP/1.1\r\nHost: x\r\nContent-Length: 5\r\n\r\nhello"
+        "GET /api/current HTTP/1.1\r\nHost: x\r\n\r\n";
+    BenchSendAll(reader.fd, pipelined, strlen(pipelined));
+    failures += BenchCheck(BenchReadResponse(&reader, false, response, sizeof(response)) == 200 &&
+                           strstr(response, "\"index\":0"), "pipelined #1");
+    failures += BenchCheck(BenchReadResponse(&reader, false, response, sizeof(response)) == 200 &&
+                           strstr(response, "\"index\":7") && strstr(response, "\"body\":5"), "pipelined POST with body");
+    failures += BenchCheck(BenchReadResponse(&reader, false, response, sizeof(response)) == 200 &&
+                           strstr(response, "\"index\":7"), "pipelined #3 sees #2");
+
+    // Incremental parsing: a request trickled in three bytes at a time
+    const char *slow = "GET /api/feeds/ HTTP/1.1\r\nHost: x\r\n\r\n";
+    for (size_t i = 0; i < strlen(slow); i += 3) {
+        size_t chunk = strlen(slow) - i < 3 ? strlen(slow) - i : 3;
+        BenchSendAll(reader.fd, slow + i, chunk);
+        usleep(2000);
+    }
+    failures += BenchCheck(BenchReadResponse(&reader, false, response, sizeof(response)) == 200 &&
+                           strstr(response, "\"feeds\""), "trickled request");
+
+    const char *head = "HEAD /api/feeds HTTP/1.1\r\nHost: x\r\n\r\n";
+    BenchSendAll(reader.fd, head, strlen(head));
+    failures += BenchCheck(BenchReadResponse(&reader, true, response, sizeof(response)) == 200 &&
+                           !strstr(response, "\"feeds\""), "HEAD has no body");
+
+    const char *missing = "GET /api/nothing/here HTTP/1.1\r\nHost: x\r\n\r\n";
+    BenchSendAll(reader.fd, missing, strlen(missing));
+    failures += BenchCheck(BenchReadResponse(&reader, false, response, sizeof(response)) == 404 &&
+                           strstr(response, "Endpoint not found"), "fallback route 404");
+
+    const char *wrongMethod = "DELETE /api/feeds HTTP/1.1\r\nHost: x\r\n\r\n";
+    BenchSendAll(reader.fd, wrongMethod, strlen(wrongMethod));
+    failures += BenchCheck(BenchReadResponse(&reader, false, response, sizeof(response)) == 405 &&
+                           strstr(response, "Allow: GET, HEAD, POST"), "405 with Allow");
+
+    // Oversized head: 431 and the connection is closed
+    char *huge = malloc(70 * 1024);
+    size_t length = (size_t)snprintf(huge, 64, "GET /api/feeds HTTP/1.1\r\nX-Padding: ");
+    memset(huge + length, 'a', 70 * 1024 - length - 4);
+    memcpy(huge + 70 * 1024 - 4, "\r\n\r\n", 4);
+    BenchSendAll(reader.fd, huge, 70 * 1024);
+    free(huge);
+    failures += BenchCheck(BenchReadResponse(&reader, false, response, sizeof(response)) == 431, "431 for oversized head");
+    close(reader.fd);
+
+    // HTTP/1.0 without keep-alive closes after the response
+    reader = (BenchReader){.fd = BenchConnect(port)};
+    const char *http10 = "GET /api/current HTTP/1.0\r\n\r\n";
+    BenchSendAll(reader.fd, http10, strlen(http10));
+    failures += BenchCheck(BenchReadResponse(&reader, false, response, sizeof(response)) == 200 &&
+                           strstr(response, "Connection: close") && recv(reader.fd, response, 1, 0) == 0,
+                           "HTTP/1.0 closes");
+    close(reader.fd);
+    return failures;
+}
+
+#pragma mark - Load Client
+
+typedef struct {
+    int fd;
+    int endpoint;
+    bool waiting;                   // Request sent, response not complete
+    double scheduledAt;             // When the current request was due
+    char data[BENCH_RESPONSE_CAPACITY];
+    size_t length;
+} BenchConnection;
+
+typedef struct {
+    uint16_t port;
+    unsigned connectionCount;
+    bool reconnect;
+    double interval;                // Per-connection request spacing, 0 for closed loop
+    double measureFrom;
+    double deadline;
+    BenchConnection *connections;
+    double *samples[BenchEndpointCount];
+    size_t sampleCount[BenchEndpointCount];
+    size_t sampleCapacity[BenchEndpointCount];
+    uint64_t errors;
+    uint64_t responses;
+} BenchClient;
+
+static bool BenchClientSend(BenchClient *client, BenchConnection *c) {
+    if (c->fd < 0) {
+        c->fd = BenchConnect(client->port);
+        if (c->fd < 0) {
+            return false;
+        }
+        fcntl(c->fd, F_SETFL, fcntl(c->fd, F_GETFL, 0) | O_NONBLOCK);
+    }
+    const char *request = BenchRequests[c->endpoint];
+    c->length = 0;
+    c->waiting = true;
+    // A request is far smaller than an empty socket buffer, so one send suffices
+    return send(c->fd, request, strlen(request), MSG_NOSIGNAL) == (ssize_t)strlen(request);
+}
+
+/// Schedules the next request, or sends it at once in closed loop
+static void BenchClientNext(BenchClient *client, BenchConnection *c, double now) {
+    c->endpoint = (c->endpoint + 1) % BenchEndpointCount;
+    c->waiting = false;
+    if (client->interval > 0) {
+        c->scheduledAt += client->interval;
+    } else {
+        c->scheduledAt = now;
+        if (!BenchClientSend(client, c)) {
+            client->errors++;
+        }
+    }
+}
+
+static void BenchClientRecord(BenchClient *client, int endpoint, double latency) {
+    if (client->sampleCount[endpoint] == client->sampleCapacity[endpoint]) {
+        size_t capacity = client->sampleCapacity[endpoint] ? client->sampleCapacity[endpoint] * 2 : 65536;
+        double *samples = realloc(client->samples[endpoint], capacity * sizeof(*samples));
+        if (!samples) {
+            return;
+        }
+        client->samples[endpoint] = samples;
+        client->sampleCapacity[endpoint] = capacity;
+    }
+    client->samples[endpoint][client->sampleCount[endpoint]++] = latency;
+}
+
+static void *BenchClientThread(void *argument) {
+    BenchClient *client = argument;
+    struct pollfd *fds = calloc(client->connectionCount, sizeof(*fds));
+    double now = BenchNow();
+    for (unsigned i = 0; i < client->connectionCount; i++) {
+        BenchConnection *c = &client->connections[i];
+        c->fd = BenchConnect(client->port);
+        if (c->fd < 0) {
+            client->errors++;
+            continue;
+        }
+        fcntl(c->fd, F_SETFL, fcntl(c->fd, F_GETFL, 0) | O_NONBLOCK);
+        c->endpoint = (int)(i % BenchEndpointCount);
+        // Spread the first requests evenly over one interval
+        c->scheduledAt = now + client->interval * i / client->connectionCount;
+    }
+
+    while ((now = BenchNow()) < client->deadline) {
+        double wake = now + 0.1;
+        for (unsigned i = 0; i < client->connectionCount; i++) {
+            BenchConnection *c = &client->connections[i];
+            if (!c->waiting && c->scheduledAt <= now) {
+                if (!BenchClientSend(client, c)) {
+                    client->errors++;
+                    c->scheduledAt += client->interval > 0 ? client->interval : 0.01;
+                    c->waiting = false;
+                }
+            }
+            if (!c->waiting && c->scheduledAt < wake) {
+                wake = c->scheduledAt;
+            }
+            fds[i] = (struct pollfd){.fd = c->waiting ? c->fd : -1, .events = POLLIN};
+        }
+        int timeout = wake > now ? (int)((wake - now) * 1000.0) : 0;
+        int ready = poll(fds, client->connectionCount, timeout);
+        if (ready <= 0) {
+            continue;
+        }
+        now = BenchNow();
+        for (unsigned i = 0; i < client->connectionCount; i++) {
+            if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+                continue;
+            }
+            BenchConnection *c = &client->connections[i];
+            ssize_t count = recv(c->fd, c->data + c->length, sizeof(c->data) - c->length, 0);
+            if (count <= 0) {
+                if (count < 0 && (errno == EAGAIN || errno == EINTR)) {
+                    continue;
+                }
+                client->errors++;
+                close(c->fd);
+                c->fd = -1;
+                BenchClientNext(client, c, now);
+                continue;
+            }
+            c->length += (size_t)count;
+            int status = 0;
+            size_t bodyOffset = 0;
+            long total = BenchResponseLength(c->data, c->length, false, &status, &bodyOffset);
+            if (total == 0 && c->length < sizeof(c->data)) {
+                continue;
+            }
+            if (total <= 0 || (size_t)total != c->length || status != 200) {
+                client->errors++;
+            } else {
+                client->responses++;
+                if (c->scheduledAt >= client->measureFrom) {
+                    BenchClientRecord(client, c->endpoint, now - c->scheduledAt);
+                }
+            }
+            if (client->reconnect || total <= 0) {
+                close(c->fd);
+                c->fd = -1;
+            }
+            BenchClientNext(client, c, now);
+        }
+    }
+
+    for (unsigned i = 0; i < client->connectionCount; i++) {
+        if (client->connections[i].fd >= 0) {
+            close(client->connections[i].fd);
+        }
+    }
+    free(fds);
+    return NULL;
+}
+
+static int BenchCompareDouble(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double BenchPercentile(const double *sorted, size_t count, double percentile) {
+    if (count == 0) {
+        return 0;
+    }
+    size_t index = (size_t)(percentile * (double)(count - 1) + 0.5);
+    return sorted[index < count ? index : count - 1];
+}
+
+int main(int argc, char **argv) {
+    unsigned connections = 1000;
+    // Client threads compete with the server for cores; keep them to half
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned threads = cores >= 8 ? 4 : (cores >= 2 ? (unsigned)cores / 2 : 1);
+    unsigned workers = 4;
+    double seconds = 5.0;
+    double rate = 10000.0;
+    bool reconnect = false;
+    BenchAPI api = {.feedCount = 12};
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--connections") == 0 && i + 1 < argc) {
+            connections = (unsigned)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+            rate = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            seconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = (unsigned)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            workers = (unsigned)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--feeds") == 0 && i + 1 < argc) {
+            api.feedCount = (unsigned)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--close") == 0) {
+            reconnect = true;
+        } else {
+            fprintf(stderr, "usage: %s [--connections N] [--rate REQ/S] [--seconds S] [--threads T] [--workers W] [--feeds F] [--close]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (connections == 0) {
+        connections = 1;
+    }
+    if (threads == 0) {
+        threads = 1;
+    }
+    if (threads > connections) {
+        threads = connections;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    // Both ends of every connection live in this process
+    struct rlimit limit;
+    getrlimit(RLIMIT_NOFILE, &limit);
+    if (limit.rlim_cur < 2 * connections + 64) {
+        limit.rlim_cur = limit.rlim_max < 2 * connections + 64 ? limit.rlim_max : 2 * connections + 64;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    RTSPHTTPServerConfig config;
+    RTSPHTTPServerConfigInit(&config);
+    config.bindAddress = "127.0.0.1";
+    config.port = 0;
+    config.workerCount = workers;
+    RTSPHTTPServerRef server = RTSPHTTPServerCreate(&config);
+    if (!server) {
+        fprintf(stderr, "failed to create server\n");
+        return 1;
+    }
+    uint32_t methods = RTSPHTTPMethodGET | RTSPHTTPMethodPOST;
+    bool routed = RTSPHTTPServerAddRoute(server, methods, "/api/feeds", BenchHandleFeeds, &api) &&
+                  RTSPHTTPServerAddRoute(server, methods, "/api/current", BenchHandleCurrent, &api) &&
+                  RTSPHTTPServerAddRoute(server, methods, "/api/switch/:index", BenchHandleSwitch, &api) &&
+                  RTSPHTTPServerAddRoute(server, RTSP_HTTP_METHOD_ANY & ~RTSPHTTPMethodDELETE, "/*",
+                                         BenchHandleNotFound, &api);
+    if (!routed || !RTSPHTTPServerStart(server)) {
+        fprintf(stderr, "failed to start server\n");
+        return 1;
+    }
+    uint16_t port = RTSPHTTPServerPort(server);
+
+    char pacing[48];
+    snprintf(pacing, sizeof(pacing), rate > 0 ? "%.0f req/s" : "closed loop", rate);
+    printf("http_bench: %u %s connections, %s, %u client threads, %u workers, %.0f s\n",
+           connections, reconnect ? "one-shot" : "keep-alive", pacing, threads, workers, seconds);
+
+    unsigned failures = BenchProtocolChecks(port);
+    printf("  protocol checks:                %s\n", failures ? "FAILED" : "ok");
+
+    BenchClient *clients = calloc(threads, sizeof(*clients));
+    pthread_t *clientThreads = calloc(threads, sizeof(*clientThreads));
+    BenchConnection *pool = calloc(connections, sizeof(*pool));
+    double start = BenchNow();
+    unsigned assigned = 0;
+    for (unsigned t = 0; t < threads; t++) {
+        unsigned count = connections / threads + (t < connections % threads ? 1 : 0);
+        clients[t] = (BenchClient){
+            .port = port,
+            .connectionCount = count,
+            .reconnect = reconnect,
+            .interval = rate > 0 ? connections / rate : 0,
+            .measureFrom = start + 1.0,     // Excludes connection setup
+            .deadline = start + 1.0 + seconds,
+            .connections = pool + assigned,
+        };
+        assigned += count;
+    }
+    for (unsigned t = 0; t < threads; t++) {
+        pthread_create(&clientThreads[t], NULL, BenchClientThread, &clients[t]);
+    }
+    for (unsigned t = 0; t < threads; t++) {
+        pthread_join(clientThreads[t], NULL);
+    }
+    RTSPHTTPServerStatistics statistics = RTSPHTTPServerGetStatistics(server);
+
+    uint64_t errors = 0, responses = 0;
+    size_t measured = 0;
+    bool targetsMet = true;
+    for (unsigned t = 0; t < threads; t++) {
+        errors += clients[t].errors;
+        responses += clients[t].responses;
+    }
+    for (int e = 0; e < BenchEndpointCount; e++) {
+        size_t count = 0;
+        for (unsigned t = 0; t < threads; t++) {
+            count += clients[t].sampleCount[e];
+        }
+        double *samples = malloc((count ? count : 1) * sizeof(*samples));
+        size_t offset = 0;
+        for (unsigned t = 0; t < threads; t++) {
+            memcpy(samples + offset, clients[t].samples[e], clients[t].sampleCount[e] * sizeof(*samples));
+            offset += clients[t].sampleCount[e];
+            free(clients[t].samples[e]);
+        }
+        qsort(samples, count, sizeof(*samples), BenchCompareDouble);
+        double p50 = BenchPercentile(samples, count, 0.50) * 1000.0;
+        double p99 = BenchPercentile(samples, count, 0.99) * 1000.0;
+        double max = count ? samples[count - 1] * 1000.0 : 0;
+        // Closed-loop latency is set by the connection count, so only paced runs are judged
+        bool met = count > 0 && (rate <= 0 || (p50 <= BENCH_TARGET_P50_MS && p99 <= BENCH_TARGET_P99_MS));
+        targetsMet = targetsMet && met;
+        printf("  %-14s %9.0f req/s   p50 %6.2f ms   p99 %6.2f ms   max %7.2f ms   %s\n",
+               BenchEndpointNames[e], count / seconds, p50, p99, max, !met ? "MISSED" : rate > 0 ? "ok" : "");
+        measured += count;
+        free(samples);
+    }
+    printf("  targets:                        p50 <= %.0f ms, p99 <= %.0f ms\n", BENCH_TARGET_P50_MS, BENCH_TARGET_P99_MS);
+    printf("  total:                          %9.0f req/s, %llu errors, %llu rejected (503)\n",
+           measured / seconds, (unsigned long long)errors, (unsigned long long)statistics.rejectedRequests);
+    printf("  server:                         %llu requests, %u connections open, queue high water %u\n",
+           (unsigned long long)statistics.requests, statistics.connections, statistics.queueHighWater);
+
+    RTSPHTTPServerRelease(server);
+    free(pool);
+    free(clients);
+    free(clientThreads);
+
+    if (failures > 0 || errors > 0 || !targetsMet || responses == 0) {
+        fprintf(stderr, "FAIL: %u protocol check(s), %llu errors%s\n", failures,
+                (unsigned long long)errors, targetsMet ? "" : ", latency targets missed");
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
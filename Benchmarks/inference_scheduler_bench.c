@@ -0,0 +1,595 @@
+//
+//  inference_scheduler_bench.c
+//  RTSP Rotator Benchmarks
+//
+//  Benchmark for RTSPInferenceScheduler with a CPU backend: the "model" is
+//  one dense layer with int8 weights, dequantized once per backend call
+//  and shared by every frame in the batch, the same trade a GPU or ONNX
+//  Runtime session makes with its dispatch and weight traffic. Cameras
+//  submit frames at a fixed rate, more than per-frame inference can keep
+//  up with, and three setups are compared:
+//
+//    fifo       every frame queued for a small thread pool, one inference
+//               per frame (the old dispatch-per-frame behaviour)
+//    per-frame  the scheduler with batches of one
+//    batched    the scheduler with batches of up to 8
+//
+//  Reports inferred frames per second, frames dropped as replaced or stale,
+//  the frames still queued at the end, and capture-to-result latency
+//  p50/p99.
+//
+//  Checks: every accepted frame completes exactly once; each camera's
+//  results arrive in capture order; no frame older than maxFrameAge is
+//  inferred; the concurrency cap holds; cameras are served evenly; batching
+//  raises throughput; inferenceInterval and camera removal behave.
+//
+//  Build (Linux / macOS):
+//    cc -O2 -std=gnu11 -I"../RTSP Rotator" inference_scheduler_bench.c "../RTSP Rotator/RTSPInferenceScheduler.c" -lpthread -lm -o inference_scheduler_bench
+//
+//  Usage: inference_scheduler_bench [--cameras N] [--fps F] [--seconds S]
+//
+
+#define _GNU_SOURCE
+
+#include "RTSPInferenceScheduler.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_INPUTS 1024
+#define BENCH_OUTPUTS 4096              // 1024 x 4096 int8 weights
+#define BENCH_MAX_CAMERAS 256
+#define BENCH_MAX_CONCURRENT 8
+#define BENCH_MAX_FRAME_AGE 0.25
+#define BENCH_TARGET_BATCH_SPEEDUP 1.3  // Batched over per-frame inferred frames per second
+#define BENCH_TARGET_FAIRNESS 0.7       // Fewest / most frames inferred for any camera
+
+static double BenchNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void BenchSleep(double seconds) {
+    struct timespec ts = {(time_t)seconds, (long)((seconds - (double)(time_t)seconds) * 1e9)};
+    nanosleep(&ts, NULL);
+}
+
+static int BenchCompareDouble(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double BenchPercentile(const double *sorted, size_t count, double percentile) {
+    if (count == 0) {
+        return 0;
+    }
+    size_t index = (size_t)(percentile * (double)(count - 1) + 0.5);
+    return sorted[index < count ? index : count - 1];
+}
+
+static unsigned BenchCheck(bool condition, const char *what) {
+    if (!condition) {
+        fprintf(stderr, "  check failed: %s\n", what);
+    }
+    return condition ? 0 : 1;
+}
+
+static uint32_t BenchRandom(uint32_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+#pragma mark - Model
+
+typedef struct {
+    uint32_t camera;
+    uint64_t sequence;
+    double captured;
+    float features[BENCH_INPUTS];
+    float score;
+} BenchFrame;
+
+static int8_t *gWeights;
+static float gScales[BENCH_INPUTS];
+
+/// One dense layer over a batch with int8 weights, stored input-major. Each
+/// weight row is dequantized once per call and applied to every frame in the
+/// batch, so a batch shares the per-call work the way a GPU or ONNX Runtime
+/// batch shares its dispatch and weight traffic.
+static void BenchForward(BenchFrame **frames, size_t count) {
+    float *outputs = calloc(count * BENCH_OUTPUTS, sizeof(float));
+    float *row = malloc(BENCH_OUTPUTS * sizeof(float));
+    for (size_t i = 0; i < BENCH_INPUTS; i++) {
+        const int8_t *quantized = gWeights + i * BENCH_OUTPUTS;
+        float scale = gScales[i];
+        for (size_t o = 0; o < BENCH_OUTPUTS; o++) {
+            row[o] = (float)quantized[o] * scale;
+        }
+        for (size_t b = 0; b < count; b++) {
+            float x = frames[b]->features[i];
+            float *y = outputs + b * BENCH_OUTPUTS;
+            for (size_t o = 0; o < BENCH_OUTPUTS; o++) {
+                y[o] += row[o] * x;
+            }
+        }
+    }
+    for (size_t b = 0; b < count; b++) {
+        const float *y = outputs + b * BENCH_OUTPUTS;
+        float best = y[0];
+        for (size_t o = 1; o < BENCH_OUTPUTS; o++) {
+            best = y[o] > best ? y[o] : best;
+        }
+        frames[b]->score = best;
+    }
+    free(row);
+    free(outputs);
+}
+
+#pragma mark - Run State
+
+typedef struct {
+    pthread_mutex_t lock;
+    uint32_t cameras;
+    double *latencies;
+    size_t latencyCount;
+    size_t latencyCapacity;
+    uint64_t inferredPerCamera[BENCH_MAX_CAMERAS];
+    uint64_t lastSequence[BENCH_MAX_CAMERAS];
+    uint64_t completions[5];            // By RTSPInferenceOutcome
+    uint64_t accepted;
+    unsigned outOfOrder;
+    unsigned tooOld;
+    atomic_uint inBackend;
+    atomic_uint inBackendHighWater;
+    uint32_t concurrencyCap;
+} BenchRun;
+
+static void BenchRunInit(BenchRun *run, uint32_t cameras, size_t expectedFrames, uint32_t concurrencyCap) {
+    memset(run, 0, sizeof(*run));
+    pthread_mutex_init(&run->lock, NULL);
+    run->cameras = cameras;
+    run->latencyCapacity = expectedFrames + 16;
+    run->latencies = calloc(run->latencyCapacity, sizeof(double));
+    run->concurrencyCap = concurrencyCap;
+}
+
+static void BenchRunFree(BenchRun *run) {
+    free(run->latencies);
+    pthread_mutex_destroy(&run->lock);
+}
+
+static void BenchRunInfer(BenchRun *run, BenchFrame **frames, size_t count, double maxAge) {
+    unsigned inside = atomic_fetch_add(&run->inBackend, (unsigned)count) + (unsigned)count;
+    unsigned high = atomic_load(&run->inBackendHighWater);
+    while (inside > high && !atomic_compare_exchange_weak(&run->inBackendHighWater, &high, inside)) {
+    }
+    double now = BenchNow();
+    for (size_t i = 0; i < count; i++) {
+        if (maxAge > 0 && now - frames[i]->captured > maxAge + 0.002) {
+            pthread_mutex_lock(&run->lock);
+            run->tooOld++;
+            pthread_mutex_unlock(&run->lock);
+        }
+    }
+    BenchForward(frames, count);
+    atomic_fetch_sub(&run->inBackend, (unsigned)count);
+}
+
+static void BenchRunComplete(BenchRun *run, BenchFrame *frame, RTSPInferenceOutcome outcome) {
+    double latency = BenchNow() - frame->captured;
+    pthread_mutex_lock(&run->lock);
+    run->completions[outcome]++;
+    if (outcome == RTSPInferenceOutcomeInferred) {
+        if (run->latencyCount < run->latencyCapacity) {
+            run->latencies[run->latencyCount++] = latency;
+        }
+        run->inferredPerCamera[frame->camera]++;
+        if (frame->sequence < run->lastSequence[frame->camera]) {
+            run->outOfOrder++;
+        }
+        run->lastSequence[frame->camera] = frame->sequence;
+    }
+    pthread_mutex_unlock(&run->lock);
+    free(frame);
+}
+
+static BenchFrame *BenchMakeFrame(uint32_t camera, uint64_t sequence, uint32_t *seed) {
+    BenchFrame *frame = malloc(sizeof(*frame));
+    frame->camera = camera;
+    frame->sequence = sequence;
+    frame->captured = BenchNow();
+    for (size_t i = 0; i < BENCH_INPUTS; i += 16) {
+        frame->features[i] = (float)(BenchRandom(seed) & 0xffff) / 65536.0f;
+        for (size_t j = 1; j < 16; j++) {
+            frame->features[i + j] = frame->features[i] * (float)j;
+        }
+    }
+    return frame;
+}
+
+typedef struct {
+    double inferredPerSecond;
+    double p50;
+    double p99;
+    uint64_t dropped;
+    uint64_t backlog;
+    double fairness;
+} BenchResult;
+
+static BenchResult BenchSummarize(BenchRun *run, double seconds, uint64_t backlog) {
+    BenchResult result = {0};
+    qsort(run->latencies, run->latencyCount, sizeof(double), BenchCompareDouble);
+    result.inferredPerSecond = (double)run->completions[RTSPInferenceOutcomeInferred] / seconds;
+    result.p50 = BenchPercentile(run->latencies, run->latencyCount, 0.50) * 1000.0;
+    result.p99 = BenchPercentile(run->latencies, run->latencyCount, 0.99) * 1000.0;
+    result.dropped = run->completions[RTSPInferenceOutcomeReplaced] + run->completions[RTSPInferenceOutcomeStale];
+    result.backlog = backlog;
+    uint64_t fewest = UINT64_MAX, most = 0;
+    for (uint32_t c = 0; c < run->cameras; c++) {
+        if (run->inferredPerCamera[c] < fewest) fewest = run->inferredPerCamera[c];
+        if (run->inferredPerCamera[c] > most) most = run->inferredPerCamera[c];
+    }
+    result.fairness = most > 0 ? (double)fewest / (double)most : 0;
+    return result;
+}
+
+static void BenchPrint(const char *name, const BenchResult *result) {
+    printf("  %-10s %6.0f inferred/s, dropped %6llu, queued at end %6llu, latency p50 %7.1f ms p99 %7.1f ms, fairness %.2f\n",
+           name, result->inferredPerSecond, (unsigned long long)result->dropped, (unsigned long long)result->backlog,
+           result->p50, result->p99, result->fairness);
+}
+
+#pragma mark - Producer
+
+typedef bool (*BenchSubmit)(void *context, uint32_t camera, BenchFrame *frame);
+
+/// Cameras capture at `fps` with staggered phases for `seconds`
+static uint64_t BenchProduce(uint32_t cameras, double fps, double seconds, BenchSubmit submit, void *context) {
+    uint32_t seed = 0x1234567u;
+    double start = BenchNow();
+    double *next = calloc(cameras, sizeof(double));
+    uint64_t *sequence = calloc(cameras, sizeof(uint64_t));
+    uint64_t accepted = 0;
+    for (uint32_t c = 0; c < cameras; c++) {
+        next[c] = start + (double)c / (double)cameras / fps;
+    }
+    for (;;) {
+        double now = BenchNow();
+        if (now - start >= seconds) {
+            break;
+        }
+        double soonest = start + seconds;
+        for (uint32_t c = 0; c < cameras; c++) {
+            while (next[c] <= now) {
+                BenchFrame *frame = BenchMakeFrame(c, ++sequence[c], &seed);
+                if (submit(context, c, frame)) {
+                    accepted++;
+                } else {
+                    free(frame);
+                }
+                next[c] += 1.0 / fps;
+            }
+            if (next[c] < soonest) {
+                soonest = next[c];
+            }
+        }
+        double wait = soonest - BenchNow();
+        if (wait > 0) {
+            BenchSleep(wait);
+        }
+    }
+    free(next);
+    free(sequence);
+    return accepted;
+}
+
+#pragma mark - FIFO Baseline
+
+typedef struct BenchQueued {
+    BenchFrame *frame;
+    struct BenchQueued *next;
+} BenchQueued;
+
+typedef struct {
+    BenchRun *run;
+    pthread_mutex_t lock;
+    pthread_cond_t available;
+    BenchQueued *head;
+    BenchQueued *tail;
+    uint64_t queued;
+    bool stopping;
+} BenchFIFO;
+
+static void *BenchFIFOThread(void *argument) {
+    BenchFIFO *fifo = argument;
+    for (;;) {
+        pthread_mutex_lock(&fifo->lock);
+        while (!fifo->stopping && !fifo->head) {
+            pthread_cond_wait(&fifo->available, &fifo->lock);
+        }
+        if (fifo->stopping) {
+            pthread_mutex_unlock(&fifo->lock);
+            return NULL;
+        }
+        BenchQueued *item = fifo->head;
+        fifo->head = item->next;
+        if (!fifo->head) {
+            fifo->tail = NULL;
+        }
+        fifo->queued--;
+        pthread_mutex_unlock(&fifo->lock);
+
+        BenchRunInfer(fifo->run, &item->frame, 1, 0);
+        BenchRunComplete(fifo->run, item->frame, RTSPInferenceOutcomeInferred);
+        free(item);
+    }
+}
+
+static bool BenchFIFOSubmit(void *context, uint32_t camera, BenchFrame *frame) {
+    (void)camera;
+    BenchFIFO *fifo = context;
+    BenchQueued *item = calloc(1, sizeof(*item));
+    item->frame = frame;
+    pthread_mutex_lock(&fifo->lock);
+    if (fifo->tail) {
+        fifo->tail->next = item;
+    } else {
+        fifo->head = item;
+    }
+    fifo->tail = item;
+    fifo->queued++;
+    pthread_cond_signal(&fifo->available);
+    pthread_mutex_unlock(&fifo->lock);
+    return true;
+}
+
+static BenchResult BenchRunFIFO(uint32_t cameras, double fps, double seconds, uint32_t threads) {
+    BenchRun run;
+    BenchRunInit(&run, cameras, (size_t)(cameras * fps * seconds), BENCH_MAX_CONCURRENT);
+    BenchFIFO fifo = {.run = &run};
+    pthread_mutex_init(&fifo.lock, NULL);
+    pthread_cond_init(&fifo.available, NULL);
+    pthread_t workers[BENCH_MAX_CONCURRENT];
+    for (uint32_t i = 0; i < threads; i++) {
+        pthread_create(&workers[i], NULL, BenchFIFOThread, &fifo);
+    }
+
+    BenchProduce(cameras, fps, seconds, BenchFIFOSubmit, &fifo);
+
+    pthread_mutex_lock(&fifo.lock);
+    fifo.stopping = true;
+    uint64_t backlog = fifo.queued;
+    pthread_cond_broadcast(&fifo.available);
+    pthread_mutex_unlock(&fifo.lock);
+    for (uint32_t i = 0; i < threads; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    while (fifo.head) {
+        BenchQueued *item = fifo.head;
+        fifo.head = item->next;
+        free(item->frame);
+        free(item);
+    }
+    BenchResult result = BenchSummarize(&run, seconds, backlog);
+    pthread_cond_destroy(&fifo.available);
+    pthread_mutex_destroy(&fifo.lock);
+    BenchRunFree(&run);
+    return result;
+}
+
+#pragma mark - Scheduler Runs
+
+typedef struct {
+    BenchRun *run;
+    RTSPInferenceSchedulerRef scheduler;
+    uint32_t slots[BENCH_MAX_CAMERAS];
+} BenchSchedulerContext;
+
+static void BenchBackendInfer(void *context, RTSPInferenceJob *jobs, size_t count) {
+    BenchRun *run = context;
+    BenchFrame *frames[BENCH_MAX_CONCURRENT];
+    for (size_t i = 0; i < count; i++) {
+        frames[i] = jobs[i].frame;
+    }
+    BenchRunInfer(run, frames, count, BENCH_MAX_FRAME_AGE);
+}
+
+static void BenchSchedulerCompletion(void *context, const RTSPInferenceJob *job, RTSPInferenceOutcome outcome) {
+    BenchRunComplete(context, job->frame, outcome);
+}
+
+static bool BenchSchedulerSubmit(void *context, uint32_t camera, BenchFrame *frame) {
+    BenchSchedulerContext *bench = context;
+    return RTSPInferenceSchedulerSubmit(bench->scheduler, bench->slots[camera], frame, NULL) == RTSPInferenceSubmitQueued;
+}
+
+static unsigned BenchRunScheduler(const char *name, uint32_t cameras, double fps, double seconds, uint32_t maxBatch,
+                                  BenchResult *result) {
+    unsigned failures = 0;
+    BenchRun run;
+    BenchRunInit(&run, cameras, (size_t)(cameras * fps * seconds), BENCH_MAX_CONCURRENT);
+
+    RTSPInferenceSchedulerConfig config;
+    RTSPInferenceSchedulerConfigInit(&config);
+    config.maxConcurrent = BENCH_MAX_CONCURRENT;
+    config.maxBatch = maxBatch;
+    config.workerCount = 2;
+    config.maxCameras = cameras;
+    config.maxFrameAge = BENCH_MAX_FRAME_AGE;
+    RTSPInferenceBackend backend = {.context = &run, .maxBatch = BENCH_MAX_CONCURRENT, .infer = BenchBackendInfer};
+
+    BenchSchedulerContext bench = {.run = &run};
+    bench.scheduler = RTSPInferenceSchedulerCreate(&config, &backend, BenchSchedulerCompletion, &run);
+    for (uint32_t c = 0; c < cameras; c++) {
+        bench.slots[c] = RTSPInferenceSchedulerAddCamera(bench.scheduler);
+    }
+
+    uint64_t accepted = BenchProduce(cameras, fps, seconds, BenchSchedulerSubmit, &bench);
+
+    RTSPInferenceSchedulerStatistics statistics = RTSPInferenceSchedulerGetStatistics(bench.scheduler);
+    RTSPInferenceSchedulerRelease(bench.scheduler);
+    uint64_t backlog = run.completions[RTSPInferenceOutcomeCancelled];    // At most one per camera
+
+    *result = BenchSummarize(&run, seconds, backlog);
+    BenchPrint(name, result);
+
+    uint64_t completions = 0;
+    for (int i = 0; i < 5; i++) {
+        completions += run.completions[i];
+    }
+    char what[128];
+    snprintf(what, sizeof(what), "%s: %llu frames accepted, %llu completions", name, (unsigned long long)accepted,
+             (unsigned long long)completions);
+    failures += BenchCheck(completions == accepted, what);
+    snprintf(what, sizeof(what), "%s: %u results out of capture order", name, run.outOfOrder);
+    failures += BenchCheck(run.outOfOrder == 0, what);
+    snprintf(what, sizeof(what), "%s: %u frames inferred after maxFrameAge", name, run.tooOld);
+    failures += BenchCheck(run.tooOld == 0, what);
+    snprintf(what, sizeof(what), "%s: %u frames in the backend at once (cap %u)", name,
+             atomic_load(&run.inBackendHighWater), BENCH_MAX_CONCURRENT);
+    failures += BenchCheck(atomic_load(&run.inBackendHighWater) <= BENCH_MAX_CONCURRENT &&
+                           statistics.inFlightHighWater <= BENCH_MAX_CONCURRENT, what);
+    snprintf(what, sizeof(what), "%s: fairness %.2f (target >= %.2f)", name, result->fairness, BENCH_TARGET_FAIRNESS);
+    failures += BenchCheck(result->fairness >= BENCH_TARGET_FAIRNESS, what);
+    snprintf(what, sizeof(what), "%s: latency p99 %.0f ms past maxFrameAge", name, result->p99);
+    failures += BenchCheck(result->p99 <= BENCH_MAX_FRAME_AGE * 1000.0 * 1.5, what);
+    if (statistics.batches > 0) {
+        printf("             mean batch %.2f frames, %llu replaced, %llu stale\n",
+               (double)(statistics.inferred + statistics.failed) / (double)statistics.batches,
+               (unsigned long long)statistics.replaced, (unsigned long long)statistics.stale);
+    }
+    BenchRunFree(&run);
+    return failures;
+}
+
+#pragma mark - Behaviour Checks
+
+static void BenchNoopInfer(void *context, RTSPInferenceJob *jobs, size_t count) {
+    (void)context;
+    for (size_t i = 0; i < count; i++) {
+        jobs[i].failed = jobs[i].userData != NULL;
+    }
+}
+
+static void BenchCountCompletion(void *context, const RTSPInferenceJob *job, RTSPInferenceOutcome outcome) {
+    (void)job;
+    atomic_fetch_add(&((atomic_uint *)context)[outcome], 1);
+}
+
+static unsigned BenchCheckBehaviour(void) {
+    unsigned failures = 0;
+    atomic_uint outcomes[5] = {0};
+    RTSPInferenceSchedulerConfig config;
+    RTSPInferenceSchedulerConfigInit(&config);
+    config.inferenceInterval = 3;
+    config.maxCameras = 2;
+    RTSPInferenceBackend backend = {.infer = BenchNoopInfer};
+    RTSPInferenceSchedulerRef scheduler = RTSPInferenceSchedulerCreate(&config, &backend, BenchCountCompletion, outcomes);
+
+    uint32_t a = RTSPInferenceSchedulerAddCamera(scheduler);
+    uint32_t b = RTSPInferenceSchedulerAddCamera(scheduler);
+    failures += BenchCheck(RTSPInferenceSchedulerAddCamera(scheduler) == UINT32_MAX, "camera slots beyond maxCameras");
+    unsigned queued = 0, skipped = 0;
+    for (int i = 0; i < 9; i++) {
+        RTSPInferenceSubmitResult result = RTSPInferenceSchedulerSubmit(scheduler, a, NULL, NULL);
+        queued += result == RTSPInferenceSubmitQueued;
+        skipped += result == RTSPInferenceSubmitSkipped;
+        BenchSleep(0.002);
+    }
+    failures += BenchCheck(queued == 3 && skipped == 6, "inferenceInterval 3 queues every third frame");
+    RTSPInferenceSchedulerSubmit(scheduler, b, NULL, (void *)1);   // Marked failed by the backend
+    BenchSleep(0.05);
+    failures += BenchCheck(atomic_load(&outcomes[RTSPInferenceOutcomeFailed]) == 1, "backend failure reported");
+
+    RTSPInferenceSchedulerRemoveCamera(scheduler, b);
+    failures += BenchCheck(RTSPInferenceSchedulerSubmit(scheduler, b, NULL, NULL) == RTSPInferenceSubmitRejected,
+                           "removed camera rejects frames");
+    failures += BenchCheck(RTSPInferenceSchedulerAddCamera(scheduler) == b, "removed camera slot reused");
+    RTSPInferenceSchedulerRelease(scheduler);
+
+    unsigned total = 0;
+    for (int i = 0; i < 5; i++) {
+        total += atomic_load(&outcomes[i]);
+    }
+    failures += BenchCheck(total == queued + 1, "every queued frame completes once");
+    printf("  interval, failure and camera removal checks: %s\n", failures ? "FAILED" : "ok");
+    return failures;
+}
+
+#pragma mark - Main
+
+int main(int argc, char **argv) {
+    uint32_t cameras = 64;
+    double fps = 15.0;
+    double seconds = 3.0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--cameras") == 0 && i + 1 < argc) {
+            cameras = (uint32_t)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+            fps = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            seconds = atof(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--cameras N] [--fps F] [--seconds S]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (cameras == 0 || cameras > BENCH_MAX_CAMERAS) {
+        fprintf(stderr, "cameras must be 1-%d\n", BENCH_MAX_CAMERAS);
+        return 2;
+    }
+
+    gWeights = malloc((size_t)BENCH_INPUTS * BENCH_OUTPUTS);
+    uint32_t seed = 0xC0FFEEu;
+    for (size_t i = 0; i < (size_t)BENCH_INPUTS * BENCH_OUTPUTS; i++) {
+        gWeights[i] = (int8_t)(BenchRandom(&seed) & 0xff);
+    }
+    for (size_t i = 0; i < BENCH_INPUTS; i++) {
+        gScales[i] = 1.0f / 128.0f;
+    }
+
+    printf("inference_scheduler_bench\n");
+    unsigned failures = BenchCheckBehaviour();
+
+    // Cost of one frame alone and of a full batch
+    BenchFrame *frames[BENCH_MAX_CONCURRENT];
+    for (int i = 0; i < BENCH_MAX_CONCURRENT; i++) {
+        frames[i] = BenchMakeFrame(0, 0, &seed);
+    }
+    double t0 = BenchNow();
+    for (int r = 0; r < 8; r++) BenchForward(frames, 1);
+    double single = (BenchNow() - t0) / 8;
+    t0 = BenchNow();
+    for (int r = 0; r < 4; r++) BenchForward(frames, BENCH_MAX_CONCURRENT);
+    double batch = (BenchNow() - t0) / 4;
+    for (int i = 0; i < BENCH_MAX_CONCURRENT; i++) free(frames[i]);
+    printf("  model: %.2f ms for one frame, %.2f ms for a batch of %d (%.2f ms per frame)\n", single * 1000.0,
+           batch * 1000.0, BENCH_MAX_CONCURRENT, batch * 1000.0 / BENCH_MAX_CONCURRENT);
+    printf("  %u cameras at %.0f fps (%.0f frames/s offered) for %.0f s\n", cameras, fps, cameras * fps, seconds);
+
+    BenchResult fifo = BenchRunFIFO(cameras, fps, seconds, 2);
+    BenchPrint("fifo", &fifo);
+    BenchResult perFrame, batched;
+    failures += BenchRunScheduler("per-frame", cameras, fps, seconds, 1, &perFrame);
+    failures += BenchRunScheduler("batched", cameras, fps, seconds, BENCH_MAX_CONCURRENT, &batched);
+
+    double speedup = perFrame.inferredPerSecond > 0 ? batched.inferredPerSecond / perFrame.inferredPerSecond : 0;
+    printf("  batching: %.2fx inferred frames per second over per-frame (target >= %.1fx)\n", speedup,
+           BENCH_TARGET_BATCH_SPEEDUP);
+    // Only meaningful when per-frame inference cannot keep up
+    if (cameras * fps > perFrame.inferredPerSecond * 1.1) {
+        failures += BenchCheck(speedup >= BENCH_TARGET_BATCH_SPEEDUP, "batched throughput over per-frame");
+    }
+
+    free(gWeights);
+    printf("%s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
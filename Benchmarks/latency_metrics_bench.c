@@ -0,0 +1,367 @@
+//
+//  latency_metrics_bench.c
+//  RTSP Rotator Benchmarks
+//
+//  Benchmark for RTSPLatencyMetrics, the detection pipeline's per-stage
+//  latency histograms. Measures the cost of recording one duration from
+//  one thread and from several threads hitting the same histogram, against
+//  the processor's old running total behind a lock, and how far the
+//  histogram's percentiles are from exact ones over a skewed distribution.
+//
+//  Checks: percentiles within the histogram's precision from 1 us to
+//  minutes; exact counts and sums under concurrent recording; merged
+//  summaries; camera registration and its limit; trace sampling by
+//  interval and by slow frames; the Prometheus text (cumulative buckets,
+//  +Inf, _sum and _count, label escaping, truncation); reset.
+//
+//  Build (Linux / macOS):
+//    cc -O2 -std=gnu11 -I"../RTSP Rotator" latency_metrics_bench.c "../RTSP Rotator/RTSPLatencyMetrics.c" -lpthread -lm -o latency_metrics_bench
+//
+//  Usage: latency_metrics_bench [--threads N] [--records N]
+//
+
+#define _GNU_SOURCE
+
+#include "RTSPLatencyMetrics.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_TARGET_RECORD_NS 100.0    // One record from one thread
+#define BENCH_PRECISION 0.035           // Relative percentile error allowed
+
+static double BenchNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static int BenchCompareDouble(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static unsigned BenchCheck(bool condition, const char *what) {
+    if (!condition) {
+        fprintf(stderr, "  check failed: %s\n", what);
+    }
+    return condition ? 0 : 1;
+}
+
+static uint32_t BenchRandom(uint32_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static double BenchUniform(uint32_t *state) {
+    return ((double)BenchRandom(state) + 1.0) / 4294967297.0;
+}
+
+/// Log-normal inference-like latency: median 20 ms with a long tail
+static double BenchLatency(uint32_t *state) {
+    double normal = sqrt(-2.0 * log(BenchUniform(state))) * cos(6.283185307179586 * BenchUniform(state));
+    return 0.020 * exp(0.8 * normal);
+}
+
+/// Exact percentile with the same rank rule as the histogram
+static double BenchExactPercentile(const double *sorted, size_t count, double percentile) {
+    size_t rank = (size_t)(percentile * (double)count + 0.5);
+    rank = rank < 1 ? 1 : rank > count ? count : rank;
+    return sorted[rank - 1];
+}
+
+static bool BenchClose(double value, double expected) {
+    return fabs(value - expected) <= BENCH_PRECISION * expected + 1e-6;
+}
+
+static RTSPLatencyMetricsRef BenchCreate(uint32_t maxCameras, uint32_t traceInterval, double slowTrace) {
+    RTSPLatencyMetricsConfig config;
+    RTSPLatencyMetricsConfigInit(&config);
+    config.maxCameras = maxCameras;
+    config.traceInterval = traceInterval;
+    config.slowTrace = slowTrace;
+    return RTSPLatencyMetricsCreate(&config);
+}
+
+#pragma mark - Behaviour
+
+static unsigned BenchCheckAccuracy(void) {
+    unsigned failures = 0;
+    RTSPLatencyMetricsRef metrics = BenchCreate(4, 0, 0);
+    uint32_t camera = RTSPLatencyMetricsAddCamera(metrics, "front");
+
+    // Single values across the range come back within precision
+    bool single = true;
+    for (double seconds = 1e-6; seconds < 600; seconds *= 1.37) {
+        RTSPLatencyMetricsReset(metrics);
+        RTSPLatencyMetricsRecord(metrics, camera, RTSPLatencyStageInference, seconds);
+        RTSPLatencySummary summary = RTSPLatencyMetricsGetSummary(metrics, camera, RTSPLatencyStageInference);
+        if (summary.count != 1 || !BenchClose(summary.p50, seconds) || !BenchClose(summary.max, seconds)) {
+            fprintf(stderr, "  %.9f s read back as %.9f\n", seconds, summary.p50);
+            single = false;
+        }
+    }
+    failures += BenchCheck(single, "single values read back within precision");
+
+    // Percentiles of a skewed distribution against a sort
+    RTSPLatencyMetricsReset(metrics);
+    size_t count = 200000;
+    double *samples = malloc(count * sizeof(double));
+    uint32_t seed = 0x1234567u;
+    double sum = 0;
+    for (size_t i = 0; i < count; i++) {
+        samples[i] = BenchLatency(&seed);
+        sum += samples[i];
+        RTSPLatencyMetricsRecord(metrics, camera, RTSPLatencyStageInference, samples[i]);
+    }
+    qsort(samples, count, sizeof(double), BenchCompareDouble);
+    RTSPLatencySummary summary = RTSPLatencyMetricsGetSummary(metrics, camera, RTSPLatencyStageInference);
+    double exact[] = {BenchExactPercentile(samples, count, 0.5), BenchExactPercentile(samples, count, 0.9),
+                      BenchExactPercentile(samples, count, 0.99), BenchExactPercentile(samples, count, 0.999)};
+    double measured[] = {summary.p50, summary.p90, summary.p99, summary.p999};
+    double worst = 0;
+    for (int q = 0; q < 4; q++) {
+        worst = fmax(worst, fabs(measured[q] - exact[q]) / exact[q]);
+    }
+    printf("  accuracy: p50 %.2f ms (exact %.2f), p99 %.2f ms (exact %.2f), p99.9 %.2f ms (exact %.2f), worst error %.2f%%\n",
+           summary.p50 * 1000, exact[0] * 1000, summary.p99 * 1000, exact[2] * 1000, summary.p999 * 1000,
+           exact[3] * 1000, worst * 100);
+    failures += BenchCheck(worst <= BENCH_PRECISION, "percentiles within precision of a sort");
+    failures += BenchCheck(summary.count == count && fabs(summary.sum - sum) < count * 1e-6, "count and sum");
+    failures += BenchCheck(BenchClose(summary.max, samples[count - 1]), "max");
+    free(samples);
+
+    // Nothing recorded for the other stages; durations out of range are ignored
+    failures += BenchCheck(RTSPLatencyMetricsGetSummary(metrics, camera, RTSPLatencyStageGrab).count == 0,
+                           "other stages empty");
+    RTSPLatencyMetricsRecord(metrics, camera, RTSPLatencyStageGrab, -1);
+    RTSPLatencyMetricsRecord(metrics, camera, RTSPLatencyStageGrab, NAN);
+    RTSPLatencyMetricsRecord(metrics, 3, RTSPLatencyStageGrab, 0.01);
+    RTSPLatencyMetricsRecord(metrics, camera, RTSPLatencyStageCount, 0.01);
+    failures += BenchCheck(RTSPLatencyMetricsGetSummary(metrics, camera, RTSPLatencyStageGrab).count == 0,
+                           "negative, NaN and unknown camera ignored");
+    RTSPLatencyMetricsRecord(metrics, camera, RTSPLatencyStageGrab, 1e9);
+    summary = RTSPLatencyMetricsGetSummary(metrics, camera, RTSPLatencyStageGrab);
+    failures += BenchCheck(summary.count == 1 && summary.max > 4000 && summary.max < 4400, "huge values clamp at the top bucket");
+
+    RTSPLatencyMetricsRelease(metrics);
+    return failures;
+}
+
+static unsigned BenchCheckCameras(void) {
+    unsigned failures = 0;
+    failures += BenchCheck(BenchCreate(0, 0, 0) == NULL, "zero cameras rejected");
+
+    RTSPLatencyMetricsRef metrics = BenchCreate(3, 10, 0.5);
+    uint32_t a = RTSPLatencyMetricsAddCamera(metrics, "a");
+    uint32_t b = RTSPLatencyMetricsAddCamera(metrics, "b");
+    failures += BenchCheck(a == 0 && b == 1 && RTSPLatencyMetricsAddCamera(metrics, "a") == a, "cameras deduplicated");
+    failures += BenchCheck(RTSPLatencyMetricsAddCamera(metrics, "c") == 2, "third camera");
+    failures += BenchCheck(RTSPLatencyMetricsAddCamera(metrics, "d") == UINT32_MAX, "camera limit");
+
+    for (int i = 0; i < 100; i++) {
+        RTSPLatencyMetricsRecord(metrics, a, RTSPLatencyStageTotal, 0.010);
+        RTSPLatencyMetricsRecord(metrics, b, RTSPLatencyStageTotal, 0.030);
+    }
+    RTSPLatencySummary merged = RTSPLatencyMetricsGetSummary(metrics, UINT32_MAX, RTSPLatencyStageTotal);
+    failures += BenchCheck(merged.count == 200 && BenchClose(merged.p50, 0.010) && BenchClose(merged.p99, 0.030),
+                           "merged summary");
+
+    // Every 10th frame, plus every frame over 0.5 s
+    unsigned traced = 0, slow = 0;
+    for (int i = 0; i < 1000; i++) {
+        traced += RTSPLatencyMetricsShouldTrace(metrics, a, 0.02);
+    }
+    for (int i = 0; i < 5; i++) {
+        slow += RTSPLatencyMetricsShouldTrace(metrics, b, 0.75);
+    }
+    failures += BenchCheck(traced == 100, "trace interval");
+    failures += BenchCheck(slow == 5, "slow frames always traced");
+    failures += BenchCheck(!RTSPLatencyMetricsShouldTrace(metrics, 7, 1.0), "unknown camera not traced");
+
+    RTSPLatencyMetricsReset(metrics);
+    failures += BenchCheck(RTSPLatencyMetricsGetSummary(metrics, UINT32_MAX, RTSPLatencyStageTotal).count == 0,
+                           "reset empties histograms");
+    failures += BenchCheck(RTSPLatencyMetricsAddCamera(metrics, "b") == b, "reset keeps cameras");
+
+    RTSPLatencyMetricsRelease(metrics);
+    RTSPLatencyMetricsRelease(NULL);
+    return failures;
+}
+
+/// Value of the first line starting with `prefix`, or -1
+static double BenchMetric(const char *text, const char *prefix) {
+    size_t length = strlen(prefix);
+    for (const char *line = text; line && *line; line = strchr(line, '\n') ? strchr(line, '\n') + 1 : NULL) {
+        if (strncmp(line, prefix, length) == 0) {
+            return strtod(line + length, NULL);
+        }
+    }
+    return -1;
+}
+
+static unsigned BenchCheckPrometheus(void) {
+    unsigned failures = 0;
+    RTSPLatencyMetricsRef metrics = BenchCreate(4, 0, 0);
+    uint32_t lobby = RTSPLatencyMetricsAddCamera(metrics, "Lobby \"east\" \\ 2\nnew");
+    uint32_t yard = RTSPLatencyMetricsAddCamera(metrics, "Yard");
+    uint32_t seed = 99;
+    for (int i = 0; i < 5000; i++) {
+        RTSPLatencyMetricsRecord(metrics, lobby, RTSPLatencyStageInference, BenchLatency(&seed));
+        RTSPLatencyMetricsRecord(metrics, lobby, RTSPLatencyStageQueue, BenchLatency(&seed) / 10);
+    }
+    RTSPLatencyMetricsRecord(metrics, yard, RTSPLatencyStageZoneFilter, 0.00004);
+
+    size_t length = RTSPLatencyMetricsWritePrometheus(metrics, NULL, 0);
+    char *text = malloc(length + 1);
+    size_t written = RTSPLatencyMetricsWritePrometheus(metrics, text, length + 1);
+    failures += BenchCheck(written == length && strlen(text) == length, "length query matches the text");
+
+    const char *label = "camera=\"Lobby \\\"east\\\" \\\\ 2\\nnew\",stage=\"inference\"";
+    char prefix[256];
+    snprintf(prefix, sizeof(prefix), "rtsp_detection_stage_seconds_count{%s} ", label);
+    failures += BenchCheck(BenchMetric(text, prefix) == 5000, "escaped camera label and _count");
+    snprintf(prefix, sizeof(prefix), "rtsp_detection_stage_seconds_bucket{%s,le=\"+Inf\"} ", label);
+    failures += BenchCheck(BenchMetric(text, prefix) == 5000, "+Inf bucket is the count");
+    snprintf(prefix, sizeof(prefix), "rtsp_detection_stage_seconds_sum{%s} ", label);
+    RTSPLatencySummary summary = RTSPLatencyMetricsGetSummary(metrics, lobby, RTSPLatencyStageInference);
+    failures += BenchCheck(fabs(BenchMetric(text, prefix) - summary.sum) < 1e-3, "_sum");
+    snprintf(prefix, sizeof(prefix), "rtsp_detection_stage_quantile_seconds{%s,quantile=\"0.99\"} ", label);
+    failures += BenchCheck(fabs(BenchMetric(text, prefix) - summary.p99) < 1e-6, "p99 gauge");
+    failures += BenchCheck(BenchMetric(text, "rtsp_detection_stage_seconds_bucket{camera=\"Yard\",stage=\"zone_filter\",le=\"0.0005\"} ") == 1,
+                           "small value in the first bucket");
+    failures += BenchCheck(BenchMetric(text, "rtsp_detection_stage_seconds_count{camera=\"Yard\",stage=\"inference\"} ") < 0,
+                           "unrecorded stages left out");
+
+    // Buckets never decrease, and the bounds line up with a sort of the same samples
+    bool cumulative = true;
+    double previous = 0;
+    const char *bounds[] = {"0.0005", "0.001", "0.0025", "0.005", "0.01", "0.025", "0.05", "0.1", "0.25", "0.5", "1", "2.5", "5", "10"};
+    for (size_t b = 0; b < sizeof(bounds) / sizeof(bounds[0]); b++) {
+        snprintf(prefix, sizeof(prefix), "rtsp_detection_stage_seconds_bucket{%s,le=\"%s\"} ", label, bounds[b]);
+        double value = BenchMetric(text, prefix);
+        cumulative &= value >= previous;
+        previous = value;
+    }
+    failures += BenchCheck(cumulative && previous <= 5000, "buckets cumulative");
+
+    // Truncated output stays terminated and reports the full length
+    char small[64];
+    failures += BenchCheck(RTSPLatencyMetricsWritePrometheus(metrics, small, sizeof(small)) == length &&
+                           strlen(small) == sizeof(small) - 1,
+                           "truncation");
+    free(text);
+    RTSPLatencyMetricsRelease(metrics);
+    return failures;
+}
+
+#pragma mark - Throughput
+
+typedef struct {
+    RTSPLatencyMetricsRef metrics;
+    uint32_t camera;
+    uint32_t records;
+    bool locked;
+    double seconds;
+} BenchThread;
+
+// The processor's old statistics: a running total under @synchronized
+static pthread_mutex_t gLock = PTHREAD_MUTEX_INITIALIZER;
+static double gTotal;
+static uint64_t gCount;
+
+static void *BenchRecordThread(void *argument) {
+    BenchThread *thread = argument;
+    uint32_t seed = 0x9E3779B9u ^ (uint32_t)(uintptr_t)argument;
+    double *values = malloc(1024 * sizeof(double));
+    for (int i = 0; i < 1024; i++) {
+        values[i] = BenchLatency(&seed);
+    }
+    double start = BenchNow();
+    for (uint32_t i = 0; i < thread->records; i++) {
+        if (thread->locked) {
+            pthread_mutex_lock(&gLock);
+            gTotal += values[i & 1023];
+            gCount++;
+            pthread_mutex_unlock(&gLock);
+        } else {
+            RTSPLatencyMetricsRecord(thread->metrics, thread->camera, RTSPLatencyStageInference, values[i & 1023]);
+        }
+    }
+    thread->seconds = BenchNow() - start;
+    free(values);
+    return NULL;
+}
+
+/// ns per record per thread
+static double BenchRecordCost(RTSPLatencyMetricsRef metrics, uint32_t camera, unsigned threads, uint32_t records, bool locked) {
+    BenchThread state[64];
+    pthread_t handles[64];
+    for (unsigned t = 0; t < threads; t++) {
+        state[t] = (BenchThread){metrics, camera, records, locked, 0};
+        pthread_create(&handles[t], NULL, BenchRecordThread, &state[t]);
+    }
+    double worst = 0;
+    for (unsigned t = 0; t < threads; t++) {
+        pthread_join(handles[t], NULL);
+        worst = fmax(worst, state[t].seconds);
+    }
+    return worst * 1e9 / records;
+}
+
+int main(int argc, char **argv) {
+    unsigned threads = 4;
+    uint32_t records = 2000000;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = (unsigned)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--records") == 0 && i + 1 < argc) {
+            records = (uint32_t)atoi(argv[++i]);
+        }
+    }
+    threads = threads < 1 ? 1 : threads > 64 ? 64 : threads;
+
+    printf("latency_metrics_bench\n");
+    unsigned failures = BenchCheckAccuracy();
+    failures += BenchCheckCameras();
+    failures += BenchCheckPrometheus();
+
+    RTSPLatencyMetricsRef metrics = BenchCreate(64, 100, 0.5);
+    uint32_t camera = RTSPLatencyMetricsAddCamera(metrics, "bench");
+    double single = BenchRecordCost(metrics, camera, 1, records, false);
+    double lockedSingle = BenchRecordCost(metrics, camera, 1, records, true);
+    RTSPLatencyMetricsReset(metrics);
+    gCount = 0;
+    double shared = BenchRecordCost(metrics, camera, threads, records, false);
+    double lockedShared = BenchRecordCost(metrics, camera, threads, records, true);
+    printf("  record: %.1f ns from 1 thread, %.1f ns each from %u threads on one histogram\n", single, shared, threads);
+    printf("  locked running total: %.1f ns from 1 thread, %.1f ns each from %u threads\n", lockedSingle, lockedShared,
+           threads);
+
+    RTSPLatencySummary summary = RTSPLatencyMetricsGetSummary(metrics, camera, RTSPLatencyStageInference);
+    failures += BenchCheck(summary.count == (uint64_t)threads * records, "no records lost between threads");
+    failures += BenchCheck(gCount == (uint64_t)threads * records, "locked baseline count");
+
+    size_t length = RTSPLatencyMetricsWritePrometheus(metrics, NULL, 0);
+    double start = BenchNow();
+    char *text = malloc(length + 1);
+    for (int i = 0; i < 100; i++) {
+        RTSPLatencyMetricsWritePrometheus(metrics, text, length + 1);
+    }
+    printf("  prometheus export: %zu bytes for one camera in %.1f us\n", length, (BenchNow() - start) * 1e6 / 100);
+    free(text);
+    RTSPLatencyMetricsRelease(metrics);
+
+    printf("  target: record <= %.0f ns from one thread\n", BENCH_TARGET_RECORD_NS);
+    failures += BenchCheck(single <= BENCH_TARGET_RECORD_NS, "record cost");
+
+    printf(failures ? "FAILED (%u)\n" : "OK\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,610 @@
+//
+//  mjpeg_bench.c
+//  RTSP Rotator Benchmarks
+//
+//  Fan-out test for the MJPEG endpoints (/api/cameras/<index>/stream.mjpeg)
+//  on an RTSPHTTPServer multipart channel. RTSPJPEGFrameCache encodes each
+//  camera frame once and publishes it once; this harness stands in for the
+//  cache with JPEG-sized frames at a fixed rate for several cameras, watched
+//  by many viewers of one camera, a few of the others, and one viewer that
+//  reads far slower than the stream. Reported:
+//
+//    - publish cost per frame in producer CPU time (p50/p99/max): one copy of
+//      the frame however many viewers there are
+//    - delivery latency from publish to a viewer holding the complete part
+//    - that fast viewers got (nearly) every frame of their camera only, in
+//      order, with intact multipart framing
+//    - that the slow viewer skipped frames but stayed connected and never
+//      saw a torn part
+//
+//  Before the load phase the protocol handling is checked: the
+//  multipart/x-mixed-replace head and part framing, per-camera routing,
+//  subscriber counts, and the API misuse that must be refused.
+//
+//  Build (Linux / macOS):
+//    cc -O2 -std=gnu11 -I"../RTSP Rotator" mjpeg_bench.c "../RTSP Rotator/RTSPHTTPServer.c" "../RTSP Rotator/RTSPHTTPRouter.c" "../RTSP Rotator/RTSPWebSocket.c" "../RTSP Rotator/RTSPByteBuffer.c" -lpthread -lm -o mjpeg_bench
+//
+//  Usage: mjpeg_bench [--viewers N] [--cameras N] [--fps N] [--size BYTES] [--seconds S] [--no-slow]
+//
+
+#define _GNU_SOURCE
+
+#include "RTSPHTTPServer.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+// Targets on loopback with ~64 viewers of 80 KB frames
+#define BENCH_TARGET_PUBLISH_P99_US 1000.0
+#define BENCH_TARGET_DELIVERY_P99_MS 50.0
+#define BENCH_TARGET_FAST_DELIVERY 0.95     // Share of its camera's frames a fast viewer must get
+
+#define BENCH_BOUNDARY "--rtspframe\r\n"
+#define BENCH_VIEWER_BUFFER (1024 * 1024)
+
+static double BenchNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/// CPU time of the calling thread, so publish cost excludes time spent preempted
+static double BenchThreadTime(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static int BenchCompareDouble(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double BenchPercentile(const double *sorted, size_t count, double percentile) {
+    if (count == 0) {
+        return 0;
+    }
+    size_t index = (size_t)(percentile * (double)(count - 1) + 0.5);
+    return sorted[index < count ? index : count - 1];
+}
+
+static unsigned BenchCheck(bool condition, const char *what) {
+    if (!condition) {
+        fprintf(stderr, "  check failed: %s\n", what);
+    }
+    return condition ? 0 : 1;
+}
+
+#pragma mark - Server
+
+/// /api/cameras/:index/stream.mjpeg, as RTSPAPIServer routes it
+static void BenchHandleStream(void *context, const RTSPHTTPRequest *request, RTSPHTTPResponse *response) {
+    const char *index = NULL;
+    size_t length = 0;
+    char event[32];
+    RTSPHTTPRequestParam(request, "index", &index, &length);
+    snprintf(event, sizeof(event), "camera%.*s", (int)length, index);
+    if (!RTSPHTTPResponseSubscribe(response, request, context, event)) {
+        static const char error[] = "{\"error\":\"Expected GET\"}";
+        RTSPHTTPResponseSetStatus(response, 400);
+        RTSPHTTPResponseSetContentType(response, "application/json");
+        RTSPHTTPResponseAppendBody(response, error, sizeof(error) - 1);
+    }
+}
+
+/// A JPEG-shaped frame: SOI, a comment segment carrying camera, sequence and
+/// publish time, a byte pattern derived from the sequence, EOI
+static void BenchFillFrame(uint8_t *frame, size_t size, unsigned camera, uint64_t sequence, double sent) {
+    memset(frame, 0, 96);
+    frame[0] = 0xFF;
+    frame[1] = 0xD8;
+    snprintf((char *)frame + 2, 94, "cam=%u seq=%llu sent=%.9f", camera, (unsigned long long)sequence, sent);
+    for (size_t i = 96; i < size - 2; i++) {
+        frame[i] = (uint8_t)(sequence + i);
+    }
+    frame[size - 2] = 0xFF;
+    frame[size - 1] = 0xD9;
+}
+
+#pragma mark - Client Helpers
+
+static int BenchConnect(uint16_t port, int receiveBuffer) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (receiveBuffer > 0) {
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &receiveBuffer, sizeof(receiveBuffer));
+    }
+    struct sockaddr_in address = {.sin_family = AF_INET, .sin_port = htons(port)};
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+static bool BenchSendAll(int fd, const void *data, size_t length) {
+    const char *bytes = data;
+    while (length > 0) {
+        ssize_t sent = send(fd, bytes, length, MSG_NOSIGNAL);
+        if (sent <= 0) {
+            return false;
+        }
+        bytes += sent;
+        length -= (size_t)sent;
+    }
+    return true;
+}
+
+static bool BenchRequestStream(int fd, unsigned camera, bool upgrade) {
+    char request[512];
+    snprintf(request, sizeof(request),
+             "GET /api/cameras/%u/stream.mjpeg HTTP/1.1\r\nHost: x\r\n%s\r\n", camera,
+             upgrade ? "Upgrade: websocket\r\nConnection: Upgrade\r\n"
+                       "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n" : "");
+    return BenchSendAll(fd, request, strlen(request));
+}
+
+static void BenchConsume(char *buffer, size_t *length, size_t count) {
+    memmove(buffer, buffer + count, *length - count);
+    *length -= count;
+}
+
+#pragma mark - Viewers
+
+typedef struct {
+    int fd;
+    unsigned camera;
+    bool slow;
+    bool headDone;
+    bool headValid;
+    char *buffer;
+    size_t length;
+    uint64_t lastSequence;
+    uint64_t received;
+    uint64_t outOfOrder;
+    uint64_t torn;                  // Bad framing, wrong camera or corrupt payload
+} BenchViewer;
+
+typedef struct {
+    BenchViewer *viewers;
+    unsigned count;
+    double measureFrom;
+    double deadline;
+    double *latencies;
+    size_t latencyCount;
+    size_t latencyCapacity;
+    uint64_t closed;
+    pthread_mutex_t lock;           // Latencies; the slow viewer has its own thread
+} BenchReaderThread;
+
+static void BenchCheckPart(BenchReaderThread *reader, BenchViewer *viewer, const uint8_t *data, size_t length,
+                           double now) {
+    unsigned camera = 0;
+    unsigned long long sequence = 0;
+    double sent = 0;
+    if (length < 98 || data[0] != 0xFF || data[1] != 0xD8 || data[length - 2] != 0xFF || data[length - 1] != 0xD9 ||
+        sscanf((const char *)data + 2, "cam=%u seq=%llu sent=%lf", &camera, &sequence, &sent) != 3 ||
+        camera != viewer->camera) {
+        viewer->torn++;
+        return;
+    }
+    // Spot-check the pattern rather than every byte of every frame
+    for (size_t i = 96; i < length - 2; i += 997) {
+        if (data[i] != (uint8_t)(sequence + i)) {
+            viewer->torn++;
+            return;
+        }
+    }
+    if (sequence <= viewer->lastSequence) {
+        viewer->outOfOrder++;
+    }
+    viewer->lastSequence = sequence;
+    viewer->received++;
+    if (!viewer->slow && sent >= reader->measureFrom) {
+        pthread_mutex_lock(&reader->lock);
+        if (reader->latencyCount < reader->latencyCapacity) {
+            reader->latencies[reader->latencyCount++] = now - sent;
+        }
+        pthread_mutex_unlock(&reader->lock);
+    }
+}
+
+/// Parses complete parts out of the viewer's buffer
+static void BenchDrain(BenchReaderThread *reader, BenchViewer *viewer, double now) {
+    if (!viewer->headDone) {
+        char *end = memmem(viewer->buffer, viewer->length, "\r\n\r\n", 4);
+        if (!end) {
+            return;
+        }
+        size_t head = (size_t)(end - viewer->buffer) + 4;
+        viewer->headValid = strncmp(viewer->buffer, "HTTP/1.1 200", 12) == 0 &&
+                            memmem(viewer->buffer, head, "multipart/x-mixed-replace; boundary=rtspframe", 45) != NULL;
+        BenchConsume(viewer->buffer, &viewer->length, head);
+        viewer->headDone = true;
+    }
+    size_t offset = 0;
+    for (;;) {
+        char *part = viewer->buffer + offset;
+        size_t available = viewer->length - offset;
+        char *end = memmem(part, available, "\r\n\r\n", 4);
+        if (!end) {
+            break;
+        }
+        const char *contentLength = memmem(part, (size_t)(end - part), "Content-Length: ", 16);
+        if (strncmp(part, BENCH_BOUNDARY, strlen(BENCH_BOUNDARY)) != 0 || !contentLength ||
+            !memmem(part, (size_t)(end - part), "Content-Type: image/jpeg", 24)) {
+            viewer->torn++;
+            offset = viewer->length; // Framing lost; nothing after this can be trusted
+            break;
+        }
+        size_t size = strtoul(contentLength + 16, NULL, 10);
+        size_t bodyStart = (size_t)(end - part) + 4;
+        if (available < bodyStart + size + 2) {
+            break;
+        }
+        if (memcmp(part + bodyStart + size, "\r\n", 2) != 0) {
+            viewer->torn++;
+        }
+        BenchCheckPart(reader, viewer, (const uint8_t *)part + bodyStart, size, now);
+        offset += bodyStart + size + 2;
+    }
+    BenchConsume(viewer->buffer, &viewer->length, offset);
+}
+
+static bool BenchReceive(BenchReaderThread *reader, BenchViewer *viewer, size_t limit) {
+    size_t room = BENCH_VIEWER_BUFFER - viewer->length;
+    ssize_t count = recv(viewer->fd, viewer->buffer + viewer->length, limit < room ? limit : room, MSG_DONTWAIT);
+    if (count == 0 || (count < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+        close(viewer->fd);
+        viewer->fd = -1;
+        return false;
+    }
+    if (count > 0) {
+        viewer->length += (size_t)count;
+        BenchDrain(reader, viewer, BenchNow());
+    }
+    return true;
+}
+
+static void *BenchReaderMain(void *argument) {
+    BenchReaderThread *reader = argument;
+    struct pollfd *pfds = calloc(reader->count, sizeof(*pfds));
+    while (BenchNow() < reader->deadline + 0.5) {
+        for (unsigned i = 0; i < reader->count; i++) {
+            pfds[i] = (struct pollfd){.fd = reader->viewers[i].fd, .events = POLLIN};
+        }
+        if (poll(pfds, reader->count, 50) <= 0) {
+            continue;
+        }
+        for (unsigned i = 0; i < reader->count; i++) {
+            BenchViewer *viewer = &reader->viewers[i];
+            if (viewer->fd >= 0 && (pfds[i].revents & (POLLIN | POLLHUP | POLLERR)) &&
+                !BenchReceive(reader, viewer, BENCH_VIEWER_BUFFER)) {
+                reader->closed++;
+            }
+        }
+    }
+    free(pfds);
+    return NULL;
+}
+
+typedef struct {
+    BenchReaderThread *reader;
+    BenchViewer *viewer;
+    bool disconnected;
+} BenchSlowViewer;
+
+/// Reads 16 KB every 50 ms, a fraction of the stream's bitrate
+static void *BenchSlowMain(void *argument) {
+    BenchSlowViewer *slow = argument;
+    while (BenchNow() < slow->reader->deadline + 0.5) {
+        if (!BenchReceive(slow->reader, slow->viewer, 16 * 1024)) {
+            slow->disconnected = true;
+            break;
+        }
+        usleep(50 * 1000);
+    }
+    return NULL;
+}
+
+#pragma mark - Protocol Checks
+
+static unsigned BenchProtocolChecks(uint16_t port, RTSPHTTPChannelRef frames, RTSPHTTPChannelRef events) {
+    unsigned failures = 0;
+    failures += BenchCheck(!RTSPHTTPChannelPublish(frames, "camera0", "{}", 2, false), "JSON publish refused on multipart channel");
+    failures += BenchCheck(!RTSPHTTPChannelPublishPart(events, "camera0", "image/jpeg", "x", 1, false), "part refused on event channel");
+    failures += BenchCheck(!RTSPHTTPChannelPublishPart(frames, "camera0", "image/jpeg\r\nX-Evil: 1", "x", 1, false),
+                           "header injection in content type refused");
+
+    BenchReaderThread reader = {.measureFrom = 1e30};
+    pthread_mutex_init(&reader.lock, NULL);
+    BenchViewer viewers[2] = {{.camera = 0}, {.camera = 1}};
+    for (int i = 0; i < 2; i++) {
+        viewers[i].buffer = malloc(BENCH_VIEWER_BUFFER);
+        viewers[i].fd = BenchConnect(port, 0);
+        BenchRequestStream(viewers[i].fd, viewers[i].camera, false);
+    }
+    double settle = BenchNow() + 2.0;
+    while (RTSPHTTPChannelSubscriberCount(frames, NULL) < 2 && BenchNow() < settle) {
+        usleep(1000);
+    }
+    failures += BenchCheck(RTSPHTTPChannelSubscriberCount(frames, "camera0") == 1 &&
+                           RTSPHTTPChannelSubscriberCount(frames, "camera1") == 1 &&
+                           RTSPHTTPChannelSubscriberCount(frames, "camera2") == 0, "per-camera subscriber counts");
+
+    // Each viewer gets its own camera only
+    uint8_t frame[4096];
+    for (unsigned camera = 0; camera < 3; camera++) {
+        BenchFillFrame(frame, sizeof(frame), camera, 1, 0);
+        RTSPHTTPChannelPublishPart(frames, camera == 0 ? "camera0" : camera == 1 ? "camera1" : "camera2",
+                                   "image/jpeg", frame, sizeof(frame), false);
+    }
+    double deadline = BenchNow() + 2.0;
+    while ((viewers[0].received < 1 || viewers[1].received < 1) && BenchNow() < deadline) {
+        for (int i = 0; i < 2; i++) {
+            struct pollfd pfd = {.fd = viewers[i].fd, .events = POLLIN};
+            if (poll(&pfd, 1, 10) > 0) {
+                BenchReceive(&reader, &viewers[i], BENCH_VIEWER_BUFFER);
+            }
+        }
+    }
+    failures += BenchCheck(viewers[0].headValid && viewers[1].headValid, "multipart/x-mixed-replace response head");
+    failures += BenchCheck(viewers[0].received == 1 && viewers[1].received == 1 &&
+                           viewers[0].torn == 0 && viewers[1].torn == 0, "one intact part per camera");
+    for (int i = 0; i < 2; i++) {
+        close(viewers[i].fd);
+        free(viewers[i].buffer);
+    }
+
+    // MJPEG is not offered over WebSocket
+    int ws = BenchConnect(port, 0);
+    BenchRequestStream(ws, 0, true);
+    char buffer[512];
+    ssize_t count = recv(ws, buffer, sizeof(buffer) - 1, 0);
+    failures += BenchCheck(count >= 12 && strncmp(buffer, "HTTP/1.1 400", 12) == 0, "WebSocket upgrade refused");
+    close(ws);
+    pthread_mutex_destroy(&reader.lock);
+    return failures;
+}
+
+#pragma mark - Load
+
+int main(int argc, char **argv) {
+    unsigned viewerCount = 64;
+    unsigned cameras = 4;
+    double fps = 15.0;
+    size_t size = 80 * 1024;
+    double seconds = 5.0;
+    bool slow = true;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--viewers") == 0 && i + 1 < argc) {
+            viewerCount = (unsigned)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--cameras") == 0 && i + 1 < argc) {
+            cameras = (unsigned)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+            fps = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            size = (size_t)atol(argv[++i]);
+        } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            seconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--no-slow") == 0) {
+            slow = false;
+        } else {
+            fprintf(stderr, "usage: %s [--viewers N] [--cameras N] [--fps N] [--size BYTES] [--seconds S] [--no-slow]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (fps <= 0) {
+        fps = 1;
+    }
+    if (cameras == 0) {
+        cameras = 1;
+    }
+    if (size < 1024) {
+        size = 1024;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    RTSPHTTPServerConfig config;
+    RTSPHTTPServerConfigInit(&config);
+    config.bindAddress = "127.0.0.1";
+    config.port = 0;
+    RTSPHTTPServerRef server = RTSPHTTPServerCreate(&config);
+    if (!server) {
+        fprintf(stderr, "failed to create server\n");
+        return 1;
+    }
+
+    // Same channel setup as RTSPAPIServer
+    RTSPHTTPChannelConfig channelConfig;
+    RTSPHTTPChannelConfigInit(&channelConfig);
+    RTSPHTTPChannelRef events = RTSPHTTPServerAddChannel(server, &channelConfig);
+    channelConfig.format = RTSPHTTPChannelFormatMultipart;
+    channelConfig.maxQueuedMessages = 2;
+    channelConfig.maxQueuedBytes = 8 * 1024 * 1024;
+    channelConfig.skipWhenFull = true;
+    RTSPHTTPChannelRef checkFrames = RTSPHTTPServerAddChannel(server, &channelConfig);
+    RTSPHTTPChannelRef frames = RTSPHTTPServerAddChannel(server, &channelConfig);
+    if (!events || !checkFrames || !frames ||
+        !RTSPHTTPServerAddRoute(server, RTSPHTTPMethodGET, "/api/cameras/:index/stream.mjpeg", BenchHandleStream, checkFrames) ||
+        !RTSPHTTPServerAddRoute(server, RTSPHTTPMethodGET, "/load/cameras/:index/stream.mjpeg", BenchHandleStream, frames) ||
+        !RTSPHTTPServerStart(server)) {
+        fprintf(stderr, "failed to start server\n");
+        return 1;
+    }
+    uint16_t port = RTSPHTTPServerPort(server);
+
+    // Most viewers watch camera 0; one each on the others
+    unsigned hot = viewerCount > cameras - 1 ? viewerCount - (cameras - 1) : viewerCount;
+    printf("mjpeg_bench: %u cameras at %.0f fps, %zu KB frames, %u viewers (%u on camera 0)%s, %.0f s\n",
+           cameras, fps, size / 1024, viewerCount, hot, slow ? " + 1 slow" : "", seconds);
+
+    unsigned failures = BenchProtocolChecks(port, checkFrames, events);
+    printf("  protocol checks:              %s\n", failures ? "FAILED" : "ok");
+
+    unsigned count = viewerCount + (slow ? 1 : 0);
+    BenchViewer *viewers = calloc(count ? count : 1, sizeof(*viewers));
+    for (unsigned i = 0; i < count; i++) {
+        BenchViewer *viewer = &viewers[i];
+        viewer->slow = slow && i == count - 1;
+        viewer->camera = viewer->slow || i < hot ? 0 : (i - hot) % cameras + 1;
+        if (viewer->camera >= cameras) {
+            viewer->camera = 0;
+        }
+        viewer->buffer = malloc(BENCH_VIEWER_BUFFER);
+        viewer->fd = BenchConnect(port, viewer->slow ? 16 * 1024 : 0);
+        char request[256];
+        snprintf(request, sizeof(request), "GET /load/cameras/%u/stream.mjpeg HTTP/1.1\r\nHost: x\r\n\r\n", viewer->camera);
+        if (viewer->fd < 0 || !BenchSendAll(viewer->fd, request, strlen(request))) {
+            fprintf(stderr, "failed to subscribe\n");
+            return 1;
+        }
+    }
+    double settle = BenchNow() + 2.0;
+    while (RTSPHTTPChannelSubscriberCount(frames, NULL) < count && BenchNow() < settle) {
+        usleep(1000);
+    }
+
+    double start = BenchNow();
+    size_t framesPerCamera = (size_t)(fps * (seconds + 0.5)) + 4;
+    BenchReaderThread reader = {
+        .viewers = viewers,
+        .count = slow ? count - 1 : count,
+        .measureFrom = start + 0.5,
+        .deadline = start + 0.5 + seconds,
+        .latencies = malloc(framesPerCamera * (count ? count : 1) * sizeof(double)),
+        .latencyCapacity = framesPerCamera * count,
+    };
+    pthread_mutex_init(&reader.lock, NULL);
+    pthread_t readerThread, slowThread;
+    BenchSlowViewer slowViewer = {.reader = &reader, .viewer = &viewers[count - 1]};
+    pthread_create(&readerThread, NULL, BenchReaderMain, &reader);
+    if (slow) {
+        pthread_create(&slowThread, NULL, BenchSlowMain, &slowViewer);
+    }
+
+    // Producer: each camera's frame is "encoded" once and published once,
+    // cameras staggered across the frame interval
+    char event[32];
+    uint8_t *frame = malloc(size);
+    double *publishCosts = malloc(framesPerCamera * cameras * sizeof(double));
+    size_t measuredPublishes = 0;
+    uint64_t sequence = 0;
+    double interval = 1.0 / (fps * cameras);
+    double next = start;
+    size_t published = 0;
+    while (next < reader.deadline && published < framesPerCamera * cameras) {
+        double now = BenchNow();
+        if (now < next) {
+            struct timespec pause = {0, (long)((next - now) * 1e9)};
+            nanosleep(&pause, NULL);
+            continue;
+        }
+        unsigned camera = (unsigned)(published % cameras);
+        if (camera == 0) {
+            sequence++;
+        }
+        snprintf(event, sizeof(event), "camera%u", camera);
+        BenchFillFrame(frame, size, camera, sequence, BenchNow());
+        double before = BenchThreadTime();
+        RTSPHTTPChannelPublishPart(frames, event, "image/jpeg", frame, size, false);
+        double cost = BenchThreadTime() - before;
+        published++;
+        if (now >= reader.measureFrom) {
+            publishCosts[measuredPublishes++] = cost;
+        }
+        next += interval;
+    }
+    pthread_join(readerThread, NULL);
+    if (slow) {
+        pthread_join(slowThread, NULL);
+    }
+    RTSPHTTPChannelStatistics statistics = RTSPHTTPChannelGetStatistics(frames);
+
+    qsort(publishCosts, measuredPublishes, sizeof(double), BenchCompareDouble);
+    qsort(reader.latencies, reader.latencyCount, sizeof(double), BenchCompareDouble);
+    double publishP50 = BenchPercentile(publishCosts, measuredPublishes, 0.50) * 1e6;
+    double publishP99 = BenchPercentile(publishCosts, measuredPublishes, 0.99) * 1e6;
+    double publishMax = measuredPublishes ? publishCosts[measuredPublishes - 1] * 1e6 : 0;
+    double deliveryP50 = BenchPercentile(reader.latencies, reader.latencyCount, 0.50) * 1e3;
+    double deliveryP99 = BenchPercentile(reader.latencies, reader.latencyCount, 0.99) * 1e3;
+    double deliveryMax = reader.latencyCount ? reader.latencies[reader.latencyCount - 1] * 1e3 : 0;
+
+    uint64_t torn = 0, outOfOrder = 0, fastMinimum = UINT64_MAX;
+    for (unsigned i = 0; i < count; i++) {
+        torn += viewers[i].torn;
+        outOfOrder += viewers[i].outOfOrder;
+        if (!viewers[i].slow && viewers[i].received < fastMinimum) {
+            fastMinimum = viewers[i].received;
+        }
+    }
+    if (fastMinimum == UINT64_MAX) {
+        fastMinimum = sequence;
+    }
+    BenchViewer *slowest = slow ? &viewers[count - 1] : NULL;
+
+    bool publishMet = measuredPublishes > 0 && publishP99 <= BENCH_TARGET_PUBLISH_P99_US;
+    bool deliveryMet = reader.latencyCount > 0 && deliveryP99 <= BENCH_TARGET_DELIVERY_P99_MS;
+    bool fastMet = (double)fastMinimum >= BENCH_TARGET_FAST_DELIVERY * (double)sequence;
+    bool slowMet = !slow || (!slowViewer.disconnected && slowest->received > 0 && slowest->received < sequence &&
+                             statistics.skipped > 0);
+    bool intact = torn == 0 && outOfOrder == 0 && reader.closed == 0;
+
+    printf("  publish (one copy per frame): p50 %6.1f us   p99 %6.1f us   max %7.1f us   %s\n",
+           publishP50, publishP99, publishMax, publishMet ? "ok" : "MISSED");
+    printf("  delivery:                     p50 %6.2f ms   p99 %6.2f ms   max %7.2f ms   %s\n",
+           deliveryP50, deliveryP99, deliveryMax, deliveryMet ? "ok" : "MISSED");
+    printf("  targets:                      publish p99 <= %.0f us, delivery p99 <= %.0f ms, fast viewers >= %.0f%% of frames\n",
+           BENCH_TARGET_PUBLISH_P99_US, BENCH_TARGET_DELIVERY_P99_MS, BENCH_TARGET_FAST_DELIVERY * 100);
+    printf("  fast viewers:                 %llu frames per camera, fewest received %llu   %s\n",
+           (unsigned long long)sequence, (unsigned long long)fastMinimum, fastMet ? "ok" : "MISSED");
+    if (slow) {
+        printf("  slow viewer:                  %llu frames received, %s\n", (unsigned long long)slowest->received,
+               slowViewer.disconnected ? "DISCONNECTED" : "still connected");
+    }
+    printf("  framing:                      %llu torn parts, %llu out of order, %llu fast viewers disconnected\n",
+           (unsigned long long)torn, (unsigned long long)outOfOrder, (unsigned long long)reader.closed);
+    printf("  channel:                      %llu published, %llu delivered, %llu skipped, %llu dropped\n",
+           (unsigned long long)statistics.published, (unsigned long long)statistics.delivered,
+           (unsigned long long)statistics.skipped, (unsigned long long)statistics.droppedSubscribers);
+
+    for (unsigned i = 0; i < count; i++) {
+        if (viewers[i].fd >= 0) {
+            close(viewers[i].fd);
+        }
+        free(viewers[i].buffer);
+    }
+    RTSPHTTPServerRelease(server);
+    pthread_mutex_destroy(&reader.lock);
+    free(viewers);
+    free(reader.latencies);
+    free(publishCosts);
+    free(frame);
+
+    if (failures > 0 || !publishMet || !deliveryMet || !fastMet || !slowMet || !intact) {
+        fprintf(stderr, "FAIL: %u protocol check(s)%s%s%s%s%s\n", failures,
+                publishMet ? "" : ", publish target missed", deliveryMet ? "" : ", delivery target missed",
+                fastMet ? "" : ", fast viewers lost frames", slowMet ? "" : ", slow viewer not handled",
+                intact ? "" : ", frames torn or reordered");
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,189 @@
+//
+//  motion_kernel_bench.c
+//  RTSP Rotator Benchmarks
+//
+//  Microbenchmark for RTSPMotionKernel on synthetic 1080p and 4K luma
+//  planes. Every backend is checked bit-for-bit against the scalar path
+//  before it is timed.
+//
+//  The "ci-equivalent" row performs the per-pixel work of the old
+//  Core Image path on the CPU (NV12 -> RGBA expansion, difference blend,
+//  area average in float). It is a lower bound for that path: the real
+//  one also created a CIContext and ran an AVAssetImageGenerator decode
+//  per check.
+//
+//  Build (Linux / macOS):
+//    cc -O2 -std=c11 -I"../RTSP Rotator" motion_kernel_bench.c "../RTSP Rotator/RTSPMotionKernel.c" -o motion_kernel_bench
+//
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "RTSPMotionKernel.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct {
+    const char *name;
+    uint32_t width;
+    uint32_t height;
+} BenchResolution;
+
+static double BenchNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static uint32_t BenchRandom(uint32_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+/// Static noisy background with a bright square moving across it
+static void BenchFillFrame(uint8_t *plane, uint32_t width, uint32_t height, size_t stride, uint32_t frame) {
+    uint32_t seed = 0x9E3779B9u;
+    for (uint32_t y = 0; y < height; y++) {
+        uint8_t *row = plane + (size_t)y * stride;
+        for (uint32_t x = 0; x < width; x++) {
+            row[x] = (uint8_t)(64 + ((x ^ y) & 31) + (BenchRandom(&seed) & 3));
+        }
+    }
+    uint32_t size = height / 6;
+    uint32_t ox = (frame * 23) % (width - size);
+    uint32_t oy = (frame * 11) % (height - size);
+    for (uint32_t y = oy; y < oy + size; y++) {
+        memset(plane + (size_t)y * stride + ox, 220, size);
+    }
+}
+
+static double BenchCIEquivalent(uint8_t **frames, uint32_t frameCount, uint32_t width, uint32_t height,
+                                size_t stride, uint32_t iterations) {
+    double sink = 0.0;
+    double start = BenchNow();
+    for (uint32_t i = 1; i <= iterations; i++) {
+        const uint8_t *a = frames[(i - 1) % frameCount];
+        const uint8_t *b = frames[i % frameCount];
+        float acc[4] = {0, 0, 0, 0};
+        for (uint32_t y = 0; y < height; y++) {
+            for (uint32_t x = 0; x < width; x++) {
+                float pa = a[(size_t)y * stride + x] / 255.0f;
+                float pb = b[(size_t)y * stride + x] / 255.0f;
+                float rgbaA[4] = {pa, pa, pa, 1.0f};
+                float rgbaB[4] = {pb, pb, pb, 1.0f};
+                for (int c = 0; c < 4; c++) {
+                    float d = rgbaA[c] - rgbaB[c];
+                    acc[c] += d < 0 ? -d : d;
+                }
+            }
+        }
+        sink += acc[0] + acc[1] + acc[2];
+    }
+    double elapsed = BenchNow() - start;
+    if (sink < 0) {
+        printf("%f\n", sink);
+    }
+    return iterations / elapsed;
+}
+
+static double BenchKernel(RTSPMotionKernelBackend backend, uint8_t **frames, uint32_t frameCount,
+                          uint32_t width, uint32_t height, size_t stride, uint32_t iterations) {
+    RTSPMotionKernelConfig config;
+    RTSPMotionKernelConfigInit(&config, width, height);
+    config.backend = backend;
+    RTSPMotionKernelRef kernel = RTSPMotionKernelCreate(&config);
+    RTSPMotionKernelResult result;
+
+    RTSPMotionKernelProcessLuma(kernel, frames[0], stride, &result);
+    double start = BenchNow();
+    for (uint32_t i = 1; i <= iterations; i++) {
+        RTSPMotionKernelProcessLuma(kernel, frames[i % frameCount], stride, &result);
+    }
+    double elapsed = BenchNow() - start;
+    RTSPMotionKernelRelease(kernel);
+    return iterations / elapsed;
+}
+
+static int BenchVerify(RTSPMotionKernelBackend backend, uint8_t **frames, uint32_t frameCount,
+                       uint32_t width, uint32_t height, size_t stride) {
+    RTSPMotionKernelConfig config;
+    RTSPMotionKernelConfigInit(&config, width, height);
+    config.backend = RTSPMotionKernelBackendScalar;
+    RTSPMotionKernelRef reference = RTSPMotionKernelCreate(&config);
+    config.backend = backend;
+    RTSPMotionKernelRef candidate = RTSPMotionKernelCreate(&config);
+
+    int mismatches = 0;
+    for (uint32_t i = 0; i < frameCount * 2; i++) {
+        RTSPMotionKernelResult a, b;
+        RTSPMotionKernelProcessLuma(reference, frames[i % frameCount], stride, &a);
+        RTSPMotionKernelProcessLuma(candidate, frames[i % frameCount], stride, &b);
+        uint32_t columns, rows;
+        const uint32_t *sadA = RTSPMotionKernelBlockSAD(reference, &columns, &rows);
+        const uint32_t *sadB = RTSPMotionKernelBlockSAD(candidate, NULL, NULL);
+        if (a.changedBlocks != b.changedBlocks ||
+            memcmp(sadA, sadB, (size_t)columns * rows * sizeof(uint32_t)) != 0) {
+            mismatches++;
+        }
+    }
+    RTSPMotionKernelRelease(reference);
+    RTSPMotionKernelRelease(candidate);
+    return mismatches;
+}
+
+int main(int argc, char **argv) {
+    uint32_t iterations = argc > 1 ? (uint32_t)atoi(argv[1]) : 200;
+    const BenchResolution resolutions[] = {
+        {"1080p", 1920, 1080},
+        {"4K", 3840, 2160},
+    };
+    const RTSPMotionKernelBackend backends[] = {
+        RTSPMotionKernelBackendScalar,
+        RTSPMotionKernelBackendSSE2,
+        RTSPMotionKernelBackendAVX2,
+        RTSPMotionKernelBackendNEON,
+    };
+    const uint32_t frameCount = 8;
+    int failures = 0;
+
+    printf("%-6s %-14s %12s %10s\n", "res", "backend", "frames/s", "speedup");
+    for (size_t r = 0; r < sizeof(resolutions) / sizeof(resolutions[0]); r++) {
+        const BenchResolution *res = &resolutions[r];
+        // Pad rows the way decoders do so the stride path is exercised
+        size_t stride = (res->width + 63) & ~(size_t)63;
+        uint8_t *frames[frameCount];
+        for (uint32_t f = 0; f < frameCount; f++) {
+            frames[f] = malloc(stride * res->height);
+            BenchFillFrame(frames[f], res->width, res->height, stride, f);
+        }
+
+        uint32_t referenceIterations = iterations / 10 ? iterations / 10 : 1;
+        double baseline = BenchCIEquivalent(frames, frameCount, res->width, res->height, stride, referenceIterations);
+        printf("%-6s %-14s %12.1f %9.1fx\n", res->name, "ci-equivalent", baseline, 1.0);
+
+        for (size_t b = 0; b < sizeof(backends) / sizeof(backends[0]); b++) {
+            if (!RTSPMotionKernelBackendAvailable(backends[b])) {
+                continue;
+            }
+            int mismatches = BenchVerify(backends[b], frames, frameCount, res->width, res->height, stride);
+            if (mismatches) {
+                fprintf(stderr, "%s %s: %d frames differ from scalar\n",
+                        res->name, RTSPMotionKernelBackendName(backends[b]), mismatches);
+                failures++;
+                continue;
+            }
+            double fps = BenchKernel(backends[b], frames, frameCount, res->width, res->height, stride, iterations);
+            printf("%-6s %-14s %12.1f %9.1fx\n", res->name, RTSPMotionKernelBackendName(backends[b]),
+                   fps, fps / baseline);
+        }
+
+        for (uint32_t f = 0; f < frameCount; f++) {
+            free(frames[f]);
+        }
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,627 @@
+//
+//  push_bench.c
+//  RTSP Rotator Benchmarks
+//
+//  Fan-out test for RTSPHTTPServer push channels, the /api/events stream
+//  that replaces dashboards polling /api/current and
+//  /api/recording/status. A producer publishes detection-sized events at a
+//  fixed rate to N Server-Sent Events and M WebSocket subscribers on
+//  loopback, plus one subscriber that never reads. Reported:
+//
+//    - publish() cost on the producer thread (p50/p99/max), which must stay
+//      flat while the stuck subscriber's queue fills up
+//    - delivery latency from publish to the client parsing the event
+//    - that every live subscriber received every event, in order, and the
+//      stuck one was disconnected instead of backing anything up
+//
+//  Before the load phase the protocol handling is checked: RFC 6455 accept
+//  key, retained events replayed on subscribe, ?events= filtering, SSE and
+//  WebSocket framing, ping/pong and the closing handshake.
+//
+//  Build (Linux / macOS):
+//    cc -O2 -std=gnu11 -I"../RTSP Rotator" push_bench.c "../RTSP Rotator/RTSPHTTPServer.c" "../RTSP Rotator/RTSPHTTPRouter.c" "../RTSP Rotator/RTSPWebSocket.c" "../RTSP Rotator/RTSPByteBuffer.c" -lpthread -lm -o push_bench
+//
+//  Usage: push_bench [--sse N] [--websocket N] [--rate EVENTS/S] [--size BYTES] [--seconds S] [--no-stuck]
+//
+
+#define _GNU_SOURCE
+
+#include "RTSPHTTPServer.h"
+#include "RTSPWebSocket.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+// Targets on loopback with ~64 subscribers
+#define BENCH_TARGET_PUBLISH_P99_US 250.0
+#define BENCH_TARGET_DELIVERY_P99_MS 10.0
+
+static double BenchNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static int BenchCompareDouble(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double BenchPercentile(const double *sorted, size_t count, double percentile) {
+    if (count == 0) {
+        return 0;
+    }
+    size_t index = (size_t)(percentile * (double)(count - 1) + 0.5);
+    return sorted[index < count ? index : count - 1];
+}
+
+#pragma mark - Server
+
+static void BenchHandleEvents(void *context, const RTSPHTTPRequest *request, RTSPHTTPResponse *response) {
+    char events[128] = "";
+    const char *filter = NULL;
+    if (request->query && strncmp(request->query, "events=", 7) == 0) {
+        snprintf(events, sizeof(events), "%.*s", (int)strcspn(request->query + 7, "&"), request->query + 7);
+        filter = events;
+    }
+    if (!RTSPHTTPResponseSubscribe(response, request, context, filter)) {
+        static const char error[] = "{\"error\":\"Subscribe with GET\"}";
+        RTSPHTTPResponseSetStatus(response, 400);
+        RTSPHTTPResponseSetContentType(response, "application/json");
+        RTSPHTTPResponseAppendBody(response, error, sizeof(error) - 1);
+    }
+}
+
+#pragma mark - Client Helpers
+
+static int BenchConnect(uint16_t port, int receiveBuffer) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (receiveBuffer > 0) {
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &receiveBuffer, sizeof(receiveBuffer));
+    }
+    struct sockaddr_in address = {.sin_family = AF_INET, .sin_port = htons(port)};
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+static bool BenchSendAll(int fd, const void *data, size_t length) {
+    const char *bytes = data;
+    while (length > 0) {
+        ssize_t sent = send(fd, bytes, length, MSG_NOSIGNAL);
+        if (sent <= 0) {
+            return false;
+        }
+        bytes += sent;
+        length -= (size_t)sent;
+    }
+    return true;
+}
+
+/// Reads until `length` bytes are buffered or `timeout` passes
+static bool BenchFill(int fd, char *buffer, size_t *length, size_t want, size_t capacity, double timeout) {
+    double deadline = BenchNow() + timeout;
+    while (*length < want) {
+        struct pollfd pfd = {.fd = fd, .events = POLLIN};
+        int wait = (int)((deadline - BenchNow()) * 1000.0);
+        if (wait <= 0 || poll(&pfd, 1, wait) <= 0) {
+            return false;
+        }
+        ssize_t count = recv(fd, buffer + *length, capacity - *length, 0);
+        if (count <= 0) {
+            return false;
+        }
+        *length += (size_t)count;
+    }
+    return true;
+}
+
+/// Reads until `marker` appears; returns the offset just past it, or 0
+static size_t BenchReadUntil(int fd, char *buffer, size_t *length, size_t capacity, const char *marker) {
+    for (;;) {
+        char *found = memmem(buffer, *length, marker, strlen(marker));
+        if (found) {
+            return (size_t)(found - buffer) + strlen(marker);
+        }
+        if (*length == capacity || !BenchFill(fd, buffer, length, *length + 1, capacity, 2.0)) {
+            return 0;
+        }
+    }
+}
+
+static void BenchConsume(char *buffer, size_t *length, size_t count) {
+    memmove(buffer, buffer + count, *length - count);
+    *length -= count;
+}
+
+/// Server frames are unmasked. Returns the frame length, or 0 if incomplete.
+static size_t BenchWebSocketFrame(const uint8_t *data, size_t length, int *opcode, const uint8_t **payload,
+                                  size_t *payloadLength) {
+    if (length < 2) {
+        return 0;
+    }
+    size_t offset = 2;
+    uint64_t size = data[1] & 0x7F;
+    if (size == 126) {
+        if (length < 4) {
+            return 0;
+        }
+        size = (uint64_t)data[2] << 8 | data[3];
+        offset = 4;
+    } else if (size == 127) {
+        if (length < 10) {
+            return 0;
+        }
+        size = 0;
+        for (int i = 0; i < 8; i++) {
+            size = size << 8 | data[2 + i];
+        }
+        offset = 10;
+    }
+    if (length < offset + size) {
+        return 0;
+    }
+    *opcode = data[0] & 0x0F;
+    *payload = data + offset;
+    *payloadLength = (size_t)size;
+    return offset + (size_t)size;
+}
+
+static void BenchSendMaskedFrame(int fd, int opcode, const void *payload, size_t length) {
+    uint8_t frame[2 + 4 + 125];
+    const uint8_t mask[4] = {0x12, 0x34, 0x56, 0x78};
+    frame[0] = (uint8_t)(0x80 | opcode);
+    frame[1] = (uint8_t)(0x80 | length);
+    memcpy(frame + 2, mask, 4);
+    for (size_t i = 0; i < length; i++) {
+        frame[6 + i] = ((const uint8_t *)payload)[i] ^ mask[i & 3];
+    }
+    BenchSendAll(fd, frame, 6 + length);
+}
+
+static unsigned BenchCheck(bool condition, const char *what) {
+    if (!condition) {
+        fprintf(stderr, "  check failed: %s\n", what);
+    }
+    return condition ? 0 : 1;
+}
+
+#pragma mark - Protocol Checks
+
+static const char BenchSSERequest[] = "GET /api/events%s HTTP/1.1\r\nHost: x\r\nAccept: text/event-stream\r\n\r\n";
+
+static unsigned BenchProtocolChecks(uint16_t port, RTSPHTTPChannelRef channel) {
+    unsigned failures = 0;
+    char buffer[8192];
+    size_t length = 0;
+
+    char accept[RTSP_WEBSOCKET_ACCEPT_LENGTH + 1];
+    RTSPWebSocketAcceptKey("dGhlIHNhbXBsZSBub25jZQ==", accept);
+    failures += BenchCheck(strcmp(accept, "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=") == 0, "RFC 6455 accept key");
+    failures += BenchCheck(!RTSPHTTPChannelPublish(channel, "bad name", "1", 1, false), "invalid event name rejected");
+
+    // Retained state reaches subscribers that connect later
+    const char feed[] = "{\"index\":3,\"count\":12}";
+    RTSPHTTPChannelPublish(channel, "feed", feed, strlen(feed), true);
+
+    char request[256];
+    int sse = BenchConnect(port, 0);
+    snprintf(request, sizeof(request), BenchSSERequest, "");
+    BenchSendAll(sse, request, strlen(request));
+    int filtered = BenchConnect(port, 0);
+    snprintf(request, sizeof(request), BenchSSERequest, "?events=network");
+    BenchSendAll(filtered, request, strlen(request));
+
+    size_t head = BenchReadUntil(sse, buffer, &length, sizeof(buffer), "\r\n\r\n");
+    failures += BenchCheck(head > 0 && strncmp(buffer, "HTTP/1.1 200", 12) == 0 &&
+                           memmem(buffer, head, "text/event-stream", 17) != NULL, "SSE response head");
+    BenchConsume(buffer, &length, head);
+    size_t record = BenchReadUntil(sse, buffer, &length, sizeof(buffer), "\n\n");
+    failures += BenchCheck(record > 0 && strncmp(buffer, "id: 1\nevent: feed\ndata: {\"index\":3", 34) == 0,
+                           "retained event replayed to SSE subscriber");
+    BenchConsume(buffer, &length, record);
+
+    // A multi-line payload becomes several data: lines
+    RTSPHTTPChannelPublish(channel, "detection", "{\n\"label\":\"person\"\n}", 20, false);
+    record = BenchReadUntil(sse, buffer, &length, sizeof(buffer), "\n\n");
+    failures += BenchCheck(record > 0 && strncmp(buffer, "id: 2\nevent: detection\ndata: {\ndata: \"label\":\"person\"\ndata: }\n\n", record) == 0,
+                           "multi-line SSE data");
+    BenchConsume(buffer, &length, record);
+
+    // The filtered subscriber sees only "network"
+    RTSPHTTPChannelPublish(channel, "network", "{\"quality\":90}", 14, true);
+    size_t filteredLength = 0;
+    char filteredBuffer[4096];
+    head = BenchReadUntil(filtered, filteredBuffer, &filteredLength, sizeof(filteredBuffer), "\r\n\r\n");
+    BenchConsume(filteredBuffer, &filteredLength, head);
+    record = BenchReadUntil(filtered, filteredBuffer, &filteredLength, sizeof(filteredBuffer), "\n\n");
+    failures += BenchCheck(record > 0 && strncmp(filteredBuffer, "id: 3\nevent: network\n", 21) == 0,
+                           "?events= filter");
+    close(filtered);
+    close(sse);
+
+    // WebSocket handshake, envelope, ping and close
+    int ws = BenchConnect(port, 0);
+    const char upgrade[] =
+        "GET /api/events HTTP/1.1\r\nHost: x\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+        "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n";
+    BenchSendAll(ws, upgrade, strlen(upgrade));
+    length = 0;
+    head = BenchReadUntil(ws, buffer, &length, sizeof(buffer), "\r\n\r\n");
+    failures += BenchCheck(head > 0 && strncmp(buffer, "HTTP/1.1 101", 12) == 0 &&
+                           memmem(buffer, head, "Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=", 50) != NULL,
+                           "WebSocket handshake");
+    BenchConsume(buffer, &length, head);
+
+    // Both retained events arrive, oldest retained first
+    const char *expected[] = {"{\"id\":1,\"event\":\"feed\",\"data\":{\"index\":3,\"count\":12}}",
+                              "{\"id\":3,\"event\":\"network\",\"data\":{\"quality\":90}}"};
+    for (int i = 0; i < 2; i++) {
+        int opcode = 0;
+        const uint8_t *payload = NULL;
+        size_t payloadLength = 0, frame = 0;
+        while ((frame = BenchWebSocketFrame((uint8_t *)buffer, length, &opcode, &payload, &payloadLength)) == 0 &&
+               BenchFill(ws, buffer, &length, length + 1, sizeof(buffer), 2.0)) {
+        }
+        failures += BenchCheck(frame > 0 && opcode == RTSPWebSocketOpcodeText && payloadLength == strlen(expected[i]) &&
+                               memcmp(payload, expected[i], payloadLength) == 0, "WebSocket text envelope");
+        if (frame > 0) {
+            BenchConsume(buffer, &length, frame);
+        }
+    }
+
+    BenchSendMaskedFrame(ws, RTSPWebSocketOpcodePing, "hi", 2);
+    BenchSendMaskedFrame(ws, RTSPWebSocketOpcodeClose, "\x03\xe8", 2);
+    int opcodes[2] = {0};
+    for (int i = 0; i < 2; i++) {
+        const uint8_t *payload = NULL;
+        size_t payloadLength = 0, frame = 0;
+        while ((frame = BenchWebSocketFrame((uint8_t *)buffer, length, &opcodes[i], &payload, &payloadLength)) == 0 &&
+               BenchFill(ws, buffer, &length, length + 1, sizeof(buffer), 2.0)) {
+        }
+        if (frame > 0) {
+            BenchConsume(buffer, &length, frame);
+        }
+    }
+    failures += BenchCheck(opcodes[0] == RTSPWebSocketOpcodePong, "pong for ping");
+    failures += BenchCheck(opcodes[1] == RTSPWebSocketOpcodeClose, "close handshake echoed");
+    failures += BenchCheck(!BenchFill(ws, buffer, &length, length + 1, sizeof(buffer), 2.0), "closed after handshake");
+    close(ws);
+
+    // Only GET subscribes
+    int post = BenchConnect(port, 0);
+    const char postRequest[] = "POST /api/events HTTP/1.1\r\nHost: x\r\nContent-Length: 0\r\n\r\n";
+    BenchSendAll(post, postRequest, strlen(postRequest));
+    length = 0;
+    head = BenchReadUntil(post, buffer, &length, sizeof(buffer), "\r\n\r\n");
+    failures += BenchCheck(head > 0 && strncmp(buffer, "HTTP/1.1 400", 12) == 0, "POST answered normally");
+    close(post);
+    return failures;
+}
+
+#pragma mark - Load
+
+typedef struct {
+    int fd;
+    bool webSocket;
+    bool headDone;
+    char *buffer;
+    size_t length;
+    uint64_t lastSequence;
+    uint64_t received;
+    uint64_t outOfOrder;
+} BenchSubscriber;
+
+#define BENCH_SUBSCRIBER_BUFFER (256 * 1024)
+
+typedef struct {
+    BenchSubscriber *subscribers;
+    unsigned count;
+    double measureFrom;
+    double deadline;
+    double *latencies;
+    size_t latencyCount;
+    size_t latencyCapacity;
+    uint64_t closed;
+} BenchReaderThread;
+
+static void BenchRecordEvent(BenchReaderThread *reader, BenchSubscriber *subscriber, const char *data, size_t length,
+                             double now) {
+    const char *sequence = memmem(data, length, "\"seq\":", 6);
+    const char *sent = memmem(data, length, "\"sent\":", 7);
+    if (!sequence || !sent) {
+        return;
+    }
+    uint64_t value = strtoull(sequence + 6, NULL, 10);
+    if (value != subscriber->lastSequence + 1) {
+        subscriber->outOfOrder++;
+    }
+    subscriber->lastSequence = value;
+    subscriber->received++;
+    double published = strtod(sent + 7, NULL);
+    if (published >= reader->measureFrom && reader->latencyCount < reader->latencyCapacity) {
+        reader->latencies[reader->latencyCount++] = now - published;
+    }
+}
+
+static void BenchDrain(BenchReaderThread *reader, BenchSubscriber *subscriber, double now) {
+    if (!subscriber->headDone) {
+        char *end = memmem(subscriber->buffer, subscriber->length, "\r\n\r\n", 4);
+        if (!end) {
+            return;
+        }
+        BenchConsume(subscriber->buffer, &subscriber->length, (size_t)(end - subscriber->buffer) + 4);
+        subscriber->headDone = true;
+    }
+    size_t offset = 0;
+    for (;;) {
+        char *data = subscriber->buffer + offset;
+        size_t available = subscriber->length - offset;
+        if (subscriber->webSocket) {
+            int opcode = 0;
+            const uint8_t *payload = NULL;
+            size_t payloadLength = 0;
+            size_t frame = BenchWebSocketFrame((uint8_t *)data, available, &opcode, &payload, &payloadLength);
+            if (frame == 0) {
+                break;
+            }
+            if (opcode == RTSPWebSocketOpcodeText) {
+                BenchRecordEvent(reader, subscriber, (const char *)payload, payloadLength, now);
+            }
+            offset += frame;
+        } else {
+            char *end = memmem(data, available, "\n\n", 2);
+            if (!end) {
+                break;
+            }
+            BenchRecordEvent(reader, subscriber, data, (size_t)(end - data), now);
+            offset += (size_t)(end - data) + 2;
+        }
+    }
+    BenchConsume(subscriber->buffer, &subscriber->length, offset);
+}
+
+static void *BenchReaderMain(void *argument) {
+    BenchReaderThread *reader = argument;
+    struct pollfd *pfds = calloc(reader->count, sizeof(*pfds));
+    while (BenchNow() < reader->deadline + 0.5) {
+        for (unsigned i = 0; i < reader->count; i++) {
+            pfds[i] = (struct pollfd){.fd = reader->subscribers[i].fd, .events = POLLIN};
+        }
+        if (poll(pfds, reader->count, 50) <= 0) {
+            continue;
+        }
+        double now = BenchNow();
+        for (unsigned i = 0; i < reader->count; i++) {
+            BenchSubscriber *subscriber = &reader->subscribers[i];
+            if (!(pfds[i].revents & (POLLIN | POLLHUP | POLLERR)) || subscriber->fd < 0) {
+                continue;
+            }
+            ssize_t count = recv(subscriber->fd, subscriber->buffer + subscriber->length,
+                                 BENCH_SUBSCRIBER_BUFFER - subscriber->length, 0);
+            if (count <= 0) {
+                close(subscriber->fd);
+                subscriber->fd = -1;
+                reader->closed++;
+                continue;
+            }
+            subscriber->length += (size_t)count;
+            BenchDrain(reader, subscriber, now);
+        }
+    }
+    free(pfds);
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    unsigned sseCount = 48;
+    unsigned webSocketCount = 16;
+    double rate = 500.0;
+    size_t size = 320;
+    double seconds = 5.0;
+    bool stuck = true;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--sse") == 0 && i + 1 < argc) {
+            sseCount = (unsigned)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--websocket") == 0 && i + 1 < argc) {
+            webSocketCount = (unsigned)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+            rate = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            size = (size_t)atol(argv[++i]);
+        } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            seconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--no-stuck") == 0) {
+            stuck = false;
+        } else {
+            fprintf(stderr, "usage: %s [--sse N] [--websocket N] [--rate EVENTS/S] [--size BYTES] [--seconds S] [--no-stuck]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (rate <= 0) {
+        rate = 1;
+    }
+    if (size < 64) {
+        size = 64;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    RTSPHTTPServerConfig config;
+    RTSPHTTPServerConfigInit(&config);
+    config.bindAddress = "127.0.0.1";
+    config.port = 0;
+    RTSPHTTPServerRef server = RTSPHTTPServerCreate(&config);
+    if (!server) {
+        fprintf(stderr, "failed to create server\n");
+        return 1;
+    }
+    RTSPHTTPChannelConfig channelConfig;
+    RTSPHTTPChannelConfigInit(&channelConfig);
+    RTSPHTTPChannelRef checkChannel = RTSPHTTPServerAddChannel(server, &channelConfig);
+    RTSPHTTPChannelRef channel = RTSPHTTPServerAddChannel(server, &channelConfig);
+    uint32_t methods = RTSPHTTPMethodGET | RTSPHTTPMethodPOST;
+    if (!checkChannel || !channel ||
+        !RTSPHTTPServerAddRoute(server, methods, "/api/events", BenchHandleEvents, checkChannel) ||
+        !RTSPHTTPServerAddRoute(server, RTSPHTTPMethodGET, "/api/load", BenchHandleEvents, channel) ||
+        !RTSPHTTPServerStart(server)) {
+        fprintf(stderr, "failed to start server\n");
+        return 1;
+    }
+    uint16_t port = RTSPHTTPServerPort(server);
+
+    printf("push_bench: %u SSE + %u WebSocket subscribers%s, %.0f events/s of %zu bytes, %.0f s\n",
+           sseCount, webSocketCount, stuck ? " + 1 stuck" : "", rate, size, seconds);
+
+    unsigned failures = BenchProtocolChecks(port, checkChannel);
+    printf("  protocol checks:              %s\n", failures ? "FAILED" : "ok");
+
+    // Subscribers
+    unsigned count = sseCount + webSocketCount;
+    BenchSubscriber *subscribers = calloc(count ? count : 1, sizeof(*subscribers));
+    for (unsigned i = 0; i < count; i++) {
+        BenchSubscriber *subscriber = &subscribers[i];
+        subscriber->webSocket = i >= sseCount;
+        subscriber->buffer = malloc(BENCH_SUBSCRIBER_BUFFER);
+        subscriber->fd = BenchConnect(port, 0);
+        const char *request = subscriber->webSocket
+            ? "GET /api/load HTTP/1.1\r\nHost: x\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+              "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n"
+            : "GET /api/load HTTP/1.1\r\nHost: x\r\nAccept: text/event-stream\r\n\r\n";
+        if (subscriber->fd < 0 || !BenchSendAll(subscriber->fd, request, strlen(request))) {
+            fprintf(stderr, "failed to subscribe\n");
+            return 1;
+        }
+    }
+    int stuckFd = -1;
+    if (stuck) {
+        stuckFd = BenchConnect(port, 4096);
+        const char *request = "GET /api/load HTTP/1.1\r\nHost: x\r\nAccept: text/event-stream\r\n\r\n";
+        BenchSendAll(stuckFd, request, strlen(request));
+    }
+    double settle = BenchNow() + 2.0;
+    while (RTSPHTTPChannelGetStatistics(channel).subscribers < count + (stuck ? 1 : 0) && BenchNow() < settle) {
+        usleep(1000);
+    }
+
+    double start = BenchNow();
+    size_t events = (size_t)(rate * (seconds + 0.5)) + 16;
+    BenchReaderThread reader = {
+        .subscribers = subscribers,
+        .count = count,
+        .measureFrom = start + 0.5,
+        .deadline = start + 0.5 + seconds,
+        .latencies = malloc(events * (count ? count : 1) * sizeof(double)),
+        .latencyCapacity = events * count,
+    };
+    pthread_t readerThread;
+    pthread_create(&readerThread, NULL, BenchReaderMain, &reader);
+
+    // Producer: a detection-sized JSON object on a fixed schedule
+    char *payload = malloc(size + 1);
+    double *publishCosts = malloc(events * sizeof(double));
+    size_t published = 0, measuredPublishes = 0;
+    double interval = 1.0 / rate;
+    double next = start;
+    while (next < reader.deadline && published < events) {
+        double now = BenchNow();
+        if (now < next) {
+            struct timespec pause = {0, (long)((next - now) * 1e9)};
+            nanosleep(&pause, NULL);
+            continue;
+        }
+        int prefix = snprintf(payload, size + 1, "{\"seq\":%zu,\"sent\":%.9f,\"label\":\"person\",\"pad\":\"",
+                              published + 1, BenchNow());
+        memset(payload + prefix, 'x', size - (size_t)prefix - 2);
+        memcpy(payload + size - 2, "\"}", 2);
+        payload[size] = '\0';
+        double before = BenchNow();
+        RTSPHTTPChannelPublish(channel, "detection", payload, size, false);
+        double cost = BenchNow() - before;
+        published++;
+        if (before >= reader.measureFrom) {
+            publishCosts[measuredPublishes++] = cost;
+        }
+        next += interval;
+    }
+    pthread_join(readerThread, NULL);
+    RTSPHTTPChannelStatistics statistics = RTSPHTTPChannelGetStatistics(channel);
+
+    qsort(publishCosts, measuredPublishes, sizeof(double), BenchCompareDouble);
+    qsort(reader.latencies, reader.latencyCount, sizeof(double), BenchCompareDouble);
+    double publishP50 = BenchPercentile(publishCosts, measuredPublishes, 0.50) * 1e6;
+    double publishP99 = BenchPercentile(publishCosts, measuredPublishes, 0.99) * 1e6;
+    double publishMax = measuredPublishes ? publishCosts[measuredPublishes - 1] * 1e6 : 0;
+    double deliveryP50 = BenchPercentile(reader.latencies, reader.latencyCount, 0.50) * 1e3;
+    double deliveryP99 = BenchPercentile(reader.latencies, reader.latencyCount, 0.99) * 1e3;
+    double deliveryMax = reader.latencyCount ? reader.latencies[reader.latencyCount - 1] * 1e3 : 0;
+
+    uint64_t missing = 0, outOfOrder = 0;
+    for (unsigned i = 0; i < count; i++) {
+        missing += published - subscribers[i].received;
+        outOfOrder += subscribers[i].outOfOrder;
+    }
+    bool publishMet = measuredPublishes > 0 && publishP99 <= BENCH_TARGET_PUBLISH_P99_US;
+    bool deliveryMet = reader.latencyCount > 0 && deliveryP99 <= BENCH_TARGET_DELIVERY_P99_MS;
+    bool stuckDropped = !stuck || statistics.droppedSubscribers == 1;
+
+    printf("  publish:                      p50 %6.1f us   p99 %6.1f us   max %7.1f us   %s\n",
+           publishP50, publishP99, publishMax, publishMet ? "ok" : "MISSED");
+    printf("  delivery:                     p50 %6.2f ms   p99 %6.2f ms   max %7.2f ms   %s\n",
+           deliveryP50, deliveryP99, deliveryMax, deliveryMet ? "ok" : "MISSED");
+    printf("  targets:                      publish p99 <= %.0f us, delivery p99 <= %.0f ms\n",
+           BENCH_TARGET_PUBLISH_P99_US, BENCH_TARGET_DELIVERY_P99_MS);
+    printf("  fan-out:                      %zu events x %u subscribers, %llu missing, %llu out of order, %llu disconnected\n",
+           published, count, (unsigned long long)missing, (unsigned long long)outOfOrder,
+           (unsigned long long)reader.closed);
+    printf("  stuck subscriber:             %s\n",
+           !stuck ? "n/a" : stuckDropped ? "dropped" : "NOT dropped");
+    printf("  channel:                      %llu published, %llu delivered, %llu dropped, %u subscribed\n",
+           (unsigned long long)statistics.published, (unsigned long long)statistics.delivered,
+           (unsigned long long)statistics.droppedSubscribers, statistics.subscribers);
+
+    for (unsigned i = 0; i < count; i++) {
+        if (subscribers[i].fd >= 0) {
+            close(subscribers[i].fd);
+        }
+        free(subscribers[i].buffer);
+    }
+    if (stuckFd >= 0) {
+        close(stuckFd);
+    }
+    RTSPHTTPServerRelease(server);
+    free(subscribers);
+    free(reader.latencies);
+    free(publishCosts);
+    free(payload);
+
+    bool delivered = missing == 0 && outOfOrder == 0 && reader.closed == 0;
+    if (failures > 0 || !publishMet || !deliveryMet || !stuckDropped || !delivered) {
+        fprintf(stderr, "FAIL: %u protocol check(s)%s%s%s%s\n", failures,
+                publishMet ? "" : ", publish target missed", deliveryMet ? "" : ", delivery target missed",
+                stuckDropped ? "" : ", stuck subscriber kept", delivered ? "" : ", events lost");
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,542 @@
+//
+//  remux_bench.c
+//  RTSP Rotator Benchmarks
+//
+//  Load test for RTSPRemuxEngine and the in-memory LL-HLS path. A forked
+//  child runs the loopback RTSPS camera simulator (Digest auth, self-signed
+//  certificate, synthetic 1080p H.264); the parent remuxes N streams on the
+//  single engine thread into RTSPHLSStore windows published by
+//  RTSPHLSServer, and reports ingest throughput, CPU and resident memory
+//  per stream. Every init segment, part and segment is sanity checked, and
+//  each stream is then played over HTTP: playlist, blocking reload on the
+//  preload hint, every listed part and segment.
+//
+//  Stream 0 connects through a host name whose first address refuses
+//  connections, and one extra stream's host takes 30 s to resolve, like a
+//  dead DNS server; neither may hold up the others.
+//
+//  Build (Linux):
+//    cc -O2 -std=gnu11 -DRTSP_REMUX_USE_OPENSSL -I"../RTSP Rotator" remux_bench.c rtsp_loopback_server.c "../RTSP Rotator/RTSPRemuxEngine.c" "../RTSP Rotator/RTSPHLSStore.c" "../RTSP Rotator/RTSPHLSServer.c" "../RTSP Rotator/RTSPTransport.c" "../RTSP Rotator/RTSPProtocol.c" "../RTSP Rotator/RTSPRTPDepacketizer.c" "../RTSP Rotator/RTSPFMP4Writer.c" "../RTSP Rotator/RTSPCodecConfig.c" "../RTSP Rotator/RTSPByteBuffer.c" -lssl -lcrypto -lpthread -lm -o remux_bench
+//
+//  Usage: remux_bench [--streams N] [--seconds S] [--fps F] [--bitrate KBPS] [--part SECONDS] [--plain] [--flood]
+//    --part   LL-HLS part target, 0 for whole segments only (default 0.2)
+//    --plain  serve rtsp:// instead of rtsps://
+//    --flood  stream as fast as the engine reads (measures remux ceiling)
+//
+
+#define _GNU_SOURCE
+
+#include "RTSPHLSServer.h"
+#include "RTSPHLSStore.h"
+#include "RTSPRemuxEngine.h"
+#include "RTSPTransport.h"
+#include "rtsp_loopback_server.h"
+
+#include <arpa/inet.h>
+#include <math.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct {
+    RTSPHLSStoreRef store;
+    atomic_uint_fast64_t segmentBytes;
+    atomic_uint segments;
+    atomic_uint parts;
+    atomic_uint initSegments;
+    atomic_uint errors;
+    _Atomic double lastPartAt;      // When the newest part entered the store
+} BenchStream;
+
+static double BenchNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static double BenchCPUSeconds(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (double)usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+           (double)usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+static double BenchResidentMB(void) {
+    FILE *file = fopen("/proc/self/statm", "r");
+    long pages = 0, resident = 0;
+    if (file) {
+        if (fscanf(file, "%ld %ld", &pages, &resident) != 2) {
+            resident = 0;
+        }
+        fclose(file);
+    }
+    return (double)resident * (double)sysconf(_SC_PAGESIZE) / (1024.0 * 1024.0);
+}
+
+static const uint8_t *BenchFindBox(const uint8_t *data, size_t length, const char *type) {
+    for (size_t i = 4; i + 4 <= length; i++) {
+        if (memcmp(data + i, type, 4) == 0) {
+            return data + i - 4;
+        }
+    }
+    return NULL;
+}
+
+static uint32_t BenchU32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+#pragma mark - Sink
+
+static void BenchInitSegment(void *context, uint32_t initID, const uint8_t *data, size_t length) {
+    BenchStream *stream = context;
+    if (length < 8 || memcmp(data + 4, "ftyp", 4) != 0 || !BenchFindBox(data, length, "avcC")) {
+        atomic_fetch_add(&stream->errors, 1);
+    }
+    RTSPHLSStoreAddInitSegment(stream->store, initID, data, length);
+    atomic_fetch_add(&stream->initSegments, 1);
+}
+
+static void BenchPart(void *context, const RTSPRemuxMediaInfo *info, const uint8_t *data, size_t length) {
+    BenchStream *stream = context;
+    if (length < 8 || memcmp(data + 4, "moof", 4) != 0 || info->duration <= 0 || info->duration > 1.0) {
+        atomic_fetch_add(&stream->errors, 1);
+    }
+    atomic_store(&stream->lastPartAt, BenchNow()); // Before the store wakes any blocked reader
+    atomic_fetch_add(&stream->parts, 1);
+    RTSPHLSStoreAddPart(stream->store, info, data, length);
+}
+
+static void BenchSegment(void *context, const RTSPRemuxMediaInfo *info, const uint8_t *data, size_t length) {
+    BenchStream *stream = context;
+    const uint8_t *trun = BenchFindBox(data, length, "trun");
+    // Every segment must open with a sync sample: size, type, version/flags,
+    // sample_count, data_offset, then duration, size, flags of sample 0
+    bool valid = length > 8 && memcmp(data + 4, "moof", 4) == 0 && trun &&
+                 (size_t)(trun - data) + 32 <= length && BenchU32(trun + 28) == 0x02000000u &&
+                 info->independent && info->duration > 0.5 && info->duration < 10.0;
+    if (!valid) {
+        atomic_fetch_add(&stream->errors, 1);
+    }
+    RTSPHLSStoreAddSegment(stream->store, info, data, length);
+    atomic_fetch_add(&stream->segmentBytes, length);
+    atomic_fetch_add(&stream->segments, 1);
+}
+
+static void BenchStateChanged(void *context, RTSPRemuxStreamState state, const char *message) {
+    (void)context;
+    if (state == RTSPRemuxStreamReconnecting) {
+        fprintf(stderr, "  stream failed: %s\n", message ? message : "(no message)");
+    }
+}
+
+#pragma mark - HTTP Client
+
+typedef struct {
+    int fd;
+    int status;
+    char *body;
+    size_t length;
+    size_t capacity;
+} BenchHTTP;
+
+static bool BenchHTTPConnect(BenchHTTP *http, uint16_t port) {
+    memset(http, 0, sizeof(*http));
+    http->fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in address = {.sin_family = AF_INET, .sin_port = htons(port)};
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    return http->fd >= 0 && connect(http->fd, (struct sockaddr *)&address, sizeof(address)) == 0;
+}
+
+/// One request on the keep-alive connection; the body lands in http->body
+static bool BenchHTTPGet(BenchHTTP *http, const char *path) {
+    char request[512];
+    int length = snprintf(request, sizeof(request), "GET %s HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n", path);
+    if (send(http->fd, request, (size_t)length, MSG_NOSIGNAL) != length) {
+        return false;
+    }
+    char head[4096];
+    size_t used = 0;
+    char *end = NULL;
+    while (!end) {
+        if (used == sizeof(head) - 1 || recv(http->fd, head + used, 1, 0) != 1) {
+            return false; // Byte-wise keeps the body unread; fine for a test client
+        }
+        head[++used] = '\0';
+        end = used >= 4 && memcmp(head + used - 4, "\r\n\r\n", 4) == 0 ? head + used : NULL;
+    }
+    http->status = atoi(head + 9);
+    char *field = strstr(head, "Content-Length:");
+    size_t bodyLength = field ? strtoul(field + 15, NULL, 10) : 0;
+    if (bodyLength + 1 > http->capacity) {
+        char *body = realloc(http->body, bodyLength + 1);
+        if (!body) {
+            return false;
+        }
+        http->body = body;
+        http->capacity = bodyLength + 1;
+    }
+    size_t received = 0;
+    while (received < bodyLength) {
+        ssize_t count = recv(http->fd, http->body + received, bodyLength - received, 0);
+        if (count <= 0) {
+            return false;
+        }
+        received += (size_t)count;
+    }
+    http->body[bodyLength] = '\0';
+    http->length = bodyLength;
+    return true;
+}
+
+static void BenchHTTPClose(BenchHTTP *http) {
+    close(http->fd);
+    free(http->body);
+}
+
+typedef struct {
+    double delivery;                // Summed part-in-store to playlist-received time of blocking reloads
+    unsigned blockedCount;
+    unsigned resources;             // Parts, segments and init segments fetched
+    uint64_t bytes;
+} BenchPlayback;
+
+/// Plays one stream the way an LL-HLS client does. Returns false on any mismatch.
+static bool BenchPlayStream(uint16_t port, unsigned index, BenchStream *stream, bool lowLatency, BenchPlayback *playback) {
+    BenchHTTP http;
+    char path[256];
+    bool ok = BenchHTTPConnect(&http, port);
+    snprintf(path, sizeof(path), "/cam%u/stream.m3u8", index);
+    ok = ok && BenchHTTPGet(&http, path) && http.status == 200 &&
+         strncmp(http.body, "#EXTM3U", 7) == 0 && strstr(http.body, "#EXT-X-MAP:URI=\"init_") &&
+         strstr(http.body, "CAN-BLOCK-RELOAD=YES");
+
+    if (ok && lowLatency) {
+        // Block on the hinted part, as a player at the live edge does
+        unsigned msn = 0, part = 0;
+        char *hint = strstr(http.body, "#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\"part_");
+        ok = hint && sscanf(hint, "#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\"part_%u.%u.m4s", &msn, &part) == 2 &&
+             strstr(http.body, "#EXT-X-PART-INF:PART-TARGET=");
+        snprintf(path, sizeof(path), "/cam%u/stream.m3u8?_HLS_msn=%u&_HLS_part=%u", index, msn, part);
+        ok = ok && BenchHTTPGet(&http, path) && http.status == 200;
+        playback->delivery += BenchNow() - atomic_load(&stream->lastPartAt);
+        playback->blockedCount++;
+        char expected[64];
+        snprintf(expected, sizeof(expected), "URI=\"part_%u.%u.m4s\"", msn, part);
+        ok = ok && strstr(http.body, expected) != NULL;
+    }
+
+    // Fetch everything the playlist references on the same connection
+    char *playlist = ok ? strdup(http.body) : NULL;
+    for (char *line = playlist; ok && line && *line; ) {
+        char *next = strchr(line, '\n');
+        if (next) {
+            *next++ = '\0';
+        }
+        char name[64] = "";
+        if (strncmp(line, "segment_", 8) == 0) {
+            snprintf(name, sizeof(name), "%s", line);
+        } else if (sscanf(line, "#EXT-X-PART:DURATION=%*[0-9.],URI=\"%63[^\"]", name) == 1 ||
+                   sscanf(line, "#EXT-X-MAP:URI=\"%63[^\"]", name) == 1) {
+        }
+        if (name[0]) {
+            snprintf(path, sizeof(path), "/cam%u/%s", index, name);
+            bool init = strncmp(name, "init_", 5) == 0;
+            unsigned sequence = 0;
+            ok = BenchHTTPGet(&http, path);
+            if (ok && http.status == 404 && sscanf(name, "%*[a-z]_%u", &sequence) == 1 &&
+                sequence < RTSPHLSStoreGetStatistics(stream->store).firstSequence) {
+                // Slid out of the window while we were fetching older entries
+            } else {
+                ok = ok && http.status == 200 && http.length > 8 && memcmp(http.body + 4, init ? "ftyp" : "moof", 4) == 0;
+                playback->resources++;
+                playback->bytes += http.length;
+            }
+        }
+        line = next;
+    }
+    free(playlist);
+
+    snprintf(path, sizeof(path), "/cam%u/segment_1.m4x", index);
+    ok = ok && BenchHTTPGet(&http, path) && http.status == 404;
+    BenchHTTPClose(&http);
+    return ok;
+}
+
+#pragma mark - Resolver
+
+#define BENCH_SLOW_HOST "slow.camera.test"
+#define BENCH_FALLBACK_HOST "fallback.camera.test"
+#define BENCH_SLOW_RESOLVE_SECONDS 30
+
+/// The slow host hangs like a dead DNS server; the fallback host lists an
+/// address nothing listens on before the loopback server's
+static int BenchResolve(const char *host, const char *service, const struct addrinfo *hints, struct addrinfo **results) {
+    if (strcmp(host, BENCH_SLOW_HOST) == 0) {
+        sleep(BENCH_SLOW_RESOLVE_SECONDS);
+        return EAI_NONAME;
+    }
+    if (strcmp(host, BENCH_FALLBACK_HOST) == 0) {
+        struct addrinfo *refusing = NULL;
+        struct addrinfo *listening = NULL;
+        if (getaddrinfo("127.0.0.2", service, hints, &refusing) != 0) {
+            return EAI_FAIL;
+        }
+        if (getaddrinfo("127.0.0.1", service, hints, &listening) != 0) {
+            freeaddrinfo(refusing);
+            return EAI_FAIL;
+        }
+        struct addrinfo *last = refusing;
+        while (last->ai_next) {
+            last = last->ai_next;
+        }
+        last->ai_next = listening;
+        *results = refusing;
+        return 0;
+    }
+    return getaddrinfo(host, service, hints, results);
+}
+
+#pragma mark - Server Process
+
+static pid_t BenchStartServer(const RTSPLoopbackConfig *config, uint16_t *port, int *control) {
+    int portPipe[2], controlPipe[2];
+    if (pipe(portPipe) != 0 || pipe(controlPipe) != 0) {
+        return -1;
+    }
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(portPipe[0]);
+        close(controlPipe[1]);
+        RTSPLoopbackServerRef server = RTSPLoopbackServerStart(config);
+        uint16_t serverPort = RTSPLoopbackServerPort(server);
+        if (write(portPipe[1], &serverPort, sizeof(serverPort)) != sizeof(serverPort)) {
+            _exit(1);
+        }
+        char byte;
+        while (read(controlPipe[0], &byte, 1) > 0) {
+        }
+        RTSPLoopbackServerStop(server);
+        _exit(0);
+    }
+    close(portPipe[1]);
+    close(controlPipe[0]);
+    if (read(portPipe[0], port, sizeof(*port)) != sizeof(*port) || *port == 0) {
+        return -1;
+    }
+    close(portPipe[0]);
+    *control = controlPipe[1];
+    return pid;
+}
+
+int main(int argc, char **argv) {
+    unsigned streams = 16;
+    double seconds = 10.0;
+    double partTarget = 0.2;
+    RTSPLoopbackConfig serverConfig;
+    RTSPLoopbackConfigInit(&serverConfig);
+    serverConfig.tls = true;
+    serverConfig.user = "admin";
+    serverConfig.password = "p@ss word";
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--streams") == 0 && i + 1 < argc) {
+            streams = (unsigned)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            seconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+            serverConfig.fps = (unsigned)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--bitrate") == 0 && i + 1 < argc) {
+            serverConfig.bitrateKbps = (unsigned)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--part") == 0 && i + 1 < argc) {
+            partTarget = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--plain") == 0) {
+            serverConfig.tls = false;
+        } else if (strcmp(argv[i], "--flood") == 0) {
+            serverConfig.fps = 0;
+        } else {
+            fprintf(stderr, "usage: %s [--streams N] [--seconds S] [--fps F] [--bitrate KBPS] [--part SECONDS] [--plain] [--flood]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (streams == 0) {
+        streams = 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    RTSPTransportSetResolver(BenchResolve);
+
+    uint16_t port = 0;
+    int control = -1;
+    pid_t server = BenchStartServer(&serverConfig, &port, &control);
+    if (server < 0) {
+        fprintf(stderr, "failed to start loopback server\n");
+        return 1;
+    }
+
+    printf("remux_bench: %u %s streams, 1080p H.264 @ %s, %u kbps, %.0f s, %s\n",
+           streams, serverConfig.tls ? "RTSPS" : "RTSP",
+           serverConfig.fps ? "fixed fps" : "flood", serverConfig.bitrateKbps, seconds,
+           partTarget > 0 ? "LL-HLS parts" : "whole segments");
+
+    double baselineRSS = BenchResidentMB();
+    RTSPRemuxConfig engineConfig;
+    RTSPRemuxConfigInit(&engineConfig);
+    engineConfig.partTargetDuration = partTarget;
+    RTSPRemuxEngineRef engine = RTSPRemuxEngineCreate(&engineConfig);
+    RTSPHLSStoreConfig storeConfig;
+    RTSPHLSStoreConfigInit(&storeConfig);
+    storeConfig.partTargetDuration = partTarget;
+    RTSPHLSServerRef http = RTSPHLSServerCreate(NULL);
+    if (!engine || !http) {
+        fprintf(stderr, "failed to start engine or HLS server\n");
+        return 1;
+    }
+    BenchStream *contexts = calloc(streams, sizeof(*contexts));
+    uint32_t *identifiers = calloc(streams, sizeof(*identifiers));
+    RTSPRemuxSink sink = {
+        .initSegment = BenchInitSegment,
+        .part = BenchPart,
+        .segment = BenchSegment,
+        .stateChanged = BenchStateChanged,
+    };
+
+    double start = BenchNow();
+    for (unsigned i = 0; i < streams; i++) {
+        char url[256];
+        snprintf(url, sizeof(url), "%s://admin:p%%40ss%%20word@%s:%u/proxy/cam%u",
+                 serverConfig.tls ? "rtsps" : "rtsp", i == 0 ? BENCH_FALLBACK_HOST : "127.0.0.1", port, i);
+        char name[32];
+        snprintf(name, sizeof(name), "cam%u", i);
+        contexts[i].store = RTSPHLSStoreCreate(&storeConfig);
+        RTSPHLSServerPublish(http, name, contexts[i].store);
+        identifiers[i] = RTSPRemuxEngineAddStream(engine, url, &sink, &contexts[i]);
+        if (identifiers[i] == 0) {
+            fprintf(stderr, "AddStream failed for %s\n", url);
+            return 1;
+        }
+    }
+
+    char slowURL[256];
+    snprintf(slowURL, sizeof(slowURL), "rtsp://%s:%u/proxy/slow", BENCH_SLOW_HOST, port);
+    uint32_t slowIdentifier = RTSPRemuxEngineAddStream(engine, slowURL, NULL, NULL);
+
+    // Warm up: every stream playable from its store
+    bool ready = false;
+    while (!ready && BenchNow() - start < 15.0) {
+        usleep(10000);
+        ready = true;
+        for (unsigned i = 0; i < streams; i++) {
+            ready = ready && RTSPHLSStoreIsPlayable(contexts[i].store);
+        }
+    }
+    double warmup = BenchNow() - start;
+    if (!ready) {
+        fprintf(stderr, "streams did not start within 15 s\n");
+    }
+
+    uint64_t bytesBefore = 0;
+    for (unsigned i = 0; i < streams; i++) {
+        RTSPRemuxStreamStatistics statistics;
+        RTSPRemuxEngineGetStatistics(engine, identifiers[i], &statistics);
+        bytesBefore += statistics.bytesReceived;
+    }
+    double cpuBefore = BenchCPUSeconds();
+    double measureStart = BenchNow();
+    usleep((useconds_t)(seconds * 1e6));
+    double elapsed = BenchNow() - measureStart;
+    double cpu = BenchCPUSeconds() - cpuBefore;
+    double rss = BenchResidentMB();
+
+    uint64_t bytes = 0, lost = 0, accessUnits = 0, segments = 0, parts = 0, held = 0, evicted = 0;
+    unsigned failures = 0;
+    BenchPlayback playback = {0};
+    for (unsigned i = 0; i < streams; i++) {
+        RTSPRemuxStreamStatistics statistics;
+        RTSPRemuxEngineGetStatistics(engine, identifiers[i], &statistics);
+        bytes += statistics.bytesReceived;
+        lost += statistics.lostPackets;
+        accessUnits += statistics.accessUnits;
+        segments += atomic_load(&contexts[i].segments);
+        parts += atomic_load(&contexts[i].parts);
+        RTSPHLSStoreStatistics window = RTSPHLSStoreGetStatistics(contexts[i].store);
+        held += window.bytes;
+        evicted += window.evictedSegments;
+        bool played = BenchPlayStream(RTSPHLSServerPort(http), i, &contexts[i], partTarget > 0, &playback);
+        bool ok = statistics.state == RTSPRemuxStreamPlaying && statistics.width == 1920 &&
+                  statistics.height == 1080 && strcmp(statistics.codecString, "avc1.640029") == 0 &&
+                  atomic_load(&contexts[i].segments) > 0 && atomic_load(&contexts[i].errors) == 0 &&
+                  (partTarget <= 0 || atomic_load(&contexts[i].parts) > 0) &&
+                  window.segments <= storeConfig.segmentCount && window.bytes <= storeConfig.maxBytes &&
+                  statistics.reconnects == 0 && played;
+        if (!ok) {
+            if (failures++ < 4) {
+                fprintf(stderr, "  stream %u: state %d %ux%u %s segments %u parts %u errors %u reconnects %u window %u/%zu B played %d\n",
+                        i, statistics.state, statistics.width, statistics.height, statistics.codecString,
+                        atomic_load(&contexts[i].segments), atomic_load(&contexts[i].parts),
+                        atomic_load(&contexts[i].errors), statistics.reconnects, window.segments, window.bytes, played);
+            }
+        }
+    }
+    bytes -= bytesBefore;
+
+    RTSPRemuxStreamStatistics slow = {0};
+    bool slowIsolated = slowIdentifier != 0 && RTSPRemuxEngineGetStatistics(engine, slowIdentifier, &slow) &&
+                        slow.state != RTSPRemuxStreamPlaying && ready;
+
+    RTSPHLSServerStatistics served = RTSPHLSServerGetStatistics(http);
+    printf("  startup (all streams playable):              %8.1f ms\n", warmup * 1000.0);
+    printf("  ingest:                                      %8.1f Mbit/s (%.2f Mbit/s per stream)\n",
+           bytes * 8.0 / elapsed / 1e6, bytes * 8.0 / elapsed / 1e6 / streams);
+    printf("  access units remuxed:                        %8.0f /s\n", accessUnits / (elapsed + warmup));
+    printf("  segments / parts produced:                   %8llu / %llu\n",
+           (unsigned long long)segments, (unsigned long long)parts);
+    printf("  in-memory HLS window:                        %8.1f MB total, %.2f MB per stream, %llu segments evicted\n",
+           held / (1024.0 * 1024.0), held / (1024.0 * 1024.0) / streams, (unsigned long long)evicted);
+    if (playback.blockedCount > 0) {
+        printf("  blocking reload, part stored to delivered:   %8.2f ms mean\n",
+               playback.delivery / playback.blockedCount * 1000.0);
+    }
+    printf("  HTTP: %llu requests, %llu blocked, %u resources / %.1f MB played back\n",
+           (unsigned long long)served.requests, (unsigned long long)served.blockedRequests,
+           playback.resources, playback.bytes / (1024.0 * 1024.0));
+    printf("  engine CPU:                                  %8.2f %% of one core (%.3f %% per stream)\n",
+           cpu / elapsed * 100.0, cpu / elapsed * 100.0 / streams);
+    printf("  resident memory:                             %8.1f MB total, %.2f MB per stream\n",
+           rss - baselineRSS, (rss - baselineRSS) / streams);
+    printf("  lost packets:                                %8llu\n", (unsigned long long)lost);
+    printf("  slow DNS (one host hangs):                   %8s (stream 0 fell back past a refusing address)\n",
+           slowIsolated ? "isolated" : "BLOCKED");
+
+    for (unsigned i = 0; i < streams; i++) {
+        RTSPRemuxEngineRemoveStream(engine, identifiers[i]);
+    }
+    RTSPRemuxEngineRemoveStream(engine, slowIdentifier);
+    bool drained = RTSPRemuxEngineStreamCount(engine) == 0;
+    RTSPRemuxEngineRelease(engine);
+    RTSPHLSServerRelease(http);
+    for (unsigned i = 0; i < streams; i++) {
+        RTSPHLSStoreRelease(contexts[i].store);
+    }
+
+    close(control);
+    waitpid(server, NULL, 0);
+    free(contexts);
+    free(identifiers);
+
+    if (failures > 0 || lost > 0 || !drained || !slowIsolated) {
+        fprintf(stderr, "FAIL: %u of %u streams unhealthy, %llu packets lost%s\n",
+                failures, streams, (unsigned long long)lost, slowIsolated ? "" : ", slow DNS held up the engine");
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,662 @@
+//
+//  rtsp_loopback_server.c
+//  RTSP Rotator Benchmarks
+//
+
+#define _GNU_SOURCE
+
+#include "rtsp_loopback_server.h"
+#include "RTSPProtocol.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LOOPBACK_MTU_PAYLOAD 1400
+#define LOOPBACK_REALM "RTSP Rotator Loopback"
+#define LOOPBACK_RANDOM_POOL (4 * 1024 * 1024)
+
+struct RTSPLoopbackServer {
+    RTSPLoopbackConfig config;
+    int listenFD;
+    uint16_t port;
+    SSL_CTX *tls;
+    pthread_t acceptThread;
+    atomic_bool stopping;
+    atomic_int connections;
+    atomic_uint_fast64_t bytesSent;
+
+    uint8_t sps[64];
+    size_t spsLength;
+    uint8_t pps[16];
+    size_t ppsLength;
+    uint8_t *random;
+};
+
+typedef struct {
+    RTSPLoopbackServerRef server;
+    int fd;
+    SSL *ssl;
+    RTSPByteBuffer input;
+    RTSPByteBuffer output;
+    RTSPMessage message;
+    char nonce[33];
+    char session[17];
+    bool playing;
+    bool closing;
+
+    uint16_t sequence;
+    uint32_t timestamp;
+    uint32_t ssrc;
+    uint64_t frame;
+    size_t randomOffset;
+} LoopbackConnection;
+
+void RTSPLoopbackConfigInit(RTSPLoopbackConfig *config) {
+    memset(config, 0, sizeof(*config));
+    config->fps = 30;
+    config->bitrateKbps = 4000;
+    config->gop = 30;
+    config->width = 1920;
+    config->height = 1080;
+}
+
+#pragma mark - Bitstream
+
+typedef struct {
+    uint8_t bytes[64];
+    size_t bit;
+} LoopbackBitWriter;
+
+static void LoopbackPutBit(LoopbackBitWriter *w, unsigned value) {
+    if (value) {
+        w->bytes[w->bit / 8] |= (uint8_t)(0x80 >> (w->bit % 8));
+    }
+    w->bit++;
+}
+
+static void LoopbackPutBits(LoopbackBitWriter *w, uint32_t value, int count) {
+    for (int i = count - 1; i >= 0; i--) {
+        LoopbackPutBit(w, (value >> i) & 1);
+    }
+}
+
+static void LoopbackPutUE(LoopbackBitWriter *w, uint32_t value) {
+    uint32_t coded = value + 1;
+    int bits = 0;
+    while ((coded >> bits) > 1) {
+        bits++;
+    }
+    LoopbackPutBits(w, 0, bits);
+    LoopbackPutBits(w, coded, bits + 1);
+}
+
+static size_t LoopbackFinishNAL(LoopbackBitWriter *w, uint8_t header, uint8_t *nal, size_t size) {
+    LoopbackPutBit(w, 1); // rbsp_stop_one_bit
+    size_t length = (w->bit + 7) / 8;
+    size_t written = 0;
+    int zeros = 0;
+    nal[written++] = header;
+    for (size_t i = 0; i < length && written + 1 < size; i++) {
+        if (zeros >= 2 && w->bytes[i] <= 3) {
+            nal[written++] = 0x03;
+            zeros = 0;
+        }
+        nal[written++] = w->bytes[i];
+        zeros = w->bytes[i] == 0 ? zeros + 1 : 0;
+    }
+    return written;
+}
+
+static void LoopbackBuildParameterSets(RTSPLoopbackServerRef server) {
+    unsigned width = server->config.width;
+    unsigned height = server->config.height;
+    unsigned mbWidth = (width + 15) / 16;
+    unsigned mbHeight = (height + 15) / 16;
+
+    LoopbackBitWriter sps = {{0}, 0};
+    LoopbackPutBits(&sps, 100, 8);        // profile_idc: High
+    LoopbackPutBits(&sps, 0, 8);          // constraint flags
+    LoopbackPutBits(&sps, 41, 8);         // level_idc 4.1
+    LoopbackPutUE(&sps, 0);               // seq_parameter_set_id
+    LoopbackPutUE(&sps, 1);               // chroma_format_idc 4:2:0
+    LoopbackPutUE(&sps, 0);               // bit_depth_luma_minus8
+    LoopbackPutUE(&sps, 0);               // bit_depth_chroma_minus8
+    LoopbackPutBit(&sps, 0);              // qpprime_y_zero_transform_bypass
+    LoopbackPutBit(&sps, 0);              // seq_scaling_matrix_present
+    LoopbackPutUE(&sps, 0);               // log2_max_frame_num_minus4
+    LoopbackPutUE(&sps, 2);               // pic_order_cnt_type
+    LoopbackPutUE(&sps, 1);               // max_num_ref_frames
+    LoopbackPutBit(&sps, 0);              // gaps_in_frame_num_allowed
+    LoopbackPutUE(&sps, mbWidth - 1);
+    LoopbackPutUE(&sps, mbHeight - 1);
+    LoopbackPutBit(&sps, 1);              // frame_mbs_only
+    LoopbackPutBit(&sps, 1);              // direct_8x8_inference
+    bool crop = mbWidth * 16 != width || mbHeight * 16 != height;
+    LoopbackPutBit(&sps, crop);
+    if (crop) {
+        LoopbackPutUE(&sps, 0);
+        LoopbackPutUE(&sps, (mbWidth * 16 - width) / 2);
+        LoopbackPutUE(&sps, 0);
+        LoopbackPutUE(&sps, (mbHeight * 16 - height) / 2);
+    }
+    LoopbackPutBit(&sps, 0);              // vui_parameters_present
+    server->spsLength = LoopbackFinishNAL(&sps, 0x67, server->sps, sizeof(server->sps));
+
+    LoopbackBitWriter pps = {{0}, 0};
+    LoopbackPutUE(&pps, 0);               // pic_parameter_set_id
+    LoopbackPutUE(&pps, 0);               // seq_parameter_set_id
+    LoopbackPutBit(&pps, 1);              // entropy_coding_mode (CABAC)
+    LoopbackPutBit(&pps, 0);              // bottom_field_pic_order_in_frame_present
+    LoopbackPutUE(&pps, 0);               // num_slice_groups_minus1
+    LoopbackPutUE(&pps, 0);               // num_ref_idx_l0_default_active_minus1
+    LoopbackPutUE(&pps, 0);               // num_ref_idx_l1_default_active_minus1
+    LoopbackPutBit(&pps, 0);              // weighted_pred
+    LoopbackPutBits(&pps, 0, 2);          // weighted_bipred_idc
+    LoopbackPutUE(&pps, 0);               // pic_init_qp_minus26 (se(0) == ue(0))
+    LoopbackPutUE(&pps, 0);               // pic_init_qs_minus26
+    LoopbackPutUE(&pps, 0);               // chroma_qp_index_offset
+    LoopbackPutBit(&pps, 1);              // deblocking_filter_control_present
+    LoopbackPutBit(&pps, 0);              // constrained_intra_pred
+    LoopbackPutBit(&pps, 0);              // redundant_pic_cnt_present
+    server->ppsLength = LoopbackFinishNAL(&pps, 0x68, server->pps, sizeof(server->pps));
+}
+
+static void LoopbackBase64(const uint8_t *input, size_t length, char *output) {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t o = 0;
+    for (size_t i = 0; i < length; i += 3) {
+        uint32_t chunk = (uint32_t)input[i] << 16;
+        if (i + 1 < length) chunk |= (uint32_t)input[i + 1] << 8;
+        if (i + 2 < length) chunk |= input[i + 2];
+        output[o++] = alphabet[(chunk >> 18) & 0x3F];
+        output[o++] = alphabet[(chunk >> 12) & 0x3F];
+        output[o++] = i + 1 < length ? alphabet[(chunk >> 6) & 0x3F] : '=';
+        output[o++] = i + 2 < length ? alphabet[chunk & 0x3F] : '=';
+    }
+    output[o] = '\0';
+}
+
+#pragma mark - Connection I/O
+
+static bool LoopbackWrite(LoopbackConnection *c, const void *data, size_t length) {
+    const uint8_t *p = data;
+    while (length > 0) {
+        ssize_t n;
+        if (c->ssl) {
+            size_t written = 0;
+            n = SSL_write_ex(c->ssl, p, length, &written) == 1 ? (ssize_t)written : -1;
+        } else {
+            n = send(c->fd, p, length, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+        }
+        if (n <= 0) {
+            return false;
+        }
+        atomic_fetch_add(&c->server->bytesSent, (uint64_t)n);
+        p += n;
+        length -= (size_t)n;
+    }
+    return true;
+}
+
+static bool LoopbackReadSome(LoopbackConnection *c) {
+    if (!RTSPByteBufferReserve(&c->input, 4096)) {
+        return false;
+    }
+    ssize_t n;
+    if (c->ssl) {
+        size_t count = 0;
+        n = SSL_read_ex(c->ssl, c->input.data + c->input.length, 4096, &count) == 1 ? (ssize_t)count : -1;
+    } else {
+        n = recv(c->fd, c->input.data + c->input.length, 4096, 0);
+    }
+    if (n <= 0) {
+        return false;
+    }
+    c->input.length += (size_t)n;
+    return true;
+}
+
+#pragma mark - RTSP
+
+static bool LoopbackAuthorized(LoopbackConnection *c, const RTSPMessage *m) {
+    const RTSPLoopbackConfig *config = &c->server->config;
+    if (!config->user || strcmp(m->method, "OPTIONS") == 0) {
+        return true;
+    }
+    char header[1024];
+    if (!RTSPMessageHeader(m, "Authorization", header, sizeof(header))) {
+        return false;
+    }
+    RTSPAuthChallenge challenge = {.digest = true, .valid = true};
+    snprintf(challenge.realm, sizeof(challenge.realm), "%s", LOOPBACK_REALM);
+    snprintf(challenge.nonce, sizeof(challenge.nonce), "%s", c->nonce);
+
+    // Recompute the response for the URI the client signed
+    char uri[1024] = "";
+    const char *uriStart = strstr(header, "uri=\"");
+    if (uriStart) {
+        uriStart += 5;
+        const char *uriEnd = strchr(uriStart, '"');
+        if (uriEnd && (size_t)(uriEnd - uriStart) < sizeof(uri)) {
+            memcpy(uri, uriStart, (size_t)(uriEnd - uriStart));
+            uri[uriEnd - uriStart] = '\0';
+        }
+    }
+    char expected[1536];
+    if (!RTSPAuthBuildHeader(&challenge, config->user, config->password, m->method, uri, expected, sizeof(expected))) {
+        return false;
+    }
+    const char *expectedResponse = strstr(expected, "response=\"");
+    const char *response = strstr(header, "response=\"");
+    return expectedResponse && response && strncmp(expectedResponse, response, 10 + 32) == 0;
+}
+
+static bool LoopbackRespond(LoopbackConnection *c, int status, const char *reason,
+                            const char *headers, const char *body) {
+    RTSPByteBuffer *b = &c->output;
+    RTSPByteBufferReset(b);
+    RTSPByteBufferAppendFormat(b, "RTSP/1.0 %d %s\r\nCSeq: %d\r\nServer: RTSP Rotator Loopback\r\n",
+                               status, reason, c->message.cseq);
+    if (headers) {
+        RTSPByteBufferAppendString(b, headers);
+    }
+    if (body) {
+        RTSPByteBufferAppendFormat(b, "Content-Length: %zu\r\n\r\n%s", strlen(body), body);
+    } else {
+        RTSPByteBufferAppendString(b, "\r\n");
+    }
+    return LoopbackWrite(c, b->data, b->length);
+}
+
+static bool LoopbackHandleRequest(LoopbackConnection *c) {
+    RTSPMessage *m = &c->message;
+    RTSPLoopbackServerRef server = c->server;
+    char headers[2048];
+
+    if (server->config.responseDelayMs) {
+        usleep(server->config.responseDelayMs * 1000);
+    }
+    if (!LoopbackAuthorized(c, m)) {
+        snprintf(headers, sizeof(headers), "WWW-Authenticate: Digest realm=\"%s\", nonce=\"%s\"\r\n",
+                 LOOPBACK_REALM, c->nonce);
+        return LoopbackRespond(c, 401, "Unauthorized", headers, NULL);
+    }
+
+    if (strcmp(m->method, "OPTIONS") == 0) {
+        return LoopbackRespond(c, 200, "OK", "Public: OPTIONS, DESCRIBE, SETUP, PLAY, TEARDOWN, GET_PARAMETER\r\n", NULL);
+    }
+    if (strcmp(m->method, "DESCRIBE") == 0) {
+        char sps[128], pps[64], sdp[1024];
+        LoopbackBase64(server->sps, server->spsLength, sps);
+        LoopbackBase64(server->pps, server->ppsLength, pps);
+        snprintf(sdp, sizeof(sdp),
+                 "v=0\r\no=- 0 0 IN IP4 127.0.0.1\r\ns=Loopback\r\nt=0 0\r\n"
+                 "m=video 0 RTP/AVP 96\r\na=rtpmap:96 H264/90000\r\n"
+                 "a=fmtp:96 packetization-mode=1;profile-level-id=640029;sprop-parameter-sets=%s,%s\r\n"
+                 "a=control:trackID=1\r\n", sps, pps);
+        snprintf(headers, sizeof(headers), "Content-Type: application/sdp\r\nContent-Base: %s/\r\n", m->uri);
+        return LoopbackRespond(c, 200, "OK", headers, sdp);
+    }
+    if (strcmp(m->method, "SETUP") == 0) {
+        snprintf(headers, sizeof(headers),
+                 "Transport: RTP/AVP/TCP;unicast;interleaved=0-1;ssrc=%08X\r\nSession: %s;timeout=60\r\n",
+                 c->ssrc, c->session);
+        return LoopbackRespond(c, 200, "OK", headers, NULL);
+    }
+    if (strcmp(m->method, "PLAY") == 0) {
+        snprintf(headers, sizeof(headers), "Session: %s\r\nRange: npt=0.000-\r\n", c->session);
+        c->playing = !server->config.withholdMedia;
+        return LoopbackRespond(c, 200, "OK", headers, NULL);
+    }
+    if (strcmp(m->method, "TEARDOWN") == 0) {
+        c->closing = true;
+        return LoopbackRespond(c, 200, "OK", NULL, NULL);
+    }
+    return LoopbackRespond(c, 200, "OK", NULL, NULL);
+}
+
+static bool LoopbackDrainRequests(LoopbackConnection *c) {
+    size_t offset = 0;
+    for (;;) {
+        size_t consumed = 0;
+        RTSPParseResult result = RTSPMessageParse(c->input.data + offset, c->input.length - offset,
+                                                  &c->message, &consumed);
+        if (result == RTSPParseNeedMore) {
+            break;
+        }
+        if (result == RTSPParseError) {
+            return false;
+        }
+        if (result == RTSPParseMessage && c->message.isRequest && !LoopbackHandleRequest(c)) {
+            return false;
+        }
+        offset += consumed;
+    }
+    RTSPByteBufferConsume(&c->input, offset);
+    return true;
+}
+
+#pragma mark - Media
+
+static void LoopbackAppendRTP(LoopbackConnection *c, RTSPByteBuffer *b, const uint8_t *payloadHeader,
+                              size_t headerLength, const uint8_t *payload, size_t length, bool marker) {
+    size_t packetLength = 12 + headerLength + length;
+    RTSPByteBufferAppendU8(b, '$');
+    RTSPByteBufferAppendU8(b, 0);
+    RTSPByteBufferAppendU16(b, (uint16_t)packetLength);
+    RTSPByteBufferAppendU8(b, 0x80);
+    RTSPByteBufferAppendU8(b, (uint8_t)((marker ? 0x80 : 0) | 96));
+    RTSPByteBufferAppendU16(b, c->sequence++);
+    RTSPByteBufferAppendU32(b, c->timestamp);
+    RTSPByteBufferAppendU32(b, c->ssrc);
+    RTSPByteBufferAppend(b, payloadHeader, headerLength);
+    RTSPByteBufferAppend(b, payload, length);
+}
+
+static void LoopbackAppendNAL(LoopbackConnection *c, RTSPByteBuffer *b, uint8_t header,
+                              const uint8_t *body, size_t length, bool last) {
+    if (length + 1 <= LOOPBACK_MTU_PAYLOAD) {
+        LoopbackAppendRTP(c, b, &header, 1, body, length, last);
+        return;
+    }
+    const uint8_t *p = body;
+    size_t remaining = length;
+    bool start = true;
+    while (remaining > 0) {
+        size_t chunk = remaining > LOOPBACK_MTU_PAYLOAD ? LOOPBACK_MTU_PAYLOAD : remaining;
+        bool end = chunk == remaining;
+        uint8_t fu[2] = {
+            (uint8_t)((header & 0xE0) | 28),
+            (uint8_t)((start ? 0x80 : 0) | (end ? 0x40 : 0) | (header & 0x1F)),
+        };
+        LoopbackAppendRTP(c, b, fu, 2, p, chunk, last && end);
+        p += chunk;
+        remaining -= chunk;
+        start = false;
+    }
+}
+
+static void LoopbackBuildFrame(LoopbackConnection *c, RTSPByteBuffer *b) {
+    const RTSPLoopbackConfig *config = &c->server->config;
+    unsigned fps = config->fps ? config->fps : 30;
+    size_t average = (size_t)config->bitrateKbps * 1000 / 8 / fps;
+    size_t gop = config->gop ? config->gop : 30;
+    bool keyframe = c->frame % gop == 0;
+    size_t keySize = average * 3;
+    size_t size = keyframe ? keySize : (gop > 1 ? (average * gop - keySize) / (gop - 1) : average);
+    if (size < 64) {
+        size = 64;
+    }
+
+    if (keyframe) {
+        // In-band parameter sets as a STAP-A, as most cameras do
+        uint8_t stap[128];
+        size_t n = 0;
+        stap[n++] = 24;
+        stap[n++] = (uint8_t)(c->server->spsLength >> 8);
+        stap[n++] = (uint8_t)c->server->spsLength;
+        memcpy(stap + n, c->server->sps, c->server->spsLength);
+        n += c->server->spsLength;
+        stap[n++] = (uint8_t)(c->server->ppsLength >> 8);
+        stap[n++] = (uint8_t)c->server->ppsLength;
+        memcpy(stap + n, c->server->pps, c->server->ppsLength);
+        n += c->server->ppsLength;
+        LoopbackAppendRTP(c, b, NULL, 0, stap, n, false);
+    }
+
+    if (c->randomOffset + size + 1 > LOOPBACK_RANDOM_POOL) {
+        c->randomOffset = 0;
+    }
+    LoopbackAppendNAL(c, b, keyframe ? 0x65 : 0x41, c->server->random + c->randomOffset, size, true);
+    c->randomOffset += size;
+
+    c->frame++;
+    c->timestamp += 90000 / fps;
+}
+
+static void *LoopbackConnectionThread(void *argument) {
+    LoopbackConnection *c = argument;
+    RTSPLoopbackServerRef server = c->server;
+    const RTSPLoopbackConfig *config = &server->config;
+
+    if (c->ssl && SSL_accept(c->ssl) != 1) {
+        goto done;
+    }
+
+    RTSPByteBuffer frame;
+    RTSPByteBufferInit(&frame);
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    long interval = config->fps ? 1000000000L / (long)config->fps : 0;
+
+    while (!atomic_load(&server->stopping) && !c->closing) {
+        int timeout = 100;
+        if (c->playing) {
+            if (interval == 0) {
+                timeout = 0;
+            } else {
+                struct timespec now;
+                clock_gettime(CLOCK_MONOTONIC, &now);
+                long remaining = (next.tv_sec - now.tv_sec) * 1000 + (next.tv_nsec - now.tv_nsec) / 1000000;
+                timeout = remaining > 0 ? (int)remaining : 0;
+            }
+        }
+
+        struct pollfd pfd = {.fd = c->fd, .events = POLLIN};
+        bool readable = (c->ssl && SSL_pending(c->ssl) > 0) || poll(&pfd, 1, timeout) > 0;
+        if (readable) {
+            if (!LoopbackReadSome(c) || !LoopbackDrainRequests(c)) {
+                break;
+            }
+            continue;
+        }
+
+        if (c->playing) {
+            RTSPByteBufferReset(&frame);
+            LoopbackBuildFrame(c, &frame);
+            if (!LoopbackWrite(c, frame.data, frame.length)) {
+                break;
+            }
+            next.tv_nsec += interval;
+            while (next.tv_nsec >= 1000000000L) {
+                next.tv_nsec -= 1000000000L;
+                next.tv_sec++;
+            }
+        }
+    }
+    RTSPByteBufferFree(&frame);
+
+done:
+    if (c->ssl) {
+        SSL_free(c->ssl);
+    }
+    close(c->fd);
+    RTSPByteBufferFree(&c->input);
+    RTSPByteBufferFree(&c->output);
+    free(c);
+    atomic_fetch_sub(&server->connections, 1);
+    return NULL;
+}
+
+#pragma mark - Server
+
+static SSL_CTX *LoopbackCreateTLSContext(void) {
+    EVP_PKEY *key = EVP_EC_gen("P-256");
+    X509 *certificate = X509_new();
+    SSL_CTX *context = SSL_CTX_new(TLS_server_method());
+    if (!key || !certificate || !context) {
+        goto fail;
+    }
+    ASN1_INTEGER_set(X509_get_serialNumber(certificate), 1);
+    X509_gmtime_adj(X509_getm_notBefore(certificate), 0);
+    X509_gmtime_adj(X509_getm_notAfter(certificate), 86400);
+    X509_set_pubkey(certificate, key);
+    X509_NAME *name = X509_get_subject_name(certificate);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char *)"localhost", -1, -1, 0);
+    X509_set_issuer_name(certificate, name);
+    if (!X509_sign(certificate, key, EVP_sha256()) ||
+        SSL_CTX_use_certificate(context, certificate) != 1 ||
+        SSL_CTX_use_PrivateKey(context, key) != 1) {
+        goto fail;
+    }
+    X509_free(certificate);
+    EVP_PKEY_free(key);
+    return context;
+
+fail:
+    SSL_CTX_free(context);
+    X509_free(certificate);
+    EVP_PKEY_free(key);
+    return NULL;
+}
+
+static void *LoopbackAcceptThread(void *argument) {
+    RTSPLoopbackServerRef server = argument;
+    uint32_t seed = 0x9E3779B9u;
+
+    while (!atomic_load(&server->stopping)) {
+        struct pollfd pfd = {.fd = server->listenFD, .events = POLLIN};
+        if (poll(&pfd, 1, 100) <= 0) {
+            continue;
+        }
+        int fd = accept(server->listenFD, NULL, NULL);
+        if (fd < 0) {
+            continue;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        LoopbackConnection *c = calloc(1, sizeof(*c));
+        if (!c) {
+            close(fd);
+            continue;
+        }
+        c->server = server;
+        c->fd = fd;
+        seed = seed * 1664525u + 1013904223u;
+        c->ssrc = seed;
+        c->sequence = (uint16_t)(seed >> 7);
+        c->timestamp = seed * 2654435761u;
+        c->randomOffset = (seed >> 3) % (LOOPBACK_RANDOM_POOL / 2);
+        snprintf(c->nonce, sizeof(c->nonce), "%08x%08x%08x%08x", seed, ~seed, seed ^ 0x5A5A5A5Au, seed * 3u);
+        snprintf(c->session, sizeof(c->session), "%08X%08X", seed, seed ^ 0xA5A5A5A5u);
+        RTSPByteBufferInit(&c->input);
+        RTSPByteBufferInit(&c->output);
+        if (server->tls) {
+            c->ssl = SSL_new(server->tls);
+            SSL_set_fd(c->ssl, fd);
+        }
+
+        atomic_fetch_add(&server->connections, 1);
+        pthread_t thread;
+        pthread_attr_t attributes;
+        pthread_attr_init(&attributes);
+        pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+        pthread_attr_setstacksize(&attributes, 256 * 1024);
+        if (pthread_create(&thread, &attributes, LoopbackConnectionThread, c) != 0) {
+            atomic_fetch_sub(&server->connections, 1);
+            if (c->ssl) {
+                SSL_free(c->ssl);
+            }
+            close(fd);
+            free(c);
+        }
+        pthread_attr_destroy(&attributes);
+    }
+    return NULL;
+}
+
+RTSPLoopbackServerRef RTSPLoopbackServerStart(const RTSPLoopbackConfig *config) {
+    RTSPLoopbackServerRef server = calloc(1, sizeof(*server));
+    if (!server) {
+        return NULL;
+    }
+    server->config = *config;
+    LoopbackBuildParameterSets(server);
+
+    server->random = malloc(LOOPBACK_RANDOM_POOL);
+    if (!server->random) {
+        free(server);
+        return NULL;
+    }
+    uint64_t state = 0x243F6A8885A308D3ull;
+    for (size_t i = 0; i < LOOPBACK_RANDOM_POOL; i++) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        server->random[i] = (uint8_t)(state >> 24) | 0x01; // Never zero: no start code emulation
+    }
+
+    if (config->tls && !(server->tls = LoopbackCreateTLSContext())) {
+        free(server->random);
+        free(server);
+        return NULL;
+    }
+
+    server->listenFD = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(server->listenFD, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in address = {.sin_family = AF_INET, .sin_port = htons(config->port)};
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    if (bind(server->listenFD, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+        listen(server->listenFD, 512) != 0 ||
+        getsockname(server->listenFD, (struct sockaddr *)&address, &length) != 0) {
+        close(server->listenFD);
+        SSL_CTX_free(server->tls);
+        free(server->random);
+        free(server);
+        return NULL;
+    }
+    server->port = ntohs(address.sin_port);
+
+    if (pthread_create(&server->acceptThread, NULL, LoopbackAcceptThread, server) != 0) {
+        close(server->listenFD);
+        SSL_CTX_free(server->tls);
+        free(server->random);
+        free(server);
+        return NULL;
+    }
+    return server;
+}
+
+uint16_t RTSPLoopbackServerPort(RTSPLoopbackServerRef server) {
+    return server ? server->port : 0;
+}
+
+uint64_t RTSPLoopbackServerBytesSent(RTSPLoopbackServerRef server) {
+    return server ? atomic_load(&server->bytesSent) : 0;
+}
+
+void RTSPLoopbackServerStop(RTSPLoopbackServerRef server) {
+    if (!server) {
+        return;
+    }
+    atomic_store(&server->stopping, true);
+    pthread_join(server->acceptThread, NULL);
+    close(server->listenFD);
+    while (atomic_load(&server->connections) > 0) {
+        usleep(1000);
+    }
+    SSL_CTX_free(server->tls);
+    free(server->random);
+    free(server);
+}
@@ -0,0 +1,42 @@
+//
+//  rtsp_loopback_server.h
+//  RTSP Rotator Benchmarks
+//
+//  Loopback RTSP / RTSPS camera simulator. Serves synthetic H.264 (valid
+//  SPS/PPS, random slice payloads) over RTP interleaved on the RTSP
+//  connection, the way UniFi Protect and most NVRs deliver RTSPS. Each
+//  connection gets its own thread; this is test scaffolding, not product code.
+//
+//  Requires OpenSSL for RTSPS (always linked by the harnesses that use it).
+//
+
+#ifndef rtsp_loopback_server_h
+#define rtsp_loopback_server_h
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+    uint16_t port;              // 0 picks an ephemeral port
+    bool tls;                   // Serve rtsps:// with a generated self-signed certificate
+    unsigned fps;               // Frame rate; 0 streams as fast as the client reads. Default 30
+    unsigned bitrateKbps;       // Average video bitrate. Default 4000
+    unsigned gop;               // Frames per IDR. Default 30
+    unsigned width;             // Default 1920
+    unsigned height;            // Default 1080
+    const char *user;           // Require Digest auth when set
+    const char *password;
+    unsigned responseDelayMs;   // Wait before every RTSP reply, like an overloaded camera. Default 0
+    bool withholdMedia;         // Answer PLAY but never send RTP, like a camera with a dead encoder
+} RTSPLoopbackConfig;
+
+typedef struct RTSPLoopbackServer *RTSPLoopbackServerRef;
+
+void RTSPLoopbackConfigInit(RTSPLoopbackConfig *config);
+
+RTSPLoopbackServerRef RTSPLoopbackServerStart(const RTSPLoopbackConfig *config);
+uint16_t RTSPLoopbackServerPort(RTSPLoopbackServerRef server);
+uint64_t RTSPLoopbackServerBytesSent(RTSPLoopbackServerRef server);
+void RTSPLoopbackServerStop(RTSPLoopbackServerRef server);
+
+#endif /* rtsp_loopback_server_h */
@@ -0,0 +1,970 @@
+//
+//  snapshot_bench.c
+//  RTSP Rotator Benchmarks
+//
+//  Benchmark for the snapshot pipeline: RTSPJPEGEncoder, which encodes NV12
+//  frames straight to JPEG, and RTSPSnapshotWriter, which encodes them on a
+//  worker pool and makes the files durable in groups. Three phases:
+//
+//    1. Checks on synthetic frames, decoded again by a minimal baseline
+//       decoder in this file (the sandbox has no libjpeg to lean on).
+//    2. Encode time of one 1080p frame per SIMD backend, and its size and
+//       PSNR per quality.
+//    3. "Snapshot all cameras": one 1080p frame from each of 16 cameras
+//       submitted at once, from submit to the last file durable on disk,
+//       against one frame interval at 30 fps; and the same files saved one
+//       at a time with an fsync each, which is what saving them in a loop
+//       would cost.
+//
+//  Checks: files are well-formed JFIF (SOI, APP0, quantization and Huffman
+//  tables, one baseline scan, EOI, nothing after) that decode to the source
+//  at a PSNR that rises with quality, with video range stretched to full
+//  range; every backend writes the same bytes as the scalar one; odd sizes
+//  and row padding; bad images are refused and leave the output as it was.
+//  The writer completes every accepted job exactly once and releases its
+//  buffers exactly once, leaves no temporary files, writes encoded bytes as
+//  they are, reports failures with errno, refuses jobs past maxQueued, and
+//  shares syncs within a burst.
+//
+//  Build (Linux):
+//    cc -O2 -std=gnu11 -I"../RTSP Rotator" snapshot_bench.c "../RTSP Rotator/RTSPSnapshotWriter.c" "../RTSP Rotator/RTSPJPEGEncoder.c" "../RTSP Rotator/RTSPByteBuffer.c" -lpthread -lm -o snapshot_bench
+//
+//  Usage: snapshot_bench [--cameras N] [--rounds N] [--quality Q]
+//
+
+#define _GNU_SOURCE
+
+#include "RTSPJPEGEncoder.h"
+#include "RTSPSnapshotWriter.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_TARGET_ALL_MS 33.3        // Every camera's snapshot durable within one 30 fps frame interval
+#define BENCH_TARGET_PSNR 34.0          // dB, luma and chroma at quality 80 on the synthetic frames
+#define BENCH_WIDTH 1920
+#define BENCH_HEIGHT 1080
+#define BENCH_ROW_PADDING 64            // CVPixelBuffer rows are padded too
+
+static double BenchNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static unsigned BenchCheck(bool condition, const char *what) {
+    if (!condition) {
+        fprintf(stderr, "  check failed: %s\n", what);
+    }
+    return condition ? 0 : 1;
+}
+
+static uint64_t gRandomState = 0x9E3779B97F4A7C15ull;
+
+static uint64_t BenchRandom(void) {
+    gRandomState ^= gRandomState << 13;
+    gRandomState ^= gRandomState >> 7;
+    gRandomState ^= gRandomState << 17;
+    return gRandomState;
+}
+
+static void BenchRemoveDirectory(const char *directory) {
+    DIR *dir = opendir(directory);
+    if (!dir) {
+        return;
+    }
+    struct dirent *entry;
+    char path[PATH_MAX];
+    while ((entry = readdir(dir))) {
+        if (entry->d_name[0] != '.') {
+            snprintf(path, sizeof(path), "%s/%s", directory, entry->d_name);
+            unlink(path);
+        }
+    }
+    closedir(dir);
+    rmdir(directory);
+}
+
+static unsigned BenchCountFiles(const char *directory, const char *suffix) {
+    DIR *dir = opendir(directory);
+    if (!dir) {
+        return 0;
+    }
+    unsigned count = 0;
+    size_t suffixLength = strlen(suffix);
+    struct dirent *entry;
+    while ((entry = readdir(dir))) {
+        size_t length = strlen(entry->d_name);
+        if (entry->d_name[0] != '.' && length >= suffixLength &&
+            strcmp(entry->d_name + length - suffixLength, suffix) == 0) {
+            count++;
+        }
+    }
+    closedir(dir);
+    return count;
+}
+
+static uint8_t *BenchReadFile(const char *path, size_t *length) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t *bytes = malloc(size > 0 ? (size_t)size : 1);
+    *length = bytes ? fread(bytes, 1, (size_t)size, file) : 0;
+    fclose(file);
+    return bytes;
+}
+
+#pragma mark - Synthetic Frames
+
+/// An NV12 frame the way the decoder hands it out: padded rows, chroma
+/// interleaved at half resolution
+typedef struct {
+    uint8_t *luma;
+    uint8_t *chroma;
+    RTSPJPEGImage image;
+} BenchFrame;
+
+/// A street-camera-ish scene: sky gradient, a few hard-edged blocks, some
+/// texture and a little sensor noise, different per seed
+static void BenchFrameInit(BenchFrame *frame, uint32_t width, uint32_t height, bool videoRange, uint32_t seed) {
+    size_t lumaRow = width + BENCH_ROW_PADDING;
+    uint32_t chromaWidth = (width + 1) / 2, chromaHeight = (height + 1) / 2;
+    size_t chromaRow = chromaWidth * 2 + BENCH_ROW_PADDING;
+    frame->luma = malloc(lumaRow * height);
+    frame->chroma = malloc(chromaRow * chromaHeight);
+    uint8_t low = videoRange ? 16 : 0, high = videoRange ? 235 : 255;
+    uint8_t chromaHigh = videoRange ? 240 : 255;
+
+    double phase = seed * 0.7;
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            double fx = (double)x / width, fy = (double)y / height;
+            double value = 60 + 120 * fy + 25 * sin(fx * 9 + phase) * cos(fy * 7);
+            // Blocks: buildings, cars
+            for (uint32_t b = 0; b < 4; b++) {
+                double bx = 0.1 + 0.2 * b + 0.05 * sin(phase + b), by = 0.45 + 0.1 * (b & 1);
+                if (fx > bx && fx < bx + 0.12 && fy > by && fy < by + 0.25) {
+                    value = 40 + 45 * b + 10 * ((x / 6 + y / 6) & 1);
+                }
+            }
+            value += (double)(BenchRandom() % 5) - 2;
+            value = low + value * (high - low) / 255.0;
+            frame->luma[y * lumaRow + x] = (uint8_t)(value < low ? low : value > high ? high : value);
+        }
+        memset(frame->luma + y * lumaRow + width, 0xEE, BENCH_ROW_PADDING);
+    }
+    for (uint32_t y = 0; y < chromaHeight; y++) {
+        for (uint32_t x = 0; x < chromaWidth; x++) {
+            double fx = (double)x / chromaWidth, fy = (double)y / chromaHeight;
+            double cb = 128 + 40 * (1 - fy) * cos(fx * 3 + phase);
+            double cr = 128 + 30 * sin(fy * 5 + fx * 2 + phase);
+            cb = low + cb * (chromaHigh - low) / 255.0;
+            cr = low + cr * (chromaHigh - low) / 255.0;
+            frame->chroma[y * chromaRow + 2 * x] = (uint8_t)cb;
+            frame->chroma[y * chromaRow + 2 * x + 1] = (uint8_t)cr;
+        }
+        memset(frame->chroma + y * chromaRow + chromaWidth * 2, 0x11, BENCH_ROW_PADDING);
+    }
+    frame->image = (RTSPJPEGImage){frame->luma, lumaRow, frame->chroma, chromaRow, width, height, videoRange};
+}
+
+static void BenchFrameFree(BenchFrame *frame) {
+    free(frame->luma);
+    free(frame->chroma);
+}
+
+#pragma mark - Reference Decoder
+
+// Baseline sequential Huffman, 4:2:0, three components: what the encoder
+// writes, decoded the slow, obvious way
+
+static const uint8_t BenchZigzag[64] = {
+    0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6,  7,  14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+typedef struct {
+    bool present;
+    int32_t maxCode[18];            // Largest code of each length, -1 for none
+    int32_t valueOffset[17];
+    uint8_t values[256];
+} BenchHuffman;
+
+typedef struct {
+    uint32_t width, height;
+    uint8_t *planes[3];             // Y, Cb, Cr, padded to whole MCUs
+    size_t strides[3];
+    const char *error;              // NULL if decoded
+    bool jfif;
+} BenchDecoded;
+
+typedef struct {
+    const uint8_t *data;
+    size_t length, position;
+    uint32_t bits;
+    int count;
+    bool hitMarker;
+} BenchBitReader;
+
+static int BenchReadBit(BenchBitReader *reader) {
+    if (reader->count == 0) {
+        if (reader->hitMarker || reader->position >= reader->length) {
+            reader->hitMarker = true;
+            return -1;
+        }
+        uint8_t byte = reader->data[reader->position++];
+        if (byte == 0xFF) {
+            if (reader->position >= reader->length || reader->data[reader->position] != 0x00) {
+                reader->hitMarker = true;   // A marker inside the coded data
+                return -1;
+            }
+            reader->position++;
+        }
+        reader->bits = byte;
+        reader->count = 8;
+    }
+    reader->count--;
+    return (reader->bits >> reader->count) & 1;
+}
+
+static int BenchReceive(BenchBitReader *reader, int size) {
+    int value = 0;
+    for (int i = 0; i < size; i++) {
+        int bit = BenchReadBit(reader);
+        if (bit < 0) {
+            return 0;
+        }
+        value = (value << 1) | bit;
+    }
+    // Extend: a leading zero means negative
+    return size && value < (1 << (size - 1)) ? value - (1 << size) + 1 : value;
+}
+
+static int BenchDecodeHuffman(BenchBitReader *reader, const BenchHuffman *table) {
+    int32_t code = 0;
+    for (int length = 1; length <= 16; length++) {
+        int bit = BenchReadBit(reader);
+        if (bit < 0) {
+            return -1;
+        }
+        code = (code << 1) | bit;
+        if (code <= table->maxCode[length]) {
+            return table->values[table->valueOffset[length] + code];
+        }
+    }
+    return -1;
+}
+
+static void BenchIDCT(const float coefficients[64], uint8_t *output, size_t stride) {
+    static float cosines[8][8];
+    static bool ready;
+    if (!ready) {
+        for (int x = 0; x < 8; x++) {
+            for (int u = 0; u < 8; u++) {
+                cosines[x][u] = (float)((u ? 1.0 : M_SQRT1_2) * cos((2 * x + 1) * u * M_PI / 16));
+            }
+        }
+        ready = true;
+    }
+    float rows[64];
+    for (int v = 0; v < 8; v++) {
+        for (int x = 0; x < 8; x++) {
+            float sum = 0;
+            for (int u = 0; u < 8; u++) {
+                sum += cosines[x][u] * coefficients[v * 8 + u];
+            }
+            rows[v * 8 + x] = sum / 2;
+        }
+    }
+    for (int y = 0; y < 8; y++) {
+        for (int x = 0; x < 8; x++) {
+            float sum = 0;
+            for (int v = 0; v < 8; v++) {
+                sum += cosines[y][v] * rows[v * 8 + x];
+            }
+            float value = sum / 2 + 128;
+            int rounded = (int)lrintf(value);
+            output[y * stride + x] = (uint8_t)(rounded < 0 ? 0 : rounded > 255 ? 255 : rounded);
+        }
+    }
+}
+
+static void BenchDecodedFree(BenchDecoded *decoded) {
+    for (int c = 0; c < 3; c++) {
+        free(decoded->planes[c]);
+    }
+}
+
+static BenchDecoded BenchDecode(const uint8_t *data, size_t length) {
+    BenchDecoded decoded = {0};
+    uint16_t quant[4][64] = {{0}};
+    BenchHuffman huffman[2][4] = {{{0}}};      // [DC/AC][id]
+    uint8_t componentQuant[3] = {0};
+    uint8_t componentTables[3] = {0};
+    bool frame = false;
+
+    if (length < 4 || data[0] != 0xFF || data[1] != 0xD8) {
+        decoded.error = "no SOI";
+        return decoded;
+    }
+    size_t position = 2;
+    for (;;) {
+        if (position + 4 > length || data[position] != 0xFF) {
+            decoded.error = "truncated or misplaced marker";
+            return decoded;
+        }
+        uint8_t marker = data[position + 1];
+        size_t segment = (size_t)data[position + 2] << 8 | data[position + 3];
+        const uint8_t *body = data + position + 4;
+        if (segment < 2 || position + 2 + segment > length) {
+            decoded.error = "segment overruns file";
+            return decoded;
+        }
+        size_t bodyLength = segment - 2;
+        position += 2 + segment;
+
+        if (marker == 0xE0) {
+            decoded.jfif = bodyLength >= 14 && memcmp(body, "JFIF\0", 5) == 0;
+        } else if (marker == 0xDB) {
+            for (size_t i = 0; i + 65 <= bodyLength; i += 65) {
+                if (body[i] >> 4) {
+                    decoded.error = "16-bit quantization table";
+                    return decoded;
+                }
+                for (int k = 0; k < 64; k++) {
+                    quant[body[i] & 3][k] = body[i + 1 + k];
+                }
+            }
+        } else if (marker == 0xC4) {
+            size_t i = 0;
+            while (i + 17 <= bodyLength) {
+                BenchHuffman *table = &huffman[body[i] >> 4 & 1][body[i] & 3];
+                const uint8_t *counts = body + i + 1;
+                size_t total = 0;
+                for (int l = 0; l < 16; l++) {
+                    total += counts[l];
+                }
+                if (total > 256 || i + 17 + total > bodyLength) {
+                    decoded.error = "bad Huffman table";
+                    return decoded;
+                }
+                memcpy(table->values, body + i + 17, total);
+                int32_t code = 0, k = 0;
+                for (int l = 1; l <= 16; l++) {
+                    table->valueOffset[l] = k - code;
+                    code += counts[l - 1];
+                    k += counts[l - 1];
+                    table->maxCode[l] = counts[l - 1] ? code - 1 : -1;
+                    code <<= 1;
+                }
+                table->present = true;
+                i += 17 + total;
+            }
+        } else if (marker == 0xC0) {
+            if (bodyLength != 15 || body[0] != 8 || body[5] != 3 ||
+                body[7] != 0x22 || body[10] != 0x11 || body[13] != 0x11) {
+                decoded.error = "not baseline 8-bit 4:2:0";
+                return decoded;
+            }
+            decoded.height = (uint32_t)body[1] << 8 | body[2];
+            decoded.width = (uint32_t)body[3] << 8 | body[4];
+            for (int c = 0; c < 3; c++) {
+                componentQuant[c] = body[8 + 3 * c] & 3;
+            }
+            frame = true;
+        } else if (marker == 0xDA) {
+            if (!frame || bodyLength != 10 || body[0] != 3) {
+                decoded.error = "bad scan header";
+                return decoded;
+            }
+            for (int c = 0; c < 3; c++) {
+                componentTables[c] = body[2 + 2 * c];
+            }
+            break;
+        } else if (marker >= 0xC1 && marker <= 0xCF) {
+            decoded.error = "not a baseline frame";
+            return decoded;
+        }
+    }
+    for (int c = 0; c < 3; c++) {
+        if (!huffman[0][componentTables[c] >> 4 & 3].present || !huffman[1][componentTables[c] & 3].present) {
+            decoded.error = "scan uses a missing Huffman table";
+            return decoded;
+        }
+    }
+
+    uint32_t mcuColumns = (decoded.width + 15) / 16, mcuRows = (decoded.height + 15) / 16;
+    decoded.strides[0] = mcuColumns * 16;
+    decoded.strides[1] = decoded.strides[2] = mcuColumns * 8;
+    decoded.planes[0] = malloc(decoded.strides[0] * mcuRows * 16);
+    decoded.planes[1] = malloc(decoded.strides[1] * mcuRows * 8);
+    decoded.planes[2] = malloc(decoded.strides[2] * mcuRows * 8);
+
+    BenchBitReader reader = {data, length, position, 0, 0, false};
+    int predictors[3] = {0};
+    float coefficients[64];
+    for (uint32_t my = 0; my < mcuRows; my++) {
+        for (uint32_t mx = 0; mx < mcuColumns; mx++) {
+            for (int block = 0; block < 6; block++) {
+                int c = block < 4 ? 0 : block - 3;
+                const BenchHuffman *dc = &huffman[0][componentTables[c] >> 4 & 3];
+                const BenchHuffman *ac = &huffman[1][componentTables[c] & 3];
+                const uint16_t *q = quant[componentQuant[c]];
+                memset(coefficients, 0, sizeof(coefficients));
+
+                int size = BenchDecodeHuffman(&reader, dc);
+                if (size < 0 || size > 11) {
+                    decoded.error = "bad DC code";
+                    return decoded;
+                }
+                predictors[c] += BenchReceive(&reader, size);
+                coefficients[0] = (float)(predictors[c] * q[0]);
+                for (int k = 1; k < 64;) {
+                    int symbol = BenchDecodeHuffman(&reader, ac);
+                    if (symbol < 0) {
+                        decoded.error = "bad AC code";
+                        return decoded;
+                    }
+                    int run = symbol >> 4, bits = symbol & 15;
+                    if (bits == 0) {
+                        if (run != 15) {
+                            break;
+                        }
+                        k += 16;
+                        continue;
+                    }
+                    k += run;
+                    if (k > 63) {
+                        decoded.error = "AC run past the block";
+                        return decoded;
+                    }
+                    coefficients[BenchZigzag[k]] = (float)(BenchReceive(&reader, bits) * q[k]);
+                    k++;
+                }
+
+                uint8_t *output;
+                if (c == 0) {
+                    size_t x = mx * 16 + (block & 1) * 8, y = my * 16 + (block >> 1) * 8;
+                    output = decoded.planes[0] + y * decoded.strides[0] + x;
+                } else {
+                    output = decoded.planes[c] + my * 8 * decoded.strides[c] + mx * 8;
+                }
+                BenchIDCT(coefficients, output, decoded.strides[c]);
+            }
+        }
+    }
+    if (reader.hitMarker) {
+        decoded.error = "scan ended early";
+        return decoded;
+    }
+    // Whatever is left of the last byte is 1-padding, then EOI ends the file
+    if (reader.count && (reader.bits & ((1u << reader.count) - 1)) != (1u << reader.count) - 1) {
+        decoded.error = "scan padding is not ones";
+        return decoded;
+    }
+    if (reader.position + 2 != length || data[reader.position] != 0xFF || data[reader.position + 1] != 0xD9) {
+        decoded.error = "scan not followed by EOI at the end of the file";
+        return decoded;
+    }
+    return decoded;
+}
+
+/// PSNR of one decoded plane against the source samples, stretched to full
+/// range the way a decoder of a video-range frame expects
+static double BenchPSNR(const BenchDecoded *decoded, int c, const BenchFrame *frame) {
+    const RTSPJPEGImage *image = &frame->image;
+    uint32_t width = c ? (image->width + 1) / 2 : image->width;
+    uint32_t height = c ? (image->height + 1) / 2 : image->height;
+    double error = 0;
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            double source = c ? image->chroma[y * image->chromaBytesPerRow + 2 * x + (c - 1)]
+                              : image->luma[y * image->lumaBytesPerRow + x];
+            if (image->videoRange) {
+                source = c ? 128 + (source - 128) * 255.0 / 224.0 : (source - 16) * 255.0 / 219.0;
+                source = source < 0 ? 0 : source > 255 ? 255 : source;
+            }
+            double difference = decoded->planes[c][y * decoded->strides[c] + x] - source;
+            error += difference * difference;
+        }
+    }
+    error /= (double)width * height;
+    return error > 0 ? 10 * log10(255.0 * 255.0 / error) : 99.0;
+}
+
+#pragma mark - Encoder Checks
+
+static unsigned BenchCheckEncoder(void) {
+    unsigned failures = 0;
+    char what[160];
+    RTSPByteBuffer output;
+    RTSPByteBufferInit(&output);
+    RTSPJPEGEncoderRef encoder = RTSPJPEGEncoderCreate(NULL);
+
+    // Round trip, both ranges, quality ordering
+    for (int range = 0; range < 2; range++) {
+        BenchFrame frame;
+        BenchFrameInit(&frame, 640, 360, range == 0, 1);
+        double previousPSNR = 0;
+        size_t previousLength = 0;
+        static const uint32_t qualities[] = {30, 80, 95};
+        for (unsigned q = 0; q < 3; q++) {
+            RTSPJPEGEncoderSetQuality(encoder, qualities[q]);
+            RTSPByteBufferReset(&output);
+            bool encoded = RTSPJPEGEncoderEncode(encoder, &frame.image, &output);
+            BenchDecoded decoded = BenchDecode(output.data, output.length);
+            snprintf(what, sizeof(what), "%s range q%u decodes (%s)", range ? "full" : "video", qualities[q],
+                     decoded.error ? decoded.error : "ok");
+            failures += BenchCheck(encoded && !decoded.error && decoded.jfif, what);
+            if (!decoded.error) {
+                failures += BenchCheck(decoded.width == 640 && decoded.height == 360, "decoded dimensions");
+                double psnr = BenchPSNR(&decoded, 0, &frame);
+                double chroma = fmin(BenchPSNR(&decoded, 1, &frame), BenchPSNR(&decoded, 2, &frame));
+                snprintf(what, sizeof(what), "%s range q%u PSNR rises with quality (%.1f dB, %zu bytes)",
+                         range ? "full" : "video", qualities[q], psnr, output.length);
+                failures += BenchCheck(psnr > previousPSNR && output.length > previousLength, what);
+                if (qualities[q] == 80) {
+                    snprintf(what, sizeof(what), "%s range q80 PSNR Y %.1f / C %.1f dB (target >= %.0f)",
+                             range ? "full" : "video", psnr, chroma, BENCH_TARGET_PSNR);
+                    failures += BenchCheck(psnr >= BENCH_TARGET_PSNR && chroma >= BENCH_TARGET_PSNR, what);
+                }
+                previousPSNR = psnr;
+                previousLength = output.length;
+            }
+            BenchDecodedFree(&decoded);
+        }
+        BenchFrameFree(&frame);
+    }
+
+    // Odd sizes and edge padding
+    static const uint32_t sizes[][2] = {{1, 1}, {2, 2}, {17, 9}, {33, 31}, {641, 359}, {8, 200}};
+    RTSPJPEGEncoderSetQuality(encoder, 90);
+    for (unsigned s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        BenchFrame frame;
+        BenchFrameInit(&frame, sizes[s][0], sizes[s][1], true, 2 + s);
+        RTSPByteBufferReset(&output);
+        bool encoded = RTSPJPEGEncoderEncode(encoder, &frame.image, &output);
+        BenchDecoded decoded = BenchDecode(output.data, output.length);
+        double psnr = decoded.error ? 0 : BenchPSNR(&decoded, 0, &frame);
+        snprintf(what, sizeof(what), "%ux%u round trip (%s, %.1f dB)", sizes[s][0], sizes[s][1],
+                 decoded.error ? decoded.error : "ok", psnr);
+        failures += BenchCheck(encoded && !decoded.error && decoded.width == sizes[s][0] &&
+                               decoded.height == sizes[s][1] && psnr >= 30.0, what);
+        BenchDecodedFree(&decoded);
+        BenchFrameFree(&frame);
+    }
+
+    // Refusals leave the output alone
+    BenchFrame frame;
+    BenchFrameInit(&frame, 64, 48, true, 9);
+    RTSPByteBufferReset(&output);
+    RTSPByteBufferAppendString(&output, "prefix");
+    RTSPJPEGImage empty = frame.image;
+    empty.width = 0;
+    RTSPJPEGImage huge = frame.image;
+    huge.height = 70000;
+    failures += BenchCheck(!RTSPJPEGEncoderEncode(encoder, &empty, &output) &&
+                           !RTSPJPEGEncoderEncode(encoder, &huge, &output) && output.length == 6,
+                           "empty and oversized images refused, output untouched");
+    failures += BenchCheck(RTSPJPEGEncoderEncode(encoder, &frame.image, &output) &&
+                           memcmp(output.data, "prefix\xFF\xD8", 8) == 0, "encode appends");
+    BenchFrameFree(&frame);
+
+    // Every backend writes the scalar backend's bytes
+    BenchFrameInit(&frame, 1280, 720, true, 3);
+    RTSPByteBuffer reference;
+    RTSPByteBufferInit(&reference);
+    RTSPJPEGEncoderConfig config;
+    RTSPJPEGEncoderConfigInit(&config);
+    config.backend = RTSPJPEGEncoderBackendScalar;
+    RTSPJPEGEncoderRef scalar = RTSPJPEGEncoderCreate(&config);
+    RTSPJPEGEncoderEncode(scalar, &frame.image, &reference);
+    RTSPJPEGEncoderRelease(scalar);
+    for (int b = RTSPJPEGEncoderBackendSSE2; b <= RTSPJPEGEncoderBackendNEON; b++) {
+        if (!RTSPJPEGEncoderBackendAvailable((RTSPJPEGEncoderBackend)b)) {
+            continue;
+        }
+        config.backend = (RTSPJPEGEncoderBackend)b;
+        RTSPJPEGEncoderRef other = RTSPJPEGEncoderCreate(&config);
+        RTSPByteBufferReset(&output);
+        RTSPJPEGEncoderEncode(other, &frame.image, &output);
+        snprintf(what, sizeof(what), "%s bytes match scalar", RTSPJPEGEncoderBackendName((RTSPJPEGEncoderBackend)b));
+        failures += BenchCheck(RTSPJPEGEncoderGetBackend(other) == (RTSPJPEGEncoderBackend)b && output.length == reference.length &&
+                               memcmp(output.data, reference.data, output.length) == 0, what);
+        RTSPJPEGEncoderRelease(other);
+    }
+    RTSPByteBufferFree(&reference);
+    BenchFrameFree(&frame);
+
+    RTSPJPEGEncoderRelease(encoder);
+    RTSPByteBufferFree(&output);
+    printf("  encoder checks: %s\n", failures ? "FAILED" : "ok");
+    return failures;
+}
+
+#pragma mark - Writer Checks
+
+typedef struct {
+    atomic_uint releases;
+    atomic_uint completions;
+    atomic_uint failures;
+    atomic_int lastError;
+    atomic_bool blocking;           // Release waits while set
+    atomic_bool inRelease;
+} BenchJobCounter;
+
+static void BenchJobRelease(void *context) {
+    BenchJobCounter *counter = context;
+    atomic_store(&counter->inRelease, true);
+    while (atomic_load(&counter->blocking)) {
+        usleep(1000);
+    }
+    atomic_fetch_add(&counter->releases, 1);
+}
+
+static void BenchJobCompletion(void *context, const char *path, int error) {
+    (void)path;
+    BenchJobCounter *counter = context;
+    atomic_fetch_add(&counter->completions, 1);
+    if (error) {
+        atomic_fetch_add(&counter->failures, 1);
+        atomic_store(&counter->lastError, error);
+    }
+}
+
+static unsigned BenchCheckWriter(const char *root) {
+    unsigned failures = 0;
+    char what[160];
+    char directory[PATH_MAX], path[PATH_MAX];
+    snprintf(directory, sizeof(directory), "%s/checks", root);
+    mkdir(directory, 0755);
+
+    RTSPSnapshotWriterConfig config;
+    RTSPSnapshotWriterConfigInit(&config);
+    config.workers = 3;
+    config.syncDelay = 1.0;         // Groups close when the workers run out of work, not on a slow machine's clock
+    RTSPSnapshotWriterRef writer = RTSPSnapshotWriterCreate(&config);
+    BenchFrame frame;
+    BenchFrameInit(&frame, 320, 240, true, 4);
+
+    // A burst of encodes, a file of raw bytes, and one that cannot be written
+    BenchJobCounter counter = {0};
+    unsigned jobs = 12;
+    for (unsigned i = 0; i < jobs; i++) {
+        snprintf(path, sizeof(path), "%s/camera-%02u.jpg", directory, i);
+        RTSPSnapshotJob job = {.image = frame.image, .quality = i % 2 ? 60 : 0, .path = path,
+                               .release = BenchJobRelease, .completion = BenchJobCompletion, .context = &counter};
+        failures += BenchCheck(RTSPSnapshotWriterSubmit(writer, &job), "job accepted");
+    }
+    static const uint8_t raw[] = "not really a HEIF file";
+    snprintf(path, sizeof(path), "%s/raw.heic", directory);
+    RTSPSnapshotJob rawJob = {.encoded = raw, .encodedLength = sizeof(raw), .path = path,
+                              .release = BenchJobRelease, .completion = BenchJobCompletion, .context = &counter};
+    failures += BenchCheck(RTSPSnapshotWriterSubmit(writer, &rawJob), "encoded job accepted");
+    BenchJobCounter missing = {0};
+    snprintf(path, sizeof(path), "%s/no-such-directory/x.jpg", directory);
+    RTSPSnapshotJob missingJob = {.image = frame.image, .path = path, .release = BenchJobRelease,
+                                  .completion = BenchJobCompletion, .context = &missing};
+    failures += BenchCheck(RTSPSnapshotWriterSubmit(writer, &missingJob), "unwritable job accepted");
+    RTSPSnapshotJob invalid = {.path = path};
+    failures += BenchCheck(!RTSPSnapshotWriterSubmit(writer, &invalid), "job without pixels refused");
+    RTSPSnapshotWriterWait(writer);
+
+    snprintf(what, sizeof(what), "%u completions, %u releases for %u jobs", atomic_load(&counter.completions),
+             atomic_load(&counter.releases), jobs + 1);
+    failures += BenchCheck(atomic_load(&counter.completions) == jobs + 1 && atomic_load(&counter.releases) == jobs + 1 &&
+                           atomic_load(&counter.failures) == 0, what);
+    snprintf(what, sizeof(what), "missing directory fails with ENOENT (got %d)", atomic_load(&missing.lastError));
+    failures += BenchCheck(atomic_load(&missing.completions) == 1 && atomic_load(&missing.releases) == 1 &&
+                           atomic_load(&missing.lastError) == ENOENT, what);
+    failures += BenchCheck(BenchCountFiles(directory, ".jpg") == jobs && BenchCountFiles(directory, ".tmp") == 0,
+                           "files in place, no temporaries left");
+
+    size_t length = 0;
+    uint8_t *bytes = BenchReadFile(path, &length);
+    failures += BenchCheck(!bytes, "failed job leaves no file");
+    free(bytes);
+    snprintf(path, sizeof(path), "%s/raw.heic", directory);
+    bytes = BenchReadFile(path, &length);
+    failures += BenchCheck(bytes && length == sizeof(raw) && memcmp(bytes, raw, length) == 0, "encoded bytes written as they are");
+    free(bytes);
+    size_t sizes[2] = {0};
+    for (unsigned i = 0; i < 2; i++) {
+        snprintf(path, sizeof(path), "%s/camera-%02u.jpg", directory, i);
+        bytes = BenchReadFile(path, &length);
+        BenchDecoded decoded = bytes ? BenchDecode(bytes, length) : (BenchDecoded){.error = "missing"};
+        snprintf(what, sizeof(what), "written file decodes (%s)", decoded.error ? decoded.error : "ok");
+        failures += BenchCheck(!decoded.error && decoded.width == 320, what);
+        sizes[i] = length;
+        BenchDecodedFree(&decoded);
+        free(bytes);
+    }
+    failures += BenchCheck(sizes[1] < sizes[0], "per-job quality overrides the writer's");
+
+    RTSPSnapshotWriterStatistics statistics = RTSPSnapshotWriterGetStatistics(writer);
+    snprintf(what, sizeof(what), "statistics: %llu submitted, %llu encoded, %llu written, %llu failed, %llu syncs (largest %u)",
+             (unsigned long long)statistics.submitted, (unsigned long long)statistics.encoded,
+             (unsigned long long)statistics.written, (unsigned long long)statistics.failed,
+             (unsigned long long)statistics.syncs, statistics.largestSync);
+    failures += BenchCheck(statistics.submitted == jobs + 2 && statistics.encoded == jobs + 1 &&
+                           statistics.written == jobs + 1 && statistics.failed == 1 &&
+                           statistics.syncs < jobs && statistics.largestSync > 1, what);
+    RTSPSnapshotWriterRelease(writer);
+
+    // maxQueued: one job held in its release callback, one waiting, the next refused
+    config.workers = 1;
+    config.maxQueued = 1;
+    writer = RTSPSnapshotWriterCreate(&config);
+    BenchJobCounter held = {0};
+    atomic_store(&held.blocking, true);
+    snprintf(path, sizeof(path), "%s/held.jpg", directory);
+    RTSPSnapshotJob heldJob = {.image = frame.image, .path = path, .release = BenchJobRelease,
+                               .completion = BenchJobCompletion, .context = &held};
+    bool first = RTSPSnapshotWriterSubmit(writer, &heldJob);
+    while (!atomic_load(&held.inRelease)) {
+        usleep(100);
+    }
+    bool second = RTSPSnapshotWriterSubmit(writer, &heldJob);
+    bool third = RTSPSnapshotWriterSubmit(writer, &heldJob);
+    failures += BenchCheck(first && second && !third, "jobs past maxQueued refused");
+    atomic_store(&held.blocking, false);
+    // Release finishes what was accepted
+    RTSPSnapshotWriterRelease(writer);
+    failures += BenchCheck(atomic_load(&held.completions) == 2 && atomic_load(&held.releases) == 2,
+                           "release completes accepted jobs");
+
+    BenchFrameFree(&frame);
+    BenchRemoveDirectory(directory);
+    printf("  writer checks: %s\n", failures ? "FAILED" : "ok");
+    return failures;
+}
+
+#pragma mark - Encode Speed
+
+static unsigned BenchEncodeSpeed(uint32_t quality) {
+    unsigned failures = 0;
+    BenchFrame frame;
+    BenchFrameInit(&frame, BENCH_WIDTH, BENCH_HEIGHT, true, 5);
+    RTSPByteBuffer output;
+    RTSPByteBufferInit(&output);
+
+    printf("\nEncode, one %ux%u NV12 frame, q%u\n", BENCH_WIDTH, BENCH_HEIGHT, quality);
+    printf("  %-8s %10s %10s %10s\n", "backend", "ms", "MP/s", "speedup");
+    double scalarMs = 0;
+    for (int b = RTSPJPEGEncoderBackendScalar; b <= RTSPJPEGEncoderBackendNEON; b++) {
+        if (!RTSPJPEGEncoderBackendAvailable((RTSPJPEGEncoderBackend)b)) {
+            continue;
+        }
+        RTSPJPEGEncoderConfig config = {quality, (RTSPJPEGEncoderBackend)b};
+        RTSPJPEGEncoderRef encoder = RTSPJPEGEncoderCreate(&config);
+        unsigned frames = 0;
+        double start = BenchNow(), elapsed;
+        do {
+            RTSPByteBufferReset(&output);
+            RTSPJPEGEncoderEncode(encoder, &frame.image, &output);
+            frames++;
+        } while ((elapsed = BenchNow() - start) < 0.5 || frames < 5);
+        double ms = elapsed * 1e3 / frames;
+        if (b == RTSPJPEGEncoderBackendScalar) {
+            scalarMs = ms;
+        }
+        printf("  %-8s %10.2f %10.1f %9.2fx\n", RTSPJPEGEncoderBackendName((RTSPJPEGEncoderBackend)b), ms,
+               BENCH_WIDTH * BENCH_HEIGHT / 1e3 / ms, scalarMs / ms);
+        RTSPJPEGEncoderRelease(encoder);
+    }
+
+    printf("\n  %-8s %10s %10s\n", "quality", "bytes", "PSNR Y");
+    RTSPJPEGEncoderRef encoder = RTSPJPEGEncoderCreate(NULL);
+    static const uint32_t qualities[] = {50, 70, 80, 90, 95};
+    for (unsigned q = 0; q < sizeof(qualities) / sizeof(qualities[0]); q++) {
+        RTSPJPEGEncoderSetQuality(encoder, qualities[q]);
+        RTSPByteBufferReset(&output);
+        RTSPJPEGEncoderEncode(encoder, &frame.image, &output);
+        BenchDecoded decoded = BenchDecode(output.data, output.length);
+        failures += BenchCheck(!decoded.error, "1080p frame decodes");
+        printf("  %-8u %10zu %10.1f\n", qualities[q], output.length, decoded.error ? 0 : BenchPSNR(&decoded, 0, &frame));
+        BenchDecodedFree(&decoded);
+    }
+    RTSPJPEGEncoderRelease(encoder);
+    RTSPByteBufferFree(&output);
+    BenchFrameFree(&frame);
+    return failures;
+}
+
+#pragma mark - Snapshot All Cameras
+
+static int BenchSyncDirectory(const char *directory) {
+    int fd = open(directory, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    int result = fsync(fd);
+    close(fd);
+    return result;
+}
+
+static unsigned BenchSnapshotAll(const char *root, unsigned cameras, unsigned rounds, uint32_t quality) {
+    unsigned failures = 0;
+    char what[200], directory[PATH_MAX], path[PATH_MAX], temporary[PATH_MAX];
+    snprintf(directory, sizeof(directory), "%s/all", root);
+    mkdir(directory, 0755);
+
+    BenchFrame *frames = calloc(cameras, sizeof(*frames));
+    for (unsigned c = 0; c < cameras; c++) {
+        BenchFrameInit(&frames[c], BENCH_WIDTH, BENCH_HEIGHT, true, 100 + c);
+    }
+    RTSPSnapshotWriterConfig config;
+    RTSPSnapshotWriterConfigInit(&config);
+    config.quality = quality;
+    RTSPSnapshotWriterRef writer = RTSPSnapshotWriterCreate(&config);
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    printf("\nSnapshot all %u cameras, %ux%u q%u, %u workers on %ld CPUs, %u rounds\n", cameras, BENCH_WIDTH,
+           BENCH_HEIGHT, quality, config.workers, cpus, rounds);
+    double *walls = calloc(rounds, sizeof(*walls));
+    BenchJobCounter counter = {0};
+    for (unsigned r = 0; r < rounds; r++) {
+        double start = BenchNow();
+        for (unsigned c = 0; c < cameras; c++) {
+            snprintf(path, sizeof(path), "%s/camera-%02u.jpg", directory, c);
+            RTSPSnapshotJob job = {.image = frames[c].image, .path = path, .release = BenchJobRelease,
+                                   .completion = BenchJobCompletion, .context = &counter};
+            failures += BenchCheck(RTSPSnapshotWriterSubmit(writer, &job), "snapshot accepted");
+        }
+        RTSPSnapshotWriterWait(writer);
+        walls[r] = (BenchNow() - start) * 1e3;
+    }
+    RTSPSnapshotWriterStatistics statistics = RTSPSnapshotWriterGetStatistics(writer);
+    RTSPSnapshotWriterRelease(writer);
+    failures += BenchCheck(atomic_load(&counter.completions) == cameras * rounds && atomic_load(&counter.failures) == 0,
+                           "every snapshot completed");
+
+    // Median round
+    for (unsigned i = 1; i < rounds; i++) {
+        for (unsigned j = i; j > 0 && walls[j - 1] > walls[j]; j--) {
+            double swap = walls[j];
+            walls[j] = walls[j - 1];
+            walls[j - 1] = swap;
+        }
+    }
+    double wall = walls[rounds / 2];
+    double encodeMs = statistics.encodeSeconds * 1e3 / (double)(statistics.encoded ? statistics.encoded : 1);
+    // What the wall time comes to with a worker per camera up to the pool size
+    unsigned parallel = config.workers < (unsigned)cpus ? config.workers : (unsigned)cpus;
+    printf("  pipeline     %8.2f ms median round (%.2f ms encode per frame, %.1f MB per round)\n", wall, encodeMs,
+           statistics.bytes / 1e6 / rounds);
+    printf("  syncs        %8.1f per round (largest group %u files)\n", (double)statistics.syncs / rounds,
+           statistics.largestSync);
+
+    // The same bytes saved one at a time: write, fsync, rename, fsync the directory
+    size_t lengths[64] = {0};
+    uint8_t *files[64] = {0};
+    unsigned kept = cameras < 64 ? cameras : 64;
+    for (unsigned c = 0; c < kept; c++) {
+        snprintf(path, sizeof(path), "%s/camera-%02u.jpg", directory, c);
+        files[c] = BenchReadFile(path, &lengths[c]);
+    }
+    double start = BenchNow();
+    for (unsigned r = 0; r < rounds; r++) {
+        for (unsigned c = 0; c < kept; c++) {
+            snprintf(path, sizeof(path), "%s/serial-%02u.jpg", directory, c);
+            snprintf(temporary, sizeof(temporary), "%s.tmp", path);
+            int fd = open(temporary, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            bool ok = fd >= 0 && write(fd, files[c], lengths[c]) == (ssize_t)lengths[c] && fsync(fd) == 0;
+            if (fd >= 0) {
+                close(fd);
+            }
+            ok = ok && rename(temporary, path) == 0 && BenchSyncDirectory(directory) == 0;
+            failures += BenchCheck(ok, "serial save");
+        }
+    }
+    double serialWrite = (BenchNow() - start) * 1e3 / rounds;
+    printf("  one at a time %7.2f ms per round to write and sync the same files, plus %.2f ms encoding serially\n",
+           serialWrite, encodeMs * cameras);
+    for (unsigned c = 0; c < kept; c++) {
+        free(files[c]);
+    }
+
+    // The target assumes enough cores for the encodes to fit in the interval;
+    // on a smaller machine say how many it would take instead
+    double needed = encodeMs * cameras / BENCH_TARGET_ALL_MS;
+    if (parallel >= needed) {
+        snprintf(what, sizeof(what), "all %u cameras in %.2f ms (target <= %.1f)", cameras, wall, BENCH_TARGET_ALL_MS);
+        failures += BenchCheck(wall <= BENCH_TARGET_ALL_MS, what);
+    } else {
+        printf("  target       %.1f ms needs %.1f cores at this encode speed; %u available, not checked\n",
+               BENCH_TARGET_ALL_MS, needed, parallel);
+    }
+    snprintf(what, sizeof(what), "grouped syncs (%.1f per round) fewer than files (%u)",
+             (double)statistics.syncs / rounds, cameras);
+    failures += BenchCheck(cameras < 2 || statistics.syncs < (uint64_t)cameras * rounds, what);
+
+    for (unsigned c = 0; c < cameras; c++) {
+        BenchFrameFree(&frames[c]);
+    }
+    free(frames);
+    free(walls);
+    BenchRemoveDirectory(directory);
+    return failures;
+}
+
+int main(int argc, char **argv) {
+    unsigned cameras = 16;
+    unsigned rounds = 15;
+    uint32_t quality = 80;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--cameras") == 0 && i + 1 < argc) {
+            cameras = (unsigned)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--rounds") == 0 && i + 1 < argc) {
+            rounds = (unsigned)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--quality") == 0 && i + 1 < argc) {
+            quality = (uint32_t)atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--cameras N] [--rounds N] [--quality Q]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (cameras == 0) {
+        cameras = 1;
+    }
+    if (rounds == 0) {
+        rounds = 1;
+    }
+
+    char root[] = "/tmp/snapshot_bench.XXXXXX";
+    if (!mkdtemp(root)) {
+        fprintf(stderr, "mkdtemp failed\n");
+        return 1;
+    }
+    printf("snapshot_bench: %u cameras, %u rounds, quality %u\n", cameras, rounds, quality);
+
+    unsigned failures = BenchCheckEncoder();
+    failures += BenchCheckWriter(root);
+    failures += BenchEncodeSpeed(quality);
+    failures += BenchSnapshotAll(root, cameras, rounds, quality);
+    rmdir(root);
+
+    if (failures) {
+        printf("FAILED (%u)\n", failures);
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
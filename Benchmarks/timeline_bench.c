@@ -0,0 +1,737 @@
+//
+//  timeline_bench.c
+//  RTSP Rotator Benchmarks
+//
+//  Benchmark for the DVR timeline: RTSPDVRStoreReadKeyframe, which reads
+//  one seek point's keyframe and decoder configuration out of a segment
+//  file, RTSPTimelineSprite, the thumbnail sheet keyed by seek point, and
+//  the media reference RTSPEventStore keeps with each event. Three phases:
+//
+//    1. Checks on a small ring fed synthetic parts behind a real H.264 init
+//       segment, on small sprite sheets, and on an event store.
+//    2. A timeline strip of 120 thumbnails over a recorded ring: cold, where
+//       each tile costs a seek and a keyframe read (the decode itself is
+//       VideoToolbox's and is not measured here; tiles get synthetic
+//       pixels), and warm, where each is a seek, a lookup and a tile copy.
+//       Both against reading every tile's segment whole, which is what
+//       handing the segment to a player would do.
+//    3. Jumping from stored events to their keyframe, and random scrubbing
+//       through the default-size sheet: hit rate and replacements.
+//
+//  Checks: keyframe reads return the codec, dimensions and avcC of the init
+//  segment and exactly the keyframe sample at the seek point, and fail once
+//  the segment is overwritten; sprite tiles round-trip through lookup, copy
+//  and the mapped sheet, survive reopening, are dropped on a geometry
+//  change or a different keyframe time, and are replaced by the clock
+//  algorithm sparing tiles looked up since the hand passed; events keep
+//  their media reference across reopening and it reads the same keyframe a
+//  seek to the event's time finds.
+//
+//  Build (Linux):
+//    cc -O2 -std=gnu11 -I"../RTSP Rotator" timeline_bench.c "../RTSP Rotator/RTSPTimelineSprite.c" "../RTSP Rotator/RTSPDVRStore.c" "../RTSP Rotator/RTSPEventStore.c" "../RTSP Rotator/RTSPEventTextIndex.c" "../RTSP Rotator/RTSPFMP4Writer.c" "../RTSP Rotator/RTSPCodecConfig.c" "../RTSP Rotator/RTSPByteBuffer.c" -lpthread -lm -o timeline_bench
+//
+//  Usage: timeline_bench [--minutes M] [--tiles N] [--scrubs N]
+//
+
+#define _GNU_SOURCE
+
+#include "RTSPDVRStore.h"
+#include "RTSPEventStore.h"
+#include "RTSPFMP4Writer.h"
+#include "RTSPTimelineSprite.h"
+
+#include <dirent.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_TARGET_WARM_TILE_US 10.0  // Mean per tile of a cached strip
+#define BENCH_TARGET_JUMP_US 200.0      // Mean event-to-keyframe read, page cache warm
+#define BENCH_FPS 30
+#define BENCH_GOP 30                    // Frames per keyframe
+#define BENCH_PART_FRAMES 6             // 0.2 s parts, as the engine cuts them
+#define BENCH_EPOCH 1760000000000000LL  // Wall clock the synthetic camera starts at (µs)
+
+static double BenchNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static unsigned BenchCheck(bool condition, const char *what) {
+    if (!condition) {
+        fprintf(stderr, "  check failed: %s\n", what);
+    }
+    return condition ? 0 : 1;
+}
+
+static uint64_t gRandomState = 0x9E3779B97F4A7C15ull;
+
+static uint64_t BenchRandom(void) {
+    gRandomState ^= gRandomState << 13;
+    gRandomState ^= gRandomState >> 7;
+    gRandomState ^= gRandomState << 17;
+    return gRandomState;
+}
+
+static void BenchRemoveDirectory(const char *directory) {
+    DIR *dir = opendir(directory);
+    if (!dir) {
+        return;
+    }
+    struct dirent *entry;
+    char path[PATH_MAX];
+    while ((entry = readdir(dir))) {
+        if (entry->d_name[0] != '.') {
+            snprintf(path, sizeof(path), "%s/%s", directory, entry->d_name);
+            unlink(path);
+        }
+    }
+    closedir(dir);
+    rmdir(directory);
+}
+
+#pragma mark - Synthetic Engine Output
+
+// 1280x720 High profile SPS and its PPS
+static const uint8_t BenchSPS[] = {
+    0x67, 0x64, 0x00, 0x1F, 0xAC, 0xD9, 0x40, 0x50, 0x05, 0xBB, 0x01, 0x10, 0x00,
+    0x00, 0x03, 0x00, 0x10, 0x00, 0x00, 0x03, 0x03, 0xC0, 0xF1, 0x83, 0x19, 0x60,
+};
+static const uint8_t BenchPPS[] = {0x68, 0xEB, 0xE3, 0xCB, 0x22, 0xC0};
+
+static RTSPCodecConfig BenchCodecConfig(void) {
+    RTSPCodecConfig config;
+    RTSPCodecConfigInit(&config, RTSPVideoCodecH264);
+    RTSPCodecConfigObserveNAL(&config, BenchSPS, sizeof(BenchSPS));
+    RTSPCodecConfigObserveNAL(&config, BenchPPS, sizeof(BenchPPS));
+    return config;
+}
+
+/// Parts the way RTSPRemuxEngine emits them: 0.2 s of 30 fps video, the
+/// first part of every GOP independent, on a wall clock from BENCH_EPOCH.
+/// Each keyframe sample is one length-prefixed IDR NAL unit carrying its
+/// frame number, so a read can be checked against the frame it should be.
+typedef struct {
+    uint32_t sequence;
+    uint64_t frame;
+    uint32_t keyframeBytes;
+    uint32_t frameBytes;
+    RTSPByteBuffer fragment;
+    uint8_t *payload;
+} BenchSynth;
+
+static void BenchSynthInit(BenchSynth *synth, RTSPDVRStoreRef store, uint32_t keyframeBytes, uint32_t frameBytes) {
+    memset(synth, 0, sizeof(*synth));
+    synth->keyframeBytes = keyframeBytes;
+    synth->frameBytes = frameBytes;
+    RTSPByteBufferInit(&synth->fragment);
+    synth->payload = calloc(1, keyframeBytes + (size_t)frameBytes * BENCH_PART_FRAMES);
+
+    RTSPCodecConfig config = BenchCodecConfig();
+    RTSPFMP4WriteInitSegment(&config, &synth->fragment);
+    RTSPDVRStoreAddInitSegment(store, 1, synth->fragment.data, synth->fragment.length);
+}
+
+static void BenchSynthFree(BenchSynth *synth) {
+    RTSPByteBufferFree(&synth->fragment);
+    free(synth->payload);
+}
+
+static int64_t BenchFrameTime(uint64_t frame) {
+    return BENCH_EPOCH + (int64_t)(frame * 1000000 / BENCH_FPS);
+}
+
+static uint64_t BenchFrameAtTime(int64_t time) {
+    return (uint64_t)((time - BENCH_EPOCH) * BENCH_FPS / 1000000);
+}
+
+/// The keyframe sample the synthetic camera writes for `frame`
+static void BenchKeyframeBytes(uint64_t frame, uint32_t length, uint8_t *bytes) {
+    memset(bytes, 0, length);
+    uint32_t nal = length - 4;
+    bytes[0] = (uint8_t)(nal >> 24);
+    bytes[1] = (uint8_t)(nal >> 16);
+    bytes[2] = (uint8_t)(nal >> 8);
+    bytes[3] = (uint8_t)nal;
+    bytes[4] = 0x65;
+    for (unsigned i = 0; i < 8; i++) {
+        bytes[5 + i] = (uint8_t)(frame >> (56 - 8 * i));
+    }
+}
+
+static void BenchSynthPart(BenchSynth *synth, RTSPDVRStoreRef store) {
+    RTSPFMP4Sample samples[BENCH_PART_FRAMES];
+    size_t payloadLength = 0;
+    bool independent = synth->frame % BENCH_GOP == 0;
+    if (independent) {
+        BenchKeyframeBytes(synth->frame, synth->keyframeBytes, synth->payload);
+    }
+    for (unsigned i = 0; i < BENCH_PART_FRAMES; i++) {
+        bool keyframe = (synth->frame + i) % BENCH_GOP == 0;
+        samples[i] = (RTSPFMP4Sample){keyframe ? synth->keyframeBytes : synth->frameBytes,
+                                      RTSP_FMP4_TIMESCALE / BENCH_FPS, keyframe};
+        payloadLength += samples[i].size;
+    }
+    RTSPByteBufferReset(&synth->fragment);
+    RTSPFMP4WriteFragment(++synth->sequence, synth->frame * (RTSP_FMP4_TIMESCALE / BENCH_FPS),
+                          samples, BENCH_PART_FRAMES, synth->payload, payloadLength, &synth->fragment);
+    RTSPRemuxMediaInfo info = {
+        .sequence = synth->sequence,
+        .initID = 1,
+        .duration = (double)BENCH_PART_FRAMES / BENCH_FPS,
+        .independent = independent,
+    };
+    RTSPDVRStoreAddMedia(store, &info, synth->fragment.data, synth->fragment.length, BenchFrameTime(synth->frame));
+    synth->frame += BENCH_PART_FRAMES;
+}
+
+static void BenchSynthFeed(BenchSynth *synth, RTSPDVRStoreRef store, double seconds) {
+    uint64_t parts = (uint64_t)llround(seconds * BENCH_FPS / BENCH_PART_FRAMES);
+    for (uint64_t p = 0; p < parts; p++) {
+        BenchSynthPart(synth, store);
+    }
+}
+
+/// Whether a keyframe read is the synthetic camera's keyframe at `point`
+static bool BenchKeyframeMatches(const RTSPDVRSeekPoint *point, const RTSPDVRKeyframeSample *keyframe,
+                                 const RTSPByteBuffer *buffer, uint32_t keyframeBytes, uint8_t *scratch) {
+    BenchKeyframeBytes(BenchFrameAtTime(point->time), keyframeBytes, scratch);
+    return keyframe->sampleLength == keyframeBytes &&
+           keyframe->sampleOffset + keyframe->sampleLength <= buffer->length &&
+           memcmp(buffer->data + keyframe->sampleOffset, scratch, keyframeBytes) == 0;
+}
+
+/// Synthetic thumbnail: every pixel names the keyframe's time
+static void BenchFillTile(uint8_t *pixels, uint32_t width, uint32_t height, size_t bytesPerRow, int64_t time) {
+    uint32_t value = (uint32_t)(time / 1000) * 2654435761u;
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            uint32_t pixel = value ^ (y << 16) ^ x;
+            memcpy(pixels + y * bytesPerRow + x * 4, &pixel, 4);
+        }
+    }
+}
+
+#pragma mark - Checks
+
+/// Keyframe reads on a small ring with a real init segment
+static unsigned BenchCheckKeyframes(const char *directory) {
+    unsigned failures = 0;
+    RTSPDVRStoreConfig config;
+    RTSPDVRStoreConfigInit(&config);
+    config.slotCount = 6;
+    config.slotBytes = 1 << 20;
+    config.segmentDuration = 2.0;
+    RTSPDVRStoreRef store = RTSPDVRStoreOpen(directory, &config);
+    failures += BenchCheck(store != NULL, "store opens");
+    if (!store) {
+        return failures;
+    }
+    BenchSynth synth;
+    BenchSynthInit(&synth, store, 6000, 800);
+    BenchSynthFeed(&synth, store, 3.0);
+    RTSPDVRSeekPoint early;
+    failures += BenchCheck(RTSPDVRStoreSeek(store, BENCH_EPOCH + 500000, &early) && early.sequence == 1,
+                           "seek into the first segment");
+    BenchSynthFeed(&synth, store, 17.0);
+
+    RTSPCodecConfig codecConfig = BenchCodecConfig();
+    RTSPByteBuffer record;
+    RTSPByteBufferInit(&record);
+    RTSPCodecConfigAppendDecoderRecord(&codecConfig, &record);
+
+    RTSPByteBuffer buffer;
+    RTSPByteBufferInit(&buffer);
+    uint8_t *scratch = malloc(synth.keyframeBytes);
+    RTSPDVRStoreStatistics statistics = RTSPDVRStoreGetStatistics(store);
+    bool reads = true;
+    for (unsigned i = 0; reads && i < 100; i++) {
+        int64_t time = statistics.oldestTime + (int64_t)(BenchRandom() % 12000000);
+        RTSPDVRSeekPoint point;
+        RTSPDVRKeyframeSample keyframe;
+        RTSPByteBufferReset(&buffer);
+        reads = RTSPDVRStoreSeek(store, time, &point) &&
+                RTSPDVRStoreReadKeyframe(store, &point, &keyframe, &buffer) &&
+                keyframe.codec == RTSPVideoCodecH264 && keyframe.width == 1280 && keyframe.height == 720 &&
+                keyframe.configLength == record.length &&
+                memcmp(buffer.data + keyframe.configOffset, record.data, record.length) == 0 &&
+                BenchKeyframeMatches(&point, &keyframe, &buffer, synth.keyframeBytes, scratch);
+    }
+    failures += BenchCheck(reads, "keyframe reads return the init segment's avcC and the keyframe sample");
+
+    // A read appends: what is already in the buffer stays
+    RTSPByteBufferReset(&buffer);
+    RTSPByteBufferAppend(&buffer, (const uint8_t *)"xyz", 3);
+    RTSPDVRSeekPoint point;
+    RTSPDVRKeyframeSample keyframe;
+    failures += BenchCheck(RTSPDVRStoreSeek(store, INT64_MAX, &point) &&
+                           RTSPDVRStoreReadKeyframe(store, &point, &keyframe, &buffer) &&
+                           keyframe.configOffset >= 3 && memcmp(buffer.data, "xyz", 3) == 0 &&
+                           BenchKeyframeMatches(&point, &keyframe, &buffer, synth.keyframeBytes, scratch),
+                           "keyframe reads append to the buffer");
+
+    RTSPByteBufferReset(&buffer);
+    failures += BenchCheck(!RTSPDVRStoreReadKeyframe(store, &early, &keyframe, &buffer) && buffer.length == 0,
+                           "keyframe reads of an overwritten segment fail");
+    RTSPDVRSeekPoint bogus = point;
+    bogus.offset += 1;
+    failures += BenchCheck(!RTSPDVRStoreReadKeyframe(store, &bogus, &keyframe, &buffer) && buffer.length == 0,
+                           "keyframe reads not at a moof fail");
+
+    free(scratch);
+    RTSPByteBufferFree(&record);
+    RTSPByteBufferFree(&buffer);
+    BenchSynthFree(&synth);
+    RTSPDVRStoreRelease(store);
+    return failures;
+}
+
+/// Round trips, persistence, geometry changes and clock replacement on an
+/// 8-tile sheet
+static unsigned BenchCheckSprite(const char *path) {
+    unsigned failures = 0;
+    RTSPTimelineSpriteConfig config = {.tileWidth = 16, .tileHeight = 9, .columns = 3, .tileCount = 8};
+    RTSPTimelineSpriteRef sprite = RTSPTimelineSpriteOpen(path, &config);
+    failures += BenchCheck(sprite != NULL, "sprite opens");
+    if (!sprite) {
+        return failures;
+    }
+    size_t bytesPerRow = (size_t)config.tileWidth * 4;
+    size_t tileBytes = bytesPerRow * config.tileHeight;
+    uint8_t *pixels = malloc(tileBytes);
+    uint8_t *copy = malloc(tileBytes);
+    RTSPDVRSeekPoint keyframes[10];
+    for (unsigned i = 0; i < 10; i++) {
+        keyframes[i] = (RTSPDVRSeekPoint){1 + i / 2, 4096 + (i % 2) * 50000, BENCH_EPOCH + i * 1000000LL};
+    }
+
+    bool inserted = true;
+    for (unsigned i = 0; i < 8; i++) {
+        BenchFillTile(pixels, config.tileWidth, config.tileHeight, bytesPerRow, keyframes[i].time);
+        inserted = inserted && RTSPTimelineSpriteLookup(sprite, &keyframes[i]) < 0 &&
+                   RTSPTimelineSpriteInsert(sprite, &keyframes[i], pixels, bytesPerRow) == (int32_t)i;
+    }
+    failures += BenchCheck(inserted, "empty tiles fill in order");
+
+    // Every tile reads back through a copy and where the sheet says it is
+    uint32_t sheetWidth = 0;
+    uint32_t sheetHeight = 0;
+    size_t sheetBytesPerRow = 0;
+    const uint8_t *sheet = RTSPTimelineSpriteSheet(sprite, &sheetWidth, &sheetHeight, &sheetBytesPerRow);
+    bool layout = sheet && sheetWidth == 48 && sheetHeight == 27 && sheetBytesPerRow >= 48 * 4;
+    bool roundTrip = true;
+    for (unsigned i = 0; layout && roundTrip && i < 8; i++) {
+        BenchFillTile(pixels, config.tileWidth, config.tileHeight, bytesPerRow, keyframes[i].time);
+        int32_t tile = RTSPTimelineSpriteLookup(sprite, &keyframes[i]);
+        roundTrip = tile == (int32_t)i && RTSPTimelineSpriteCopyTile(sprite, tile, &keyframes[i], copy, bytesPerRow) &&
+                    memcmp(copy, pixels, tileBytes) == 0;
+        const uint8_t *origin = sheet + (size_t)(i / 3) * config.tileHeight * sheetBytesPerRow +
+                                (size_t)(i % 3) * bytesPerRow;
+        for (uint32_t y = 0; y < config.tileHeight; y++) {
+            layout = layout && memcmp(origin + y * sheetBytesPerRow, pixels + y * bytesPerRow, bytesPerRow) == 0;
+        }
+    }
+    failures += BenchCheck(roundTrip, "tiles round-trip through lookup and copy");
+    failures += BenchCheck(layout, "tile i sits at column i % columns, row i / columns of the sheet");
+
+    RTSPDVRSeekPoint restarted = keyframes[2];
+    restarted.time += 3600000000LL;
+    failures += BenchCheck(RTSPTimelineSpriteLookup(sprite, &restarted) < 0 &&
+                           !RTSPTimelineSpriteCopyTile(sprite, 2, &restarted, copy, bytesPerRow),
+                           "a keyframe at another time does not match");
+
+    // Reopen: same tiles, same pixels
+    RTSPTimelineSpriteClose(sprite);
+    sprite = RTSPTimelineSpriteOpen(path, &config);
+    bool persisted = sprite && RTSPTimelineSpriteGetStatistics(sprite).tiles == 8;
+    for (unsigned i = 0; persisted && i < 8; i++) {
+        BenchFillTile(pixels, config.tileWidth, config.tileHeight, bytesPerRow, keyframes[i].time);
+        int32_t tile = RTSPTimelineSpriteLookup(sprite, &keyframes[i]);
+        persisted = tile == (int32_t)i && RTSPTimelineSpriteCopyTile(sprite, tile, &keyframes[i], copy, bytesPerRow) &&
+                    memcmp(copy, pixels, tileBytes) == 0;
+    }
+    failures += BenchCheck(persisted, "tiles survive reopening");
+    if (!sprite) {
+        free(pixels);
+        free(copy);
+        return failures;
+    }
+
+    // Everything was looked up since the reopen: a full pass of the hand
+    // clears the marks, then tile 0 goes. Looking up 2 and 3 then spares
+    // them from the next replacement, which takes 1 and then 4.
+    BenchFillTile(pixels, config.tileWidth, config.tileHeight, bytesPerRow, keyframes[8].time);
+    bool clock = RTSPTimelineSpriteInsert(sprite, &keyframes[8], pixels, bytesPerRow) == 0 &&
+                 RTSPTimelineSpriteLookup(sprite, &keyframes[0]) < 0;
+    clock = clock && RTSPTimelineSpriteLookup(sprite, &keyframes[2]) == 2 &&
+            RTSPTimelineSpriteLookup(sprite, &keyframes[3]) == 3;
+    BenchFillTile(pixels, config.tileWidth, config.tileHeight, bytesPerRow, keyframes[9].time);
+    clock = clock && RTSPTimelineSpriteInsert(sprite, &keyframes[9], pixels, bytesPerRow) == 1 &&
+            RTSPTimelineSpriteLookup(sprite, &keyframes[1]) < 0 &&
+            RTSPTimelineSpriteLookup(sprite, &keyframes[2]) == 2 &&
+            RTSPTimelineSpriteLookup(sprite, &keyframes[3]) == 3;
+    BenchFillTile(pixels, config.tileWidth, config.tileHeight, bytesPerRow, keyframes[0].time);
+    clock = clock && RTSPTimelineSpriteInsert(sprite, &keyframes[0], pixels, bytesPerRow) == 4 &&
+            RTSPTimelineSpriteLookup(sprite, &keyframes[4]) < 0;
+    failures += BenchCheck(clock, "the clock replaces tiles not looked up since the hand passed");
+    failures += BenchCheck(!RTSPTimelineSpriteCopyTile(sprite, 1, &keyframes[1], copy, bytesPerRow) &&
+                           RTSPTimelineSpriteCopyTile(sprite, 1, &keyframes[9], copy, bytesPerRow) &&
+                           memcmp(copy, (BenchFillTile(pixels, config.tileWidth, config.tileHeight, bytesPerRow,
+                                                       keyframes[9].time), pixels), tileBytes) == 0,
+                           "a replaced tile no longer copies for its old keyframe");
+    RTSPTimelineSpriteStatistics statistics = RTSPTimelineSpriteGetStatistics(sprite);
+    failures += BenchCheck(statistics.tiles == 8 && statistics.replaced == 3, "replacements are counted");
+
+    // Replacing a keyframe's thumbnail keeps its tile
+    failures += BenchCheck(RTSPTimelineSpriteInsert(sprite, &keyframes[2], pixels, bytesPerRow) == 2 &&
+                           RTSPTimelineSpriteGetStatistics(sprite).replaced == 3, "reinserting keeps the tile");
+    RTSPTimelineSpriteClose(sprite);
+
+    // Other geometry starts over
+    config.tileWidth = 32;
+    sprite = RTSPTimelineSpriteOpen(path, &config);
+    failures += BenchCheck(sprite && RTSPTimelineSpriteGetStatistics(sprite).tiles == 0 &&
+                           RTSPTimelineSpriteLookup(sprite, &keyframes[2]) < 0,
+                           "a sheet with other geometry is discarded");
+    RTSPTimelineSpriteClose(sprite);
+    unlink(path);
+    free(pixels);
+    free(copy);
+    return failures;
+}
+
+/// Events keep the seek point they were recorded at
+static unsigned BenchCheckEventMedia(const char *directory, RTSPDVRStoreRef dvr) {
+    unsigned failures = 0;
+    RTSPEventStoreConfig config;
+    RTSPEventStoreConfigInit(&config);
+    config.syncOnCommit = false;
+    RTSPEventStoreRef events = RTSPEventStoreOpen(directory, &config);
+    failures += BenchCheck(events != NULL, "event store opens");
+    if (!events) {
+        return failures;
+    }
+    RTSPDVRStoreStatistics statistics = RTSPDVRStoreGetStatistics(dvr);
+    uint64_t sequences[64];
+    RTSPDVRSeekPoint points[64];
+    for (unsigned i = 0; i < 64; i++) {
+        int64_t time = statistics.oldestTime + (int64_t)(BenchRandom() % (uint64_t)(statistics.newestTime -
+                                                                                     statistics.oldestTime));
+        RTSPDVRStoreSeek(dvr, time, &points[i]);
+        RTSPEventStoreEvent event = {0};
+        event.timestamp = time;
+        event.type = 1;
+        event.title = "person";
+        event.titleLength = 6;
+        if (i % 8 != 7) {
+            event.media = (RTSPEventStoreMediaRef){points[i].sequence, (uint32_t)points[i].offset, 0, points[i].time};
+        }
+        sequences[i] = RTSPEventStoreAppend(events, &event);
+    }
+    RTSPEventStoreClose(events);
+
+    events = RTSPEventStoreOpen(directory, &config);
+    RTSPByteBuffer buffer;
+    RTSPByteBufferInit(&buffer);
+    bool kept = events != NULL;
+    for (unsigned i = 0; kept && i < 64; i++) {
+        RTSPEventStoreEntry entry;
+        kept = RTSPEventStoreGet(events, sequences[i], &entry);
+        const RTSPEventStoreMediaRef *media = kept ? &entry.record->media : NULL;
+        if (kept && i % 8 == 7) {
+            kept = media->segment == 0 && media->offset == 0 && media->time == 0;
+        } else if (kept) {
+            RTSPDVRSeekPoint point = {media->segment, media->offset, media->time};
+            RTSPDVRKeyframeSample keyframe;
+            RTSPByteBufferReset(&buffer);
+            kept = point.sequence == points[i].sequence && point.offset == points[i].offset &&
+                   point.time == points[i].time && RTSPDVRStoreReadKeyframe(dvr, &point, &keyframe, &buffer);
+        }
+    }
+    failures += BenchCheck(kept, "events keep their keyframe across reopening, none when not recorded");
+    RTSPByteBufferFree(&buffer);
+    RTSPEventStoreClose(events);
+    return failures;
+}
+
+#pragma mark - Timeline
+
+typedef struct {
+    const char *root;
+    RTSPDVRStoreRef store;
+    BenchSynth synth;
+    int64_t start;
+    int64_t end;
+} BenchTimeline;
+
+static bool BenchTimelineOpen(BenchTimeline *timeline, const char *root, double minutes) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/timeline", root);
+    RTSPDVRStoreConfig config;
+    RTSPDVRStoreConfigInit(&config);
+    config.slotCount = (uint32_t)ceil(minutes * 60.0 / config.segmentDuration);
+    config.slotBytes = 4 << 20;
+    config.reserveSpace = false;
+    timeline->root = root;
+    timeline->store = RTSPDVRStoreOpen(path, &config);
+    if (!timeline->store) {
+        return false;
+    }
+    // 1 Mbps: a 40 KB keyframe and 3 KB frames
+    BenchSynthInit(&timeline->synth, timeline->store, 40000, 3000);
+    BenchSynthFeed(&timeline->synth, timeline->store, minutes * 60.0);
+    RTSPDVRStoreCut(timeline->store);
+    RTSPDVRStoreStatistics statistics = RTSPDVRStoreGetStatistics(timeline->store);
+    timeline->start = statistics.oldestTime;
+    timeline->end = statistics.newestTime;
+    return true;
+}
+
+static void BenchTimelineClose(BenchTimeline *timeline) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/timeline", timeline->root);
+    BenchSynthFree(&timeline->synth);
+    RTSPDVRStoreRelease(timeline->store);
+    BenchRemoveDirectory(path);
+}
+
+static int64_t BenchStripTime(const BenchTimeline *timeline, unsigned i, unsigned count) {
+    return timeline->start + (int64_t)((double)(timeline->end - timeline->start) * (2 * i + 1) / (2.0 * count));
+}
+
+/// Cold and warm strips against reading whole segments
+static unsigned BenchStrip(BenchTimeline *timeline, unsigned tiles) {
+    unsigned failures = 0;
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/thumbnails.sprite", timeline->root);
+    RTSPTimelineSpriteRef sprite = RTSPTimelineSpriteOpen(path, NULL);
+    if (!sprite) {
+        return BenchCheck(false, "default sprite opens");
+    }
+    RTSPTimelineSpriteConfig config = RTSPTimelineSpriteGetConfig(sprite);
+    size_t bytesPerRow = (size_t)config.tileWidth * 4 * tiles;
+    uint8_t *strip = calloc(bytesPerRow, config.tileHeight);
+    RTSPByteBuffer buffer;
+    RTSPByteBufferInit(&buffer);
+    uint8_t *scratch = malloc(timeline->synth.keyframeBytes);
+
+    // Cold: every tile is a keyframe read, then a decode that is not
+    // measured, then an insert
+    uint64_t coldBytes = 0;
+    bool cold = true;
+    double coldStart = BenchNow();
+    for (unsigned i = 0; i < tiles; i++) {
+        RTSPDVRSeekPoint point;
+        RTSPDVRKeyframeSample keyframe;
+        RTSPByteBufferReset(&buffer);
+        cold = cold && RTSPDVRStoreSeek(timeline->store, BenchStripTime(timeline, i, tiles), &point) &&
+               RTSPDVRStoreReadKeyframe(timeline->store, &point, &keyframe, &buffer) &&
+               BenchKeyframeMatches(&point, &keyframe, &buffer, timeline->synth.keyframeBytes, scratch);
+        coldBytes += buffer.length;
+        uint8_t *tile = strip + (size_t)i * config.tileWidth * 4;
+        BenchFillTile(tile, config.tileWidth, config.tileHeight, bytesPerRow, point.time);
+        cold = cold && RTSPTimelineSpriteInsert(sprite, &point, tile, bytesPerRow) >= 0;
+    }
+    double coldTime = BenchNow() - coldStart;
+    failures += BenchCheck(cold, "cold strip reads every keyframe");
+
+    // Without the keyframe reader: each tile's segment, whole
+    uint64_t wholeBytes = 0;
+    double wholeStart = BenchNow();
+    for (unsigned i = 0; i < tiles; i++) {
+        RTSPDVRSeekPoint point;
+        RTSPByteBufferReset(&buffer);
+        RTSPDVRStoreSeek(timeline->store, BenchStripTime(timeline, i, tiles), &point);
+        RTSPDVRStoreRead(timeline->store, point.sequence, 0, UINT64_MAX, &buffer);
+        wholeBytes += buffer.length;
+    }
+    double wholeTime = BenchNow() - wholeStart;
+
+    // Warm: the same strip from the sheet
+    memset(strip, 0, bytesPerRow * config.tileHeight);
+    RTSPTimelineSpriteStatistics before = RTSPTimelineSpriteGetStatistics(sprite);
+    unsigned rounds = 100;
+    bool warm = true;
+    double warmStart = BenchNow();
+    for (unsigned round = 0; round < rounds; round++) {
+        for (unsigned i = 0; i < tiles; i++) {
+            RTSPDVRSeekPoint point;
+            RTSPDVRStoreSeek(timeline->store, BenchStripTime(timeline, i, tiles), &point);
+            int32_t tile = RTSPTimelineSpriteLookup(sprite, &point);
+            warm = warm && tile >= 0 &&
+                   RTSPTimelineSpriteCopyTile(sprite, tile, &point, strip + (size_t)i * config.tileWidth * 4,
+                                              bytesPerRow);
+        }
+    }
+    double warmTime = (BenchNow() - warmStart) / rounds;
+    RTSPTimelineSpriteStatistics after = RTSPTimelineSpriteGetStatistics(sprite);
+    failures += BenchCheck(warm && after.misses == before.misses, "warm strip is served from the sheet");
+
+    uint8_t *expected = malloc((size_t)config.tileWidth * 4 * config.tileHeight);
+    bool pixels = true;
+    for (unsigned i = 0; pixels && i < tiles; i++) {
+        RTSPDVRSeekPoint point;
+        RTSPDVRStoreSeek(timeline->store, BenchStripTime(timeline, i, tiles), &point);
+        BenchFillTile(expected, config.tileWidth, config.tileHeight, (size_t)config.tileWidth * 4, point.time);
+        for (uint32_t y = 0; pixels && y < config.tileHeight; y++) {
+            pixels = memcmp(strip + y * bytesPerRow + (size_t)i * config.tileWidth * 4,
+                            expected + (size_t)y * config.tileWidth * 4, (size_t)config.tileWidth * 4) == 0;
+        }
+    }
+    failures += BenchCheck(pixels, "warm strip tiles hold their keyframe's pixels");
+
+    double warmTile = warmTime / tiles * 1e6;
+    printf("  strip             %u tiles over %.0f min, %ux%u tiles\n", tiles,
+           (timeline->end - timeline->start) / 60e6, config.tileWidth, config.tileHeight);
+    printf("    cold            %.2f ms, %.2f MB read (keyframe reads, decode not included)\n",
+           coldTime * 1e3, coldBytes / 1e6);
+    printf("    whole segments  %.2f ms, %.2f MB read (%.0fx the bytes)\n",
+           wholeTime * 1e3, wholeBytes / 1e6, (double)wholeBytes / (coldBytes ? coldBytes : 1));
+    printf("    warm            %.3f ms, %.2f µs per tile (target ≤ %.1f)\n",
+           warmTime * 1e3, warmTile, BENCH_TARGET_WARM_TILE_US);
+    failures += BenchCheck(warmTile <= BENCH_TARGET_WARM_TILE_US, "warm strip tile cost");
+
+    free(expected);
+    free(scratch);
+    free(strip);
+    RTSPByteBufferFree(&buffer);
+    RTSPTimelineSpriteClose(sprite);
+    unlink(path);
+    return failures;
+}
+
+/// Events straight to their keyframe, then random scrubbing
+static unsigned BenchJumpAndScrub(BenchTimeline *timeline, unsigned scrubs) {
+    unsigned failures = 0;
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/events", timeline->root);
+    failures += BenchCheckEventMedia(path, timeline->store);
+    RTSPEventStoreConfig eventConfig;
+    RTSPEventStoreConfigInit(&eventConfig);
+    eventConfig.syncOnCommit = false;
+    RTSPEventStoreRef events = RTSPEventStoreOpen(path, &eventConfig);
+    if (!events) {
+        BenchRemoveDirectory(path);
+        return failures + BenchCheck(false, "event store reopens");
+    }
+    uint64_t first = RTSPEventStoreGetStatistics(events).firstSequence;
+    RTSPByteBuffer buffer;
+    RTSPByteBufferInit(&buffer);
+    unsigned jumps = 0;
+    double jumpStart = BenchNow();
+    for (unsigned round = 0; round < 100; round++) {
+        for (uint64_t sequence = first; sequence < first + 64; sequence++) {
+            RTSPEventStoreEntry entry;
+            RTSPDVRKeyframeSample keyframe;
+            RTSPByteBufferReset(&buffer);
+            if (RTSPEventStoreGet(events, sequence, &entry) && entry.record->media.segment != 0) {
+                RTSPDVRSeekPoint point = {entry.record->media.segment, entry.record->media.offset,
+                                          entry.record->media.time};
+                jumps += RTSPDVRStoreReadKeyframe(timeline->store, &point, &keyframe, &buffer);
+            }
+        }
+    }
+    double jump = (BenchNow() - jumpStart) / (jumps ? jumps : 1) * 1e6;
+    failures += BenchCheck(jumps == 5600, "every recorded event jumps to its keyframe");
+    printf("  event jump        %.1f µs per event to its keyframe bytes (target ≤ %.0f)\n", jump, BENCH_TARGET_JUMP_US);
+    failures += BenchCheck(jump <= BENCH_TARGET_JUMP_US, "event jump latency");
+    RTSPEventStoreClose(events);
+    BenchRemoveDirectory(path);
+
+    // Scrubbing: uniformly random times through the default sheet
+    snprintf(path, sizeof(path), "%s/thumbnails.sprite", timeline->root);
+    RTSPTimelineSpriteRef sprite = RTSPTimelineSpriteOpen(path, NULL);
+    if (!sprite) {
+        RTSPByteBufferFree(&buffer);
+        return failures + BenchCheck(false, "default sprite opens");
+    }
+    RTSPTimelineSpriteConfig config = RTSPTimelineSpriteGetConfig(sprite);
+    size_t bytesPerRow = (size_t)config.tileWidth * 4;
+    uint8_t *pixels = malloc(bytesPerRow * config.tileHeight);
+    uint64_t span = (uint64_t)(timeline->end - timeline->start);
+    bool consistent = true;
+    for (unsigned i = 0; i < scrubs; i++) {
+        RTSPDVRSeekPoint point;
+        RTSPDVRStoreSeek(timeline->store, timeline->start + (int64_t)(BenchRandom() % span), &point);
+        int32_t tile = RTSPTimelineSpriteLookup(sprite, &point);
+        if (tile < 0) {
+            BenchFillTile(pixels, config.tileWidth, config.tileHeight, bytesPerRow, point.time);
+            consistent = consistent && RTSPTimelineSpriteInsert(sprite, &point, pixels, bytesPerRow) >= 0;
+        } else {
+            consistent = consistent && RTSPTimelineSpriteCopyTile(sprite, tile, &point, pixels, bytesPerRow);
+        }
+    }
+    RTSPTimelineSpriteStatistics statistics = RTSPTimelineSpriteGetStatistics(sprite);
+    uint64_t keyframes = span / 1000000;
+    failures += BenchCheck(consistent && statistics.tiles == (keyframes < config.tileCount ? keyframes : config.tileCount),
+                           "scrubbing fills the sheet and copies what it finds");
+    printf("  scrubbing         %u scrubs over %llu keyframes into %u tiles: %.1f%% hits, %llu replaced\n",
+           scrubs, (unsigned long long)keyframes, config.tileCount,
+           100.0 * statistics.hits / (statistics.hits + statistics.misses), (unsigned long long)statistics.replaced);
+    free(pixels);
+    RTSPByteBufferFree(&buffer);
+    RTSPTimelineSpriteClose(sprite);
+    unlink(path);
+    return failures;
+}
+
+int main(int argc, char **argv) {
+    double minutes = 10.0;
+    unsigned tiles = 120;
+    unsigned scrubs = 20000;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--minutes") == 0 && i + 1 < argc) {
+            minutes = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--tiles") == 0 && i + 1 < argc) {
+            tiles = (unsigned)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--scrubs") == 0 && i + 1 < argc) {
+            scrubs = (unsigned)atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--minutes M] [--tiles N] [--scrubs N]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (minutes < 2.0) {
+        minutes = 2.0;
+    }
+    if (tiles == 0) {
+        tiles = 1;
+    }
+
+    char root[] = "/tmp/timeline_bench.XXXXXX";
+    if (!mkdtemp(root)) {
+        fprintf(stderr, "mkdtemp failed\n");
+        return 1;
+    }
+    char path[PATH_MAX];
+    printf("timeline_bench: %.0f min recorded, %u-tile strip, %u scrubs\n", minutes, tiles, scrubs);
+
+    snprintf(path, sizeof(path), "%s/ring", root);
+    unsigned failures = BenchCheckKeyframes(path);
+    BenchRemoveDirectory(path);
+    snprintf(path, sizeof(path), "%s/check.sprite", root);
+    failures += BenchCheckSprite(path);
+
+    BenchTimeline timeline;
+    if (BenchTimelineOpen(&timeline, root, minutes)) {
+        failures += BenchStrip(&timeline, tiles);
+        failures += BenchJumpAndScrub(&timeline, scrubs);
+        BenchTimelineClose(&timeline);
+    } else {
+        failures += BenchCheck(false, "timeline store opens");
+    }
+    rmdir(root);
+
+    if (failures) {
+        printf("FAILED (%u)\n", failures);
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
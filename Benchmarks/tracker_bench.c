@@ -0,0 +1,426 @@
+//
+//  tracker_bench.c
+//  RTSP Rotator Benchmarks
+//
+//  Benchmark for RTSPTracker on synthetic scenes: objects of two classes
+//  wander and cross at 10 fps with detection noise, short occlusions,
+//  partly occluded (low-confidence) frames and one-frame false positives.
+//  Reports identity switches per 1000 ground-truth detections (against the
+//  old behaviour of a fresh ID per detection), tracks started per object,
+//  update latency for 30 / 200 objects, and the box error when inference
+//  runs on every third frame of a 30 fps stream and the tracker predicts the
+//  frames between, against holding the last detected box.
+//
+//  Checks: lifecycle and zone events with dwell time on a scripted walk,
+//  rect and polygon zones, late frames rejected, identity switches and
+//  interpolation within targets.
+//
+//  Build (Linux / macOS):
+//    cc -O2 -std=c11 -I"../RTSP Rotator" tracker_bench.c "../RTSP Rotator/RTSPTracker.c" "../RTSP Rotator/RTSPZoneIndex.c" -lm -o tracker_bench
+//
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "RTSPTracker.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_TARGET_SWITCHES_PER_1000 5.0
+#define BENCH_TARGET_UPDATE_P99_MS 1.0       // 200 objects
+#define BENCH_MAX_OBJECTS 256
+#define BENCH_MAX_DETECTIONS (BENCH_MAX_OBJECTS + 16)
+
+static double BenchNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static int BenchCompareDouble(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double BenchPercentile(const double *sorted, size_t count, double percentile) {
+    if (count == 0) {
+        return 0;
+    }
+    size_t index = (size_t)(percentile * (double)(count - 1) + 0.5);
+    return sorted[index < count ? index : count - 1];
+}
+
+static unsigned BenchCheck(bool condition, const char *what) {
+    if (!condition) {
+        fprintf(stderr, "  check failed: %s\n", what);
+    }
+    return condition ? 0 : 1;
+}
+
+static uint32_t BenchRandom(uint32_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static double BenchUniform(uint32_t *state, double low, double high) {
+    return low + (high - low) * (BenchRandom(state) / 4294967296.0);
+}
+
+static double BenchGaussian(uint32_t *state, double sigma) {
+    double u = BenchUniform(state, 1e-12, 1.0), v = BenchUniform(state, 0.0, 1.0);
+    return sigma * sqrt(-2.0 * log(u)) * cos(6.283185307179586 * v);
+}
+
+#pragma mark - Scene
+
+typedef struct {
+    double x, y, vx, vy, width, height;
+    uint32_t classID;
+    int occludedFrames;
+    uint64_t lastTrack;             // Track ID given to its last detection
+} BenchObject;
+
+typedef struct {
+    BenchObject objects[BENCH_MAX_OBJECTS];
+    uint32_t count;
+    uint32_t seed;
+    double fps;
+} BenchScene;
+
+static void BenchSceneInit(BenchScene *scene, uint32_t count, double fps, uint32_t seed) {
+    memset(scene, 0, sizeof(*scene));
+    scene->count = count;
+    scene->seed = seed;
+    scene->fps = fps;
+    for (uint32_t i = 0; i < count; i++) {
+        BenchObject *object = &scene->objects[i];
+        object->width = BenchUniform(&scene->seed, 0.03, 0.08);
+        object->height = object->width * BenchUniform(&scene->seed, 1.5, 2.5);
+        object->x = BenchUniform(&scene->seed, 0, 1 - object->width);
+        object->y = BenchUniform(&scene->seed, 0, 1 - object->height);
+        double speed = BenchUniform(&scene->seed, 0.02, 0.15);
+        double heading = BenchUniform(&scene->seed, 0, 6.283185307179586);
+        object->vx = speed * cos(heading);
+        object->vy = speed * sin(heading);
+        object->classID = i % 2;
+    }
+}
+
+/// Move every object one frame: gentle random acceleration, turning back
+/// smoothly near the edges, at walking speeds
+static void BenchSceneStep(BenchScene *scene) {
+    double dt = 1.0 / scene->fps;
+    for (uint32_t i = 0; i < scene->count; i++) {
+        BenchObject *object = &scene->objects[i];
+        double ax = BenchGaussian(&scene->seed, 0.05), ay = BenchGaussian(&scene->seed, 0.05);
+        ax += object->x < 0.1 ? 0.2 : object->x > 0.9 - object->width ? -0.2 : 0;
+        ay += object->y < 0.1 ? 0.2 : object->y > 0.9 - object->height ? -0.2 : 0;
+        object->vx += ax * dt;
+        object->vy += ay * dt;
+        double speed = sqrt(object->vx * object->vx + object->vy * object->vy);
+        if (speed > 0.15) {
+            object->vx *= 0.15 / speed;
+            object->vy *= 0.15 / speed;
+        }
+        object->x = fmin(fmax(object->x + object->vx * dt, 0), 1 - object->width);
+        object->y = fmin(fmax(object->y + object->vy * dt, 0), 1 - object->height);
+    }
+}
+
+/// Detections for the current frame, shuffled; owners[i] = object index or -1 (false positive)
+static size_t BenchSceneDetect(BenchScene *scene, RTSPTrackerDetection *detections, int *owners) {
+    size_t count = 0;
+    double frameScale = 10.0 / scene->fps;      // Occlusion lengths are set at 10 fps
+    for (uint32_t i = 0; i < scene->count; i++) {
+        BenchObject *object = &scene->objects[i];
+        if (object->occludedFrames > 0) {
+            object->occludedFrames--;
+            continue;
+        }
+        if (BenchUniform(&scene->seed, 0, 1) < 0.01 * frameScale) {
+            object->occludedFrames = (int)((3 + BenchRandom(&scene->seed) % 6) / frameScale);
+            continue;
+        }
+        RTSPTrackerDetection *detection = &detections[count];
+        detection->x = (float)(object->x + BenchGaussian(&scene->seed, 0.003));
+        detection->y = (float)(object->y + BenchGaussian(&scene->seed, 0.003));
+        detection->width = (float)(object->width * (1 + BenchGaussian(&scene->seed, 0.04)));
+        detection->height = (float)(object->height * (1 + BenchGaussian(&scene->seed, 0.04)));
+        bool partial = BenchUniform(&scene->seed, 0, 1) < 0.1;
+        detection->score = (float)(partial ? BenchUniform(&scene->seed, 0.2, 0.45) : BenchUniform(&scene->seed, 0.55, 0.95));
+        detection->classID = object->classID;
+        owners[count++] = (int)i;
+    }
+    // About one false positive per frame, never in the same place twice
+    uint32_t falsePositives = BenchRandom(&scene->seed) % 3;
+    for (uint32_t f = 0; f < falsePositives; f++) {
+        RTSPTrackerDetection *detection = &detections[count];
+        detection->width = (float)BenchUniform(&scene->seed, 0.03, 0.08);
+        detection->height = detection->width * 2;
+        detection->x = (float)BenchUniform(&scene->seed, 0, 1 - detection->width);
+        detection->y = (float)BenchUniform(&scene->seed, 0, 1 - detection->height);
+        detection->score = (float)BenchUniform(&scene->seed, 0.3, 0.6);
+        detection->classID = BenchRandom(&scene->seed) % 2;
+        owners[count++] = -1;
+    }
+    for (size_t i = count; i > 1; i--) {
+        size_t j = BenchRandom(&scene->seed) % i;
+        RTSPTrackerDetection detection = detections[i - 1];
+        detections[i - 1] = detections[j];
+        detections[j] = detection;
+        int owner = owners[i - 1];
+        owners[i - 1] = owners[j];
+        owners[j] = owner;
+    }
+    return count;
+}
+
+static double BenchIoU(double ax, double ay, double aw, double ah, double bx, double by, double bw, double bh) {
+    double left = fmax(ax, bx), top = fmax(ay, by);
+    double right = fmin(ax + aw, bx + bw), bottom = fmin(ay + ah, by + bh);
+    if (right <= left || bottom <= top) {
+        return 0;
+    }
+    double intersection = (right - left) * (bottom - top);
+    return intersection / (aw * ah + bw * bh - intersection);
+}
+
+#pragma mark - Benchmarks
+
+typedef struct {
+    uint64_t detections;            // Ground-truth detections
+    uint64_t tracked;               // ... given a track ID
+    uint64_t switches;
+    uint64_t tracksStarted;
+    double p50, p99;                // Update latency, ms
+} BenchIdentity;
+
+static BenchIdentity BenchRunIdentity(uint32_t objects, uint32_t frames, uint32_t seed) {
+    BenchIdentity result = {0};
+    BenchScene *scene = malloc(sizeof(*scene));
+    BenchSceneInit(scene, objects, 10.0, seed);
+    RTSPTrackerRef tracker = RTSPTrackerCreate(NULL);
+    RTSPTrackerDetection detections[BENCH_MAX_DETECTIONS];
+    int owners[BENCH_MAX_DETECTIONS];
+    uint64_t trackIDs[BENCH_MAX_DETECTIONS];
+    double *latencies = malloc(frames * sizeof(double));
+
+    for (uint32_t frame = 0; frame < frames; frame++) {
+        BenchSceneStep(scene);
+        size_t count = BenchSceneDetect(scene, detections, owners);
+        double start = BenchNow();
+        RTSPTrackerUpdate(tracker, frame / scene->fps, detections, count, trackIDs);
+        latencies[frame] = (BenchNow() - start) * 1000.0;
+        for (size_t d = 0; d < count; d++) {
+            if (owners[d] < 0) {
+                continue;
+            }
+            BenchObject *object = &scene->objects[owners[d]];
+            result.detections++;
+            if (trackIDs[d] == 0) {
+                continue;
+            }
+            result.tracked++;
+            if (object->lastTrack && object->lastTrack != trackIDs[d]) {
+                result.switches++;
+            }
+            object->lastTrack = trackIDs[d];
+        }
+    }
+    result.tracksStarted = RTSPTrackerGetStatistics(tracker).tracksStarted;
+    qsort(latencies, frames, sizeof(double), BenchCompareDouble);
+    result.p50 = BenchPercentile(latencies, frames, 0.50);
+    result.p99 = BenchPercentile(latencies, frames, 0.99);
+    free(latencies);
+    RTSPTrackerRelease(tracker);
+    free(scene);
+    return result;
+}
+
+/// 30 fps ground truth, inference on every third frame; mean IoU of the
+/// boxes shown on the frames between
+static void BenchRunInterpolation(double *predictedIoU, double *heldIoU) {
+    BenchScene *scene = malloc(sizeof(*scene));
+    BenchSceneInit(scene, 20, 30.0, 0xC0FFEEu);
+    for (uint32_t i = 0; i < scene->count; i++) {
+        scene->objects[i].vx *= 3;                  // Brisk walkers, so holding a box shows
+        scene->objects[i].vy *= 3;
+    }
+    RTSPTrackerRef tracker = RTSPTrackerCreate(NULL);
+    RTSPTrackerDetection detections[BENCH_MAX_DETECTIONS];
+    int owners[BENCH_MAX_DETECTIONS];
+    uint64_t trackIDs[BENCH_MAX_DETECTIONS];
+    RTSPTrack tracks[BENCH_MAX_DETECTIONS * 2];
+    float held[BENCH_MAX_OBJECTS][4] = {{0}};
+    double predictedSum = 0, heldSum = 0;
+    uint64_t samples = 0;
+
+    for (uint32_t frame = 0; frame < 3000; frame++) {
+        BenchSceneStep(scene);
+        double timestamp = frame / scene->fps;
+        if (frame % 3 == 0) {
+            size_t count = BenchSceneDetect(scene, detections, owners);
+            RTSPTrackerUpdate(tracker, timestamp, detections, count, trackIDs);
+            for (size_t d = 0; d < count; d++) {
+                if (owners[d] >= 0 && trackIDs[d]) {
+                    scene->objects[owners[d]].lastTrack = trackIDs[d];
+                    memcpy(held[owners[d]], &detections[d].x, sizeof(held[0]));
+                }
+            }
+            continue;
+        }
+        size_t trackCount = RTSPTrackerGetTracks(tracker, timestamp, tracks, sizeof(tracks) / sizeof(tracks[0]));
+        for (size_t t = 0; t < trackCount && frame > 90; t++) {
+            if (tracks[t].state != RTSPTrackStateConfirmed) {
+                continue;
+            }
+            for (uint32_t i = 0; i < scene->count; i++) {
+                const BenchObject *object = &scene->objects[i];
+                if (object->lastTrack != tracks[t].trackID || object->occludedFrames > 0) {
+                    continue;
+                }
+                predictedSum += BenchIoU(tracks[t].x, tracks[t].y, tracks[t].width, tracks[t].height,
+                                         object->x, object->y, object->width, object->height);
+                heldSum += BenchIoU(held[i][0], held[i][1], held[i][2], held[i][3],
+                                    object->x, object->y, object->width, object->height);
+                samples++;
+            }
+        }
+    }
+    *predictedIoU = samples ? predictedSum / (double)samples : 0;
+    *heldIoU = samples ? heldSum / (double)samples : 0;
+    RTSPTrackerRelease(tracker);
+    free(scene);
+}
+
+#pragma mark - Checks
+
+static unsigned BenchLifecycleChecks(void) {
+    unsigned failures = 0;
+    RTSPTrackerRef tracker = RTSPTrackerCreate(NULL);
+    const float zones[1][4] = {{0.4f, 0.0f, 0.2f, 1.0f}};
+    RTSPTrackerSetZones(tracker, zones, 1);
+
+    // One person walking right at 0.1 / s for 8 s, then gone
+    uint32_t started = 0, ended = 0, entered = 0, exited = 0;
+    double enteredAt = -1, dwell = -1, lifetime = -1, dwellMidway = -1;
+    uint64_t firstID = 0;
+    bool stableID = true;
+    for (int frame = 0; frame <= 100; frame++) {
+        double timestamp = frame / 10.0;
+        RTSPTrackerDetection detection = {(float)(0.1 * timestamp), 0.4f, 0.1f, 0.2f, 0.9f, 0};
+        uint64_t trackID = 0;
+        RTSPTrackerUpdate(tracker, timestamp, &detection, timestamp < 8.0 ? 1 : 0, &trackID);
+        if (timestamp < 8.0) {
+            firstID = firstID ? firstID : trackID;
+            stableID &= trackID == firstID;
+        }
+        if (frame == 45) {
+            dwellMidway = RTSPTrackerZoneDwell(tracker, firstID, 0, timestamp);
+        }
+        size_t eventCount = 0;
+        const RTSPTrackEvent *events = RTSPTrackerEvents(tracker, &eventCount);
+        for (size_t e = 0; e < eventCount; e++) {
+            switch (events[e].type) {
+                case RTSPTrackEventStarted: started++; break;
+                case RTSPTrackEventEnded: ended++; lifetime = events[e].duration; break;
+                case RTSPTrackEventZoneEntered: entered++; enteredAt = events[e].timestamp; break;
+                case RTSPTrackEventZoneExited: exited++; dwell = events[e].duration; break;
+            }
+        }
+    }
+    failures += BenchCheck(stableID, "one ID for the whole walk");
+    failures += BenchCheck(started == 1 && ended == 1, "one started and one ended event");
+    failures += BenchCheck(entered == 1 && exited == 1 && fabs(enteredAt - 3.5) <= 0.15 && fabs(dwell - 2.0) <= 0.15,
+                           "zone entered at 3.5 s with 2 s dwell");
+    failures += BenchCheck(fabs(dwellMidway - 1.0) <= 0.15, "live dwell time");
+    failures += BenchCheck(fabs(lifetime - 7.9) < 1e-6, "ended event carries the track lifetime");
+    failures += BenchCheck(!RTSPTrackerUpdate(tracker, 5.0, NULL, 0, NULL), "late frame rejected");
+
+    // Polygon zone: at the walker's feet (y 0.6) the triangle spans x 0.3 - 0.54, not its bounds' 0.3 - 0.7
+    RTSPTrackerReset(tracker);
+    const RTSPZonePoint triangle[] = {{0.3f, 0.0f}, {0.7f, 1.0f}, {0.3f, 1.0f}};
+    RTSPZonePolygon polygon = {triangle, 3, 0.0f};
+    RTSPTrackerSetZonePolygons(tracker, &polygon, 1);
+    entered = exited = 0;
+    for (int frame = 0; frame <= 80; frame++) {
+        double timestamp = 10.0 + frame / 10.0;
+        RTSPTrackerDetection detection = {(float)(0.1 * frame / 10.0), 0.4f, 0.1f, 0.2f, 0.9f, 0};
+        RTSPTrackerUpdate(tracker, timestamp, &detection, 1, NULL);
+        size_t eventCount = 0;
+        const RTSPTrackEvent *events = RTSPTrackerEvents(tracker, &eventCount);
+        for (size_t e = 0; e < eventCount; e++) {
+            if (events[e].type == RTSPTrackEventZoneEntered) {
+                entered++;
+                enteredAt = events[e].timestamp;
+            } else if (events[e].type == RTSPTrackEventZoneExited) {
+                exited++;
+                dwell = events[e].duration;
+            }
+        }
+    }
+    failures += BenchCheck(entered == 1 && exited == 1 && fabs(enteredAt - 12.5) <= 0.15 && fabs(dwell - 2.4) <= 0.15,
+                           "polygon zone entered at 2.5 s with 2.4 s dwell");
+
+    // A one-frame blip never becomes a track; a low-confidence box never starts one
+    RTSPTrackerReset(tracker);
+    RTSPTrackerDetection blip = {0.1f, 0.1f, 0.1f, 0.2f, 0.9f, 1};
+    RTSPTrackerDetection faint = {0.5f, 0.5f, 0.1f, 0.2f, 0.3f, 1};
+    uint64_t before = RTSPTrackerGetStatistics(tracker).tracksStarted;
+    RTSPTrackerUpdate(tracker, 20.0, &blip, 1, NULL);
+    for (int frame = 1; frame < 10; frame++) {
+        uint64_t trackID = 1;
+        RTSPTrackerUpdate(tracker, 20.0 + frame / 10.0, &faint, 1, &trackID);
+        failures += BenchCheck(trackID == 0, "low-confidence detection starts no track");
+    }
+    failures += BenchCheck(RTSPTrackerGetStatistics(tracker).tracksStarted == before, "blips are not confirmed");
+    RTSPTrackerRelease(tracker);
+    return failures;
+}
+
+int main(void) {
+    printf("tracker_bench\n");
+    unsigned failures = BenchLifecycleChecks();
+    printf("  lifecycle and zone checks: %s\n", failures ? "FAILED" : "ok");
+
+    static const struct {
+        const char *name;
+        uint32_t objects;
+    } scenes[] = {
+        {"30 objects", 30},
+        {"200 objects", 200},
+    };
+    bool targetsMet = true;
+    for (size_t s = 0; s < sizeof(scenes) / sizeof(scenes[0]); s++) {
+        BenchIdentity identity = BenchRunIdentity(scenes[s].objects, 3000, 0x1234567u + (uint32_t)s);
+        double perThousand = 1000.0 * (double)identity.switches / (double)identity.detections;
+        printf("  %-12s %5.2f ID switches / 1000 detections (fresh IDs: 1000), %4.1f%% tracked,"
+               " %.2f tracks per object, update p50 %.3f ms p99 %.3f ms\n",
+               scenes[s].name, perThousand, 100.0 * (double)identity.tracked / (double)identity.detections,
+               (double)identity.tracksStarted / scenes[s].objects, identity.p50, identity.p99);
+        if (scenes[s].objects == 30) {
+            targetsMet &= perThousand <= BENCH_TARGET_SWITCHES_PER_1000;
+        } else {
+            targetsMet &= identity.p99 <= BENCH_TARGET_UPDATE_P99_MS;
+        }
+    }
+
+    double predictedIoU = 0, heldIoU = 0;
+    BenchRunInterpolation(&predictedIoU, &heldIoU);
+    printf("  inference every 3rd frame at 30 fps: predicted boxes IoU %.3f, held boxes IoU %.3f\n", predictedIoU, heldIoU);
+    failures += BenchCheck(predictedIoU > heldIoU, "prediction beats holding the last box");
+
+    printf("  targets: <= %.0f ID switches / 1000 detections (30 objects), update p99 <= %.1f ms (200 objects)\n",
+           BENCH_TARGET_SWITCHES_PER_1000, BENCH_TARGET_UPDATE_P99_MS);
+    if (failures > 0 || !targetsMet) {
+        fprintf(stderr, "FAIL: %u check(s)%s\n", failures, targetsMet ? "" : ", target missed");
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
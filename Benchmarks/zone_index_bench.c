@@ -0,0 +1,419 @@
+//
+//  zone_index_bench.c
+//  RTSP Rotator Benchmarks
+//
+//  Benchmark for RTSPZoneIndex.
+//
+//  Matches detection boxes against 4, 16 and 64 zones per camera (a mix of
+//  rectangles and concave star-shaped polygons, some overlapping), timing
+//  the index against clipping every box against every zone, and against
+//  the old detector path: two scans of every zone's bounding rect per
+//  detection (one to filter, one to name the zone). Foot-point lookups are
+//  timed against testing every polygon.
+//
+//  Checks: masks and overlap fractions match a double-precision reference
+//  for every box and threshold, point lookups match a brute-force crossing
+//  test, and hand-made cases: a box in the notch of an L-shaped zone, half
+//  in / half out, half-open rect edges, zero-area boxes, zones beyond the
+//  frame, 64 zones and invalid input.
+//
+//  Build (Linux / macOS):
+//    cc -O2 -std=c11 -I"../RTSP Rotator" zone_index_bench.c "../RTSP Rotator/RTSPZoneIndex.c" -lm -o zone_index_bench
+//
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "RTSPZoneIndex.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_BOXES 4096
+#define BENCH_POINTS 200000
+#define BENCH_ROUNDS 50
+#define BENCH_TARGET_SPEEDUP 3.0        // Index against clipping every zone, 16 zones
+
+static double BenchNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static uint32_t BenchRandom(uint32_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static float BenchUniform(uint32_t *state, float low, float high) {
+    return low + (high - low) * (float)(BenchRandom(state) >> 8) / 16777216.0f;
+}
+
+static unsigned BenchCheck(bool condition, const char *what) {
+    if (!condition) {
+        fprintf(stderr, "  check failed: %s\n", what);
+    }
+    return condition ? 0 : 1;
+}
+
+#pragma mark - Scenes
+
+typedef struct {
+    uint32_t count;
+    RTSPZonePolygon zones[RTSP_ZONE_INDEX_MAX_ZONES];
+    RTSPZonePoint points[RTSP_ZONE_INDEX_MAX_ZONES][RTSP_ZONE_INDEX_MAX_POINTS];
+} BenchScene;
+
+typedef struct {
+    float x, y, width, height;
+} BenchBox;
+
+/// Every third zone a rectangle, the rest stars of 6 - 24 points with
+/// alternating radii (concave), thresholds from any overlap to 60%
+static void BenchMakeScene(BenchScene *scene, uint32_t count, uint32_t seed) {
+    scene->count = count;
+    for (uint32_t z = 0; z < count; z++) {
+        RTSPZonePoint *points = scene->points[z];
+        float cx = BenchUniform(&seed, 0.1f, 0.9f), cy = BenchUniform(&seed, 0.1f, 0.9f);
+        float radius = BenchUniform(&seed, 0.04f, 0.2f);
+        uint32_t n;
+        if (z % 3 == 0) {
+            float w = radius * BenchUniform(&seed, 0.8f, 1.6f), h = radius * BenchUniform(&seed, 0.8f, 1.6f);
+            points[0] = (RTSPZonePoint){cx - w, cy - h};
+            points[1] = (RTSPZonePoint){cx + w, cy - h};
+            points[2] = (RTSPZonePoint){cx + w, cy + h};
+            points[3] = (RTSPZonePoint){cx - w, cy + h};
+            n = 4;
+        } else {
+            n = 6 + BenchRandom(&seed) % 19;
+            for (uint32_t i = 0; i < n; i++) {
+                float angle = 6.2831853f * ((float)i + BenchUniform(&seed, -0.2f, 0.2f)) / (float)n;
+                float r = radius * ((i & 1) ? BenchUniform(&seed, 0.35f, 0.7f) : BenchUniform(&seed, 0.9f, 1.3f));
+                points[i] = (RTSPZonePoint){cx + r * cosf(angle), cy + r * sinf(angle)};
+            }
+        }
+        static const float thresholds[] = {0.0f, 0.0f, 0.1f, 0.25f, 0.6f};
+        scene->zones[z] = (RTSPZonePolygon){points, n, thresholds[z % 5]};
+    }
+}
+
+/// Person- and car-sized boxes, some running off the frame
+static void BenchMakeBoxes(BenchBox *boxes, size_t count, uint32_t seed) {
+    for (size_t i = 0; i < count; i++) {
+        float w = BenchUniform(&seed, 0.01f, 0.25f), h = BenchUniform(&seed, 0.02f, 0.4f);
+        boxes[i] = (BenchBox){BenchUniform(&seed, -0.05f, 1.0f - w * 0.5f), BenchUniform(&seed, -0.05f, 1.0f - h * 0.5f), w, h};
+    }
+}
+
+#pragma mark - Reference
+
+typedef struct {
+    double x, y;
+} BenchPoint;
+
+static int BenchClipSide(const BenchPoint *input, int count, BenchPoint *output, int side, double bound) {
+    int written = 0;
+    for (int i = 0; i < count; i++) {
+        BenchPoint c = input[i], p = input[(i + count - 1) % count];
+        double cv = side < 2 ? c.x : c.y, pv = side < 2 ? p.x : p.y;
+        bool cin = (side & 1) ? cv <= bound : cv >= bound, pin = (side & 1) ? pv <= bound : pv >= bound;
+        if (cin != pin) {
+            double t = (bound - pv) / (cv - pv);
+            output[written++] = (BenchPoint){p.x + t * (c.x - p.x), p.y + t * (c.y - p.y)};
+        }
+        if (cin) {
+            output[written++] = c;
+        }
+    }
+    return written;
+}
+
+/// Fraction of a box inside a polygon, clipping in doubles
+static double BenchReferenceOverlap(const RTSPZonePolygon *zone, const BenchBox *box) {
+    static BenchPoint a[RTSP_ZONE_INDEX_MAX_POINTS * 16], b[RTSP_ZONE_INDEX_MAX_POINTS * 16];
+    int count = (int)zone->pointCount;
+    for (int i = 0; i < count; i++) {
+        a[i] = (BenchPoint){zone->points[i].x, zone->points[i].y};
+    }
+    double bounds[4] = {box->x, (double)box->x + box->width, box->y, (double)box->y + box->height};
+    BenchPoint *input = a, *output = b;
+    for (int side = 0; side < 4 && count > 0; side++) {
+        count = BenchClipSide(input, count, output, side, bounds[side]);
+        BenchPoint *swap = input;
+        input = output;
+        output = swap;
+    }
+    double area = 0;
+    for (int i = 0; i < count; i++) {
+        area += input[i].x * input[(i + 1) % count].y - input[(i + 1) % count].x * input[i].y;
+    }
+    return fabs(area) * 0.5 / ((double)box->width * box->height);
+}
+
+static bool BenchReferenceContains(const RTSPZonePolygon *zone, float x, float y) {
+    bool inside = false;
+    for (uint32_t i = 0; i < zone->pointCount; i++) {
+        RTSPZonePoint a = zone->points[i], b = zone->points[(i + 1) % zone->pointCount];
+        if ((a.y > y) != (b.y > y) && x < a.x + (y - a.y) * ((b.x - a.x) / (b.y - a.y))) {
+            inside = !inside;
+        }
+    }
+    return inside;
+}
+
+/// Masks and fractions against the reference, ignoring boxes within
+/// rounding of a zone's threshold
+static unsigned BenchCheckScene(const BenchScene *scene, RTSPZoneIndexRef index, const BenchBox *boxes, size_t count) {
+    unsigned failures = 0;
+    size_t wrongMasks = 0, matched = 0;
+    double worst = 0;
+    float overlaps[RTSP_ZONE_INDEX_MAX_ZONES];
+    for (size_t i = 0; i < count; i++) {
+        const BenchBox *box = &boxes[i];
+        RTSPZoneMask mask = RTSPZoneIndexMatchBox(index, box->x, box->y, box->width, box->height, overlaps);
+        for (uint32_t z = 0; z < scene->count; z++) {
+            const RTSPZonePolygon *zone = &scene->zones[z];
+            double expected = BenchReferenceOverlap(zone, box);
+            worst = fmax(worst, fabs(expected - overlaps[z]));
+            bool in = zone->minOverlap > 0 ? expected >= zone->minOverlap : expected > 0;
+            double margin = zone->minOverlap > 0 ? fabs(expected - zone->minOverlap) : expected;
+            if (in != (bool)((mask >> z) & 1) && margin > 1e-5) {
+                wrongMasks++;
+            }
+            matched += in;
+        }
+    }
+    char what[160];
+    snprintf(what, sizeof(what), "%u zones: %zu of %zu box-zone matches differ from the reference, worst overlap error %.1e",
+             scene->count, wrongMasks, matched, worst);
+    failures += BenchCheck(wrongMasks == 0 && worst < 1e-4, what);
+
+    size_t wrongPoints = 0;
+    uint32_t seed = 99u;
+    for (int i = 0; i < BENCH_POINTS / 4; i++) {
+        float x = BenchUniform(&seed, -0.1f, 1.1f), y = BenchUniform(&seed, -0.1f, 1.1f);
+        RTSPZoneMask expected = 0;
+        for (uint32_t z = 0; z < scene->count; z++) {
+            expected |= (RTSPZoneMask)BenchReferenceContains(&scene->zones[z], x, y) << z;
+        }
+        wrongPoints += expected != RTSPZoneIndexZonesAtPoint(index, x, y);
+    }
+    snprintf(what, sizeof(what), "%u zones: %zu point lookups differ from the crossing test", scene->count, wrongPoints);
+    failures += BenchCheck(wrongPoints == 0, what);
+    return failures;
+}
+
+#pragma mark - Timing
+
+/// The old path: every zone's rect tested twice per detection
+static size_t BenchRectScans(const BenchScene *scene, const BenchBox *boxes, size_t count) {
+    float rects[RTSP_ZONE_INDEX_MAX_ZONES][4];
+    for (uint32_t z = 0; z < scene->count; z++) {
+        float minX = INFINITY, minY = INFINITY, maxX = -INFINITY, maxY = -INFINITY;
+        for (uint32_t i = 0; i < scene->zones[z].pointCount; i++) {
+            minX = fminf(minX, scene->points[z][i].x);
+            maxX = fmaxf(maxX, scene->points[z][i].x);
+            minY = fminf(minY, scene->points[z][i].y);
+            maxY = fmaxf(maxY, scene->points[z][i].y);
+        }
+        rects[z][0] = minX;
+        rects[z][1] = minY;
+        rects[z][2] = maxX;
+        rects[z][3] = maxY;
+    }
+    size_t hits = 0;
+    for (size_t i = 0; i < count; i++) {
+        const BenchBox *box = &boxes[i];
+        for (int pass = 0; pass < 2; pass++) {
+            for (uint32_t z = 0; z < scene->count; z++) {
+                if (box->x < rects[z][2] && box->x + box->width > rects[z][0] && box->y < rects[z][3] &&
+                    box->y + box->height > rects[z][1]) {
+                    hits++;
+                    break;
+                }
+            }
+        }
+    }
+    return hits;
+}
+
+static size_t BenchClipAll(const BenchScene *scene, const BenchBox *boxes, size_t count) {
+    size_t hits = 0;
+    for (size_t i = 0; i < count; i++) {
+        for (uint32_t z = 0; z < scene->count; z++) {
+            float fraction = RTSPZonePolygonOverlap(&scene->zones[z], boxes[i].x, boxes[i].y, boxes[i].width, boxes[i].height);
+            hits += scene->zones[z].minOverlap > 0 ? fraction >= scene->zones[z].minOverlap : fraction > 0;
+        }
+    }
+    return hits;
+}
+
+static size_t BenchIndexed(RTSPZoneIndexRef index, const BenchBox *boxes, size_t count) {
+    size_t hits = 0;
+    for (size_t i = 0; i < count; i++) {
+        hits += (size_t)__builtin_popcountll(RTSPZoneIndexMatchBox(index, boxes[i].x, boxes[i].y, boxes[i].width,
+                                                                   boxes[i].height, NULL));
+    }
+    return hits;
+}
+
+typedef size_t (*BenchRun)(const BenchScene *scene, RTSPZoneIndexRef index, const BenchBox *boxes, size_t count);
+
+static size_t BenchRunRects(const BenchScene *scene, RTSPZoneIndexRef index, const BenchBox *boxes, size_t count) {
+    (void)index;
+    return BenchRectScans(scene, boxes, count);
+}
+
+static size_t BenchRunClip(const BenchScene *scene, RTSPZoneIndexRef index, const BenchBox *boxes, size_t count) {
+    (void)index;
+    return BenchClipAll(scene, boxes, count);
+}
+
+static size_t BenchRunIndex(const BenchScene *scene, RTSPZoneIndexRef index, const BenchBox *boxes, size_t count) {
+    (void)scene;
+    return BenchIndexed(index, boxes, count);
+}
+
+/// ns per box; `sink` keeps the work from being optimised away
+static double BenchTime(BenchRun run, const BenchScene *scene, RTSPZoneIndexRef index, const BenchBox *boxes,
+                        size_t *sink) {
+    double start = BenchNow();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        *sink += run(scene, index, boxes, BENCH_BOXES);
+    }
+    return (BenchNow() - start) * 1e9 / ((double)BENCH_ROUNDS * BENCH_BOXES);
+}
+
+static double BenchScenario(uint32_t zoneCount, const BenchBox *boxes, unsigned *failures) {
+    BenchScene *scene = malloc(sizeof(*scene));
+    BenchMakeScene(scene, zoneCount, 1000u + zoneCount);
+    double start = BenchNow();
+    RTSPZoneIndexRef index = RTSPZoneIndexCreate(scene->zones, scene->count, 0);
+    double build = (BenchNow() - start) * 1e6;
+    *failures += BenchCheck(index != NULL, "index created");
+    if (!index) {
+        free(scene);
+        return 0;
+    }
+    *failures += BenchCheckScene(scene, index, boxes, BENCH_BOXES);
+
+    size_t sink = 0;
+    double rects = BenchTime(BenchRunRects, scene, index, boxes, &sink);
+    double clip = BenchTime(BenchRunClip, scene, index, boxes, &sink);
+    double indexed = BenchTime(BenchRunIndex, scene, index, boxes, &sink);
+
+    uint32_t seed = 7u;
+    float *points = malloc(2 * BENCH_POINTS * sizeof(float));
+    for (int i = 0; i < 2 * BENCH_POINTS; i++) {
+        points[i] = BenchUniform(&seed, 0.0f, 1.0f);
+    }
+    start = BenchNow();
+    for (int i = 0; i < BENCH_POINTS; i++) {
+        RTSPZoneMask mask = 0;
+        for (uint32_t z = 0; z < scene->count; z++) {
+            mask |= (RTSPZoneMask)BenchReferenceContains(&scene->zones[z], points[2 * i], points[2 * i + 1]) << z;
+        }
+        sink += (size_t)mask;
+    }
+    double bruteForce = (BenchNow() - start) * 1e9 / BENCH_POINTS;
+    start = BenchNow();
+    for (int i = 0; i < BENCH_POINTS; i++) {
+        sink += (size_t)RTSPZoneIndexZonesAtPoint(index, points[2 * i], points[2 * i + 1]);
+    }
+    double lookup = (BenchNow() - start) * 1e9 / BENCH_POINTS;
+
+    printf("  %2u zones (index built in %.0f us)%s\n", zoneCount, build, sink ? "" : " ");
+    printf("    boxes:  rect scans x2 %6.0f ns  clip every zone %7.0f ns  index %6.0f ns  (%.1fx)\n",
+           rects, clip, indexed, clip / indexed);
+    printf("    points: every polygon %6.0f ns  index %6.0f ns  (%.1fx)\n", bruteForce, lookup, bruteForce / lookup);
+    free(points);
+    RTSPZoneIndexRelease(index);
+    free(scene);
+    return clip / indexed;
+}
+
+#pragma mark - Cases
+
+static unsigned BenchCheckCases(void) {
+    unsigned failures = 0;
+
+    // L-shaped zone: the notch is outside
+    const RTSPZonePoint shapeL[] = {{0.1f, 0.1f}, {0.3f, 0.1f}, {0.3f, 0.7f}, {0.9f, 0.7f}, {0.9f, 0.9f}, {0.1f, 0.9f}};
+    RTSPZonePolygon zones[3] = {{shapeL, 6, 0.0f}};
+    const RTSPZonePoint rect[] = {{0.5f, 0.0f}, {1.0f, 0.0f}, {1.0f, 0.5f}, {0.5f, 0.5f}};
+    zones[1] = (RTSPZonePolygon){rect, 4, 0.5f};
+    const RTSPZonePoint beyond[] = {{-0.5f, -0.5f}, {0.05f, -0.5f}, {0.05f, 0.05f}, {-0.5f, 0.05f}};
+    zones[2] = (RTSPZonePolygon){beyond, 4, 0.0f};
+    RTSPZoneIndexRef index = RTSPZoneIndexCreate(zones, 3, 8);
+    float overlaps[3];
+
+    RTSPZoneMask mask = RTSPZoneIndexMatchBox(index, 0.45f, 0.3f, 0.2f, 0.2f, overlaps);
+    failures += BenchCheck(!(mask & 1) && overlaps[0] == 0.0f, "box in the notch of an L is outside it");
+    mask = RTSPZoneIndexMatchBox(index, 0.2f, 0.6f, 0.2f, 0.2f, overlaps);
+    failures += BenchCheck((mask & 1) && fabsf(overlaps[0] - 0.75f) < 1e-5f, "box across the L's inner corner is 3/4 in");
+    mask = RTSPZoneIndexMatchBox(index, 0.375f, 0.25f, 0.25f, 0.125f, overlaps);
+    failures += BenchCheck((mask & 2) && overlaps[1] == 0.5f, "half-in box meets a 50% threshold");
+    mask = RTSPZoneIndexMatchBox(index, 0.39f, 0.3f, 0.2f, 0.1f, overlaps);
+    failures += BenchCheck(!(mask & 2) && fabsf(overlaps[1] - 0.45f) < 1e-5f, "box 45% in misses a 50% threshold");
+    mask = RTSPZoneIndexMatchBox(index, 0.55f, 0.1f, 0.1f, 0.1f, overlaps);
+    failures += BenchCheck((mask & 2) && overlaps[1] == 1.0f, "box wholly inside");
+    mask = RTSPZoneIndexMatchBox(index, -0.2f, -0.2f, 0.3f, 0.3f, overlaps);
+    failures += BenchCheck((mask & 4) && fabsf(overlaps[2] - 0.0625f / 0.09f) < 1e-5f,
+                           "zone beyond the frame matches a box running off it");
+
+    // Half-open edges, like rects: left / top in, right / bottom out
+    mask = RTSPZoneIndexZonesAtPoint(index, 0.5f, 0.25f);
+    failures += BenchCheck((mask & 2) != 0, "point on a zone's left edge is inside");
+    mask = RTSPZoneIndexZonesAtPoint(index, 0.75f, 0.5f);
+    failures += BenchCheck((mask & 2) == 0, "point on a zone's bottom edge is outside");
+    mask = RTSPZoneIndexZonesAtPoint(index, 0.2f, 0.8f);
+    failures += BenchCheck((mask & 1) != 0 && RTSPZoneIndexZonesAtPoint(index, 0.5f, 0.5f) == 0, "points in and out of the L");
+
+    // Zero-area boxes are points
+    mask = RTSPZoneIndexMatchBox(index, 0.2f, 0.8f, 0.0f, 0.0f, overlaps);
+    failures += BenchCheck(mask == 1 && overlaps[0] == 1.0f, "zero-area box inside");
+    RTSPZoneIndexRelease(index);
+
+    // Standalone overlap agrees with the index
+    failures += BenchCheck(fabsf(RTSPZonePolygonOverlap(&zones[0], 0.2f, 0.6f, 0.2f, 0.2f) - 0.75f) < 1e-5f,
+                           "standalone overlap");
+
+    // Invalid input
+    const RTSPZonePoint two[] = {{0, 0}, {1, 1}};
+    RTSPZonePolygon invalid = {two, 2, 0.0f};
+    failures += BenchCheck(RTSPZoneIndexCreate(&invalid, 1, 0) == NULL, "polygon of two points rejected");
+    invalid = (RTSPZonePolygon){rect, 4, 1.5f};
+    failures += BenchCheck(RTSPZoneIndexCreate(&invalid, 1, 0) == NULL, "overlap above 1 rejected");
+    failures += BenchCheck(RTSPZoneIndexCreate(zones, RTSP_ZONE_INDEX_MAX_ZONES + 1, 0) == NULL, "too many zones rejected");
+    index = RTSPZoneIndexCreate(NULL, 0, 0);
+    failures += BenchCheck(index && RTSPZoneIndexMatchBox(index, 0, 0, 1, 1, NULL) == 0, "no zones match nothing");
+    RTSPZoneIndexRelease(index);
+
+    printf("  L-shape, thresholds, edges, off-frame and invalid zone checks: %s\n", failures ? "FAILED" : "ok");
+    return failures;
+}
+
+#pragma mark - Main
+
+int main(void) {
+    printf("zone_index_bench\n");
+    unsigned failures = BenchCheckCases();
+
+    BenchBox *boxes = malloc(BENCH_BOXES * sizeof(*boxes));
+    BenchMakeBoxes(boxes, BENCH_BOXES, 4242u);
+    BenchScenario(4, boxes, &failures);
+    double speedup = BenchScenario(16, boxes, &failures);
+    BenchScenario(64, boxes, &failures);
+
+    char what[128];
+    snprintf(what, sizeof(what), "16 zones: index %.1fx clipping every zone (target >= %.1fx)", speedup, BENCH_TARGET_SPEEDUP);
+    failures += BenchCheck(speedup >= BENCH_TARGET_SPEEDUP, what);
+
+    free(boxes);
+    printf("%s\n", failures ? "FAILED" : "OK");
+    return failures ? 1 : 0;
+}
@@ -77,9 +77,6 @@
 - (void)applicationDidFinishLaunching:(NSNotification *)aNotification {
     NSLog(@"[AppDelegate] Application starting...");
 
-    // Clean up stale HLS temp directories from previous runs (older than 1 hour)
-    [self cleanupStaleHLSTempDirectories];
-
     // Show status window on startup
     RTSPStatusWindow *statusWindow = [RTSPStatusWindow sharedWindow];
     [statusWindow clearLog];
@@ -256,9 +253,8 @@
 - (void)applicationWillTerminate:(NSNotification *)aNotification {
     NSLog(@"[AppDelegate] Application terminating...");
 
-    // Stop all FFmpeg proxies and clean up their HLS temp directories
+    // Stop all RTSPS proxies (their HLS windows live in memory)
     [[RTSPFFmpegProxy sharedProxy] stopAllProxies];
-    [self cleanupAllHLSTempDirectories];
 
     // Cleanup
     [self.wallpaperController stop];
@@ -342,6 +338,19 @@
     apiServer.requireAPIKey = NO; // Can be enabled in preferences
     NSLog(@"[Phase2] ✓ API Server configured (port: %ld)", (long)apiServer.port);
 
+    // Continuous recording is opt-in: it reserves disk for every proxied camera
+    NSUserDefaults *defaults = [NSUserDefaults standardUserDefaults];
+    if ([defaults boolForKey:@"RTSPDVREnabled"]) {
+        RTSPFFmpegProxy *proxy = [RTSPFFmpegProxy sharedProxy];
+        NSString *appSupport = [NSSearchPathForDirectoriesInDomains(NSApplicationSupportDirectory, NSUserDomainMask, YES) firstObject];
+        proxy.dvrDirectory = [[appSupport stringByAppendingPathComponent:@"RTSP Rotator"] stringByAppendingPathComponent:@"DVR"];
+        double hours = [defaults doubleForKey:@"RTSPDVRRetentionHours"];
+        if (hours > 0) {
+            proxy.dvrRetention = hours * 60 * 60;
+        }
+        NSLog(@"[Phase2] ✓ DVR recording to %@ (%.0f hours per camera)", proxy.dvrDirectory, proxy.dvrRetention / 3600.0);
+    }
+
     // Failover Manager
     RTSPFailoverManager *failoverManager = [RTSPFailoverManager sharedManager];
     failoverManager.delegate = self;
@@ -1924,55 +1933,4 @@
     [alert runModal];
 }
 
-#pragma mark - HLS Temp Directory Cleanup
-
-/// Remove ALL /tmp/rtsp_hls_* directories (used on app termination).
-- (void)cleanupAllHLSTempDirectories {
-    NSFileManager *fm = [NSFileManager defaultManager];
-    NSError *error = nil;
-    NSArray *contents = [fm contentsOfDirectoryAtPath:NSTemporaryDirectory() error:&error];
-    if (error) {
-        NSLog(@"[Cleanup] Error listing temp directory: %@", error.localizedDescription);
-        return;
-    }
-
-    for (NSString *item in contents) {
-        if ([item hasPrefix:@"rtsp_hls_"]) {
-            NSString *fullPath = [NSTemporaryDirectory() stringByAppendingPathComponent:item];
-            NSError *removeError = nil;
-            [fm removeItemAtPath:fullPath error:&removeError];
-            if (removeError) {
-                NSLog(@"[Cleanup] Failed to remove %@: %@", fullPath, removeError.localizedDescription);
-            } else {
-                NSLog(@"[Cleanup] Removed HLS temp directory: %@", fullPath);
-            }
-        }
-    }
-}
-
-/// Remove stale /tmp/rtsp_hls_* directories older than 1 hour (used on startup).
-- (void)cleanupStaleHLSTempDirectories {
-    NSFileManager *fm = [NSFileManager defaultManager];
-    NSError *error = nil;
-    NSArray *contents = [fm contentsOfDirectoryAtPath:NSTemporaryDirectory() error:&error];
-    if (error) return;
-
-    NSDate *cutoff = [NSDate dateWithTimeIntervalSinceNow:-3600]; // 1 hour ago
-
-    for (NSString *item in contents) {
-        if ([item hasPrefix:@"rtsp_hls_"]) {
-            NSString *fullPath = [NSTemporaryDirectory() stringByAppendingPathComponent:item];
-            NSDictionary *attrs = [fm attributesOfItemAtPath:fullPath error:nil];
-            NSDate *modDate = attrs[NSFileModificationDate];
-            if (modDate && [modDate compare:cutoff] == NSOrderedAscending) {
-                NSError *removeError = nil;
-                [fm removeItemAtPath:fullPath error:&removeError];
-                if (!removeError) {
-                    NSLog(@"[Cleanup] Removed stale HLS temp directory: %@", fullPath);
-                }
-            }
-        }
-    }
-}
-
 @end
@@ -2,7 +2,21 @@
 //  RTSPAPIServer.h
 //  RTSP Rotator
 //
-//  HTTP REST API server for remote control
+//  HTTP REST API server for remote control. Requests are served by
+//  RTSPHTTPServer (keep-alive, pipelining, bounded worker pool); delegate
+//  queries run on its worker threads and commands are forwarded to the
+//  main queue.
+//
+//  GET /api/events streams feed switches, failover state, detections,
+//  network statistics and recording state as Server-Sent Events, or as
+//  WebSocket text frames when the request is an upgrade. ?events=feed,network
+//  narrows the stream. State events (feed, network, recording) are replayed
+//  to new subscribers, so dashboards no longer need to poll.
+//
+//  GET /api/cameras/<index>/snapshot.jpg and /stream.mjpeg serve a camera
+//  (its index in /api/feeds) from RTSPJPEGFrameCache: each frame is encoded
+//  once however many viewers there are, and a slow MJPEG viewer skips frames
+//  instead of holding others back.
 //
 
 #import <Foundation/Foundation.h>
@@ -42,6 +56,13 @@ NS_ASSUME_NONNULL_BEGIN
 /// Server port (default: 8080)
 @property (nonatomic, assign) NSInteger port;
 
+/// Threads that run endpoint handlers, applied on start (default: 4)
+@property (nonatomic, assign) NSInteger workerCount;
+
+/// Events buffered per /api/events client before it is disconnected as too
+/// slow, applied on start (default: 256)
+@property (nonatomic, assign) NSInteger eventQueueDepth;
+
 /// API key for authentication (optional)
 @property (nonatomic, strong, nullable) NSString *apiKey;
 
@@ -60,6 +81,11 @@ NS_ASSUME_NONNULL_BEGIN
 /// Get server base URL
 - (NSURL *)baseURL;
 
+/// Push an event to /api/events subscribers. `retain` replays the latest
+/// payload of `event` to clients that subscribe later. Any thread; ignored
+/// while the server is stopped.
+- (void)publishEvent:(NSString *)event payload:(NSDictionary *)payload retain:(BOOL)retain;
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -2,22 +2,79 @@
 //  RTSPAPIServer.m
 //  RTSP Rotator
 //
-//  Simple HTTP REST API server using NSURLConnection
+//  HTTP REST API server on the event-driven RTSPHTTPServer engine
 //
 
 #import "RTSPAPIServer.h"
-#import <sys/socket.h>
-#import <netinet/in.h>
-#import <arpa/inet.h>
+#import "RTSPHTTPServer.h"
+#import "RTSPWallpaperController.h"
+#import "RTSPFailoverManager.h"
+#import "RTSPObjectDetector.h"
+#import "RTSPNetworkMonitor.h"
+#import "RTSPJPEGFrameCache.h"
+#import "RTSPDecodeScheduler.h"
+#import "RTSPFFmpegProxy.h"
+#import <ImageIO/ImageIO.h>
+#import <QuartzCore/QuartzCore.h>
+#import <UniformTypeIdentifiers/UniformTypeIdentifiers.h>
+
+typedef NSDictionary * _Nonnull (^RTSPAPIRouteHandler)(NSDictionary<NSString *, NSString *> *parameters);
+
+/// Writes the response itself: streams and images rather than JSON
+typedef void (^RTSPAPIRouteResponder)(const RTSPHTTPRequest *request, NSDictionary<NSString *, NSString *> *parameters,
+                                      NSDictionary<NSString *, NSString *> *query, RTSPHTTPResponse *response);
+
+static const NSTimeInterval kRTSPAPISnapshotTimeout = 2.0;
+static const NSTimeInterval kRTSPAPIStreamAttachGrace = 2.0;
+static const NSUInteger kRTSPAPIMaxTimelineThumbnails = 120;
+
+/// One registered endpoint; the C engine holds an unretained pointer to it
+@interface RTSPAPIRoute : NSObject
+@property (nonatomic, weak) RTSPAPIServer *server;
+@property (nonatomic, copy) NSString *pattern;
+@property (nonatomic, assign) NSInteger status;
+@property (nonatomic, copy, nullable) RTSPAPIRouteHandler handler;
+@property (nonatomic, copy, nullable) RTSPAPIRouteResponder responder;
+@end
+
+@implementation RTSPAPIRoute
+@end
+
+/// A camera streamed as MJPEG; one cache consumer feeds all of its viewers
+@interface RTSPAPIFrameStream : NSObject
+@property (nonatomic, copy) NSString *event;
+@property (nonatomic, assign) CFTimeInterval lastSubscribe;   // Guarded by the frame stream table
+@end
+
+@implementation RTSPAPIFrameStream
+@end
 
 @interface RTSPAPIServer () <NSNetServiceDelegate>
 @property (nonatomic, strong, nullable) NSNetService *netService;
 @property (nonatomic, assign) BOOL isRunning;
-@property (nonatomic, assign) CFSocketRef socket;
-@property (nonatomic, strong) dispatch_queue_t serverQueue;
+@property (nonatomic, strong) NSMutableArray<RTSPAPIRoute *> *routes;
+- (void)respondToRequest:(const RTSPHTTPRequest *)request route:(RTSPAPIRoute *)route response:(RTSPHTTPResponse *)response;
 @end
 
-@implementation RTSPAPIServer
+static void RTSPAPIHandleRequest(void *context, const RTSPHTTPRequest *request, RTSPHTTPResponse *response) {
+    @autoreleasepool {
+        RTSPAPIRoute *route = (__bridge RTSPAPIRoute *)context;
+        RTSPAPIServer *server = route.server;
+        if (!server) {
+            RTSPHTTPResponseSetStatus(response, 503);
+            return;
+        }
+        [server respondToRequest:request route:route response:response];
+    }
+}
+
+@implementation RTSPAPIServer {
+    RTSPHTTPServerRef _httpServer;
+    RTSPHTTPChannelRef _eventChannel;   // Guarded by @synchronized (self) for publishers
+    RTSPHTTPChannelRef _frameChannel;   // Same
+    NSMutableDictionary<NSURL *, RTSPAPIFrameStream *> *_frameStreams;
+    NSUInteger _frameStreamCounter;
+}
 
 + (instancetype)sharedServer {
     static RTSPAPIServer *shared = nil;
@@ -35,7 +92,10 @@
         _port = 8080;
         _requireAPIKey = NO;
         _isRunning = NO;
-        _serverQueue = dispatch_queue_create("com.rtsp.apiserver", DISPATCH_QUEUE_SERIAL);
+        _workerCount = 4;
+        _eventQueueDepth = 256;
+        _routes = [NSMutableArray array];
+        _frameStreams = [NSMutableDictionary dictionary];
     }
     return self;
 }
@@ -51,132 +111,92 @@
         return NO;
     }
 
-    // Create socket
-    CFSocketContext context = {0, (__bridge void *)self, NULL, NULL, NULL};
-    self.socket = CFSocketCreate(kCFAllocatorDefault, PF_INET, SOCK_STREAM, IPPROTO_TCP, kCFSocketAcceptCallBack, &handleConnect, &context);
+    RTSPHTTPServerConfig config;
+    RTSPHTTPServerConfigInit(&config);
+    config.port = (uint16_t)self.port;
+    config.workerCount = (uint32_t)MAX(1, self.workerCount);
+    RTSPHTTPServerRef httpServer = RTSPHTTPServerCreate(&config);
 
-    if (!self.socket) {
-        NSLog(@"[API] Failed to create socket");
+    if (!httpServer) {
+        NSLog(@"[API] Failed to bind to port %ld", (long)self.port);
         return NO;
     }
 
-    // Set socket options
-    int yes = 1;
-    setsockopt(CFSocketGetNative(self.socket), SOL_SOCKET, SO_REUSEADDR, (void *)&yes, sizeof(yes));
-
-    // Bind to port
-    struct sockaddr_in addr;
-    memset(&addr, 0, sizeof(addr));
-    addr.sin_len = sizeof(addr);
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons((uint16_t)self.port);
-    addr.sin_addr.s_addr = htonl(INADDR_ANY);
-
-    NSData *address = [NSData dataWithBytes:&addr length:sizeof(addr)];
-    CFSocketError error = CFSocketSetAddress(self.socket, (__bridge CFDataRef)address);
-
-    if (error != kCFSocketSuccess) {
-        NSLog(@"[API] Failed to bind to port %ld", (long)self.port);
-        CFRelease(self.socket);
-        self.socket = NULL;
+    RTSPHTTPChannelConfig channelConfig;
+    RTSPHTTPChannelConfigInit(&channelConfig);
+    channelConfig.maxQueuedMessages = (uint32_t)MAX(16, self.eventQueueDepth);
+    RTSPHTTPChannelRef eventChannel = RTSPHTTPServerAddChannel(httpServer, &channelConfig);
+
+    // MJPEG viewers only ever want the newest frames
+    RTSPHTTPChannelConfigInit(&channelConfig);
+    channelConfig.format = RTSPHTTPChannelFormatMultipart;
+    channelConfig.maxQueuedMessages = 2;
+    channelConfig.maxQueuedBytes = 8 * 1024 * 1024;
+    channelConfig.skipWhenFull = true;
+    RTSPHTTPChannelRef frameChannel = RTSPHTTPServerAddChannel(httpServer, &channelConfig);
+
+    _httpServer = httpServer;
+    [self registerRoutes];
+    [self registerStreamRoutesWithEventChannel:eventChannel frameChannel:frameChannel];
+
+    if (!eventChannel || !frameChannel || !RTSPHTTPServerStart(httpServer)) {
+        NSLog(@"[API] Failed to start server threads");
+        RTSPHTTPServerRelease(httpServer);
+        _httpServer = NULL;
+        [self.routes removeAllObjects];
         return NO;
     }
 
-    // Add to run loop
-    CFRunLoopSourceRef source = CFSocketCreateRunLoopSource(kCFAllocatorDefault, self.socket, 0);
-    CFRunLoopAddSource(CFRunLoopGetCurrent(), source, kCFRunLoopCommonModes);
-    CFRelease(source);
-
+    @synchronized (self) {
+        _eventChannel = eventChannel;
+        _frameChannel = frameChannel;
+    }
+    [self observeEventSources];
     self.isRunning = YES;
 
-    NSLog(@"[API] Server started on port %ld", (long)self.port);
+    NSLog(@"[API] Server started on port %ld (%ld workers)", (long)self.port, (long)config.workerCount);
     NSLog(@"[API] Base URL: %@", [self baseURL].absoluteString);
 
     return YES;
 }
 
-static void handleConnect(CFSocketRef socket, CFSocketCallBackType type, CFDataRef address, const void *data, void *info) {
-    RTSPAPIServer *server = (__bridge RTSPAPIServer *)info;
-
-    if (type == kCFSocketAcceptCallBack) {
-        CFSocketNativeHandle nativeSocket = *(CFSocketNativeHandle *)data;
+#pragma mark - Routing
 
-        dispatch_async(server.serverQueue, ^{
-            [server handleConnection:nativeSocket];
-        });
-    }
+- (void)addRoute:(NSString *)pattern handler:(RTSPAPIRouteHandler)handler {
+    [self addRoute:pattern status:200 handler:handler];
 }
 
-- (void)handleConnection:(CFSocketNativeHandle)nativeSocket {
-    // Read request
-    char buffer[4096];
-    ssize_t bytesRead = recv(nativeSocket, buffer, sizeof(buffer) - 1, 0);
-
-    if (bytesRead <= 0) {
-        close(nativeSocket);
-        return;
-    }
-
-    buffer[bytesRead] = '\0';
-    NSString *request = [NSString stringWithUTF8String:buffer];
-
-    // Parse HTTP request
-    NSArray *lines = [request componentsSeparatedByString:@"\r\n"];
-    if (lines.count == 0) {
-        close(nativeSocket);
-        return;
-    }
-
-    NSString *requestLine = lines[0];
-    NSArray *parts = [requestLine componentsSeparatedByString:@" "];
-
-    if (parts.count < 3) {
-        [self sendResponse:@"HTTP/1.1 400 Bad Request\r\n\r\n" toSocket:nativeSocket];
-        close(nativeSocket);
-        return;
-    }
+- (void)addRoute:(NSString *)pattern status:(NSInteger)status handler:(RTSPAPIRouteHandler)handler {
+    RTSPAPIRoute *route = [[RTSPAPIRoute alloc] init];
+    route.pattern = pattern;
+    route.status = status;
+    route.handler = handler;
+    [self addRoute:route];
+}
 
-    NSString *method = parts[0];
-    NSString *path = parts[1];
+- (void)addRoute:(NSString *)pattern responder:(RTSPAPIRouteResponder)responder {
+    RTSPAPIRoute *route = [[RTSPAPIRoute alloc] init];
+    route.pattern = pattern;
+    route.status = 200;
+    route.responder = responder;
+    [self addRoute:route];
+}
 
-    // Check API key if required
-    if (self.requireAPIKey && self.apiKey) {
-        BOOL authenticated = NO;
-
-        for (NSString *line in lines) {
-            if ([line hasPrefix:@"Authorization:"]) {
-                NSString *auth = [line substringFromIndex:14];
-                auth = [auth stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
-
-                if ([auth isEqualToString:self.apiKey]) {
-                    authenticated = YES;
-                    break;
-                }
-            }
-        }
+- (void)addRoute:(RTSPAPIRoute *)route {
+    route.server = self;
+    [self.routes addObject:route];
 
-        if (!authenticated) {
-            [self sendResponse:@"HTTP/1.1 401 Unauthorized\r\n\r\n{\"error\":\"Invalid API key\"}" toSocket:nativeSocket];
-            close(nativeSocket);
-            return;
-        }
+    // Every endpoint has always accepted both GET and POST
+    if (!RTSPHTTPServerAddRoute(_httpServer, RTSPHTTPMethodGET | RTSPHTTPMethodPOST, route.pattern.UTF8String,
+                                RTSPAPIHandleRequest, (__bridge void *)route)) {
+        NSLog(@"[API] ERROR: Could not register route %@", route.pattern);
     }
-
-    // Route request
-    NSDictionary *response = [self routeRequest:method path:path];
-
-    // Send response
-    [self sendJSONResponse:response toSocket:nativeSocket];
-    close(nativeSocket);
 }
 
-- (NSDictionary *)routeRequest:(NSString *)method path:(NSString *)path {
-    if (![method isEqualToString:@"GET"] && ![method isEqualToString:@"POST"]) {
-        return @{@"error": @"Method not allowed"};
-    }
+- (void)registerRoutes {
+    __weak typeof(self) weakSelf = self;
 
-    // API endpoints
-    if ([path isEqualToString:@"/"] || [path isEqualToString:@"/api"]) {
+    RTSPAPIRouteHandler index = ^NSDictionary *(NSDictionary *parameters) {
         return @{
             @"name": @"RTSP Rotator API",
             @"version": @"1.0",
@@ -190,38 +210,182 @@ static void handleConnect(CFSocketRef socket, CFSocketCallBackType type, CFDataR
                 @"/api/recording/start",
                 @"/api/recording/stop",
                 @"/api/recording/status",
-                @"/api/interval/<seconds>"
+                @"/api/interval/<seconds>",
+                @"/api/decoders",
+                @"/api/metrics",
+                @"/api/events",
+                @"/api/cameras/<index>/snapshot.jpg",
+                @"/api/cameras/<index>/stream.mjpeg",
+                @"/api/cameras/<index>/dvr",
+                @"/api/cameras/<index>/dvr.m3u8?start=<unix>&end=<unix>",
+                @"/api/cameras/<index>/dvr/thumbnail.jpg?time=<unix>",
+                @"/api/cameras/<index>/dvr/timeline.jpg?start=<unix>&end=<unix>&count=<n>"
             ]
         };
-    } else if ([path isEqualToString:@"/api/feeds"]) {
-        return [self handleGetFeeds];
-    } else if ([path isEqualToString:@"/api/current"]) {
-        return [self handleGetCurrent];
-    } else if ([path hasPrefix:@"/api/switch/"]) {
-        NSString *indexStr = [path substringFromIndex:12];
-        NSInteger index = [indexStr integerValue];
-        return [self handleSwitchToFeed:index];
-    } else if ([path isEqualToString:@"/api/next"]) {
-        return [self handleNextFeed];
-    } else if ([path isEqualToString:@"/api/previous"]) {
-        return [self handlePreviousFeed];
-    } else if ([path isEqualToString:@"/api/snapshot"]) {
-        return [self handleSnapshot];
-    } else if ([path isEqualToString:@"/api/recording/start"]) {
-        return [self handleStartRecording];
-    } else if ([path isEqualToString:@"/api/recording/stop"]) {
-        return [self handleStopRecording];
-    } else if ([path isEqualToString:@"/api/recording/status"]) {
-        return [self handleRecordingStatus];
-    } else if ([path hasPrefix:@"/api/interval/"]) {
-        NSString *intervalStr = [path substringFromIndex:14];
-        NSTimeInterval interval = [intervalStr doubleValue];
-        return [self handleSetInterval:interval];
-    }
-
-    return @{@"error": @"Endpoint not found"};
+    };
+    [self addRoute:@"/" handler:index];
+    [self addRoute:@"/api" handler:index];
+
+    [self addRoute:@"/api/feeds" handler:^NSDictionary *(NSDictionary *parameters) {
+        return [weakSelf handleGetFeeds];
+    }];
+    [self addRoute:@"/api/current" handler:^NSDictionary *(NSDictionary *parameters) {
+        return [weakSelf handleGetCurrent];
+    }];
+    [self addRoute:@"/api/switch/:index" handler:^NSDictionary *(NSDictionary *parameters) {
+        return [weakSelf handleSwitchToFeed:[parameters[@"index"] integerValue]];
+    }];
+    [self addRoute:@"/api/next" handler:^NSDictionary *(NSDictionary *parameters) {
+        return [weakSelf handleNextFeed];
+    }];
+    [self addRoute:@"/api/previous" handler:^NSDictionary *(NSDictionary *parameters) {
+        return [weakSelf handlePreviousFeed];
+    }];
+    [self addRoute:@"/api/snapshot" handler:^NSDictionary *(NSDictionary *parameters) {
+        return [weakSelf handleSnapshot];
+    }];
+    [self addRoute:@"/api/recording/start" handler:^NSDictionary *(NSDictionary *parameters) {
+        return [weakSelf handleStartRecording];
+    }];
+    [self addRoute:@"/api/recording/stop" handler:^NSDictionary *(NSDictionary *parameters) {
+        return [weakSelf handleStopRecording];
+    }];
+    [self addRoute:@"/api/recording/status" handler:^NSDictionary *(NSDictionary *parameters) {
+        return [weakSelf handleRecordingStatus];
+    }];
+    [self addRoute:@"/api/interval/:seconds" handler:^NSDictionary *(NSDictionary *parameters) {
+        return [weakSelf handleSetInterval:[parameters[@"seconds"] doubleValue]];
+    }];
+    [self addRoute:@"/api/decoders" handler:^NSDictionary *(NSDictionary *parameters) {
+        return [weakSelf handleDecoderStatistics];
+    }];
+
+    [self addRoute:@"/api/metrics" responder:^(const RTSPHTTPRequest *request, NSDictionary *parameters,
+                                               NSDictionary *query, RTSPHTTPResponse *response) {
+        [weakSelf respondWithMetrics:response];
+    }];
+
+    // Recorded video, played back as HLS by time
+    [self addRoute:@"/api/cameras/:index/dvr" responder:^(const RTSPHTTPRequest *request, NSDictionary *parameters,
+                                                          NSDictionary *query, RTSPHTTPResponse *response) {
+        [weakSelf respondWithDVRStatusOfCamera:parameters[@"index"] response:response];
+    }];
+    [self addRoute:@"/api/cameras/:index/dvr.m3u8" responder:^(const RTSPHTTPRequest *request, NSDictionary *parameters,
+                                                               NSDictionary *query, RTSPHTTPResponse *response) {
+        [weakSelf respondWithDVRPlaylistOfCamera:parameters[@"index"] query:query response:response];
+    }];
+    [self addRoute:@"/api/cameras/:index/dvr/segments/:sequence" responder:^(const RTSPHTTPRequest *request, NSDictionary *parameters,
+                                                                             NSDictionary *query, RTSPHTTPResponse *response) {
+        [weakSelf respondWithDVRSegment:parameters[@"sequence"] ofCamera:parameters[@"index"] initSegment:NO response:response];
+    }];
+    [self addRoute:@"/api/cameras/:index/dvr/init/:sequence" responder:^(const RTSPHTTPRequest *request, NSDictionary *parameters,
+                                                                         NSDictionary *query, RTSPHTTPResponse *response) {
+        [weakSelf respondWithDVRSegment:parameters[@"sequence"] ofCamera:parameters[@"index"] initSegment:YES response:response];
+    }];
+    [self addRoute:@"/api/cameras/:index/dvr/thumbnail.jpg" responder:^(const RTSPHTTPRequest *request, NSDictionary *parameters,
+                                                                        NSDictionary *query, RTSPHTTPResponse *response) {
+        [weakSelf respondWithDVRThumbnailOfCamera:parameters[@"index"] query:query response:response];
+    }];
+    [self addRoute:@"/api/cameras/:index/dvr/timeline.jpg" responder:^(const RTSPHTTPRequest *request, NSDictionary *parameters,
+                                                                       NSDictionary *query, RTSPHTTPResponse *response) {
+        [weakSelf respondWithDVRTimelineOfCamera:parameters[@"index"] query:query response:response];
+    }];
+
+    // Anything else under GET/POST
+    [self addRoute:@"/*" status:404 handler:^NSDictionary *(NSDictionary *parameters) {
+        return @{@"error": @"Endpoint not found"};
+    }];
 }
 
+/// Channels live as long as the engine, so responders capture them directly
+- (void)registerStreamRoutesWithEventChannel:(RTSPHTTPChannelRef)eventChannel frameChannel:(RTSPHTTPChannelRef)frameChannel {
+    __weak typeof(self) weakSelf = self;
+
+    [self addRoute:@"/api/events" responder:^(const RTSPHTTPRequest *request, NSDictionary *parameters,
+                                              NSDictionary *query, RTSPHTTPResponse *response) {
+        NSString *events = query[@"events"];
+        if (!eventChannel || !RTSPHTTPResponseSubscribe(response, request, eventChannel, events.UTF8String)) {
+            [weakSelf writeJSON:@{@"error": @"Expected GET with an EventSource or WebSocket handshake"}
+                         status:400
+                     toResponse:response];
+        }
+    }];
+    [self addRoute:@"/api/cameras/:index/snapshot.jpg" responder:^(const RTSPHTTPRequest *request, NSDictionary *parameters,
+                                                                    NSDictionary *query, RTSPHTTPResponse *response) {
+        [weakSelf respondWithSnapshotOfCamera:parameters[@"index"] response:response];
+    }];
+    [self addRoute:@"/api/cameras/:index/stream.mjpeg" responder:^(const RTSPHTTPRequest *request, NSDictionary *parameters,
+                                                                    NSDictionary *query, RTSPHTTPResponse *response) {
+        [weakSelf subscribeRequest:request toCamera:parameters[@"index"] channel:frameChannel response:response];
+    }];
+}
+
+/// Runs on an engine worker thread
+- (void)respondToRequest:(const RTSPHTTPRequest *)request route:(RTSPAPIRoute *)route response:(RTSPHTTPResponse *)response {
+    NSDictionary<NSString *, NSString *> *query = [self queryItemsForRequest:request];
+
+    // Check API key if required
+    NSString *apiKey = self.apiKey;
+    if (self.requireAPIKey && apiKey) {
+        char authorization[512];
+        BOOL authenticated = RTSPHTTPRequestHeader(request, "Authorization", authorization, sizeof(authorization)) &&
+                             [@(authorization) isEqualToString:apiKey];
+        // Browsers' EventSource and <img> cannot set headers, so streams and
+        // images also take ?key=
+        if (!authenticated && route.responder) {
+            authenticated = [query[@"key"] isEqualToString:apiKey];
+        }
+        if (!authenticated) {
+            [self writeJSON:@{@"error": @"Invalid API key"} status:401 toResponse:response];
+            return;
+        }
+    }
+
+    NSMutableDictionary<NSString *, NSString *> *parameters = [NSMutableDictionary dictionary];
+    for (uint32_t i = 0; i < request->paramCount; i++) {
+        const RTSPHTTPRouteParam *param = &request->params[i];
+        NSString *value = [[NSString alloc] initWithBytes:param->value length:param->length encoding:NSUTF8StringEncoding];
+        if (value) {
+            parameters[@(param->name)] = value;
+        }
+    }
+
+    if (route.responder) {
+        route.responder(request, parameters, query, response);
+        return;
+    }
+
+    NSDictionary *json = route.handler(parameters);
+    NSInteger status = route.status;
+    if (status == 200 && json[@"error"]) {
+        status = 501; // Delegate does not implement the endpoint
+    }
+    [self writeJSON:json status:status toResponse:response];
+}
+
+- (NSDictionary<NSString *, NSString *> *)queryItemsForRequest:(const RTSPHTTPRequest *)request {
+    if (!request->query) {
+        return @{};
+    }
+    NSURLComponents *components = [[NSURLComponents alloc] init];
+    components.percentEncodedQuery = @(request->query);
+    NSMutableDictionary<NSString *, NSString *> *items = [NSMutableDictionary dictionary];
+    for (NSURLQueryItem *item in components.queryItems) {
+        if (item.value && !items[item.name]) {
+            items[item.name] = item.value;
+        }
+    }
+    return items;
+}
+
+/// Commands drive the player and UI, so they run on the main queue. The
+/// response does not wait for them.
+- (void)performOnMain:(dispatch_block_t)block {
+    dispatch_async(dispatch_get_main_queue(), block);
+}
+
+#pragma mark - Endpoints
+
 - (NSDictionary *)handleGetFeeds {
     if ([self.delegate respondsToSelector:@selector(apiServerRequestFeedList:)]) {
         NSArray *feeds = [self.delegate apiServerRequestFeedList:self];
@@ -240,7 +404,9 @@ static void handleConnect(CFSocketRef socket, CFSocketCallBackType type, CFDataR
 
 - (NSDictionary *)handleSwitchToFeed:(NSInteger)index {
     if ([self.delegate respondsToSelector:@selector(apiServer:switchToFeedAtIndex:)]) {
-        [self.delegate apiServer:self switchToFeedAtIndex:index];
+        [self performOnMain:^{
+            [self.delegate apiServer:self switchToFeedAtIndex:index];
+        }];
         return @{@"success": @YES, @"message": @"Switched to feed", @"index": @(index)};
     }
     return @{@"error": @"Not implemented"};
@@ -248,7 +414,9 @@ static void handleConnect(CFSocketRef socket, CFSocketCallBackType type, CFDataR
 
 - (NSDictionary *)handleNextFeed {
     if ([self.delegate respondsToSelector:@selector(apiServerSwitchToNextFeed:)]) {
-        [self.delegate apiServerSwitchToNextFeed:self];
+        [self performOnMain:^{
+            [self.delegate apiServerSwitchToNextFeed:self];
+        }];
         return @{@"success": @YES, @"message": @"Switched to next feed"};
     }
     return @{@"error": @"Not implemented"};
@@ -256,7 +424,9 @@ static void handleConnect(CFSocketRef socket, CFSocketCallBackType type, CFDataR
 
 - (NSDictionary *)handlePreviousFeed {
     if ([self.delegate respondsToSelector:@selector(apiServerSwitchToPreviousFeed:)]) {
-        [self.delegate apiServerSwitchToPreviousFeed:self];
+        [self performOnMain:^{
+            [self.delegate apiServerSwitchToPreviousFeed:self];
+        }];
         return @{@"success": @YES, @"message": @"Switched to previous feed"};
     }
     return @{@"error": @"Not implemented"};
@@ -264,7 +434,9 @@ static void handleConnect(CFSocketRef socket, CFSocketCallBackType type, CFDataR
 
 - (NSDictionary *)handleSnapshot {
     if ([self.delegate respondsToSelector:@selector(apiServerTakeSnapshot:)]) {
-        [self.delegate apiServerTakeSnapshot:self];
+        [self performOnMain:^{
+            [self.delegate apiServerTakeSnapshot:self];
+        }];
         return @{@"success": @YES, @"message": @"Snapshot taken"};
     }
     return @{@"error": @"Not implemented"};
@@ -272,7 +444,10 @@ static void handleConnect(CFSocketRef socket, CFSocketCallBackType type, CFDataR
 
 - (NSDictionary *)handleStartRecording {
     if ([self.delegate respondsToSelector:@selector(apiServerStartRecording:)]) {
-        [self.delegate apiServerStartRecording:self];
+        [self performOnMain:^{
+            [self.delegate apiServerStartRecording:self];
+            [self publishRecordingState];
+        }];
         return @{@"success": @YES, @"message": @"Recording started"};
     }
     return @{@"error": @"Not implemented"};
@@ -280,7 +455,10 @@ static void handleConnect(CFSocketRef socket, CFSocketCallBackType type, CFDataR
 
 - (NSDictionary *)handleStopRecording {
     if ([self.delegate respondsToSelector:@selector(apiServerStopRecording:)]) {
-        [self.delegate apiServerStopRecording:self];
+        [self performOnMain:^{
+            [self.delegate apiServerStopRecording:self];
+            [self publishRecordingState];
+        }];
         return @{@"success": @YES, @"message": @"Recording stopped"};
     }
     return @{@"error": @"Not implemented"};
@@ -296,30 +474,373 @@ static void handleConnect(CFSocketRef socket, CFSocketCallBackType type, CFDataR
 
 - (NSDictionary *)handleSetInterval:(NSTimeInterval)interval {
     if ([self.delegate respondsToSelector:@selector(apiServer:setRotationInterval:)]) {
-        [self.delegate apiServer:self setRotationInterval:interval];
+        [self performOnMain:^{
+            [self.delegate apiServer:self setRotationInterval:interval];
+        }];
         return @{@"success": @YES, @"message": @"Interval updated", @"interval": @(interval)};
     }
     return @{@"error": @"Not implemented"};
 }
 
-- (void)sendJSONResponse:(NSDictionary *)json toSocket:(CFSocketNativeHandle)socket {
+- (NSDictionary *)handleDecoderStatistics {
+    return @{@"success": @YES, @"decoders": [[RTSPDecodeScheduler sharedScheduler] statistics]};
+}
+
+/// Prometheus scrape target: detection pipeline latency and counters
+- (void)respondWithMetrics:(RTSPHTTPResponse *)response {
+    NSData *body = [[[RTSPMLXProcessor sharedProcessor] prometheusMetrics] dataUsingEncoding:NSUTF8StringEncoding];
+    RTSPHTTPResponseSetContentType(response, "text/plain; version=0.0.4; charset=utf-8");
+    RTSPHTTPResponseAddHeader(response, "Cache-Control", "no-store");
+    RTSPHTTPResponseAppendBody(response, body.bytes, body.length);
+}
+
+#pragma mark - Event Stream
+
+
+- (void)publishEvent:(NSString *)event payload:(NSDictionary *)payload retain:(BOOL)retain {
     NSError *error = nil;
-    NSData *jsonData = [NSJSONSerialization dataWithJSONObject:json options:NSJSONWritingPrettyPrinted error:&error];
+    NSData *data = [NSJSONSerialization dataWithJSONObject:payload options:0 error:&error];
+    if (!data) {
+        NSLog(@"[API] Dropping %@ event: %@", event, error.localizedDescription);
+        return;
+    }
+
+    // The channel is released by -stop under the same lock
+    @synchronized (self) {
+        if (_eventChannel) {
+            RTSPHTTPChannelPublish(_eventChannel, event.UTF8String, data.bytes, data.length, retain);
+        }
+    }
+}
+
+- (void)observeEventSources {
+    NSNotificationCenter *center = [NSNotificationCenter defaultCenter];
+    [center addObserver:self selector:@selector(feedDidSwitch:)
+                   name:RTSPWallpaperControllerDidSwitchFeedNotification object:nil];
+    [center addObserver:self selector:@selector(feedStatusDidChange:)
+                   name:RTSPFailoverManagerFeedStatusDidChangeNotification object:nil];
+    [center addObserver:self selector:@selector(detectorDidDetectEvent:)
+                   name:RTSPObjectDetectorDidDetectEventNotification object:nil];
+    [center addObserver:self selector:@selector(networkStatsDidUpdate:)
+                   name:RTSPNetworkMonitorDidUpdateStatsNotification object:nil];
+}
+
+- (void)feedDidSwitch:(NSNotification *)notification {
+    NSDictionary *userInfo = notification.userInfo;
+    [self publishEvent:@"feed"
+               payload:@{@"index": userInfo[@"index"] ?: @0, @"count": userInfo[@"count"] ?: @0}
+                retain:YES];
+}
 
+- (void)feedStatusDidChange:(NSNotification *)notification {
+    RTSPFeedConfig *feed = notification.userInfo[@"feed"];
+    NSError *error = notification.userInfo[@"error"];
+    if (!feed) {
+        return;
+    }
+
+    // Names only: feed URLs usually carry camera credentials
+    NSString *status;
+    switch (feed.status) {
+        case RTSPFeedStatusHealthy: status = @"healthy"; break;
+        case RTSPFeedStatusFailed: status = @"failed"; break;
+        case RTSPFeedStatusFailedOver: status = @"failedOver"; break;
+        default: status = @"unknown"; break;
+    }
+    NSMutableDictionary *payload = [@{@"feed": feed.name ?: @"", @"status": status} mutableCopy];
     if (error) {
-        [self sendResponse:@"HTTP/1.1 500 Internal Server Error\r\n\r\n{\"error\":\"JSON serialization failed\"}" toSocket:socket];
+        payload[@"error"] = error.localizedDescription;
+    }
+    [self publishEvent:@"failover" payload:payload retain:NO];
+}
+
+- (void)detectorDidDetectEvent:(NSNotification *)notification {
+    RTSPDetectionEvent *event = notification.userInfo[@"event"];
+    RTSPDetection *detection = event.detection;
+    if (!detection) {
+        return;
+    }
+
+    CGRect box = detection.boundingBox;
+    NSMutableDictionary *payload = [@{
+        @"camera": event.cameraID ?: @"",
+        @"cameraName": event.cameraName ?: @"",
+        @"label": detection.label ?: @"",
+        @"confidence": @(detection.confidence),
+        @"box": @{@"x": @(box.origin.x), @"y": @(box.origin.y),
+                  @"width": @(box.size.width), @"height": @(box.size.height)},
+        @"alert": @(event.alertTriggered),
+        @"timestamp": @(event.timestamp.timeIntervalSince1970)
+    } mutableCopy];
+    if (event.zoneName) {
+        payload[@"zone"] = event.zoneName;
+        payload[@"zones"] = event.zoneNames;
+    }
+    // Play from here with dvr.m3u8?start=<time>; the thumbnail is the same keyframe's
+    if (event.recording) {
+        payload[@"recording"] = @{@"segment": @(event.recording.segment),
+                                  @"offset": @(event.recording.offset),
+                                  @"time": @(event.recording.timestamp / 1e6)};
+    }
+    [self publishEvent:@"detection" payload:payload retain:NO];
+}
+
+- (void)networkStatsDidUpdate:(NSNotification *)notification {
+    RTSPNetworkStats *stats = notification.userInfo[@"stats"];
+    if (!stats) {
+        return;
+    }
+    [self publishEvent:@"network" payload:@{
+        @"bandwidthMbps": @(stats.bandwidthMbps),
+        @"latencyMs": @(stats.latencyMs),
+        @"packetLossPercent": @(stats.packetLossPercent),
+        @"droppedFrames": @(stats.droppedFrames),
+        @"totalFrames": @(stats.totalFrames),
+        @"quality": @(stats.connectionQuality)
+    } retain:YES];
+}
+
+/// Runs on the main queue after a recording command
+- (void)publishRecordingState {
+    if ([self.delegate respondsToSelector:@selector(apiServerIsRecording:)]) {
+        [self publishEvent:@"recording" payload:@{@"recording": @([self.delegate apiServerIsRecording:self])} retain:YES];
+    }
+}
+
+#pragma mark - Cameras
+
+/// Worker thread. Cameras are addressed by their index in /api/feeds.
+- (nullable NSURL *)feedURLForCamera:(NSString *)index {
+    if (![self.delegate respondsToSelector:@selector(apiServerRequestFeedList:)]) {
+        return nil;
+    }
+    NSArray<NSString *> *feeds = [self.delegate apiServerRequestFeedList:self];
+    NSInteger position = index.integerValue;
+    if (index.length == 0 || ![index isEqualToString:@(position).stringValue] || position < 0 || position >= (NSInteger)feeds.count) {
+        return nil;
+    }
+    return [NSURL URLWithString:feeds[position]];
+}
+
+- (nullable RTSPJPEGFrameCache *)frameCacheForCamera:(NSString *)index {
+    NSURL *url = [self feedURLForCamera:index];
+    return url ? [RTSPJPEGFrameCache cacheForURL:url] : nil;
+}
+
+- (void)respondWithSnapshotOfCamera:(NSString *)index response:(RTSPHTTPResponse *)response {
+    RTSPJPEGFrameCache *cache = [self frameCacheForCamera:index];
+    if (!cache) {
+        [self writeJSON:@{@"error": @"Camera not found"} status:404 toResponse:response];
+        return;
+    }
+
+    // The tap encodes once per frame interval; any frame from the last two
+    // is as fresh as a new encode would be
+    NSTimeInterval maxAge = 2.0 / MAX(1.0, cache.framesPerSecond);
+    RTSPEncodedFrame *frame = cache.isAvailable ? [cache frameWithMaximumAge:maxAge timeout:kRTSPAPISnapshotTimeout] : nil;
+    if (!frame) {
+        [self writeJSON:@{@"error": @"Camera is not playing"} status:503 toResponse:response];
+        return;
+    }
+    RTSPHTTPResponseSetContentType(response, "image/jpeg");
+    RTSPHTTPResponseAddHeader(response, "Cache-Control", "no-store");
+    RTSPHTTPResponseAppendBody(response, frame.data.bytes, frame.data.length);
+}
+
+- (void)subscribeRequest:(const RTSPHTTPRequest *)request
+                toCamera:(NSString *)index
+                 channel:(RTSPHTTPChannelRef)channel
+                response:(RTSPHTTPResponse *)response {
+    RTSPJPEGFrameCache *cache = [self frameCacheForCamera:index];
+    if (!cache) {
+        [self writeJSON:@{@"error": @"Camera not found"} status:404 toResponse:response];
+        return;
+    }
+    NSString *event = [self frameStreamEventForCache:cache];
+    if (!RTSPHTTPResponseSubscribe(response, request, channel, event.UTF8String)) {
+        [self writeJSON:@{@"error": @"Expected GET"} status:400 toResponse:response];
+    }
+}
+
+/// Each frame is published once and the engine shares it across every
+/// viewer's queue
+- (NSString *)frameStreamEventForCache:(RTSPJPEGFrameCache *)cache {
+    NSURL *url = cache.url;
+    RTSPAPIFrameStream *stream;
+    @synchronized (_frameStreams) {
+        stream = _frameStreams[url];
+        if (stream) {
+            stream.lastSubscribe = CACurrentMediaTime();
+            return stream.event;
+        }
+        stream = [[RTSPAPIFrameStream alloc] init];
+        stream.event = [NSString stringWithFormat:@"camera%lu", (unsigned long)++_frameStreamCounter];
+        stream.lastSubscribe = CACurrentMediaTime();
+        _frameStreams[url] = stream;
+    }
+
+    __weak typeof(self) weakSelf = self;
+    [cache addConsumer:^BOOL(RTSPEncodedFrame *frame) {
+        return [weakSelf publishFrame:frame toStream:stream forURL:url];
+    }];
+    return stream.event;
+}
+
+/// Cache queue. Returns NO, retiring the stream, once it has had no viewers
+/// for a while or the server stopped.
+- (BOOL)publishFrame:(nullable RTSPEncodedFrame *)frame toStream:(RTSPAPIFrameStream *)stream forURL:(NSURL *)url {
+    @synchronized (_frameStreams) {
+        BOOL watched = NO;
+        @synchronized (self) {
+            const char *event = stream.event.UTF8String;
+            watched = _frameChannel && RTSPHTTPChannelSubscriberCount(_frameChannel, event) > 0;
+            if (watched && frame) {
+                // Not retained: a late viewer waits one frame interval rather than seeing a stale picture
+                RTSPHTTPChannelPublishPart(_frameChannel, event, "image/jpeg", frame.data.bytes, frame.data.length, false);
+            }
+        }
+        // A viewer only attaches after its handler returns
+        if (watched || CACurrentMediaTime() - stream.lastSubscribe < kRTSPAPIStreamAttachGrace) {
+            return YES;
+        }
+        [_frameStreams removeObjectForKey:url];
+        return NO;
+    }
+}
+
+#pragma mark - DVR
+
+- (void)respondWithDVRStatusOfCamera:(NSString *)index response:(RTSPHTTPResponse *)response {
+    NSURL *url = [self feedURLForCamera:index];
+    NSDictionary *status = url ? [[RTSPFFmpegProxy sharedProxy] dvrStatusForURL:url] : nil;
+    if (!status) {
+        [self writeJSON:@{@"error": url ? @"Camera is not recorded" : @"Camera not found"} status:404 toResponse:response];
+        return;
+    }
+    NSMutableDictionary *json = [status mutableCopy];
+    json[@"success"] = @YES;
+    json[@"playlist"] = [NSString stringWithFormat:@"/api/cameras/%@/dvr.m3u8", index];
+    [self writeJSON:json status:200 toResponse:response];
+}
+
+/// ?start= and ?end= are seconds since 1970; either may be left out. The
+/// playlist's URIs are relative to it and carry ?key= along.
+- (void)respondWithDVRPlaylistOfCamera:(NSString *)index query:(NSDictionary *)query response:(RTSPHTTPResponse *)response {
+    NSURL *url = [self feedURLForCamera:index];
+    if (!url) {
+        [self writeJSON:@{@"error": @"Camera not found"} status:404 toResponse:response];
+        return;
+    }
+    NSDate *start = query[@"start"] ? [NSDate dateWithTimeIntervalSince1970:[query[@"start"] doubleValue]] : nil;
+    NSDate *end = query[@"end"] ? [NSDate dateWithTimeIntervalSince1970:[query[@"end"] doubleValue]] : nil;
+    NSString *suffix = nil;
+    if (query[@"key"]) {
+        NSString *key = [query[@"key"] stringByAddingPercentEncodingWithAllowedCharacters:[NSCharacterSet URLQueryAllowedCharacterSet]];
+        suffix = [@"?key=" stringByAppendingString:key];
+    }
+    NSData *playlist = [[RTSPFFmpegProxy sharedProxy] dvrPlaylistForURL:url from:start to:end URIPrefix:@"dvr/" URISuffix:suffix];
+    if (!playlist) {
+        [self writeJSON:@{@"error": @"No recorded video in range"} status:404 toResponse:response];
+        return;
+    }
+    RTSPHTTPResponseSetContentType(response, "application/vnd.apple.mpegurl");
+    RTSPHTTPResponseAddHeader(response, "Cache-Control", "no-store");
+    RTSPHTTPResponseAppendBody(response, playlist.bytes, playlist.length);
+}
+
+- (void)respondWithDVRSegment:(NSString *)sequence
+                     ofCamera:(NSString *)index
+                  initSegment:(BOOL)initSegment
+                     response:(RTSPHTTPResponse *)response {
+    NSURL *url = [self feedURLForCamera:index];
+    unsigned long long number = strtoull(sequence.UTF8String, NULL, 10);
+    NSData *data = url && number > 0 ? [[RTSPFFmpegProxy sharedProxy] dvrSegmentForURL:url sequence:number initSegment:initSegment] : nil;
+    if (!data) {
+        // Overwritten by the ring since the playlist was fetched
+        [self writeJSON:@{@"error": @"Segment not found"} status:404 toResponse:response];
+        return;
+    }
+    RTSPHTTPResponseSetContentType(response, "video/mp4");
+    // The newest segment is still growing
+    RTSPHTTPResponseAddHeader(response, "Cache-Control", "no-cache");
+    RTSPHTTPResponseAppendBody(response, data.bytes, data.length);
+}
+
+/// ?time= is seconds since 1970; the thumbnail is of the keyframe at or before it
+- (void)respondWithDVRThumbnailOfCamera:(NSString *)index query:(NSDictionary *)query response:(RTSPHTTPResponse *)response {
+    NSURL *url = [self feedURLForCamera:index];
+    if (!url) {
+        [self writeJSON:@{@"error": @"Camera not found"} status:404 toResponse:response];
         return;
     }
+    NSDate *time = query[@"time"] ? [NSDate dateWithTimeIntervalSince1970:[query[@"time"] doubleValue]] : [NSDate date];
+    RTSPFFmpegProxy *proxy = [RTSPFFmpegProxy sharedProxy];
+    RTSPDVRPosition *position = [proxy dvrPositionForURL:url time:time];
+    CGImageRef image = position ? [proxy copyDVRThumbnailForURL:url position:position] : NULL;
+    [self writeJPEGImage:image notFound:@"No recorded video at that time" toResponse:response];
+    CGImageRelease(image);
+}
 
-    NSString *jsonString = [[NSString alloc] initWithData:jsonData encoding:NSUTF8StringEncoding];
-    NSString *response = [NSString stringWithFormat:@"HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: %lu\r\n\r\n%@", (unsigned long)[jsonData length], jsonString];
+/// ?start= and ?end= are seconds since 1970 (default: the last hour);
+/// ?count= thumbnails (default 12) are laid side by side
+- (void)respondWithDVRTimelineOfCamera:(NSString *)index query:(NSDictionary *)query response:(RTSPHTTPResponse *)response {
+    NSURL *url = [self feedURLForCamera:index];
+    if (!url) {
+        [self writeJSON:@{@"error": @"Camera not found"} status:404 toResponse:response];
+        return;
+    }
+    NSDate *end = query[@"end"] ? [NSDate dateWithTimeIntervalSince1970:[query[@"end"] doubleValue]] : [NSDate date];
+    NSDate *start = query[@"start"] ? [NSDate dateWithTimeIntervalSince1970:[query[@"start"] doubleValue]]
+                                    : [end dateByAddingTimeInterval:-3600];
+    NSInteger count = query[@"count"] ? [query[@"count"] integerValue] : 12;
+    if (count < 1 || count > (NSInteger)kRTSPAPIMaxTimelineThumbnails || [end compare:start] != NSOrderedDescending) {
+        [self writeJSON:@{@"error": [NSString stringWithFormat:@"Expected start < end and 1-%lu thumbnails",
+                                     (unsigned long)kRTSPAPIMaxTimelineThumbnails]}
+                 status:400
+             toResponse:response];
+        return;
+    }
+    CGImageRef strip = [[RTSPFFmpegProxy sharedProxy] copyDVRTimelineForURL:url from:start to:end count:(NSUInteger)count];
+    [self writeJPEGImage:strip notFound:@"No recorded video in range" toResponse:response];
+    CGImageRelease(strip);
+}
 
-    [self sendResponse:response toSocket:socket];
+- (void)writeJPEGImage:(nullable CGImageRef)image notFound:(NSString *)message toResponse:(RTSPHTTPResponse *)response {
+    NSMutableData *data = [NSMutableData data];
+    CGImageDestinationRef destination = image ? CGImageDestinationCreateWithData((__bridge CFMutableDataRef)data,
+                                                                                 (__bridge CFStringRef)UTTypeJPEG.identifier, 1, NULL)
+                                              : NULL;
+    BOOL encoded = NO;
+    if (destination) {
+        CGImageDestinationAddImage(destination, image, (__bridge CFDictionaryRef)@{(id)kCGImageDestinationLossyCompressionQuality: @0.7});
+        encoded = CGImageDestinationFinalize(destination);
+        CFRelease(destination);
+    }
+    if (!encoded) {
+        [self writeJSON:@{@"error": message} status:404 toResponse:response];
+        return;
+    }
+    RTSPHTTPResponseSetContentType(response, "image/jpeg");
+    RTSPHTTPResponseAddHeader(response, "Cache-Control", "no-cache");
+    RTSPHTTPResponseAppendBody(response, data.bytes, data.length);
 }
 
-- (void)sendResponse:(NSString *)response toSocket:(CFSocketNativeHandle)socket {
-    const char *bytes = [response UTF8String];
-    send(socket, bytes, strlen(bytes), 0);
+#pragma mark - Responses
+
+- (void)writeJSON:(NSDictionary *)json status:(NSInteger)status toResponse:(RTSPHTTPResponse *)response {
+    NSError *error = nil;
+    NSData *jsonData = [NSJSONSerialization dataWithJSONObject:json options:NSJSONWritingPrettyPrinted error:&error];
+
+    RTSPHTTPResponseSetContentType(response, "application/json");
+    if (error) {
+        static const char failure[] = "{\"error\":\"JSON serialization failed\"}";
+        RTSPHTTPResponseSetStatus(response, 500);
+        RTSPHTTPResponseAppendBody(response, failure, sizeof(failure) - 1);
+        return;
+    }
+
+    RTSPHTTPResponseSetStatus(response, (int)status);
+    RTSPHTTPResponseAppendBody(response, jsonData.bytes, jsonData.length);
 }
 
 - (void)stop {
@@ -327,12 +848,21 @@ static void handleConnect(CFSocketRef socket, CFSocketCallBackType type, CFDataR
         return;
     }
 
-    if (self.socket) {
-        CFSocketInvalidate(self.socket);
-        CFRelease(self.socket);
-        self.socket = NULL;
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+
+    // The channel dies with the engine; once it is cleared no publisher can
+    // reach it. Releasing outside the lock keeps workers from deadlocking.
+    RTSPHTTPServerRef httpServer = _httpServer;
+    @synchronized (self) {
+        _eventChannel = NULL;
+        _frameChannel = NULL;
+        _httpServer = NULL;
     }
 
+    // Joins the engine threads; handlers already running finish first
+    RTSPHTTPServerRelease(httpServer);
+    [self.routes removeAllObjects];
+
     self.isRunning = NO;
 
     NSLog(@"[API] Server stopped");
@@ -0,0 +1,293 @@
+//
+//  RTSPActivityGate.c
+//  RTSP Rotator
+//
+
+#include "RTSPActivityGate.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RTSP_GATE_RATE_WINDOW 5.0           // Seconds, time constant of the rate statistics
+#define RTSP_GATE_MAX_CREDIT 1.5            // Frames of credit a camera may bank
+#define RTSP_GATE_REALLOCATE_INTERVAL 0.1   // Seconds between budget shares at most
+#define RTSP_GATE_REALLOCATE_CHANGE 0.1     // Target change (fraction) that asks for a new share
+
+typedef struct {
+    bool present;
+    bool moving;                    // Hysteresis state of the motion score
+    bool onset;                     // Motion started on the last frame, not yet confirmed
+    double lastOffer;
+    double lastActivity;
+    double targetRate;
+    double allowedRate;
+    double allocatedTarget;         // targetRate when allowedRate was computed
+    double credit;
+    uint64_t framesOffered;
+    uint64_t framesInferred;
+    double offeredWeight;           // Exponentially decayed frame counts
+    double inferredWeight;
+    double weightTime;
+} RTSPGateCamera;
+
+typedef struct {
+    double target;
+    uint32_t camera;
+} RTSPGateDemand;
+
+struct RTSPActivityGate {
+    RTSPActivityGateConfig config;
+    pthread_mutex_t lock;
+    RTSPGateCamera *cameras;
+    RTSPGateDemand *demands;        // Scratch for the budget share
+    bool reallocate;
+    double lastAllocation;
+};
+
+void RTSPActivityGateConfigInit(RTSPActivityGateConfig *config) {
+    config->activeRate = 10.0;
+    config->idleRate = 0.2;
+    config->motionOn = 0.01f;
+    config->motionOff = 0.004f;
+    config->holdTime = 2.0;
+    config->decayTime = 1.5;
+    config->budget = 0;
+    config->staleAfter = 2.0;
+    config->maxCameras = 64;
+}
+
+RTSPActivityGateRef RTSPActivityGateCreate(const RTSPActivityGateConfig *config) {
+    RTSPActivityGateRef gate = calloc(1, sizeof(*gate));
+    if (!gate) {
+        return NULL;
+    }
+    if (config) {
+        gate->config = *config;
+    } else {
+        RTSPActivityGateConfigInit(&gate->config);
+    }
+    if (gate->config.maxCameras == 0) {
+        gate->config.maxCameras = 1;
+    }
+    if (gate->config.idleRate > gate->config.activeRate) {
+        gate->config.idleRate = gate->config.activeRate;
+    }
+    gate->cameras = calloc(gate->config.maxCameras, sizeof(*gate->cameras));
+    gate->demands = calloc(gate->config.maxCameras, sizeof(*gate->demands));
+    if (!gate->cameras || !gate->demands) {
+        RTSPActivityGateRelease(gate);
+        return NULL;
+    }
+    pthread_mutex_init(&gate->lock, NULL);
+    gate->lastAllocation = -INFINITY;
+    return gate;
+}
+
+void RTSPActivityGateRelease(RTSPActivityGateRef gate) {
+    if (!gate) {
+        return;
+    }
+    if (gate->cameras && gate->demands) {
+        pthread_mutex_destroy(&gate->lock);
+    }
+    free(gate->cameras);
+    free(gate->demands);
+    free(gate);
+}
+
+#pragma mark - Rates
+
+/// The rate the scene asks for: active during and just after activity,
+/// then halving every decayTime toward idle
+static double RTSPGateTargetRate(const RTSPActivityGateConfig *config, const RTSPGateCamera *camera, double now) {
+    double quiet = now - camera->lastActivity - config->holdTime;
+    if (quiet <= 0) {
+        return config->activeRate;
+    }
+    double decay = config->decayTime > 0 ? exp2(-quiet / config->decayTime) : 0;
+    return config->idleRate + (config->activeRate - config->idleRate) * decay;
+}
+
+static int RTSPGateCompareDemand(const void *a, const void *b) {
+    double x = ((const RTSPGateDemand *)a)->target, y = ((const RTSPGateDemand *)b)->target;
+    return (x > y) - (x < y);
+}
+
+/// Max-min fair share of the budget over the cameras still sending frames
+static void RTSPGateAllocate(RTSPActivityGateRef gate, double now) {
+    const RTSPActivityGateConfig *config = &gate->config;
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < config->maxCameras; i++) {
+        RTSPGateCamera *camera = &gate->cameras[i];
+        if (camera->present && now - camera->lastOffer > config->staleAfter) {
+            camera->present = false;
+        }
+        if (camera->present) {
+            gate->demands[count++] = (RTSPGateDemand){camera->targetRate, i};
+            camera->allocatedTarget = camera->targetRate;
+        }
+    }
+
+    if (config->budget <= 0) {
+        for (uint32_t n = 0; n < count; n++) {
+            gate->cameras[gate->demands[n].camera].allowedRate = gate->demands[n].target;
+        }
+    } else {
+        qsort(gate->demands, count, sizeof(*gate->demands), RTSPGateCompareDemand);
+        double remaining = config->budget;
+        for (uint32_t n = 0; n < count; n++) {
+            double share = remaining / (double)(count - n);
+            double allowed = gate->demands[n].target < share ? gate->demands[n].target : share;
+            gate->cameras[gate->demands[n].camera].allowedRate = allowed;
+            remaining -= allowed;
+        }
+    }
+    gate->reallocate = false;
+    gate->lastAllocation = now;
+}
+
+static void RTSPGateDecayWeights(RTSPGateCamera *camera, double now) {
+    double elapsed = now - camera->weightTime;
+    if (elapsed > 0) {
+        double keep = exp(-elapsed / RTSP_GATE_RATE_WINDOW);
+        camera->offeredWeight *= keep;
+        camera->inferredWeight *= keep;
+        camera->weightTime = now;
+    }
+}
+
+#pragma mark - Frames
+
+bool RTSPActivityGateOfferFrame(RTSPActivityGateRef gate, uint32_t camera, double timestamp, float motion,
+                                uint32_t movingTracks) {
+    const RTSPActivityGateConfig *config = &gate->config;
+    if (camera >= config->maxCameras) {
+        return false;
+    }
+    pthread_mutex_lock(&gate->lock);
+    RTSPGateCamera *c = &gate->cameras[camera];
+
+    if (!c->present) {
+        // First frame (or back from silence): infer it, then settle
+        bool known = c->framesOffered > 0;
+        double lastOffer = c->lastOffer;
+        c->present = true;
+        c->lastOffer = timestamp;
+        c->weightTime = timestamp;
+        if (!known || timestamp - lastOffer > config->staleAfter) {
+            c->lastActivity = timestamp;
+            c->credit = 1.0;
+        }
+        gate->reallocate = true;
+    }
+    double elapsed = timestamp - c->lastOffer;
+    if (elapsed < 0) {
+        elapsed = 0;    // Out-of-order frames earn no credit
+    }
+    c->lastOffer = timestamp > c->lastOffer ? timestamp : c->lastOffer;
+
+    // Activity, with hysteresis on the motion score. The first frame of new
+    // motion is inferred at once, but the scene only turns active when the
+    // next frame moves too, so a one-frame flicker costs a single inference.
+    c->moving = motion < 0 || motion >= config->motionOn || (c->moving && motion >= config->motionOff);
+    bool wasActive = timestamp - c->lastActivity <= config->holdTime;
+    if (movingTracks > 0 || (c->moving && (wasActive || c->onset || motion < 0))) {
+        c->lastActivity = timestamp;
+        c->onset = false;
+    } else if (c->moving) {
+        c->credit = c->credit > 1.0 ? c->credit : 1.0;
+        c->onset = true;
+    } else {
+        c->onset = false;
+    }
+
+    c->targetRate = RTSPGateTargetRate(config, c, timestamp);
+    if (fabs(c->targetRate - c->allocatedTarget) > RTSP_GATE_REALLOCATE_CHANGE * c->allocatedTarget) {
+        gate->reallocate = true;
+    }
+    if (gate->reallocate && timestamp - gate->lastAllocation >= RTSP_GATE_REALLOCATE_INTERVAL) {
+        RTSPGateAllocate(gate, timestamp);
+    } else if (config->budget <= 0) {
+        c->allowedRate = c->targetRate;
+    }
+
+    c->credit += elapsed * c->allowedRate;
+    if (c->credit > RTSP_GATE_MAX_CREDIT) {
+        c->credit = RTSP_GATE_MAX_CREDIT;
+    }
+    bool infer = c->credit >= 1.0;
+    if (infer) {
+        c->credit -= 1.0;
+        c->framesInferred++;
+    }
+
+    c->framesOffered++;
+    RTSPGateDecayWeights(c, timestamp);
+    c->offeredWeight += 1.0;
+    c->inferredWeight += infer ? 1.0 : 0.0;
+    pthread_mutex_unlock(&gate->lock);
+    return infer;
+}
+
+void RTSPActivityGateRemoveCamera(RTSPActivityGateRef gate, uint32_t camera) {
+    if (camera >= gate->config.maxCameras) {
+        return;
+    }
+    pthread_mutex_lock(&gate->lock);
+    memset(&gate->cameras[camera], 0, sizeof(gate->cameras[camera]));
+    gate->reallocate = true;
+    pthread_mutex_unlock(&gate->lock);
+}
+
+#pragma mark - Statistics
+
+static void RTSPGateCameraStatistics(RTSPActivityGateRef gate, RTSPGateCamera *c, double timestamp,
+                                     RTSPActivityGateCameraStatistics *statistics) {
+    // Counts decayed with time constant W read as a rate once divided by W
+    RTSPGateDecayWeights(c, timestamp);
+    statistics->framesOffered = c->framesOffered;
+    statistics->framesInferred = c->framesInferred;
+    statistics->offeredRate = c->offeredWeight / RTSP_GATE_RATE_WINDOW;
+    statistics->inferenceRate = c->inferredWeight / RTSP_GATE_RATE_WINDOW;
+    statistics->skippedRatio = c->offeredWeight > 0 ? 1.0 - c->inferredWeight / c->offeredWeight : 0;
+    statistics->targetRate = c->present ? RTSPGateTargetRate(&gate->config, c, timestamp) : 0;
+    statistics->allowedRate = c->present ? c->allowedRate : 0;
+    statistics->active = c->present && timestamp - c->lastActivity <= gate->config.holdTime;
+}
+
+bool RTSPActivityGateGetCameraStatistics(RTSPActivityGateRef gate, uint32_t camera, double timestamp,
+                                         RTSPActivityGateCameraStatistics *statistics) {
+    if (camera >= gate->config.maxCameras) {
+        return false;
+    }
+    pthread_mutex_lock(&gate->lock);
+    RTSPGateCamera *c = &gate->cameras[camera];
+    bool known = c->framesOffered > 0;
+    if (known) {
+        RTSPGateCameraStatistics(gate, c, timestamp, statistics);
+    }
+    pthread_mutex_unlock(&gate->lock);
+    return known;
+}
+
+RTSPActivityGateStatistics RTSPActivityGateGetStatistics(RTSPActivityGateRef gate, double timestamp) {
+    RTSPActivityGateStatistics statistics = {0};
+    pthread_mutex_lock(&gate->lock);
+    for (uint32_t i = 0; i < gate->config.maxCameras; i++) {
+        RTSPGateCamera *c = &gate->cameras[i];
+        if (c->framesOffered == 0) {
+            continue;
+        }
+        RTSPActivityGateCameraStatistics camera;
+        RTSPGateCameraStatistics(gate, c, timestamp, &camera);
+        if (c->present && timestamp - c->lastOffer <= gate->config.staleAfter) {
+            statistics.cameras++;
+            statistics.allocatedRate += camera.allowedRate;
+        }
+        statistics.inferenceRate += camera.inferenceRate;
+    }
+    pthread_mutex_unlock(&gate->lock);
+    return statistics;
+}
@@ -0,0 +1,90 @@
+//
+//  RTSPActivityGate.h
+//  RTSP Rotator
+//
+//  Decides which camera frames go to object detection. Each camera's
+//  inference rate follows its scene: activity (a motion score over
+//  motionOn, or tracked objects still moving) runs it at activeRate, and
+//  once the scene has been still for holdTime the rate decays toward
+//  idleRate, a slow heartbeat that still catches objects entering without
+//  motion being picked up. The first frame of new motion is always
+//  inferred, so a quiet camera reacts as fast as a busy one, but motion
+//  only counts as activity once a second frame confirms it: a one-frame
+//  lighting flicker costs a single inference.
+//
+//  A global budget (inferences per second over all cameras) is shared
+//  max-min fairly: cameras asking for less than an equal share get what
+//  they ask for, and the rest split what remains. Frames are admitted with
+//  a per-camera token bucket, so any frame rate above the allowed rate
+//  works.
+//
+//  Timestamps are seconds on any monotonic clock. Thread-safe.
+//
+
+#ifndef RTSPActivityGate_h
+#define RTSPActivityGate_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    double activeRate;              // Inferences / s per camera during activity (default 10)
+    double idleRate;                // Inferences / s per camera when still (default 0.2)
+    float motionOn;                 // Motion fraction that starts activity (default 0.01)
+    float motionOff;                // Motion fraction below which it ends (default 0.004)
+    double holdTime;                // Seconds at activeRate after the last activity (default 2)
+    double decayTime;               // Half-life in seconds of the fall toward idleRate (default 1.5)
+    double budget;                  // Inferences / s over all cameras; 0 = unlimited (default 0)
+    double staleAfter;              // Seconds without frames before a camera gives up its share (default 2)
+    uint32_t maxCameras;            // Default 64
+} RTSPActivityGateConfig;
+
+void RTSPActivityGateConfigInit(RTSPActivityGateConfig *config);
+
+typedef struct {
+    uint64_t framesOffered;
+    uint64_t framesInferred;
+    double offeredRate;             // Frames / s over roughly the last 5 s
+    double inferenceRate;           // Effective inference FPS, same window
+    double skippedRatio;            // Offered frames not inferred, same window
+    double targetRate;              // What the scene asks for
+    double allowedRate;             // Target after the budget
+    bool active;                    // Activity now or within holdTime
+} RTSPActivityGateCameraStatistics;
+
+typedef struct {
+    uint32_t cameras;               // Offered a frame within staleAfter
+    double allocatedRate;           // Sum of allowed rates
+    double inferenceRate;           // Sum of effective rates
+} RTSPActivityGateStatistics;
+
+typedef struct RTSPActivityGate *RTSPActivityGateRef;
+
+RTSPActivityGateRef RTSPActivityGateCreate(const RTSPActivityGateConfig *config);
+void RTSPActivityGateRelease(RTSPActivityGateRef gate);
+
+/// A frame from `camera` (0 ..< maxCameras) with its motion fraction (0.0 -
+/// 1.0, or negative when unknown, which counts as activity) and the number
+/// of tracked objects still moving. Returns whether to run inference on it.
+bool RTSPActivityGateOfferFrame(RTSPActivityGateRef gate, uint32_t camera, double timestamp, float motion,
+                                uint32_t movingTracks);
+
+/// Forget a camera and give its share of the budget to the others
+void RTSPActivityGateRemoveCamera(RTSPActivityGateRef gate, uint32_t camera);
+
+/// Returns false for a camera that has never offered a frame
+bool RTSPActivityGateGetCameraStatistics(RTSPActivityGateRef gate, uint32_t camera, double timestamp,
+                                         RTSPActivityGateCameraStatistics *statistics);
+
+RTSPActivityGateStatistics RTSPActivityGateGetStatistics(RTSPActivityGateRef gate, double timestamp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RTSPActivityGate_h */
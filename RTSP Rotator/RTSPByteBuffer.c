@@ -0,0 +1,133 @@
+//
+//  RTSPByteBuffer.c
+//  RTSP Rotator
+//
+
+#include "RTSPByteBuffer.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void RTSPByteBufferInit(RTSPByteBuffer *buffer) {
+    memset(buffer, 0, sizeof(*buffer));
+}
+
+void RTSPByteBufferFree(RTSPByteBuffer *buffer) {
+    free(buffer->data);
+    memset(buffer, 0, sizeof(*buffer));
+}
+
+void RTSPByteBufferReset(RTSPByteBuffer *buffer) {
+    buffer->length = 0;
+    buffer->failed = false;
+}
+
+bool RTSPByteBufferReserve(RTSPByteBuffer *buffer, size_t additional) {
+    if (buffer->failed) {
+        return false;
+    }
+    size_t needed = buffer->length + additional;
+    if (needed <= buffer->capacity) {
+        return true;
+    }
+    size_t capacity = buffer->capacity ? buffer->capacity : 256;
+    while (capacity < needed) {
+        capacity *= 2;
+    }
+    uint8_t *data = realloc(buffer->data, capacity);
+    if (!data) {
+        buffer->failed = true;
+        return false;
+    }
+    buffer->data = data;
+    buffer->capacity = capacity;
+    return true;
+}
+
+void RTSPByteBufferConsume(RTSPByteBuffer *buffer, size_t count) {
+    if (count >= buffer->length) {
+        buffer->length = 0;
+        return;
+    }
+    memmove(buffer->data, buffer->data + count, buffer->length - count);
+    buffer->length -= count;
+}
+
+uint8_t *RTSPByteBufferDetach(RTSPByteBuffer *buffer, size_t *length) {
+    uint8_t *data = buffer->data;
+    if (length) {
+        *length = buffer->length;
+    }
+    memset(buffer, 0, sizeof(*buffer));
+    return data;
+}
+
+void RTSPByteBufferAppend(RTSPByteBuffer *buffer, const void *bytes, size_t length) {
+    if (length == 0 || !RTSPByteBufferReserve(buffer, length)) {
+        return;
+    }
+    memcpy(buffer->data + buffer->length, bytes, length);
+    buffer->length += length;
+}
+
+void RTSPByteBufferAppendString(RTSPByteBuffer *buffer, const char *string) {
+    RTSPByteBufferAppend(buffer, string, strlen(string));
+}
+
+void RTSPByteBufferAppendFormat(RTSPByteBuffer *buffer, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    va_list copy;
+    va_copy(copy, args);
+    int needed = vsnprintf(NULL, 0, format, copy);
+    va_end(copy);
+    if (needed > 0 && RTSPByteBufferReserve(buffer, (size_t)needed + 1)) {
+        vsnprintf((char *)buffer->data + buffer->length, (size_t)needed + 1, format, args);
+        buffer->length += (size_t)needed;
+    }
+    va_end(args);
+}
+
+void RTSPByteBufferAppendZeros(RTSPByteBuffer *buffer, size_t count) {
+    if (count == 0 || !RTSPByteBufferReserve(buffer, count)) {
+        return;
+    }
+    memset(buffer->data + buffer->length, 0, count);
+    buffer->length += count;
+}
+
+void RTSPByteBufferAppendU8(RTSPByteBuffer *buffer, uint8_t value) {
+    RTSPByteBufferAppend(buffer, &value, 1);
+}
+
+void RTSPByteBufferAppendU16(RTSPByteBuffer *buffer, uint16_t value) {
+    uint8_t bytes[2] = {(uint8_t)(value >> 8), (uint8_t)value};
+    RTSPByteBufferAppend(buffer, bytes, 2);
+}
+
+void RTSPByteBufferAppendU24(RTSPByteBuffer *buffer, uint32_t value) {
+    uint8_t bytes[3] = {(uint8_t)(value >> 16), (uint8_t)(value >> 8), (uint8_t)value};
+    RTSPByteBufferAppend(buffer, bytes, 3);
+}
+
+void RTSPByteBufferAppendU32(RTSPByteBuffer *buffer, uint32_t value) {
+    uint8_t bytes[4] = {(uint8_t)(value >> 24), (uint8_t)(value >> 16), (uint8_t)(value >> 8), (uint8_t)value};
+    RTSPByteBufferAppend(buffer, bytes, 4);
+}
+
+void RTSPByteBufferAppendU64(RTSPByteBuffer *buffer, uint64_t value) {
+    RTSPByteBufferAppendU32(buffer, (uint32_t)(value >> 32));
+    RTSPByteBufferAppendU32(buffer, (uint32_t)value);
+}
+
+void RTSPByteBufferPatchU32(RTSPByteBuffer *buffer, size_t offset, uint32_t value) {
+    if (buffer->failed || offset + 4 > buffer->length) {
+        return;
+    }
+    buffer->data[offset] = (uint8_t)(value >> 24);
+    buffer->data[offset + 1] = (uint8_t)(value >> 16);
+    buffer->data[offset + 2] = (uint8_t)(value >> 8);
+    buffer->data[offset + 3] = (uint8_t)value;
+}
@@ -0,0 +1,60 @@
+//
+//  RTSPByteBuffer.h
+//  RTSP Rotator
+//
+//  Growable byte buffer with big-endian writers, shared by the portable
+//  C media modules (fMP4 writer, RTSP protocol, remux engine).
+//
+
+#ifndef RTSPByteBuffer_h
+#define RTSPByteBuffer_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint8_t *data;
+    size_t length;
+    size_t capacity;
+    bool failed;        // Sticky allocation failure flag
+} RTSPByteBuffer;
+
+void RTSPByteBufferInit(RTSPByteBuffer *buffer);
+void RTSPByteBufferFree(RTSPByteBuffer *buffer);
+
+/// Drop contents but keep the allocation
+void RTSPByteBufferReset(RTSPByteBuffer *buffer);
+
+/// Make room for `additional` more bytes
+bool RTSPByteBufferReserve(RTSPByteBuffer *buffer, size_t additional);
+
+/// Remove `count` bytes from the front
+void RTSPByteBufferConsume(RTSPByteBuffer *buffer, size_t count);
+
+/// Hand the storage to the caller (who must free() it) and reset the buffer
+uint8_t *RTSPByteBufferDetach(RTSPByteBuffer *buffer, size_t *length);
+
+void RTSPByteBufferAppend(RTSPByteBuffer *buffer, const void *bytes, size_t length);
+void RTSPByteBufferAppendString(RTSPByteBuffer *buffer, const char *string);
+void RTSPByteBufferAppendFormat(RTSPByteBuffer *buffer, const char *format, ...)
+    __attribute__((format(printf, 2, 3)));
+void RTSPByteBufferAppendZeros(RTSPByteBuffer *buffer, size_t count);
+void RTSPByteBufferAppendU8(RTSPByteBuffer *buffer, uint8_t value);
+void RTSPByteBufferAppendU16(RTSPByteBuffer *buffer, uint16_t value);
+void RTSPByteBufferAppendU24(RTSPByteBuffer *buffer, uint32_t value);
+void RTSPByteBufferAppendU32(RTSPByteBuffer *buffer, uint32_t value);
+void RTSPByteBufferAppendU64(RTSPByteBuffer *buffer, uint64_t value);
+
+/// Overwrite a big-endian u32 at an earlier offset (box sizes, data offsets)
+void RTSPByteBufferPatchU32(RTSPByteBuffer *buffer, size_t offset, uint32_t value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RTSPByteBuffer_h */
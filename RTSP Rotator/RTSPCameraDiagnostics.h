@@ -4,6 +4,10 @@
 //
 //  Comprehensive camera health monitoring and diagnostics
 //
+//  Cameras are tested with RTSPCameraProbe: OPTIONS, DESCRIBE and the first
+//  RTP packet over a short-lived connection, many cameras at once, instead
+//  of opening a player per camera. Reports arrive as each camera answers.
+//
 
 #import <Foundation/Foundation.h>
 #import "RTSPCameraTypeManager.h"
@@ -93,19 +97,26 @@ typedef NS_ENUM(NSInteger, RTSPCameraHealthStatus) {
 /// Health check interval (default: 60 seconds)
 @property (nonatomic, assign) NSTimeInterval healthCheckInterval;
 
+/// Cameras tested at the same time; the rest wait for a slot (default: 16)
+@property (nonatomic, assign) NSUInteger maxConcurrentTests;
+
+/// Seconds a single camera test may take before it fails (default: 5)
+@property (nonatomic, assign) NSTimeInterval testTimeout;
+
 /// Get diagnostic report for camera
 - (nullable RTSPCameraDiagnosticReport *)reportForCamera:(RTSPCameraConfig *)camera;
 
 /// Get all diagnostic reports
 - (NSArray<RTSPCameraDiagnosticReport *> *)allReports;
 
-/// Run comprehensive diagnostic test on camera
+/// Run diagnostic test on camera: connect, DESCRIBE, first RTP packet
 - (void)testCamera:(RTSPCameraConfig *)camera completion:(void (^)(RTSPCameraDiagnosticReport *report))completion;
 
-/// Run quick connection test
+/// Run quick connection test (connect and DESCRIBE only)
 - (void)quickTestCamera:(RTSPCameraConfig *)camera completion:(void (^)(BOOL healthy, NSString *_Nullable issue))completion;
 
-/// Test all cameras
+/// Test all cameras concurrently; progress and the delegate are called on
+/// the main queue as each camera's report arrives
 - (void)testAllCamerasWithProgress:(void (^)(NSInteger tested, NSInteger total))progressHandler
                         completion:(void (^)(NSArray<RTSPCameraDiagnosticReport *> *reports))completion;
 
@@ -4,7 +4,16 @@
 //
 
 #import "RTSPCameraDiagnostics.h"
-#import <AVFoundation/AVFoundation.h>
+#import "RTSPCameraProbe.h"
+
+/// Probe thread; hands the result to the completion block on the main queue
+static void RTSPDiagnosticsProbeFinished(void *context, uint32_t probeID, const RTSPCameraProbeResult *result) {
+    void (^completion)(RTSPCameraProbeResult) = CFBridgingRelease(context);
+    RTSPCameraProbeResult copy = *result;
+    dispatch_async(dispatch_get_main_queue(), ^{
+        completion(copy);
+    });
+}
 
 @implementation RTSPCameraDiagnosticReport
 
@@ -28,13 +37,15 @@
     if (self.canConnect) {
         [summary appendFormat:@"Connection: OK (%.1fms)\n", self.connectionTime * 1000];
 
-        if (self.hasVideo) {
+        if (self.hasVideo && self.framerate > 0) {
             [summary appendFormat:@"Video: %@ @ %@ (%ldfps, %.1f Mbps)\n",
              self.videoCodec, self.resolution, (long)self.framerate, self.bitrate];
+        } else if (self.hasVideo) {
+            [summary appendFormat:@"Video: %@ @ %@\n", self.videoCodec, self.resolution ?: @"unknown size"];
         }
 
         if (self.hasAudio) {
-            [summary appendFormat:@"Audio: %@\n", self.audioCodec];
+            [summary appendFormat:@"Audio: %@\n", self.audioCodec ?: @"present"];
         }
 
         if (self.latency > 0) {
@@ -120,7 +131,10 @@
 @property (nonatomic, strong) NSTimer *monitoringTimer;
 @end
 
-@implementation RTSPCameraDiagnostics
+@implementation RTSPCameraDiagnostics {
+    RTSPCameraProbeRef _probe;          // Up to the first RTP packet
+    RTSPCameraProbeRef _quickProbe;     // DESCRIBE only
+}
 
 + (instancetype)sharedDiagnostics {
     static RTSPCameraDiagnostics *shared = nil;
@@ -137,6 +151,8 @@
         _reports = [NSMutableDictionary dictionary];
         _automaticHealthChecks = NO;
         _healthCheckInterval = 60.0;
+        _maxConcurrentTests = 16;
+        _testTimeout = 5.0;
     }
     return self;
 }
@@ -149,6 +165,80 @@
     return [self.reports.allValues copy];
 }
 
+- (void)setMaxConcurrentTests:(NSUInteger)maxConcurrentTests {
+    _maxConcurrentTests = MAX(maxConcurrentTests, (NSUInteger)1);
+    [self resetProbes];
+}
+
+- (void)setTestTimeout:(NSTimeInterval)testTimeout {
+    _testTimeout = testTimeout > 0 ? testTimeout : 5.0;
+    [self resetProbes];
+}
+
+/// Engines pick up the settings when next created. Tests already running
+/// finish on the old ones, which are released once they are idle.
+- (void)resetProbes {
+    RTSPCameraProbeRef engines[2] = {_probe, _quickProbe};
+    _probe = NULL;
+    _quickProbe = NULL;
+    for (int i = 0; i < 2; i++) {
+        RTSPCameraProbeRef engine = engines[i];
+        if (engine) {
+            dispatch_async(dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+                RTSPCameraProbeWait(engine);
+                RTSPCameraProbeRelease(engine);
+            });
+        }
+    }
+}
+
+- (RTSPCameraProbeRef)probeWaitingForMedia:(BOOL)waitForMedia {
+    RTSPCameraProbeRef *engine = waitForMedia ? &_probe : &_quickProbe;
+    if (!*engine) {
+        RTSPCameraProbeConfig config;
+        RTSPCameraProbeConfigInit(&config);
+        config.maxInFlight = (uint32_t)MIN(self.maxConcurrentTests, (NSUInteger)256);
+        config.timeout = self.testTimeout;
+        config.waitForMedia = waitForMedia;
+        *engine = RTSPCameraProbeCreate(&config);
+        if (!*engine) {
+            NSLog(@"[Diagnostics] Could not start the camera probe");
+        }
+    }
+    return *engine;
+}
+
+/// Feed URL with the camera's credentials filled in when the URL has none
+- (nullable NSString *)probeURLForCamera:(RTSPCameraConfig *)camera {
+    NSURLComponents *components = [NSURLComponents componentsWithURL:camera.feedURL resolvingAgainstBaseURL:NO];
+    if (!components) {
+        return nil;
+    }
+    if (components.user.length == 0 && camera.username.length > 0) {
+        components.user = camera.username;
+        components.password = camera.password;
+    }
+    return components.URL.absoluteString;
+}
+
+/// Probe a camera. Returns NO, without calling completion, for feeds the
+/// probe cannot test (not rtsp:// or rtsps://).
+- (BOOL)probeCamera:(RTSPCameraConfig *)camera
+       waitForMedia:(BOOL)waitForMedia
+         completion:(void (^)(RTSPCameraProbeResult result))completion {
+    NSString *url = [self probeURLForCamera:camera];
+    RTSPCameraProbeRef engine = [self probeWaitingForMedia:waitForMedia];
+    if (!url || !engine) {
+        return NO;
+    }
+    void *context = (void *)CFBridgingRetain([completion copy]);
+    if (RTSPCameraProbeSubmit(engine, url.UTF8String, RTSPDiagnosticsProbeFinished, context) == 0) {
+        CFRelease(context);
+        return NO;
+    }
+    return YES;
+}
+
 - (void)testCamera:(RTSPCameraConfig *)camera completion:(void (^)(RTSPCameraDiagnosticReport *))completion {
     RTSPCameraDiagnosticReport *report = [[RTSPCameraDiagnosticReport alloc] init];
     report.cameraID = camera.cameraID;
@@ -158,167 +248,87 @@
 
     self.reports[camera.cameraID] = report;
 
-    NSDate *testStart = [NSDate date];
-
     NSLog(@"[Diagnostics] Testing camera: %@", camera.name);
 
-    // Test connection
-    [[RTSPCameraTypeManager sharedManager] testCameraConnection:camera completion:^(BOOL success, NSDictionary *diagnostics, NSError *error) {
-        report.testDuration = [[NSDate date] timeIntervalSinceDate:testStart];
-        report.canConnect = success;
+    void (^finish)(void) = ^{
+        [self finalizeReport:report];
 
-        if (success) {
-            report.connectionTime = [diagnostics[@"connectionTime"] doubleValue];
-
-            // Run detailed stream analysis
-            [self analyzeStream:camera report:report completion:^{
-                [self finalizeReport:report];
-
-                if ([self.delegate respondsToSelector:@selector(cameraDiagnostics:didCompleteTest:)]) {
-                    [self.delegate cameraDiagnostics:self didCompleteTest:report];
-                }
-
-                if (completion) completion(report);
-            }];
-        } else {
-            report.connectionError = error.localizedDescription;
-            report.healthStatus = RTSPCameraHealthStatusCritical;
-
-            NSMutableArray *errors = [report.errors mutableCopy];
-            [errors addObject:[NSString stringWithFormat:@"Connection failed: %@", error.localizedDescription]];
-            report.errors = errors;
-
-            [self finalizeReport:report];
-
-            if (completion) completion(report);
+        if ([self.delegate respondsToSelector:@selector(cameraDiagnostics:didCompleteTest:)]) {
+            [self.delegate cameraDiagnostics:self didCompleteTest:report];
         }
-    }];
-}
-
-- (void)analyzeStream:(RTSPCameraConfig *)camera report:(RTSPCameraDiagnosticReport *)report completion:(void (^)(void))completion {
-    // Create temporary player for stream analysis
-    AVPlayer *player = [[AVPlayer alloc] init];
-    AVPlayerItem *item = [AVPlayerItem playerItemWithURL:camera.feedURL];
-
-    [item addObserver:self forKeyPath:@"status" options:NSKeyValueObservingOptionNew context:(__bridge void *)report];
-    [player replaceCurrentItemWithPlayerItem:item];
-
-    // Wait for player to be ready
-    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(3.0 * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
-        if (item.status == AVPlayerItemStatusReadyToPlay) {
-            // Extract stream information
-            AVAsset *asset = item.asset;
-
-            // Video tracks - use new async API
-            if (@available(macOS 12.0, *)) {
-                [asset loadTracksWithMediaType:AVMediaTypeVideo completionHandler:^(NSArray<AVAssetTrack *> * _Nullable videoTracks, NSError * _Nullable error) {
-                    if (!error && videoTracks.count > 0) {
-                        AVAssetTrack *videoTrack = videoTracks[0];
-                        report.hasVideo = YES;
 
-                        // Get resolution
-                        CGSize size = videoTrack.naturalSize;
-                        report.resolution = [NSString stringWithFormat:@"%.0fx%.0f", size.width, size.height];
-
-                        // Get framerate
-                        report.framerate = (NSInteger)videoTrack.nominalFrameRate;
-
-                        // Estimate bitrate
-                        report.bitrate = videoTrack.estimatedDataRate / 1000000.0; // Convert to Mbps
-
-                        NSLog(@"[Diagnostics] Video: %@ @ %ldfps, %.1f Mbps", report.resolution, (long)report.framerate, report.bitrate);
-                    }
-
-                    // Audio tracks - use new async API
-                    [asset loadTracksWithMediaType:AVMediaTypeAudio completionHandler:^(NSArray<AVAssetTrack *> * _Nullable audioTracks, NSError * _Nullable audioError) {
-                        if (!audioError) {
-                            report.hasAudio = audioTracks.count > 0;
-                        }
-
-                    // Check for issues
-                    NSMutableArray *warnings = [NSMutableArray array];
-
-                    if (report.framerate < 15) {
-                        [warnings addObject:[NSString stringWithFormat:@"Low framerate: %ldfps", (long)report.framerate]];
-                    }
-
-                    if (report.bitrate < 1.0) {
-                        [warnings addObject:[NSString stringWithFormat:@"Low bitrate: %.1f Mbps", report.bitrate]];
-                    }
-
-                    if (!report.hasVideo) {
-                        [warnings addObject:@"No video stream detected"];
-                    }
-
-                    report.warnings = warnings;
+        if (completion) completion(report);
+    };
 
-                    dispatch_async(dispatch_get_main_queue(), ^{
-                        [item removeObserver:self forKeyPath:@"status" context:(__bridge void *)report];
-                        [player pause];
+    BOOL probing = [self probeCamera:camera waitForMedia:YES completion:^(RTSPCameraProbeResult result) {
+        [self applyProbeResult:&result toReport:report];
+        finish();
+    }];
+    if (probing) {
+        return;
+    }
 
-                        if (completion) completion();
-                    });
-                }];
-            }];
+    // Not an RTSP feed; fall back to the camera type's own connection test
+    NSDate *testStart = [NSDate date];
+    [[RTSPCameraTypeManager sharedManager] testCameraConnection:camera completion:^(BOOL success, NSDictionary *diagnostics, NSError *error) {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            report.testDuration = [[NSDate date] timeIntervalSinceDate:testStart];
+            report.canConnect = success;
+            if (success) {
+                report.connectionTime = [diagnostics[@"connectionTime"] doubleValue];
             } else {
-                // Fallback for macOS 11.0-11.x: use synchronous API
-                NSArray<AVAssetTrack *> *videoTracks = [asset tracksWithMediaType:AVMediaTypeVideo];
-                if (videoTracks.count > 0) {
-                    AVAssetTrack *videoTrack = videoTracks[0];
-                    report.hasVideo = YES;
-
-                    // Get resolution
-                    CGSize size = videoTrack.naturalSize;
-                    report.resolution = [NSString stringWithFormat:@"%.0fx%.0f", size.width, size.height];
-
-                    // Get framerate
-                    report.framerate = (NSInteger)videoTrack.nominalFrameRate;
-
-                    // Estimate bitrate
-                    report.bitrate = videoTrack.estimatedDataRate / 1000000.0;
-
-                    NSLog(@"[Diagnostics] Video: %@ @ %ldfps, %.1f Mbps", report.resolution, (long)report.framerate, report.bitrate);
-                }
-
-                // Audio tracks
-                NSArray<AVAssetTrack *> *audioTracks = [asset tracksWithMediaType:AVMediaTypeAudio];
-                report.hasAudio = audioTracks.count > 0;
-
-                // Check for issues
-                NSMutableArray *warnings = [NSMutableArray array];
-
-                if (report.framerate < 15) {
-                    [warnings addObject:[NSString stringWithFormat:@"Low framerate: %ldfps", (long)report.framerate]];
-                }
+                report.connectionError = error.localizedDescription;
+                report.errors = @[[NSString stringWithFormat:@"Connection failed: %@", error.localizedDescription]];
+            }
+            finish();
+        });
+    }];
+}
 
-                if (report.bitrate < 1.0) {
-                    [warnings addObject:[NSString stringWithFormat:@"Low bitrate: %.1f Mbps", report.bitrate]];
-                }
+- (void)applyProbeResult:(const RTSPCameraProbeResult *)result toReport:(RTSPCameraDiagnosticReport *)report {
+    report.testDuration = result->totalTime;
+    report.canConnect = result->connectTime > 0;
+    report.connectionTime = result->connectTime;
+    report.latency = result->optionsTime * 1000.0;
 
-                if (!report.hasVideo) {
-                    [warnings addObject:@"No video stream detected"];
-                }
+    if (result->codec != RTSPVideoCodecUnknown) {
+        report.videoCodec = result->codec == RTSPVideoCodecH265 ? @"H.265" : @"H.264";
+    }
+    if (result->width > 0) {
+        report.resolution = [NSString stringWithFormat:@"%ux%u", result->width, result->height];
+    }
+    report.hasVideo = result->status == RTSPCameraProbeOK;
+    report.hasAudio = result->hasAudio;
 
-                report.warnings = warnings;
+    NSMutableArray *warnings = [NSMutableArray array];
+    NSMutableArray *errors = [NSMutableArray array];
 
-                dispatch_async(dispatch_get_main_queue(), ^{
-                    [item removeObserver:self forKeyPath:@"status" context:(__bridge void *)report];
-                    [player pause];
+    if (result->status == RTSPCameraProbeOK) {
+        NSLog(@"[Diagnostics] %@: %@ %@, first packet after %.0fms", report.cameraName,
+              report.videoCodec, report.resolution ?: @"(size unknown)", result->firstPacketTime * 1000.0);
 
-                    if (completion) completion();
-                });
-            }
+        if (result->optionsTime > 0.5) {
+            [warnings addObject:[NSString stringWithFormat:@"Slow RTSP responses: %.0fms", result->optionsTime * 1000.0]];
+        }
+        if (result->firstPacketTime > 2.0) {
+            [warnings addObject:[NSString stringWithFormat:@"Slow stream start: %.1fs to first packet", result->firstPacketTime]];
+        }
+    } else {
+        NSString *message = [NSString stringWithUTF8String:result->message];
+        if (!report.canConnect) {
+            report.connectionError = message;
+            [errors addObject:[NSString stringWithFormat:@"Connection failed: %@", message]];
+        } else if (result->status == RTSPCameraProbeUnauthorized) {
+            [errors addObject:[NSString stringWithFormat:@"Authentication failed: %@", message]];
+        } else if (result->status == RTSPCameraProbeNoVideo) {
+            [warnings addObject:@"No video stream detected"];
         } else {
-            [item removeObserver:self forKeyPath:@"status" context:(__bridge void *)report];
-            [player pause];
-
-            if (completion) completion();
+            [errors addObject:message];
         }
-    });
-}
+    }
 
-- (void)observeValueForKeyPath:(NSString *)keyPath ofObject:(id)object change:(NSDictionary *)change context:(void *)context {
-    // Observer for stream analysis
+    report.warnings = warnings;
+    report.errors = errors;
 }
 
 - (void)finalizeReport:(RTSPCameraDiagnosticReport *)report {
@@ -344,6 +354,15 @@
 }
 
 - (void)quickTestCamera:(RTSPCameraConfig *)camera completion:(void (^)(BOOL, NSString * _Nullable))completion {
+    BOOL probing = [self probeCamera:camera waitForMedia:NO completion:^(RTSPCameraProbeResult result) {
+        if (completion) {
+            completion(result.status == RTSPCameraProbeOK,
+                       result.status == RTSPCameraProbeOK ? nil : [NSString stringWithUTF8String:result.message]);
+        }
+    }];
+    if (probing) {
+        return;
+    }
     [[RTSPCameraTypeManager sharedManager] testCameraConnection:camera completion:^(BOOL success, NSDictionary *diagnostics, NSError *error) {
         if (success) {
             if (completion) completion(YES, nil);
@@ -356,7 +375,7 @@
 - (void)testAllCamerasWithProgress:(void (^)(NSInteger, NSInteger))progressHandler completion:(void (^)(NSArray<RTSPCameraDiagnosticReport *> *))completion {
     RTSPCameraTypeManager *manager = [RTSPCameraTypeManager sharedManager];
 
-    NSMutableArray *allCameras = [NSMutableArray arrayWithArray:manager.rtspCameras];
+    NSArray *allCameras = [manager.rtspCameras copy];
 
     NSMutableArray<RTSPCameraDiagnosticReport *> *allReports = [NSMutableArray array];
     __block NSInteger tested = 0;
@@ -367,8 +386,12 @@
         return;
     }
 
-    NSLog(@"[Diagnostics] Testing %ld cameras...", (long)total);
+    NSLog(@"[Diagnostics] Testing %ld cameras, %lu at a time...", (long)total, (unsigned long)self.maxConcurrentTests);
+    NSDate *start = [NSDate date];
 
+    // Every test is queued at once; the probe runs maxConcurrentTests of
+    // them together and each report arrives as soon as its camera answers
+    // or its deadline passes.
     for (RTSPCameraConfig *camera in allCameras) {
         [self testCamera:camera completion:^(RTSPCameraDiagnosticReport *report) {
             [allReports addObject:report];
@@ -379,13 +402,10 @@
             }
 
             if (tested == total) {
-                NSLog(@"[Diagnostics] All cameras tested");
+                NSLog(@"[Diagnostics] All cameras tested in %.1fs", -[start timeIntervalSinceNow]);
                 if (completion) completion(allReports);
             }
         }];
-
-        // Stagger tests to avoid overload
-        [NSThread sleepForTimeInterval:0.5];
     }
 }
 
@@ -521,6 +541,8 @@
 
 - (void)dealloc {
     [self stopHealthMonitoring];
+    RTSPCameraProbeRelease(_probe);
+    RTSPCameraProbeRelease(_quickProbe);
 }
 
 @end
@@ -0,0 +1,738 @@
+//
+//  RTSPCameraProbe.c
+//  RTSP Rotator
+//
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE     // pthread_setname_np
+#endif
+
+#include "RTSPCameraProbe.h"
+#include "RTSPByteBuffer.h"
+#include "RTSPProtocol.h"
+#include "RTSPTransport.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RTSP_PROBE_READ_CHUNK 16384
+#define RTSP_PROBE_READ_BUDGET (256 * 1024)     // Per probe per loop pass, for fairness
+
+typedef struct RTSPProbeSession {
+    uint32_t identifier;
+    RTSPURL url;
+    RTSPCameraProbeCallback callback;
+    void *context;
+
+    RTSPTransportRef transport;
+    bool wantWrite;
+    RTSPByteBuffer input;
+    RTSPByteBuffer output;
+    int cseq;
+    int pendingCSeq;
+    RTSPAuthChallenge challenge;
+    bool authRetried;
+    char controlURL[1536];
+    char session[256];
+
+    double start;
+    double deadline;
+    double sentAt;                  // Last request
+    double playSentAt;
+    RTSPCodecConfig codecConfig;
+    RTSPCameraProbeResult result;
+    bool finished;
+
+    struct RTSPProbeSession *next;
+} RTSPProbeSession;
+
+struct RTSPCameraProbe {
+    RTSPCameraProbeConfig config;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    int wakeup[2];
+    bool running;
+    uint32_t nextIdentifier;
+    RTSPProbeSession *queueHead;    // Waiting for a slot, FIFO; guarded by the lock
+    RTSPProbeSession *queueTail;
+    RTSPCameraProbeStatistics statistics;
+
+    // Loop thread
+    RTSPProbeSession *active;
+    RTSPMessage message;
+    struct pollfd *pollfds;         // maxInFlight + 1
+    RTSPProbeSession **polled;
+};
+
+static double RTSPProbeNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+void RTSPCameraProbeConfigInit(RTSPCameraProbeConfig *config) {
+    config->maxInFlight = 16;
+    config->timeout = 5.0;
+    config->waitForMedia = true;
+    config->verifyCertificates = false;
+}
+
+static const char *RTSPProbeStageName(RTSPCameraProbeStage stage) {
+    switch (stage) {
+        case RTSPCameraProbeStageConnect: return "connect";
+        case RTSPCameraProbeStageOptions: return "OPTIONS";
+        case RTSPCameraProbeStageDescribe: return "DESCRIBE";
+        case RTSPCameraProbeStageSetup: return "SETUP";
+        case RTSPCameraProbeStagePlay: return "PLAY";
+        case RTSPCameraProbeStageMedia: return "the first RTP packet";
+        default: return "a slot";
+    }
+}
+
+#pragma mark - Requests
+
+static void RTSPProbeSendRequest(RTSPProbeSession *s, const char *method, const char *uri, const char *extraHeaders) {
+    RTSPByteBuffer *b = &s->output;
+    s->pendingCSeq = ++s->cseq;
+    RTSPByteBufferAppendFormat(b, "%s %s RTSP/1.0\r\nCSeq: %d\r\nUser-Agent: RTSP Rotator\r\n", method, uri, s->cseq);
+    if (s->challenge.valid) {
+        char authorization[1024];
+        if (RTSPAuthBuildHeader(&s->challenge, s->url.user, s->url.password, method, uri,
+                                authorization, sizeof(authorization))) {
+            RTSPByteBufferAppendFormat(b, "Authorization: %s\r\n", authorization);
+        }
+    }
+    if (s->session[0]) {
+        RTSPByteBufferAppendFormat(b, "Session: %s\r\n", s->session);
+    }
+    if (extraHeaders) {
+        RTSPByteBufferAppendString(b, extraHeaders);
+    }
+    RTSPByteBufferAppendString(b, "\r\n");
+    s->wantWrite = true;
+    s->sentAt = RTSPProbeNow();
+}
+
+static void RTSPProbeSendDescribe(RTSPProbeSession *s) {
+    s->result.stage = RTSPCameraProbeStageDescribe;
+    RTSPProbeSendRequest(s, "DESCRIBE", s->url.sanitized, "Accept: application/sdp\r\n");
+}
+
+static void RTSPProbeSendSetup(RTSPProbeSession *s) {
+    s->result.stage = RTSPCameraProbeStageSetup;
+    RTSPProbeSendRequest(s, "SETUP", s->controlURL, "Transport: RTP/AVP/TCP;unicast;interleaved=0-1\r\n");
+}
+
+static bool RTSPProbeRetryWithAuth(RTSPProbeSession *s, const RTSPMessage *m) {
+    char header[512];
+    if (m->statusCode != 401 || s->authRetried || s->url.user[0] == '\0' ||
+        !RTSPMessageHeader(m, "WWW-Authenticate", header, sizeof(header))) {
+        return false;
+    }
+    s->authRetried = true;
+    return RTSPAuthParseChallenge(header, &s->challenge);
+}
+
+#pragma mark - Results
+
+static void RTSPProbeFinish(RTSPProbeSession *s, RTSPCameraProbeStatus status, const char *message) {
+    if (s->finished) {
+        return;
+    }
+    s->finished = true;
+    s->result.status = status;
+    if (status == RTSPCameraProbeOK) {
+        s->result.stage = RTSPCameraProbeStageDone;
+    }
+    if (message) {
+        snprintf(s->result.message, sizeof(s->result.message), "%s", message);
+    }
+    if (s->start > 0) {
+        s->result.totalTime = RTSPProbeNow() - s->start;
+    }
+    if (s->transport && s->session[0]) {
+        // Best-effort TEARDOWN so the camera frees the session immediately
+        RTSPByteBufferReset(&s->output);
+        RTSPProbeSendRequest(s, "TEARDOWN", s->url.sanitized, NULL);
+        size_t written = 0;
+        RTSPTransportWrite(s->transport, s->output.data, s->output.length, &written);
+    }
+    if (s->transport) {
+        RTSPTransportRelease(s->transport);
+        s->transport = NULL;
+    }
+}
+
+static void RTSPProbeFail(RTSPProbeSession *s, RTSPCameraProbeStatus status, const char *format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+static void RTSPProbeFail(RTSPProbeSession *s, RTSPCameraProbeStatus status, const char *format, ...) {
+    char message[128];
+    va_list arguments;
+    va_start(arguments, format);
+    vsnprintf(message, sizeof(message), format, arguments);
+    va_end(arguments);
+    RTSPProbeFinish(s, status, message);
+}
+
+static void RTSPProbeSessionDestroy(RTSPProbeSession *s) {
+    if (s->transport) {
+        RTSPTransportRelease(s->transport);
+    }
+    RTSPByteBufferFree(&s->input);
+    RTSPByteBufferFree(&s->output);
+    free(s);
+}
+
+/// Delivers the result and frees the session. Never called with the lock held.
+static void RTSPProbeDeliver(RTSPCameraProbeRef engine, RTSPProbeSession *s, bool wasInFlight) {
+    if (s->callback) {
+        s->callback(s->context, s->identifier, &s->result);
+    }
+    pthread_mutex_lock(&engine->lock);
+    engine->statistics.completed++;
+    engine->statistics.succeeded += s->result.status == RTSPCameraProbeOK ? 1 : 0;
+    engine->statistics.timedOut += s->result.status == RTSPCameraProbeTimedOut ? 1 : 0;
+    if (wasInFlight) {
+        engine->statistics.inFlight--;
+    }
+    pthread_cond_broadcast(&engine->changed);
+    pthread_mutex_unlock(&engine->lock);
+    RTSPProbeSessionDestroy(s);
+}
+
+#pragma mark - Protocol
+
+static void RTSPProbeHandleDescribe(RTSPCameraProbeRef engine, RTSPProbeSession *s, const RTSPMessage *m) {
+    if (m->statusCode == 401) {
+        RTSPProbeFinish(s, RTSPCameraProbeUnauthorized,
+                        s->url.user[0] ? "Camera rejected the credentials" : "Camera requires credentials");
+        return;
+    }
+    if (m->statusCode != 200) {
+        RTSPProbeFail(s, RTSPCameraProbeRequestFailed, "DESCRIBE failed (%d)", m->statusCode);
+        return;
+    }
+
+    RTSPSDPVideoTrack track;
+    RTSPCodecConfigInit(&s->codecConfig, RTSPVideoCodecUnknown);
+    // An audio m= line anywhere in the description, not only the first one
+    s->result.hasAudio = strncmp(m->body, "m=audio", 7) == 0 || strstr(m->body, "\nm=audio") != NULL;
+    if (!RTSPSDPParseVideoTrack(m->body, &track, &s->codecConfig)) {
+        RTSPProbeFinish(s, RTSPCameraProbeNoVideo, "No H.264 or H.265 video track");
+        return;
+    }
+    s->result.codec = track.codec;
+    s->result.payloadType = track.payloadType;
+    s->result.width = s->codecConfig.width;
+    s->result.height = s->codecConfig.height;
+    if (s->codecConfig.sps.length > 0) {
+        RTSPCodecConfigCodecString(&s->codecConfig, s->result.codecString, sizeof(s->result.codecString));
+    }
+    if (!engine->config.waitForMedia) {
+        RTSPProbeFinish(s, RTSPCameraProbeOK, NULL);
+        return;
+    }
+
+    char base[1536];
+    if (!RTSPMessageHeader(m, "Content-Base", base, sizeof(base)) &&
+        !RTSPMessageHeader(m, "Content-Location", base, sizeof(base))) {
+        snprintf(base, sizeof(base), "%s", s->url.sanitized);
+    }
+    RTSPResolveControlURL(base, track.control, s->controlURL, sizeof(s->controlURL));
+    RTSPProbeSendSetup(s);
+}
+
+static void RTSPProbeHandleResponse(RTSPCameraProbeRef engine, RTSPProbeSession *s, const RTSPMessage *m) {
+    if (m->cseq != s->pendingCSeq) {
+        return;
+    }
+    s->pendingCSeq = -1;
+    s->result.statusCode = m->statusCode;
+    if (s->result.server[0] == '\0') {
+        RTSPMessageHeader(m, "Server", s->result.server, sizeof(s->result.server));
+    }
+    double elapsed = RTSPProbeNow() - s->sentAt;
+
+    switch (s->result.stage) {
+        case RTSPCameraProbeStageOptions: {
+            // OPTIONS only measures the round trip: cameras that refuse it
+            // or want credentials for it are judged by DESCRIBE. A challenge
+            // is kept so DESCRIBE is authenticated on the first try.
+            s->result.optionsTime = elapsed;
+            char header[512];
+            if (m->statusCode == 401 && s->url.user[0] &&
+                RTSPMessageHeader(m, "WWW-Authenticate", header, sizeof(header))) {
+                RTSPAuthParseChallenge(header, &s->challenge);
+            }
+            RTSPProbeSendDescribe(s);
+            return;
+        }
+
+        case RTSPCameraProbeStageDescribe:
+            s->result.describeTime += elapsed;
+            if (RTSPProbeRetryWithAuth(s, m)) {
+                RTSPProbeSendDescribe(s);
+                return;
+            }
+            RTSPProbeHandleDescribe(engine, s, m);
+            return;
+
+        case RTSPCameraProbeStageSetup: {
+            if (RTSPProbeRetryWithAuth(s, m)) {
+                RTSPProbeSendSetup(s);
+                return;
+            }
+            char session[256];
+            if (m->statusCode == 401) {
+                RTSPProbeFinish(s, RTSPCameraProbeUnauthorized, "Camera rejected the credentials");
+                return;
+            }
+            if (m->statusCode != 200 || !RTSPMessageHeader(m, "Session", session, sizeof(session))) {
+                RTSPProbeFail(s, RTSPCameraProbeRequestFailed, "SETUP failed (%d)", m->statusCode);
+                return;
+            }
+            char *separator = strchr(session, ';');
+            if (separator) {
+                *separator = '\0';
+            }
+            snprintf(s->session, sizeof(s->session), "%s", session);
+            s->result.stage = RTSPCameraProbeStagePlay;
+            RTSPProbeSendRequest(s, "PLAY", s->url.sanitized, "Range: npt=0.000-\r\n");
+            s->playSentAt = s->sentAt;
+            return;
+        }
+
+        case RTSPCameraProbeStagePlay:
+            if (m->statusCode != 200) {
+                RTSPProbeFail(s, RTSPCameraProbeRequestFailed, "PLAY failed (%d)", m->statusCode);
+                return;
+            }
+            s->result.stage = RTSPCameraProbeStageMedia;
+            return;
+
+        default:
+            return;
+    }
+}
+
+static void RTSPProbeHandleInterleaved(RTSPProbeSession *s, const RTSPMessage *m) {
+    if (m->channel != 0 || s->playSentAt == 0 || m->packetLength < 12) {
+        return; // RTCP and anything before PLAY
+    }
+    s->result.firstPacketTime = RTSPProbeNow() - s->playSentAt;
+
+    // Cameras that leave sprop-parameter-sets out of the SDP send the SPS in
+    // band, usually first; a single NAL unit packet is enough to size it.
+    const uint8_t *packet = m->packet;
+    size_t header = 12 + 4 * (size_t)(packet[0] & 0x0F);
+    if ((packet[0] & 0x10) && m->packetLength >= header + 4) {
+        header += 4 + 4 * (size_t)((packet[header + 2] << 8) | packet[header + 3]);
+    }
+    if (s->result.width == 0 && header < m->packetLength) {
+        RTSPCodecConfigObserveNAL(&s->codecConfig, packet + header, m->packetLength - header);
+        if (s->codecConfig.width) {
+            s->result.width = s->codecConfig.width;
+            s->result.height = s->codecConfig.height;
+            RTSPCodecConfigCodecString(&s->codecConfig, s->result.codecString, sizeof(s->result.codecString));
+        }
+    }
+    RTSPProbeFinish(s, RTSPCameraProbeOK, NULL);
+}
+
+#pragma mark - I/O
+
+static void RTSPProbeFlushOutput(RTSPProbeSession *s) {
+    while (s->output.length > 0) {
+        size_t written = 0;
+        RTSPTransportStatus status = RTSPTransportWrite(s->transport, s->output.data, s->output.length, &written);
+        if (status == RTSPTransportOK) {
+            RTSPByteBufferConsume(&s->output, written);
+        } else if (status == RTSPTransportWantWrite || status == RTSPTransportWantRead) {
+            s->wantWrite = true;
+            return;
+        } else {
+            RTSPProbeFinish(s, RTSPCameraProbeConnectionLost, "Connection lost");
+            return;
+        }
+    }
+    s->wantWrite = false;
+}
+
+static void RTSPProbeReadInput(RTSPCameraProbeRef engine, RTSPProbeSession *s) {
+    size_t budget = RTSP_PROBE_READ_BUDGET;
+    while (budget > 0 && !s->finished) {
+        if (!RTSPByteBufferReserve(&s->input, RTSP_PROBE_READ_CHUNK)) {
+            RTSPProbeFinish(s, RTSPCameraProbeConnectionLost, "Out of memory");
+            return;
+        }
+        size_t count = 0;
+        RTSPTransportStatus status = RTSPTransportRead(s->transport, s->input.data + s->input.length,
+                                                       RTSP_PROBE_READ_CHUNK, &count);
+        if (status == RTSPTransportWantRead || status == RTSPTransportWantWrite) {
+            break;
+        }
+        if (status != RTSPTransportOK) {
+            RTSPProbeFinish(s, RTSPCameraProbeConnectionLost,
+                            status == RTSPTransportClosed ? "Camera closed the connection" : "Connection lost");
+            return;
+        }
+        s->input.length += count;
+        budget = count < budget ? budget - count : 0;
+
+        size_t offset = 0;
+        for (;;) {
+            size_t consumed = 0;
+            RTSPParseResult result = RTSPMessageParse(s->input.data + offset, s->input.length - offset,
+                                                      &engine->message, &consumed);
+            if (result == RTSPParseNeedMore) {
+                break;
+            }
+            if (result == RTSPParseError) {
+                RTSPProbeFinish(s, RTSPCameraProbeConnectionLost, "Malformed RTSP message");
+                return;
+            }
+            if (result == RTSPParseInterleaved) {
+                RTSPProbeHandleInterleaved(s, &engine->message);
+            } else if (!engine->message.isRequest) {
+                RTSPProbeHandleResponse(engine, s, &engine->message);
+            }
+            if (s->finished) {
+                return;
+            }
+            offset += consumed;
+        }
+        RTSPByteBufferConsume(&s->input, offset);
+    }
+}
+
+static void RTSPProbeService(RTSPCameraProbeRef engine, RTSPProbeSession *s, short revents) {
+    if (s->finished) {
+        return;
+    }
+    if (s->result.stage == RTSPCameraProbeStageConnect) {
+        RTSPTransportStatus status = RTSPTransportHandshake(s->transport);
+        if (status == RTSPTransportWantRead || status == RTSPTransportWantWrite) {
+            s->wantWrite = status == RTSPTransportWantWrite;
+            return;
+        }
+        if (status != RTSPTransportOK) {
+            RTSPProbeFinish(s, RTSPCameraProbeConnectFailed, RTSPTransportFailureReason(s->transport));
+            return;
+        }
+        s->result.connectTime = RTSPProbeNow() - s->start;
+        s->result.stage = RTSPCameraProbeStageOptions;
+        RTSPProbeSendRequest(s, "OPTIONS", s->url.sanitized, NULL);
+    }
+
+    if ((revents & (POLLIN | POLLHUP | POLLERR)) || RTSPTransportHasPendingInput(s->transport)) {
+        RTSPProbeReadInput(engine, s);
+    }
+    if (!s->finished && s->output.length > 0) {
+        RTSPProbeFlushOutput(s);
+    }
+}
+
+static void RTSPProbeConnect(RTSPCameraProbeRef engine, RTSPProbeSession *s) {
+    s->start = RTSPProbeNow();
+    s->deadline = s->start + engine->config.timeout;
+    s->result.stage = RTSPCameraProbeStageConnect;
+    s->wantWrite = true;
+    // Host names resolve off the probe thread, so a bad one costs only this
+    // probe its timeout; the lookup wakes the loop when done
+    s->transport = RTSPTransportConnect(s->url.host, s->url.port, s->url.secure,
+                                        engine->config.verifyCertificates, engine->wakeup[1]);
+    if (!s->transport) {
+        RTSPProbeFinish(s, RTSPCameraProbeConnectFailed, "Out of memory");
+    }
+}
+
+#pragma mark - Event Loop
+
+/// Moves queued probes into free in-flight slots and starts them
+static void RTSPProbeAdmit(RTSPCameraProbeRef engine) {
+    for (;;) {
+        pthread_mutex_lock(&engine->lock);
+        RTSPProbeSession *s = NULL;
+        if (engine->queueHead && engine->statistics.inFlight < engine->config.maxInFlight) {
+            s = engine->queueHead;
+            engine->queueHead = s->next;
+            if (!engine->queueHead) {
+                engine->queueTail = NULL;
+            }
+            engine->statistics.queued--;
+            engine->statistics.inFlight++;
+            if (engine->statistics.inFlight > engine->statistics.peakInFlight) {
+                engine->statistics.peakInFlight = engine->statistics.inFlight;
+            }
+        }
+        pthread_mutex_unlock(&engine->lock);
+        if (!s) {
+            return;
+        }
+        RTSPProbeConnect(engine, s);
+        s->next = engine->active;
+        engine->active = s;
+    }
+}
+
+/// Hands finished probes to their callbacks as soon as they are known
+static void RTSPProbeReap(RTSPCameraProbeRef engine) {
+    RTSPProbeSession **link = &engine->active;
+    while (*link) {
+        RTSPProbeSession *s = *link;
+        if (s->finished) {
+            *link = s->next;
+            RTSPProbeDeliver(engine, s, true);
+        } else {
+            link = &s->next;
+        }
+    }
+}
+
+static void *RTSPProbeThread(void *argument) {
+    RTSPCameraProbeRef engine = argument;
+#if defined(__APPLE__)
+    pthread_setname_np("com.rtsp.probe");
+#elif defined(__linux__)
+    pthread_setname_np(pthread_self(), "rtsp-probe");
+#endif
+
+    for (;;) {
+        pthread_mutex_lock(&engine->lock);
+        bool running = engine->running;
+        pthread_mutex_unlock(&engine->lock);
+        if (!running) {
+            break;
+        }
+
+        RTSPProbeAdmit(engine);
+
+        double now = RTSPProbeNow();
+        double nextTimer = now + 1.0;
+        size_t nfds = 1;
+        engine->pollfds[0] = (struct pollfd){.fd = engine->wakeup[0], .events = POLLIN};
+        bool pendingWork = false;
+
+        for (RTSPProbeSession *s = engine->active; s; s = s->next) {
+            if (s->finished) {
+                pendingWork = true; // Failed while connecting; deliver without waiting
+                continue;
+            }
+            nextTimer = fmin(nextTimer, s->deadline);
+            pendingWork = pendingWork || RTSPTransportHasPendingInput(s->transport);
+            engine->polled[nfds] = s;
+            engine->pollfds[nfds++] = (struct pollfd){
+                .fd = RTSPTransportGetFD(s->transport),
+                .events = (short)(POLLIN | (s->wantWrite ? POLLOUT : 0)),
+            };
+        }
+
+        int timeout = pendingWork ? 0 : (int)fmax(0, ceil((nextTimer - now) * 1000.0));
+        int ready = poll(engine->pollfds, (nfds_t)nfds, timeout);
+        if (ready < 0 && errno != EINTR) {
+            usleep(1000);
+            continue;
+        }
+
+        if (engine->pollfds[0].revents & POLLIN) {
+            char drain[64];
+            while (read(engine->wakeup[0], drain, sizeof(drain)) > 0) {
+            }
+        }
+
+        for (size_t i = 1; i < nfds; i++) {
+            RTSPProbeSession *s = engine->polled[i];
+            if (engine->pollfds[i].revents || RTSPTransportHasPendingInput(s->transport)) {
+                RTSPProbeService(engine, s, engine->pollfds[i].revents);
+            }
+        }
+
+        now = RTSPProbeNow();
+        for (RTSPProbeSession *s = engine->active; s; s = s->next) {
+            if (!s->finished && now >= s->deadline) {
+                if (RTSPTransportIsResolving(s->transport)) {
+                    RTSPProbeFail(s, RTSPCameraProbeTimedOut, "Timed out resolving %s", s->url.host);
+                } else {
+                    RTSPProbeFail(s, RTSPCameraProbeTimedOut, "Timed out waiting for %s",
+                                  RTSPProbeStageName(s->result.stage));
+                }
+            } else if (!s->finished && s->result.stage == RTSPCameraProbeStageConnect) {
+                // Resolution and the per-address connect timeout advance on the clock too
+                RTSPProbeService(engine, s, 0);
+            }
+        }
+
+        RTSPProbeReap(engine);
+    }
+
+    return NULL;
+}
+
+static void RTSPProbeWake(RTSPCameraProbeRef engine) {
+    char byte = 1;
+    ssize_t result = write(engine->wakeup[1], &byte, 1);
+    (void)result; // A full pipe already guarantees a wakeup
+}
+
+#pragma mark - Public API
+
+RTSPCameraProbeRef RTSPCameraProbeCreate(const RTSPCameraProbeConfig *config) {
+    RTSPCameraProbeRef engine = calloc(1, sizeof(*engine));
+    if (!engine) {
+        return NULL;
+    }
+    if (config) {
+        engine->config = *config;
+    } else {
+        RTSPCameraProbeConfigInit(&engine->config);
+    }
+    if (engine->config.maxInFlight == 0) {
+        engine->config.maxInFlight = 16;
+    }
+    if (engine->config.timeout <= 0) {
+        engine->config.timeout = 5.0;
+    }
+
+    engine->pollfds = calloc(engine->config.maxInFlight + 1, sizeof(*engine->pollfds));
+    engine->polled = calloc(engine->config.maxInFlight + 1, sizeof(*engine->polled));
+    if (!engine->pollfds || !engine->polled || pipe(engine->wakeup) != 0) {
+        free(engine->pollfds);
+        free(engine->polled);
+        free(engine);
+        return NULL;
+    }
+    for (int i = 0; i < 2; i++) {
+        fcntl(engine->wakeup[i], F_SETFL, fcntl(engine->wakeup[i], F_GETFL, 0) | O_NONBLOCK);
+        fcntl(engine->wakeup[i], F_SETFD, FD_CLOEXEC);
+    }
+
+    pthread_mutex_init(&engine->lock, NULL);
+    pthread_cond_init(&engine->changed, NULL);
+    engine->running = true;
+    engine->nextIdentifier = 1;
+
+    if (pthread_create(&engine->thread, NULL, RTSPProbeThread, engine) != 0) {
+        close(engine->wakeup[0]);
+        close(engine->wakeup[1]);
+        pthread_mutex_destroy(&engine->lock);
+        pthread_cond_destroy(&engine->changed);
+        free(engine->pollfds);
+        free(engine->polled);
+        free(engine);
+        return NULL;
+    }
+    return engine;
+}
+
+void RTSPCameraProbeRelease(RTSPCameraProbeRef engine) {
+    if (!engine) {
+        return;
+    }
+    pthread_mutex_lock(&engine->lock);
+    engine->running = false;
+    pthread_mutex_unlock(&engine->lock);
+    RTSPProbeWake(engine);
+    pthread_join(engine->thread, NULL);
+
+    // Probes that finished on the last pass keep their result
+    while (engine->active) {
+        RTSPProbeSession *s = engine->active;
+        engine->active = s->next;
+        RTSPProbeFinish(s, RTSPCameraProbeCancelled, "Cancelled");
+        RTSPProbeDeliver(engine, s, true);
+    }
+    pthread_mutex_lock(&engine->lock);
+    RTSPProbeSession *queued = engine->queueHead;
+    engine->queueHead = engine->queueTail = NULL;
+    engine->statistics.queued = 0;
+    pthread_mutex_unlock(&engine->lock);
+    while (queued) {
+        RTSPProbeSession *next = queued->next;
+        RTSPProbeFinish(queued, RTSPCameraProbeCancelled, "Cancelled");
+        RTSPProbeDeliver(engine, queued, false);
+        queued = next;
+    }
+
+    close(engine->wakeup[0]);
+    close(engine->wakeup[1]);
+    pthread_mutex_destroy(&engine->lock);
+    pthread_cond_destroy(&engine->changed);
+    free(engine->pollfds);
+    free(engine->polled);
+    free(engine);
+}
+
+uint32_t RTSPCameraProbeSubmit(RTSPCameraProbeRef engine, const char *url,
+                               RTSPCameraProbeCallback callback, void *context) {
+    if (!engine || !url) {
+        return 0;
+    }
+    RTSPProbeSession *s = calloc(1, sizeof(*s));
+    if (!s) {
+        return 0;
+    }
+    if (!RTSPURLParse(url, &s->url) || (s->url.secure && !RTSPTransportSupportsTLS())) {
+        free(s);
+        return 0;
+    }
+    s->callback = callback;
+    s->context = context;
+    s->pendingCSeq = -1;
+    s->result.stage = RTSPCameraProbeStageQueued;
+    RTSPByteBufferInit(&s->input);
+    RTSPByteBufferInit(&s->output);
+
+    pthread_mutex_lock(&engine->lock);
+    if (!engine->running) {
+        pthread_mutex_unlock(&engine->lock);
+        RTSPProbeSessionDestroy(s);
+        return 0;
+    }
+    s->identifier = engine->nextIdentifier++;
+    if (engine->queueTail) {
+        engine->queueTail->next = s;
+    } else {
+        engine->queueHead = s;
+    }
+    engine->queueTail = s;
+    engine->statistics.submitted++;
+    engine->statistics.queued++;
+    uint32_t identifier = s->identifier;
+    pthread_mutex_unlock(&engine->lock);
+
+    RTSPProbeWake(engine);
+    return identifier;
+}
+
+void RTSPCameraProbeWait(RTSPCameraProbeRef engine) {
+    if (!engine) {
+        return;
+    }
+    pthread_mutex_lock(&engine->lock);
+    while (engine->running && engine->statistics.completed < engine->statistics.submitted) {
+        pthread_cond_wait(&engine->changed, &engine->lock);
+    }
+    pthread_mutex_unlock(&engine->lock);
+}
+
+RTSPCameraProbeStatistics RTSPCameraProbeGetStatistics(RTSPCameraProbeRef engine) {
+    RTSPCameraProbeStatistics statistics = {0};
+    if (!engine) {
+        return statistics;
+    }
+    pthread_mutex_lock(&engine->lock);
+    statistics = engine->statistics;
+    pthread_mutex_unlock(&engine->lock);
+    return statistics;
+}
@@ -0,0 +1,123 @@
+//
+//  RTSPCameraProbe.h
+//  RTSP Rotator
+//
+//  Lightweight RTSP(S) health probe for many cameras at once. One event-loop
+//  thread runs up to maxInFlight probes concurrently; each one connects,
+//  sends OPTIONS and DESCRIBE (answering a Digest / Basic challenge), reads
+//  the video track from the SDP and, unless told not to, sets up an
+//  interleaved session and waits for the first RTP packet before tearing
+//  it down. Nothing is decoded. Every probe has its own deadline and its
+//  result is delivered as soon as it is known, so one dead camera never
+//  holds up the report for the others.
+//
+//  Portable C so it can be benchmarked on Linux against the loopback
+//  server in Benchmarks/. See Benchmarks/camera_probe_bench.c.
+//
+
+#ifndef RTSPCameraProbe_h
+#define RTSPCameraProbe_h
+
+#include "RTSPCodecConfig.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t maxInFlight;           // Probes connected at once; the rest wait their turn. Default 16
+    double timeout;                 // Seconds from connect to result, per probe. Default 5
+    bool waitForMedia;              // SETUP + PLAY and wait for the first RTP packet. Default true
+    bool verifyCertificates;        // Default false (UniFi and most NVRs use self-signed certificates)
+} RTSPCameraProbeConfig;
+
+void RTSPCameraProbeConfigInit(RTSPCameraProbeConfig *config);
+
+typedef enum {
+    RTSPCameraProbeOK = 0,
+    RTSPCameraProbeConnectFailed,   // Refused, unreachable or TLS handshake failed
+    RTSPCameraProbeTimedOut,        // The deadline passed; `stage` says where
+    RTSPCameraProbeUnauthorized,    // 401 with missing or rejected credentials
+    RTSPCameraProbeRequestFailed,   // Any other error status; see `statusCode`
+    RTSPCameraProbeNoVideo,         // No H.264 or H.265 track in the SDP
+    RTSPCameraProbeConnectionLost,  // Closed or malformed reply mid-probe
+    RTSPCameraProbeCancelled        // The probe engine was released first
+} RTSPCameraProbeStatus;
+
+typedef enum {
+    RTSPCameraProbeStageQueued = 0,
+    RTSPCameraProbeStageConnect,    // TCP connect, TLS handshake
+    RTSPCameraProbeStageOptions,
+    RTSPCameraProbeStageDescribe,
+    RTSPCameraProbeStageSetup,
+    RTSPCameraProbeStagePlay,
+    RTSPCameraProbeStageMedia,      // Waiting for the first RTP packet
+    RTSPCameraProbeStageDone
+} RTSPCameraProbeStage;
+
+typedef struct {
+    RTSPCameraProbeStatus status;
+    RTSPCameraProbeStage stage;     // Last stage reached; for failures, the one that failed
+    char message[128];              // Human-readable failure, empty on success
+    int statusCode;                 // Last RTSP status code, 0 if none
+    char server[64];                // Server header, if sent
+
+    // Seconds; 0 for stages that were not reached
+    double connectTime;             // TCP connect + TLS handshake
+    double optionsTime;             // OPTIONS round trip
+    double describeTime;            // DESCRIBE round trip(s), including an auth retry
+    double firstPacketTime;         // PLAY sent to first RTP packet
+    double totalTime;               // Connect to result
+
+    RTSPVideoCodec codec;
+    int payloadType;
+    uint32_t width;                 // From the SPS (SDP or first packet), 0 if not seen
+    uint32_t height;
+    char codecString[32];           // RFC 6381, e.g. "avc1.640029", when the SPS is known
+    bool hasAudio;                  // SDP carries an audio track
+} RTSPCameraProbeResult;
+
+/// Called exactly once per accepted probe, on the probe thread (or, for
+/// probes cancelled by Release, on the releasing thread). Must not block
+/// and must not call back into the engine except Submit.
+typedef void (*RTSPCameraProbeCallback)(void *context, uint32_t probeID, const RTSPCameraProbeResult *result);
+
+typedef struct {
+    uint64_t submitted;
+    uint64_t completed;             // Results delivered, including failures
+    uint64_t succeeded;
+    uint64_t timedOut;
+    uint32_t inFlight;              // Connected right now
+    uint32_t queued;                // Waiting for an in-flight slot
+    uint32_t peakInFlight;
+} RTSPCameraProbeStatistics;
+
+typedef struct RTSPCameraProbe *RTSPCameraProbeRef;
+
+/// Starts the probe thread. `config` may be NULL for defaults.
+RTSPCameraProbeRef RTSPCameraProbeCreate(const RTSPCameraProbeConfig *config);
+
+/// Cancels every probe that has not finished (each still gets its
+/// callback, with RTSPCameraProbeCancelled) and joins the thread
+void RTSPCameraProbeRelease(RTSPCameraProbeRef probe);
+
+/// Queue a probe of an rtsp:// or rtsps:// URL (credentials in the userinfo).
+/// Returns a probe ID, or 0 if the URL is invalid or TLS is unavailable;
+/// the callback is not called then.
+uint32_t RTSPCameraProbeSubmit(RTSPCameraProbeRef probe, const char *url,
+                               RTSPCameraProbeCallback callback, void *context);
+
+/// Blocks until every probe submitted so far has delivered its result
+void RTSPCameraProbeWait(RTSPCameraProbeRef probe);
+
+RTSPCameraProbeStatistics RTSPCameraProbeGetStatistics(RTSPCameraProbeRef probe);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RTSPCameraProbe_h */
@@ -0,0 +1,601 @@
+//
+//  RTSPClipRecorder.c
+//  RTSP Rotator
+//
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE     // pthread_setname_np
+#endif
+
+#include "RTSPClipRecorder.h"
+#include "RTSPByteBuffer.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/// Engine output, shared by the pre-roll and the write queue
+typedef struct RTSPClipChunk {
+    atomic_uint references;
+    struct RTSPClipChunk *next;     // Pre-roll order, under the lock
+    double duration;
+    bool independent;
+    size_t length;
+    uint8_t data[];
+} RTSPClipChunk;
+
+typedef enum {
+    RTSPClipWriteOpen = 0,
+    RTSPClipWriteMedia,
+    RTSPClipWriteClose
+} RTSPClipWriteType;
+
+typedef struct RTSPClipWrite {
+    RTSPClipWriteType type;
+    struct RTSPClip *clip;
+    RTSPClipChunk *chunk;           // Media only
+    bool preRoll;
+    struct RTSPClipWrite *next;
+} RTSPClipWrite;
+
+/// One output file. The producer hands it to the writer with its open
+/// write and lets go of it with its close write; the writer frees it.
+typedef struct RTSPClip {
+    uint32_t id;
+    char *path;
+    RTSPClipChunk *init;
+    RTSPClipEndReason reason;       // Set by the producer before the close write
+    atomic_bool failed;             // Set by the writer, ends the clip on the next media
+
+    // Writer thread only
+    int fd;
+    int error;
+    double duration;
+    double preRoll;
+    uint64_t bytes;
+    uint32_t fragments;
+    bool hasBase;
+    uint64_t baseDecodeTime;
+
+    // Never allocated separately, so opening and closing cannot fail
+    RTSPClipWrite openWrite;
+    RTSPClipWrite closeWrite;
+} RTSPClip;
+
+struct RTSPClipRecorder {
+    RTSPClipRecorderConfig config;
+    RTSPClipFinishedCallback finished;
+    void *context;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;            // Writes queued, or stopping
+    bool running;
+
+    // Under the lock
+    RTSPClipChunk *init;
+    uint32_t initID;
+    RTSPClipChunk *first;           // Pre-roll, oldest first; always starts with a keyframe
+    RTSPClipChunk *last;
+    RTSPClipChunk *lastKeyframe;    // Start of the current GOP
+    double preRollDuration;
+    size_t preRollBytes;
+    RTSPClipWrite *queueHead;
+    RTSPClipWrite *queueTail;
+    RTSPClip *clip;                 // Being recorded, NULL when idle
+    bool triggered;
+    double clipDuration;
+    double postRollLeft;
+    uint32_t nextClipID;
+    uint32_t clips;
+    uint64_t droppedMedia;
+
+    _Atomic uint64_t bytesWritten;
+    RTSPByteBuffer scratch;         // Writer thread only
+};
+
+void RTSPClipRecorderConfigInit(RTSPClipRecorderConfig *config) {
+    config->preRollDuration = 15.0;
+    config->maxPreRollBytes = 32 * 1024 * 1024;
+    config->postRollDuration = 10.0;
+}
+
+#pragma mark - Chunks
+
+static RTSPClipChunk *RTSPClipChunkCreate(const uint8_t *data, size_t length, double duration, bool independent) {
+    RTSPClipChunk *chunk = malloc(sizeof(RTSPClipChunk) + length);
+    if (!chunk) {
+        return NULL;
+    }
+    atomic_init(&chunk->references, 1);
+    chunk->next = NULL;
+    chunk->duration = duration;
+    chunk->independent = independent;
+    chunk->length = length;
+    memcpy(chunk->data, data, length);
+    return chunk;
+}
+
+static RTSPClipChunk *RTSPClipChunkRetain(RTSPClipChunk *chunk) {
+    atomic_fetch_add_explicit(&chunk->references, 1, memory_order_relaxed);
+    return chunk;
+}
+
+static void RTSPClipChunkRelease(RTSPClipChunk *chunk) {
+    if (chunk && atomic_fetch_sub_explicit(&chunk->references, 1, memory_order_acq_rel) == 1) {
+        free(chunk);
+    }
+}
+
+#pragma mark - Pre-roll
+
+static void RTSPClipRecorderDropFirst(RTSPClipRecorderRef recorder) {
+    RTSPClipChunk *chunk = recorder->first;
+    recorder->first = chunk->next;
+    if (!recorder->first) {
+        recorder->last = NULL;
+        recorder->lastKeyframe = NULL;
+    }
+    recorder->preRollDuration -= chunk->duration;
+    recorder->preRollBytes -= chunk->length;
+    RTSPClipChunkRelease(chunk);
+}
+
+static void RTSPClipRecorderClearPreRoll(RTSPClipRecorderRef recorder) {
+    while (recorder->first) {
+        RTSPClipRecorderDropFirst(recorder);
+    }
+    recorder->preRollDuration = 0;
+    recorder->preRollBytes = 0;
+}
+
+/// Drop the oldest GOPs while the rest still covers the pre-roll and while
+/// over the byte limit; the current GOP always stays
+static void RTSPClipRecorderTrimPreRoll(RTSPClipRecorderRef recorder) {
+    while (recorder->first != recorder->lastKeyframe) {
+        double duration = 0;
+        for (RTSPClipChunk *chunk = recorder->first; chunk; chunk = chunk->next) {
+            if (chunk != recorder->first && chunk->independent) {
+                break;
+            }
+            duration += chunk->duration;
+        }
+        // Part durations are rounded; a millisecond short still counts as covered
+        if (recorder->preRollDuration - duration < recorder->config.preRollDuration - 0.001 &&
+            recorder->preRollBytes <= recorder->config.maxPreRollBytes) {
+            break;
+        }
+        do {
+            RTSPClipRecorderDropFirst(recorder);
+        } while (!recorder->first->independent);
+    }
+}
+
+#pragma mark - Write Queue
+
+static void RTSPClipRecorderEnqueue(RTSPClipRecorderRef recorder, RTSPClipWrite *write) {
+    write->next = NULL;
+    if (recorder->queueTail) {
+        recorder->queueTail->next = write;
+    } else {
+        recorder->queueHead = write;
+    }
+    recorder->queueTail = write;
+}
+
+static void RTSPClipRecorderEnqueueMedia(RTSPClipRecorderRef recorder, RTSPClipChunk *chunk, bool preRoll) {
+    RTSPClip *clip = recorder->clip;
+    RTSPClipWrite *write = malloc(sizeof(RTSPClipWrite));
+    if (!write) {
+        // A hole in the media would corrupt the file; end it instead
+        atomic_store_explicit(&clip->failed, true, memory_order_relaxed);
+        return;
+    }
+    write->type = RTSPClipWriteMedia;
+    write->clip = clip;
+    write->chunk = RTSPClipChunkRetain(chunk);
+    write->preRoll = preRoll;
+    RTSPClipRecorderEnqueue(recorder, write);
+    recorder->clipDuration += chunk->duration;
+}
+
+static uint32_t RTSPClipRecorderBeginClip(RTSPClipRecorderRef recorder, const char *path, bool includePreRoll) {
+    if (!recorder->init || !recorder->first || !path) {
+        return 0;
+    }
+    RTSPClip *clip = calloc(1, sizeof(RTSPClip));
+    char *copy = strdup(path);
+    if (!clip || !copy) {
+        free(clip);
+        free(copy);
+        return 0;
+    }
+    if (++recorder->nextClipID == 0) {
+        recorder->nextClipID = 1;
+    }
+    clip->id = recorder->nextClipID;
+    clip->path = copy;
+    clip->init = RTSPClipChunkRetain(recorder->init);
+    clip->fd = -1;
+    atomic_init(&clip->failed, false);
+    clip->openWrite = (RTSPClipWrite){.type = RTSPClipWriteOpen, .clip = clip};
+    clip->closeWrite = (RTSPClipWrite){.type = RTSPClipWriteClose, .clip = clip};
+    RTSPClipRecorderEnqueue(recorder, &clip->openWrite);
+
+    recorder->clip = clip;
+    recorder->clipDuration = 0;
+    RTSPClipChunk *start = includePreRoll ? recorder->first : recorder->lastKeyframe;
+    for (RTSPClipChunk *chunk = start; chunk; chunk = chunk->next) {
+        RTSPClipRecorderEnqueueMedia(recorder, chunk, true);
+    }
+    pthread_cond_signal(&recorder->wake);
+    return clip->id;
+}
+
+static void RTSPClipRecorderEndClip(RTSPClipRecorderRef recorder, RTSPClipEndReason reason) {
+    RTSPClip *clip = recorder->clip;
+    if (!clip) {
+        return;
+    }
+    clip->reason = reason;
+    RTSPClipRecorderEnqueue(recorder, &clip->closeWrite);
+    recorder->clip = NULL;
+    recorder->triggered = false;
+    recorder->clipDuration = 0;
+    pthread_cond_signal(&recorder->wake);
+}
+
+#pragma mark - Writer
+
+static bool RTSPClipWriteAll(int fd, const uint8_t *bytes, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, bytes, length);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        bytes += written;
+        length -= (size_t)written;
+    }
+    return true;
+}
+
+static uint32_t RTSPClipReadU32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void RTSPClipWriteU32(uint8_t *p, uint32_t value) {
+    p[0] = (uint8_t)(value >> 24);
+    p[1] = (uint8_t)(value >> 16);
+    p[2] = (uint8_t)(value >> 8);
+    p[3] = (uint8_t)value;
+}
+
+/// First child box of `type` in [data, data + length), or NULL
+static uint8_t *RTSPClipFindBox(uint8_t *data, size_t length, const char *type, size_t *boxLength) {
+    size_t offset = 0;
+    while (offset + 8 <= length) {
+        size_t size = RTSPClipReadU32(data + offset);
+        if (size < 8 || size > length - offset) {
+            return NULL;
+        }
+        if (memcmp(data + offset + 4, type, 4) == 0) {
+            *boxLength = size;
+            return data + offset;
+        }
+        offset += size;
+    }
+    return NULL;
+}
+
+/// Renumber a moof from 1 and move its decode time so the clip starts at 0
+static void RTSPClipRebaseFragment(RTSPClip *clip, uint8_t *moof, size_t length) {
+    size_t mfhdLength = 0, trafLength = 0, tfdtLength = 0;
+    uint8_t *mfhd = RTSPClipFindBox(moof + 8, length - 8, "mfhd", &mfhdLength);
+    if (mfhd && mfhdLength >= 16) {
+        RTSPClipWriteU32(mfhd + 12, clip->fragments + 1);
+    }
+    uint8_t *traf = RTSPClipFindBox(moof + 8, length - 8, "traf", &trafLength);
+    uint8_t *tfdt = traf ? RTSPClipFindBox(traf + 8, trafLength - 8, "tfdt", &tfdtLength) : NULL;
+    if (!tfdt || tfdtLength < 16) {
+        return;
+    }
+    bool wide = tfdt[8] == 1 && tfdtLength >= 20;
+    uint64_t decodeTime = RTSPClipReadU32(tfdt + 12);
+    if (wide) {
+        decodeTime = (decodeTime << 32) | RTSPClipReadU32(tfdt + 16);
+    }
+    if (!clip->hasBase) {
+        clip->hasBase = true;
+        clip->baseDecodeTime = decodeTime;
+    }
+    decodeTime = decodeTime > clip->baseDecodeTime ? decodeTime - clip->baseDecodeTime : 0;
+    if (wide) {
+        RTSPClipWriteU32(tfdt + 12, (uint32_t)(decodeTime >> 32));
+        RTSPClipWriteU32(tfdt + 16, (uint32_t)decodeTime);
+    } else {
+        RTSPClipWriteU32(tfdt + 12, (uint32_t)decodeTime);
+    }
+}
+
+static bool RTSPClipRecorderWriteMedia(RTSPClipRecorderRef recorder, RTSPClip *clip, const RTSPClipChunk *chunk) {
+    RTSPByteBuffer *scratch = &recorder->scratch;
+    RTSPByteBufferReset(scratch);
+    RTSPByteBufferAppend(scratch, chunk->data, chunk->length);
+    if (scratch->failed) {
+        scratch->failed = false;
+        errno = ENOMEM;
+        return false;
+    }
+    size_t offset = 0;
+    while (offset + 8 <= scratch->length) {
+        uint8_t *box = scratch->data + offset;
+        size_t size = RTSPClipReadU32(box);
+        if (size < 8 || size > scratch->length - offset) {
+            break;
+        }
+        if (memcmp(box + 4, "moof", 4) == 0) {
+            RTSPClipRebaseFragment(clip, box, size);
+            clip->fragments++;
+        }
+        offset += size;
+    }
+    return RTSPClipWriteAll(clip->fd, scratch->data, scratch->length);
+}
+
+static void RTSPClipRecorderProcess(RTSPClipRecorderRef recorder, RTSPClipWrite *write) {
+    RTSPClip *clip = write->clip;
+    switch (write->type) {
+        case RTSPClipWriteOpen:
+            clip->fd = open(clip->path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (clip->fd < 0 || !RTSPClipWriteAll(clip->fd, clip->init->data, clip->init->length)) {
+                clip->error = errno;
+            } else {
+                clip->bytes += clip->init->length;
+            }
+            break;
+
+        case RTSPClipWriteMedia:
+            if (clip->error == 0) {
+                if (RTSPClipRecorderWriteMedia(recorder, clip, write->chunk)) {
+                    clip->bytes += write->chunk->length;
+                    clip->duration += write->chunk->duration;
+                    clip->preRoll += write->preRoll ? write->chunk->duration : 0;
+                    atomic_fetch_add_explicit(&recorder->bytesWritten, write->chunk->length, memory_order_relaxed);
+                } else {
+                    clip->error = errno;
+                }
+            }
+            RTSPClipChunkRelease(write->chunk);
+            free(write);
+            break;
+
+        case RTSPClipWriteClose: {
+            if (clip->fd >= 0 && close(clip->fd) != 0 && clip->error == 0) {
+                clip->error = errno;
+            }
+            RTSPClipInfo info = {
+                .clipID = clip->id,
+                .reason = clip->error ? RTSPClipEndWriteFailed : clip->reason,
+                .path = clip->path,
+                .duration = clip->duration,
+                .preRoll = clip->preRoll,
+                .bytes = clip->bytes,
+                .fragments = clip->fragments,
+                .error = clip->error,
+            };
+            if (recorder->finished) {
+                recorder->finished(recorder->context, &info);
+            }
+            pthread_mutex_lock(&recorder->lock);
+            recorder->clips++;
+            pthread_mutex_unlock(&recorder->lock);
+            RTSPClipChunkRelease(clip->init);
+            free(clip->path);
+            free(clip);
+            return;
+        }
+    }
+    if (clip->error != 0) {
+        atomic_store_explicit(&clip->failed, true, memory_order_relaxed);
+    }
+}
+
+static void *RTSPClipRecorderThread(void *argument) {
+    RTSPClipRecorderRef recorder = argument;
+#if defined(__APPLE__)
+    pthread_setname_np("com.rtsp.clip-recorder");
+#elif defined(__linux__)
+    pthread_setname_np(pthread_self(), "rtsp-clips");
+#endif
+
+    pthread_mutex_lock(&recorder->lock);
+    for (;;) {
+        while (!recorder->queueHead && recorder->running) {
+            pthread_cond_wait(&recorder->wake, &recorder->lock);
+        }
+        RTSPClipWrite *write = recorder->queueHead;
+        if (!write) {
+            break; // Stopping, and every clip is closed
+        }
+        recorder->queueHead = write->next;
+        if (!recorder->queueHead) {
+            recorder->queueTail = NULL;
+        }
+        pthread_mutex_unlock(&recorder->lock);
+        RTSPClipRecorderProcess(recorder, write);
+        pthread_mutex_lock(&recorder->lock);
+    }
+    pthread_mutex_unlock(&recorder->lock);
+    return NULL;
+}
+
+#pragma mark - Lifecycle
+
+RTSPClipRecorderRef RTSPClipRecorderCreate(const RTSPClipRecorderConfig *config,
+                                           RTSPClipFinishedCallback finished, void *context) {
+    RTSPClipRecorderRef recorder = calloc(1, sizeof(struct RTSPClipRecorder));
+    if (!recorder) {
+        return NULL;
+    }
+    if (config) {
+        recorder->config = *config;
+    } else {
+        RTSPClipRecorderConfigInit(&recorder->config);
+    }
+    if (recorder->config.preRollDuration < 0) {
+        recorder->config.preRollDuration = 0;
+    }
+    if (recorder->config.postRollDuration < 0) {
+        recorder->config.postRollDuration = 0;
+    }
+    recorder->finished = finished;
+    recorder->context = context;
+    recorder->running = true;
+    RTSPByteBufferInit(&recorder->scratch);
+    pthread_mutex_init(&recorder->lock, NULL);
+    pthread_cond_init(&recorder->wake, NULL);
+    if (pthread_create(&recorder->thread, NULL, RTSPClipRecorderThread, recorder) != 0) {
+        pthread_cond_destroy(&recorder->wake);
+        pthread_mutex_destroy(&recorder->lock);
+        free(recorder);
+        return NULL;
+    }
+    return recorder;
+}
+
+void RTSPClipRecorderRelease(RTSPClipRecorderRef recorder) {
+    if (!recorder) {
+        return;
+    }
+    pthread_mutex_lock(&recorder->lock);
+    RTSPClipRecorderEndClip(recorder, RTSPClipEndStopped);
+    recorder->running = false;
+    pthread_cond_signal(&recorder->wake);
+    pthread_mutex_unlock(&recorder->lock);
+    pthread_join(recorder->thread, NULL);
+
+    RTSPClipRecorderClearPreRoll(recorder);
+    RTSPClipChunkRelease(recorder->init);
+    RTSPByteBufferFree(&recorder->scratch);
+    pthread_cond_destroy(&recorder->wake);
+    pthread_mutex_destroy(&recorder->lock);
+    free(recorder);
+}
+
+#pragma mark - Media
+
+void RTSPClipRecorderAddInitSegment(RTSPClipRecorderRef recorder, uint32_t initID, const uint8_t *data, size_t length) {
+    pthread_mutex_lock(&recorder->lock);
+    recorder->initID = initID;
+    // A reconnect that announces the same parameter sets changes nothing
+    bool same = recorder->init && recorder->init->length == length && memcmp(recorder->init->data, data, length) == 0;
+    if (!same) {
+        RTSPClipRecorderEndClip(recorder, RTSPClipEndConfigurationChanged);
+        RTSPClipRecorderClearPreRoll(recorder);
+        RTSPClipChunkRelease(recorder->init);
+        recorder->init = RTSPClipChunkCreate(data, length, 0, true);
+    }
+    pthread_mutex_unlock(&recorder->lock);
+}
+
+void RTSPClipRecorderAddMedia(RTSPClipRecorderRef recorder, const RTSPRemuxMediaInfo *info, const uint8_t *data, size_t length) {
+    pthread_mutex_lock(&recorder->lock);
+    if (!recorder->init || info->initID != recorder->initID || (!recorder->first && !info->independent)) {
+        recorder->droppedMedia++;
+        pthread_mutex_unlock(&recorder->lock);
+        return;
+    }
+    RTSPClipChunk *chunk = RTSPClipChunkCreate(data, length, info->duration, info->independent);
+    if (!chunk) {
+        // Without this chunk the GOP cannot be decoded; start over at the next keyframe
+        RTSPClipRecorderEndClip(recorder, RTSPClipEndWriteFailed);
+        RTSPClipRecorderClearPreRoll(recorder);
+        recorder->droppedMedia++;
+        pthread_mutex_unlock(&recorder->lock);
+        return;
+    }
+
+    if (recorder->last) {
+        recorder->last->next = chunk;
+    } else {
+        recorder->first = chunk;
+    }
+    recorder->last = chunk;
+    if (chunk->independent) {
+        recorder->lastKeyframe = chunk;
+    }
+    recorder->preRollDuration += chunk->duration;
+    recorder->preRollBytes += chunk->length;
+
+    RTSPClip *clip = recorder->clip;
+    if (clip) {
+        if (atomic_load_explicit(&clip->failed, memory_order_relaxed)) {
+            RTSPClipRecorderEndClip(recorder, RTSPClipEndWriteFailed);
+        } else {
+            RTSPClipRecorderEnqueueMedia(recorder, chunk, false);
+            pthread_cond_signal(&recorder->wake);
+            if (recorder->triggered) {
+                recorder->postRollLeft -= chunk->duration;
+                if (recorder->postRollLeft <= 0) {
+                    RTSPClipRecorderEndClip(recorder, RTSPClipEndPostRollElapsed);
+                }
+            }
+        }
+    }
+    RTSPClipRecorderTrimPreRoll(recorder);
+    pthread_mutex_unlock(&recorder->lock);
+}
+
+#pragma mark - Clips
+
+uint32_t RTSPClipRecorderStart(RTSPClipRecorderRef recorder, const char *path, bool includePreRoll) {
+    pthread_mutex_lock(&recorder->lock);
+    uint32_t clipID = recorder->clip ? 0 : RTSPClipRecorderBeginClip(recorder, path, includePreRoll);
+    pthread_mutex_unlock(&recorder->lock);
+    return clipID;
+}
+
+uint32_t RTSPClipRecorderTrigger(RTSPClipRecorderRef recorder, const char *path) {
+    pthread_mutex_lock(&recorder->lock);
+    uint32_t clipID = 0;
+    if (recorder->clip) {
+        clipID = recorder->clip->id;
+    } else {
+        clipID = RTSPClipRecorderBeginClip(recorder, path, true);
+        recorder->triggered = clipID != 0;
+    }
+    if (recorder->triggered) {
+        recorder->postRollLeft = recorder->config.postRollDuration;
+    }
+    pthread_mutex_unlock(&recorder->lock);
+    return clipID;
+}
+
+void RTSPClipRecorderStop(RTSPClipRecorderRef recorder) {
+    pthread_mutex_lock(&recorder->lock);
+    RTSPClipRecorderEndClip(recorder, RTSPClipEndStopped);
+    pthread_mutex_unlock(&recorder->lock);
+}
+
+RTSPClipRecorderStatistics RTSPClipRecorderGetStatistics(RTSPClipRecorderRef recorder) {
+    pthread_mutex_lock(&recorder->lock);
+    RTSPClipRecorderStatistics statistics = {
+        .preRollDuration = recorder->preRollDuration,
+        .preRollBytes = recorder->preRollBytes,
+        .clipID = recorder->clip ? recorder->clip->id : 0,
+        .triggered = recorder->triggered,
+        .clipDuration = recorder->clipDuration,
+        .clips = recorder->clips,
+        .bytesWritten = atomic_load_explicit(&recorder->bytesWritten, memory_order_relaxed),
+        .droppedMedia = recorder->droppedMedia,
+    };
+    pthread_mutex_unlock(&recorder->lock);
+    return statistics;
+}
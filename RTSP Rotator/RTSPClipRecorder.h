@@ -0,0 +1,111 @@
+//
+//  RTSPClipRecorder.h
+//  RTSP Rotator
+//
+//  Records one camera to fragmented MP4 files by stream copy: the init
+//  segment and moof + mdat fragments RTSPRemuxEngine already produced are
+//  written as they are, with only the fragment sequence numbers and decode
+//  times rebased so each file starts at zero. Nothing is decoded or encoded.
+//
+//  The newest media is kept in RAM as whole GOPs (the pre-roll), so a clip
+//  started by a motion or alert trigger opens with the lead-up to it. A
+//  triggered clip runs until postRollDuration after its last trigger; a
+//  started recording runs until stopped.
+//
+//  Media is added from the engine thread and never waits for the disk: a
+//  writer thread owned by the recorder does the file I/O. See
+//  Benchmarks/clip_recorder_bench.c.
+//
+
+#ifndef RTSPClipRecorder_h
+#define RTSPClipRecorder_h
+
+#include "RTSPRemuxEngine.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    double preRollDuration;         // Seconds of media kept ahead of a trigger, rounded up to whole GOPs. Default 15
+    size_t maxPreRollBytes;         // Upper bound on the pre-roll; the oldest GOPs go first. Default 32 MB
+    double postRollDuration;        // Seconds a triggered clip runs past its last trigger. Default 10
+} RTSPClipRecorderConfig;
+
+void RTSPClipRecorderConfigInit(RTSPClipRecorderConfig *config);
+
+typedef enum {
+    RTSPClipEndStopped = 0,             // RTSPClipRecorderStop or Release
+    RTSPClipEndPostRollElapsed,         // A triggered clip ran postRollDuration past its last trigger
+    RTSPClipEndConfigurationChanged,    // New init segment (codec or resolution change)
+    RTSPClipEndWriteFailed              // The file could not be created or written
+} RTSPClipEndReason;
+
+/// A finished clip. `path` is only valid during the callback.
+typedef struct {
+    uint32_t clipID;
+    RTSPClipEndReason reason;
+    const char *path;
+    double duration;                // Seconds of media in the file
+    double preRoll;                 // Of which recorded before the clip was started
+    uint64_t bytes;                 // File size
+    uint32_t fragments;             // moof + mdat pairs
+    int error;                      // errno for RTSPClipEndWriteFailed
+} RTSPClipInfo;
+
+/// Runs on the writer thread once the file is closed; must not call back
+/// into the recorder's Release
+typedef void (*RTSPClipFinishedCallback)(void *context, const RTSPClipInfo *clip);
+
+typedef struct {
+    double preRollDuration;         // Seconds held now
+    size_t preRollBytes;
+    uint32_t clipID;                // Clip being recorded, 0 when idle
+    bool triggered;                 // It ends on its own after the post-roll
+    double clipDuration;            // Media handed to the writer for it so far
+    uint32_t clips;                 // Clips finished
+    uint64_t bytesWritten;          // Across all clips
+    uint64_t droppedMedia;          // Media without an init segment or keyframe before it
+} RTSPClipRecorderStatistics;
+
+typedef struct RTSPClipRecorder *RTSPClipRecorderRef;
+
+/// Creates the recorder and its writer thread. `config` may be NULL for
+/// defaults, `finished` may be NULL.
+RTSPClipRecorderRef RTSPClipRecorderCreate(const RTSPClipRecorderConfig *config,
+                                           RTSPClipFinishedCallback finished, void *context);
+
+/// Ends the current clip (RTSPClipEndStopped), waits until it is closed and
+/// joins the writer thread
+void RTSPClipRecorderRelease(RTSPClipRecorderRef recorder);
+
+/// Engine output, as delivered to an RTSPRemuxSink. Feed parts when the
+/// engine emits them and segments otherwise, not both. One thread at a time.
+void RTSPClipRecorderAddInitSegment(RTSPClipRecorderRef recorder, uint32_t initID, const uint8_t *data, size_t length);
+void RTSPClipRecorderAddMedia(RTSPClipRecorderRef recorder, const RTSPRemuxMediaInfo *info, const uint8_t *data, size_t length);
+
+/// Record to `path` until RTSPClipRecorderStop, starting with the pre-roll
+/// or else at the current GOP's keyframe. Returns the clip ID, or 0 if a
+/// clip is already being recorded or no media has arrived yet.
+uint32_t RTSPClipRecorderStart(RTSPClipRecorderRef recorder, const char *path, bool includePreRoll);
+
+/// Record a clip to `path` that opens with the pre-roll and ends
+/// postRollDuration after the last trigger. While a clip is being recorded
+/// it is extended instead and `path` is ignored. Returns the clip ID, or 0
+/// if no media has arrived yet.
+uint32_t RTSPClipRecorderTrigger(RTSPClipRecorderRef recorder, const char *path);
+
+/// End the current clip, if any. Its callback follows once the writer has closed it.
+void RTSPClipRecorderStop(RTSPClipRecorderRef recorder);
+
+RTSPClipRecorderStatistics RTSPClipRecorderGetStatistics(RTSPClipRecorderRef recorder);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RTSPClipRecorder_h */
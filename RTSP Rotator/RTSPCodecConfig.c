@@ -0,0 +1,405 @@
+//
+//  RTSPCodecConfig.c
+//  RTSP Rotator
+//
+
+#include "RTSPCodecConfig.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#pragma mark - Bit Reader
+
+/// Exp-Golomb reader over an RBSP (emulation prevention bytes removed)
+typedef struct {
+    uint8_t rbsp[RTSP_CODEC_MAX_PARAMETER_SET];
+    size_t length;
+    size_t bit;
+    bool overrun;
+} RTSPBitReader;
+
+static void RTSPBitReaderInit(RTSPBitReader *reader, const uint8_t *nal, size_t length) {
+    memset(reader, 0, sizeof(*reader));
+    size_t zeros = 0;
+    for (size_t i = 0; i < length && reader->length < sizeof(reader->rbsp); i++) {
+        if (zeros >= 2 && nal[i] == 0x03) {
+            zeros = 0;
+            continue;
+        }
+        zeros = nal[i] == 0 ? zeros + 1 : 0;
+        reader->rbsp[reader->length++] = nal[i];
+    }
+}
+
+static uint32_t RTSPBitReaderBits(RTSPBitReader *reader, unsigned count) {
+    uint32_t value = 0;
+    for (unsigned i = 0; i < count; i++) {
+        if (reader->bit >= reader->length * 8) {
+            reader->overrun = true;
+            return 0;
+        }
+        uint8_t byte = reader->rbsp[reader->bit / 8];
+        value = (value << 1) | ((byte >> (7 - reader->bit % 8)) & 1);
+        reader->bit++;
+    }
+    return value;
+}
+
+static void RTSPBitReaderSkip(RTSPBitReader *reader, size_t count) {
+    reader->bit += count;
+    if (reader->bit > reader->length * 8) {
+        reader->overrun = true;
+    }
+}
+
+static uint32_t RTSPBitReaderUE(RTSPBitReader *reader) {
+    unsigned leadingZeros = 0;
+    while (!reader->overrun && RTSPBitReaderBits(reader, 1) == 0) {
+        if (++leadingZeros > 31) {
+            reader->overrun = true;
+            return 0;
+        }
+    }
+    return (1u << leadingZeros) - 1 + RTSPBitReaderBits(reader, leadingZeros);
+}
+
+static int32_t RTSPBitReaderSE(RTSPBitReader *reader) {
+    uint32_t value = RTSPBitReaderUE(reader);
+    return (value & 1) ? (int32_t)((value + 1) / 2) : -(int32_t)(value / 2);
+}
+
+#pragma mark - SPS Parsing
+
+static void RTSPSkipH264ScalingList(RTSPBitReader *reader, int size) {
+    int lastScale = 8, nextScale = 8;
+    for (int j = 0; j < size; j++) {
+        if (nextScale != 0) {
+            int32_t delta = RTSPBitReaderSE(reader);
+            nextScale = (lastScale + delta + 256) % 256;
+        }
+        lastScale = nextScale == 0 ? lastScale : nextScale;
+    }
+}
+
+static bool RTSPParseH264SPS(const uint8_t *sps, size_t length, uint32_t *width, uint32_t *height) {
+    RTSPBitReader reader;
+    RTSPBitReaderInit(&reader, sps, length);
+    RTSPBitReaderSkip(&reader, 8); // NAL header
+
+    uint32_t profile = RTSPBitReaderBits(&reader, 8);
+    RTSPBitReaderSkip(&reader, 16); // constraint flags + level
+    RTSPBitReaderUE(&reader);       // seq_parameter_set_id
+
+    uint32_t chromaFormat = 1;
+    if (profile == 100 || profile == 110 || profile == 122 || profile == 244 || profile == 44 ||
+        profile == 83 || profile == 86 || profile == 118 || profile == 128 || profile == 138 ||
+        profile == 139 || profile == 134 || profile == 135) {
+        chromaFormat = RTSPBitReaderUE(&reader);
+        if (chromaFormat == 3) {
+            RTSPBitReaderSkip(&reader, 1);
+        }
+        RTSPBitReaderUE(&reader); // bit_depth_luma_minus8
+        RTSPBitReaderUE(&reader); // bit_depth_chroma_minus8
+        RTSPBitReaderSkip(&reader, 1);
+        if (RTSPBitReaderBits(&reader, 1)) {
+            int lists = chromaFormat == 3 ? 12 : 8;
+            for (int i = 0; i < lists; i++) {
+                if (RTSPBitReaderBits(&reader, 1)) {
+                    RTSPSkipH264ScalingList(&reader, i < 6 ? 16 : 64);
+                }
+            }
+        }
+    }
+
+    RTSPBitReaderUE(&reader); // log2_max_frame_num_minus4
+    uint32_t pocType = RTSPBitReaderUE(&reader);
+    if (pocType == 0) {
+        RTSPBitReaderUE(&reader);
+    } else if (pocType == 1) {
+        RTSPBitReaderSkip(&reader, 1);
+        RTSPBitReaderSE(&reader);
+        RTSPBitReaderSE(&reader);
+        uint32_t cycle = RTSPBitReaderUE(&reader);
+        for (uint32_t i = 0; i < cycle && !reader.overrun; i++) {
+            RTSPBitReaderSE(&reader);
+        }
+    }
+    RTSPBitReaderUE(&reader); // max_num_ref_frames
+    RTSPBitReaderSkip(&reader, 1);
+
+    uint32_t widthInMbs = RTSPBitReaderUE(&reader) + 1;
+    uint32_t heightInMapUnits = RTSPBitReaderUE(&reader) + 1;
+    uint32_t frameMbsOnly = RTSPBitReaderBits(&reader, 1);
+    if (!frameMbsOnly) {
+        RTSPBitReaderSkip(&reader, 1);
+    }
+    RTSPBitReaderSkip(&reader, 1); // direct_8x8_inference_flag
+
+    uint32_t cropLeft = 0, cropRight = 0, cropTop = 0, cropBottom = 0;
+    if (RTSPBitReaderBits(&reader, 1)) {
+        cropLeft = RTSPBitReaderUE(&reader);
+        cropRight = RTSPBitReaderUE(&reader);
+        cropTop = RTSPBitReaderUE(&reader);
+        cropBottom = RTSPBitReaderUE(&reader);
+    }
+    if (reader.overrun) {
+        return false;
+    }
+
+    uint32_t cropUnitX = chromaFormat == 0 || chromaFormat == 3 ? 1 : 2;
+    uint32_t cropUnitY = (chromaFormat == 1 ? 2 : 1) * (2 - frameMbsOnly);
+    *width = widthInMbs * 16 - cropUnitX * (cropLeft + cropRight);
+    *height = (2 - frameMbsOnly) * heightInMapUnits * 16 - cropUnitY * (cropTop + cropBottom);
+    return *width > 0 && *height > 0;
+}
+
+static bool RTSPParseH265SPS(const uint8_t *sps, size_t length, uint32_t *width, uint32_t *height) {
+    RTSPBitReader reader;
+    RTSPBitReaderInit(&reader, sps, length);
+    RTSPBitReaderSkip(&reader, 16); // NAL header
+
+    RTSPBitReaderSkip(&reader, 4);  // sps_video_parameter_set_id
+    uint32_t maxSubLayersMinus1 = RTSPBitReaderBits(&reader, 3);
+    RTSPBitReaderSkip(&reader, 1);
+
+    // profile_tier_level
+    RTSPBitReaderSkip(&reader, 88 + 8);
+    uint32_t subLayerProfilePresent[8] = {0}, subLayerLevelPresent[8] = {0};
+    for (uint32_t i = 0; i < maxSubLayersMinus1; i++) {
+        subLayerProfilePresent[i] = RTSPBitReaderBits(&reader, 1);
+        subLayerLevelPresent[i] = RTSPBitReaderBits(&reader, 1);
+    }
+    if (maxSubLayersMinus1 > 0) {
+        RTSPBitReaderSkip(&reader, 2 * (8 - maxSubLayersMinus1));
+    }
+    for (uint32_t i = 0; i < maxSubLayersMinus1; i++) {
+        if (subLayerProfilePresent[i]) RTSPBitReaderSkip(&reader, 88);
+        if (subLayerLevelPresent[i]) RTSPBitReaderSkip(&reader, 8);
+    }
+
+    RTSPBitReaderUE(&reader); // sps_seq_parameter_set_id
+    uint32_t chromaFormat = RTSPBitReaderUE(&reader);
+    if (chromaFormat == 3) {
+        RTSPBitReaderSkip(&reader, 1);
+    }
+    uint32_t picWidth = RTSPBitReaderUE(&reader);
+    uint32_t picHeight = RTSPBitReaderUE(&reader);
+
+    uint32_t left = 0, right = 0, top = 0, bottom = 0;
+    if (RTSPBitReaderBits(&reader, 1)) {
+        left = RTSPBitReaderUE(&reader);
+        right = RTSPBitReaderUE(&reader);
+        top = RTSPBitReaderUE(&reader);
+        bottom = RTSPBitReaderUE(&reader);
+    }
+    if (reader.overrun) {
+        return false;
+    }
+
+    uint32_t subWidth = chromaFormat == 1 || chromaFormat == 2 ? 2 : 1;
+    uint32_t subHeight = chromaFormat == 1 ? 2 : 1;
+    *width = picWidth - subWidth * (left + right);
+    *height = picHeight - subHeight * (top + bottom);
+    return *width > 0 && *height > 0;
+}
+
+bool RTSPCodecParseSPSDimensions(RTSPVideoCodec codec, const uint8_t *sps, size_t length,
+                                 uint32_t *width, uint32_t *height) {
+    if (!sps || !width || !height) {
+        return false;
+    }
+    switch (codec) {
+        case RTSPVideoCodecH264: return length >= 4 && RTSPParseH264SPS(sps, length, width, height);
+        case RTSPVideoCodecH265: return length >= 15 && RTSPParseH265SPS(sps, length, width, height);
+        default: return false;
+    }
+}
+
+#pragma mark - NAL Classification
+
+void RTSPCodecConfigInit(RTSPCodecConfig *config, RTSPVideoCodec codec) {
+    memset(config, 0, sizeof(*config));
+    config->codec = codec;
+}
+
+int RTSPCodecNALType(RTSPVideoCodec codec, const uint8_t *nal, size_t length) {
+    if (!nal || length == 0) {
+        return -1;
+    }
+    return codec == RTSPVideoCodecH265 ? (nal[0] >> 1) & 0x3F : nal[0] & 0x1F;
+}
+
+bool RTSPCodecNALIsKeyframe(RTSPVideoCodec codec, int nalType) {
+    if (codec == RTSPVideoCodecH265) {
+        return nalType >= 16 && nalType <= 21;
+    }
+    return nalType == 5;
+}
+
+bool RTSPCodecNALIsConfig(RTSPVideoCodec codec, int nalType) {
+    if (codec == RTSPVideoCodecH265) {
+        return nalType == 32 || nalType == 33 || nalType == 34 || nalType == 35;
+    }
+    return nalType == 7 || nalType == 8 || nalType == 9;
+}
+
+static bool RTSPStoreParameterSet(RTSPParameterSet *set, const uint8_t *nal, size_t length) {
+    if (length > RTSP_CODEC_MAX_PARAMETER_SET) {
+        return false;
+    }
+    if (set->length == length && memcmp(set->bytes, nal, length) == 0) {
+        return false;
+    }
+    memcpy(set->bytes, nal, length);
+    set->length = (uint16_t)length;
+    return true;
+}
+
+bool RTSPCodecConfigObserveNAL(RTSPCodecConfig *config, const uint8_t *nal, size_t length) {
+    int type = RTSPCodecNALType(config->codec, nal, length);
+    bool changed = false;
+    bool isSPS = false;
+
+    if (config->codec == RTSPVideoCodecH264) {
+        if (type == 7) {
+            changed = RTSPStoreParameterSet(&config->sps, nal, length);
+            isSPS = true;
+        } else if (type == 8) {
+            changed = RTSPStoreParameterSet(&config->pps, nal, length);
+        }
+    } else if (config->codec == RTSPVideoCodecH265) {
+        if (type == 32) {
+            changed = RTSPStoreParameterSet(&config->vps, nal, length);
+        } else if (type == 33) {
+            changed = RTSPStoreParameterSet(&config->sps, nal, length);
+            isSPS = true;
+        } else if (type == 34) {
+            changed = RTSPStoreParameterSet(&config->pps, nal, length);
+        }
+    }
+
+    if (changed) {
+        if (isSPS) {
+            uint32_t width = 0, height = 0;
+            if (RTSPCodecParseSPSDimensions(config->codec, nal, length, &width, &height)) {
+                config->width = width;
+                config->height = height;
+            }
+        }
+        config->generation++;
+    }
+    return changed;
+}
+
+bool RTSPCodecConfigIsComplete(const RTSPCodecConfig *config) {
+    if (config->sps.length == 0 || config->pps.length == 0) {
+        return false;
+    }
+    return config->codec != RTSPVideoCodecH265 || config->vps.length > 0;
+}
+
+#pragma mark - Decoder Configuration Records
+
+static void RTSPAppendHVCCArray(RTSPByteBuffer *buffer, uint8_t nalType, const RTSPParameterSet *set) {
+    RTSPByteBufferAppendU8(buffer, 0x80 | nalType); // array_completeness = 1
+    RTSPByteBufferAppendU16(buffer, 1);
+    RTSPByteBufferAppendU16(buffer, set->length);
+    RTSPByteBufferAppend(buffer, set->bytes, set->length);
+}
+
+bool RTSPCodecConfigAppendDecoderRecord(const RTSPCodecConfig *config, RTSPByteBuffer *buffer) {
+    if (!RTSPCodecConfigIsComplete(config)) {
+        return false;
+    }
+
+    if (config->codec == RTSPVideoCodecH264) {
+        const uint8_t *sps = config->sps.bytes;
+        RTSPByteBufferAppendU8(buffer, 1);       // configurationVersion
+        RTSPByteBufferAppendU8(buffer, sps[1]);  // AVCProfileIndication
+        RTSPByteBufferAppendU8(buffer, sps[2]);  // profile_compatibility
+        RTSPByteBufferAppendU8(buffer, sps[3]);  // AVCLevelIndication
+        RTSPByteBufferAppendU8(buffer, 0xFF);    // lengthSizeMinusOne = 3
+        RTSPByteBufferAppendU8(buffer, 0xE1);    // one SPS
+        RTSPByteBufferAppendU16(buffer, config->sps.length);
+        RTSPByteBufferAppend(buffer, sps, config->sps.length);
+        RTSPByteBufferAppendU8(buffer, 1);       // one PPS
+        RTSPByteBufferAppendU16(buffer, config->pps.length);
+        RTSPByteBufferAppend(buffer, config->pps.bytes, config->pps.length);
+        return !buffer->failed;
+    }
+
+    // profile_tier_level sits at a fixed offset: 2 byte NAL header + 1 byte
+    RTSPBitReader reader;
+    RTSPBitReaderInit(&reader, config->sps.bytes, config->sps.length);
+    if (reader.length < 15) {
+        return false;
+    }
+    const uint8_t *ptl = reader.rbsp + 3;
+    uint32_t maxSubLayersMinus1 = (reader.rbsp[2] >> 1) & 0x07;
+    uint32_t temporalIdNested = reader.rbsp[2] & 0x01;
+
+    RTSPByteBufferAppendU8(buffer, 1);                 // configurationVersion
+    RTSPByteBufferAppend(buffer, ptl, 12);             // profile space/tier/idc, compat flags, constraints, level
+    RTSPByteBufferAppendU16(buffer, 0xF000);           // min_spatial_segmentation_idc
+    RTSPByteBufferAppendU8(buffer, 0xFC);              // parallelismType
+    RTSPByteBufferAppendU8(buffer, 0xFD);              // chroma_format_idc = 1 (4:2:0)
+    RTSPByteBufferAppendU8(buffer, 0xF8);              // bit_depth_luma_minus8
+    RTSPByteBufferAppendU8(buffer, 0xF8);              // bit_depth_chroma_minus8
+    RTSPByteBufferAppendU16(buffer, 0);                // avgFrameRate
+    RTSPByteBufferAppendU8(buffer, (uint8_t)(((maxSubLayersMinus1 + 1) << 3) | (temporalIdNested << 2) | 3));
+    RTSPByteBufferAppendU8(buffer, 3);                 // numOfArrays
+    RTSPAppendHVCCArray(buffer, 32, &config->vps);
+    RTSPAppendHVCCArray(buffer, 33, &config->sps);
+    RTSPAppendHVCCArray(buffer, 34, &config->pps);
+    return !buffer->failed;
+}
+
+void RTSPCodecConfigCodecString(const RTSPCodecConfig *config, char *string, size_t size) {
+    if (config->codec == RTSPVideoCodecH264 && config->sps.length >= 4) {
+        snprintf(string, size, "avc1.%02x%02x%02x",
+                 config->sps.bytes[1], config->sps.bytes[2], config->sps.bytes[3]);
+    } else if (config->codec == RTSPVideoCodecH265 && config->sps.length >= 15) {
+        uint8_t profile = config->sps.bytes[3] & 0x1F;
+        uint8_t tier = (config->sps.bytes[3] >> 5) & 1;
+        uint8_t level = config->sps.bytes[14];
+        snprintf(string, size, "hvc1.%u.4.%c%u.B0", profile, tier ? 'H' : 'L', level);
+    } else {
+        snprintf(string, size, "%s", config->codec == RTSPVideoCodecH265 ? "hvc1" : "avc1");
+    }
+}
+
+#pragma mark - Base64
+
+static int RTSPBase64Value(char c) {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+' || c == '-') return 62;
+    if (c == '/' || c == '_') return 63;
+    return -1;
+}
+
+long RTSPCodecBase64Decode(const char *input, size_t inputLength, uint8_t *output, size_t outputSize) {
+    uint32_t accumulator = 0;
+    int bits = 0;
+    size_t written = 0;
+    for (size_t i = 0; i < inputLength; i++) {
+        if (input[i] == '=') {
+            break;
+        }
+        int value = RTSPBase64Value(input[i]);
+        if (value < 0) {
+            return -1;
+        }
+        accumulator = (accumulator << 6) | (uint32_t)value;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            if (written >= outputSize) {
+                return -1;
+            }
+            output[written++] = (uint8_t)(accumulator >> bits);
+        }
+    }
+    return (long)written;
+}
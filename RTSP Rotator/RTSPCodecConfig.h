@@ -0,0 +1,79 @@
+//
+//  RTSPCodecConfig.h
+//  RTSP Rotator
+//
+//  H.264 / H.265 parameter set handling: SPS dimension parsing, NAL unit
+//  classification and avcC / hvcC decoder configuration records. Used by
+//  the remux engine and recorder, which copy elementary streams without
+//  decoding them.
+//
+
+#ifndef RTSPCodecConfig_h
+#define RTSPCodecConfig_h
+
+#include "RTSPByteBuffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    RTSPVideoCodecUnknown = 0,
+    RTSPVideoCodecH264,
+    RTSPVideoCodecH265
+} RTSPVideoCodec;
+
+#define RTSP_CODEC_MAX_PARAMETER_SET 256
+
+typedef struct {
+    uint8_t bytes[RTSP_CODEC_MAX_PARAMETER_SET];
+    uint16_t length;
+} RTSPParameterSet;
+
+typedef struct {
+    RTSPVideoCodec codec;
+    RTSPParameterSet vps;       // H.265 only
+    RTSPParameterSet sps;
+    RTSPParameterSet pps;
+    uint32_t width;             // Parsed from the SPS, 0 until known
+    uint32_t height;
+    uint32_t generation;        // Bumped whenever a parameter set changes
+} RTSPCodecConfig;
+
+void RTSPCodecConfigInit(RTSPCodecConfig *config, RTSPVideoCodec codec);
+
+/// NAL unit type from the first header byte(s)
+int RTSPCodecNALType(RTSPVideoCodec codec, const uint8_t *nal, size_t length);
+
+/// Whether a NAL unit type starts a random access point (IDR / IRAP)
+bool RTSPCodecNALIsKeyframe(RTSPVideoCodec codec, int nalType);
+
+/// Whether a NAL unit type is a parameter set or access unit delimiter
+/// (carried out of band in avcC / hvcC and stripped from samples)
+bool RTSPCodecNALIsConfig(RTSPVideoCodec codec, int nalType);
+
+/// Offer a NAL unit; parameter sets are stored and the SPS is parsed.
+/// Returns true if the NAL unit changed the configuration.
+bool RTSPCodecConfigObserveNAL(RTSPCodecConfig *config, const uint8_t *nal, size_t length);
+
+/// Whether all parameter sets needed for a decoder configuration are known
+bool RTSPCodecConfigIsComplete(const RTSPCodecConfig *config);
+
+/// Append an avcC (H.264) or hvcC (H.265) box payload (without box header)
+bool RTSPCodecConfigAppendDecoderRecord(const RTSPCodecConfig *config, RTSPByteBuffer *buffer);
+
+/// RFC 6381 codec string for HLS playlists, e.g. "avc1.64001f"
+void RTSPCodecConfigCodecString(const RTSPCodecConfig *config, char *string, size_t size);
+
+/// Parse SPS dimensions. Returns false if the SPS cannot be parsed.
+bool RTSPCodecParseSPSDimensions(RTSPVideoCodec codec, const uint8_t *sps, size_t length,
+                                 uint32_t *width, uint32_t *height);
+
+/// Decode base64 (used for SDP sprop-parameter-sets). Returns decoded length or -1.
+long RTSPCodecBase64Decode(const char *input, size_t inputLength, uint8_t *output, size_t outputSize);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RTSPCodecConfig_h */
@@ -0,0 +1,944 @@
+//
+//  RTSPDVRStore.c
+//  RTSP Rotator
+//
+
+#include "RTSPDVRStore.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RTSP_DVR_MAGIC "RTSPDVR1"
+#define RTSP_DVR_VERSION 1
+#define RTSP_DVR_MAX_KEYFRAMES 4096
+
+enum {
+    RTSPDVRFlagComplete = 1 << 0,
+    RTSPDVRFlagDiscontinuity = 1 << 1,
+};
+
+// The index is written in host byte order: little-endian on every supported Mac
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t slotCount;
+    uint32_t maxKeyframes;
+    uint32_t entrySize;
+    uint64_t nextSequence;          // Segment number the next segment gets
+    uint8_t reserved[32];
+} RTSPDVRIndexHeader;
+
+typedef struct {
+    uint32_t time;                  // Milliseconds after the segment start
+    uint32_t offset;                // moof offset in the slot file
+} RTSPDVRKeyframe;
+
+/// One slot, followed by maxKeyframes RTSPDVRKeyframe
+typedef struct {
+    uint64_t sequence;              // Segment held, 0 = none
+    int64_t startTime;
+    int64_t endTime;
+    uint32_t length;
+    uint32_t mediaOffset;
+    uint32_t initHash;
+    uint16_t keyframeCount;
+    uint16_t flags;
+    uint8_t reserved[8];
+} RTSPDVRIndexEntry;
+
+_Static_assert(sizeof(RTSPDVRIndexHeader) == 64, "index header layout");
+_Static_assert(sizeof(RTSPDVRIndexEntry) == 48, "index entry layout");
+
+struct RTSPDVRStore {
+    atomic_int references;
+    RTSPDVRStoreConfig config;
+    char *directory;
+
+    pthread_mutex_t lock;           // Index entries, the sequence range and the counters
+    int indexFd;
+    uint8_t *map;
+    size_t mapLength;
+    size_t entrySize;
+    RTSPDVRIndexHeader *header;
+    uint64_t oldestSequence;        // Segments held are [oldestSequence, header->nextSequence)
+
+    // Appending thread only
+    uint8_t *init;
+    size_t initLength;
+    uint32_t initID;
+    uint32_t initHash;
+    bool gap;                       // Media was lost since the last segment
+    int fd;                         // Segment being appended to, -1 between segments
+    RTSPDVRIndexEntry *current;
+    double currentDuration;
+    int64_t lastEndTime;
+
+    uint64_t bytesWritten;
+    uint64_t overwritten;
+    uint64_t droppedMedia;
+    uint64_t writeErrors;
+};
+
+void RTSPDVRStoreConfigInit(RTSPDVRStoreConfig *config) {
+    config->slotCount = 8640;
+    config->slotBytes = 16u << 20;
+    config->segmentDuration = 10.0;
+    config->maxKeyframes = 32;
+    config->reserveSpace = true;
+    config->syncOnCut = false;
+}
+
+#pragma mark - Files
+
+static uint32_t RTSPDVRHash(const uint8_t *bytes, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static bool RTSPDVRWriteAll(int fd, const void *data, size_t length, off_t offset) {
+    const uint8_t *bytes = data;
+    while (length > 0) {
+        ssize_t written = pwrite(fd, bytes, length, offset);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        bytes += written;
+        length -= (size_t)written;
+        offset += written;
+    }
+    return true;
+}
+
+static bool RTSPDVRReadAll(int fd, void *data, size_t length, off_t offset) {
+    uint8_t *bytes = data;
+    while (length > 0) {
+        ssize_t count = pread(fd, bytes, length, offset);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return false;
+        }
+        bytes += count;
+        length -= (size_t)count;
+        offset += count;
+    }
+    return true;
+}
+
+static void RTSPDVRSlotPath(RTSPDVRStoreRef store, uint32_t slot, char *path, size_t length) {
+    snprintf(path, length, "%s/segment-%05u.m4s", store->directory, slot);
+}
+
+/// Allocates a new slot file's blocks up front so a full disk shows up when
+/// the ring grows, not as a failed append hours later. Best effort.
+static void RTSPDVRReserve(int fd, uint64_t bytes) {
+#if defined(__APPLE__)
+    fstore_t store = {F_ALLOCATECONTIG, F_PEOFPOSMODE, 0, (off_t)bytes, 0};
+    if (fcntl(fd, F_PREALLOCATE, &store) == -1) {
+        store.fst_flags = F_ALLOCATEALL;
+        fcntl(fd, F_PREALLOCATE, &store);
+    }
+    (void)ftruncate(fd, (off_t)bytes);
+#else
+    (void)posix_fallocate(fd, 0, (off_t)bytes);
+#endif
+}
+
+#pragma mark - Index
+
+static RTSPDVRIndexEntry *RTSPDVRSlotEntry(RTSPDVRStoreRef store, uint32_t slot) {
+    return (RTSPDVRIndexEntry *)(store->map + sizeof(RTSPDVRIndexHeader) + (size_t)slot * store->entrySize);
+}
+
+static uint32_t RTSPDVRSlotForSequence(RTSPDVRStoreRef store, uint64_t sequence) {
+    return (uint32_t)((sequence - 1) % store->config.slotCount);
+}
+
+/// Entry holding `sequence`, or NULL if it is not in the ring. Lock held.
+static RTSPDVRIndexEntry *RTSPDVREntry(RTSPDVRStoreRef store, uint64_t sequence) {
+    if (sequence < store->oldestSequence || sequence >= store->header->nextSequence) {
+        return NULL;
+    }
+    RTSPDVRIndexEntry *entry = RTSPDVRSlotEntry(store, RTSPDVRSlotForSequence(store, sequence));
+    return entry->sequence == sequence ? entry : NULL;
+}
+
+static RTSPDVRKeyframe *RTSPDVRKeyframes(RTSPDVRIndexEntry *entry) {
+    return (RTSPDVRKeyframe *)(entry + 1);
+}
+
+static void RTSPDVRSegmentInfoFromEntry(const RTSPDVRIndexEntry *entry, RTSPDVRSegmentInfo *info) {
+    info->sequence = entry->sequence;
+    info->startTime = entry->startTime;
+    info->endTime = entry->endTime;
+    info->length = entry->length;
+    info->mediaOffset = entry->mediaOffset;
+    info->initHash = entry->initHash;
+    info->keyframes = entry->keyframeCount;
+    info->complete = (entry->flags & RTSPDVRFlagComplete) != 0;
+    info->discontinuity = (entry->flags & RTSPDVRFlagDiscontinuity) != 0;
+}
+
+/// Maps index.dat, starting a new ring if it is missing or has other geometry,
+/// and finds the run of intact segments that ends at the newest one
+static bool RTSPDVRStoreLoadIndex(RTSPDVRStoreRef store) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/index.dat", store->directory);
+    store->indexFd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (store->indexFd < 0) {
+        return false;
+    }
+    store->entrySize = sizeof(RTSPDVRIndexEntry) + (size_t)store->config.maxKeyframes * sizeof(RTSPDVRKeyframe);
+    store->mapLength = sizeof(RTSPDVRIndexHeader) + (size_t)store->config.slotCount * store->entrySize;
+    struct stat info;
+    if (fstat(store->indexFd, &info) != 0) {
+        return false;
+    }
+    if ((size_t)info.st_size != store->mapLength &&
+        (ftruncate(store->indexFd, 0) != 0 || ftruncate(store->indexFd, (off_t)store->mapLength) != 0)) {
+        return false;
+    }
+    void *map = mmap(NULL, store->mapLength, PROT_READ | PROT_WRITE, MAP_SHARED, store->indexFd, 0);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    store->map = map;
+    store->header = map;
+
+    RTSPDVRIndexHeader *header = store->header;
+    if (memcmp(header->magic, RTSP_DVR_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != RTSP_DVR_VERSION || header->slotCount != store->config.slotCount ||
+        header->maxKeyframes != store->config.maxKeyframes || header->entrySize != store->entrySize ||
+        header->nextSequence == 0) {
+        memset(store->map, 0, store->mapLength);
+        memcpy(header->magic, RTSP_DVR_MAGIC, sizeof(header->magic));
+        header->version = RTSP_DVR_VERSION;
+        header->slotCount = store->config.slotCount;
+        header->maxKeyframes = store->config.maxKeyframes;
+        header->entrySize = (uint32_t)store->entrySize;
+        header->nextSequence = 1;
+    }
+
+    // Walk back from the newest segment; a crash mid-replacement leaves at most one hole
+    uint64_t newest = header->nextSequence - 1;
+    uint64_t floor = newest >= store->config.slotCount ? newest - store->config.slotCount + 1 : 1;
+    store->oldestSequence = header->nextSequence;
+    for (uint64_t sequence = newest; sequence >= floor && sequence > 0; sequence--) {
+        RTSPDVRIndexEntry *entry = RTSPDVRSlotEntry(store, RTSPDVRSlotForSequence(store, sequence));
+        if (entry->sequence != sequence || entry->length < entry->mediaOffset ||
+            entry->keyframeCount > store->config.maxKeyframes) {
+            break;
+        }
+        store->oldestSequence = sequence;
+    }
+    if (store->oldestSequence < header->nextSequence) {
+        RTSPDVRIndexEntry *entry = RTSPDVRSlotEntry(store, RTSPDVRSlotForSequence(store, newest));
+        entry->flags |= RTSPDVRFlagComplete;
+        store->lastEndTime = entry->endTime;
+    }
+    return true;
+}
+
+#pragma mark - Lifecycle
+
+static void RTSPDVRStoreFinishSegment(RTSPDVRStoreRef store);
+
+RTSPDVRStoreRef RTSPDVRStoreOpen(const char *directory, const RTSPDVRStoreConfig *config) {
+    RTSPDVRStoreConfig defaults;
+    if (!config) {
+        RTSPDVRStoreConfigInit(&defaults);
+        config = &defaults;
+    }
+    if (!directory || config->slotCount == 0 || config->slotBytes == 0 || config->maxKeyframes == 0 ||
+        config->maxKeyframes > RTSP_DVR_MAX_KEYFRAMES || !(config->segmentDuration > 0)) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (mkdir(directory, 0755) != 0 && errno != EEXIST) {
+        return NULL;
+    }
+    RTSPDVRStoreRef store = calloc(1, sizeof(*store));
+    if (!store) {
+        return NULL;
+    }
+    atomic_init(&store->references, 1);
+    store->config = *config;
+    store->directory = strdup(directory);
+    store->indexFd = -1;
+    store->fd = -1;
+    store->gap = true;
+    pthread_mutex_init(&store->lock, NULL);
+
+    if (!store->directory || !RTSPDVRStoreLoadIndex(store)) {
+        int error = errno ? errno : EIO;
+        RTSPDVRStoreRelease(store);
+        errno = error;
+        return NULL;
+    }
+    return store;
+}
+
+RTSPDVRStoreRef RTSPDVRStoreRetain(RTSPDVRStoreRef store) {
+    if (store) {
+        atomic_fetch_add_explicit(&store->references, 1, memory_order_relaxed);
+    }
+    return store;
+}
+
+void RTSPDVRStoreRelease(RTSPDVRStoreRef store) {
+    if (!store || atomic_fetch_sub_explicit(&store->references, 1, memory_order_acq_rel) != 1) {
+        return;
+    }
+    if (store->map) {
+        RTSPDVRStoreFinishSegment(store);
+        msync(store->map, store->mapLength, MS_SYNC);
+        munmap(store->map, store->mapLength);
+    }
+    if (store->indexFd >= 0) {
+        close(store->indexFd);
+    }
+    pthread_mutex_destroy(&store->lock);
+    free(store->init);
+    free(store->directory);
+    free(store);
+}
+
+#pragma mark - Appending
+
+static void RTSPDVRStoreFinishSegment(RTSPDVRStoreRef store) {
+    if (store->fd < 0) {
+        return;
+    }
+    if (store->config.syncOnCut) {
+        fsync(store->fd);
+    }
+    pthread_mutex_lock(&store->lock);
+    store->current->flags |= RTSPDVRFlagComplete;
+    store->lastEndTime = store->current->endTime;
+    pthread_mutex_unlock(&store->lock);
+    if (store->config.syncOnCut) {
+        msync(store->map, store->mapLength, MS_SYNC);
+    }
+    close(store->fd);
+    store->fd = -1;
+    store->current = NULL;
+}
+
+void RTSPDVRStoreCut(RTSPDVRStoreRef store) {
+    if (store) {
+        RTSPDVRStoreFinishSegment(store);
+        store->gap = true;
+    }
+}
+
+/// Takes over the oldest slot for the next segment and writes the init segment into it
+static bool RTSPDVRStoreBeginSegment(RTSPDVRStoreRef store, int64_t time) {
+    uint64_t sequence = store->header->nextSequence;
+    uint32_t slot = RTSPDVRSlotForSequence(store, sequence);
+    char path[PATH_MAX];
+    RTSPDVRSlotPath(store, slot, path, sizeof(path));
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (store->config.reserveSpace && fstat(fd, &info) == 0 && (uint64_t)info.st_size < store->config.slotBytes) {
+        RTSPDVRReserve(fd, store->config.slotBytes);
+    }
+
+    // Readers of the segment this slot held fail from here on
+    RTSPDVRIndexEntry *entry = RTSPDVRSlotEntry(store, slot);
+    pthread_mutex_lock(&store->lock);
+    if (RTSPDVREntry(store, entry->sequence) == entry) {
+        store->overwritten++;
+    }
+    memset(entry, 0, store->entrySize);
+    entry->sequence = sequence;
+    entry->startTime = time > store->lastEndTime ? time : store->lastEndTime;
+    entry->endTime = entry->startTime;
+    entry->mediaOffset = (uint32_t)store->initLength;
+    entry->initHash = store->initHash;
+    entry->flags = store->gap ? RTSPDVRFlagDiscontinuity : 0;
+    store->header->nextSequence = sequence + 1;
+    if (sequence + 1 - store->oldestSequence > store->config.slotCount) {
+        store->oldestSequence = sequence + 1 - store->config.slotCount;
+    }
+    pthread_mutex_unlock(&store->lock);
+
+    bool ok = RTSPDVRWriteAll(fd, store->init, store->initLength, 0);
+    pthread_mutex_lock(&store->lock);
+    if (ok) {
+        entry->length = (uint32_t)store->initLength;
+        store->bytesWritten += store->initLength;
+    } else {
+        entry->flags |= RTSPDVRFlagComplete;
+    }
+    pthread_mutex_unlock(&store->lock);
+    if (!ok) {
+        close(fd);
+        return false;
+    }
+    store->fd = fd;
+    store->current = entry;
+    store->currentDuration = 0;
+    store->gap = false;
+    return true;
+}
+
+void RTSPDVRStoreAddInitSegment(RTSPDVRStoreRef store, uint32_t initID, const uint8_t *data, size_t length) {
+    if (!store || !data || length == 0) {
+        return;
+    }
+    uint32_t hash = RTSPDVRHash(data, length);
+    if (store->init && hash == store->initHash && length == store->initLength &&
+        memcmp(data, store->init, length) == 0) {
+        store->initID = initID;          // Reconnect with the same parameters
+        return;
+    }
+    uint8_t *copy = malloc(length);
+    if (!copy) {
+        return;
+    }
+    memcpy(copy, data, length);
+    RTSPDVRStoreFinishSegment(store);
+    free(store->init);
+    store->init = copy;
+    store->initLength = length;
+    store->initID = initID;
+    store->initHash = hash;
+    store->gap = true;
+}
+
+void RTSPDVRStoreAddMedia(RTSPDVRStoreRef store, const RTSPRemuxMediaInfo *info, const uint8_t *data, size_t length,
+                          int64_t time) {
+    if (!store || !info || !data || length == 0) {
+        return;
+    }
+    if (!store->init || info->initID != store->initID) {
+        pthread_mutex_lock(&store->lock);
+        store->droppedMedia++;
+        pthread_mutex_unlock(&store->lock);
+        store->gap = true;
+        return;
+    }
+    if (info->discontinuity) {
+        store->gap = true;
+    }
+    RTSPDVRIndexEntry *entry = store->current;
+    if (entry && info->independent &&
+        (store->gap || store->currentDuration >= store->config.segmentDuration - 0.001 ||
+         entry->length - entry->mediaOffset >= store->config.slotBytes / 4 * 3 ||
+         entry->keyframeCount >= store->config.maxKeyframes ||
+         (uint64_t)entry->length + length > UINT32_MAX)) {
+        RTSPDVRStoreFinishSegment(store);
+    }
+    if (!store->current) {
+        if (!info->independent) {
+            pthread_mutex_lock(&store->lock);
+            store->droppedMedia++;
+            pthread_mutex_unlock(&store->lock);
+            store->gap = true;
+            return;
+        }
+        if (!RTSPDVRStoreBeginSegment(store, time)) {
+            pthread_mutex_lock(&store->lock);
+            store->writeErrors++;
+            pthread_mutex_unlock(&store->lock);
+            store->gap = true;
+            return;
+        }
+    }
+    entry = store->current;
+    uint32_t offset = entry->length;
+    if ((uint64_t)offset + length > UINT32_MAX || !RTSPDVRWriteAll(store->fd, data, length, offset)) {
+        pthread_mutex_lock(&store->lock);
+        store->writeErrors++;
+        pthread_mutex_unlock(&store->lock);
+        RTSPDVRStoreCut(store);
+        return;
+    }
+
+    int64_t endTime = time + (int64_t)llround(info->duration * 1e6);
+    pthread_mutex_lock(&store->lock);
+    if (info->independent && entry->keyframeCount < store->config.maxKeyframes) {
+        int64_t after = time > entry->startTime ? time - entry->startTime : 0;
+        RTSPDVRKeyframes(entry)[entry->keyframeCount++] = (RTSPDVRKeyframe){(uint32_t)(after / 1000), offset};
+    }
+    entry->length = offset + (uint32_t)length;
+    if (endTime > entry->endTime) {
+        entry->endTime = endTime;
+    }
+    store->bytesWritten += length;
+    pthread_mutex_unlock(&store->lock);
+    store->currentDuration += info->duration;
+}
+
+#pragma mark - Lookup
+
+/// First segment whose end is after `time`, or nextSequence if none. Lock held.
+static uint64_t RTSPDVRFirstEndingAfter(RTSPDVRStoreRef store, int64_t time) {
+    uint64_t low = store->oldestSequence;
+    uint64_t high = store->header->nextSequence;
+    while (low < high) {
+        uint64_t middle = low + (high - low) / 2;
+        if (RTSPDVRSlotEntry(store, RTSPDVRSlotForSequence(store, middle))->endTime > time) {
+            high = middle;
+        } else {
+            low = middle + 1;
+        }
+    }
+    return low;
+}
+
+size_t RTSPDVRStoreFindSegments(RTSPDVRStoreRef store, int64_t start, int64_t end,
+                                RTSPDVRSegmentInfo *segments, size_t capacity) {
+    if (!store || end <= start) {
+        return 0;
+    }
+    size_t count = 0;
+    pthread_mutex_lock(&store->lock);
+    for (uint64_t sequence = RTSPDVRFirstEndingAfter(store, start); sequence < store->header->nextSequence; sequence++) {
+        RTSPDVRIndexEntry *entry = RTSPDVRSlotEntry(store, RTSPDVRSlotForSequence(store, sequence));
+        if (entry->startTime >= end) {
+            break;
+        }
+        if (entry->length <= entry->mediaOffset) {
+            continue;                   // Nothing written yet, or the init segment failed
+        }
+        if (count < capacity) {
+            RTSPDVRSegmentInfoFromEntry(entry, &segments[count]);
+        }
+        count++;
+    }
+    pthread_mutex_unlock(&store->lock);
+    return count;
+}
+
+bool RTSPDVRStoreGetSegment(RTSPDVRStoreRef store, uint64_t sequence, RTSPDVRSegmentInfo *segment) {
+    if (!store || !segment) {
+        return false;
+    }
+    pthread_mutex_lock(&store->lock);
+    RTSPDVRIndexEntry *entry = RTSPDVREntry(store, sequence);
+    if (entry) {
+        RTSPDVRSegmentInfoFromEntry(entry, segment);
+    }
+    pthread_mutex_unlock(&store->lock);
+    return entry != NULL;
+}
+
+bool RTSPDVRStoreSeek(RTSPDVRStoreRef store, int64_t time, RTSPDVRSeekPoint *point) {
+    if (!store || !point) {
+        return false;
+    }
+    pthread_mutex_lock(&store->lock);
+    uint64_t oldest = store->oldestSequence;
+    uint64_t low = oldest;
+    uint64_t high = store->header->nextSequence;
+    // Last segment starting at or before `time`
+    while (low < high) {
+        uint64_t middle = low + (high - low) / 2;
+        if (RTSPDVRSlotEntry(store, RTSPDVRSlotForSequence(store, middle))->startTime > time) {
+            high = middle;
+        } else {
+            low = middle + 1;
+        }
+    }
+    uint64_t sequence = low > oldest ? low - 1 : oldest;
+    RTSPDVRIndexEntry *entry = NULL;
+    for (; sequence >= oldest && sequence < store->header->nextSequence; sequence--) {
+        entry = RTSPDVRSlotEntry(store, RTSPDVRSlotForSequence(store, sequence));
+        if (entry->keyframeCount > 0) {
+            break;
+        }
+        entry = NULL;
+        if (sequence == oldest) {
+            break;
+        }
+    }
+    if (entry) {
+        // Last keyframe at or before `time`, else the segment's first
+        const RTSPDVRKeyframe *keyframes = RTSPDVRKeyframes(entry);
+        int64_t after = time - entry->startTime;
+        uint32_t first = 0;
+        uint32_t last = entry->keyframeCount;
+        while (first < last) {
+            uint32_t middle = first + (last - first) / 2;
+            if ((int64_t)keyframes[middle].time * 1000 > after) {
+                last = middle;
+            } else {
+                first = middle + 1;
+            }
+        }
+        const RTSPDVRKeyframe *keyframe = &keyframes[first > 0 ? first - 1 : 0];
+        point->sequence = entry->sequence;
+        point->offset = keyframe->offset;
+        point->time = entry->startTime + (int64_t)keyframe->time * 1000;
+    }
+    pthread_mutex_unlock(&store->lock);
+    return entry != NULL;
+}
+
+bool RTSPDVRStoreRead(RTSPDVRStoreRef store, uint64_t sequence, uint64_t offset, uint64_t length,
+                      RTSPByteBuffer *output) {
+    if (!store || !output) {
+        return false;
+    }
+    pthread_mutex_lock(&store->lock);
+    RTSPDVRIndexEntry *entry = RTSPDVREntry(store, sequence);
+    uint64_t available = entry ? entry->length : 0;
+    pthread_mutex_unlock(&store->lock);
+    if (!entry || offset > available) {
+        return false;
+    }
+    if (length > available - offset) {
+        length = available - offset;
+    }
+    if (length == 0) {
+        return true;
+    }
+    if (!RTSPByteBufferReserve(output, (size_t)length)) {
+        return false;
+    }
+    char path[PATH_MAX];
+    RTSPDVRSlotPath(store, RTSPDVRSlotForSequence(store, sequence), path, sizeof(path));
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    bool ok = fd >= 0 && RTSPDVRReadAll(fd, output->data + output->length, (size_t)length, (off_t)offset);
+    if (fd >= 0) {
+        close(fd);
+    }
+
+    // The appender claims a slot before it writes to it, so the bytes are
+    // good if the segment still owns its slot now
+    pthread_mutex_lock(&store->lock);
+    ok = ok && RTSPDVREntry(store, sequence) == entry;
+    pthread_mutex_unlock(&store->lock);
+    if (ok) {
+        output->length += (size_t)length;
+    }
+    return ok;
+}
+
+#pragma mark - Keyframes
+
+static uint32_t RTSPDVRReadU32(const uint8_t *p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+/// First child box of a type among `length` bytes of sibling boxes
+static bool RTSPDVRFindBox(const uint8_t *data, size_t length, const char *type,
+                           const uint8_t **payload, size_t *payloadLength) {
+    while (length >= 8) {
+        uint64_t size = RTSPDVRReadU32(data);
+        size_t header = 8;
+        if (size == 1) {
+            if (length < 16) {
+                return false;
+            }
+            size = (uint64_t)RTSPDVRReadU32(data + 8) << 32 | RTSPDVRReadU32(data + 12);
+            header = 16;
+        } else if (size == 0) {
+            size = length;
+        }
+        if (size < header || size > length) {
+            return false;
+        }
+        if (memcmp(data + 4, type, 4) == 0) {
+            *payload = data + header;
+            *payloadLength = (size_t)size - header;
+            return true;
+        }
+        data += size;
+        length -= (size_t)size;
+    }
+    return false;
+}
+
+/// Codec, dimensions and decoder record from the sample entry of an init segment
+static bool RTSPDVRParseInit(const uint8_t *init, size_t length, RTSPDVRKeyframeSample *keyframe,
+                             const uint8_t **record, size_t *recordLength) {
+    static const char *const path[] = {"moov", "trak", "mdia", "minf", "stbl", "stsd"};
+    const uint8_t *box = init;
+    size_t boxLength = length;
+    for (size_t i = 0; i < sizeof(path) / sizeof(path[0]); i++) {
+        if (!RTSPDVRFindBox(box, boxLength, path[i], &box, &boxLength)) {
+            return false;
+        }
+    }
+    // stsd: version/flags and entry count, then the first sample entry
+    if (boxLength < 16) {
+        return false;
+    }
+    box += 8;
+    boxLength -= 8;
+    const char *configType;
+    if (memcmp(box + 4, "avc1", 4) == 0 || memcmp(box + 4, "avc3", 4) == 0) {
+        keyframe->codec = RTSPVideoCodecH264;
+        configType = "avcC";
+    } else if (memcmp(box + 4, "hvc1", 4) == 0 || memcmp(box + 4, "hev1", 4) == 0) {
+        keyframe->codec = RTSPVideoCodecH265;
+        configType = "hvcC";
+    } else {
+        return false;
+    }
+    const uint8_t *entry;
+    size_t entryLength;
+    if (!RTSPDVRFindBox(box, boxLength, (const char *)box + 4, &entry, &entryLength) || entryLength < 78) {
+        return false;
+    }
+    // VisualSampleEntry: 24 bytes of reserved fields, width, height, then 50 more before the child boxes
+    keyframe->width = (uint32_t)entry[24] << 8 | entry[25];
+    keyframe->height = (uint32_t)entry[26] << 8 | entry[27];
+    return RTSPDVRFindBox(entry + 78, entryLength - 78, configType, record, recordLength);
+}
+
+/// First sample of a fragment: its offset, from the moof unless the tfhd
+/// gives a base offset in the file, and its size
+static bool RTSPDVRParseMoof(const uint8_t *moof, size_t length, uint64_t *dataOffset, bool *fromFile,
+                             uint32_t *sampleSize) {
+    const uint8_t *traf, *tfhd, *trun;
+    size_t trafLength, tfhdLength, trunLength;
+    if (!RTSPDVRFindBox(moof, length, "traf", &traf, &trafLength) ||
+        !RTSPDVRFindBox(traf, trafLength, "tfhd", &tfhd, &tfhdLength) ||
+        !RTSPDVRFindBox(traf, trafLength, "trun", &trun, &trunLength) || tfhdLength < 8 || trunLength < 8) {
+        return false;
+    }
+    // tfhd: version/flags, track ID, then the optional fields its flags name
+    uint32_t tfhdFlags = RTSPDVRReadU32(tfhd) & 0xFFFFFF;
+    size_t field = 8;
+    uint64_t base = 0;
+    uint32_t defaultSize = 0;
+    if (tfhdFlags & 0x01) {
+        if (tfhdLength < field + 8) {
+            return false;
+        }
+        base = (uint64_t)RTSPDVRReadU32(tfhd + field) << 32 | RTSPDVRReadU32(tfhd + field + 4);
+        field += 8;
+    }
+    field += (tfhdFlags & 0x02) ? 4 : 0;
+    field += (tfhdFlags & 0x08) ? 4 : 0;
+    if (tfhdFlags & 0x10) {
+        if (tfhdLength < field + 4) {
+            return false;
+        }
+        defaultSize = RTSPDVRReadU32(tfhd + field);
+    }
+
+    // trun: version/flags, sample count, data offset, first sample flags, then per-sample fields
+    uint32_t trunFlags = RTSPDVRReadU32(trun) & 0xFFFFFF;
+    if (RTSPDVRReadU32(trun + 4) == 0) {
+        return false;
+    }
+    field = 8;
+    int32_t offset = 0;
+    if (trunFlags & 0x001) {
+        if (trunLength < field + 4) {
+            return false;
+        }
+        offset = (int32_t)RTSPDVRReadU32(trun + field);
+        field += 4;
+    } else {
+        // Without a data offset the samples start in the mdat right after the moof
+        offset = (int32_t)(length + 16);
+    }
+    field += (trunFlags & 0x004) ? 4 : 0;
+    field += (trunFlags & 0x100) ? 4 : 0;
+    uint32_t size = defaultSize;
+    if (trunFlags & 0x200) {
+        if (trunLength < field + 4) {
+            return false;
+        }
+        size = RTSPDVRReadU32(trun + field);
+    }
+    if (size == 0 || offset < 0) {
+        return false;
+    }
+    *dataOffset = base + (uint64_t)offset;
+    *fromFile = (tfhdFlags & 0x01) != 0;
+    *sampleSize = size;
+    return true;
+}
+
+bool RTSPDVRStoreReadKeyframe(RTSPDVRStoreRef store, const RTSPDVRSeekPoint *point,
+                              RTSPDVRKeyframeSample *keyframe, RTSPByteBuffer *output) {
+    if (!store || !point || !keyframe || !output) {
+        return false;
+    }
+    pthread_mutex_lock(&store->lock);
+    RTSPDVRIndexEntry *entry = RTSPDVREntry(store, point->sequence);
+    uint64_t available = entry ? entry->length : 0;
+    uint32_t mediaOffset = entry ? entry->mediaOffset : 0;
+    pthread_mutex_unlock(&store->lock);
+    if (!entry || point->offset < mediaOffset || point->offset + 8 > available) {
+        return false;
+    }
+
+    char path[PATH_MAX];
+    RTSPDVRSlotPath(store, RTSPDVRSlotForSequence(store, point->sequence), path, sizeof(path));
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    memset(keyframe, 0, sizeof(*keyframe));
+    size_t start = output->length;
+    RTSPByteBuffer scratch;
+    RTSPByteBufferInit(&scratch);
+    uint8_t header[8];
+    const uint8_t *record = NULL;
+    size_t recordLength = 0;
+    uint64_t moofLength = 0;
+    uint64_t dataOffset = 0;
+    bool fromFile = false;
+    uint32_t sampleSize = 0;
+
+    // Init segment, then the moof's size, the moof, and the one sample
+    bool ok = RTSPByteBufferReserve(&scratch, mediaOffset) &&
+              RTSPDVRReadAll(fd, scratch.data, mediaOffset, 0) &&
+              RTSPDVRParseInit(scratch.data, mediaOffset, keyframe, &record, &recordLength) &&
+              RTSPDVRReadAll(fd, header, sizeof(header), (off_t)point->offset);
+    if (ok) {
+        keyframe->configOffset = output->length;
+        keyframe->configLength = recordLength;
+        RTSPByteBufferAppend(output, record, recordLength);
+        moofLength = RTSPDVRReadU32(header);
+        ok = !output->failed && memcmp(header + 4, "moof", 4) == 0 && moofLength > 8 &&
+             point->offset + moofLength <= available;
+    }
+    if (ok) {
+        RTSPByteBufferReset(&scratch);
+        ok = RTSPByteBufferReserve(&scratch, (size_t)moofLength - 8) &&
+             RTSPDVRReadAll(fd, scratch.data, (size_t)moofLength - 8, (off_t)point->offset + 8) &&
+             RTSPDVRParseMoof(scratch.data, (size_t)moofLength - 8, &dataOffset, &fromFile, &sampleSize);
+        if (ok && !fromFile) {
+            dataOffset += point->offset;
+        }
+        ok = ok && dataOffset >= point->offset + moofLength && dataOffset + sampleSize <= available &&
+             RTSPByteBufferReserve(output, sampleSize) &&
+             RTSPDVRReadAll(fd, output->data + output->length, sampleSize, (off_t)dataOffset);
+    }
+    close(fd);
+    RTSPByteBufferFree(&scratch);
+
+    // Same ownership check as a read: the bytes are good if the segment still owns its slot
+    pthread_mutex_lock(&store->lock);
+    ok = ok && RTSPDVREntry(store, point->sequence) == entry;
+    pthread_mutex_unlock(&store->lock);
+    if (!ok) {
+        output->length = start;
+        return false;
+    }
+    keyframe->sampleOffset = output->length;
+    keyframe->sampleLength = sampleSize;
+    output->length += sampleSize;
+    return true;
+}
+
+#pragma mark - Playlist
+
+static void RTSPDVRAppendDate(RTSPByteBuffer *b, int64_t time) {
+    time_t seconds = (time_t)(time / 1000000);
+    struct tm utc;
+    gmtime_r(&seconds, &utc);
+    char date[32];
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", &utc);
+    RTSPByteBufferAppendFormat(b, "#EXT-X-PROGRAM-DATE-TIME:%s.%03dZ\n", date, (int)(time % 1000000 / 1000));
+}
+
+bool RTSPDVRStoreWritePlaylist(RTSPDVRStoreRef store, int64_t start, int64_t end,
+                               const char *uriPrefix, const char *uriSuffix, RTSPByteBuffer *output) {
+    if (!store || !output) {
+        return false;
+    }
+    size_t capacity = store->config.slotCount;
+    RTSPDVRSegmentInfo *segments = malloc(capacity * sizeof(*segments));
+    if (!segments) {
+        return false;
+    }
+    size_t count = RTSPDVRStoreFindSegments(store, start, end, segments, capacity);
+    if (count > capacity) {
+        count = capacity;
+    }
+    if (count == 0) {
+        free(segments);
+        return false;
+    }
+    const char *prefix = uriPrefix ? uriPrefix : "";
+    const char *suffix = uriSuffix ? uriSuffix : "";
+
+    double targetDuration = 1;
+    for (size_t i = 0; i < count; i++) {
+        double duration = (double)(segments[i].endTime - segments[i].startTime) / 1e6;
+        if (duration > targetDuration) {
+            targetDuration = duration;
+        }
+    }
+    RTSPByteBuffer *b = output;
+    RTSPByteBufferAppendString(b, "#EXTM3U\n#EXT-X-VERSION:7\n");
+    RTSPByteBufferAppendFormat(b, "#EXT-X-TARGETDURATION:%d\n", (int)ceil(targetDuration));
+    RTSPByteBufferAppendFormat(b, "#EXT-X-MEDIA-SEQUENCE:%llu\n", (unsigned long long)segments[0].sequence);
+    RTSPByteBufferAppendString(b, "#EXT-X-PLAYLIST-TYPE:VOD\n#EXT-X-INDEPENDENT-SEGMENTS\n");
+    if (start > segments[0].startTime) {
+        RTSPByteBufferAppendFormat(b, "#EXT-X-START:TIME-OFFSET=%.3f,PRECISE=YES\n",
+                                   (double)(start - segments[0].startTime) / 1e6);
+    }
+    for (size_t i = 0; i < count; i++) {
+        const RTSPDVRSegmentInfo *segment = &segments[i];
+        if (i > 0 && (segment->discontinuity || segment->sequence != segments[i - 1].sequence + 1)) {
+            RTSPByteBufferAppendString(b, "#EXT-X-DISCONTINUITY\n");
+        }
+        if (i == 0 || segment->initHash != segments[i - 1].initHash) {
+            RTSPByteBufferAppendFormat(b, "#EXT-X-MAP:URI=\"%sinit/%llu%s\"\n",
+                                       prefix, (unsigned long long)segment->sequence, suffix);
+        }
+        RTSPDVRAppendDate(b, segment->startTime);
+        RTSPByteBufferAppendFormat(b, "#EXTINF:%.5f,\n%ssegments/%llu%s\n",
+                                   (double)(segment->endTime - segment->startTime) / 1e6,
+                                   prefix, (unsigned long long)segment->sequence, suffix);
+    }
+    RTSPByteBufferAppendString(b, "#EXT-X-ENDLIST\n");
+    free(segments);
+    return !b->failed;
+}
+
+#pragma mark - Statistics
+
+RTSPDVRStoreStatistics RTSPDVRStoreGetStatistics(RTSPDVRStoreRef store) {
+    RTSPDVRStoreStatistics statistics = {0};
+    if (!store) {
+        return statistics;
+    }
+    pthread_mutex_lock(&store->lock);
+    uint64_t next = store->header->nextSequence;
+    statistics.segments = (uint32_t)(next - store->oldestSequence);
+    for (uint64_t sequence = store->oldestSequence; sequence < next; sequence++) {
+        statistics.bytes += RTSPDVRSlotEntry(store, RTSPDVRSlotForSequence(store, sequence))->length;
+    }
+    if (statistics.segments > 0) {
+        statistics.oldestTime = RTSPDVRSlotEntry(store, RTSPDVRSlotForSequence(store, store->oldestSequence))->startTime;
+        statistics.newestTime = RTSPDVRSlotEntry(store, RTSPDVRSlotForSequence(store, next - 1))->endTime;
+    }
+    statistics.bytesWritten = store->bytesWritten;
+    statistics.overwritten = store->overwritten;
+    statistics.droppedMedia = store->droppedMedia;
+    statistics.writeErrors = store->writeErrors;
+    pthread_mutex_unlock(&store->lock);
+    return statistics;
+}
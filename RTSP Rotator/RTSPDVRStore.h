@@ -0,0 +1,153 @@
+//
+//  RTSPDVRStore.h
+//  RTSP Rotator
+//
+//  Continuous recording of one camera to a fixed ring of fragmented MP4
+//  segment files, for scrubbing back through the last N hours. Segments are
+//  cut at the first keyframe past segmentDuration; segment number S lives in
+//  slot file segment-NNNNN.m4s for slot (S - 1) % slotCount and begins with
+//  its init segment, so every file plays on its own. Once the ring is full
+//  the oldest segment is overwritten in place: disk use is bounded by
+//  slotCount × slotBytes and retention never lists or deletes files.
+//
+//  index.dat is a fixed-size table, memory-mapped: one entry per slot with
+//  the segment's wall-clock range, length and keyframe offsets. Segment
+//  numbers in the ring are contiguous and their times ascending, so a seek
+//  is a binary search over segments then over one segment's keyframes.
+//
+//  Appends come from one thread and do blocking file I/O, so the caller runs
+//  them off the engine thread. Lookups and reads are safe from any thread;
+//  a read of a segment that was overwritten meanwhile fails instead of
+//  returning the newer bytes. See Benchmarks/dvr_store_bench.c.
+//
+
+#ifndef RTSPDVRStore_h
+#define RTSPDVRStore_h
+
+#include "RTSPByteBuffer.h"
+#include "RTSPCodecConfig.h"
+#include "RTSPRemuxEngine.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t slotCount;             // Segments kept; retention is slotCount × segmentDuration. Default 8640 (24 h)
+    uint64_t slotBytes;             // Space reserved per slot file. Default 16 MB
+    double segmentDuration;         // Seconds; also cut early at 3/4 of slotBytes. Default 10
+    uint32_t maxKeyframes;          // Seek points indexed per segment; a full table cuts the segment. Default 32
+    bool reserveSpace;              // Allocate a slot file's blocks when it is first used, not sparse. Default true
+    bool syncOnCut;                 // fsync the segment and the index when a segment is finished. Default false
+} RTSPDVRStoreConfig;
+
+void RTSPDVRStoreConfigInit(RTSPDVRStoreConfig *config);
+
+/// One stored segment. Times are microseconds since 1970.
+typedef struct {
+    uint64_t sequence;              // Segment number, from 1, never reused
+    int64_t startTime;
+    int64_t endTime;
+    uint32_t length;                // Bytes in the file: init segment, then media
+    uint32_t mediaOffset;           // Length of the init segment
+    uint32_t initHash;              // Equal for segments decoded with the same init segment
+    uint32_t keyframes;
+    bool complete;                  // No longer being appended to
+    bool discontinuity;             // Follows a gap: reconnect, dropped media or a new init segment
+} RTSPDVRSegmentInfo;
+
+/// A keyframe to start playback from
+typedef struct {
+    uint64_t sequence;
+    uint64_t offset;                // Byte offset of its moof in the segment file
+    int64_t time;                   // Microseconds since 1970
+} RTSPDVRSeekPoint;
+
+typedef struct {
+    uint32_t segments;              // Held now
+    int64_t oldestTime;             // 0 when empty
+    int64_t newestTime;
+    uint64_t bytes;                 // Media held, including init segments
+    uint64_t bytesWritten;          // Since open
+    uint64_t overwritten;           // Segments dropped by the ring since open
+    uint64_t droppedMedia;          // Media without an init segment or keyframe before it
+    uint64_t writeErrors;
+} RTSPDVRStoreStatistics;
+
+typedef struct RTSPDVRStore *RTSPDVRStoreRef;
+
+/// Opens or creates the store in `directory`. An existing index with other
+/// slot geometry is discarded and the ring starts over. `config` may be NULL
+/// for defaults. Returns NULL with errno set on failure.
+RTSPDVRStoreRef RTSPDVRStoreOpen(const char *directory, const RTSPDVRStoreConfig *config);
+
+RTSPDVRStoreRef RTSPDVRStoreRetain(RTSPDVRStoreRef store);
+
+/// The last release finishes the current segment and closes the store
+void RTSPDVRStoreRelease(RTSPDVRStoreRef store);
+
+/// Engine output, as delivered to an RTSPRemuxSink. Feed parts when the
+/// engine emits them and segments otherwise, not both; each independent
+/// one is a seek point. `time` is the wall clock of the media's first
+/// sample. One thread at a time.
+void RTSPDVRStoreAddInitSegment(RTSPDVRStoreRef store, uint32_t initID, const uint8_t *data, size_t length);
+void RTSPDVRStoreAddMedia(RTSPDVRStoreRef store, const RTSPRemuxMediaInfo *info, const uint8_t *data, size_t length,
+                          int64_t time);
+
+/// Finish the current segment, e.g. when the stream stops or media was lost
+/// before it reached the store. The next media starts a new segment at a
+/// keyframe, marked as a discontinuity.
+void RTSPDVRStoreCut(RTSPDVRStoreRef store);
+
+/// Segments overlapping [start, end), oldest first. Copies at most
+/// `capacity` and returns how many overlap.
+size_t RTSPDVRStoreFindSegments(RTSPDVRStoreRef store, int64_t start, int64_t end,
+                                RTSPDVRSegmentInfo *segments, size_t capacity);
+
+bool RTSPDVRStoreGetSegment(RTSPDVRStoreRef store, uint64_t sequence, RTSPDVRSegmentInfo *segment);
+
+/// The last keyframe at or before `time`, or the oldest one if `time` is
+/// before the ring. False when the store is empty.
+bool RTSPDVRStoreSeek(RTSPDVRStoreRef store, int64_t time, RTSPDVRSeekPoint *point);
+
+/// Appends bytes [offset, offset + length) of a segment, clamped to its
+/// current length. False if the segment is not (or no longer) held.
+bool RTSPDVRStoreRead(RTSPDVRStoreRef store, uint64_t sequence, uint64_t offset, uint64_t length,
+                      RTSPByteBuffer *output);
+
+/// What a decoder needs for one seek point's keyframe, as ranges of the
+/// output buffer
+typedef struct {
+    RTSPVideoCodec codec;
+    uint32_t width;                 // From the sample entry
+    uint32_t height;
+    size_t configOffset;            // avcC / hvcC payload
+    size_t configLength;
+    size_t sampleOffset;            // The keyframe: length-prefixed NAL units
+    size_t sampleLength;
+} RTSPDVRKeyframeSample;
+
+/// Appends the decoder configuration and the first sample of the fragment
+/// at a seek point, reading only those bytes and the moof rather than the
+/// segment. False if the segment is no longer held or does not parse.
+bool RTSPDVRStoreReadKeyframe(RTSPDVRStoreRef store, const RTSPDVRSeekPoint *point,
+                              RTSPDVRKeyframeSample *keyframe, RTSPByteBuffer *output);
+
+/// HLS playlist over the segments overlapping [start, end), starting playback
+/// at `start`. URIs are `<uriPrefix>init/<sequence>` for init segments and
+/// `<uriPrefix>segments/<sequence>` for media, followed by `uriSuffix`
+/// (e.g. "?key=..."); either may be NULL. False when nothing overlaps.
+bool RTSPDVRStoreWritePlaylist(RTSPDVRStoreRef store, int64_t start, int64_t end,
+                               const char *uriPrefix, const char *uriSuffix, RTSPByteBuffer *output);
+
+RTSPDVRStoreStatistics RTSPDVRStoreGetStatistics(RTSPDVRStoreRef store);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RTSPDVRStore_h */
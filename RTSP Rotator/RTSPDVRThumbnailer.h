@@ -0,0 +1,43 @@
+//
+//  RTSPDVRThumbnailer.h
+//  RTSP Rotator
+//
+//  Timeline thumbnails for one camera's DVR ring. A thumbnail is made the
+//  first time it is asked for, from the keyframe a seek lands on: only that
+//  keyframe is read from disk and decoded (VideoToolbox, scaled to the tile
+//  by the decoder), then kept in an RTSPTimelineSprite sheet next to the
+//  ring. Times that share a keyframe share its tile.
+//
+
+#import <Foundation/Foundation.h>
+#import <CoreGraphics/CoreGraphics.h>
+#import "RTSPDVRStore.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@interface RTSPDVRThumbnailer : NSObject
+
+/// Retains the store. Returns nil if the sprite file cannot be opened.
+- (nullable instancetype)initWithStore:(RTSPDVRStoreRef)store spritePath:(NSString *)path;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/// Tile size in pixels
+@property (nonatomic, readonly) CGSize tileSize;
+
+/// Thumbnail of a keyframe, decoded if it is not cached. Blocks; nil if the
+/// keyframe's segment has been overwritten or does not decode.
+- (nullable CGImageRef)copyThumbnailForKeyframe:(RTSPDVRSeekPoint)keyframe CF_RETURNS_RETAINED;
+
+/// `count` thumbnails side by side, for times spread evenly over
+/// [start, end) (microseconds since 1970). Tiles before the recording or
+/// that fail to decode are left transparent. Blocks; nil if nothing in the
+/// range is recorded.
+- (nullable CGImageRef)copyStripFrom:(int64_t)start to:(int64_t)end count:(NSUInteger)count CF_RETURNS_RETAINED;
+
+/// Keys: tiles, hits, misses, replaced, decoded, decodeFailures
+- (NSDictionary *)statistics;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,264 @@
+//
+//  RTSPDVRThumbnailer.m
+//  RTSP Rotator
+//
+
+#import "RTSPDVRThumbnailer.h"
+#import "RTSPTimelineSprite.h"
+#import <CoreMedia/CoreMedia.h>
+#import <VideoToolbox/VideoToolbox.h>
+
+@implementation RTSPDVRThumbnailer {
+    RTSPDVRStoreRef _store;
+    RTSPTimelineSpriteRef _sprite;
+    RTSPTimelineSpriteConfig _config;
+    dispatch_queue_t _decodeQueue;              // One decode at a time; owns everything below
+    VTDecompressionSessionRef _session;
+    CMVideoFormatDescriptionRef _format;
+    RTSPVideoCodec _formatCodec;
+    NSData *_formatRecord;                      // avcC / hvcC _format was made from
+    uint64_t _decoded;
+    uint64_t _decodeFailures;
+}
+
+- (nullable instancetype)initWithStore:(RTSPDVRStoreRef)store spritePath:(NSString *)path {
+    self = [super init];
+    if (self) {
+        _sprite = RTSPTimelineSpriteOpen(path.fileSystemRepresentation, NULL);
+        if (!_sprite) {
+            NSLog(@"[FFmpegProxy] ✗ Could not open thumbnail sprite %@: %s", path, strerror(errno));
+            return nil;
+        }
+        _config = RTSPTimelineSpriteGetConfig(_sprite);
+        _store = RTSPDVRStoreRetain(store);
+        _decodeQueue = dispatch_queue_create("com.rtsp.dvr.thumbnails", DISPATCH_QUEUE_SERIAL);
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [self invalidateSession];
+    RTSPTimelineSpriteClose(_sprite);
+    RTSPDVRStoreRelease(_store);
+}
+
+- (CGSize)tileSize {
+    return CGSizeMake(_config.tileWidth, _config.tileHeight);
+}
+
+#pragma mark - Thumbnails
+
+- (nullable CGImageRef)copyThumbnailForKeyframe:(RTSPDVRSeekPoint)keyframe {
+    size_t bytesPerRow = (size_t)_config.tileWidth * 4;
+    NSMutableData *pixels = [NSMutableData dataWithLength:bytesPerRow * _config.tileHeight];
+    if (![self copyKeyframe:keyframe into:pixels.mutableBytes bytesPerRow:bytesPerRow]) {
+        return NULL;
+    }
+    return [self copyImageWithPixels:pixels width:_config.tileWidth bytesPerRow:bytesPerRow];
+}
+
+- (nullable CGImageRef)copyStripFrom:(int64_t)start to:(int64_t)end count:(NSUInteger)count {
+    if (count == 0 || end <= start) {
+        return NULL;
+    }
+    size_t tileBytes = (size_t)_config.tileWidth * 4;
+    size_t bytesPerRow = tileBytes * count;
+    NSMutableData *pixels = [NSMutableData dataWithLength:bytesPerRow * _config.tileHeight];
+    uint8_t *row = pixels.mutableBytes;
+
+    BOOL recorded = NO;
+    RTSPDVRSeekPoint previous = {0};
+    BOOL previousCopied = NO;
+    for (NSUInteger i = 0; i < count; i++) {
+        int64_t time = start + (int64_t)((double)(end - start) * (2 * i + 1) / (2.0 * count));
+        RTSPDVRSeekPoint keyframe;
+        if (!RTSPDVRStoreSeek(_store, time, &keyframe)) {
+            return NULL;
+        }
+        // Before the recording: the seek lands on the oldest keyframe, after `time`
+        if (keyframe.time > time) {
+            continue;
+        }
+        recorded = YES;
+        uint8_t *destination = row + i * tileBytes;
+        if (previousCopied && keyframe.sequence == previous.sequence && keyframe.offset == previous.offset) {
+            for (uint32_t y = 0; y < _config.tileHeight; y++) {
+                memcpy(destination + y * bytesPerRow, destination - tileBytes + y * bytesPerRow, tileBytes);
+            }
+            continue;
+        }
+        previous = keyframe;
+        previousCopied = [self copyKeyframe:keyframe into:destination bytesPerRow:bytesPerRow];
+    }
+    if (!recorded) {
+        return NULL;
+    }
+    return [self copyImageWithPixels:pixels width:_config.tileWidth * (uint32_t)count bytesPerRow:bytesPerRow];
+}
+
+/// Copies a keyframe's tile, decoding it first on a miss
+- (BOOL)copyKeyframe:(RTSPDVRSeekPoint)keyframe into:(uint8_t *)pixels bytesPerRow:(size_t)bytesPerRow {
+    int32_t tile = RTSPTimelineSpriteLookup(_sprite, &keyframe);
+    if (tile >= 0 && RTSPTimelineSpriteCopyTile(_sprite, tile, &keyframe, pixels, bytesPerRow)) {
+        return YES;
+    }
+    __block BOOL copied = NO;
+    dispatch_sync(_decodeQueue, ^{
+        // Another caller may have decoded it while this one waited
+        int32_t cached = RTSPTimelineSpriteLookup(self->_sprite, &keyframe);
+        if (cached < 0) {
+            cached = [self decodeKeyframe:keyframe];
+        }
+        copied = cached >= 0 && RTSPTimelineSpriteCopyTile(self->_sprite, cached, &keyframe, pixels, bytesPerRow);
+    });
+    return copied;
+}
+
+- (CGImageRef)copyImageWithPixels:(NSData *)pixels width:(uint32_t)width bytesPerRow:(size_t)bytesPerRow CF_RETURNS_RETAINED {
+    CGDataProviderRef provider = CGDataProviderCreateWithCFData((__bridge CFDataRef)pixels);
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateWithName(kCGColorSpaceSRGB);
+    CGImageRef image = CGImageCreate(width, _config.tileHeight, 8, 32, bytesPerRow, colorSpace,
+                                     kCGBitmapByteOrder32Little | kCGImageAlphaPremultipliedFirst,
+                                     provider, NULL, false, kCGRenderingIntentDefault);
+    CGColorSpaceRelease(colorSpace);
+    CGDataProviderRelease(provider);
+    return image;
+}
+
+#pragma mark - Decoding
+
+/// Reads one keyframe, decodes it straight to a tile-sized BGRA buffer and
+/// stores it in the sprite. Returns the tile, -1 on failure. decodeQueue.
+- (int32_t)decodeKeyframe:(RTSPDVRSeekPoint)keyframe {
+    RTSPByteBuffer buffer;
+    RTSPByteBufferInit(&buffer);
+    RTSPDVRKeyframeSample sample;
+    __block int32_t tile = -1;
+    if (RTSPDVRStoreReadKeyframe(_store, &keyframe, &sample, &buffer) &&
+        [self prepareSessionForCodec:sample.codec
+                              record:[NSData dataWithBytes:buffer.data + sample.configOffset length:sample.configLength]
+                               width:sample.width
+                              height:sample.height]) {
+        CMSampleBufferRef sampleBuffer = [self copySampleBufferWithBytes:buffer.data + sample.sampleOffset
+                                                                  length:sample.sampleLength];
+        if (sampleBuffer) {
+            RTSPTimelineSpriteRef sprite = _sprite;
+            RTSPTimelineSpriteConfig config = _config;
+            VTDecodeInfoFlags infoFlags = 0;
+            OSStatus status = VTDecompressionSessionDecodeFrameWithOutputHandler(
+                _session, sampleBuffer, 0, &infoFlags,
+                ^(OSStatus decodeStatus, VTDecodeInfoFlags flags, CVImageBufferRef imageBuffer,
+                  CMTime presentationTimeStamp, CMTime presentationDuration) {
+                    if (decodeStatus != noErr || !imageBuffer ||
+                        CVPixelBufferGetWidth(imageBuffer) < config.tileWidth ||
+                        CVPixelBufferGetHeight(imageBuffer) < config.tileHeight) {
+                        return;
+                    }
+                    CVPixelBufferLockBaseAddress(imageBuffer, kCVPixelBufferLock_ReadOnly);
+                    tile = RTSPTimelineSpriteInsert(sprite, &keyframe, CVPixelBufferGetBaseAddress(imageBuffer),
+                                                    CVPixelBufferGetBytesPerRow(imageBuffer));
+                    CVPixelBufferUnlockBaseAddress(imageBuffer, kCVPixelBufferLock_ReadOnly);
+                });
+            if (status == noErr) {
+                VTDecompressionSessionWaitForAsynchronousFrames(_session);
+            }
+            CFRelease(sampleBuffer);
+        }
+    }
+    RTSPByteBufferFree(&buffer);
+    if (tile >= 0) {
+        _decoded++;
+    } else {
+        _decodeFailures++;
+    }
+    return tile;
+}
+
+/// Keeps the session while the decoder record stays the same
+- (BOOL)prepareSessionForCodec:(RTSPVideoCodec)codec record:(NSData *)record width:(uint32_t)width height:(uint32_t)height {
+    if (_session && codec == _formatCodec && [record isEqualToData:_formatRecord]) {
+        return YES;
+    }
+    [self invalidateSession];
+    NSString *atom = codec == RTSPVideoCodecH265 ? @"hvcC" : @"avcC";
+    NSDictionary *extensions = @{
+        (__bridge NSString *)kCMFormatDescriptionExtension_SampleDescriptionExtensionAtoms: @{atom: record}
+    };
+    OSStatus status = CMVideoFormatDescriptionCreate(kCFAllocatorDefault,
+                                                     codec == RTSPVideoCodecH265 ? kCMVideoCodecType_HEVC : kCMVideoCodecType_H264,
+                                                     (int32_t)width, (int32_t)height,
+                                                     (__bridge CFDictionaryRef)extensions, &_format);
+    if (status != noErr) {
+        _format = NULL;
+        return NO;
+    }
+    // The decoder scales to the tile, so no pass over full-size pixels here
+    NSDictionary *attributes = @{
+        (__bridge NSString *)kCVPixelBufferPixelFormatTypeKey: @(kCVPixelFormatType_32BGRA),
+        (__bridge NSString *)kCVPixelBufferWidthKey: @(_config.tileWidth),
+        (__bridge NSString *)kCVPixelBufferHeightKey: @(_config.tileHeight)
+    };
+    status = VTDecompressionSessionCreate(kCFAllocatorDefault, _format, NULL,
+                                          (__bridge CFDictionaryRef)attributes, NULL, &_session);
+    if (status != noErr) {
+        NSLog(@"[FFmpegProxy] ✗ Thumbnail decoder unavailable (%d)", (int)status);
+        _session = NULL;
+        [self invalidateSession];
+        return NO;
+    }
+    _formatCodec = codec;
+    _formatRecord = record;
+    return YES;
+}
+
+- (nullable CMSampleBufferRef)copySampleBufferWithBytes:(const uint8_t *)bytes length:(size_t)length CF_RETURNS_RETAINED {
+    CMBlockBufferRef block = NULL;
+    OSStatus status = CMBlockBufferCreateWithMemoryBlock(kCFAllocatorDefault, NULL, length, kCFAllocatorDefault, NULL,
+                                                         0, length, kCMBlockBufferAssureMemoryNowFlag, &block);
+    if (status == kCMBlockBufferNoErr) {
+        status = CMBlockBufferReplaceDataBytes(bytes, block, 0, length);
+    }
+    CMSampleBufferRef sampleBuffer = NULL;
+    if (status == noErr) {
+        status = CMSampleBufferCreateReady(kCFAllocatorDefault, block, _format, 1, 0, NULL, 1, &length, &sampleBuffer);
+    }
+    if (block) {
+        CFRelease(block);
+    }
+    return status == noErr ? sampleBuffer : NULL;
+}
+
+- (void)invalidateSession {
+    if (_session) {
+        VTDecompressionSessionInvalidate(_session);
+        CFRelease(_session);
+        _session = NULL;
+    }
+    if (_format) {
+        CFRelease(_format);
+        _format = NULL;
+    }
+    _formatRecord = nil;
+}
+
+#pragma mark - Statistics
+
+- (NSDictionary *)statistics {
+    RTSPTimelineSpriteStatistics sprite = RTSPTimelineSpriteGetStatistics(_sprite);
+    __block uint64_t decoded = 0;
+    __block uint64_t failures = 0;
+    dispatch_sync(_decodeQueue, ^{
+        decoded = self->_decoded;
+        failures = self->_decodeFailures;
+    });
+    return @{
+        @"tiles": @(sprite.tiles),
+        @"hits": @(sprite.hits),
+        @"misses": @(sprite.misses),
+        @"replaced": @(sprite.replaced),
+        @"decoded": @(decoded),
+        @"decodeFailures": @(failures)
+    };
+}
+
+@end
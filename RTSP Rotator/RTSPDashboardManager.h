@@ -27,6 +27,7 @@ typedef NS_ENUM(NSInteger, RTSPDashboardLayout) {
 @property (nonatomic, strong) NSString *cameraID;
 @property (nonatomic, strong) NSString *name;
 @property (nonatomic, strong) NSURL *feedURL;
+@property (nonatomic, strong, nullable) NSURL *substreamURL; // Low-resolution stream for small grid tiles
 @property (nonatomic, strong, nullable) NSString *username;
 @property (nonatomic, strong, nullable) NSString *password;
 @property (nonatomic, assign) BOOL enabled;
@@ -28,6 +28,7 @@
     [coder encodeObject:self.cameraID forKey:@"cameraID"];
     [coder encodeObject:self.name forKey:@"name"];
     [coder encodeObject:self.feedURL forKey:@"feedURL"];
+    [coder encodeObject:self.substreamURL forKey:@"substreamURL"];
     [coder encodeObject:self.username forKey:@"username"];
     [coder encodeObject:self.password forKey:@"password"];
     [coder encodeBool:self.enabled forKey:@"enabled"];
@@ -45,6 +46,7 @@
         _cameraID = [coder decodeObjectOfClass:[NSString class] forKey:@"cameraID"];
         _name = [coder decodeObjectOfClass:[NSString class] forKey:@"name"];
         _feedURL = [coder decodeObjectOfClass:[NSURL class] forKey:@"feedURL"];
+        _substreamURL = [coder decodeObjectOfClass:[NSURL class] forKey:@"substreamURL"];
         _username = [coder decodeObjectOfClass:[NSString class] forKey:@"username"];
         _password = [coder decodeObjectOfClass:[NSString class] forKey:@"password"];
         _enabled = [coder decodeBoolForKey:@"enabled"];
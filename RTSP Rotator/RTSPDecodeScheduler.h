@@ -0,0 +1,84 @@
+//
+//  RTSPDecodeScheduler.h
+//  RTSP Rotator
+//
+//  Global budget for live video decoders. Grid cells register as clients;
+//  the scheduler decides which of them decode, and whether from the main
+//  stream or the camera's low-resolution substream, from how much of each
+//  tile is actually visible on screen. The focused tile is served first and
+//  gets the main stream when the budget allows; then larger tiles before
+//  smaller ones. Hidden, off-screen and occluded tiles are paused.
+//
+
+#import <Foundation/Foundation.h>
+#import <CoreGraphics/CoreGraphics.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef NS_ENUM(NSInteger, RTSPDecodeMode) {
+    RTSPDecodeModePaused = 0,
+    RTSPDecodeModeMain,
+    RTSPDecodeModeSubstream
+};
+
+@protocol RTSPDecodeSchedulerClient <NSObject>
+
+/// Visible size of the tile in device pixels; zero when it cannot be seen
+- (CGSize)decodeVisiblePixelSize;
+
+/// Whether this tile has user focus
+- (BOOL)decodeHasFocus;
+
+/// Whether the camera offers a low-resolution substream
+- (BOOL)decodeHasSubstream;
+
+/// Decoded pixels per second for a mode (measured once playing, estimated before)
+- (double)decodePixelRateForMode:(RTSPDecodeMode)mode;
+
+/// Switch to the mode the scheduler picked. Called on the main thread, only on change.
+- (void)applyDecodeMode:(RTSPDecodeMode)mode;
+
+@end
+
+/// Posted on the main thread after each pass that changed any client's mode
+extern NSString * const RTSPDecodeSchedulerDidUpdateNotification;
+
+@interface RTSPDecodeScheduler : NSObject
+
+/// Shared instance; all grids draw from the same budget
++ (instancetype)sharedScheduler;
+
+/// Most decoders running at once (default: 9). The budget settings persist in user defaults.
+@property (nonatomic, assign) NSUInteger maxActiveDecoders;
+
+/// Most decoded pixels per second across all decoders (default: 4K at 60 fps)
+@property (nonatomic, assign) double maxPixelsPerSecond;
+
+/// Tiles at most this tall (device pixels) use the substream when there is
+/// one (default: 540)
+@property (nonatomic, assign) CGFloat substreamMaxTileHeight;
+
+/// Register a client. Clients are held weakly and start paused.
+- (void)addClient:(id<RTSPDecodeSchedulerClient>)client;
+
+/// Unregister a client; its mode is left as is
+- (void)removeClient:(id<RTSPDecodeSchedulerClient>)client;
+
+/// Re-evaluate on the next main run loop pass (coalesced). Call after
+/// anything that changes visibility, size, focus or a pixel rate.
+- (void)setNeedsUpdate;
+
+/// Current mode of a registered client
+- (RTSPDecodeMode)modeForClient:(id<RTSPDecodeSchedulerClient>)client;
+
+/**
+ * Statistics: clients, activeDecoders, mainDecoders, substreamDecoders,
+ * pausedDecoders, pixelsPerSecond, downgradedToSubstream (in the last pass,
+ * for lack of budget), deniedByBudget (visible but paused in the last pass),
+ * passes, modeChanges, plus the three budget settings.
+ */
+- (NSDictionary<NSString *, NSNumber *> *)statistics;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,305 @@
+//
+//  RTSPDecodeScheduler.m
+//  RTSP Rotator
+//
+
+#import "RTSPDecodeScheduler.h"
+#import <AppKit/AppKit.h>
+
+NSString * const RTSPDecodeSchedulerDidUpdateNotification = @"RTSPDecodeSchedulerDidUpdateNotification";
+
+static NSString * const kRTSPDecodeMaxActiveDecodersKey = @"DecodeMaxActiveDecoders";
+static NSString * const kRTSPDecodeMaxPixelsPerSecondKey = @"DecodeMaxPixelsPerSecond";
+static NSString * const kRTSPDecodeSubstreamMaxTileHeightKey = @"DecodeSubstreamMaxTileHeight";
+
+static const NSTimeInterval kRTSPDecodeSchedulerInterval = 2.0;    // Catches visibility changes nobody posts
+static const CGFloat kRTSPDecodeSubstreamHysteresis = 1.1;         // Keeps resizing tiles from flapping between streams
+
+@interface RTSPDecodeClientEntry : NSObject
+@property (nonatomic, weak) id<RTSPDecodeSchedulerClient> client;
+@property (nonatomic, assign) RTSPDecodeMode mode;
+@property (nonatomic, assign) NSUInteger order;
+// Sampled at the start of each pass
+@property (nonatomic, assign) CGSize visibleSize;
+@property (nonatomic, assign) BOOL focused;
+@end
+
+@implementation RTSPDecodeClientEntry
+@end
+
+@interface RTSPDecodeScheduler ()
+@property (nonatomic, strong) NSMutableArray<RTSPDecodeClientEntry *> *entries;
+@property (nonatomic, strong, nullable) NSTimer *timer;
+@property (nonatomic, assign) BOOL updatePending;
+@property (atomic, copy) NSDictionary<NSString *, NSNumber *> *lastPass;   // Read by the API threads
+@end
+
+@implementation RTSPDecodeScheduler {
+    NSUInteger _nextOrder;
+    uint64_t _passes;
+    uint64_t _modeChanges;
+}
+
++ (instancetype)sharedScheduler {
+    static RTSPDecodeScheduler *shared = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        shared = [[self alloc] init];
+    });
+    return shared;
+}
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        _entries = [NSMutableArray array];
+        _lastPass = @{};
+
+        NSUserDefaults *defaults = [NSUserDefaults standardUserDefaults];
+        NSInteger maxActive = [defaults integerForKey:kRTSPDecodeMaxActiveDecodersKey];
+        double maxPixels = [defaults doubleForKey:kRTSPDecodeMaxPixelsPerSecondKey];
+        double maxTileHeight = [defaults doubleForKey:kRTSPDecodeSubstreamMaxTileHeightKey];
+        _maxActiveDecoders = maxActive > 0 ? (NSUInteger)maxActive : 9;
+        _maxPixelsPerSecond = maxPixels > 0 ? maxPixels : 3840.0 * 2160.0 * 60.0;
+        _substreamMaxTileHeight = maxTileHeight > 0 ? maxTileHeight : 540.0;
+
+        NSNotificationCenter *center = [NSNotificationCenter defaultCenter];
+        for (NSNotificationName name in @[NSWindowDidChangeOcclusionStateNotification,
+                                          NSWindowDidMiniaturizeNotification,
+                                          NSWindowDidDeminiaturizeNotification,
+                                          NSWindowDidChangeBackingPropertiesNotification,
+                                          NSWindowDidEndLiveResizeNotification,
+                                          NSApplicationDidHideNotification,
+                                          NSApplicationDidUnhideNotification]) {
+            [center addObserver:self selector:@selector(windowStateDidChange:) name:name object:nil];
+        }
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+    [self.timer invalidate];
+}
+
+#pragma mark - Budget
+
+- (void)setMaxActiveDecoders:(NSUInteger)maxActiveDecoders {
+    _maxActiveDecoders = MAX(maxActiveDecoders, 1);
+    [[NSUserDefaults standardUserDefaults] setInteger:(NSInteger)_maxActiveDecoders forKey:kRTSPDecodeMaxActiveDecodersKey];
+    [self setNeedsUpdate];
+}
+
+- (void)setMaxPixelsPerSecond:(double)maxPixelsPerSecond {
+    _maxPixelsPerSecond = MAX(maxPixelsPerSecond, 1.0);
+    [[NSUserDefaults standardUserDefaults] setDouble:_maxPixelsPerSecond forKey:kRTSPDecodeMaxPixelsPerSecondKey];
+    [self setNeedsUpdate];
+}
+
+- (void)setSubstreamMaxTileHeight:(CGFloat)substreamMaxTileHeight {
+    _substreamMaxTileHeight = MAX(substreamMaxTileHeight, 0.0);
+    [[NSUserDefaults standardUserDefaults] setDouble:_substreamMaxTileHeight forKey:kRTSPDecodeSubstreamMaxTileHeightKey];
+    [self setNeedsUpdate];
+}
+
+#pragma mark - Clients
+
+- (nullable RTSPDecodeClientEntry *)entryForClient:(id<RTSPDecodeSchedulerClient>)client {
+    for (RTSPDecodeClientEntry *entry in self.entries) {
+        if (entry.client == client) {
+            return entry;
+        }
+    }
+    return nil;
+}
+
+- (void)addClient:(id<RTSPDecodeSchedulerClient>)client {
+    NSAssert([NSThread isMainThread], @"RTSPDecodeScheduler is main-thread only");
+    if ([self entryForClient:client]) {
+        [self setNeedsUpdate];
+        return;
+    }
+    RTSPDecodeClientEntry *entry = [[RTSPDecodeClientEntry alloc] init];
+    entry.client = client;
+    entry.mode = RTSPDecodeModePaused;
+    entry.order = _nextOrder++;
+    [self.entries addObject:entry];
+
+    if (!self.timer) {
+        __weak typeof(self) weakSelf = self;
+        self.timer = [NSTimer scheduledTimerWithTimeInterval:kRTSPDecodeSchedulerInterval repeats:YES block:^(NSTimer *timer) {
+            [weakSelf update];
+        }];
+    }
+    [self setNeedsUpdate];
+}
+
+- (void)removeClient:(id<RTSPDecodeSchedulerClient>)client {
+    NSAssert([NSThread isMainThread], @"RTSPDecodeScheduler is main-thread only");
+    RTSPDecodeClientEntry *entry = [self entryForClient:client];
+    if (entry) {
+        [self.entries removeObject:entry];
+        [self setNeedsUpdate]; // Its budget goes to someone else
+    }
+}
+
+- (RTSPDecodeMode)modeForClient:(id<RTSPDecodeSchedulerClient>)client {
+    return [self entryForClient:client].mode;
+}
+
+- (void)setNeedsUpdate {
+    if (self.updatePending) {
+        return;
+    }
+    self.updatePending = YES;
+    dispatch_async(dispatch_get_main_queue(), ^{
+        [self update];
+    });
+}
+
+- (void)windowStateDidChange:(NSNotification *)notification {
+    if (self.entries.count > 0) {
+        [self setNeedsUpdate];
+    }
+}
+
+#pragma mark - Scheduling
+
+- (RTSPDecodeMode)preferredModeForEntry:(RTSPDecodeClientEntry *)entry {
+    id<RTSPDecodeSchedulerClient> client = entry.client;
+    if (![client decodeHasSubstream] || entry.focused) {
+        return RTSPDecodeModeMain;
+    }
+    CGFloat threshold = self.substreamMaxTileHeight;
+    if (entry.mode == RTSPDecodeModeSubstream) {
+        threshold *= kRTSPDecodeSubstreamHysteresis;
+    }
+    return entry.visibleSize.height <= threshold ? RTSPDecodeModeSubstream : RTSPDecodeModeMain;
+}
+
+- (void)update {
+    self.updatePending = NO;
+    [self.entries filterUsingPredicate:[NSPredicate predicateWithBlock:^BOOL(RTSPDecodeClientEntry *entry, NSDictionary *bindings) {
+        return entry.client != nil;
+    }]];
+    if (self.entries.count == 0) {
+        [self.timer invalidate];
+        self.timer = nil;
+    }
+    _passes++;
+    uint64_t changesBefore = _modeChanges;
+
+    NSMutableArray<RTSPDecodeClientEntry *> *visible = [NSMutableArray array];
+    for (RTSPDecodeClientEntry *entry in self.entries) {
+        entry.visibleSize = [entry.client decodeVisiblePixelSize];
+        entry.focused = [entry.client decodeHasFocus];
+        if (entry.visibleSize.width >= 1.0 && entry.visibleSize.height >= 1.0) {
+            [visible addObject:entry];
+        }
+    }
+
+    // Focused tile first, then the tiles that show the most pixels
+    [visible sortUsingComparator:^NSComparisonResult(RTSPDecodeClientEntry *a, RTSPDecodeClientEntry *b) {
+        if (a.focused != b.focused) {
+            return a.focused ? NSOrderedAscending : NSOrderedDescending;
+        }
+        CGFloat areaA = a.visibleSize.width * a.visibleSize.height;
+        CGFloat areaB = b.visibleSize.width * b.visibleSize.height;
+        if (areaA != areaB) {
+            return areaA > areaB ? NSOrderedAscending : NSOrderedDescending;
+        }
+        return a.order < b.order ? NSOrderedAscending : NSOrderedDescending;
+    }];
+
+    NSMapTable<RTSPDecodeClientEntry *, NSNumber *> *assigned = [NSMapTable strongToStrongObjectsMapTable];
+    NSUInteger active = 0, main = 0, substream = 0, downgraded = 0, denied = 0;
+    double pixels = 0;
+    for (RTSPDecodeClientEntry *entry in visible) {
+        RTSPDecodeMode preferred = [self preferredModeForEntry:entry];
+        RTSPDecodeMode chosen = RTSPDecodeModePaused;
+        double rate = 0;
+
+        if (active < self.maxActiveDecoders) {
+            NSMutableArray<NSNumber *> *options = [NSMutableArray arrayWithObject:@(preferred)];
+            if (preferred == RTSPDecodeModeMain && [entry.client decodeHasSubstream]) {
+                [options addObject:@(RTSPDecodeModeSubstream)];
+            }
+            for (NSNumber *option in options) {
+                double optionRate = [entry.client decodePixelRateForMode:option.integerValue];
+                // The first tile always gets a decoder, even one bigger than the whole budget
+                if (active == 0 || pixels + optionRate <= self.maxPixelsPerSecond) {
+                    chosen = option.integerValue;
+                    rate = optionRate;
+                    break;
+                }
+            }
+        }
+
+        if (chosen == RTSPDecodeModePaused) {
+            denied++;
+            continue;
+        }
+        if (chosen != preferred) {
+            downgraded++;
+        }
+        active++;
+        pixels += rate;
+        if (chosen == RTSPDecodeModeMain) {
+            main++;
+        } else {
+            substream++;
+        }
+        [assigned setObject:@(chosen) forKey:entry];
+    }
+
+    // Stop decoders before starting others, so the budget is never exceeded in between
+    NSMutableArray<RTSPDecodeClientEntry *> *starting = [NSMutableArray array];
+    for (RTSPDecodeClientEntry *entry in self.entries) {
+        RTSPDecodeMode mode = [assigned objectForKey:entry] ? [[assigned objectForKey:entry] integerValue] : RTSPDecodeModePaused;
+        if (mode == entry.mode) {
+            continue;
+        }
+        _modeChanges++;
+        if (mode == RTSPDecodeModePaused || entry.mode != RTSPDecodeModePaused) {
+            entry.mode = mode;
+            [entry.client applyDecodeMode:mode];
+        } else {
+            entry.mode = mode;
+            [starting addObject:entry];
+        }
+    }
+    for (RTSPDecodeClientEntry *entry in starting) {
+        [entry.client applyDecodeMode:entry.mode];
+    }
+
+    self.lastPass = @{
+        @"clients": @(self.entries.count),
+        @"activeDecoders": @(active),
+        @"mainDecoders": @(main),
+        @"substreamDecoders": @(substream),
+        @"pausedDecoders": @(self.entries.count - active),
+        @"pixelsPerSecond": @(pixels),
+        @"downgradedToSubstream": @(downgraded),
+        @"deniedByBudget": @(denied),
+        @"passes": @(_passes),
+        @"modeChanges": @(_modeChanges)
+    };
+    if (_modeChanges != changesBefore) {
+        if (downgraded > 0 || denied > 0) {
+            NSLog(@"[DecodeScheduler] %lu active (%lu main, %lu substream), %.0f Mpx/s; %lu downgraded, %lu paused for budget",
+                  (unsigned long)active, (unsigned long)main, (unsigned long)substream, pixels / 1e6,
+                  (unsigned long)downgraded, (unsigned long)denied);
+        }
+        [[NSNotificationCenter defaultCenter] postNotificationName:RTSPDecodeSchedulerDidUpdateNotification object:self];
+    }
+}
+
+- (NSDictionary<NSString *, NSNumber *> *)statistics {
+    NSMutableDictionary *stats = [self.lastPass mutableCopy];
+    stats[@"maxActiveDecoders"] = @(self.maxActiveDecoders);
+    stats[@"maxPixelsPerSecond"] = @(self.maxPixelsPerSecond);
+    stats[@"substreamMaxTileHeight"] = @(self.substreamMaxTileHeight);
+    return stats;
+}
+
+@end
@@ -0,0 +1,639 @@
+//
+//  RTSPDetectionDecoder.c
+//  RTSP Rotator
+//
+//  Channels-first tensors are read one class row at a time over a block of
+//  anchors, keeping a running best score and class per anchor, so every
+//  load is contiguous and the block's state stays in L1. Ties keep the
+//  lower class in every backend, so all backends pick the same boxes.
+//
+
+#include "RTSPDetectionDecoder.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+#define RTSP_DETECTION_X86 1
+#include <emmintrin.h>
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#define RTSP_DETECTION_NEON 1
+#include <arm_neon.h>
+#endif
+
+#define RTSP_DETECTION_BLOCK 1024           // Anchors per pass over the class rows
+
+/// best[i] = max(best[i], row[i]), remembering `classID` where row wins
+typedef void (*RTSPDetectionMaxFunction)(const float *row, float *best, uint32_t *bestClass, uint32_t count,
+                                         uint32_t classID);
+
+/// Whether a box overlaps any kept box of the same class (any class when
+/// `classAgnostic`) by more than `threshold` IoU
+typedef bool (*RTSPDetectionOverlapFunction)(const float *kept, uint32_t stride, uint32_t count, const float box[5],
+                                             float classID, bool classAgnostic, float threshold);
+
+/// Kept boxes during NMS, one array each: x1, y1, x2, y2, area, class
+enum { RTSPKeptX1, RTSPKeptY1, RTSPKeptX2, RTSPKeptY2, RTSPKeptArea, RTSPKeptClass, RTSPKeptArrays };
+
+struct RTSPDetectionDecoder {
+    RTSPDetectionDecoderConfig config;
+    RTSPDetectionBackend backend;
+    RTSPDetectionMaxFunction maxFunction;
+    RTSPDetectionOverlapFunction overlapFunction;
+    uint32_t *classes;              // Enabled classes, ascending
+    uint32_t enabledCount;
+    bool *enabled;                  // By class
+};
+
+struct RTSPDetectionScratch {
+    uint32_t capacity;              // Anchors
+    float best[RTSP_DETECTION_BLOCK];
+    uint32_t bestClass[RTSP_DETECTION_BLOCK];
+    uint32_t *candidates;           // Anchor per candidate
+    float *candidateScores;
+    uint32_t *candidateClasses;
+    uint64_t *order;                // Sort keys: score descending, then candidate
+    uint32_t keptCapacity;
+    float *kept;                    // RTSPKeptArrays arrays of keptCapacity floats
+};
+
+#pragma mark - Scalar
+
+static void RTSPDetectionMaxScalar(const float *row, float *best, uint32_t *bestClass, uint32_t count, uint32_t classID) {
+    for (uint32_t i = 0; i < count; i++) {
+        if (row[i] > best[i]) {
+            best[i] = row[i];
+            bestClass[i] = classID;
+        }
+    }
+}
+
+static inline float RTSPDetectionIntersection(const float *kept, uint32_t stride, uint32_t k, const float box[5]) {
+    float x1 = fmaxf(box[0], kept[RTSPKeptX1 * stride + k]);
+    float y1 = fmaxf(box[1], kept[RTSPKeptY1 * stride + k]);
+    float x2 = fminf(box[2], kept[RTSPKeptX2 * stride + k]);
+    float y2 = fminf(box[3], kept[RTSPKeptY2 * stride + k]);
+    return fmaxf(x2 - x1, 0.0f) * fmaxf(y2 - y1, 0.0f);
+}
+
+static bool RTSPDetectionOverlapScalar(const float *kept, uint32_t stride, uint32_t count, const float box[5],
+                                       float classID, bool classAgnostic, float threshold) {
+    for (uint32_t k = 0; k < count; k++) {
+        if (!classAgnostic && kept[RTSPKeptClass * stride + k] != classID) {
+            continue;
+        }
+        float intersection = RTSPDetectionIntersection(kept, stride, k, box);
+        // IoU > t without the division: inter > t * (a + b - inter)
+        if (intersection > threshold * (box[4] + kept[RTSPKeptArea * stride + k] - intersection)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+#pragma mark - SSE2 / AVX2
+
+#ifdef RTSP_DETECTION_X86
+
+static void RTSPDetectionMaxSSE2(const float *row, float *best, uint32_t *bestClass, uint32_t count, uint32_t classID) {
+    __m128i cls = _mm_set1_epi32((int)classID);
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 r = _mm_loadu_ps(row + i);
+        __m128 b = _mm_loadu_ps(best + i);
+        __m128 wins = _mm_cmpgt_ps(r, b);
+        __m128i mask = _mm_castps_si128(wins);
+        __m128i c = _mm_loadu_si128((const __m128i *)(bestClass + i));
+        _mm_storeu_ps(best + i, _mm_or_ps(_mm_and_ps(wins, r), _mm_andnot_ps(wins, b)));
+        _mm_storeu_si128((__m128i *)(bestClass + i), _mm_or_si128(_mm_and_si128(mask, cls), _mm_andnot_si128(mask, c)));
+    }
+    RTSPDetectionMaxScalar(row + i, best + i, bestClass + i, count - i, classID);
+}
+
+static bool RTSPDetectionOverlapSSE2(const float *kept, uint32_t stride, uint32_t count, const float box[5],
+                                     float classID, bool classAgnostic, float threshold) {
+    __m128 bx1 = _mm_set1_ps(box[0]), by1 = _mm_set1_ps(box[1]);
+    __m128 bx2 = _mm_set1_ps(box[2]), by2 = _mm_set1_ps(box[3]);
+    __m128 barea = _mm_set1_ps(box[4]), t = _mm_set1_ps(threshold), zero = _mm_setzero_ps();
+    __m128 cls = _mm_set1_ps(classID);
+    __m128 any = _mm_castsi128_ps(_mm_set1_epi32(classAgnostic ? -1 : 0));
+    uint32_t k = 0;
+    for (; k + 4 <= count; k += 4) {
+        __m128 w = _mm_max_ps(_mm_sub_ps(_mm_min_ps(bx2, _mm_loadu_ps(kept + RTSPKeptX2 * stride + k)),
+                                         _mm_max_ps(bx1, _mm_loadu_ps(kept + RTSPKeptX1 * stride + k))), zero);
+        __m128 h = _mm_max_ps(_mm_sub_ps(_mm_min_ps(by2, _mm_loadu_ps(kept + RTSPKeptY2 * stride + k)),
+                                         _mm_max_ps(by1, _mm_loadu_ps(kept + RTSPKeptY1 * stride + k))), zero);
+        __m128 intersection = _mm_mul_ps(w, h);
+        __m128 unionArea = _mm_sub_ps(_mm_add_ps(barea, _mm_loadu_ps(kept + RTSPKeptArea * stride + k)), intersection);
+        __m128 overlaps = _mm_cmpgt_ps(intersection, _mm_mul_ps(t, unionArea));
+        __m128 sameClass = _mm_or_ps(any, _mm_cmpeq_ps(cls, _mm_loadu_ps(kept + RTSPKeptClass * stride + k)));
+        if (_mm_movemask_ps(_mm_and_ps(overlaps, sameClass))) {
+            return true;
+        }
+    }
+    return RTSPDetectionOverlapScalar(kept + k, stride, count - k, box, classID, classAgnostic, threshold);
+}
+
+__attribute__((target("avx2")))
+static void RTSPDetectionMaxAVX2(const float *row, float *best, uint32_t *bestClass, uint32_t count, uint32_t classID) {
+    __m256 cls = _mm256_castsi256_ps(_mm256_set1_epi32((int)classID));
+    uint32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 r = _mm256_loadu_ps(row + i);
+        __m256 b = _mm256_loadu_ps(best + i);
+        __m256 wins = _mm256_cmp_ps(r, b, _CMP_GT_OQ);
+        __m256 c = _mm256_loadu_ps((const float *)(bestClass + i));
+        _mm256_storeu_ps(best + i, _mm256_blendv_ps(b, r, wins));
+        _mm256_storeu_ps((float *)(bestClass + i), _mm256_blendv_ps(c, cls, wins));
+    }
+    RTSPDetectionMaxSSE2(row + i, best + i, bestClass + i, count - i, classID);
+}
+
+__attribute__((target("avx2")))
+static bool RTSPDetectionOverlapAVX2(const float *kept, uint32_t stride, uint32_t count, const float box[5],
+                                     float classID, bool classAgnostic, float threshold) {
+    __m256 bx1 = _mm256_set1_ps(box[0]), by1 = _mm256_set1_ps(box[1]);
+    __m256 bx2 = _mm256_set1_ps(box[2]), by2 = _mm256_set1_ps(box[3]);
+    __m256 barea = _mm256_set1_ps(box[4]), t = _mm256_set1_ps(threshold), zero = _mm256_setzero_ps();
+    __m256 cls = _mm256_set1_ps(classID);
+    __m256 any = _mm256_castsi256_ps(_mm256_set1_epi32(classAgnostic ? -1 : 0));
+    uint32_t k = 0;
+    for (; k + 8 <= count; k += 8) {
+        __m256 w = _mm256_max_ps(_mm256_sub_ps(_mm256_min_ps(bx2, _mm256_loadu_ps(kept + RTSPKeptX2 * stride + k)),
+                                               _mm256_max_ps(bx1, _mm256_loadu_ps(kept + RTSPKeptX1 * stride + k))), zero);
+        __m256 h = _mm256_max_ps(_mm256_sub_ps(_mm256_min_ps(by2, _mm256_loadu_ps(kept + RTSPKeptY2 * stride + k)),
+                                               _mm256_max_ps(by1, _mm256_loadu_ps(kept + RTSPKeptY1 * stride + k))), zero);
+        __m256 intersection = _mm256_mul_ps(w, h);
+        __m256 unionArea = _mm256_sub_ps(_mm256_add_ps(barea, _mm256_loadu_ps(kept + RTSPKeptArea * stride + k)),
+                                         intersection);
+        __m256 overlaps = _mm256_cmp_ps(intersection, _mm256_mul_ps(t, unionArea), _CMP_GT_OQ);
+        __m256 sameClass = _mm256_or_ps(any, _mm256_cmp_ps(cls, _mm256_loadu_ps(kept + RTSPKeptClass * stride + k),
+                                                           _CMP_EQ_OQ));
+        if (_mm256_movemask_ps(_mm256_and_ps(overlaps, sameClass))) {
+            return true;
+        }
+    }
+    return RTSPDetectionOverlapSSE2(kept + k, stride, count - k, box, classID, classAgnostic, threshold);
+}
+
+static bool RTSPDetectionCPUHasAVX2(void) {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+#endif
+
+#pragma mark - NEON
+
+#ifdef RTSP_DETECTION_NEON
+
+static void RTSPDetectionMaxNEON(const float *row, float *best, uint32_t *bestClass, uint32_t count, uint32_t classID) {
+    uint32x4_t cls = vdupq_n_u32(classID);
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t r = vld1q_f32(row + i);
+        float32x4_t b = vld1q_f32(best + i);
+        uint32x4_t wins = vcgtq_f32(r, b);
+        vst1q_f32(best + i, vbslq_f32(wins, r, b));
+        vst1q_u32(bestClass + i, vbslq_u32(wins, cls, vld1q_u32(bestClass + i)));
+    }
+    RTSPDetectionMaxScalar(row + i, best + i, bestClass + i, count - i, classID);
+}
+
+static bool RTSPDetectionOverlapNEON(const float *kept, uint32_t stride, uint32_t count, const float box[5],
+                                     float classID, bool classAgnostic, float threshold) {
+    float32x4_t bx1 = vdupq_n_f32(box[0]), by1 = vdupq_n_f32(box[1]);
+    float32x4_t bx2 = vdupq_n_f32(box[2]), by2 = vdupq_n_f32(box[3]);
+    float32x4_t barea = vdupq_n_f32(box[4]), t = vdupq_n_f32(threshold), zero = vdupq_n_f32(0.0f);
+    float32x4_t cls = vdupq_n_f32(classID);
+    uint32x4_t any = vdupq_n_u32(classAgnostic ? UINT32_MAX : 0);
+    uint32_t k = 0;
+    for (; k + 4 <= count; k += 4) {
+        float32x4_t w = vmaxq_f32(vsubq_f32(vminq_f32(bx2, vld1q_f32(kept + RTSPKeptX2 * stride + k)),
+                                           vmaxq_f32(bx1, vld1q_f32(kept + RTSPKeptX1 * stride + k))), zero);
+        float32x4_t h = vmaxq_f32(vsubq_f32(vminq_f32(by2, vld1q_f32(kept + RTSPKeptY2 * stride + k)),
+                                           vmaxq_f32(by1, vld1q_f32(kept + RTSPKeptY1 * stride + k))), zero);
+        float32x4_t intersection = vmulq_f32(w, h);
+        float32x4_t unionArea = vsubq_f32(vaddq_f32(barea, vld1q_f32(kept + RTSPKeptArea * stride + k)), intersection);
+        uint32x4_t overlaps = vcgtq_f32(intersection, vmulq_f32(t, unionArea));
+        uint32x4_t sameClass = vorrq_u32(any, vceqq_f32(cls, vld1q_f32(kept + RTSPKeptClass * stride + k)));
+        if (vmaxvq_u32(vandq_u32(overlaps, sameClass))) {
+            return true;
+        }
+    }
+    return RTSPDetectionOverlapScalar(kept + k, stride, count - k, box, classID, classAgnostic, threshold);
+}
+
+#endif
+
+#pragma mark - Backend selection
+
+bool RTSPDetectionBackendAvailable(RTSPDetectionBackend backend) {
+    switch (backend) {
+        case RTSPDetectionBackendAuto:
+        case RTSPDetectionBackendScalar:
+            return true;
+#ifdef RTSP_DETECTION_X86
+        case RTSPDetectionBackendSSE2:
+            return true;
+        case RTSPDetectionBackendAVX2:
+            return RTSPDetectionCPUHasAVX2();
+#endif
+#ifdef RTSP_DETECTION_NEON
+        case RTSPDetectionBackendNEON:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+const char *RTSPDetectionBackendName(RTSPDetectionBackend backend) {
+    switch (backend) {
+        case RTSPDetectionBackendAuto:   return "auto";
+        case RTSPDetectionBackendScalar: return "scalar";
+        case RTSPDetectionBackendSSE2:   return "sse2";
+        case RTSPDetectionBackendAVX2:   return "avx2";
+        case RTSPDetectionBackendNEON:   return "neon";
+    }
+    return "unknown";
+}
+
+static RTSPDetectionBackend RTSPDetectionResolveBackend(RTSPDetectionBackend requested) {
+    if (requested != RTSPDetectionBackendAuto) {
+        return RTSPDetectionBackendAvailable(requested) ? requested : RTSPDetectionBackendScalar;
+    }
+#ifdef RTSP_DETECTION_NEON
+    return RTSPDetectionBackendNEON;
+#elif defined(RTSP_DETECTION_X86)
+    return RTSPDetectionCPUHasAVX2() ? RTSPDetectionBackendAVX2 : RTSPDetectionBackendSSE2;
+#else
+    return RTSPDetectionBackendScalar;
+#endif
+}
+
+#pragma mark - Letterbox
+
+RTSPLetterbox RTSPLetterboxMake(uint32_t sourceWidth, uint32_t sourceHeight, uint32_t inputWidth, uint32_t inputHeight) {
+    RTSPLetterbox letterbox = {
+        .sourceWidth = sourceWidth,
+        .sourceHeight = sourceHeight,
+        .inputWidth = inputWidth,
+        .inputHeight = inputHeight,
+    };
+    if (sourceWidth == 0 || sourceHeight == 0) {
+        letterbox.scale = 1.0f;
+        return letterbox;
+    }
+    float scaleX = (float)inputWidth / (float)sourceWidth;
+    float scaleY = (float)inputHeight / (float)sourceHeight;
+    letterbox.scale = scaleX < scaleY ? scaleX : scaleY;
+    letterbox.padX = ((float)inputWidth - (float)sourceWidth * letterbox.scale) * 0.5f;
+    letterbox.padY = ((float)inputHeight - (float)sourceHeight * letterbox.scale) * 0.5f;
+    return letterbox;
+}
+
+#pragma mark - Decoder
+
+void RTSPDetectionDecoderConfigInit(RTSPDetectionDecoderConfig *config, uint32_t anchorCount, uint32_t classCount) {
+    memset(config, 0, sizeof(*config));
+    config->layout = RTSPDetectionLayoutChannelsFirst;
+    config->anchorCount = anchorCount;
+    config->classCount = classCount;
+    config->confidenceThreshold = 0.25f;
+    config->iouThreshold = 0.45f;
+    config->maxDetections = 300;
+    config->classAgnostic = false;
+    config->backend = RTSPDetectionBackendAuto;
+}
+
+RTSPDetectionDecoderRef RTSPDetectionDecoderCreate(const RTSPDetectionDecoderConfig *config) {
+    if (!config || config->anchorCount == 0 || config->classCount == 0 || config->maxDetections == 0) {
+        return NULL;
+    }
+    RTSPDetectionDecoderRef decoder = calloc(1, sizeof(*decoder));
+    if (!decoder) {
+        return NULL;
+    }
+    decoder->config = *config;
+    decoder->classes = calloc(config->classCount, sizeof(*decoder->classes));
+    decoder->enabled = calloc(config->classCount, sizeof(*decoder->enabled));
+    if (!decoder->classes || !decoder->enabled) {
+        RTSPDetectionDecoderRelease(decoder);
+        return NULL;
+    }
+    RTSPDetectionDecoderSetEnabledClasses(decoder, NULL, 0);
+
+    decoder->backend = RTSPDetectionResolveBackend(config->backend);
+    decoder->maxFunction = RTSPDetectionMaxScalar;
+    decoder->overlapFunction = RTSPDetectionOverlapScalar;
+    switch (decoder->backend) {
+#ifdef RTSP_DETECTION_X86
+        case RTSPDetectionBackendSSE2:
+            decoder->maxFunction = RTSPDetectionMaxSSE2;
+            decoder->overlapFunction = RTSPDetectionOverlapSSE2;
+            break;
+        case RTSPDetectionBackendAVX2:
+            decoder->maxFunction = RTSPDetectionMaxAVX2;
+            decoder->overlapFunction = RTSPDetectionOverlapAVX2;
+            break;
+#endif
+#ifdef RTSP_DETECTION_NEON
+        case RTSPDetectionBackendNEON:
+            decoder->maxFunction = RTSPDetectionMaxNEON;
+            decoder->overlapFunction = RTSPDetectionOverlapNEON;
+            break;
+#endif
+        default:
+            break;
+    }
+    return decoder;
+}
+
+void RTSPDetectionDecoderRelease(RTSPDetectionDecoderRef decoder) {
+    if (!decoder) {
+        return;
+    }
+    free(decoder->classes);
+    free(decoder->enabled);
+    free(decoder);
+}
+
+void RTSPDetectionDecoderSetEnabledClasses(RTSPDetectionDecoderRef decoder, const uint32_t *classes, uint32_t count) {
+    uint32_t classCount = decoder->config.classCount;
+    bool all = !classes || count == 0;
+    for (uint32_t c = 0; c < classCount; c++) {
+        decoder->enabled[c] = all;
+    }
+    for (uint32_t i = 0; !all && i < count; i++) {
+        if (classes[i] < classCount) {
+            decoder->enabled[classes[i]] = true;
+        }
+    }
+    decoder->enabledCount = 0;
+    for (uint32_t c = 0; c < classCount; c++) {
+        if (decoder->enabled[c]) {
+            decoder->classes[decoder->enabledCount++] = c;
+        }
+    }
+}
+
+size_t RTSPDetectionDecoderOutputLength(RTSPDetectionDecoderRef decoder) {
+    const RTSPDetectionDecoderConfig *config = &decoder->config;
+    size_t channels = config->layout == RTSPDetectionLayoutChannelsFirst ? 4 + config->classCount : 5 + config->classCount;
+    return channels * config->anchorCount;
+}
+
+RTSPDetectionBackend RTSPDetectionDecoderGetBackend(RTSPDetectionDecoderRef decoder) {
+    return decoder ? decoder->backend : RTSPDetectionBackendScalar;
+}
+
+#pragma mark - Buffers
+
+static void RTSPDetectionScratchFree(struct RTSPDetectionScratch *scratch) {
+    if (!scratch) {
+        return;
+    }
+    free(scratch->candidates);
+    free(scratch->candidateScores);
+    free(scratch->candidateClasses);
+    free(scratch->order);
+    free(scratch->kept);
+    free(scratch);
+}
+
+/// Scratch sized for `anchors` candidates and `kept` kept boxes
+static struct RTSPDetectionScratch *RTSPDetectionScratchReserve(RTSPDetectionBuffer *detections, uint32_t anchors,
+                                                               uint32_t kept) {
+    struct RTSPDetectionScratch *scratch = detections->scratch;
+    if (scratch && scratch->capacity >= anchors && scratch->keptCapacity >= kept) {
+        return scratch;
+    }
+    RTSPDetectionScratchFree(scratch);
+    detections->scratch = scratch = calloc(1, sizeof(*scratch));
+    if (!scratch) {
+        return NULL;
+    }
+    scratch->capacity = anchors;
+    scratch->keptCapacity = kept;
+    scratch->candidates = malloc(anchors * sizeof(*scratch->candidates));
+    scratch->candidateScores = malloc(anchors * sizeof(*scratch->candidateScores));
+    scratch->candidateClasses = malloc(anchors * sizeof(*scratch->candidateClasses));
+    scratch->order = malloc(anchors * sizeof(*scratch->order));
+    scratch->kept = malloc((size_t)kept * RTSPKeptArrays * sizeof(*scratch->kept));
+    if (!scratch->candidates || !scratch->candidateScores || !scratch->candidateClasses || !scratch->order ||
+        !scratch->kept) {
+        RTSPDetectionScratchFree(scratch);
+        detections->scratch = NULL;
+        return NULL;
+    }
+    return scratch;
+}
+
+bool RTSPDetectionBufferInit(RTSPDetectionBuffer *detections, uint32_t capacity) {
+    memset(detections, 0, sizeof(*detections));
+    detections->capacity = capacity;
+    detections->x = malloc(capacity * sizeof(float));
+    detections->y = malloc(capacity * sizeof(float));
+    detections->width = malloc(capacity * sizeof(float));
+    detections->height = malloc(capacity * sizeof(float));
+    detections->score = malloc(capacity * sizeof(float));
+    detections->classID = malloc(capacity * sizeof(uint32_t));
+    if (!detections->x || !detections->y || !detections->width || !detections->height || !detections->score ||
+        !detections->classID) {
+        RTSPDetectionBufferFree(detections);
+        return false;
+    }
+    return true;
+}
+
+void RTSPDetectionBufferFree(RTSPDetectionBuffer *detections) {
+    if (!detections) {
+        return;
+    }
+    free(detections->x);
+    free(detections->y);
+    free(detections->width);
+    free(detections->height);
+    free(detections->score);
+    free(detections->classID);
+    RTSPDetectionScratchFree(detections->scratch);
+    memset(detections, 0, sizeof(*detections));
+}
+
+#pragma mark - Decoding
+
+/// Candidates of a [4 + classes][anchors] tensor
+static uint32_t RTSPDetectionCandidatesChannelsFirst(RTSPDetectionDecoderRef decoder, const float *output,
+                                                     struct RTSPDetectionScratch *scratch) {
+    const RTSPDetectionDecoderConfig *config = &decoder->config;
+    uint32_t anchors = config->anchorCount;
+    const float *scores = output + 4 * (size_t)anchors;
+    float threshold = config->confidenceThreshold;
+    uint32_t found = 0;
+
+    for (uint32_t start = 0; start < anchors; start += RTSP_DETECTION_BLOCK) {
+        uint32_t count = anchors - start < RTSP_DETECTION_BLOCK ? anchors - start : RTSP_DETECTION_BLOCK;
+        uint32_t first = decoder->classes[0];
+        memcpy(scratch->best, scores + (size_t)first * anchors + start, count * sizeof(float));
+        for (uint32_t i = 0; i < count; i++) {
+            scratch->bestClass[i] = first;
+        }
+        for (uint32_t n = 1; n < decoder->enabledCount; n++) {
+            uint32_t c = decoder->classes[n];
+            decoder->maxFunction(scores + (size_t)c * anchors + start, scratch->best, scratch->bestClass, count, c);
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            if (scratch->best[i] >= threshold) {
+                scratch->candidates[found] = start + i;
+                scratch->candidateScores[found] = scratch->best[i];
+                scratch->candidateClasses[found] = scratch->bestClass[i];
+                found++;
+            }
+        }
+    }
+    return found;
+}
+
+/// Candidates of an [anchors][5 + classes] tensor
+static uint32_t RTSPDetectionCandidatesAnchorsFirst(RTSPDetectionDecoderRef decoder, const float *output,
+                                                    struct RTSPDetectionScratch *scratch) {
+    const RTSPDetectionDecoderConfig *config = &decoder->config;
+    size_t stride = 5 + (size_t)config->classCount;
+    float threshold = config->confidenceThreshold;
+    uint32_t found = 0;
+
+    for (uint32_t a = 0; a < config->anchorCount; a++) {
+        const float *anchor = output + a * stride;
+        float objectness = anchor[4];
+        if (objectness < threshold) {
+            continue;   // Class scores are at most 1: nothing here can pass
+        }
+        const float *classScores = anchor + 5;
+        uint32_t bestClass = decoder->classes[0];
+        float best = classScores[bestClass];
+        for (uint32_t n = 1; n < decoder->enabledCount; n++) {
+            uint32_t c = decoder->classes[n];
+            if (classScores[c] > best) {
+                best = classScores[c];
+                bestClass = c;
+            }
+        }
+        float score = best * objectness;
+        if (score >= threshold) {
+            scratch->candidates[found] = a;
+            scratch->candidateScores[found] = score;
+            scratch->candidateClasses[found] = bestClass;
+            found++;
+        }
+    }
+    return found;
+}
+
+/// Float bits as an unsigned key that sorts like the float
+static inline uint32_t RTSPDetectionSortableBits(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits & 0x80000000u ? ~bits : bits | 0x80000000u;
+}
+
+static int RTSPDetectionCompareKeys(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/// Order candidates best first; equal scores keep anchor order, so every
+/// backend and every run keeps the same boxes
+static void RTSPDetectionSortCandidates(struct RTSPDetectionScratch *scratch, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t descending = ~RTSPDetectionSortableBits(scratch->candidateScores[i]);
+        scratch->order[i] = (uint64_t)descending << 32 | i;
+    }
+    qsort(scratch->order, count, sizeof(*scratch->order), RTSPDetectionCompareKeys);
+}
+
+bool RTSPDetectionDecoderDecode(RTSPDetectionDecoderRef decoder, const float *output, const RTSPLetterbox *letterbox,
+                                RTSPDetectionBuffer *detections) {
+    if (!decoder || !output || !letterbox || !detections || detections->capacity == 0) {
+        return false;
+    }
+    const RTSPDetectionDecoderConfig *config = &decoder->config;
+    detections->count = 0;
+    if (decoder->enabledCount == 0) {
+        return true;
+    }
+    uint32_t limit = config->maxDetections < detections->capacity ? config->maxDetections : detections->capacity;
+    struct RTSPDetectionScratch *scratch = RTSPDetectionScratchReserve(detections, config->anchorCount, limit);
+    if (!scratch) {
+        return false;
+    }
+
+    uint32_t found = config->layout == RTSPDetectionLayoutChannelsFirst
+        ? RTSPDetectionCandidatesChannelsFirst(decoder, output, scratch)
+        : RTSPDetectionCandidatesAnchorsFirst(decoder, output, scratch);
+    RTSPDetectionSortCandidates(scratch, found);
+
+    size_t anchorStride = config->layout == RTSPDetectionLayoutChannelsFirst ? 1 : 5 + (size_t)config->classCount;
+    size_t fieldStride = config->layout == RTSPDetectionLayoutChannelsFirst ? config->anchorCount : 1;
+    float *kept = scratch->kept;
+    uint32_t keptStride = scratch->keptCapacity;
+    float scaleX = letterbox->scale * (float)letterbox->sourceWidth;
+    float scaleY = letterbox->scale * (float)letterbox->sourceHeight;
+    uint32_t count = 0;
+
+    for (uint32_t n = 0; n < found && count < limit; n++) {
+        uint32_t candidate = (uint32_t)(scratch->order[n] & 0xFFFFFFFFu);
+        const float *anchor = output + scratch->candidates[candidate] * anchorStride;
+        float cx = anchor[0], cy = anchor[fieldStride], w = anchor[2 * fieldStride], h = anchor[3 * fieldStride];
+        if (!(w > 0.0f) || !(h > 0.0f)) {
+            continue;
+        }
+        float box[5] = {cx - w * 0.5f, cy - h * 0.5f, cx + w * 0.5f, cy + h * 0.5f, w * h};
+        float classID = (float)scratch->candidateClasses[candidate];
+        if (decoder->overlapFunction(kept, keptStride, count, box, classID, config->classAgnostic, config->iouThreshold)) {
+            continue;
+        }
+        kept[RTSPKeptX1 * keptStride + count] = box[0];
+        kept[RTSPKeptY1 * keptStride + count] = box[1];
+        kept[RTSPKeptX2 * keptStride + count] = box[2];
+        kept[RTSPKeptY2 * keptStride + count] = box[3];
+        kept[RTSPKeptArea * keptStride + count] = box[4];
+        kept[RTSPKeptClass * keptStride + count] = classID;
+
+        // Model input pixels -> normalized source image, clipped
+        float x1 = fminf(fmaxf((box[0] - letterbox->padX) / scaleX, 0.0f), 1.0f);
+        float y1 = fminf(fmaxf((box[1] - letterbox->padY) / scaleY, 0.0f), 1.0f);
+        float x2 = fminf(fmaxf((box[2] - letterbox->padX) / scaleX, 0.0f), 1.0f);
+        float y2 = fminf(fmaxf((box[3] - letterbox->padY) / scaleY, 0.0f), 1.0f);
+        detections->x[count] = x1;
+        detections->y[count] = y1;
+        detections->width[count] = x2 - x1;
+        detections->height[count] = y2 - y1;
+        detections->score[count] = scratch->candidateScores[candidate];
+        detections->classID[count] = scratch->candidateClasses[candidate];
+        count++;
+    }
+    detections->count = count;
+    return true;
+}
+
+bool RTSPDetectionDecoderDecodeBatch(RTSPDetectionDecoderRef decoder, const float *outputs, size_t count,
+                                     const RTSPLetterbox *letterboxes, RTSPDetectionBuffer *detections) {
+    if (!decoder) {
+        return false;
+    }
+    size_t length = RTSPDetectionDecoderOutputLength(decoder);
+    bool ok = true;
+    for (size_t i = 0; i < count; i++) {
+        ok = RTSPDetectionDecoderDecode(decoder, outputs + i * length, &letterboxes[i], &detections[i]) && ok;
+    }
+    return ok;
+}
@@ -0,0 +1,131 @@
+//
+//  RTSPDetectionDecoder.h
+//  RTSP Rotator
+//
+//  Post-processing for raw YOLO-style detection tensors: confidence and
+//  class filtering, class-aware NMS and letterbox un-mapping into a
+//  struct-of-arrays detection buffer.
+//
+//  Two output layouts are read: channels first ([4 + classes, anchors],
+//  YOLOv8 / v11, no objectness), where the best class of every anchor is
+//  found with a vectorised running max over contiguous class rows, and
+//  anchors first ([anchors, 5 + classes], YOLOv5 / v7), where objectness
+//  rejects most anchors before their classes are read. Boxes are centre
+//  x, y, width, height in model input pixels.
+//
+//  NMS runs once over all classes rather than once per class: each
+//  candidate, best first, is tested against the boxes kept so far, held as
+//  arrays with their classes so one vectorised pass checks overlap and
+//  class together.
+//
+//  Plain C with SSE2 / AVX2 / NEON paths and a scalar fallback (see
+//  Benchmarks/). A decoder is immutable once created and can be shared
+//  between threads; each thread decodes into its own buffer.
+//
+
+#ifndef RTSPDetectionDecoder_h
+#define RTSPDetectionDecoder_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// SIMD backend used for the per-anchor and per-pixel loops
+typedef enum {
+    RTSPDetectionBackendAuto = 0,      // Best backend supported by the running CPU
+    RTSPDetectionBackendScalar,
+    RTSPDetectionBackendSSE2,
+    RTSPDetectionBackendAVX2,
+    RTSPDetectionBackendNEON
+} RTSPDetectionBackend;
+
+typedef enum {
+    RTSPDetectionLayoutChannelsFirst = 0,  // [4 + classes][anchors]
+    RTSPDetectionLayoutAnchorsFirst        // [anchors][5 + classes], objectness at 4
+} RTSPDetectionLayout;
+
+/// Where a source image sits inside the model input: scaled by `scale`
+/// and centred with padX / padY pixels of padding
+typedef struct {
+    float scale;
+    float padX;
+    float padY;
+    uint32_t sourceWidth;
+    uint32_t sourceHeight;
+    uint32_t inputWidth;
+    uint32_t inputHeight;
+} RTSPLetterbox;
+
+/// Fit a source image into the model input, keeping its aspect ratio
+RTSPLetterbox RTSPLetterboxMake(uint32_t sourceWidth, uint32_t sourceHeight, uint32_t inputWidth, uint32_t inputHeight);
+
+typedef struct {
+    RTSPDetectionLayout layout;
+    uint32_t anchorCount;              // e.g. 8400 for a 640x640 YOLOv8 input
+    uint32_t classCount;               // e.g. 80 for COCO
+    float confidenceThreshold;         // Class score (times objectness) to keep a box (default 0.25)
+    float iouThreshold;                // Overlap that suppresses the weaker box (default 0.45)
+    uint32_t maxDetections;            // Kept after NMS (default 300)
+    bool classAgnostic;                // Suppress across classes too (default false)
+    RTSPDetectionBackend backend;      // Backend override, Auto by default
+} RTSPDetectionDecoderConfig;
+
+void RTSPDetectionDecoderConfigInit(RTSPDetectionDecoderConfig *config, uint32_t anchorCount, uint32_t classCount);
+
+/// Detections in struct-of-arrays form. Boxes are normalized to the source
+/// image (0.0 - 1.0, top-left origin) and clipped to it; sorted by score.
+typedef struct {
+    uint32_t count;
+    uint32_t capacity;
+    float *x;
+    float *y;
+    float *width;
+    float *height;
+    float *score;
+    uint32_t *classID;
+    struct RTSPDetectionScratch *scratch;  // Internal: candidates before NMS
+} RTSPDetectionBuffer;
+
+typedef struct RTSPDetectionDecoder *RTSPDetectionDecoderRef;
+
+/// Create a decoder; returns NULL on invalid configuration or allocation failure
+RTSPDetectionDecoderRef RTSPDetectionDecoderCreate(const RTSPDetectionDecoderConfig *config);
+void RTSPDetectionDecoderRelease(RTSPDetectionDecoderRef decoder);
+
+/// Restrict output to the given classes (NULL or count 0 = all). Not
+/// thread-safe: set before sharing the decoder.
+void RTSPDetectionDecoderSetEnabledClasses(RTSPDetectionDecoderRef decoder, const uint32_t *classes, uint32_t count);
+
+/// Decode one image's output tensor (float32, packed in the configured
+/// layout). Returns false on allocation failure or invalid arguments.
+bool RTSPDetectionDecoderDecode(RTSPDetectionDecoderRef decoder, const float *output, const RTSPLetterbox *letterbox,
+                                RTSPDetectionBuffer *detections);
+
+/// Decode a batch of outputs laid out back to back, one buffer per image
+bool RTSPDetectionDecoderDecodeBatch(RTSPDetectionDecoderRef decoder, const float *outputs, size_t count,
+                                     const RTSPLetterbox *letterboxes, RTSPDetectionBuffer *detections);
+
+/// Floats in one image's output tensor
+size_t RTSPDetectionDecoderOutputLength(RTSPDetectionDecoderRef decoder);
+
+RTSPDetectionBackend RTSPDetectionDecoderGetBackend(RTSPDetectionDecoderRef decoder);
+
+/// Allocate a buffer for up to `capacity` detections
+bool RTSPDetectionBufferInit(RTSPDetectionBuffer *detections, uint32_t capacity);
+void RTSPDetectionBufferFree(RTSPDetectionBuffer *detections);
+
+/// Whether a backend can run on this CPU
+bool RTSPDetectionBackendAvailable(RTSPDetectionBackend backend);
+
+/// Human readable backend name
+const char *RTSPDetectionBackendName(RTSPDetectionBackend backend);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RTSPDetectionDecoder_h */
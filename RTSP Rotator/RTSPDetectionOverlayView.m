@@ -108,7 +108,22 @@
         CGContextSetStrokeColorWithColor(context, [[NSColor cyanColor] colorWithAlphaComponent:0.5].CGColor);
         CGContextSetLineWidth(context, 1.0);
         CGContextSetLineDash(context, 0, (CGFloat[]){5.0, 3.0}, 2);
-        CGContextStrokeRect(context, pixelRect);
+        if (zone.points.count >= 3) {
+            CGContextBeginPath(context);
+            [zone.points enumerateObjectsUsingBlock:^(NSValue *value, NSUInteger index, BOOL *stop) {
+                CGFloat x = value.pointValue.x * bounds.size.width;
+                CGFloat y = value.pointValue.y * bounds.size.height;
+                if (index == 0) {
+                    CGContextMoveToPoint(context, x, y);
+                } else {
+                    CGContextAddLineToPoint(context, x, y);
+                }
+            }];
+            CGContextClosePath(context);
+            CGContextStrokePath(context);
+        } else {
+            CGContextStrokeRect(context, pixelRect);
+        }
 
         // Draw zone label
         NSDictionary *attributes = @{
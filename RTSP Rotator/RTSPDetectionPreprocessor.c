@@ -0,0 +1,493 @@
+//
+//  RTSPDetectionPreprocessor.c
+//  RTSP Rotator
+//
+//  Sampling positions come from the letterbox itself (output pixel centre
+//  mapped back through scale and padding), so the decoder's un-mapping is
+//  the exact inverse of what was drawn. Chroma is sampled bilinearly at
+//  its own half resolution.
+//
+
+#include "RTSPDetectionPreprocessor.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+#define RTSP_PREPROCESS_X86 1
+#include <emmintrin.h>
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#define RTSP_PREPROCESS_NEON 1
+#include <arm_neon.h>
+#endif
+
+// BT.709 full range, chroma centred on 0
+#define RTSP_PREPROCESS_RV 1.5748f
+#define RTSP_PREPROCESS_GU (-0.1873f)
+#define RTSP_PREPROCESS_GV (-0.4681f)
+#define RTSP_PREPROCESS_BU 1.8556f
+
+/// One output row's inputs: two horizontally resampled source rows of each
+/// plane and the vertical blend weights, plus per-channel scale and bias
+typedef struct {
+    const float *y0, *y1;
+    const float *u0, *u1;
+    const float *v0, *v1;
+    float fy;
+    float chromaFy;
+    float scale[3];
+    float bias[3];
+} RTSPPreprocessRowArgs;
+
+typedef void (*RTSPPreprocessRowFunction)(const RTSPPreprocessRowArgs *args, uint32_t count, float *r, float *g,
+                                          float *b);
+
+/// A horizontally resampled source row
+typedef struct {
+    int64_t row;                    // Source row, -1 when empty
+    float *data;                    // Luma, or U then V for chroma
+} RTSPPreprocessCachedRow;
+
+struct RTSPDetectionPreprocessor {
+    RTSPDetectionPreprocessorConfig config;
+    RTSPDetectionBackend backend;
+    RTSPPreprocessRowFunction rowFunction;
+
+    // Per frame size
+    uint32_t width;
+    uint32_t height;
+    RTSPLetterbox letterbox;
+    uint32_t left, top;             // First content pixel of the input
+    uint32_t contentWidth, contentHeight;
+    uint32_t *lumaX0, *lumaX1;      // Source columns per content column
+    float *lumaFx;
+    uint32_t *chromaX0, *chromaX1;
+    float *chromaFx;
+    RTSPPreprocessCachedRow luma[2];
+    RTSPPreprocessCachedRow chroma[2];
+    float *rows;                    // Three float rows for BGRA8 output
+    float padded[3];                // Normalized padding per channel
+};
+
+#pragma mark - Scalar
+
+static void RTSPPreprocessRowScalar(const RTSPPreprocessRowArgs *args, uint32_t count, float *r, float *g, float *b) {
+    for (uint32_t i = 0; i < count; i++) {
+        float y = args->y0[i] + args->fy * (args->y1[i] - args->y0[i]);
+        float u = args->u0[i] + args->chromaFy * (args->u1[i] - args->u0[i]);
+        float v = args->v0[i] + args->chromaFy * (args->v1[i] - args->v0[i]);
+        r[i] = (y + RTSP_PREPROCESS_RV * v) * args->scale[0] + args->bias[0];
+        g[i] = (y + RTSP_PREPROCESS_GU * u + RTSP_PREPROCESS_GV * v) * args->scale[1] + args->bias[1];
+        b[i] = (y + RTSP_PREPROCESS_BU * u) * args->scale[2] + args->bias[2];
+    }
+}
+
+#pragma mark - SSE2 / AVX2
+
+#ifdef RTSP_PREPROCESS_X86
+
+static void RTSPPreprocessRowSSE2(const RTSPPreprocessRowArgs *args, uint32_t count, float *r, float *g, float *b) {
+    __m128 fy = _mm_set1_ps(args->fy), cfy = _mm_set1_ps(args->chromaFy);
+    __m128 rv = _mm_set1_ps(RTSP_PREPROCESS_RV), gu = _mm_set1_ps(RTSP_PREPROCESS_GU);
+    __m128 gv = _mm_set1_ps(RTSP_PREPROCESS_GV), bu = _mm_set1_ps(RTSP_PREPROCESS_BU);
+    __m128 sr = _mm_set1_ps(args->scale[0]), sg = _mm_set1_ps(args->scale[1]), sb = _mm_set1_ps(args->scale[2]);
+    __m128 br = _mm_set1_ps(args->bias[0]), bg = _mm_set1_ps(args->bias[1]), bb = _mm_set1_ps(args->bias[2]);
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 y0 = _mm_loadu_ps(args->y0 + i), u0 = _mm_loadu_ps(args->u0 + i), v0 = _mm_loadu_ps(args->v0 + i);
+        __m128 y = _mm_add_ps(y0, _mm_mul_ps(fy, _mm_sub_ps(_mm_loadu_ps(args->y1 + i), y0)));
+        __m128 u = _mm_add_ps(u0, _mm_mul_ps(cfy, _mm_sub_ps(_mm_loadu_ps(args->u1 + i), u0)));
+        __m128 v = _mm_add_ps(v0, _mm_mul_ps(cfy, _mm_sub_ps(_mm_loadu_ps(args->v1 + i), v0)));
+        __m128 red = _mm_add_ps(y, _mm_mul_ps(rv, v));
+        __m128 green = _mm_add_ps(_mm_add_ps(y, _mm_mul_ps(gu, u)), _mm_mul_ps(gv, v));
+        __m128 blue = _mm_add_ps(y, _mm_mul_ps(bu, u));
+        _mm_storeu_ps(r + i, _mm_add_ps(_mm_mul_ps(red, sr), br));
+        _mm_storeu_ps(g + i, _mm_add_ps(_mm_mul_ps(green, sg), bg));
+        _mm_storeu_ps(b + i, _mm_add_ps(_mm_mul_ps(blue, sb), bb));
+    }
+    RTSPPreprocessRowArgs tail = *args;
+    tail.y0 += i; tail.y1 += i; tail.u0 += i; tail.u1 += i; tail.v0 += i; tail.v1 += i;
+    RTSPPreprocessRowScalar(&tail, count - i, r + i, g + i, b + i);
+}
+
+__attribute__((target("avx2")))
+static void RTSPPreprocessRowAVX2(const RTSPPreprocessRowArgs *args, uint32_t count, float *r, float *g, float *b) {
+    __m256 fy = _mm256_set1_ps(args->fy), cfy = _mm256_set1_ps(args->chromaFy);
+    __m256 rv = _mm256_set1_ps(RTSP_PREPROCESS_RV), gu = _mm256_set1_ps(RTSP_PREPROCESS_GU);
+    __m256 gv = _mm256_set1_ps(RTSP_PREPROCESS_GV), bu = _mm256_set1_ps(RTSP_PREPROCESS_BU);
+    __m256 sr = _mm256_set1_ps(args->scale[0]), sg = _mm256_set1_ps(args->scale[1]), sb = _mm256_set1_ps(args->scale[2]);
+    __m256 br = _mm256_set1_ps(args->bias[0]), bg = _mm256_set1_ps(args->bias[1]), bb = _mm256_set1_ps(args->bias[2]);
+    uint32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 y0 = _mm256_loadu_ps(args->y0 + i), u0 = _mm256_loadu_ps(args->u0 + i), v0 = _mm256_loadu_ps(args->v0 + i);
+        __m256 y = _mm256_add_ps(y0, _mm256_mul_ps(fy, _mm256_sub_ps(_mm256_loadu_ps(args->y1 + i), y0)));
+        __m256 u = _mm256_add_ps(u0, _mm256_mul_ps(cfy, _mm256_sub_ps(_mm256_loadu_ps(args->u1 + i), u0)));
+        __m256 v = _mm256_add_ps(v0, _mm256_mul_ps(cfy, _mm256_sub_ps(_mm256_loadu_ps(args->v1 + i), v0)));
+        __m256 red = _mm256_add_ps(y, _mm256_mul_ps(rv, v));
+        __m256 green = _mm256_add_ps(_mm256_add_ps(y, _mm256_mul_ps(gu, u)), _mm256_mul_ps(gv, v));
+        __m256 blue = _mm256_add_ps(y, _mm256_mul_ps(bu, u));
+        _mm256_storeu_ps(r + i, _mm256_add_ps(_mm256_mul_ps(red, sr), br));
+        _mm256_storeu_ps(g + i, _mm256_add_ps(_mm256_mul_ps(green, sg), bg));
+        _mm256_storeu_ps(b + i, _mm256_add_ps(_mm256_mul_ps(blue, sb), bb));
+    }
+    RTSPPreprocessRowArgs tail = *args;
+    tail.y0 += i; tail.y1 += i; tail.u0 += i; tail.u1 += i; tail.v0 += i; tail.v1 += i;
+    RTSPPreprocessRowSSE2(&tail, count - i, r + i, g + i, b + i);
+}
+
+#endif
+
+#pragma mark - NEON
+
+#ifdef RTSP_PREPROCESS_NEON
+
+static void RTSPPreprocessRowNEON(const RTSPPreprocessRowArgs *args, uint32_t count, float *r, float *g, float *b) {
+    float32x4_t fy = vdupq_n_f32(args->fy), cfy = vdupq_n_f32(args->chromaFy);
+    float32x4_t sr = vdupq_n_f32(args->scale[0]), sg = vdupq_n_f32(args->scale[1]), sb = vdupq_n_f32(args->scale[2]);
+    float32x4_t br = vdupq_n_f32(args->bias[0]), bg = vdupq_n_f32(args->bias[1]), bb = vdupq_n_f32(args->bias[2]);
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t y0 = vld1q_f32(args->y0 + i), u0 = vld1q_f32(args->u0 + i), v0 = vld1q_f32(args->v0 + i);
+        float32x4_t y = vaddq_f32(y0, vmulq_f32(fy, vsubq_f32(vld1q_f32(args->y1 + i), y0)));
+        float32x4_t u = vaddq_f32(u0, vmulq_f32(cfy, vsubq_f32(vld1q_f32(args->u1 + i), u0)));
+        float32x4_t v = vaddq_f32(v0, vmulq_f32(cfy, vsubq_f32(vld1q_f32(args->v1 + i), v0)));
+        float32x4_t red = vaddq_f32(y, vmulq_n_f32(v, RTSP_PREPROCESS_RV));
+        float32x4_t green = vaddq_f32(vaddq_f32(y, vmulq_n_f32(u, RTSP_PREPROCESS_GU)), vmulq_n_f32(v, RTSP_PREPROCESS_GV));
+        float32x4_t blue = vaddq_f32(y, vmulq_n_f32(u, RTSP_PREPROCESS_BU));
+        vst1q_f32(r + i, vaddq_f32(vmulq_f32(red, sr), br));
+        vst1q_f32(g + i, vaddq_f32(vmulq_f32(green, sg), bg));
+        vst1q_f32(b + i, vaddq_f32(vmulq_f32(blue, sb), bb));
+    }
+    RTSPPreprocessRowArgs tail = *args;
+    tail.y0 += i; tail.y1 += i; tail.u0 += i; tail.u1 += i; tail.v0 += i; tail.v1 += i;
+    RTSPPreprocessRowScalar(&tail, count - i, r + i, g + i, b + i);
+}
+
+#endif
+
+#pragma mark - Lifecycle
+
+void RTSPDetectionPreprocessorConfigInit(RTSPDetectionPreprocessorConfig *config, uint32_t inputWidth,
+                                         uint32_t inputHeight) {
+    memset(config, 0, sizeof(*config));
+    config->inputWidth = inputWidth;
+    config->inputHeight = inputHeight;
+    config->format = RTSPDetectionInputPlanarFloat;
+    for (int c = 0; c < 3; c++) {
+        config->mean[c] = 0.0f;
+        config->std[c] = 1.0f;
+    }
+    config->padValue = 114;
+    config->backend = RTSPDetectionBackendAuto;
+}
+
+static RTSPDetectionBackend RTSPPreprocessResolveBackend(RTSPDetectionBackend requested) {
+    if (requested != RTSPDetectionBackendAuto) {
+        return RTSPDetectionBackendAvailable(requested) ? requested : RTSPDetectionBackendScalar;
+    }
+    const RTSPDetectionBackend preferred[] = {
+        RTSPDetectionBackendNEON, RTSPDetectionBackendAVX2, RTSPDetectionBackendSSE2
+    };
+    for (size_t i = 0; i < sizeof(preferred) / sizeof(preferred[0]); i++) {
+        if (RTSPDetectionBackendAvailable(preferred[i])) {
+            return preferred[i];
+        }
+    }
+    return RTSPDetectionBackendScalar;
+}
+
+RTSPDetectionPreprocessorRef RTSPDetectionPreprocessorCreate(const RTSPDetectionPreprocessorConfig *config) {
+    if (!config || config->inputWidth == 0 || config->inputHeight == 0) {
+        return NULL;
+    }
+    for (int c = 0; c < 3; c++) {
+        if (!(config->std[c] > 0.0f)) {
+            return NULL;
+        }
+    }
+    RTSPDetectionPreprocessorRef preprocessor = calloc(1, sizeof(*preprocessor));
+    if (!preprocessor) {
+        return NULL;
+    }
+    preprocessor->config = *config;
+    preprocessor->backend = RTSPPreprocessResolveBackend(config->backend);
+    preprocessor->rowFunction = RTSPPreprocessRowScalar;
+    switch (preprocessor->backend) {
+#ifdef RTSP_PREPROCESS_X86
+        case RTSPDetectionBackendSSE2: preprocessor->rowFunction = RTSPPreprocessRowSSE2; break;
+        case RTSPDetectionBackendAVX2: preprocessor->rowFunction = RTSPPreprocessRowAVX2; break;
+#endif
+#ifdef RTSP_PREPROCESS_NEON
+        case RTSPDetectionBackendNEON: preprocessor->rowFunction = RTSPPreprocessRowNEON; break;
+#endif
+        default: break;
+    }
+
+    uint32_t width = config->inputWidth;
+    preprocessor->lumaX0 = malloc(width * sizeof(uint32_t));
+    preprocessor->lumaX1 = malloc(width * sizeof(uint32_t));
+    preprocessor->lumaFx = malloc(width * sizeof(float));
+    preprocessor->chromaX0 = malloc(width * sizeof(uint32_t));
+    preprocessor->chromaX1 = malloc(width * sizeof(uint32_t));
+    preprocessor->chromaFx = malloc(width * sizeof(float));
+    preprocessor->rows = malloc(3 * (size_t)width * sizeof(float));
+    bool ok = preprocessor->lumaX0 && preprocessor->lumaX1 && preprocessor->lumaFx && preprocessor->chromaX0 &&
+              preprocessor->chromaX1 && preprocessor->chromaFx && preprocessor->rows;
+    for (int s = 0; s < 2 && ok; s++) {
+        preprocessor->luma[s].data = malloc(width * sizeof(float));
+        preprocessor->chroma[s].data = malloc(2 * (size_t)width * sizeof(float));
+        ok = preprocessor->luma[s].data && preprocessor->chroma[s].data;
+    }
+    if (!ok) {
+        RTSPDetectionPreprocessorRelease(preprocessor);
+        return NULL;
+    }
+
+    // Padding goes through the same normalisation as the picture
+    bool floats = config->format == RTSPDetectionInputPlanarFloat;
+    for (int c = 0; c < 3; c++) {
+        preprocessor->padded[c] = floats ? ((float)config->padValue / 255.0f - config->mean[c]) / config->std[c]
+                                         : (float)config->padValue;
+    }
+    return preprocessor;
+}
+
+void RTSPDetectionPreprocessorRelease(RTSPDetectionPreprocessorRef preprocessor) {
+    if (!preprocessor) {
+        return;
+    }
+    free(preprocessor->lumaX0);
+    free(preprocessor->lumaX1);
+    free(preprocessor->lumaFx);
+    free(preprocessor->chromaX0);
+    free(preprocessor->chromaX1);
+    free(preprocessor->chromaFx);
+    free(preprocessor->rows);
+    for (int s = 0; s < 2; s++) {
+        free(preprocessor->luma[s].data);
+        free(preprocessor->chroma[s].data);
+    }
+    free(preprocessor);
+}
+
+size_t RTSPDetectionPreprocessorInputLength(RTSPDetectionPreprocessorRef preprocessor, size_t bytesPerRow) {
+    const RTSPDetectionPreprocessorConfig *config = &preprocessor->config;
+    if (config->format == RTSPDetectionInputPlanarFloat) {
+        return 3 * (size_t)config->inputWidth * config->inputHeight * sizeof(float);
+    }
+    size_t stride = bytesPerRow ? bytesPerRow : 4 * (size_t)config->inputWidth;
+    return stride * config->inputHeight;
+}
+
+RTSPDetectionBackend RTSPDetectionPreprocessorGetBackend(RTSPDetectionPreprocessorRef preprocessor) {
+    return preprocessor ? preprocessor->backend : RTSPDetectionBackendScalar;
+}
+
+#pragma mark - Tables
+
+/// Source coordinate of an output pixel centre, clamped to the plane
+static inline float RTSPPreprocessSourceCoordinate(float output, float pad, float scale, float planeScale, uint32_t size) {
+    float source = (output + 0.5f - pad) / scale * planeScale - 0.5f;
+    float last = (float)(size - 1);
+    return source < 0.0f ? 0.0f : source > last ? last : source;
+}
+
+static void RTSPPreprocessPrepare(RTSPDetectionPreprocessorRef preprocessor, uint32_t width, uint32_t height) {
+    const RTSPDetectionPreprocessorConfig *config = &preprocessor->config;
+    RTSPLetterbox letterbox = RTSPLetterboxMake(width, height, config->inputWidth, config->inputHeight);
+    preprocessor->letterbox = letterbox;
+    preprocessor->width = width;
+    preprocessor->height = height;
+
+    // Output pixels whose centres fall on the picture
+    float right = letterbox.padX + (float)width * letterbox.scale;
+    float bottom = letterbox.padY + (float)height * letterbox.scale;
+    preprocessor->left = (uint32_t)ceilf(letterbox.padX - 0.5f);
+    preprocessor->top = (uint32_t)ceilf(letterbox.padY - 0.5f);
+    uint32_t end = (uint32_t)ceilf(right - 0.5f), endY = (uint32_t)ceilf(bottom - 0.5f);
+    end = end > config->inputWidth ? config->inputWidth : end;
+    endY = endY > config->inputHeight ? config->inputHeight : endY;
+    preprocessor->contentWidth = end > preprocessor->left ? end - preprocessor->left : 0;
+    preprocessor->contentHeight = endY > preprocessor->top ? endY - preprocessor->top : 0;
+
+    uint32_t chromaWidth = (width + 1) / 2;
+    for (uint32_t j = 0; j < preprocessor->contentWidth; j++) {
+        float x = (float)(preprocessor->left + j);
+        float sx = RTSPPreprocessSourceCoordinate(x, letterbox.padX, letterbox.scale, 1.0f, width);
+        uint32_t x0 = (uint32_t)sx;
+        preprocessor->lumaX0[j] = x0;
+        preprocessor->lumaX1[j] = x0 + 1 < width ? x0 + 1 : width - 1;
+        preprocessor->lumaFx[j] = sx - (float)x0;
+
+        float cx = RTSPPreprocessSourceCoordinate(x, letterbox.padX, letterbox.scale, 0.5f, chromaWidth);
+        uint32_t c0 = (uint32_t)cx;
+        preprocessor->chromaX0[j] = c0;
+        preprocessor->chromaX1[j] = c0 + 1 < chromaWidth ? c0 + 1 : chromaWidth - 1;
+        preprocessor->chromaFx[j] = cx - (float)c0;
+    }
+}
+
+#pragma mark - Rows
+
+/// Horizontally resampled luma row, from the cache when an earlier output row used it
+static const float *RTSPPreprocessLumaRow(RTSPDetectionPreprocessorRef preprocessor, const uint8_t *luma,
+                                          size_t bytesPerRow, uint32_t row) {
+    RTSPPreprocessCachedRow *slots = preprocessor->luma;
+    for (int s = 0; s < 2; s++) {
+        if (slots[s].row == row) {
+            return slots[s].data;
+        }
+    }
+    // Rows only move down: replace the older one
+    RTSPPreprocessCachedRow *slot = slots[0].row < slots[1].row ? &slots[0] : &slots[1];
+    const uint8_t *source = luma + row * bytesPerRow;
+    for (uint32_t j = 0; j < preprocessor->contentWidth; j++) {
+        float a = source[preprocessor->lumaX0[j]], b = source[preprocessor->lumaX1[j]];
+        slot->data[j] = a + preprocessor->lumaFx[j] * (b - a);
+    }
+    slot->row = row;
+    return slot->data;
+}
+
+/// Horizontally resampled U and V rows (centred on 0), one after the other
+static const float *RTSPPreprocessChromaRow(RTSPDetectionPreprocessorRef preprocessor, const uint8_t *chroma,
+                                            size_t bytesPerRow, uint32_t row) {
+    RTSPPreprocessCachedRow *slots = preprocessor->chroma;
+    for (int s = 0; s < 2; s++) {
+        if (slots[s].row == row) {
+            return slots[s].data;
+        }
+    }
+    RTSPPreprocessCachedRow *slot = slots[0].row < slots[1].row ? &slots[0] : &slots[1];
+    const uint8_t *source = chroma + row * bytesPerRow;
+    float *u = slot->data, *v = slot->data + preprocessor->contentWidth;
+    for (uint32_t j = 0; j < preprocessor->contentWidth; j++) {
+        const uint8_t *p0 = source + 2 * preprocessor->chromaX0[j];
+        const uint8_t *p1 = source + 2 * preprocessor->chromaX1[j];
+        float fx = preprocessor->chromaFx[j];
+        u[j] = (float)p0[0] + fx * ((float)p1[0] - (float)p0[0]) - 128.0f;
+        v[j] = (float)p0[1] + fx * ((float)p1[1] - (float)p0[1]) - 128.0f;
+    }
+    slot->row = row;
+    return slot->data;
+}
+
+static inline uint8_t RTSPPreprocessByte(float value) {
+    return value <= 0.0f ? 0 : value >= 255.0f ? 255 : (uint8_t)(value + 0.5f);
+}
+
+static void RTSPPreprocessPadBGRA(uint8_t *row, uint32_t from, uint32_t to, uint8_t value) {
+    for (uint32_t x = from; x < to; x++) {
+        row[4 * x + 0] = value;
+        row[4 * x + 1] = value;
+        row[4 * x + 2] = value;
+        row[4 * x + 3] = 255;
+    }
+}
+
+static void RTSPPreprocessPadFloat(float *row, uint32_t from, uint32_t to, float value) {
+    for (uint32_t x = from; x < to; x++) {
+        row[x] = value;
+    }
+}
+
+#pragma mark - Frames
+
+bool RTSPDetectionPreprocessNV12(RTSPDetectionPreprocessorRef preprocessor,
+                                 const uint8_t *luma, size_t lumaBytesPerRow,
+                                 const uint8_t *chroma, size_t chromaBytesPerRow,
+                                 uint32_t width, uint32_t height,
+                                 void *input, size_t bytesPerRow,
+                                 RTSPLetterbox *letterbox) {
+    if (!preprocessor || !luma || !chroma || !input || width < 2 || height < 2 || lumaBytesPerRow < width ||
+        chromaBytesPerRow < 2 * ((width + 1) / 2)) {
+        return false;
+    }
+    const RTSPDetectionPreprocessorConfig *config = &preprocessor->config;
+    if (width != preprocessor->width || height != preprocessor->height) {
+        RTSPPreprocessPrepare(preprocessor, width, height);
+    }
+    for (int s = 0; s < 2; s++) {
+        preprocessor->luma[s].row = -1;
+        preprocessor->chroma[s].row = -1;
+    }
+    if (letterbox) {
+        *letterbox = preprocessor->letterbox;
+    }
+
+    const RTSPLetterbox *box = &preprocessor->letterbox;
+    uint32_t inputWidth = config->inputWidth, inputHeight = config->inputHeight;
+    uint32_t left = preprocessor->left, top = preprocessor->top;
+    uint32_t contentWidth = preprocessor->contentWidth, contentBottom = top + preprocessor->contentHeight;
+    uint32_t chromaHeight = (height + 1) / 2;
+    bool floats = config->format == RTSPDetectionInputPlanarFloat;
+    size_t plane = (size_t)inputWidth * inputHeight;
+    size_t stride = bytesPerRow ? bytesPerRow : 4 * (size_t)inputWidth;
+    uint8_t pad = config->padValue;
+
+    RTSPPreprocessRowArgs args;
+    for (int c = 0; c < 3; c++) {
+        args.scale[c] = floats ? 1.0f / (255.0f * config->std[c]) : 1.0f;
+        args.bias[c] = floats ? -config->mean[c] / config->std[c] : 0.0f;
+    }
+
+    for (uint32_t oy = 0; oy < inputHeight; oy++) {
+        float *r = floats ? (float *)input + oy * (size_t)inputWidth : preprocessor->rows;
+        float *g = floats ? r + plane : preprocessor->rows + inputWidth;
+        float *b = floats ? g + plane : preprocessor->rows + 2 * (size_t)inputWidth;
+        uint8_t *bgra = floats ? NULL : (uint8_t *)input + oy * stride;
+
+        if (oy < top || oy >= contentBottom || contentWidth == 0) {
+            if (floats) {
+                RTSPPreprocessPadFloat(r, 0, inputWidth, preprocessor->padded[0]);
+                RTSPPreprocessPadFloat(g, 0, inputWidth, preprocessor->padded[1]);
+                RTSPPreprocessPadFloat(b, 0, inputWidth, preprocessor->padded[2]);
+            } else {
+                RTSPPreprocessPadBGRA(bgra, 0, inputWidth, pad);
+            }
+            continue;
+        }
+
+        float sy = RTSPPreprocessSourceCoordinate((float)oy, box->padY, box->scale, 1.0f, height);
+        uint32_t y0 = (uint32_t)sy, y1 = y0 + 1 < height ? y0 + 1 : height - 1;
+        float cy = RTSPPreprocessSourceCoordinate((float)oy, box->padY, box->scale, 0.5f, chromaHeight);
+        uint32_t c0 = (uint32_t)cy, c1 = c0 + 1 < chromaHeight ? c0 + 1 : chromaHeight - 1;
+
+        // Fetch the second row first: it evicts the older slot, never the row just fetched
+        args.y1 = RTSPPreprocessLumaRow(preprocessor, luma, lumaBytesPerRow, y1);
+        args.y0 = RTSPPreprocessLumaRow(preprocessor, luma, lumaBytesPerRow, y0);
+        const float *chroma1 = RTSPPreprocessChromaRow(preprocessor, chroma, chromaBytesPerRow, c1);
+        const float *chroma0 = RTSPPreprocessChromaRow(preprocessor, chroma, chromaBytesPerRow, c0);
+        args.u0 = chroma0;
+        args.v0 = chroma0 + contentWidth;
+        args.u1 = chroma1;
+        args.v1 = chroma1 + contentWidth;
+        args.fy = sy - (float)y0;
+        args.chromaFy = cy - (float)c0;
+
+        preprocessor->rowFunction(&args, contentWidth, r + left, g + left, b + left);
+
+        if (floats) {
+            RTSPPreprocessPadFloat(r, 0, left, preprocessor->padded[0]);
+            RTSPPreprocessPadFloat(g, 0, left, preprocessor->padded[1]);
+            RTSPPreprocessPadFloat(b, 0, left, preprocessor->padded[2]);
+            RTSPPreprocessPadFloat(r, left + contentWidth, inputWidth, preprocessor->padded[0]);
+            RTSPPreprocessPadFloat(g, left + contentWidth, inputWidth, preprocessor->padded[1]);
+            RTSPPreprocessPadFloat(b, left + contentWidth, inputWidth, preprocessor->padded[2]);
+        } else {
+            RTSPPreprocessPadBGRA(bgra, 0, left, pad);
+            for (uint32_t x = left; x < left + contentWidth; x++) {
+                bgra[4 * x + 0] = RTSPPreprocessByte(b[x]);
+                bgra[4 * x + 1] = RTSPPreprocessByte(g[x]);
+                bgra[4 * x + 2] = RTSPPreprocessByte(r[x]);
+                bgra[4 * x + 3] = 255;
+            }
+            RTSPPreprocessPadBGRA(bgra, left + contentWidth, inputWidth, pad);
+        }
+    }
+    return true;
+}
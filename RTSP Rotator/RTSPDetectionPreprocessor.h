@@ -0,0 +1,76 @@
+//
+//  RTSPDetectionPreprocessor.h
+//  RTSP Rotator
+//
+//  Turns decoded NV12 frames into detection model input: letterbox resize
+//  (aspect kept, centred, padded with grey 114 like YOLO training) with
+//  bilinear sampling, BT.709 full-range YUV to RGB, and normalisation,
+//  written either as planar float32 RGB ([3][height][width], for models
+//  taking a tensor) or as BGRA8 rows (for models taking an image).
+//
+//  Each output row is two horizontally resampled source rows (cached, as
+//  consecutive output rows share them) blended vertically; the blend and
+//  colour conversion run on whole rows with SSE2 / AVX2 / NEON paths and
+//  a scalar fallback (see Benchmarks/). Not thread-safe: one per thread.
+//
+
+#ifndef RTSPDetectionPreprocessor_h
+#define RTSPDetectionPreprocessor_h
+
+#include "RTSPDetectionDecoder.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    RTSPDetectionInputPlanarFloat = 0,     // [3][height][width] float32 RGB, (value / 255 - mean) / std
+    RTSPDetectionInputBGRA8                // height rows of width BGRA pixels
+} RTSPDetectionInputFormat;
+
+typedef struct {
+    uint32_t inputWidth;               // Model input size (default 640 x 640)
+    uint32_t inputHeight;
+    RTSPDetectionInputFormat format;   // Default planar float
+    float mean[3];                     // Per RGB channel on the 0 - 1 scale (default 0)
+    float std[3];                      // Default 1
+    uint8_t padValue;                  // Letterbox padding (default 114)
+    RTSPDetectionBackend backend;      // Backend override, Auto by default
+} RTSPDetectionPreprocessorConfig;
+
+void RTSPDetectionPreprocessorConfigInit(RTSPDetectionPreprocessorConfig *config, uint32_t inputWidth,
+                                         uint32_t inputHeight);
+
+typedef struct RTSPDetectionPreprocessor *RTSPDetectionPreprocessorRef;
+
+/// Create a preprocessor; returns NULL on invalid configuration or allocation failure
+RTSPDetectionPreprocessorRef RTSPDetectionPreprocessorCreate(const RTSPDetectionPreprocessorConfig *config);
+void RTSPDetectionPreprocessorRelease(RTSPDetectionPreprocessorRef preprocessor);
+
+/// Bytes of one model input: the packed float tensor, or height BGRA rows
+/// of `bytesPerRow` (0 = packed)
+size_t RTSPDetectionPreprocessorInputLength(RTSPDetectionPreprocessorRef preprocessor, size_t bytesPerRow);
+
+/// Letterbox an NV12 frame (luma plane plus interleaved half-resolution
+/// CbCr plane; rows may be padded) into `input`. `bytesPerRow` applies to
+/// BGRA8 output (0 = packed). `letterbox`, if given, receives the mapping
+/// RTSPDetectionDecoderDecode needs. Tables are rebuilt when the frame
+/// size changes. Returns false on invalid arguments or allocation failure.
+bool RTSPDetectionPreprocessNV12(RTSPDetectionPreprocessorRef preprocessor,
+                                 const uint8_t *luma, size_t lumaBytesPerRow,
+                                 const uint8_t *chroma, size_t chromaBytesPerRow,
+                                 uint32_t width, uint32_t height,
+                                 void *input, size_t bytesPerRow,
+                                 RTSPLetterbox *letterbox);
+
+RTSPDetectionBackend RTSPDetectionPreprocessorGetBackend(RTSPDetectionPreprocessorRef preprocessor);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RTSPDetectionPreprocessor_h */
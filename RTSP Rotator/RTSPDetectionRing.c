@@ -0,0 +1,175 @@
+//
+//  RTSPDetectionRing.c
+//  RTSP Rotator
+//
+
+#include "RTSPDetectionRing.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RTSP_DETECTION_RING_WORDS (sizeof(RTSPDetectionRecord) / sizeof(uint64_t))
+
+_Static_assert(sizeof(RTSPDetectionRecord) % sizeof(uint64_t) == 0, "records are copied as 64-bit words");
+
+typedef struct {
+    // 2 * sequence + 1 while the record is written, 2 * sequence + 2 once
+    // it is complete, 0 for a slot never written
+    _Atomic uint64_t version;
+    // The record as relaxed atomic words, so a read racing a write is torn
+    // rather than undefined; the version check throws torn copies away
+    _Atomic uint64_t words[RTSP_DETECTION_RING_WORDS];
+} RTSPDetectionSlot;
+
+struct RTSPDetectionRing {
+    uint32_t capacity;
+    RTSPDetectionSlot *slots;
+
+    _Alignas(64) _Atomic uint64_t head;     // Sequence of the next push
+    _Atomic uint64_t start;                 // First sequence since the last clear
+
+    _Alignas(64) _Atomic uint32_t classCounts[RTSP_DETECTION_RING_MAX_CLASSES];
+    _Atomic uint32_t cameraCounts[RTSP_DETECTION_RING_MAX_CAMERAS];
+};
+
+RTSPDetectionRingRef RTSPDetectionRingCreate(uint32_t capacity) {
+    if (capacity == 0) {
+        return NULL;
+    }
+    RTSPDetectionRingRef ring = aligned_alloc(64, (sizeof(struct RTSPDetectionRing) + 63) & ~(size_t)63);
+    if (!ring) {
+        return NULL;
+    }
+    memset(ring, 0, sizeof(*ring));
+    ring->capacity = capacity;
+    ring->slots = calloc(capacity, sizeof(RTSPDetectionSlot));
+    if (!ring->slots) {
+        free(ring);
+        return NULL;
+    }
+    return ring;
+}
+
+void RTSPDetectionRingRelease(RTSPDetectionRingRef ring) {
+    if (!ring) {
+        return;
+    }
+    free(ring->slots);
+    free(ring);
+}
+
+/// Only the producer changes counts, so a relaxed load and store is enough
+static void RTSPDetectionRingAdd(_Atomic uint32_t *count, int delta) {
+    atomic_store_explicit(count, atomic_load_explicit(count, memory_order_relaxed) + (uint32_t)delta, memory_order_relaxed);
+}
+
+static void RTSPDetectionRingCount(RTSPDetectionRingRef ring, const RTSPDetectionRecord *record, int delta) {
+    RTSPDetectionRingAdd(&ring->classCounts[record->classID], delta);
+    RTSPDetectionRingAdd(&ring->cameraCounts[record->cameraID], delta);
+}
+
+static void RTSPDetectionSlotLoad(RTSPDetectionSlot *slot, RTSPDetectionRecord *record) {
+    uint64_t words[RTSP_DETECTION_RING_WORDS];
+    for (size_t i = 0; i < RTSP_DETECTION_RING_WORDS; i++) {
+        words[i] = atomic_load_explicit(&slot->words[i], memory_order_relaxed);
+    }
+    memcpy(record, words, sizeof(*record));
+}
+
+uint64_t RTSPDetectionRingPush(RTSPDetectionRingRef ring, const RTSPDetectionRecord *record) {
+    if (record->classID >= RTSP_DETECTION_RING_MAX_CLASSES || record->cameraID >= RTSP_DETECTION_RING_MAX_CAMERAS) {
+        return UINT64_MAX;
+    }
+    // Only the producer writes head and start, so its own loads can be relaxed
+    uint64_t sequence = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint64_t start = atomic_load_explicit(&ring->start, memory_order_relaxed);
+    RTSPDetectionSlot *slot = &ring->slots[sequence % ring->capacity];
+
+    // The record being overwritten leaves the counts, unless a clear already dropped it
+    if (sequence >= ring->capacity && sequence - ring->capacity >= start) {
+        RTSPDetectionRecord evicted;
+        RTSPDetectionSlotLoad(slot, &evicted);
+        RTSPDetectionRingCount(ring, &evicted, -1);
+    }
+
+    RTSPDetectionRecord stored = *record;
+    stored.sequence = sequence;
+    uint64_t words[RTSP_DETECTION_RING_WORDS];
+    memcpy(words, &stored, sizeof(stored));
+
+    atomic_store_explicit(&slot->version, 2 * sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    for (size_t i = 0; i < RTSP_DETECTION_RING_WORDS; i++) {
+        atomic_store_explicit(&slot->words[i], words[i], memory_order_relaxed);
+    }
+    atomic_store_explicit(&slot->version, 2 * sequence + 2, memory_order_release);
+
+    RTSPDetectionRingCount(ring, &stored, 1);
+    atomic_store_explicit(&ring->head, sequence + 1, memory_order_release);
+    return sequence;
+}
+
+void RTSPDetectionRingClear(RTSPDetectionRingRef ring) {
+    atomic_store_explicit(&ring->start, atomic_load_explicit(&ring->head, memory_order_relaxed), memory_order_release);
+    for (uint32_t i = 0; i < RTSP_DETECTION_RING_MAX_CLASSES; i++) {
+        atomic_store_explicit(&ring->classCounts[i], 0, memory_order_relaxed);
+    }
+    for (uint32_t i = 0; i < RTSP_DETECTION_RING_MAX_CAMERAS; i++) {
+        atomic_store_explicit(&ring->cameraCounts[i], 0, memory_order_relaxed);
+    }
+}
+
+/// Copy one record if the slot still holds that sequence and was not
+/// rewritten during the copy
+static bool RTSPDetectionRingRead(RTSPDetectionRingRef ring, uint64_t sequence, RTSPDetectionRecord *record) {
+    RTSPDetectionSlot *slot = &ring->slots[sequence % ring->capacity];
+    uint64_t version = atomic_load_explicit(&slot->version, memory_order_acquire);
+    if (version != 2 * sequence + 2) {
+        return false;
+    }
+    RTSPDetectionSlotLoad(slot, record);
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&slot->version, memory_order_relaxed) == version;
+}
+
+static uint64_t RTSPDetectionRingFirst(RTSPDetectionRingRef ring, uint64_t head) {
+    uint64_t start = atomic_load_explicit(&ring->start, memory_order_acquire);
+    uint64_t first = head > ring->capacity ? head - ring->capacity : 0;
+    return start > first ? start : first;
+}
+
+uint32_t RTSPDetectionRingSnapshot(RTSPDetectionRingRef ring, RTSPDetectionRecord *records, uint32_t maxCount) {
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    uint64_t first = RTSPDetectionRingFirst(ring, head);
+    if (head - first > maxCount) {
+        first = head - maxCount;
+    }
+    uint32_t count = 0;
+    for (uint64_t sequence = first; sequence < head; sequence++) {
+        if (RTSPDetectionRingRead(ring, sequence, &records[count])) {
+            count++;
+        }
+    }
+    return count;
+}
+
+uint32_t RTSPDetectionRingClassCount(RTSPDetectionRingRef ring, uint16_t classID) {
+    if (classID >= RTSP_DETECTION_RING_MAX_CLASSES) {
+        return 0;
+    }
+    return atomic_load_explicit(&ring->classCounts[classID], memory_order_relaxed);
+}
+
+uint32_t RTSPDetectionRingCameraCount(RTSPDetectionRingRef ring, uint16_t cameraID) {
+    if (cameraID >= RTSP_DETECTION_RING_MAX_CAMERAS) {
+        return 0;
+    }
+    return atomic_load_explicit(&ring->cameraCounts[cameraID], memory_order_relaxed);
+}
+
+RTSPDetectionRingStats RTSPDetectionRingGetStats(RTSPDetectionRingRef ring) {
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    RTSPDetectionRingStats stats = {head, (uint32_t)(head - RTSPDetectionRingFirst(ring, head)), ring->capacity};
+    return stats;
+}
@@ -0,0 +1,91 @@
+//
+//  RTSPDetectionRing.h
+//  RTSP Rotator
+//
+//  Fixed-capacity history of detection events as compact records, written
+//  by one producer and read by any number of threads without locks. Each
+//  slot carries a sequence word that is odd while the slot is being written
+//  (a seqlock), so readers copy a record and keep it only if the word did
+//  not change; a reader never makes the producer wait, and the producer
+//  never waits for a reader.
+//
+//  Per-class and per-camera counts over the records in the ring are kept
+//  as atomics and adjusted as records are added and overwritten, so
+//  statistics need no scan.
+//
+//  Push and Clear must come from one thread at a time (e.g. a serial
+//  queue). Labels, cameras and zone sets are small IDs the caller maps to
+//  names. See Benchmarks/detection_ring_bench.c.
+//
+
+#ifndef RTSPDetectionRing_h
+#define RTSPDetectionRing_h
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RTSP_DETECTION_RING_MAX_CLASSES 1024
+#define RTSP_DETECTION_RING_MAX_CAMERAS 1024
+
+enum {
+    RTSPDetectionRecordFlagTracked = 1 << 0,       // trackID belongs to a confirmed track
+    RTSPDetectionRecordFlagAlert = 1 << 1,
+};
+
+typedef struct {
+    uint64_t sequence;          // Set by Push: 0, 1, 2... since the ring was created
+    double timestamp;           // Event time, seconds since 1970
+    double detectedAt;          // Detection time, seconds since 1970
+    float x, y, width, height;  // Normalized box, top-left origin
+    float confidence;
+    uint16_t classID;           // < RTSP_DETECTION_RING_MAX_CLASSES
+    uint16_t cameraID;          // < RTSP_DETECTION_RING_MAX_CAMERAS
+    uint64_t trackID;           // Tracker's ID, 0 = untracked
+    uint16_t zoneSetID;         // Caller-defined, e.g. an interned list of zone names
+    uint16_t flags;             // RTSPDetectionRecordFlag
+    uint32_t mediaOffset;       // DVR keyframe at or before the event: moof offset,
+    uint64_t mediaSegment;      // segment sequence (0 = not recorded)
+    int64_t mediaTime;          // and wall clock, microseconds since 1970
+} RTSPDetectionRecord;
+
+typedef struct {
+    uint64_t pushed;            // Records pushed since the ring was created
+    uint32_t count;             // Records currently readable
+    uint32_t capacity;
+} RTSPDetectionRingStats;
+
+typedef struct RTSPDetectionRing *RTSPDetectionRingRef;
+
+/// Ring holding the last `capacity` records. Returns NULL for a zero
+/// capacity or on allocation failure.
+RTSPDetectionRingRef RTSPDetectionRingCreate(uint32_t capacity);
+void RTSPDetectionRingRelease(RTSPDetectionRingRef ring);
+
+/// Append a record, overwriting the oldest once full. Returns its sequence,
+/// or UINT64_MAX if classID or cameraID is out of range. Producer only.
+uint64_t RTSPDetectionRingPush(RTSPDetectionRingRef ring, const RTSPDetectionRecord *record);
+
+/// Forget every record and zero the counts. Producer only.
+void RTSPDetectionRingClear(RTSPDetectionRingRef ring);
+
+/// Copy up to `maxCount` of the newest records into `records`, oldest
+/// first, and return how many were copied. Any thread; a record the
+/// producer overwrites during the copy is left out.
+uint32_t RTSPDetectionRingSnapshot(RTSPDetectionRingRef ring, RTSPDetectionRecord *records, uint32_t maxCount);
+
+/// Records in the ring for one class or camera. Any thread; counts read
+/// while the producer runs may be one push apart from each other.
+uint32_t RTSPDetectionRingClassCount(RTSPDetectionRingRef ring, uint16_t classID);
+uint32_t RTSPDetectionRingCameraCount(RTSPDetectionRingRef ring, uint16_t cameraID);
+
+RTSPDetectionRingStats RTSPDetectionRingGetStats(RTSPDetectionRingRef ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RTSPDetectionRing_h */
@@ -0,0 +1,376 @@
+//
+//  RTSPEventExporter.c
+//  RTSP Rotator
+//
+
+#include "RTSPEventExporter.h"
+#include "RTSPByteBuffer.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RTSP_EVENT_EXPORTER_PAGE 256
+
+struct RTSPEventExporter {
+    int fd;
+    RTSPEventExportConfig config;
+    RTSPByteBuffer buffer;
+    RTSPEventTimestampFormatter formatter;
+    RTSPEventExporterStatistics statistics;
+};
+
+#pragma mark - Timestamps
+
+static inline int64_t RTSPEventFloorDiv(int64_t value, int64_t divisor) {
+    int64_t quotient = value / divisor;
+    return (value % divisor != 0 && (value < 0) != (divisor < 0)) ? quotient - 1 : quotient;
+}
+
+/// Days since 1970-01-01 to a proleptic Gregorian date
+static void RTSPEventCivilFromDays(int64_t days, int64_t *year, unsigned *month, unsigned *day) {
+    days += 719468;
+    int64_t era = RTSPEventFloorDiv(days, 146097);
+    unsigned dayOfEra = (unsigned)(days - era * 146097);
+    unsigned yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    unsigned dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    unsigned monthIndex = (5 * dayOfYear + 2) / 153;
+    *day = dayOfYear - (153 * monthIndex + 2) / 5 + 1;
+    *month = monthIndex < 10 ? monthIndex + 3 : monthIndex - 9;
+    *year = (int64_t)yearOfEra + era * 400 + (*month <= 2);
+}
+
+static inline void RTSPEventTwoDigits(char *out, unsigned value) {
+    out[0] = (char)('0' + value / 10);
+    out[1] = (char)('0' + value % 10);
+}
+
+void RTSPEventTimestampFormatterInit(RTSPEventTimestampFormatter *formatter, bool localTime) {
+    memset(formatter, 0, sizeof(*formatter));
+    formatter->localTime = localTime;
+    formatter->window = INT64_MIN;
+    formatter->day = INT64_MIN;
+}
+
+/// Seconds in the output zone; the date text is refreshed when the day changes
+static int64_t RTSPEventTimestampFormatterPrepare(RTSPEventTimestampFormatter *formatter, int64_t timestamp) {
+    int64_t seconds = RTSPEventFloorDiv(timestamp, 1000000);
+    if (formatter->localTime) {
+        // Offsets change only at quarter-hour boundaries in every zone
+        int64_t window = RTSPEventFloorDiv(seconds, 900);
+        if (window != formatter->window) {
+            time_t clock = (time_t)seconds;
+            struct tm parts;
+            formatter->offset = localtime_r(&clock, &parts) ? (int64_t)parts.tm_gmtoff : 0;
+            formatter->window = window;
+        }
+        seconds += formatter->offset;
+    }
+    int64_t day = RTSPEventFloorDiv(seconds, 86400);
+    if (day != formatter->day) {
+        int64_t year;
+        unsigned month, dayOfMonth;
+        RTSPEventCivilFromDays(day, &year, &month, &dayOfMonth);
+        char text[32];
+        snprintf(text, sizeof(text), "%04lld-%02u-%02u", (long long)year, month, dayOfMonth);
+        memcpy(formatter->dayText, text, sizeof(formatter->dayText) - 1);
+        formatter->dayText[sizeof(formatter->dayText) - 1] = '\0';
+        formatter->day = day;
+    }
+    return seconds;
+}
+
+static void RTSPEventTimestampFormatterTime(char *out, int64_t secondOfDay) {
+    RTSPEventTwoDigits(out, (unsigned)(secondOfDay / 3600));
+    out[2] = ':';
+    RTSPEventTwoDigits(out + 3, (unsigned)(secondOfDay / 60 % 60));
+    out[5] = ':';
+    RTSPEventTwoDigits(out + 6, (unsigned)(secondOfDay % 60));
+}
+
+size_t RTSPEventTimestampFormatterFormat(RTSPEventTimestampFormatter *formatter, int64_t timestamp, char *out) {
+    int64_t seconds = RTSPEventTimestampFormatterPrepare(formatter, timestamp);
+    memcpy(out, formatter->dayText, 10);
+    out[10] = ' ';
+    RTSPEventTimestampFormatterTime(out + 11, seconds - formatter->day * 86400);
+    out[19] = '\0';
+    return 19;
+}
+
+size_t RTSPEventTimestampFormatterFormatISO8601(RTSPEventTimestampFormatter *formatter, int64_t timestamp, char *out) {
+    int64_t seconds = RTSPEventTimestampFormatterPrepare(formatter, timestamp);
+    unsigned milliseconds = (unsigned)((timestamp - RTSPEventFloorDiv(timestamp, 1000000) * 1000000) / 1000);
+    memcpy(out, formatter->dayText, 10);
+    out[10] = 'T';
+    RTSPEventTimestampFormatterTime(out + 11, seconds - formatter->day * 86400);
+    out[19] = '.';
+    out[20] = (char)('0' + milliseconds / 100);
+    RTSPEventTwoDigits(out + 21, milliseconds % 100);
+    out[23] = 'Z';
+    out[24] = '\0';
+    return 24;
+}
+
+#pragma mark - Escaping
+
+/// "text" with quotes doubled
+static void RTSPEventExporterAppendCSV(RTSPByteBuffer *buffer, const char *text, size_t length) {
+    RTSPByteBufferAppend(buffer, "\"", 1);
+    const char *end = text + length;
+    while (text < end) {
+        const char *quote = memchr(text, '"', (size_t)(end - text));
+        if (!quote) {
+            RTSPByteBufferAppend(buffer, text, (size_t)(end - text));
+            break;
+        }
+        RTSPByteBufferAppend(buffer, text, (size_t)(quote - text) + 1);
+        RTSPByteBufferAppend(buffer, "\"", 1);
+        text = quote + 1;
+    }
+    RTSPByteBufferAppend(buffer, "\"", 1);
+}
+
+static void RTSPEventExporterAppendJSON(RTSPByteBuffer *buffer, const char *text, size_t length) {
+    static const char hex[] = "0123456789abcdef";
+    RTSPByteBufferAppend(buffer, "\"", 1);
+    size_t run = 0;
+    for (size_t i = 0; i < length; i++) {
+        uint8_t c = (uint8_t)text[i];
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        RTSPByteBufferAppend(buffer, text + run, i - run);
+        run = i + 1;
+        switch (c) {
+            case '"': RTSPByteBufferAppend(buffer, "\\\"", 2); break;
+            case '\\': RTSPByteBufferAppend(buffer, "\\\\", 2); break;
+            case '\n': RTSPByteBufferAppend(buffer, "\\n", 2); break;
+            case '\r': RTSPByteBufferAppend(buffer, "\\r", 2); break;
+            case '\t': RTSPByteBufferAppend(buffer, "\\t", 2); break;
+            default: {
+                char escape[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 15]};
+                RTSPByteBufferAppend(buffer, escape, sizeof(escape));
+                break;
+            }
+        }
+    }
+    RTSPByteBufferAppend(buffer, text + run, length - run);
+    RTSPByteBufferAppend(buffer, "\"", 1);
+}
+
+static void RTSPEventExporterAppendUUID(RTSPByteBuffer *buffer, const uint8_t *uuid) {
+    static const char hex[] = "0123456789ABCDEF";
+    char text[36];
+    size_t position = 0;
+    for (int i = 0; i < 16; i++) {
+        if (i == 4 || i == 6 || i == 8 || i == 10) {
+            text[position++] = '-';
+        }
+        text[position++] = hex[uuid[i] >> 4];
+        text[position++] = hex[uuid[i] & 15];
+    }
+    RTSPByteBufferAppend(buffer, text, sizeof(text));
+}
+
+#pragma mark - Exporter
+
+void RTSPEventExportConfigInit(RTSPEventExportConfig *config) {
+    memset(config, 0, sizeof(*config));
+    config->format = RTSPEventExportFormatCSV;
+    config->chunkSize = 64 * 1024;
+}
+
+RTSPEventExporterRef RTSPEventExporterCreate(int fd, const RTSPEventExportConfig *config) {
+    if (fd < 0 || !config) {
+        errno = EINVAL;
+        return NULL;
+    }
+    RTSPEventExporterRef exporter = calloc(1, sizeof(*exporter));
+    if (!exporter) {
+        return NULL;
+    }
+    exporter->fd = fd;
+    exporter->config = *config;
+    if (exporter->config.chunkSize == 0) {
+        exporter->config.chunkSize = 64 * 1024;
+    }
+    RTSPByteBufferInit(&exporter->buffer);
+    RTSPByteBufferReserve(&exporter->buffer, exporter->config.chunkSize + 4096);
+    RTSPEventTimestampFormatterInit(&exporter->formatter, config->format != RTSPEventExportFormatNDJSON);
+    if (config->format == RTSPEventExportFormatCSV) {
+        RTSPByteBufferAppendString(&exporter->buffer, "Timestamp,Type,Title,Details,Feed URL\n");
+    }
+    return exporter;
+}
+
+void RTSPEventExporterRelease(RTSPEventExporterRef exporter) {
+    if (!exporter) {
+        return;
+    }
+    RTSPByteBufferFree(&exporter->buffer);
+    free(exporter);
+}
+
+bool RTSPEventExporterFlush(RTSPEventExporterRef exporter) {
+    if (!exporter) {
+        errno = EINVAL;
+        return false;
+    }
+    if (exporter->buffer.failed) {
+        errno = ENOMEM;
+        return false;
+    }
+    if (exporter->buffer.length > exporter->statistics.peakBuffer) {
+        exporter->statistics.peakBuffer = exporter->buffer.length;
+    }
+    const uint8_t *data = exporter->buffer.data;
+    size_t remaining = exporter->buffer.length;
+    while (remaining > 0) {
+        ssize_t written = write(exporter->fd, data, remaining);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        remaining -= (size_t)written;
+        exporter->statistics.writes++;
+    }
+    exporter->statistics.bytes += exporter->buffer.length;
+    RTSPByteBufferReset(&exporter->buffer);
+    return true;
+}
+
+bool RTSPEventExporterWriteText(RTSPEventExporterRef exporter, const char *text, size_t length) {
+    if (!exporter) {
+        errno = EINVAL;
+        return false;
+    }
+    RTSPByteBufferAppend(&exporter->buffer, text, length);
+    return exporter->buffer.length < exporter->config.chunkSize || RTSPEventExporterFlush(exporter);
+}
+
+static void RTSPEventExporterAppendTypeName(RTSPEventExporterRef exporter, uint16_t type, bool json) {
+    const char *name = type < exporter->config.typeNameCount ? exporter->config.typeNames[type] : NULL;
+    char number[8];
+    if (!name) {
+        snprintf(number, sizeof(number), "%u", type);
+        name = number;
+    }
+    if (json) {
+        RTSPEventExporterAppendJSON(&exporter->buffer, name, strlen(name));
+    } else if (exporter->config.format == RTSPEventExportFormatCSV) {
+        RTSPEventExporterAppendCSV(&exporter->buffer, name, strlen(name));
+    } else {
+        RTSPByteBufferAppendString(&exporter->buffer, name);
+    }
+}
+
+static void RTSPEventExporterAppendEntry(RTSPEventExporterRef exporter, const RTSPEventStoreEntry *entry) {
+    const RTSPEventStoreRecord *record = entry->record;
+    RTSPByteBuffer *buffer = &exporter->buffer;
+    char timestamp[32];
+
+    switch (exporter->config.format) {
+        case RTSPEventExportFormatCSV:
+            RTSPByteBufferAppend(buffer, "\"", 1);
+            RTSPByteBufferAppend(buffer, timestamp, RTSPEventTimestampFormatterFormat(&exporter->formatter, record->timestamp, timestamp));
+            RTSPByteBufferAppend(buffer, "\",", 2);
+            RTSPEventExporterAppendTypeName(exporter, record->type, false);
+            RTSPByteBufferAppend(buffer, ",", 1);
+            RTSPEventExporterAppendCSV(buffer, entry->title, record->titleLength);
+            RTSPByteBufferAppend(buffer, ",", 1);
+            RTSPEventExporterAppendCSV(buffer, entry->details, record->detailsLength);
+            RTSPByteBufferAppend(buffer, ",", 1);
+            RTSPEventExporterAppendCSV(buffer, entry->feed ? entry->feed : "", entry->feed ? strlen(entry->feed) : 0);
+            RTSPByteBufferAppend(buffer, "\n", 1);
+            break;
+
+        case RTSPEventExportFormatNDJSON:
+            RTSPByteBufferAppendString(buffer, "{\"id\":\"");
+            RTSPEventExporterAppendUUID(buffer, record->uuid);
+            RTSPByteBufferAppendFormat(buffer, "\",\"sequence\":%llu,\"timestamp\":\"", (unsigned long long)record->sequence);
+            RTSPByteBufferAppend(buffer, timestamp, RTSPEventTimestampFormatterFormatISO8601(&exporter->formatter, record->timestamp, timestamp));
+            RTSPByteBufferAppendString(buffer, "\",\"type\":");
+            RTSPEventExporterAppendTypeName(exporter, record->type, true);
+            RTSPByteBufferAppendFormat(buffer, ",\"typeCode\":%u,\"title\":", record->type);
+            RTSPEventExporterAppendJSON(buffer, entry->title, record->titleLength);
+            if (record->detailsLength > 0) {
+                RTSPByteBufferAppendString(buffer, ",\"details\":");
+                RTSPEventExporterAppendJSON(buffer, entry->details, record->detailsLength);
+            }
+            if (entry->feed) {
+                RTSPByteBufferAppendString(buffer, ",\"feed\":");
+                RTSPEventExporterAppendJSON(buffer, entry->feed, strlen(entry->feed));
+            }
+            if (record->metadataLength > 0) {
+                // Stored as JSON by the logger; embedded verbatim
+                RTSPByteBufferAppendString(buffer, ",\"metadata\":");
+                RTSPByteBufferAppend(buffer, entry->metadata, record->metadataLength);
+            }
+            RTSPByteBufferAppend(buffer, "}\n", 2);
+            break;
+
+        case RTSPEventExportFormatText:
+            RTSPByteBufferAppend(buffer, "[", 1);
+            RTSPByteBufferAppend(buffer, timestamp, RTSPEventTimestampFormatterFormat(&exporter->formatter, record->timestamp, timestamp));
+            RTSPByteBufferAppend(buffer, "] ", 2);
+            RTSPEventExporterAppendTypeName(exporter, record->type, false);
+            RTSPByteBufferAppendString(buffer, "\nTitle: ");
+            RTSPByteBufferAppend(buffer, entry->title, record->titleLength);
+            if (record->detailsLength > 0) {
+                RTSPByteBufferAppendString(buffer, "\nDetails: ");
+                RTSPByteBufferAppend(buffer, entry->details, record->detailsLength);
+            }
+            if (entry->feed) {
+                RTSPByteBufferAppendString(buffer, "\nFeed: ");
+                RTSPByteBufferAppendString(buffer, entry->feed);
+            }
+            RTSPByteBufferAppend(buffer, "\n\n", 2);
+            break;
+    }
+}
+
+long long RTSPEventExporterWrite(RTSPEventExporterRef exporter, RTSPEventStoreRef store, RTSPEventStoreCursorRef cursor,
+                                 uint64_t maxEvents) {
+    if (!exporter || !store || !cursor) {
+        errno = EINVAL;
+        return -1;
+    }
+    uint64_t sequences[RTSP_EVENT_EXPORTER_PAGE];
+    uint64_t exported = 0;
+    while (!RTSPEventStoreCursorExhausted(cursor) && (maxEvents == 0 || exported < maxEvents)) {
+        size_t want = RTSP_EVENT_EXPORTER_PAGE;
+        if (maxEvents && maxEvents - exported < want) {
+            want = (size_t)(maxEvents - exported);
+        }
+        size_t count = RTSPEventStoreCursorNext(cursor, store, sequences, want);
+        for (size_t i = 0; i < count; i++) {
+            RTSPEventStoreEntry entry;
+            if (!RTSPEventStoreGet(store, sequences[i], &entry)) {
+                continue;
+            }
+            RTSPEventExporterAppendEntry(exporter, &entry);
+            exported++;
+            exporter->statistics.events++;
+            if (exporter->buffer.length >= exporter->config.chunkSize && !RTSPEventExporterFlush(exporter)) {
+                return -1;
+            }
+        }
+    }
+    if (exporter->buffer.failed) {
+        errno = ENOMEM;
+        return -1;
+    }
+    return (long long)exported;
+}
+
+RTSPEventExporterStatistics RTSPEventExporterGetStatistics(RTSPEventExporterRef exporter) {
+    RTSPEventExporterStatistics statistics;
+    memset(&statistics, 0, sizeof(statistics));
+    return exporter ? exporter->statistics : statistics;
+}
@@ -0,0 +1,96 @@
+//
+//  RTSPEventExporter.h
+//  RTSP Rotator
+//
+//  Streaming export of RTSPEventStore events as CSV, NDJSON or the plain
+//  text timeline report. Events are pulled from a query cursor and
+//  formatted straight from the mapped records into one fixed-size chunk
+//  buffer, which is written to a file descriptor whenever it fills, so
+//  memory stays flat however many events are exported. Callers can export
+//  in slices (RTSPEventExporterWrite with a small maxEvents) to release the
+//  store's queue between them.
+//
+//  Timestamps use RTSPEventTimestampFormatter, which caches the date text
+//  for the current day and the UTC offset for the current quarter hour
+//  instead of calling localtime or a date formatter per event.
+//
+//  Plain C. Not thread-safe: use on the store's queue.
+//
+
+#ifndef RTSPEventExporter_h
+#define RTSPEventExporter_h
+
+#include "RTSPEventStoreQuery.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#pragma mark - Timestamps
+
+typedef struct {
+    bool localTime;                 // Local wall-clock time, else UTC
+    int64_t window;                 // Cached quarter hour (UTC seconds / 900)
+    int64_t offset;                 // Its UTC offset in seconds
+    int64_t day;                    // Cached day (days since 1970, in the output zone)
+    char dayText[11];               // Its "yyyy-MM-dd"
+} RTSPEventTimestampFormatter;
+
+void RTSPEventTimestampFormatterInit(RTSPEventTimestampFormatter *formatter, bool localTime);
+
+/// "yyyy-MM-dd HH:mm:ss" into 20 bytes (NUL-terminated); returns 19
+size_t RTSPEventTimestampFormatterFormat(RTSPEventTimestampFormatter *formatter, int64_t timestamp, char *out);
+
+/// RFC 3339 UTC with milliseconds, "yyyy-MM-ddTHH:mm:ss.SSSZ", into 25
+/// bytes (NUL-terminated); returns 24. The formatter must be in UTC mode.
+size_t RTSPEventTimestampFormatterFormatISO8601(RTSPEventTimestampFormatter *formatter, int64_t timestamp, char *out);
+
+#pragma mark - Exporter
+
+typedef enum {
+    RTSPEventExportFormatCSV,       // Timestamp,Type,Title,Details,Feed URL; local time
+    RTSPEventExportFormatNDJSON,    // One JSON object per line; UTC
+    RTSPEventExportFormatText       // The timeline report layout; local time
+} RTSPEventExportFormat;
+
+typedef struct {
+    RTSPEventExportFormat format;
+    const char *const *typeNames;   // Display name per event type; NULL entries fall back to the number
+    size_t typeNameCount;
+    size_t chunkSize;               // Write threshold; default 64 KB
+} RTSPEventExportConfig;
+
+void RTSPEventExportConfigInit(RTSPEventExportConfig *config);
+
+typedef struct {
+    uint64_t events;
+    uint64_t bytes;
+    uint64_t writes;                // write(2) calls
+    size_t peakBuffer;              // Largest the chunk buffer got
+} RTSPEventExporterStatistics;
+
+typedef struct RTSPEventExporter *RTSPEventExporterRef;
+
+/// Start an export to `fd` (not closed by the exporter). Writes the CSV
+/// header line; other formats start empty.
+RTSPEventExporterRef RTSPEventExporterCreate(int fd, const RTSPEventExportConfig *config);
+void RTSPEventExporterRelease(RTSPEventExporterRef exporter);
+
+/// Append raw text (e.g. a report preamble)
+bool RTSPEventExporterWriteText(RTSPEventExporterRef exporter, const char *text, size_t length);
+
+/// Export up to `maxEvents` further matches of the cursor (0 = until it is
+/// exhausted). Returns the number exported, -1 on a write error (errno set).
+long long RTSPEventExporterWrite(RTSPEventExporterRef exporter, RTSPEventStoreRef store, RTSPEventStoreCursorRef cursor,
+                                 uint64_t maxEvents);
+
+/// Write what is buffered. False on a write error (errno set).
+bool RTSPEventExporterFlush(RTSPEventExporterRef exporter);
+
+RTSPEventExporterStatistics RTSPEventExporterGetStatistics(RTSPEventExporterRef exporter);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RTSPEventExporter_h */
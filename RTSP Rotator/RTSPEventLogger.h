@@ -2,7 +2,9 @@
 //  RTSPEventLogger.h
 //  RTSP Rotator
 //
-//  Event timeline and activity logging
+//  Event timeline and activity logging. Events are kept in RTSPEventStore,
+//  an append-only log under Application Support/RTSP Rotator/Events; writes
+//  happen on a background queue and are committed in groups.
 //
 
 #import <Foundation/Foundation.h>
@@ -10,6 +12,8 @@
 
 NS_ASSUME_NONNULL_BEGIN
 
+@class RTSPDVRPosition;
+
 typedef NS_ENUM(NSInteger, RTSPEventType) {
     RTSPEventTypeFeedSwitch,
     RTSPEventTypeSnapshot,
@@ -34,8 +38,36 @@ typedef NS_ENUM(NSInteger, RTSPEventType) {
 @property (nonatomic, strong) NSString *title;
 @property (nonatomic, strong, nullable) NSString *details;
 @property (nonatomic, strong, nullable) NSURL *feedURL;
-@property (nonatomic, strong, nullable) NSImage *thumbnail;
+@property (nonatomic, strong, nullable) NSImage *thumbnail;           // Not stored; see -thumbnailForEvent:
 @property (nonatomic, strong, nullable) NSDictionary *metadata;
+/// Keyframe at or before the event in the feed's DVR recording, set by
+/// -logEvent: before the event is stored or the delegate is told, if the
+/// feed is recorded
+@property (nonatomic, strong, nullable) RTSPDVRPosition *recording;
+@end
+
+/// Event query; criteria that are set must all match, unset ones match
+/// everything
+@interface RTSPEventQuery : NSObject
+/// RTSPEventType values
+@property (nonatomic, copy, nullable) NSIndexSet *types;
+@property (nonatomic, strong, nullable) NSURL *feedURL;
+/// Inclusive bounds
+@property (nonatomic, strong, nullable) NSDate *fromDate;
+@property (nonatomic, strong, nullable) NSDate *toDate;
+/// Substring of title or details (case-insensitive for ASCII letters)
+@property (nonatomic, copy, nullable) NSString *text;
+/// Page newest events first (default: oldest first)
+@property (nonatomic, assign) BOOL newestFirst;
+@end
+
+/// Query results, materialized a page at a time. Covers the events logged
+/// before the cursor was created.
+@interface RTSPEventCursor : NSObject
+/// YES once every match has been returned
+@property (nonatomic, readonly, getter=isExhausted) BOOL exhausted;
+/// Next matches, at most `size`; empty once exhausted
+- (NSArray<RTSPEvent *> *)nextPageWithSize:(NSUInteger)size;
 @end
 
 @class RTSPEventLogger;
@@ -52,16 +84,30 @@ typedef NS_ENUM(NSInteger, RTSPEventType) {
 /// Shared instance
 + (instancetype)sharedLogger;
 
+/// Logger over the store in `directory`, created if needed (-init uses
+/// Application Support/RTSP Rotator/Events). A store has one writer: while
+/// another logger holds it, this one stays empty and logs nothing, so use
+/// +sharedLogger for the default store.
+- (instancetype)initWithDirectory:(NSString *)directory;
+
+/// Directory holding this logger's event store
+@property (nonatomic, copy, readonly) NSString *directory;
+
 /// Delegate for event notifications
 @property (nonatomic, weak) id<RTSPEventLoggerDelegate> delegate;
 
 /// Enable logging (default: YES)
 @property (nonatomic, assign) BOOL loggingEnabled;
 
-/// Maximum events to keep in memory (default: 1000)
+/// Maximum events returned by one call to -events or a query, newest kept
+/// (default: 1000)
 @property (nonatomic, assign) NSInteger maxEventsInMemory;
 
-/// All events
+/// Events retained on disk; the oldest are dropped in whole segments
+/// (default: 1,000,000, 0 = unlimited)
+@property (nonatomic, assign) NSInteger maxStoredEvents;
+
+/// Most recent events, oldest first
 - (NSArray<RTSPEvent *> *)events;
 
 /// Log event
@@ -70,6 +116,9 @@ typedef NS_ENUM(NSInteger, RTSPEventType) {
 /// Log event with details
 - (void)logEventType:(RTSPEventType)type title:(NSString *)title details:(nullable NSString *)details feedURL:(nullable NSURL *)feedURL;
 
+/// Query events (type, feed, date range and text combined), paged lazily
+- (RTSPEventCursor *)cursorForQuery:(RTSPEventQuery *)query;
+
 /// Get events by type
 - (NSArray<RTSPEvent *> *)eventsWithType:(RTSPEventType)type;
 
@@ -82,22 +131,34 @@ typedef NS_ENUM(NSInteger, RTSPEventType) {
 /// Search events
 - (NSArray<RTSPEvent *> *)searchEventsWithQuery:(NSString *)query;
 
+/// The event's thumbnail, made from its recording's keyframe the first time
+/// and cached with the recording. Blocks; nil if the event has no recording
+/// or it has been overwritten.
+- (nullable NSImage *)thumbnailForEvent:(RTSPEvent *)event;
+
 /// Clear all events
 - (void)clearAllEvents;
 
 /// Clear events before date
 - (void)clearEventsBeforeDate:(NSDate *)date;
 
-/// Export events to CSV
+/// Export events to CSV (local timestamps), streamed in constant memory
 - (BOOL)exportToCSV:(NSString *)filePath;
 
+/// Export events as newline-delimited JSON (UTC RFC 3339 timestamps)
+- (BOOL)exportToNDJSON:(NSString *)filePath;
+
+/// Export the events a query matches (nil = all), oldest first unless newestFirst
+- (BOOL)exportEventsMatchingQuery:(nullable RTSPEventQuery *)query toCSV:(NSString *)filePath;
+- (BOOL)exportEventsMatchingQuery:(nullable RTSPEventQuery *)query toNDJSON:(NSString *)filePath;
+
 /// Export events to PDF
 - (BOOL)exportToPDF:(NSString *)filePath;
 
-/// Save events to disk
+/// Commit pending events to disk now
 - (BOOL)saveEvents;
 
-/// Load events from disk
+/// Open the event store, migrating a legacy events.dat archive once
 - (BOOL)loadEvents;
 
 /// Get display name for event type
@@ -4,6 +4,14 @@
 //
 
 #import "RTSPEventLogger.h"
+#import "RTSPEventExporter.h"
+#import "RTSPEventStore.h"
+#import "RTSPEventStoreQuery.h"
+#import "RTSPFFmpegProxy.h"
+#import <fcntl.h>
+
+// Events exported per turn on the store queue, so logging carries on during long exports
+static const uint64_t kExportSliceEvents = 4096;
 
 @implementation RTSPEvent
 
@@ -27,8 +35,9 @@
     [coder encodeObject:self.title forKey:@"title"];
     [coder encodeObject:self.details forKey:@"details"];
     [coder encodeObject:self.feedURL forKey:@"feedURL"];
-    // Note: NSImage can be encoded but we'll skip for simplicity
+    // The thumbnail is not encoded: the recording position finds it again
     [coder encodeObject:self.metadata forKey:@"metadata"];
+    [coder encodeObject:self.recording forKey:@"recording"];
 }
 
 - (instancetype)initWithCoder:(NSCoder *)coder {
@@ -41,17 +50,79 @@
         _details = [coder decodeObjectOfClass:[NSString class] forKey:@"details"];
         _feedURL = [coder decodeObjectOfClass:[NSURL class] forKey:@"feedURL"];
         _metadata = [coder decodeObjectOfClass:[NSDictionary class] forKey:@"metadata"];
+        _recording = [coder decodeObjectOfClass:[RTSPDVRPosition class] forKey:@"recording"];
     }
     return self;
 }
 
 @end
 
+// Commit as soon as this many events are pending, otherwise after the delay
+static const uint32_t RTSPEventLoggerCommitBatch = 256;
+static const NSTimeInterval RTSPEventLoggerCommitDelay = 0.2;
+
+@implementation RTSPEventQuery
+@end
+
 @interface RTSPEventLogger ()
-@property (nonatomic, strong) NSMutableArray<RTSPEvent *> *allEvents;
+@property (nonatomic, strong) dispatch_queue_t storeQueue;
+@property (nonatomic, assign) BOOL commitScheduled;
+@property (nonatomic, readonly, nullable) RTSPEventStoreRef store;
+- (nullable RTSPEvent *)eventWithSequence:(uint64_t)sequence;
 @end
 
-@implementation RTSPEventLogger
+@implementation RTSPEventCursor {
+    RTSPEventLogger *_logger;
+    RTSPEventStoreCursorRef _cursor;    // Only touched on the logger's storeQueue
+}
+
+- (instancetype)initWithLogger:(RTSPEventLogger *)logger cursor:(RTSPEventStoreCursorRef)cursor {
+    self = [super init];
+    if (self) {
+        _logger = logger;
+        _cursor = cursor;
+    }
+    return self;
+}
+
+- (void)dealloc {
+    RTSPEventStoreCursorRef cursor = _cursor;
+    dispatch_async(_logger.storeQueue, ^{
+        RTSPEventStoreCursorRelease(cursor);
+    });
+}
+
+- (BOOL)isExhausted {
+    __block BOOL exhausted = YES;
+    dispatch_sync(_logger.storeQueue, ^{
+        exhausted = RTSPEventStoreCursorExhausted(self->_cursor);
+    });
+    return exhausted;
+}
+
+- (NSArray<RTSPEvent *> *)nextPageWithSize:(NSUInteger)size {
+    NSMutableArray<RTSPEvent *> *page = [NSMutableArray arrayWithCapacity:MIN(size, 1024)];
+    dispatch_sync(_logger.storeQueue, ^{
+        RTSPEventStoreRef store = self->_logger.store;
+        uint64_t sequences[256];
+        while (page.count < size && store && !RTSPEventStoreCursorExhausted(self->_cursor)) {
+            size_t count = RTSPEventStoreCursorNext(self->_cursor, store, sequences, MIN(size - page.count, 256));
+            for (size_t i = 0; i < count; i++) {
+                RTSPEvent *event = [self->_logger eventWithSequence:sequences[i]];
+                if (event) {
+                    [page addObject:event];
+                }
+            }
+        }
+    });
+    return page;
+}
+
+@end
+
+@implementation RTSPEventLogger {
+    RTSPEventStoreRef _store;       // Only touched on storeQueue
+}
 
 + (instancetype)sharedLogger {
     static RTSPEventLogger *shared = nil;
@@ -63,19 +134,136 @@
 }
 
 - (instancetype)init {
+    return [self initWithDirectory:[RTSPEventLogger storeDirectory]];
+}
+
+- (instancetype)initWithDirectory:(NSString *)directory {
     self = [super init];
     if (self) {
-        _allEvents = [NSMutableArray array];
+        _directory = [directory copy];
+        _storeQueue = dispatch_queue_create("com.rtsp.events.store", DISPATCH_QUEUE_SERIAL);
         _loggingEnabled = YES;
         _maxEventsInMemory = 1000;
+        _maxStoredEvents = 1000000;
 
         [self loadEvents];
     }
     return self;
 }
 
+- (void)dealloc {
+    RTSPEventStoreClose(_store);
+}
+
+- (RTSPEventStoreRef)store {
+    return _store;
+}
+
++ (NSString *)storeDirectory {
+    NSString *appSupport = [NSSearchPathForDirectoriesInDomains(NSApplicationSupportDirectory, NSUserDomainMask, YES) firstObject];
+    return [[appSupport stringByAppendingPathComponent:@"RTSP Rotator"] stringByAppendingPathComponent:@"Events"];
+}
+
+- (void)setMaxStoredEvents:(NSInteger)maxStoredEvents {
+    _maxStoredEvents = MAX(maxStoredEvents, 0);
+    dispatch_async(self.storeQueue, ^{
+        RTSPEventStoreSetMaxEvents(self->_store, (uint64_t)self->_maxStoredEvents);
+    });
+}
+
+#pragma mark - Conversion
+
+/// Copy an event into the store (storeQueue)
+- (void)appendEvent:(RTSPEvent *)event {
+    NSData *title = [event.title ?: @"" dataUsingEncoding:NSUTF8StringEncoding];
+    NSData *details = [event.details dataUsingEncoding:NSUTF8StringEncoding];
+    NSData *metadata = nil;
+    if (event.metadata && [NSJSONSerialization isValidJSONObject:event.metadata]) {
+        metadata = [NSJSONSerialization dataWithJSONObject:event.metadata options:0 error:nil];
+    }
+    NSUUID *uuid = [[NSUUID alloc] initWithUUIDString:event.eventID ?: @""] ?: [NSUUID UUID];
+
+    RTSPEventStoreEvent record = {
+        .timestamp = (int64_t)llround((event.timestamp ?: [NSDate date]).timeIntervalSince1970 * 1e6),
+        .type = (uint16_t)event.type,
+        .feed = event.feedURL.absoluteString.UTF8String,
+        .title = title.bytes,
+        .titleLength = title.length,
+        .details = details.bytes,
+        .detailsLength = details.length,
+        .metadata = metadata.bytes,
+        .metadataLength = metadata.length
+    };
+    [uuid getUUIDBytes:record.uuid];
+    RTSPDVRPosition *recording = event.recording;
+    if (recording && recording.offset <= UINT32_MAX) {
+        record.media.segment = recording.segment;
+        record.media.offset = (uint32_t)recording.offset;
+        record.media.time = recording.timestamp;
+    }
+    if (RTSPEventStoreAppend(_store, &record) == 0) {
+        NSLog(@"[Events] Failed to store event: %@", event.title);
+    }
+}
+
+/// Materialize a stored event (storeQueue)
+- (nullable RTSPEvent *)eventWithSequence:(uint64_t)sequence {
+    RTSPEventStoreEntry entry;
+    if (!RTSPEventStoreGet(_store, sequence, &entry)) {
+        return nil;
+    }
+    const RTSPEventStoreRecord *record = entry.record;
+    RTSPEvent *event = [[RTSPEvent alloc] init];
+    event.eventID = [[NSUUID alloc] initWithUUIDBytes:record->uuid].UUIDString;
+    event.type = (RTSPEventType)record->type;
+    event.timestamp = [NSDate dateWithTimeIntervalSince1970:(NSTimeInterval)record->timestamp / 1e6];
+    event.title = [[NSString alloc] initWithBytes:entry.title length:record->titleLength encoding:NSUTF8StringEncoding] ?: @"";
+    if (record->detailsLength > 0) {
+        event.details = [[NSString alloc] initWithBytes:entry.details length:record->detailsLength encoding:NSUTF8StringEncoding];
+    }
+    if (entry.feed) {
+        event.feedURL = [NSURL URLWithString:@(entry.feed)];
+    }
+    if (record->metadataLength > 0) {
+        NSData *metadata = [NSData dataWithBytesNoCopy:(void *)entry.metadata length:record->metadataLength freeWhenDone:NO];
+        id object = [NSJSONSerialization JSONObjectWithData:metadata options:0 error:nil];
+        event.metadata = [object isKindOfClass:[NSDictionary class]] ? object : nil;
+    }
+    if (record->media.segment != 0) {
+        event.recording = [[RTSPDVRPosition alloc] initWithSegment:record->media.segment
+                                                            offset:record->media.offset
+                                                         timestamp:record->media.time];
+    }
+    return event;
+}
+
+/// Materialize the newest `maxEventsInMemory` of a time index range, oldest first
+- (NSArray<RTSPEvent *> *)eventsInTimeIndexFrom:(size_t)from to:(size_t)to {
+    size_t count = 0;
+    const RTSPEventStoreTimeEntry *time = RTSPEventStoreTimeIndex(_store, &count);
+    to = MIN(to, count);
+    size_t limit = (size_t)MAX(self.maxEventsInMemory, 0);
+    if (to > from && to - from > limit) {
+        from = to - limit;
+    }
+    NSMutableArray<RTSPEvent *> *events = [NSMutableArray arrayWithCapacity:to > from ? to - from : 0];
+    for (size_t i = from; i < to; i++) {
+        RTSPEvent *event = [self eventWithSequence:time[i].sequence];
+        if (event) {
+            [events addObject:event];
+        }
+    }
+    return events;
+}
+
+#pragma mark - Logging
+
 - (NSArray<RTSPEvent *> *)events {
-    return [self.allEvents copy];
+    __block NSArray<RTSPEvent *> *events = @[];
+    dispatch_sync(self.storeQueue, ^{
+        events = [self eventsInTimeIndexFrom:0 to:SIZE_MAX];
+    });
+    return events;
 }
 
 - (void)logEvent:(RTSPEvent *)event {
@@ -83,24 +271,55 @@
         return;
     }
 
-    [self.allEvents addObject:event];
-
-    // Trim if exceeds maximum
-    if (self.allEvents.count > self.maxEventsInMemory) {
-        [self.allEvents removeObjectAtIndex:0];
+    // One seek through the feed's open DVR ring, so the event leads straight
+    // to its video. Set before the event is stored or anyone is told about
+    // it, and never waits on the proxy's queue.
+    if (!event.recording && event.feedURL) {
+        event.recording = [[RTSPFFmpegProxy sharedProxy] dvrPositionForURL:event.feedURL
+                                                                      time:event.timestamp ?: [NSDate date]];
     }
 
+    dispatch_async(self.storeQueue, ^{
+        if (!self->_store) {
+            return;
+        }
+        [self appendEvent:event];
+        [self scheduleCommit];
+    });
+
     // Notify delegate
     if ([self.delegate respondsToSelector:@selector(eventLogger:didLogEvent:)]) {
         [self.delegate eventLogger:self didLogEvent:event];
     }
 
-    // Auto-save periodically
-    if (self.allEvents.count % 10 == 0) {
-        [self saveEvents];
+    NSLog(@"[Events] %@: %@", [RTSPEventLogger nameForEventType:event.type], event.title);
+}
+
+/// Group commit: a burst of events costs one write per file (storeQueue)
+- (void)scheduleCommit {
+    if (RTSPEventStorePendingCount(_store) >= RTSPEventLoggerCommitBatch) {
+        [self commitPendingEvents];
+        return;
+    }
+    if (self.commitScheduled) {
+        return;
     }
+    self.commitScheduled = YES;
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(RTSPEventLoggerCommitDelay * NSEC_PER_SEC)), self.storeQueue, ^{
+        [self commitPendingEvents];
+    });
+}
 
-    NSLog(@"[Events] %@: %@", [RTSPEventLogger nameForEventType:event.type], event.title);
+- (BOOL)commitPendingEvents {
+    self.commitScheduled = NO;
+    if (!_store) {
+        return NO;
+    }
+    if (RTSPEventStoreCommit(_store) < 0) {
+        NSLog(@"[Events] Failed to commit events: %s", strerror(errno));
+        return NO;
+    }
+    return YES;
 }
 
 - (void)logEventType:(RTSPEventType)type title:(NSString *)title details:(NSString *)details feedURL:(NSURL *)feedURL {
@@ -113,144 +332,235 @@
     [self logEvent:event];
 }
 
+#pragma mark - Queries
+
+/// Store cursor for a query (nil = every event). Call on storeQueue.
+- (RTSPEventStoreCursorRef)createStoreCursorForQuery:(nullable RTSPEventQuery *)query {
+    RTSPEventStoreQuery storeQuery;
+    RTSPEventStoreQueryInit(&storeQuery);
+    [query.types enumerateIndexesUsingBlock:^(NSUInteger type, BOOL *stop) {
+        if (type < 64) {
+            storeQuery.types |= 1ull << type;
+        }
+    }];
+    if (query.types && storeQuery.types == 0) {
+        storeQuery.types = 1ull << 63;     // Only unknown types asked for: nothing matches
+    }
+    storeQuery.feed = query.feedURL.absoluteString.UTF8String;
+    if (query.fromDate || query.toDate) {
+        storeQuery.hasTimeRange = YES;
+        storeQuery.from = query.fromDate ? (int64_t)llround(query.fromDate.timeIntervalSince1970 * 1e6) : INT64_MIN;
+        storeQuery.to = query.toDate ? (int64_t)llround(query.toDate.timeIntervalSince1970 * 1e6) : INT64_MAX;
+    }
+    storeQuery.text = query.text.UTF8String;
+    storeQuery.textLength = storeQuery.text ? strlen(storeQuery.text) : 0;
+    storeQuery.newestFirst = query.newestFirst;
+    return RTSPEventStoreCursorCreate(_store, &storeQuery);
+}
+
+- (RTSPEventCursor *)cursorForQuery:(RTSPEventQuery *)query {
+    __block RTSPEventStoreCursorRef cursor = NULL;
+    dispatch_sync(self.storeQueue, ^{
+        if (self->_store) {
+            cursor = [self createStoreCursorForQuery:query];
+        }
+    });
+    return [[RTSPEventCursor alloc] initWithLogger:self cursor:cursor];
+}
+
+/// The newest `maxEventsInMemory` matches, oldest first
+- (NSArray<RTSPEvent *> *)recentEventsForQuery:(RTSPEventQuery *)query {
+    query.newestFirst = YES;
+    NSArray<RTSPEvent *> *page = [[self cursorForQuery:query] nextPageWithSize:(NSUInteger)MAX(self.maxEventsInMemory, 0)];
+    return page.reverseObjectEnumerator.allObjects;
+}
+
 - (NSArray<RTSPEvent *> *)eventsWithType:(RTSPEventType)type {
-    return [self.allEvents filteredArrayUsingPredicate:[NSPredicate predicateWithBlock:^BOOL(RTSPEvent *event, NSDictionary *bindings) {
-        return event.type == type;
-    }]];
+    RTSPEventQuery *query = [[RTSPEventQuery alloc] init];
+    query.types = [NSIndexSet indexSetWithIndex:(NSUInteger)type];
+    return [self recentEventsForQuery:query];
 }
 
 - (NSArray<RTSPEvent *> *)eventsFromDate:(NSDate *)startDate toDate:(NSDate *)endDate {
-    return [self.allEvents filteredArrayUsingPredicate:[NSPredicate predicateWithBlock:^BOOL(RTSPEvent *event, NSDictionary *bindings) {
-        return [event.timestamp compare:startDate] != NSOrderedAscending && [event.timestamp compare:endDate] != NSOrderedDescending;
-    }]];
+    RTSPEventQuery *query = [[RTSPEventQuery alloc] init];
+    query.fromDate = startDate;
+    query.toDate = endDate;
+    return [self recentEventsForQuery:query];
 }
 
 - (NSArray<RTSPEvent *> *)eventsForFeedURL:(NSURL *)feedURL {
-    return [self.allEvents filteredArrayUsingPredicate:[NSPredicate predicateWithBlock:^BOOL(RTSPEvent *event, NSDictionary *bindings) {
-        return event.feedURL && [event.feedURL.absoluteString isEqualToString:feedURL.absoluteString];
-    }]];
+    RTSPEventQuery *query = [[RTSPEventQuery alloc] init];
+    query.feedURL = feedURL;
+    return [self recentEventsForQuery:query];
 }
 
-- (NSArray<RTSPEvent *> *)searchEventsWithQuery:(NSString *)query {
-    NSString *lowerQuery = [query lowercaseString];
+- (NSArray<RTSPEvent *> *)searchEventsWithQuery:(NSString *)text {
+    RTSPEventQuery *query = [[RTSPEventQuery alloc] init];
+    query.text = text;
+    return [self recentEventsForQuery:query];
+}
 
-    return [self.allEvents filteredArrayUsingPredicate:[NSPredicate predicateWithBlock:^BOOL(RTSPEvent *event, NSDictionary *bindings) {
-        NSString *title = [event.title lowercaseString];
-        NSString *details = [event.details lowercaseString];
+#pragma mark - Thumbnails
 
-        return [title containsString:lowerQuery] || [details containsString:lowerQuery];
-    }]];
+- (nullable NSImage *)thumbnailForEvent:(RTSPEvent *)event {
+    if (event.thumbnail || !event.recording || !event.feedURL) {
+        return event.thumbnail;
+    }
+    CGImageRef image = [[RTSPFFmpegProxy sharedProxy] copyDVRThumbnailForURL:event.feedURL position:event.recording];
+    if (!image) {
+        return nil;
+    }
+    event.thumbnail = [[NSImage alloc] initWithCGImage:image size:NSZeroSize];
+    CGImageRelease(image);
+    return event.thumbnail;
 }
 
+#pragma mark - Maintenance
+
 - (void)clearAllEvents {
-    [self.allEvents removeAllObjects];
-    [self saveEvents];
+    dispatch_sync(self.storeQueue, ^{
+        if (self->_store && !RTSPEventStoreClear(self->_store)) {
+            NSLog(@"[Events] Failed to clear events: %s", strerror(errno));
+        }
+    });
 
     NSLog(@"[Events] Cleared all events");
 }
 
 - (void)clearEventsBeforeDate:(NSDate *)date {
-    NSArray *eventsToKeep = [self.allEvents filteredArrayUsingPredicate:[NSPredicate predicateWithBlock:^BOOL(RTSPEvent *event, NSDictionary *bindings) {
-        return [event.timestamp compare:date] != NSOrderedAscending;
-    }]];
-
-    self.allEvents = [NSMutableArray arrayWithArray:eventsToKeep];
-    [self saveEvents];
+    dispatch_sync(self.storeQueue, ^{
+        if (self->_store && !RTSPEventStoreTrimBefore(self->_store, (int64_t)llround(date.timeIntervalSince1970 * 1e6))) {
+            NSLog(@"[Events] Failed to trim events: %s", strerror(errno));
+        }
+    });
 
     NSLog(@"[Events] Cleared events before %@", date);
 }
 
-- (BOOL)exportToCSV:(NSString *)filePath {
-    NSMutableString *csv = [NSMutableString string];
-
-    // Header
-    [csv appendString:@"Timestamp,Type,Title,Details,Feed URL\n"];
-
-    // Data
-    NSDateFormatter *formatter = [[NSDateFormatter alloc] init];
-    formatter.dateFormat = @"yyyy-MM-dd HH:mm:ss";
+#pragma mark - Export
 
-    for (RTSPEvent *event in self.allEvents) {
-        NSString *timestamp = [formatter stringFromDate:event.timestamp];
-        NSString *type = [RTSPEventLogger nameForEventType:event.type];
-        NSString *title = [event.title stringByReplacingOccurrencesOfString:@"\"" withString:@"\"\""];
-        NSString *details = event.details ? [event.details stringByReplacingOccurrencesOfString:@"\"" withString:@"\"\""] : @"";
-        NSString *feedURL = event.feedURL ? event.feedURL.absoluteString : @"";
+/// Type display names as C strings, indexed by RTSPEventType
+static const char *const *RTSPEventExportTypeNames(size_t *count) {
+    static const char *names[RTSPEventTypeInfo + 1];
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        for (NSInteger type = 0; type <= RTSPEventTypeInfo; type++) {
+            names[type] = strdup([RTSPEventLogger nameForEventType:(RTSPEventType)type].UTF8String);
+        }
+    });
+    *count = RTSPEventTypeInfo + 1;
+    return names;
+}
 
-        [csv appendFormat:@"\"%@\",\"%@\",\"%@\",\"%@\",\"%@\"\n", timestamp, type, title, details, feedURL];
+/// Stream matching events to a temporary file in slices, then move it into
+/// place. Memory stays at one chunk buffer however many events there are.
+- (BOOL)exportEventsMatchingQuery:(nullable RTSPEventQuery *)query
+                           format:(RTSPEventExportFormat)format
+                           toFile:(NSString *)filePath {
+    NSString *temporaryPath = [filePath stringByAppendingPathExtension:@"partial"];
+    int fd = open(temporaryPath.fileSystemRepresentation, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        NSLog(@"[Events] Failed to create export file %@: %s", temporaryPath, strerror(errno));
+        return NO;
     }
 
-    NSError *error = nil;
-    BOOL success = [csv writeToFile:filePath atomically:YES encoding:NSUTF8StringEncoding error:&error];
-
-    if (success) {
-        NSLog(@"[Events] Exported events to CSV: %@", filePath);
-    } else {
-        NSLog(@"[Events] Failed to export CSV: %@", error);
+    RTSPEventExportConfig config;
+    RTSPEventExportConfigInit(&config);
+    config.format = format;
+    config.typeNames = RTSPEventExportTypeNames(&config.typeNameCount);
+    RTSPEventExporterRef exporter = RTSPEventExporterCreate(fd, &config);
+
+    __block RTSPEventStoreCursorRef cursor = NULL;
+    __block BOOL finished = NO;
+    __block BOOL success = exporter != NULL;
+    __block int error = 0;
+    while (success && !finished) {
+        dispatch_sync(self.storeQueue, ^{
+            if (!self->_store) {
+                success = NO;
+                error = ENOENT;
+                return;
+            }
+            if (!cursor) {
+                cursor = [self createStoreCursorForQuery:query];
+                if (format == RTSPEventExportFormatText) {
+                    NSMutableString *preamble = [NSMutableString string];
+                    [preamble appendString:@"RTSP Rotator Event Timeline\n"];
+                    [preamble appendFormat:@"Generated: %@\n\n", [NSDate date]];
+                    if (!query) {
+                        [preamble appendFormat:@"Total Events: %llu\n\n", (unsigned long long)RTSPEventStoreCount(self->_store)];
+                    }
+                    [preamble appendString:@"================================================================================\n\n"];
+                    const char *text = preamble.UTF8String;
+                    RTSPEventExporterWriteText(exporter, text, strlen(text));
+                }
+            }
+            if (!cursor || RTSPEventExporterWrite(exporter, self->_store, cursor, kExportSliceEvents) < 0) {
+                success = NO;
+                error = errno;
+                return;
+            }
+            finished = RTSPEventStoreCursorExhausted(cursor);
+        });
     }
 
-    return success;
-}
-
-- (BOOL)exportToPDF:(NSString *)filePath {
-    // Simplified PDF export (production would use PDFKit or NSPrintOperation)
-    NSMutableString *text = [NSMutableString string];
-
-    [text appendString:@"RTSP Rotator Event Timeline\n"];
-    [text appendFormat:@"Generated: %@\n\n", [NSDate date]];
-    [text appendFormat:@"Total Events: %lu\n\n", (unsigned long)self.allEvents.count];
-    [text appendString:@"================================================================================\n\n"];
-
-    NSDateFormatter *formatter = [[NSDateFormatter alloc] init];
-    formatter.dateFormat = @"yyyy-MM-dd HH:mm:ss";
-
-    for (RTSPEvent *event in self.allEvents) {
-        [text appendFormat:@"[%@] %@\n", [formatter stringFromDate:event.timestamp], [RTSPEventLogger nameForEventType:event.type]];
-        [text appendFormat:@"Title: %@\n", event.title];
-
-        if (event.details) {
-            [text appendFormat:@"Details: %@\n", event.details];
-        }
-
-        if (event.feedURL) {
-            [text appendFormat:@"Feed: %@\n", event.feedURL.absoluteString];
-        }
-
-        [text appendString:@"\n"];
+    if (success && !RTSPEventExporterFlush(exporter)) {
+        success = NO;
+        error = errno;
     }
-
-    NSError *error = nil;
-    BOOL success = [text writeToFile:filePath atomically:YES encoding:NSUTF8StringEncoding error:&error];
-
-    if (success) {
-        NSLog(@"[Events] Exported events to PDF: %@", filePath);
-    } else {
-        NSLog(@"[Events] Failed to export PDF: %@", error);
+    uint64_t exported = exporter ? RTSPEventExporterGetStatistics(exporter).events : 0;
+    RTSPEventExporterRelease(exporter);
+    if (cursor) {
+        dispatch_sync(self.storeQueue, ^{
+            RTSPEventStoreCursorRelease(cursor);
+        });
+    }
+    if (close(fd) != 0 && success) {
+        success = NO;
+        error = errno;
+    }
+    if (success && rename(temporaryPath.fileSystemRepresentation, filePath.fileSystemRepresentation) != 0) {
+        success = NO;
+        error = errno;
+    }
+    if (!success) {
+        unlink(temporaryPath.fileSystemRepresentation);
+        NSLog(@"[Events] Failed to export events to %@: %s", filePath, strerror(error));
+        return NO;
     }
 
-    return success;
+    NSLog(@"[Events] Exported %llu events to %@", (unsigned long long)exported, filePath);
+    return YES;
 }
 
-- (BOOL)saveEvents {
-    NSString *appSupport = [NSSearchPathForDirectoriesInDomains(NSApplicationSupportDirectory, NSUserDomainMask, YES) firstObject];
-    NSString *appFolder = [appSupport stringByAppendingPathComponent:@"RTSP Rotator"];
+- (BOOL)exportToCSV:(NSString *)filePath {
+    return [self exportEventsMatchingQuery:nil toCSV:filePath];
+}
 
-    NSFileManager *fm = [NSFileManager defaultManager];
-    if (![fm fileExistsAtPath:appFolder]) {
-        [fm createDirectoryAtPath:appFolder withIntermediateDirectories:YES attributes:nil error:nil];
-    }
+- (BOOL)exportToNDJSON:(NSString *)filePath {
+    return [self exportEventsMatchingQuery:nil toNDJSON:filePath];
+}
 
-    NSString *eventsPath = [appFolder stringByAppendingPathComponent:@"events.dat"];
+- (BOOL)exportEventsMatchingQuery:(RTSPEventQuery *)query toCSV:(NSString *)filePath {
+    return [self exportEventsMatchingQuery:query format:RTSPEventExportFormatCSV toFile:filePath];
+}
 
-    NSError *error = nil;
-    NSData *archiveData = [NSKeyedArchiver archivedDataWithRootObject:self.allEvents requiringSecureCoding:YES error:&error];
+- (BOOL)exportEventsMatchingQuery:(RTSPEventQuery *)query toNDJSON:(NSString *)filePath {
+    return [self exportEventsMatchingQuery:query format:RTSPEventExportFormatNDJSON toFile:filePath];
+}
 
-    if (error) {
-        NSLog(@"[Events] Failed to archive events: %@", error);
-        return NO;
-    }
+- (BOOL)exportToPDF:(NSString *)filePath {
+    // Simplified PDF export (production would use PDFKit or NSPrintOperation)
+    return [self exportEventsMatchingQuery:nil format:RTSPEventExportFormatText toFile:filePath];
+}
 
-    BOOL success = [archiveData writeToFile:eventsPath atomically:YES];
+#pragma mark - Persistence
+
+- (BOOL)saveEvents {
+    __block BOOL success = NO;
+    dispatch_sync(self.storeQueue, ^{
+        success = [self commitPendingEvents];
+    });
 
     if (!success) {
         NSLog(@"[Events] Failed to save events to disk");
@@ -260,31 +570,76 @@
 }
 
 - (BOOL)loadEvents {
+    __block BOOL success = NO;
+    dispatch_sync(self.storeQueue, ^{
+        if (self->_store) {
+            success = YES;
+            return;
+        }
+        NSString *directory = self.directory;
+        [[NSFileManager defaultManager] createDirectoryAtPath:directory withIntermediateDirectories:YES attributes:nil error:nil];
+
+        RTSPEventStoreConfig config;
+        RTSPEventStoreConfigInit(&config);
+        config.maxEvents = (uint64_t)self->_maxStoredEvents;
+        self->_store = RTSPEventStoreOpen(directory.fileSystemRepresentation, &config);
+        if (!self->_store) {
+            NSLog(@"[Events] Failed to open event store at %@: %s", directory,
+                  errno == EWOULDBLOCK ? "already open in another logger or process" : strerror(errno));
+            return;
+        }
+        if ([directory isEqualToString:[RTSPEventLogger storeDirectory]]) {
+            [self migrateLegacyArchive];
+        }
+
+        RTSPEventStoreStatistics statistics = RTSPEventStoreGetStatistics(self->_store);
+        if (statistics.recoveredTornRecords > 0) {
+            NSLog(@"[Events] Discarded %llu incomplete event(s) from an interrupted write",
+                  (unsigned long long)statistics.recoveredTornRecords);
+        }
+        NSLog(@"[Events] Loaded %llu events from disk", (unsigned long long)statistics.events);
+        success = YES;
+    });
+    return success;
+}
+
+/// Move events from the keyed archive the logger used to rewrite in full
+/// into the store, once (storeQueue)
+- (void)migrateLegacyArchive {
     NSString *appSupport = [NSSearchPathForDirectoriesInDomains(NSApplicationSupportDirectory, NSUserDomainMask, YES) firstObject];
     NSString *eventsPath = [[appSupport stringByAppendingPathComponent:@"RTSP Rotator"] stringByAppendingPathComponent:@"events.dat"];
 
-    if (![[NSFileManager defaultManager] fileExistsAtPath:eventsPath]) {
-        NSLog(@"[Events] No saved events found");
-        return NO;
+    NSFileManager *fm = [NSFileManager defaultManager];
+    if (![fm fileExistsAtPath:eventsPath]) {
+        return;
     }
 
     NSError *error = nil;
     NSData *archiveData = [NSData dataWithContentsOfFile:eventsPath];
-
     NSSet *classes = [NSSet setWithArray:@[[NSArray class], [RTSPEvent class], [NSString class], [NSDate class], [NSURL class], [NSDictionary class]]];
-    NSArray *loadedEvents = [NSKeyedUnarchiver unarchivedObjectOfClasses:classes fromData:archiveData error:&error];
+    NSArray *loadedEvents = archiveData ? [NSKeyedUnarchiver unarchivedObjectOfClasses:classes fromData:archiveData error:&error] : nil;
 
-    if (error) {
-        NSLog(@"[Events] Failed to unarchive events: %@", error);
-        return NO;
+    if (!loadedEvents) {
+        NSLog(@"[Events] Failed to unarchive legacy events: %@", error);
+    } else {
+        for (RTSPEvent *event in loadedEvents) {
+            if ([event isKindOfClass:[RTSPEvent class]]) {
+                [self appendEvent:event];
+            }
+        }
+        if (![self commitPendingEvents]) {
+            return;
+        }
+        NSLog(@"[Events] Migrated %lu events from events.dat", (unsigned long)loadedEvents.count);
     }
 
-    self.allEvents = [NSMutableArray arrayWithArray:loadedEvents];
-
-    NSLog(@"[Events] Loaded %lu events from disk", (unsigned long)self.allEvents.count);
-    return YES;
+    NSString *migratedPath = [eventsPath stringByAppendingPathExtension:@"migrated"];
+    [fm removeItemAtPath:migratedPath error:nil];
+    [fm moveItemAtPath:eventsPath toPath:migratedPath error:nil];
 }
 
+#pragma mark - Display
+
 + (NSString *)nameForEventType:(RTSPEventType)type {
     switch (type) {
         case RTSPEventTypeFeedSwitch: return @"Feed Switch";
@@ -0,0 +1,1187 @@
+//
+//  RTSPEventStore.c
+//  RTSP Rotator
+//
+
+#include "RTSPEventStore.h"
+#include "RTSPByteBuffer.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define RTSP_EVENT_STORE_MAGIC "RTSPEVT1"
+#define RTSP_EVENT_STORE_META_MAGIC "RTSPEVM1"
+#define RTSP_EVENT_STORE_VERSION 1
+#define RTSP_EVENT_STORE_HEADER_SIZE 64
+#define RTSP_EVENT_STORE_TEXT_RESERVE 256       // Text heap address space reserved per record slot
+#define RTSP_EVENT_STORE_MAX_FEED 4096
+
+// Records are written in host byte order: little-endian on every supported Mac
+_Static_assert(sizeof(RTSPEventStoreRecord) == RTSP_EVENT_STORE_RECORD_SIZE, "record layout");
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    uint32_t capacity;
+    uint32_t reserved0;
+    uint64_t firstSequence;
+    uint8_t reserved[32];
+} RTSPEventSegmentHeader;
+
+_Static_assert(sizeof(RTSPEventSegmentHeader) == RTSP_EVENT_STORE_HEADER_SIZE, "header layout");
+
+/// Survives clearing and trimming, which can leave no record to derive it from
+typedef struct {
+    char magic[8];
+    int64_t floor;
+    uint64_t nextSequence;
+} RTSPEventStoreMeta;
+
+typedef struct {
+    uint64_t number;
+    uint64_t firstSequence;
+    uint32_t capacity;
+    uint32_t count;                 // Committed records
+    int fd;
+    int textFd;
+    uint8_t *map;                   // Whole segment file, read-only
+    size_t mapLength;
+    uint8_t *textMap;               // Text heap; reserved beyond its current size
+    size_t textMapLength;
+    uint64_t textSize;              // Committed text bytes
+    int64_t minTimestamp;
+    int64_t maxTimestamp;
+} RTSPEventSegment;
+
+typedef struct {
+    uint64_t *items;
+    size_t count;
+    size_t capacity;
+} RTSPEventPostings;
+
+struct RTSPEventStore {
+    char *directory;
+    int lockFd;                     // Exclusive flock on events.lock while open
+    RTSPEventStoreConfig config;
+    int64_t floor;                  // Events before this are trimmed
+    uint64_t nextSequence;
+    uint64_t lastSegmentNumber;     // Segment numbers are never reused
+
+    RTSPEventSegment *segments;
+    uint32_t segmentCount;
+    uint32_t segmentCapacity;
+
+    // Pending events, all in the last segment
+    RTSPByteBuffer pendingRecords;
+    RTSPByteBuffer pendingText;
+    uint32_t pendingCount;
+
+    // Feed table: feeds[id - 1], hashed for interning
+    int feedsFd;
+    char **feeds;
+    uint32_t feedCount;
+    uint32_t feedCapacity;
+    uint32_t *feedSlots;
+    uint32_t feedSlotCount;         // Power of two
+    RTSPByteBuffer pendingFeeds;
+
+    // Indexes
+    RTSPEventStoreTimeEntry *time;
+    size_t timeCount;
+    size_t timeCapacity;
+    RTSPEventPostings *types;
+    uint32_t typeCount;
+    RTSPEventPostings *feedPostings;
+    uint32_t feedPostingCount;
+    RTSPEventTextIndexRef text;     // Built on first search
+
+    RTSPEventStoreStatistics statistics;
+};
+
+#pragma mark - CRC-32
+
+static uint32_t RTSPEventStoreCRCTable[256];
+static pthread_once_t RTSPEventStoreCRCOnce = PTHREAD_ONCE_INIT;
+
+static void RTSPEventStoreCRCInit(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        RTSPEventStoreCRCTable[i] = c;
+    }
+}
+
+static uint32_t RTSPEventStoreRecordCRC(const RTSPEventStoreRecord *record) {
+    const uint8_t *bytes = (const uint8_t *)record + sizeof(record->crc);
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < sizeof(*record) - sizeof(record->crc); i++) {
+        crc = RTSPEventStoreCRCTable[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    }
+    // Never 0, so an all-zero slot is never a valid record
+    return ~crc ? ~crc : 1;
+}
+
+#pragma mark - Files
+
+static bool RTSPEventStoreWriteAll(int fd, const void *data, size_t length, off_t offset) {
+    const uint8_t *bytes = data;
+    while (length > 0) {
+        ssize_t written = offset >= 0 ? pwrite(fd, bytes, length, offset) : write(fd, bytes, length);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        bytes += written;
+        length -= (size_t)written;
+        if (offset >= 0) {
+            offset += written;
+        }
+    }
+    return true;
+}
+
+static char *RTSPEventStorePath(RTSPEventStoreRef store, const char *name) {
+    size_t length = strlen(store->directory) + strlen(name) + 2;
+    char *path = malloc(length);
+    if (path) {
+        snprintf(path, length, "%s/%s", store->directory, name);
+    }
+    return path;
+}
+
+static char *RTSPEventStoreSegmentPath(RTSPEventStoreRef store, uint64_t number, const char *extension) {
+    char name[64];
+    snprintf(name, sizeof(name), "events-%08llu.%s", (unsigned long long)number, extension);
+    return RTSPEventStorePath(store, name);
+}
+
+static bool RTSPEventStoreWriteMeta(RTSPEventStoreRef store) {
+    RTSPEventStoreMeta meta;
+    memset(&meta, 0, sizeof(meta));
+    memcpy(meta.magic, RTSP_EVENT_STORE_META_MAGIC, sizeof(meta.magic));
+    meta.floor = store->floor;
+    meta.nextSequence = store->nextSequence;
+
+    char *path = RTSPEventStorePath(store, "events.meta");
+    char *temporary = RTSPEventStorePath(store, "events.meta.tmp");
+    bool ok = false;
+    if (path && temporary) {
+        int fd = open(temporary, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd >= 0) {
+            ok = RTSPEventStoreWriteAll(fd, &meta, sizeof(meta), 0) && (!store->config.syncOnCommit || fsync(fd) == 0);
+            close(fd);
+            ok = ok && rename(temporary, path) == 0;
+        }
+    }
+    free(path);
+    free(temporary);
+    return ok;
+}
+
+static void RTSPEventStoreReadMeta(RTSPEventStoreRef store) {
+    char *path = RTSPEventStorePath(store, "events.meta");
+    int fd = path ? open(path, O_RDONLY) : -1;
+    free(path);
+    if (fd < 0) {
+        return;
+    }
+    RTSPEventStoreMeta meta;
+    if (pread(fd, &meta, sizeof(meta), 0) == (ssize_t)sizeof(meta) &&
+        memcmp(meta.magic, RTSP_EVENT_STORE_META_MAGIC, sizeof(meta.magic)) == 0) {
+        store->floor = meta.floor;
+        if (meta.nextSequence > store->nextSequence) {
+            store->nextSequence = meta.nextSequence;
+        }
+    }
+    close(fd);
+}
+
+/// One writer per directory: a second open, from this process or another,
+/// would append interleaved records and trim segments under the first
+static bool RTSPEventStoreLock(RTSPEventStoreRef store) {
+    char *path = RTSPEventStorePath(store, "events.lock");
+    store->lockFd = path ? open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644) : -1;
+    free(path);
+    if (store->lockFd < 0) {
+        return false;
+    }
+    if (flock(store->lockFd, LOCK_EX | LOCK_NB) != 0) {
+        int error = errno;
+        close(store->lockFd);
+        store->lockFd = -1;
+        errno = error;
+        return false;
+    }
+    return true;
+}
+
+#pragma mark - Feeds
+
+static uint32_t RTSPEventStoreHash(const char *string, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ (uint8_t)string[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static bool RTSPEventStoreFeedSlotsGrow(RTSPEventStoreRef store) {
+    uint32_t slotCount = store->feedSlotCount ? store->feedSlotCount * 2 : 64;
+    uint32_t *slots = calloc(slotCount, sizeof(*slots));
+    if (!slots) {
+        return false;
+    }
+    for (uint32_t id = 1; id <= store->feedCount; id++) {
+        const char *feed = store->feeds[id - 1];
+        uint32_t slot = RTSPEventStoreHash(feed, strlen(feed)) & (slotCount - 1);
+        while (slots[slot]) {
+            slot = (slot + 1) & (slotCount - 1);
+        }
+        slots[slot] = id;
+    }
+    free(store->feedSlots);
+    store->feedSlots = slots;
+    store->feedSlotCount = slotCount;
+    return true;
+}
+
+static uint32_t RTSPEventStoreFindFeed(RTSPEventStoreRef store, const char *feed, size_t length, uint32_t *emptySlot) {
+    if (store->feedSlotCount == 0) {
+        return 0;
+    }
+    uint32_t slot = RTSPEventStoreHash(feed, length) & (store->feedSlotCount - 1);
+    while (store->feedSlots[slot]) {
+        const char *candidate = store->feeds[store->feedSlots[slot] - 1];
+        if (strncmp(candidate, feed, length) == 0 && candidate[length] == '\0') {
+            return store->feedSlots[slot];
+        }
+        slot = (slot + 1) & (store->feedSlotCount - 1);
+    }
+    if (emptySlot) {
+        *emptySlot = slot;
+    }
+    return 0;
+}
+
+/// Add a feed to the in-memory table; returns its ID, 0 on failure
+static uint32_t RTSPEventStoreAddFeed(RTSPEventStoreRef store, const char *feed, size_t length) {
+    if ((store->feedCount + 1) * 2 > store->feedSlotCount && !RTSPEventStoreFeedSlotsGrow(store)) {
+        return 0;
+    }
+    if (store->feedCount == store->feedCapacity) {
+        uint32_t capacity = store->feedCapacity ? store->feedCapacity * 2 : 16;
+        char **feeds = realloc(store->feeds, capacity * sizeof(*feeds));
+        if (!feeds) {
+            return 0;
+        }
+        store->feeds = feeds;
+        store->feedCapacity = capacity;
+    }
+    char *copy = malloc(length + 1);
+    if (!copy) {
+        return 0;
+    }
+    memcpy(copy, feed, length);
+    copy[length] = '\0';
+
+    uint32_t slot = 0;
+    uint32_t existing = RTSPEventStoreFindFeed(store, copy, length, &slot);
+    if (existing) {
+        free(copy);
+        return existing;
+    }
+    store->feeds[store->feedCount++] = copy;
+    store->feedSlots[slot] = store->feedCount;
+    return store->feedCount;
+}
+
+static uint32_t RTSPEventStoreInternFeed(RTSPEventStoreRef store, const char *feed) {
+    size_t length = strnlen(feed, RTSP_EVENT_STORE_MAX_FEED);
+    uint32_t id = RTSPEventStoreFindFeed(store, feed, length, NULL);
+    if (id) {
+        return id;
+    }
+    id = RTSPEventStoreAddFeed(store, feed, length);
+    if (id) {
+        uint32_t prefix = (uint32_t)length;
+        RTSPByteBufferAppend(&store->pendingFeeds, &prefix, sizeof(prefix));
+        RTSPByteBufferAppend(&store->pendingFeeds, feed, length);
+    }
+    return id;
+}
+
+/// feeds.dat: length-prefixed URLs in ID order. A torn tail is cut off.
+static bool RTSPEventStoreLoadFeeds(RTSPEventStoreRef store) {
+    char *path = RTSPEventStorePath(store, "feeds.dat");
+    store->feedsFd = path ? open(path, O_RDWR | O_CREAT | O_APPEND, 0644) : -1;
+    free(path);
+    if (store->feedsFd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(store->feedsFd, &info) != 0) {
+        return false;
+    }
+    if (info.st_size == 0) {
+        return true;
+    }
+    uint8_t *data = malloc((size_t)info.st_size);
+    if (!data || pread(store->feedsFd, data, (size_t)info.st_size, 0) != info.st_size) {
+        free(data);
+        return false;
+    }
+    size_t offset = 0;
+    while (offset + sizeof(uint32_t) <= (size_t)info.st_size) {
+        uint32_t length;
+        memcpy(&length, data + offset, sizeof(length));
+        if (length > RTSP_EVENT_STORE_MAX_FEED || offset + sizeof(length) + length > (size_t)info.st_size) {
+            break;
+        }
+        if (!RTSPEventStoreAddFeed(store, (const char *)data + offset + sizeof(length), length)) {
+            free(data);
+            return false;
+        }
+        offset += sizeof(length) + length;
+    }
+    free(data);
+    if (offset < (size_t)info.st_size && ftruncate(store->feedsFd, (off_t)offset) != 0) {
+        return false;
+    }
+    return true;
+}
+
+#pragma mark - Segments
+
+static void RTSPEventSegmentClose(RTSPEventSegment *segment) {
+    if (segment->map) {
+        munmap(segment->map, segment->mapLength);
+    }
+    if (segment->textMap) {
+        munmap(segment->textMap, segment->textMapLength);
+    }
+    if (segment->fd >= 0) {
+        close(segment->fd);
+    }
+    if (segment->textFd >= 0) {
+        close(segment->textFd);
+    }
+    segment->map = NULL;
+    segment->textMap = NULL;
+    segment->fd = -1;
+    segment->textFd = -1;
+}
+
+/// Map the text heap with room to grow; remapped only when it outgrows that
+static bool RTSPEventSegmentMapText(RTSPEventSegment *segment, uint64_t needed) {
+    if (segment->textMap && needed <= segment->textMapLength) {
+        return true;
+    }
+    size_t length = (size_t)segment->capacity * RTSP_EVENT_STORE_TEXT_RESERVE;
+    while (length < needed) {
+        length *= 2;
+    }
+    void *map = mmap(NULL, length, PROT_READ, MAP_SHARED, segment->textFd, 0);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    if (segment->textMap) {
+        munmap(segment->textMap, segment->textMapLength);
+    }
+    segment->textMap = map;
+    segment->textMapLength = length;
+    return true;
+}
+
+static bool RTSPEventStoreReserveSegment(RTSPEventStoreRef store) {
+    if (store->segmentCount < store->segmentCapacity) {
+        return true;
+    }
+    uint32_t capacity = store->segmentCapacity ? store->segmentCapacity * 2 : 8;
+    RTSPEventSegment *segments = realloc(store->segments, capacity * sizeof(*segments));
+    if (!segments) {
+        return false;
+    }
+    store->segments = segments;
+    store->segmentCapacity = capacity;
+    return true;
+}
+
+static bool RTSPEventSegmentOpenFiles(RTSPEventStoreRef store, RTSPEventSegment *segment, bool create) {
+    char *path = RTSPEventStoreSegmentPath(store, segment->number, "seg");
+    char *textPath = RTSPEventStoreSegmentPath(store, segment->number, "txt");
+    int flags = O_RDWR | (create ? O_CREAT | O_EXCL : 0);
+    if (path && textPath) {
+        segment->fd = open(path, flags, 0644);
+        segment->textFd = segment->fd >= 0 ? open(textPath, O_RDWR | O_CREAT, 0644) : -1;
+    }
+    free(path);
+    free(textPath);
+    return segment->fd >= 0 && segment->textFd >= 0;
+}
+
+/// Start a new, empty segment whose first record gets the next sequence number
+static RTSPEventSegment *RTSPEventStoreCreateSegment(RTSPEventStoreRef store) {
+    if (!RTSPEventStoreReserveSegment(store)) {
+        return NULL;
+    }
+    RTSPEventSegment segment = {
+        .number = store->lastSegmentNumber + 1,
+        .firstSequence = store->nextSequence,
+        .capacity = store->config.recordsPerSegment,
+        .fd = -1,
+        .textFd = -1,
+        .minTimestamp = INT64_MAX,
+        .maxTimestamp = INT64_MIN
+    };
+    RTSPEventSegmentHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, RTSP_EVENT_STORE_MAGIC, sizeof(header.magic));
+    header.version = RTSP_EVENT_STORE_VERSION;
+    header.recordSize = RTSP_EVENT_STORE_RECORD_SIZE;
+    header.capacity = segment.capacity;
+    header.firstSequence = segment.firstSequence;
+
+    // Preallocated (sparse) to full size so the mapping never changes
+    segment.mapLength = RTSP_EVENT_STORE_HEADER_SIZE + (size_t)segment.capacity * RTSP_EVENT_STORE_RECORD_SIZE;
+    if (!RTSPEventSegmentOpenFiles(store, &segment, true) ||
+        !RTSPEventStoreWriteAll(segment.fd, &header, sizeof(header), 0) ||
+        ftruncate(segment.fd, (off_t)segment.mapLength) != 0 || ftruncate(segment.textFd, 0) != 0) {
+        RTSPEventSegmentClose(&segment);
+        return NULL;
+    }
+    segment.map = mmap(NULL, segment.mapLength, PROT_READ, MAP_SHARED, segment.fd, 0);
+    if (segment.map == MAP_FAILED) {
+        segment.map = NULL;
+        RTSPEventSegmentClose(&segment);
+        return NULL;
+    }
+    if (!RTSPEventSegmentMapText(&segment, 0)) {
+        RTSPEventSegmentClose(&segment);
+        return NULL;
+    }
+    store->lastSegmentNumber = segment.number;
+    store->segments[store->segmentCount++] = segment;
+    return &store->segments[store->segmentCount - 1];
+}
+
+static const RTSPEventStoreRecord *RTSPEventSegmentRecord(const RTSPEventSegment *segment, uint32_t slot) {
+    return (const RTSPEventStoreRecord *)(segment->map + RTSP_EVENT_STORE_HEADER_SIZE + (size_t)slot * RTSP_EVENT_STORE_RECORD_SIZE);
+}
+
+/// Map an existing segment and find where its valid records end
+static bool RTSPEventStoreLoadSegment(RTSPEventStoreRef store, uint64_t number) {
+    if (!RTSPEventStoreReserveSegment(store)) {
+        return false;
+    }
+    RTSPEventSegment segment = {
+        .number = number,
+        .fd = -1,
+        .textFd = -1,
+        .minTimestamp = INT64_MAX,
+        .maxTimestamp = INT64_MIN
+    };
+    RTSPEventSegmentHeader header;
+    struct stat info, textInfo;
+    if (!RTSPEventSegmentOpenFiles(store, &segment, false) ||
+        pread(segment.fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+        memcmp(header.magic, RTSP_EVENT_STORE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != RTSP_EVENT_STORE_VERSION || header.recordSize != RTSP_EVENT_STORE_RECORD_SIZE ||
+        header.capacity == 0 || header.firstSequence == 0 ||
+        fstat(segment.fd, &info) != 0 || fstat(segment.textFd, &textInfo) != 0) {
+        RTSPEventSegmentClose(&segment);
+        return false;
+    }
+    segment.capacity = header.capacity;
+    segment.firstSequence = header.firstSequence;
+    segment.mapLength = RTSP_EVENT_STORE_HEADER_SIZE + (size_t)segment.capacity * RTSP_EVENT_STORE_RECORD_SIZE;
+    if ((size_t)info.st_size < segment.mapLength && ftruncate(segment.fd, (off_t)segment.mapLength) != 0) {
+        RTSPEventSegmentClose(&segment);
+        return false;
+    }
+    segment.map = mmap(NULL, segment.mapLength, PROT_READ, MAP_SHARED, segment.fd, 0);
+    if (segment.map == MAP_FAILED) {
+        segment.map = NULL;
+        RTSPEventSegmentClose(&segment);
+        return false;
+    }
+
+    uint64_t textFileSize = (uint64_t)textInfo.st_size;
+    uint64_t textEnd = 0;
+    uint32_t slot = 0;
+    bool torn = false;
+    for (; slot < segment.capacity; slot++) {
+        const RTSPEventStoreRecord *record = RTSPEventSegmentRecord(&segment, slot);
+        if (record->crc == 0 && record->sequence == 0) {
+            break;
+        }
+        uint64_t end = record->textOffset + record->titleLength + record->detailsLength + record->metadataLength;
+        if (record->crc != RTSPEventStoreRecordCRC(record) || record->sequence != segment.firstSequence + slot ||
+            end > textFileSize || record->feed > store->feedCount) {
+            torn = true;
+            break;
+        }
+        textEnd = end > textEnd ? end : textEnd;
+        segment.minTimestamp = record->timestamp < segment.minTimestamp ? record->timestamp : segment.minTimestamp;
+        segment.maxTimestamp = record->timestamp > segment.maxTimestamp ? record->timestamp : segment.maxTimestamp;
+    }
+    segment.count = slot;
+    segment.textSize = textEnd;
+
+    if (torn) {
+        // Zero everything after the last good record so stale slots can't
+        // come back to life once appends reach them
+        store->statistics.recoveredTornRecords++;
+        size_t keep = RTSP_EVENT_STORE_HEADER_SIZE + (size_t)slot * RTSP_EVENT_STORE_RECORD_SIZE;
+        if (ftruncate(segment.fd, (off_t)keep) != 0 || ftruncate(segment.fd, (off_t)segment.mapLength) != 0) {
+            RTSPEventSegmentClose(&segment);
+            return false;
+        }
+    }
+    if (textFileSize > textEnd && ftruncate(segment.textFd, (off_t)textEnd) != 0) {
+        RTSPEventSegmentClose(&segment);
+        return false;
+    }
+    if (!RTSPEventSegmentMapText(&segment, textEnd)) {
+        RTSPEventSegmentClose(&segment);
+        return false;
+    }
+    store->lastSegmentNumber = number;
+    store->segments[store->segmentCount++] = segment;
+    return true;
+}
+
+static int RTSPEventStoreCompareNumbers(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static bool RTSPEventStoreLoadSegments(RTSPEventStoreRef store) {
+    DIR *directory = opendir(store->directory);
+    if (!directory) {
+        return false;
+    }
+    uint64_t *numbers = NULL;
+    size_t count = 0, capacity = 0;
+    struct dirent *entry;
+    while ((entry = readdir(directory))) {
+        unsigned long long number;
+        char extension[8];
+        if (sscanf(entry->d_name, "events-%llu.%7s", &number, extension) != 2 || strcmp(extension, "seg") != 0) {
+            continue;
+        }
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            uint64_t *grown = realloc(numbers, capacity * sizeof(*numbers));
+            if (!grown) {
+                free(numbers);
+                closedir(directory);
+                return false;
+            }
+            numbers = grown;
+        }
+        numbers[count++] = number;
+    }
+    closedir(directory);
+    qsort(numbers, count, sizeof(*numbers), RTSPEventStoreCompareNumbers);
+
+    bool ok = true;
+    for (size_t i = 0; i < count && ok; i++) {
+        ok = RTSPEventStoreLoadSegment(store, numbers[i]);
+        if (ok && store->segmentCount > 1) {
+            // Segments must follow each other; a gap means damage, keep what precedes it
+            const RTSPEventSegment *previous = &store->segments[store->segmentCount - 2];
+            const RTSPEventSegment *last = &store->segments[store->segmentCount - 1];
+            if (last->firstSequence != previous->firstSequence + previous->count) {
+                RTSPEventSegmentClose(&store->segments[--store->segmentCount]);
+                break;
+            }
+        }
+    }
+    free(numbers);
+    return ok;
+}
+
+static void RTSPEventStoreDeleteSegmentFiles(RTSPEventStoreRef store, uint64_t number) {
+    char *path = RTSPEventStoreSegmentPath(store, number, "seg");
+    char *textPath = RTSPEventStoreSegmentPath(store, number, "txt");
+    if (path) {
+        unlink(path);
+    }
+    if (textPath) {
+        unlink(textPath);
+    }
+    free(path);
+    free(textPath);
+}
+
+/// Delete the oldest `count` segments
+static void RTSPEventStoreDropSegments(RTSPEventStoreRef store, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        RTSPEventSegmentClose(&store->segments[i]);
+        RTSPEventStoreDeleteSegmentFiles(store, store->segments[i].number);
+    }
+    memmove(store->segments, store->segments + count, (store->segmentCount - count) * sizeof(*store->segments));
+    store->segmentCount -= count;
+    store->statistics.droppedSegments += count;
+}
+
+static RTSPEventSegment *RTSPEventStoreSegmentFor(RTSPEventStoreRef store, uint64_t sequence) {
+    uint32_t low = 0, high = store->segmentCount;
+    while (low < high) {
+        uint32_t middle = (low + high) / 2;
+        if (store->segments[middle].firstSequence <= sequence) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low > 0 ? &store->segments[low - 1] : NULL;
+}
+
+#pragma mark - Indexes
+
+static bool RTSPEventPostingsAdd(RTSPEventPostings *postings, uint64_t sequence) {
+    if (postings->count == postings->capacity) {
+        size_t capacity = postings->capacity ? postings->capacity * 2 : 64;
+        uint64_t *items = realloc(postings->items, capacity * sizeof(*items));
+        if (!items) {
+            return false;
+        }
+        postings->items = items;
+        postings->capacity = capacity;
+    }
+    postings->items[postings->count++] = sequence;
+    return true;
+}
+
+static bool RTSPEventStoreGrowPostings(RTSPEventPostings **lists, uint32_t *count, uint32_t index) {
+    if (index < *count) {
+        return true;
+    }
+    uint32_t grown = index + 1 > *count * 2 ? index + 1 : *count * 2;
+    RTSPEventPostings *resized = realloc(*lists, grown * sizeof(*resized));
+    if (!resized) {
+        return false;
+    }
+    memset(resized + *count, 0, (grown - *count) * sizeof(*resized));
+    *lists = resized;
+    *count = grown;
+    return true;
+}
+
+static int RTSPEventStoreCompareTime(const void *a, const void *b) {
+    const RTSPEventStoreTimeEntry *x = a, *y = b;
+    if (x->timestamp != y->timestamp) {
+        return x->timestamp < y->timestamp ? -1 : 1;
+    }
+    return (x->sequence > y->sequence) - (x->sequence < y->sequence);
+}
+
+/// Add a visible record to every index. Appends come in sequence order, so
+/// postings stay sorted; the time index is kept sorted by insertion from the
+/// tail (events arrive nearly in time order) unless `sortLater` is set.
+static bool RTSPEventStoreIndexRecord(RTSPEventStoreRef store, const RTSPEventStoreRecord *record, bool sortLater) {
+    if (store->timeCount == store->timeCapacity) {
+        size_t capacity = store->timeCapacity ? store->timeCapacity * 2 : 1024;
+        RTSPEventStoreTimeEntry *time = realloc(store->time, capacity * sizeof(*time));
+        if (!time) {
+            return false;
+        }
+        store->time = time;
+        store->timeCapacity = capacity;
+    }
+    RTSPEventStoreTimeEntry entry = {record->timestamp, record->sequence};
+    size_t position = store->timeCount;
+    if (!sortLater) {
+        while (position > 0 && RTSPEventStoreCompareTime(&store->time[position - 1], &entry) > 0) {
+            position--;
+        }
+        memmove(store->time + position + 1, store->time + position, (store->timeCount - position) * sizeof(entry));
+    }
+    store->time[position] = entry;
+    store->timeCount++;
+
+    if (!RTSPEventStoreGrowPostings(&store->types, &store->typeCount, record->type) ||
+        !RTSPEventPostingsAdd(&store->types[record->type], record->sequence)) {
+        return false;
+    }
+    if (record->feed &&
+        (!RTSPEventStoreGrowPostings(&store->feedPostings, &store->feedPostingCount, record->feed) ||
+         !RTSPEventPostingsAdd(&store->feedPostings[record->feed], record->sequence))) {
+        return false;
+    }
+    return true;
+}
+
+static void RTSPEventStoreResetIndexes(RTSPEventStoreRef store) {
+    store->timeCount = 0;
+    for (uint32_t i = 0; i < store->typeCount; i++) {
+        store->types[i].count = 0;
+    }
+    for (uint32_t i = 0; i < store->feedPostingCount; i++) {
+        store->feedPostings[i].count = 0;
+    }
+}
+
+static bool RTSPEventStoreRebuildIndexes(RTSPEventStoreRef store) {
+    RTSPEventStoreResetIndexes(store);
+    bool sorted = true;
+    for (uint32_t s = 0; s < store->segmentCount; s++) {
+        const RTSPEventSegment *segment = &store->segments[s];
+        for (uint32_t slot = 0; slot < segment->count; slot++) {
+            const RTSPEventStoreRecord *record = RTSPEventSegmentRecord(segment, slot);
+            if (record->timestamp < store->floor) {
+                continue;
+            }
+            if (store->timeCount > 0 && store->time[store->timeCount - 1].timestamp > record->timestamp) {
+                sorted = false;
+            }
+            if (!RTSPEventStoreIndexRecord(store, record, true)) {
+                return false;
+            }
+        }
+    }
+    if (!sorted) {
+        qsort(store->time, store->timeCount, sizeof(*store->time), RTSPEventStoreCompareTime);
+    }
+    return true;
+}
+
+static void RTSPEventPostingsDropBefore(RTSPEventPostings *postings, uint64_t sequence) {
+    size_t low = 0, high = postings->count;
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+        if (postings->items[middle] < sequence) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    memmove(postings->items, postings->items + low, (postings->count - low) * sizeof(*postings->items));
+    postings->count -= low;
+}
+
+/// Forget index entries of dropped segments
+static void RTSPEventStoreUnindexBefore(RTSPEventStoreRef store, uint64_t sequence) {
+    size_t kept = 0;
+    for (size_t i = 0; i < store->timeCount; i++) {
+        if (store->time[i].sequence >= sequence) {
+            store->time[kept++] = store->time[i];
+        }
+    }
+    store->timeCount = kept;
+    for (uint32_t i = 0; i < store->typeCount; i++) {
+        RTSPEventPostingsDropBefore(&store->types[i], sequence);
+    }
+    for (uint32_t i = 0; i < store->feedPostingCount; i++) {
+        RTSPEventPostingsDropBefore(&store->feedPostings[i], sequence);
+    }
+}
+
+#pragma mark - Store
+
+void RTSPEventStoreConfigInit(RTSPEventStoreConfig *config) {
+    memset(config, 0, sizeof(*config));
+    config->recordsPerSegment = 65536;
+    config->maxEvents = 1000000;
+    config->syncOnCommit = true;
+}
+
+RTSPEventStoreRef RTSPEventStoreOpen(const char *directory, const RTSPEventStoreConfig *config) {
+    pthread_once(&RTSPEventStoreCRCOnce, RTSPEventStoreCRCInit);
+    if (!directory || !config || config->recordsPerSegment == 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (mkdir(directory, 0755) != 0 && errno != EEXIST) {
+        return NULL;
+    }
+    RTSPEventStoreRef store = calloc(1, sizeof(*store));
+    if (!store) {
+        return NULL;
+    }
+    store->directory = strdup(directory);
+    store->config = *config;
+    store->floor = INT64_MIN;
+    store->nextSequence = 1;
+    store->lockFd = -1;
+    store->feedsFd = -1;
+    RTSPByteBufferInit(&store->pendingRecords);
+    RTSPByteBufferInit(&store->pendingText);
+    RTSPByteBufferInit(&store->pendingFeeds);
+
+    int error = 0;
+    if (!store->directory || !RTSPEventStoreLock(store) || !RTSPEventStoreLoadFeeds(store) || !RTSPEventStoreLoadSegments(store)) {
+        error = errno ? errno : EIO;
+    } else {
+        RTSPEventStoreReadMeta(store);
+        if (store->segmentCount > 0) {
+            const RTSPEventSegment *last = &store->segments[store->segmentCount - 1];
+            if (last->firstSequence + last->count > store->nextSequence) {
+                store->nextSequence = last->firstSequence + last->count;
+            }
+        }
+        if (store->segmentCount == 0 || store->segments[store->segmentCount - 1].firstSequence +
+                                        store->segments[store->segmentCount - 1].count != store->nextSequence) {
+            if (!RTSPEventStoreCreateSegment(store)) {
+                error = errno ? errno : EIO;
+            }
+        }
+        if (!error && !RTSPEventStoreRebuildIndexes(store)) {
+            error = ENOMEM;
+        }
+    }
+    if (error) {
+        RTSPEventStoreClose(store);
+        errno = error;
+        return NULL;
+    }
+    return store;
+}
+
+void RTSPEventStoreClose(RTSPEventStoreRef store) {
+    if (!store) {
+        return;
+    }
+    if (store->segmentCount > 0) {
+        RTSPEventStoreCommit(store);
+    }
+    for (uint32_t i = 0; i < store->segmentCount; i++) {
+        RTSPEventSegmentClose(&store->segments[i]);
+    }
+    if (store->feedsFd >= 0) {
+        close(store->feedsFd);
+    }
+    if (store->lockFd >= 0) {
+        close(store->lockFd);
+    }
+    for (uint32_t i = 0; i < store->feedCount; i++) {
+        free(store->feeds[i]);
+    }
+    for (uint32_t i = 0; i < store->typeCount; i++) {
+        free(store->types[i].items);
+    }
+    for (uint32_t i = 0; i < store->feedPostingCount; i++) {
+        free(store->feedPostings[i].items);
+    }
+    RTSPEventTextIndexRelease(store->text);
+    RTSPByteBufferFree(&store->pendingRecords);
+    RTSPByteBufferFree(&store->pendingText);
+    RTSPByteBufferFree(&store->pendingFeeds);
+    free(store->segments);
+    free(store->feeds);
+    free(store->feedSlots);
+    free(store->time);
+    free(store->types);
+    free(store->feedPostings);
+    free(store->directory);
+    free(store);
+}
+
+void RTSPEventStoreSetMaxEvents(RTSPEventStoreRef store, uint64_t maxEvents) {
+    if (store) {
+        store->config.maxEvents = maxEvents;
+    }
+}
+
+uint64_t RTSPEventStoreAppend(RTSPEventStoreRef store, const RTSPEventStoreEvent *event) {
+    if (!store || store->segmentCount == 0 || !event || event->titleLength > UINT32_MAX || event->detailsLength > UINT32_MAX ||
+        event->metadataLength > UINT32_MAX) {
+        return 0;
+    }
+    RTSPEventSegment *segment = &store->segments[store->segmentCount - 1];
+    if (segment->count + store->pendingCount >= segment->capacity) {
+        if (RTSPEventStoreCommit(store) < 0 || !(segment = RTSPEventStoreCreateSegment(store))) {
+            return 0;
+        }
+    }
+
+    RTSPEventStoreRecord record;
+    memset(&record, 0, sizeof(record));
+    record.type = event->type;
+    record.sequence = store->nextSequence;
+    record.timestamp = event->timestamp;
+    memcpy(record.uuid, event->uuid, sizeof(record.uuid));
+    record.feed = event->feed && event->feed[0] ? RTSPEventStoreInternFeed(store, event->feed) : 0;
+    record.titleLength = event->title ? (uint32_t)event->titleLength : 0;
+    record.detailsLength = event->details ? (uint32_t)event->detailsLength : 0;
+    record.metadataLength = event->metadata ? (uint32_t)event->metadataLength : 0;
+    record.textOffset = segment->textSize + store->pendingText.length;
+    if (event->media.segment != 0) {
+        record.media = event->media;
+        record.media.reserved = 0;
+    }
+    record.crc = RTSPEventStoreRecordCRC(&record);
+
+    RTSPByteBufferAppend(&store->pendingText, event->title, record.titleLength);
+    RTSPByteBufferAppend(&store->pendingText, event->details, record.detailsLength);
+    RTSPByteBufferAppend(&store->pendingText, event->metadata, record.metadataLength);
+    RTSPByteBufferAppend(&store->pendingRecords, &record, sizeof(record));
+    if (store->pendingText.failed || store->pendingRecords.failed) {
+        return 0;
+    }
+    store->pendingCount++;
+    store->nextSequence++;
+    if (record.timestamp >= store->floor) {
+        RTSPEventStoreIndexRecord(store, &record, false);
+        if (store->text) {
+            RTSPEventTextIndexAdd(store->text, record.sequence, event->title, record.titleLength);
+            RTSPEventTextIndexAdd(store->text, record.sequence, event->details, record.detailsLength);
+        }
+    }
+    return record.sequence;
+}
+
+/// Drop the oldest whole segments beyond the event budget
+static void RTSPEventStoreApplyRetention(RTSPEventStoreRef store) {
+    if (store->config.maxEvents == 0) {
+        return;
+    }
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < store->segmentCount; i++) {
+        total += store->segments[i].count;
+    }
+    uint32_t drop = 0;
+    while (drop + 1 < store->segmentCount && total - store->segments[drop].count >= store->config.maxEvents) {
+        total -= store->segments[drop].count;
+        drop++;
+    }
+    if (drop > 0) {
+        RTSPEventStoreDropSegments(store, drop);
+        RTSPEventStoreUnindexBefore(store, store->segments[0].firstSequence);
+        RTSPEventTextIndexDropBefore(store->text, store->segments[0].firstSequence);
+    }
+}
+
+int RTSPEventStoreCommit(RTSPEventStoreRef store) {
+    if (!store) {
+        return -1;
+    }
+    if (store->pendingCount == 0 && store->pendingFeeds.length == 0) {
+        return 0;
+    }
+    if (store->segmentCount == 0) {
+        return -1;
+    }
+    RTSPEventSegment *segment = &store->segments[store->segmentCount - 1];
+
+    // Feeds and text land before the records that point at them
+    if (store->pendingFeeds.length > 0 &&
+        !RTSPEventStoreWriteAll(store->feedsFd, store->pendingFeeds.data, store->pendingFeeds.length, -1)) {
+        return -1;
+    }
+    RTSPByteBufferReset(&store->pendingFeeds);
+    if (store->pendingText.length > 0 &&
+        !RTSPEventStoreWriteAll(segment->textFd, store->pendingText.data, store->pendingText.length, (off_t)segment->textSize)) {
+        return -1;
+    }
+    off_t recordOffset = RTSP_EVENT_STORE_HEADER_SIZE + (off_t)segment->count * RTSP_EVENT_STORE_RECORD_SIZE;
+    if (store->pendingRecords.length > 0 &&
+        !RTSPEventStoreWriteAll(segment->fd, store->pendingRecords.data, store->pendingRecords.length, recordOffset)) {
+        return -1;
+    }
+    if (store->config.syncOnCommit &&
+        (fsync(store->feedsFd) != 0 || fsync(segment->textFd) != 0 || fsync(segment->fd) != 0)) {
+        return -1;
+    }
+
+    const RTSPEventStoreRecord *records = (const RTSPEventStoreRecord *)store->pendingRecords.data;
+    for (uint32_t i = 0; i < store->pendingCount; i++) {
+        segment->minTimestamp = records[i].timestamp < segment->minTimestamp ? records[i].timestamp : segment->minTimestamp;
+        segment->maxTimestamp = records[i].timestamp > segment->maxTimestamp ? records[i].timestamp : segment->maxTimestamp;
+    }
+    int written = (int)store->pendingCount;
+    segment->count += store->pendingCount;
+    segment->textSize += store->pendingText.length;
+    store->statistics.recordBytes += store->pendingRecords.length;
+    store->statistics.textBytes += store->pendingText.length;
+    store->statistics.commits++;
+    store->statistics.committedEvents += store->pendingCount;
+    RTSPByteBufferReset(&store->pendingRecords);
+    RTSPByteBufferReset(&store->pendingText);
+    store->pendingCount = 0;
+
+    if (!RTSPEventSegmentMapText(segment, segment->textSize)) {
+        return -1;
+    }
+    RTSPEventStoreApplyRetention(store);
+    return written;
+}
+
+uint32_t RTSPEventStorePendingCount(RTSPEventStoreRef store) {
+    return store ? store->pendingCount : 0;
+}
+
+uint64_t RTSPEventStoreCount(RTSPEventStoreRef store) {
+    return store ? store->timeCount : 0;
+}
+
+bool RTSPEventStoreGet(RTSPEventStoreRef store, uint64_t sequence, RTSPEventStoreEntry *entry) {
+    RTSPEventSegment *segment = store ? RTSPEventStoreSegmentFor(store, sequence) : NULL;
+    if (!segment || !entry) {
+        return false;
+    }
+    uint64_t slot = sequence - segment->firstSequence;
+    const RTSPEventStoreRecord *record = NULL;
+    const char *text = NULL;
+    if (slot < segment->count) {
+        record = RTSPEventSegmentRecord(segment, (uint32_t)slot);
+        text = (const char *)segment->textMap + record->textOffset;
+    } else if (segment == &store->segments[store->segmentCount - 1] && slot < (uint64_t)segment->count + store->pendingCount) {
+        record = (const RTSPEventStoreRecord *)store->pendingRecords.data + (slot - segment->count);
+        text = (const char *)store->pendingText.data + (record->textOffset - segment->textSize);
+    }
+    if (!record || record->timestamp < store->floor) {
+        return false;
+    }
+    entry->record = record;
+    entry->feed = record->feed && record->feed <= store->feedCount ? store->feeds[record->feed - 1] : NULL;
+    entry->title = text;
+    entry->details = text + record->titleLength;
+    entry->metadata = (const uint8_t *)text + record->titleLength + record->detailsLength;
+    return true;
+}
+
+#pragma mark - Index Access
+
+const RTSPEventStoreTimeEntry *RTSPEventStoreTimeIndex(RTSPEventStoreRef store, size_t *count) {
+    if (count) {
+        *count = store ? store->timeCount : 0;
+    }
+    return store ? store->time : NULL;
+}
+
+size_t RTSPEventStoreTimeLowerBound(RTSPEventStoreRef store, int64_t timestamp) {
+    size_t low = 0, high = store ? store->timeCount : 0;
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+        if (store->time[middle].timestamp < timestamp) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+const uint64_t *RTSPEventStoreTypePostings(RTSPEventStoreRef store, uint16_t type, size_t *count) {
+    bool known = store && type < store->typeCount;
+    if (count) {
+        *count = known ? store->types[type].count : 0;
+    }
+    return known ? store->types[type].items : NULL;
+}
+
+uint32_t RTSPEventStoreFeedID(RTSPEventStoreRef store, const char *feed) {
+    if (!store || !feed) {
+        return 0;
+    }
+    return RTSPEventStoreFindFeed(store, feed, strnlen(feed, RTSP_EVENT_STORE_MAX_FEED), NULL);
+}
+
+const uint64_t *RTSPEventStoreFeedPostings(RTSPEventStoreRef store, uint32_t feed, size_t *count) {
+    bool known = store && feed > 0 && feed < store->feedPostingCount;
+    if (count) {
+        *count = known ? store->feedPostings[feed].count : 0;
+    }
+    return known ? store->feedPostings[feed].items : NULL;
+}
+
+RTSPEventTextIndexRef RTSPEventStoreTextIndex(RTSPEventStoreRef store) {
+    if (!store || store->text) {
+        return store ? store->text : NULL;
+    }
+    RTSPEventTextIndexRef text = RTSPEventTextIndexCreate();
+    if (!text) {
+        return NULL;
+    }
+    uint64_t first = store->segmentCount ? store->segments[0].firstSequence : store->nextSequence;
+    for (uint64_t sequence = first; sequence < store->nextSequence; sequence++) {
+        RTSPEventStoreEntry entry;
+        if (!RTSPEventStoreGet(store, sequence, &entry)) {
+            continue;
+        }
+        if (!RTSPEventTextIndexAdd(text, sequence, entry.title, entry.record->titleLength) ||
+            !RTSPEventTextIndexAdd(text, sequence, entry.details, entry.record->detailsLength)) {
+            RTSPEventTextIndexRelease(text);
+            return NULL;
+        }
+    }
+    store->text = text;
+    return text;
+}
+
+#pragma mark - Deletion
+
+bool RTSPEventStoreTrimBefore(RTSPEventStoreRef store, int64_t timestamp) {
+    if (!store || RTSPEventStoreCommit(store) < 0) {
+        return false;
+    }
+    if (timestamp > store->floor) {
+        store->floor = timestamp;
+    }
+    uint32_t drop = 0;
+    while (drop + 1 < store->segmentCount && store->segments[drop].count > 0 &&
+           store->segments[drop].maxTimestamp < store->floor) {
+        drop++;
+    }
+    RTSPEventStoreDropSegments(store, drop);
+    RTSPEventTextIndexRelease(store->text);
+    store->text = NULL;
+    return RTSPEventStoreWriteMeta(store) && RTSPEventStoreRebuildIndexes(store);
+}
+
+bool RTSPEventStoreClear(RTSPEventStoreRef store) {
+    if (!store) {
+        return false;
+    }
+    RTSPByteBufferReset(&store->pendingRecords);
+    RTSPByteBufferReset(&store->pendingText);
+    store->pendingCount = 0;
+    if (store->pendingFeeds.length > 0 &&
+        RTSPEventStoreWriteAll(store->feedsFd, store->pendingFeeds.data, store->pendingFeeds.length, -1)) {
+        RTSPByteBufferReset(&store->pendingFeeds);
+    }
+
+    // Record the next sequence number first, so a crash in between can't reuse one
+    store->floor = INT64_MIN;
+    if (!RTSPEventStoreWriteMeta(store)) {
+        return false;
+    }
+    RTSPEventStoreDropSegments(store, store->segmentCount);
+    RTSPEventStoreResetIndexes(store);
+    RTSPEventTextIndexRelease(store->text);
+    store->text = NULL;
+    return RTSPEventStoreCreateSegment(store) != NULL;
+}
+
+RTSPEventStoreStatistics RTSPEventStoreGetStatistics(RTSPEventStoreRef store) {
+    RTSPEventStoreStatistics statistics;
+    memset(&statistics, 0, sizeof(statistics));
+    if (!store) {
+        return statistics;
+    }
+    statistics = store->statistics;
+    statistics.events = store->timeCount;
+    statistics.nextSequence = store->nextSequence;
+    statistics.segments = store->segmentCount;
+    statistics.feeds = store->feedCount;
+    statistics.pending = store->pendingCount;
+    statistics.firstSequence = store->timeCount && store->segmentCount ? store->segments[0].firstSequence : 0;
+    return statistics;
+}
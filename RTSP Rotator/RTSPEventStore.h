@@ -0,0 +1,182 @@
+//
+//  RTSPEventStore.h
+//  RTSP Rotator
+//
+//  Append-only on-disk event log behind RTSPEventLogger. Events are
+//  fixed-size binary records in segment files (events-NNNNNNNN.seg); their
+//  title, details and metadata go to the segment's text heap
+//  (events-NNNNNNNN.txt), and feed URLs are interned once in feeds.dat.
+//
+//  Appends are buffered and written by RTSPEventStoreCommit as one write per
+//  file (group commit), text before records. Every record carries a CRC, so
+//  a torn write is detected on open and the log ends at the last good
+//  record. Opening memory-maps the segments and rebuilds the in-memory
+//  indexes from the records alone: a time index sorted by timestamp, and
+//  posting lists per event type and per feed. A trigram index over titles
+//  and details (RTSPEventTextIndex) is built on the first text search.
+//
+//  Retention drops whole segments, oldest first. Events are addressed by
+//  sequence number, which starts at 1 and is never reused.
+//
+//  Plain C. Not thread-safe: callers serialize access (one queue).
+//
+
+#ifndef RTSPEventStore_h
+#define RTSPEventStore_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "RTSPEventTextIndex.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RTSP_EVENT_STORE_RECORD_SIZE 96
+
+/// Where the event is in its feed's DVR recording (RTSPDVRStore): the
+/// keyframe at or before it, so playback starts with one seek
+typedef struct {
+    uint64_t segment;               // DVR segment sequence, 0 = not recorded
+    uint32_t offset;                // The keyframe's moof in the segment file
+    uint32_t reserved;              // Zero
+    int64_t time;                   // The keyframe's wall clock, microseconds since 1970
+} RTSPEventStoreMediaRef;
+
+/// On-disk record, little-endian, 96 bytes
+typedef struct {
+    uint32_t crc;                   // CRC-32 of the remaining 92 bytes
+    uint16_t type;
+    uint16_t flags;
+    uint64_t sequence;
+    int64_t timestamp;              // Microseconds since 1970
+    uint8_t uuid[16];
+    uint32_t feed;                  // Feed ID, 0 = none
+    uint32_t titleLength;
+    uint32_t detailsLength;
+    uint32_t metadataLength;
+    uint64_t textOffset;            // Title, details, metadata back to back in the text heap
+    RTSPEventStoreMediaRef media;   // All zero in records written before it existed
+    uint8_t reserved[8];            // Zero
+} RTSPEventStoreRecord;
+
+typedef struct {
+    uint32_t recordsPerSegment;     // Default 65536 (6 MB of records)
+    uint64_t maxEvents;             // Retention; 0 = unlimited. Default 1,000,000
+    bool syncOnCommit;              // fsync after each commit. Default true
+} RTSPEventStoreConfig;
+
+void RTSPEventStoreConfigInit(RTSPEventStoreConfig *config);
+
+typedef struct RTSPEventStore *RTSPEventStoreRef;
+
+/// Event to append. Strings are UTF-8 and copied.
+typedef struct {
+    int64_t timestamp;
+    uint16_t type;
+    uint8_t uuid[16];
+    const char *feed;               // NULL = none
+    const char *title;
+    size_t titleLength;
+    const char *details;            // NULL = none
+    size_t detailsLength;
+    const uint8_t *metadata;        // Opaque (the logger stores JSON); NULL = none
+    size_t metadataLength;
+    RTSPEventStoreMediaRef media;   // Zero = none
+} RTSPEventStoreEvent;
+
+/// A stored event. Pointers stay valid until the next call that modifies
+/// the store.
+typedef struct {
+    const RTSPEventStoreRecord *record;
+    const char *feed;               // NUL-terminated, NULL = none
+    const char *title;              // Not NUL-terminated
+    const char *details;
+    const uint8_t *metadata;
+} RTSPEventStoreEntry;
+
+typedef struct {
+    int64_t timestamp;
+    uint64_t sequence;
+} RTSPEventStoreTimeEntry;
+
+typedef struct {
+    uint64_t events;                // Visible events
+    uint64_t firstSequence;         // Oldest retained, 0 when empty
+    uint64_t nextSequence;
+    uint32_t segments;
+    uint32_t feeds;
+    uint32_t pending;               // Appended, not yet committed
+    uint64_t commits;
+    uint64_t committedEvents;
+    uint64_t droppedSegments;       // By retention, trimming or clearing
+    uint64_t recoveredTornRecords;  // Discarded on open
+    uint64_t recordBytes;
+    uint64_t textBytes;
+} RTSPEventStoreStatistics;
+
+/// Open or create the store in a directory (created if missing). Returns
+/// NULL with errno set on failure; EWOULDBLOCK if the store is already open,
+/// here or in another process.
+RTSPEventStoreRef RTSPEventStoreOpen(const char *directory, const RTSPEventStoreConfig *config);
+
+/// Commit pending events, unmap and close
+void RTSPEventStoreClose(RTSPEventStoreRef store);
+
+void RTSPEventStoreSetMaxEvents(RTSPEventStoreRef store, uint64_t maxEvents);
+
+/// Buffer an event; it is visible to reads and indexes immediately.
+/// Returns its sequence number, 0 on failure.
+uint64_t RTSPEventStoreAppend(RTSPEventStoreRef store, const RTSPEventStoreEvent *event);
+
+/// Write pending events and apply retention. Returns the number of events
+/// written, -1 on I/O error (pending events are kept for the next attempt).
+int RTSPEventStoreCommit(RTSPEventStoreRef store);
+
+uint32_t RTSPEventStorePendingCount(RTSPEventStoreRef store);
+
+/// Visible events
+uint64_t RTSPEventStoreCount(RTSPEventStoreRef store);
+
+/// Look up by sequence number. False for unknown, dropped or trimmed events.
+bool RTSPEventStoreGet(RTSPEventStoreRef store, uint64_t sequence, RTSPEventStoreEntry *entry);
+
+#pragma mark - Indexes
+
+/// Every visible event by (timestamp, sequence)
+const RTSPEventStoreTimeEntry *RTSPEventStoreTimeIndex(RTSPEventStoreRef store, size_t *count);
+
+/// First time index position with timestamp >= the given one
+size_t RTSPEventStoreTimeLowerBound(RTSPEventStoreRef store, int64_t timestamp);
+
+/// Sequence numbers of visible events of a type, ascending
+const uint64_t *RTSPEventStoreTypePostings(RTSPEventStoreRef store, uint16_t type, size_t *count);
+
+/// Feed ID for a URL, 0 if no event was ever logged for it
+uint32_t RTSPEventStoreFeedID(RTSPEventStoreRef store, const char *feed);
+
+/// Sequence numbers of visible events of a feed, ascending
+const uint64_t *RTSPEventStoreFeedPostings(RTSPEventStoreRef store, uint32_t feed, size_t *count);
+
+/// Trigram index over titles and details. Built on first use, then kept
+/// current by appends and retention; trimming or clearing discards it.
+/// NULL if it cannot be built.
+RTSPEventTextIndexRef RTSPEventStoreTextIndex(RTSPEventStoreRef store);
+
+#pragma mark - Deletion
+
+/// Hide events older than a timestamp; segments wholly before it are deleted
+bool RTSPEventStoreTrimBefore(RTSPEventStoreRef store, int64_t timestamp);
+
+/// Delete every event. Sequence numbers continue where they left off.
+bool RTSPEventStoreClear(RTSPEventStoreRef store);
+
+RTSPEventStoreStatistics RTSPEventStoreGetStatistics(RTSPEventStoreRef store);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RTSPEventStore_h */
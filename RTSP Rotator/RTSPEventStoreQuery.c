@@ -0,0 +1,297 @@
+//
+//  RTSPEventStoreQuery.c
+//  RTSP Rotator
+//
+
+#include "RTSPEventStoreQuery.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Below this many candidates, verifying the text directly is cheaper than
+// decoding trigram lists
+#define RTSP_EVENT_STORE_QUERY_TEXT_INDEX_THRESHOLD 4096
+
+struct RTSPEventStoreCursor {
+    RTSPEventStoreQuery query;
+    char *feed;
+    char *text;
+    uint32_t feedID;
+    RTSPEventStoreQueryPlan plan;
+    uint16_t type;                  // Type plan
+    uint64_t *owned;                // Types, time and text plans: sorted sequences
+    size_t ownedCount;
+    uint64_t ceiling;               // Next sequence when created; later events are excluded
+    uint64_t resume;                // Last sequence examined, 0 before the first page
+    bool exhausted;
+    RTSPEventStoreCursorStatistics statistics;
+};
+
+void RTSPEventStoreQueryInit(RTSPEventStoreQuery *query) {
+    memset(query, 0, sizeof(*query));
+}
+
+bool RTSPEventStoreQueryMatches(const RTSPEventStoreQuery *query, uint32_t feed, const RTSPEventStoreEntry *entry) {
+    const RTSPEventStoreRecord *record = entry->record;
+    if (query->types && (record->type >= 64 || !(query->types & (1ull << record->type)))) {
+        return false;
+    }
+    if (query->feed && record->feed != feed) {
+        return false;
+    }
+    if (query->hasTimeRange && (record->timestamp < query->from || record->timestamp > query->to)) {
+        return false;
+    }
+    if (query->text && query->textLength > 0 &&
+        !RTSPEventTextContains(entry->title, record->titleLength, query->text, query->textLength) &&
+        !RTSPEventTextContains(entry->details, record->detailsLength, query->text, query->textLength)) {
+        return false;
+    }
+    return true;
+}
+
+static int RTSPEventStoreQueryCompareSequence(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+#pragma mark - Planning
+
+/// Sequences of a time index range, sorted into log order
+static bool RTSPEventStoreCursorTakeTimeRange(RTSPEventStoreCursorRef cursor, RTSPEventStoreRef store, size_t from, size_t to) {
+    const RTSPEventStoreTimeEntry *time = RTSPEventStoreTimeIndex(store, NULL);
+    cursor->owned = malloc((to - from + 1) * sizeof(*cursor->owned));
+    if (!cursor->owned) {
+        return false;
+    }
+    for (size_t i = from; i < to; i++) {
+        cursor->owned[cursor->ownedCount++] = time[i].sequence;
+    }
+    qsort(cursor->owned, cursor->ownedCount, sizeof(*cursor->owned), RTSPEventStoreQueryCompareSequence);
+    return true;
+}
+
+static bool RTSPEventStoreCursorTakeTypes(RTSPEventStoreCursorRef cursor, RTSPEventStoreRef store, uint64_t total) {
+    cursor->owned = malloc((size_t)(total + 1) * sizeof(*cursor->owned));
+    if (!cursor->owned) {
+        return false;
+    }
+    for (unsigned type = 0; type < 64; type++) {
+        if (cursor->query.types & (1ull << type)) {
+            size_t count = 0;
+            const uint64_t *postings = RTSPEventStoreTypePostings(store, (uint16_t)type, &count);
+            memcpy(cursor->owned + cursor->ownedCount, postings, count * sizeof(*postings));
+            cursor->ownedCount += count;
+        }
+    }
+    qsort(cursor->owned, cursor->ownedCount, sizeof(*cursor->owned), RTSPEventStoreQueryCompareSequence);
+    return true;
+}
+
+RTSPEventStoreCursorRef RTSPEventStoreCursorCreate(RTSPEventStoreRef store, const RTSPEventStoreQuery *query) {
+    if (!store || !query) {
+        return NULL;
+    }
+    RTSPEventStoreCursorRef cursor = calloc(1, sizeof(*cursor));
+    if (!cursor) {
+        return NULL;
+    }
+    cursor->query = *query;
+    cursor->feed = query->feed ? strdup(query->feed) : NULL;
+    cursor->text = query->text && query->textLength > 0 ? malloc(query->textLength) : NULL;
+    if ((query->feed && !cursor->feed) || (query->text && query->textLength > 0 && !cursor->text)) {
+        RTSPEventStoreCursorRelease(cursor);
+        return NULL;
+    }
+    if (cursor->text) {
+        memcpy(cursor->text, query->text, query->textLength);
+    }
+    cursor->query.feed = cursor->feed;
+    cursor->query.text = cursor->text;
+    cursor->query.textLength = cursor->text ? query->textLength : 0;
+
+    // Estimate each criterion's slice and drive from the smallest
+    RTSPEventStoreStatistics statistics = RTSPEventStoreGetStatistics(store);
+    cursor->ceiling = statistics.nextSequence;
+    uint64_t best = statistics.events;
+    cursor->plan = RTSPEventStoreQueryPlanScan;
+
+    uint64_t typeTotal = 0;
+    unsigned typeCount = 0;
+    for (unsigned type = 0; type < 64 && cursor->query.types; type++) {
+        if (cursor->query.types & (1ull << type)) {
+            size_t count = 0;
+            RTSPEventStoreTypePostings(store, (uint16_t)type, &count);
+            typeTotal += count;
+            typeCount++;
+            cursor->type = (uint16_t)type;
+        }
+    }
+    if (cursor->query.types && typeTotal <= best) {
+        best = typeTotal;
+        cursor->plan = typeCount == 1 ? RTSPEventStoreQueryPlanType : RTSPEventStoreQueryPlanTypes;
+    }
+    if (cursor->feed) {
+        size_t count = 0;
+        cursor->feedID = RTSPEventStoreFeedID(store, cursor->feed);
+        RTSPEventStoreFeedPostings(store, cursor->feedID, &count);
+        if (count <= best) {
+            best = count;
+            cursor->plan = RTSPEventStoreQueryPlanFeed;
+        }
+    }
+    size_t timeFrom = 0, timeTo = 0;
+    if (cursor->query.hasTimeRange) {
+        timeFrom = RTSPEventStoreTimeLowerBound(store, cursor->query.from);
+        timeTo = cursor->query.to == INT64_MAX ? statistics.events : RTSPEventStoreTimeLowerBound(store, cursor->query.to + 1);
+        timeTo = timeTo < timeFrom ? timeFrom : timeTo;
+        if (timeTo - timeFrom <= best) {
+            best = timeTo - timeFrom;
+            cursor->plan = RTSPEventStoreQueryPlanTime;
+        }
+    }
+    uint64_t *candidates = NULL;
+    size_t candidateCount = 0;
+    RTSPEventTextIndexRef text = best > RTSP_EVENT_STORE_QUERY_TEXT_INDEX_THRESHOLD && cursor->text ? RTSPEventStoreTextIndex(store) : NULL;
+    // Intersecting trigram lists is paid up front, while another driver is
+    // consumed lazily a page at a time: only use the index when decoding it
+    // touches fewer entries than the best driver holds
+    if (text && RTSPEventTextIndexCandidates(text, cursor->text, cursor->query.textLength, best, &candidates, &candidateCount)) {
+        if (candidateCount <= best) {
+            best = candidateCount;
+            cursor->plan = RTSPEventStoreQueryPlanText;
+            cursor->owned = candidates;
+            cursor->ownedCount = candidateCount;
+        } else {
+            free(candidates);
+        }
+    }
+
+    bool ok = true;
+    if (best == 0) {
+        cursor->plan = RTSPEventStoreQueryPlanEmpty;
+    } else if (cursor->plan == RTSPEventStoreQueryPlanTypes) {
+        ok = RTSPEventStoreCursorTakeTypes(cursor, store, typeTotal);
+    } else if (cursor->plan == RTSPEventStoreQueryPlanTime) {
+        ok = RTSPEventStoreCursorTakeTimeRange(cursor, store, timeFrom, timeTo);
+    }
+    if (!ok) {
+        RTSPEventStoreCursorRelease(cursor);
+        return NULL;
+    }
+    cursor->exhausted = cursor->plan == RTSPEventStoreQueryPlanEmpty;
+    cursor->statistics.plan = cursor->plan;
+    cursor->statistics.candidates = best;
+    return cursor;
+}
+
+void RTSPEventStoreCursorRelease(RTSPEventStoreCursorRef cursor) {
+    if (!cursor) {
+        return;
+    }
+    free(cursor->owned);
+    free(cursor->feed);
+    free(cursor->text);
+    free(cursor);
+}
+
+#pragma mark - Paging
+
+/// First position with items[i] > sequence
+static size_t RTSPEventStoreUpperBound(const uint64_t *items, size_t count, uint64_t sequence) {
+    size_t low = 0, high = count;
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+        if (items[middle] <= sequence) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+static bool RTSPEventStoreCursorExamine(RTSPEventStoreCursorRef cursor, RTSPEventStoreRef store, uint64_t sequence) {
+    RTSPEventStoreEntry entry;
+    cursor->resume = sequence;
+    cursor->statistics.examined++;
+    if (!RTSPEventStoreGet(store, sequence, &entry) || !RTSPEventStoreQueryMatches(&cursor->query, cursor->feedID, &entry)) {
+        return false;
+    }
+    cursor->statistics.matched++;
+    return true;
+}
+
+size_t RTSPEventStoreCursorNext(RTSPEventStoreCursorRef cursor, RTSPEventStoreRef store, uint64_t *sequences, size_t capacity) {
+    if (!cursor || !store || cursor->exhausted) {
+        return 0;
+    }
+    size_t produced = 0;
+    bool newestFirst = cursor->query.newestFirst;
+
+    if (cursor->plan == RTSPEventStoreQueryPlanScan) {
+        uint64_t first = RTSPEventStoreGetStatistics(store).firstSequence;
+        if (first == 0) {
+            cursor->exhausted = true;
+            return 0;
+        }
+        if (!newestFirst) {
+            uint64_t sequence = cursor->resume + 1 > first ? cursor->resume + 1 : first;
+            for (; sequence < cursor->ceiling && produced < capacity; sequence++) {
+                if (RTSPEventStoreCursorExamine(cursor, store, sequence)) {
+                    sequences[produced++] = sequence;
+                }
+            }
+            cursor->exhausted = sequence >= cursor->ceiling;
+        } else {
+            uint64_t sequence = cursor->resume ? cursor->resume : cursor->ceiling;
+            while (sequence > first && produced < capacity) {
+                sequence--;
+                if (RTSPEventStoreCursorExamine(cursor, store, sequence)) {
+                    sequences[produced++] = sequence;
+                }
+            }
+            cursor->exhausted = sequence <= first;
+        }
+        return produced;
+    }
+
+    // Posting lists are looked up again on every page: appends may have moved them
+    const uint64_t *items = cursor->owned;
+    size_t count = cursor->ownedCount;
+    if (cursor->plan == RTSPEventStoreQueryPlanType) {
+        items = RTSPEventStoreTypePostings(store, cursor->type, &count);
+    } else if (cursor->plan == RTSPEventStoreQueryPlanFeed) {
+        items = RTSPEventStoreFeedPostings(store, cursor->feedID, &count);
+    }
+    count = RTSPEventStoreUpperBound(items, count, cursor->ceiling - 1);
+
+    if (!newestFirst) {
+        size_t i = RTSPEventStoreUpperBound(items, count, cursor->resume);
+        for (; i < count && produced < capacity; i++) {
+            if (RTSPEventStoreCursorExamine(cursor, store, items[i])) {
+                sequences[produced++] = items[i];
+            }
+        }
+        cursor->exhausted = i >= count;
+    } else {
+        size_t i = cursor->resume ? RTSPEventStoreUpperBound(items, count, cursor->resume - 1) : count;
+        for (; i > 0 && produced < capacity; i--) {
+            if (RTSPEventStoreCursorExamine(cursor, store, items[i - 1])) {
+                sequences[produced++] = items[i - 1];
+            }
+        }
+        cursor->exhausted = i == 0;
+    }
+    return produced;
+}
+
+bool RTSPEventStoreCursorExhausted(RTSPEventStoreCursorRef cursor) {
+    return !cursor || cursor->exhausted;
+}
+
+RTSPEventStoreCursorStatistics RTSPEventStoreCursorGetStatistics(RTSPEventStoreCursorRef cursor) {
+    RTSPEventStoreCursorStatistics statistics;
+    memset(&statistics, 0, sizeof(statistics));
+    return cursor ? cursor->statistics : statistics;
+}
@@ -0,0 +1,81 @@
+//
+//  RTSPEventStoreQuery.h
+//  RTSP Rotator
+//
+//  Composable queries over RTSPEventStore: any combination of event types,
+//  a feed, a time range and a text substring, ANDed. The planner drives the
+//  query from the most selective index (type or feed posting list, time
+//  index range, or trigram candidates) and checks the remaining criteria
+//  against each candidate's record, so a query never scans more than its
+//  smallest index slice.
+//
+//  Results come from a cursor a page at a time, in log (sequence) order,
+//  oldest or newest first. A cursor covers the events present when it was
+//  created; it resumes from the last sequence number it examined, so it
+//  stays valid while the store is appended to, trimmed or pruned (events
+//  removed in between are skipped).
+//
+//  Plain C. Not thread-safe: use on the store's queue.
+//
+
+#ifndef RTSPEventStoreQuery_h
+#define RTSPEventStoreQuery_h
+
+#include "RTSPEventStore.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint64_t types;                 // Bit n selects event type n; 0 = any
+    const char *feed;               // NULL = any
+    bool hasTimeRange;
+    int64_t from;                   // Inclusive, microseconds since 1970
+    int64_t to;                     // Inclusive
+    const char *text;               // Title or details substring, ASCII case-insensitive; NULL = any
+    size_t textLength;
+    bool newestFirst;
+} RTSPEventStoreQuery;
+
+void RTSPEventStoreQueryInit(RTSPEventStoreQuery *query);
+
+typedef enum {
+    RTSPEventStoreQueryPlanEmpty,   // A criterion matches nothing
+    RTSPEventStoreQueryPlanScan,    // No criteria: every event
+    RTSPEventStoreQueryPlanType,
+    RTSPEventStoreQueryPlanTypes,   // Several types merged
+    RTSPEventStoreQueryPlanFeed,
+    RTSPEventStoreQueryPlanTime,
+    RTSPEventStoreQueryPlanText
+} RTSPEventStoreQueryPlan;
+
+typedef struct {
+    RTSPEventStoreQueryPlan plan;
+    uint64_t candidates;            // Size of the driving index slice
+    uint64_t examined;
+    uint64_t matched;
+} RTSPEventStoreCursorStatistics;
+
+typedef struct RTSPEventStoreCursor *RTSPEventStoreCursorRef;
+
+/// Plan a query. The query's strings are copied. NULL on allocation failure.
+RTSPEventStoreCursorRef RTSPEventStoreCursorCreate(RTSPEventStoreRef store, const RTSPEventStoreQuery *query);
+void RTSPEventStoreCursorRelease(RTSPEventStoreCursorRef cursor);
+
+/// Fill up to `capacity` matching sequence numbers; returns how many, 0 once
+/// the cursor is exhausted. Pass the store the cursor was created on.
+size_t RTSPEventStoreCursorNext(RTSPEventStoreCursorRef cursor, RTSPEventStoreRef store, uint64_t *sequences, size_t capacity);
+
+bool RTSPEventStoreCursorExhausted(RTSPEventStoreCursorRef cursor);
+
+RTSPEventStoreCursorStatistics RTSPEventStoreCursorGetStatistics(RTSPEventStoreCursorRef cursor);
+
+/// Whether a stored event meets every criterion of a query
+bool RTSPEventStoreQueryMatches(const RTSPEventStoreQuery *query, uint32_t feed, const RTSPEventStoreEntry *entry);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RTSPEventStoreQuery_h */
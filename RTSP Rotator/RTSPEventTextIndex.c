@@ -0,0 +1,363 @@
+//
+//  RTSPEventTextIndex.c
+//  RTSP Rotator
+//
+
+#include "RTSPEventTextIndex.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Only the rarest lists are intersected; verification handles the rest
+#define RTSP_EVENT_TEXT_INDEX_MAX_LISTS 4
+#define RTSP_EVENT_TEXT_INDEX_MAX_QUERY_TRIGRAMS 64
+
+typedef struct {
+    uint32_t key;                   // Trigram + 1; 0 marks an empty slot
+    uint32_t count;
+    uint64_t last;                  // Last sequence in the list (delta base)
+    uint8_t *bytes;                 // Delta varints, first delta from 0
+    uint32_t length;
+    uint32_t capacity;
+} RTSPEventTrigram;
+
+struct RTSPEventTextIndex {
+    RTSPEventTrigram *slots;
+    uint32_t slotBits;
+    uint32_t used;
+    uint64_t floor;                 // Entries before this are stale
+    uint64_t firstSequence;         // Oldest entry that may be in a list
+    uint64_t lastSequence;
+    RTSPEventTextIndexStatistics statistics;
+};
+
+static inline uint8_t RTSPEventTextFold(uint8_t c) {
+    return (c >= 'A' && c <= 'Z') ? (uint8_t)(c + 32) : c;
+}
+
+static inline uint32_t RTSPEventTextKey(const uint8_t *folded) {
+    return ((uint32_t)folded[0] << 16 | (uint32_t)folded[1] << 8 | folded[2]) + 1;
+}
+
+static inline uint32_t RTSPEventTextSlot(const struct RTSPEventTextIndex *index, uint32_t key) {
+    return (key * 0x9E3779B1u) >> (32 - index->slotBits);
+}
+
+#pragma mark - Table
+
+static bool RTSPEventTextIndexGrow(RTSPEventTextIndexRef index) {
+    uint32_t bits = index->slotBits ? index->slotBits + 1 : 12;
+    RTSPEventTrigram *slots = calloc((size_t)1 << bits, sizeof(*slots));
+    if (!slots) {
+        return false;
+    }
+    RTSPEventTrigram *old = index->slots;
+    uint32_t oldCount = index->slotBits ? 1u << index->slotBits : 0;
+    index->slots = slots;
+    index->slotBits = bits;
+    uint32_t mask = (1u << bits) - 1;
+    for (uint32_t i = 0; i < oldCount; i++) {
+        if (old[i].key) {
+            uint32_t slot = RTSPEventTextSlot(index, old[i].key);
+            while (slots[slot].key) {
+                slot = (slot + 1) & mask;
+            }
+            slots[slot] = old[i];
+        }
+    }
+    free(old);
+    return true;
+}
+
+static RTSPEventTrigram *RTSPEventTextIndexFind(RTSPEventTextIndexRef index, uint32_t key, bool insert) {
+    if (insert && (index->used + 1) * 10 > (index->slotBits ? 7u << index->slotBits : 0) && !RTSPEventTextIndexGrow(index)) {
+        return NULL;
+    }
+    if (!index->slotBits) {
+        return NULL;
+    }
+    uint32_t mask = (1u << index->slotBits) - 1;
+    uint32_t slot = RTSPEventTextSlot(index, key);
+    while (index->slots[slot].key) {
+        if (index->slots[slot].key == key) {
+            return &index->slots[slot];
+        }
+        slot = (slot + 1) & mask;
+    }
+    if (!insert) {
+        return NULL;
+    }
+    index->slots[slot].key = key;
+    index->used++;
+    index->statistics.trigrams = index->used;
+    return &index->slots[slot];
+}
+
+#pragma mark - Lists
+
+static bool RTSPEventTrigramAppend(RTSPEventTrigram *trigram, uint64_t delta) {
+    if (trigram->length + 10 > trigram->capacity) {
+        uint32_t capacity = trigram->capacity ? trigram->capacity * 2 : 16;
+        uint8_t *bytes = realloc(trigram->bytes, capacity);
+        if (!bytes) {
+            return false;
+        }
+        trigram->bytes = bytes;
+        trigram->capacity = capacity;
+    }
+    while (delta >= 0x80) {
+        trigram->bytes[trigram->length++] = (uint8_t)(delta | 0x80);
+        delta >>= 7;
+    }
+    trigram->bytes[trigram->length++] = (uint8_t)delta;
+    return true;
+}
+
+typedef struct {
+    const uint8_t *cursor;
+    const uint8_t *end;
+    uint64_t value;
+} RTSPEventTrigramReader;
+
+static inline bool RTSPEventTrigramNext(RTSPEventTrigramReader *reader) {
+    if (reader->cursor >= reader->end) {
+        return false;
+    }
+    uint64_t delta = 0;
+    unsigned shift = 0;
+    uint8_t byte;
+    do {
+        byte = *reader->cursor++;
+        delta |= (uint64_t)(byte & 0x7F) << shift;
+        shift += 7;
+    } while ((byte & 0x80) && reader->cursor < reader->end);
+    reader->value += delta;
+    return true;
+}
+
+static RTSPEventTrigramReader RTSPEventTrigramRead(const RTSPEventTrigram *trigram) {
+    RTSPEventTrigramReader reader = {trigram->bytes, trigram->bytes + trigram->length, 0};
+    return reader;
+}
+
+#pragma mark - Index
+
+RTSPEventTextIndexRef RTSPEventTextIndexCreate(void) {
+    return calloc(1, sizeof(struct RTSPEventTextIndex));
+}
+
+void RTSPEventTextIndexClear(RTSPEventTextIndexRef index) {
+    if (!index) {
+        return;
+    }
+    uint32_t slotCount = index->slotBits ? 1u << index->slotBits : 0;
+    for (uint32_t i = 0; i < slotCount; i++) {
+        free(index->slots[i].bytes);
+    }
+    free(index->slots);
+    uint64_t compactions = index->statistics.compactions;
+    memset(index, 0, sizeof(*index));
+    index->statistics.compactions = compactions;
+}
+
+void RTSPEventTextIndexRelease(RTSPEventTextIndexRef index) {
+    RTSPEventTextIndexClear(index);
+    free(index);
+}
+
+bool RTSPEventTextIndexAdd(RTSPEventTextIndexRef index, uint64_t sequence, const char *text, size_t length) {
+    if (!index || sequence == 0 || sequence < index->lastSequence) {
+        return false;
+    }
+    if (sequence != index->lastSequence) {
+        index->statistics.documents++;
+        if (!index->firstSequence) {
+            index->firstSequence = sequence;
+        }
+        index->lastSequence = sequence;
+    }
+    if (!text || length < 3) {
+        return true;
+    }
+    const uint8_t *bytes = (const uint8_t *)text;
+    uint8_t window[3] = {RTSPEventTextFold(bytes[0]), RTSPEventTextFold(bytes[1]), 0};
+    for (size_t i = 2; i < length; i++) {
+        window[2] = RTSPEventTextFold(bytes[i]);
+        RTSPEventTrigram *trigram = RTSPEventTextIndexFind(index, RTSPEventTextKey(window), true);
+        if (!trigram) {
+            return false;
+        }
+        if (trigram->count == 0 || trigram->last != sequence) {
+            uint32_t before = trigram->length;
+            if (!RTSPEventTrigramAppend(trigram, sequence - trigram->last)) {
+                return false;
+            }
+            trigram->last = sequence;
+            trigram->count++;
+            index->statistics.postings++;
+            index->statistics.postingBytes += trigram->length - before;
+        }
+        window[0] = window[1];
+        window[1] = window[2];
+    }
+    return true;
+}
+
+/// Rewrite every list without its stale head
+static void RTSPEventTextIndexCompact(RTSPEventTextIndexRef index) {
+    uint32_t slotCount = index->slotBits ? 1u << index->slotBits : 0;
+    index->statistics.postings = 0;
+    index->statistics.postingBytes = 0;
+    for (uint32_t i = 0; i < slotCount; i++) {
+        RTSPEventTrigram *trigram = &index->slots[i];
+        if (!trigram->key) {
+            continue;
+        }
+        RTSPEventTrigramReader reader = RTSPEventTrigramRead(trigram);
+        if (RTSPEventTrigramNext(&reader) && reader.value < index->floor) {
+            RTSPEventTrigram rewritten = {.key = trigram->key};
+            bool ok = true;
+            reader = RTSPEventTrigramRead(trigram);
+            while (ok && RTSPEventTrigramNext(&reader)) {
+                if (reader.value >= index->floor) {
+                    ok = RTSPEventTrigramAppend(&rewritten, reader.value - rewritten.last);
+                    rewritten.last = reader.value;
+                    rewritten.count++;
+                }
+            }
+            if (ok) {
+                // On failure the old list stays; its stale entries are filtered anyway
+                free(trigram->bytes);
+                *trigram = rewritten;
+            } else {
+                free(rewritten.bytes);
+            }
+        }
+        index->statistics.postings += trigram->count;
+        index->statistics.postingBytes += trigram->length;
+    }
+    index->firstSequence = index->floor;
+    index->statistics.compactions++;
+}
+
+void RTSPEventTextIndexDropBefore(RTSPEventTextIndexRef index, uint64_t sequence) {
+    if (!index || sequence <= index->floor) {
+        return;
+    }
+    index->floor = sequence;
+    if (index->lastSequence > index->firstSequence &&
+        (index->floor - index->firstSequence) * 4 >= index->lastSequence - index->firstSequence) {
+        RTSPEventTextIndexCompact(index);
+    }
+}
+
+#pragma mark - Queries
+
+bool RTSPEventTextContains(const char *text, size_t length, const char *query, size_t queryLength) {
+    if (queryLength == 0) {
+        return true;
+    }
+    if (!text || queryLength > length) {
+        return false;
+    }
+    const uint8_t *haystack = (const uint8_t *)text;
+    const uint8_t *needle = (const uint8_t *)query;
+    uint8_t first = RTSPEventTextFold(needle[0]);
+    for (size_t i = 0; i + queryLength <= length; i++) {
+        if (RTSPEventTextFold(haystack[i]) != first) {
+            continue;
+        }
+        size_t j = 1;
+        while (j < queryLength && RTSPEventTextFold(haystack[i + j]) == RTSPEventTextFold(needle[j])) {
+            j++;
+        }
+        if (j == queryLength) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool RTSPEventTextIndexCandidates(RTSPEventTextIndexRef index, const char *query, size_t length, uint64_t maxPostings,
+                                  uint64_t **candidates, size_t *count) {
+    *candidates = NULL;
+    *count = 0;
+    if (!index || !query || length < 3) {
+        return false;
+    }
+
+    // Distinct trigrams of the query, rarest first
+    const RTSPEventTrigram *lists[RTSP_EVENT_TEXT_INDEX_MAX_QUERY_TRIGRAMS];
+    size_t listCount = 0;
+    const uint8_t *bytes = (const uint8_t *)query;
+    for (size_t i = 0; i + 3 <= length && listCount < RTSP_EVENT_TEXT_INDEX_MAX_QUERY_TRIGRAMS; i++) {
+        uint8_t window[3] = {RTSPEventTextFold(bytes[i]), RTSPEventTextFold(bytes[i + 1]), RTSPEventTextFold(bytes[i + 2])};
+        const RTSPEventTrigram *trigram = RTSPEventTextIndexFind(index, RTSPEventTextKey(window), false);
+        if (!trigram || trigram->count == 0) {
+            return true;
+        }
+        size_t position = listCount;
+        bool duplicate = false;
+        for (size_t j = 0; j < listCount; j++) {
+            duplicate |= lists[j] == trigram;
+        }
+        if (duplicate) {
+            continue;
+        }
+        while (position > 0 && lists[position - 1]->count > trigram->count) {
+            lists[position] = lists[position - 1];
+            position--;
+        }
+        lists[position] = trigram;
+        listCount++;
+    }
+
+    uint64_t cost = 0;
+    for (size_t l = 0; l < listCount && l < RTSP_EVENT_TEXT_INDEX_MAX_LISTS; l++) {
+        cost += lists[l]->count;
+    }
+    if (maxPostings && cost > maxPostings) {
+        return false;
+    }
+
+    uint64_t *result = malloc(lists[0]->count * sizeof(*result));
+    if (!result) {
+        return false;
+    }
+    size_t resultCount = 0;
+    RTSPEventTrigramReader reader = RTSPEventTrigramRead(lists[0]);
+    while (RTSPEventTrigramNext(&reader)) {
+        if (reader.value >= index->floor) {
+            result[resultCount++] = reader.value;
+        }
+    }
+
+    // Merge-intersect in place against the next rarest lists
+    for (size_t l = 1; l < listCount && l < RTSP_EVENT_TEXT_INDEX_MAX_LISTS && resultCount > 0; l++) {
+        RTSPEventTrigramReader other = RTSPEventTrigramRead(lists[l]);
+        bool more = RTSPEventTrigramNext(&other);
+        size_t kept = 0;
+        for (size_t i = 0; i < resultCount && more; i++) {
+            while (more && other.value < result[i]) {
+                more = RTSPEventTrigramNext(&other);
+            }
+            if (more && other.value == result[i]) {
+                result[kept++] = result[i];
+            }
+        }
+        resultCount = kept;
+    }
+    if (resultCount == 0) {
+        free(result);
+        return true;
+    }
+    *candidates = result;
+    *count = resultCount;
+    return true;
+}
+
+RTSPEventTextIndexStatistics RTSPEventTextIndexGetStatistics(RTSPEventTextIndexRef index) {
+    RTSPEventTextIndexStatistics statistics;
+    memset(&statistics, 0, sizeof(statistics));
+    return index ? index->statistics : statistics;
+}
@@ -0,0 +1,68 @@
+//
+//  RTSPEventTextIndex.h
+//  RTSP Rotator
+//
+//  Trigram index over event titles and details for RTSPEventStore search.
+//  Every three-byte window of a text (ASCII case-folded) maps to the
+//  ascending sequence numbers of the events containing it, stored as
+//  delta-encoded varints. A substring query of three or more bytes is
+//  answered by intersecting the lists of its rarest trigrams; the result is
+//  a candidate set that callers verify against the text, since trigrams
+//  only prove the pieces occur, not in order.
+//
+//  Plain C. Not thread-safe: it belongs to the store and shares its queue.
+//
+
+#ifndef RTSPEventTextIndex_h
+#define RTSPEventTextIndex_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct RTSPEventTextIndex *RTSPEventTextIndexRef;
+
+typedef struct {
+    uint64_t documents;             // Events added
+    uint32_t trigrams;              // Distinct
+    uint64_t postings;
+    uint64_t postingBytes;
+    uint64_t compactions;
+} RTSPEventTextIndexStatistics;
+
+RTSPEventTextIndexRef RTSPEventTextIndexCreate(void);
+void RTSPEventTextIndexRelease(RTSPEventTextIndexRef index);
+
+/// Index text of an event. Sequence numbers must not decrease; several
+/// calls for one event (title, then details) are merged.
+bool RTSPEventTextIndexAdd(RTSPEventTextIndexRef index, uint64_t sequence, const char *text, size_t length);
+
+/// Forget events before a sequence number. Lists are compacted once a
+/// quarter of the indexed range is stale; until then the stale entries
+/// are skipped.
+void RTSPEventTextIndexDropBefore(RTSPEventTextIndexRef index, uint64_t sequence);
+
+void RTSPEventTextIndexClear(RTSPEventTextIndexRef index);
+
+/// Sequence numbers, ascending, of events that may contain the query
+/// (case-insensitive for ASCII). Returns false when the index cannot narrow
+/// the query: it is shorter than a trigram, or answering would decode more
+/// than `maxPostings` entries (0 = no limit). Otherwise the caller frees
+/// *candidates (NULL when there are none).
+bool RTSPEventTextIndexCandidates(RTSPEventTextIndexRef index, const char *query, size_t length, uint64_t maxPostings,
+                                  uint64_t **candidates, size_t *count);
+
+/// Case-insensitive (ASCII) substring test, the verification step
+bool RTSPEventTextContains(const char *text, size_t length, const char *query, size_t queryLength);
+
+RTSPEventTextIndexStatistics RTSPEventTextIndexGetStatistics(RTSPEventTextIndexRef index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RTSPEventTextIndex_h */
@@ -2,40 +2,72 @@
 //  RTSPFFmpegProxy.h
 //  RTSP Rotator
 //
-//  FFmpeg-based proxy for RTSPS streams with self-signed certificate support
-//  Converts RTSPS → local RTSP for AVFoundation compatibility
+//  RTSPS proxy: remuxes camera streams to local HLS for AVFoundation
+//  (historically one FFmpeg process per camera, now in-process)
 //
 
 #import <Foundation/Foundation.h>
+#import <CoreGraphics/CoreGraphics.h>
 
 NS_ASSUME_NONNULL_BEGIN
 
+/// Called on the main queue once the proxied stream is playable, or with an error
+typedef void (^RTSPProxyStartCompletion)(NSURL * _Nullable localURL, NSError * _Nullable error);
+
+/// Called on the main queue once a recording's file is closed, with its
+/// path and seconds of media, or with an error if it could not be written
+typedef void (^RTSPProxyRecordingCompletion)(NSString * _Nullable filePath, NSTimeInterval duration, NSError * _Nullable error);
+
+/// Posted on the main queue when a proxy's stream first becomes playable.
+/// userInfo: @"sourceURL" (NSURL), @"localURL" (NSURL), @"timeToFirstFrame" (NSNumber, seconds)
+extern NSString * const RTSPFFmpegProxyReadyNotification;
+
+/// A keyframe in a camera's DVR ring: where playback of a moment starts,
+/// found with one seek through the ring's index
+@interface RTSPDVRPosition : NSObject <NSSecureCoding>
+@property (nonatomic, readonly) uint64_t segment;       // Segment sequence number
+@property (nonatomic, readonly) uint64_t offset;        // Byte offset of the keyframe in the segment file
+@property (nonatomic, readonly) int64_t timestamp;      // The keyframe's wall clock, microseconds since 1970
+@property (nonatomic, readonly) NSDate *time;
+- (instancetype)initWithSegment:(uint64_t)segment offset:(uint64_t)offset timestamp:(int64_t)timestamp;
+- (instancetype)init NS_UNAVAILABLE;
+@end
+
 /**
- * @brief FFmpeg proxy that converts RTSPS streams to local RTSP streams
+ * @brief Proxy that converts RTSPS streams to local HLS streams
  *
- * This class solves the AVFoundation + RTSPS + self-signed certificate limitation
- * by running local FFmpeg processes that:
- * 1. Accept RTSPS streams with self-signed certificates
- * 2. Transcode to local RTSP streams
- * 3. AVFoundation plays the local streams
+ * AVFoundation cannot play RTSPS from cameras with self-signed certificates.
+ * All proxied cameras share a single in-process remux engine (RTSPRemuxEngine)
+ * that terminates RTSP/TLS on one event-loop thread and repackages the RTP
+ * video into fMP4 LL-HLS parts and segments without transcoding. Each
+ * camera's media lives in a bounded in-memory window (RTSPHLSStore) served by
+ * an embedded loopback HTTP server (RTSPHLSServer); nothing touches disk.
  *
  * Architecture:
  * @code
- * RTSPS Camera → FFmpeg Process → rtsp://localhost:PORT → AVFoundation ✅
- *    (port 7441)     (handles cert)     (local stream)      (can play!)
+ * RTSPS Cameras → RTSPRemuxEngine (1 thread) → RTSPHLSStore → RTSPHLSServer → AVFoundation
+ *  (port 7441)     (TLS + RTP → fMP4 parts)     (per camera)   (127.0.0.1:ephemeral)
  * @endcode
  *
+ * Each camera also feeds an RTSPClipRecorder that keeps the last
+ * preRollDuration seconds in RAM as whole GOPs and records to fragmented
+ * MP4 on request, by stream copy like the HLS output. With dvrDirectory
+ * set, every proxied camera is also recorded continuously to a ring of
+ * segment files on disk (RTSPDVRStore) that can be played back by time.
+ *
+ * Audio tracks are not proxied; the rotator plays video only.
+ *
  * Usage:
  * @code
  * RTSPFFmpegProxy *proxy = [RTSPFFmpegProxy sharedProxy];
  *
- * // Convert RTSPS URL to local RTSP
+ * // Convert RTSPS URL to a local HLS URL
  * NSURL *rtspsURL = [NSURL URLWithString:@"rtsps://10.0.0.1:7441/alias"];
- * NSURL *localURL = [proxy startProxyForURL:rtspsURL cameraName:@"Front Door"];
- *
- * // Use local URL with AVPlayer
- * AVPlayerItem *item = [AVPlayerItem playerItemWithURL:localURL];
- * [player replaceCurrentItemWithPlayerItem:item];
+ * [proxy startProxyForURL:rtspsURL cameraName:@"Front Door" completion:^(NSURL *localURL, NSError *error) {
+ *     // Use local URL with AVPlayer
+ *     AVPlayerItem *item = [AVPlayerItem playerItemWithURL:localURL];
+ *     [player replaceCurrentItemWithPlayerItem:item];
+ * }];
  * @endcode
  */
 @interface RTSPFFmpegProxy : NSObject
@@ -50,15 +82,31 @@ NS_ASSUME_NONNULL_BEGIN
 #pragma mark - Proxy Management
 
 /**
- * Start FFmpeg proxy for an RTSPS URL
+ * Start proxying an RTSPS URL without blocking the caller
  *
- * Creates a local RTSP stream that AVFoundation can play
+ * Adds the camera to the remux engine and completes as soon as its
+ * playlist holds enough media to start playback. Starts for different cameras proceed in
+ * parallel; a second start for a camera that is still connecting joins the
+ * first. On timeout the camera keeps reconnecting in the background and a
+ * later start completes immediately once it is ready.
  *
  * @param rtspsURL Original RTSPS URL (with self-signed cert)
  * @param cameraName Camera name for logging
- * @return Local RTSP URL (rtsp://localhost:PORT) or nil on failure
+ * @param timeout Seconds to wait for playable media
+ * @param completion Local HLS URL (http://127.0.0.1:PORT/cameraN/stream.m3u8),
+ *        or an error in the RTSPFFmpegProxy domain
+ */
+- (void)startProxyForURL:(NSURL *)rtspsURL
+              cameraName:(NSString *)cameraName
+                 timeout:(NSTimeInterval)timeout
+              completion:(RTSPProxyStartCompletion)completion;
+
+/**
+ * Start proxying with the default 10 second timeout
  */
-- (nullable NSURL *)startProxyForURL:(NSURL *)rtspsURL cameraName:(NSString *)cameraName;
+- (void)startProxyForURL:(NSURL *)rtspsURL
+              cameraName:(NSString *)cameraName
+              completion:(RTSPProxyStartCompletion)completion;
 
 /**
  * Stop proxy for a specific URL
@@ -84,30 +132,182 @@ NS_ASSUME_NONNULL_BEGIN
  * Get local URL for an RTSPS URL
  *
  * @param rtspsURL Original RTSPS URL
- * @return Local RTSP URL if proxy is running, nil otherwise
+ * @return Local HLS URL if proxy is running, nil otherwise
  */
 - (nullable NSURL *)localURLForRTSPSURL:(NSURL *)rtspsURL;
 
+#pragma mark - Recording
+
+/**
+ * Record a camera to a fragmented MP4 file until stopped
+ *
+ * The stream is copied as the camera sent it; nothing is re-encoded. The
+ * file opens at the keyframe of the current GOP, or with the whole
+ * pre-roll if includePreRoll is set.
+ *
+ * @param url The camera's RTSPS URL or its local HLS URL
+ * @param filePath Destination .mp4 file
+ * @param includePreRoll Start with the buffered pre-roll
+ * @param completion Called once the file is closed
+ * @return NO if the camera is not proxied, has sent no media yet or is
+ *         already recording; the completion is then never called
+ */
+- (BOOL)startRecordingForURL:(NSURL *)url
+                      toFile:(NSString *)filePath
+              includePreRoll:(BOOL)includePreRoll
+                  completion:(nullable RTSPProxyRecordingCompletion)completion;
+
+/**
+ * Record a motion or alert clip: the pre-roll, then postRollDuration
+ * seconds past the last trigger
+ *
+ * While the camera is already recording, the recording is extended (a
+ * triggered clip) or joined (a started one) and filePath is ignored; the
+ * completion then reports that recording's file.
+ *
+ * @param url The camera's RTSPS URL or its local HLS URL
+ * @param filePath Destination .mp4 file
+ * @param completion Called once the file is closed
+ * @return NO if the camera is not proxied or has sent no media yet
+ */
+- (BOOL)triggerClipForURL:(NSURL *)url
+                   toFile:(NSString *)filePath
+               completion:(nullable RTSPProxyRecordingCompletion)completion;
+
+/**
+ * End a camera's recording or clip, if any
+ */
+- (void)stopRecordingForURL:(NSURL *)url;
+
+#pragma mark - DVR
+
+/**
+ * Continuous recording held for a camera
+ *
+ * @param url The camera's RTSPS URL or its local HLS URL
+ * @return Keys: segments, start and end (seconds since 1970), bytes,
+ *         overwritten, droppedMedia, writeErrors; nil if the camera has no
+ *         DVR ring
+ */
+- (nullable NSDictionary *)dvrStatusForURL:(NSURL *)url;
+
+/**
+ * HLS playlist (EXT-X-PLAYLIST-TYPE:VOD) over a camera's recorded video
+ * between two times, starting playback at `start`
+ *
+ * Segment URIs are "<prefix>segments/<sequence><suffix>" and init segments
+ * "<prefix>init/<sequence><suffix>"; serve them with
+ * dvrSegmentForURL:sequence:initSegment:.
+ *
+ * @param start Earliest time, or nil for the oldest video held
+ * @param end Latest time, or nil for now
+ * @return nil if nothing was recorded in the range
+ */
+- (nullable NSData *)dvrPlaylistForURL:(NSURL *)url
+                                  from:(nullable NSDate *)start
+                                    to:(nullable NSDate *)end
+                             URIPrefix:(nullable NSString *)prefix
+                             URISuffix:(nullable NSString *)suffix;
+
+/**
+ * Media (moof + mdat fragments) or init segment of one recorded segment
+ *
+ * @return nil if the segment has been overwritten or never existed
+ */
+- (nullable NSData *)dvrSegmentForURL:(NSURL *)url sequence:(uint64_t)sequence initSegment:(BOOL)initSegment;
+
+/**
+ * The recorded keyframe at or before a time, to start playback from or to
+ * keep as a pointer into the recording (an event's, say). Cheap and
+ * non-blocking, so it can run on the main thread; only rings opened this
+ * session are searched.
+ *
+ * @return nil if the camera has no open DVR ring or it is empty
+ */
+- (nullable RTSPDVRPosition *)dvrPositionForURL:(NSURL *)url time:(NSDate *)time;
+
+/**
+ * Thumbnail of the keyframe at a position, decoded from the ring the first
+ * time it is asked for and cached in a sprite sheet next to it. Blocks, so
+ * call it off the main thread.
+ *
+ * @return nil if the position's segment has been overwritten
+ */
+- (nullable CGImageRef)copyDVRThumbnailForURL:(NSURL *)url position:(RTSPDVRPosition *)position CF_RETURNS_RETAINED;
+
+/**
+ * Strip of `count` thumbnails side by side for times spread evenly between
+ * two times, for a timeline. Times that land on the same keyframe share its
+ * cached thumbnail. Blocks, so call it off the main thread.
+ *
+ * @return nil if nothing was recorded in the range
+ */
+- (nullable CGImageRef)copyDVRTimelineForURL:(NSURL *)url
+                                        from:(NSDate *)start
+                                          to:(NSDate *)end
+                                       count:(NSUInteger)count CF_RETURNS_RETAINED;
+
 #pragma mark - Configuration
 
 /**
- * Base port for local RTSP servers
- * Default: 18554
- * Each proxy gets basePort + index
+ * Loopback port for the embedded HLS server, applied when the first proxy starts
+ * Default: 0 (any free port; the chosen port is part of each local URL)
  */
-@property (nonatomic, assign) NSInteger basePort;
+@property (nonatomic, assign) NSInteger httpPort;
 
 /**
- * Enable verbose FFmpeg logging
- * Default: NO
+ * Upper bound on media held in memory per camera, in bytes. The oldest
+ * segments are evicted first.
+ * Default: 32 MB
  */
-@property (nonatomic, assign) BOOL verboseLogging;
+@property (nonatomic, assign) NSUInteger maxBufferedBytesPerCamera;
+
+/**
+ * Seconds of video kept in RAM per camera ahead of a triggered clip,
+ * rounded up to whole GOPs. Applied to proxies started afterwards.
+ * Default: 15
+ */
+@property (nonatomic, assign) NSTimeInterval preRollDuration;
+
+/**
+ * Seconds a triggered clip runs past its last trigger. Applied to
+ * proxies started afterwards.
+ * Default: 10
+ */
+@property (nonatomic, assign) NSTimeInterval postRollDuration;
+
+/**
+ * Directory holding each camera's DVR ring, or nil to record nothing.
+ * Disk use is fixed per camera: dvrRetention × dvrMaxBitrate / 8, plus a
+ * third for headroom, allocated as the ring first fills. Applied to
+ * proxies started afterwards.
+ * Default: nil
+ */
+@property (nonatomic, copy, nullable) NSString *dvrDirectory;
+
+/**
+ * Seconds of video kept per camera; older video is overwritten. Changing it
+ * starts existing rings over.
+ * Default: 86400 (24 hours)
+ */
+@property (nonatomic, assign) NSTimeInterval dvrRetention;
+
+/**
+ * Highest camera bitrate the DVR reserves space for, in bits per second
+ * Default: 8,000,000
+ */
+@property (nonatomic, assign) NSUInteger dvrMaxBitrate;
 
 /**
- * FFmpeg path
- * Default: /opt/homebrew/bin/ffmpeg or /usr/local/bin/ffmpeg
+ * LL-HLS partial segment duration in seconds (0 = whole segments only)
  */
-@property (nonatomic, strong) NSString *ffmpegPath;
+@property (nonatomic, readonly) NSTimeInterval partTargetDuration;
+
+/**
+ * Log every segment written
+ * Default: NO
+ */
+@property (nonatomic, assign) BOOL verboseLogging;
 
 #pragma mark - Status
 
@@ -119,10 +319,20 @@ NS_ASSUME_NONNULL_BEGIN
 /**
  * Get status information for all proxies
  *
- * @return Array of dictionaries with proxy status
+ * @return Array of dictionaries with proxy status, including the remux
+ *         engine's per-stream state, codec and counters, the
+ *         recorder's pre-roll and recording state, and the DVR's span
  */
 - (NSArray<NSDictionary *> *)proxyStatus;
 
+/**
+ * Time-to-first-frame across proxy starts (start request → playable
+ * stream), over the most recent 64 starts
+ *
+ * Keys: count, timeouts, lastMs, meanMs, p50Ms, p95Ms, maxMs
+ */
+@property (nonatomic, readonly) NSDictionary<NSString *, NSNumber *> *startupMetrics;
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -2,32 +2,292 @@
 //  RTSPFFmpegProxy.m
 //  RTSP Rotator
 //
-//  FFmpeg-based proxy implementation for RTSPS stream conversion
+//  RTSPS → LL-HLS proxy backed by the in-process remux engine and an
+//  in-memory HLS server
 //
 
 #import "RTSPFFmpegProxy.h"
 #import "RTSPStatusWindow.h"
+#import "RTSPRemuxEngine.h"
+#import "RTSPHLSServer.h"
+#import "RTSPHLSStore.h"
+#import "RTSPClipRecorder.h"
+#import "RTSPDVRStore.h"
+#import "RTSPDVRThumbnailer.h"
+#import <stdatomic.h>
+
+NSString * const RTSPFFmpegProxyReadyNotification = @"RTSPFFmpegProxyReadyNotification";
+
+/// Default wait for the first playable media
+static const NSTimeInterval RTSPProxyStartupTimeout = 10.0;
+
+/// Startup latency samples kept for startupMetrics
+static const NSUInteger RTSPProxyStartupSampleCount = 64;
+
+#pragma mark - HLS Output
+
+/// Receives engine callbacks for one camera and feeds its in-memory HLS
+/// window, clip recorder and DVR ring. Runs on the engine thread; the store
+/// and the recorder do their own locking, the DVR is appended to on dvrQueue.
+@interface RTSPProxyHLSOutput : NSObject
+@property (nonatomic, assign) RTSPHLSStoreRef store;
+@property (nonatomic, assign) RTSPClipRecorderRef recorder;
+@property (nonatomic, assign) BOOL recordsParts;                    // Engine emits parts; record those, not segments
+@property (nonatomic, assign) RTSPDVRStoreRef dvr;                  // Retained; NULL when continuous recording is off
+@property (nonatomic, strong) dispatch_queue_t dvrQueue;
+@property (nonatomic, assign) size_t maxDVRBacklog;                 // Bytes queued for the disk before media is dropped
+@property (nonatomic, strong) NSMutableDictionary<NSNumber *, NSMutableArray<RTSPProxyRecordingCompletion> *> *recordingCompletions;
+@property (nonatomic, strong) NSString *cameraName;
+@property (atomic, copy, nullable) dispatch_block_t readyHandler;    // Once, on the engine thread
+@property (atomic, assign) CFAbsoluteTime firstKeyframeTime;
+@property (atomic, copy) NSString *lastError;
+@property (nonatomic, assign) BOOL verboseLogging;
+@end
+
+@implementation RTSPProxyHLSOutput {
+    atomic_size_t _dvrBacklog;
+    BOOL _dvrDropping;              // Engine thread only
+}
+
+- (void)dealloc {
+    RTSPClipRecorderRelease(_recorder);
+    RTSPDVRStoreRelease(_dvr);
+    RTSPHLSStoreRelease(_store);
+}
+
+- (void)recordInitSegment:(uint32_t)initID data:(const uint8_t *)data length:(size_t)length {
+    RTSPDVRStoreRef dvr = self.dvr;
+    NSData *bytes = [NSData dataWithBytes:data length:length];
+    dispatch_async(self.dvrQueue, ^{
+        RTSPDVRStoreAddInitSegment(dvr, initID, bytes.bytes, bytes.length);
+    });
+}
+
+/// Copies the media for the DVR queue so the engine thread never waits for
+/// the disk. A disk that falls behind by maxDVRBacklog loses media, and the
+/// ring resumes at the next keyframe.
+- (void)recordMedia:(const RTSPRemuxMediaInfo *)info data:(const uint8_t *)data length:(size_t)length {
+    if (atomic_load_explicit(&_dvrBacklog, memory_order_relaxed) + length > self.maxDVRBacklog) {
+        _dvrDropping = YES;
+        return;
+    }
+    BOOL cut = _dvrDropping;
+    _dvrDropping = NO;
+    atomic_fetch_add_explicit(&_dvrBacklog, length, memory_order_relaxed);
+
+    RTSPDVRStoreRef dvr = self.dvr;
+    RTSPRemuxMediaInfo media = *info;
+    NSData *bytes = [NSData dataWithBytes:data length:length];
+    // The callback follows the media's last sample
+    int64_t time = (int64_t)((CFAbsoluteTimeGetCurrent() + kCFAbsoluteTimeIntervalSince1970 - info->duration) * 1e6);
+    dispatch_async(self.dvrQueue, ^{
+        if (cut) {
+            RTSPDVRStoreCut(dvr);
+        }
+        RTSPDVRStoreAddMedia(dvr, &media, bytes.bytes, bytes.length, time);
+        atomic_fetch_sub_explicit(&self->_dvrBacklog, bytes.length, memory_order_relaxed);
+    });
+}
+
+- (void)signalReadyIfPlayable {
+    dispatch_block_t ready = self.readyHandler;
+    if (ready && RTSPHLSStoreIsPlayable(self.store)) {
+        self.readyHandler = nil;
+        ready();
+    }
+}
+
+@end
+
+static void RTSPProxyInitSegment(void *context, uint32_t initID, const uint8_t *data, size_t length) {
+    RTSPProxyHLSOutput *output = (__bridge RTSPProxyHLSOutput *)context;
+    if (output.firstKeyframeTime == 0) {
+        output.firstKeyframeTime = CFAbsoluteTimeGetCurrent();
+    }
+    RTSPHLSStoreAddInitSegment(output.store, initID, data, length);
+    if (output.recorder) {
+        RTSPClipRecorderAddInitSegment(output.recorder, initID, data, length);
+    }
+    if (output.dvr) {
+        [output recordInitSegment:initID data:data length:length];
+    }
+}
+
+static void RTSPProxyPart(void *context, const RTSPRemuxMediaInfo *info, const uint8_t *data, size_t length) {
+    RTSPProxyHLSOutput *output = (__bridge RTSPProxyHLSOutput *)context;
+    RTSPHLSStoreAddPart(output.store, info, data, length);
+    if (output.recorder && output.recordsParts) {
+        RTSPClipRecorderAddMedia(output.recorder, info, data, length);
+    }
+    if (output.dvr && output.recordsParts) {
+        [output recordMedia:info data:data length:length];
+    }
+    [output signalReadyIfPlayable];
+}
+
+static void RTSPProxySegment(void *context, const RTSPRemuxMediaInfo *info, const uint8_t *data, size_t length) {
+    RTSPProxyHLSOutput *output = (__bridge RTSPProxyHLSOutput *)context;
+    RTSPHLSStoreAddSegment(output.store, info, data, length);
+    if (output.recorder && !output.recordsParts) {
+        RTSPClipRecorderAddMedia(output.recorder, info, data, length);
+    }
+    if (output.dvr && !output.recordsParts) {
+        [output recordMedia:info data:data length:length];
+    }
+    [output signalReadyIfPlayable];
+    if (output.verboseLogging) {
+        NSLog(@"[FFmpegProxy] %@ segment %u (%.2fs, %u parts, %lu bytes)",
+              output.cameraName, info->sequence, info->duration, info->part, (unsigned long)length);
+    }
+}
+
+/// Runs on the recorder's writer thread once a clip's file is closed
+static void RTSPProxyClipFinished(void *context, const RTSPClipInfo *clip) {
+    RTSPProxyHLSOutput *output = (__bridge RTSPProxyHLSOutput *)context;
+    NSArray<RTSPProxyRecordingCompletion> *completions = nil;
+    @synchronized (output.recordingCompletions) {
+        completions = output.recordingCompletions[@(clip->clipID)];
+        [output.recordingCompletions removeObjectForKey:@(clip->clipID)];
+    }
+
+    NSString *path = @(clip->path);
+    NSTimeInterval duration = clip->duration;
+    NSError *error = nil;
+    switch (clip->reason) {
+        case RTSPClipEndWriteFailed:
+            error = [NSError errorWithDomain:NSPOSIXErrorDomain code:clip->error userInfo:@{
+                NSLocalizedDescriptionKey: [NSString stringWithFormat:@"Could not write %@: %s", path.lastPathComponent, strerror(clip->error)]
+            }];
+            NSLog(@"[FFmpegProxy] ✗ %@ recording failed: %@", output.cameraName, error.localizedDescription);
+            break;
+        case RTSPClipEndConfigurationChanged:
+            NSLog(@"[FFmpegProxy] %@ changed codec or resolution; recording ended after %.1fs", output.cameraName, duration);
+            break;
+        default:
+            NSLog(@"[FFmpegProxy] ✓ %@ recorded %.1fs (%.1fs pre-roll, %.1f MB) to %@",
+                  output.cameraName, duration, clip->preRoll, clip->bytes / (1024.0 * 1024.0), path);
+            break;
+    }
+
+    dispatch_async(dispatch_get_main_queue(), ^{
+        for (RTSPProxyRecordingCompletion completion in completions) {
+            completion(error ? nil : path, duration, error);
+        }
+    });
+}
+
+static void RTSPProxyStateChanged(void *context, RTSPRemuxStreamState state, const char *message) {
+    RTSPProxyHLSOutput *output = (__bridge RTSPProxyHLSOutput *)context;
+    NSString *camera = output.cameraName;
+    RTSPStatusWindow *statusWindow = [RTSPStatusWindow sharedWindow];
+
+    switch (state) {
+        case RTSPRemuxStreamPlaying:
+            output.lastError = nil;
+            NSLog(@"[FFmpegProxy] ✓ %@ streaming", camera);
+            [statusWindow appendLog:[NSString stringWithFormat:@"✓ %@ streaming", camera] level:@"SUCCESS"];
+            break;
+        case RTSPRemuxStreamReconnecting: {
+            NSString *reason = message ? @(message) : @"Connection lost";
+            output.lastError = reason;
+            NSLog(@"[FFmpegProxy] %@: %@ - reconnecting", camera, reason);
+            [statusWindow appendLog:[NSString stringWithFormat:@"%@: %@ - reconnecting", camera, reason] level:@"ERROR"];
+            break;
+        }
+        default:
+            if (output.verboseLogging) {
+                NSLog(@"[FFmpegProxy] %@ state %d", camera, (int)state);
+            }
+            break;
+    }
+}
+
+#pragma mark - Proxy Instance
 
 @interface RTSPProxyInstance : NSObject
 @property (nonatomic, strong) NSURL *sourceURL;
 @property (nonatomic, strong) NSURL *localURL;
 @property (nonatomic, strong) NSString *cameraName;
-@property (nonatomic, strong) NSTask *ffmpegTask;
-@property (nonatomic, assign) NSInteger localPort;
+@property (nonatomic, strong) NSString *streamName;
 @property (nonatomic, assign) BOOL isRunning;
-@property (nonatomic, strong) NSString *logFilePath;
+@property (nonatomic, assign) uint32_t streamID;
+@property (nonatomic, strong) RTSPProxyHLSOutput *output;
+@property (nonatomic, assign) CFAbsoluteTime startTime;
+@property (nonatomic, assign) BOOL ready;
+@property (nonatomic, assign) NSTimeInterval timeToFirstFrame;
+@property (nonatomic, assign) NSTimeInterval timeToFirstKeyframe;
+@property (nonatomic, strong) NSMutableArray<RTSPProxyStartCompletion> *pendingCompletions;
 @end
 
 @implementation RTSPProxyInstance
 @end
 
+@implementation RTSPDVRPosition
+
++ (BOOL)supportsSecureCoding {
+    return YES;
+}
+
+- (instancetype)initWithSegment:(uint64_t)segment offset:(uint64_t)offset timestamp:(int64_t)timestamp {
+    self = [super init];
+    if (self) {
+        _segment = segment;
+        _offset = offset;
+        _timestamp = timestamp;
+    }
+    return self;
+}
+
+- (NSDate *)time {
+    return [NSDate dateWithTimeIntervalSince1970:(NSTimeInterval)self.timestamp / 1e6];
+}
+
+- (void)encodeWithCoder:(NSCoder *)coder {
+    [coder encodeInt64:(int64_t)self.segment forKey:@"segment"];
+    [coder encodeInt64:(int64_t)self.offset forKey:@"offset"];
+    [coder encodeInt64:self.timestamp forKey:@"timestamp"];
+}
+
+- (nullable instancetype)initWithCoder:(NSCoder *)coder {
+    return [self initWithSegment:(uint64_t)[coder decodeInt64ForKey:@"segment"]
+                          offset:(uint64_t)[coder decodeInt64ForKey:@"offset"]
+                       timestamp:[coder decodeInt64ForKey:@"timestamp"]];
+}
+
+- (BOOL)isEqual:(id)object {
+    if (![object isKindOfClass:[RTSPDVRPosition class]]) {
+        return NO;
+    }
+    RTSPDVRPosition *other = object;
+    return other.segment == self.segment && other.offset == self.offset && other.timestamp == self.timestamp;
+}
+
+- (NSUInteger)hash {
+    return (NSUInteger)(self.segment * 31 + self.offset);
+}
+
+- (NSString *)description {
+    return [NSString stringWithFormat:@"<RTSPDVRPosition segment %llu @%llu, %@>",
+            (unsigned long long)self.segment, (unsigned long long)self.offset, self.time];
+}
+
+@end
+
 @interface RTSPFFmpegProxy ()
 @property (nonatomic, strong) NSMutableDictionary<NSString *, RTSPProxyInstance *> *proxies;
 @property (nonatomic, strong) dispatch_queue_t proxyQueue;
-@property (nonatomic, assign) NSInteger nextPort;
+@property (nonatomic, assign) NSUInteger nextStreamNumber;
+@property (nonatomic, strong) NSMutableArray<NSNumber *> *startupSamples;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSValue *> *dvrStores;   // Camera key → RTSPDVRStoreRef, kept across proxy restarts
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSValue *> *dvrRings;     // Camera key or local URL → open ring, for lookups off proxyQueue; @synchronized
+@property (nonatomic, strong) NSMutableDictionary<NSString *, RTSPDVRThumbnailer *> *dvrThumbnailers;   // Camera key → timeline thumbnails, made on first use
+@property (nonatomic, assign) NSUInteger startupTimeouts;
 @end
 
-@implementation RTSPFFmpegProxy
+@implementation RTSPFFmpegProxy {
+    RTSPRemuxEngineRef _engine;
+    RTSPHLSServerRef _server;       // Created on first use, on proxyQueue
+}
 
 #pragma mark - Singleton
 
@@ -45,54 +305,75 @@
     if (self) {
         _proxies = [NSMutableDictionary dictionary];
         _proxyQueue = dispatch_queue_create("com.rtsp-rotator.ffmpeg-proxy", DISPATCH_QUEUE_SERIAL);
-        _basePort = 18554;
-        _nextPort = _basePort;
+        _httpPort = 0;
+        _maxBufferedBytesPerCamera = 32 * 1024 * 1024;
+        _nextStreamNumber = 1;
         _verboseLogging = NO;
-
-        // Find FFmpeg
-        _ffmpegPath = [self detectFFmpegPath];
-
-        NSLog(@"[FFmpegProxy] Initialized with FFmpeg at: %@", _ffmpegPath);
+        _preRollDuration = 15.0;
+        _postRollDuration = 10.0;
+        _startupSamples = [NSMutableArray array];
+        _dvrStores = [NSMutableDictionary dictionary];
+        _dvrRings = [NSMutableDictionary dictionary];
+        _dvrThumbnailers = [NSMutableDictionary dictionary];
+        _dvrRetention = 24 * 60 * 60;
+        _dvrMaxBitrate = 8000000;
+
+        // LL-HLS parts; the stores advertise the same PART-TARGET
+        RTSPRemuxConfig config;
+        RTSPRemuxConfigInit(&config);
+        _engine = RTSPRemuxEngineCreate(&config);
+        _partTargetDuration = config.partTargetDuration;
+
+        NSLog(@"[FFmpegProxy] Initialized in-process remux engine%@", _engine ? @"" : @" - FAILED");
     }
     return self;
 }
 
-- (NSString *)detectFFmpegPath {
-    NSArray *possiblePaths = @[
-        @"/opt/homebrew/bin/ffmpeg",
-        @"/usr/local/bin/ffmpeg",
-        @"/usr/bin/ffmpeg"
-    ];
-
-    for (NSString *path in possiblePaths) {
-        if ([[NSFileManager defaultManager] fileExistsAtPath:path]) {
-            NSLog(@"[FFmpegProxy] Found FFmpeg at: %@", path);
-            return path;
-        }
-    }
+#pragma mark - Proxy Management
 
-    NSLog(@"[FFmpegProxy] WARNING: FFmpeg not found in standard locations");
-    return @"/opt/homebrew/bin/ffmpeg"; // Default
+- (void)startProxyForURL:(NSURL *)rtspsURL
+              cameraName:(NSString *)cameraName
+              completion:(RTSPProxyStartCompletion)completion {
+    [self startProxyForURL:rtspsURL cameraName:cameraName timeout:RTSPProxyStartupTimeout completion:completion];
 }
 
-#pragma mark - Proxy Management
-
-- (nullable NSURL *)startProxyForURL:(NSURL *)rtspsURL cameraName:(NSString *)cameraName {
+- (void)startProxyForURL:(NSURL *)rtspsURL
+              cameraName:(NSString *)cameraName
+                 timeout:(NSTimeInterval)timeout
+              completion:(RTSPProxyStartCompletion)completion {
     if (!rtspsURL) {
         NSLog(@"[FFmpegProxy] ERROR: nil URL provided");
-        return nil;
+        [self completeStart:completion URL:nil error:[self errorWithCode:1001 description:@"No URL provided"]];
+        return;
     }
 
-    __block NSURL *localURL = nil;
-
-    dispatch_sync(self.proxyQueue, ^{
+    dispatch_async(self.proxyQueue, ^{
         NSString *urlKey = rtspsURL.absoluteString;
 
-        // Check if proxy already exists
+        // Join an existing proxy, ready or still connecting
         RTSPProxyInstance *existing = self.proxies[urlKey];
         if (existing && existing.isRunning) {
-            NSLog(@"[FFmpegProxy] Proxy already running for %@", cameraName);
-            localURL = existing.localURL;
+            if (existing.ready) {
+                [self completeStart:completion URL:existing.localURL error:nil];
+            } else {
+                NSLog(@"[FFmpegProxy] Proxy already starting for %@", cameraName);
+                RTSPProxyStartCompletion pending = [completion copy];
+                [existing.pendingCompletions addObject:pending];
+                [self scheduleTimeout:timeout forCompletion:pending proxy:existing];
+            }
+            return;
+        }
+
+        RTSPStatusWindow *statusWindow = [RTSPStatusWindow sharedWindow];
+        if (!self->_engine) {
+            [statusWindow appendLog:@"✗ Remux engine unavailable" level:@"ERROR"];
+            [self completeStart:completion URL:nil error:[self errorWithCode:1001 description:@"Remux engine unavailable"]];
+            return;
+        }
+
+        if (![self startServerIfNeeded]) {
+            [statusWindow appendLog:@"✗ Local HLS server could not start" level:@"ERROR"];
+            [self completeStart:completion URL:nil error:[self errorWithCode:1001 description:@"Local HLS server unavailable"]];
             return;
         }
 
@@ -100,179 +381,214 @@
         RTSPProxyInstance *proxy = [[RTSPProxyInstance alloc] init];
         proxy.sourceURL = rtspsURL;
         proxy.cameraName = cameraName;
-        proxy.localPort = self.nextPort++;
-        proxy.localURL = [NSURL URLWithString:[NSString stringWithFormat:@"rtsp://localhost:%ld", (long)proxy.localPort]];
+        proxy.streamName = [NSString stringWithFormat:@"camera%lu", (unsigned long)self.nextStreamNumber++];
+        proxy.startTime = CFAbsoluteTimeGetCurrent();
+        RTSPProxyStartCompletion pending = [completion copy];
+        proxy.pendingCompletions = [NSMutableArray arrayWithObject:pending];
+
+        // Bounded in-memory window for this camera, served by the embedded server
+        RTSPHLSStoreConfig storeConfig;
+        RTSPHLSStoreConfigInit(&storeConfig);
+        storeConfig.maxBytes = (size_t)self.maxBufferedBytesPerCamera;
+        storeConfig.partTargetDuration = self.partTargetDuration;
+        RTSPProxyHLSOutput *output = [[RTSPProxyHLSOutput alloc] init];
+        output.store = RTSPHLSStoreCreate(&storeConfig);
+        output.cameraName = cameraName;
+        output.verboseLogging = self.verboseLogging;
+
+        // Stream-copy recorder holding the pre-roll for triggered clips
+        RTSPClipRecorderConfig recorderConfig;
+        RTSPClipRecorderConfigInit(&recorderConfig);
+        recorderConfig.preRollDuration = self.preRollDuration;
+        recorderConfig.maxPreRollBytes = (size_t)self.maxBufferedBytesPerCamera;
+        recorderConfig.postRollDuration = self.postRollDuration;
+        output.recordingCompletions = [NSMutableDictionary dictionary];
+        output.recordsParts = self.partTargetDuration > 0;
+        output.recorder = RTSPClipRecorderCreate(&recorderConfig, RTSPProxyClipFinished, (__bridge void *)output);
+
+        // Continuous recording to the camera's ring on disk, if enabled
+        output.dvr = RTSPDVRStoreRetain([self dvrStoreForURL:rtspsURL create:YES]);
+        if (output.dvr) {
+            output.dvrQueue = dispatch_queue_create("com.rtsp-rotator.dvr", dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_SERIAL, QOS_CLASS_UTILITY, 0));
+            output.maxDVRBacklog = self.maxBufferedBytesPerCamera;
+        }
+
+        if (!output.store || !output.recorder || !RTSPHLSServerPublish(self->_server, proxy.streamName.UTF8String, output.store)) {
+            [self completeStart:completion URL:nil error:[self errorWithCode:1001 description:@"Out of memory"]];
+            return;
+        }
+
+        // Use 127.0.0.1 instead of localhost to force IPv4 (avoids IPv6 connection refused)
+        NSString *httpURL = [NSString stringWithFormat:@"http://127.0.0.1:%u/%@/stream.m3u8",
+                             RTSPHLSServerPort(self->_server), proxy.streamName];
+        proxy.localURL = [NSURL URLWithString:httpURL];
+        if (output.dvr) {
+            @synchronized (self.dvrRings) {
+                self.dvrRings[httpURL] = [NSValue valueWithPointer:output.dvr];
+            }
+        }
+
+        __weak typeof(self) weakSelf = self;
+        __weak RTSPProxyInstance *weakProxy = proxy;
+        output.readyHandler = ^{
+            // Enough media is buffered to start playback; hand over to the proxy queue
+            dispatch_async(weakSelf.proxyQueue, ^{
+                RTSPProxyInstance *readyProxy = weakProxy;
+                if (readyProxy) {
+                    [weakSelf proxyBecameReady:readyProxy];
+                }
+            });
+        };
+        proxy.output = output;
+
+        RTSPRemuxSink sink = {
+            .initSegment = RTSPProxyInitSegment,
+            .part = RTSPProxyPart,
+            .segment = RTSPProxySegment,
+            .stateChanged = RTSPProxyStateChanged,
+        };
+
+        // Credentials stay inside the URL handed to the engine; nothing is
+        // exposed in a process argument list any more.
+        proxy.streamID = RTSPRemuxEngineAddStream(self->_engine, rtspsURL.absoluteString.UTF8String,
+                                                  &sink, (__bridge void *)output);
+        if (proxy.streamID == 0) {
+            NSLog(@"[FFmpegProxy] ERROR: Remux engine rejected URL for %@", cameraName);
+            [statusWindow appendLog:[NSString stringWithFormat:@"✗ Invalid stream URL for %@", cameraName] level:@"ERROR"];
+            RTSPHLSServerUnpublish(self->_server, proxy.streamName.UTF8String);
+            [self completeStart:completion URL:nil error:[self errorWithCode:1001 description:@"Invalid stream URL"]];
+            return;
+        }
+
+        proxy.isRunning = YES;
+        self.proxies[urlKey] = proxy;
+        [self scheduleTimeout:timeout forCompletion:pending proxy:proxy];
 
         NSLog(@"[FFmpegProxy] Starting proxy for %@", cameraName);
-        NSLog(@"[FFmpegProxy]   Source: %@", rtspsURL.absoluteString);
         NSLog(@"[FFmpegProxy]   Local:  %@", proxy.localURL.absoluteString);
+        [statusWindow appendLog:[NSString stringWithFormat:@"Remuxing %@ → %@", cameraName, proxy.localURL.absoluteString] level:@"INFO"];
+    });
+}
 
-        RTSPStatusWindow *statusWindow = [RTSPStatusWindow sharedWindow];
+/// Must be called on proxyQueue
+- (BOOL)startServerIfNeeded {
+    if (_server) {
+        return YES;
+    }
+    RTSPHLSServerConfig config;
+    RTSPHLSServerConfigInit(&config);
+    config.port = (uint16_t)self.httpPort;
+    _server = RTSPHLSServerCreate(&config);
+    if (!_server) {
+        NSLog(@"[FFmpegProxy] ERROR: Could not bind local HLS server (port %ld)", (long)self.httpPort);
+        return NO;
+    }
+    NSLog(@"[FFmpegProxy] Serving HLS from memory on http://127.0.0.1:%u", RTSPHLSServerPort(_server));
+    return YES;
+}
 
-        // Create HLS output directory for this camera
-        NSString *hlsDir = [NSString stringWithFormat:@"/tmp/rtsp_hls_%ld", (long)proxy.localPort];
-        NSError *dirError = nil;
-        [[NSFileManager defaultManager] createDirectoryAtPath:hlsDir withIntermediateDirectories:YES attributes:nil error:&dirError];
+#pragma mark - Readiness
 
-        if (dirError) {
-            NSLog(@"[FFmpegProxy] ERROR: Could not create HLS directory: %@", dirError);
-            [statusWindow appendLog:[NSString stringWithFormat:@"✗ HLS directory creation failed: %@", dirError.localizedDescription] level:@"ERROR"];
-            return; // Just return from block, localURL stays nil
-        }
+- (NSError *)errorWithCode:(NSInteger)code description:(NSString *)description {
+    return [NSError errorWithDomain:@"RTSPFFmpegProxy" code:code userInfo:@{NSLocalizedDescriptionKey: description}];
+}
 
-        [statusWindow appendLog:[NSString stringWithFormat:@"✓ HLS directory created: %@", hlsDir] level:@"SUCCESS"];
+- (void)completeStart:(RTSPProxyStartCompletion)completion URL:(nullable NSURL *)url error:(nullable NSError *)error {
+    if (!completion) return;
+    dispatch_async(dispatch_get_main_queue(), ^{
+        completion(url, error);
+    });
+}
 
-        NSString *hlsPlaylist = [hlsDir stringByAppendingPathComponent:@"stream.m3u8"];
-        NSString *ffmpegLogFile = [hlsDir stringByAppendingPathComponent:@"ffmpeg.log"];
-        proxy.logFilePath = ffmpegLogFile;
+/// Must be called on proxyQueue
+- (void)flushCompletionsForProxy:(RTSPProxyInstance *)proxy URL:(nullable NSURL *)url error:(nullable NSError *)error {
+    NSArray<RTSPProxyStartCompletion> *completions = [proxy.pendingCompletions copy];
+    [proxy.pendingCompletions removeAllObjects];
+    for (RTSPProxyStartCompletion completion in completions) {
+        [self completeStart:completion URL:url error:error];
+    }
+}
 
-        // Update local URL to point to HLS playlist via HTTP server
-        // Extract directory name (e.g., "rtsp_hls_18554")
-        // Use 127.0.0.1 instead of localhost to force IPv4 (avoids IPv6 connection refused)
-        NSString *hlsDirName = [hlsDir lastPathComponent];
-        NSString *httpURL = [NSString stringWithFormat:@"http://127.0.0.1:8080/%@/stream.m3u8", hlsDirName];
-        proxy.localURL = [NSURL URLWithString:httpURL];
+/// Must be called on proxyQueue. Fails only this caller; the stream keeps
+/// connecting so a later start can still join it.
+- (void)scheduleTimeout:(NSTimeInterval)timeout forCompletion:(RTSPProxyStartCompletion)completion proxy:(RTSPProxyInstance *)proxy {
+    __weak typeof(self) weakSelf = self;
+    __weak RTSPProxyInstance *weakProxy = proxy;
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(timeout * NSEC_PER_SEC)), self.proxyQueue, ^{
+        RTSPProxyInstance *timedOut = weakProxy;
+        NSUInteger index = [timedOut.pendingCompletions indexOfObjectIdenticalTo:completion];
+        if (!timedOut || index == NSNotFound) {
+            return; // Ready or stopped in the meantime
+        }
+        [timedOut.pendingCompletions removeObjectAtIndex:index];
+        weakSelf.startupTimeouts++;
 
-        // Extract credentials from URL and pass via environment variables
-        // instead of exposing them in the process argument list.
-        NSURLComponents *components = [NSURLComponents componentsWithURL:rtspsURL resolvingAgainstBaseURL:NO];
-        NSString *rtspUser = components.user ?: @"";
-        NSString *rtspPass = components.percentEncodedPassword ?: @"";
-
-        // Build a sanitized URL (without userinfo) for the argument list
-        components.user = nil;
-        components.password = nil;
-        NSString *sanitizedURLString = components.URL ? components.URL.absoluteString : rtspsURL.absoluteString;
-
-        // Create FFmpeg task using helper script (bypasses NSTask network restrictions)
-        NSTask *task = [[NSTask alloc] init];
-        task.launchPath = @"/bin/bash";
-        task.arguments = @[
-            @"/tmp/ffmpeg_camera_proxy.sh",
-            sanitizedURLString,
-            hlsDir,
-            ffmpegLogFile
-        ];
-
-        // Pass credentials through environment variables so they don't appear
-        // in the process argument list visible via `ps`.
-        NSMutableDictionary *env = [[[NSProcessInfo processInfo] environment] mutableCopy];
-        env[@"RTSP_USER"] = rtspUser;
-        env[@"RTSP_PASSWORD"] = rtspPass;
-        task.environment = env;
-
-        // Capture output to both log file AND console
-        NSPipe *outputPipe = [NSPipe pipe];
-        task.standardOutput = outputPipe;
-        task.standardError = outputPipe;
-
-        // Monitor FFmpeg output continuously and write to log file
-        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_LOW, 0), ^{
-            NSFileHandle *handle = [outputPipe fileHandleForReading];
-            NSFileHandle *logFile = [NSFileHandle fileHandleForWritingAtPath:ffmpegLogFile];
-            if (!logFile) {
-                [[NSFileManager defaultManager] createFileAtPath:ffmpegLogFile contents:nil attributes:nil];
-                logFile = [NSFileHandle fileHandleForWritingAtPath:ffmpegLogFile];
-            }
+        NSString *reason = timedOut.output.lastError ?: @"still connecting";
+        NSLog(@"[FFmpegProxy] ⚠ WARNING: No playable HLS media after %.0fs for %@ (%@)", timeout, timedOut.cameraName, reason);
+        NSString *description = [NSString stringWithFormat:@"Timed out waiting for %@ (%@)", timedOut.cameraName, reason];
+        [weakSelf completeStart:completion URL:nil error:[weakSelf errorWithCode:1002 description:description]];
+    });
+}
 
-            NSLog(@"[FFmpegProxy] Logging FFmpeg output to: %@", ffmpegLogFile);
-            [statusWindow appendLog:[NSString stringWithFormat:@"FFmpeg log: %@", ffmpegLogFile] level:@"INFO"];
-
-            // Read continuously until task ends
-            while (task.isRunning) {
-                @autoreleasepool {
-                    NSData *data = [handle availableData];
-                    if (data.length > 0) {
-                        NSString *output = [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
-
-                        // Log to console
-                        NSLog(@"[FFmpegProxy] %@ OUTPUT: %@", cameraName, output);
-
-                        // Write to file
-                        if (logFile) {
-                            [logFile writeData:data];
-                        }
-
-                        // Show in status window
-                        NSArray *lines = [output componentsSeparatedByString:@"\n"];
-                        for (NSString *line in lines) {
-                            if (line.length > 0 && ![line containsString:@"frame="]) {
-                                [statusWindow appendLog:[NSString stringWithFormat:@"[FFmpeg] %@", line] level:@"INFO"];
-                            }
-                        }
-                    }
-                    usleep(100000); // 0.1 second
-                }
-            }
+/// Must be called on proxyQueue
+- (void)proxyBecameReady:(RTSPProxyInstance *)proxy {
+    if (proxy.ready || !proxy.isRunning) {
+        return;
+    }
+    proxy.ready = YES;
+    proxy.timeToFirstFrame = CFAbsoluteTimeGetCurrent() - proxy.startTime;
+    if (proxy.output.firstKeyframeTime > 0) {
+        proxy.timeToFirstKeyframe = proxy.output.firstKeyframeTime - proxy.startTime;
+    }
 
-            // Read any final output after termination
-            NSData *finalData = [handle readDataToEndOfFile];
-            if (finalData.length > 0) {
-                NSString *output = [[NSString alloc] initWithData:finalData encoding:NSUTF8StringEncoding];
-                NSLog(@"[FFmpegProxy] %@ FINAL OUTPUT: %@", cameraName, output);
-                [statusWindow appendLog:[NSString stringWithFormat:@"[FFmpeg] FINAL: %@", output] level:@"ERROR"];
+    [self.startupSamples addObject:@(proxy.timeToFirstFrame)];
+    if (self.startupSamples.count > RTSPProxyStartupSampleCount) {
+        [self.startupSamples removeObjectAtIndex:0];
+    }
 
-                if (logFile) {
-                    [logFile writeData:finalData];
-                }
-            }
+    NSLog(@"[FFmpegProxy] ✓ %@ ready in %.0f ms (first keyframe after %.0f ms)",
+          proxy.cameraName, proxy.timeToFirstFrame * 1000.0, proxy.timeToFirstKeyframe * 1000.0);
+    [self flushCompletionsForProxy:proxy URL:proxy.localURL error:nil];
+
+    NSDictionary *userInfo = @{
+        @"sourceURL": proxy.sourceURL,
+        @"localURL": proxy.localURL,
+        @"timeToFirstFrame": @(proxy.timeToFirstFrame)
+    };
+    dispatch_async(dispatch_get_main_queue(), ^{
+        [[NSNotificationCenter defaultCenter] postNotificationName:RTSPFFmpegProxyReadyNotification
+                                                            object:self
+                                                          userInfo:userInfo];
+    });
+}
 
-            if (logFile) {
-                [logFile closeFile];
-            }
+#pragma mark - Proxy Lifecycle
 
-            // Log termination
-            int exitCode = task.terminationStatus;
-            NSLog(@"[FFmpegProxy] %@ terminated with exit code: %d", cameraName, exitCode);
-            [statusWindow appendLog:[NSString stringWithFormat:@"FFmpeg terminated (exit code: %d)", exitCode] level:exitCode == 0 ? @"INFO" : @"ERROR"];
+- (void)releaseProxy:(RTSPProxyInstance *)proxy {
+    if (proxy.streamID != 0) {
+        // Blocks until the engine has stopped calling into the output
+        RTSPRemuxEngineRemoveStream(_engine, proxy.streamID);
+        proxy.streamID = 0;
+    }
+    // Closes any recording; its completion still runs
+    RTSPClipRecorderRelease(proxy.output.recorder);
+    proxy.output.recorder = NULL;
+    if (proxy.output.dvr) {
+        // Drain the queued media so a restarted proxy appends after it
+        RTSPDVRStoreRef dvr = proxy.output.dvr;
+        dispatch_sync(proxy.output.dvrQueue, ^{
+            RTSPDVRStoreCut(dvr);
         });
-
-        // Launch FFmpeg
-        @try {
-            NSLog(@"[FFmpegProxy] ==========================================");
-            NSLog(@"[FFmpegProxy] Launching FFmpeg for: %@", cameraName);
-            NSLog(@"[FFmpegProxy] Command: %@", self.ffmpegPath);
-            NSLog(@"[FFmpegProxy] Arguments: %@", [task.arguments componentsJoinedByString:@" "]);
-            NSLog(@"[FFmpegProxy] HLS Directory: %@", hlsDir);
-            NSLog(@"[FFmpegProxy] HLS Playlist: %@", hlsPlaylist);
-            NSLog(@"[FFmpegProxy] ==========================================");
-
-            [task launch];
-            proxy.ffmpegTask = task;
-            proxy.isRunning = YES;
-            self.proxies[urlKey] = proxy;
-
-            NSLog(@"[FFmpegProxy] ✓ FFmpeg process started (PID: %d) for %@", task.processIdentifier, cameraName);
-            NSLog(@"[FFmpegProxy] ✓ HLS output will be at: %@", hlsPlaylist);
-
-            // Give FFmpeg time to create HLS segments (needs 6-8 seconds for first playable segments)
-            NSLog(@"[FFmpegProxy] Waiting for HLS segments to initialize (8 seconds)...");
-            [NSThread sleepForTimeInterval:8.0];
-
-            // Check if FFmpeg is still running and HLS playlist exists
-            if (task.isRunning) {
-                BOOL hlsExists = [[NSFileManager defaultManager] fileExistsAtPath:hlsPlaylist];
-                if (hlsExists) {
-                    NSLog(@"[FFmpegProxy] ✓ FFmpeg still running - HLS playlist ready");
-                    NSLog(@"[FFmpegProxy] ✓ HLS file: %@", hlsPlaylist);
-                    localURL = proxy.localURL;
-                } else {
-                    NSLog(@"[FFmpegProxy] ⚠ WARNING: HLS playlist not found yet at: %@", hlsPlaylist);
-                    // Return URL anyway, might appear soon
-                    localURL = proxy.localURL;
-                }
-            } else {
-                NSLog(@"[FFmpegProxy] ERROR: FFmpeg process terminated unexpectedly!");
-                proxy.isRunning = NO;
-                [self.proxies removeObjectForKey:urlKey];
-            }
-        } @catch (NSException *exception) {
-            NSLog(@"[FFmpegProxy] ERROR: Failed to launch FFmpeg: %@", exception);
-            NSLog(@"[FFmpegProxy] Exception reason: %@", exception.reason);
+    }
+    if (proxy.localURL) {
+        @synchronized (self.dvrRings) {
+            [self.dvrRings removeObjectForKey:proxy.localURL.absoluteString];
         }
-    });
-
-    return localURL;
+    }
+    RTSPHLSServerUnpublish(_server, proxy.streamName.UTF8String);
+    proxy.isRunning = NO;
+    proxy.output.readyHandler = nil;
+    [self flushCompletionsForProxy:proxy URL:nil error:[self errorWithCode:1003 description:@"Proxy stopped"]];
 }
 
 - (void)stopProxyForURL:(NSURL *)rtspsURL {
@@ -284,31 +600,20 @@
 
         if (proxy && proxy.isRunning) {
             NSLog(@"[FFmpegProxy] Stopping proxy for %@", proxy.cameraName);
-
-            if (proxy.ffmpegTask && proxy.ffmpegTask.isRunning) {
-                [proxy.ffmpegTask terminate];
-                [proxy.ffmpegTask waitUntilExit];
-            }
-
-            proxy.isRunning = NO;
+            [self releaseProxy:proxy];
             [self.proxies removeObjectForKey:urlKey];
-
             NSLog(@"[FFmpegProxy] ✓ Proxy stopped for %@", proxy.cameraName);
         }
     });
 }
 
 - (void)stopAllProxies {
-    NSLog(@"[FFmpegProxy] Stopping all proxies (%lu active)", (unsigned long)self.proxies.count);
-
     dispatch_sync(self.proxyQueue, ^{
+        NSLog(@"[FFmpegProxy] Stopping all proxies (%lu active)", (unsigned long)self.proxies.count);
         for (RTSPProxyInstance *proxy in self.proxies.allValues) {
-            if (proxy.ffmpegTask && proxy.ffmpegTask.isRunning) {
-                [proxy.ffmpegTask terminate];
-            }
+            [self releaseProxy:proxy];
         }
         [self.proxies removeAllObjects];
-        self.nextPort = self.basePort; // Reset port counter
     });
 
     NSLog(@"[FFmpegProxy] ✓ All proxies stopped");
@@ -321,7 +626,7 @@
     dispatch_sync(self.proxyQueue, ^{
         NSString *urlKey = rtspsURL.absoluteString;
         RTSPProxyInstance *proxy = self.proxies[urlKey];
-        running = (proxy != nil && proxy.isRunning && proxy.ffmpegTask.isRunning);
+        running = (proxy != nil && proxy.isRunning);
     });
     return running;
 }
@@ -340,6 +645,284 @@
     return localURL;
 }
 
+#pragma mark - Recording
+
+/// Must be called on proxyQueue. Matches the camera's RTSPS URL or its local HLS URL.
+- (nullable RTSPProxyInstance *)runningProxyForURL:(NSURL *)url {
+    RTSPProxyInstance *proxy = self.proxies[url.absoluteString];
+    if (!proxy) {
+        for (RTSPProxyInstance *candidate in self.proxies.allValues) {
+            if ([candidate.localURL isEqual:url]) {
+                proxy = candidate;
+                break;
+            }
+        }
+    }
+    return proxy.isRunning && proxy.output.recorder ? proxy : nil;
+}
+
+/// Must be called on proxyQueue
+- (void)addRecordingCompletion:(nullable RTSPProxyRecordingCompletion)completion clipID:(uint32_t)clipID output:(RTSPProxyHLSOutput *)output {
+    if (!completion) return;
+    @synchronized (output.recordingCompletions) {
+        NSMutableArray *completions = output.recordingCompletions[@(clipID)];
+        if (!completions) {
+            completions = [NSMutableArray array];
+            output.recordingCompletions[@(clipID)] = completions;
+        }
+        [completions addObject:[completion copy]];
+    }
+}
+
+- (BOOL)startRecordingForURL:(NSURL *)url
+                      toFile:(NSString *)filePath
+              includePreRoll:(BOOL)includePreRoll
+                  completion:(nullable RTSPProxyRecordingCompletion)completion {
+    if (!url || !filePath) return NO;
+
+    __block BOOL started = NO;
+    dispatch_sync(self.proxyQueue, ^{
+        RTSPProxyInstance *proxy = [self runningProxyForURL:url];
+        if (!proxy) {
+            return;
+        }
+        // Registered under the lock the writer takes, so a clip that ends at once still finds it
+        @synchronized (proxy.output.recordingCompletions) {
+            uint32_t clipID = RTSPClipRecorderStart(proxy.output.recorder, filePath.fileSystemRepresentation, includePreRoll);
+            if (clipID != 0) {
+                [self addRecordingCompletion:completion clipID:clipID output:proxy.output];
+                started = YES;
+            }
+        }
+        NSLog(@"[FFmpegProxy] %@ recording %@ to %@", proxy.cameraName, started ? @"started" : @"could not start", filePath);
+    });
+    return started;
+}
+
+- (BOOL)triggerClipForURL:(NSURL *)url
+                   toFile:(NSString *)filePath
+               completion:(nullable RTSPProxyRecordingCompletion)completion {
+    if (!url || !filePath) return NO;
+
+    __block BOOL triggered = NO;
+    dispatch_sync(self.proxyQueue, ^{
+        RTSPProxyInstance *proxy = [self runningProxyForURL:url];
+        if (!proxy) {
+            return;
+        }
+        @synchronized (proxy.output.recordingCompletions) {
+            uint32_t clipID = RTSPClipRecorderTrigger(proxy.output.recorder, filePath.fileSystemRepresentation);
+            if (clipID != 0) {
+                [self addRecordingCompletion:completion clipID:clipID output:proxy.output];
+                triggered = YES;
+            }
+        }
+        if (self.verboseLogging) {
+            NSLog(@"[FFmpegProxy] %@ clip triggered%@", proxy.cameraName, triggered ? @"" : @" - no media yet");
+        }
+    });
+    return triggered;
+}
+
+- (void)stopRecordingForURL:(NSURL *)url {
+    if (!url) return;
+
+    dispatch_sync(self.proxyQueue, ^{
+        RTSPProxyInstance *proxy = [self runningProxyForURL:url];
+        if (proxy) {
+            RTSPClipRecorderStop(proxy.output.recorder);
+        }
+    });
+}
+
+#pragma mark - DVR
+
+/// Must be called on proxyQueue. A camera's ring is named after its
+/// address without credentials, so renaming or reordering cameras keeps
+/// their history; nil when DVR recording is off.
+- (nullable NSString *)dvrKeyForURL:(NSURL *)url {
+    for (RTSPProxyInstance *proxy in self.proxies.allValues) {
+        if ([proxy.localURL isEqual:url]) {
+            url = proxy.sourceURL;
+            break;
+        }
+    }
+    if (self.dvrDirectory.length == 0) {
+        return nil;
+    }
+    return [RTSPFFmpegProxy dvrKeyForSourceURL:url];
+}
+
+/// Any thread
++ (nullable NSString *)dvrKeyForSourceURL:(NSURL *)url {
+    if (url.host.length == 0) {
+        return nil;
+    }
+    NSString *key = [NSString stringWithFormat:@"%@-%@%@", url.host, url.port ?: @554, url.path];
+    NSCharacterSet *unsafe = [[NSCharacterSet characterSetWithCharactersInString:
+                               @"abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789.-_"] invertedSet];
+    return [[key componentsSeparatedByCharactersInSet:unsafe] componentsJoinedByString:@"_"];
+}
+
+/// Must be called on proxyQueue. One ring per camera; rings stay open
+/// across proxy restarts.
+- (RTSPDVRStoreRef)dvrStoreForURL:(NSURL *)url create:(BOOL)create {
+    NSString *directory = self.dvrDirectory;
+    NSString *key = [self dvrKeyForURL:url];
+    if (!key) {
+        return NULL;
+    }
+    NSValue *existing = self.dvrStores[key];
+    if (existing) {
+        return existing.pointerValue;
+    }
+
+    NSString *path = [directory stringByAppendingPathComponent:key];
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    if (!create && ![fileManager fileExistsAtPath:[path stringByAppendingPathComponent:@"index.dat"]]) {
+        return NULL;
+    }
+    [fileManager createDirectoryAtPath:directory withIntermediateDirectories:YES attributes:nil error:nil];
+
+    RTSPDVRStoreConfig config;
+    RTSPDVRStoreConfigInit(&config);
+    config.slotCount = (uint32_t)MAX(1.0, ceil(self.dvrRetention / config.segmentDuration));
+    // Segments are cut at 3/4 of a slot, leaving room for the GOP that crosses it
+    config.slotBytes = (uint64_t)(config.segmentDuration * self.dvrMaxBitrate / 8.0 * 4.0 / 3.0);
+    RTSPDVRStoreRef store = RTSPDVRStoreOpen(path.fileSystemRepresentation, &config);
+    if (!store) {
+        NSLog(@"[FFmpegProxy] ✗ Could not open DVR ring %@: %s", path, strerror(errno));
+        return NULL;
+    }
+    self.dvrStores[key] = [NSValue valueWithPointer:store];
+    @synchronized (self.dvrRings) {
+        self.dvrRings[key] = self.dvrStores[key];
+    }
+    NSLog(@"[FFmpegProxy] DVR ring %@: %u × %.0fs segments, up to %.1f GB",
+          key, config.slotCount, config.segmentDuration, config.slotCount * (double)config.slotBytes / 1e9);
+    return store;
+}
+
+/// Retained for the caller, who releases it off proxyQueue
+- (RTSPDVRStoreRef)retainDVRStoreForURL:(NSURL *)url {
+    if (!url) return NULL;
+
+    __block RTSPDVRStoreRef store = NULL;
+    dispatch_sync(self.proxyQueue, ^{
+        store = RTSPDVRStoreRetain([self dvrStoreForURL:url create:NO]);
+    });
+    return store;
+}
+
+- (nullable NSDictionary *)dvrStatusForURL:(NSURL *)url {
+    RTSPDVRStoreRef store = [self retainDVRStoreForURL:url];
+    if (!store) {
+        return nil;
+    }
+    RTSPDVRStoreStatistics statistics = RTSPDVRStoreGetStatistics(store);
+    RTSPDVRStoreRelease(store);
+    return @{
+        @"segments": @(statistics.segments),
+        @"start": @(statistics.oldestTime / 1e6),
+        @"end": @(statistics.newestTime / 1e6),
+        @"bytes": @(statistics.bytes),
+        @"overwritten": @(statistics.overwritten),
+        @"droppedMedia": @(statistics.droppedMedia),
+        @"writeErrors": @(statistics.writeErrors)
+    };
+}
+
+- (nullable NSData *)dvrPlaylistForURL:(NSURL *)url
+                                  from:(nullable NSDate *)start
+                                    to:(nullable NSDate *)end
+                             URIPrefix:(nullable NSString *)prefix
+                             URISuffix:(nullable NSString *)suffix {
+    RTSPDVRStoreRef store = [self retainDVRStoreForURL:url];
+    if (!store) {
+        return nil;
+    }
+    RTSPByteBuffer playlist;
+    RTSPByteBufferInit(&playlist);
+    BOOL written = RTSPDVRStoreWritePlaylist(store,
+                                             start ? (int64_t)(start.timeIntervalSince1970 * 1e6) : INT64_MIN,
+                                             end ? (int64_t)(end.timeIntervalSince1970 * 1e6) : INT64_MAX,
+                                             prefix.UTF8String, suffix.UTF8String, &playlist);
+    RTSPDVRStoreRelease(store);
+    size_t length = 0;
+    uint8_t *bytes = written ? RTSPByteBufferDetach(&playlist, &length) : NULL;
+    RTSPByteBufferFree(&playlist);
+    return bytes ? [NSData dataWithBytesNoCopy:bytes length:length freeWhenDone:YES] : nil;
+}
+
+- (nullable NSData *)dvrSegmentForURL:(NSURL *)url sequence:(uint64_t)sequence initSegment:(BOOL)initSegment {
+    RTSPDVRStoreRef store = [self retainDVRStoreForURL:url];
+    if (!store) {
+        return nil;
+    }
+    RTSPDVRSegmentInfo segment;
+    RTSPByteBuffer data;
+    RTSPByteBufferInit(&data);
+    BOOL read = RTSPDVRStoreGetSegment(store, sequence, &segment) &&
+                RTSPDVRStoreRead(store, sequence,
+                                 initSegment ? 0 : segment.mediaOffset,
+                                 initSegment ? segment.mediaOffset : UINT64_MAX, &data);
+    RTSPDVRStoreRelease(store);
+    size_t length = 0;
+    uint8_t *bytes = read ? RTSPByteBufferDetach(&data, &length) : NULL;
+    RTSPByteBufferFree(&data);
+    return bytes ? [NSData dataWithBytesNoCopy:bytes length:length freeWhenDone:YES] : nil;
+}
+
+/// Never waits for proxyQueue, which stream teardown can hold for a while:
+/// event producers call this on the main thread
+- (nullable RTSPDVRPosition *)dvrPositionForURL:(NSURL *)url time:(NSDate *)time {
+    RTSPDVRStoreRef store = NULL;
+    @synchronized (self.dvrRings) {
+        NSValue *ring = self.dvrRings[url.absoluteString ?: @""];
+        if (!ring) {
+            NSString *key = [RTSPFFmpegProxy dvrKeyForSourceURL:url];
+            ring = key ? self.dvrRings[key] : nil;
+        }
+        store = RTSPDVRStoreRetain(ring.pointerValue);
+    }
+    if (!store) {
+        return nil;
+    }
+    RTSPDVRSeekPoint point;
+    BOOL found = RTSPDVRStoreSeek(store, (int64_t)llround(time.timeIntervalSince1970 * 1e6), &point);
+    RTSPDVRStoreRelease(store);
+    return found ? [[RTSPDVRPosition alloc] initWithSegment:point.sequence offset:point.offset timestamp:point.time] : nil;
+}
+
+/// Thumbnails share the ring's directory and lifetime
+- (nullable RTSPDVRThumbnailer *)dvrThumbnailerForURL:(NSURL *)url {
+    if (!url) return nil;
+
+    __block RTSPDVRThumbnailer *thumbnailer = nil;
+    dispatch_sync(self.proxyQueue, ^{
+        NSString *key = [self dvrKeyForURL:url];
+        thumbnailer = key ? self.dvrThumbnailers[key] : nil;
+        RTSPDVRStoreRef store = thumbnailer ? NULL : [self dvrStoreForURL:url create:NO];
+        if (store) {
+            NSString *path = [[self.dvrDirectory stringByAppendingPathComponent:key] stringByAppendingPathComponent:@"thumbnails.sprite"];
+            thumbnailer = [[RTSPDVRThumbnailer alloc] initWithStore:store spritePath:path];
+            self.dvrThumbnailers[key] = thumbnailer;
+        }
+    });
+    return thumbnailer;
+}
+
+- (nullable CGImageRef)copyDVRThumbnailForURL:(NSURL *)url position:(RTSPDVRPosition *)position {
+    RTSPDVRSeekPoint keyframe = {position.segment, position.offset, position.timestamp};
+    return [[self dvrThumbnailerForURL:url] copyThumbnailForKeyframe:keyframe];
+}
+
+- (nullable CGImageRef)copyDVRTimelineForURL:(NSURL *)url from:(NSDate *)start to:(NSDate *)end count:(NSUInteger)count {
+    return [[self dvrThumbnailerForURL:url] copyStripFrom:(int64_t)llround(start.timeIntervalSince1970 * 1e6)
+                                                        to:(int64_t)llround(end.timeIntervalSince1970 * 1e6)
+                                                     count:count];
+}
+
 #pragma mark - Status
 
 - (NSInteger)activeProxyCount {
@@ -354,14 +937,41 @@
     __block NSMutableArray *status = [NSMutableArray array];
 
     dispatch_sync(self.proxyQueue, ^{
+        static NSString *const stateNames[] = {@"connecting", @"negotiating", @"playing", @"reconnecting"};
         for (RTSPProxyInstance *proxy in self.proxies.allValues) {
+            RTSPRemuxStreamStatistics stats = {0};
+            BOOL known = RTSPRemuxEngineGetStatistics(self->_engine, proxy.streamID, &stats);
+            RTSPHLSStoreStatistics window = RTSPHLSStoreGetStatistics(proxy.output.store);
+            RTSPClipRecorderStatistics recording = {0};
+            if (proxy.output.recorder) {
+                recording = RTSPClipRecorderGetStatistics(proxy.output.recorder);
+            }
+            RTSPDVRStoreStatistics dvr = RTSPDVRStoreGetStatistics(proxy.output.dvr);
             [status addObject:@{
                 @"cameraName": proxy.cameraName ?: @"Unknown",
                 @"sourceURL": proxy.sourceURL.absoluteString,
                 @"localURL": proxy.localURL.absoluteString,
-                @"localPort": @(proxy.localPort),
-                @"isRunning": @(proxy.isRunning && proxy.ffmpegTask.isRunning),
-                @"pid": @(proxy.ffmpegTask.processIdentifier)
+                @"streamName": proxy.streamName,
+                @"isRunning": @(proxy.isRunning && known && stats.state == RTSPRemuxStreamPlaying),
+                @"state": known ? stateNames[stats.state] : @"stopped",
+                @"codec": @(stats.codecString),
+                @"width": @(stats.width),
+                @"height": @(stats.height),
+                @"bytesReceived": @(stats.bytesReceived),
+                @"lostPackets": @(stats.lostPackets),
+                @"segments": @(stats.segments),
+                @"bufferedSegments": @(window.segments),
+                @"bufferedBytes": @(window.bytes),
+                @"preRollSeconds": @(recording.preRollDuration),
+                @"recording": @(recording.clipID != 0),
+                @"recordedBytes": @(recording.bytesWritten),
+                @"dvrSeconds": @((dvr.newestTime - dvr.oldestTime) / 1e6),
+                @"dvrBytes": @(dvr.bytes),
+                @"reconnects": @(stats.reconnects),
+                @"ready": @(proxy.ready),
+                @"timeToFirstFrameMs": @(proxy.timeToFirstFrame * 1000.0),
+                @"timeToFirstKeyframeMs": @(proxy.timeToFirstKeyframe * 1000.0),
+                @"lastError": proxy.output.lastError ?: @""
             }];
         }
     });
@@ -369,10 +979,45 @@
     return [status copy];
 }
 
+- (NSDictionary<NSString *, NSNumber *> *)startupMetrics {
+    __block NSArray<NSNumber *> *samples = nil;
+    __block NSUInteger timeouts = 0;
+    dispatch_sync(self.proxyQueue, ^{
+        samples = [self.startupSamples copy];
+        timeouts = self.startupTimeouts;
+    });
+
+    if (samples.count == 0) {
+        return @{@"count": @0, @"timeouts": @(timeouts)};
+    }
+
+    NSArray<NSNumber *> *sorted = [samples sortedArrayUsingSelector:@selector(compare:)];
+    double sum = 0;
+    for (NSNumber *sample in samples) {
+        sum += sample.doubleValue;
+    }
+    NSUInteger p50 = (sorted.count - 1) / 2;
+    NSUInteger p95 = (NSUInteger)((sorted.count - 1) * 0.95);
+    return @{
+        @"count": @(samples.count),
+        @"timeouts": @(timeouts),
+        @"lastMs": @(samples.lastObject.doubleValue * 1000.0),
+        @"meanMs": @(sum / samples.count * 1000.0),
+        @"p50Ms": @(sorted[p50].doubleValue * 1000.0),
+        @"p95Ms": @(sorted[p95].doubleValue * 1000.0),
+        @"maxMs": @(sorted.lastObject.doubleValue * 1000.0)
+    };
+}
+
 #pragma mark - Cleanup
 
 - (void)dealloc {
     [self stopAllProxies];
+    for (NSValue *store in _dvrStores.allValues) {
+        RTSPDVRStoreRelease(store.pointerValue);
+    }
+    RTSPRemuxEngineRelease(_engine);
+    RTSPHLSServerRelease(_server);
 }
 
 @end
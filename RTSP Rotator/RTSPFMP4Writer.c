@@ -0,0 +1,221 @@
+//
+//  RTSPFMP4Writer.c
+//  RTSP Rotator
+//
+
+#include "RTSPFMP4Writer.h"
+
+#define RTSP_FMP4_TRACK_ID 1
+
+/// sample_depends_on = 2 (does not depend on others)
+#define RTSP_FMP4_SYNC_SAMPLE_FLAGS 0x02000000u
+/// sample_depends_on = 1, sample_is_non_sync_sample = 1
+#define RTSP_FMP4_NON_SYNC_SAMPLE_FLAGS 0x01010000u
+
+static size_t RTSPBoxBegin(RTSPByteBuffer *b, const char type[4]) {
+    size_t offset = b->length;
+    RTSPByteBufferAppendU32(b, 0);
+    RTSPByteBufferAppend(b, type, 4);
+    return offset;
+}
+
+static size_t RTSPFullBoxBegin(RTSPByteBuffer *b, const char type[4], uint8_t version, uint32_t flags) {
+    size_t offset = RTSPBoxBegin(b, type);
+    RTSPByteBufferAppendU8(b, version);
+    RTSPByteBufferAppendU24(b, flags);
+    return offset;
+}
+
+static void RTSPBoxEnd(RTSPByteBuffer *b, size_t offset) {
+    RTSPByteBufferPatchU32(b, offset, (uint32_t)(b->length - offset));
+}
+
+static void RTSPAppendMatrix(RTSPByteBuffer *b) {
+    static const uint32_t matrix[9] = {0x00010000, 0, 0, 0, 0x00010000, 0, 0, 0, 0x40000000};
+    for (int i = 0; i < 9; i++) {
+        RTSPByteBufferAppendU32(b, matrix[i]);
+    }
+}
+
+#pragma mark - Init Segment
+
+static void RTSPWriteSampleEntry(const RTSPCodecConfig *config, RTSPByteBuffer *b) {
+    bool hevc = config->codec == RTSPVideoCodecH265;
+    size_t entry = RTSPBoxBegin(b, hevc ? "hvc1" : "avc1");
+    RTSPByteBufferAppendZeros(b, 6);                  // reserved
+    RTSPByteBufferAppendU16(b, 1);                    // data_reference_index
+    RTSPByteBufferAppendZeros(b, 16);                 // pre_defined + reserved
+    RTSPByteBufferAppendU16(b, (uint16_t)config->width);
+    RTSPByteBufferAppendU16(b, (uint16_t)config->height);
+    RTSPByteBufferAppendU32(b, 0x00480000);           // 72 dpi
+    RTSPByteBufferAppendU32(b, 0x00480000);
+    RTSPByteBufferAppendU32(b, 0);
+    RTSPByteBufferAppendU16(b, 1);                    // frame_count
+    RTSPByteBufferAppendZeros(b, 32);                 // compressorname
+    RTSPByteBufferAppendU16(b, 0x0018);               // depth
+    RTSPByteBufferAppendU16(b, 0xFFFF);               // pre_defined = -1
+
+    size_t record = RTSPBoxBegin(b, hevc ? "hvcC" : "avcC");
+    RTSPCodecConfigAppendDecoderRecord(config, b);
+    RTSPBoxEnd(b, record);
+    RTSPBoxEnd(b, entry);
+}
+
+bool RTSPFMP4WriteInitSegment(const RTSPCodecConfig *config, RTSPByteBuffer *b) {
+    if (!config || !b || !RTSPCodecConfigIsComplete(config)) {
+        return false;
+    }
+
+    size_t ftyp = RTSPBoxBegin(b, "ftyp");
+    RTSPByteBufferAppend(b, "iso5", 4);
+    RTSPByteBufferAppendU32(b, 512);
+    RTSPByteBufferAppend(b, "iso5iso6mp41", 12);
+    RTSPBoxEnd(b, ftyp);
+
+    size_t moov = RTSPBoxBegin(b, "moov");
+
+    size_t mvhd = RTSPFullBoxBegin(b, "mvhd", 0, 0);
+    RTSPByteBufferAppendU32(b, 0);                    // creation_time
+    RTSPByteBufferAppendU32(b, 0);                    // modification_time
+    RTSPByteBufferAppendU32(b, 1000);                 // timescale
+    RTSPByteBufferAppendU32(b, 0);                    // duration (fragmented)
+    RTSPByteBufferAppendU32(b, 0x00010000);           // rate
+    RTSPByteBufferAppendU16(b, 0x0100);               // volume
+    RTSPByteBufferAppendZeros(b, 10);
+    RTSPAppendMatrix(b);
+    RTSPByteBufferAppendZeros(b, 24);                 // pre_defined
+    RTSPByteBufferAppendU32(b, RTSP_FMP4_TRACK_ID + 1);
+    RTSPBoxEnd(b, mvhd);
+
+    size_t trak = RTSPBoxBegin(b, "trak");
+    size_t tkhd = RTSPFullBoxBegin(b, "tkhd", 0, 0x000003);
+    RTSPByteBufferAppendU32(b, 0);
+    RTSPByteBufferAppendU32(b, 0);
+    RTSPByteBufferAppendU32(b, RTSP_FMP4_TRACK_ID);
+    RTSPByteBufferAppendU32(b, 0);
+    RTSPByteBufferAppendU32(b, 0);                    // duration
+    RTSPByteBufferAppendZeros(b, 8);
+    RTSPByteBufferAppendU16(b, 0);                    // layer
+    RTSPByteBufferAppendU16(b, 0);                    // alternate_group
+    RTSPByteBufferAppendU16(b, 0);                    // volume
+    RTSPByteBufferAppendU16(b, 0);
+    RTSPAppendMatrix(b);
+    RTSPByteBufferAppendU32(b, config->width << 16);
+    RTSPByteBufferAppendU32(b, config->height << 16);
+    RTSPBoxEnd(b, tkhd);
+
+    size_t mdia = RTSPBoxBegin(b, "mdia");
+    size_t mdhd = RTSPFullBoxBegin(b, "mdhd", 0, 0);
+    RTSPByteBufferAppendU32(b, 0);
+    RTSPByteBufferAppendU32(b, 0);
+    RTSPByteBufferAppendU32(b, RTSP_FMP4_TIMESCALE);
+    RTSPByteBufferAppendU32(b, 0);
+    RTSPByteBufferAppendU16(b, 0x55C4);               // language "und"
+    RTSPByteBufferAppendU16(b, 0);
+    RTSPBoxEnd(b, mdhd);
+
+    size_t hdlr = RTSPFullBoxBegin(b, "hdlr", 0, 0);
+    RTSPByteBufferAppendU32(b, 0);
+    RTSPByteBufferAppend(b, "vide", 4);
+    RTSPByteBufferAppendZeros(b, 12);
+    RTSPByteBufferAppend(b, "VideoHandler", 13);      // includes terminator
+    RTSPBoxEnd(b, hdlr);
+
+    size_t minf = RTSPBoxBegin(b, "minf");
+    size_t vmhd = RTSPFullBoxBegin(b, "vmhd", 0, 1);
+    RTSPByteBufferAppendZeros(b, 8);
+    RTSPBoxEnd(b, vmhd);
+
+    size_t dinf = RTSPBoxBegin(b, "dinf");
+    size_t dref = RTSPFullBoxBegin(b, "dref", 0, 0);
+    RTSPByteBufferAppendU32(b, 1);
+    size_t url = RTSPFullBoxBegin(b, "url ", 0, 1);   // self-contained
+    RTSPBoxEnd(b, url);
+    RTSPBoxEnd(b, dref);
+    RTSPBoxEnd(b, dinf);
+
+    size_t stbl = RTSPBoxBegin(b, "stbl");
+    size_t stsd = RTSPFullBoxBegin(b, "stsd", 0, 0);
+    RTSPByteBufferAppendU32(b, 1);
+    RTSPWriteSampleEntry(config, b);
+    RTSPBoxEnd(b, stsd);
+
+    // Empty sample tables; samples live in fragments
+    const char *emptyTables[] = {"stts", "stsc", "stco"};
+    for (int i = 0; i < 3; i++) {
+        size_t box = RTSPFullBoxBegin(b, emptyTables[i], 0, 0);
+        RTSPByteBufferAppendU32(b, 0);
+        RTSPBoxEnd(b, box);
+    }
+    size_t stsz = RTSPFullBoxBegin(b, "stsz", 0, 0);
+    RTSPByteBufferAppendU32(b, 0);
+    RTSPByteBufferAppendU32(b, 0);
+    RTSPBoxEnd(b, stsz);
+    RTSPBoxEnd(b, stbl);
+    RTSPBoxEnd(b, minf);
+    RTSPBoxEnd(b, mdia);
+    RTSPBoxEnd(b, trak);
+
+    size_t mvex = RTSPBoxBegin(b, "mvex");
+    size_t trex = RTSPFullBoxBegin(b, "trex", 0, 0);
+    RTSPByteBufferAppendU32(b, RTSP_FMP4_TRACK_ID);
+    RTSPByteBufferAppendU32(b, 1);                    // default_sample_description_index
+    RTSPByteBufferAppendU32(b, 0);
+    RTSPByteBufferAppendU32(b, 0);
+    RTSPByteBufferAppendU32(b, 0);
+    RTSPBoxEnd(b, trex);
+    RTSPBoxEnd(b, mvex);
+
+    RTSPBoxEnd(b, moov);
+    return !b->failed;
+}
+
+#pragma mark - Fragments
+
+bool RTSPFMP4WriteFragment(uint32_t sequenceNumber,
+                           uint64_t baseDecodeTime,
+                           const RTSPFMP4Sample *samples,
+                           size_t sampleCount,
+                           const uint8_t *payload,
+                           size_t payloadLength,
+                           RTSPByteBuffer *b) {
+    if (!b || !samples || sampleCount == 0) {
+        return false;
+    }
+
+    size_t moof = RTSPBoxBegin(b, "moof");
+    size_t mfhd = RTSPFullBoxBegin(b, "mfhd", 0, 0);
+    RTSPByteBufferAppendU32(b, sequenceNumber);
+    RTSPBoxEnd(b, mfhd);
+
+    size_t traf = RTSPBoxBegin(b, "traf");
+    size_t tfhd = RTSPFullBoxBegin(b, "tfhd", 0, 0x020000); // default-base-is-moof
+    RTSPByteBufferAppendU32(b, RTSP_FMP4_TRACK_ID);
+    RTSPBoxEnd(b, tfhd);
+
+    size_t tfdt = RTSPFullBoxBegin(b, "tfdt", 1, 0);
+    RTSPByteBufferAppendU64(b, baseDecodeTime);
+    RTSPBoxEnd(b, tfdt);
+
+    // data-offset, sample-duration, sample-size, sample-flags present
+    size_t trun = RTSPFullBoxBegin(b, "trun", 0, 0x000701);
+    RTSPByteBufferAppendU32(b, (uint32_t)sampleCount);
+    size_t dataOffsetPosition = b->length;
+    RTSPByteBufferAppendU32(b, 0);
+    for (size_t i = 0; i < sampleCount; i++) {
+        RTSPByteBufferAppendU32(b, samples[i].duration);
+        RTSPByteBufferAppendU32(b, samples[i].size);
+        RTSPByteBufferAppendU32(b, samples[i].keyframe ? RTSP_FMP4_SYNC_SAMPLE_FLAGS : RTSP_FMP4_NON_SYNC_SAMPLE_FLAGS);
+    }
+    RTSPBoxEnd(b, trun);
+    RTSPBoxEnd(b, traf);
+    RTSPBoxEnd(b, moof);
+
+    size_t moofSize = b->length - moof;
+    RTSPByteBufferPatchU32(b, dataOffsetPosition, (uint32_t)(moofSize + 8));
+
+    RTSPByteBufferAppendU32(b, (uint32_t)(payloadLength + 8));
+    RTSPByteBufferAppend(b, "mdat", 4);
+    RTSPByteBufferAppend(b, payload, payloadLength);
+    return !b->failed;
+}
@@ -0,0 +1,46 @@
+//
+//  RTSPFMP4Writer.h
+//  RTSP Rotator
+//
+//  Minimal fragmented MP4 (ISO BMFF) writer for a single video track:
+//  an init segment (ftyp + moov with avcC/hvcC) and moof + mdat fragments
+//  holding stream-copied samples. Output is what HLS (fMP4), the recorder
+//  and the DVR store consume.
+//
+
+#ifndef RTSPFMP4Writer_h
+#define RTSPFMP4Writer_h
+
+#include "RTSPCodecConfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Track timescale used for all video written by the app (RTP video clock)
+#define RTSP_FMP4_TIMESCALE 90000
+
+typedef struct {
+    uint32_t size;
+    uint32_t duration;
+    bool keyframe;
+} RTSPFMP4Sample;
+
+/// Append an init segment (ftyp + moov) for the configuration
+bool RTSPFMP4WriteInitSegment(const RTSPCodecConfig *config, RTSPByteBuffer *output);
+
+/// Append one moof + mdat. `payload` holds the samples back to back
+/// (length-prefixed NAL units), in the order listed in `samples`.
+bool RTSPFMP4WriteFragment(uint32_t sequenceNumber,
+                           uint64_t baseDecodeTime,
+                           const RTSPFMP4Sample *samples,
+                           size_t sampleCount,
+                           const uint8_t *payload,
+                           size_t payloadLength,
+                           RTSPByteBuffer *output);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RTSPFMP4Writer_h */
@@ -18,6 +18,10 @@ typedef NS_ENUM(NSInteger, RTSPFeedStatus) {
 
 @class RTSPFailoverManager;
 
+/// Posted when a feed's status changes or failing over it fails.
+/// userInfo: @"feed" (RTSPFeedConfig), @"error" (NSError, failures only)
+extern NSString * const RTSPFailoverManagerFeedStatusDidChangeNotification;
+
 /// Feed configuration with backup URLs
 @interface RTSPFeedConfig : NSObject
 @property (nonatomic, strong) NSString *name;
@@ -6,6 +6,8 @@
 #import "RTSPFailoverManager.h"
 #import <AVFoundation/AVFoundation.h>
 
+NSString * const RTSPFailoverManagerFeedStatusDidChangeNotification = @"RTSPFailoverManagerFeedStatusDidChangeNotification";
+
 @implementation RTSPFeedConfig
 @end
 
@@ -85,13 +87,20 @@
         dispatch_async(dispatch_get_main_queue(), ^{
             feed.lastHealthCheck = [NSDate date];
             feed.lastError = error;
+            RTSPFeedStatus previousStatus = feed.status;
 
             if (healthy) {
                 feed.status = RTSPFeedStatusHealthy;
                 // Reset retry counter on success
                 [self.retryAttempts removeObjectForKey:feed.primaryURL.absoluteString];
+                if (previousStatus != feed.status) {
+                    [self postStatusChangeForFeed:feed error:nil];
+                }
             } else {
                 feed.status = RTSPFeedStatusFailed;
+                if (previousStatus != feed.status) {
+                    [self postStatusChangeForFeed:feed error:error];
+                }
                 [self handleFailedFeed:feed];
             }
 
@@ -132,6 +141,16 @@
     return connected;
 }
 
+- (void)postStatusChangeForFeed:(RTSPFeedConfig *)feed error:(nullable NSError *)error {
+    NSMutableDictionary *userInfo = [NSMutableDictionary dictionaryWithObject:feed forKey:@"feed"];
+    if (error) {
+        userInfo[@"error"] = error;
+    }
+    [[NSNotificationCenter defaultCenter] postNotificationName:RTSPFailoverManagerFeedStatusDidChangeNotification
+                                                        object:self
+                                                      userInfo:userInfo];
+}
+
 - (void)handleFailedFeed:(RTSPFeedConfig *)feed {
     if (!self.autoFailoverEnabled) {
         if ([self.delegate respondsToSelector:@selector(failoverManager:didFailFeed:withError:)]) {
@@ -159,12 +178,13 @@
     if (!feed.backupURLs || feed.backupURLs.count == 0) {
         NSLog(@"[Failover] No backup URLs available for %@", feed.name);
 
+        NSError *error = [NSError errorWithDomain:@"RTSPFailoverManager"
+                                            code:1002
+                                        userInfo:@{NSLocalizedDescriptionKey: @"No backup URLs configured"}];
         if ([self.delegate respondsToSelector:@selector(failoverManager:didFailFeed:withError:)]) {
-            NSError *error = [NSError errorWithDomain:@"RTSPFailoverManager"
-                                                code:1002
-                                            userInfo:@{NSLocalizedDescriptionKey: @"No backup URLs configured"}];
             [self.delegate failoverManager:self didFailFeed:feed withError:error];
         }
+        [self postStatusChangeForFeed:feed error:error];
 
         if (completion) completion(NO, nil);
         return;
@@ -182,6 +202,7 @@
             if ([self.delegate respondsToSelector:@selector(failoverManager:didFailoverFeed:toURL:)]) {
                 [self.delegate failoverManager:self didFailoverFeed:feed toURL:backupURL];
             }
+            [self postStatusChangeForFeed:feed error:nil];
 
             NSLog(@"[Failover] Successfully failed over %@ to backup: %@", feed.name, backupURL.absoluteString);
 
@@ -193,12 +214,13 @@
     // All backups failed
     NSLog(@"[Failover] All backup URLs failed for %@", feed.name);
 
+    NSError *error = [NSError errorWithDomain:@"RTSPFailoverManager"
+                                        code:1003
+                                    userInfo:@{NSLocalizedDescriptionKey: @"All backup URLs failed"}];
     if ([self.delegate respondsToSelector:@selector(failoverManager:didFailFeed:withError:)]) {
-        NSError *error = [NSError errorWithDomain:@"RTSPFailoverManager"
-                                            code:1003
-                                        userInfo:@{NSLocalizedDescriptionKey: @"All backup URLs failed"}];
         [self.delegate failoverManager:self didFailFeed:feed withError:error];
     }
+    [self postStatusChangeForFeed:feed error:error];
 
     if (completion) completion(NO, nil);
 }
@@ -214,6 +236,7 @@
         if ([self.delegate respondsToSelector:@selector(failoverManager:didRestoreFeed:toPrimaryURL:)]) {
             [self.delegate failoverManager:self didRestoreFeed:feed toPrimaryURL:feed.primaryURL];
         }
+        [self postStatusChangeForFeed:feed error:nil];
 
         NSLog(@"[Failover] Restored %@ to primary URL", feed.name);
 
@@ -0,0 +1,100 @@
+//
+//  RTSPFrameBus.h
+//  RTSP Rotator
+//
+//  Per-feed decoded frame tap. One AVPlayerItemVideoOutput per player feeds
+//  a small ring of recent frames; motion detection, smart alerts, snapshots
+//  and thumbnails all subscribe to it instead of running their own
+//  AVAssetImageGenerator decode/seek.
+//
+
+#import <Foundation/Foundation.h>
+#import <AVFoundation/AVFoundation.h>
+#import <CoreVideo/CoreVideo.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// A decoded frame shared between subscribers. The pixel buffer is the
+/// decoder's own (IOSurface backed, NV12) buffer - it is never copied.
+@interface RTSPDecodedFrame : NSObject
+
+@property (nonatomic, readonly) CVPixelBufferRef pixelBuffer;
+@property (nonatomic, readonly) CMTime presentationTime;
+@property (nonatomic, readonly) CFTimeInterval hostTime;      // CACurrentMediaTime() at capture
+@property (nonatomic, readonly) uint64_t sequenceNumber;
+@property (nonatomic, readonly) size_t width;
+@property (nonatomic, readonly) size_t height;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/// Convert to a CGImage (RGB). Caller releases. Only pays for color
+/// conversion, not a decode.
+- (nullable CGImageRef)copyCGImage CF_RETURNS_RETAINED;
+
+@end
+
+typedef void (^RTSPFrameBusHandler)(RTSPDecodedFrame *frame);
+
+/// Frame bus for one player
+@interface RTSPFrameBus : NSObject
+
+/// Shared bus for a player (created on first use, released with the player)
++ (instancetype)busForPlayer:(AVPlayer *)player;
+
+/// Bus currently tapping a stream with this URL, if any
++ (nullable instancetype)activeBusForURL:(NSURL *)url;
+
+/// Bus whose player is playing this URL, tapped or not. Only players that
+/// have been passed to busForPlayer: are known.
++ (nullable instancetype)busPlayingURL:(NSURL *)url;
+
+/// One bus per stream being played, tapped or not, for players that have
+/// been passed to busForPlayer:
++ (NSArray<RTSPFrameBus *> *)allBuses;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/// Player being tapped
+@property (nonatomic, weak, readonly, nullable) AVPlayer *player;
+
+/// Number of recent frames retained (default: 4). Keep small: every
+/// retained frame is a buffer the decoder cannot reuse.
+@property (nonatomic, assign) NSUInteger capacity;
+
+/**
+ * Subscribe to frames.
+ * @param framesPerSecond Maximum delivery rate for this subscriber
+ * @param queue Queue the handler runs on (nil = a private serial queue)
+ * @param handler Called with each delivered frame. If the previous call
+ *        for this subscriber has not returned, the frame is skipped for it.
+ * @return Token to pass to removeSubscriber:
+ */
+- (id<NSObject>)addSubscriberWithRate:(double)framesPerSecond
+                                queue:(nullable dispatch_queue_t)queue
+                              handler:(RTSPFrameBusHandler)handler;
+
+/// Stop delivering to a subscriber
+- (void)removeSubscriber:(id<NSObject>)token;
+
+/// Most recent frame, if any
+- (nullable RTSPDecodedFrame *)latestFrame;
+
+/// Retained frames, oldest first
+- (NSArray<RTSPDecodedFrame *> *)recentFrames;
+
+/**
+ * One-shot frame request. Returns the latest frame if it is newer than
+ * maxAge, otherwise pulls one from the output. If no new frame arrives
+ * within maxAge (a paused or stalled player), completes with the newest
+ * frame held, or nil. The completion runs on a global queue, never on the
+ * bus queue.
+ */
+- (void)requestFrameWithMaximumAge:(NSTimeInterval)maxAge
+                        completion:(void (^)(RTSPDecodedFrame * _Nullable frame))completion;
+
+/// Statistics: framesPulled, framesDelivered, framesSkipped, subscribers
+- (NSDictionary<NSString *, NSNumber *> *)statistics;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,503 @@
+//
+//  RTSPFrameBus.m
+//  RTSP Rotator
+//
+
+#import "RTSPFrameBus.h"
+#import <QuartzCore/QuartzCore.h>
+#import <VideoToolbox/VideoToolbox.h>
+#import <stdatomic.h>
+
+static const NSUInteger kRTSPFrameBusDefaultCapacity = 4;
+static const double kRTSPFrameBusMaxPollRate = 60.0;
+static void *kRTSPFrameBusCurrentItemContext = &kRTSPFrameBusCurrentItemContext;
+
+#pragma mark - RTSPDecodedFrame
+
+@implementation RTSPDecodedFrame {
+    CVPixelBufferRef _pixelBuffer;
+}
+
+- (instancetype)initWithPixelBuffer:(CVPixelBufferRef)pixelBuffer
+                   presentationTime:(CMTime)presentationTime
+                           hostTime:(CFTimeInterval)hostTime
+                     sequenceNumber:(uint64_t)sequenceNumber {
+    self = [super init];
+    if (self) {
+        _pixelBuffer = CVPixelBufferRetain(pixelBuffer);
+        _presentationTime = presentationTime;
+        _hostTime = hostTime;
+        _sequenceNumber = sequenceNumber;
+        _width = CVPixelBufferGetWidth(pixelBuffer);
+        _height = CVPixelBufferGetHeight(pixelBuffer);
+    }
+    return self;
+}
+
+- (CVPixelBufferRef)pixelBuffer {
+    return _pixelBuffer;
+}
+
+- (CGImageRef)copyCGImage {
+    CGImageRef image = NULL;
+    OSStatus status = VTCreateCGImageFromCVPixelBuffer(_pixelBuffer, NULL, &image);
+    if (status != noErr) {
+        NSLog(@"[FrameBus] CGImage conversion failed: %d", (int)status);
+        return NULL;
+    }
+    return image;
+}
+
+- (void)dealloc {
+    CVPixelBufferRelease(_pixelBuffer);
+}
+
+@end
+
+#pragma mark - Subscriber
+
+@interface RTSPFrameBusSubscriber : NSObject
+@property (nonatomic, assign) NSTimeInterval minimumInterval;
+@property (nonatomic, strong) dispatch_queue_t queue;
+@property (nonatomic, copy) RTSPFrameBusHandler handler;
+@property (nonatomic, assign) CFTimeInterval lastDeliveryTime;
+@end
+
+@implementation RTSPFrameBusSubscriber {
+@public
+    atomic_bool _busy;
+}
+@end
+
+#pragma mark - RTSPFrameBus
+
+@interface RTSPFrameBus ()
+@property (nonatomic, weak) AVPlayer *player;
+@property (nonatomic, strong) dispatch_queue_t busQueue;
+@property (nonatomic, strong) dispatch_source_t pollTimer;
+@property (nonatomic, assign) double pollRate;
+@property (nonatomic, strong) AVPlayerItemVideoOutput *videoOutput;
+@property (nonatomic, weak) AVPlayerItem *outputItem;
+@property (nonatomic, strong) NSURL *currentURL;
+@property (nonatomic, strong) NSURL *playingURL;              // Player's current item; set on main, read under the registry lock
+@property (nonatomic, strong) NSMutableArray *ring;           // RTSPDecodedFrame or NSNull
+@property (nonatomic, assign) NSUInteger ringHead;            // Next slot to write
+@property (nonatomic, strong) NSMutableArray<RTSPFrameBusSubscriber *> *subscribers;
+@property (nonatomic, strong) NSMutableArray *pendingRequests;
+@end
+
+@implementation RTSPFrameBus {
+    uint64_t _sequence;
+    uint64_t _framesPulled;
+    atomic_uint_fast64_t _framesDelivered;
+    atomic_uint_fast64_t _framesSkipped;
+}
+
++ (NSMapTable<AVPlayer *, RTSPFrameBus *> *)registry {
+    static NSMapTable *registry;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        registry = [NSMapTable weakToStrongObjectsMapTable];
+    });
+    return registry;
+}
+
++ (instancetype)busForPlayer:(AVPlayer *)player {
+    NSMapTable *registry = [self registry];
+    @synchronized (registry) {
+        RTSPFrameBus *bus = [registry objectForKey:player];
+        if (!bus) {
+            bus = [[RTSPFrameBus alloc] initWithPlayer:player];
+            [registry setObject:bus forKey:player];
+        }
+        return bus;
+    }
+}
+
++ (instancetype)activeBusForURL:(NSURL *)url {
+    NSMapTable *registry = [self registry];
+    @synchronized (registry) {
+        for (RTSPFrameBus *bus in registry.objectEnumerator) {
+            if (bus.videoOutput && [bus.currentURL isEqual:url]) {
+                return bus;
+            }
+        }
+    }
+    return nil;
+}
+
++ (instancetype)busPlayingURL:(NSURL *)url {
+    NSMapTable *registry = [self registry];
+    @synchronized (registry) {
+        for (RTSPFrameBus *bus in registry.objectEnumerator) {
+            if ([bus.playingURL isEqual:url]) {
+                return bus;
+            }
+        }
+    }
+    return nil;
+}
+
++ (NSArray<RTSPFrameBus *> *)allBuses {
+    NSMapTable *registry = [self registry];
+    NSMutableArray<RTSPFrameBus *> *buses = [NSMutableArray array];
+    NSMutableSet<NSURL *> *urls = [NSMutableSet set];
+    @synchronized (registry) {
+        for (RTSPFrameBus *bus in registry.objectEnumerator) {
+            // A camera in the main view and in the grid is one stream
+            NSURL *url = bus.playingURL;
+            if (url && ![urls containsObject:url]) {
+                [urls addObject:url];
+                [buses addObject:bus];
+            }
+        }
+    }
+    return buses;
+}
+
+- (instancetype)initWithPlayer:(AVPlayer *)player {
+    self = [super init];
+    if (self) {
+        _player = player;
+        _busQueue = dispatch_queue_create("com.rtsp.framebus", DISPATCH_QUEUE_SERIAL);
+        _subscribers = [NSMutableArray array];
+        _pendingRequests = [NSMutableArray array];
+        [self resetRingWithCapacity:kRTSPFrameBusDefaultCapacity];
+        [player addObserver:self
+                 forKeyPath:@"currentItem"
+                    options:NSKeyValueObservingOptionInitial | NSKeyValueObservingOptionNew
+                    context:kRTSPFrameBusCurrentItemContext];
+    }
+    return self;
+}
+
+- (void)observeValueForKeyPath:(NSString *)keyPath ofObject:(id)object change:(NSDictionary *)change context:(void *)context {
+    if (context != kRTSPFrameBusCurrentItemContext) {
+        [super observeValueForKeyPath:keyPath ofObject:object change:change context:context];
+        return;
+    }
+    [self updatePlayingURL];
+}
+
+/// Players change items on the main thread, so the item is read there;
+/// the registry lookups only ever see the URL recorded here
+- (void)updatePlayingURL {
+    if (![NSThread isMainThread]) {
+        __weak typeof(self) weakSelf = self;
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [weakSelf updatePlayingURL];
+        });
+        return;
+    }
+    AVAsset *asset = self.player.currentItem.asset;
+    NSURL *url = [asset isKindOfClass:[AVURLAsset class]] ? ((AVURLAsset *)asset).URL : nil;
+    @synchronized ([RTSPFrameBus registry]) {
+        self.playingURL = url;
+    }
+}
+
+- (void)resetRingWithCapacity:(NSUInteger)capacity {
+    _capacity = MAX(1, capacity);
+    _ring = [NSMutableArray arrayWithCapacity:_capacity];
+    for (NSUInteger i = 0; i < _capacity; i++) {
+        [_ring addObject:[NSNull null]];
+    }
+    _ringHead = 0;
+}
+
+- (void)setCapacity:(NSUInteger)capacity {
+    dispatch_sync(self.busQueue, ^{
+        [self resetRingWithCapacity:capacity];
+    });
+}
+
+#pragma mark - Subscribers
+
+- (id<NSObject>)addSubscriberWithRate:(double)framesPerSecond
+                                queue:(dispatch_queue_t)queue
+                              handler:(RTSPFrameBusHandler)handler {
+    RTSPFrameBusSubscriber *subscriber = [[RTSPFrameBusSubscriber alloc] init];
+    subscriber.minimumInterval = framesPerSecond > 0 ? 1.0 / framesPerSecond : 1.0;
+    subscriber.queue = queue ?: dispatch_queue_create("com.rtsp.framebus.subscriber", DISPATCH_QUEUE_SERIAL);
+    subscriber.handler = handler;
+    atomic_init(&subscriber->_busy, false);
+
+    dispatch_async(self.busQueue, ^{
+        [self.subscribers addObject:subscriber];
+        [self updatePollTimer];
+    });
+    return subscriber;
+}
+
+- (void)removeSubscriber:(id<NSObject>)token {
+    if (!token) {
+        return;
+    }
+    dispatch_async(self.busQueue, ^{
+        [self.subscribers removeObjectIdenticalTo:(RTSPFrameBusSubscriber *)token];
+        [self updatePollTimer];
+    });
+}
+
+/// Poll at the fastest subscriber rate; tear the tap down entirely when idle
+- (void)updatePollTimer {
+    NSTimeInterval interval = 0;
+    for (RTSPFrameBusSubscriber *subscriber in self.subscribers) {
+        if (interval == 0 || subscriber.minimumInterval < interval) {
+            interval = subscriber.minimumInterval;
+        }
+    }
+    interval = MAX(interval, 1.0 / kRTSPFrameBusMaxPollRate);
+
+    if (self.subscribers.count == 0) {
+        if (self.pollTimer) {
+            dispatch_source_cancel(self.pollTimer);
+            self.pollTimer = nil;
+        }
+        self.pollRate = 0;
+        [self detachVideoOutput];
+        return;
+    }
+
+    if (self.pollTimer && fabs(self.pollRate - 1.0 / interval) < 0.001) {
+        return;
+    }
+
+    if (!self.pollTimer) {
+        self.pollTimer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, self.busQueue);
+        __weak typeof(self) weakSelf = self;
+        dispatch_source_set_event_handler(self.pollTimer, ^{
+            [weakSelf poll];
+        });
+        dispatch_resume(self.pollTimer);
+    }
+    self.pollRate = 1.0 / interval;
+    dispatch_source_set_timer(self.pollTimer, dispatch_time(DISPATCH_TIME_NOW, 0),
+                              (uint64_t)(interval * NSEC_PER_SEC), (uint64_t)(interval * NSEC_PER_SEC / 10));
+}
+
+#pragma mark - Output
+
+- (void)attachVideoOutputIfNeeded {
+    AVPlayerItem *item = self.player.currentItem;
+    if (!item || item == self.outputItem) {
+        return;
+    }
+
+    [self detachVideoOutput];
+
+    NSDictionary *attributes = @{
+        (id)kCVPixelBufferPixelFormatTypeKey: @(kCVPixelFormatType_420YpCbCr8BiPlanarFullRange),
+        (id)kCVPixelBufferIOSurfacePropertiesKey: @{},
+        (id)kCVPixelBufferMetalCompatibilityKey: @YES   // Grid renders straight from these buffers
+    };
+    AVPlayerItemVideoOutput *output = [[AVPlayerItemVideoOutput alloc] initWithPixelBufferAttributes:attributes];
+    // AVPlayerItem output management must happen on the main thread
+    dispatch_async(dispatch_get_main_queue(), ^{
+        [item addOutput:output];
+    });
+    self.videoOutput = output;
+    self.outputItem = item;
+    self.currentURL = [item.asset isKindOfClass:[AVURLAsset class]] ? ((AVURLAsset *)item.asset).URL : nil;
+
+    // Frames from the previous item are no longer "recent"
+    [self resetRingWithCapacity:self.capacity];
+}
+
+- (void)detachVideoOutput {
+    AVPlayerItem *item = self.outputItem;
+    AVPlayerItemVideoOutput *output = self.videoOutput;
+    if (item && output) {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [item removeOutput:output];
+        });
+    }
+    self.videoOutput = nil;
+    self.outputItem = nil;
+    self.currentURL = nil;
+}
+
+- (RTSPDecodedFrame *)pullFrame {
+    [self attachVideoOutputIfNeeded];
+    if (!self.videoOutput) {
+        return nil;
+    }
+
+    CFTimeInterval hostTime = CACurrentMediaTime();
+    CMTime itemTime = [self.videoOutput itemTimeForHostTime:hostTime];
+    if (![self.videoOutput hasNewPixelBufferForItemTime:itemTime]) {
+        return nil;
+    }
+
+    CMTime displayTime = kCMTimeInvalid;
+    CVPixelBufferRef pixelBuffer = [self.videoOutput copyPixelBufferForItemTime:itemTime itemTimeForDisplay:&displayTime];
+    if (!pixelBuffer) {
+        return nil;
+    }
+
+    RTSPDecodedFrame *frame = [[RTSPDecodedFrame alloc] initWithPixelBuffer:pixelBuffer
+                                                           presentationTime:displayTime
+                                                                   hostTime:hostTime
+                                                             sequenceNumber:++_sequence];
+    CVPixelBufferRelease(pixelBuffer);
+
+    self.ring[self.ringHead] = frame;
+    self.ringHead = (self.ringHead + 1) % self.capacity;
+    _framesPulled++;
+    return frame;
+}
+
+- (void)poll {
+    RTSPDecodedFrame *frame = [self pullFrame];
+    if (!frame) {
+        return;
+    }
+
+    for (RTSPFrameBusSubscriber *subscriber in self.subscribers) {
+        if (frame.hostTime - subscriber.lastDeliveryTime < subscriber.minimumInterval * 0.95) {
+            continue;
+        }
+        // Slow consumers lose frames rather than building a backlog
+        bool expected = false;
+        if (!atomic_compare_exchange_strong(&subscriber->_busy, &expected, true)) {
+            atomic_fetch_add(&_framesSkipped, 1);
+            continue;
+        }
+        subscriber.lastDeliveryTime = frame.hostTime;
+        atomic_fetch_add(&_framesDelivered, 1);
+
+        dispatch_async(subscriber.queue, ^{
+            subscriber.handler(frame);
+            atomic_store(&subscriber->_busy, false);
+        });
+    }
+
+    [self completePendingRequestsWithFrame:frame];
+}
+
+- (void)completePendingRequestsWithFrame:(RTSPDecodedFrame *)frame {
+    if (self.pendingRequests.count == 0) {
+        return;
+    }
+    NSArray *requests = [self.pendingRequests copy];
+    [self.pendingRequests removeAllObjects];
+    for (void (^completion)(RTSPDecodedFrame *) in requests) {
+        [self deliverFrame:frame toRequest:completion];
+    }
+}
+
+/// Request completions never run on busQueue, so they may call the
+/// synchronous accessors
+- (void)deliverFrame:(RTSPDecodedFrame *)frame toRequest:(void (^)(RTSPDecodedFrame * _Nullable))completion {
+    dispatch_async(dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^{
+        completion(frame);
+    });
+}
+
+#pragma mark - Access
+
+- (RTSPDecodedFrame *)latestFrame {
+    __block RTSPDecodedFrame *frame = nil;
+    dispatch_sync(self.busQueue, ^{
+        frame = [self latestFrameLocked];
+    });
+    return frame;
+}
+
+- (RTSPDecodedFrame *)latestFrameLocked {
+    id object = self.ring[(self.ringHead + self.capacity - 1) % self.capacity];
+    return object == [NSNull null] ? nil : object;
+}
+
+- (NSArray<RTSPDecodedFrame *> *)recentFrames {
+    __block NSMutableArray *frames = [NSMutableArray array];
+    dispatch_sync(self.busQueue, ^{
+        for (NSUInteger i = 0; i < self.capacity; i++) {
+            id object = self.ring[(self.ringHead + i) % self.capacity];
+            if (object != [NSNull null]) {
+                [frames addObject:object];
+            }
+        }
+    });
+    return frames;
+}
+
+- (void)requestFrameWithMaximumAge:(NSTimeInterval)maxAge
+                        completion:(void (^)(RTSPDecodedFrame * _Nullable))completion {
+    if (!completion) {
+        return;
+    }
+
+    dispatch_async(self.busQueue, ^{
+        RTSPDecodedFrame *latest = [self latestFrameLocked];
+        if (latest && CACurrentMediaTime() - latest.hostTime <= maxAge) {
+            [self deliverFrame:latest toRequest:completion];
+            return;
+        }
+
+        RTSPDecodedFrame *frame = [self pullFrame];
+        if (frame) {
+            [self completePendingRequestsWithFrame:frame];
+            [self deliverFrame:frame toRequest:completion];
+            return;
+        }
+
+        if (!self.videoOutput) {
+            [self deliverFrame:latest toRequest:completion];
+            return;
+        }
+
+        // Output was just attached or has nothing new yet; wait for the next poll
+        void (^request)(RTSPDecodedFrame * _Nullable) = [completion copy];
+        [self.pendingRequests addObject:request];
+        if (!self.pollTimer) {
+            dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(0.1 * NSEC_PER_SEC)), self.busQueue, ^{
+                [self completePendingRequestsWithFrame:[self pullFrame] ?: [self latestFrameLocked]];
+                if (self.subscribers.count == 0) {
+                    [self detachVideoOutput];
+                }
+            });
+        }
+
+        // A paused, stalled or disconnected player never produces the next
+        // frame; settle for the newest one held (or nil) after maxAge
+        NSTimeInterval deadline = MAX(maxAge, 0.1);
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(deadline * NSEC_PER_SEC)), self.busQueue, ^{
+            NSUInteger index = [self.pendingRequests indexOfObjectIdenticalTo:request];
+            if (index != NSNotFound) {
+                [self.pendingRequests removeObjectAtIndex:index];
+                [self deliverFrame:[self latestFrameLocked] toRequest:request];
+            }
+        });
+    });
+}
+
+- (NSDictionary<NSString *, NSNumber *> *)statistics {
+    __block NSDictionary *stats = nil;
+    dispatch_sync(self.busQueue, ^{
+        stats = @{
+            @"framesPulled": @(self->_framesPulled),
+            @"framesDelivered": @(atomic_load(&self->_framesDelivered)),
+            @"framesSkipped": @(atomic_load(&self->_framesSkipped)),
+            @"subscribers": @(self.subscribers.count),
+            @"pollRate": @(self.pollRate)
+        };
+    });
+    return stats;
+}
+
+- (void)dealloc {
+    [_player removeObserver:self forKeyPath:@"currentItem" context:kRTSPFrameBusCurrentItemContext];
+    if (_pollTimer) {
+        dispatch_source_cancel(_pollTimer);
+    }
+    if (_outputItem && _videoOutput) {
+        AVPlayerItem *item = _outputItem;
+        AVPlayerItemVideoOutput *output = _videoOutput;
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [item removeOutput:output];
+        });
+    }
+}
+
+@end
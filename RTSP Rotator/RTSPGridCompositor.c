@@ -0,0 +1,665 @@
+//
+//  RTSPGridCompositor.c
+//  RTSP Rotator
+//
+
+#include "RTSPGridCompositor.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RTSP_GRID_LABEL_MAX 64
+#define RTSP_GRID_DIAGNOSTICS_MAX 48
+#define RTSP_GRID_TIMESTAMP_MAX 32
+
+// Overlay geometry in points, as the per-cell NSTextFields were laid out
+#define RTSP_GRID_INSET 8.0f
+#define RTSP_GRID_STATUS_SIZE 12.0f
+#define RTSP_GRID_BAR_HEIGHT 20.0f
+#define RTSP_GRID_BAR_BOTTOM 28.0f                 // Bar top, measured up from the tile's bottom edge
+#define RTSP_GRID_TIMESTAMP_WIDTH 142.0f
+#define RTSP_GRID_DIAGNOSTICS_WIDTH 92.0f
+#define RTSP_GRID_DIAGNOSTICS_HEIGHT 16.0f
+#define RTSP_GRID_DIAGNOSTICS_TOP 4.0f
+#define RTSP_GRID_TEXT_PADDING 3.0f
+#define RTSP_GRID_FOCUS_WIDTH 2.0f
+
+#define RTSP_GRID_BAR_COLOR 0xB3000000u            // Black at 0.7
+#define RTSP_GRID_TEXT_COLOR 0xFFFFFFFFu
+
+typedef struct {
+    RTSPGridCompositorTile state;                  // label/diagnostics point into the buffers below
+    char label[RTSP_GRID_LABEL_MAX];
+    char diagnostics[RTSP_GRID_DIAGNOSTICS_MAX];
+    float rect[4];
+} RTSPGridCompositorTileSlot;
+
+struct RTSPGridCompositor {
+    RTSPGridCompositorConfig config;
+    RTSPGridCompositorAtlas atlas;
+    bool hasAtlas;
+    uint32_t tileCount;
+    RTSPGridCompositorTileSlot tiles[RTSP_GRID_COMPOSITOR_MAX_TILES];
+    char timestamp[RTSP_GRID_TIMESTAMP_MAX];
+
+    bool overlayDirty;
+    bool needsDisplay;
+    bool clearTarget;                              // Software target must be cleared whole
+    bool damage[RTSP_GRID_COMPOSITOR_MAX_TILES];         // Since the last build
+    bool renderDamage[RTSP_GRID_COMPOSITOR_MAX_TILES];   // Since the last software render
+
+    RTSPGridCompositorQuad *overlay;               // Cached overlay batch
+    uint32_t overlayCount;
+    uint32_t overlayCapacity;
+    uint32_t glyphCount;
+
+    RTSPGridCompositorQuad *quads;                 // Last build: video quads, then the overlay batch
+    uint32_t videoCount;
+    uint32_t quadCapacity;
+
+    uint32_t *columnMap;                           // Software scaler: source column per target column
+    uint32_t columnMapCapacity;
+
+    // Full-range BT.709 NV12 -> RGB lookup tables
+    int16_t crToR[256];
+    int16_t cbToG[256];
+    int16_t crToG[256];
+    int16_t cbToB[256];
+    uint8_t clamp[1024];                           // Index value + 256
+
+    RTSPGridCompositorStatistics statistics;
+};
+
+#pragma mark - Configuration
+
+void RTSPGridCompositorConfigInit(RTSPGridCompositorConfig *config, uint32_t width, uint32_t height,
+                                  uint32_t rows, uint32_t columns) {
+    memset(config, 0, sizeof(*config));
+    config->width = width;
+    config->height = height;
+    config->rows = rows;
+    config->columns = columns;
+    config->spacing = 2.0f;
+    config->scale = 1.0f;
+    config->focusColor = 0xFF0A84FFu;
+}
+
+static bool RTSPGridCompositorConfigValid(const RTSPGridCompositorConfig *config) {
+    return config && config->width > 0 && config->height > 0 && config->rows > 0 && config->columns > 0 &&
+           config->rows * config->columns <= RTSP_GRID_COMPOSITOR_MAX_TILES && config->scale > 0.0f &&
+           config->spacing >= 0.0f;
+}
+
+/// Same arithmetic as RTSPMultiViewGrid's cell frames, in pixels
+static void RTSPGridCompositorLayout(RTSPGridCompositorRef compositor) {
+    const RTSPGridCompositorConfig *config = &compositor->config;
+    float spacing = config->spacing * config->scale;
+    float cellWidth = ((float)config->width - spacing * (float)(config->columns + 1)) / (float)config->columns;
+    float cellHeight = ((float)config->height - spacing * (float)(config->rows + 1)) / (float)config->rows;
+    for (uint32_t i = 0; i < compositor->tileCount; i++) {
+        uint32_t row = i / config->columns;
+        uint32_t column = i % config->columns;
+        float *rect = compositor->tiles[i].rect;
+        rect[0] = spacing + (float)column * (cellWidth + spacing);
+        rect[1] = spacing + (float)row * (cellHeight + spacing);
+        rect[2] = cellWidth > 0 ? cellWidth : 0;
+        rect[3] = cellHeight > 0 ? cellHeight : 0;
+    }
+}
+
+static void RTSPGridCompositorDamageAll(RTSPGridCompositorRef compositor) {
+    for (uint32_t i = 0; i < compositor->tileCount; i++) {
+        compositor->damage[i] = true;
+    }
+    compositor->clearTarget = true;
+    compositor->overlayDirty = true;
+    compositor->needsDisplay = true;
+}
+
+bool RTSPGridCompositorReconfigure(RTSPGridCompositorRef compositor, const RTSPGridCompositorConfig *config) {
+    if (!compositor || !RTSPGridCompositorConfigValid(config)) {
+        return false;
+    }
+    uint32_t columns = config->width;
+    if (columns > compositor->columnMapCapacity) {
+        uint32_t *map = realloc(compositor->columnMap, columns * sizeof(*map));
+        if (!map) {
+            return false;
+        }
+        compositor->columnMap = map;
+        compositor->columnMapCapacity = columns;
+    }
+
+    uint32_t tileCount = config->rows * config->columns;
+    for (uint32_t i = tileCount; i < compositor->tileCount; i++) {
+        memset(&compositor->tiles[i], 0, sizeof(compositor->tiles[i]));
+    }
+    compositor->config = *config;
+    compositor->hasAtlas = config->atlas != NULL;
+    if (config->atlas) {
+        compositor->atlas = *config->atlas;
+    }
+    compositor->config.atlas = compositor->hasAtlas ? &compositor->atlas : NULL;
+    compositor->tileCount = tileCount;
+    RTSPGridCompositorLayout(compositor);
+    RTSPGridCompositorDamageAll(compositor);
+    return true;
+}
+
+RTSPGridCompositorRef RTSPGridCompositorCreate(const RTSPGridCompositorConfig *config) {
+    if (!RTSPGridCompositorConfigValid(config)) {
+        return NULL;
+    }
+    RTSPGridCompositorRef compositor = calloc(1, sizeof(*compositor));
+    if (!compositor) {
+        return NULL;
+    }
+    for (int i = 0; i < 256; i++) {
+        double c = i - 128;
+        compositor->crToR[i] = (int16_t)lround(1.5748 * c);
+        compositor->cbToG[i] = (int16_t)lround(0.1873 * c);
+        compositor->crToG[i] = (int16_t)lround(0.4681 * c);
+        compositor->cbToB[i] = (int16_t)lround(1.8556 * c);
+    }
+    for (int i = 0; i < 1024; i++) {
+        int value = i - 256;
+        compositor->clamp[i] = (uint8_t)(value < 0 ? 0 : value > 255 ? 255 : value);
+    }
+    if (!RTSPGridCompositorReconfigure(compositor, config)) {
+        RTSPGridCompositorRelease(compositor);
+        return NULL;
+    }
+    return compositor;
+}
+
+void RTSPGridCompositorRelease(RTSPGridCompositorRef compositor) {
+    if (!compositor) {
+        return;
+    }
+    free(compositor->overlay);
+    free(compositor->quads);
+    free(compositor->columnMap);
+    free(compositor);
+}
+
+uint32_t RTSPGridCompositorTileCount(RTSPGridCompositorRef compositor) {
+    return compositor ? compositor->tileCount : 0;
+}
+
+bool RTSPGridCompositorTileRect(RTSPGridCompositorRef compositor, uint32_t tile, float rect[4]) {
+    if (!compositor || tile >= compositor->tileCount) {
+        return false;
+    }
+    memcpy(rect, compositor->tiles[tile].rect, 4 * sizeof(float));
+    return true;
+}
+
+#pragma mark - Tile State
+
+static bool RTSPGridCompositorCopyText(char *buffer, size_t capacity, const char *text) {
+    char previous[RTSP_GRID_LABEL_MAX];
+    memcpy(previous, buffer, capacity);
+    size_t length = text ? strnlen(text, capacity - 1) : 0;
+    memcpy(buffer, text ? text : "", length);
+    buffer[length] = '\0';
+    return strcmp(previous, buffer) != 0;
+}
+
+bool RTSPGridCompositorSetTile(RTSPGridCompositorRef compositor, uint32_t tile, const RTSPGridCompositorTile *state) {
+    if (!compositor || !state || tile >= compositor->tileCount) {
+        return false;
+    }
+    RTSPGridCompositorTileSlot *slot = &compositor->tiles[tile];
+    bool changed = false;
+    changed |= RTSPGridCompositorCopyText(slot->label, sizeof(slot->label), state->label);
+    changed |= RTSPGridCompositorCopyText(slot->diagnostics, sizeof(slot->diagnostics), state->diagnostics);
+    bool frameChanged = slot->state.frameWidth != state->frameWidth || slot->state.frameHeight != state->frameHeight;
+    changed |= frameChanged || slot->state.statusColor != state->statusColor || slot->state.focused != state->focused ||
+               slot->state.showLabel != state->showLabel || slot->state.showTimestamp != state->showTimestamp ||
+               slot->state.showDiagnostics != state->showDiagnostics;
+
+    slot->state = *state;
+    slot->state.label = slot->label;
+    slot->state.diagnostics = slot->diagnostics;
+    if (changed) {
+        compositor->overlayDirty = true;
+        compositor->damage[tile] = true;
+        compositor->needsDisplay = true;
+    }
+    return changed;
+}
+
+void RTSPGridCompositorSetTimestamp(RTSPGridCompositorRef compositor, const char *timestamp) {
+    if (!compositor || !RTSPGridCompositorCopyText(compositor->timestamp, sizeof(compositor->timestamp), timestamp)) {
+        return;
+    }
+    for (uint32_t i = 0; i < compositor->tileCount; i++) {
+        if (compositor->tiles[i].state.showTimestamp) {
+            compositor->damage[i] = true;
+            compositor->overlayDirty = true;
+            compositor->needsDisplay = true;
+        }
+    }
+}
+
+void RTSPGridCompositorMarkFrame(RTSPGridCompositorRef compositor, uint32_t tile) {
+    if (compositor && tile < compositor->tileCount) {
+        compositor->damage[tile] = true;
+        compositor->needsDisplay = true;
+    }
+}
+
+bool RTSPGridCompositorNeedsDisplay(RTSPGridCompositorRef compositor) {
+    return compositor && compositor->needsDisplay;
+}
+
+#pragma mark - Quad Generation
+
+static bool RTSPGridCompositorReserve(RTSPGridCompositorQuad **quads, uint32_t *capacity, uint32_t count) {
+    if (count <= *capacity) {
+        return true;
+    }
+    uint32_t grown = *capacity ? *capacity * 2 : 256;
+    while (grown < count) {
+        grown *= 2;
+    }
+    RTSPGridCompositorQuad *resized = realloc(*quads, grown * sizeof(**quads));
+    if (!resized) {
+        return false;
+    }
+    *quads = resized;
+    *capacity = grown;
+    return true;
+}
+
+static void RTSPGridCompositorAppend(RTSPGridCompositorRef compositor, uint32_t tile, RTSPGridCompositorQuadKind kind,
+                                     float x0, float y0, float x1, float y1, uint32_t color) {
+    if (x1 <= x0 || y1 <= y0 || (color >> 24) == 0 ||
+        !RTSPGridCompositorReserve(&compositor->overlay, &compositor->overlayCapacity, compositor->overlayCount + 1)) {
+        return;
+    }
+    compositor->overlay[compositor->overlayCount++] = (RTSPGridCompositorQuad){
+        .x0 = x0, .y0 = y0, .x1 = x1, .y1 = y1,
+        .u1 = 1.0f, .v1 = 1.0f,
+        .color = color, .tile = (uint16_t)tile, .kind = (uint16_t)kind
+    };
+}
+
+static const RTSPGridCompositorGlyph *RTSPGridCompositorGlyphFor(RTSPGridCompositorRef compositor, char c) {
+    unsigned index = (unsigned char)c - RTSP_GRID_COMPOSITOR_FIRST_GLYPH;
+    return index < RTSP_GRID_COMPOSITOR_GLYPH_COUNT ? &compositor->atlas.glyphs[index] : &compositor->atlas.glyphs['?' - RTSP_GRID_COMPOSITOR_FIRST_GLYPH];
+}
+
+static float RTSPGridCompositorTextWidth(RTSPGridCompositorRef compositor, const char *text) {
+    float width = 0;
+    for (const char *c = text; *c; c++) {
+        width += RTSPGridCompositorGlyphFor(compositor, *c)->advance;
+    }
+    return width;
+}
+
+/// Glyph quads for one line, vertically centered in the box and clipped at its edges
+static void RTSPGridCompositorAppendText(RTSPGridCompositorRef compositor, uint32_t tile, const char *text,
+                                         float left, float top, float width, float height, bool alignRight) {
+    if (!compositor->hasAtlas || !text[0]) {
+        return;
+    }
+    const RTSPGridCompositorAtlas *atlas = &compositor->atlas;
+    float padding = RTSP_GRID_TEXT_PADDING * compositor->config.scale;
+    float right = left + width - padding;
+    float pen = left + padding;
+    if (alignRight) {
+        float textWidth = RTSPGridCompositorTextWidth(compositor, text);
+        if (right - textWidth > pen) {
+            pen = right - textWidth;
+        }
+    }
+    float baseline = floorf(top + (height - (float)atlas->lineHeight) / 2.0f + (float)atlas->ascent + 0.5f);
+    pen = floorf(pen + 0.5f);
+
+    for (const char *c = text; *c; c++) {
+        const RTSPGridCompositorGlyph *glyph = RTSPGridCompositorGlyphFor(compositor, *c);
+        float x0 = pen + glyph->bearingX;
+        float y0 = baseline - glyph->bearingY;
+        float x1 = x0 + glyph->width;
+        float y1 = y0 + glyph->height;
+        if (x1 > right) {
+            break;
+        }
+        if (glyph->width > 0 && glyph->height > 0 && y0 >= top && y1 <= top + height &&
+            RTSPGridCompositorReserve(&compositor->overlay, &compositor->overlayCapacity, compositor->overlayCount + 1)) {
+            compositor->overlay[compositor->overlayCount++] = (RTSPGridCompositorQuad){
+                .x0 = x0, .y0 = y0, .x1 = x1, .y1 = y1,
+                .u0 = (float)glyph->x / (float)atlas->width,
+                .v0 = (float)glyph->y / (float)atlas->height,
+                .u1 = (float)(glyph->x + glyph->width) / (float)atlas->width,
+                .v1 = (float)(glyph->y + glyph->height) / (float)atlas->height,
+                .color = RTSP_GRID_TEXT_COLOR, .tile = (uint16_t)tile, .kind = RTSPGridCompositorQuadGlyph
+            };
+            compositor->glyphCount++;
+        }
+        pen += glyph->advance;
+    }
+}
+
+static void RTSPGridCompositorBuildOverlay(RTSPGridCompositorRef compositor) {
+    float s = compositor->config.scale;
+    compositor->overlayCount = 0;
+    compositor->glyphCount = 0;
+
+    for (uint32_t i = 0; i < compositor->tileCount; i++) {
+        const RTSPGridCompositorTileSlot *slot = &compositor->tiles[i];
+        const RTSPGridCompositorTile *state = &slot->state;
+        float x = slot->rect[0], y = slot->rect[1], w = slot->rect[2], h = slot->rect[3];
+        if (w <= 0 || h <= 0) {
+            continue;
+        }
+
+        if ((state->statusColor >> 24) != 0) {
+            float inset = RTSP_GRID_INSET * s;
+            RTSPGridCompositorAppend(compositor, i, RTSPGridCompositorQuadDisc, x + inset, y + inset,
+                                     x + inset + RTSP_GRID_STATUS_SIZE * s, y + inset + RTSP_GRID_STATUS_SIZE * s,
+                                     state->statusColor);
+        }
+        if (state->showDiagnostics && slot->diagnostics[0]) {
+            float bx = x + w - (RTSP_GRID_INSET + RTSP_GRID_DIAGNOSTICS_WIDTH) * s;
+            float by = y + RTSP_GRID_DIAGNOSTICS_TOP * s;
+            float bw = RTSP_GRID_DIAGNOSTICS_WIDTH * s, bh = RTSP_GRID_DIAGNOSTICS_HEIGHT * s;
+            RTSPGridCompositorAppend(compositor, i, RTSPGridCompositorQuadSolid, bx, by, bx + bw, by + bh, RTSP_GRID_BAR_COLOR);
+            RTSPGridCompositorAppendText(compositor, i, slot->diagnostics, bx, by, bw, bh, true);
+        }
+        float barTop = y + h - RTSP_GRID_BAR_BOTTOM * s;
+        float barHeight = RTSP_GRID_BAR_HEIGHT * s;
+        if (state->showLabel && slot->label[0]) {
+            float bx = x + RTSP_GRID_INSET * s, bw = w - 2 * RTSP_GRID_INSET * s;
+            RTSPGridCompositorAppend(compositor, i, RTSPGridCompositorQuadSolid, bx, barTop, bx + bw, barTop + barHeight, RTSP_GRID_BAR_COLOR);
+            RTSPGridCompositorAppendText(compositor, i, slot->label, bx, barTop, bw, barHeight, false);
+        }
+        if (state->showTimestamp && compositor->timestamp[0]) {
+            float bw = RTSP_GRID_TIMESTAMP_WIDTH * s;
+            float bx = x + w - RTSP_GRID_INSET * s - bw;
+            RTSPGridCompositorAppend(compositor, i, RTSPGridCompositorQuadSolid, bx, barTop, bx + bw, barTop + barHeight, RTSP_GRID_BAR_COLOR);
+            RTSPGridCompositorAppendText(compositor, i, compositor->timestamp, bx, barTop, bw, barHeight, true);
+        }
+        if (state->focused) {
+            float b = RTSP_GRID_FOCUS_WIDTH * s;
+            uint32_t color = compositor->config.focusColor;
+            RTSPGridCompositorAppend(compositor, i, RTSPGridCompositorQuadSolid, x, y, x + w, y + b, color);
+            RTSPGridCompositorAppend(compositor, i, RTSPGridCompositorQuadSolid, x, y + h - b, x + w, y + h, color);
+            RTSPGridCompositorAppend(compositor, i, RTSPGridCompositorQuadSolid, x, y + b, x + b, y + h - b, color);
+            RTSPGridCompositorAppend(compositor, i, RTSPGridCompositorQuadSolid, x + w - b, y + b, x + w, y + h - b, color);
+        }
+    }
+    compositor->overlayDirty = false;
+    compositor->statistics.overlayRebuilds++;
+}
+
+/// Frame rectangle fitted inside the tile, preserving aspect ratio
+static void RTSPGridCompositorFitFrame(const RTSPGridCompositorTileSlot *slot, float out[4]) {
+    float w = slot->rect[2], h = slot->rect[3];
+    float scale = fminf(w / (float)slot->state.frameWidth, h / (float)slot->state.frameHeight);
+    float fw = floorf((float)slot->state.frameWidth * scale + 0.5f);
+    float fh = floorf((float)slot->state.frameHeight * scale + 0.5f);
+    out[0] = slot->rect[0] + floorf((w - fw) / 2.0f);
+    out[1] = slot->rect[1] + floorf((h - fh) / 2.0f);
+    out[2] = out[0] + fw;
+    out[3] = out[1] + fh;
+}
+
+const RTSPGridCompositorQuad *RTSPGridCompositorBuild(RTSPGridCompositorRef compositor,
+                                                      uint32_t *videoQuads, uint32_t *overlayQuads) {
+    if (!compositor) {
+        return NULL;
+    }
+    if (compositor->overlayDirty) {
+        RTSPGridCompositorBuildOverlay(compositor);
+    }
+    if (!RTSPGridCompositorReserve(&compositor->quads, &compositor->quadCapacity,
+                                   compositor->tileCount + compositor->overlayCount)) {
+        return NULL;
+    }
+
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < compositor->tileCount; i++) {
+        const RTSPGridCompositorTileSlot *slot = &compositor->tiles[i];
+        if (slot->state.frameWidth == 0 || slot->state.frameHeight == 0 || slot->rect[2] <= 0 || slot->rect[3] <= 0) {
+            continue;
+        }
+        float fit[4];
+        RTSPGridCompositorFitFrame(slot, fit);
+        compositor->quads[count++] = (RTSPGridCompositorQuad){
+            .x0 = fit[0], .y0 = fit[1], .x1 = fit[2], .y1 = fit[3],
+            .u1 = 1.0f, .v1 = 1.0f,
+            .color = 0xFFFFFFFFu, .tile = (uint16_t)i, .kind = RTSPGridCompositorQuadVideo
+        };
+    }
+    compositor->videoCount = count;
+    memcpy(compositor->quads + count, compositor->overlay, compositor->overlayCount * sizeof(*compositor->overlay));
+
+    for (uint32_t i = 0; i < compositor->tileCount; i++) {
+        compositor->renderDamage[i] |= compositor->damage[i];
+        compositor->damage[i] = false;
+    }
+    compositor->needsDisplay = false;
+    compositor->statistics.builds++;
+    compositor->statistics.videoQuads = count;
+    compositor->statistics.overlayQuads = compositor->overlayCount;
+    compositor->statistics.glyphQuads = compositor->glyphCount;
+
+    if (videoQuads) {
+        *videoQuads = count;
+    }
+    if (overlayQuads) {
+        *overlayQuads = compositor->overlayCount;
+    }
+    return compositor->quads;
+}
+
+#pragma mark - Software Backend
+
+typedef struct {
+    int32_t x0, y0, x1, y1;
+} RTSPGridPixelRect;
+
+static RTSPGridPixelRect RTSPGridCompositorPixelRect(RTSPGridCompositorRef compositor, float x0, float y0, float x1, float y1) {
+    RTSPGridPixelRect r = {
+        (int32_t)lroundf(x0), (int32_t)lroundf(y0), (int32_t)lroundf(x1), (int32_t)lroundf(y1)
+    };
+    int32_t w = (int32_t)compositor->config.width, h = (int32_t)compositor->config.height;
+    r.x0 = r.x0 < 0 ? 0 : r.x0 > w ? w : r.x0;
+    r.x1 = r.x1 < 0 ? 0 : r.x1 > w ? w : r.x1;
+    r.y0 = r.y0 < 0 ? 0 : r.y0 > h ? h : r.y0;
+    r.y1 = r.y1 < 0 ? 0 : r.y1 > h ? h : r.y1;
+    return r;
+}
+
+static void RTSPGridCompositorFillBlack(uint8_t *target, size_t bytesPerRow, int32_t x0, int32_t y0, int32_t x1, int32_t y1) {
+    if (x1 <= x0) {
+        return;
+    }
+    for (int32_t y = y0; y < y1; y++) {
+        uint32_t *row = (uint32_t *)(target + (size_t)y * bytesPerRow) + x0;
+        for (int32_t x = 0; x < x1 - x0; x++) {
+            row[x] = 0xFF000000u;
+        }
+    }
+}
+
+static inline uint8_t RTSPGridCompositorMix(uint8_t src, uint8_t dst, uint32_t alpha) {
+    uint32_t value = src * alpha + dst * (255 - alpha);
+    return (uint8_t)((value + 1 + (value >> 8)) >> 8);
+}
+
+static inline void RTSPGridCompositorBlend(uint8_t *pixel, uint32_t color, uint32_t alpha) {
+    if (alpha == 0) {
+        return;
+    }
+    pixel[0] = RTSPGridCompositorMix((uint8_t)color, pixel[0], alpha);
+    pixel[1] = RTSPGridCompositorMix((uint8_t)(color >> 8), pixel[1], alpha);
+    pixel[2] = RTSPGridCompositorMix((uint8_t)(color >> 16), pixel[2], alpha);
+    pixel[3] = 0xFF;
+}
+
+/// Nearest-neighbour scale of one image into the quad's rectangle
+static void RTSPGridCompositorDrawVideo(RTSPGridCompositorRef compositor, const RTSPGridCompositorQuad *quad,
+                                        const RTSPGridCompositorImage *image, uint8_t *target, size_t bytesPerRow) {
+    RTSPGridPixelRect r = RTSPGridCompositorPixelRect(compositor, quad->x0, quad->y0, quad->x1, quad->y1);
+    int32_t width = r.x1 - r.x0, height = r.y1 - r.y0;
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+    if (!image || image->format == RTSPGridCompositorPixelFormatNone || image->width == 0 || image->height == 0 ||
+        !image->planes[0] || (image->format == RTSPGridCompositorPixelFormatNV12 && !image->planes[1])) {
+        RTSPGridCompositorFillBlack(target, bytesPerRow, r.x0, r.y0, r.x1, r.y1);
+        return;
+    }
+
+    uint32_t *columns = compositor->columnMap;
+    uint64_t stepX = ((uint64_t)image->width << 16) / (uint64_t)width;
+    uint64_t stepY = ((uint64_t)image->height << 16) / (uint64_t)height;
+    for (int32_t x = 0; x < width; x++) {
+        uint32_t sx = (uint32_t)(((uint64_t)x * stepX + stepX / 2) >> 16);
+        columns[x] = sx < image->width ? sx : image->width - 1;
+    }
+
+    for (int32_t y = 0; y < height; y++) {
+        uint32_t sy = (uint32_t)(((uint64_t)y * stepY + stepY / 2) >> 16);
+        sy = sy < image->height ? sy : image->height - 1;
+        uint32_t *out = (uint32_t *)(target + (size_t)(r.y0 + y) * bytesPerRow) + r.x0;
+
+        if (image->format == RTSPGridCompositorPixelFormatBGRA8) {
+            const uint32_t *in = (const uint32_t *)(image->planes[0] + (size_t)sy * image->bytesPerRow[0]);
+            for (int32_t x = 0; x < width; x++) {
+                out[x] = in[columns[x]] | 0xFF000000u;
+            }
+            continue;
+        }
+
+        const uint8_t *luma = image->planes[0] + (size_t)sy * image->bytesPerRow[0];
+        const uint8_t *chroma = image->planes[1] + (size_t)(sy / 2) * image->bytesPerRow[1];
+        const uint8_t *clamp = compositor->clamp + 256;
+        for (int32_t x = 0; x < width; x++) {
+            uint32_t sx = columns[x];
+            int32_t l = luma[sx];
+            const uint8_t *cbcr = chroma + (sx & ~1u);
+            int32_t r8 = l + compositor->crToR[cbcr[1]];
+            int32_t g8 = l - compositor->cbToG[cbcr[0]] - compositor->crToG[cbcr[1]];
+            int32_t b8 = l + compositor->cbToB[cbcr[0]];
+            out[x] = 0xFF000000u | ((uint32_t)clamp[r8] << 16) | ((uint32_t)clamp[g8] << 8) | clamp[b8];
+        }
+    }
+}
+
+static void RTSPGridCompositorDrawOverlay(RTSPGridCompositorRef compositor, const RTSPGridCompositorQuad *quad,
+                                          uint8_t *target, size_t bytesPerRow) {
+    RTSPGridPixelRect r = RTSPGridCompositorPixelRect(compositor, quad->x0, quad->y0, quad->x1, quad->y1);
+    uint32_t alpha = quad->color >> 24;
+
+    switch (quad->kind) {
+        case RTSPGridCompositorQuadSolid:
+            for (int32_t y = r.y0; y < r.y1; y++) {
+                uint8_t *row = target + (size_t)y * bytesPerRow;
+                for (int32_t x = r.x0; x < r.x1; x++) {
+                    RTSPGridCompositorBlend(row + 4 * x, quad->color, alpha);
+                }
+            }
+            break;
+
+        case RTSPGridCompositorQuadDisc: {
+            float cx = (quad->x0 + quad->x1) / 2.0f, cy = (quad->y0 + quad->y1) / 2.0f;
+            float radius = (quad->x1 - quad->x0) / 2.0f;
+            for (int32_t y = r.y0; y < r.y1; y++) {
+                uint8_t *row = target + (size_t)y * bytesPerRow;
+                for (int32_t x = r.x0; x < r.x1; x++) {
+                    float dx = (float)x + 0.5f - cx, dy = (float)y + 0.5f - cy;
+                    float coverage = radius - sqrtf(dx * dx + dy * dy) + 0.5f;
+                    coverage = coverage < 0 ? 0 : coverage > 1 ? 1 : coverage;
+                    RTSPGridCompositorBlend(row + 4 * x, quad->color, (uint32_t)(coverage * (float)alpha + 0.5f));
+                }
+            }
+            break;
+        }
+
+        case RTSPGridCompositorQuadGlyph: {
+            const RTSPGridCompositorAtlas *atlas = &compositor->atlas;
+            if (!compositor->hasAtlas || !atlas->coverage) {
+                break;
+            }
+            // Glyph quads map atlas pixels 1:1; (ax, ay) is the atlas pixel under (r.x0, r.y0)
+            int32_t ax = (int32_t)lroundf(quad->u0 * (float)atlas->width) + r.x0 - (int32_t)lroundf(quad->x0);
+            int32_t ay = (int32_t)lroundf(quad->v0 * (float)atlas->height) + r.y0 - (int32_t)lroundf(quad->y0);
+            for (int32_t y = r.y0; y < r.y1; y++) {
+                const uint8_t *coverage = atlas->coverage + (size_t)(ay + y - r.y0) * atlas->bytesPerRow + ax;
+                uint8_t *row = target + (size_t)y * bytesPerRow;
+                for (int32_t x = r.x0; x < r.x1; x++) {
+                    RTSPGridCompositorBlend(row + 4 * x, quad->color, (coverage[x - r.x0] * alpha + 127) / 255);
+                }
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+uint32_t RTSPGridCompositorRenderSoftware(RTSPGridCompositorRef compositor, const RTSPGridCompositorImage *images,
+                                          uint8_t *target, size_t bytesPerRow) {
+    if (!compositor || !target || bytesPerRow < (size_t)compositor->config.width * 4) {
+        return 0;
+    }
+    if (compositor->clearTarget) {
+        RTSPGridCompositorFillBlack(target, bytesPerRow, 0, 0, (int32_t)compositor->config.width,
+                                    (int32_t)compositor->config.height);
+        compositor->clearTarget = false;
+    }
+
+    const RTSPGridCompositorQuad *quads = compositor->quads;
+    bool redrawn[RTSP_GRID_COMPOSITOR_MAX_TILES];
+    uint32_t drawn = 0;
+    uint32_t next = 0;                      // Video quads are in tile order
+    for (uint32_t i = 0; i < compositor->tileCount; i++) {
+        const RTSPGridCompositorQuad *video = NULL;
+        if (next < compositor->videoCount && quads[next].tile == i) {
+            video = &quads[next++];
+        }
+        redrawn[i] = compositor->renderDamage[i];
+        if (!redrawn[i]) {
+            continue;
+        }
+        compositor->renderDamage[i] = false;
+        drawn++;
+
+        const float *rect = compositor->tiles[i].rect;
+        RTSPGridPixelRect tile = RTSPGridCompositorPixelRect(compositor, rect[0], rect[1], rect[0] + rect[2], rect[1] + rect[3]);
+        if (!video) {
+            RTSPGridCompositorFillBlack(target, bytesPerRow, tile.x0, tile.y0, tile.x1, tile.y1);
+            continue;
+        }
+        // Letterbox bands, then the frame over the rest
+        RTSPGridPixelRect frame = RTSPGridCompositorPixelRect(compositor, video->x0, video->y0, video->x1, video->y1);
+        RTSPGridCompositorFillBlack(target, bytesPerRow, tile.x0, tile.y0, tile.x1, frame.y0);
+        RTSPGridCompositorFillBlack(target, bytesPerRow, tile.x0, frame.y1, tile.x1, tile.y1);
+        RTSPGridCompositorFillBlack(target, bytesPerRow, tile.x0, frame.y0, frame.x0, frame.y1);
+        RTSPGridCompositorFillBlack(target, bytesPerRow, frame.x1, frame.y0, tile.x1, frame.y1);
+        RTSPGridCompositorDrawVideo(compositor, video, images ? &images[i] : NULL, target, bytesPerRow);
+    }
+
+    // Overlays go over the tiles just redrawn, in batch order
+    for (uint32_t i = compositor->videoCount; drawn > 0 && i < compositor->videoCount + compositor->overlayCount; i++) {
+        if (redrawn[quads[i].tile]) {
+            RTSPGridCompositorDrawOverlay(compositor, &quads[i], target, bytesPerRow);
+        }
+    }
+    compositor->statistics.tilesRasterized += drawn;
+    return drawn;
+}
+
+RTSPGridCompositorStatistics RTSPGridCompositorGetStatistics(RTSPGridCompositorRef compositor) {
+    RTSPGridCompositorStatistics statistics = {0};
+    if (compositor) {
+        statistics = compositor->statistics;
+    }
+    return statistics;
+}
@@ -0,0 +1,177 @@
+//
+//  RTSPGridCompositor.h
+//  RTSP Rotator
+//
+//  Scene model for the multi-view grid drawn as one surface. Holds the tile
+//  layout and each tile's overlay state (label, timestamp, diagnostics,
+//  status dot, focus ring) and turns them into a single list of quads: one
+//  textured quad per tile for the video, then every overlay rectangle and
+//  glyph as one batch drawn against a glyph atlas. Overlay quads are only
+//  regenerated when some overlay changes.
+//
+//  Backends consume the quad list. RTSPGridRenderView draws it with Metal;
+//  RTSPGridCompositorRenderSoftware rasterizes it into a BGRA buffer on the
+//  CPU, redrawing only tiles that changed, for headless use and for
+//  benchmarking on machines without a GPU (see Benchmarks/).
+//
+//  Plain C. Not thread-safe: callers serialize access (one render queue).
+//
+
+#ifndef RTSPGridCompositor_h
+#define RTSPGridCompositor_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RTSP_GRID_COMPOSITOR_MAX_TILES 64
+#define RTSP_GRID_COMPOSITOR_FIRST_GLYPH 32    // ' '
+#define RTSP_GRID_COMPOSITOR_GLYPH_COUNT 95    // ' ' through '~'
+
+/// One glyph in the atlas. Glyph quads map atlas pixels 1:1 to target
+/// pixels, so the atlas is rendered at the target's backing scale.
+typedef struct {
+    uint16_t x, y, width, height;      // Bitmap rectangle in the atlas
+    int16_t bearingX;                  // Pen position to the bitmap's left edge
+    int16_t bearingY;                  // Baseline to the bitmap's top edge (up is positive)
+    uint16_t advance;
+} RTSPGridCompositorGlyph;
+
+/// 8-bit coverage atlas for printable ASCII. The compositor copies the
+/// metrics; the coverage bitmap is only read by the software backend and
+/// must outlive the compositor.
+typedef struct {
+    const uint8_t *coverage;
+    uint32_t width;
+    uint32_t height;
+    size_t bytesPerRow;
+    uint16_t lineHeight;
+    uint16_t ascent;
+    RTSPGridCompositorGlyph glyphs[RTSP_GRID_COMPOSITOR_GLYPH_COUNT];
+} RTSPGridCompositorAtlas;
+
+typedef enum {
+    RTSPGridCompositorQuadVideo = 0,   // Tile frame, sampled from the tile's image
+    RTSPGridCompositorQuadSolid,       // Flat color
+    RTSPGridCompositorQuadDisc,        // Antialiased disc inscribed in the quad
+    RTSPGridCompositorQuadGlyph        // Atlas coverage times color
+} RTSPGridCompositorQuadKind;
+
+/// 40 bytes, no padding: usable as-is as per-instance vertex data
+typedef struct {
+    float x0, y0, x1, y1;              // Target pixels, origin top-left
+    float u0, v0, u1, v1;              // Normalized source coordinates (image or atlas)
+    uint32_t color;                    // 0xAARRGGBB, straight alpha (unused for video)
+    uint16_t tile;
+    uint16_t kind;                     // RTSPGridCompositorQuadKind
+} RTSPGridCompositorQuad;
+
+/// Overlay and frame state of one tile
+typedef struct {
+    uint32_t frameWidth;               // Size of the tile's frames; 0 = no frame (tile stays black)
+    uint32_t frameHeight;
+    uint32_t statusColor;              // 0xAARRGGBB; alpha 0 hides the status dot
+    bool focused;
+    bool showLabel;
+    bool showTimestamp;
+    bool showDiagnostics;
+    const char *label;                 // Copied; NULL or "" = none
+    const char *diagnostics;           // Copied; NULL or "" = none
+} RTSPGridCompositorTile;
+
+typedef struct {
+    uint32_t width;                    // Target size in pixels
+    uint32_t height;
+    uint32_t rows;
+    uint32_t columns;
+    float spacing;                     // Gap between and around tiles, in points
+    float scale;                       // Pixels per point (backing scale factor)
+    uint32_t focusColor;               // Focus ring, 0xAARRGGBB
+    const RTSPGridCompositorAtlas *atlas;
+} RTSPGridCompositorConfig;
+
+/// BGRA8 or NV12 (full range, BT.709) image for the software backend
+typedef enum {
+    RTSPGridCompositorPixelFormatNone = 0,
+    RTSPGridCompositorPixelFormatBGRA8,
+    RTSPGridCompositorPixelFormatNV12
+} RTSPGridCompositorPixelFormat;
+
+typedef struct {
+    RTSPGridCompositorPixelFormat format;
+    uint32_t width;
+    uint32_t height;
+    const uint8_t *planes[2];          // BGRA: pixels. NV12: luma, interleaved CbCr.
+    size_t bytesPerRow[2];
+} RTSPGridCompositorImage;
+
+typedef struct {
+    uint64_t builds;                   // Quad lists produced
+    uint64_t overlayRebuilds;          // Of which regenerated the overlay batch
+    uint64_t tilesRasterized;          // Software backend: tiles redrawn
+    uint32_t videoQuads;               // Last build
+    uint32_t overlayQuads;
+    uint32_t glyphQuads;
+} RTSPGridCompositorStatistics;
+
+typedef struct RTSPGridCompositor *RTSPGridCompositorRef;
+
+/// Defaults: 2 pt spacing, scale 1, system-blue focus ring, no atlas
+void RTSPGridCompositorConfigInit(RTSPGridCompositorConfig *config, uint32_t width, uint32_t height,
+                                  uint32_t rows, uint32_t columns);
+
+/// Returns NULL on invalid configuration (no tiles, more than the maximum,
+/// zero size) or allocation failure. Without an atlas no text is drawn.
+RTSPGridCompositorRef RTSPGridCompositorCreate(const RTSPGridCompositorConfig *config);
+
+void RTSPGridCompositorRelease(RTSPGridCompositorRef compositor);
+
+/// Change size, grid, spacing, scale or atlas. Tile state is kept for the
+/// tiles that still exist. Everything is redrawn.
+bool RTSPGridCompositorReconfigure(RTSPGridCompositorRef compositor, const RTSPGridCompositorConfig *config);
+
+uint32_t RTSPGridCompositorTileCount(RTSPGridCompositorRef compositor);
+
+/// Tile rectangle in target pixels, origin top-left: x, y, width, height
+bool RTSPGridCompositorTileRect(RTSPGridCompositorRef compositor, uint32_t tile, float rect[4]);
+
+/// Update a tile's overlay state. Returns true if anything visible changed.
+bool RTSPGridCompositorSetTile(RTSPGridCompositorRef compositor, uint32_t tile, const RTSPGridCompositorTile *state);
+
+/// Text shown in every tile with showTimestamp set (copied)
+void RTSPGridCompositorSetTimestamp(RTSPGridCompositorRef compositor, const char *timestamp);
+
+/// A new frame arrived for a tile
+void RTSPGridCompositorMarkFrame(RTSPGridCompositorRef compositor, uint32_t tile);
+
+/// Whether anything changed since the last build
+bool RTSPGridCompositorNeedsDisplay(RTSPGridCompositorRef compositor);
+
+/**
+ * Produce the quad list: video quads first (one per tile with a frame, in
+ * tile order), then the overlay batch. Valid until the next call that
+ * changes the compositor.
+ */
+const RTSPGridCompositorQuad *RTSPGridCompositorBuild(RTSPGridCompositorRef compositor,
+                                                      uint32_t *videoQuads, uint32_t *overlayQuads);
+
+/**
+ * Software backend. Rasterizes the last build into a BGRA8 target of the
+ * configured size whose previous contents are the last software render;
+ * only tiles marked or changed since then are redrawn. `images` has one
+ * entry per tile. Returns the number of tiles redrawn.
+ */
+uint32_t RTSPGridCompositorRenderSoftware(RTSPGridCompositorRef compositor, const RTSPGridCompositorImage *images,
+                                          uint8_t *target, size_t bytesPerRow);
+
+RTSPGridCompositorStatistics RTSPGridCompositorGetStatistics(RTSPGridCompositorRef compositor);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RTSPGridCompositor_h */
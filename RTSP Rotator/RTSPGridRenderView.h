@@ -0,0 +1,54 @@
+//
+//  RTSPGridRenderView.h
+//  RTSP Rotator
+//
+//  One render surface for the whole multi-view grid. Every tile's video and
+//  its overlays (label, timestamp, diagnostics, status dot, focus ring) are
+//  drawn by RTSPGridCompositor into a single CAMetalLayer in one pass: one
+//  quad per tile sampling the decoder's NV12 buffer, then all overlays as
+//  one instanced batch against a glyph atlas. Frames come from each tile's
+//  RTSPFrameBus, and the view redraws when a frame arrives rather than on a
+//  timer. Without a Metal device the compositor's software backend draws
+//  into the layer instead.
+//
+
+#import <AppKit/AppKit.h>
+#import <AVFoundation/AVFoundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+@interface RTSPGridRenderView : NSView
+
+/// Tile layout; must match the cell frames laid out by the grid
+- (void)setRows:(NSUInteger)rows columns:(NSUInteger)columns spacing:(CGFloat)spacing;
+
+/// Draw frames of this player in a tile (nil detaches). Frames are taken
+/// from the player's RTSPFrameBus at up to 30 fps.
+- (void)setPlayer:(nullable AVPlayer *)player forTile:(NSUInteger)tile;
+
+/// Camera name shown in the tile's bottom-left bar
+- (void)setLabel:(nullable NSString *)label forTile:(NSUInteger)tile;
+
+/// Stream diagnostics shown top-right when diagnostics are on
+- (void)setDiagnostics:(nullable NSString *)diagnostics forTile:(NSUInteger)tile;
+
+/// Status dot color (nil hides the dot)
+- (void)setStatusColor:(nullable NSColor *)color forTile:(NSUInteger)tile;
+
+- (void)setFocused:(BOOL)focused forTile:(NSUInteger)tile;
+
+- (void)setShowLabel:(BOOL)showLabel
+       showTimestamp:(BOOL)showTimestamp
+     showDiagnostics:(BOOL)showDiagnostics
+             forTile:(NSUInteger)tile;
+
+/// Drop all tiles' players and overlay state
+- (void)removeAllTiles;
+
+/// Statistics: tiles, frames, draws, overlayRebuilds, videoQuads,
+/// overlayQuads, glyphQuads, metal (1 when drawing with Metal)
+- (NSDictionary<NSString *, NSNumber *> *)statistics;
+
+@end
+
+NS_ASSUME_NONNULL_END
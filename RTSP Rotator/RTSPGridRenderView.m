@@ -0,0 +1,807 @@
+//
+//  RTSPGridRenderView.m
+//  RTSP Rotator
+//
+
+#import "RTSPGridRenderView.h"
+#import "RTSPGridCompositor.h"
+#import "RTSPFrameBus.h"
+#import <QuartzCore/QuartzCore.h>
+#import <Metal/Metal.h>
+#import <CoreText/CoreText.h>
+#import <CoreVideo/CoreVideo.h>
+
+static const double kRTSPGridRenderViewFrameRate = 30.0;          // Per-tile frame delivery from the bus
+static const CFTimeInterval kRTSPGridRenderViewMinDrawInterval = 1.0 / 60.0;
+static const CGFloat kRTSPGridRenderViewFontSize = 11.0;
+static const NSUInteger kRTSPGridRenderViewBuffersInFlight = 3;
+
+// Quads are RTSPGridCompositorQuad, read directly as per-instance data
+static NSString * const kRTSPGridRenderViewShaderSource = @
+    "#include <metal_stdlib>\n"
+    "using namespace metal;\n"
+    "struct GridQuad { packed_float4 rect; packed_float4 uv; uint color; ushort tile; ushort kind; };\n"
+    "struct GridVertexOut {\n"
+    "    float4 position [[position]];\n"
+    "    float2 uv;\n"
+    "    float2 local;\n"
+    "    float4 color;\n"
+    "    uint kind [[flat]];\n"
+    "};\n"
+    "vertex GridVertexOut gridVertex(uint vid [[vertex_id]], uint iid [[instance_id]],\n"
+    "                                const device GridQuad *quads [[buffer(0)]],\n"
+    "                                constant float2 &viewport [[buffer(1)]]) {\n"
+    "    GridQuad q = quads[iid];\n"
+    "    float2 corner = float2(vid & 1, vid >> 1);\n"
+    "    float2 p = mix(float2(q.rect.x, q.rect.y), float2(q.rect.z, q.rect.w), corner);\n"
+    "    GridVertexOut out;\n"
+    "    out.position = float4(p.x / viewport.x * 2.0 - 1.0, 1.0 - p.y / viewport.y * 2.0, 0.0, 1.0);\n"
+    "    out.uv = mix(float2(q.uv.x, q.uv.y), float2(q.uv.z, q.uv.w), corner);\n"
+    "    out.local = corner * 2.0 - 1.0;\n"
+    "    out.color = float4((q.color >> 16) & 0xFF, (q.color >> 8) & 0xFF, q.color & 0xFF, q.color >> 24) / 255.0;\n"
+    "    out.kind = q.kind;\n"
+    "    return out;\n"
+    "}\n"
+    "fragment float4 gridVideoFragment(GridVertexOut in [[stage_in]],\n"
+    "                                  texture2d<float> luma [[texture(0)]],\n"
+    "                                  texture2d<float> chroma [[texture(1)]]) {\n"
+    "    constexpr sampler s(filter::linear, address::clamp_to_edge);\n"
+    "    float y = luma.sample(s, in.uv).r;\n"
+    "    float2 c = chroma.sample(s, in.uv).rg - 0.5;\n"
+    "    return float4(y + 1.5748 * c.y, y - 0.1873 * c.x - 0.4681 * c.y, y + 1.8556 * c.x, 1.0);\n"
+    "}\n"
+    "fragment float4 gridOverlayFragment(GridVertexOut in [[stage_in]],\n"
+    "                                    texture2d<float> atlas [[texture(0)]]) {\n"
+    "    constexpr sampler s(filter::nearest, address::clamp_to_edge);\n"
+    "    float a = in.color.a;\n"
+    "    if (in.kind == 2) {\n"
+    "        float d = length(in.local);\n"
+    "        a *= 1.0 - smoothstep(1.0 - fwidth(d), 1.0, d);\n"
+    "    } else if (in.kind == 3) {\n"
+    "        a *= atlas.sample(s, in.uv).r;\n"
+    "    }\n"
+    "    return float4(in.color.rgb * a, a);\n"
+    "}\n";
+
+#pragma mark - Tile
+
+/// Render-queue state of one tile
+@interface RTSPGridRenderTile : NSObject
+@property (nonatomic, assign) NSUInteger generation;
+@property (nonatomic, strong, nullable) RTSPDecodedFrame *frame;
+@property (nonatomic, copy, nullable) NSString *label;
+@property (nonatomic, copy, nullable) NSString *diagnostics;
+@property (nonatomic, assign) uint32_t statusColor;
+@property (nonatomic, assign) BOOL focused;
+@property (nonatomic, assign) BOOL showLabel;
+@property (nonatomic, assign) BOOL showTimestamp;
+@property (nonatomic, assign) BOOL showDiagnostics;
+@end
+
+@implementation RTSPGridRenderTile
+@end
+
+/// Main-thread record of a tile's frame bus subscription
+@interface RTSPGridRenderSubscription : NSObject
+@property (nonatomic, strong) RTSPFrameBus *bus;
+@property (nonatomic, strong) id<NSObject> token;
+@end
+
+@implementation RTSPGridRenderSubscription
+@end
+
+#pragma mark - Glyph Atlas
+
+/// Rasterize printable ASCII in the system font at the backing scale
+static NSData *RTSPGridRenderViewCreateAtlas(CGFloat scale, RTSPGridCompositorAtlas *atlas) {
+    CTFontRef font = CTFontCreateUIFontForLanguage(kCTFontUIFontSystem, kRTSPGridRenderViewFontSize * scale, NULL);
+    if (!font) {
+        return nil;
+    }
+    UniChar characters[RTSP_GRID_COMPOSITOR_GLYPH_COUNT];
+    CGGlyph glyphs[RTSP_GRID_COMPOSITOR_GLYPH_COUNT];
+    CGRect bounds[RTSP_GRID_COMPOSITOR_GLYPH_COUNT];
+    CGSize advances[RTSP_GRID_COMPOSITOR_GLYPH_COUNT];
+    for (NSUInteger i = 0; i < RTSP_GRID_COMPOSITOR_GLYPH_COUNT; i++) {
+        characters[i] = (UniChar)(RTSP_GRID_COMPOSITOR_FIRST_GLYPH + i);
+    }
+    CTFontGetGlyphsForCharacters(font, characters, glyphs, RTSP_GRID_COMPOSITOR_GLYPH_COUNT);
+    CTFontGetBoundingRectsForGlyphs(font, kCTFontOrientationDefault, glyphs, bounds, RTSP_GRID_COMPOSITOR_GLYPH_COUNT);
+    CTFontGetAdvancesForGlyphs(font, kCTFontOrientationDefault, glyphs, advances, RTSP_GRID_COMPOSITOR_GLYPH_COUNT);
+
+    // Shelf-pack the glyph bitmaps, one pixel of padding around each
+    memset(atlas, 0, sizeof(*atlas));
+    uint32_t width = (uint32_t)(256 * ceil(scale));
+    uint32_t x = 1, y = 1, rowHeight = 0;
+    for (NSUInteger i = 0; i < RTSP_GRID_COMPOSITOR_GLYPH_COUNT; i++) {
+        RTSPGridCompositorGlyph *glyph = &atlas->glyphs[i];
+        glyph->advance = (uint16_t)lround(advances[i].width);
+        if (CGRectIsEmpty(bounds[i])) {
+            continue;
+        }
+        int32_t left = (int32_t)floor(CGRectGetMinX(bounds[i])) - 1;
+        int32_t right = (int32_t)ceil(CGRectGetMaxX(bounds[i])) + 1;
+        int32_t bottom = (int32_t)floor(CGRectGetMinY(bounds[i])) - 1;
+        int32_t top = (int32_t)ceil(CGRectGetMaxY(bounds[i])) + 1;
+        uint32_t glyphWidth = (uint32_t)(right - left), glyphHeight = (uint32_t)(top - bottom);
+        if (x + glyphWidth + 1 > width) {
+            x = 1;
+            y += rowHeight + 1;
+            rowHeight = 0;
+        }
+        glyph->x = (uint16_t)x;
+        glyph->y = (uint16_t)y;
+        glyph->width = (uint16_t)glyphWidth;
+        glyph->height = (uint16_t)glyphHeight;
+        glyph->bearingX = (int16_t)left;
+        glyph->bearingY = (int16_t)top;
+        x += glyphWidth + 1;
+        rowHeight = MAX(rowHeight, glyphHeight);
+    }
+    uint32_t height = y + rowHeight + 1;
+
+    NSMutableData *coverage = [NSMutableData dataWithLength:(NSUInteger)width * height];
+    CGColorSpaceRef gray = CGColorSpaceCreateDeviceGray();
+    CGContextRef context = CGBitmapContextCreate(coverage.mutableBytes, width, height, 8, width, gray, kCGImageAlphaNone);
+    CGColorSpaceRelease(gray);
+    if (!context) {
+        CFRelease(font);
+        return nil;
+    }
+    CGContextSetGrayFillColor(context, 1.0, 1.0);
+    CGContextSetShouldSmoothFonts(context, false);
+    for (NSUInteger i = 0; i < RTSP_GRID_COMPOSITOR_GLYPH_COUNT; i++) {
+        const RTSPGridCompositorGlyph *glyph = &atlas->glyphs[i];
+        if (glyph->width == 0) {
+            continue;
+        }
+        // Bitmap rows run top-down; Core Graphics y runs bottom-up
+        CGPoint position = CGPointMake(glyph->x - glyph->bearingX, (CGFloat)height - glyph->y - glyph->bearingY);
+        CTFontDrawGlyphs(font, &glyphs[i], &position, 1, context);
+    }
+    CGContextRelease(context);
+
+    atlas->coverage = coverage.bytes;
+    atlas->width = width;
+    atlas->height = height;
+    atlas->bytesPerRow = width;
+    atlas->ascent = (uint16_t)ceil(CTFontGetAscent(font));
+    atlas->lineHeight = (uint16_t)ceil(CTFontGetAscent(font) + CTFontGetDescent(font));
+    CFRelease(font);
+    return coverage;
+}
+
+static uint32_t RTSPGridRenderViewPackColor(NSColor *color) {
+    NSColor *rgb = [color colorUsingColorSpace:[NSColorSpace sRGBColorSpace]];
+    if (!rgb) {
+        return 0;
+    }
+    uint32_t a = (uint32_t)lround(rgb.alphaComponent * 255.0);
+    uint32_t r = (uint32_t)lround(rgb.redComponent * 255.0);
+    uint32_t g = (uint32_t)lround(rgb.greenComponent * 255.0);
+    uint32_t b = (uint32_t)lround(rgb.blueComponent * 255.0);
+    return a << 24 | r << 16 | g << 8 | b;
+}
+
+#pragma mark - RTSPGridRenderView
+
+@implementation RTSPGridRenderView {
+    // Main thread
+    NSUInteger _rows;
+    NSUInteger _columns;
+    CGFloat _spacing;
+    NSUInteger _nextGeneration;
+    NSMutableDictionary<NSNumber *, RTSPGridRenderSubscription *> *_subscriptions;
+
+    // Render queue
+    dispatch_queue_t _renderQueue;
+    dispatch_source_t _clockTimer;
+    NSDateFormatter *_timestampFormatter;
+    RTSPGridCompositorRef _compositor;
+    RTSPGridCompositorConfig _config;
+    RTSPGridCompositorAtlas _atlas;
+    NSData *_atlasCoverage;
+    CGFloat _atlasScale;
+    NSMutableArray<RTSPGridRenderTile *> *_tiles;
+    BOOL _drawScheduled;
+    CFTimeInterval _lastDrawTime;
+    uint64_t _frames;
+    uint64_t _draws;
+    uint32_t _targetWidth;
+    uint32_t _targetHeight;
+    NSMutableData *_softwareTarget;
+
+    // Metal (created once, used on the render queue)
+    id<MTLDevice> _device;
+    id<MTLCommandQueue> _commandQueue;
+    id<MTLRenderPipelineState> _videoPipeline;
+    id<MTLRenderPipelineState> _overlayPipeline;
+    id<MTLTexture> _atlasTexture;
+    CVMetalTextureCacheRef _textureCache;
+    id<MTLBuffer> _quadBuffers[kRTSPGridRenderViewBuffersInFlight];
+    NSUInteger _quadBufferIndex;
+    dispatch_semaphore_t _inFlight;
+    CAMetalLayer *_metalLayer;
+}
+
+- (instancetype)initWithFrame:(NSRect)frameRect {
+    self = [super initWithFrame:frameRect];
+    if (self) {
+        _rows = 1;
+        _columns = 1;
+        _spacing = 2.0;
+        _subscriptions = [NSMutableDictionary dictionary];
+        _renderQueue = dispatch_queue_create("com.rtsp.gridrender", DISPATCH_QUEUE_SERIAL);
+        _tiles = [NSMutableArray array];
+        _timestampFormatter = [[NSDateFormatter alloc] init];
+        _timestampFormatter.dateFormat = @"HH:mm:ss";
+        _inFlight = dispatch_semaphore_create(kRTSPGridRenderViewBuffersInFlight);
+
+        [self setupMetal];
+        self.wantsLayer = YES;
+        self.layerContentsRedrawPolicy = NSViewLayerContentsRedrawNever;
+        [self startClock];
+    }
+    return self;
+}
+
+- (void)setupMetal {
+    id<MTLDevice> device = MTLCreateSystemDefaultDevice();
+    if (!device) {
+        NSLog(@"[GridRender] No Metal device, using the software backend");
+        return;
+    }
+    NSError *error = nil;
+    id<MTLLibrary> library = [device newLibraryWithSource:kRTSPGridRenderViewShaderSource options:nil error:&error];
+    if (!library) {
+        NSLog(@"[GridRender] Shader compilation failed, using the software backend: %@", error);
+        return;
+    }
+
+    MTLRenderPipelineDescriptor *descriptor = [[MTLRenderPipelineDescriptor alloc] init];
+    descriptor.vertexFunction = [library newFunctionWithName:@"gridVertex"];
+    descriptor.fragmentFunction = [library newFunctionWithName:@"gridVideoFragment"];
+    descriptor.colorAttachments[0].pixelFormat = MTLPixelFormatBGRA8Unorm;
+    id<MTLRenderPipelineState> videoPipeline = [device newRenderPipelineStateWithDescriptor:descriptor error:&error];
+
+    // Overlays blend premultiplied over the video
+    descriptor.fragmentFunction = [library newFunctionWithName:@"gridOverlayFragment"];
+    descriptor.colorAttachments[0].blendingEnabled = YES;
+    descriptor.colorAttachments[0].sourceRGBBlendFactor = MTLBlendFactorOne;
+    descriptor.colorAttachments[0].sourceAlphaBlendFactor = MTLBlendFactorOne;
+    descriptor.colorAttachments[0].destinationRGBBlendFactor = MTLBlendFactorOneMinusSourceAlpha;
+    descriptor.colorAttachments[0].destinationAlphaBlendFactor = MTLBlendFactorOneMinusSourceAlpha;
+    id<MTLRenderPipelineState> overlayPipeline = [device newRenderPipelineStateWithDescriptor:descriptor error:&error];
+
+    CVMetalTextureCacheRef textureCache = NULL;
+    if (!videoPipeline || !overlayPipeline ||
+        CVMetalTextureCacheCreate(kCFAllocatorDefault, NULL, device, NULL, &textureCache) != kCVReturnSuccess) {
+        NSLog(@"[GridRender] Metal setup failed, using the software backend: %@", error);
+        return;
+    }
+    _device = device;
+    _commandQueue = [device newCommandQueue];
+    _videoPipeline = videoPipeline;
+    _overlayPipeline = overlayPipeline;
+    _textureCache = textureCache;
+}
+
+- (CALayer *)makeBackingLayer {
+    if (!_device) {
+        CALayer *layer = [CALayer layer];
+        layer.backgroundColor = [[NSColor blackColor] CGColor];
+        return layer;
+    }
+    _metalLayer = [CAMetalLayer layer];
+    _metalLayer.device = _device;
+    _metalLayer.pixelFormat = MTLPixelFormatBGRA8Unorm;
+    _metalLayer.framebufferOnly = YES;
+    _metalLayer.opaque = YES;
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateWithName(kCGColorSpaceSRGB);
+    _metalLayer.colorspace = colorSpace;
+    CGColorSpaceRelease(colorSpace);
+    return _metalLayer;
+}
+
+- (BOOL)isOpaque {
+    return YES;
+}
+
+- (NSView *)hitTest:(NSPoint)point {
+    // Clicks belong to the cells and the grid above
+    return nil;
+}
+
+#pragma mark - Layout
+
+- (void)setRows:(NSUInteger)rows columns:(NSUInteger)columns spacing:(CGFloat)spacing {
+    if (rows == _rows && columns == _columns && spacing == _spacing) {
+        return;
+    }
+    _rows = MAX(rows, 1);
+    _columns = MAX(columns, 1);
+    _spacing = spacing;
+    [self updateConfiguration];
+}
+
+- (void)layout {
+    [super layout];
+    [self updateConfiguration];
+}
+
+- (void)setFrameSize:(NSSize)newSize {
+    [super setFrameSize:newSize];
+    [self updateConfiguration];
+}
+
+- (void)viewDidChangeBackingProperties {
+    [super viewDidChangeBackingProperties];
+    [self updateConfiguration];
+}
+
+- (void)updateConfiguration {
+    if (!_renderQueue) {
+        return; // NSView's initializer sizes the view before ours runs
+    }
+    CGFloat scale = self.window.backingScaleFactor > 0 ? self.window.backingScaleFactor : 1.0;
+    CGSize size = [self convertSizeToBacking:self.bounds.size];
+    self.layer.contentsScale = scale;
+
+    uint32_t width = (uint32_t)lround(size.width), height = (uint32_t)lround(size.height);
+    uint32_t rows = (uint32_t)_rows, columns = (uint32_t)_columns;
+    float spacing = (float)_spacing;
+    __weak typeof(self) weakSelf = self;
+    dispatch_async(_renderQueue, ^{
+        [weakSelf reconfigureWithWidth:width height:height rows:rows columns:columns spacing:spacing scale:scale];
+    });
+}
+
+- (void)reconfigureWithWidth:(uint32_t)width height:(uint32_t)height rows:(uint32_t)rows columns:(uint32_t)columns
+                     spacing:(float)spacing scale:(CGFloat)scale {
+    if (scale != _atlasScale) {
+        RTSPGridCompositorAtlas atlas;
+        NSData *coverage = RTSPGridRenderViewCreateAtlas(scale, &atlas);
+        if (coverage) {
+            _atlas = atlas;
+            _atlasCoverage = coverage;
+            _atlasScale = scale;
+            [self uploadAtlas];
+        }
+    }
+
+    RTSPGridCompositorConfig config;
+    RTSPGridCompositorConfigInit(&config, width, height, rows, columns);
+    config.spacing = spacing;
+    config.scale = (float)scale;
+    config.focusColor = RTSPGridRenderViewPackColor([NSColor controlAccentColor]);
+    config.atlas = _atlasCoverage ? &_atlas : NULL;
+
+    if (width == 0 || height == 0 || rows * columns > RTSP_GRID_COMPOSITOR_MAX_TILES) {
+        return;
+    }
+    if (_compositor && memcmp(&config, &_config, sizeof(config)) == 0) {
+        return; // Layout pass without a change; keep the damage tracking
+    }
+    if (!_compositor) {
+        _compositor = RTSPGridCompositorCreate(&config);
+    } else if (!RTSPGridCompositorReconfigure(_compositor, &config)) {
+        return;
+    }
+    if (!_compositor) {
+        return;
+    }
+    _config = config;
+    _targetWidth = width;
+    _targetHeight = height;
+    _metalLayer.drawableSize = CGSizeMake(width, height);
+    _softwareTarget = nil;
+    for (NSUInteger i = 0; i < _tiles.count; i++) {
+        [self applyTile:i];
+    }
+    [self setNeedsDraw];
+}
+
+- (void)uploadAtlas {
+    if (!_device) {
+        return;
+    }
+    MTLTextureDescriptor *descriptor = [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:MTLPixelFormatR8Unorm
+                                                                                           width:_atlas.width
+                                                                                          height:_atlas.height
+                                                                                       mipmapped:NO];
+    descriptor.usage = MTLTextureUsageShaderRead;
+    id<MTLTexture> texture = [_device newTextureWithDescriptor:descriptor];
+    [texture replaceRegion:MTLRegionMake2D(0, 0, _atlas.width, _atlas.height)
+               mipmapLevel:0
+                 withBytes:_atlas.coverage
+               bytesPerRow:_atlas.bytesPerRow];
+    _atlasTexture = texture;
+}
+
+#pragma mark - Tiles
+
+- (void)setPlayer:(AVPlayer *)player forTile:(NSUInteger)tile {
+    NSNumber *key = @(tile);
+    RTSPGridRenderSubscription *subscription = _subscriptions[key];
+    if (subscription) {
+        if (player && subscription.bus.player == player) {
+            return;
+        }
+        [subscription.bus removeSubscriber:subscription.token];
+        [_subscriptions removeObjectForKey:key];
+    }
+
+    NSUInteger generation = ++_nextGeneration;
+    __weak typeof(self) weakSelf = self;
+    dispatch_async(_renderQueue, ^{
+        [weakSelf updateTile:tile changes:^(RTSPGridRenderTile *state) {
+            state.generation = generation;
+            state.frame = nil;
+        }];
+    });
+    if (!player) {
+        return;
+    }
+
+    // Delivered on the render queue, after the generation above is set
+    RTSPFrameBus *bus = [RTSPFrameBus busForPlayer:player];
+    subscription = [[RTSPGridRenderSubscription alloc] init];
+    subscription.bus = bus;
+    subscription.token = [bus addSubscriberWithRate:kRTSPGridRenderViewFrameRate queue:_renderQueue handler:^(RTSPDecodedFrame *frame) {
+        [weakSelf receiveFrame:frame forTile:tile generation:generation];
+    }];
+    _subscriptions[key] = subscription;
+}
+
+- (void)setLabel:(NSString *)label forTile:(NSUInteger)tile {
+    NSString *copy = [label copy];
+    [self changeTile:tile changes:^(RTSPGridRenderTile *state) {
+        state.label = copy;
+    }];
+}
+
+- (void)setDiagnostics:(NSString *)diagnostics forTile:(NSUInteger)tile {
+    NSString *copy = [diagnostics copy];
+    [self changeTile:tile changes:^(RTSPGridRenderTile *state) {
+        state.diagnostics = copy;
+    }];
+}
+
+- (void)setStatusColor:(NSColor *)color forTile:(NSUInteger)tile {
+    uint32_t packed = color ? RTSPGridRenderViewPackColor(color) : 0;
+    [self changeTile:tile changes:^(RTSPGridRenderTile *state) {
+        state.statusColor = packed;
+    }];
+}
+
+- (void)setFocused:(BOOL)focused forTile:(NSUInteger)tile {
+    [self changeTile:tile changes:^(RTSPGridRenderTile *state) {
+        state.focused = focused;
+    }];
+}
+
+- (void)setShowLabel:(BOOL)showLabel showTimestamp:(BOOL)showTimestamp showDiagnostics:(BOOL)showDiagnostics forTile:(NSUInteger)tile {
+    [self changeTile:tile changes:^(RTSPGridRenderTile *state) {
+        state.showLabel = showLabel;
+        state.showTimestamp = showTimestamp;
+        state.showDiagnostics = showDiagnostics;
+    }];
+}
+
+- (void)removeAllTiles {
+    for (RTSPGridRenderSubscription *subscription in _subscriptions.allValues) {
+        [subscription.bus removeSubscriber:subscription.token];
+    }
+    [_subscriptions removeAllObjects];
+    _nextGeneration++;
+
+    __weak typeof(self) weakSelf = self;
+    dispatch_async(_renderQueue, ^{
+        [weakSelf clearTiles];
+    });
+}
+
+- (void)changeTile:(NSUInteger)tile changes:(void (^)(RTSPGridRenderTile *state))changes {
+    __weak typeof(self) weakSelf = self;
+    dispatch_async(_renderQueue, ^{
+        [weakSelf updateTile:tile changes:changes];
+    });
+}
+
+#pragma mark - Render Queue
+
+- (void)updateTile:(NSUInteger)tile changes:(void (^)(RTSPGridRenderTile *state))changes {
+    if (tile >= RTSP_GRID_COMPOSITOR_MAX_TILES) {
+        return;
+    }
+    while (_tiles.count <= tile) {
+        [_tiles addObject:[[RTSPGridRenderTile alloc] init]];
+    }
+    changes(_tiles[tile]);
+    [self applyTile:tile];
+}
+
+- (void)clearTiles {
+    NSUInteger count = _tiles.count;
+    [_tiles removeAllObjects];
+    for (NSUInteger i = 0; i < count; i++) {
+        [_tiles addObject:[[RTSPGridRenderTile alloc] init]];
+        [self applyTile:i];
+    }
+}
+
+/// Push a tile's state into the compositor and draw if anything changed
+- (void)applyTile:(NSUInteger)tile {
+    if (!_compositor || tile >= RTSPGridCompositorTileCount(_compositor)) {
+        return;
+    }
+    RTSPGridRenderTile *state = _tiles[tile];
+    RTSPGridCompositorTile compositorTile = {
+        .frameWidth = (uint32_t)state.frame.width,
+        .frameHeight = (uint32_t)state.frame.height,
+        .statusColor = state.statusColor,
+        .focused = state.focused,
+        .showLabel = state.showLabel,
+        .showTimestamp = state.showTimestamp,
+        .showDiagnostics = state.showDiagnostics,
+        .label = state.label.UTF8String,
+        .diagnostics = state.diagnostics.UTF8String
+    };
+    if (RTSPGridCompositorSetTile(_compositor, (uint32_t)tile, &compositorTile)) {
+        [self setNeedsDraw];
+    }
+}
+
+- (void)receiveFrame:(RTSPDecodedFrame *)frame forTile:(NSUInteger)tile generation:(NSUInteger)generation {
+    if (tile >= _tiles.count || _tiles[tile].generation != generation) {
+        return;
+    }
+    RTSPGridRenderTile *state = _tiles[tile];
+    BOOL resized = state.frame.width != frame.width || state.frame.height != frame.height;
+    state.frame = frame;
+    _frames++;
+    if (resized) {
+        [self applyTile:tile];
+    }
+    if (_compositor && tile < RTSPGridCompositorTileCount(_compositor)) {
+        RTSPGridCompositorMarkFrame(_compositor, (uint32_t)tile);
+        [self setNeedsDraw];
+    }
+}
+
+- (void)startClock {
+    // One clock for every tile's timestamp; it only redraws when the text changes
+    _clockTimer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, _renderQueue);
+    dispatch_source_set_timer(_clockTimer, DISPATCH_TIME_NOW, NSEC_PER_SEC, NSEC_PER_SEC / 10);
+    __weak typeof(self) weakSelf = self;
+    dispatch_source_set_event_handler(_clockTimer, ^{
+        [weakSelf tickClock];
+    });
+    dispatch_resume(_clockTimer);
+}
+
+- (void)tickClock {
+    if (!_compositor) {
+        return;
+    }
+    NSString *timestamp = [_timestampFormatter stringFromDate:[NSDate date]];
+    RTSPGridCompositorSetTimestamp(_compositor, timestamp.UTF8String);
+    if (RTSPGridCompositorNeedsDisplay(_compositor)) {
+        [self setNeedsDraw];
+    }
+}
+
+/// Coalesce frame arrivals into at most one draw per display refresh
+- (void)setNeedsDraw {
+    if (_drawScheduled) {
+        return;
+    }
+    _drawScheduled = YES;
+    CFTimeInterval delay = MAX(0.0, _lastDrawTime + kRTSPGridRenderViewMinDrawInterval - CACurrentMediaTime());
+    __weak typeof(self) weakSelf = self;
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), _renderQueue, ^{
+        [weakSelf drawFrame];
+    });
+}
+
+- (void)drawFrame {
+    _drawScheduled = NO;
+    if (!_compositor || !RTSPGridCompositorNeedsDisplay(_compositor)) {
+        return;
+    }
+    uint32_t videoCount = 0, overlayCount = 0;
+    const RTSPGridCompositorQuad *quads = RTSPGridCompositorBuild(_compositor, &videoCount, &overlayCount);
+    if (!quads) {
+        return;
+    }
+    _lastDrawTime = CACurrentMediaTime();
+    _draws++;
+
+    if (_metalLayer) {
+        [self drawMetalQuads:quads videoCount:videoCount overlayCount:overlayCount];
+    } else {
+        [self drawSoftware];
+    }
+}
+
+#pragma mark - Metal Backend
+
+- (void)drawMetalQuads:(const RTSPGridCompositorQuad *)quads videoCount:(uint32_t)videoCount overlayCount:(uint32_t)overlayCount {
+    id<CAMetalDrawable> drawable = [_metalLayer nextDrawable];
+    if (!drawable) {
+        return;
+    }
+    dispatch_semaphore_wait(_inFlight, DISPATCH_TIME_FOREVER);
+
+    NSUInteger length = MAX((NSUInteger)(videoCount + overlayCount), 1) * sizeof(RTSPGridCompositorQuad);
+    _quadBufferIndex = (_quadBufferIndex + 1) % kRTSPGridRenderViewBuffersInFlight;
+    id<MTLBuffer> buffer = _quadBuffers[_quadBufferIndex];
+    if (buffer.length < length) {
+        buffer = [_device newBufferWithLength:length * 2 options:MTLResourceStorageModeShared];
+        _quadBuffers[_quadBufferIndex] = buffer;
+    }
+    memcpy(buffer.contents, quads, (videoCount + overlayCount) * sizeof(RTSPGridCompositorQuad));
+
+    MTLRenderPassDescriptor *pass = [MTLRenderPassDescriptor renderPassDescriptor];
+    pass.colorAttachments[0].texture = drawable.texture;
+    pass.colorAttachments[0].loadAction = MTLLoadActionClear;
+    pass.colorAttachments[0].storeAction = MTLStoreActionStore;
+    pass.colorAttachments[0].clearColor = MTLClearColorMake(0, 0, 0, 1);
+
+    id<MTLCommandBuffer> commandBuffer = [_commandQueue commandBuffer];
+    id<MTLRenderCommandEncoder> encoder = [commandBuffer renderCommandEncoderWithDescriptor:pass];
+    vector_float2 viewport = {(float)drawable.texture.width, (float)drawable.texture.height};
+    [encoder setVertexBytes:&viewport length:sizeof(viewport) atIndex:1];
+
+    // Video: one quad per tile, sampling the decoder's NV12 planes in place
+    NSMutableArray *textures = [NSMutableArray arrayWithCapacity:videoCount * 2];
+    [encoder setRenderPipelineState:_videoPipeline];
+    [encoder setVertexBuffer:buffer offset:0 atIndex:0];
+    for (uint32_t i = 0; i < videoCount; i++) {
+        RTSPDecodedFrame *frame = quads[i].tile < _tiles.count ? _tiles[quads[i].tile].frame : nil;
+        id<MTLTexture> luma = [self textureForFrame:frame plane:0 retainIn:textures];
+        id<MTLTexture> chroma = [self textureForFrame:frame plane:1 retainIn:textures];
+        if (!luma || !chroma) {
+            continue;
+        }
+        [encoder setVertexBufferOffset:i * sizeof(RTSPGridCompositorQuad) atIndex:0];
+        [encoder setFragmentTexture:luma atIndex:0];
+        [encoder setFragmentTexture:chroma atIndex:1];
+        [encoder drawPrimitives:MTLPrimitiveTypeTriangleStrip vertexStart:0 vertexCount:4];
+    }
+
+    // Overlays: every bar, dot, ring and glyph in one instanced draw
+    if (overlayCount > 0 && _atlasTexture) {
+        [encoder setRenderPipelineState:_overlayPipeline];
+        [encoder setVertexBufferOffset:videoCount * sizeof(RTSPGridCompositorQuad) atIndex:0];
+        [encoder setFragmentTexture:_atlasTexture atIndex:0];
+        [encoder drawPrimitives:MTLPrimitiveTypeTriangleStrip vertexStart:0 vertexCount:4 instanceCount:overlayCount];
+    }
+    [encoder endEncoding];
+
+    dispatch_semaphore_t inFlight = _inFlight;
+    [commandBuffer addCompletedHandler:^(id<MTLCommandBuffer> completed) {
+        // Keeps the pixel buffers' textures alive until the GPU is done
+        (void)textures;
+        dispatch_semaphore_signal(inFlight);
+    }];
+    [commandBuffer presentDrawable:drawable];
+    [commandBuffer commit];
+}
+
+- (nullable id<MTLTexture>)textureForFrame:(RTSPDecodedFrame *)frame plane:(size_t)plane retainIn:(NSMutableArray *)textures {
+    CVPixelBufferRef pixelBuffer = frame.pixelBuffer;
+    if (!pixelBuffer || CVPixelBufferGetPlaneCount(pixelBuffer) < 2) {
+        return nil;
+    }
+    CVMetalTextureRef texture = NULL;
+    CVReturn result = CVMetalTextureCacheCreateTextureFromImage(kCFAllocatorDefault, _textureCache, pixelBuffer, NULL,
+                                                                plane == 0 ? MTLPixelFormatR8Unorm : MTLPixelFormatRG8Unorm,
+                                                                CVPixelBufferGetWidthOfPlane(pixelBuffer, plane),
+                                                                CVPixelBufferGetHeightOfPlane(pixelBuffer, plane),
+                                                                plane, &texture);
+    if (result != kCVReturnSuccess || !texture) {
+        return nil;
+    }
+    [textures addObject:(__bridge_transfer id)texture];
+    return CVMetalTextureGetTexture(texture);
+}
+
+#pragma mark - Software Backend
+
+/// Fallback without a Metal device: the compositor's CPU rasterizer, which
+/// only redraws changed tiles, shown as the layer's contents
+- (void)drawSoftware {
+    uint32_t count = RTSPGridCompositorTileCount(_compositor);
+    size_t bytesPerRow = (size_t)_targetWidth * 4;
+    if (!_softwareTarget) {
+        _softwareTarget = [NSMutableData dataWithLength:bytesPerRow * _targetHeight];
+    }
+
+    RTSPGridCompositorImage images[RTSP_GRID_COMPOSITOR_MAX_TILES];
+    memset(images, 0, sizeof(images));
+    for (uint32_t i = 0; i < count && i < _tiles.count; i++) {
+        CVPixelBufferRef pixelBuffer = _tiles[i].frame.pixelBuffer;
+        if (!pixelBuffer || CVPixelBufferGetPlaneCount(pixelBuffer) < 2 ||
+            CVPixelBufferLockBaseAddress(pixelBuffer, kCVPixelBufferLock_ReadOnly) != kCVReturnSuccess) {
+            continue;
+        }
+        images[i] = (RTSPGridCompositorImage){
+            .format = RTSPGridCompositorPixelFormatNV12,
+            .width = (uint32_t)CVPixelBufferGetWidth(pixelBuffer),
+            .height = (uint32_t)CVPixelBufferGetHeight(pixelBuffer),
+            .planes = {CVPixelBufferGetBaseAddressOfPlane(pixelBuffer, 0), CVPixelBufferGetBaseAddressOfPlane(pixelBuffer, 1)},
+            .bytesPerRow = {CVPixelBufferGetBytesPerRowOfPlane(pixelBuffer, 0), CVPixelBufferGetBytesPerRowOfPlane(pixelBuffer, 1)}
+        };
+    }
+    uint32_t drawn = RTSPGridCompositorRenderSoftware(_compositor, images, _softwareTarget.mutableBytes, bytesPerRow);
+    for (uint32_t i = 0; i < count && i < _tiles.count; i++) {
+        if (images[i].format != RTSPGridCompositorPixelFormatNone) {
+            CVPixelBufferUnlockBaseAddress(_tiles[i].frame.pixelBuffer, kCVPixelBufferLock_ReadOnly);
+        }
+    }
+    if (drawn == 0) {
+        return;
+    }
+
+    NSData *pixels = [_softwareTarget copy];
+    CGDataProviderRef provider = CGDataProviderCreateWithCFData((__bridge CFDataRef)pixels);
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateWithName(kCGColorSpaceSRGB);
+    CGImageRef image = CGImageCreate(_targetWidth, _targetHeight, 8, 32, bytesPerRow, colorSpace,
+                                     kCGBitmapByteOrder32Little | kCGImageAlphaNoneSkipFirst,
+                                     provider, NULL, false, kCGRenderingIntentDefault);
+    CGColorSpaceRelease(colorSpace);
+    CGDataProviderRelease(provider);
+    if (!image) {
+        return;
+    }
+    id contents = (__bridge_transfer id)image;
+    dispatch_async(dispatch_get_main_queue(), ^{
+        self.layer.contents = contents;
+    });
+}
+
+#pragma mark - Statistics
+
+- (NSDictionary<NSString *, NSNumber *> *)statistics {
+    __block NSDictionary *statistics = nil;
+    dispatch_sync(_renderQueue, ^{
+        RTSPGridCompositorStatistics compositor = {0};
+        if (self->_compositor) {
+            compositor = RTSPGridCompositorGetStatistics(self->_compositor);
+        }
+        statistics = @{
+            @"tiles": @(self->_compositor ? RTSPGridCompositorTileCount(self->_compositor) : 0),
+            @"frames": @(self->_frames),
+            @"draws": @(self->_draws),
+            @"overlayRebuilds": @(compositor.overlayRebuilds),
+            @"videoQuads": @(compositor.videoQuads),
+            @"overlayQuads": @(compositor.overlayQuads),
+            @"glyphQuads": @(compositor.glyphQuads),
+            @"metal": @(self->_metalLayer != nil)
+        };
+    });
+    return statistics;
+}
+
+- (void)dealloc {
+    for (RTSPGridRenderSubscription *subscription in _subscriptions.allValues) {
+        [subscription.bus removeSubscriber:subscription.token];
+    }
+    if (_clockTimer) {
+        dispatch_source_cancel(_clockTimer);
+    }
+    // Pending render-queue blocks hold only weak references; release there after them
+    RTSPGridCompositorRef compositor = _compositor;
+    NSData *coverage = _atlasCoverage;
+    CVMetalTextureCacheRef textureCache = _textureCache;
+    dispatch_async(_renderQueue, ^{
+        RTSPGridCompositorRelease(compositor);
+        (void)coverage;
+        if (textureCache) {
+            CFRelease(textureCache);
+        }
+    });
+}
+
+@end
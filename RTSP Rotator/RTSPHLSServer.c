@@ -0,0 +1,768 @@
+//
+//  RTSPHLSServer.c
+//  RTSP Rotator
+//
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE     // pthread_setname_np
+#endif
+
+#include "RTSPHLSServer.h"
+#include "RTSPByteBuffer.h"
+
+#include <arpa/inet.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0  // Apple: SO_NOSIGPIPE is set per socket instead
+#endif
+
+#define RTSP_HLS_MAX_REQUEST 8192
+#define RTSP_HLS_READ_CHUNK 4096
+#define RTSP_HLS_NAME_LENGTH 64
+#define RTSP_HLS_BLOCK_FACTOR 3.0       // Parked requests wait this many target durations (RFC 8216bis)
+
+typedef struct RTSPHLSPublication {
+    char name[RTSP_HLS_NAME_LENGTH];
+    RTSPHLSStoreRef store;
+    struct RTSPHLSPublication *next;
+} RTSPHLSPublication;
+
+typedef struct RTSPHLSConnection {
+    int fd;
+    RTSPByteBuffer input;
+    double lastActivity;
+    bool closeAfterResponse;
+
+    // Response in flight
+    bool responding;
+    RTSPByteBuffer head;
+    size_t headSent;
+    RTSPHLSResource body;
+    size_t bodySent;
+
+    // Parked request
+    bool parked;
+    RTSPHLSStoreRef store;
+    char resource[RTSP_HLS_NAME_LENGTH];
+    int64_t msn;
+    int64_t part;
+    bool headOnly;
+    double deadline;
+
+    struct RTSPHLSConnection *next;
+} RTSPHLSConnection;
+
+struct RTSPHLSServer {
+    RTSPHLSServerConfig config;
+    char bindAddress[INET_ADDRSTRLEN];
+    int listener;
+    uint16_t port;
+    int wakeup[2];
+    pthread_t thread;
+    pthread_mutex_t lock;
+    bool running;
+
+    RTSPHLSPublication *publications;   // Guarded by the lock
+    RTSPHLSServerStatistics statistics; // Guarded by the lock
+
+    // Loop thread only
+    RTSPHLSConnection *connections;
+    uint32_t connectionCount;
+    struct pollfd *pollfds;
+    RTSPHLSConnection **polled;
+    size_t pollCapacity;
+    RTSPHLSServerStatistics local;
+};
+
+static double RTSPHLSNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+void RTSPHLSServerConfigInit(RTSPHLSServerConfig *config) {
+    config->bindAddress = "127.0.0.1";
+    config->port = 0;
+    config->maxConnections = 256;
+    config->idleTimeout = 30.0;
+}
+
+static void RTSPHLSServerWake(void *context) {
+    RTSPHLSServerRef server = context;
+    char byte = 1;
+    ssize_t result = write(server->wakeup[1], &byte, 1);
+    (void)result; // A full pipe already guarantees a wakeup
+}
+
+#pragma mark - Responses
+
+static const char *RTSPHLSReason(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 431: return "Request Header Fields Too Large";
+        case 503: return "Service Unavailable";
+        default: return "Internal Server Error";
+    }
+}
+
+/// Takes ownership of `body` (may be NULL for an empty response)
+static void RTSPHLSRespond(RTSPHLSConnection *c, int status, RTSPHLSResource *body, bool headOnly) {
+    bool playlist = body && body->contentType && strstr(body->contentType, "mpegurl");
+    RTSPByteBufferReset(&c->head);
+    RTSPByteBufferAppendFormat(&c->head,
+                               "HTTP/1.1 %d %s\r\n"
+                               "Content-Type: %s\r\n"
+                               "Content-Length: %zu\r\n"
+                               "Cache-Control: %s\r\n"
+                               "Access-Control-Allow-Origin: *\r\n"
+                               "Connection: %s\r\n\r\n",
+                               status, RTSPHLSReason(status),
+                               body ? body->contentType : "text/plain",
+                               body ? body->length : 0,
+                               (playlist || status != 200) ? "no-cache" : "max-age=60",
+                               c->closeAfterResponse ? "close" : "keep-alive");
+    c->headSent = 0;
+    if (body && !headOnly) {
+        c->body = *body;
+    } else {
+        if (body) {
+            RTSPHLSResourceRelease(body);
+        }
+        memset(&c->body, 0, sizeof(c->body));
+    }
+    c->bodySent = 0;
+    c->responding = true;
+}
+
+static void RTSPHLSUnpark(RTSPHLSConnection *c) {
+    if (c->store) {
+        RTSPHLSStoreRelease(c->store);
+        c->store = NULL;
+    }
+    c->parked = false;
+}
+
+/// Answers the request if it can be answered now. Returns false when the
+/// request has to wait for the store.
+static bool RTSPHLSTryAnswer(RTSPHLSServerRef server, RTSPHLSConnection *c) {
+    bool playlist = strcmp(c->resource, "stream.m3u8") == 0;
+    if (playlist && c->msn >= 0) {
+        bool tooFar = false;
+        if (!RTSPHLSStoreHasMedia(c->store, c->msn, c->part, &tooFar)) {
+            if (tooFar) {
+                RTSPHLSRespond(c, 400, NULL, false);
+                return true;
+            }
+            return false;
+        }
+    }
+
+    RTSPHLSResource resource;
+    switch (RTSPHLSStoreCopyResource(c->store, c->resource, &resource)) {
+        case RTSPHLSLookupFound:
+            server->local.bytesSent += c->headOnly ? 0 : resource.length;
+            RTSPHLSRespond(c, 200, &resource, c->headOnly);
+            return true;
+        case RTSPHLSLookupPending:
+            return false;
+        case RTSPHLSLookupNotFound:
+        default:
+            RTSPHLSRespond(c, 404, NULL, false);
+            return true;
+    }
+}
+
+static void RTSPHLSPark(RTSPHLSServerRef server, RTSPHLSConnection *c, double now) {
+    if (RTSPHLSTryAnswer(server, c)) {
+        RTSPHLSUnpark(c);
+        return;
+    }
+    if (!c->parked) {
+        c->parked = true;
+        c->deadline = now + RTSP_HLS_BLOCK_FACTOR * RTSPHLSStoreTargetDuration(c->store);
+        server->local.blockedRequests++;
+    } else if (now >= c->deadline) {
+        server->local.timedOutRequests++;
+        RTSPHLSUnpark(c);
+        RTSPHLSRespond(c, 503, NULL, false);
+    }
+}
+
+#pragma mark - Requests
+
+static bool RTSPHLSQueryValue(const char *query, const char *key, int64_t *value) {
+    size_t keyLength = strlen(key);
+    for (const char *p = query; p && *p; ) {
+        if (strncmp(p, key, keyLength) == 0 && p[keyLength] == '=') {
+            char *end = NULL;
+            long long parsed = strtoll(p + keyLength + 1, &end, 10);
+            if (end == p + keyLength + 1 || parsed < 0 || (*end != '\0' && *end != '&')) {
+                return false;
+            }
+            *value = parsed;
+            return true;
+        }
+        p = strchr(p, '&');
+        p = p ? p + 1 : NULL;
+    }
+    return false;
+}
+
+/// Copies the value of the first `name` header, without surrounding whitespace
+static bool RTSPHLSHeaderValue(const char *headers, const char *name, char *value, size_t capacity) {
+    size_t nameLength = strlen(name);
+    for (const char *line = headers; *line; ) {
+        const char *end = strstr(line, "\r\n");
+        if (!end) {
+            break;
+        }
+        if ((size_t)(end - line) > nameLength && strncasecmp(line, name, nameLength) == 0 && line[nameLength] == ':') {
+            const char *start = line + nameLength + 1;
+            while (start < end && (*start == ' ' || *start == '\t')) {
+                start++;
+            }
+            size_t length = (size_t)(end - start);
+            while (length > 0 && (start[length - 1] == ' ' || start[length - 1] == '\t')) {
+                length--;
+            }
+            if (length >= capacity) {
+                length = capacity - 1;
+            }
+            memcpy(value, start, length);
+            value[length] = '\0';
+            return true;
+        }
+        line = end + 2;
+    }
+    return false;
+}
+
+static bool RTSPHLSHeaderHasToken(const char *headers, const char *name, const char *token) {
+    char value[256];
+    if (!RTSPHLSHeaderValue(headers, name, value, sizeof(value))) {
+        return false;
+    }
+    size_t tokenLength = strlen(token);
+    for (const char *p = value; *p; p++) {
+        if (strncasecmp(p, token, tokenLength) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static RTSPHLSStoreRef RTSPHLSCopyStore(RTSPHLSServerRef server, const char *name, size_t length) {
+    RTSPHLSStoreRef store = NULL;
+    pthread_mutex_lock(&server->lock);
+    for (RTSPHLSPublication *p = server->publications; p; p = p->next) {
+        if (strlen(p->name) == length && strncmp(p->name, name, length) == 0) {
+            store = RTSPHLSStoreRetain(p->store);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&server->lock);
+    return store;
+}
+
+/// Parses one request head (NUL terminated, ends with CRLFCRLF) and answers or parks it
+static void RTSPHLSHandleRequest(RTSPHLSServerRef server, RTSPHLSConnection *c, char *request, double now) {
+    server->local.requests++;
+
+    char *lineEnd = strstr(request, "\r\n");
+    *lineEnd = '\0';
+    char *headers = lineEnd + 2;
+    char *method = request;
+    char *target = strchr(method, ' ');
+    char *version = target ? strchr(target + 1, ' ') : NULL;
+    if (!target || !version || strncmp(version + 1, "HTTP/1.", 7) != 0) {
+        c->closeAfterResponse = true;
+        RTSPHLSRespond(c, 400, NULL, false);
+        return;
+    }
+    *target++ = '\0';
+    *version++ = '\0';
+
+    bool http10 = strcmp(version, "HTTP/1.0") == 0;
+    if (http10 ? !RTSPHLSHeaderHasToken(headers, "Connection", "keep-alive")
+               : RTSPHLSHeaderHasToken(headers, "Connection", "close")) {
+        c->closeAfterResponse = true;
+    }
+    char value[32];
+    bool hasBody = RTSPHLSHeaderHasToken(headers, "Transfer-Encoding", "chunked") ||
+                   (RTSPHLSHeaderValue(headers, "Content-Length", value, sizeof(value)) && strtoll(value, NULL, 10) != 0);
+    if (hasBody) {
+        c->closeAfterResponse = true; // Request bodies are never expected here
+        RTSPHLSRespond(c, 400, NULL, false);
+        return;
+    }
+
+    c->headOnly = strcmp(method, "HEAD") == 0;
+    if (!c->headOnly && strcmp(method, "GET") != 0) {
+        RTSPHLSRespond(c, 405, NULL, false);
+        return;
+    }
+
+    // "/<stream>/<resource>[?query]"
+    char *query = strchr(target, '?');
+    if (query) {
+        *query++ = '\0';
+    }
+    char *slash = target[0] == '/' ? strchr(target + 1, '/') : NULL;
+    size_t resourceLength = slash ? strlen(slash + 1) : 0;
+    if (!slash || resourceLength == 0 || resourceLength >= sizeof(c->resource) || strchr(slash + 1, '/')) {
+        RTSPHLSRespond(c, 404, NULL, false);
+        return;
+    }
+    RTSPHLSStoreRef store = RTSPHLSCopyStore(server, target + 1, (size_t)(slash - target - 1));
+    if (!store) {
+        RTSPHLSRespond(c, 404, NULL, false);
+        return;
+    }
+
+    c->store = store;
+    memcpy(c->resource, slash + 1, resourceLength + 1);
+    c->msn = -1;
+    c->part = -1;
+    if (query && strcmp(c->resource, "stream.m3u8") == 0) {
+        bool hasMSN = RTSPHLSQueryValue(query, "_HLS_msn", &c->msn);
+        bool hasPart = RTSPHLSQueryValue(query, "_HLS_part", &c->part);
+        if (hasPart && !hasMSN) {
+            RTSPHLSUnpark(c);
+            RTSPHLSRespond(c, 400, NULL, false);
+            return;
+        }
+    }
+    RTSPHLSPark(server, c, now);
+}
+
+static void RTSPHLSProcessInput(RTSPHLSServerRef server, RTSPHLSConnection *c, double now) {
+    // Pipelined requests are answered strictly in order
+    while (!c->responding && !c->parked && c->input.length > 0) {
+        uint8_t *end = NULL;
+        for (size_t i = 3; i < c->input.length; i++) {
+            if (memcmp(c->input.data + i - 3, "\r\n\r\n", 4) == 0) {
+                end = c->input.data + i + 1;
+                break;
+            }
+        }
+        if (!end) {
+            if (c->input.length > RTSP_HLS_MAX_REQUEST) {
+                c->closeAfterResponse = true;
+                RTSPHLSRespond(c, 431, NULL, false);
+            }
+            return;
+        }
+        size_t length = (size_t)(end - c->input.data);
+        char request[RTSP_HLS_MAX_REQUEST + 1];
+        if (length > RTSP_HLS_MAX_REQUEST) {
+            c->closeAfterResponse = true;
+            RTSPHLSRespond(c, 431, NULL, false);
+            return;
+        }
+        memcpy(request, c->input.data, length);
+        request[length] = '\0';
+        RTSPByteBufferConsume(&c->input, length);
+        RTSPHLSHandleRequest(server, c, request, now);
+    }
+}
+
+#pragma mark - Connections
+
+static void RTSPHLSConnectionFree(RTSPHLSConnection *c) {
+    close(c->fd);
+    RTSPHLSUnpark(c);
+    RTSPHLSResourceRelease(&c->body);
+    RTSPByteBufferFree(&c->input);
+    RTSPByteBufferFree(&c->head);
+    free(c);
+}
+
+/// Returns false when the connection should be closed
+static bool RTSPHLSFlush(RTSPHLSConnection *c) {
+    while (c->responding) {
+        struct iovec iov[2];
+        int count = 0;
+        if (c->headSent < c->head.length) {
+            iov[count++] = (struct iovec){c->head.data + c->headSent, c->head.length - c->headSent};
+        }
+        if (c->bodySent < c->body.length) {
+            iov[count++] = (struct iovec){(void *)(c->body.data + c->bodySent), c->body.length - c->bodySent};
+        }
+        if (count == 0) {
+            c->responding = false;
+            RTSPHLSResourceRelease(&c->body);
+            return !c->closeAfterResponse;
+        }
+        struct msghdr message = {.msg_iov = iov, .msg_iovlen = count};
+        ssize_t sent = sendmsg(c->fd, &message, MSG_NOSIGNAL);
+        if (sent < 0) {
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        }
+        size_t headLeft = c->head.length - c->headSent;
+        size_t headPart = (size_t)sent < headLeft ? (size_t)sent : headLeft;
+        c->headSent += headPart;
+        c->bodySent += (size_t)sent - headPart;
+    }
+    return true;
+}
+
+/// Returns false when the connection should be closed
+static bool RTSPHLSRead(RTSPHLSConnection *c) {
+    for (;;) {
+        if (!RTSPByteBufferReserve(&c->input, RTSP_HLS_READ_CHUNK)) {
+            return false;
+        }
+        ssize_t count = recv(c->fd, c->input.data + c->input.length, RTSP_HLS_READ_CHUNK, 0);
+        if (count > 0) {
+            c->input.length += (size_t)count;
+            if (c->input.length > 4 * RTSP_HLS_MAX_REQUEST) {
+                return false; // Pipelining far ahead of us
+            }
+            continue;
+        }
+        if (count == 0) {
+            return false;
+        }
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    }
+}
+
+static void RTSPHLSAccept(RTSPHLSServerRef server, double now) {
+    for (;;) {
+        int fd = accept(server->listener, NULL, NULL);
+        if (fd < 0) {
+            return;
+        }
+        if (server->connectionCount >= server->config.maxConnections) {
+            close(fd);
+            continue;
+        }
+        RTSPHLSConnection *c = calloc(1, sizeof(*c));
+        if (!c) {
+            close(fd);
+            continue;
+        }
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+#ifdef SO_NOSIGPIPE
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+        c->fd = fd;
+        c->lastActivity = now;
+        RTSPByteBufferInit(&c->input);
+        RTSPByteBufferInit(&c->head);
+        c->next = server->connections;
+        server->connections = c;
+        server->connectionCount++;
+    }
+}
+
+#pragma mark - Event Loop
+
+static void *RTSPHLSThread(void *argument) {
+    RTSPHLSServerRef server = argument;
+#if defined(__APPLE__)
+    pthread_setname_np("com.rtsp.hls-server");
+#elif defined(__linux__)
+    pthread_setname_np(pthread_self(), "rtsp-hls");
+#endif
+
+    for (;;) {
+        pthread_mutex_lock(&server->lock);
+        bool running = server->running;
+        server->local.connections = server->connectionCount;
+        server->statistics = server->local;
+        pthread_mutex_unlock(&server->lock);
+        if (!running) {
+            break;
+        }
+
+        size_t needed = server->connectionCount + 2;
+        if (needed > server->pollCapacity) {
+            size_t capacity = needed * 2;
+            struct pollfd *fds = realloc(server->pollfds, capacity * sizeof(*fds));
+            RTSPHLSConnection **polled = realloc(server->polled, capacity * sizeof(*polled));
+            if (fds) server->pollfds = fds;
+            if (polled) server->polled = polled;
+            if (!fds || !polled) {
+                usleep(10000);
+                continue;
+            }
+            server->pollCapacity = capacity;
+        }
+
+        double now = RTSPHLSNow();
+        double nextTimer = now + 1.0;
+        server->pollfds[0] = (struct pollfd){.fd = server->wakeup[0], .events = POLLIN};
+        server->pollfds[1] = (struct pollfd){.fd = server->listener, .events = POLLIN};
+        size_t nfds = 2;
+        for (RTSPHLSConnection *c = server->connections; c; c = c->next) {
+            nextTimer = fmin(nextTimer, c->parked ? c->deadline : c->lastActivity + server->config.idleTimeout);
+            server->polled[nfds] = c;
+            server->pollfds[nfds++] = (struct pollfd){
+                .fd = c->fd,
+                .events = (short)(c->responding ? POLLOUT : (c->parked ? 0 : POLLIN)),
+            };
+        }
+
+        int timeout = (int)fmax(0, ceil((nextTimer - now) * 1000.0));
+        int ready = poll(server->pollfds, (nfds_t)nfds, timeout);
+        if (ready < 0 && errno != EINTR) {
+            usleep(1000);
+            continue;
+        }
+        now = RTSPHLSNow();
+
+        if (server->pollfds[0].revents & POLLIN) {
+            char drain[64];
+            while (read(server->wakeup[0], drain, sizeof(drain)) > 0) {
+            }
+        }
+
+        for (size_t i = 2; i < nfds; i++) {
+            RTSPHLSConnection *c = server->polled[i];
+            short revents = server->pollfds[i].revents;
+            bool alive = !(revents & (POLLERR | POLLNVAL));
+            if (alive && (revents & (POLLIN | POLLHUP)) && !c->responding) {
+                alive = RTSPHLSRead(c);
+                c->lastActivity = now;
+            }
+            if (alive && c->parked) {
+                RTSPHLSPark(server, c, now); // Store changed or deadline passed
+            }
+            if (alive) {
+                RTSPHLSProcessInput(server, c, now);
+            }
+            if (alive && c->responding) {
+                alive = RTSPHLSFlush(c);
+                c->lastActivity = now;
+                if (alive && !c->responding) {
+                    RTSPHLSProcessInput(server, c, now);
+                    alive = RTSPHLSFlush(c);
+                }
+            }
+            if (alive && !c->parked && !c->responding && now - c->lastActivity > server->config.idleTimeout) {
+                alive = false;
+            }
+            if (!alive) {
+                c->fd = -c->fd - 1; // Marked for reaping below
+            }
+        }
+
+        RTSPHLSConnection **link = &server->connections;
+        while (*link) {
+            RTSPHLSConnection *c = *link;
+            if (c->fd < 0) {
+                c->fd = -c->fd - 1;
+                *link = c->next;
+                RTSPHLSConnectionFree(c);
+                server->connectionCount--;
+            } else {
+                link = &c->next;
+            }
+        }
+
+        if (server->pollfds[1].revents & POLLIN) {
+            RTSPHLSAccept(server, now);
+        }
+    }
+
+    while (server->connections) {
+        RTSPHLSConnection *next = server->connections->next;
+        RTSPHLSConnectionFree(server->connections);
+        server->connections = next;
+    }
+    return NULL;
+}
+
+#pragma mark - Public API
+
+RTSPHLSServerRef RTSPHLSServerCreate(const RTSPHLSServerConfig *config) {
+    RTSPHLSServerRef server = calloc(1, sizeof(*server));
+    if (!server) {
+        return NULL;
+    }
+    if (config) {
+        server->config = *config;
+    } else {
+        RTSPHLSServerConfigInit(&server->config);
+    }
+    snprintf(server->bindAddress, sizeof(server->bindAddress), "%s",
+             server->config.bindAddress ? server->config.bindAddress : "127.0.0.1");
+    server->config.bindAddress = server->bindAddress;
+    if (server->config.maxConnections == 0) {
+        server->config.maxConnections = 256;
+    }
+    if (server->config.idleTimeout <= 0) {
+        server->config.idleTimeout = 30.0;
+    }
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(server->config.port);
+    if (inet_pton(AF_INET, server->bindAddress, &address.sin_addr) != 1) {
+        free(server);
+        return NULL;
+    }
+
+    server->listener = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    socklen_t length = sizeof(address);
+    if (server->listener < 0 ||
+        setsockopt(server->listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) != 0 ||
+        bind(server->listener, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+        listen(server->listener, 128) != 0 ||
+        getsockname(server->listener, (struct sockaddr *)&address, &length) != 0 ||
+        pipe(server->wakeup) != 0) {
+        if (server->listener >= 0) {
+            close(server->listener);
+        }
+        free(server);
+        return NULL;
+    }
+    server->port = ntohs(address.sin_port);
+    fcntl(server->listener, F_SETFL, fcntl(server->listener, F_GETFL, 0) | O_NONBLOCK);
+    fcntl(server->listener, F_SETFD, FD_CLOEXEC);
+    for (int i = 0; i < 2; i++) {
+        fcntl(server->wakeup[i], F_SETFL, fcntl(server->wakeup[i], F_GETFL, 0) | O_NONBLOCK);
+        fcntl(server->wakeup[i], F_SETFD, FD_CLOEXEC);
+    }
+
+    pthread_mutex_init(&server->lock, NULL);
+    server->running = true;
+    if (pthread_create(&server->thread, NULL, RTSPHLSThread, server) != 0) {
+        close(server->listener);
+        close(server->wakeup[0]);
+        close(server->wakeup[1]);
+        pthread_mutex_destroy(&server->lock);
+        free(server);
+        return NULL;
+    }
+    return server;
+}
+
+void RTSPHLSServerRelease(RTSPHLSServerRef server) {
+    if (!server) {
+        return;
+    }
+    pthread_mutex_lock(&server->lock);
+    RTSPHLSPublication *publications = server->publications;
+    server->publications = NULL;
+    server->running = false;
+    pthread_mutex_unlock(&server->lock);
+
+    // Detach observers before the wakeup pipe goes away
+    while (publications) {
+        RTSPHLSPublication *next = publications->next;
+        RTSPHLSStoreSetObserver(publications->store, NULL, NULL);
+        RTSPHLSStoreRelease(publications->store);
+        free(publications);
+        publications = next;
+    }
+
+    RTSPHLSServerWake(server);
+    pthread_join(server->thread, NULL);
+    close(server->listener);
+    close(server->wakeup[0]);
+    close(server->wakeup[1]);
+    pthread_mutex_destroy(&server->lock);
+    free(server->pollfds);
+    free(server->polled);
+    free(server);
+}
+
+uint16_t RTSPHLSServerPort(RTSPHLSServerRef server) {
+    return server ? server->port : 0;
+}
+
+bool RTSPHLSServerPublish(RTSPHLSServerRef server, const char *name, RTSPHLSStoreRef store) {
+    size_t length = name ? strlen(name) : 0;
+    if (!server || !store || length == 0 || length >= RTSP_HLS_NAME_LENGTH) {
+        return false;
+    }
+    for (size_t i = 0; i < length; i++) {
+        if (!isalnum((unsigned char)name[i]) && name[i] != '_' && name[i] != '-') {
+            return false;
+        }
+    }
+    RTSPHLSPublication *publication = calloc(1, sizeof(*publication));
+    if (!publication) {
+        return false;
+    }
+    memcpy(publication->name, name, length + 1);
+    publication->store = RTSPHLSStoreRetain(store);
+
+    pthread_mutex_lock(&server->lock);
+    bool taken = false;
+    for (RTSPHLSPublication *p = server->publications; p; p = p->next) {
+        taken = taken || strcmp(p->name, name) == 0;
+    }
+    if (!taken) {
+        publication->next = server->publications;
+        server->publications = publication;
+    }
+    pthread_mutex_unlock(&server->lock);
+
+    if (taken) {
+        RTSPHLSStoreRelease(store);
+        free(publication);
+        return false;
+    }
+    RTSPHLSStoreSetObserver(store, RTSPHLSServerWake, server);
+    return true;
+}
+
+void RTSPHLSServerUnpublish(RTSPHLSServerRef server, const char *name) {
+    if (!server || !name) {
+        return;
+    }
+    RTSPHLSPublication *removed = NULL;
+    pthread_mutex_lock(&server->lock);
+    for (RTSPHLSPublication **link = &server->publications; *link; link = &(*link)->next) {
+        if (strcmp((*link)->name, name) == 0) {
+            removed = *link;
+            *link = removed->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&server->lock);
+
+    if (removed) {
+        RTSPHLSStoreSetObserver(removed->store, NULL, NULL);
+        RTSPHLSStoreRelease(removed->store);
+        free(removed);
+        RTSPHLSServerWake(server); // Parked requests still hold the store and time out normally
+    }
+}
+
+RTSPHLSServerStatistics RTSPHLSServerGetStatistics(RTSPHLSServerRef server) {
+    RTSPHLSServerStatistics statistics = {0};
+    if (server) {
+        pthread_mutex_lock(&server->lock);
+        statistics = server->statistics;
+        pthread_mutex_unlock(&server->lock);
+    }
+    return statistics;
+}
@@ -0,0 +1,65 @@
+//
+//  RTSPHLSServer.h
+//  RTSP Rotator
+//
+//  Embedded loopback HTTP/1.1 server for the in-memory HLS stores. One
+//  poll() thread serves every published camera with keep-alive, and parks
+//  LL-HLS blocking playlist reloads (_HLS_msn / _HLS_part) and preload-hint
+//  part requests until the store produces the media or the request times
+//  out. Responses reference store memory directly; nothing is copied or
+//  written to disk.
+//
+//  Portable C so it can be exercised on Linux by Benchmarks/remux_bench.
+//
+
+#ifndef RTSPHLSServer_h
+#define RTSPHLSServer_h
+
+#include "RTSPHLSStore.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    const char *bindAddress;        // IPv4 literal. Default "127.0.0.1"
+    uint16_t port;                  // 0 picks a free port. Default 0
+    uint32_t maxConnections;        // Default 256
+    double idleTimeout;             // Seconds before an idle keep-alive connection is closed. Default 30
+} RTSPHLSServerConfig;
+
+void RTSPHLSServerConfigInit(RTSPHLSServerConfig *config);
+
+typedef struct {
+    uint64_t requests;
+    uint64_t blockedRequests;       // Parked on a blocking reload or preload hint
+    uint64_t timedOutRequests;      // Parked requests answered with 503
+    uint64_t bytesSent;
+    uint32_t connections;
+} RTSPHLSServerStatistics;
+
+typedef struct RTSPHLSServer *RTSPHLSServerRef;
+
+/// Binds and starts the server thread. Returns NULL if the port is unavailable.
+RTSPHLSServerRef RTSPHLSServerCreate(const RTSPHLSServerConfig *config);
+
+/// Closes every connection and joins the server thread
+void RTSPHLSServerRelease(RTSPHLSServerRef server);
+
+/// The bound port (useful when the config asked for 0)
+uint16_t RTSPHLSServerPort(RTSPHLSServerRef server);
+
+/// Serve `store` under "/<name>/". Names are path segments ([A-Za-z0-9_-]).
+/// The server retains the store until it is unpublished.
+bool RTSPHLSServerPublish(RTSPHLSServerRef server, const char *name, RTSPHLSStoreRef store);
+
+/// Stop serving `name`. Requests already being answered complete normally.
+void RTSPHLSServerUnpublish(RTSPHLSServerRef server, const char *name);
+
+RTSPHLSServerStatistics RTSPHLSServerGetStatistics(RTSPHLSServerRef server);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RTSPHLSServer_h */
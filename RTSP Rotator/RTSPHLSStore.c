@@ -0,0 +1,591 @@
+//
+//  RTSPHLSStore.c
+//  RTSP Rotator
+//
+
+#include "RTSPHLSStore.h"
+#include "RTSPByteBuffer.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RTSP_HLS_MAX_INITS 4
+#define RTSP_HLS_MAX_PARTS 256          // Per segment; beyond this the segment is listed without parts
+#define RTSP_HLS_PART_WINDOW 3.0        // Parts stay listed for this many target durations (RFC 8216bis)
+
+static const char *const RTSPHLSPlaylistType = "application/vnd.apple.mpegurl";
+static const char *const RTSPHLSMediaType = "video/mp4";
+
+#pragma mark - Blobs
+
+typedef struct {
+    atomic_int references;
+    size_t length;
+    uint8_t data[];
+} RTSPHLSBlob;
+
+static RTSPHLSBlob *RTSPHLSBlobCreate(const uint8_t *data, size_t length) {
+    RTSPHLSBlob *blob = malloc(sizeof(*blob) + length);
+    if (!blob) {
+        return NULL;
+    }
+    atomic_init(&blob->references, 1);
+    blob->length = length;
+    memcpy(blob->data, data, length);
+    return blob;
+}
+
+static RTSPHLSBlob *RTSPHLSBlobRetain(RTSPHLSBlob *blob) {
+    if (blob) {
+        atomic_fetch_add_explicit(&blob->references, 1, memory_order_relaxed);
+    }
+    return blob;
+}
+
+static void RTSPHLSBlobRelease(RTSPHLSBlob *blob) {
+    if (blob && atomic_fetch_sub_explicit(&blob->references, 1, memory_order_acq_rel) == 1) {
+        free(blob);
+    }
+}
+
+#pragma mark - Store
+
+typedef struct {
+    RTSPHLSBlob *blob;              // Own blob while the segment is open, the segment's once finished
+    size_t offset;
+    size_t length;
+    double duration;
+    bool independent;
+} RTSPHLSPart;
+
+typedef struct {
+    uint32_t sequence;
+    uint32_t initID;
+    double duration;
+    bool independent;
+    bool discontinuity;
+    bool partsDropped;              // Too many parts, or they did not add up to the segment
+    RTSPHLSBlob *blob;              // NULL while open
+    RTSPHLSPart *parts;
+    uint32_t partCount;
+    uint32_t partCapacity;
+    size_t bytes;
+} RTSPHLSSegment;
+
+typedef struct {
+    uint32_t initID;
+    RTSPHLSBlob *blob;
+} RTSPHLSInit;
+
+struct RTSPHLSStore {
+    RTSPHLSStoreConfig config;
+    atomic_int references;
+    pthread_mutex_t lock;
+    RTSPHLSStoreObserver observer;
+    void *observerContext;
+
+    RTSPHLSSegment *segments;       // Finished segments, ring of config.segmentCount
+    uint32_t head;
+    uint32_t count;
+    RTSPHLSSegment open;
+    bool openValid;
+    RTSPHLSInit inits[RTSP_HLS_MAX_INITS];
+
+    size_t bytes;
+    double targetDuration;          // EXT-X-TARGETDURATION never shrinks
+    uint32_t discontinuitySequence;
+    uint64_t evicted;
+
+    RTSPHLSBlob *playlist;
+    RTSPByteBuffer text;
+};
+
+void RTSPHLSStoreConfigInit(RTSPHLSStoreConfig *config) {
+    config->segmentCount = 6;
+    config->maxBytes = 32 * 1024 * 1024;
+    config->targetDuration = 2.0;
+    config->partTargetDuration = 0.2;
+}
+
+static RTSPHLSSegment *RTSPHLSSegmentAt(RTSPHLSStoreRef store, uint32_t index) {
+    return &store->segments[(store->head + index) % store->config.segmentCount];
+}
+
+static void RTSPHLSSegmentClear(RTSPHLSSegment *segment) {
+    for (uint32_t i = 0; i < segment->partCount; i++) {
+        RTSPHLSBlobRelease(segment->parts[i].blob);
+    }
+    free(segment->parts);
+    RTSPHLSBlobRelease(segment->blob);
+    memset(segment, 0, sizeof(*segment));
+}
+
+static void RTSPHLSStoreDropOpen(RTSPHLSStoreRef store) {
+    if (store->openValid) {
+        store->bytes -= store->open.bytes;
+        RTSPHLSSegmentClear(&store->open);
+        store->openValid = false;
+    }
+}
+
+static void RTSPHLSStoreEvictOldest(RTSPHLSStoreRef store) {
+    RTSPHLSSegment *oldest = RTSPHLSSegmentAt(store, 0);
+    RTSPHLSSegment *next = store->count > 1 ? RTSPHLSSegmentAt(store, 1) : NULL;
+    if (next && next->discontinuity) {
+        store->discontinuitySequence++;   // The tag leaves the playlist with its predecessor
+    }
+    store->bytes -= oldest->bytes;
+    RTSPHLSSegmentClear(oldest);
+    store->head = (store->head + 1) % store->config.segmentCount;
+    store->count--;
+    store->evicted++;
+}
+
+static bool RTSPHLSStoreReferencesInit(RTSPHLSStoreRef store, uint32_t initID) {
+    for (uint32_t i = 0; i < store->count; i++) {
+        if (RTSPHLSSegmentAt(store, i)->initID == initID) {
+            return true;
+        }
+    }
+    return store->openValid && store->open.initID == initID;
+}
+
+static double RTSPHLSStoreOpenDuration(RTSPHLSStoreRef store) {
+    double duration = 0;
+    for (uint32_t i = 0; store->openValid && i < store->open.partCount; i++) {
+        duration += store->open.parts[i].duration;
+    }
+    return duration;
+}
+
+static bool RTSPHLSStoreListsParts(RTSPHLSStoreRef store) {
+    return store->config.partTargetDuration > 0;
+}
+
+#pragma mark - Playlist
+
+static void RTSPHLSAppendParts(RTSPHLSStoreRef store, const RTSPHLSSegment *segment) {
+    RTSPByteBuffer *b = &store->text;
+    for (uint32_t i = 0; i < segment->partCount; i++) {
+        const RTSPHLSPart *part = &segment->parts[i];
+        RTSPByteBufferAppendFormat(b, "#EXT-X-PART:DURATION=%.5f,URI=\"part_%u.%u.m4s\"%s\n",
+                                   part->duration, segment->sequence, i,
+                                   part->independent ? ",INDEPENDENT=YES" : "");
+    }
+}
+
+static void RTSPHLSStoreRenderPlaylist(RTSPHLSStoreRef store) {
+    if (store->count == 0 && (!store->openValid || store->open.partCount == 0)) {
+        return;
+    }
+    bool lowLatency = RTSPHLSStoreListsParts(store);
+    RTSPByteBuffer *b = &store->text;
+    RTSPByteBufferReset(b);
+
+    uint32_t firstSequence = store->count > 0 ? RTSPHLSSegmentAt(store, 0)->sequence : store->open.sequence;
+    RTSPByteBufferAppendFormat(b, "#EXTM3U\n#EXT-X-VERSION:%d\n", lowLatency ? 9 : 7);
+    RTSPByteBufferAppendFormat(b, "#EXT-X-TARGETDURATION:%d\n", (int)ceil(store->targetDuration));
+    if (lowLatency) {
+        RTSPByteBufferAppendFormat(b, "#EXT-X-SERVER-CONTROL:CAN-BLOCK-RELOAD=YES,PART-HOLD-BACK=%.3f\n",
+                                   store->config.partTargetDuration * 3.0);
+        RTSPByteBufferAppendFormat(b, "#EXT-X-PART-INF:PART-TARGET=%.5f\n", store->config.partTargetDuration);
+    } else {
+        RTSPByteBufferAppendString(b, "#EXT-X-SERVER-CONTROL:CAN-BLOCK-RELOAD=YES\n");
+    }
+    RTSPByteBufferAppendFormat(b, "#EXT-X-MEDIA-SEQUENCE:%u\n", firstSequence);
+    if (store->discontinuitySequence > 0) {
+        RTSPByteBufferAppendFormat(b, "#EXT-X-DISCONTINUITY-SEQUENCE:%u\n", store->discontinuitySequence);
+    }
+    RTSPByteBufferAppendString(b, "#EXT-X-INDEPENDENT-SEGMENTS\n");
+
+    // Parts are listed only near the live edge
+    double partWindow = RTSP_HLS_PART_WINDOW * store->targetDuration;
+    double age = RTSPHLSStoreOpenDuration(store);
+    uint32_t partsFrom = store->count;
+    while (lowLatency && partsFrom > 0 && age < partWindow) {
+        partsFrom--;
+        age += RTSPHLSSegmentAt(store, partsFrom)->duration;
+    }
+
+    uint32_t mappedInit = 0;
+    uint32_t total = store->count + (store->openValid ? 1 : 0);
+    for (uint32_t i = 0; i < total; i++) {
+        const RTSPHLSSegment *segment = i < store->count ? RTSPHLSSegmentAt(store, i) : &store->open;
+        if (segment->discontinuity && i > 0) {
+            RTSPByteBufferAppendString(b, "#EXT-X-DISCONTINUITY\n");
+        }
+        if (segment->initID != mappedInit) {
+            RTSPByteBufferAppendFormat(b, "#EXT-X-MAP:URI=\"init_%u.mp4\"\n", segment->initID);
+            mappedInit = segment->initID;
+        }
+        if (lowLatency && i >= partsFrom && !segment->partsDropped) {
+            RTSPHLSAppendParts(store, segment);
+        }
+        if (segment->blob) {
+            RTSPByteBufferAppendFormat(b, "#EXTINF:%.5f,\nsegment_%u.m4s\n", segment->duration, segment->sequence);
+        }
+    }
+
+    if (lowLatency) {
+        uint32_t hintSequence = store->openValid ? store->open.sequence
+                              : RTSPHLSSegmentAt(store, store->count - 1)->sequence + 1;
+        uint32_t hintPart = store->openValid ? store->open.partCount : 0;
+        RTSPByteBufferAppendFormat(b, "#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\"part_%u.%u.m4s\"\n", hintSequence, hintPart);
+    }
+
+    if (b->failed) {
+        return;
+    }
+    RTSPHLSBlob *playlist = RTSPHLSBlobCreate(b->data, b->length);
+    if (playlist) {
+        RTSPHLSBlobRelease(store->playlist);
+        store->playlist = playlist;
+    }
+}
+
+static void RTSPHLSStoreChanged(RTSPHLSStoreRef store) {
+    RTSPHLSStoreRenderPlaylist(store);
+    if (store->observer) {
+        store->observer(store->observerContext);
+    }
+}
+
+#pragma mark - Lifecycle
+
+RTSPHLSStoreRef RTSPHLSStoreCreate(const RTSPHLSStoreConfig *config) {
+    RTSPHLSStoreRef store = calloc(1, sizeof(*store));
+    if (!store) {
+        return NULL;
+    }
+    if (config) {
+        store->config = *config;
+    } else {
+        RTSPHLSStoreConfigInit(&store->config);
+    }
+    if (store->config.segmentCount < 2) {
+        store->config.segmentCount = 2;
+    }
+    if (store->config.targetDuration <= 0) {
+        store->config.targetDuration = 2.0;
+    }
+    if (store->config.partTargetDuration < 0) {
+        store->config.partTargetDuration = 0;
+    }
+    store->segments = calloc(store->config.segmentCount, sizeof(*store->segments));
+    if (!store->segments) {
+        free(store);
+        return NULL;
+    }
+    atomic_init(&store->references, 1);
+    pthread_mutex_init(&store->lock, NULL);
+    RTSPByteBufferInit(&store->text);
+    store->targetDuration = store->config.targetDuration;
+    return store;
+}
+
+RTSPHLSStoreRef RTSPHLSStoreRetain(RTSPHLSStoreRef store) {
+    if (store) {
+        atomic_fetch_add_explicit(&store->references, 1, memory_order_relaxed);
+    }
+    return store;
+}
+
+void RTSPHLSStoreRelease(RTSPHLSStoreRef store) {
+    if (!store || atomic_fetch_sub_explicit(&store->references, 1, memory_order_acq_rel) != 1) {
+        return;
+    }
+    while (store->count > 0) {
+        RTSPHLSStoreEvictOldest(store);
+    }
+    RTSPHLSStoreDropOpen(store);
+    for (size_t i = 0; i < RTSP_HLS_MAX_INITS; i++) {
+        RTSPHLSBlobRelease(store->inits[i].blob);
+    }
+    RTSPHLSBlobRelease(store->playlist);
+    RTSPByteBufferFree(&store->text);
+    pthread_mutex_destroy(&store->lock);
+    free(store->segments);
+    free(store);
+}
+
+void RTSPHLSStoreSetObserver(RTSPHLSStoreRef store, RTSPHLSStoreObserver observer, void *context) {
+    pthread_mutex_lock(&store->lock);
+    store->observer = observer;
+    store->observerContext = context;
+    pthread_mutex_unlock(&store->lock);
+}
+
+#pragma mark - Writing
+
+void RTSPHLSStoreAddInitSegment(RTSPHLSStoreRef store, uint32_t initID, const uint8_t *data, size_t length) {
+    RTSPHLSBlob *blob = RTSPHLSBlobCreate(data, length);
+    if (!blob) {
+        return;
+    }
+    pthread_mutex_lock(&store->lock);
+    // Reuse an empty slot, else the oldest init nothing in the window needs
+    RTSPHLSInit *slot = NULL;
+    for (size_t i = 0; i < RTSP_HLS_MAX_INITS && !slot; i++) {
+        if (!store->inits[i].blob) {
+            slot = &store->inits[i];
+        }
+    }
+    for (size_t i = 0; i < RTSP_HLS_MAX_INITS && !slot; i++) {
+        if (!RTSPHLSStoreReferencesInit(store, store->inits[i].initID)) {
+            slot = &store->inits[i];
+        }
+    }
+    if (!slot) {
+        slot = &store->inits[0];
+        for (size_t i = 1; i < RTSP_HLS_MAX_INITS; i++) {
+            if (store->inits[i].initID < slot->initID) {
+                slot = &store->inits[i];
+            }
+        }
+    }
+    RTSPHLSBlobRelease(slot->blob);
+    slot->initID = initID;
+    slot->blob = blob;
+    pthread_mutex_unlock(&store->lock);
+}
+
+static bool RTSPHLSStoreBeginSegment(RTSPHLSStoreRef store, const RTSPRemuxMediaInfo *info) {
+    if (store->openValid && store->open.sequence == info->sequence) {
+        return true;
+    }
+    RTSPHLSStoreDropOpen(store); // Abandoned without a finished segment
+    store->open = (RTSPHLSSegment){
+        .sequence = info->sequence,
+        .initID = info->initID,
+        .independent = info->independent,
+        .discontinuity = info->discontinuity,
+    };
+    store->openValid = true;
+    return true;
+}
+
+void RTSPHLSStoreAddPart(RTSPHLSStoreRef store, const RTSPRemuxMediaInfo *info, const uint8_t *data, size_t length) {
+    RTSPHLSBlob *blob = RTSPHLSBlobCreate(data, length);
+    if (!blob) {
+        return;
+    }
+    pthread_mutex_lock(&store->lock);
+    RTSPHLSStoreBeginSegment(store, info);
+    RTSPHLSSegment *open = &store->open;
+    if (open->partsDropped || info->part != open->partCount || open->partCount == RTSP_HLS_MAX_PARTS) {
+        open->partsDropped = true;
+        RTSPHLSBlobRelease(blob);
+        pthread_mutex_unlock(&store->lock);
+        return;
+    }
+    if (open->partCount == open->partCapacity) {
+        uint32_t capacity = open->partCapacity ? open->partCapacity * 2 : 16;
+        RTSPHLSPart *parts = realloc(open->parts, capacity * sizeof(*parts));
+        if (!parts) {
+            open->partsDropped = true;
+            RTSPHLSBlobRelease(blob);
+            pthread_mutex_unlock(&store->lock);
+            return;
+        }
+        open->parts = parts;
+        open->partCapacity = capacity;
+    }
+    open->parts[open->partCount++] = (RTSPHLSPart){
+        .blob = blob,
+        .offset = 0,
+        .length = length,
+        .duration = info->duration,
+        .independent = info->independent,
+    };
+    open->bytes += length;
+    store->bytes += length;
+    RTSPHLSStoreChanged(store);
+    pthread_mutex_unlock(&store->lock);
+}
+
+void RTSPHLSStoreAddSegment(RTSPHLSStoreRef store, const RTSPRemuxMediaInfo *info, const uint8_t *data, size_t length) {
+    RTSPHLSBlob *blob = RTSPHLSBlobCreate(data, length);
+    if (!blob) {
+        return;
+    }
+    pthread_mutex_lock(&store->lock);
+    RTSPHLSStoreBeginSegment(store, info);
+    RTSPHLSSegment segment = store->open;
+    store->bytes -= segment.bytes;
+    store->openValid = false;
+    memset(&store->open, 0, sizeof(store->open));
+
+    // Re-point the parts into the finished segment so its bytes are held once
+    size_t offset = 0;
+    for (uint32_t i = 0; i < segment.partCount; i++) {
+        offset += segment.parts[i].length;
+    }
+    if (segment.partCount != info->part || offset != length) {
+        segment.partsDropped = segment.partsDropped || segment.partCount > 0;
+    }
+    offset = 0;
+    for (uint32_t i = 0; i < segment.partCount; i++) {
+        RTSPHLSPart *part = &segment.parts[i];
+        RTSPHLSBlobRelease(part->blob);
+        part->blob = NULL;
+        part->offset = offset;
+        offset += part->length;
+    }
+    if (segment.partsDropped) {
+        free(segment.parts);
+        segment.parts = NULL;
+        segment.partCount = 0;
+        segment.partCapacity = 0;
+    }
+    segment.blob = blob;
+    segment.duration = info->duration;
+    segment.bytes = length;
+    store->targetDuration = fmax(store->targetDuration, ceil(info->duration));
+
+    if (store->count == store->config.segmentCount) {
+        RTSPHLSStoreEvictOldest(store);
+    }
+    *RTSPHLSSegmentAt(store, store->count) = segment;
+    store->count++;
+    store->bytes += length;
+    while (store->bytes > store->config.maxBytes && store->count > 1) {
+        RTSPHLSStoreEvictOldest(store);
+    }
+    RTSPHLSStoreChanged(store);
+    pthread_mutex_unlock(&store->lock);
+}
+
+#pragma mark - Reading
+
+bool RTSPHLSStoreIsPlayable(RTSPHLSStoreRef store) {
+    pthread_mutex_lock(&store->lock);
+    bool playable = store->count > 0 ||
+                    (RTSPHLSStoreListsParts(store) && !store->open.partsDropped &&
+                     RTSPHLSStoreOpenDuration(store) >= store->config.partTargetDuration * 3.0 - 1e-6);
+    pthread_mutex_unlock(&store->lock);
+    return playable;
+}
+
+static uint32_t RTSPHLSStoreLastFinished(RTSPHLSStoreRef store) {
+    return store->count > 0 ? RTSPHLSSegmentAt(store, store->count - 1)->sequence : 0;
+}
+
+bool RTSPHLSStoreHasMedia(RTSPHLSStoreRef store, int64_t msn, int64_t part, bool *tooFar) {
+    pthread_mutex_lock(&store->lock);
+    uint32_t lastFinished = RTSPHLSStoreLastFinished(store);
+    bool available = msn <= (int64_t)lastFinished && (store->count > 0 || store->openValid);
+    if (!available && part >= 0 && store->openValid && store->open.sequence == msn) {
+        available = part < (int64_t)store->open.partCount;
+    }
+    if (tooFar) {
+        int64_t lastListed = store->openValid ? store->open.sequence : lastFinished;
+        *tooFar = lastListed > 0 && msn > lastListed + 2;
+    }
+    pthread_mutex_unlock(&store->lock);
+    return available;
+}
+
+static bool RTSPHLSParse(const char *name, const char *format, unsigned *a, unsigned *b) {
+    int consumed = -1;
+    int matched = b ? sscanf(name, format, a, b, &consumed) : sscanf(name, format, a, &consumed);
+    return matched == (b ? 2 : 1) && consumed >= 0 && name[consumed] == '\0';
+}
+
+static void RTSPHLSFillResource(RTSPHLSResource *resource, RTSPHLSBlob *blob, size_t offset, size_t length,
+                                const char *contentType) {
+    resource->owner = RTSPHLSBlobRetain(blob);
+    resource->data = blob->data + offset;
+    resource->length = length;
+    resource->contentType = contentType;
+}
+
+RTSPHLSLookupResult RTSPHLSStoreCopyResource(RTSPHLSStoreRef store, const char *name, RTSPHLSResource *resource) {
+    memset(resource, 0, sizeof(*resource));
+    unsigned first = 0, second = 0;
+    RTSPHLSLookupResult result = RTSPHLSLookupNotFound;
+
+    pthread_mutex_lock(&store->lock);
+    uint32_t lastFinished = RTSPHLSStoreLastFinished(store);
+
+    if (strcmp(name, "stream.m3u8") == 0) {
+        if (store->playlist) {
+            RTSPHLSFillResource(resource, store->playlist, 0, store->playlist->length, RTSPHLSPlaylistType);
+            result = RTSPHLSLookupFound;
+        } else {
+            result = RTSPHLSLookupPending;
+        }
+    } else if (RTSPHLSParse(name, "init_%u.mp4%n", &first, NULL)) {
+        for (size_t i = 0; i < RTSP_HLS_MAX_INITS; i++) {
+            if (store->inits[i].blob && store->inits[i].initID == first) {
+                RTSPHLSFillResource(resource, store->inits[i].blob, 0, store->inits[i].blob->length, RTSPHLSMediaType);
+                result = RTSPHLSLookupFound;
+            }
+        }
+    } else if (RTSPHLSParse(name, "segment_%u.m4s%n", &first, NULL)) {
+        for (uint32_t i = 0; i < store->count; i++) {
+            RTSPHLSSegment *segment = RTSPHLSSegmentAt(store, i);
+            if (segment->sequence == first) {
+                RTSPHLSFillResource(resource, segment->blob, 0, segment->bytes, RTSPHLSMediaType);
+                result = RTSPHLSLookupFound;
+            }
+        }
+        if (result != RTSPHLSLookupFound && first == lastFinished + 1) {
+            result = RTSPHLSLookupPending;
+        }
+    } else if (RTSPHLSParse(name, "part_%u.%u.m4s%n", &first, &second)) {
+        if (store->openValid && store->open.sequence == first && !store->open.partsDropped) {
+            if (second < store->open.partCount) {
+                RTSPHLSPart *part = &store->open.parts[second];
+                RTSPHLSFillResource(resource, part->blob, 0, part->length, RTSPHLSMediaType);
+                result = RTSPHLSLookupFound;
+            } else if (second == store->open.partCount) {
+                result = RTSPHLSLookupPending; // The preload hint
+            }
+        } else if (!store->openValid && first == lastFinished + 1 && second == 0) {
+            result = RTSPHLSLookupPending;
+        } else {
+            for (uint32_t i = 0; i < store->count; i++) {
+                RTSPHLSSegment *segment = RTSPHLSSegmentAt(store, i);
+                if (segment->sequence == first && second < segment->partCount) {
+                    RTSPHLSPart *part = &segment->parts[second];
+                    RTSPHLSFillResource(resource, segment->blob, part->offset, part->length, RTSPHLSMediaType);
+                    result = RTSPHLSLookupFound;
+                }
+            }
+        }
+    }
+    pthread_mutex_unlock(&store->lock);
+    return result;
+}
+
+void RTSPHLSResourceRelease(RTSPHLSResource *resource) {
+    if (resource && resource->owner) {
+        RTSPHLSBlobRelease(resource->owner);
+        memset(resource, 0, sizeof(*resource));
+    }
+}
+
+double RTSPHLSStoreTargetDuration(RTSPHLSStoreRef store) {
+    pthread_mutex_lock(&store->lock);
+    double duration = ceil(store->targetDuration);
+    pthread_mutex_unlock(&store->lock);
+    return duration;
+}
+
+RTSPHLSStoreStatistics RTSPHLSStoreGetStatistics(RTSPHLSStoreRef store) {
+    pthread_mutex_lock(&store->lock);
+    RTSPHLSStoreStatistics statistics = {
+        .segments = store->count,
+        .parts = store->openValid ? store->open.partCount : 0,
+        .bytes = store->bytes,
+        .firstSequence = store->count > 0 ? RTSPHLSSegmentAt(store, 0)->sequence : 0,
+        .lastSequence = RTSPHLSStoreLastFinished(store),
+        .evictedSegments = store->evicted,
+    };
+    pthread_mutex_unlock(&store->lock);
+    return statistics;
+}
@@ -0,0 +1,106 @@
+//
+//  RTSPHLSStore.h
+//  RTSP Rotator
+//
+//  Bounded in-memory HLS window for one camera. Holds the init segments,
+//  media segments and LL-HLS partial segments produced by RTSPRemuxEngine
+//  and renders the live playlist, so nothing is written to disk.
+//
+//  Eviction is deterministic: after every finished segment the oldest
+//  segments are dropped until at most `segmentCount` remain and the stream
+//  fits in `maxBytes`. Parts are slices of their parent segment once it is
+//  finished, so a segment's bytes are only ever held once.
+//
+//  Writers (the engine thread) and readers (the HTTP server) may run on
+//  different threads; resources handed out are reference counted and stay
+//  valid after eviction until released.
+//
+
+#ifndef RTSPHLSStore_h
+#define RTSPHLSStore_h
+
+#include "RTSPRemuxEngine.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t segmentCount;          // Finished segments in the live window. Default 6
+    size_t maxBytes;                // Media held per stream, including the open segment. Default 32 MB
+    double targetDuration;          // Segment target, used before the first segment finishes. Default 2.0
+    double partTargetDuration;      // PART-TARGET, must match the engine; 0 disables LL-HLS tags. Default 0.2
+} RTSPHLSStoreConfig;
+
+void RTSPHLSStoreConfigInit(RTSPHLSStoreConfig *config);
+
+typedef struct RTSPHLSStore *RTSPHLSStoreRef;
+
+/// Immutable bytes handed to a reader; release when done
+typedef struct {
+    const uint8_t *data;
+    size_t length;
+    const char *contentType;
+    void *owner;
+} RTSPHLSResource;
+
+typedef enum {
+    RTSPHLSLookupFound = 0,
+    RTSPHLSLookupPending,           // Announced (next part or segment) but not produced yet
+    RTSPHLSLookupNotFound
+} RTSPHLSLookupResult;
+
+typedef struct {
+    uint32_t segments;              // Finished segments held
+    uint32_t parts;                 // Parts of the open segment
+    size_t bytes;                   // Media bytes held
+    uint32_t firstSequence;
+    uint32_t lastSequence;          // Last finished segment, 0 before the first one
+    uint64_t evictedSegments;
+} RTSPHLSStoreStatistics;
+
+/// Called with the store lock held after every update; must only signal
+typedef void (*RTSPHLSStoreObserver)(void *context);
+
+RTSPHLSStoreRef RTSPHLSStoreCreate(const RTSPHLSStoreConfig *config);
+RTSPHLSStoreRef RTSPHLSStoreRetain(RTSPHLSStoreRef store);
+void RTSPHLSStoreRelease(RTSPHLSStoreRef store);
+
+void RTSPHLSStoreSetObserver(RTSPHLSStoreRef store, RTSPHLSStoreObserver observer, void *context);
+
+#pragma mark - Writing (RTSPRemuxSink shaped)
+
+void RTSPHLSStoreAddInitSegment(RTSPHLSStoreRef store, uint32_t initID, const uint8_t *data, size_t length);
+void RTSPHLSStoreAddPart(RTSPHLSStoreRef store, const RTSPRemuxMediaInfo *info, const uint8_t *data, size_t length);
+void RTSPHLSStoreAddSegment(RTSPHLSStoreRef store, const RTSPRemuxMediaInfo *info, const uint8_t *data, size_t length);
+
+#pragma mark - Reading
+
+/// True once the playlist holds enough media to start playback
+/// (PART-HOLD-BACK worth of parts, or one finished segment)
+bool RTSPHLSStoreIsPlayable(RTSPHLSStoreRef store);
+
+/// True if a blocking playlist request for (msn, part) can be answered.
+/// `part` < 0 waits for the whole segment. Sets `tooFar` for requests more
+/// than one segment ahead of the live edge (HTTP 400 per the LL-HLS spec).
+bool RTSPHLSStoreHasMedia(RTSPHLSStoreRef store, int64_t msn, int64_t part, bool *tooFar);
+
+/// Look up "stream.m3u8", "init_<id>.mp4", "segment_<seq>.m4s" or "part_<seq>.<index>.m4s"
+RTSPHLSLookupResult RTSPHLSStoreCopyResource(RTSPHLSStoreRef store, const char *name, RTSPHLSResource *resource);
+
+void RTSPHLSResourceRelease(RTSPHLSResource *resource);
+
+/// Longest segment in the window (EXT-X-TARGETDURATION), for blocking timeouts
+double RTSPHLSStoreTargetDuration(RTSPHLSStoreRef store);
+
+RTSPHLSStoreStatistics RTSPHLSStoreGetStatistics(RTSPHLSStoreRef store);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RTSPHLSStore_h */
@@ -0,0 +1,291 @@
+//
+//  RTSPHTTPRouter.c
+//  RTSP Rotator
+//
+
+#include "RTSPHTTPRouter.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct RTSPHTTPRouteNode {
+    char *segment;                          // Literal text, or the parameter name
+    size_t length;
+    struct RTSPHTTPRouteNode **literals;
+    size_t literalCount;
+    struct RTSPHTTPRouteNode *parameter;
+    struct RTSPHTTPRouteNode *wildcard;
+    const void *targets[RTSP_HTTP_METHOD_COUNT];
+    uint32_t methods;
+} RTSPHTTPRouteNode;
+
+struct RTSPHTTPRouter {
+    RTSPHTTPRouteNode root;
+};
+
+static const char *const RTSPHTTPMethodNames[RTSP_HTTP_METHOD_COUNT] = {
+    "GET", "HEAD", "POST", "PUT", "DELETE", "OPTIONS", "PATCH"
+};
+
+RTSPHTTPMethod RTSPHTTPMethodFromString(const char *method, size_t length) {
+    for (int i = 0; i < RTSP_HTTP_METHOD_COUNT; i++) {
+        if (strlen(RTSPHTTPMethodNames[i]) == length && memcmp(RTSPHTTPMethodNames[i], method, length) == 0) {
+            return (RTSPHTTPMethod)(1u << i);
+        }
+    }
+    return 0;
+}
+
+static int RTSPHTTPMethodIndex(uint32_t method) {
+    int index = 0;
+    while (method > 1) {
+        method >>= 1;
+        index++;
+    }
+    return index;
+}
+
+const char *RTSPHTTPMethodName(RTSPHTTPMethod method) {
+    int index = RTSPHTTPMethodIndex(method);
+    return index < RTSP_HTTP_METHOD_COUNT ? RTSPHTTPMethodNames[index] : "";
+}
+
+#pragma mark - Building
+
+static RTSPHTTPRouteNode *RTSPHTTPRouteNodeCreate(const char *segment, size_t length) {
+    RTSPHTTPRouteNode *node = calloc(1, sizeof(*node));
+    if (!node) {
+        return NULL;
+    }
+    node->segment = malloc(length + 1);
+    if (!node->segment) {
+        free(node);
+        return NULL;
+    }
+    memcpy(node->segment, segment, length);
+    node->segment[length] = '\0';
+    node->length = length;
+    return node;
+}
+
+static void RTSPHTTPRouteNodeFree(RTSPHTTPRouteNode *node, bool freeSelf) {
+    if (!node) {
+        return;
+    }
+    for (size_t i = 0; i < node->literalCount; i++) {
+        RTSPHTTPRouteNodeFree(node->literals[i], true);
+    }
+    free(node->literals);
+    RTSPHTTPRouteNodeFree(node->parameter, true);
+    RTSPHTTPRouteNodeFree(node->wildcard, true);
+    free(node->segment);
+    if (freeSelf) {
+        free(node);
+    }
+}
+
+static RTSPHTTPRouteNode *RTSPHTTPRouteChild(RTSPHTTPRouteNode *node, const char *segment, size_t length) {
+    if (segment[0] == '*') {
+        if (length != 1) {
+            return NULL;
+        }
+        if (!node->wildcard) {
+            node->wildcard = RTSPHTTPRouteNodeCreate("*", 1);
+        }
+        return node->wildcard;
+    }
+    if (segment[0] == ':') {
+        if (length < 2) {
+            return NULL;
+        }
+        if (!node->parameter) {
+            node->parameter = RTSPHTTPRouteNodeCreate(segment + 1, length - 1);
+        } else if (node->parameter->length != length - 1 || memcmp(node->parameter->segment, segment + 1, length - 1) != 0) {
+            return NULL; // One name per position keeps captures unambiguous
+        }
+        return node->parameter;
+    }
+    for (size_t i = 0; i < node->literalCount; i++) {
+        RTSPHTTPRouteNode *child = node->literals[i];
+        if (child->length == length && memcmp(child->segment, segment, length) == 0) {
+            return child;
+        }
+    }
+    RTSPHTTPRouteNode **literals = realloc(node->literals, (node->literalCount + 1) * sizeof(*literals));
+    if (!literals) {
+        return NULL;
+    }
+    node->literals = literals;
+    RTSPHTTPRouteNode *child = RTSPHTTPRouteNodeCreate(segment, length);
+    if (child) {
+        node->literals[node->literalCount++] = child;
+    }
+    return child;
+}
+
+RTSPHTTPRouterRef RTSPHTTPRouterCreate(void) {
+    return calloc(1, sizeof(struct RTSPHTTPRouter));
+}
+
+void RTSPHTTPRouterRelease(RTSPHTTPRouterRef router) {
+    if (!router) {
+        return;
+    }
+    RTSPHTTPRouteNodeFree(&router->root, false);
+    free(router);
+}
+
+bool RTSPHTTPRouterAdd(RTSPHTTPRouterRef router, uint32_t methods, const char *pattern, const void *target) {
+    if (!router || !pattern || pattern[0] != '/' || (methods & RTSP_HTTP_METHOD_ANY) == 0) {
+        return false;
+    }
+    RTSPHTTPRouteNode *node = &router->root;
+    const char *p = pattern;
+    uint32_t captures = 0;
+    bool wildcard = false;
+    while (*p) {
+        while (*p == '/') {
+            p++;
+        }
+        if (!*p) {
+            break;
+        }
+        if (wildcard) {
+            return false; // Nothing may follow a wildcard
+        }
+        wildcard = p[0] == '*';
+        const char *end = strchr(p, '/');
+        size_t length = end ? (size_t)(end - p) : strlen(p);
+        if ((p[0] == ':' || p[0] == '*') && ++captures > RTSP_HTTP_MAX_PARAMS) {
+            return false;
+        }
+        node = RTSPHTTPRouteChild(node, p, length);
+        if (!node) {
+            return false;
+        }
+        p += length;
+    }
+
+    methods &= RTSP_HTTP_METHOD_ANY;
+    if (node->methods & methods) {
+        return false;
+    }
+    for (int i = 0; i < RTSP_HTTP_METHOD_COUNT; i++) {
+        if (methods & (1u << i)) {
+            node->targets[i] = target;
+        }
+    }
+    node->methods |= methods;
+    return true;
+}
+
+#pragma mark - Matching
+
+static uint32_t RTSPHTTPAllowedMethods(const RTSPHTTPRouteNode *node) {
+    uint32_t methods = node->methods;
+    if (methods & RTSPHTTPMethodGET) {
+        methods |= RTSPHTTPMethodHEAD;
+    }
+    return methods;
+}
+
+static RTSPHTTPRouteResult RTSPHTTPRouteResolve(const RTSPHTTPRouteNode *node, RTSPHTTPMethod method,
+                                                RTSPHTTPRouteMatch *match) {
+    if (node->methods == 0) {
+        return RTSPHTTPRouteNotFound;
+    }
+    uint32_t key = method;
+    if (method == RTSPHTTPMethodHEAD && !(node->methods & RTSPHTTPMethodHEAD)) {
+        key = RTSPHTTPMethodGET;
+    }
+    if (!(node->methods & key)) {
+        match->allowedMethods = RTSPHTTPAllowedMethods(node);
+        return RTSPHTTPRouteMethodNotAllowed;
+    }
+    match->target = node->targets[RTSPHTTPMethodIndex(key)];
+    match->allowedMethods = RTSPHTTPAllowedMethods(node);
+    return RTSPHTTPRouteFound;
+}
+
+static RTSPHTTPRouteResult RTSPHTTPRouteMatchWildcard(const RTSPHTTPRouteNode *wildcard, RTSPHTTPMethod method,
+                                                      const char *p, const char *end, RTSPHTTPRouteMatch *match) {
+    match->params[match->paramCount++] = (RTSPHTTPRouteParam){"*", p, (size_t)(end - p)};
+    RTSPHTTPRouteResult result = RTSPHTTPRouteResolve(wildcard, method, match);
+    if (result != RTSPHTTPRouteFound) {
+        match->paramCount--;
+    }
+    return result;
+}
+
+static RTSPHTTPRouteResult RTSPHTTPRouteMatchNode(const RTSPHTTPRouteNode *node, RTSPHTTPMethod method,
+                                                  const char *p, const char *end, RTSPHTTPRouteMatch *match) {
+    while (p < end && *p == '/') {
+        p++;
+    }
+    if (p == end) {
+        RTSPHTTPRouteResult result = RTSPHTTPRouteResolve(node, method, match);
+        if (result == RTSPHTTPRouteNotFound && node->wildcard) {
+            result = RTSPHTTPRouteMatchWildcard(node->wildcard, method, p, end, match);
+        }
+        return result;
+    }
+
+    const char *segmentEnd = memchr(p, '/', (size_t)(end - p));
+    if (!segmentEnd) {
+        segmentEnd = end;
+    }
+    size_t length = (size_t)(segmentEnd - p);
+    RTSPHTTPRouteResult best = RTSPHTTPRouteNotFound;
+    uint32_t allowed = 0;
+
+    for (size_t i = 0; i < node->literalCount; i++) {
+        const RTSPHTTPRouteNode *child = node->literals[i];
+        if (child->length == length && memcmp(child->segment, p, length) == 0) {
+            RTSPHTTPRouteResult result = RTSPHTTPRouteMatchNode(child, method, segmentEnd, end, match);
+            if (result == RTSPHTTPRouteFound) {
+                return result;
+            }
+            if (result == RTSPHTTPRouteMethodNotAllowed && best == RTSPHTTPRouteNotFound) {
+                best = result;
+                allowed = match->allowedMethods;
+            }
+            break;
+        }
+    }
+
+    if (node->parameter && match->paramCount < RTSP_HTTP_MAX_PARAMS) {
+        match->params[match->paramCount++] = (RTSPHTTPRouteParam){node->parameter->segment, p, length};
+        RTSPHTTPRouteResult result = RTSPHTTPRouteMatchNode(node->parameter, method, segmentEnd, end, match);
+        if (result == RTSPHTTPRouteFound) {
+            return result;
+        }
+        match->paramCount--;
+        if (result == RTSPHTTPRouteMethodNotAllowed && best == RTSPHTTPRouteNotFound) {
+            best = result;
+            allowed = match->allowedMethods;
+        }
+    }
+
+    if (node->wildcard && match->paramCount < RTSP_HTTP_MAX_PARAMS) {
+        RTSPHTTPRouteResult result = RTSPHTTPRouteMatchWildcard(node->wildcard, method, p, end, match);
+        if (result == RTSPHTTPRouteFound) {
+            return result;
+        }
+        if (result == RTSPHTTPRouteMethodNotAllowed && best == RTSPHTTPRouteNotFound) {
+            best = result;
+            allowed = match->allowedMethods;
+        }
+    }
+
+    match->allowedMethods = allowed;
+    return best;
+}
+
+RTSPHTTPRouteResult RTSPHTTPRouterMatch(RTSPHTTPRouterRef router, RTSPHTTPMethod method,
+                                        const char *path, size_t length, RTSPHTTPRouteMatch *match) {
+    memset(match, 0, sizeof(*match));
+    if (!router || !path || method == 0) {
+        return RTSPHTTPRouteNotFound;
+    }
+    return RTSPHTTPRouteMatchNode(&router->root, method, path, path + length, match);
+}
@@ -0,0 +1,86 @@
+//
+//  RTSPHTTPRouter.h
+//  RTSP Rotator
+//
+//  Prefix trie over path segments for the embedded HTTP servers. Patterns
+//  are literal segments, ":name" parameters that capture one segment, and a
+//  trailing "*" that captures the rest of the path. Literal segments win
+//  over parameters, which win over wildcards; the router backtracks, so
+//  "/api/recording/status" and "/api/:anything/status" can coexist.
+//
+//  Routes are added up front; matching is read-only and may run on any
+//  number of threads at once.
+//
+
+#ifndef RTSPHTTPRouter_h
+#define RTSPHTTPRouter_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    RTSPHTTPMethodGET     = 1 << 0,
+    RTSPHTTPMethodHEAD    = 1 << 1,
+    RTSPHTTPMethodPOST    = 1 << 2,
+    RTSPHTTPMethodPUT     = 1 << 3,
+    RTSPHTTPMethodDELETE  = 1 << 4,
+    RTSPHTTPMethodOPTIONS = 1 << 5,
+    RTSPHTTPMethodPATCH   = 1 << 6,
+} RTSPHTTPMethod;
+
+#define RTSP_HTTP_METHOD_COUNT 7
+#define RTSP_HTTP_METHOD_ANY   ((1u << RTSP_HTTP_METHOD_COUNT) - 1)
+
+/// 0 for methods the router does not know
+RTSPHTTPMethod RTSPHTTPMethodFromString(const char *method, size_t length);
+
+/// "GET", "POST", ... for a single method bit
+const char *RTSPHTTPMethodName(RTSPHTTPMethod method);
+
+#define RTSP_HTTP_MAX_PARAMS 8
+
+/// A captured segment. Points into the matched path; not NUL terminated.
+typedef struct {
+    const char *name;               // Pattern name without the ':' ("*" for the wildcard)
+    const char *value;
+    size_t length;
+} RTSPHTTPRouteParam;
+
+typedef struct {
+    const void *target;
+    RTSPHTTPRouteParam params[RTSP_HTTP_MAX_PARAMS];
+    uint32_t paramCount;
+    uint32_t allowedMethods;        // Methods the matched path accepts (for 405 Allow)
+} RTSPHTTPRouteMatch;
+
+typedef enum {
+    RTSPHTTPRouteFound = 0,
+    RTSPHTTPRouteNotFound,
+    RTSPHTTPRouteMethodNotAllowed
+} RTSPHTTPRouteResult;
+
+typedef struct RTSPHTTPRouter *RTSPHTTPRouterRef;
+
+RTSPHTTPRouterRef RTSPHTTPRouterCreate(void);
+void RTSPHTTPRouterRelease(RTSPHTTPRouterRef router);
+
+/// Register `target` for every method in `methods`. Routes registered for
+/// GET also answer HEAD unless HEAD has its own target. Returns false for a
+/// malformed pattern or one that is already registered for a method.
+bool RTSPHTTPRouterAdd(RTSPHTTPRouterRef router, uint32_t methods, const char *pattern, const void *target);
+
+/// Match a request path (without the query string). Empty segments are
+/// ignored, so "/api/feeds/" matches "/api/feeds".
+RTSPHTTPRouteResult RTSPHTTPRouterMatch(RTSPHTTPRouterRef router, RTSPHTTPMethod method,
+                                        const char *path, size_t length, RTSPHTTPRouteMatch *match);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RTSPHTTPRouter_h */
@@ -0,0 +1,1909 @@
+//
+//  RTSPHTTPServer.c
+//  RTSP Rotator
+//
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE     // pthread_setname_np
+#endif
+
+#include "RTSPHTTPServer.h"
+#include "RTSPByteBuffer.h"
+#include "RTSPWebSocket.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__APPLE__) || defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__)
+#include <sys/event.h>
+#define RTSP_HTTP_USE_KQUEUE 1
+#elif defined(__linux__)
+#include <sys/epoll.h>
+#define RTSP_HTTP_USE_KQUEUE 0
+#else
+#error "RTSPHTTPServer needs kqueue or epoll"
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0  // Apple: SO_NOSIGPIPE is set per socket instead
+#endif
+
+#define RTSP_HTTP_READ_CHUNK 16384
+#define RTSP_HTTP_EVENT_BATCH 256
+#define RTSP_HTTP_SWEEP_INTERVAL 1.0
+#define RTSP_HTTP_RETAINED_BUFFER (256 * 1024)  // Larger per-connection buffers are freed after use
+#define RTSP_HTTP_STREAM_IOV 64                 // Queued messages written per sendmsg
+#define RTSP_HTTP_STREAM_SEND_BUFFER (128 * 1024)
+#define RTSP_HTTP_MAX_RETAINED 32               // Distinct retained events per channel
+#define RTSP_HTTP_EVENT_NAME_MAX 48
+#define RTSP_HTTP_PART_BOUNDARY "rtspframe"
+
+#pragma mark - Poller
+
+enum {
+    RTSPHTTPInterestRead = 1 << 0,
+    RTSPHTTPInterestWrite = 1 << 1,
+    RTSPHTTPInterestUnregistered = 1 << 7,
+};
+
+typedef struct {
+    void *udata;
+    bool readable;
+    bool writable;
+    bool failed;
+} RTSPHTTPEvent;
+
+static int RTSPHTTPPollerCreate(void) {
+#if RTSP_HTTP_USE_KQUEUE
+    int poller = kqueue();
+    if (poller >= 0) {
+        fcntl(poller, F_SETFD, FD_CLOEXEC);
+    }
+    return poller;
+#else
+    return epoll_create1(EPOLL_CLOEXEC);
+#endif
+}
+
+/// Level triggered. `previous` is RTSPHTTPInterestUnregistered for a new descriptor.
+static bool RTSPHTTPPollerUpdate(int poller, int fd, void *udata, uint32_t interest, uint32_t previous) {
+    if (interest == previous) {
+        return true;
+    }
+#if RTSP_HTTP_USE_KQUEUE
+    struct kevent changes[2];
+    int count = 0;
+    bool added = previous == RTSPHTTPInterestUnregistered;
+    if (added || (interest & RTSPHTTPInterestRead) != (previous & RTSPHTTPInterestRead)) {
+        EV_SET(&changes[count++], fd, EVFILT_READ,
+               EV_ADD | ((interest & RTSPHTTPInterestRead) ? EV_ENABLE : EV_DISABLE), 0, 0, udata);
+    }
+    if (added || (interest & RTSPHTTPInterestWrite) != (previous & RTSPHTTPInterestWrite)) {
+        EV_SET(&changes[count++], fd, EVFILT_WRITE,
+               EV_ADD | ((interest & RTSPHTTPInterestWrite) ? EV_ENABLE : EV_DISABLE), 0, 0, udata);
+    }
+    return kevent(poller, changes, count, NULL, 0, NULL) == 0;
+#else
+    struct epoll_event event = {
+        .events = ((interest & RTSPHTTPInterestRead) ? EPOLLIN : 0u) |
+                  ((interest & RTSPHTTPInterestWrite) ? EPOLLOUT : 0u),
+        .data.ptr = udata,
+    };
+    int operation = previous == RTSPHTTPInterestUnregistered ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+    return epoll_ctl(poller, operation, fd, &event) == 0;
+#endif
+}
+
+static int RTSPHTTPPollerWait(int poller, RTSPHTTPEvent *events, int timeoutMs) {
+#if RTSP_HTTP_USE_KQUEUE
+    struct kevent raw[RTSP_HTTP_EVENT_BATCH];
+    struct timespec timeout = {timeoutMs / 1000, (long)(timeoutMs % 1000) * 1000000L};
+    int count = kevent(poller, NULL, 0, raw, RTSP_HTTP_EVENT_BATCH, &timeout);
+    for (int i = 0; i < count; i++) {
+        events[i] = (RTSPHTTPEvent){
+            .udata = raw[i].udata,
+            .readable = raw[i].filter == EVFILT_READ,
+            .writable = raw[i].filter == EVFILT_WRITE,
+            .failed = (raw[i].flags & EV_ERROR) != 0,
+        };
+    }
+#else
+    struct epoll_event raw[RTSP_HTTP_EVENT_BATCH];
+    int count = epoll_wait(poller, raw, RTSP_HTTP_EVENT_BATCH, timeoutMs);
+    for (int i = 0; i < count; i++) {
+        events[i] = (RTSPHTTPEvent){
+            .udata = raw[i].data.ptr,
+            .readable = (raw[i].events & EPOLLIN) != 0,
+            .writable = (raw[i].events & EPOLLOUT) != 0,
+            .failed = (raw[i].events & (EPOLLERR | EPOLLHUP)) != 0,
+        };
+    }
+#endif
+    return count;
+}
+
+#pragma mark - Types
+
+typedef struct RTSPHTTPChannel RTSPHTTPChannel;
+
+typedef struct {
+    RTSPHTTPHandler handler;
+    void *context;
+} RTSPHTTPRoute;
+
+struct RTSPHTTPResponse {
+    int status;
+    char contentType[128];
+    RTSPByteBuffer headers;
+    RTSPByteBuffer body;
+
+    // Set by RTSPHTTPResponseSubscribe
+    RTSPHTTPChannel *channel;
+    bool webSocket;
+    char accept[RTSP_WEBSOCKET_ACCEPT_LENGTH + 1];
+    char *events;
+};
+
+typedef enum {
+    RTSPHTTPConnectionReading = 0,
+    RTSPHTTPConnectionDispatched,       // A worker owns the request and response
+    RTSPHTTPConnectionWriting,
+    RTSPHTTPConnectionStreaming         // Subscribed to a channel until either side closes
+} RTSPHTTPConnectionState;
+
+typedef enum {
+    RTSPHTTPParseNeedMore = 0,
+    RTSPHTTPParseComplete,
+    RTSPHTTPParseFailed                 // An error response has been started
+} RTSPHTTPParseResult;
+
+/// Encoded once per publish and shared by every subscriber queue
+typedef struct {
+    atomic_int references;
+    char event[RTSP_HTTP_EVENT_NAME_MAX];
+    uint8_t *record;                    // SSE record, or a multipart part
+    size_t recordLength;
+    uint8_t *frame;                     // WebSocket text frame; NULL for multipart
+    size_t frameLength;
+} RTSPHTTPMessage;
+
+typedef struct RTSPHTTPConnection RTSPHTTPConnection;
+
+typedef struct RTSPHTTPSubscriber {
+    RTSPHTTPChannel *channel;
+    RTSPHTTPConnection *connection;
+    bool webSocket;
+    char *events;                       // Comma-separated filter, or NULL for all
+
+    // Guarded by channel->lock
+    RTSPHTTPMessage **queue;            // Ring of maxQueuedMessages
+    uint32_t queueHead;
+    uint32_t queueCount;
+    size_t queuedBytes;
+    uint64_t delivered;                 // Not yet folded into the channel statistics
+    bool attached;
+    bool overflowed;
+    bool ready;
+    struct RTSPHTTPSubscriber *prev;
+    struct RTSPHTTPSubscriber *next;
+    struct RTSPHTTPSubscriber *readyNext;
+
+    // Loop thread only. The loop takes the whole queue once the previous
+    // batch is written, so a stalled socket lets the queue fill and overflow.
+    RTSPHTTPMessage **sending;
+    uint32_t sendingCount;
+    uint32_t sendingIndex;
+    size_t sendingOffset;               // Bytes of sending[sendingIndex] already written
+    RTSPByteBuffer control;             // Heartbeats and WebSocket control frames, sent between messages
+    size_t controlSent;
+    double lastWrite;
+    bool closing;                       // Close once the control frames are written
+} RTSPHTTPSubscriber;
+
+struct RTSPHTTPChannel {
+    RTSPHTTPServerRef server;
+    RTSPHTTPChannelConfig config;
+    pthread_mutex_t lock;               // Guards the fields below and every subscriber queue
+    uint64_t lastID;
+    RTSPHTTPSubscriber *subscribers;
+    RTSPHTTPSubscriber *ready;          // Subscribers with new messages (or overflowed) for the loop
+    RTSPHTTPMessage *retained[RTSP_HTTP_MAX_RETAINED];
+    uint32_t retainedCount;
+    RTSPHTTPChannelStatistics statistics;
+};
+
+struct RTSPHTTPConnection {
+    int fd;
+    RTSPHTTPConnectionState state;
+    uint32_t interest;
+    bool closed;                        // Socket closed; freed once no worker holds it
+    bool peerClosed;                    // Read side reached EOF
+    bool closeAfterResponse;
+    double lastActivity;
+
+    // Incremental parsing
+    RTSPByteBuffer input;
+    size_t scanned;                     // Input already searched for the end of the head
+    size_t headLength;                  // 0 until the head is complete
+    size_t bodyLength;
+
+    // Current request; owned by a worker while dispatched
+    RTSPByteBuffer storage;             // Head, NUL, body
+    RTSPHTTPRequest request;
+    RTSPHTTPRouteMatch match;
+    bool headOnly;
+    RTSPHTTPResponse response;
+
+    // Response in flight
+    RTSPByteBuffer head;
+    size_t headSent;
+    size_t bodySent;
+
+    RTSPHTTPSubscriber *subscriber;     // While streaming
+
+    RTSPHTTPConnection *prev;
+    RTSPHTTPConnection *next;
+    RTSPHTTPConnection *completedNext;
+    RTSPHTTPConnection *deadNext;
+};
+
+struct RTSPHTTPServer {
+    RTSPHTTPServerConfig config;
+    char bindAddress[INET_ADDRSTRLEN];
+    int listener;
+    int poller;
+    int wakeup[2];
+    uint16_t port;
+    RTSPHTTPRouterRef router;
+    RTSPHTTPRoute **routes;
+    size_t routeCount;
+    bool started;
+    pthread_t thread;
+    pthread_t *workers;
+    uint32_t workerCount;
+
+    pthread_mutex_t lock;               // Guards running, the work queue and statistics
+    pthread_cond_t workAvailable;
+    bool running;
+    RTSPHTTPConnection **queue;
+    uint32_t queueHead;
+    uint32_t queueCount;
+    RTSPHTTPServerStatistics statistics;
+
+    pthread_mutex_t completionLock;
+    RTSPHTTPConnection *completed;
+
+    RTSPHTTPChannel **channels;
+    size_t channelCount;
+
+    // Loop thread only
+    RTSPHTTPConnection *connections;
+    uint32_t connectionCount;
+    RTSPHTTPConnection *dead;
+    RTSPHTTPServerStatistics local;
+    double nextSweep;
+    double acceptResumeTime;            // Accepting pauses briefly when out of descriptors
+    RTSPHTTPConnection **readyConnections;
+    size_t readyCapacity;
+};
+
+static double RTSPHTTPNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+void RTSPHTTPServerConfigInit(RTSPHTTPServerConfig *config) {
+    config->bindAddress = "0.0.0.0";
+    config->port = 8080;
+    config->maxConnections = 4096;
+    config->workerCount = 4;
+    config->queueDepth = 1024;
+    config->maxRequestSize = 64 * 1024;
+    config->idleTimeout = 30.0;
+}
+
+static void RTSPHTTPServerWake(RTSPHTTPServerRef server) {
+    char byte = 1;
+    ssize_t result = write(server->wakeup[1], &byte, 1);
+    (void)result; // A full pipe already guarantees a wakeup
+}
+
+static void RTSPHTTPSetNonBlocking(int fd) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+}
+
+#pragma mark - Requests and Responses
+
+static bool RTSPHTTPHeaderValue(const char *headers, const char *name, char *value, size_t capacity) {
+    size_t nameLength = strlen(name);
+    for (const char *line = headers; *line; ) {
+        const char *end = strstr(line, "\r\n");
+        if (!end || end == line) {
+            break;
+        }
+        if ((size_t)(end - line) > nameLength && strncasecmp(line, name, nameLength) == 0 && line[nameLength] == ':') {
+            const char *start = line + nameLength + 1;
+            while (start < end && (*start == ' ' || *start == '\t')) {
+                start++;
+            }
+            size_t length = (size_t)(end - start);
+            while (length > 0 && (start[length - 1] == ' ' || start[length - 1] == '\t')) {
+                length--;
+            }
+            if (capacity > 0) {
+                if (length >= capacity) {
+                    length = capacity - 1;
+                }
+                memcpy(value, start, length);
+                value[length] = '\0';
+            }
+            return true;
+        }
+        line = end + 2;
+    }
+    return false;
+}
+
+static bool RTSPHTTPHeaderHasToken(const char *headers, const char *name, const char *token) {
+    char value[256];
+    if (!RTSPHTTPHeaderValue(headers, name, value, sizeof(value))) {
+        return false;
+    }
+    size_t tokenLength = strlen(token);
+    for (const char *p = value; *p; p++) {
+        if (strncasecmp(p, token, tokenLength) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool RTSPHTTPRequestHeader(const RTSPHTTPRequest *request, const char *name, char *value, size_t capacity) {
+    return request && name && RTSPHTTPHeaderValue(request->headers, name, value, capacity);
+}
+
+bool RTSPHTTPRequestParam(const RTSPHTTPRequest *request, const char *name, const char **value, size_t *length) {
+    for (uint32_t i = 0; request && name && i < request->paramCount; i++) {
+        if (strcmp(request->params[i].name, name) == 0) {
+            *value = request->params[i].value;
+            *length = request->params[i].length;
+            return true;
+        }
+    }
+    return false;
+}
+
+void RTSPHTTPResponseSetStatus(RTSPHTTPResponse *response, int status) {
+    response->status = status;
+}
+
+void RTSPHTTPResponseSetContentType(RTSPHTTPResponse *response, const char *contentType) {
+    snprintf(response->contentType, sizeof(response->contentType), "%s", contentType ? contentType : "");
+}
+
+void RTSPHTTPResponseAddHeader(RTSPHTTPResponse *response, const char *name, const char *value) {
+    if (!name || !value || strpbrk(name, "\r\n:") || strpbrk(value, "\r\n")) {
+        return; // Never let a handler split the response
+    }
+    RTSPByteBufferAppendFormat(&response->headers, "%s: %s\r\n", name, value);
+}
+
+void RTSPHTTPResponseAppendBody(RTSPHTTPResponse *response, const void *data, size_t length) {
+    RTSPByteBufferAppend(&response->body, data, length);
+}
+
+static void RTSPHTTPResponseReset(RTSPHTTPResponse *response) {
+    response->status = 200;
+    snprintf(response->contentType, sizeof(response->contentType), "text/plain; charset=utf-8");
+    RTSPByteBufferReset(&response->headers);
+    RTSPByteBufferReset(&response->body);
+    response->channel = NULL;
+    free(response->events);
+    response->events = NULL;
+}
+
+static const char *RTSPHTTPReason(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 201: return "Created";
+        case 204: return "No Content";
+        case 400: return "Bad Request";
+        case 401: return "Unauthorized";
+        case 403: return "Forbidden";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 408: return "Request Timeout";
+        case 413: return "Content Too Large";
+        case 429: return "Too Many Requests";
+        case 431: return "Request Header Fields Too Large";
+        case 500: return "Internal Server Error";
+        case 501: return "Not Implemented";
+        case 503: return "Service Unavailable";
+        case 505: return "HTTP Version Not Supported";
+        default: return status < 400 ? "OK" : "Error";
+    }
+}
+
+#pragma mark - Channels
+
+static bool RTSPHTTPEventNameValid(const char *event) {
+    size_t length = event ? strlen(event) : 0;
+    if (length == 0 || length >= RTSP_HTTP_EVENT_NAME_MAX) {
+        return false;
+    }
+    for (size_t i = 0; i < length; i++) {
+        char ch = event[i];
+        if (!((ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9') ||
+              ch == '.' || ch == '_' || ch == '-')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool RTSPHTTPEventSelected(const char *filter, const char *event) {
+    if (!filter) {
+        return true;
+    }
+    size_t length = strlen(event);
+    for (const char *p = filter; ; ) {
+        const char *end = strchr(p, ',');
+        size_t tokenLength = end ? (size_t)(end - p) : strlen(p);
+        if (tokenLength == length && memcmp(p, event, length) == 0) {
+            return true;
+        }
+        if (!end) {
+            return false;
+        }
+        p = end + 1;
+    }
+}
+
+static RTSPHTTPMessage *RTSPHTTPMessageCreate(uint64_t identifier, const char *event, const char *data, size_t length) {
+    RTSPHTTPMessage *message = calloc(1, sizeof(*message));
+    if (!message) {
+        return NULL;
+    }
+    atomic_init(&message->references, 1);
+    snprintf(message->event, sizeof(message->event), "%s", event);
+    if (length == 0) {
+        data = "null";
+        length = 4;
+    }
+
+    // SSE: one data line per line of the payload
+    RTSPByteBuffer record;
+    RTSPByteBufferInit(&record);
+    RTSPByteBufferAppendFormat(&record, "id: %llu\nevent: %s\n", (unsigned long long)identifier, event);
+    for (size_t start = 0; start < length; ) {
+        const char *newline = memchr(data + start, '\n', length - start);
+        size_t end = newline ? (size_t)(newline - data) : length;
+        size_t lineLength = end - start;
+        if (lineLength > 0 && data[start + lineLength - 1] == '\r') {
+            lineLength--;
+        }
+        RTSPByteBufferAppendString(&record, "data: ");
+        RTSPByteBufferAppend(&record, data + start, lineLength);
+        RTSPByteBufferAppendU8(&record, '\n');
+        start = end + 1;
+    }
+    RTSPByteBufferAppendU8(&record, '\n');
+
+    // WebSocket: the same message wrapped in an envelope
+    RTSPByteBuffer payload;
+    RTSPByteBuffer frame;
+    RTSPByteBufferInit(&payload);
+    RTSPByteBufferInit(&frame);
+    RTSPByteBufferAppendFormat(&payload, "{\"id\":%llu,\"event\":\"%s\",\"data\":", (unsigned long long)identifier, event);
+    RTSPByteBufferAppend(&payload, data, length);
+    RTSPByteBufferAppendU8(&payload, '}');
+    RTSPWebSocketAppendFrame(&frame, RTSPWebSocketOpcodeText, payload.data, payload.length);
+    bool failed = record.failed || payload.failed || frame.failed;
+    RTSPByteBufferFree(&payload);
+
+    message->record = RTSPByteBufferDetach(&record, &message->recordLength);
+    message->frame = RTSPByteBufferDetach(&frame, &message->frameLength);
+    if (failed || !message->record || !message->frame) {
+        free(message->record);
+        free(message->frame);
+        free(message);
+        return NULL;
+    }
+    return message;
+}
+
+static RTSPHTTPMessage *RTSPHTTPPartCreate(const char *event, const char *contentType, const void *data, size_t length) {
+    RTSPHTTPMessage *message = calloc(1, sizeof(*message));
+    if (!message) {
+        return NULL;
+    }
+    atomic_init(&message->references, 1);
+    snprintf(message->event, sizeof(message->event), "%s", event);
+
+    RTSPByteBuffer part;
+    RTSPByteBufferInit(&part);
+    RTSPByteBufferReserve(&part, length + 128);
+    RTSPByteBufferAppendFormat(&part, "--" RTSP_HTTP_PART_BOUNDARY "\r\nContent-Type: %s\r\nContent-Length: %zu\r\n\r\n",
+                               contentType, length);
+    RTSPByteBufferAppend(&part, data, length);
+    RTSPByteBufferAppendString(&part, "\r\n");
+    bool failed = part.failed;
+    message->record = RTSPByteBufferDetach(&part, &message->recordLength);
+    if (failed || !message->record) {
+        free(message->record);
+        free(message);
+        return NULL;
+    }
+    return message;
+}
+
+static RTSPHTTPMessage *RTSPHTTPMessageRetain(RTSPHTTPMessage *message) {
+    atomic_fetch_add_explicit(&message->references, 1, memory_order_relaxed);
+    return message;
+}
+
+static void RTSPHTTPMessageRelease(RTSPHTTPMessage *message) {
+    if (message && atomic_fetch_sub_explicit(&message->references, 1, memory_order_acq_rel) == 1) {
+        free(message->record);
+        free(message->frame);
+        free(message);
+    }
+}
+
+static size_t RTSPHTTPMessageLength(const RTSPHTTPMessage *message, bool webSocket) {
+    return webSocket ? message->frameLength : message->recordLength;
+}
+
+/// Channel lock held. Sets *wake when the loop has to be woken up.
+static void RTSPHTTPSubscriberEnqueue(RTSPHTTPChannel *channel, RTSPHTTPSubscriber *subscriber,
+                                      RTSPHTTPMessage *message, bool *wake) {
+    if (subscriber->overflowed || !RTSPHTTPEventSelected(subscriber->events, message->event)) {
+        return;
+    }
+    uint32_t capacity = channel->config.maxQueuedMessages;
+    size_t length = RTSPHTTPMessageLength(message, subscriber->webSocket);
+    while (channel->config.skipWhenFull && subscriber->queueCount > 0 &&
+           (subscriber->queueCount == capacity ||
+            subscriber->queuedBytes + length > channel->config.maxQueuedBytes)) {
+        // Only the newest messages matter (video); the batch being written is left alone
+        RTSPHTTPMessage *oldest = subscriber->queue[subscriber->queueHead];
+        subscriber->queuedBytes -= RTSPHTTPMessageLength(oldest, subscriber->webSocket);
+        subscriber->queueHead = (subscriber->queueHead + 1) % capacity;
+        subscriber->queueCount--;
+        channel->statistics.skipped++;
+        RTSPHTTPMessageRelease(oldest);
+    }
+    if (subscriber->queueCount == capacity ||
+        (subscriber->queueCount > 0 && subscriber->queuedBytes + length > channel->config.maxQueuedBytes)) {
+        subscriber->overflowed = true; // The loop disconnects it
+    } else {
+        subscriber->queue[(subscriber->queueHead + subscriber->queueCount) % capacity] = RTSPHTTPMessageRetain(message);
+        subscriber->queueCount++;
+        subscriber->queuedBytes += length;
+    }
+    if (!subscriber->ready) {
+        *wake = *wake || channel->ready == NULL;
+        subscriber->ready = true;
+        subscriber->readyNext = channel->ready;
+        channel->ready = subscriber;
+    }
+}
+
+static void RTSPHTTPSubscriberAttach(RTSPHTTPChannel *channel, RTSPHTTPSubscriber *subscriber) {
+    bool wake = false;
+    pthread_mutex_lock(&channel->lock);
+    subscriber->attached = true;
+    subscriber->next = channel->subscribers;
+    if (subscriber->next) {
+        subscriber->next->prev = subscriber;
+    }
+    channel->subscribers = subscriber;
+    channel->statistics.subscribers++;
+    if (subscriber->webSocket) {
+        channel->statistics.webSocketSubscribers++;
+    }
+    for (uint32_t i = 0; i < channel->retainedCount; i++) {
+        RTSPHTTPSubscriberEnqueue(channel, subscriber, channel->retained[i], &wake); // Loop thread; no wakeup needed
+    }
+    pthread_mutex_unlock(&channel->lock);
+}
+
+static void RTSPHTTPSubscriberDetach(RTSPHTTPSubscriber *subscriber) {
+    RTSPHTTPChannel *channel = subscriber->channel;
+    pthread_mutex_lock(&channel->lock);
+    if (subscriber->attached) {
+        if (subscriber->prev) {
+            subscriber->prev->next = subscriber->next;
+        } else {
+            channel->subscribers = subscriber->next;
+        }
+        if (subscriber->next) {
+            subscriber->next->prev = subscriber->prev;
+        }
+        for (RTSPHTTPSubscriber **link = &channel->ready; subscriber->ready && *link; link = &(*link)->readyNext) {
+            if (*link == subscriber) {
+                *link = subscriber->readyNext;
+                subscriber->ready = false;
+                break;
+            }
+        }
+        for (uint32_t i = 0; i < subscriber->queueCount; i++) {
+            RTSPHTTPMessageRelease(subscriber->queue[(subscriber->queueHead + i) % channel->config.maxQueuedMessages]);
+        }
+        subscriber->queueCount = 0;
+        channel->statistics.delivered += subscriber->delivered;
+        subscriber->delivered = 0;
+        channel->statistics.subscribers--;
+        if (subscriber->webSocket) {
+            channel->statistics.webSocketSubscribers--;
+        }
+        subscriber->attached = false;
+    }
+    pthread_mutex_unlock(&channel->lock);
+}
+
+static void RTSPHTTPSubscriberFree(RTSPHTTPSubscriber *subscriber) {
+    RTSPHTTPSubscriberDetach(subscriber);
+    for (uint32_t i = subscriber->sendingIndex; i < subscriber->sendingCount; i++) {
+        RTSPHTTPMessageRelease(subscriber->sending[i]);
+    }
+    RTSPByteBufferFree(&subscriber->control);
+    free(subscriber->queue);
+    free(subscriber->sending);
+    free(subscriber->events);
+    free(subscriber);
+}
+
+static bool RTSPHTTPStreamPending(const RTSPHTTPConnection *c) {
+    const RTSPHTTPSubscriber *subscriber = c->subscriber;
+    return c->headSent < c->head.length || subscriber->controlSent < subscriber->control.length ||
+           subscriber->sendingIndex < subscriber->sendingCount;
+}
+
+#pragma mark - Connections
+
+static void RTSPHTTPUpdateInterest(RTSPHTTPServerRef server, RTSPHTTPConnection *c) {
+    uint32_t interest = 0;
+    if (c->state == RTSPHTTPConnectionWriting) {
+        interest = RTSPHTTPInterestWrite;
+    } else if (c->state == RTSPHTTPConnectionStreaming) {
+        interest = (c->peerClosed ? 0 : RTSPHTTPInterestRead) | (RTSPHTTPStreamPending(c) ? RTSPHTTPInterestWrite : 0);
+    } else if (!c->peerClosed && c->input.length < 2 * server->config.maxRequestSize) {
+        interest = RTSPHTTPInterestRead; // Keep reading pipelined requests, within reason
+    }
+    if (RTSPHTTPPollerUpdate(server->poller, c->fd, c, interest, c->interest)) {
+        c->interest = interest;
+    }
+}
+
+static void RTSPHTTPConnectionFree(RTSPHTTPConnection *c) {
+    if (c->subscriber) {
+        RTSPHTTPSubscriberFree(c->subscriber);
+    }
+    free(c->response.events);
+    RTSPByteBufferFree(&c->input);
+    RTSPByteBufferFree(&c->storage);
+    RTSPByteBufferFree(&c->response.headers);
+    RTSPByteBufferFree(&c->response.body);
+    RTSPByteBufferFree(&c->head);
+    free(c);
+}
+
+static void RTSPHTTPConnectionClose(RTSPHTTPServerRef server, RTSPHTTPConnection *c) {
+    if (c->closed) {
+        return;
+    }
+    close(c->fd); // Also removes it from the poller
+    c->closed = true;
+    if (c->subscriber) {
+        RTSPHTTPSubscriberDetach(c->subscriber); // Publishers stop queueing for it right away
+    }
+    if (c->prev) {
+        c->prev->next = c->next;
+    } else {
+        server->connections = c->next;
+    }
+    if (c->next) {
+        c->next->prev = c->prev;
+    }
+    server->connectionCount--;
+    if (c->state != RTSPHTTPConnectionDispatched) {
+        c->deadNext = server->dead; // Freed after this batch of events
+        server->dead = c;
+    }
+}
+
+/// Formats the head for c->response and starts writing it
+static void RTSPHTTPBeginResponse(RTSPHTTPConnection *c) {
+    RTSPHTTPResponse *response = &c->response;
+    RTSPByteBufferReset(&c->head);
+    RTSPByteBufferAppendFormat(&c->head,
+                               "HTTP/1.1 %d %s\r\n"
+                               "Content-Type: %s\r\n"
+                               "Content-Length: %zu\r\n"
+                               "Connection: %s\r\n",
+                               response->status, RTSPHTTPReason(response->status),
+                               response->contentType, response->body.length,
+                               c->closeAfterResponse ? "close" : "keep-alive");
+    RTSPByteBufferAppend(&c->head, response->headers.data, response->headers.length);
+    RTSPByteBufferAppendString(&c->head, "\r\n");
+    c->headSent = 0;
+    c->bodySent = c->headOnly ? response->body.length : 0;
+    c->state = RTSPHTTPConnectionWriting;
+}
+
+/// Fills c->response with a plain-text error; headers may still be added
+static void RTSPHTTPPrepareError(RTSPHTTPConnection *c, int status, bool close) {
+    RTSPHTTPResponseReset(&c->response);
+    c->response.status = status;
+    RTSPByteBufferAppendFormat(&c->response.body, "%d %s\n", status, RTSPHTTPReason(status));
+    c->closeAfterResponse = c->closeAfterResponse || close;
+}
+
+static void RTSPHTTPRespondError(RTSPHTTPConnection *c, int status, bool close) {
+    RTSPHTTPPrepareError(c, status, close);
+    RTSPHTTPBeginResponse(c);
+}
+
+/// Returns false when the connection should be closed
+static bool RTSPHTTPFlush(RTSPHTTPServerRef server, RTSPHTTPConnection *c, double now) {
+    while (c->state == RTSPHTTPConnectionWriting) {
+        struct iovec iov[2];
+        int count = 0;
+        if (c->headSent < c->head.length) {
+            iov[count++] = (struct iovec){c->head.data + c->headSent, c->head.length - c->headSent};
+        }
+        if (c->bodySent < c->response.body.length) {
+            iov[count++] = (struct iovec){c->response.body.data + c->bodySent, c->response.body.length - c->bodySent};
+        }
+        if (count == 0) {
+            c->state = RTSPHTTPConnectionReading;
+            if (c->response.body.capacity > RTSP_HTTP_RETAINED_BUFFER) {
+                RTSPByteBufferFree(&c->response.body);
+            }
+            return !c->closeAfterResponse;
+        }
+        struct msghdr message = {.msg_iov = iov, .msg_iovlen = count};
+        ssize_t sent = sendmsg(c->fd, &message, MSG_NOSIGNAL);
+        if (sent < 0) {
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        }
+        server->local.bytesSent += (uint64_t)sent;
+        c->lastActivity = now;
+        size_t headLeft = c->head.length - c->headSent;
+        size_t headPart = (size_t)sent < headLeft ? (size_t)sent : headLeft;
+        c->headSent += headPart;
+        c->bodySent += (size_t)sent - headPart;
+        if ((size_t)sent < iov[0].iov_len + (count > 1 ? iov[1].iov_len : 0)) {
+            return true; // Socket buffer full; wait for writability
+        }
+    }
+    return true;
+}
+
+/// Returns false when the connection should be closed
+static bool RTSPHTTPRead(RTSPHTTPServerRef server, RTSPHTTPConnection *c, double now) {
+    size_t limit = 2 * server->config.maxRequestSize;
+    while (c->input.length < limit) {
+        if (!RTSPByteBufferReserve(&c->input, RTSP_HTTP_READ_CHUNK)) {
+            return false;
+        }
+        ssize_t count = recv(c->fd, c->input.data + c->input.length, RTSP_HTTP_READ_CHUNK, 0);
+        if (count > 0) {
+            c->input.length += (size_t)count;
+            c->lastActivity = now;
+            if ((size_t)count < RTSP_HTTP_READ_CHUNK) {
+                return true; // Drained
+            }
+            continue;
+        }
+        if (count == 0) {
+            c->peerClosed = true;
+            // Answer what was already received unless the client is gone entirely
+            return c->input.length > 0 || c->state != RTSPHTTPConnectionReading;
+        }
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    }
+    return true;
+}
+
+#pragma mark - Parsing
+
+/// Finds the next complete request in c->input and moves it into c->storage
+static RTSPHTTPParseResult RTSPHTTPParse(RTSPHTTPServerRef server, RTSPHTTPConnection *c) {
+    size_t maxRequest = server->config.maxRequestSize;
+    if (c->headLength == 0) {
+        size_t start = c->scanned > 3 ? c->scanned - 3 : 0;
+        size_t end = 0;
+        for (size_t i = start; i + 3 < c->input.length; i++) {
+            if (c->input.data[i + 3] == '\n' && memcmp(c->input.data + i, "\r\n\r\n", 4) == 0) {
+                end = i + 4;
+                break;
+            }
+        }
+        if (end == 0) {
+            c->scanned = c->input.length;
+            if (c->input.length > maxRequest) {
+                RTSPHTTPRespondError(c, 431, true);
+                return RTSPHTTPParseFailed;
+            }
+            return RTSPHTTPParseNeedMore;
+        }
+        if (end > maxRequest) {
+            RTSPHTTPRespondError(c, 431, true);
+            return RTSPHTTPParseFailed;
+        }
+        if (memchr(c->input.data, '\0', end)) {
+            RTSPHTTPRespondError(c, 400, true); // The head is handled as a C string from here on
+            return RTSPHTTPParseFailed;
+        }
+
+        RTSPByteBufferReset(&c->storage);
+        RTSPByteBufferAppend(&c->storage, c->input.data, end);
+        RTSPByteBufferAppendU8(&c->storage, 0);
+        if (c->storage.failed) {
+            RTSPHTTPRespondError(c, 500, true);
+            return RTSPHTTPParseFailed;
+        }
+        const char *head = (const char *)c->storage.data;
+        char value[32];
+        c->bodyLength = 0;
+        if (RTSPHTTPHeaderHasToken(head, "Transfer-Encoding", "chunked")) {
+            RTSPHTTPRespondError(c, 501, true);
+            return RTSPHTTPParseFailed;
+        }
+        if (RTSPHTTPHeaderValue(head, "Content-Length", value, sizeof(value))) {
+            char *valueEnd = NULL;
+            unsigned long long length = strtoull(value, &valueEnd, 10);
+            if (valueEnd == value || *valueEnd != '\0' || value[0] == '-') {
+                RTSPHTTPRespondError(c, 400, true);
+                return RTSPHTTPParseFailed;
+            }
+            if (length > maxRequest - end) {
+                RTSPHTTPRespondError(c, 413, true);
+                return RTSPHTTPParseFailed;
+            }
+            c->bodyLength = (size_t)length;
+        }
+        c->headLength = end;
+    }
+
+    if (c->input.length < c->headLength + c->bodyLength) {
+        return RTSPHTTPParseNeedMore;
+    }
+    RTSPByteBufferAppend(&c->storage, c->input.data + c->headLength, c->bodyLength);
+    if (c->storage.failed) {
+        RTSPHTTPRespondError(c, 500, true);
+        return RTSPHTTPParseFailed;
+    }
+    RTSPByteBufferConsume(&c->input, c->headLength + c->bodyLength);
+    c->scanned = 0;
+    c->headLength = 0;
+    return RTSPHTTPParseComplete;
+}
+
+/// Tokenizes the request in c->storage, routes it and queues it for a worker
+static void RTSPHTTPDispatch(RTSPHTTPServerRef server, RTSPHTTPConnection *c) {
+    server->local.requests++;
+    char *request = (char *)c->storage.data;
+    size_t headLength = strlen(request);
+
+    char *lineEnd = strstr(request, "\r\n");
+    *lineEnd = '\0';
+    char *method = request;
+    char *target = strchr(method, ' ');
+    char *version = target ? strchr(target + 1, ' ') : NULL;
+    if (!target || !version || strncmp(version + 1, "HTTP/1.", 7) != 0 || target[1] != '/') {
+        RTSPHTTPRespondError(c, 400, true);
+        return;
+    }
+    *target++ = '\0';
+    *version++ = '\0';
+    const char *headers = lineEnd + 2;
+
+    bool http10 = strcmp(version, "HTTP/1.0") == 0;
+    if (http10 ? !RTSPHTTPHeaderHasToken(headers, "Connection", "keep-alive")
+               : RTSPHTTPHeaderHasToken(headers, "Connection", "close")) {
+        c->closeAfterResponse = true;
+    }
+
+    RTSPHTTPMethod httpMethod = RTSPHTTPMethodFromString(method, strlen(method));
+    if (httpMethod == 0) {
+        RTSPHTTPRespondError(c, 501, false);
+        return;
+    }
+    c->headOnly = httpMethod == RTSPHTTPMethodHEAD;
+
+    char *query = strchr(target, '?');
+    if (query) {
+        *query++ = '\0';
+    }
+    switch (RTSPHTTPRouterMatch(server->router, httpMethod, target, strlen(target), &c->match)) {
+        case RTSPHTTPRouteFound:
+            break;
+        case RTSPHTTPRouteMethodNotAllowed: {
+            RTSPHTTPPrepareError(c, 405, false);
+            char allow[64] = "";
+            for (int i = 0; i < RTSP_HTTP_METHOD_COUNT; i++) {
+                if (c->match.allowedMethods & (1u << i)) {
+                    size_t used = strlen(allow);
+                    snprintf(allow + used, sizeof(allow) - used, "%s%s", used ? ", " : "",
+                             RTSPHTTPMethodName((RTSPHTTPMethod)(1u << i)));
+                }
+            }
+            RTSPHTTPResponseAddHeader(&c->response, "Allow", allow);
+            RTSPHTTPBeginResponse(c);
+            return;
+        }
+        case RTSPHTTPRouteNotFound:
+        default:
+            RTSPHTTPRespondError(c, 404, false);
+            return;
+    }
+
+    c->request = (RTSPHTTPRequest){
+        .method = httpMethod,
+        .path = target,
+        .query = query,
+        .headers = headers,
+        .body = c->storage.data + headLength + 1,
+        .bodyLength = c->storage.length - headLength - 1,
+        .params = c->match.params,
+        .paramCount = c->match.paramCount,
+    };
+
+    pthread_mutex_lock(&server->lock);
+    bool queued = server->queueCount < server->config.queueDepth;
+    if (queued) {
+        server->queue[(server->queueHead + server->queueCount) % server->config.queueDepth] = c;
+        server->queueCount++;
+        if (server->queueCount > server->local.queueHighWater) {
+            server->local.queueHighWater = server->queueCount;
+        }
+        c->state = RTSPHTTPConnectionDispatched;
+        pthread_cond_signal(&server->workAvailable);
+    }
+    pthread_mutex_unlock(&server->lock);
+
+    if (!queued) {
+        server->local.rejectedRequests++;
+        RTSPHTTPPrepareError(c, 503, false);
+        RTSPHTTPResponseAddHeader(&c->response, "Retry-After", "1");
+        RTSPHTTPBeginResponse(c);
+    }
+}
+
+#pragma mark - Streaming
+
+/// Turns a completed subscription into a streaming connection
+static bool RTSPHTTPBeginStream(RTSPHTTPConnection *c, double now) {
+    RTSPHTTPResponse *response = &c->response;
+    RTSPHTTPChannel *channel = response->channel;
+    RTSPHTTPSubscriber *subscriber = calloc(1, sizeof(*subscriber));
+    if (!subscriber) {
+        return false;
+    }
+    subscriber->queue = calloc(channel->config.maxQueuedMessages, sizeof(*subscriber->queue));
+    subscriber->sending = calloc(channel->config.maxQueuedMessages, sizeof(*subscriber->sending));
+    if (!subscriber->queue || !subscriber->sending) {
+        free(subscriber->queue);
+        free(subscriber->sending);
+        free(subscriber);
+        return false;
+    }
+    subscriber->channel = channel;
+    subscriber->connection = c;
+    subscriber->webSocket = response->webSocket;
+    subscriber->events = response->events;
+    subscriber->lastWrite = now;
+    response->events = NULL;
+    RTSPByteBufferInit(&subscriber->control);
+
+    RTSPByteBufferReset(&c->head);
+    if (channel->config.format == RTSPHTTPChannelFormatMultipart) {
+        RTSPByteBufferAppendString(&c->head,
+                                   "HTTP/1.1 200 OK\r\n"
+                                   "Content-Type: multipart/x-mixed-replace; boundary=" RTSP_HTTP_PART_BOUNDARY "\r\n"
+                                   "Cache-Control: no-cache, no-store\r\n"
+                                   "Pragma: no-cache\r\n"
+                                   "Connection: close\r\n");
+        RTSPByteBufferReset(&c->input);
+    } else if (subscriber->webSocket) {
+        RTSPByteBufferAppendFormat(&c->head,
+                                   "HTTP/1.1 101 Switching Protocols\r\n"
+                                   "Upgrade: websocket\r\n"
+                                   "Connection: Upgrade\r\n"
+                                   "Sec-WebSocket-Accept: %s\r\n",
+                                   response->accept);
+    } else {
+        RTSPByteBufferAppendString(&c->head,
+                                   "HTTP/1.1 200 OK\r\n"
+                                   "Content-Type: text/event-stream\r\n"
+                                   "Cache-Control: no-cache\r\n"
+                                   "Connection: keep-alive\r\n");
+        RTSPByteBufferReset(&c->input); // Nothing an SSE client sends from here on matters
+    }
+    RTSPByteBufferAppend(&c->head, response->headers.data, response->headers.length);
+    RTSPByteBufferAppendString(&c->head, "\r\n");
+    c->headSent = 0;
+    RTSPByteBufferFree(&response->body);
+
+    // Keep the kernel from hiding a stalled reader behind megabytes of
+    // autotuned buffer; the subscriber queue is the backlog that counts
+    int sendBuffer = RTSP_HTTP_STREAM_SEND_BUFFER;
+    setsockopt(c->fd, SOL_SOCKET, SO_SNDBUF, &sendBuffer, sizeof(sendBuffer));
+
+    c->subscriber = subscriber;
+    c->state = RTSPHTTPConnectionStreaming;
+    RTSPHTTPSubscriberAttach(channel, subscriber);
+    return true;
+}
+
+/// Stop sending messages; anything but a half-written one is dropped
+static void RTSPHTTPStreamStop(RTSPHTTPSubscriber *subscriber) {
+    uint32_t keep = subscriber->sendingOffset > 0 ? subscriber->sendingIndex + 1 : subscriber->sendingIndex;
+    for (uint32_t i = keep; i < subscriber->sendingCount; i++) {
+        RTSPHTTPMessageRelease(subscriber->sending[i]);
+    }
+    subscriber->sendingCount = keep;
+    subscriber->closing = true;
+}
+
+/// Answers pings and the closing handshake. Returns false on a protocol error.
+static bool RTSPHTTPWebSocketRead(RTSPHTTPServerRef server, RTSPHTTPConnection *c) {
+    RTSPHTTPSubscriber *subscriber = c->subscriber;
+    size_t offset = 0;
+    bool valid = true;
+    while (!subscriber->closing && offset < c->input.length) {
+        RTSPWebSocketFrame frame;
+        RTSPWebSocketParseResult result = RTSPWebSocketParseFrame(c->input.data + offset, c->input.length - offset,
+                                                                  server->config.maxRequestSize, &frame);
+        if (result == RTSPWebSocketParseNeedMore) {
+            break;
+        }
+        if (result == RTSPWebSocketParseInvalid) {
+            valid = false;
+            break;
+        }
+        offset += frame.frameLength;
+        if (frame.opcode == RTSPWebSocketOpcodePing && subscriber->control.length < 4096) {
+            RTSPWebSocketAppendFrame(&subscriber->control, RTSPWebSocketOpcodePong, frame.payload, frame.payloadLength);
+        } else if (frame.opcode == RTSPWebSocketOpcodeClose) {
+            // Echo the status code and hang up once it is written
+            RTSPWebSocketAppendFrame(&subscriber->control, RTSPWebSocketOpcodeClose, frame.payload,
+                                     frame.payloadLength >= 2 ? 2 : 0);
+            RTSPHTTPStreamStop(subscriber);
+        }
+        // Data frames are ignored; the channel only flows to the client
+    }
+    RTSPByteBufferConsume(&c->input, offset);
+    return valid;
+}
+
+/// Moves newly queued messages to the sending batch once the previous batch
+/// is written. Returns false when the subscriber overflowed and must go.
+static bool RTSPHTTPStreamRefill(RTSPHTTPSubscriber *subscriber) {
+    RTSPHTTPChannel *channel = subscriber->channel;
+    pthread_mutex_lock(&channel->lock);
+    bool overflowed = subscriber->overflowed;
+    if (overflowed) {
+        channel->statistics.droppedSubscribers++;
+    } else if (!subscriber->closing && subscriber->sendingCount == 0) {
+        uint32_t capacity = channel->config.maxQueuedMessages;
+        for (uint32_t i = 0; i < subscriber->queueCount; i++) {
+            subscriber->sending[i] = subscriber->queue[(subscriber->queueHead + i) % capacity];
+        }
+        subscriber->sendingCount = subscriber->queueCount;
+        subscriber->queueHead = 0;
+        subscriber->queueCount = 0;
+        subscriber->queuedBytes = 0;
+    }
+    channel->statistics.delivered += subscriber->delivered;
+    subscriber->delivered = 0;
+    pthread_mutex_unlock(&channel->lock);
+    return !overflowed;
+}
+
+/// Writes the stream head, control frames and queued messages. Returns false
+/// when the connection should be closed.
+static bool RTSPHTTPStreamFlush(RTSPHTTPServerRef server, RTSPHTTPConnection *c, double now) {
+    RTSPHTTPSubscriber *subscriber = c->subscriber;
+    for (;;) {
+        if (!RTSPHTTPStreamRefill(subscriber)) {
+            return false;
+        }
+
+        struct iovec iov[RTSP_HTTP_STREAM_IOV + 2];
+        int count = 0;
+        size_t total = 0;
+        if (c->headSent < c->head.length) {
+            iov[count++] = (struct iovec){c->head.data + c->headSent, c->head.length - c->headSent};
+        }
+        // Control frames never land inside a half-written message
+        bool control = subscriber->sendingOffset == 0 && subscriber->controlSent < subscriber->control.length;
+        if (control) {
+            iov[count++] = (struct iovec){subscriber->control.data + subscriber->controlSent,
+                                          subscriber->control.length - subscriber->controlSent};
+        }
+        for (uint32_t i = subscriber->sendingIndex; i < subscriber->sendingCount && i - subscriber->sendingIndex < RTSP_HTTP_STREAM_IOV; i++) {
+            RTSPHTTPMessage *message = subscriber->sending[i];
+            uint8_t *bytes = subscriber->webSocket ? message->frame : message->record;
+            size_t skip = i == subscriber->sendingIndex ? subscriber->sendingOffset : 0;
+            iov[count++] = (struct iovec){bytes + skip, RTSPHTTPMessageLength(message, subscriber->webSocket) - skip};
+        }
+        if (count == 0) {
+            return !subscriber->closing;
+        }
+        for (int i = 0; i < count; i++) {
+            total += iov[i].iov_len;
+        }
+
+        struct msghdr header = {.msg_iov = iov, .msg_iovlen = count};
+        ssize_t sent = sendmsg(c->fd, &header, MSG_NOSIGNAL);
+        if (sent < 0) {
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        }
+        server->local.bytesSent += (uint64_t)sent;
+        c->lastActivity = now;
+        subscriber->lastWrite = now;
+
+        size_t remaining = (size_t)sent;
+        size_t part = c->head.length - c->headSent;
+        part = remaining < part ? remaining : part;
+        c->headSent += part;
+        remaining -= part;
+        if (control) {
+            part = subscriber->control.length - subscriber->controlSent;
+            part = remaining < part ? remaining : part;
+            subscriber->controlSent += part;
+            remaining -= part;
+            if (subscriber->controlSent == subscriber->control.length) {
+                RTSPByteBufferReset(&subscriber->control);
+                subscriber->controlSent = 0;
+            }
+        }
+        while (remaining > 0) {
+            RTSPHTTPMessage *message = subscriber->sending[subscriber->sendingIndex];
+            size_t left = RTSPHTTPMessageLength(message, subscriber->webSocket) - subscriber->sendingOffset;
+            if (remaining < left) {
+                subscriber->sendingOffset += remaining;
+                break;
+            }
+            remaining -= left;
+            RTSPHTTPMessageRelease(message);
+            subscriber->sendingIndex++;
+            subscriber->sendingOffset = 0;
+            subscriber->delivered++;
+        }
+        if (subscriber->sendingIndex == subscriber->sendingCount) {
+            subscriber->sendingIndex = 0;
+            subscriber->sendingCount = 0;
+        }
+        if ((size_t)sent < total) {
+            return true; // Socket buffer full; wait for writability
+        }
+    }
+}
+
+/// Returns false when the connection should be closed
+static bool RTSPHTTPStreamAdvance(RTSPHTTPServerRef server, RTSPHTTPConnection *c, double now) {
+    if (c->peerClosed) {
+        return false;
+    }
+    if (c->subscriber->webSocket) {
+        if (!RTSPHTTPWebSocketRead(server, c)) {
+            return false;
+        }
+    } else {
+        RTSPByteBufferReset(&c->input);
+    }
+    return RTSPHTTPStreamFlush(server, c, now);
+}
+
+/// Drives a connection as far as it can go without blocking
+static void RTSPHTTPAdvance(RTSPHTTPServerRef server, RTSPHTTPConnection *c, double now) {
+    while (!c->closed) {
+        if (c->state == RTSPHTTPConnectionWriting) {
+            if (!RTSPHTTPFlush(server, c, now)) {
+                RTSPHTTPConnectionClose(server, c);
+                return;
+            }
+            if (c->state == RTSPHTTPConnectionWriting) {
+                break; // Wait for writability
+            }
+            continue;
+        }
+        if (c->state == RTSPHTTPConnectionStreaming) {
+            if (!RTSPHTTPStreamAdvance(server, c, now)) {
+                RTSPHTTPConnectionClose(server, c);
+                return;
+            }
+            break;
+        }
+        if (c->state == RTSPHTTPConnectionDispatched) {
+            break;
+        }
+        switch (RTSPHTTPParse(server, c)) {
+            case RTSPHTTPParseComplete:
+                RTSPHTTPDispatch(server, c);
+                continue;
+            case RTSPHTTPParseFailed:
+                continue;
+            case RTSPHTTPParseNeedMore:
+            default:
+                if (c->peerClosed) {
+                    RTSPHTTPConnectionClose(server, c);
+                    return;
+                }
+                break;
+        }
+        break;
+    }
+    if (!c->closed) {
+        RTSPHTTPUpdateInterest(server, c);
+    }
+}
+
+static void RTSPHTTPAccept(RTSPHTTPServerRef server, double now) {
+    for (;;) {
+        int fd = accept(server->listener, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+                // Leave the backlog alone for a moment instead of spinning on it
+                server->acceptResumeTime = now + 0.1;
+                RTSPHTTPPollerUpdate(server->poller, server->listener, &server->listener, 0, RTSPHTTPInterestRead);
+            }
+            return;
+        }
+        if (server->connectionCount >= server->config.maxConnections) {
+            close(fd);
+            continue;
+        }
+        RTSPHTTPConnection *c = calloc(1, sizeof(*c));
+        if (!c) {
+            close(fd);
+            continue;
+        }
+        RTSPHTTPSetNonBlocking(fd);
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+#ifdef SO_NOSIGPIPE
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+        c->fd = fd;
+        c->lastActivity = now;
+        c->interest = RTSPHTTPInterestUnregistered;
+        RTSPByteBufferInit(&c->input);
+        RTSPByteBufferInit(&c->storage);
+        RTSPByteBufferInit(&c->response.headers);
+        RTSPByteBufferInit(&c->response.body);
+        RTSPByteBufferInit(&c->head);
+        if (!RTSPHTTPPollerUpdate(server->poller, fd, c, RTSPHTTPInterestRead, RTSPHTTPInterestUnregistered)) {
+            close(fd);
+            free(c);
+            continue;
+        }
+        c->interest = RTSPHTTPInterestRead;
+        c->next = server->connections;
+        if (c->next) {
+            c->next->prev = c;
+        }
+        server->connections = c;
+        server->connectionCount++;
+    }
+}
+
+#pragma mark - Threads
+
+static void *RTSPHTTPWorkerThread(void *argument) {
+    RTSPHTTPServerRef server = argument;
+#if defined(__APPLE__)
+    pthread_setname_np("com.rtsp.http-worker");
+#elif defined(__linux__)
+    pthread_setname_np(pthread_self(), "rtsp-http-work");
+#endif
+
+    for (;;) {
+        pthread_mutex_lock(&server->lock);
+        while (server->running && server->queueCount == 0) {
+            pthread_cond_wait(&server->workAvailable, &server->lock);
+        }
+        if (!server->running) {
+            pthread_mutex_unlock(&server->lock);
+            break;
+        }
+        RTSPHTTPConnection *c = server->queue[server->queueHead];
+        server->queueHead = (server->queueHead + 1) % server->config.queueDepth;
+        server->queueCount--;
+        pthread_mutex_unlock(&server->lock);
+
+        // Runs even if the client has gone; the loop frees the connection afterwards
+        RTSPHTTPResponseReset(&c->response);
+        const RTSPHTTPRoute *route = c->match.target;
+        route->handler(route->context, &c->request, &c->response);
+
+        pthread_mutex_lock(&server->completionLock);
+        bool wake = server->completed == NULL;
+        c->completedNext = server->completed;
+        server->completed = c;
+        pthread_mutex_unlock(&server->completionLock);
+        if (wake) {
+            RTSPHTTPServerWake(server);
+        }
+    }
+    return NULL;
+}
+
+static void RTSPHTTPProcessCompletions(RTSPHTTPServerRef server, double now) {
+    pthread_mutex_lock(&server->completionLock);
+    RTSPHTTPConnection *completed = server->completed;
+    server->completed = NULL;
+    pthread_mutex_unlock(&server->completionLock);
+
+    while (completed) {
+        RTSPHTTPConnection *c = completed;
+        completed = c->completedNext;
+        c->state = RTSPHTTPConnectionReading;
+        if (c->closed) {
+            c->deadNext = server->dead;
+            server->dead = c;
+            continue;
+        }
+        if (!c->response.channel) {
+            RTSPHTTPBeginResponse(c);
+        } else if (!RTSPHTTPBeginStream(c, now)) {
+            RTSPHTTPRespondError(c, 500, true);
+        }
+        RTSPHTTPAdvance(server, c, now);
+    }
+}
+
+/// Advances subscribers that publishers queued messages for
+static void RTSPHTTPProcessChannels(RTSPHTTPServerRef server, double now) {
+    for (size_t i = 0; i < server->channelCount; i++) {
+        RTSPHTTPChannel *channel = server->channels[i];
+        size_t count = 0;
+        pthread_mutex_lock(&channel->lock);
+        for (RTSPHTTPSubscriber *subscriber = channel->ready; subscriber; subscriber = subscriber->readyNext) {
+            if (count == server->readyCapacity) {
+                size_t capacity = server->readyCapacity ? server->readyCapacity * 2 : 64;
+                RTSPHTTPConnection **grown = realloc(server->readyConnections, capacity * sizeof(*grown));
+                if (!grown) {
+                    break; // The rest stay ready for the next pass
+                }
+                server->readyConnections = grown;
+                server->readyCapacity = capacity;
+            }
+            server->readyConnections[count++] = subscriber->connection;
+        }
+        for (size_t j = 0; j < count; j++) {
+            RTSPHTTPSubscriber *subscriber = channel->ready;
+            subscriber->ready = false;
+            channel->ready = subscriber->readyNext;
+        }
+        pthread_mutex_unlock(&channel->lock);
+
+        // Detached (closed) subscribers were removed from the ready list under the lock
+        for (size_t j = 0; j < count; j++) {
+            RTSPHTTPAdvance(server, server->readyConnections[j], now);
+        }
+    }
+}
+
+static void RTSPHTTPSweep(RTSPHTTPServerRef server, double now) {
+    RTSPHTTPConnection *c = server->connections;
+    while (c) {
+        RTSPHTTPConnection *next = c->next;
+        if (c->state == RTSPHTTPConnectionStreaming) {
+            RTSPHTTPSubscriber *subscriber = c->subscriber;
+            if (RTSPHTTPStreamPending(c) && now - subscriber->lastWrite > server->config.idleTimeout) {
+                RTSPHTTPConnectionClose(server, c); // Not reading at all
+            } else if (subscriber->channel->config.format == RTSPHTTPChannelFormatEvents &&
+                       now - subscriber->lastWrite >= subscriber->channel->config.heartbeatInterval &&
+                       subscriber->control.length == 0 && !subscriber->closing) {
+                // Keeps proxies from timing out a quiet stream and finds dead peers
+                if (subscriber->webSocket) {
+                    RTSPWebSocketAppendFrame(&subscriber->control, RTSPWebSocketOpcodePing, NULL, 0);
+                } else {
+                    RTSPByteBufferAppendString(&subscriber->control, ": keep-alive\n\n");
+                }
+                RTSPHTTPAdvance(server, c, now);
+            }
+        } else if (c->state != RTSPHTTPConnectionDispatched && now - c->lastActivity > server->config.idleTimeout) {
+            RTSPHTTPConnectionClose(server, c);
+        }
+        c = next;
+    }
+    if (server->acceptResumeTime > 0 && now >= server->acceptResumeTime) {
+        server->acceptResumeTime = 0;
+        RTSPHTTPPollerUpdate(server->poller, server->listener, &server->listener, RTSPHTTPInterestRead, 0);
+    }
+}
+
+static void *RTSPHTTPLoopThread(void *argument) {
+    RTSPHTTPServerRef server = argument;
+#if defined(__APPLE__)
+    pthread_setname_np("com.rtsp.http-server");
+#elif defined(__linux__)
+    pthread_setname_np(pthread_self(), "rtsp-http");
+#endif
+
+    RTSPHTTPEvent events[RTSP_HTTP_EVENT_BATCH];
+    server->nextSweep = RTSPHTTPNow() + RTSP_HTTP_SWEEP_INTERVAL;
+    for (;;) {
+        pthread_mutex_lock(&server->lock);
+        bool running = server->running;
+        server->local.connections = server->connectionCount;
+        server->statistics = server->local;
+        pthread_mutex_unlock(&server->lock);
+        if (!running) {
+            break;
+        }
+
+        double now = RTSPHTTPNow();
+        double wait = server->nextSweep - now;
+        if (server->acceptResumeTime > 0 && server->acceptResumeTime - now < wait) {
+            wait = server->acceptResumeTime - now;
+        }
+        int timeout = wait > 0 ? (int)(wait * 1000.0) + 1 : 0;
+        int count = RTSPHTTPPollerWait(server->poller, events, timeout);
+        if (count < 0 && errno != EINTR) {
+            usleep(1000);
+            continue;
+        }
+        now = RTSPHTTPNow();
+
+        for (int i = 0; i < count; i++) {
+            RTSPHTTPEvent *event = &events[i];
+            if (event->udata == &server->wakeup[0]) {
+                char drain[64];
+                while (read(server->wakeup[0], drain, sizeof(drain)) > 0) {
+                }
+                continue;
+            }
+            if (event->udata == &server->listener) {
+                RTSPHTTPAccept(server, now);
+                continue;
+            }
+            RTSPHTTPConnection *c = event->udata;
+            if (c->closed) {
+                continue;
+            }
+            bool alive = !event->failed;
+            if (alive && event->readable && !c->peerClosed) {
+                alive = RTSPHTTPRead(server, c, now);
+            }
+            if (!alive) {
+                RTSPHTTPConnectionClose(server, c);
+                continue;
+            }
+            RTSPHTTPAdvance(server, c, now);
+        }
+
+        RTSPHTTPProcessCompletions(server, now);
+        RTSPHTTPProcessChannels(server, now);
+
+        if (now >= server->nextSweep) {
+            RTSPHTTPSweep(server, now);
+            server->nextSweep = now + RTSP_HTTP_SWEEP_INTERVAL;
+        }
+
+        while (server->dead) {
+            RTSPHTTPConnection *c = server->dead;
+            server->dead = c->deadNext;
+            RTSPHTTPConnectionFree(c);
+        }
+    }
+
+    // Let running handlers finish before anything they touch is freed
+    pthread_mutex_lock(&server->lock);
+    pthread_cond_broadcast(&server->workAvailable);
+    pthread_mutex_unlock(&server->lock);
+    for (uint32_t i = 0; i < server->workerCount; i++) {
+        pthread_join(server->workers[i], NULL);
+    }
+
+    // Closed connections that were still queued or completing are only reachable from there
+    for (uint32_t i = 0; i < server->queueCount; i++) {
+        RTSPHTTPConnection *c = server->queue[(server->queueHead + i) % server->config.queueDepth];
+        if (c->closed) {
+            RTSPHTTPConnectionFree(c);
+        }
+    }
+    for (RTSPHTTPConnection *c = server->completed, *next; c; c = next) {
+        next = c->completedNext;
+        if (c->closed) {
+            RTSPHTTPConnectionFree(c);
+        }
+    }
+    while (server->dead) {
+        RTSPHTTPConnection *c = server->dead;
+        server->dead = c->deadNext;
+        RTSPHTTPConnectionFree(c);
+    }
+    while (server->connections) {
+        RTSPHTTPConnection *next = server->connections->next;
+        close(server->connections->fd);
+        RTSPHTTPConnectionFree(server->connections);
+        server->connections = next;
+    }
+    return NULL;
+}
+
+#pragma mark - Public API
+
+RTSPHTTPServerRef RTSPHTTPServerCreate(const RTSPHTTPServerConfig *config) {
+    RTSPHTTPServerRef server = calloc(1, sizeof(*server));
+    if (!server) {
+        return NULL;
+    }
+    if (config) {
+        server->config = *config;
+    } else {
+        RTSPHTTPServerConfigInit(&server->config);
+    }
+    snprintf(server->bindAddress, sizeof(server->bindAddress), "%s",
+             server->config.bindAddress ? server->config.bindAddress : "0.0.0.0");
+    server->config.bindAddress = server->bindAddress;
+    if (server->config.maxConnections == 0) {
+        server->config.maxConnections = 4096;
+    }
+    if (server->config.workerCount == 0) {
+        server->config.workerCount = 4;
+    }
+    if (server->config.queueDepth == 0) {
+        server->config.queueDepth = 1024;
+    }
+    if (server->config.maxRequestSize < 1024) {
+        server->config.maxRequestSize = 64 * 1024;
+    }
+    if (server->config.idleTimeout <= 0) {
+        server->config.idleTimeout = 30.0;
+    }
+    server->listener = -1;
+    server->poller = -1;
+    server->wakeup[0] = server->wakeup[1] = -1;
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(server->config.port);
+    socklen_t length = sizeof(address);
+    int one = 1;
+    server->router = RTSPHTTPRouterCreate();
+    server->queue = calloc(server->config.queueDepth, sizeof(*server->queue));
+    server->workers = calloc(server->config.workerCount, sizeof(*server->workers));
+    if (!server->router || !server->queue || !server->workers ||
+        inet_pton(AF_INET, server->bindAddress, &address.sin_addr) != 1 ||
+        (server->listener = socket(AF_INET, SOCK_STREAM, 0)) < 0 ||
+        setsockopt(server->listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) != 0 ||
+        bind(server->listener, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+        listen(server->listener, 1024) != 0 ||
+        getsockname(server->listener, (struct sockaddr *)&address, &length) != 0 ||
+        pipe(server->wakeup) != 0 ||
+        (server->poller = RTSPHTTPPollerCreate()) < 0) {
+        RTSPHTTPServerRelease(server);
+        return NULL;
+    }
+    server->port = ntohs(address.sin_port);
+    RTSPHTTPSetNonBlocking(server->listener);
+    RTSPHTTPSetNonBlocking(server->wakeup[0]);
+    RTSPHTTPSetNonBlocking(server->wakeup[1]);
+    pthread_mutex_init(&server->lock, NULL);
+    pthread_mutex_init(&server->completionLock, NULL);
+    pthread_cond_init(&server->workAvailable, NULL);
+    return server;
+}
+
+bool RTSPHTTPServerAddRoute(RTSPHTTPServerRef server, uint32_t methods, const char *pattern,
+                            RTSPHTTPHandler handler, void *context) {
+    if (!server || server->started || !handler) {
+        return false;
+    }
+    RTSPHTTPRoute **routes = realloc(server->routes, (server->routeCount + 1) * sizeof(*routes));
+    if (!routes) {
+        return false;
+    }
+    server->routes = routes;
+    RTSPHTTPRoute *route = malloc(sizeof(*route));
+    if (!route) {
+        return false;
+    }
+    *route = (RTSPHTTPRoute){handler, context};
+    if (!RTSPHTTPRouterAdd(server->router, methods, pattern, route)) {
+        free(route);
+        return false;
+    }
+    server->routes[server->routeCount++] = route;
+    return true;
+}
+
+bool RTSPHTTPServerStart(RTSPHTTPServerRef server) {
+    if (!server || server->started) {
+        return false;
+    }
+    if (!RTSPHTTPPollerUpdate(server->poller, server->listener, &server->listener,
+                              RTSPHTTPInterestRead, RTSPHTTPInterestUnregistered) ||
+        !RTSPHTTPPollerUpdate(server->poller, server->wakeup[0], &server->wakeup[0],
+                              RTSPHTTPInterestRead, RTSPHTTPInterestUnregistered)) {
+        return false;
+    }
+
+    server->running = true;
+    for (uint32_t i = 0; i < server->config.workerCount; i++) {
+        if (pthread_create(&server->workers[i], NULL, RTSPHTTPWorkerThread, server) != 0) {
+            break;
+        }
+        server->workerCount++;
+    }
+    if (server->workerCount == 0 || pthread_create(&server->thread, NULL, RTSPHTTPLoopThread, server) != 0) {
+        pthread_mutex_lock(&server->lock);
+        server->running = false;
+        pthread_cond_broadcast(&server->workAvailable);
+        pthread_mutex_unlock(&server->lock);
+        for (uint32_t i = 0; i < server->workerCount; i++) {
+            pthread_join(server->workers[i], NULL);
+        }
+        server->workerCount = 0;
+        return false;
+    }
+    server->started = true;
+    return true;
+}
+
+void RTSPHTTPServerRelease(RTSPHTTPServerRef server) {
+    if (!server) {
+        return;
+    }
+    if (server->started) {
+        pthread_mutex_lock(&server->lock);
+        server->running = false;
+        pthread_mutex_unlock(&server->lock);
+        RTSPHTTPServerWake(server);
+        pthread_join(server->thread, NULL);
+    }
+    if (server->poller >= 0) {
+        // Only initialised once everything before it succeeded
+        pthread_mutex_destroy(&server->lock);
+        pthread_mutex_destroy(&server->completionLock);
+        pthread_cond_destroy(&server->workAvailable);
+        close(server->poller);
+    }
+    if (server->listener >= 0) {
+        close(server->listener);
+    }
+    if (server->wakeup[0] >= 0) {
+        close(server->wakeup[0]);
+        close(server->wakeup[1]);
+    }
+    for (size_t i = 0; i < server->routeCount; i++) {
+        free(server->routes[i]);
+    }
+    free(server->routes);
+    for (size_t i = 0; i < server->channelCount; i++) {
+        RTSPHTTPChannel *channel = server->channels[i];
+        for (uint32_t j = 0; j < channel->retainedCount; j++) {
+            RTSPHTTPMessageRelease(channel->retained[j]);
+        }
+        pthread_mutex_destroy(&channel->lock);
+        free(channel);
+    }
+    free(server->channels);
+    free(server->readyConnections);
+    RTSPHTTPRouterRelease(server->router);
+    free(server->queue);
+    free(server->workers);
+    free(server);
+}
+
+uint16_t RTSPHTTPServerPort(RTSPHTTPServerRef server) {
+    return server ? server->port : 0;
+}
+
+RTSPHTTPServerStatistics RTSPHTTPServerGetStatistics(RTSPHTTPServerRef server) {
+    RTSPHTTPServerStatistics statistics = {0};
+    if (server && server->started) {
+        pthread_mutex_lock(&server->lock);
+        statistics = server->statistics;
+        pthread_mutex_unlock(&server->lock);
+    }
+    return statistics;
+}
+
+#pragma mark - Push Channels
+
+void RTSPHTTPChannelConfigInit(RTSPHTTPChannelConfig *config) {
+    config->format = RTSPHTTPChannelFormatEvents;
+    config->maxQueuedMessages = 256;
+    config->maxQueuedBytes = 1024 * 1024;
+    config->skipWhenFull = false;
+    config->heartbeatInterval = 15.0;
+}
+
+RTSPHTTPChannelRef RTSPHTTPServerAddChannel(RTSPHTTPServerRef server, const RTSPHTTPChannelConfig *config) {
+    if (!server || server->started) {
+        return NULL;
+    }
+    RTSPHTTPChannel **channels = realloc(server->channels, (server->channelCount + 1) * sizeof(*channels));
+    if (!channels) {
+        return NULL;
+    }
+    server->channels = channels;
+    RTSPHTTPChannel *channel = calloc(1, sizeof(*channel));
+    if (!channel) {
+        return NULL;
+    }
+    if (config) {
+        channel->config = *config;
+    } else {
+        RTSPHTTPChannelConfigInit(&channel->config);
+    }
+    if (channel->config.maxQueuedMessages == 0) {
+        channel->config.maxQueuedMessages = 256;
+    }
+    if (channel->config.maxQueuedBytes == 0) {
+        channel->config.maxQueuedBytes = 1024 * 1024;
+    }
+    if (channel->config.heartbeatInterval <= 0) {
+        channel->config.heartbeatInterval = 15.0;
+    }
+    channel->server = server;
+    pthread_mutex_init(&channel->lock, NULL);
+    server->channels[server->channelCount++] = channel;
+    return channel;
+}
+
+bool RTSPHTTPResponseSubscribe(RTSPHTTPResponse *response, const RTSPHTTPRequest *request,
+                               RTSPHTTPChannelRef channel, const char *events) {
+    if (!response || !request || !channel || request->method != RTSPHTTPMethodGET) {
+        return false;
+    }
+    bool webSocket = RTSPHTTPHeaderHasToken(request->headers, "Upgrade", "websocket");
+    char key[64];
+    if (webSocket && channel->config.format != RTSPHTTPChannelFormatEvents) {
+        return false;
+    }
+    if (webSocket) {
+        char version[8];
+        if (!RTSPHTTPHeaderHasToken(request->headers, "Connection", "upgrade") ||
+            !RTSPHTTPHeaderValue(request->headers, "Sec-WebSocket-Version", version, sizeof(version)) ||
+            strcmp(version, "13") != 0 ||
+            !RTSPHTTPHeaderValue(request->headers, "Sec-WebSocket-Key", key, sizeof(key)) ||
+            strlen(key) != 24) {
+            return false;
+        }
+    }
+
+    char *filter = NULL;
+    if (events && *events) {
+        filter = malloc(strlen(events) + 1);
+        if (!filter) {
+            return false;
+        }
+        char *out = filter;
+        for (const char *p = events; *p; p++) {
+            if (*p != ' ' && *p != '\t') {
+                *out++ = *p;
+            }
+        }
+        *out = '\0';
+    }
+
+    free(response->events);
+    response->events = filter;
+    response->channel = channel;
+    response->webSocket = webSocket;
+    if (webSocket) {
+        RTSPWebSocketAcceptKey(key, response->accept);
+    }
+    return true;
+}
+
+/// Channel lock held. Returns true when the loop has to be woken up.
+static bool RTSPHTTPChannelDistribute(RTSPHTTPChannel *channel, RTSPHTTPMessage *message, bool retain) {
+    bool wake = false;
+    channel->statistics.published++;
+    for (RTSPHTTPSubscriber *subscriber = channel->subscribers; subscriber; subscriber = subscriber->next) {
+        RTSPHTTPSubscriberEnqueue(channel, subscriber, message, &wake);
+    }
+    if (retain) {
+        uint32_t slot = 0;
+        while (slot < channel->retainedCount && strcmp(channel->retained[slot]->event, message->event) != 0) {
+            slot++;
+        }
+        if (slot < channel->retainedCount) {
+            RTSPHTTPMessageRelease(channel->retained[slot]);
+            channel->retained[slot] = RTSPHTTPMessageRetain(message);
+        } else if (slot < RTSP_HTTP_MAX_RETAINED) {
+            channel->retained[channel->retainedCount++] = RTSPHTTPMessageRetain(message);
+        }
+    }
+    return wake;
+}
+
+bool RTSPHTTPChannelPublish(RTSPHTTPChannelRef channel, const char *event, const char *data, size_t length,
+                            bool retain) {
+    if (!channel || channel->config.format != RTSPHTTPChannelFormatEvents || !RTSPHTTPEventNameValid(event) ||
+        (!data && length > 0)) {
+        return false;
+    }
+
+    // Encoded under the lock so ids reach every subscriber in order
+    pthread_mutex_lock(&channel->lock);
+    RTSPHTTPMessage *message = RTSPHTTPMessageCreate(channel->lastID + 1, event, data, length);
+    if (!message) {
+        pthread_mutex_unlock(&channel->lock);
+        return false;
+    }
+    channel->lastID++;
+    bool wake = RTSPHTTPChannelDistribute(channel, message, retain);
+    pthread_mutex_unlock(&channel->lock);
+
+    RTSPHTTPMessageRelease(message);
+    if (wake) {
+        RTSPHTTPServerWake(channel->server);
+    }
+    return true;
+}
+
+bool RTSPHTTPChannelPublishPart(RTSPHTTPChannelRef channel, const char *event, const char *contentType,
+                                const void *data, size_t length, bool retain) {
+    if (!channel || channel->config.format != RTSPHTTPChannelFormatMultipart || !RTSPHTTPEventNameValid(event) ||
+        !contentType || strlen(contentType) >= 128 || strpbrk(contentType, "\r\n") || (!data && length > 0)) {
+        return false;
+    }
+
+    // Parts carry no ids, so the copy happens outside the lock
+    RTSPHTTPMessage *message = RTSPHTTPPartCreate(event, contentType, data, length);
+    if (!message) {
+        return false;
+    }
+    pthread_mutex_lock(&channel->lock);
+    bool wake = RTSPHTTPChannelDistribute(channel, message, retain);
+    pthread_mutex_unlock(&channel->lock);
+
+    RTSPHTTPMessageRelease(message);
+    if (wake) {
+        RTSPHTTPServerWake(channel->server);
+    }
+    return true;
+}
+
+uint32_t RTSPHTTPChannelSubscriberCount(RTSPHTTPChannelRef channel, const char *event) {
+    uint32_t count = 0;
+    if (channel) {
+        pthread_mutex_lock(&channel->lock);
+        for (RTSPHTTPSubscriber *subscriber = channel->subscribers; subscriber; subscriber = subscriber->next) {
+            if (!subscriber->overflowed && (!event || RTSPHTTPEventSelected(subscriber->events, event))) {
+                count++;
+            }
+        }
+        pthread_mutex_unlock(&channel->lock);
+    }
+    return count;
+}
+
+RTSPHTTPChannelStatistics RTSPHTTPChannelGetStatistics(RTSPHTTPChannelRef channel) {
+    RTSPHTTPChannelStatistics statistics = {0};
+    if (channel) {
+        pthread_mutex_lock(&channel->lock);
+        statistics = channel->statistics;
+        pthread_mutex_unlock(&channel->lock);
+    }
+    return statistics;
+}
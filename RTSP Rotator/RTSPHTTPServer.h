@@ -0,0 +1,172 @@
+//
+//  RTSPHTTPServer.h
+//  RTSP Rotator
+//
+//  Event-driven HTTP/1.1 engine for the REST API. One loop thread owns
+//  every socket through kqueue (macOS) or epoll (Linux) and parses requests
+//  incrementally as bytes arrive; keep-alive connections stay open and
+//  pipelined requests are answered strictly in order. Matched routes run on
+//  a bounded worker pool so a slow handler never stalls the loop. When
+//  every worker is busy and the queue is full, requests are answered with
+//  503 instead of piling up.
+//
+//  Push channels turn a request into a long-lived subscription, served as
+//  Server-Sent Events or, for upgrade requests, a WebSocket. Publishing
+//  encodes a message once and hands a reference to each subscriber's
+//  bounded queue; a subscriber that falls too far behind is disconnected
+//  rather than slowing the publisher or its peers. Multipart channels carry
+//  binary parts instead (MJPEG); there a lagging subscriber skips to newer
+//  parts rather than being dropped.
+//
+//  Portable C so it can be load-tested on Linux by Benchmarks/http_bench.
+//
+
+#ifndef RTSPHTTPServer_h
+#define RTSPHTTPServer_h
+
+#include "RTSPHTTPRouter.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    const char *bindAddress;        // IPv4 literal. Default "0.0.0.0"
+    uint16_t port;                  // 0 picks a free port. Default 8080
+    uint32_t maxConnections;        // Default 4096
+    uint32_t workerCount;           // Handler threads. Default 4
+    uint32_t queueDepth;            // Requests waiting for a worker before 503. Default 1024
+    size_t maxRequestSize;          // Request head plus body. Default 64 KB
+    double idleTimeout;             // Seconds before an idle or stalled connection is closed. Default 30
+} RTSPHTTPServerConfig;
+
+void RTSPHTTPServerConfigInit(RTSPHTTPServerConfig *config);
+
+typedef struct {
+    uint64_t requests;
+    uint64_t rejectedRequests;      // Answered 503 because the worker queue was full
+    uint64_t bytesSent;
+    uint32_t connections;
+    uint32_t queueHighWater;        // Deepest the worker queue has been
+} RTSPHTTPServerStatistics;
+
+/// A parsed request, valid for the duration of the handler call
+typedef struct {
+    RTSPHTTPMethod method;
+    const char *path;               // Without the query string
+    const char *query;              // After '?', or NULL
+    const char *headers;            // Raw "Name: value\r\n" lines
+    const uint8_t *body;
+    size_t bodyLength;
+    const RTSPHTTPRouteParam *params;
+    uint32_t paramCount;
+} RTSPHTTPRequest;
+
+/// Copies the value of the first `name` header, without surrounding whitespace
+bool RTSPHTTPRequestHeader(const RTSPHTTPRequest *request, const char *name, char *value, size_t capacity);
+
+/// Looks up a ":name" (or "*") capture from the matched route
+bool RTSPHTTPRequestParam(const RTSPHTTPRequest *request, const char *name, const char **value, size_t *length);
+
+typedef struct RTSPHTTPResponse RTSPHTTPResponse;
+
+/// Defaults to 200 with an empty text/plain body
+void RTSPHTTPResponseSetStatus(RTSPHTTPResponse *response, int status);
+void RTSPHTTPResponseSetContentType(RTSPHTTPResponse *response, const char *contentType);
+void RTSPHTTPResponseAddHeader(RTSPHTTPResponse *response, const char *name, const char *value);
+void RTSPHTTPResponseAppendBody(RTSPHTTPResponse *response, const void *data, size_t length);
+
+/// Runs on a worker thread. Fill in `response` before returning.
+typedef void (*RTSPHTTPHandler)(void *context, const RTSPHTTPRequest *request, RTSPHTTPResponse *response);
+
+typedef struct RTSPHTTPServer *RTSPHTTPServerRef;
+
+/// Binds the listening socket. Returns NULL if the address is unavailable.
+RTSPHTTPServerRef RTSPHTTPServerCreate(const RTSPHTTPServerConfig *config);
+
+/// Register a handler. Only valid before RTSPHTTPServerStart.
+bool RTSPHTTPServerAddRoute(RTSPHTTPServerRef server, uint32_t methods, const char *pattern,
+                            RTSPHTTPHandler handler, void *context);
+
+/// Starts the loop and worker threads
+bool RTSPHTTPServerStart(RTSPHTTPServerRef server);
+
+/// Closes every connection and joins all threads. Handlers that are running
+/// finish first; queued requests are dropped.
+void RTSPHTTPServerRelease(RTSPHTTPServerRef server);
+
+/// The bound port (useful when the config asked for 0)
+uint16_t RTSPHTTPServerPort(RTSPHTTPServerRef server);
+
+RTSPHTTPServerStatistics RTSPHTTPServerGetStatistics(RTSPHTTPServerRef server);
+
+#pragma mark - Push Channels
+
+typedef enum {
+    RTSPHTTPChannelFormatEvents = 0,    // Server-Sent Events, or WebSocket text frames on upgrade
+    RTSPHTTPChannelFormatMultipart      // multipart/x-mixed-replace, one part per message
+} RTSPHTTPChannelFormat;
+
+typedef struct {
+    RTSPHTTPChannelFormat format;   // Default RTSPHTTPChannelFormatEvents
+    uint32_t maxQueuedMessages;     // Per subscriber before it is dropped. Default 256
+    size_t maxQueuedBytes;          // Per subscriber before it is dropped. Default 1 MB
+    bool skipWhenFull;              // Drop the oldest queued messages instead of the subscriber. Default false
+    double heartbeatInterval;       // Seconds between SSE comments / WebSocket pings. Default 15
+} RTSPHTTPChannelConfig;
+
+void RTSPHTTPChannelConfigInit(RTSPHTTPChannelConfig *config);
+
+typedef struct {
+    uint64_t published;
+    uint64_t delivered;             // Messages fully written to a subscriber
+    uint64_t droppedSubscribers;    // Disconnected for falling behind
+    uint64_t skipped;               // Messages dropped from full queues with skipWhenFull
+    uint32_t subscribers;
+    uint32_t webSocketSubscribers;
+} RTSPHTTPChannelStatistics;
+
+typedef struct RTSPHTTPChannel *RTSPHTTPChannelRef;
+
+/// Creates a channel owned by the server. Only valid before RTSPHTTPServerStart.
+RTSPHTTPChannelRef RTSPHTTPServerAddChannel(RTSPHTTPServerRef server, const RTSPHTTPChannelConfig *config);
+
+/// Called from a handler: once it returns, the connection subscribes to
+/// `channel` instead of receiving a normal response. Requests carrying a
+/// WebSocket upgrade get 101 and one text frame per message; others get a
+/// text/event-stream. `events` is a comma-separated list of event names, or
+/// NULL for all. Returns false for anything but GET or for a malformed
+/// upgrade (or any upgrade on a multipart channel), leaving the response
+/// untouched.
+bool RTSPHTTPResponseSubscribe(RTSPHTTPResponse *response, const RTSPHTTPRequest *request,
+                               RTSPHTTPChannelRef channel, const char *events);
+
+/// Queues `data` (JSON) for every subscriber to `event`; WebSocket clients
+/// receive {"id":N,"event":"...","data":...}. Never waits on a client. With
+/// `retain`, the message is also replayed to later subscribers until the next
+/// retained message for the same event. Event names are limited to
+/// [A-Za-z0-9._-]. Any thread, until the server is released.
+bool RTSPHTTPChannelPublish(RTSPHTTPChannelRef channel, const char *event, const char *data, size_t length,
+                            bool retain);
+
+/// Queues one part of a multipart channel for every subscriber to `event`.
+/// The part is copied once and shared. With `retain`, later subscribers
+/// start with the latest part for `event` (up to 32 distinct events).
+bool RTSPHTTPChannelPublishPart(RTSPHTTPChannelRef channel, const char *event, const char *contentType,
+                                const void *data, size_t length, bool retain);
+
+/// Subscribers currently receiving `event` (all subscribers for NULL). Lets
+/// a publisher skip producing messages nobody will read.
+uint32_t RTSPHTTPChannelSubscriberCount(RTSPHTTPChannelRef channel, const char *event);
+
+RTSPHTTPChannelStatistics RTSPHTTPChannelGetStatistics(RTSPHTTPChannelRef channel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RTSPHTTPServer_h */
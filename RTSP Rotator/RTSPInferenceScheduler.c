@@ -0,0 +1,412 @@
+//
+//  RTSPInferenceScheduler.c
+//  RTSP Rotator
+//
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE     // pthread_setname_np
+#endif
+
+#include "RTSPInferenceScheduler.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct {
+    bool active;
+    bool pending;                   // job holds a frame waiting for a batch
+    bool inFlight;                  // A frame of this camera is inside the backend
+    uint64_t frameCount;            // Frames submitted, for inferenceInterval
+    RTSPInferenceJob job;
+} RTSPInferenceCamera;
+
+typedef struct {
+    RTSPInferenceSchedulerRef scheduler;
+    pthread_t thread;
+    bool started;
+    RTSPInferenceJob *batch;        // maxBatch
+    RTSPInferenceJob *stale;        // maxCameras
+} RTSPInferenceWorker;
+
+struct RTSPInferenceScheduler {
+    RTSPInferenceSchedulerConfig config;
+    RTSPInferenceBackend backend;
+    RTSPInferenceCompletion completion;
+    void *context;
+    uint32_t batchLimit;
+
+    pthread_mutex_t lock;           // Guards everything below
+    pthread_cond_t changed;         // Frame submitted, batch finished, or stopping
+    bool running;
+    RTSPInferenceCamera *cameras;
+    uint32_t cursor;                // Camera the next batch starts from
+    uint32_t inFlight;              // Frames inside the backend
+    RTSPInferenceSchedulerStatistics statistics;
+
+    RTSPInferenceWorker *workers;
+};
+
+static double RTSPInferenceNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+void RTSPInferenceSchedulerConfigInit(RTSPInferenceSchedulerConfig *config) {
+    config->maxConcurrent = 4;
+    config->maxBatch = 8;
+    config->workerCount = 2;
+    config->maxCameras = 64;
+    config->inferenceInterval = 1;
+    config->targetLatency = 0.010;
+    config->maxFrameAge = 0.25;
+}
+
+/// pthread_cond_timedwait takes a wall-clock deadline; only the length matters here
+static void RTSPInferenceWait(RTSPInferenceSchedulerRef scheduler, double seconds) {
+    if (seconds < 0) {
+        pthread_cond_wait(&scheduler->changed, &scheduler->lock);
+        return;
+    }
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    long long nanoseconds = deadline.tv_nsec + (long long)(seconds * 1e9);
+    deadline.tv_sec += (time_t)(nanoseconds / 1000000000);
+    deadline.tv_nsec = (long)(nanoseconds % 1000000000);
+    pthread_cond_timedwait(&scheduler->changed, &scheduler->lock, &deadline);
+}
+
+#pragma mark - Batching
+
+/// Whether a batch should go now; otherwise how long to wait (-1 = until
+/// something changes). Called with the lock held.
+static bool RTSPInferenceReady(RTSPInferenceSchedulerRef scheduler, double now, double *wait) {
+    *wait = -1;
+    uint32_t capacity = scheduler->config.maxConcurrent - scheduler->inFlight;
+    if (capacity == 0) {
+        return false;
+    }
+    if (capacity > scheduler->batchLimit) {
+        capacity = scheduler->batchLimit;
+    }
+
+    uint32_t eligible = 0;
+    uint32_t potential = 0;         // Cameras that could still add a frame to this batch
+    double oldest = now;
+    for (uint32_t i = 0; i < scheduler->config.maxCameras; i++) {
+        const RTSPInferenceCamera *camera = &scheduler->cameras[i];
+        if (camera->inFlight || !camera->active) {
+            continue;
+        }
+        potential++;
+        if (camera->pending) {
+            eligible++;
+            if (camera->job.submitted < oldest) {
+                oldest = camera->job.submitted;
+            }
+        }
+    }
+    if (eligible == 0) {
+        return false;
+    }
+    if (eligible >= capacity || eligible >= potential || now - oldest >= scheduler->config.maxFrameAge) {
+        return true;
+    }
+    double deadline = oldest + scheduler->config.targetLatency;
+    if (now >= deadline) {
+        return true;
+    }
+    *wait = deadline - now;
+    return false;
+}
+
+/// Takes up to a batch of waiting frames round-robin from the cursor, and
+/// every stale frame passed on the way. Called with the lock held.
+static size_t RTSPInferenceTakeBatch(RTSPInferenceSchedulerRef scheduler, RTSPInferenceWorker *worker, double now,
+                                     size_t *staleCount) {
+    uint32_t capacity = scheduler->config.maxConcurrent - scheduler->inFlight;
+    if (capacity > scheduler->batchLimit) {
+        capacity = scheduler->batchLimit;
+    }
+
+    size_t count = 0;
+    *staleCount = 0;
+    uint32_t cameraCount = scheduler->config.maxCameras;
+    uint32_t next = scheduler->cursor;
+    for (uint32_t n = 0; n < cameraCount && count < capacity; n++) {
+        uint32_t index = (scheduler->cursor + n) % cameraCount;
+        RTSPInferenceCamera *camera = &scheduler->cameras[index];
+        if (!camera->active || !camera->pending || camera->inFlight) {
+            continue;
+        }
+        camera->pending = false;
+        if (now - camera->job.submitted > scheduler->config.maxFrameAge) {
+            worker->stale[(*staleCount)++] = camera->job;
+            continue;
+        }
+        camera->inFlight = true;
+        worker->batch[count++] = camera->job;
+        next = (index + 1) % cameraCount;
+    }
+    scheduler->cursor = next;
+
+    scheduler->inFlight += (uint32_t)count;
+    if (scheduler->inFlight > scheduler->statistics.inFlightHighWater) {
+        scheduler->statistics.inFlightHighWater = scheduler->inFlight;
+    }
+    scheduler->statistics.stale += *staleCount;
+    if (count > 0) {
+        scheduler->statistics.batches++;
+    }
+    return count;
+}
+
+static void *RTSPInferenceWorkerThread(void *argument) {
+    RTSPInferenceWorker *worker = argument;
+    RTSPInferenceSchedulerRef scheduler = worker->scheduler;
+#if defined(__APPLE__)
+    pthread_setname_np("com.rtsp.inference");
+#elif defined(__linux__)
+    pthread_setname_np(pthread_self(), "rtsp-inference");
+#endif
+
+    pthread_mutex_lock(&scheduler->lock);
+    for (;;) {
+        double wait;
+        while (scheduler->running && !RTSPInferenceReady(scheduler, RTSPInferenceNow(), &wait)) {
+            RTSPInferenceWait(scheduler, wait);
+        }
+        if (!scheduler->running) {
+            break;
+        }
+        size_t staleCount;
+        size_t count = RTSPInferenceTakeBatch(scheduler, worker, RTSPInferenceNow(), &staleCount);
+        pthread_mutex_unlock(&scheduler->lock);
+
+        for (size_t i = 0; i < staleCount; i++) {
+            scheduler->completion(scheduler->context, &worker->stale[i], RTSPInferenceOutcomeStale);
+        }
+        if (count > 0) {
+            for (size_t i = 0; i < count; i++) {
+                worker->batch[i].result = NULL;
+                worker->batch[i].failed = false;
+            }
+            scheduler->backend.infer(scheduler->backend.context, worker->batch, count);
+        }
+
+        uint64_t failed = 0;
+        double totalLatency = 0;
+        double maxLatency = 0;
+        for (size_t i = 0; i < count; i++) {
+            RTSPInferenceJob *job = &worker->batch[i];
+            double latency = RTSPInferenceNow() - job->submitted;
+            if (job->failed) {
+                failed++;
+            } else {
+                totalLatency += latency;
+                if (latency > maxLatency) {
+                    maxLatency = latency;
+                }
+            }
+            scheduler->completion(scheduler->context, job,
+                                  job->failed ? RTSPInferenceOutcomeFailed : RTSPInferenceOutcomeInferred);
+        }
+
+        pthread_mutex_lock(&scheduler->lock);
+        for (size_t i = 0; i < count; i++) {
+            scheduler->cameras[worker->batch[i].camera].inFlight = false;
+        }
+        scheduler->inFlight -= (uint32_t)count;
+        scheduler->statistics.inferred += count - failed;
+        scheduler->statistics.failed += failed;
+        scheduler->statistics.totalLatency += totalLatency;
+        if (maxLatency > scheduler->statistics.maxLatency) {
+            scheduler->statistics.maxLatency = maxLatency;
+        }
+        if (count > 0) {
+            pthread_cond_broadcast(&scheduler->changed);
+        }
+    }
+    pthread_mutex_unlock(&scheduler->lock);
+    return NULL;
+}
+
+#pragma mark - Lifecycle
+
+RTSPInferenceSchedulerRef RTSPInferenceSchedulerCreate(const RTSPInferenceSchedulerConfig *config,
+                                                       const RTSPInferenceBackend *backend,
+                                                       RTSPInferenceCompletion completion, void *context) {
+    if (!backend || !backend->infer || !completion) {
+        return NULL;
+    }
+    RTSPInferenceSchedulerRef scheduler = calloc(1, sizeof(*scheduler));
+    if (!scheduler) {
+        return NULL;
+    }
+    if (config) {
+        scheduler->config = *config;
+    } else {
+        RTSPInferenceSchedulerConfigInit(&scheduler->config);
+    }
+    RTSPInferenceSchedulerConfig *c = &scheduler->config;
+    if (c->maxConcurrent == 0) c->maxConcurrent = 1;
+    if (c->maxBatch == 0) c->maxBatch = 1;
+    if (c->workerCount == 0) c->workerCount = 1;
+    if (c->maxCameras == 0) c->maxCameras = 1;
+    if (c->inferenceInterval == 0) c->inferenceInterval = 1;
+
+    scheduler->backend = *backend;
+    scheduler->completion = completion;
+    scheduler->context = context;
+    scheduler->batchLimit = c->maxBatch;
+    if (backend->maxBatch > 0 && backend->maxBatch < scheduler->batchLimit) {
+        scheduler->batchLimit = backend->maxBatch;
+    }
+    if (scheduler->batchLimit > c->maxConcurrent) {
+        scheduler->batchLimit = c->maxConcurrent;
+    }
+
+    pthread_mutex_init(&scheduler->lock, NULL);
+    pthread_cond_init(&scheduler->changed, NULL);
+    scheduler->running = true;
+    scheduler->cameras = calloc(c->maxCameras, sizeof(*scheduler->cameras));
+    scheduler->workers = calloc(c->workerCount, sizeof(*scheduler->workers));
+    bool ok = scheduler->cameras && scheduler->workers;
+    for (uint32_t i = 0; ok && i < c->workerCount; i++) {
+        RTSPInferenceWorker *worker = &scheduler->workers[i];
+        worker->scheduler = scheduler;
+        worker->batch = calloc(scheduler->batchLimit, sizeof(*worker->batch));
+        worker->stale = calloc(c->maxCameras, sizeof(*worker->stale));
+        ok = worker->batch && worker->stale &&
+             pthread_create(&worker->thread, NULL, RTSPInferenceWorkerThread, worker) == 0;
+        worker->started = ok;
+    }
+    if (!ok) {
+        RTSPInferenceSchedulerRelease(scheduler);
+        return NULL;
+    }
+    return scheduler;
+}
+
+void RTSPInferenceSchedulerRelease(RTSPInferenceSchedulerRef scheduler) {
+    if (!scheduler) {
+        return;
+    }
+    pthread_mutex_lock(&scheduler->lock);
+    scheduler->running = false;
+    pthread_cond_broadcast(&scheduler->changed);
+    pthread_mutex_unlock(&scheduler->lock);
+
+    for (uint32_t i = 0; scheduler->workers && i < scheduler->config.workerCount; i++) {
+        RTSPInferenceWorker *worker = &scheduler->workers[i];
+        if (worker->started) {
+            pthread_join(worker->thread, NULL);
+        }
+        free(worker->batch);
+        free(worker->stale);
+    }
+    for (uint32_t i = 0; scheduler->cameras && i < scheduler->config.maxCameras; i++) {
+        if (scheduler->cameras[i].pending) {
+            scheduler->completion(scheduler->context, &scheduler->cameras[i].job, RTSPInferenceOutcomeCancelled);
+        }
+    }
+    pthread_cond_destroy(&scheduler->changed);
+    pthread_mutex_destroy(&scheduler->lock);
+    free(scheduler->workers);
+    free(scheduler->cameras);
+    free(scheduler);
+}
+
+#pragma mark - Cameras and Frames
+
+uint32_t RTSPInferenceSchedulerAddCamera(RTSPInferenceSchedulerRef scheduler) {
+    uint32_t index = UINT32_MAX;
+    pthread_mutex_lock(&scheduler->lock);
+    for (uint32_t i = 0; i < scheduler->config.maxCameras; i++) {
+        RTSPInferenceCamera *camera = &scheduler->cameras[i];
+        // A removed camera's slot is reused once its last batch is done
+        if (!camera->active && !camera->inFlight) {
+            memset(camera, 0, sizeof(*camera));
+            camera->active = true;
+            scheduler->statistics.cameras++;
+            index = i;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&scheduler->lock);
+    return index;
+}
+
+void RTSPInferenceSchedulerRemoveCamera(RTSPInferenceSchedulerRef scheduler, uint32_t camera) {
+    if (camera >= scheduler->config.maxCameras) {
+        return;
+    }
+    RTSPInferenceJob cancelled;
+    bool cancel = false;
+    pthread_mutex_lock(&scheduler->lock);
+    RTSPInferenceCamera *slot = &scheduler->cameras[camera];
+    if (slot->active) {
+        cancel = slot->pending;
+        cancelled = slot->job;
+        slot->pending = false;
+        slot->active = false;
+        scheduler->statistics.cameras--;
+        // Its absence may complete a batch someone is waiting to fill
+        pthread_cond_broadcast(&scheduler->changed);
+    }
+    pthread_mutex_unlock(&scheduler->lock);
+    if (cancel) {
+        scheduler->completion(scheduler->context, &cancelled, RTSPInferenceOutcomeCancelled);
+    }
+}
+
+RTSPInferenceSubmitResult RTSPInferenceSchedulerSubmit(RTSPInferenceSchedulerRef scheduler, uint32_t camera,
+                                                       void *frame, void *userData) {
+    if (camera >= scheduler->config.maxCameras) {
+        return RTSPInferenceSubmitRejected;
+    }
+    RTSPInferenceJob replaced;
+    bool replace = false;
+    pthread_mutex_lock(&scheduler->lock);
+    RTSPInferenceCamera *slot = &scheduler->cameras[camera];
+    if (!scheduler->running || !slot->active) {
+        pthread_mutex_unlock(&scheduler->lock);
+        return RTSPInferenceSubmitRejected;
+    }
+    if (slot->frameCount++ % scheduler->config.inferenceInterval != 0) {
+        scheduler->statistics.skipped++;
+        pthread_mutex_unlock(&scheduler->lock);
+        return RTSPInferenceSubmitSkipped;
+    }
+    if (slot->pending) {
+        replace = true;
+        replaced = slot->job;
+        scheduler->statistics.replaced++;
+    }
+    slot->job = (RTSPInferenceJob){
+        .camera = camera,
+        .frame = frame,
+        .userData = userData,
+        .submitted = RTSPInferenceNow(),
+    };
+    slot->pending = true;
+    scheduler->statistics.submitted++;
+    if (!slot->inFlight) {
+        pthread_cond_broadcast(&scheduler->changed);
+    }
+    pthread_mutex_unlock(&scheduler->lock);
+
+    if (replace) {
+        scheduler->completion(scheduler->context, &replaced, RTSPInferenceOutcomeReplaced);
+    }
+    return RTSPInferenceSubmitQueued;
+}
+
+RTSPInferenceSchedulerStatistics RTSPInferenceSchedulerGetStatistics(RTSPInferenceSchedulerRef scheduler) {
+    pthread_mutex_lock(&scheduler->lock);
+    RTSPInferenceSchedulerStatistics statistics = scheduler->statistics;
+    pthread_mutex_unlock(&scheduler->lock);
+    return statistics;
+}
@@ -0,0 +1,123 @@
+//
+//  RTSPInferenceScheduler.h
+//  RTSP Rotator
+//
+//  Shares one inference backend between every camera. Each camera keeps
+//  only its latest submitted frame: a newer frame replaces one still
+//  waiting, and a frame that waited longer than maxFrameAge is dropped
+//  rather than inferred, so the queue never grows past one frame per
+//  camera however far behind the backend falls.
+//
+//  Worker threads gather waiting frames into batches, taking cameras
+//  round-robin from where the previous batch stopped so every camera gets
+//  its turn under load. A batch is sent once it is full, once every camera
+//  that could still contribute has, or once its oldest frame has waited
+//  targetLatency. At most maxConcurrent frames are inside the backend at
+//  any time, and each camera has at most one, so a camera's results
+//  complete in submission order.
+//
+//  The backend is a plain callback table; the app plugs in Vision, and
+//  Benchmarks/inference_scheduler_bench drives a CPU backend on Linux.
+//
+//  Thread-safe: submit from any thread. Completions run on worker threads
+//  (or on the submitting thread for a replaced frame) and must not block.
+//
+
+#ifndef RTSPInferenceScheduler_h
+#define RTSPInferenceScheduler_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t maxConcurrent;         // Frames inside the backend at once, across batches (default 4)
+    uint32_t maxBatch;              // Frames per batch; the backend's limit also applies (default 8)
+    uint32_t workerCount;           // Batches in flight at once (default 2)
+    uint32_t maxCameras;            // Default 64
+    uint32_t inferenceInterval;     // Every Nth frame submitted per camera is inferred (default 1)
+    double targetLatency;           // Seconds a frame may wait for its batch to fill (default 0.010)
+    double maxFrameAge;             // Seconds after which a waiting frame is dropped (default 0.25)
+} RTSPInferenceSchedulerConfig;
+
+void RTSPInferenceSchedulerConfigInit(RTSPInferenceSchedulerConfig *config);
+
+typedef struct {
+    uint32_t camera;                // From RTSPInferenceSchedulerAddCamera
+    void *frame;                    // As submitted
+    void *userData;                 // As submitted
+    double submitted;               // Monotonic seconds
+    void *result;                   // Set by the backend for the completion to consume
+    bool failed;                    // Set by the backend for frames it could not infer
+} RTSPInferenceJob;
+
+typedef struct {
+    void *context;
+    uint32_t maxBatch;              // Largest batch the backend accepts (0 = no limit)
+    /// Infers `count` frames as one batch on a worker thread, filling in each
+    /// job's result (or failed)
+    void (*infer)(void *context, RTSPInferenceJob *jobs, size_t count);
+} RTSPInferenceBackend;
+
+typedef enum {
+    RTSPInferenceOutcomeInferred,
+    RTSPInferenceOutcomeFailed,     // The backend marked the job failed
+    RTSPInferenceOutcomeReplaced,   // A newer frame from the same camera took its place
+    RTSPInferenceOutcomeStale,      // Waited longer than maxFrameAge
+    RTSPInferenceOutcomeCancelled   // Camera removed or scheduler released
+} RTSPInferenceOutcome;
+
+/// Called exactly once per accepted frame. The scheduler forgets the frame
+/// afterwards; the completion owns it (and job->result).
+typedef void (*RTSPInferenceCompletion)(void *context, const RTSPInferenceJob *job, RTSPInferenceOutcome outcome);
+
+typedef enum {
+    RTSPInferenceSubmitQueued,      // The completion will be called
+    RTSPInferenceSubmitSkipped,     // Not this camera's inferenceInterval turn; caller keeps the frame
+    RTSPInferenceSubmitRejected     // Unknown camera or stopped scheduler; caller keeps the frame
+} RTSPInferenceSubmitResult;
+
+typedef struct {
+    uint64_t submitted;             // Accepted frames
+    uint64_t skipped;               // Passed over by inferenceInterval
+    uint64_t inferred;
+    uint64_t failed;
+    uint64_t replaced;
+    uint64_t stale;
+    uint64_t batches;
+    uint32_t inFlightHighWater;     // Most frames inside the backend at once
+    uint32_t cameras;
+    double totalLatency;            // Seconds from submission to completion, inferred frames
+    double maxLatency;
+} RTSPInferenceSchedulerStatistics;
+
+typedef struct RTSPInferenceScheduler *RTSPInferenceSchedulerRef;
+
+/// Starts the worker threads. Returns NULL on allocation or thread failure.
+RTSPInferenceSchedulerRef RTSPInferenceSchedulerCreate(const RTSPInferenceSchedulerConfig *config,
+                                                       const RTSPInferenceBackend *backend,
+                                                       RTSPInferenceCompletion completion, void *context);
+
+/// Cancels waiting frames, lets running batches finish and joins the workers
+void RTSPInferenceSchedulerRelease(RTSPInferenceSchedulerRef scheduler);
+
+/// A camera slot, or UINT32_MAX when maxCameras are in use
+uint32_t RTSPInferenceSchedulerAddCamera(RTSPInferenceSchedulerRef scheduler);
+
+/// Cancels the camera's waiting frame; a batch already running completes normally
+void RTSPInferenceSchedulerRemoveCamera(RTSPInferenceSchedulerRef scheduler, uint32_t camera);
+
+RTSPInferenceSubmitResult RTSPInferenceSchedulerSubmit(RTSPInferenceSchedulerRef scheduler, uint32_t camera,
+                                                       void *frame, void *userData);
+
+RTSPInferenceSchedulerStatistics RTSPInferenceSchedulerGetStatistics(RTSPInferenceSchedulerRef scheduler);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RTSPInferenceScheduler_h */
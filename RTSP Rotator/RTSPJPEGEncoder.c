@@ -0,0 +1,784 @@
+//
+//  RTSPJPEGEncoder.c
+//  RTSP Rotator
+//
+//  Each MCU row (16 luma lines, 8 chroma lines) is copied into padded
+//  scratch rows, with the chroma deinterleaved, then encoded block by
+//  block while it is in cache. The forward DCT is the AAN float DCT:
+//  columns first, then rows, so a SIMD backend can keep one row per vector,
+//  transpose once in the middle and finish with coefficients transposed.
+//  The scalar backend stores them in that same layout, and the divisors and
+//  zigzag order are kept transposed to match. All backends share one
+//  butterfly macro, so they round identically.
+//
+
+#include "RTSPJPEGEncoder.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Bit-identical backends need every multiply and add rounded on its own
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+#define RTSP_JPEG_X86 1
+#include <emmintrin.h>
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#define RTSP_JPEG_NEON 1
+#include <arm_neon.h>
+#endif
+
+#define RTSP_JPEG_MAX_DIMENSION 65535
+#define RTSP_JPEG_MCU_BYTES 2600        // Worst case for six blocks, byte stuffing included
+
+/// Quantizes one 8x8 block of samples: coefficients out transposed, index
+/// horizontal frequency × 8 + vertical frequency
+typedef void (*RTSPJPEGBlockFunction)(const uint8_t *pixels, size_t stride, float level,
+                                      const float *divisors, int16_t *coefficients);
+
+typedef struct {
+    uint16_t code[256];
+    uint8_t size[256];
+} RTSPJPEGHuffmanTable;
+
+struct RTSPJPEGEncoder {
+    RTSPJPEGEncoderBackend backend;
+    RTSPJPEGBlockFunction blockFunction;
+    uint32_t quality;
+    uint8_t quantization[2][64];        // Zigzag order, as written to DQT
+    float divisors[2][2][64];           // [full / video range][luma / chroma], transposed
+    RTSPJPEGHuffmanTable dc[2];
+    RTSPJPEGHuffmanTable ac[2];
+    uint8_t *scratch;                   // 16 luma rows, then 8 Cb and 8 Cr rows
+    size_t scratchCapacity;
+};
+
+#pragma mark - Tables
+
+static const uint8_t kRTSPJPEGZigzag[64] = {
+     0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+// Annex K.1, natural order
+static const uint8_t kRTSPJPEGLumaQuantization[64] = {
+    16, 11, 10, 16,  24,  40,  51,  61,
+    12, 12, 14, 19,  26,  58,  60,  55,
+    14, 13, 16, 24,  40,  57,  69,  56,
+    14, 17, 22, 29,  51,  87,  80,  62,
+    18, 22, 37, 56,  68, 109, 103,  77,
+    24, 35, 55, 64,  81, 104, 113,  92,
+    49, 64, 78, 87, 103, 121, 120, 101,
+    72, 92, 95, 98, 112, 100, 103,  99,
+};
+
+static const uint8_t kRTSPJPEGChromaQuantization[64] = {
+    17, 18, 24, 47, 99, 99, 99, 99,
+    18, 21, 26, 66, 99, 99, 99, 99,
+    24, 26, 56, 99, 99, 99, 99, 99,
+    47, 66, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99,
+};
+
+// Annex K.3: code counts per length 1-16, then symbols
+static const uint8_t kRTSPJPEGDCLumaBits[16] = {0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0};
+static const uint8_t kRTSPJPEGDCChromaBits[16] = {0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0};
+static const uint8_t kRTSPJPEGDCValues[12] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+
+static const uint8_t kRTSPJPEGACLumaBits[16] = {0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d};
+static const uint8_t kRTSPJPEGACLumaValues[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+    0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+    0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+    0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+    0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+    0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+    0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa,
+};
+
+static const uint8_t kRTSPJPEGACChromaBits[16] = {0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77};
+static const uint8_t kRTSPJPEGACChromaValues[162] = {
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+    0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+    0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+    0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+    0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+    0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+    0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+    0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa,
+};
+
+// cos(k * pi / 16) * sqrt(2), 1 for k = 0: the AAN DCT's output scale
+static const double kRTSPJPEGAANScale[8] = {
+    1.0, 1.387039845, 1.306562965, 1.175875602, 1.0, 0.785694958, 0.541196100, 0.275899379,
+};
+
+/// Zigzag position k → coefficient index in the transposed layout
+static const uint8_t kRTSPJPEGTransposedZigzag[64] = {
+     0,  8,  1,  2,  9, 16, 24, 17, 10,  3,  4, 11, 18, 25, 32, 40,
+    33, 26, 19, 12,  5,  6, 13, 20, 27, 34, 41, 48, 56, 49, 42, 35,
+    28, 21, 14,  7, 15, 22, 29, 36, 43, 50, 57, 58, 51, 44, 37, 30,
+    23, 31, 38, 45, 52, 59, 60, 53, 46, 39, 47, 54, 61, 62, 55, 63,
+};
+
+static void RTSPJPEGBuildHuffman(RTSPJPEGHuffmanTable *table, const uint8_t *bits, const uint8_t *values) {
+    memset(table, 0, sizeof(*table));
+    uint16_t code = 0;
+    unsigned k = 0;
+    for (unsigned length = 1; length <= 16; length++) {
+        for (unsigned i = 0; i < bits[length - 1]; i++, k++) {
+            table->code[values[k]] = code++;
+            table->size[values[k]] = (uint8_t)length;
+        }
+        code <<= 1;
+    }
+}
+
+#pragma mark - Forward DCT
+
+/// AAN butterfly over d[0..7], in place. The operations are functions so
+/// scalar and vector backends perform the same roundings in the same order.
+#define RTSP_JPEG_FDCT(T, ADD, SUB, MUL, SPLAT, d) do {                     \
+    T t0 = ADD(d[0], d[7]), t7 = SUB(d[0], d[7]);                           \
+    T t1 = ADD(d[1], d[6]), t6 = SUB(d[1], d[6]);                           \
+    T t2 = ADD(d[2], d[5]), t5 = SUB(d[2], d[5]);                           \
+    T t3 = ADD(d[3], d[4]), t4 = SUB(d[3], d[4]);                           \
+    T t10 = ADD(t0, t3), t13 = SUB(t0, t3);                                 \
+    T t11 = ADD(t1, t2), t12 = SUB(t1, t2);                                 \
+    d[0] = ADD(t10, t11);                                                   \
+    d[4] = SUB(t10, t11);                                                   \
+    T z1 = MUL(ADD(t12, t13), SPLAT(0.707106781f));                         \
+    d[2] = ADD(t13, z1);                                                    \
+    d[6] = SUB(t13, z1);                                                    \
+    t10 = ADD(t4, t5);                                                      \
+    t11 = ADD(t5, t6);                                                      \
+    t12 = ADD(t6, t7);                                                      \
+    T z5 = MUL(SUB(t10, t12), SPLAT(0.382683433f));                         \
+    T z2 = ADD(MUL(t10, SPLAT(0.541196100f)), z5);                          \
+    T z4 = ADD(MUL(t12, SPLAT(1.306562965f)), z5);                          \
+    T z3 = MUL(t11, SPLAT(0.707106781f));                                   \
+    T z11 = ADD(t7, z3), z13 = SUB(t7, z3);                                 \
+    d[5] = ADD(z13, z2);                                                    \
+    d[3] = SUB(z13, z2);                                                    \
+    d[1] = ADD(z11, z4);                                                    \
+    d[7] = SUB(z11, z4);                                                    \
+} while (0)
+
+// Rounds to nearest by truncating a positive value
+#define RTSP_JPEG_ROUND_BIAS 16384.5f
+#define RTSP_JPEG_ROUND_OFFSET 16384
+// Baseline coefficients fit in 11 bits
+#define RTSP_JPEG_MAX_COEFFICIENT 1023
+
+#pragma mark - Scalar
+
+static inline float RTSPJPEGAdd(float a, float b) { return a + b; }
+static inline float RTSPJPEGSub(float a, float b) { return a - b; }
+static inline float RTSPJPEGMul(float a, float b) { return a * b; }
+static inline float RTSPJPEGSplat(float a) { return a; }
+
+static void RTSPJPEGBlockScalar(const uint8_t *pixels, size_t stride, float level,
+                                const float *divisors, int16_t *coefficients) {
+    float m[64];
+    for (unsigned y = 0; y < 8; y++) {
+        for (unsigned x = 0; x < 8; x++) {
+            m[y * 8 + x] = (float)pixels[y * stride + x] - level;
+        }
+    }
+    for (unsigned x = 0; x < 8; x++) {
+        float d[8];
+        for (unsigned y = 0; y < 8; y++) {
+            d[y] = m[y * 8 + x];
+        }
+        RTSP_JPEG_FDCT(float, RTSPJPEGAdd, RTSPJPEGSub, RTSPJPEGMul, RTSPJPEGSplat, d);
+        for (unsigned u = 0; u < 8; u++) {
+            m[u * 8 + x] = d[u];
+        }
+    }
+    for (unsigned u = 0; u < 8; u++) {
+        float *d = m + u * 8;
+        RTSP_JPEG_FDCT(float, RTSPJPEGAdd, RTSPJPEGSub, RTSPJPEGMul, RTSPJPEGSplat, d);
+        for (unsigned v = 0; v < 8; v++) {
+            float scaled = d[v] * divisors[v * 8 + u];
+            // Clamping before rounding gives what the vector backends get clamping after
+            scaled = scaled < -RTSP_JPEG_MAX_COEFFICIENT ? -RTSP_JPEG_MAX_COEFFICIENT
+                   : scaled > RTSP_JPEG_MAX_COEFFICIENT ? RTSP_JPEG_MAX_COEFFICIENT : scaled;
+            coefficients[v * 8 + u] = (int16_t)((int)(scaled + RTSP_JPEG_ROUND_BIAS) - RTSP_JPEG_ROUND_OFFSET);
+        }
+    }
+}
+
+#pragma mark - SSE2 / AVX2
+
+#ifdef RTSP_JPEG_X86
+
+static void RTSPJPEGBlockSSE2(const uint8_t *pixels, size_t stride, float level,
+                              const float *divisors, int16_t *coefficients) {
+    // Rows as left and right halves
+    __m128 left[8];
+    __m128 right[8];
+    __m128i zero = _mm_setzero_si128();
+    __m128 levels = _mm_set1_ps(level);
+    for (unsigned y = 0; y < 8; y++) {
+        __m128i words = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(pixels + y * stride)), zero);
+        left[y] = _mm_sub_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(words, zero)), levels);
+        right[y] = _mm_sub_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(words, zero)), levels);
+    }
+    RTSP_JPEG_FDCT(__m128, _mm_add_ps, _mm_sub_ps, _mm_mul_ps, _mm_set1_ps, left);
+    RTSP_JPEG_FDCT(__m128, _mm_add_ps, _mm_sub_ps, _mm_mul_ps, _mm_set1_ps, right);
+
+    // Transpose as four 4x4 quadrants: column x becomes vector x
+    _MM_TRANSPOSE4_PS(left[0], left[1], left[2], left[3]);
+    _MM_TRANSPOSE4_PS(left[4], left[5], left[6], left[7]);
+    _MM_TRANSPOSE4_PS(right[0], right[1], right[2], right[3]);
+    _MM_TRANSPOSE4_PS(right[4], right[5], right[6], right[7]);
+    __m128 top[8] = {left[0], left[1], left[2], left[3], right[0], right[1], right[2], right[3]};
+    __m128 bottom[8] = {left[4], left[5], left[6], left[7], right[4], right[5], right[6], right[7]};
+    RTSP_JPEG_FDCT(__m128, _mm_add_ps, _mm_sub_ps, _mm_mul_ps, _mm_set1_ps, top);
+    RTSP_JPEG_FDCT(__m128, _mm_add_ps, _mm_sub_ps, _mm_mul_ps, _mm_set1_ps, bottom);
+
+    __m128 bias = _mm_set1_ps(RTSP_JPEG_ROUND_BIAS);
+    __m128i offset = _mm_set1_epi32(RTSP_JPEG_ROUND_OFFSET);
+    __m128i high = _mm_set1_epi16(RTSP_JPEG_MAX_COEFFICIENT), low = _mm_set1_epi16(-RTSP_JPEG_MAX_COEFFICIENT);
+    for (unsigned v = 0; v < 8; v++) {
+        __m128 a = _mm_add_ps(_mm_mul_ps(top[v], _mm_loadu_ps(divisors + v * 8)), bias);
+        __m128 b = _mm_add_ps(_mm_mul_ps(bottom[v], _mm_loadu_ps(divisors + v * 8 + 4)), bias);
+        __m128i packed = _mm_packs_epi32(_mm_sub_epi32(_mm_cvttps_epi32(a), offset),
+                                         _mm_sub_epi32(_mm_cvttps_epi32(b), offset));
+        packed = _mm_max_epi16(_mm_min_epi16(packed, high), low);
+        _mm_storeu_si128((__m128i *)(coefficients + v * 8), packed);
+    }
+}
+
+__attribute__((target("avx2")))
+static void RTSPJPEGBlockAVX2(const uint8_t *pixels, size_t stride, float level,
+                              const float *divisors, int16_t *coefficients) {
+    __m256 r[8];
+    __m256 levels = _mm256_set1_ps(level);
+    for (unsigned y = 0; y < 8; y++) {
+        __m256i words = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(pixels + y * stride)));
+        r[y] = _mm256_sub_ps(_mm256_cvtepi32_ps(words), levels);
+    }
+    RTSP_JPEG_FDCT(__m256, _mm256_add_ps, _mm256_sub_ps, _mm256_mul_ps, _mm256_set1_ps, r);
+
+    __m256 t0 = _mm256_unpacklo_ps(r[0], r[1]), t1 = _mm256_unpackhi_ps(r[0], r[1]);
+    __m256 t2 = _mm256_unpacklo_ps(r[2], r[3]), t3 = _mm256_unpackhi_ps(r[2], r[3]);
+    __m256 t4 = _mm256_unpacklo_ps(r[4], r[5]), t5 = _mm256_unpackhi_ps(r[4], r[5]);
+    __m256 t6 = _mm256_unpacklo_ps(r[6], r[7]), t7 = _mm256_unpackhi_ps(r[6], r[7]);
+    __m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+    __m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+    __m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+    __m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+    r[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+    r[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+    r[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+    r[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+    r[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+    r[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+    r[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+    r[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+    RTSP_JPEG_FDCT(__m256, _mm256_add_ps, _mm256_sub_ps, _mm256_mul_ps, _mm256_set1_ps, r);
+
+    __m256 bias = _mm256_set1_ps(RTSP_JPEG_ROUND_BIAS);
+    __m256i offset = _mm256_set1_epi32(RTSP_JPEG_ROUND_OFFSET);
+    __m128i high = _mm_set1_epi16(RTSP_JPEG_MAX_COEFFICIENT), low = _mm_set1_epi16(-RTSP_JPEG_MAX_COEFFICIENT);
+    for (unsigned v = 0; v < 8; v++) {
+        __m256 scaled = _mm256_add_ps(_mm256_mul_ps(r[v], _mm256_loadu_ps(divisors + v * 8)), bias);
+        __m256i values = _mm256_sub_epi32(_mm256_cvttps_epi32(scaled), offset);
+        __m128i packed = _mm_packs_epi32(_mm256_castsi256_si128(values), _mm256_extracti128_si256(values, 1));
+        packed = _mm_max_epi16(_mm_min_epi16(packed, high), low);
+        _mm_storeu_si128((__m128i *)(coefficients + v * 8), packed);
+    }
+}
+
+static bool RTSPJPEGCPUHasAVX2(void) {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+#endif
+
+#pragma mark - NEON
+
+#ifdef RTSP_JPEG_NEON
+
+static inline void RTSPJPEGTransposeNEON(float32x4_t *a, float32x4_t *b, float32x4_t *c, float32x4_t *d) {
+    float32x4_t t0 = vtrn1q_f32(*a, *b), t1 = vtrn2q_f32(*a, *b);
+    float32x4_t t2 = vtrn1q_f32(*c, *d), t3 = vtrn2q_f32(*c, *d);
+    *a = vreinterpretq_f32_f64(vtrn1q_f64(vreinterpretq_f64_f32(t0), vreinterpretq_f64_f32(t2)));
+    *b = vreinterpretq_f32_f64(vtrn1q_f64(vreinterpretq_f64_f32(t1), vreinterpretq_f64_f32(t3)));
+    *c = vreinterpretq_f32_f64(vtrn2q_f64(vreinterpretq_f64_f32(t0), vreinterpretq_f64_f32(t2)));
+    *d = vreinterpretq_f32_f64(vtrn2q_f64(vreinterpretq_f64_f32(t1), vreinterpretq_f64_f32(t3)));
+}
+
+static void RTSPJPEGBlockNEON(const uint8_t *pixels, size_t stride, float level,
+                              const float *divisors, int16_t *coefficients) {
+    float32x4_t left[8];
+    float32x4_t right[8];
+    float32x4_t levels = vdupq_n_f32(level);
+    for (unsigned y = 0; y < 8; y++) {
+        uint16x8_t words = vmovl_u8(vld1_u8(pixels + y * stride));
+        left[y] = vsubq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(words))), levels);
+        right[y] = vsubq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(words))), levels);
+    }
+    RTSP_JPEG_FDCT(float32x4_t, vaddq_f32, vsubq_f32, vmulq_f32, vdupq_n_f32, left);
+    RTSP_JPEG_FDCT(float32x4_t, vaddq_f32, vsubq_f32, vmulq_f32, vdupq_n_f32, right);
+
+    RTSPJPEGTransposeNEON(&left[0], &left[1], &left[2], &left[3]);
+    RTSPJPEGTransposeNEON(&left[4], &left[5], &left[6], &left[7]);
+    RTSPJPEGTransposeNEON(&right[0], &right[1], &right[2], &right[3]);
+    RTSPJPEGTransposeNEON(&right[4], &right[5], &right[6], &right[7]);
+    float32x4_t top[8] = {left[0], left[1], left[2], left[3], right[0], right[1], right[2], right[3]};
+    float32x4_t bottom[8] = {left[4], left[5], left[6], left[7], right[4], right[5], right[6], right[7]};
+    RTSP_JPEG_FDCT(float32x4_t, vaddq_f32, vsubq_f32, vmulq_f32, vdupq_n_f32, top);
+    RTSP_JPEG_FDCT(float32x4_t, vaddq_f32, vsubq_f32, vmulq_f32, vdupq_n_f32, bottom);
+
+    float32x4_t bias = vdupq_n_f32(RTSP_JPEG_ROUND_BIAS);
+    int32x4_t offset = vdupq_n_s32(RTSP_JPEG_ROUND_OFFSET);
+    int16x8_t high = vdupq_n_s16(RTSP_JPEG_MAX_COEFFICIENT), low = vdupq_n_s16(-RTSP_JPEG_MAX_COEFFICIENT);
+    for (unsigned v = 0; v < 8; v++) {
+        float32x4_t a = vaddq_f32(vmulq_f32(top[v], vld1q_f32(divisors + v * 8)), bias);
+        float32x4_t b = vaddq_f32(vmulq_f32(bottom[v], vld1q_f32(divisors + v * 8 + 4)), bias);
+        int16x8_t packed = vcombine_s16(vqmovn_s32(vsubq_s32(vcvtq_s32_f32(a), offset)),
+                                        vqmovn_s32(vsubq_s32(vcvtq_s32_f32(b), offset)));
+        packed = vmaxq_s16(vminq_s16(packed, high), low);
+        vst1q_s16(coefficients + v * 8, packed);
+    }
+}
+
+#endif
+
+#pragma mark - Backend selection
+
+bool RTSPJPEGEncoderBackendAvailable(RTSPJPEGEncoderBackend backend) {
+    switch (backend) {
+        case RTSPJPEGEncoderBackendAuto:
+        case RTSPJPEGEncoderBackendScalar:
+            return true;
+#ifdef RTSP_JPEG_X86
+        case RTSPJPEGEncoderBackendSSE2:
+            return true;
+        case RTSPJPEGEncoderBackendAVX2:
+            return RTSPJPEGCPUHasAVX2();
+#endif
+#ifdef RTSP_JPEG_NEON
+        case RTSPJPEGEncoderBackendNEON:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+const char *RTSPJPEGEncoderBackendName(RTSPJPEGEncoderBackend backend) {
+    switch (backend) {
+        case RTSPJPEGEncoderBackendAuto:   return "auto";
+        case RTSPJPEGEncoderBackendScalar: return "scalar";
+        case RTSPJPEGEncoderBackendSSE2:   return "sse2";
+        case RTSPJPEGEncoderBackendAVX2:   return "avx2";
+        case RTSPJPEGEncoderBackendNEON:   return "neon";
+    }
+    return "unknown";
+}
+
+static RTSPJPEGEncoderBackend RTSPJPEGResolveBackend(RTSPJPEGEncoderBackend requested) {
+    if (requested != RTSPJPEGEncoderBackendAuto) {
+        return RTSPJPEGEncoderBackendAvailable(requested) ? requested : RTSPJPEGEncoderBackendScalar;
+    }
+#ifdef RTSP_JPEG_NEON
+    return RTSPJPEGEncoderBackendNEON;
+#elif defined(RTSP_JPEG_X86)
+    return RTSPJPEGCPUHasAVX2() ? RTSPJPEGEncoderBackendAVX2 : RTSPJPEGEncoderBackendSSE2;
+#else
+    return RTSPJPEGEncoderBackendScalar;
+#endif
+}
+
+static RTSPJPEGBlockFunction RTSPJPEGBlockFunctionForBackend(RTSPJPEGEncoderBackend backend) {
+    switch (backend) {
+#ifdef RTSP_JPEG_X86
+        case RTSPJPEGEncoderBackendSSE2: return RTSPJPEGBlockSSE2;
+        case RTSPJPEGEncoderBackendAVX2: return RTSPJPEGBlockAVX2;
+#endif
+#ifdef RTSP_JPEG_NEON
+        case RTSPJPEGEncoderBackendNEON: return RTSPJPEGBlockNEON;
+#endif
+        default: return RTSPJPEGBlockScalar;
+    }
+}
+
+#pragma mark - Lifecycle
+
+void RTSPJPEGEncoderConfigInit(RTSPJPEGEncoderConfig *config) {
+    config->quality = 80;
+    config->backend = RTSPJPEGEncoderBackendAuto;
+}
+
+RTSPJPEGEncoderRef RTSPJPEGEncoderCreate(const RTSPJPEGEncoderConfig *config) {
+    RTSPJPEGEncoderConfig defaults;
+    if (!config) {
+        RTSPJPEGEncoderConfigInit(&defaults);
+        config = &defaults;
+    }
+    RTSPJPEGEncoderRef encoder = calloc(1, sizeof(*encoder));
+    if (!encoder) {
+        return NULL;
+    }
+    encoder->backend = RTSPJPEGResolveBackend(config->backend);
+    encoder->blockFunction = RTSPJPEGBlockFunctionForBackend(encoder->backend);
+    RTSPJPEGBuildHuffman(&encoder->dc[0], kRTSPJPEGDCLumaBits, kRTSPJPEGDCValues);
+    RTSPJPEGBuildHuffman(&encoder->dc[1], kRTSPJPEGDCChromaBits, kRTSPJPEGDCValues);
+    RTSPJPEGBuildHuffman(&encoder->ac[0], kRTSPJPEGACLumaBits, kRTSPJPEGACLumaValues);
+    RTSPJPEGBuildHuffman(&encoder->ac[1], kRTSPJPEGACChromaBits, kRTSPJPEGACChromaValues);
+    RTSPJPEGEncoderSetQuality(encoder, config->quality);
+    return encoder;
+}
+
+void RTSPJPEGEncoderRelease(RTSPJPEGEncoderRef encoder) {
+    if (!encoder) {
+        return;
+    }
+    free(encoder->scratch);
+    free(encoder);
+}
+
+void RTSPJPEGEncoderSetQuality(RTSPJPEGEncoderRef encoder, uint32_t quality) {
+    if (!encoder) {
+        return;
+    }
+    quality = quality < 1 ? 1 : quality > 100 ? 100 : quality;
+    if (quality == encoder->quality) {
+        return;
+    }
+    encoder->quality = quality;
+    uint32_t scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+    // Video range stretches to full range by 255/219 (luma) and 255/224 (chroma)
+    const double stretch[2][2] = {{1.0, 1.0}, {255.0 / 219.0, 255.0 / 224.0}};
+    for (unsigned table = 0; table < 2; table++) {
+        const uint8_t *base = table == 0 ? kRTSPJPEGLumaQuantization : kRTSPJPEGChromaQuantization;
+        uint8_t natural[64];
+        for (unsigned i = 0; i < 64; i++) {
+            uint32_t value = (base[i] * scale + 50) / 100;
+            natural[i] = (uint8_t)(value < 1 ? 1 : value > 255 ? 255 : value);
+        }
+        for (unsigned k = 0; k < 64; k++) {
+            encoder->quantization[table][k] = natural[kRTSPJPEGZigzag[k]];
+        }
+        for (unsigned u = 0; u < 8; u++) {
+            for (unsigned v = 0; v < 8; v++) {
+                double divisor = natural[u * 8 + v] * kRTSPJPEGAANScale[u] * kRTSPJPEGAANScale[v] * 8.0;
+                for (unsigned range = 0; range < 2; range++) {
+                    encoder->divisors[range][table][v * 8 + u] = (float)(stretch[range][table] / divisor);
+                }
+            }
+        }
+    }
+}
+
+RTSPJPEGEncoderBackend RTSPJPEGEncoderGetBackend(RTSPJPEGEncoderRef encoder) {
+    return encoder ? encoder->backend : RTSPJPEGEncoderBackendScalar;
+}
+
+#pragma mark - Entropy Coding
+
+typedef struct {
+    uint8_t *out;
+    uint64_t bits;
+    unsigned count;
+} RTSPJPEGBitWriter;
+
+static inline void RTSPJPEGPutBits(RTSPJPEGBitWriter *writer, uint32_t value, unsigned size) {
+    writer->bits = (writer->bits << size) | value;
+    writer->count += size;
+    if (writer->count >= 32) {
+        writer->count -= 32;
+        uint32_t word = (uint32_t)(writer->bits >> writer->count);
+        // No 0xFF byte, the common case: store all four without stuffing
+        if (!((~word - 0x01010101u) & word & 0x80808080u)) {
+            word = __builtin_bswap32(word);
+            memcpy(writer->out, &word, 4);
+            writer->out += 4;
+            return;
+        }
+        writer->count += 32;
+        for (unsigned i = 0; i < 4; i++) {
+            writer->count -= 8;
+            uint8_t byte = (uint8_t)(writer->bits >> writer->count);
+            *writer->out++ = byte;
+            if (byte == 0xFF) {
+                *writer->out++ = 0;
+            }
+        }
+    }
+}
+
+static void RTSPJPEGFlushBits(RTSPJPEGBitWriter *writer) {
+    unsigned pad = (8 - writer->count % 8) % 8;
+    writer->bits = (writer->bits << pad) | ((1u << pad) - 1);
+    writer->count += pad;
+    while (writer->count >= 8) {
+        writer->count -= 8;
+        uint8_t byte = (uint8_t)(writer->bits >> writer->count);
+        *writer->out++ = byte;
+        if (byte == 0xFF) {
+            *writer->out++ = 0;
+        }
+    }
+}
+
+static inline unsigned RTSPJPEGMagnitudeBits(int value) {
+    unsigned magnitude = (unsigned)(value < 0 ? -value : value);
+    return magnitude ? 32 - (unsigned)__builtin_clz(magnitude) : 0;
+}
+
+/// Bit k set where coefficient k is nonzero
+static inline uint64_t RTSPJPEGNonzeroMask(const int16_t *values) {
+#if defined(RTSP_JPEG_X86)
+    __m128i zero = _mm_setzero_si128();
+    uint64_t mask = 0;
+    for (unsigned i = 0; i < 4; i++) {
+        __m128i a = _mm_cmpeq_epi16(_mm_loadu_si128((const __m128i *)(values + i * 16)), zero);
+        __m128i b = _mm_cmpeq_epi16(_mm_loadu_si128((const __m128i *)(values + i * 16 + 8)), zero);
+        mask |= (uint64_t)(uint16_t)~_mm_movemask_epi8(_mm_packs_epi16(a, b)) << (i * 16);
+    }
+    return mask;
+#elif defined(RTSP_JPEG_NEON)
+    static const uint8_t weights[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+    uint8x16_t weight = vld1q_u8(weights);
+    uint64_t mask = 0;
+    for (unsigned i = 0; i < 4; i++) {
+        uint16x8_t a = vtstq_s16(vld1q_s16(values + i * 16), vld1q_s16(values + i * 16));
+        uint16x8_t b = vtstq_s16(vld1q_s16(values + i * 16 + 8), vld1q_s16(values + i * 16 + 8));
+        uint8x16_t bits = vandq_u8(vcombine_u8(vmovn_u16(a), vmovn_u16(b)), weight);
+        uint64_t low = vaddv_u8(vget_low_u8(bits)), high = vaddv_u8(vget_high_u8(bits));
+        mask |= (low | high << 8) << (i * 16);
+    }
+    return mask;
+#else
+    uint64_t mask = 0;
+    for (unsigned k = 0; k < 64; k++) {
+        mask |= (uint64_t)(values[k] != 0) << k;
+    }
+    return mask;
+#endif
+}
+
+/// Quantizes, reorders and codes one block
+static void RTSPJPEGEncodeBlock(RTSPJPEGEncoderRef encoder, RTSPJPEGBitWriter *writer, const uint8_t *pixels,
+                                size_t stride, float level, const float *divisors, unsigned table, int *lastDC) {
+    int16_t transposed[64];
+    encoder->blockFunction(pixels, stride, level, divisors, transposed);
+
+    // Zigzag order, with a mask of nonzero AC
+    int16_t zigzag[64];
+    for (unsigned k = 0; k < 64; k++) {
+        zigzag[k] = transposed[kRTSPJPEGTransposedZigzag[k]];
+    }
+    uint64_t mask = RTSPJPEGNonzeroMask(zigzag);
+
+    const RTSPJPEGHuffmanTable *dc = &encoder->dc[table];
+    const RTSPJPEGHuffmanTable *ac = &encoder->ac[table];
+    int difference = zigzag[0] - *lastDC;
+    *lastDC = zigzag[0];
+    unsigned size = RTSPJPEGMagnitudeBits(difference);
+    uint32_t bits = (uint32_t)(difference < 0 ? difference - 1 : difference) & ((1u << size) - 1);
+    RTSPJPEGPutBits(writer, ((uint32_t)dc->code[size] << size) | bits, dc->size[size] + size);
+
+    mask >>= 1;
+    unsigned k = 0;
+    while (mask) {
+        unsigned run = (unsigned)__builtin_ctzll(mask);
+        k += run + 1;
+        mask = (mask >> run) >> 1;
+        while (run > 15) {
+            RTSPJPEGPutBits(writer, ac->code[0xF0], ac->size[0xF0]);
+            run -= 16;
+        }
+        int value = zigzag[k];
+        size = RTSPJPEGMagnitudeBits(value);
+        bits = (uint32_t)(value < 0 ? value - 1 : value) & ((1u << size) - 1);
+        unsigned symbol = (run << 4) | size;
+        RTSPJPEGPutBits(writer, ((uint32_t)ac->code[symbol] << size) | bits, ac->size[symbol] + size);
+    }
+    if (k < 63) {
+        RTSPJPEGPutBits(writer, ac->code[0x00], ac->size[0x00]);
+    }
+}
+
+#pragma mark - Encoding
+
+static void RTSPJPEGAppendMarker(RTSPByteBuffer *output, uint8_t marker, uint16_t length) {
+    RTSPByteBufferAppendU8(output, 0xFF);
+    RTSPByteBufferAppendU8(output, marker);
+    RTSPByteBufferAppendU16(output, length);
+}
+
+static void RTSPJPEGAppendHuffman(RTSPByteBuffer *output, uint8_t tableClass, const uint8_t *bits,
+                                  const uint8_t *values) {
+    size_t count = 0;
+    for (unsigned i = 0; i < 16; i++) {
+        count += bits[i];
+    }
+    RTSPByteBufferAppendU8(output, tableClass);
+    RTSPByteBufferAppend(output, bits, 16);
+    RTSPByteBufferAppend(output, values, count);
+}
+
+static void RTSPJPEGAppendHeaders(RTSPJPEGEncoderRef encoder, const RTSPJPEGImage *image, RTSPByteBuffer *output) {
+    static const uint8_t jfif[] = {'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0};
+    RTSPByteBufferAppendU16(output, 0xFFD8);
+    RTSPJPEGAppendMarker(output, 0xE0, 2 + sizeof(jfif));
+    RTSPByteBufferAppend(output, jfif, sizeof(jfif));
+
+    RTSPJPEGAppendMarker(output, 0xDB, 2 + 2 * 65);
+    for (unsigned table = 0; table < 2; table++) {
+        RTSPByteBufferAppendU8(output, (uint8_t)table);
+        RTSPByteBufferAppend(output, encoder->quantization[table], 64);
+    }
+
+    // Y at 2x2, Cb and Cr at 1x1: 4:2:0
+    RTSPJPEGAppendMarker(output, 0xC0, 17);
+    RTSPByteBufferAppendU8(output, 8);
+    RTSPByteBufferAppendU16(output, (uint16_t)image->height);
+    RTSPByteBufferAppendU16(output, (uint16_t)image->width);
+    RTSPByteBufferAppendU8(output, 3);
+    const uint8_t components[9] = {1, 0x22, 0, 2, 0x11, 1, 3, 0x11, 1};
+    RTSPByteBufferAppend(output, components, sizeof(components));
+
+    RTSPJPEGAppendMarker(output, 0xC4, 2 + 2 * (17 + 12) + 2 * (17 + 162));
+    RTSPJPEGAppendHuffman(output, 0x00, kRTSPJPEGDCLumaBits, kRTSPJPEGDCValues);
+    RTSPJPEGAppendHuffman(output, 0x10, kRTSPJPEGACLumaBits, kRTSPJPEGACLumaValues);
+    RTSPJPEGAppendHuffman(output, 0x01, kRTSPJPEGDCChromaBits, kRTSPJPEGDCValues);
+    RTSPJPEGAppendHuffman(output, 0x11, kRTSPJPEGACChromaBits, kRTSPJPEGACChromaValues);
+
+    RTSPJPEGAppendMarker(output, 0xDA, 12);
+    const uint8_t scan[10] = {3, 1, 0x00, 2, 0x11, 3, 0x11, 0, 63, 0};
+    RTSPByteBufferAppend(output, scan, sizeof(scan));
+}
+
+/// Copies one MCU row into the scratch rows, repeating the last column and
+/// line into the padding, and splits the chroma
+static void RTSPJPEGLoadRows(RTSPJPEGEncoderRef encoder, const RTSPJPEGImage *image, uint32_t mcuRow,
+                             uint32_t paddedWidth) {
+    uint8_t *luma = encoder->scratch;
+    for (uint32_t i = 0; i < 16; i++) {
+        uint32_t y = mcuRow * 16 + i;
+        y = y < image->height ? y : image->height - 1;
+        uint8_t *row = luma + (size_t)i * paddedWidth;
+        memcpy(row, image->luma + y * image->lumaBytesPerRow, image->width);
+        memset(row + image->width, row[image->width - 1], paddedWidth - image->width);
+    }
+
+    uint32_t chromaWidth = (image->width + 1) / 2;
+    uint32_t chromaHeight = (image->height + 1) / 2;
+    uint32_t paddedChroma = paddedWidth / 2;
+    uint8_t *cb = luma + (size_t)16 * paddedWidth;
+    uint8_t *cr = cb + (size_t)8 * paddedChroma;
+    for (uint32_t i = 0; i < 8; i++) {
+        uint32_t y = mcuRow * 8 + i;
+        y = y < chromaHeight ? y : chromaHeight - 1;
+        const uint8_t *source = image->chroma + y * image->chromaBytesPerRow;
+        uint8_t *cbRow = cb + (size_t)i * paddedChroma;
+        uint8_t *crRow = cr + (size_t)i * paddedChroma;
+        for (uint32_t x = 0; x < chromaWidth; x++) {
+            cbRow[x] = source[2 * x];
+            crRow[x] = source[2 * x + 1];
+        }
+        memset(cbRow + chromaWidth, cbRow[chromaWidth - 1], paddedChroma - chromaWidth);
+        memset(crRow + chromaWidth, crRow[chromaWidth - 1], paddedChroma - chromaWidth);
+    }
+}
+
+bool RTSPJPEGEncoderEncode(RTSPJPEGEncoderRef encoder, const RTSPJPEGImage *image, RTSPByteBuffer *output) {
+    if (!encoder || !image || !output || !image->luma || !image->chroma || image->width == 0 ||
+        image->height == 0 || image->width > RTSP_JPEG_MAX_DIMENSION || image->height > RTSP_JPEG_MAX_DIMENSION) {
+        return false;
+    }
+    uint32_t mcuColumns = (image->width + 15) / 16;
+    uint32_t mcuRows = (image->height + 15) / 16;
+    uint32_t paddedWidth = mcuColumns * 16;
+    size_t scratchBytes = (size_t)paddedWidth * 16 + (size_t)paddedWidth / 2 * 16;
+    if (scratchBytes > encoder->scratchCapacity) {
+        uint8_t *scratch = realloc(encoder->scratch, scratchBytes);
+        if (!scratch) {
+            return false;
+        }
+        encoder->scratch = scratch;
+        encoder->scratchCapacity = scratchBytes;
+    }
+
+    size_t start = output->length;
+    RTSPJPEGAppendHeaders(encoder, image, output);
+    const float (*divisors)[64] = encoder->divisors[image->videoRange ? 1 : 0];
+    // Level shift, and for video range the black level, subtracted before the DCT
+    float lumaLevel = image->videoRange ? 16.0f + 128.0f * 219.0f / 255.0f : 128.0f;
+    float chromaLevel = 128.0f;
+    size_t paddedChroma = paddedWidth / 2;
+    const uint8_t *luma = encoder->scratch;
+    const uint8_t *cb = luma + (size_t)16 * paddedWidth;
+    const uint8_t *cr = cb + 8 * paddedChroma;
+
+    RTSPJPEGBitWriter writer = {0};
+    int lastDC[3] = {0, 0, 0};
+    for (uint32_t row = 0; row < mcuRows; row++) {
+        if (!RTSPByteBufferReserve(output, (size_t)mcuColumns * RTSP_JPEG_MCU_BYTES + 16)) {
+            output->length = start;
+            return false;
+        }
+        RTSPJPEGLoadRows(encoder, image, row, paddedWidth);
+        writer.out = output->data + output->length;
+        for (uint32_t column = 0; column < mcuColumns; column++) {
+            const uint8_t *block = luma + column * 16;
+            RTSPJPEGEncodeBlock(encoder, &writer, block, paddedWidth, lumaLevel, divisors[0], 0, &lastDC[0]);
+            RTSPJPEGEncodeBlock(encoder, &writer, block + 8, paddedWidth, lumaLevel, divisors[0], 0, &lastDC[0]);
+            block += (size_t)8 * paddedWidth;
+            RTSPJPEGEncodeBlock(encoder, &writer, block, paddedWidth, lumaLevel, divisors[0], 0, &lastDC[0]);
+            RTSPJPEGEncodeBlock(encoder, &writer, block + 8, paddedWidth, lumaLevel, divisors[0], 0, &lastDC[0]);
+            RTSPJPEGEncodeBlock(encoder, &writer, cb + column * 8, paddedChroma, chromaLevel, divisors[1], 1,
+                                &lastDC[1]);
+            RTSPJPEGEncodeBlock(encoder, &writer, cr + column * 8, paddedChroma, chromaLevel, divisors[1], 1,
+                                &lastDC[2]);
+        }
+        output->length = (size_t)(writer.out - output->data);
+    }
+    if (!RTSPByteBufferReserve(output, 32)) {
+        output->length = start;
+        return false;
+    }
+    writer.out = output->data + output->length;
+    RTSPJPEGFlushBits(&writer);
+    output->length = (size_t)(writer.out - output->data);
+    RTSPByteBufferAppendU16(output, 0xFFD9);
+    if (output->failed) {
+        output->length = start;
+        return false;
+    }
+    return true;
+}
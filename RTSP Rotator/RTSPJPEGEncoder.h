@@ -0,0 +1,81 @@
+//
+//  RTSPJPEGEncoder.h
+//  RTSP Rotator
+//
+//  Baseline JPEG (JFIF, 4:2:0) straight from NV12 planes, the layout the
+//  decoder hands out: the planes already are YCbCr at the right
+//  subsampling, so there is no color conversion, and video-range samples
+//  are stretched to full range inside the quantizer rather than per pixel.
+//
+//  Forward DCT and quantization have SSE2 / AVX2 / NEON paths and a scalar
+//  fallback doing the same float operations in the same order, so every
+//  backend writes the same bytes. Huffman coding uses the Annex K tables.
+//
+//  An encoder keeps its tables and scratch rows between frames; make one
+//  per thread and reuse it. See Benchmarks/snapshot_bench.c.
+//
+
+#ifndef RTSPJPEGEncoder_h
+#define RTSPJPEGEncoder_h
+
+#include "RTSPByteBuffer.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    RTSPJPEGEncoderBackendAuto = 0,     // Best backend supported by the running CPU
+    RTSPJPEGEncoderBackendScalar,
+    RTSPJPEGEncoderBackendSSE2,
+    RTSPJPEGEncoderBackendAVX2,
+    RTSPJPEGEncoderBackendNEON
+} RTSPJPEGEncoderBackend;
+
+typedef struct {
+    uint32_t quality;                   // 1-100, IJG scaling of the Annex K tables. Default 80
+    RTSPJPEGEncoderBackend backend;     // Default Auto
+} RTSPJPEGEncoderConfig;
+
+void RTSPJPEGEncoderConfigInit(RTSPJPEGEncoderConfig *config);
+
+/// One NV12 frame. Odd sizes are fine; edges are padded by repetition.
+typedef struct {
+    const uint8_t *luma;
+    size_t lumaBytesPerRow;
+    const uint8_t *chroma;              // Cb, Cr interleaved at half width and height
+    size_t chromaBytesPerRow;
+    uint32_t width;
+    uint32_t height;
+    bool videoRange;                    // Y 16-235, CbCr 16-240 ('420v'); false for full range ('420f')
+} RTSPJPEGImage;
+
+typedef struct RTSPJPEGEncoder *RTSPJPEGEncoderRef;
+
+/// Returns NULL on allocation failure. `config` may be NULL for defaults.
+RTSPJPEGEncoderRef RTSPJPEGEncoderCreate(const RTSPJPEGEncoderConfig *config);
+
+void RTSPJPEGEncoderRelease(RTSPJPEGEncoderRef encoder);
+
+/// Rebuilds the quantization tables; a no-op when unchanged
+void RTSPJPEGEncoderSetQuality(RTSPJPEGEncoderRef encoder, uint32_t quality);
+
+/// Appends a complete JFIF file. False for an empty or oversized (> 65535)
+/// image or when the buffer cannot grow; the output is left as it was.
+bool RTSPJPEGEncoderEncode(RTSPJPEGEncoderRef encoder, const RTSPJPEGImage *image, RTSPByteBuffer *output);
+
+RTSPJPEGEncoderBackend RTSPJPEGEncoderGetBackend(RTSPJPEGEncoderRef encoder);
+
+bool RTSPJPEGEncoderBackendAvailable(RTSPJPEGEncoderBackend backend);
+
+const char *RTSPJPEGEncoderBackendName(RTSPJPEGEncoderBackend backend);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RTSPJPEGEncoder_h */
@@ -0,0 +1,68 @@
+//
+//  RTSPJPEGFrameCache.h
+//  RTSP Rotator
+//
+//  Latest JPEG-encoded frame per camera, shared by every snapshot request
+//  and MJPEG viewer. Frames come from the camera's RTSPFrameBus at a fixed
+//  rate and are encoded once each, on the hardware JPEG encoder through
+//  VideoToolbox (ImageIO when that is unavailable), so N viewers cost one
+//  encode. The tap runs only while something is asking for frames.
+//
+
+#import <Foundation/Foundation.h>
+#import <CoreGraphics/CoreGraphics.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// One encoded frame, immutable and shared
+@interface RTSPEncodedFrame : NSObject
+
+@property (nonatomic, readonly) NSData *data;                 // JPEG (JFIF) bytes
+@property (nonatomic, readonly) uint64_t sequenceNumber;      // RTSPDecodedFrame it was encoded from
+@property (nonatomic, readonly) CFTimeInterval hostTime;      // Capture time of that frame
+@property (nonatomic, readonly) size_t width;
+@property (nonatomic, readonly) size_t height;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+@end
+
+/// Called on the cache's queue with each new frame, and with nil about once
+/// a second while there is none. Return NO to stop receiving frames.
+typedef BOOL (^RTSPJPEGFrameConsumer)(RTSPEncodedFrame * _Nullable frame);
+
+@interface RTSPJPEGFrameCache : NSObject
+
+/// Shared cache for a feed URL (RTSPS feeds are matched to their local
+/// proxy stream)
++ (instancetype)cacheForURL:(NSURL *)url;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+@property (nonatomic, readonly) NSURL *url;
+
+/// Most frames encoded per second, applied when the tap starts (default: 10)
+@property (nonatomic, assign) double framesPerSecond;
+
+/// JPEG quality, 0.0-1.0 (default: 0.7)
+@property (nonatomic, assign) double quality;
+
+/// Whether the camera is currently playing in some player
+@property (nonatomic, readonly) BOOL isAvailable;
+
+/**
+ * The latest frame, if it was captured within maxAge; otherwise waits up to
+ * timeout for the next one. Blocks, so call it off the main thread. Returns
+ * nil if the camera is not playing or no frame arrived in time.
+ */
+- (nullable RTSPEncodedFrame *)frameWithMaximumAge:(NSTimeInterval)maxAge timeout:(NSTimeInterval)timeout;
+
+/// Receive every encoded frame until the consumer returns NO
+- (void)addConsumer:(RTSPJPEGFrameConsumer)consumer;
+
+/// Statistics: framesEncoded, bytesEncoded, consumers, hardwareEncoder
+- (NSDictionary<NSString *, NSNumber *> *)statistics;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,315 @@
+//
+//  RTSPJPEGFrameCache.m
+//  RTSP Rotator
+//
+
+#import "RTSPJPEGFrameCache.h"
+#import "RTSPFrameBus.h"
+#import "RTSPFFmpegProxy.h"
+#import <ImageIO/ImageIO.h>
+#import <QuartzCore/QuartzCore.h>
+#import <UniformTypeIdentifiers/UniformTypeIdentifiers.h>
+#import <VideoToolbox/VideoToolbox.h>
+
+static const NSTimeInterval kRTSPJPEGFrameCacheLinger = 5.0;     // Tap stays up this long after a snapshot
+static const NSTimeInterval kRTSPJPEGFrameCacheTick = 1.0;
+
+#pragma mark - RTSPEncodedFrame
+
+@implementation RTSPEncodedFrame
+
+- (instancetype)initWithData:(NSData *)data frame:(RTSPDecodedFrame *)frame {
+    self = [super init];
+    if (self) {
+        _data = data;
+        _sequenceNumber = frame.sequenceNumber;
+        _hostTime = frame.hostTime;
+        _width = frame.width;
+        _height = frame.height;
+    }
+    return self;
+}
+
+@end
+
+#pragma mark - RTSPJPEGFrameCache
+
+@interface RTSPJPEGFrameCache ()
+@property (nonatomic, strong) NSURL *url;
+@property (nonatomic, strong) dispatch_queue_t queue;        // Tap, consumers and encoder
+@property (nonatomic, strong) NSCondition *condition;        // Guards latestFrame for waiting snapshots
+@property (nonatomic, strong, nullable) RTSPEncodedFrame *latestFrame;
+@property (nonatomic, strong, nullable) RTSPFrameBus *bus;
+@property (nonatomic, strong, nullable) id<NSObject> busToken;
+@property (nonatomic, strong, nullable) dispatch_source_t tickTimer;
+@property (nonatomic, strong) NSMutableArray<RTSPJPEGFrameConsumer> *consumers;
+@property (nonatomic, assign) CFTimeInterval demandUntil;
+@end
+
+@implementation RTSPJPEGFrameCache {
+    VTCompressionSessionRef _session;
+    int32_t _sessionWidth;
+    int32_t _sessionHeight;
+    double _sessionQuality;
+    BOOL _hardwareUnavailable;
+    __weak RTSPFrameBus *_latestSource;
+    uint64_t _framesEncoded;
+    uint64_t _bytesEncoded;
+}
+
++ (instancetype)cacheForURL:(NSURL *)url {
+    static NSMutableDictionary<NSURL *, RTSPJPEGFrameCache *> *caches;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        caches = [NSMutableDictionary dictionary];
+    });
+    @synchronized (caches) {
+        RTSPJPEGFrameCache *cache = caches[url];
+        if (!cache) {
+            cache = [[RTSPJPEGFrameCache alloc] initWithURL:url];
+            caches[url] = cache;
+        }
+        return cache;
+    }
+}
+
+- (instancetype)initWithURL:(NSURL *)url {
+    self = [super init];
+    if (self) {
+        _url = url;
+        _framesPerSecond = 10.0;
+        _quality = 0.7;
+        _queue = dispatch_queue_create("com.rtsp.jpegcache", DISPATCH_QUEUE_SERIAL);
+        _condition = [[NSCondition alloc] init];
+        _consumers = [NSMutableArray array];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [self invalidateSession];
+}
+
+#pragma mark - Frames
+
+- (nullable RTSPFrameBus *)playingBus {
+    RTSPFrameBus *bus = [RTSPFrameBus busPlayingURL:self.url];
+    if (!bus && [self.url.scheme.lowercaseString isEqualToString:@"rtsps"]) {
+        NSURL *localURL = [[RTSPFFmpegProxy sharedProxy] localURLForRTSPSURL:self.url];
+        bus = localURL ? [RTSPFrameBus busPlayingURL:localURL] : nil;
+    }
+    return bus;
+}
+
+- (BOOL)isAvailable {
+    return [self playingBus] != nil;
+}
+
+- (RTSPEncodedFrame *)frameWithMaximumAge:(NSTimeInterval)maxAge timeout:(NSTimeInterval)timeout {
+    // Clients polling for snapshots keep the tap warm between requests
+    dispatch_async(self.queue, ^{
+        self.demandUntil = CACurrentMediaTime() + kRTSPJPEGFrameCacheLinger;
+        [self updateTap];
+    });
+
+    // Concurrent snapshots all wait for the same encode
+    NSDate *deadline = [NSDate dateWithTimeIntervalSinceNow:timeout];
+    RTSPEncodedFrame *frame = nil;
+    [self.condition lock];
+    for (;;) {
+        frame = self.latestFrame;
+        if (frame && CACurrentMediaTime() - frame.hostTime <= maxAge) {
+            break;
+        }
+        if (![self.condition waitUntilDate:deadline]) {
+            frame = nil;
+            break;
+        }
+    }
+    [self.condition unlock];
+    return frame;
+}
+
+- (void)addConsumer:(RTSPJPEGFrameConsumer)consumer {
+    dispatch_async(self.queue, ^{
+        [self.consumers addObject:[consumer copy]];
+        [self updateTap];
+    });
+}
+
+/// Queue only. Keeps the bus subscription pointed at whichever player is
+/// showing the camera, and drops it once nobody is asking.
+- (void)updateTap {
+    BOOL wanted = self.consumers.count > 0 || CACurrentMediaTime() < self.demandUntil;
+    RTSPFrameBus *bus = wanted ? [self playingBus] : nil;
+
+    if (bus != self.bus) {
+        if (self.busToken) {
+            [self.bus removeSubscriber:self.busToken];
+        }
+        self.bus = bus;
+        self.busToken = nil;
+        if (bus) {
+            __weak typeof(self) weakSelf = self;
+            __weak RTSPFrameBus *weakBus = bus;
+            self.busToken = [bus addSubscriberWithRate:self.framesPerSecond queue:self.queue handler:^(RTSPDecodedFrame *frame) {
+                [weakSelf encodeFrame:frame fromBus:weakBus];
+            }];
+        }
+    }
+
+    if (wanted && !self.tickTimer) {
+        self.tickTimer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, self.queue);
+        __weak typeof(self) weakSelf = self;
+        dispatch_source_set_event_handler(self.tickTimer, ^{
+            [weakSelf tick];
+        });
+        uint64_t interval = (uint64_t)(kRTSPJPEGFrameCacheTick * NSEC_PER_SEC);
+        dispatch_source_set_timer(self.tickTimer, dispatch_time(DISPATCH_TIME_NOW, (int64_t)interval), interval, interval / 10);
+        dispatch_resume(self.tickTimer);
+    } else if (!wanted && self.tickTimer) {
+        dispatch_source_cancel(self.tickTimer);
+        self.tickTimer = nil;
+        [self invalidateSession];
+    }
+}
+
+- (void)tick {
+    // Consumers also get a chance to leave while the camera is not playing
+    [self deliverFrame:nil];
+    [self updateTap];
+}
+
+- (void)deliverFrame:(nullable RTSPEncodedFrame *)frame {
+    NSIndexSet *finished = [self.consumers indexesOfObjectsPassingTest:^BOOL(RTSPJPEGFrameConsumer consumer, NSUInteger index, BOOL *stop) {
+        return !consumer(frame);
+    }];
+    [self.consumers removeObjectsAtIndexes:finished];
+}
+
+- (void)encodeFrame:(RTSPDecodedFrame *)frame fromBus:(RTSPFrameBus *)bus {
+    // The player may have rotated to another camera since the last tick
+    if (!bus || bus != self.bus || [self playingBus] != bus) {
+        [self updateTap];
+        return;
+    }
+    if (bus == _latestSource && frame.sequenceNumber == self.latestFrame.sequenceNumber) {
+        return;
+    }
+
+    NSData *data = [self encodePixelBuffer:frame.pixelBuffer] ?: [self encodeWithImageIO:frame];
+    if (!data) {
+        return;
+    }
+    RTSPEncodedFrame *encoded = [[RTSPEncodedFrame alloc] initWithData:data frame:frame];
+    _latestSource = bus;
+    _framesEncoded++;
+    _bytesEncoded += data.length;
+
+    [self.condition lock];
+    self.latestFrame = encoded;
+    [self.condition broadcast];
+    [self.condition unlock];
+
+    [self deliverFrame:encoded];
+}
+
+#pragma mark - Encoding
+
+/// Hardware JPEG straight from the decoder's NV12 buffer: no RGB conversion
+- (nullable NSData *)encodePixelBuffer:(CVPixelBufferRef)pixelBuffer {
+    if (_hardwareUnavailable) {
+        return nil;
+    }
+    int32_t width = (int32_t)CVPixelBufferGetWidth(pixelBuffer);
+    int32_t height = (int32_t)CVPixelBufferGetHeight(pixelBuffer);
+    if (_session && (width != _sessionWidth || height != _sessionHeight)) {
+        [self invalidateSession];
+    }
+    if (!_session) {
+        OSStatus status = VTCompressionSessionCreate(kCFAllocatorDefault, width, height, kCMVideoCodecType_JPEG,
+                                                     NULL, NULL, NULL, NULL, NULL, &_session);
+        if (status != noErr) {
+            NSLog(@"[JPEGCache] Hardware JPEG encoder unavailable (%d); using ImageIO", (int)status);
+            _hardwareUnavailable = YES;
+            _session = NULL;
+            return nil;
+        }
+        _sessionWidth = width;
+        _sessionHeight = height;
+        _sessionQuality = -1;
+    }
+    if (_sessionQuality != self.quality) {
+        _sessionQuality = self.quality;
+        VTSessionSetProperty(_session, kVTCompressionPropertyKey_Quality, (__bridge CFNumberRef)@(_sessionQuality));
+    }
+
+    __block NSData *data = nil;
+    OSStatus status = VTCompressionSessionEncodeFrameWithOutputHandler(
+        _session, pixelBuffer, CMTimeMake((int64_t)_framesEncoded, 1000), kCMTimeInvalid, NULL, NULL,
+        ^(OSStatus encodeStatus, VTEncodeInfoFlags infoFlags, CMSampleBufferRef sampleBuffer) {
+            CMBlockBufferRef block = sampleBuffer ? CMSampleBufferGetDataBuffer(sampleBuffer) : NULL;
+            if (encodeStatus != noErr || !block) {
+                return;
+            }
+            size_t length = CMBlockBufferGetDataLength(block);
+            NSMutableData *bytes = [NSMutableData dataWithLength:length];
+            if (CMBlockBufferCopyDataBytes(block, 0, length, bytes.mutableBytes) == kCMBlockBufferNoErr) {
+                data = bytes;
+            }
+        });
+    if (status == noErr) {
+        VTCompressionSessionCompleteFrames(_session, kCMTimeInvalid);
+    }
+
+    const uint8_t *bytes = data.bytes;
+    if (data.length < 4 || bytes[0] != 0xFF || bytes[1] != 0xD8) {
+        NSLog(@"[JPEGCache] Hardware JPEG encode failed (%d); using ImageIO", (int)status);
+        _hardwareUnavailable = YES;
+        [self invalidateSession];
+        return nil;
+    }
+    return data;
+}
+
+- (nullable NSData *)encodeWithImageIO:(RTSPDecodedFrame *)frame {
+    CGImageRef image = [frame copyCGImage];
+    if (!image) {
+        return nil;
+    }
+    NSMutableData *data = [NSMutableData data];
+    CGImageDestinationRef destination = CGImageDestinationCreateWithData((__bridge CFMutableDataRef)data,
+                                                                         (__bridge CFStringRef)UTTypeJPEG.identifier, 1, NULL);
+    BOOL encoded = NO;
+    if (destination) {
+        NSDictionary *properties = @{(id)kCGImageDestinationLossyCompressionQuality: @(self.quality)};
+        CGImageDestinationAddImage(destination, image, (__bridge CFDictionaryRef)properties);
+        encoded = CGImageDestinationFinalize(destination);
+        CFRelease(destination);
+    }
+    CGImageRelease(image);
+    return encoded ? data : nil;
+}
+
+- (void)invalidateSession {
+    if (_session) {
+        VTCompressionSessionInvalidate(_session);
+        CFRelease(_session);
+        _session = NULL;
+    }
+}
+
+- (NSDictionary<NSString *, NSNumber *> *)statistics {
+    __block NSDictionary *stats = nil;
+    dispatch_sync(self.queue, ^{
+        stats = @{
+            @"framesEncoded": @(self->_framesEncoded),
+            @"bytesEncoded": @(self->_bytesEncoded),
+            @"consumers": @(self.consumers.count),
+            @"hardwareEncoder": @(!self->_hardwareUnavailable)
+        };
+    });
+    return stats;
+}
+
+@end
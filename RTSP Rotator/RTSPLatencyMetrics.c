@@ -0,0 +1,392 @@
+//
+//  RTSPLatencyMetrics.c
+//  RTSP Rotator
+//
+
+#include "RTSPLatencyMetrics.h"
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Values below 64 us get a bucket each; above, every power of two from 2^6
+// to 2^31 us is split into 32 buckets
+#define RTSP_LATENCY_LINEAR 64
+#define RTSP_LATENCY_SUB_BUCKETS 32
+#define RTSP_LATENCY_MAX_EXPONENT 31
+#define RTSP_LATENCY_BUCKETS (RTSP_LATENCY_LINEAR + (RTSP_LATENCY_MAX_EXPONENT - 5) * RTSP_LATENCY_SUB_BUCKETS)
+#define RTSP_LATENCY_MAX_MICROS ((UINT64_C(1) << (RTSP_LATENCY_MAX_EXPONENT + 1)) - 1)
+#define RTSP_LATENCY_NAME_LENGTH 128
+
+typedef struct {
+    _Atomic uint32_t buckets[RTSP_LATENCY_BUCKETS];
+    _Atomic uint64_t count;
+    _Atomic uint64_t sumMicros;
+    _Atomic uint64_t maxMicros;
+} RTSPLatencyHistogram;
+
+typedef struct {
+    char name[RTSP_LATENCY_NAME_LENGTH];
+    _Atomic uint64_t frames;            // Frames offered to ShouldTrace
+    RTSPLatencyHistogram stages[RTSPLatencyStageCount];
+} RTSPLatencyCamera;
+
+struct RTSPLatencyMetrics {
+    RTSPLatencyMetricsConfig config;
+    pthread_mutex_t lock;               // Guards adding cameras
+    _Atomic uint32_t cameraCount;
+    _Atomic(RTSPLatencyCamera *) *cameras;
+};
+
+static const char *const RTSPLatencyStageNames[RTSPLatencyStageCount] = {
+    "grab", "queue", "preprocess", "inference", "postprocess", "zone_filter", "alert_dispatch", "total",
+};
+
+// Prometheus histogram bucket bounds, seconds
+static const double RTSPLatencyPrometheusBounds[] = {
+    0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10,
+};
+
+const char *RTSPLatencyStageName(RTSPLatencyStage stage) {
+    return stage < RTSPLatencyStageCount ? RTSPLatencyStageNames[stage] : "unknown";
+}
+
+void RTSPLatencyMetricsConfigInit(RTSPLatencyMetricsConfig *config) {
+    config->maxCameras = 64;
+    config->traceInterval = 100;
+    config->slowTrace = 0.5;
+}
+
+RTSPLatencyMetricsRef RTSPLatencyMetricsCreate(const RTSPLatencyMetricsConfig *config) {
+    if (!config || config->maxCameras == 0) {
+        return NULL;
+    }
+    RTSPLatencyMetricsRef metrics = calloc(1, sizeof(*metrics));
+    if (!metrics) {
+        return NULL;
+    }
+    metrics->config = *config;
+    metrics->cameras = calloc(config->maxCameras, sizeof(*metrics->cameras));
+    if (!metrics->cameras) {
+        free(metrics);
+        return NULL;
+    }
+    pthread_mutex_init(&metrics->lock, NULL);
+    return metrics;
+}
+
+void RTSPLatencyMetricsRelease(RTSPLatencyMetricsRef metrics) {
+    if (!metrics) {
+        return;
+    }
+    uint32_t count = atomic_load_explicit(&metrics->cameraCount, memory_order_acquire);
+    for (uint32_t i = 0; i < count; i++) {
+        free(atomic_load_explicit(&metrics->cameras[i], memory_order_relaxed));
+    }
+    free(metrics->cameras);
+    pthread_mutex_destroy(&metrics->lock);
+    free(metrics);
+}
+
+uint32_t RTSPLatencyMetricsAddCamera(RTSPLatencyMetricsRef metrics, const char *name) {
+    if (!name) {
+        name = "";
+    }
+    pthread_mutex_lock(&metrics->lock);
+    uint32_t count = atomic_load_explicit(&metrics->cameraCount, memory_order_relaxed);
+    for (uint32_t i = 0; i < count; i++) {
+        RTSPLatencyCamera *camera = atomic_load_explicit(&metrics->cameras[i], memory_order_relaxed);
+        if (strncmp(camera->name, name, RTSP_LATENCY_NAME_LENGTH - 1) == 0) {
+            pthread_mutex_unlock(&metrics->lock);
+            return i;
+        }
+    }
+    RTSPLatencyCamera *camera = count < metrics->config.maxCameras ? calloc(1, sizeof(*camera)) : NULL;
+    if (!camera) {
+        pthread_mutex_unlock(&metrics->lock);
+        return UINT32_MAX;
+    }
+    strncpy(camera->name, name, RTSP_LATENCY_NAME_LENGTH - 1);
+    atomic_store_explicit(&metrics->cameras[count], camera, memory_order_release);
+    atomic_store_explicit(&metrics->cameraCount, count + 1, memory_order_release);
+    pthread_mutex_unlock(&metrics->lock);
+    return count;
+}
+
+static RTSPLatencyCamera *RTSPLatencyMetricsCamera(RTSPLatencyMetricsRef metrics, uint32_t camera) {
+    if (camera >= atomic_load_explicit(&metrics->cameraCount, memory_order_acquire)) {
+        return NULL;
+    }
+    return atomic_load_explicit(&metrics->cameras[camera], memory_order_acquire);
+}
+
+#pragma mark - Buckets
+
+static uint32_t RTSPLatencyBucket(uint64_t micros) {
+    if (micros < RTSP_LATENCY_LINEAR) {
+        return (uint32_t)micros;
+    }
+    if (micros > RTSP_LATENCY_MAX_MICROS) {
+        micros = RTSP_LATENCY_MAX_MICROS;
+    }
+    uint32_t exponent = 63 - (uint32_t)__builtin_clzll(micros);
+    uint32_t mantissa = (uint32_t)(micros >> (exponent - 5));     // 32 - 63
+    return RTSP_LATENCY_LINEAR + (exponent - 6) * RTSP_LATENCY_SUB_BUCKETS + (mantissa - RTSP_LATENCY_SUB_BUCKETS);
+}
+
+/// Smallest value in a bucket, us
+static uint64_t RTSPLatencyBucketLow(uint32_t bucket) {
+    if (bucket < RTSP_LATENCY_LINEAR) {
+        return bucket;
+    }
+    uint32_t exponent = (bucket - RTSP_LATENCY_LINEAR) / RTSP_LATENCY_SUB_BUCKETS + 6;
+    uint64_t mantissa = RTSP_LATENCY_SUB_BUCKETS + (bucket - RTSP_LATENCY_LINEAR) % RTSP_LATENCY_SUB_BUCKETS;
+    return mantissa << (exponent - 5);
+}
+
+/// Value reported for a bucket: its midpoint, us
+static double RTSPLatencyBucketValue(uint32_t bucket) {
+    if (bucket < RTSP_LATENCY_LINEAR) {
+        return bucket;
+    }
+    uint64_t low = RTSPLatencyBucketLow(bucket);
+    uint64_t width = UINT64_C(1) << ((bucket - RTSP_LATENCY_LINEAR) / RTSP_LATENCY_SUB_BUCKETS + 1);
+    return (double)low + (double)(width - 1) / 2.0;
+}
+
+#pragma mark - Recording
+
+void RTSPLatencyMetricsRecord(RTSPLatencyMetricsRef metrics, uint32_t camera, RTSPLatencyStage stage, double seconds) {
+    RTSPLatencyCamera *entry = RTSPLatencyMetricsCamera(metrics, camera);
+    if (!entry || stage >= RTSPLatencyStageCount || !(seconds >= 0)) {
+        return;
+    }
+    double scaled = seconds * 1e6 + 0.5;
+    uint64_t micros = scaled >= (double)RTSP_LATENCY_MAX_MICROS ? RTSP_LATENCY_MAX_MICROS : (uint64_t)scaled;
+    RTSPLatencyHistogram *histogram = &entry->stages[stage];
+    atomic_fetch_add_explicit(&histogram->buckets[RTSPLatencyBucket(micros)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&histogram->sumMicros, micros, memory_order_relaxed);
+    atomic_fetch_add_explicit(&histogram->count, 1, memory_order_relaxed);
+    uint64_t max = atomic_load_explicit(&histogram->maxMicros, memory_order_relaxed);
+    while (micros > max &&
+           !atomic_compare_exchange_weak_explicit(&histogram->maxMicros, &max, micros, memory_order_relaxed,
+                                                  memory_order_relaxed)) {
+    }
+}
+
+bool RTSPLatencyMetricsShouldTrace(RTSPLatencyMetricsRef metrics, uint32_t camera, double total) {
+    RTSPLatencyCamera *entry = RTSPLatencyMetricsCamera(metrics, camera);
+    if (!entry) {
+        return false;
+    }
+    uint64_t frame = atomic_fetch_add_explicit(&entry->frames, 1, memory_order_relaxed);
+    if (metrics->config.slowTrace > 0 && total >= metrics->config.slowTrace) {
+        return true;
+    }
+    return metrics->config.traceInterval > 0 && frame % metrics->config.traceInterval == 0;
+}
+
+#pragma mark - Reading
+
+typedef struct {
+    uint64_t buckets[RTSP_LATENCY_BUCKETS];
+    uint64_t count;                     // Sum of buckets, consistent with them
+    uint64_t sumMicros;
+    uint64_t maxMicros;
+} RTSPLatencySnapshot;
+
+static void RTSPLatencySnapshotAdd(RTSPLatencySnapshot *snapshot, RTSPLatencyHistogram *histogram) {
+    for (uint32_t i = 0; i < RTSP_LATENCY_BUCKETS; i++) {
+        uint32_t value = atomic_load_explicit(&histogram->buckets[i], memory_order_relaxed);
+        snapshot->buckets[i] += value;
+        snapshot->count += value;
+    }
+    snapshot->sumMicros += atomic_load_explicit(&histogram->sumMicros, memory_order_relaxed);
+    uint64_t max = atomic_load_explicit(&histogram->maxMicros, memory_order_relaxed);
+    if (max > snapshot->maxMicros) {
+        snapshot->maxMicros = max;
+    }
+}
+
+/// Percentile in seconds, never above the largest value recorded
+static double RTSPLatencySnapshotPercentile(const RTSPLatencySnapshot *snapshot, double percentile) {
+    if (snapshot->count == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(percentile * (double)snapshot->count + 0.5);
+    rank = rank < 1 ? 1 : rank > snapshot->count ? snapshot->count : rank;
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < RTSP_LATENCY_BUCKETS; i++) {
+        seen += snapshot->buckets[i];
+        if (seen >= rank) {
+            double value = RTSPLatencyBucketValue(i);
+            if (value > (double)snapshot->maxMicros) {
+                value = (double)snapshot->maxMicros;
+            }
+            return value / 1e6;
+        }
+    }
+    return (double)snapshot->maxMicros / 1e6;
+}
+
+static RTSPLatencySummary RTSPLatencySnapshotSummary(const RTSPLatencySnapshot *snapshot) {
+    RTSPLatencySummary summary = {
+        snapshot->count,
+        (double)snapshot->sumMicros / 1e6,
+        (double)snapshot->maxMicros / 1e6,
+        RTSPLatencySnapshotPercentile(snapshot, 0.5),
+        RTSPLatencySnapshotPercentile(snapshot, 0.9),
+        RTSPLatencySnapshotPercentile(snapshot, 0.99),
+        RTSPLatencySnapshotPercentile(snapshot, 0.999),
+    };
+    return summary;
+}
+
+RTSPLatencySummary RTSPLatencyMetricsGetSummary(RTSPLatencyMetricsRef metrics, uint32_t camera, RTSPLatencyStage stage) {
+    RTSPLatencySummary empty = {0};
+    if (stage >= RTSPLatencyStageCount) {
+        return empty;
+    }
+    RTSPLatencySnapshot *snapshot = calloc(1, sizeof(*snapshot));
+    if (!snapshot) {
+        return empty;
+    }
+    uint32_t count = atomic_load_explicit(&metrics->cameraCount, memory_order_acquire);
+    for (uint32_t i = 0; i < count; i++) {
+        if (camera == UINT32_MAX || camera == i) {
+            RTSPLatencySnapshotAdd(snapshot, &RTSPLatencyMetricsCamera(metrics, i)->stages[stage]);
+        }
+    }
+    RTSPLatencySummary summary = RTSPLatencySnapshotSummary(snapshot);
+    free(snapshot);
+    return summary;
+}
+
+void RTSPLatencyMetricsReset(RTSPLatencyMetricsRef metrics) {
+    uint32_t count = atomic_load_explicit(&metrics->cameraCount, memory_order_acquire);
+    for (uint32_t i = 0; i < count; i++) {
+        RTSPLatencyCamera *camera = RTSPLatencyMetricsCamera(metrics, i);
+        for (uint32_t s = 0; s < RTSPLatencyStageCount; s++) {
+            RTSPLatencyHistogram *histogram = &camera->stages[s];
+            for (uint32_t b = 0; b < RTSP_LATENCY_BUCKETS; b++) {
+                atomic_store_explicit(&histogram->buckets[b], 0, memory_order_relaxed);
+            }
+            atomic_store_explicit(&histogram->count, 0, memory_order_relaxed);
+            atomic_store_explicit(&histogram->sumMicros, 0, memory_order_relaxed);
+            atomic_store_explicit(&histogram->maxMicros, 0, memory_order_relaxed);
+        }
+        atomic_store_explicit(&camera->frames, 0, memory_order_relaxed);
+    }
+}
+
+#pragma mark - Prometheus
+
+typedef struct {
+    char *buffer;
+    size_t capacity;
+    size_t length;                      // Full length, may exceed capacity
+} RTSPLatencyWriter;
+
+static void RTSPLatencyPrintf(RTSPLatencyWriter *writer, const char *format, ...) {
+    va_list arguments;
+    va_start(arguments, format);
+    size_t remaining = writer->length < writer->capacity ? writer->capacity - writer->length : 0;
+    int written = vsnprintf(remaining ? writer->buffer + writer->length : NULL, remaining, format, arguments);
+    va_end(arguments);
+    if (written > 0) {
+        writer->length += (size_t)written;
+    }
+}
+
+/// Camera name as a label value: backslash, quote and newline escaped
+static void RTSPLatencyEscape(const char *name, char *escaped, size_t capacity) {
+    size_t length = 0;
+    for (const char *c = name; *c && length + 3 < capacity; c++) {
+        if (*c == '\\' || *c == '"') {
+            escaped[length++] = '\\';
+            escaped[length++] = *c;
+        } else if (*c == '\n') {
+            escaped[length++] = '\\';
+            escaped[length++] = 'n';
+        } else {
+            escaped[length++] = *c;
+        }
+    }
+    escaped[length] = '\0';
+}
+
+size_t RTSPLatencyMetricsWritePrometheus(RTSPLatencyMetricsRef metrics, char *buffer, size_t capacity) {
+    RTSPLatencyWriter writer = {buffer, capacity, 0};
+    if (capacity > 0) {
+        buffer[0] = '\0';
+    }
+    RTSPLatencySnapshot *snapshot = malloc(sizeof(*snapshot));
+    RTSPLatencySummary *summaries = calloc((size_t)metrics->config.maxCameras * RTSPLatencyStageCount, sizeof(*summaries));
+    if (!snapshot || !summaries) {
+        free(snapshot);
+        free(summaries);
+        return 0;
+    }
+
+    static const size_t boundCount = sizeof(RTSPLatencyPrometheusBounds) / sizeof(RTSPLatencyPrometheusBounds[0]);
+    char name[RTSP_LATENCY_NAME_LENGTH * 2];
+    uint32_t count = atomic_load_explicit(&metrics->cameraCount, memory_order_acquire);
+
+    RTSPLatencyPrintf(&writer, "# HELP rtsp_detection_stage_seconds Detection pipeline latency per camera and stage.\n");
+    RTSPLatencyPrintf(&writer, "# TYPE rtsp_detection_stage_seconds histogram\n");
+    for (uint32_t i = 0; i < count; i++) {
+        RTSPLatencyCamera *camera = RTSPLatencyMetricsCamera(metrics, i);
+        RTSPLatencyEscape(camera->name, name, sizeof(name));
+        for (uint32_t s = 0; s < RTSPLatencyStageCount; s++) {
+            memset(snapshot, 0, sizeof(*snapshot));
+            RTSPLatencySnapshotAdd(snapshot, &camera->stages[s]);
+            summaries[i * RTSPLatencyStageCount + s] = RTSPLatencySnapshotSummary(snapshot);
+            if (snapshot->count == 0) {
+                continue;
+            }
+            // A bucket counts toward a bound when its smallest value is within it
+            uint64_t cumulative = 0;
+            uint32_t bucket = 0;
+            for (size_t b = 0; b < boundCount; b++) {
+                double bound = RTSPLatencyPrometheusBounds[b] * 1e6;
+                while (bucket < RTSP_LATENCY_BUCKETS && (double)RTSPLatencyBucketLow(bucket) <= bound) {
+                    cumulative += snapshot->buckets[bucket++];
+                }
+                RTSPLatencyPrintf(&writer, "rtsp_detection_stage_seconds_bucket{camera=\"%s\",stage=\"%s\",le=\"%g\"} %llu\n",
+                                  name, RTSPLatencyStageNames[s], RTSPLatencyPrometheusBounds[b],
+                                  (unsigned long long)cumulative);
+            }
+            RTSPLatencyPrintf(&writer, "rtsp_detection_stage_seconds_bucket{camera=\"%s\",stage=\"%s\",le=\"+Inf\"} %llu\n",
+                              name, RTSPLatencyStageNames[s], (unsigned long long)snapshot->count);
+            RTSPLatencyPrintf(&writer, "rtsp_detection_stage_seconds_sum{camera=\"%s\",stage=\"%s\"} %.6f\n", name,
+                              RTSPLatencyStageNames[s], (double)snapshot->sumMicros / 1e6);
+            RTSPLatencyPrintf(&writer, "rtsp_detection_stage_seconds_count{camera=\"%s\",stage=\"%s\"} %llu\n", name,
+                              RTSPLatencyStageNames[s], (unsigned long long)snapshot->count);
+        }
+    }
+
+    static const char *const quantiles[] = {"0.5", "0.9", "0.99", "0.999"};
+    RTSPLatencyPrintf(&writer, "# HELP rtsp_detection_stage_quantile_seconds Detection pipeline latency percentiles since start.\n");
+    RTSPLatencyPrintf(&writer, "# TYPE rtsp_detection_stage_quantile_seconds gauge\n");
+    for (uint32_t i = 0; i < count; i++) {
+        RTSPLatencyEscape(RTSPLatencyMetricsCamera(metrics, i)->name, name, sizeof(name));
+        for (uint32_t s = 0; s < RTSPLatencyStageCount; s++) {
+            const RTSPLatencySummary *summary = &summaries[i * RTSPLatencyStageCount + s];
+            if (summary->count == 0) {
+                continue;
+            }
+            double values[] = {summary->p50, summary->p90, summary->p99, summary->p999};
+            for (size_t q = 0; q < 4; q++) {
+                RTSPLatencyPrintf(&writer, "rtsp_detection_stage_quantile_seconds{camera=\"%s\",stage=\"%s\",quantile=\"%s\"} %.6f\n",
+                                  name, RTSPLatencyStageNames[s], quantiles[q], values[q]);
+            }
+        }
+    }
+
+    free(snapshot);
+    free(summaries);
+    return writer.length;
+}
@@ -0,0 +1,92 @@
+//
+//  RTSPLatencyMetrics.h
+//  RTSP Rotator
+//
+//  Per-camera latency histograms for the detection pipeline's stages, from
+//  frame grab to alert dispatch. Histograms are HDR-style: microseconds in
+//  log-linear buckets, 32 per power of two, so any percentile is within
+//  about 3% from 1 us to an hour in a fixed 3.5 KB per histogram.
+//
+//  Recording is a few relaxed atomic adds with no lock, from any thread.
+//  Only adding a camera takes a lock. Snapshots and the Prometheus text
+//  export read the counters while recording goes on.
+//
+//  Also decides which frames get a trace record: every Nth frame per
+//  camera and every frame slower than a threshold. See
+//  Benchmarks/latency_metrics_bench.c.
+//
+
+#ifndef RTSPLatencyMetrics_h
+#define RTSPLatencyMetrics_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    RTSPLatencyStageGrab = 0,           // Frame capture to the processor
+    RTSPLatencyStageQueue,              // Waiting in the inference scheduler
+    RTSPLatencyStagePreprocess,         // Letterboxing into the model input
+    RTSPLatencyStageInference,          // The model run (the frame's whole batch)
+    RTSPLatencyStagePostprocess,        // Decoding and tracking
+    RTSPLatencyStageZoneFilter,         // Matching detections to zones
+    RTSPLatencyStageAlertDispatch,      // Event or alert creation to delivery
+    RTSPLatencyStageTotal,              // Frame capture to detections delivered
+    RTSPLatencyStageCount
+} RTSPLatencyStage;
+
+typedef struct {
+    uint32_t maxCameras;                // Default 64
+    uint32_t traceInterval;             // Trace every Nth frame per camera; 0 = none (default 100)
+    double slowTrace;                   // Also trace frames with a total at least this long, s; 0 = none (default 0.5)
+} RTSPLatencyMetricsConfig;
+
+typedef struct {
+    uint64_t count;
+    double sum;                         // Seconds
+    double max;
+    double p50, p90, p99, p999;
+} RTSPLatencySummary;
+
+typedef struct RTSPLatencyMetrics *RTSPLatencyMetricsRef;
+
+void RTSPLatencyMetricsConfigInit(RTSPLatencyMetricsConfig *config);
+
+RTSPLatencyMetricsRef RTSPLatencyMetricsCreate(const RTSPLatencyMetricsConfig *config);
+void RTSPLatencyMetricsRelease(RTSPLatencyMetricsRef metrics);
+
+/// Index for a camera's histograms, the same for the same name. UINT32_MAX
+/// once maxCameras are in use. Takes a lock: look it up once per camera.
+uint32_t RTSPLatencyMetricsAddCamera(RTSPLatencyMetricsRef metrics, const char *name);
+
+/// Record one duration in seconds. Negative durations are ignored. Any thread.
+void RTSPLatencyMetricsRecord(RTSPLatencyMetricsRef metrics, uint32_t camera, RTSPLatencyStage stage, double seconds);
+
+/// Whether a frame that took `total` seconds should be traced; counts the
+/// frame toward the camera's traceInterval. Any thread.
+bool RTSPLatencyMetricsShouldTrace(RTSPLatencyMetricsRef metrics, uint32_t camera, double total);
+
+/// Count, sum, max and percentiles of one stage. UINT32_MAX for `camera`
+/// merges every camera.
+RTSPLatencySummary RTSPLatencyMetricsGetSummary(RTSPLatencyMetricsRef metrics, uint32_t camera, RTSPLatencyStage stage);
+
+/// Prometheus text exposition (version 0.0.4) of every recorded stage: a
+/// histogram rtsp_detection_stage_seconds with coarse buckets, and the
+/// p50/p90/p99/p99.9 as gauges. Writes at most `capacity` bytes with a
+/// terminating NUL and returns the full length, like snprintf.
+size_t RTSPLatencyMetricsWritePrometheus(RTSPLatencyMetricsRef metrics, char *buffer, size_t capacity);
+
+/// Zero every histogram; cameras keep their indexes
+void RTSPLatencyMetricsReset(RTSPLatencyMetricsRef metrics);
+
+const char *RTSPLatencyStageName(RTSPLatencyStage stage);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RTSPLatencyMetrics_h */
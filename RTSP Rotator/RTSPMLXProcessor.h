@@ -9,6 +9,7 @@
 #import <Foundation/Foundation.h>
 #import <CoreVideo/CoreVideo.h>
 #import <CoreGraphics/CoreGraphics.h>
+#import "RTSPLatencyMetrics.h"
 
 NS_ASSUME_NONNULL_BEGIN
 
@@ -18,8 +19,10 @@ NS_ASSUME_NONNULL_BEGIN
 @property (nonatomic, copy) NSString *label;           // Object label (e.g., "person", "car")
 @property (nonatomic, assign) float confidence;         // Confidence score (0.0 - 1.0)
 @property (nonatomic, assign) CGRect boundingBox;      // Normalized coordinates (0.0 - 1.0)
-@property (nonatomic, copy) NSString *trackingID;      // Optional tracking ID
+@property (nonatomic, copy) NSString *trackingID;      // Same for an object across frames while it is tracked
 @property (nonatomic, strong) NSDate *timestamp;       // Detection timestamp
+@property (nonatomic, assign, getter=isTracked) BOOL tracked;             // trackingID belongs to a confirmed track
+@property (nonatomic, assign, getter=isInterpolated) BOOL interpolated;   // Predicted by the tracker on a frame without inference
 
 - (instancetype)initWithLabel:(NSString *)label
                    confidence:(float)confidence
@@ -34,16 +37,42 @@ NS_ASSUME_NONNULL_BEGIN
 @interface RTSPMLXConfiguration : NSObject
 
 @property (nonatomic, assign) BOOL useGPU;                      // Enable GPU acceleration (default: YES)
-@property (nonatomic, assign) NSInteger maxConcurrentStreams;  // Max simultaneous streams (default: 4)
+@property (nonatomic, assign) NSInteger maxConcurrentStreams;  // Max frames in inference at once, batched across cameras (default: 4)
 @property (nonatomic, assign) float confidenceThreshold;       // Minimum confidence (default: 0.5)
-@property (nonatomic, assign) float iouThreshold;              // Non-max suppression threshold (default: 0.45)
-@property (nonatomic, assign) NSInteger inferenceInterval;     // Process every N frames (default: 3)
+@property (nonatomic, assign) float iouThreshold;              // Non-max suppression threshold for raw tensor models (default: 0.45)
+@property (nonatomic, assign) NSInteger inferenceInterval;     // Process every N frames when not adaptive (default: 3)
+@property (nonatomic, assign) BOOL adaptiveInference;          // Inference rate per camera follows motion and activity (default: YES)
+@property (nonatomic, assign) double activeInferenceRate;       // Inferences / s per camera during activity (default: 10)
+@property (nonatomic, assign) double idleInferenceRate;        // Inferences / s per camera when still (default: 0.2)
+@property (nonatomic, assign) double inferenceBudget;          // Inferences / s over all cameras, shared fairly; 0 = unlimited (default: 0)
 @property (nonatomic, copy) NSArray<NSString *> *enabledClasses; // Filter by classes (nil = all)
+@property (nonatomic, assign) BOOL trackingEnabled;            // Track objects across frames per camera (default: YES)
+@property (nonatomic, assign) float trackingLowConfidence;     // Weaker detections that only keep tracks alive (default: 0.1)
 
 + (instancetype)defaultConfiguration;
 
 @end
 
+typedef NS_ENUM(NSInteger, RTSPTrackingEventType) {
+    RTSPTrackingEventTypeStarted,          // Object confirmed and given its trackingID
+    RTSPTrackingEventTypeEnded,            // Object unseen long enough to be gone
+    RTSPTrackingEventTypeEnteredZone,
+    RTSPTrackingEventTypeExitedZone
+};
+
+/// Track lifecycle or zone change
+@interface RTSPTrackingEvent : NSObject
+
+@property (nonatomic, assign) RTSPTrackingEventType type;
+@property (nonatomic, copy) NSString *trackingID;
+@property (nonatomic, copy) NSString *label;
+@property (nonatomic, assign) CGRect boundingBox;
+@property (nonatomic, copy, nullable) NSString *zoneName;
+@property (nonatomic, assign) NSTimeInterval duration;          // Ended: time tracked; exited zone: dwell time
+@property (nonatomic, strong) NSDate *timestamp;
+
+@end
+
 @class RTSPMLXProcessor;
 
 /// MLX Processor delegate
@@ -52,6 +81,7 @@ NS_ASSUME_NONNULL_BEGIN
 - (void)mlxProcessor:(RTSPMLXProcessor *)processor didDetectObjects:(NSArray<RTSPDetection *> *)detections forCamera:(NSString *)cameraID;
 - (void)mlxProcessor:(RTSPMLXProcessor *)processor didFailWithError:(NSError *)error;
 - (void)mlxProcessor:(RTSPMLXProcessor *)processor didUpdatePerformance:(NSDictionary *)metrics;
+- (void)mlxProcessor:(RTSPMLXProcessor *)processor didUpdateTracks:(NSArray<RTSPTrackingEvent *> *)events forCamera:(NSString *)cameraID;
 @end
 
 /// Core MLX processor for machine learning inference
@@ -77,6 +107,12 @@ NS_ASSUME_NONNULL_BEGIN
  * @param modelPath Path to .mlmodel or .mlpackage file
  * @param error Error if loading fails
  * @return YES if model loaded successfully
+ *
+ * Object detectors with an NMS pipeline run through Vision. Models that
+ * output the raw YOLO tensor ([1, 4 + classes, anchors] or
+ * [1, anchors, 5 + classes]) are fed letterboxed frames in batches and
+ * decoded natively with iouThreshold; class names come from the model's
+ * "names" metadata.
  */
 - (BOOL)loadModel:(NSString *)modelPath error:(NSError **)error;
 
@@ -84,10 +120,45 @@ NS_ASSUME_NONNULL_BEGIN
  * Process video frame and detect objects
  * @param pixelBuffer CVPixelBuffer containing frame data
  * @param cameraID Camera identifier for tracking
- * @param completion Completion handler with detections array
+ * @param completion Completion handler with detections array. With tracking
+ *        enabled, skipped frames get the tracked objects' predicted boxes
+ *        (interpolated) instead of an empty array.
+ *
+ * Frames from all cameras share one scheduler: each camera keeps only its
+ * latest frame waiting, batches take cameras round-robin, and frames that
+ * are replaced by a newer one or wait too long are answered like skipped
+ * frames instead of being queued. Changing the configuration restarts it.
+ */
+- (void)processFrame:(CVPixelBufferRef)pixelBuffer
+           forCamera:(NSString *)cameraID
+          completion:(void (^)(NSArray<RTSPDetection *> * _Nullable detections, NSError * _Nullable error))completion;
+
+/**
+ * Process video frame with its motion score for adaptive inference
+ * @param motionScore Fraction of the frame that moved (0.0 - 1.0), e.g.
+ *        from RTSPMotionDetector; negative when unknown, which counts as
+ *        activity. Tracked objects still moving keep a camera active too.
+ *
+ * With adaptiveInference, a camera runs at activeInferenceRate while its
+ * scene moves and falls to idleInferenceRate once it has been still for a
+ * couple of seconds; the first frame of new motion is always inferred.
+ * Without it, this is processFrame:forCamera:completion:.
+ */
+- (void)processFrame:(CVPixelBufferRef)pixelBuffer
+           forCamera:(NSString *)cameraID
+         motionScore:(float)motionScore
+          completion:(void (^)(NSArray<RTSPDetection *> * _Nullable detections, NSError * _Nullable error))completion;
+
+/**
+ * Process video frame with its motion score and capture time
+ * @param captureTime CACurrentMediaTime() when the frame was decoded (e.g.
+ *        RTSPDecodedFrame.hostTime), for the grab and total latencies;
+ *        0 when unknown, which starts them at this call
  */
 - (void)processFrame:(CVPixelBufferRef)pixelBuffer
            forCamera:(NSString *)cameraID
+         motionScore:(float)motionScore
+         captureTime:(CFTimeInterval)captureTime
           completion:(void (^)(NSArray<RTSPDetection *> * _Nullable detections, NSError * _Nullable error))completion;
 
 /**
@@ -98,6 +169,23 @@ NS_ASSUME_NONNULL_BEGIN
 - (void)processImage:(CGImageRef)image
           completion:(void (^)(NSArray<RTSPDetection *> * _Nullable detections, NSError * _Nullable error))completion;
 
+/**
+ * Set the zones tracks report entry, exit and dwell time for
+ * @param zones Zone name to a normalized rect (NSValue) or polygon (NSArray
+ *        of 3-64 NSValue points); nil removes them
+ * @param cameraID Camera identifier
+ */
+- (void)setTrackingZones:(nullable NSDictionary<NSString *, id> *)zones forCamera:(NSString *)cameraID;
+
+/**
+ * Time a tracked object has been in a zone so far
+ * @param trackingID Tracking ID from a detection
+ * @param zoneName Zone name from setTrackingZones:forCamera:
+ * @param cameraID Camera identifier
+ * @return Seconds in the zone, 0 if outside or unknown
+ */
+- (NSTimeInterval)dwellTimeForTrackingID:(NSString *)trackingID inZone:(NSString *)zoneName camera:(NSString *)cameraID;
+
 /**
  * Stop processing for specific camera
  * @param cameraID Camera identifier
@@ -109,6 +197,21 @@ NS_ASSUME_NONNULL_BEGIN
  */
 - (void)stopAllProcessing;
 
+/**
+ * Record a pipeline stage that runs outside the processor, such as zone
+ * filtering or alert dispatch, in the camera's latency histograms
+ * @param seconds Duration of the stage
+ * @param stage Pipeline stage
+ * @param cameraID Camera identifier
+ */
+- (void)recordLatency:(NSTimeInterval)seconds stage:(RTSPLatencyStage)stage forCamera:(NSString *)cameraID;
+
+/**
+ * Per-camera stage latency histograms and processing counters in the
+ * Prometheus text format, for /api/metrics
+ */
+- (NSString *)prometheusMetrics;
+
 /**
  * Reset statistics
  */
@@ -120,6 +223,14 @@ NS_ASSUME_NONNULL_BEGIN
  */
 - (NSDictionary *)performanceMetrics;
 
+/**
+ * Adaptive inference rates per camera over roughly the last 5 seconds
+ * @return Camera ID to effectiveFPS, offeredFPS, skippedRatio, targetFPS,
+ *         allowedFPS (target after the budget), active, framesOffered and
+ *         framesInferred. Empty when adaptiveInference is off.
+ */
+- (NSDictionary<NSString *, NSDictionary *> *)inferenceRatesByCamera;
+
 /**
  * Check if MLX is available on this system
  * @return YES if MLX is supported
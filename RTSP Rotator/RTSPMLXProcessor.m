@@ -6,25 +6,47 @@
 //
 
 #import "RTSPMLXProcessor.h"
+#import "RTSPActivityGate.h"
+#import "RTSPDetectionDecoder.h"
+#import "RTSPDetectionPreprocessor.h"
+#import "RTSPInferenceScheduler.h"
+#import "RTSPTracker.h"
 #import <CoreML/CoreML.h>
 #import <Vision/Vision.h>
 #import <Accelerate/Accelerate.h>
+#import <QuartzCore/QuartzCore.h>
 #import <sys/sysctl.h>
 
+@interface RTSPDetection ()
+- (instancetype)initWithLabel:(NSString *)label confidence:(float)confidence boundingBox:(CGRect)box timestamp:(NSDate *)timestamp;
+@end
+
 @implementation RTSPDetection
 
 - (instancetype)initWithLabel:(NSString *)label confidence:(float)confidence boundingBox:(CGRect)box {
+    return [self initWithLabel:label confidence:confidence boundingBox:box timestamp:[NSDate date]];
+}
+
+/// Detections decoded from one frame share its timestamp
+- (instancetype)initWithLabel:(NSString *)label confidence:(float)confidence boundingBox:(CGRect)box timestamp:(NSDate *)timestamp {
     self = [super init];
     if (self) {
         _label = [label copy];
         _confidence = confidence;
         _boundingBox = box;
-        _timestamp = [NSDate date];
-        _trackingID = [[NSUUID UUID] UUIDString];
+        _timestamp = timestamp;
     }
     return self;
 }
 
+/// Most detections are given their track's ID, so a unique one is only made when asked for
+- (NSString *)trackingID {
+    if (!_trackingID) {
+        _trackingID = [[NSUUID UUID] UUIDString];
+    }
+    return _trackingID;
+}
+
 - (CGRect)boundingBoxForImageSize:(CGSize)imageSize {
     return CGRectMake(
         self.boundingBox.origin.x * imageSize.width,
@@ -43,6 +65,215 @@
 
 @end
 
+@implementation RTSPTrackingEvent
+
+- (NSString *)description {
+    return [NSString stringWithFormat:@"<RTSPTrackingEvent: %ld %@ (%@) zone:%@ %.1fs>",
+            (long)self.type, self.trackingID, self.label, self.zoneName ?: @"-", self.duration];
+}
+
+@end
+
+/// One camera's tracker and the names behind its numeric classes and zones.
+/// Only touched on the processor's tracking queue.
+@interface RTSPCameraTracks : NSObject
+@property (nonatomic, assign) RTSPTrackerRef tracker;
+@property (nonatomic, strong) NSMutableArray<NSString *> *labels;                       // By class ID
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSNumber *> *classIDs;
+@property (nonatomic, copy) NSArray<NSString *> *zoneNames;                             // By zone index
+@property (nonatomic, assign) uint32_t movingTracks;                                    // Confirmed tracks still moving at the last inference
+@end
+
+@implementation RTSPCameraTracks
+
+- (instancetype)initWithConfiguration:(RTSPMLXConfiguration *)configuration {
+    self = [super init];
+    if (self) {
+        RTSPTrackerConfig config;
+        RTSPTrackerConfigInit(&config);
+        config.highScore = configuration.confidenceThreshold;
+        config.lowScore = MIN(configuration.trackingLowConfidence, configuration.confidenceThreshold);
+        _tracker = RTSPTrackerCreate(&config);
+        _labels = [NSMutableArray array];
+        _classIDs = [NSMutableDictionary dictionary];
+        _zoneNames = @[];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    RTSPTrackerRelease(_tracker);
+}
+
+- (uint32_t)classIDForLabel:(NSString *)label {
+    NSNumber *classID = self.classIDs[label];
+    if (!classID) {
+        classID = @(self.labels.count);
+        self.classIDs[label] = classID;
+        [self.labels addObject:label];
+    }
+    return classID.unsignedIntValue;
+}
+
+@end
+
+/// A camera frame between submission to the scheduler and its completion
+@interface RTSPMLXFrameRequest : NSObject
+@property (nonatomic, copy) NSString *cameraID;
+@property (nonatomic, assign) NSTimeInterval frameTime;
+@property (nonatomic, assign) NSTimeInterval inferenceTime;                 // ms, this frame's share of its batch
+@property (nonatomic, assign) uint32_t metricsCamera;                       // Latency histograms' camera index
+@property (nonatomic, assign) CFTimeInterval captureTime;                   // CACurrentMediaTime(), like the times below
+@property (nonatomic, assign) CFTimeInterval submitTime;
+@property (nonatomic, assign) CFTimeInterval batchStartTime;
+@property (nonatomic, assign) uint32_t batchSize;
+@property (nonatomic, assign) CFTimeInterval preprocessDuration;            // s; 0 when Vision preprocesses
+@property (nonatomic, assign) CFTimeInterval inferenceDuration;             // s, the whole batch's model run
+@property (nonatomic, assign) CFTimeInterval postprocessDuration;           // s, decoding so far
+@property (nonatomic, copy) void (^completion)(NSArray<RTSPDetection *> * _Nullable, NSError * _Nullable);
+@property (nonatomic, assign, getter=isDecoded) BOOL decoded;             // Result holds RTSPDetections, not Vision observations
+@end
+
+@implementation RTSPMLXFrameRequest
+@end
+
+/// A model whose output is the raw YOLO tensor (no NMS pipeline). Its frames
+/// are letterboxed, batched through Core ML and decoded natively instead of
+/// going through Vision.
+@interface RTSPMLXTensorModel : NSObject
+@property (nonatomic, copy) NSString *inputName;
+@property (nonatomic, copy) NSString *outputName;
+@property (nonatomic, assign) BOOL imageInput;                  // BGRA pixel buffer, otherwise a [1, 3, H, W] float array
+@property (nonatomic, assign) uint32_t inputWidth;
+@property (nonatomic, assign) uint32_t inputHeight;
+@property (nonatomic, assign) RTSPDetectionLayout layout;
+@property (nonatomic, assign) uint32_t anchorCount;
+@property (nonatomic, assign) uint32_t classCount;
+@property (nonatomic, copy) NSArray<NSString *> *classNames;    // By class ID
+@property (nonatomic, strong) NSMutableArray<NSValue *> *preprocessors;   // Idle preprocessors; @synchronized
+@property (nonatomic, assign) CVPixelBufferPoolRef inputPool;   // Image input only
+@end
+
+@implementation RTSPMLXTensorModel
+
+/// Class names from the "names" metadata Ultralytics exports write, e.g.
+/// "{0: 'person', 1: 'bicycle'}"; "class N" where missing
+static NSArray<NSString *> *RTSPMLXClassNames(MLModel *model, uint32_t classCount) {
+    NSMutableDictionary<NSNumber *, NSString *> *byID = [NSMutableDictionary dictionary];
+    NSDictionary *creatorDefined = model.modelDescription.metadata[MLModelCreatorDefinedKey];
+    NSString *metadata = [creatorDefined[@"names"] isKindOfClass:[NSString class]] ? creatorDefined[@"names"] : nil;
+    if (metadata) {
+        NSRegularExpression *entry = [NSRegularExpression regularExpressionWithPattern:@"(\\d+)\\s*:\\s*['\"]([^'\"]*)['\"]"
+                                                                               options:0
+                                                                                 error:nil];
+        for (NSTextCheckingResult *match in [entry matchesInString:metadata options:0 range:NSMakeRange(0, metadata.length)]) {
+            byID[@([metadata substringWithRange:[match rangeAtIndex:1]].integerValue)] = [metadata substringWithRange:[match rangeAtIndex:2]];
+        }
+    }
+    NSMutableArray<NSString *> *names = [NSMutableArray arrayWithCapacity:classCount];
+    for (uint32_t c = 0; c < classCount; c++) {
+        [names addObject:byID[@(c)] ?: [NSString stringWithFormat:@"class %u", c]];
+    }
+    return names;
+}
+
++ (nullable instancetype)tensorModelForModel:(MLModel *)model {
+    MLModelDescription *description = model.modelDescription;
+    if (description.inputDescriptionsByName.count != 1 || description.outputDescriptionsByName.count != 1) {
+        return nil;
+    }
+    MLFeatureDescription *input = description.inputDescriptionsByName.allValues.firstObject;
+    MLFeatureDescription *output = description.outputDescriptionsByName.allValues.firstObject;
+    if (output.type != MLFeatureTypeMultiArray) {
+        return nil;
+    }
+
+    RTSPMLXTensorModel *tensorModel = [[RTSPMLXTensorModel alloc] init];
+    tensorModel.inputName = input.name;
+    tensorModel.outputName = output.name;
+    if (input.type == MLFeatureTypeImage) {
+        tensorModel.imageInput = YES;
+        tensorModel.inputWidth = (uint32_t)input.imageConstraint.pixelsWide;
+        tensorModel.inputHeight = (uint32_t)input.imageConstraint.pixelsHigh;
+    } else if (input.type == MLFeatureTypeMultiArray && input.multiArrayConstraint.shape.count == 4 &&
+               input.multiArrayConstraint.shape[1].integerValue == 3) {
+        tensorModel.inputHeight = input.multiArrayConstraint.shape[2].unsignedIntValue;
+        tensorModel.inputWidth = input.multiArrayConstraint.shape[3].unsignedIntValue;
+    } else {
+        return nil;
+    }
+
+    // [1, 4 + classes, anchors] (YOLOv8 / v11) or [1, anchors, 5 + classes] (YOLOv5 / v7)
+    NSArray<NSNumber *> *shape = output.multiArrayConstraint.shape;
+    if (shape.count < 2 || (shape.count == 3 && shape[0].integerValue != 1) || shape.count > 3) {
+        return nil;
+    }
+    uint32_t rows = shape[shape.count - 2].unsignedIntValue, columns = shape[shape.count - 1].unsignedIntValue;
+    if (rows < columns && rows > 4) {
+        tensorModel.layout = RTSPDetectionLayoutChannelsFirst;
+        tensorModel.classCount = rows - 4;
+        tensorModel.anchorCount = columns;
+    } else if (columns > 5) {
+        tensorModel.layout = RTSPDetectionLayoutAnchorsFirst;
+        tensorModel.classCount = columns - 5;
+        tensorModel.anchorCount = rows;
+    } else {
+        return nil;
+    }
+    if (tensorModel.inputWidth == 0 || tensorModel.inputHeight == 0) {
+        return nil;
+    }
+    tensorModel.classNames = RTSPMLXClassNames(model, tensorModel.classCount);
+    tensorModel.preprocessors = [NSMutableArray array];
+
+    if (tensorModel.imageInput) {
+        NSDictionary *attributes = @{
+            (id)kCVPixelBufferPixelFormatTypeKey: @(kCVPixelFormatType_32BGRA),
+            (id)kCVPixelBufferWidthKey: @(tensorModel.inputWidth),
+            (id)kCVPixelBufferHeightKey: @(tensorModel.inputHeight),
+            (id)kCVPixelBufferIOSurfacePropertiesKey: @{},
+        };
+        CVPixelBufferPoolRef pool = NULL;
+        if (CVPixelBufferPoolCreate(kCFAllocatorDefault, NULL, (__bridge CFDictionaryRef)attributes, &pool) != kCVReturnSuccess) {
+            return nil;
+        }
+        tensorModel.inputPool = pool;
+    }
+    return tensorModel;
+}
+
+- (RTSPDetectionPreprocessorRef)checkoutPreprocessor {
+    @synchronized (self.preprocessors) {
+        NSValue *idle = self.preprocessors.lastObject;
+        if (idle) {
+            [self.preprocessors removeLastObject];
+            return idle.pointerValue;
+        }
+    }
+    RTSPDetectionPreprocessorConfig config;
+    RTSPDetectionPreprocessorConfigInit(&config, self.inputWidth, self.inputHeight);
+    config.format = self.imageInput ? RTSPDetectionInputBGRA8 : RTSPDetectionInputPlanarFloat;
+    return RTSPDetectionPreprocessorCreate(&config);
+}
+
+- (void)returnPreprocessor:(RTSPDetectionPreprocessorRef)preprocessor {
+    if (!preprocessor) {
+        return;
+    }
+    @synchronized (self.preprocessors) {
+        [self.preprocessors addObject:[NSValue valueWithPointer:preprocessor]];
+    }
+}
+
+- (void)dealloc {
+    for (NSValue *preprocessor in _preprocessors) {
+        RTSPDetectionPreprocessorRelease(preprocessor.pointerValue);
+    }
+    CVPixelBufferPoolRelease(_inputPool);
+}
+
+@end
+
 @implementation RTSPMLXConfiguration
 
 + (instancetype)defaultConfiguration {
@@ -51,18 +282,27 @@
     config.maxConcurrentStreams = 4;
     config.confidenceThreshold = 0.5;
     config.iouThreshold = 0.45;
-    config.inferenceInterval = 3; // Process every 3rd frame for performance
+    config.inferenceInterval = 3; // Process every 3rd frame when not adaptive
+    config.adaptiveInference = YES;
+    config.activeInferenceRate = 10.0;
+    config.idleInferenceRate = 0.2;
+    config.inferenceBudget = 0; // Unlimited
     config.enabledClasses = nil; // All classes enabled
+    config.trackingEnabled = YES;
+    config.trackingLowConfidence = 0.1;
     return config;
 }
 
 - (NSString *)description {
-    return [NSString stringWithFormat:@"<RTSPMLXConfiguration: GPU=%@ streams=%ld conf=%.2f iou=%.2f interval=%ld>",
+    NSString *rate = self.adaptiveInference
+        ? [NSString stringWithFormat:@"adaptive=%.1f-%.1f/s budget=%.0f/s", self.idleInferenceRate, self.activeInferenceRate, self.inferenceBudget]
+        : [NSString stringWithFormat:@"interval=%ld", (long)self.inferenceInterval];
+    return [NSString stringWithFormat:@"<RTSPMLXConfiguration: GPU=%@ streams=%ld conf=%.2f iou=%.2f %@>",
             self.useGPU ? @"YES" : @"NO",
             (long)self.maxConcurrentStreams,
             self.confidenceThreshold,
             self.iouThreshold,
-            (long)self.inferenceInterval];
+            rate];
 }
 
 @end
@@ -70,15 +310,22 @@
 @interface RTSPMLXProcessor ()
 
 @property (nonatomic, strong) MLModel *model;
-@property (nonatomic, strong) VNCoreMLModel *visionModel;
+@property (nonatomic, strong) VNCoreMLModel *visionModel;                                     // Image input models
+@property (nonatomic, strong) RTSPMLXTensorModel *tensorModel;                                // Raw tensor output models
+@property (nonatomic, assign) RTSPDetectionDecoderRef tensorDecoder;                          // With tensorModel; rebuilt with the scheduler
 @property (nonatomic, strong) dispatch_queue_t processingQueue;
-@property (nonatomic, strong) NSMutableDictionary<NSString *, NSNumber *> *cameraFrameCounts;
+@property (nonatomic, assign) RTSPInferenceSchedulerRef scheduler;
+@property (nonatomic, assign) RTSPActivityGateRef activityGate;                                // Adaptive inference only; with the scheduler
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSNumber *> *cameraSlots;       // Scheduler camera per cameraID; @synchronized
+@property (nonatomic, strong) dispatch_queue_t trackingQueue;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, RTSPCameraTracks *> *cameraTracks;   // trackingQueue only
 @property (nonatomic, assign) NSInteger framesProcessed;
 @property (nonatomic, assign) NSInteger detectionsCount;
 @property (nonatomic, assign) double totalInferenceTime;
 @property (nonatomic, assign) NSInteger inferenceCount;
-@property (nonatomic, strong) NSMutableSet<NSString *> *activeCameras;
 @property (nonatomic, strong) NSDate *startTime;
+@property (nonatomic, assign) RTSPLatencyMetricsRef latencyMetrics;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSNumber *> *metricsCameras;   // Histogram camera per cameraID; @synchronized
 
 @end
 
@@ -98,14 +345,21 @@
     if (self) {
         _configuration = [RTSPMLXConfiguration defaultConfiguration];
         _processingQueue = dispatch_queue_create("com.rtsp.mlx.processing", DISPATCH_QUEUE_CONCURRENT);
-        _cameraFrameCounts = [NSMutableDictionary dictionary];
-        _activeCameras = [NSMutableSet set];
+        _cameraSlots = [NSMutableDictionary dictionary];
+        _trackingQueue = dispatch_queue_create("com.rtsp.mlx.tracking", DISPATCH_QUEUE_SERIAL);
+        _cameraTracks = [NSMutableDictionary dictionary];
         _startTime = [NSDate date];
         _framesProcessed = 0;
         _detectionsCount = 0;
         _totalInferenceTime = 0.0;
         _inferenceCount = 0;
 
+        RTSPLatencyMetricsConfig metricsConfig;
+        RTSPLatencyMetricsConfigInit(&metricsConfig);
+        metricsConfig.maxCameras = 256;
+        _latencyMetrics = RTSPLatencyMetricsCreate(&metricsConfig);
+        _metricsCameras = [NSMutableDictionary dictionary];
+
         NSLog(@"[MLX] Initialized MLX Processor with config: %@", _configuration);
     }
     return self;
@@ -143,15 +397,26 @@
             return NO;
         }
 
-        // Create Vision model wrapper
-        self.visionModel = [VNCoreMLModel modelForMLModel:self.model error:error];
+        // Raw YOLO outputs are decoded natively; models with an NMS pipeline go through Vision
+        self.tensorModel = [RTSPMLXTensorModel tensorModelForModel:self.model];
+        NSError *visionError = nil;
+        self.visionModel = [VNCoreMLModel modelForMLModel:self.model error:&visionError];
 
-        if (!self.visionModel) {
-            NSLog(@"[MLX] Failed to create Vision model: %@", error ? *error : @"Unknown error");
+        if (!self.visionModel && !self.tensorModel) {
+            NSLog(@"[MLX] Failed to create Vision model: %@", visionError ?: @"Unknown error");
+            if (error) {
+                *error = visionError;
+            }
             return NO;
         }
+        if (self.tensorModel) {
+            NSLog(@"[MLX] Raw detection output: %u anchors x %u classes, %ux%u %@ input, decoded natively",
+                  self.tensorModel.anchorCount, self.tensorModel.classCount, self.tensorModel.inputWidth,
+                  self.tensorModel.inputHeight, self.tensorModel.imageInput ? @"image" : @"tensor");
+        }
 
         NSLog(@"[MLX] Model loaded successfully: %@", self.model.modelDescription);
+        [self rebuildScheduler];
         return YES;
 
     } @catch (NSException *exception) {
@@ -168,89 +433,564 @@
 - (void)processFrame:(CVPixelBufferRef)pixelBuffer
            forCamera:(NSString *)cameraID
           completion:(void (^)(NSArray<RTSPDetection *> * _Nullable, NSError * _Nullable))completion {
+    [self processFrame:pixelBuffer forCamera:cameraID motionScore:-1 completion:completion];
+}
 
-    if (!self.visionModel) {
+- (void)processFrame:(CVPixelBufferRef)pixelBuffer
+           forCamera:(NSString *)cameraID
+         motionScore:(float)motionScore
+          completion:(void (^)(NSArray<RTSPDetection *> * _Nullable, NSError * _Nullable))completion {
+    [self processFrame:pixelBuffer forCamera:cameraID motionScore:motionScore captureTime:0 completion:completion];
+}
+
+- (void)processFrame:(CVPixelBufferRef)pixelBuffer
+           forCamera:(NSString *)cameraID
+         motionScore:(float)motionScore
+         captureTime:(CFTimeInterval)captureTime
+          completion:(void (^)(NSArray<RTSPDetection *> * _Nullable, NSError * _Nullable))completion {
+
+    CFTimeInterval submitTime = CACurrentMediaTime();
+    uint32_t slot = UINT32_MAX;
+    RTSPInferenceSchedulerRef scheduler = NULL;
+    RTSPActivityGateRef gate = NULL;
+    @synchronized (self.cameraSlots) {
+        scheduler = self.scheduler;
+        gate = self.activityGate;
+        NSNumber *existing = self.cameraSlots[cameraID];
+        if (existing) {
+            slot = existing.unsignedIntValue;
+        } else if (scheduler) {
+            slot = RTSPInferenceSchedulerAddCamera(scheduler);
+            if (slot != UINT32_MAX) {
+                self.cameraSlots[cameraID] = @(slot);
+            }
+        }
+    }
+
+    if (!self.model || !scheduler) {
         NSError *error = [NSError errorWithDomain:@"RTSPMLXProcessor"
                                             code:400
                                         userInfo:@{NSLocalizedDescriptionKey: @"Model not loaded"}];
         if (completion) completion(nil, error);
         return;
     }
+    if (slot == UINT32_MAX) {
+        NSError *error = [NSError errorWithDomain:@"RTSPMLXProcessor"
+                                            code:503
+                                        userInfo:@{NSLocalizedDescriptionKey: @"Too many cameras for the inference scheduler"}];
+        if (completion) completion(nil, error);
+        return;
+    }
 
-    // Check frame interval
-    NSNumber *frameCount = self.cameraFrameCounts[cameraID] ?: @0;
-    NSInteger count = [frameCount integerValue];
-    self.cameraFrameCounts[cameraID] = @(count + 1);
-
-    if (count % self.configuration.inferenceInterval != 0) {
-        // Skip this frame
-        if (completion) completion(@[], nil);
+    RTSPMLXFrameRequest *request = [[RTSPMLXFrameRequest alloc] init];
+    request.cameraID = cameraID;
+    request.frameTime = [NSProcessInfo processInfo].systemUptime;   // The clock the trackers run on
+    request.completion = completion;
+    request.metricsCamera = [self metricsCameraForID:cameraID];
+    request.submitTime = submitTime;
+    request.captureTime = captureTime > 0 && captureTime <= submitTime ? captureTime : submitTime;
+
+    // Adaptive inference: quiet scenes skip most frames, activity runs at the active rate
+    if (gate && !RTSPActivityGateOfferFrame(gate, slot, request.frameTime, motionScore, [self movingTracksForCamera:cameraID])) {
+        if (completion) completion([self predictedDetectionsForCamera:cameraID frameTime:request.frameTime], nil);
         return;
     }
 
-    [self.activeCameras addObject:cameraID];
+    // The scheduler keeps only the camera's latest frame; an older one still
+    // waiting completes at once as dropped
+    CVPixelBufferRetain(pixelBuffer);
+    void *userData = (__bridge_retained void *)request;
+    RTSPInferenceSubmitResult result = RTSPInferenceSchedulerSubmit(scheduler, slot, pixelBuffer, userData);
+    if (result != RTSPInferenceSubmitQueued) {
+        // Not this frame's inferenceInterval turn (or the camera was just stopped)
+        CVPixelBufferRelease(pixelBuffer);
+        CFBridgingRelease(userData);
+        if (completion) completion([self predictedDetectionsForCamera:cameraID frameTime:request.frameTime], nil);
+    }
+}
 
-    dispatch_async(self.processingQueue, ^{
-        NSDate *startTime = [NSDate date];
+#pragma mark - Inference Scheduling
 
-        // Create Vision request
-        VNCoreMLRequest *request = [[VNCoreMLRequest alloc] initWithModel:self.visionModel
-                                                        completionHandler:^(VNRequest *request, NSError *error) {
-            if (error) {
-                NSLog(@"[MLX] Vision request error: %@", error);
-                if (completion) {
-                    dispatch_async(dispatch_get_main_queue(), ^{
-                        completion(nil, error);
-                    });
-                }
-                return;
+/// Packed float32 rows from a Core ML output, which may hold Float16 or
+/// Double and pad its rows
+static BOOL RTSPMLXCopyOutput(MLMultiArray *array, float *output, size_t rows, size_t columns) {
+    NSUInteger dimensions = array.shape.count;
+    if (dimensions < 2 || array.shape[dimensions - 2].unsignedIntegerValue != rows ||
+        array.shape[dimensions - 1].unsignedIntegerValue != columns || array.strides[dimensions - 1].integerValue != 1) {
+        return NO;
+    }
+    BOOL half = NO;
+    if (@available(macOS 12.0, *)) {
+        half = array.dataType == MLMultiArrayDataTypeFloat16;
+    }
+    size_t rowStride = array.strides[dimensions - 2].unsignedIntegerValue;
+    for (size_t r = 0; r < rows; r++) {
+        float *destination = output + r * columns;
+        if (array.dataType == MLMultiArrayDataTypeFloat32) {
+            memcpy(destination, (const float *)array.dataPointer + r * rowStride, columns * sizeof(float));
+        } else if (array.dataType == MLMultiArrayDataTypeDouble) {
+            vDSP_vdpsp((const double *)array.dataPointer + r * rowStride, 1, destination, 1, columns);
+        } else if (half) {
+            vImage_Buffer source = {(uint16_t *)array.dataPointer + r * rowStride, 1, columns, columns * sizeof(uint16_t)};
+            vImage_Buffer converted = {destination, 1, columns, columns * sizeof(float)};
+            vImageConvert_Planar16FtoPlanarF(&source, &converted, kvImageNoFlags);
+        } else {
+            return NO;
+        }
+    }
+    return YES;
+}
+
+/// Letterbox a full-range NV12 camera frame into the model's input; nil for other formats
+static MLFeatureValue *RTSPMLXTensorInput(RTSPMLXTensorModel *tensorModel, CVPixelBufferRef frame, RTSPLetterbox *letterbox) {
+    if (CVPixelBufferGetPixelFormatType(frame) != kCVPixelFormatType_420YpCbCr8BiPlanarFullRange) {
+        return nil;
+    }
+    RTSPDetectionPreprocessorRef preprocessor = [tensorModel checkoutPreprocessor];
+    if (!preprocessor) {
+        return nil;
+    }
+
+    MLFeatureValue *value = nil;
+    CVPixelBufferLockBaseAddress(frame, kCVPixelBufferLock_ReadOnly);
+    const uint8_t *luma = CVPixelBufferGetBaseAddressOfPlane(frame, 0);
+    const uint8_t *chroma = CVPixelBufferGetBaseAddressOfPlane(frame, 1);
+    size_t lumaBytesPerRow = CVPixelBufferGetBytesPerRowOfPlane(frame, 0);
+    size_t chromaBytesPerRow = CVPixelBufferGetBytesPerRowOfPlane(frame, 1);
+    uint32_t width = (uint32_t)CVPixelBufferGetWidth(frame), height = (uint32_t)CVPixelBufferGetHeight(frame);
+    if (tensorModel.imageInput) {
+        CVPixelBufferRef input = NULL;
+        if (CVPixelBufferPoolCreatePixelBuffer(kCFAllocatorDefault, tensorModel.inputPool, &input) == kCVReturnSuccess) {
+            CVPixelBufferLockBaseAddress(input, 0);
+            bool converted = RTSPDetectionPreprocessNV12(preprocessor, luma, lumaBytesPerRow, chroma, chromaBytesPerRow,
+                                                         width, height, CVPixelBufferGetBaseAddress(input),
+                                                         CVPixelBufferGetBytesPerRow(input), letterbox);
+            CVPixelBufferUnlockBaseAddress(input, 0);
+            if (converted) {
+                value = [MLFeatureValue featureValueWithPixelBuffer:input];
             }
+            CVPixelBufferRelease(input);
+        }
+    } else {
+        NSArray<NSNumber *> *shape = @[@1, @3, @(tensorModel.inputHeight), @(tensorModel.inputWidth)];
+        MLMultiArray *array = [[MLMultiArray alloc] initWithShape:shape dataType:MLMultiArrayDataTypeFloat32 error:nil];
+        if (array && RTSPDetectionPreprocessNV12(preprocessor, luma, lumaBytesPerRow, chroma, chromaBytesPerRow,
+                                                 width, height, array.dataPointer, 0, letterbox)) {
+            value = [MLFeatureValue featureValueWithMultiArray:array];
+        }
+    }
+    CVPixelBufferUnlockBaseAddress(frame, kCVPixelBufferLock_ReadOnly);
+    [tensorModel returnPreprocessor:preprocessor];
+    return value;
+}
 
-            // Process results
-            NSArray<RTSPDetection *> *detections = [self processVisionResults:request.results];
+/// Decode one raw output into detections sharing one timestamp; nil if the
+/// output does not have the model's shape
+static NSArray<RTSPDetection *> *RTSPMLXDecodeTensor(RTSPMLXTensorModel *tensorModel, RTSPDetectionDecoderRef decoder,
+                                                     MLMultiArray *output, const RTSPLetterbox *letterbox) {
+    BOOL channelsFirst = tensorModel.layout == RTSPDetectionLayoutChannelsFirst;
+    size_t rows = channelsFirst ? 4 + tensorModel.classCount : tensorModel.anchorCount;
+    size_t columns = channelsFirst ? tensorModel.anchorCount : 5 + tensorModel.classCount;
+    if (!decoder || !output || RTSPDetectionDecoderOutputLength(decoder) != rows * columns) {
+        return nil;
+    }
+    float *values = malloc(rows * columns * sizeof(float));
+    RTSPDetectionBuffer buffer;
+    NSMutableArray<RTSPDetection *> *detections = nil;
+    if (values && RTSPDetectionBufferInit(&buffer, 300)) {
+        if (RTSPMLXCopyOutput(output, values, rows, columns) &&
+            RTSPDetectionDecoderDecode(decoder, values, letterbox, &buffer)) {
+            NSArray<NSString *> *classNames = tensorModel.classNames;
+            NSDate *timestamp = [NSDate date];
+            detections = [NSMutableArray arrayWithCapacity:buffer.count];
+            for (uint32_t i = 0; i < buffer.count; i++) {
+                CGRect box = CGRectMake(buffer.x[i], buffer.y[i], buffer.width[i], buffer.height[i]);
+                [detections addObject:[[RTSPDetection alloc] initWithLabel:classNames[buffer.classID[i]]
+                                                                confidence:buffer.score[i]
+                                                               boundingBox:box
+                                                                 timestamp:timestamp]];
+            }
+        }
+        RTSPDetectionBufferFree(&buffer);
+    }
+    free(values);
+    return detections;
+}
 
-            // Update statistics
-            NSTimeInterval inferenceTime = [[NSDate date] timeIntervalSinceDate:startTime] * 1000; // ms
-            self.totalInferenceTime += inferenceTime;
-            self.inferenceCount++;
-            self.framesProcessed++;
-            self.detectionsCount += detections.count;
+/// Raw tensor models: every frame is letterboxed natively, the batch runs as
+/// one Core ML prediction and the outputs are decoded without Vision
+static void RTSPMLXInferTensorBatch(RTSPMLXProcessor *processor, RTSPInferenceJob *jobs, size_t count) {
+    RTSPMLXTensorModel *tensorModel = processor.tensorModel;
+    RTSPDetectionDecoderRef decoder = processor.tensorDecoder;
+    MLModel *model = processor.model;
+    RTSPLetterbox *letterboxes = calloc(count, sizeof(*letterboxes));
+    void **inputs = calloc(count, sizeof(*inputs));
+    size_t *batchJobs = calloc(count, sizeof(*batchJobs));     // Job of each frame in the Core ML batch
+    if (!letterboxes || !inputs || !batchJobs) {
+        for (size_t i = 0; i < count; i++) {
+            jobs[i].failed = true;
+        }
+        free(letterboxes);
+        free(inputs);
+        free(batchJobs);
+        return;
+    }
 
-            NSLog(@"[MLX] Camera %@: Found %lu objects in %.1fms",
-                  cameraID, (unsigned long)detections.count, inferenceTime);
+    dispatch_apply(count, DISPATCH_APPLY_AUTO, ^(size_t i) {
+        @autoreleasepool {
+            CFTimeInterval start = CACurrentMediaTime();
+            MLFeatureValue *value = RTSPMLXTensorInput(tensorModel, (CVPixelBufferRef)jobs[i].frame, &letterboxes[i]);
+            inputs[i] = value ? (__bridge_retained void *)value : NULL;
+            ((__bridge RTSPMLXFrameRequest *)jobs[i].userData).preprocessDuration = CACurrentMediaTime() - start;
+        }
+    });
 
-            // Notify delegate
-            if ([self.delegate respondsToSelector:@selector(mlxProcessor:didDetectObjects:forCamera:)]) {
-                dispatch_async(dispatch_get_main_queue(), ^{
-                    [self.delegate mlxProcessor:self didDetectObjects:detections forCamera:cameraID];
-                });
-            }
+    NSMutableArray<id<MLFeatureProvider>> *providers = [NSMutableArray arrayWithCapacity:count];
+    for (size_t i = 0; i < count; i++) {
+        MLFeatureValue *value = inputs[i] ? (__bridge_transfer MLFeatureValue *)inputs[i] : nil;
+        MLDictionaryFeatureProvider *provider = value
+            ? [[MLDictionaryFeatureProvider alloc] initWithDictionary:@{tensorModel.inputName: value} error:nil]
+            : nil;
+        if (!provider) {
+            NSError *error = [NSError errorWithDomain:@"RTSPMLXProcessor"
+                                                 code:415
+                                             userInfo:@{NSLocalizedDescriptionKey: @"Frame is not full-range NV12"}];
+            jobs[i].result = (__bridge_retained void *)error;
+            jobs[i].failed = true;
+            continue;
+        }
+        batchJobs[providers.count] = i;
+        [providers addObject:provider];
+    }
 
-            if (completion) {
-                dispatch_async(dispatch_get_main_queue(), ^{
-                    completion(detections, nil);
-                });
+    NSError *error = nil;
+    CFTimeInterval inferenceStart = CACurrentMediaTime();
+    id<MLBatchProvider> outputs = providers.count > 0
+        ? [model predictionsFromBatch:[[MLArrayBatchProvider alloc] initWithFeatureProviderArray:providers] error:&error]
+        : nil;
+    CFTimeInterval inferenceDuration = CACurrentMediaTime() - inferenceStart;
+    if (providers.count > 0 && !outputs) {
+        NSLog(@"[MLX] Failed to run a batch of %lu frames: %@", (unsigned long)providers.count, error);
+    }
+    dispatch_apply(outputs ? (size_t)outputs.count : 0, DISPATCH_APPLY_AUTO, ^(size_t b) {
+        @autoreleasepool {
+            RTSPInferenceJob *job = &jobs[batchJobs[b]];
+            RTSPMLXFrameRequest *request = (__bridge RTSPMLXFrameRequest *)job->userData;
+            CFTimeInterval start = CACurrentMediaTime();
+            MLMultiArray *output = [[outputs featuresAtIndex:(NSInteger)b] featureValueForName:tensorModel.outputName].multiArrayValue;
+            NSArray<RTSPDetection *> *detections = RTSPMLXDecodeTensor(tensorModel, decoder, output, &letterboxes[batchJobs[b]]);
+            request.inferenceDuration = inferenceDuration;
+            request.postprocessDuration = CACurrentMediaTime() - start;
+            if (detections) {
+                job->result = (__bridge_retained void *)detections;
+                request.decoded = YES;
+            } else {
+                job->failed = true;
             }
-        }];
+        }
+    });
+    for (NSUInteger b = outputs ? (NSUInteger)outputs.count : 0; b < providers.count; b++) {
+        jobs[batchJobs[b]].result = error ? (__bridge_retained void *)error : NULL;
+        jobs[batchJobs[b]].failed = true;
+    }
+    free(batchJobs);
+    free(letterboxes);
+    free(inputs);
+}
 
-        // Configure request
-        request.imageCropAndScaleOption = VNImageCropAndScaleOptionScaleFit;
+/// Scheduler backend: runs a batch of camera frames through the model. Raw
+/// tensor models take the whole batch at once; Vision takes one image per
+/// handler, so for pipeline models the batch's requests run concurrently.
+static void RTSPMLXInferBatch(void *context, RTSPInferenceJob *jobs, size_t count) {
+    @autoreleasepool {
+        RTSPMLXProcessor *processor = (__bridge RTSPMLXProcessor *)context;
+        VNCoreMLModel *model = processor.visionModel;
+        NSDate *start = [NSDate date];
+        CFTimeInterval batchStart = CACurrentMediaTime();
+        for (size_t i = 0; i < count; i++) {
+            RTSPMLXFrameRequest *request = (__bridge RTSPMLXFrameRequest *)jobs[i].userData;
+            request.batchStartTime = batchStart;
+            request.batchSize = (uint32_t)count;
+        }
 
-        // Create request handler
-        VNImageRequestHandler *handler = [[VNImageRequestHandler alloc] initWithCVPixelBuffer:pixelBuffer
-                                                                                      options:@{}];
+        if (processor.tensorModel) {
+            RTSPMLXInferTensorBatch(processor, jobs, count);
+        } else {
+            dispatch_apply(count, DISPATCH_APPLY_AUTO, ^(size_t i) {
+                RTSPInferenceJob *job = &jobs[i];
+                VNCoreMLRequest *request = [[VNCoreMLRequest alloc] initWithModel:model];
+                request.imageCropAndScaleOption = VNImageCropAndScaleOptionScaleFit;
+                VNImageRequestHandler *handler = [[VNImageRequestHandler alloc] initWithCVPixelBuffer:(CVPixelBufferRef)job->frame
+                                                                                              options:@{}];
+                NSError *error = nil;
+                CFTimeInterval requestStart = CACurrentMediaTime();
+                BOOL performed = [handler performRequests:@[request] error:&error];
+                ((__bridge RTSPMLXFrameRequest *)job->userData).inferenceDuration = CACurrentMediaTime() - requestStart;
+                if (performed) {
+                    job->result = (__bridge_retained void *)(request.results ?: @[]);
+                } else {
+                    NSLog(@"[MLX] Failed to perform Vision request: %@", error);
+                    job->result = error ? (__bridge_retained void *)error : NULL;
+                    job->failed = true;
+                }
+            });
+        }
 
-        // Perform request
-        NSError *error = nil;
-        if (![handler performRequests:@[request] error:&error]) {
-            NSLog(@"[MLX] Failed to perform Vision request: %@", error);
-            if (completion) {
-                dispatch_async(dispatch_get_main_queue(), ^{
-                    completion(nil, error);
-                });
+        NSTimeInterval share = [[NSDate date] timeIntervalSinceDate:start] * 1000 / count; // ms
+        for (size_t i = 0; i < count; i++) {
+            ((__bridge RTSPMLXFrameRequest *)jobs[i].userData).inferenceTime = share;
+        }
+    }
+}
+
+/// Scheduler completion: every submitted frame ends here exactly once
+static void RTSPMLXInferenceCompleted(void *context, const RTSPInferenceJob *job, RTSPInferenceOutcome outcome) {
+    @autoreleasepool {
+        RTSPMLXProcessor *processor = (__bridge RTSPMLXProcessor *)context;
+        RTSPMLXFrameRequest *request = (__bridge_transfer RTSPMLXFrameRequest *)job->userData;
+        CVPixelBufferRelease((CVPixelBufferRef)job->frame);
+        id result = job->result ? (__bridge_transfer id)job->result : nil;
+        [processor finishFrameRequest:request outcome:outcome result:result];
+    }
+}
+
+- (void)finishFrameRequest:(RTSPMLXFrameRequest *)request outcome:(RTSPInferenceOutcome)outcome result:(nullable id)result {
+    void (^completion)(NSArray<RTSPDetection *> * _Nullable, NSError * _Nullable) = request.completion;
+    NSString *cameraID = request.cameraID;
+
+    if (outcome == RTSPInferenceOutcomeFailed) {
+        NSError *error = [result isKindOfClass:[NSError class]] ? result
+            : [NSError errorWithDomain:@"RTSPMLXProcessor"
+                                  code:500
+                              userInfo:@{NSLocalizedDescriptionKey: @"Inference failed"}];
+        if (completion) {
+            dispatch_async(dispatch_get_main_queue(), ^{
+                completion(nil, error);
+            });
+        }
+        return;
+    }
+
+    if (outcome != RTSPInferenceOutcomeInferred) {
+        // Dropped for a newer frame or for waiting too long: answered like a skipped frame
+        if (completion) {
+            NSArray<RTSPDetection *> *predicted = [self predictedDetectionsForCamera:cameraID frameTime:request.frameTime];
+            dispatch_async(dispatch_get_main_queue(), ^{
+                completion(predicted, nil);
+            });
+        }
+        return;
+    }
+
+    // Process results, keeping weaker detections that may continue a track
+    CFTimeInterval postprocessStart = CACurrentMediaTime();
+    NSArray<RTSPDetection *> *detections = request.decoded
+        ? result
+        : [self processVisionResults:result minimumConfidence:[self inferenceConfidenceThreshold]];
+    if (self.configuration.trackingEnabled) {
+        detections = [self trackDetections:detections forCamera:cameraID frameTime:request.frameTime];
+    }
+    request.postprocessDuration += CACurrentMediaTime() - postprocessStart;
+
+    // Update statistics
+    @synchronized (self) {
+        self.totalInferenceTime += request.inferenceTime;
+        self.inferenceCount++;
+        self.framesProcessed++;
+        self.detectionsCount += detections.count;
+    }
+
+    [self recordLatenciesOfRequest:request detections:detections.count];
+
+    // Notify delegate
+    if ([self.delegate respondsToSelector:@selector(mlxProcessor:didDetectObjects:forCamera:)]) {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [self.delegate mlxProcessor:self didDetectObjects:detections forCamera:cameraID];
+        });
+    }
+
+    if (completion) {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            completion(detections, nil);
+        });
+    }
+}
+
+/// Histogram camera for a camera ID, added on first use
+- (uint32_t)metricsCameraForID:(NSString *)cameraID {
+    @synchronized (self.metricsCameras) {
+        NSNumber *camera = self.metricsCameras[cameraID];
+        if (!camera) {
+            camera = @(RTSPLatencyMetricsAddCamera(self.latencyMetrics, cameraID.UTF8String));
+            self.metricsCameras[cameraID] = camera;
+        }
+        return camera.unsignedIntValue;
+    }
+}
+
+/// Histogram an inferred frame's stages, and trace a sample of frames
+/// (every 100th per camera and any slower than 0.5 s) instead of each one
+- (void)recordLatenciesOfRequest:(RTSPMLXFrameRequest *)request detections:(NSUInteger)detections {
+    RTSPLatencyMetricsRef metrics = self.latencyMetrics;
+    uint32_t camera = request.metricsCamera;
+    CFTimeInterval total = CACurrentMediaTime() - request.captureTime;
+    CFTimeInterval grab = request.submitTime - request.captureTime;
+    CFTimeInterval queue = request.batchStartTime - request.submitTime;
+
+    RTSPLatencyMetricsRecord(metrics, camera, RTSPLatencyStageGrab, grab);
+    RTSPLatencyMetricsRecord(metrics, camera, RTSPLatencyStageQueue, queue);
+    if (request.preprocessDuration > 0) {
+        RTSPLatencyMetricsRecord(metrics, camera, RTSPLatencyStagePreprocess, request.preprocessDuration);
+    }
+    RTSPLatencyMetricsRecord(metrics, camera, RTSPLatencyStageInference, request.inferenceDuration);
+    RTSPLatencyMetricsRecord(metrics, camera, RTSPLatencyStagePostprocess, request.postprocessDuration);
+    RTSPLatencyMetricsRecord(metrics, camera, RTSPLatencyStageTotal, total);
+
+    if (RTSPLatencyMetricsShouldTrace(metrics, camera, total)) {
+        NSLog(@"[MLX] trace camera=%@ detections=%lu batch=%u grab_ms=%.1f queue_ms=%.1f preprocess_ms=%.1f "
+              @"inference_ms=%.1f postprocess_ms=%.1f total_ms=%.1f",
+              request.cameraID, (unsigned long)detections, request.batchSize, grab * 1000, queue * 1000,
+              request.preprocessDuration * 1000, request.inferenceDuration * 1000,
+              request.postprocessDuration * 1000, total * 1000);
+    }
+}
+
+- (void)recordLatency:(NSTimeInterval)seconds stage:(RTSPLatencyStage)stage forCamera:(NSString *)cameraID {
+    RTSPLatencyMetricsRecord(self.latencyMetrics, [self metricsCameraForID:cameraID], stage, seconds);
+}
+
+- (NSString *)prometheusMetrics {
+    size_t length = RTSPLatencyMetricsWritePrometheus(self.latencyMetrics, NULL, 0);
+    NSMutableData *text = [NSMutableData dataWithLength:length + 1];
+    RTSPLatencyMetricsWritePrometheus(self.latencyMetrics, text.mutableBytes, text.length);
+    text.length = strlen(text.bytes);
+
+    NSDictionary *metrics = [self performanceMetrics];
+    NSMutableString *output = [[NSMutableString alloc] initWithData:text encoding:NSUTF8StringEncoding] ?: [NSMutableString string];
+    [output appendFormat:@"# HELP rtsp_detection_frames_total Frames inferred.\n"
+                         @"# TYPE rtsp_detection_frames_total counter\n"
+                         @"rtsp_detection_frames_total %ld\n"
+                         @"# HELP rtsp_detection_frames_dropped_total Frames replaced by a newer one or too old to infer.\n"
+                         @"# TYPE rtsp_detection_frames_dropped_total counter\n"
+                         @"rtsp_detection_frames_dropped_total %llu\n"
+                         @"# HELP rtsp_detection_objects_total Objects detected.\n"
+                         @"# TYPE rtsp_detection_objects_total counter\n"
+                         @"rtsp_detection_objects_total %ld\n"
+                         @"# HELP rtsp_detection_inference_rate Inferences per second across cameras.\n"
+                         @"# TYPE rtsp_detection_inference_rate gauge\n"
+                         @"rtsp_detection_inference_rate %.3f\n",
+                         (long)self.framesProcessed, [metrics[@"framesDropped"] unsignedLongLongValue],
+                         (long)self.detectionsCount, [metrics[@"inferenceRate"] doubleValue]];
+    return output;
+}
+
+/// Lowest confidence inference keeps: weaker detections may still continue a track
+- (float)inferenceConfidenceThreshold {
+    return self.configuration.trackingEnabled
+        ? MIN(self.configuration.trackingLowConfidence, self.configuration.confidenceThreshold)
+        : self.configuration.confidenceThreshold;
+}
+
+/// Decoder for a raw tensor model with the configuration's thresholds and classes
+- (RTSPDetectionDecoderRef)createTensorDecoder {
+    RTSPMLXTensorModel *tensorModel = self.tensorModel;
+    if (!tensorModel) {
+        return NULL;
+    }
+    RTSPDetectionDecoderConfig config;
+    RTSPDetectionDecoderConfigInit(&config, tensorModel.anchorCount, tensorModel.classCount);
+    config.layout = tensorModel.layout;
+    config.confidenceThreshold = [self inferenceConfidenceThreshold];
+    config.iouThreshold = self.configuration.iouThreshold;
+    RTSPDetectionDecoderRef decoder = RTSPDetectionDecoderCreate(&config);
+
+    NSArray<NSString *> *enabledClasses = self.configuration.enabledClasses;
+    if (decoder && enabledClasses) {
+        uint32_t *classes = calloc(enabledClasses.count + 1, sizeof(*classes));
+        uint32_t count = 0;
+        for (NSString *name in enabledClasses) {
+            NSUInteger classID = [tensorModel.classNames indexOfObject:name];
+            if (classes && classID != NSNotFound) {
+                classes[count++] = (uint32_t)classID;
             }
         }
-    });
+        if (classes && count == 0) {
+            classes[count++] = UINT32_MAX;  // None of the model's classes: keep nothing
+        }
+        RTSPDetectionDecoderSetEnabledClasses(decoder, classes, count);
+        free(classes);
+    }
+    return decoder;
+}
+
+/// Replace the scheduler to pick up the configuration. Frames waiting in the
+/// old one complete as dropped; cameras re-register on their next frame.
+- (void)rebuildScheduler {
+    RTSPInferenceSchedulerRef previous = NULL;
+    RTSPActivityGateRef previousGate = NULL;
+    @synchronized (self.cameraSlots) {
+        previous = self.scheduler;
+        previousGate = self.activityGate;
+        self.scheduler = NULL;
+        self.activityGate = NULL;
+        [self.cameraSlots removeAllObjects];
+    }
+    RTSPInferenceSchedulerRelease(previous);
+    RTSPActivityGateRelease(previousGate);
+    RTSPDetectionDecoderRelease(self.tensorDecoder);   // No batch is running now
+    self.tensorDecoder = [self createTensorDecoder];
+    if (!self.model) {
+        return;
+    }
+
+    RTSPInferenceSchedulerConfig config;
+    RTSPInferenceSchedulerConfigInit(&config);
+    config.maxConcurrent = (uint32_t)MAX(self.configuration.maxConcurrentStreams, 1);
+    config.maxBatch = config.maxConcurrent;
+    config.inferenceInterval = self.configuration.adaptiveInference ? 1 : (uint32_t)MAX(self.configuration.inferenceInterval, 1);
+    RTSPInferenceBackend backend = {
+        .context = (__bridge void *)self,
+        .maxBatch = 0,
+        .infer = RTSPMLXInferBatch,
+    };
+    RTSPInferenceSchedulerRef scheduler = RTSPInferenceSchedulerCreate(&config, &backend, RTSPMLXInferenceCompleted,
+                                                                       (__bridge void *)self);
+    if (!scheduler) {
+        NSLog(@"[MLX] Failed to start the inference scheduler");
+        return;
+    }
+
+    RTSPActivityGateRef gate = NULL;
+    if (self.configuration.adaptiveInference) {
+        RTSPActivityGateConfig gateConfig;
+        RTSPActivityGateConfigInit(&gateConfig);
+        gateConfig.activeRate = MAX(self.configuration.activeInferenceRate, 0.01);
+        gateConfig.idleRate = MAX(self.configuration.idleInferenceRate, 0.0);
+        gateConfig.budget = MAX(self.configuration.inferenceBudget, 0.0);
+        gateConfig.maxCameras = config.maxCameras;
+        gate = RTSPActivityGateCreate(&gateConfig);
+        if (!gate) {
+            NSLog(@"[MLX] Failed to start adaptive inference; running every frame");
+        }
+    }
+    @synchronized (self.cameraSlots) {
+        self.scheduler = scheduler;
+        self.activityGate = gate;
+    }
+    if (gate) {
+        NSLog(@"[MLX] Inference scheduler: %u frames at once, %.1f-%.1f inferences/s per camera by activity",
+              config.maxConcurrent, self.configuration.idleInferenceRate, self.configuration.activeInferenceRate);
+    } else {
+        NSLog(@"[MLX] Inference scheduler: %u frames at once, every %u frames per camera",
+              config.maxConcurrent, config.inferenceInterval);
+    }
+}
+
+- (void)setConfiguration:(RTSPMLXConfiguration *)configuration {
+    _configuration = configuration;
+    if (self.model) {
+        [self rebuildScheduler];
+    }
 }
 
 - (void)processImage:(CGImageRef)image completion:(void (^)(NSArray<RTSPDetection *> * _Nullable, NSError * _Nullable))completion {
@@ -276,7 +1016,10 @@
                 return;
             }
 
-            NSArray<RTSPDetection *> *detections = [self processVisionResults:request.results];
+            NSArray<RTSPDetection *> *detections = self.tensorModel
+                ? [self processTensorResults:request.results
+                                   imageSize:CGSizeMake(CGImageGetWidth(image), CGImageGetHeight(image))]
+                : [self processVisionResults:request.results minimumConfidence:self.configuration.confidenceThreshold];
 
             NSTimeInterval inferenceTime = [[NSDate date] timeIntervalSinceDate:startTime] * 1000;
             NSLog(@"[MLX] Image: Found %lu objects in %.1fms",
@@ -304,7 +1047,7 @@
     });
 }
 
-- (NSArray<RTSPDetection *> *)processVisionResults:(NSArray<VNObservation *> *)results {
+- (NSArray<RTSPDetection *> *)processVisionResults:(NSArray<VNObservation *> *)results minimumConfidence:(float)minimumConfidence {
     NSMutableArray<RTSPDetection *> *detections = [NSMutableArray array];
 
     for (VNObservation *observation in results) {
@@ -316,7 +1059,7 @@
             if (!topLabel) continue;
 
             // Filter by confidence
-            if (topLabel.confidence < self.configuration.confidenceThreshold) {
+            if (topLabel.confidence < minimumConfidence) {
                 continue;
             }
 
@@ -345,29 +1088,292 @@
     return [detections copy];
 }
 
+/// Raw tensor output from Vision, which scaled the whole image to fit the
+/// input like the letterbox does
+- (NSArray<RTSPDetection *> *)processTensorResults:(NSArray<VNObservation *> *)results imageSize:(CGSize)imageSize {
+    VNCoreMLFeatureValueObservation *observation = (VNCoreMLFeatureValueObservation *)results.firstObject;
+    if (![observation isKindOfClass:[VNCoreMLFeatureValueObservation class]]) {
+        return @[];
+    }
+    RTSPMLXTensorModel *tensorModel = self.tensorModel;
+    RTSPLetterbox letterbox = RTSPLetterboxMake((uint32_t)imageSize.width, (uint32_t)imageSize.height,
+                                                tensorModel.inputWidth, tensorModel.inputHeight);
+    NSArray<RTSPDetection *> *detections = RTSPMLXDecodeTensor(tensorModel, self.tensorDecoder,
+                                                               observation.featureValue.multiArrayValue, &letterbox);
+    float threshold = self.configuration.confidenceThreshold;
+    return [detections filteredArrayUsingPredicate:[NSPredicate predicateWithBlock:^BOOL(RTSPDetection *detection, NSDictionary *bindings) {
+        return detection.confidence >= threshold;
+    }]] ?: @[];
+}
+
+#pragma mark - Tracking
+
+- (RTSPCameraTracks *)tracksForCamera:(NSString *)cameraID {
+    RTSPCameraTracks *tracks = self.cameraTracks[cameraID];
+    if (!tracks) {
+        tracks = [[RTSPCameraTracks alloc] initWithConfiguration:self.configuration];
+        self.cameraTracks[cameraID] = tracks;
+    }
+    return tracks;
+}
+
+/// Tracks slower than this (frame widths / s) count as standing still for adaptive inference
+static const float RTSPMovingTrackSpeed = 0.02f;
+
+static NSString *RTSPTrackingID(NSString *cameraID, uint64_t trackID) {
+    return [NSString stringWithFormat:@"%@#%llu", cameraID, (unsigned long long)trackID];
+}
+
+/// Give an inference frame's detections their tracks' IDs. Weaker detections
+/// survive only where they continue a track.
+- (NSArray<RTSPDetection *> *)trackDetections:(NSArray<RTSPDetection *> *)detections
+                                    forCamera:(NSString *)cameraID
+                                    frameTime:(NSTimeInterval)frameTime {
+    float threshold = self.configuration.confidenceThreshold;
+    __block NSMutableArray<RTSPDetection *> *result = [NSMutableArray arrayWithCapacity:detections.count];
+    __block NSMutableArray<RTSPTrackingEvent *> *trackEvents = [NSMutableArray array];
+
+    dispatch_sync(self.trackingQueue, ^{
+        RTSPCameraTracks *tracks = [self tracksForCamera:cameraID];
+        size_t count = detections.count;
+        RTSPTrackerDetection *input = calloc(MAX(count, 1), sizeof(*input));
+        uint64_t *trackIDs = calloc(MAX(count, 1), sizeof(*trackIDs));
+        for (size_t i = 0; i < count; i++) {
+            RTSPDetection *detection = detections[i];
+            input[i].x = detection.boundingBox.origin.x;
+            input[i].y = detection.boundingBox.origin.y;
+            input[i].width = detection.boundingBox.size.width;
+            input[i].height = detection.boundingBox.size.height;
+            input[i].score = detection.confidence;
+            input[i].classID = [tracks classIDForLabel:detection.label];
+        }
+
+        if (!input || !trackIDs || !RTSPTrackerUpdate(tracks.tracker, frameTime, input, count, trackIDs)) {
+            // A frame that finished after a newer one: report it untracked
+            for (RTSPDetection *detection in detections) {
+                if (detection.confidence >= threshold) {
+                    [result addObject:detection];
+                }
+            }
+            free(input);
+            free(trackIDs);
+            return;
+        }
+
+        size_t trackCount = RTSPTrackerGetTracks(tracks.tracker, frameTime, NULL, 0);
+        RTSPTrack *current = calloc(MAX(trackCount, 1), sizeof(*current));
+        RTSPTrackerGetTracks(tracks.tracker, frameTime, current, trackCount);
+        uint32_t moving = 0;
+        for (size_t t = 0; t < trackCount; t++) {
+            float speed = hypotf(current[t].velocityX, current[t].velocityY);
+            if (current[t].state == RTSPTrackStateConfirmed && speed >= RTSPMovingTrackSpeed) {
+                moving++;
+            }
+        }
+        tracks.movingTracks = moving;
+        for (size_t i = 0; i < count; i++) {
+            if (trackIDs[i] == 0) {
+                continue;
+            }
+            RTSPDetection *detection = detections[i];
+            detection.trackingID = RTSPTrackingID(cameraID, trackIDs[i]);
+            for (size_t t = 0; t < trackCount; t++) {
+                if (current[t].trackID == trackIDs[i]) {
+                    detection.tracked = current[t].state == RTSPTrackStateConfirmed;
+                    break;
+                }
+            }
+            [result addObject:detection];
+        }
+        free(current);
+        free(input);
+        free(trackIDs);
+
+        size_t eventCount = 0;
+        const RTSPTrackEvent *events = RTSPTrackerEvents(tracks.tracker, &eventCount);
+        NSTimeInterval clockOffset = [NSDate timeIntervalSinceReferenceDate] - [NSProcessInfo processInfo].systemUptime;
+        for (size_t e = 0; e < eventCount; e++) {
+            RTSPTrackingEvent *event = [[RTSPTrackingEvent alloc] init];
+            switch (events[e].type) {
+                case RTSPTrackEventStarted: event.type = RTSPTrackingEventTypeStarted; break;
+                case RTSPTrackEventEnded: event.type = RTSPTrackingEventTypeEnded; break;
+                case RTSPTrackEventZoneEntered: event.type = RTSPTrackingEventTypeEnteredZone; break;
+                case RTSPTrackEventZoneExited: event.type = RTSPTrackingEventTypeExitedZone; break;
+            }
+            event.trackingID = RTSPTrackingID(cameraID, events[e].trackID);
+            event.label = events[e].classID < tracks.labels.count ? tracks.labels[events[e].classID] : @"";
+            event.boundingBox = CGRectMake(events[e].x, events[e].y, events[e].width, events[e].height);
+            if (events[e].type == RTSPTrackEventZoneEntered || events[e].type == RTSPTrackEventZoneExited) {
+                event.zoneName = events[e].zone < tracks.zoneNames.count ? tracks.zoneNames[events[e].zone] : nil;
+            }
+            event.duration = events[e].duration;
+            event.timestamp = [NSDate dateWithTimeIntervalSinceReferenceDate:events[e].timestamp + clockOffset];
+            [trackEvents addObject:event];
+        }
+    });
+
+    if (trackEvents.count > 0 && [self.delegate respondsToSelector:@selector(mlxProcessor:didUpdateTracks:forCamera:)]) {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [self.delegate mlxProcessor:self didUpdateTracks:trackEvents forCamera:cameraID];
+        });
+    }
+    return result;
+}
+
+/// Confirmed tracks seen at the last inference, moved to the frame time
+- (NSArray<RTSPDetection *> *)predictedDetectionsForCamera:(NSString *)cameraID frameTime:(NSTimeInterval)frameTime {
+    if (!self.configuration.trackingEnabled) {
+        return @[];
+    }
+    __block NSMutableArray<RTSPDetection *> *detections = [NSMutableArray array];
+    dispatch_sync(self.trackingQueue, ^{
+        RTSPCameraTracks *tracks = self.cameraTracks[cameraID];
+        if (!tracks) {
+            return;
+        }
+        size_t trackCount = RTSPTrackerGetTracks(tracks.tracker, frameTime, NULL, 0);
+        RTSPTrack *current = calloc(MAX(trackCount, 1), sizeof(*current));
+        RTSPTrackerGetTracks(tracks.tracker, frameTime, current, trackCount);
+        for (size_t t = 0; t < trackCount; t++) {
+            if (current[t].state != RTSPTrackStateConfirmed || current[t].classID >= tracks.labels.count) {
+                continue;
+            }
+            RTSPDetection *detection = [[RTSPDetection alloc] initWithLabel:tracks.labels[current[t].classID]
+                                                                  confidence:current[t].score
+                                                                 boundingBox:CGRectMake(current[t].x, current[t].y,
+                                                                                        current[t].width, current[t].height)];
+            detection.trackingID = RTSPTrackingID(cameraID, current[t].trackID);
+            detection.tracked = YES;
+            detection.interpolated = YES;
+            [detections addObject:detection];
+        }
+        free(current);
+    });
+    return detections;
+}
+
+/// Confirmed tracks moving at the camera's last inference; they keep adaptive inference active
+- (uint32_t)movingTracksForCamera:(NSString *)cameraID {
+    if (!self.configuration.trackingEnabled) {
+        return 0;
+    }
+    __block uint32_t moving = 0;
+    dispatch_sync(self.trackingQueue, ^{
+        moving = self.cameraTracks[cameraID].movingTracks;
+    });
+    return moving;
+}
+
+- (void)setTrackingZones:(NSDictionary<NSString *, id> *)zones forCamera:(NSString *)cameraID {
+    NSArray<NSString *> *names = [zones.allKeys sortedArrayUsingSelector:@selector(compare:)];
+    if (names.count > RTSP_TRACKER_MAX_ZONES) {
+        NSLog(@"[MLX] Camera %@: tracking only the first %d of %lu zones", cameraID, RTSP_TRACKER_MAX_ZONES, (unsigned long)names.count);
+        names = [names subarrayWithRange:NSMakeRange(0, RTSP_TRACKER_MAX_ZONES)];
+    }
+
+    // Rects become their four corners; polygons beyond the point limit are dropped
+    NSMutableArray<NSString *> *tracked = [NSMutableArray arrayWithCapacity:names.count];
+    NSMutableData *points = [NSMutableData dataWithLength:names.count * RTSP_ZONE_INDEX_MAX_POINTS * sizeof(RTSPZonePoint)];
+    NSMutableData *polygons = [NSMutableData dataWithLength:MAX(names.count, 1) * sizeof(RTSPZonePolygon)];
+    for (NSString *name in names) {
+        id zone = zones[name];
+        RTSPZonePoint *corners = (RTSPZonePoint *)points.mutableBytes + tracked.count * RTSP_ZONE_INDEX_MAX_POINTS;
+        uint32_t count = 0;
+        if ([zone isKindOfClass:[NSArray class]] && [zone count] >= 3 && [zone count] <= RTSP_ZONE_INDEX_MAX_POINTS) {
+            for (NSValue *value in zone) {
+                corners[count++] = (RTSPZonePoint){value.pointValue.x, value.pointValue.y};
+            }
+        } else if ([zone isKindOfClass:[NSValue class]]) {
+            NSRect rect = [zone rectValue];
+            corners[0] = (RTSPZonePoint){NSMinX(rect), NSMinY(rect)};
+            corners[1] = (RTSPZonePoint){NSMaxX(rect), NSMinY(rect)};
+            corners[2] = (RTSPZonePoint){NSMaxX(rect), NSMaxY(rect)};
+            corners[3] = (RTSPZonePoint){NSMinX(rect), NSMaxY(rect)};
+            count = 4;
+        } else {
+            NSLog(@"[MLX] Camera %@: zone %@ is neither a rect nor 3-%d points", cameraID, name, RTSP_ZONE_INDEX_MAX_POINTS);
+            continue;
+        }
+        ((RTSPZonePolygon *)polygons.mutableBytes)[tracked.count] = (RTSPZonePolygon){corners, count, 0.0f};
+        [tracked addObject:name];
+    }
+
+    dispatch_async(self.trackingQueue, ^{
+        RTSPCameraTracks *tracks = [self tracksForCamera:cameraID];
+        RTSPTrackerSetZonePolygons(tracks.tracker, polygons.bytes, (uint32_t)tracked.count);
+        (void)points;       // The polygons point into it; keep it until the zone index has copied them
+        tracks.zoneNames = tracked;
+    });
+}
+
+- (NSTimeInterval)dwellTimeForTrackingID:(NSString *)trackingID inZone:(NSString *)zoneName camera:(NSString *)cameraID {
+    NSRange separator = [trackingID rangeOfString:@"#" options:NSBackwardsSearch];
+    if (separator.location == NSNotFound) {
+        return 0;
+    }
+    uint64_t trackID = strtoull([trackingID substringFromIndex:NSMaxRange(separator)].UTF8String, NULL, 10);
+    __block NSTimeInterval dwell = 0;
+    dispatch_sync(self.trackingQueue, ^{
+        RTSPCameraTracks *tracks = self.cameraTracks[cameraID];
+        NSUInteger zone = [tracks.zoneNames indexOfObject:zoneName];
+        if (tracks && zone != NSNotFound) {
+            dwell = RTSPTrackerZoneDwell(tracks.tracker, trackID, (uint32_t)zone, [NSProcessInfo processInfo].systemUptime);
+        }
+    });
+    return dwell;
+}
+
 - (void)stopProcessingForCamera:(NSString *)cameraID {
-    [self.activeCameras removeObject:cameraID];
-    [self.cameraFrameCounts removeObjectForKey:cameraID];
+    @synchronized (self.cameraSlots) {
+        NSNumber *slot = self.cameraSlots[cameraID];
+        if (slot && self.scheduler) {
+            RTSPInferenceSchedulerRemoveCamera(self.scheduler, slot.unsignedIntValue);
+        }
+        if (slot && self.activityGate) {
+            RTSPActivityGateRemoveCamera(self.activityGate, slot.unsignedIntValue);
+        }
+        [self.cameraSlots removeObjectForKey:cameraID];
+    }
+    dispatch_async(self.trackingQueue, ^{
+        [self.cameraTracks removeObjectForKey:cameraID];
+    });
     NSLog(@"[MLX] Stopped processing for camera: %@", cameraID);
 }
 
 - (void)stopAllProcessing {
-    [self.activeCameras removeAllObjects];
-    [self.cameraFrameCounts removeAllObjects];
+    @synchronized (self.cameraSlots) {
+        for (NSNumber *slot in self.cameraSlots.allValues) {
+            if (self.scheduler) {
+                RTSPInferenceSchedulerRemoveCamera(self.scheduler, slot.unsignedIntValue);
+            }
+            if (self.activityGate) {
+                RTSPActivityGateRemoveCamera(self.activityGate, slot.unsignedIntValue);
+            }
+        }
+        [self.cameraSlots removeAllObjects];
+    }
+    dispatch_async(self.trackingQueue, ^{
+        [self.cameraTracks removeAllObjects];
+    });
     NSLog(@"[MLX] Stopped all processing");
 }
 
 - (void)resetStatistics {
-    self.framesProcessed = 0;
-    self.detectionsCount = 0;
-    self.totalInferenceTime = 0.0;
-    self.inferenceCount = 0;
-    self.startTime = [NSDate date];
+    @synchronized (self) {
+        self.framesProcessed = 0;
+        self.detectionsCount = 0;
+        self.totalInferenceTime = 0.0;
+        self.inferenceCount = 0;
+        self.startTime = [NSDate date];
+    }
+    RTSPLatencyMetricsReset(self.latencyMetrics);
     NSLog(@"[MLX] Statistics reset");
 }
 
 - (BOOL)isProcessing {
-    return self.activeCameras.count > 0;
+    @synchronized (self.cameraSlots) {
+        return self.cameraSlots.count > 0;
+    }
 }
 
 - (double)averageInferenceTime {
@@ -375,21 +1381,84 @@
     return self.totalInferenceTime / self.inferenceCount;
 }
 
+/// Stage to p50 / p99 / max in ms across cameras, for stages with samples
+- (NSDictionary<NSString *, NSDictionary *> *)latencySummaries {
+    NSMutableDictionary<NSString *, NSDictionary *> *summaries = [NSMutableDictionary dictionary];
+    for (int stage = 0; stage < RTSPLatencyStageCount; stage++) {
+        RTSPLatencySummary summary = RTSPLatencyMetricsGetSummary(self.latencyMetrics, UINT32_MAX, (RTSPLatencyStage)stage);
+        if (summary.count == 0) continue;
+        summaries[@(RTSPLatencyStageName((RTSPLatencyStage)stage))] = @{
+            @"count": @(summary.count),
+            @"p50": @(summary.p50 * 1000),
+            @"p99": @(summary.p99 * 1000),
+            @"max": @(summary.max * 1000)
+        };
+    }
+    return summaries;
+}
+
 - (NSDictionary *)performanceMetrics {
     NSTimeInterval uptime = [[NSDate date] timeIntervalSinceDate:self.startTime];
 
+    RTSPInferenceSchedulerStatistics scheduling = {0};
+    RTSPActivityGateStatistics gating = {0};
+    NSUInteger activeCameras = 0;
+    @synchronized (self.cameraSlots) {
+        if (self.scheduler) {
+            scheduling = RTSPInferenceSchedulerGetStatistics(self.scheduler);
+        }
+        if (self.activityGate) {
+            gating = RTSPActivityGateGetStatistics(self.activityGate, [NSProcessInfo processInfo].systemUptime);
+        }
+        activeCameras = self.cameraSlots.count;
+    }
+
     return @{
         @"framesProcessed": @(self.framesProcessed),
         @"detectionsCount": @(self.detectionsCount),
         @"averageInferenceTime": @(self.averageInferenceTime),
         @"inferenceCount": @(self.inferenceCount),
-        @"activeCameras": @(self.activeCameras.count),
+        @"activeCameras": @(activeCameras),
+        @"framesDropped": @(scheduling.replaced + scheduling.stale),
+        @"averageBatchSize": @(scheduling.batches > 0 ? (double)(scheduling.inferred + scheduling.failed) / scheduling.batches : 0.0),
+        @"averageQueueLatency": @(scheduling.inferred > 0 ? scheduling.totalLatency * 1000 / scheduling.inferred : 0.0),
+        @"inferenceRate": @(gating.inferenceRate),
+        @"allocatedInferenceRate": @(gating.allocatedRate),
+        @"inferenceRatesByCamera": [self inferenceRatesByCamera],
+        @"latency": [self latencySummaries],
         @"uptimeSeconds": @(uptime),
         @"framesPerSecond": @(uptime > 0 ? self.framesProcessed / uptime : 0.0),
         @"detectionsPerFrame": @(self.framesProcessed > 0 ? (double)self.detectionsCount / self.framesProcessed : 0.0)
     };
 }
 
+- (NSDictionary<NSString *, NSDictionary *> *)inferenceRatesByCamera {
+    NSMutableDictionary<NSString *, NSDictionary *> *rates = [NSMutableDictionary dictionary];
+    NSTimeInterval now = [NSProcessInfo processInfo].systemUptime;
+    @synchronized (self.cameraSlots) {
+        if (!self.activityGate) {
+            return rates;
+        }
+        [self.cameraSlots enumerateKeysAndObjectsUsingBlock:^(NSString *cameraID, NSNumber *slot, BOOL *stop) {
+            RTSPActivityGateCameraStatistics statistics;
+            if (!RTSPActivityGateGetCameraStatistics(self.activityGate, slot.unsignedIntValue, now, &statistics)) {
+                return;
+            }
+            rates[cameraID] = @{
+                @"effectiveFPS": @(statistics.inferenceRate),
+                @"offeredFPS": @(statistics.offeredRate),
+                @"skippedRatio": @(statistics.skippedRatio),
+                @"targetFPS": @(statistics.targetRate),
+                @"allowedFPS": @(statistics.allowedRate),
+                @"active": @(statistics.active),
+                @"framesOffered": @(statistics.framesOffered),
+                @"framesInferred": @(statistics.framesInferred)
+            };
+        }];
+    }
+    return rates;
+}
+
 + (BOOL)isMLXAvailable {
     // Check for CoreML availability
     if (@available(macOS 11.0, *)) {
@@ -414,11 +1483,13 @@
         // Apple Silicon - can handle more streams
         config.maxConcurrentStreams = 6;
         config.inferenceInterval = 2; // Process more frequently
+        config.inferenceBudget = 60;
         NSLog(@"[MLX] Detected Apple Silicon - using optimized configuration");
     } else {
         // Intel - more conservative
         config.maxConcurrentStreams = 3;
         config.inferenceInterval = 5;
+        config.inferenceBudget = 15;
         NSLog(@"[MLX] Detected Intel processor - using conservative configuration");
     }
 
@@ -427,6 +1498,10 @@
 
 - (void)dealloc {
     [self stopAllProcessing];
+    RTSPInferenceSchedulerRelease(_scheduler);
+    RTSPActivityGateRelease(_activityGate);
+    RTSPDetectionDecoderRelease(_tensorDecoder);
+    RTSPLatencyMetricsRelease(_latencyMetrics);
 }
 
 @end
@@ -2,12 +2,12 @@
 //  RTSPMotionDetector.h
 //  RTSP Rotator
 //
-//  Motion detection using Vision framework
+//  Motion detection on decoded luma planes (see RTSPMotionKernel)
 //
 
 #import <Foundation/Foundation.h>
 #import <AVFoundation/AVFoundation.h>
-#import <Vision/Vision.h>
+#import <CoreVideo/CoreVideo.h>
 
 NS_ASSUME_NONNULL_BEGIN
 
@@ -23,8 +23,8 @@ NS_ASSUME_NONNULL_BEGIN
 /// Motion detection for RTSP streams
 @interface RTSPMotionDetector : NSObject
 
-/// Initialize with AVPlayer
-- (instancetype)initWithPlayer:(AVPlayer *)player;
+/// Initialize with AVPlayer (nil to only score frames fed directly)
+- (instancetype)initWithPlayer:(nullable AVPlayer *)player;
 
 /// Delegate for motion callbacks
 @property (nonatomic, weak) id<RTSPMotionDetectorDelegate> delegate;
@@ -41,12 +41,28 @@ NS_ASSUME_NONNULL_BEGIN
 /// Whether motion is currently detected
 @property (nonatomic, assign, readonly) BOOL motionDetected;
 
+/// Fraction of blocks that changed in the last processed frame (0.0 - 1.0)
+@property (nonatomic, assign, readonly) CGFloat lastMotionScore;
+
+/// Name of the SIMD backend in use (e.g. "neon", "avx2")
+@property (nonatomic, copy, readonly) NSString *backendName;
+
 /// Start monitoring
 - (void)startMonitoring;
 
 /// Stop monitoring
 - (void)stopMonitoring;
 
+/// Feed a decoded frame directly (NV12/I420 uses plane 0, other formats are ignored).
+/// Safe to call from any thread; processing happens on an internal queue.
+- (void)processPixelBuffer:(CVPixelBufferRef)pixelBuffer;
+
+/// Score a decoded frame against the previous one and return its motion
+/// fraction (0.0 - 1.0), or -1 when it cannot be compared (first frame,
+/// size change, unsupported format). Blocks until done; don't call from
+/// the detector's own callbacks.
+- (float)motionScoreForPixelBuffer:(CVPixelBufferRef)pixelBuffer;
+
 @end
 
 NS_ASSUME_NONNULL_END
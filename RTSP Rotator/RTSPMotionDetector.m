@@ -4,18 +4,30 @@
 //
 
 #import "RTSPMotionDetector.h"
-#import <CoreImage/CoreImage.h>
+#import "RTSPMotionKernel.h"
+#import "RTSPFrameBus.h"
+
+/// Fraction of blocks that must change before motion is reported
+static const float kRTSPMotionMinimumBlockFraction = 0.005f;
 
 @interface RTSPMotionDetector ()
 @property (nonatomic, weak) AVPlayer *player;
-@property (nonatomic, strong) NSTimer *monitoringTimer;
-@property (nonatomic, strong) CIImage *previousFrame;
+@property (nonatomic, strong) RTSPFrameBus *frameBus;
+@property (nonatomic, strong) id<NSObject> frameSubscription;
+@property (nonatomic, strong) dispatch_queue_t processingQueue;
 @property (nonatomic, assign) BOOL motionDetected;
+@property (nonatomic, assign) CGFloat lastMotionScore;
+@property (nonatomic, copy) NSString *backendName;
 @end
 
-@implementation RTSPMotionDetector
+@implementation RTSPMotionDetector {
+    RTSPMotionKernelRef _kernel;
+    uint32_t _kernelWidth;
+    uint32_t _kernelHeight;
+    BOOL _processing;
+}
 
-- (instancetype)initWithPlayer:(AVPlayer *)player {
+- (instancetype)initWithPlayer:(nullable AVPlayer *)player {
     self = [super init];
     if (self) {
         _player = player;
@@ -23,149 +35,174 @@
         _sensitivity = 0.5;
         _checkInterval = 0.5;
         _motionDetected = NO;
+        _backendName = @"none";
+        _processingQueue = dispatch_queue_create("com.rtsp.motion", DISPATCH_QUEUE_SERIAL);
     }
     return self;
 }
 
 - (void)startMonitoring {
-    if (!self.enabled || self.monitoringTimer) {
+    if (!self.enabled || self.frameSubscription || !self.player) {
         return;
     }
 
-    self.monitoringTimer = [NSTimer scheduledTimerWithTimeInterval:self.checkInterval
-                                                            target:self
-                                                          selector:@selector(checkForMotion)
-                                                          userInfo:nil
-                                                           repeats:YES];
+    __weak typeof(self) weakSelf = self;
+    self.frameBus = [RTSPFrameBus busForPlayer:self.player];
+    self.frameSubscription = [self.frameBus addSubscriberWithRate:1.0 / MAX(self.checkInterval, 0.01)
+                                                            queue:self.processingQueue
+                                                          handler:^(RTSPDecodedFrame *frame) {
+        [weakSelf analyzeLumaOfPixelBuffer:frame.pixelBuffer];
+    }];
 
     NSLog(@"[Motion] Started monitoring (sensitivity: %.2f)", self.sensitivity);
 }
 
 - (void)stopMonitoring {
-    [self.monitoringTimer invalidate];
-    self.monitoringTimer = nil;
-    self.previousFrame = nil;
+    if (self.frameSubscription) {
+        [self.frameBus removeSubscriber:self.frameSubscription];
+        self.frameSubscription = nil;
+    }
     self.motionDetected = NO;
 
+    dispatch_async(self.processingQueue, ^{
+        if (self->_kernel) {
+            RTSPMotionKernelReset(self->_kernel);
+        }
+    });
+
     NSLog(@"[Motion] Stopped monitoring");
 }
 
-- (void)checkForMotion {
-    if (!self.player.currentItem) {
+- (void)setSensitivity:(CGFloat)sensitivity {
+    _sensitivity = MAX(0.0, MIN(1.0, sensitivity));
+    uint8_t threshold = [self pixelThreshold];
+    dispatch_async(self.processingQueue, ^{
+        RTSPMotionKernelSetPixelThreshold(self->_kernel, threshold);
+    });
+}
+
+/// Higher sensitivity lowers the per-pixel difference a block needs to count as moving
+- (uint8_t)pixelThreshold {
+    return (uint8_t)(4.0 + (1.0 - self.sensitivity) * 28.0);
+}
+
+#pragma mark - Processing
+
+- (void)processPixelBuffer:(CVPixelBufferRef)pixelBuffer {
+    if (!pixelBuffer) {
         return;
     }
 
-    // Get current frame
-    AVAssetImageGenerator *generator = [AVAssetImageGenerator assetImageGeneratorWithAsset:self.player.currentItem.asset];
-    generator.requestedTimeToleranceBefore = kCMTimeZero;
-    generator.requestedTimeToleranceAfter = kCMTimeZero;
-
-    CMTime currentTime = self.player.currentTime;
-
-    if (@available(macOS 13.0, *)) {
-        [generator generateCGImageAsynchronouslyForTime:currentTime completionHandler:^(CGImageRef imageRef, CMTime actualTime, NSError *error) {
-            if (imageRef) {
-                CIImage *currentFrame = [CIImage imageWithCGImage:imageRef];
-
-                if (self.previousFrame) {
-                    CGFloat difference = [self calculateDifferenceBetween:self.previousFrame and:currentFrame];
-
-                    BOOL hasMotion = difference > (1.0 - self.sensitivity);
-
-                    if (hasMotion && !self.motionDetected) {
-                        self.motionDetected = YES;
-                        dispatch_async(dispatch_get_main_queue(), ^{
-                            if ([self.delegate respondsToSelector:@selector(motionDetector:didDetectMotionWithConfidence:)]) {
-                                [self.delegate motionDetector:self didDetectMotionWithConfidence:difference];
-                            }
-                        });
-                        NSLog(@"[Motion] Motion detected (confidence: %.2f)", difference);
-                    } else if (!hasMotion && self.motionDetected) {
-                        self.motionDetected = NO;
-                        dispatch_async(dispatch_get_main_queue(), ^{
-                            if ([self.delegate respondsToSelector:@selector(motionDetectorDidStopMotion:)]) {
-                                [self.delegate motionDetectorDidStopMotion:self];
-                            }
-                        });
-                        NSLog(@"[Motion] Motion stopped");
-                    }
-                }
-
-                self.previousFrame = currentFrame;
-            }
-        }];
-    } else {
-        // Fallback for macOS 11.0-12.x: use synchronous API
-        NSError *error = nil;
-        CGImageRef imageRef = [generator copyCGImageAtTime:currentTime actualTime:NULL error:&error];
-        if (imageRef) {
-            CIImage *currentFrame = [CIImage imageWithCGImage:imageRef];
-
-            if (self.previousFrame) {
-                CGFloat difference = [self calculateDifferenceBetween:self.previousFrame and:currentFrame];
-
-                BOOL hasMotion = difference > (1.0 - self.sensitivity);
-
-                if (hasMotion && !self.motionDetected) {
-                    self.motionDetected = YES;
-                    dispatch_async(dispatch_get_main_queue(), ^{
-                        if ([self.delegate respondsToSelector:@selector(motionDetector:didDetectMotionWithConfidence:)]) {
-                            [self.delegate motionDetector:self didDetectMotionWithConfidence:difference];
-                        }
-                    });
-                    NSLog(@"[Motion] Motion detected (confidence: %.2f)", difference);
-                } else if (!hasMotion && self.motionDetected) {
-                    self.motionDetected = NO;
-                    dispatch_async(dispatch_get_main_queue(), ^{
-                        if ([self.delegate respondsToSelector:@selector(motionDetectorDidStopMotion:)]) {
-                            [self.delegate motionDetectorDidStopMotion:self];
-                        }
-                    });
-                    NSLog(@"[Motion] Motion stopped");
-                }
-            }
+    @synchronized (self) {
+        // Never queue more than one frame; a stale frame is worthless for motion
+        if (_processing) {
+            return;
+        }
+        _processing = YES;
+    }
 
-            self.previousFrame = currentFrame;
-            CGImageRelease(imageRef);
+    CVPixelBufferRetain(pixelBuffer);
+    dispatch_async(self.processingQueue, ^{
+        [self analyzeLumaOfPixelBuffer:pixelBuffer];
+        CVPixelBufferRelease(pixelBuffer);
+        @synchronized (self) {
+            self->_processing = NO;
         }
+    });
+}
+
+- (float)motionScoreForPixelBuffer:(CVPixelBufferRef)pixelBuffer {
+    if (!pixelBuffer) {
+        return -1.0f;
     }
+    __block float score = -1.0f;
+    dispatch_sync(self.processingQueue, ^{
+        score = [self analyzeLumaOfPixelBuffer:pixelBuffer];
+    });
+    return score;
 }
 
-- (CGFloat)calculateDifferenceBetween:(CIImage *)image1 and:(CIImage *)image2 {
-    // Simple pixel difference calculation
-    CIFilter *differenceFilter = [CIFilter filterWithName:@"CIDifferenceBlendMode"];
-    [differenceFilter setValue:image1 forKey:kCIInputImageKey];
-    [differenceFilter setValue:image2 forKey:kCIInputBackgroundImageKey];
+/// Motion fraction of the frame, or -1 if it could not be compared with a previous one
+- (float)analyzeLumaOfPixelBuffer:(CVPixelBufferRef)pixelBuffer {
+    if (!CVPixelBufferIsPlanar(pixelBuffer)) {
+        return -1.0f;
+    }
 
-    CIImage *differenceImage = differenceFilter.outputImage;
+    uint32_t width = (uint32_t)CVPixelBufferGetWidthOfPlane(pixelBuffer, 0);
+    uint32_t height = (uint32_t)CVPixelBufferGetHeightOfPlane(pixelBuffer, 0);
 
-    if (!differenceImage) {
-        return 0.0;
+    if (![self prepareKernelForWidth:width height:height]) {
+        return -1.0f;
     }
 
-    // Calculate average pixel intensity
-    CIFilter *areaAverageFilter = [CIFilter filterWithName:@"CIAreaAverage"];
-    [areaAverageFilter setValue:differenceImage forKey:kCIInputImageKey];
-    [areaAverageFilter setValue:[CIVector vectorWithCGRect:differenceImage.extent] forKey:kCIInputExtentKey];
+    RTSPMotionKernelResult result;
+    CVPixelBufferLockBaseAddress(pixelBuffer, kCVPixelBufferLock_ReadOnly);
+    const uint8_t *luma = CVPixelBufferGetBaseAddressOfPlane(pixelBuffer, 0);
+    size_t bytesPerRow = CVPixelBufferGetBytesPerRowOfPlane(pixelBuffer, 0);
+    BOOL ok = RTSPMotionKernelProcessLuma(_kernel, luma, bytesPerRow, &result);
+    CVPixelBufferUnlockBaseAddress(pixelBuffer, kCVPixelBufferLock_ReadOnly);
 
-    CIImage *averageImage = areaAverageFilter.outputImage;
+    if (!ok || !result.primed) {
+        return -1.0f;
+    }
+    [self handleResult:result];
+    return result.motionFraction;
+}
+
+- (BOOL)prepareKernelForWidth:(uint32_t)width height:(uint32_t)height {
+    if (_kernel) {
+        if (_kernelWidth == width && _kernelHeight == height) {
+            return YES;
+        }
+        RTSPMotionKernelRelease(_kernel);
+        _kernel = NULL;
+    }
 
-    if (!averageImage) {
-        return 0.0;
+    RTSPMotionKernelConfig config;
+    RTSPMotionKernelConfigInit(&config, width, height);
+    config.pixelThreshold = [self pixelThreshold];
+    _kernel = RTSPMotionKernelCreate(&config);
+    if (!_kernel) {
+        NSLog(@"[Motion] Failed to create kernel for %ux%u", width, height);
+        return NO;
     }
+    _kernelWidth = width;
+    _kernelHeight = height;
+
+    self.backendName = @(RTSPMotionKernelBackendName(RTSPMotionKernelGetBackend(_kernel)));
+    NSLog(@"[Motion] Kernel ready for %ux%u (%@)", width, height, self.backendName);
+    return YES;
+}
 
-    // Extract pixel value
-    uint8_t pixel[4] = {0};
-    CIContext *context = [CIContext contextWithOptions:nil];
-    [context render:averageImage toBitmap:pixel rowBytes:4 bounds:CGRectMake(0, 0, 1, 1) format:kCIFormatRGBA8 colorSpace:nil];
+- (void)handleResult:(RTSPMotionKernelResult)result {
+    CGFloat score = result.motionFraction;
+    BOOL hasMotion = result.motionFraction > kRTSPMotionMinimumBlockFraction;
+    self.lastMotionScore = score;
 
-    // Return average intensity (0.0 - 1.0)
-    CGFloat average = (pixel[0] + pixel[1] + pixel[2]) / (3.0 * 255.0);
-    return average;
+    if (hasMotion && !self.motionDetected) {
+        self.motionDetected = YES;
+        dispatch_async(dispatch_get_main_queue(), ^{
+            if ([self.delegate respondsToSelector:@selector(motionDetector:didDetectMotionWithConfidence:)]) {
+                [self.delegate motionDetector:self didDetectMotionWithConfidence:score];
+            }
+        });
+        NSLog(@"[Motion] Motion detected (confidence: %.2f)", score);
+    } else if (!hasMotion && self.motionDetected) {
+        self.motionDetected = NO;
+        dispatch_async(dispatch_get_main_queue(), ^{
+            if ([self.delegate respondsToSelector:@selector(motionDetectorDidStopMotion:)]) {
+                [self.delegate motionDetectorDidStopMotion:self];
+            }
+        });
+        NSLog(@"[Motion] Motion stopped");
+    }
 }
 
 - (void)dealloc {
-    [self stopMonitoring];
+    if (_frameSubscription) {
+        [_frameBus removeSubscriber:_frameSubscription];
+    }
+    RTSPMotionKernelRelease(_kernel);
 }
 
 @end
@@ -0,0 +1,380 @@
+//
+//  RTSPMotionKernel.c
+//  RTSP Rotator
+//
+//  Single pass per row: SAD against the background, background update and
+//  block accumulation all happen while the row is hot in cache. The
+//  background update is bg' = bg + (cur - bg) / 2^shift, implemented as
+//  `shift` rounds of a rounding average so every backend is bit-exact.
+//
+
+#include "RTSPMotionKernel.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+#define RTSP_MOTION_X86 1
+#include <emmintrin.h>
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#define RTSP_MOTION_NEON 1
+#include <arm_neon.h>
+#endif
+
+#define RTSP_MOTION_SPAN 16
+
+typedef void (*RTSPMotionRowFunction)(const uint8_t *cur,
+                                      uint8_t *bg,
+                                      uint32_t spans,
+                                      uint32_t spansPerBlock,
+                                      uint32_t *blockSAD,
+                                      unsigned shift);
+
+struct RTSPMotionKernel {
+    RTSPMotionKernelConfig config;
+    RTSPMotionKernelBackend backend;
+    RTSPMotionRowFunction rowFunction;
+    uint32_t columns;
+    uint32_t rows;
+    uint8_t *background;
+    uint32_t *blockSAD;
+    uint8_t *mask;
+    bool primed;
+};
+
+#pragma mark - Scalar
+
+static inline uint8_t RTSPMotionBlend(uint8_t bg, uint8_t cur, unsigned shift) {
+    unsigned t = cur;
+    for (unsigned i = 0; i < shift; i++) {
+        t = (bg + t + 1) >> 1;
+    }
+    return (uint8_t)t;
+}
+
+static void RTSPMotionScalarPixels(const uint8_t *cur, uint8_t *bg, uint32_t count, uint32_t *sad, unsigned shift) {
+    uint32_t sum = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        int d = (int)cur[i] - (int)bg[i];
+        sum += (uint32_t)(d < 0 ? -d : d);
+        bg[i] = RTSPMotionBlend(bg[i], cur[i], shift);
+    }
+    *sad += sum;
+}
+
+static void RTSPMotionRowScalar(const uint8_t *cur, uint8_t *bg, uint32_t spans,
+                                uint32_t spansPerBlock, uint32_t *blockSAD, unsigned shift) {
+    for (uint32_t s = 0; s < spans; s++) {
+        RTSPMotionScalarPixels(cur + s * RTSP_MOTION_SPAN, bg + s * RTSP_MOTION_SPAN,
+                               RTSP_MOTION_SPAN, &blockSAD[s / spansPerBlock], shift);
+    }
+}
+
+#pragma mark - SSE2 / AVX2
+
+#ifdef RTSP_MOTION_X86
+
+static void RTSPMotionRowSSE2(const uint8_t *cur, uint8_t *bg, uint32_t spans,
+                              uint32_t spansPerBlock, uint32_t *blockSAD, unsigned shift) {
+    for (uint32_t s = 0; s < spans; s++) {
+        __m128i c = _mm_loadu_si128((const __m128i *)(cur + s * RTSP_MOTION_SPAN));
+        __m128i b = _mm_loadu_si128((const __m128i *)(bg + s * RTSP_MOTION_SPAN));
+        __m128i sad = _mm_sad_epu8(c, b);
+        blockSAD[s / spansPerBlock] += (uint32_t)(_mm_cvtsi128_si32(sad) + _mm_extract_epi16(sad, 4));
+
+        __m128i t = c;
+        for (unsigned i = 0; i < shift; i++) {
+            t = _mm_avg_epu8(b, t);
+        }
+        _mm_storeu_si128((__m128i *)(bg + s * RTSP_MOTION_SPAN), t);
+    }
+}
+
+__attribute__((target("avx2")))
+static void RTSPMotionRowAVX2(const uint8_t *cur, uint8_t *bg, uint32_t spans,
+                              uint32_t spansPerBlock, uint32_t *blockSAD, unsigned shift) {
+    uint32_t s = 0;
+    for (; s + 1 < spans; s += 2) {
+        __m256i c = _mm256_loadu_si256((const __m256i *)(cur + s * RTSP_MOTION_SPAN));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(bg + s * RTSP_MOTION_SPAN));
+        __m256i sad = _mm256_sad_epu8(c, b);
+        // Lanes 0/1 hold the first 16 bytes, lanes 2/3 the second
+        uint32_t lo = (uint32_t)(_mm256_extract_epi64(sad, 0) + _mm256_extract_epi64(sad, 1));
+        uint32_t hi = (uint32_t)(_mm256_extract_epi64(sad, 2) + _mm256_extract_epi64(sad, 3));
+        blockSAD[s / spansPerBlock] += lo;
+        blockSAD[(s + 1) / spansPerBlock] += hi;
+
+        __m256i t = c;
+        for (unsigned i = 0; i < shift; i++) {
+            t = _mm256_avg_epu8(b, t);
+        }
+        _mm256_storeu_si256((__m256i *)(bg + s * RTSP_MOTION_SPAN), t);
+    }
+    if (s < spans) {
+        RTSPMotionRowSSE2(cur + s * RTSP_MOTION_SPAN, bg + s * RTSP_MOTION_SPAN, 1,
+                          1, &blockSAD[s / spansPerBlock], shift);
+    }
+}
+
+static bool RTSPMotionCPUHasAVX2(void) {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+#endif
+
+#pragma mark - NEON
+
+#ifdef RTSP_MOTION_NEON
+
+static void RTSPMotionRowNEON(const uint8_t *cur, uint8_t *bg, uint32_t spans,
+                              uint32_t spansPerBlock, uint32_t *blockSAD, unsigned shift) {
+    for (uint32_t s = 0; s < spans; s++) {
+        uint8x16_t c = vld1q_u8(cur + s * RTSP_MOTION_SPAN);
+        uint8x16_t b = vld1q_u8(bg + s * RTSP_MOTION_SPAN);
+        uint16x8_t wide = vpaddlq_u8(vabdq_u8(c, b));
+        blockSAD[s / spansPerBlock] += vaddvq_u32(vpaddlq_u16(wide));
+
+        uint8x16_t t = c;
+        for (unsigned i = 0; i < shift; i++) {
+            t = vrhaddq_u8(b, t);
+        }
+        vst1q_u8(bg + s * RTSP_MOTION_SPAN, t);
+    }
+}
+
+#endif
+
+#pragma mark - Backend selection
+
+bool RTSPMotionKernelBackendAvailable(RTSPMotionKernelBackend backend) {
+    switch (backend) {
+        case RTSPMotionKernelBackendAuto:
+        case RTSPMotionKernelBackendScalar:
+            return true;
+#ifdef RTSP_MOTION_X86
+        case RTSPMotionKernelBackendSSE2:
+            return true;
+        case RTSPMotionKernelBackendAVX2:
+            return RTSPMotionCPUHasAVX2();
+#endif
+#ifdef RTSP_MOTION_NEON
+        case RTSPMotionKernelBackendNEON:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+const char *RTSPMotionKernelBackendName(RTSPMotionKernelBackend backend) {
+    switch (backend) {
+        case RTSPMotionKernelBackendAuto:   return "auto";
+        case RTSPMotionKernelBackendScalar: return "scalar";
+        case RTSPMotionKernelBackendSSE2:   return "sse2";
+        case RTSPMotionKernelBackendAVX2:   return "avx2";
+        case RTSPMotionKernelBackendNEON:   return "neon";
+    }
+    return "unknown";
+}
+
+static RTSPMotionKernelBackend RTSPMotionResolveBackend(RTSPMotionKernelBackend requested) {
+    if (requested != RTSPMotionKernelBackendAuto) {
+        return RTSPMotionKernelBackendAvailable(requested) ? requested : RTSPMotionKernelBackendScalar;
+    }
+#ifdef RTSP_MOTION_NEON
+    return RTSPMotionKernelBackendNEON;
+#elif defined(RTSP_MOTION_X86)
+    return RTSPMotionCPUHasAVX2() ? RTSPMotionKernelBackendAVX2 : RTSPMotionKernelBackendSSE2;
+#else
+    return RTSPMotionKernelBackendScalar;
+#endif
+}
+
+static RTSPMotionRowFunction RTSPMotionRowFunctionForBackend(RTSPMotionKernelBackend backend) {
+    switch (backend) {
+#ifdef RTSP_MOTION_X86
+        case RTSPMotionKernelBackendSSE2: return RTSPMotionRowSSE2;
+        case RTSPMotionKernelBackendAVX2: return RTSPMotionRowAVX2;
+#endif
+#ifdef RTSP_MOTION_NEON
+        case RTSPMotionKernelBackendNEON: return RTSPMotionRowNEON;
+#endif
+        default: return RTSPMotionRowScalar;
+    }
+}
+
+#pragma mark - Lifecycle
+
+void RTSPMotionKernelConfigInit(RTSPMotionKernelConfig *config, uint32_t width, uint32_t height) {
+    if (!config) {
+        return;
+    }
+    memset(config, 0, sizeof(*config));
+    config->width = width;
+    config->height = height;
+    config->blockSize = 16;
+    config->pixelThreshold = 12;
+    config->backgroundShift = 3;
+    config->backend = RTSPMotionKernelBackendAuto;
+}
+
+RTSPMotionKernelRef RTSPMotionKernelCreate(const RTSPMotionKernelConfig *config) {
+    if (!config || config->width == 0 || config->height == 0 || config->backgroundShift > 8) {
+        return NULL;
+    }
+
+    RTSPMotionKernelRef kernel = calloc(1, sizeof(*kernel));
+    if (!kernel) {
+        return NULL;
+    }
+
+    kernel->config = *config;
+    uint32_t blockSize = config->blockSize ? config->blockSize : 16;
+    blockSize = (blockSize + RTSP_MOTION_SPAN - 1) / RTSP_MOTION_SPAN * RTSP_MOTION_SPAN;
+    kernel->config.blockSize = blockSize;
+
+    kernel->backend = RTSPMotionResolveBackend(config->backend);
+    kernel->rowFunction = RTSPMotionRowFunctionForBackend(kernel->backend);
+    kernel->columns = (config->width + blockSize - 1) / blockSize;
+    kernel->rows = (config->height + blockSize - 1) / blockSize;
+
+    size_t blocks = (size_t)kernel->columns * kernel->rows;
+    kernel->background = malloc((size_t)config->width * config->height);
+    kernel->blockSAD = calloc(blocks, sizeof(uint32_t));
+    kernel->mask = calloc(blocks, 1);
+
+    if (!kernel->background || !kernel->blockSAD || !kernel->mask) {
+        RTSPMotionKernelRelease(kernel);
+        return NULL;
+    }
+    return kernel;
+}
+
+void RTSPMotionKernelRelease(RTSPMotionKernelRef kernel) {
+    if (!kernel) {
+        return;
+    }
+    free(kernel->background);
+    free(kernel->blockSAD);
+    free(kernel->mask);
+    free(kernel);
+}
+
+void RTSPMotionKernelReset(RTSPMotionKernelRef kernel) {
+    if (kernel) {
+        kernel->primed = false;
+    }
+}
+
+void RTSPMotionKernelSetPixelThreshold(RTSPMotionKernelRef kernel, uint8_t pixelThreshold) {
+    if (kernel) {
+        kernel->config.pixelThreshold = pixelThreshold;
+    }
+}
+
+#pragma mark - Processing
+
+bool RTSPMotionKernelProcessLuma(RTSPMotionKernelRef kernel,
+                                 const uint8_t *luma,
+                                 size_t bytesPerRow,
+                                 RTSPMotionKernelResult *result) {
+    if (!kernel || !luma || bytesPerRow < kernel->config.width) {
+        return false;
+    }
+
+    const uint32_t width = kernel->config.width;
+    const uint32_t height = kernel->config.height;
+    const uint32_t blockSize = kernel->config.blockSize;
+    const uint32_t totalBlocks = kernel->columns * kernel->rows;
+
+    if (!kernel->primed) {
+        for (uint32_t y = 0; y < height; y++) {
+            memcpy(kernel->background + (size_t)y * width, luma + (size_t)y * bytesPerRow, width);
+        }
+        memset(kernel->blockSAD, 0, totalBlocks * sizeof(uint32_t));
+        memset(kernel->mask, 0, totalBlocks);
+        kernel->primed = true;
+        if (result) {
+            memset(result, 0, sizeof(*result));
+            result->totalBlocks = totalBlocks;
+        }
+        return true;
+    }
+
+    memset(kernel->blockSAD, 0, totalBlocks * sizeof(uint32_t));
+
+    const uint32_t spans = width / RTSP_MOTION_SPAN;
+    const uint32_t spansPerBlock = blockSize / RTSP_MOTION_SPAN;
+    const uint32_t tailStart = spans * RTSP_MOTION_SPAN;
+    const unsigned shift = kernel->config.backgroundShift;
+
+    for (uint32_t y = 0; y < height; y++) {
+        const uint8_t *cur = luma + (size_t)y * bytesPerRow;
+        uint8_t *bg = kernel->background + (size_t)y * width;
+        uint32_t *rowSAD = kernel->blockSAD + (size_t)(y / blockSize) * kernel->columns;
+
+        kernel->rowFunction(cur, bg, spans, spansPerBlock, rowSAD, shift);
+        if (tailStart < width) {
+            RTSPMotionScalarPixels(cur + tailStart, bg + tailStart, width - tailStart,
+                                   &rowSAD[tailStart / blockSize], shift);
+        }
+    }
+
+    uint64_t totalSAD = 0;
+    uint32_t changed = 0;
+    const uint32_t threshold = kernel->config.pixelThreshold;
+
+    for (uint32_t by = 0; by < kernel->rows; by++) {
+        uint32_t blockHeight = (by + 1) * blockSize <= height ? blockSize : height - by * blockSize;
+        for (uint32_t bx = 0; bx < kernel->columns; bx++) {
+            uint32_t blockWidth = (bx + 1) * blockSize <= width ? blockSize : width - bx * blockSize;
+            size_t index = (size_t)by * kernel->columns + bx;
+            uint32_t sad = kernel->blockSAD[index];
+            totalSAD += sad;
+            uint8_t moving = sad > threshold * blockWidth * blockHeight;
+            kernel->mask[index] = moving;
+            changed += moving;
+        }
+    }
+
+    if (result) {
+        result->primed = true;
+        result->changedBlocks = changed;
+        result->totalBlocks = totalBlocks;
+        result->motionFraction = (float)changed / (float)totalBlocks;
+        result->meanDifference = (float)((double)totalSAD / ((double)width * height * 255.0));
+    }
+    return true;
+}
+
+#pragma mark - Accessors
+
+const uint8_t *RTSPMotionKernelMotionMask(RTSPMotionKernelRef kernel, uint32_t *columns, uint32_t *rows) {
+    if (!kernel) {
+        return NULL;
+    }
+    if (columns) *columns = kernel->columns;
+    if (rows) *rows = kernel->rows;
+    return kernel->mask;
+}
+
+const uint32_t *RTSPMotionKernelBlockSAD(RTSPMotionKernelRef kernel, uint32_t *columns, uint32_t *rows) {
+    if (!kernel) {
+        return NULL;
+    }
+    if (columns) *columns = kernel->columns;
+    if (rows) *rows = kernel->rows;
+    return kernel->blockSAD;
+}
+
+RTSPMotionKernelBackend RTSPMotionKernelGetBackend(RTSPMotionKernelRef kernel) {
+    return kernel ? kernel->backend : RTSPMotionKernelBackendScalar;
+}
@@ -0,0 +1,95 @@
+//
+//  RTSPMotionKernel.h
+//  RTSP Rotator
+//
+//  Portable frame-differencing kernel operating on 8-bit luma planes
+//  (the Y plane of NV12 / I420 frames). Computes per-block SAD against a
+//  running background model and produces a block motion mask.
+//
+//  Plain C with SSE2 / AVX2 / NEON paths and a scalar fallback so it can be
+//  built and benchmarked on Linux (see Benchmarks/).
+//
+
+#ifndef RTSPMotionKernel_h
+#define RTSPMotionKernel_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// SIMD backend used by the kernel
+typedef enum {
+    RTSPMotionKernelBackendAuto = 0,   // Best backend supported by the running CPU
+    RTSPMotionKernelBackendScalar,
+    RTSPMotionKernelBackendSSE2,
+    RTSPMotionKernelBackendAVX2,
+    RTSPMotionKernelBackendNEON
+} RTSPMotionKernelBackend;
+
+/// Kernel configuration
+typedef struct {
+    uint32_t width;                    // Luma width in pixels
+    uint32_t height;                   // Luma height in pixels
+    uint32_t blockSize;                // Block edge in pixels, rounded up to a multiple of 16 (default 16)
+    uint8_t pixelThreshold;            // Mean absolute difference per pixel that marks a block as moving (default 12)
+    uint8_t backgroundShift;           // Background learning rate = 1 / 2^shift; 0 = plain frame differencing (default 3)
+    RTSPMotionKernelBackend backend;   // Backend override, Auto by default
+} RTSPMotionKernelConfig;
+
+/// Per-frame result
+typedef struct {
+    float motionFraction;              // Fraction of blocks marked as moving (0.0 - 1.0)
+    float meanDifference;              // Mean absolute difference over the frame (0.0 - 1.0)
+    uint32_t changedBlocks;
+    uint32_t totalBlocks;
+    bool primed;                       // false for the first frame (background seeded, no result)
+} RTSPMotionKernelResult;
+
+typedef struct RTSPMotionKernel *RTSPMotionKernelRef;
+
+/// Fill a configuration with defaults for the given frame size
+void RTSPMotionKernelConfigInit(RTSPMotionKernelConfig *config, uint32_t width, uint32_t height);
+
+/// Create a kernel; returns NULL on invalid configuration or allocation failure
+RTSPMotionKernelRef RTSPMotionKernelCreate(const RTSPMotionKernelConfig *config);
+
+/// Destroy a kernel
+void RTSPMotionKernelRelease(RTSPMotionKernelRef kernel);
+
+/// Drop the background model; the next frame re-seeds it
+void RTSPMotionKernelReset(RTSPMotionKernelRef kernel);
+
+/// Update the per-pixel threshold without rebuilding the background
+void RTSPMotionKernelSetPixelThreshold(RTSPMotionKernelRef kernel, uint8_t pixelThreshold);
+
+/// Process one luma plane. `bytesPerRow` may exceed the width (padded planes).
+/// Returns false if the kernel or plane is invalid.
+bool RTSPMotionKernelProcessLuma(RTSPMotionKernelRef kernel,
+                                 const uint8_t *luma,
+                                 size_t bytesPerRow,
+                                 RTSPMotionKernelResult *result);
+
+/// Block grid of the most recent frame: one byte per block (1 = moving), row-major
+const uint8_t *RTSPMotionKernelMotionMask(RTSPMotionKernelRef kernel, uint32_t *columns, uint32_t *rows);
+
+/// Raw per-block SAD of the most recent frame, row-major
+const uint32_t *RTSPMotionKernelBlockSAD(RTSPMotionKernelRef kernel, uint32_t *columns, uint32_t *rows);
+
+/// Backend actually selected for this kernel
+RTSPMotionKernelBackend RTSPMotionKernelGetBackend(RTSPMotionKernelRef kernel);
+
+/// Whether a backend can run on this CPU
+bool RTSPMotionKernelBackendAvailable(RTSPMotionKernelBackend backend);
+
+/// Human readable backend name
+const char *RTSPMotionKernelBackendName(RTSPMotionKernelBackend backend);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RTSPMotionKernel_h */
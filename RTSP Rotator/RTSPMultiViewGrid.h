@@ -10,28 +10,32 @@
 #import <AVFoundation/AVFoundation.h>
 #import "RTSPDashboardManager.h"
 #import "RTSPCameraDiagnostics.h"
+#import "RTSPDecodeScheduler.h"
+#import "RTSPGridRenderView.h"
 
 NS_ASSUME_NONNULL_BEGIN
 
-/// Individual camera cell in the grid
-@interface RTSPCameraCell : NSView
+/// Individual camera cell in the grid. Decoding is granted by
+/// RTSPDecodeScheduler: the cell plays the main stream or the substream, or
+/// sits paused, as the scheduler decides. The cell draws nothing itself: its
+/// video and overlays are one tile of the grid's RTSPGridRenderView.
+@interface RTSPCameraCell : NSView <RTSPDecodeSchedulerClient>
 
 @property (nonatomic, strong) AVPlayer *player;
-@property (nonatomic, strong) AVPlayerLayer *playerLayer;
 @property (nonatomic, strong) RTSPCameraConfig *cameraConfig;
-@property (nonatomic, strong) NSTextField *labelField;
-@property (nonatomic, strong) NSTextField *timestampField;
-@property (nonatomic, strong) NSView *statusIndicator;
-@property (nonatomic, strong) NSTextField *diagnosticsLabel;
+@property (nonatomic, weak, nullable) RTSPGridRenderView *renderView;
+@property (nonatomic, assign) NSUInteger tileIndex;
 @property (nonatomic, assign) BOOL isPlaying;
 @property (nonatomic, assign) BOOL showLabel;
 @property (nonatomic, assign) BOOL showTimestamp;
 @property (nonatomic, assign) BOOL showDiagnostics;
+@property (nonatomic, assign) BOOL isFocused;
+@property (nonatomic, assign, readonly) RTSPDecodeMode decodeMode;
 
-/// Load and play camera feed
+/// Load and play camera feed once the decode scheduler grants a decoder
 - (void)loadFeed;
 
-/// Stop playback
+/// Stop playback and give up the decoder
 - (void)stopPlayback;
 
 /// Update status indicator with health status
@@ -69,6 +73,13 @@ NS_ASSUME_NONNULL_BEGIN
 /// All camera cells
 @property (nonatomic, strong, readonly) NSArray<RTSPCameraCell *> *cameraCells;
 
+/// Single surface every cell's video and overlays are drawn into
+@property (nonatomic, strong, readonly) RTSPGridRenderView *renderView;
+
+/// Cell with user focus (set by clicking a cell); decoded first and kept on
+/// the main stream when the budget allows
+@property (nonatomic, weak, nullable) RTSPCameraCell *focusedCell;
+
 /// Grid spacing (default: 2)
 @property (nonatomic, assign) CGFloat gridSpacing;
 
@@ -4,70 +4,35 @@
 //
 
 #import "RTSPMultiViewGrid.h"
+#import "RTSPFrameBus.h"
+#import <QuartzCore/QuartzCore.h>
+
+// Assumed until a stream reports its size: 1080p30 main, 360p30 substream
+static const double kRTSPCameraCellMainPixelRate = 1920.0 * 1080.0 * 30.0;
+static const double kRTSPCameraCellSubstreamPixelRate = 640.0 * 360.0 * 30.0;
+static const NSTimeInterval kRTSPCameraCellReleaseDelay = 10.0;   // Paused this long, the stream is closed
+
+@interface RTSPCameraCell ()
+@property (nonatomic, strong) NSColor *statusColor;
+@property (nonatomic, copy, nullable) NSString *diagnosticsText;
+@property (nonatomic, assign) CGSize lastLayoutSize;
+@property (nonatomic, strong, nullable) AVPlayerItem *observedItem;
+@property (nonatomic, strong, nullable) NSURL *itemURL;
+@property (nonatomic, assign) CFTimeInterval pausedSince;
+@property (nonatomic, assign) double mainPixelRate;
+@property (nonatomic, assign) double substreamPixelRate;
+@end
 
 @implementation RTSPCameraCell
 
 - (instancetype)initWithFrame:(NSRect)frameRect {
     self = [super initWithFrame:frameRect];
     if (self) {
-        self.wantsLayer = YES;
-        self.layer.backgroundColor = [[NSColor blackColor] CGColor];
-
-        // Setup player layer
-        _playerLayer = [AVPlayerLayer layer];
-        _playerLayer.videoGravity = AVLayerVideoGravityResizeAspect;
-        [self.layer addSublayer:_playerLayer];
-
-        // Status indicator (top-left corner)
-        _statusIndicator = [[NSView alloc] initWithFrame:NSMakeRect(8, frameRect.size.height - 20, 12, 12)];
-        _statusIndicator.wantsLayer = YES;
-        _statusIndicator.layer.cornerRadius = 6;
-        _statusIndicator.layer.backgroundColor = [[NSColor grayColor] CGColor];
-        [self addSubview:_statusIndicator];
-
-        // Label (bottom-left)
-        _labelField = [[NSTextField alloc] initWithFrame:NSMakeRect(8, 8, frameRect.size.width - 16, 20)];
-        _labelField.bezeled = NO;
-        _labelField.drawsBackground = YES;
-        _labelField.backgroundColor = [[NSColor colorWithWhite:0.0 alpha:0.7] colorWithAlphaComponent:0.7];
-        _labelField.textColor = [NSColor whiteColor];
-        _labelField.font = [NSFont systemFontOfSize:12];
-        _labelField.editable = NO;
-        _labelField.selectable = NO;
-        [self addSubview:_labelField];
-
-        // Timestamp (bottom-right)
-        _timestampField = [[NSTextField alloc] initWithFrame:NSMakeRect(frameRect.size.width - 150, 8, 142, 20)];
-        _timestampField.bezeled = NO;
-        _timestampField.drawsBackground = YES;
-        _timestampField.backgroundColor = [[NSColor colorWithWhite:0.0 alpha:0.7] colorWithAlphaComponent:0.7];
-        _timestampField.textColor = [NSColor whiteColor];
-        _timestampField.font = [NSFont systemFontOfSize:11];
-        _timestampField.alignment = NSTextAlignmentRight;
-        _timestampField.editable = NO;
-        _timestampField.selectable = NO;
-        [self addSubview:_timestampField];
-
-        // Diagnostics label (top-right)
-        _diagnosticsLabel = [[NSTextField alloc] initWithFrame:NSMakeRect(frameRect.size.width - 100, frameRect.size.height - 20, 92, 16)];
-        _diagnosticsLabel.bezeled = NO;
-        _diagnosticsLabel.drawsBackground = YES;
-        _diagnosticsLabel.backgroundColor = [[NSColor colorWithWhite:0.0 alpha:0.7] colorWithAlphaComponent:0.7];
-        _diagnosticsLabel.textColor = [NSColor whiteColor];
-        _diagnosticsLabel.font = [NSFont systemFontOfSize:9];
-        _diagnosticsLabel.alignment = NSTextAlignmentRight;
-        _diagnosticsLabel.editable = NO;
-        _diagnosticsLabel.selectable = NO;
-        _diagnosticsLabel.hidden = YES;
-        [self addSubview:_diagnosticsLabel];
-
-        // Start timestamp updates
-        [NSTimer scheduledTimerWithTimeInterval:1.0 target:self selector:@selector(updateTimestamp) userInfo:nil repeats:YES];
-
         _showLabel = YES;
         _showTimestamp = YES;
         _showDiagnostics = NO;
         _isPlaying = NO;
+        _statusColor = [NSColor grayColor];
     }
     return self;
 }
@@ -75,12 +40,63 @@
 - (void)layout {
     [super layout];
 
-    // Update layer frames
-    self.playerLayer.frame = self.bounds;
-    self.statusIndicator.frame = NSMakeRect(8, self.bounds.size.height - 20, 12, 12);
-    self.labelField.frame = NSMakeRect(8, 8, self.bounds.size.width - 16, 20);
-    self.timestampField.frame = NSMakeRect(self.bounds.size.width - 150, 8, 142, 20);
-    self.diagnosticsLabel.frame = NSMakeRect(self.bounds.size.width - 100, self.bounds.size.height - 20, 92, 16);
+    if (!CGSizeEqualToSize(self.lastLayoutSize, self.bounds.size) && self.isPlaying) {
+        [[RTSPDecodeScheduler sharedScheduler] setNeedsUpdate];
+    }
+    self.lastLayoutSize = self.bounds.size;
+}
+
+#pragma mark - Tile
+
+- (void)setRenderView:(RTSPGridRenderView *)renderView {
+    _renderView = renderView;
+    [self updateTile];
+}
+
+- (void)setTileIndex:(NSUInteger)tileIndex {
+    _tileIndex = tileIndex;
+    [self updateTile];
+}
+
+- (void)setShowLabel:(BOOL)showLabel {
+    _showLabel = showLabel;
+    [self updateTileVisibility];
+}
+
+- (void)setShowTimestamp:(BOOL)showTimestamp {
+    _showTimestamp = showTimestamp;
+    [self updateTileVisibility];
+}
+
+- (void)setShowDiagnostics:(BOOL)showDiagnostics {
+    _showDiagnostics = showDiagnostics;
+    [self updateTileVisibility];
+}
+
+- (void)setStatusColor:(NSColor *)statusColor {
+    _statusColor = statusColor;
+    [self.renderView setStatusColor:statusColor forTile:self.tileIndex];
+}
+
+/// Push everything this cell shows into its tile
+- (void)updateTile {
+    RTSPGridRenderView *renderView = self.renderView;
+    if (!renderView) {
+        return;
+    }
+    [renderView setPlayer:self.isPlaying ? self.player : nil forTile:self.tileIndex];
+    [renderView setLabel:self.cameraConfig ? (self.cameraConfig.name ?: @"Camera") : nil forTile:self.tileIndex];
+    [renderView setDiagnostics:self.diagnosticsText forTile:self.tileIndex];
+    [renderView setStatusColor:self.statusColor forTile:self.tileIndex];
+    [renderView setFocused:self.isFocused forTile:self.tileIndex];
+    [self updateTileVisibility];
+}
+
+- (void)updateTileVisibility {
+    [self.renderView setShowLabel:self.showLabel
+                    showTimestamp:self.showTimestamp
+                  showDiagnostics:self.showDiagnostics
+                          forTile:self.tileIndex];
 }
 
 - (void)loadFeed {
@@ -92,43 +108,62 @@
 
     [self updateStatusWithState:@"loading"];
 
-    // Create player
-    self.player = [[AVPlayer alloc] init];
+    // Create player; the item is created once the scheduler grants a decoder
+    if (!self.player) {
+        self.player = [[AVPlayer alloc] init];
+        [RTSPFrameBus busForPlayer:self.player];
+    }
     self.player.muted = self.cameraConfig.isMuted;
-    self.playerLayer.player = self.player;
-
-    // Create player item
-    AVPlayerItem *playerItem = [AVPlayerItem playerItemWithURL:self.cameraConfig.feedURL];
-
-    // Observe player item status
-    [playerItem addObserver:self forKeyPath:@"status" options:NSKeyValueObservingOptionNew context:nil];
-
-    [self.player replaceCurrentItemWithPlayerItem:playerItem];
-    [self.player play];
 
     self.isPlaying = YES;
-    self.labelField.stringValue = self.cameraConfig.name ?: @"Camera";
-    self.labelField.hidden = !self.showLabel;
-    self.timestampField.hidden = !self.showTimestamp;
+    [self updateTile];
+
+    [[RTSPDecodeScheduler sharedScheduler] addClient:self];
 
     NSLog(@"[CameraCell] Loading feed: %@", self.cameraConfig.name);
 }
 
 - (void)stopPlayback {
+    [[RTSPDecodeScheduler sharedScheduler] removeClient:self];
+    _decodeMode = RTSPDecodeModePaused;
+    self.pausedSince = 0;
     [self.player pause];
-    [self.player replaceCurrentItemWithPlayerItem:nil];
+    [self replaceItemWithURL:nil];
     self.isPlaying = NO;
     [self updateStatusWithState:@"stopped"];
+    [self updateTile];
 
     NSLog(@"[CameraCell] Stopped playback: %@", self.cameraConfig.name);
 }
 
+- (void)replaceItemWithURL:(nullable NSURL *)url {
+    if (self.observedItem) {
+        [self.observedItem removeObserver:self forKeyPath:@"status"];
+        self.observedItem = nil;
+    }
+    self.itemURL = url;
+
+    AVPlayerItem *playerItem = nil;
+    if (url) {
+        playerItem = [AVPlayerItem playerItemWithURL:url];
+
+        // Observe player item status
+        [playerItem addObserver:self forKeyPath:@"status" options:NSKeyValueObservingOptionNew context:nil];
+        self.observedItem = playerItem;
+    }
+    [self.player replaceCurrentItemWithPlayerItem:playerItem];
+}
+
 - (void)observeValueForKeyPath:(NSString *)keyPath ofObject:(id)object change:(NSDictionary *)change context:(void *)context {
     if ([keyPath isEqualToString:@"status"]) {
         AVPlayerItem *item = (AVPlayerItem *)object;
         dispatch_async(dispatch_get_main_queue(), ^{
+            if (item != self.observedItem) {
+                return;
+            }
             if (item.status == AVPlayerItemStatusReadyToPlay) {
                 [self updateStatusWithState:@"playing"];
+                [self measurePixelRateOfItem:item];
                 NSLog(@"[CameraCell] Feed ready: %@", self.cameraConfig.name);
             } else if (item.status == AVPlayerItemStatusFailed) {
                 [self updateStatusWithState:@"error"];
@@ -138,12 +173,137 @@
     }
 }
 
+#pragma mark - Decode Scheduling
+
+- (CGSize)decodeVisiblePixelSize {
+    NSWindow *window = self.window;
+    if (!self.isPlaying || !window || self.isHiddenOrHasHiddenAncestor || window.isMiniaturized ||
+        !(window.occlusionState & NSWindowOcclusionStateVisible)) {
+        return CGSizeZero;
+    }
+    NSRect visible = [self visibleRect];
+    if (NSIsEmptyRect(visible)) {
+        return CGSizeZero;
+    }
+    return [self convertRectToBacking:visible].size;
+}
+
+- (BOOL)decodeHasFocus {
+    return self.isFocused;
+}
+
+- (BOOL)decodeHasSubstream {
+    return self.cameraConfig.substreamURL != nil;
+}
+
+- (double)decodePixelRateForMode:(RTSPDecodeMode)mode {
+    switch (mode) {
+        case RTSPDecodeModeMain:
+            return self.mainPixelRate > 0 ? self.mainPixelRate : kRTSPCameraCellMainPixelRate;
+        case RTSPDecodeModeSubstream:
+            return self.substreamPixelRate > 0 ? self.substreamPixelRate : kRTSPCameraCellSubstreamPixelRate;
+        default:
+            return 0;
+    }
+}
+
+- (void)applyDecodeMode:(RTSPDecodeMode)mode {
+    RTSPDecodeMode previous = _decodeMode;
+    _decodeMode = mode;
+    if (!self.isPlaying) {
+        return;
+    }
+
+    if (mode == RTSPDecodeModePaused) {
+        // Keep the last frame up; the connection goes if the pause lasts
+        [self.player pause];
+        CFTimeInterval pausedSince = CACurrentMediaTime();
+        self.pausedSince = pausedSince;
+        [self updateStatusWithState:@"paused"];
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(kRTSPCameraCellReleaseDelay * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+            if (self.decodeMode == RTSPDecodeModePaused && self.pausedSince == pausedSince && self.isPlaying) {
+                [self replaceItemWithURL:nil];
+            }
+        });
+        NSLog(@"[CameraCell] Paused %@", self.cameraConfig.name);
+        return;
+    }
+
+    NSURL *url = mode == RTSPDecodeModeSubstream ? self.cameraConfig.substreamURL : self.cameraConfig.feedURL;
+    self.pausedSince = 0;
+    if (self.player.currentItem && [self.itemURL isEqual:url]) {
+        // Resuming a live stream: jump back to the live edge
+        NSValue *range = self.player.currentItem.seekableTimeRanges.lastObject;
+        if (range) {
+            [self.player seekToTime:CMTimeRangeGetEnd(range.CMTimeRangeValue)];
+        }
+        [self updateStatusWithState:self.player.currentItem.status == AVPlayerItemStatusReadyToPlay ? @"playing" : @"loading"];
+    } else {
+        [self updateStatusWithState:@"loading"];
+        [self replaceItemWithURL:url];
+    }
+    [self.player play];
+
+    NSLog(@"[CameraCell] Decoding %@ from %@%@", self.cameraConfig.name,
+          mode == RTSPDecodeModeSubstream ? @"substream" : @"main stream",
+          previous == RTSPDecodeModePaused ? @"" : @" (switched)");
+}
+
+- (void)measurePixelRateOfItem:(AVPlayerItem *)item {
+    CGSize size = item.presentationSize;
+    float frameRate = 0;
+    for (AVPlayerItemTrack *track in item.tracks) {
+        if ([track.assetTrack.mediaType isEqualToString:AVMediaTypeVideo]) {
+            frameRate = track.currentVideoFrameRate > 0 ? track.currentVideoFrameRate : track.assetTrack.nominalFrameRate;
+            break;
+        }
+    }
+    if (size.width <= 0 || size.height <= 0) {
+        return;
+    }
+    double rate = size.width * size.height * (frameRate > 0 ? frameRate : 30.0);
+    if ([self.itemURL isEqual:self.cameraConfig.substreamURL]) {
+        self.substreamPixelRate = rate;
+    } else {
+        self.mainPixelRate = rate;
+    }
+    [[RTSPDecodeScheduler sharedScheduler] setNeedsUpdate];
+}
+
+- (void)viewDidMoveToWindow {
+    [super viewDidMoveToWindow];
+    if (self.isPlaying) {
+        [[RTSPDecodeScheduler sharedScheduler] setNeedsUpdate];
+    }
+}
+
+- (void)viewDidHide {
+    [super viewDidHide];
+    if (self.isPlaying) {
+        [[RTSPDecodeScheduler sharedScheduler] setNeedsUpdate];
+    }
+}
+
+- (void)viewDidUnhide {
+    [super viewDidUnhide];
+    if (self.isPlaying) {
+        [[RTSPDecodeScheduler sharedScheduler] setNeedsUpdate];
+    }
+}
+
+- (void)setIsFocused:(BOOL)isFocused {
+    if (_isFocused != isFocused) {
+        _isFocused = isFocused;
+        [self.renderView setFocused:isFocused forTile:self.tileIndex];
+        [[RTSPDecodeScheduler sharedScheduler] setNeedsUpdate];
+    }
+}
+
 - (void)updateStatusWithHealthStatus:(RTSPCameraHealthStatus)status {
     RTSPCameraDiagnostics *diagnostics = [RTSPCameraDiagnostics sharedDiagnostics];
     RTSPCameraDiagnosticReport *report = [diagnostics reportForCamera:self.cameraConfig];
 
-    NSColor *color = report ? [report statusColor] : [NSColor grayColor];
-    self.statusIndicator.layer.backgroundColor = [color CGColor];
+    self.statusColor = report ? [report statusColor] : [NSColor grayColor];
 
     [self updateDiagnosticsDisplay];
 }
@@ -157,24 +317,22 @@
         color = [NSColor yellowColor];
     } else if ([state isEqualToString:@"error"]) {
         color = [NSColor redColor];
+    } else if ([state isEqualToString:@"paused"]) {
+        color = [NSColor blueColor];
     } else if ([state isEqualToString:@"stopped"]) {
         color = [NSColor grayColor];
     }
 
-    self.statusIndicator.layer.backgroundColor = [color CGColor];
+    self.statusColor = color;
 }
 
 - (void)updateDiagnosticsDisplay {
-    if (!self.showDiagnostics) {
-        self.diagnosticsLabel.hidden = YES;
-        return;
-    }
-
     RTSPCameraDiagnostics *diagnostics = [RTSPCameraDiagnostics sharedDiagnostics];
     RTSPCameraDiagnosticReport *report = [diagnostics reportForCamera:self.cameraConfig];
 
+    NSString *diagText = nil;
     if (report) {
-        NSString *diagText = @"";
+        diagText = @"";
 
         if (report.hasVideo) {
             diagText = [NSString stringWithFormat:@"%@ %ldfps", report.resolution ?: @"", (long)report.framerate];
@@ -183,24 +341,11 @@
         if (report.latency > 0) {
             diagText = [diagText stringByAppendingFormat:@" %.0fms", report.latency];
         }
-
-        self.diagnosticsLabel.stringValue = diagText;
-        self.diagnosticsLabel.hidden = NO;
-    } else {
-        self.diagnosticsLabel.hidden = YES;
     }
-}
 
-- (void)updateTimestamp {
-    if (!self.showTimestamp) {
-        self.timestampField.hidden = YES;
-        return;
-    }
-
-    NSDateFormatter *formatter = [[NSDateFormatter alloc] init];
-    formatter.dateFormat = @"HH:mm:ss";
-    self.timestampField.stringValue = [formatter stringFromDate:[NSDate date]];
-    self.timestampField.hidden = NO;
+    // Shown only while showDiagnostics is on
+    self.diagnosticsText = diagText;
+    [self.renderView setDiagnostics:diagText forTile:self.tileIndex];
 }
 
 - (void)dealloc {
@@ -227,6 +372,10 @@
         self.wantsLayer = YES;
         self.layer.backgroundColor = [[NSColor blackColor] CGColor];
 
+        // One surface under the cells draws every tile
+        _renderView = [[RTSPGridRenderView alloc] initWithFrame:NSZeroRect];
+        [self addSubview:_renderView];
+
         [self loadDashboard:dashboard];
     }
     return self;
@@ -240,6 +389,26 @@
     return [self.allCameraCells copy];
 }
 
+- (void)setFocusedCell:(RTSPCameraCell *)focusedCell {
+    _focusedCell.isFocused = NO;
+    _focusedCell = focusedCell;
+    focusedCell.isFocused = YES;
+}
+
+- (void)mouseDown:(NSEvent *)event {
+    NSPoint point = [self convertPoint:event.locationInWindow fromView:nil];
+    for (RTSPCameraCell *cell in self.allCameraCells) {
+        if (NSPointInRect(point, cell.frame)) {
+            self.focusedCell = cell;
+            if ([self.delegate respondsToSelector:@selector(multiViewGrid:didSelectCamera:)]) {
+                [self.delegate multiViewGrid:self didSelectCamera:cell.cameraConfig];
+            }
+            return;
+        }
+    }
+    [super mouseDown:event];
+}
+
 - (void)loadDashboard:(RTSPDashboard *)dashboard {
     // Stop and remove existing cells
     [self stopAllFeeds];
@@ -247,6 +416,8 @@
         [cell removeFromSuperview];
     }
     [self.allCameraCells removeAllObjects];
+    self.focusedCell = nil;
+    [self.renderView removeAllTiles];
 
     self.dashboard = dashboard;
 
@@ -262,6 +433,8 @@
         cell.showLabel = dashboard.showLabels;
         cell.showTimestamp = dashboard.showTimestamp;
         cell.showDiagnostics = self.showDiagnostics;
+        cell.tileIndex = self.allCameraCells.count;
+        cell.renderView = self.renderView;
         [self.allCameraCells addObject:cell];
         [self addSubview:cell];
     }
@@ -272,6 +445,7 @@
 }
 
 - (void)layoutCameraGrid {
+    self.renderView.frame = self.bounds;
     if (!self.dashboard || self.allCameraCells.count == 0) {
         return;
     }
@@ -300,6 +474,8 @@
             break;
     }
 
+    [self.renderView setRows:rows columns:columns spacing:self.gridSpacing];
+
     CGFloat totalWidth = self.bounds.size.width;
     CGFloat totalHeight = self.bounds.size.height;
 
@@ -24,6 +24,10 @@ NS_ASSUME_NONNULL_BEGIN
 
 @class RTSPNetworkMonitor;
 
+/// Posted after every statistics update, alongside the delegate call.
+/// userInfo: @"stats" (RTSPNetworkStats)
+extern NSString * const RTSPNetworkMonitorDidUpdateStatsNotification;
+
 /// Network monitor delegate
 @protocol RTSPNetworkMonitorDelegate <NSObject>
 @optional
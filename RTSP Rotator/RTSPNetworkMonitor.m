@@ -5,6 +5,8 @@
 
 #import "RTSPNetworkMonitor.h"
 
+NSString * const RTSPNetworkMonitorDidUpdateStatsNotification = @"RTSPNetworkMonitorDidUpdateStatsNotification";
+
 @implementation RTSPNetworkStats
 @end
 
@@ -113,6 +115,9 @@
     if ([self.delegate respondsToSelector:@selector(networkMonitor:didUpdateStats:)]) {
         [self.delegate networkMonitor:self didUpdateStats:stats];
     }
+    [[NSNotificationCenter defaultCenter] postNotificationName:RTSPNetworkMonitorDidUpdateStatsNotification
+                                                        object:self
+                                                      userInfo:@{@"stats": stats}];
 
     // Check for poor quality
     if (stats.connectionQuality < self.poorQualityThreshold) {
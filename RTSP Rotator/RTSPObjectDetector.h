@@ -12,15 +12,20 @@
 
 NS_ASSUME_NONNULL_BEGIN
 
+@class RTSPDVRPosition;
+
 /// Object detection zone for filtering
 @interface RTSPDetectionZone : NSObject
 
 @property (nonatomic, copy) NSString *name;
-@property (nonatomic, assign) CGRect normalizedRect;  // 0.0-1.0 coordinates
+@property (nonatomic, assign) CGRect normalizedRect;  // 0.0-1.0 coordinates; a polygon's bounds
+@property (nonatomic, copy, nullable) NSArray<NSValue *> *points;   // Polygon (3-64 NSPoint values, normalized); nil = normalizedRect
+@property (nonatomic, assign) float minimumOverlap;   // Fraction of a detection's box inside the zone to count (default: 0 = any overlap)
 @property (nonatomic, assign) BOOL enabled;
 @property (nonatomic, copy) NSArray<NSString *> *enabledClasses; // nil = all classes
 
 - (instancetype)initWithName:(NSString *)name rect:(CGRect)rect;
+- (instancetype)initWithName:(NSString *)name points:(NSArray<NSValue *> *)points;
 - (BOOL)containsDetection:(RTSPDetection *)detection;
 
 @end
@@ -32,19 +37,30 @@ NS_ASSUME_NONNULL_BEGIN
 @property (nonatomic, copy) NSString *cameraName;
 @property (nonatomic, strong) RTSPDetection *detection;
 @property (nonatomic, strong) NSDate *timestamp;
-@property (nonatomic, copy, nullable) NSString *zoneName;
+@property (nonatomic, copy, nullable) NSString *zoneName;                 // First of zoneNames
+@property (nonatomic, copy) NSArray<NSString *> *zoneNames;              // Every zone the detection is in
 @property (nonatomic, assign) BOOL alertTriggered;
 @property (nonatomic, strong, nullable) NSImage *snapshot;
+@property (nonatomic, strong, nullable) RTSPDVRPosition *recording;      // DVR keyframe at or before the event; needs the camera's feed URL
 
 @end
 
 @class RTSPObjectDetector;
 
+/// Posted on the main queue for every detection event, alongside the delegate call.
+/// userInfo: @"event" (RTSPDetectionEvent)
+extern NSString * const RTSPObjectDetectorDidDetectEventNotification;
+
+/// Posted on the main queue when tracked objects start, end, or enter / leave a zone.
+/// userInfo: @"events" (NSArray<RTSPTrackingEvent *>), @"cameraID"
+extern NSString * const RTSPObjectDetectorDidUpdateTracksNotification;
+
 /// Object detector delegate
 @protocol RTSPObjectDetectorDelegate <NSObject>
 @optional
 - (void)objectDetector:(RTSPObjectDetector *)detector didDetectEvent:(RTSPDetectionEvent *)event;
 - (void)objectDetector:(RTSPObjectDetector *)detector didUpdateStatistics:(NSDictionary *)stats;
+- (void)objectDetector:(RTSPObjectDetector *)detector didUpdateTracks:(NSArray<RTSPTrackingEvent *> *)events forCamera:(NSString *)cameraID;
 @end
 
 /// High-level object detection manager
@@ -74,6 +90,9 @@ NS_ASSUME_NONNULL_BEGIN
  * Enable detection for camera
  * @param cameraID Camera identifier
  * @param zones Optional detection zones (nil = entire frame)
+ *
+ * Zones are indexed when they are set: after editing a zone, set the
+ * camera's zones again.
  */
 - (void)enableDetectionForCamera:(NSString *)cameraID zones:(NSArray<RTSPDetectionZone *> * _Nullable)zones;
 
@@ -83,6 +102,14 @@ NS_ASSUME_NONNULL_BEGIN
  */
 - (void)disableDetectionForCamera:(NSString *)cameraID;
 
+/**
+ * Feed a camera's frames come from, so its events point into the feed's
+ * DVR recording (see RTSPDetectionEvent.recording)
+ * @param feedURL The camera's RTSPS or local HLS URL; nil to stop
+ * @param cameraID Camera identifier
+ */
+- (void)setFeedURL:(nullable NSURL *)feedURL forCamera:(NSString *)cameraID;
+
 /**
  * Process frame from camera
  * @param pixelBuffer CVPixelBuffer containing frame
@@ -110,13 +137,20 @@ NS_ASSUME_NONNULL_BEGIN
 /**
  * Get recent detection events
  * @param limit Maximum number of events
- * @return Array of recent events
+ * @return Array of recent events, oldest first
+ *
+ * Safe from any thread and never waits for detection processing. Events
+ * are rebuilt from the history's compact records, so each call returns new
+ * objects and snapshot is not kept.
  */
 - (NSArray<RTSPDetectionEvent *> *)recentEvents:(NSInteger)limit;
 
 /**
  * Get detection statistics
  * @return Statistics dictionary
+ *
+ * Counts cover the events in history. Safe from any thread and never waits
+ * for detection processing.
  */
 - (NSDictionary *)statistics;
 
@@ -6,7 +6,18 @@
 //
 
 #import "RTSPObjectDetector.h"
+#import "RTSPDetectionRing.h"
+#import "RTSPFFmpegProxy.h"
+#import "RTSPZoneIndex.h"
 #import <AppKit/AppKit.h>
+#import <QuartzCore/QuartzCore.h>
+
+NSString * const RTSPObjectDetectorDidDetectEventNotification = @"RTSPObjectDetectorDidDetectEventNotification";
+NSString * const RTSPObjectDetectorDidUpdateTracksNotification = @"RTSPObjectDetectorDidUpdateTracksNotification";
+
+@interface RTSPDetectionZone ()
+- (BOOL)getPolygon:(RTSPZonePolygon *)polygon points:(RTSPZonePoint *)points;
+@end
 
 @implementation RTSPDetectionZone
 
@@ -21,16 +32,66 @@
     return self;
 }
 
+- (instancetype)initWithName:(NSString *)name points:(NSArray<NSValue *> *)points {
+    self = [self initWithName:name rect:CGRectZero];
+    if (self) {
+        self.points = points;
+    }
+    return self;
+}
+
+- (void)setPoints:(NSArray<NSValue *> *)points {
+    _points = [points copy];
+    if (points.count == 0) {
+        return;
+    }
+    // Keep normalizedRect as the polygon's bounds for drawing and rect consumers
+    CGFloat minX = CGFLOAT_MAX, minY = CGFLOAT_MAX, maxX = -CGFLOAT_MAX, maxY = -CGFLOAT_MAX;
+    for (NSValue *value in points) {
+        NSPoint point = value.pointValue;
+        minX = MIN(minX, point.x);
+        minY = MIN(minY, point.y);
+        maxX = MAX(maxX, point.x);
+        maxY = MAX(maxY, point.y);
+    }
+    _normalizedRect = CGRectMake(minX, minY, maxX - minX, maxY - minY);
+}
+
+/// The zone as an RTSPZoneIndex polygon; `points` holds up to
+/// RTSP_ZONE_INDEX_MAX_POINTS vertices. NO for polygons the index cannot take.
+- (BOOL)getPolygon:(RTSPZonePolygon *)polygon points:(RTSPZonePoint *)points {
+    uint32_t count = 0;
+    if (self.points) {
+        if (self.points.count < 3 || self.points.count > RTSP_ZONE_INDEX_MAX_POINTS) {
+            return NO;
+        }
+        for (NSValue *value in self.points) {
+            points[count++] = (RTSPZonePoint){value.pointValue.x, value.pointValue.y};
+        }
+    } else {
+        CGRect rect = self.normalizedRect;
+        points[0] = (RTSPZonePoint){CGRectGetMinX(rect), CGRectGetMinY(rect)};
+        points[1] = (RTSPZonePoint){CGRectGetMaxX(rect), CGRectGetMinY(rect)};
+        points[2] = (RTSPZonePoint){CGRectGetMaxX(rect), CGRectGetMaxY(rect)};
+        points[3] = (RTSPZonePoint){CGRectGetMinX(rect), CGRectGetMaxY(rect)};
+        count = 4;
+    }
+    *polygon = (RTSPZonePolygon){points, count, MIN(MAX(self.minimumOverlap, 0.0f), 1.0f)};
+    return YES;
+}
+
 - (BOOL)containsDetection:(RTSPDetection *)detection {
     if (!self.enabled) return NO;
 
-    // Check if detection bounding box intersects with zone
-    CGRect detectionRect = detection.boundingBox;
-    CGRect zoneRect = self.normalizedRect;
+    // Check how much of the detection's box is in the zone
+    RTSPZonePoint points[RTSP_ZONE_INDEX_MAX_POINTS];
+    RTSPZonePolygon polygon;
+    if (![self getPolygon:&polygon points:points]) return NO;
 
-    BOOL intersects = CGRectIntersectsRect(detectionRect, zoneRect);
+    CGRect box = detection.boundingBox;
+    float overlap = RTSPZonePolygonOverlap(&polygon, box.origin.x, box.origin.y, box.size.width, box.size.height);
 
-    if (!intersects) return NO;
+    if (polygon.minOverlap > 0 ? overlap < polygon.minOverlap : overlap <= 0) return NO;
 
     // Check class filter
     if (self.enabledClasses && ![self.enabledClasses containsObject:detection.label]) {
@@ -41,15 +102,73 @@
 }
 
 - (NSString *)description {
-    return [NSString stringWithFormat:@"<RTSPDetectionZone: %@ rect:(%.2f,%.2f,%.2f,%.2f) enabled:%@>",
+    return [NSString stringWithFormat:@"<RTSPDetectionZone: %@ rect:(%.2f,%.2f,%.2f,%.2f) points:%lu enabled:%@>",
             self.name,
             self.normalizedRect.origin.x, self.normalizedRect.origin.y,
             self.normalizedRect.size.width, self.normalizedRect.size.height,
+            (unsigned long)self.points.count,
             self.enabled ? @"YES" : @"NO"];
 }
 
 @end
 
+/// A camera's enabled zones in an RTSPZoneIndex, so each detection is
+/// matched against all of them in one pass
+@interface RTSPCameraZoneIndex : NSObject
+@property (nonatomic, copy) NSArray<RTSPDetectionZone *> *zones;    // By index bit
+@property (nonatomic, assign) RTSPZoneIndexRef index;
+@end
+
+@implementation RTSPCameraZoneIndex
+
+- (nullable instancetype)initWithZones:(NSArray<RTSPDetectionZone *> *)zones cameraID:(NSString *)cameraID {
+    self = [super init];
+    if (self) {
+        NSMutableArray<RTSPDetectionZone *> *indexed = [NSMutableArray array];
+        NSMutableData *points = [NSMutableData dataWithLength:RTSP_ZONE_INDEX_MAX_ZONES * RTSP_ZONE_INDEX_MAX_POINTS * sizeof(RTSPZonePoint)];
+        RTSPZonePolygon polygons[RTSP_ZONE_INDEX_MAX_ZONES];
+        for (RTSPDetectionZone *zone in zones) {
+            if (!zone.enabled) continue;
+            if (indexed.count == RTSP_ZONE_INDEX_MAX_ZONES) {
+                NSLog(@"[ObjectDetector] Camera %@: only the first %d zones are used", cameraID, RTSP_ZONE_INDEX_MAX_ZONES);
+                break;
+            }
+            RTSPZonePoint *storage = (RTSPZonePoint *)points.mutableBytes + indexed.count * RTSP_ZONE_INDEX_MAX_POINTS;
+            if (![zone getPolygon:&polygons[indexed.count] points:storage]) {
+                NSLog(@"[ObjectDetector] Camera %@: zone %@ needs 3-%d points", cameraID, zone.name, RTSP_ZONE_INDEX_MAX_POINTS);
+                continue;
+            }
+            [indexed addObject:zone];
+        }
+        _index = RTSPZoneIndexCreate(polygons, (uint32_t)indexed.count, 0);
+        if (!_index) {
+            NSLog(@"[ObjectDetector] Camera %@: could not index %lu zones", cameraID, (unsigned long)indexed.count);
+            return nil;
+        }
+        _zones = [indexed copy];
+    }
+    return self;
+}
+
+/// Names of the zones a detection is in whose class filter lets it through
+- (NSArray<NSString *> *)zoneNamesForDetection:(RTSPDetection *)detection {
+    CGRect box = detection.boundingBox;
+    RTSPZoneMask mask = RTSPZoneIndexMatchBox(self.index, box.origin.x, box.origin.y, box.size.width, box.size.height, NULL);
+    NSMutableArray<NSString *> *names = [NSMutableArray array];
+    for (; mask; mask &= mask - 1) {
+        RTSPDetectionZone *zone = self.zones[__builtin_ctzll(mask)];
+        if (zone.enabledClasses && ![zone.enabledClasses containsObject:detection.label]) continue;
+        [names addObject:zone.name];
+    }
+    return names;
+}
+
+- (void)dealloc {
+    RTSPZoneIndexRelease(_index);
+}
+
+@end
+
 @implementation RTSPDetectionEvent
 
 - (NSString *)description {
@@ -59,11 +178,50 @@
 
 @end
 
+/// Names behind the small IDs in history records. IDs are handed out on the
+/// event queue; `names` is replaced whole, so readers on any thread see a
+/// consistent table without waiting for the queue.
+@interface RTSPHistoryNames : NSObject
+@property (nonatomic, strong) NSMutableDictionary<id, NSNumber *> *identifiers;
+@property (atomic, copy) NSArray *names;
+@property (nonatomic, assign) NSUInteger limit;
+@end
+
+@implementation RTSPHistoryNames
+
+- (instancetype)initWithLimit:(NSUInteger)limit {
+    self = [super init];
+    if (self) {
+        _identifiers = [NSMutableDictionary dictionary];
+        _names = @[];
+        _limit = limit;
+    }
+    return self;
+}
+
+/// ID for a name, or UINT16_MAX once `limit` names are in use. Event queue only.
+- (uint16_t)identifierForName:(id<NSCopying>)name {
+    NSNumber *identifier = self.identifiers[name];
+    if (identifier) return identifier.unsignedShortValue;
+    NSArray *names = self.names;
+    if (names.count >= MIN(self.limit, UINT16_MAX)) return UINT16_MAX;
+    self.identifiers[name] = @(names.count);
+    self.names = [names arrayByAddingObject:name];
+    return (uint16_t)names.count;
+}
+
+@end
+
 @interface RTSPObjectDetector () <RTSPMLXProcessorDelegate>
 
 @property (nonatomic, strong) RTSPMLXProcessor *mlxProcessor;
 @property (nonatomic, strong) NSMutableDictionary<NSString *, NSArray<RTSPDetectionZone *> *> *cameraZones;
-@property (nonatomic, strong) NSMutableArray<RTSPDetectionEvent *> *detectionHistory;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, RTSPCameraZoneIndex *> *cameraZoneIndexes;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSURL *> *cameraFeedURLs;
+@property (nonatomic, assign) RTSPDetectionRingRef detectionHistory;
+@property (nonatomic, strong) RTSPHistoryNames *historyLabels;      // NSString
+@property (nonatomic, strong) RTSPHistoryNames *historyCameras;     // @[cameraID, cameraName]
+@property (nonatomic, strong) RTSPHistoryNames *historyZoneSets;    // NSArray<NSString *>
 @property (nonatomic, strong) NSMutableSet<NSString *> *enabledCameras;
 @property (nonatomic, strong) dispatch_queue_t eventQueue;
 @property (nonatomic, assign) NSInteger maxHistorySize;
@@ -87,17 +245,26 @@
         _mlxProcessor = [RTSPMLXProcessor sharedProcessor];
         _mlxProcessor.delegate = self;
         _cameraZones = [NSMutableDictionary dictionary];
-        _detectionHistory = [NSMutableArray array];
+        _cameraZoneIndexes = [NSMutableDictionary dictionary];
+        _cameraFeedURLs = [NSMutableDictionary dictionary];
+        _historyLabels = [[RTSPHistoryNames alloc] initWithLimit:RTSP_DETECTION_RING_MAX_CLASSES];
+        _historyCameras = [[RTSPHistoryNames alloc] initWithLimit:RTSP_DETECTION_RING_MAX_CAMERAS];
+        _historyZoneSets = [[RTSPHistoryNames alloc] initWithLimit:UINT16_MAX];
         _enabledCameras = [NSMutableSet set];
         _eventQueue = dispatch_queue_create("com.rtsp.objectdetector.events", DISPATCH_QUEUE_SERIAL);
         _detectionEnabled = YES;
         _maxHistorySize = 1000; // Keep last 1000 events
+        _detectionHistory = RTSPDetectionRingCreate((uint32_t)_maxHistorySize);
 
         NSLog(@"[ObjectDetector] Initialized with MLX Processor");
     }
     return self;
 }
 
+- (void)dealloc {
+    RTSPDetectionRingRelease(_detectionHistory);
+}
+
 - (BOOL)initializeWithModel:(NSString *)modelPath error:(NSError **)error {
     NSLog(@"[ObjectDetector] Initializing with model: %@", modelPath);
 
@@ -115,11 +282,10 @@
 - (void)enableDetectionForCamera:(NSString *)cameraID zones:(NSArray<RTSPDetectionZone *> *)zones {
     [self.enabledCameras addObject:cameraID];
 
+    [self storeZones:zones forCamera:cameraID];
     if (zones) {
-        self.cameraZones[cameraID] = zones;
         NSLog(@"[ObjectDetector] Enabled detection for camera %@ with %lu zones", cameraID, (unsigned long)zones.count);
     } else {
-        [self.cameraZones removeObjectForKey:cameraID];
         NSLog(@"[ObjectDetector] Enabled detection for camera %@ (full frame)", cameraID);
     }
 }
@@ -127,11 +293,17 @@
 - (void)disableDetectionForCamera:(NSString *)cameraID {
     [self.enabledCameras removeObject:cameraID];
     [self.cameraZones removeObjectForKey:cameraID];
+    [self.cameraZoneIndexes removeObjectForKey:cameraID];
+    [self.cameraFeedURLs removeObjectForKey:cameraID];
     [self.mlxProcessor stopProcessingForCamera:cameraID];
 
     NSLog(@"[ObjectDetector] Disabled detection for camera %@", cameraID);
 }
 
+- (void)setFeedURL:(NSURL *)feedURL forCamera:(NSString *)cameraID {
+    self.cameraFeedURLs[cameraID] = feedURL;
+}
+
 - (void)processFrame:(CVPixelBufferRef)pixelBuffer fromCamera:(NSString *)cameraID name:(NSString *)cameraName {
     if (!self.detectionEnabled) return;
     if (![self.enabledCameras containsObject:cameraID]) return;
@@ -147,34 +319,34 @@
 
         if (detections.count == 0) return;
 
-        // Filter detections by zones
-        NSArray<RTSPDetectionZone *> *zones = self.cameraZones[cameraID];
-        NSArray<RTSPDetection *> *filteredDetections = detections;
-
-        if (zones) {
-            NSMutableArray *filtered = [NSMutableArray array];
-            for (RTSPDetection *detection in detections) {
-                for (RTSPDetectionZone *zone in zones) {
-                    if ([zone containsDetection:detection]) {
-                        [filtered addObject:detection];
-                        break;
-                    }
-                }
-            }
-            filteredDetections = filtered;
+        // Match each detection against the camera's zones once; with zones set,
+        // detections outside all of them are dropped
+        RTSPCameraZoneIndex *zoneIndex = self.cameraZoneIndexes[cameraID];
+        BOOL zoned = self.cameraZones[cameraID] != nil;
+
+        // Create detection events; predicted boxes between inferences are not new sightings
+        CFTimeInterval zoneTime = 0;
+        for (RTSPDetection *detection in detections) {
+            if (detection.isInterpolated) continue;
+            CFTimeInterval start = CACurrentMediaTime();
+            NSArray<NSString *> *zoneNames = zoneIndex ? [zoneIndex zoneNamesForDetection:detection] : @[];
+            zoneTime += CACurrentMediaTime() - start;
+            if (zoned && zoneNames.count == 0) continue;
+            [self createEventForDetection:detection cameraID:cameraID cameraName:cameraName zoneNames:zoneNames];
         }
-
-        // Create detection events
-        for (RTSPDetection *detection in filteredDetections) {
-            [self createEventForDetection:detection cameraID:cameraID cameraName:cameraName];
+        if (zoneIndex) {
+            [self.mlxProcessor recordLatency:zoneTime stage:RTSPLatencyStageZoneFilter forCamera:cameraID];
         }
     }];
 }
 
 - (void)createEventForDetection:(RTSPDetection *)detection
                        cameraID:(NSString *)cameraID
-                     cameraName:(NSString *)cameraName {
+                     cameraName:(NSString *)cameraName
+                      zoneNames:(NSArray<NSString *> *)zoneNames {
 
+    CFTimeInterval dispatchStart = CACurrentMediaTime();
+    NSURL *feedURL = self.cameraFeedURLs[cameraID];
     dispatch_async(self.eventQueue, ^{
         RTSPDetectionEvent *event = [[RTSPDetectionEvent alloc] init];
         event.cameraID = cameraID;
@@ -182,101 +354,186 @@
         event.detection = detection;
         event.timestamp = [NSDate date];
         event.alertTriggered = NO;
-
-        // Find zone name if applicable
-        NSArray<RTSPDetectionZone *> *zones = self.cameraZones[cameraID];
-        for (RTSPDetectionZone *zone in zones) {
-            if ([zone containsDetection:detection]) {
-                event.zoneName = zone.name;
-                break;
-            }
+        event.zoneNames = zoneNames;
+        event.zoneName = zoneNames.firstObject;
+        // One seek through the DVR index; the event then leads straight to its video
+        if (feedURL) {
+            event.recording = [[RTSPFFmpegProxy sharedProxy] dvrPositionForURL:feedURL time:event.timestamp];
         }
 
-        // Add to history
-        [self.detectionHistory addObject:event];
-
-        // Trim history if needed
-        if (self.detectionHistory.count > self.maxHistorySize) {
-            [self.detectionHistory removeObjectsInRange:NSMakeRange(0, self.detectionHistory.count - self.maxHistorySize)];
-        }
+        // Add to history; the ring drops the oldest event once full
+        [self recordEvent:event];
 
         // Notify delegate
         dispatch_async(dispatch_get_main_queue(), ^{
             if ([self.delegate respondsToSelector:@selector(objectDetector:didDetectEvent:)]) {
                 [self.delegate objectDetector:self didDetectEvent:event];
             }
+            [[NSNotificationCenter defaultCenter] postNotificationName:RTSPObjectDetectorDidDetectEventNotification
+                                                                object:self
+                                                              userInfo:@{@"event": event}];
+            [self.mlxProcessor recordLatency:CACurrentMediaTime() - dispatchStart
+                                       stage:RTSPLatencyStageAlertDispatch
+                                   forCamera:cameraID];
         });
-
-        NSLog(@"[ObjectDetector] Event: %@ detected %@ in %@%@",
-              cameraName, detection.label,
-              event.zoneName ?: @"frame",
-              event.alertTriggered ? @" (ALERT)" : @"");
     });
 }
 
+/// Store an event in the history ring as a compact record. Event queue only.
+- (void)recordEvent:(RTSPDetectionEvent *)event {
+    RTSPDetection *detection = event.detection;
+    RTSPDetectionRecord record = {0};
+    record.timestamp = event.timestamp.timeIntervalSince1970;
+    record.detectedAt = detection.timestamp.timeIntervalSince1970;
+    record.x = detection.boundingBox.origin.x;
+    record.y = detection.boundingBox.origin.y;
+    record.width = detection.boundingBox.size.width;
+    record.height = detection.boundingBox.size.height;
+    record.confidence = detection.confidence;
+    record.classID = [self.historyLabels identifierForName:detection.label ?: @""];
+    record.cameraID = [self.historyCameras identifierForName:@[event.cameraID ?: @"", event.cameraName ?: @""]];
+    record.zoneSetID = [self.historyZoneSets identifierForName:event.zoneNames ?: @[]];
+    record.flags = (detection.isTracked ? RTSPDetectionRecordFlagTracked : 0) |
+                   (event.alertTriggered ? RTSPDetectionRecordFlagAlert : 0);
+    if (event.recording && event.recording.offset <= UINT32_MAX) {
+        record.mediaSegment = event.recording.segment;
+        record.mediaOffset = (uint32_t)event.recording.offset;
+        record.mediaTime = event.recording.timestamp;
+    }
+
+    // Tracker IDs are "<cameraID>#<n>"; anything else is a one-off UUID not worth keeping
+    NSString *prefix = [event.cameraID stringByAppendingString:@"#"];
+    if (prefix && [detection.trackingID hasPrefix:prefix]) {
+        record.trackID = strtoull([detection.trackingID substringFromIndex:prefix.length].UTF8String, NULL, 10);
+    }
+
+    if (RTSPDetectionRingPush(self.detectionHistory, &record) == UINT64_MAX) {
+        NSLog(@"[ObjectDetector] History is out of class or camera IDs, event not kept");
+    }
+}
+
+/// Events for the newest `limit` records in the history ring. Any thread.
+- (NSArray<RTSPDetectionEvent *> *)historyEvents:(NSUInteger)limit {
+    limit = MIN(limit, (NSUInteger)self.maxHistorySize);
+    if (limit == 0) return @[];
+    NSMutableData *buffer = [NSMutableData dataWithLength:limit * sizeof(RTSPDetectionRecord)];
+    RTSPDetectionRecord *records = buffer.mutableBytes;
+    uint32_t count = RTSPDetectionRingSnapshot(self.detectionHistory, records, (uint32_t)limit);
+
+    // Tables are read after the snapshot, so they name every ID in it
+    NSArray<NSString *> *labels = self.historyLabels.names;
+    NSArray<NSArray<NSString *> *> *cameras = self.historyCameras.names;
+    NSArray<NSArray<NSString *> *> *zoneSets = self.historyZoneSets.names;
+
+    NSMutableArray<RTSPDetectionEvent *> *events = [NSMutableArray arrayWithCapacity:count];
+    for (uint32_t i = 0; i < count; i++) {
+        const RTSPDetectionRecord *record = &records[i];
+        RTSPDetection *detection = [[RTSPDetection alloc] initWithLabel:labels[record->classID]
+                                                              confidence:record->confidence
+                                                             boundingBox:CGRectMake(record->x, record->y, record->width, record->height)];
+        detection.timestamp = [NSDate dateWithTimeIntervalSince1970:record->detectedAt];
+        detection.tracked = (record->flags & RTSPDetectionRecordFlagTracked) != 0;
+
+        NSArray<NSString *> *camera = cameras[record->cameraID];
+        if (record->trackID) {
+            detection.trackingID = [NSString stringWithFormat:@"%@#%llu", camera[0], (unsigned long long)record->trackID];
+        }
+
+        RTSPDetectionEvent *event = [[RTSPDetectionEvent alloc] init];
+        event.cameraID = camera[0];
+        event.cameraName = camera[1];
+        event.detection = detection;
+        event.timestamp = [NSDate dateWithTimeIntervalSince1970:record->timestamp];
+        event.zoneNames = record->zoneSetID < zoneSets.count ? zoneSets[record->zoneSetID] : @[];
+        event.zoneName = event.zoneNames.firstObject;
+        event.alertTriggered = (record->flags & RTSPDetectionRecordFlagAlert) != 0;
+        if (record->mediaSegment) {
+            event.recording = [[RTSPDVRPosition alloc] initWithSegment:record->mediaSegment
+                                                                offset:record->mediaOffset
+                                                             timestamp:record->mediaTime];
+        }
+        [events addObject:event];
+    }
+    return events;
+}
+
 - (NSArray<RTSPDetectionZone *> *)zonesForCamera:(NSString *)cameraID {
     return self.cameraZones[cameraID];
 }
 
 - (void)setZones:(NSArray<RTSPDetectionZone *> *)zones forCamera:(NSString *)cameraID {
-    self.cameraZones[cameraID] = zones;
+    [self storeZones:zones forCamera:cameraID];
     NSLog(@"[ObjectDetector] Set %lu zones for camera %@", (unsigned long)zones.count, cameraID);
 }
 
-- (NSArray<RTSPDetectionEvent *> *)recentEvents:(NSInteger)limit {
-    __block NSArray *events;
-    dispatch_sync(self.eventQueue, ^{
-        NSInteger start = MAX(0, (NSInteger)self.detectionHistory.count - limit);
-        events = [self.detectionHistory subarrayWithRange:NSMakeRange(start, self.detectionHistory.count - start)];
-    });
-    return events;
+/// Keep a camera's zones with their index, and hand them to the tracker
+- (void)storeZones:(nullable NSArray<RTSPDetectionZone *> *)zones forCamera:(NSString *)cameraID {
+    self.cameraZones[cameraID] = zones;
+    self.cameraZoneIndexes[cameraID] = zones ? [[RTSPCameraZoneIndex alloc] initWithZones:zones cameraID:cameraID] : nil;
+    [self updateTrackingZones:zones forCamera:cameraID];
 }
 
-- (NSDictionary *)statistics {
-    __block NSDictionary *stats;
-
-    dispatch_sync(self.eventQueue, ^{
-        // Count detections by class
-        NSMutableDictionary *classCounts = [NSMutableDictionary dictionary];
-        NSMutableDictionary *cameraCounts = [NSMutableDictionary dictionary];
+/// Hand the enabled zones to the processor's tracker for entry, exit and dwell
+- (void)updateTrackingZones:(nullable NSArray<RTSPDetectionZone *> *)zones forCamera:(NSString *)cameraID {
+    NSMutableDictionary<NSString *, id> *shapes = [NSMutableDictionary dictionary];
+    for (RTSPDetectionZone *zone in zones) {
+        if (zone.enabled) {
+            shapes[zone.name] = zone.points ?: [NSValue valueWithRect:NSRectFromCGRect(zone.normalizedRect)];
+        }
+    }
+    [self.mlxProcessor setTrackingZones:shapes forCamera:cameraID];
+}
 
-        for (RTSPDetectionEvent *event in self.detectionHistory) {
-            NSString *label = event.detection.label;
-            classCounts[label] = @([classCounts[label] integerValue] + 1);
+- (NSArray<RTSPDetectionEvent *> *)recentEvents:(NSInteger)limit {
+    return [self historyEvents:(NSUInteger)MAX(limit, 0)];
+}
 
-            NSString *camera = event.cameraName ?: event.cameraID;
-            cameraCounts[camera] = @([cameraCounts[camera] integerValue] + 1);
+- (NSDictionary *)statistics {
+    // Count detections by class and camera from the ring's counters
+    NSMutableDictionary *classCounts = [NSMutableDictionary dictionary];
+    NSMutableDictionary *cameraCounts = [NSMutableDictionary dictionary];
+
+    NSArray<NSString *> *labels = self.historyLabels.names;
+    for (NSUInteger i = 0; i < labels.count; i++) {
+        uint32_t count = RTSPDetectionRingClassCount(self.detectionHistory, (uint16_t)i);
+        if (count > 0) {
+            classCounts[labels[i]] = @(count);
         }
+    }
 
-        // Get MLX performance metrics
-        NSDictionary *mlxMetrics = [self.mlxProcessor performanceMetrics];
-
-        stats = @{
-            @"totalEvents": @(self.detectionHistory.count),
-            @"enabledCameras": @(self.enabledCameras.count),
-            @"detectionsByClass": classCounts,
-            @"detectionsByCamera": cameraCounts,
-            @"mlxPerformance": mlxMetrics,
-            @"historySize": @(self.detectionHistory.count),
-            @"maxHistorySize": @(self.maxHistorySize)
-        };
-    });
+    NSArray<NSArray<NSString *> *> *cameras = self.historyCameras.names;
+    for (NSUInteger i = 0; i < cameras.count; i++) {
+        uint32_t count = RTSPDetectionRingCameraCount(self.detectionHistory, (uint16_t)i);
+        if (count > 0) {
+            NSString *camera = cameras[i][1].length > 0 ? cameras[i][1] : cameras[i][0];
+            cameraCounts[camera] = @([cameraCounts[camera] integerValue] + count);
+        }
+    }
 
-    return stats;
+    // Get MLX performance metrics
+    NSDictionary *mlxMetrics = [self.mlxProcessor performanceMetrics];
+
+    RTSPDetectionRingStats history = RTSPDetectionRingGetStats(self.detectionHistory);
+    return @{
+        @"totalEvents": @(history.count),
+        @"enabledCameras": @(self.enabledCameras.count),
+        @"detectionsByClass": classCounts,
+        @"detectionsByCamera": cameraCounts,
+        @"mlxPerformance": mlxMetrics,
+        @"historySize": @(history.count),
+        @"maxHistorySize": @(self.maxHistorySize)
+    };
 }
 
 - (void)clearHistory {
     dispatch_async(self.eventQueue, ^{
-        [self.detectionHistory removeAllObjects];
+        RTSPDetectionRingClear(self.detectionHistory);
         NSLog(@"[ObjectDetector] Cleared detection history");
     });
 }
 
 - (BOOL)exportEventsToCSV:(NSString *)filePath error:(NSError **)error {
-    __block NSArray *events;
-    dispatch_sync(self.eventQueue, ^{
-        events = [self.detectionHistory copy];
-    });
+    NSArray<RTSPDetectionEvent *> *events = [self historyEvents:(NSUInteger)self.maxHistorySize];
 
     if (events.count == 0) {
         if (error) {
@@ -308,7 +565,7 @@
          det.boundingBox.origin.y,
          det.boundingBox.size.width,
          det.boundingBox.size.height,
-         event.zoneName ?: @"",
+         [event.zoneNames componentsJoinedByString:@";"] ?: @"",
          event.alertTriggered ? @"YES" : @"NO"];
     }
 
@@ -333,6 +590,16 @@
     // This is handled in processFrame completion
 }
 
+- (void)mlxProcessor:(RTSPMLXProcessor *)processor didUpdateTracks:(NSArray<RTSPTrackingEvent *> *)events forCamera:(NSString *)cameraID {
+    // Already on the main queue
+    if ([self.delegate respondsToSelector:@selector(objectDetector:didUpdateTracks:forCamera:)]) {
+        [self.delegate objectDetector:self didUpdateTracks:events forCamera:cameraID];
+    }
+    [[NSNotificationCenter defaultCenter] postNotificationName:RTSPObjectDetectorDidUpdateTracksNotification
+                                                        object:self
+                                                      userInfo:@{@"events": events, @"cameraID": cameraID}];
+}
+
 - (void)mlxProcessor:(RTSPMLXProcessor *)processor didUpdatePerformance:(NSDictionary *)metrics {
     dispatch_async(dispatch_get_main_queue(), ^{
         if ([self.delegate respondsToSelector:@selector(objectDetector:didUpdateStatistics:)]) {
@@ -0,0 +1,562 @@
+//
+//  RTSPProtocol.c
+//  RTSP Rotator
+//
+
+#include "RTSPProtocol.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#pragma mark - Helpers
+
+static void RTSPCopyString(char *destination, size_t size, const char *source, size_t length) {
+    if (size == 0) {
+        return;
+    }
+    if (length >= size) {
+        length = size - 1;
+    }
+    memcpy(destination, source, length);
+    destination[length] = '\0';
+}
+
+static int RTSPHexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static void RTSPPercentDecode(char *destination, size_t size, const char *source, size_t length) {
+    size_t written = 0;
+    for (size_t i = 0; i < length && written + 1 < size; i++) {
+        if (source[i] == '%' && i + 2 < length && RTSPHexValue(source[i + 1]) >= 0 && RTSPHexValue(source[i + 2]) >= 0) {
+            destination[written++] = (char)(RTSPHexValue(source[i + 1]) * 16 + RTSPHexValue(source[i + 2]));
+            i += 2;
+        } else {
+            destination[written++] = source[i];
+        }
+    }
+    destination[written] = '\0';
+}
+
+static const char *RTSPFindLine(const char *text, const char *end) {
+    const char *p = memchr(text, '\n', (size_t)(end - text));
+    return p ? p + 1 : end;
+}
+
+#pragma mark - URLs
+
+bool RTSPURLParse(const char *string, RTSPURL *url) {
+    if (!string || !url) {
+        return false;
+    }
+    memset(url, 0, sizeof(*url));
+
+    const char *schemeEnd = strstr(string, "://");
+    if (!schemeEnd) {
+        return false;
+    }
+    RTSPCopyString(url->scheme, sizeof(url->scheme), string, (size_t)(schemeEnd - string));
+    for (char *c = url->scheme; *c; c++) {
+        *c = (char)tolower((unsigned char)*c);
+    }
+    if (strcmp(url->scheme, "rtsp") == 0) {
+        url->port = 554;
+    } else if (strcmp(url->scheme, "rtsps") == 0) {
+        url->port = 322;
+        url->secure = true;
+    } else {
+        return false;
+    }
+
+    const char *authority = schemeEnd + 3;
+    const char *pathStart = strchr(authority, '/');
+    if (!pathStart) {
+        pathStart = authority + strlen(authority);
+    }
+
+    // Userinfo ends at the last '@' before the path
+    const char *at = NULL;
+    for (const char *p = authority; p < pathStart; p++) {
+        if (*p == '@') {
+            at = p;
+        }
+    }
+    const char *hostStart = authority;
+    if (at) {
+        const char *colon = memchr(authority, ':', (size_t)(at - authority));
+        if (colon) {
+            RTSPPercentDecode(url->user, sizeof(url->user), authority, (size_t)(colon - authority));
+            RTSPPercentDecode(url->password, sizeof(url->password), colon + 1, (size_t)(at - colon - 1));
+        } else {
+            RTSPPercentDecode(url->user, sizeof(url->user), authority, (size_t)(at - authority));
+        }
+        hostStart = at + 1;
+    }
+
+    const char *hostEnd = pathStart;
+    if (*hostStart == '[') {
+        const char *bracket = memchr(hostStart, ']', (size_t)(pathStart - hostStart));
+        if (!bracket) {
+            return false;
+        }
+        RTSPCopyString(url->host, sizeof(url->host), hostStart + 1, (size_t)(bracket - hostStart - 1));
+        hostEnd = bracket + 1;
+    } else {
+        const char *colon = memchr(hostStart, ':', (size_t)(pathStart - hostStart));
+        hostEnd = colon ? colon : pathStart;
+        RTSPCopyString(url->host, sizeof(url->host), hostStart, (size_t)(hostEnd - hostStart));
+    }
+    if (hostEnd < pathStart && *hostEnd == ':') {
+        long port = strtol(hostEnd + 1, NULL, 10);
+        if (port <= 0 || port > 65535) {
+            return false;
+        }
+        url->port = (uint16_t)port;
+    }
+    if (url->host[0] == '\0') {
+        return false;
+    }
+
+    RTSPCopyString(url->path, sizeof(url->path), *pathStart ? pathStart : "/", *pathStart ? strlen(pathStart) : 1);
+    bool ipv6 = strchr(url->host, ':') != NULL;
+    snprintf(url->sanitized, sizeof(url->sanitized), "%s://%s%s%s:%u%s",
+             url->scheme, ipv6 ? "[" : "", url->host, ipv6 ? "]" : "", url->port, url->path);
+    return true;
+}
+
+#pragma mark - Messages
+
+RTSPParseResult RTSPMessageParse(const uint8_t *data, size_t length, RTSPMessage *message, size_t *consumed) {
+    if (length == 0) {
+        return RTSPParseNeedMore;
+    }
+
+    if (data[0] == '$') {
+        if (length < 4) {
+            return RTSPParseNeedMore;
+        }
+        size_t packetLength = ((size_t)data[2] << 8) | data[3];
+        if (length < 4 + packetLength) {
+            return RTSPParseNeedMore;
+        }
+        message->channel = data[1];
+        message->packet = data + 4;
+        message->packetLength = packetLength;
+        *consumed = 4 + packetLength;
+        return RTSPParseInterleaved;
+    }
+
+    // Find the end of the header block
+    size_t headerEnd = 0;
+    for (size_t i = 0; i + 3 < length; i++) {
+        if (data[i] == '\r' && data[i + 1] == '\n' && data[i + 2] == '\r' && data[i + 3] == '\n') {
+            headerEnd = i + 4;
+            break;
+        }
+    }
+    if (headerEnd == 0) {
+        return length > RTSP_MAX_HEADER_BLOCK ? RTSPParseError : RTSPParseNeedMore;
+    }
+    if (headerEnd > RTSP_MAX_HEADER_BLOCK) {
+        return RTSPParseError;
+    }
+
+    const char *text = (const char *)data;
+    const char *end = text + headerEnd;
+    const char *firstLineEnd = RTSPFindLine(text, end);
+
+    message->isRequest = strncmp(text, "RTSP/", 5) != 0;
+    message->statusCode = 0;
+    message->method[0] = '\0';
+    message->uri[0] = '\0';
+    if (message->isRequest) {
+        const char *space = memchr(text, ' ', (size_t)(firstLineEnd - text));
+        if (!space) {
+            return RTSPParseError;
+        }
+        RTSPCopyString(message->method, sizeof(message->method), text, (size_t)(space - text));
+        const char *uriEnd = memchr(space + 1, ' ', (size_t)(firstLineEnd - space - 1));
+        if (!uriEnd) {
+            return RTSPParseError;
+        }
+        RTSPCopyString(message->uri, sizeof(message->uri), space + 1, (size_t)(uriEnd - space - 1));
+    } else {
+        const char *space = memchr(text, ' ', (size_t)(firstLineEnd - text));
+        if (!space) {
+            return RTSPParseError;
+        }
+        message->statusCode = atoi(space + 1);
+    }
+
+    RTSPCopyString(message->headers, sizeof(message->headers), firstLineEnd, (size_t)(end - firstLineEnd));
+
+    char value[64];
+    message->cseq = RTSPMessageHeader(message, "CSeq", value, sizeof(value)) ? atoi(value) : -1;
+
+    size_t contentLength = 0;
+    if (RTSPMessageHeader(message, "Content-Length", value, sizeof(value))) {
+        long parsed = strtol(value, NULL, 10);
+        if (parsed < 0 || parsed > RTSP_MAX_BODY) {
+            return RTSPParseError;
+        }
+        contentLength = (size_t)parsed;
+    }
+    if (length < headerEnd + contentLength) {
+        return RTSPParseNeedMore;
+    }
+    memcpy(message->body, data + headerEnd, contentLength);
+    message->body[contentLength] = '\0';
+    message->bodyLength = contentLength;
+    message->packet = NULL;
+    message->packetLength = 0;
+    *consumed = headerEnd + contentLength;
+    return RTSPParseMessage;
+}
+
+bool RTSPMessageHeader(const RTSPMessage *message, const char *name, char *value, size_t size) {
+    size_t nameLength = strlen(name);
+    const char *line = message->headers;
+    while (*line) {
+        const char *lineEnd = strstr(line, "\r\n");
+        if (!lineEnd) {
+            lineEnd = line + strlen(line);
+        }
+        if ((size_t)(lineEnd - line) > nameLength && line[nameLength] == ':' &&
+            strncasecmp(line, name, nameLength) == 0) {
+            const char *v = line + nameLength + 1;
+            while (v < lineEnd && (*v == ' ' || *v == '\t')) {
+                v++;
+            }
+            RTSPCopyString(value, size, v, (size_t)(lineEnd - v));
+            return true;
+        }
+        line = *lineEnd ? lineEnd + 2 : lineEnd;
+    }
+    return false;
+}
+
+#pragma mark - SDP
+
+static void RTSPSDPFeedParameterSets(const char *list, size_t length, RTSPCodecConfig *config) {
+    const char *p = list;
+    const char *end = list + length;
+    while (p < end) {
+        const char *comma = memchr(p, ',', (size_t)(end - p));
+        const char *itemEnd = comma ? comma : end;
+        uint8_t nal[RTSP_CODEC_MAX_PARAMETER_SET];
+        long decoded = RTSPCodecBase64Decode(p, (size_t)(itemEnd - p), nal, sizeof(nal));
+        if (decoded > 0) {
+            RTSPCodecConfigObserveNAL(config, nal, (size_t)decoded);
+        }
+        p = comma ? comma + 1 : end;
+    }
+}
+
+static void RTSPSDPParseFmtp(const char *parameters, size_t length, RTSPCodecConfig *config) {
+    static const char *keys[] = {"sprop-parameter-sets=", "sprop-vps=", "sprop-sps=", "sprop-pps="};
+    for (size_t k = 0; k < sizeof(keys) / sizeof(keys[0]); k++) {
+        size_t keyLength = strlen(keys[k]);
+        for (const char *p = parameters; p + keyLength <= parameters + length; p++) {
+            if (strncasecmp(p, keys[k], keyLength) == 0 && (p == parameters || p[-1] == ';' || p[-1] == ' ')) {
+                const char *value = p + keyLength;
+                const char *valueEnd = value;
+                while (valueEnd < parameters + length && *valueEnd != ';' && *valueEnd != '\r' && *valueEnd != '\n') {
+                    valueEnd++;
+                }
+                RTSPSDPFeedParameterSets(value, (size_t)(valueEnd - value), config);
+                break;
+            }
+        }
+    }
+}
+
+bool RTSPSDPParseVideoTrack(const char *sdp, RTSPSDPVideoTrack *track, RTSPCodecConfig *config) {
+    if (!sdp || !track) {
+        return false;
+    }
+    memset(track, 0, sizeof(*track));
+    track->payloadType = -1;
+
+    bool inVideo = false;
+    bool found = false;
+    const char *line = sdp;
+    const char *end = sdp + strlen(sdp);
+
+    while (line < end) {
+        const char *next = RTSPFindLine(line, end);
+        size_t lineLength = (size_t)(next - line);
+        while (lineLength > 0 && (line[lineLength - 1] == '\n' || line[lineLength - 1] == '\r')) {
+            lineLength--;
+        }
+
+        if (strncmp(line, "m=", 2) == 0) {
+            if (found) {
+                break; // Only the first video track
+            }
+            inVideo = strncmp(line, "m=video", 7) == 0;
+            if (inVideo) {
+                // m=video 0 RTP/AVP 96
+                const char *last = line + lineLength;
+                const char *pt = last;
+                while (pt > line && pt[-1] != ' ') {
+                    pt--;
+                }
+                track->payloadType = atoi(pt);
+            }
+        } else if (inVideo && strncmp(line, "a=rtpmap:", 9) == 0) {
+            int pt = atoi(line + 9);
+            const char *encoding = memchr(line, ' ', lineLength);
+            if (encoding && pt == track->payloadType) {
+                encoding++;
+                if (strncasecmp(encoding, "H264/", 5) == 0) {
+                    track->codec = RTSPVideoCodecH264;
+                    track->clockRate = (uint32_t)atoi(encoding + 5);
+                } else if (strncasecmp(encoding, "H265/", 5) == 0 || strncasecmp(encoding, "HEVC/", 5) == 0) {
+                    track->codec = RTSPVideoCodecH265;
+                    track->clockRate = (uint32_t)atoi(encoding + 5);
+                }
+                if (track->codec != RTSPVideoCodecUnknown && config) {
+                    RTSPCodecConfig fresh;
+                    RTSPCodecConfigInit(&fresh, track->codec);
+                    *config = fresh;
+                }
+                found = track->codec != RTSPVideoCodecUnknown;
+            }
+        } else if (inVideo && strncmp(line, "a=fmtp:", 7) == 0 && config) {
+            const char *parameters = memchr(line, ' ', lineLength);
+            if (parameters && track->codec != RTSPVideoCodecUnknown) {
+                RTSPSDPParseFmtp(parameters + 1, (size_t)(line + lineLength - parameters - 1), config);
+            }
+        } else if (inVideo && strncmp(line, "a=control:", 10) == 0) {
+            RTSPCopyString(track->control, sizeof(track->control), line + 10, lineLength - 10);
+        }
+
+        line = next;
+    }
+
+    if (found && track->clockRate == 0) {
+        track->clockRate = 90000;
+    }
+    return found;
+}
+
+void RTSPResolveControlURL(const char *base, const char *control, char *output, size_t size) {
+    if (!control || control[0] == '\0' || strcmp(control, "*") == 0) {
+        snprintf(output, size, "%s", base);
+    } else if (strstr(control, "://")) {
+        snprintf(output, size, "%s", control);
+    } else {
+        size_t baseLength = strlen(base);
+        bool slash = baseLength > 0 && base[baseLength - 1] == '/';
+        snprintf(output, size, "%s%s%s", base, slash ? "" : "/", control);
+    }
+}
+
+#pragma mark - MD5
+
+typedef struct {
+    uint32_t state[4];
+    uint64_t length;
+    uint8_t block[64];
+    size_t blockLength;
+} RTSPMD5Context;
+
+#define RTSP_MD5_ROTATE(x, c) (((x) << (c)) | ((x) >> (32 - (c))))
+
+static void RTSPMD5Transform(uint32_t state[4], const uint8_t block[64]) {
+    static const uint32_t k[64] = {
+        0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+        0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+        0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+        0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+        0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+        0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+        0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+        0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+    };
+    static const uint8_t r[64] = {
+        7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+        5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20,
+        4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+        6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21
+    };
+
+    uint32_t w[16];
+    for (int i = 0; i < 16; i++) {
+        w[i] = (uint32_t)block[i * 4] | ((uint32_t)block[i * 4 + 1] << 8) |
+               ((uint32_t)block[i * 4 + 2] << 16) | ((uint32_t)block[i * 4 + 3] << 24);
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    for (int i = 0; i < 64; i++) {
+        uint32_t f;
+        int g;
+        if (i < 16) {
+            f = (b & c) | (~b & d);
+            g = i;
+        } else if (i < 32) {
+            f = (d & b) | (~d & c);
+            g = (5 * i + 1) % 16;
+        } else if (i < 48) {
+            f = b ^ c ^ d;
+            g = (3 * i + 5) % 16;
+        } else {
+            f = c ^ (b | ~d);
+            g = (7 * i) % 16;
+        }
+        uint32_t temp = d;
+        d = c;
+        c = b;
+        b = b + RTSP_MD5_ROTATE(a + f + k[i] + w[g], r[i]);
+        a = temp;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+}
+
+static void RTSPMD5Update(RTSPMD5Context *ctx, const uint8_t *data, size_t length) {
+    ctx->length += length;
+    while (length > 0) {
+        size_t take = 64 - ctx->blockLength;
+        if (take > length) {
+            take = length;
+        }
+        memcpy(ctx->block + ctx->blockLength, data, take);
+        ctx->blockLength += take;
+        data += take;
+        length -= take;
+        if (ctx->blockLength == 64) {
+            RTSPMD5Transform(ctx->state, ctx->block);
+            ctx->blockLength = 0;
+        }
+    }
+}
+
+void RTSPMD5Hex(const void *data, size_t length, char output[33]) {
+    RTSPMD5Context ctx = {{0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476}, 0, {0}, 0};
+    RTSPMD5Update(&ctx, data, length);
+
+    uint64_t bits = ctx.length * 8;
+    uint8_t padding = 0x80;
+    RTSPMD5Update(&ctx, &padding, 1);
+    uint8_t zero = 0;
+    while (ctx.blockLength != 56) {
+        RTSPMD5Update(&ctx, &zero, 1);
+    }
+    uint8_t lengthBytes[8];
+    for (int i = 0; i < 8; i++) {
+        lengthBytes[i] = (uint8_t)(bits >> (8 * i));
+    }
+    RTSPMD5Update(&ctx, lengthBytes, 8);
+
+    static const char hex[] = "0123456789abcdef";
+    for (int i = 0; i < 16; i++) {
+        uint8_t byte = (uint8_t)(ctx.state[i / 4] >> (8 * (i % 4)));
+        output[i * 2] = hex[byte >> 4];
+        output[i * 2 + 1] = hex[byte & 0x0F];
+    }
+    output[32] = '\0';
+}
+
+#pragma mark - Authentication
+
+static bool RTSPAuthParameter(const char *header, const char *name, char *value, size_t size) {
+    size_t nameLength = strlen(name);
+    for (const char *p = header; *p; p++) {
+        if (strncasecmp(p, name, nameLength) == 0 && p[nameLength] == '=' &&
+            (p == header || p[-1] == ' ' || p[-1] == ',')) {
+            const char *v = p + nameLength + 1;
+            if (*v == '"') {
+                const char *close = strchr(v + 1, '"');
+                if (!close) {
+                    return false;
+                }
+                RTSPCopyString(value, size, v + 1, (size_t)(close - v - 1));
+            } else {
+                const char *close = v;
+                while (*close && *close != ',' && *close != ' ') {
+                    close++;
+                }
+                RTSPCopyString(value, size, v, (size_t)(close - v));
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+bool RTSPAuthParseChallenge(const char *header, RTSPAuthChallenge *challenge) {
+    memset(challenge, 0, sizeof(*challenge));
+    if (!header) {
+        return false;
+    }
+    if (strncasecmp(header, "Digest", 6) == 0) {
+        challenge->digest = true;
+        RTSPAuthParameter(header + 6, "realm", challenge->realm, sizeof(challenge->realm));
+        RTSPAuthParameter(header + 6, "opaque", challenge->opaque, sizeof(challenge->opaque));
+        challenge->valid = RTSPAuthParameter(header + 6, "nonce", challenge->nonce, sizeof(challenge->nonce));
+    } else if (strncasecmp(header, "Basic", 5) == 0) {
+        RTSPAuthParameter(header + 5, "realm", challenge->realm, sizeof(challenge->realm));
+        challenge->valid = true;
+    }
+    return challenge->valid;
+}
+
+static void RTSPBase64Encode(const uint8_t *input, size_t length, char *output, size_t size) {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t written = 0;
+    for (size_t i = 0; i < length && written + 5 < size; i += 3) {
+        uint32_t chunk = (uint32_t)input[i] << 16;
+        if (i + 1 < length) chunk |= (uint32_t)input[i + 1] << 8;
+        if (i + 2 < length) chunk |= input[i + 2];
+        output[written++] = alphabet[(chunk >> 18) & 0x3F];
+        output[written++] = alphabet[(chunk >> 12) & 0x3F];
+        output[written++] = i + 1 < length ? alphabet[(chunk >> 6) & 0x3F] : '=';
+        output[written++] = i + 2 < length ? alphabet[chunk & 0x3F] : '=';
+    }
+    output[written] = '\0';
+}
+
+bool RTSPAuthBuildHeader(const RTSPAuthChallenge *challenge,
+                         const char *user, const char *password,
+                         const char *method, const char *uri,
+                         char *output, size_t size) {
+    if (!challenge || !challenge->valid || !user || !password) {
+        return false;
+    }
+
+    char scratch[768];
+    if (!challenge->digest) {
+        int n = snprintf(scratch, sizeof(scratch), "%s:%s", user, password);
+        if (n < 0 || (size_t)n >= sizeof(scratch)) {
+            return false;
+        }
+        char encoded[1100];
+        RTSPBase64Encode((const uint8_t *)scratch, (size_t)n, encoded, sizeof(encoded));
+        return (size_t)snprintf(output, size, "Basic %s", encoded) < size;
+    }
+
+    char ha1[33], ha2[33], response[33];
+    int n = snprintf(scratch, sizeof(scratch), "%s:%s:%s", user, challenge->realm, password);
+    RTSPMD5Hex(scratch, (size_t)n, ha1);
+    n = snprintf(scratch, sizeof(scratch), "%s:%s", method, uri);
+    RTSPMD5Hex(scratch, (size_t)n, ha2);
+    n = snprintf(scratch, sizeof(scratch), "%s:%s:%s", ha1, challenge->nonce, ha2);
+    RTSPMD5Hex(scratch, (size_t)n, response);
+
+    int written = snprintf(output, size,
+                           "Digest username=\"%s\", realm=\"%s\", nonce=\"%s\", uri=\"%s\", response=\"%s\"%s%s%s",
+                           user, challenge->realm, challenge->nonce, uri, response,
+                           challenge->opaque[0] ? ", opaque=\"" : "",
+                           challenge->opaque,
+                           challenge->opaque[0] ? "\"" : "");
+    return written > 0 && (size_t)written < size;
+}
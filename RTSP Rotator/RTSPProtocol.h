@@ -0,0 +1,112 @@
+//
+//  RTSPProtocol.h
+//  RTSP Rotator
+//
+//  Portable RTSP/1.0 protocol helpers: URL parsing, incremental message
+//  framing (including '$' interleaved RTP), SDP video track parsing and
+//  Basic / Digest authentication. No I/O - callers own the sockets.
+//
+
+#ifndef RTSPProtocol_h
+#define RTSPProtocol_h
+
+#include "RTSPCodecConfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#pragma mark - URLs
+
+typedef struct {
+    char scheme[8];             // "rtsp" or "rtsps"
+    char host[256];
+    uint16_t port;
+    char user[128];             // Percent-decoded
+    char password[128];         // Percent-decoded
+    char path[1024];            // Path + query, starts with '/'
+    char sanitized[1536];       // URL without userinfo, used on the wire
+    bool secure;
+} RTSPURL;
+
+/// Parse an rtsp:// or rtsps:// URL. Default ports: 554 (rtsp), 322 (rtsps).
+bool RTSPURLParse(const char *string, RTSPURL *url);
+
+#pragma mark - Messages
+
+typedef enum {
+    RTSPParseNeedMore = 0,
+    RTSPParseMessage,           // A request or response was parsed
+    RTSPParseInterleaved,       // A '$' framed binary packet was parsed
+    RTSPParseError
+} RTSPParseResult;
+
+#define RTSP_MAX_HEADER_BLOCK 8192
+#define RTSP_MAX_BODY 32768
+
+typedef struct {
+    bool isRequest;
+    char method[32];            // Requests
+    char uri[1024];             // Requests
+    int statusCode;             // Responses
+    int cseq;
+    char headers[RTSP_MAX_HEADER_BLOCK];  // Raw header lines, NUL terminated
+    char body[RTSP_MAX_BODY + 1];
+    size_t bodyLength;
+
+    // Interleaved packets point into the caller's buffer
+    uint8_t channel;
+    const uint8_t *packet;
+    size_t packetLength;
+} RTSPMessage;
+
+/// Try to parse one message from the front of `data`. On success
+/// `consumed` is the number of bytes to drop.
+RTSPParseResult RTSPMessageParse(const uint8_t *data, size_t length, RTSPMessage *message, size_t *consumed);
+
+/// Copy a header value (case-insensitive name). Returns false if absent.
+bool RTSPMessageHeader(const RTSPMessage *message, const char *name, char *value, size_t size);
+
+#pragma mark - SDP
+
+typedef struct {
+    RTSPVideoCodec codec;
+    int payloadType;
+    uint32_t clockRate;
+    char control[512];          // Track control attribute (may be relative)
+} RTSPSDPVideoTrack;
+
+/// Find the first H.264/H.265 video track. Out-of-band parameter sets
+/// (sprop-parameter-sets / sprop-vps/sps/pps) are fed into `config`.
+bool RTSPSDPParseVideoTrack(const char *sdp, RTSPSDPVideoTrack *track, RTSPCodecConfig *config);
+
+/// Resolve a track control attribute against the content base
+void RTSPResolveControlURL(const char *base, const char *control, char *output, size_t size);
+
+#pragma mark - Authentication
+
+typedef struct {
+    bool digest;
+    char realm[128];
+    char nonce[128];
+    char opaque[128];
+    bool valid;
+} RTSPAuthChallenge;
+
+/// Parse a WWW-Authenticate header (Digest preferred over Basic)
+bool RTSPAuthParseChallenge(const char *header, RTSPAuthChallenge *challenge);
+
+/// Build an Authorization header value for a request
+bool RTSPAuthBuildHeader(const RTSPAuthChallenge *challenge,
+                         const char *user, const char *password,
+                         const char *method, const char *uri,
+                         char *output, size_t size);
+
+/// Hex MD5 (33 bytes including terminator)
+void RTSPMD5Hex(const void *data, size_t length, char output[33]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RTSPProtocol_h */
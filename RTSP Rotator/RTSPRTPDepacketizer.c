@@ -0,0 +1,276 @@
+//
+//  RTSPRTPDepacketizer.c
+//  RTSP Rotator
+//
+
+#include "RTSPRTPDepacketizer.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+struct RTSPRTPDepacketizer {
+    RTSPCodecConfig *config;
+    RTSPAccessUnitCallback callback;
+    void *context;
+
+    RTSPByteBuffer unit;
+    uint64_t unitTimestamp;
+    bool unitOpen;
+    bool unitKeyframe;
+    bool unitCorrupted;
+    bool needKeyframe;
+
+    size_t fragmentOffset;      // Offset of the length prefix of the open fragmented NAL
+    bool inFragment;
+
+    bool haveSequence;
+    uint16_t expectedSequence;
+    bool haveTimestamp;
+    uint64_t lastTimestamp;
+
+    RTSPRTPStatistics stats;
+};
+
+RTSPRTPDepacketizerRef RTSPRTPDepacketizerCreate(RTSPCodecConfig *config,
+                                                 RTSPAccessUnitCallback callback,
+                                                 void *context) {
+    if (!config || !callback) {
+        return NULL;
+    }
+    RTSPRTPDepacketizerRef depacketizer = calloc(1, sizeof(*depacketizer));
+    if (!depacketizer) {
+        return NULL;
+    }
+    depacketizer->config = config;
+    depacketizer->callback = callback;
+    depacketizer->context = context;
+    depacketizer->needKeyframe = true;
+    RTSPByteBufferInit(&depacketizer->unit);
+    return depacketizer;
+}
+
+void RTSPRTPDepacketizerRelease(RTSPRTPDepacketizerRef depacketizer) {
+    if (!depacketizer) {
+        return;
+    }
+    RTSPByteBufferFree(&depacketizer->unit);
+    free(depacketizer);
+}
+
+RTSPRTPStatistics RTSPRTPDepacketizerGetStatistics(RTSPRTPDepacketizerRef depacketizer) {
+    RTSPRTPStatistics empty = {0};
+    return depacketizer ? depacketizer->stats : empty;
+}
+
+#pragma mark - Access Units
+
+static void RTSPDepacketizerFlush(RTSPRTPDepacketizerRef d) {
+    if (!d->unitOpen) {
+        return;
+    }
+
+    bool deliver = d->unit.length > 0 && !d->unitCorrupted && !d->inFragment && !d->unit.failed;
+    if (deliver && d->needKeyframe) {
+        deliver = d->unitKeyframe && RTSPCodecConfigIsComplete(d->config);
+    }
+
+    if (deliver) {
+        d->needKeyframe = false;
+        RTSPAccessUnit unit = {
+            .data = d->unit.data,
+            .length = d->unit.length,
+            .timestamp = d->unitTimestamp,
+            .keyframe = d->unitKeyframe,
+            .configGeneration = d->config->generation,
+        };
+        d->stats.accessUnits++;
+        d->callback(d->context, &unit);
+    } else if (d->unit.length > 0 || d->unitCorrupted) {
+        d->stats.droppedUnits++;
+        if (d->unitCorrupted) {
+            d->needKeyframe = true;
+        }
+    }
+
+    RTSPByteBufferReset(&d->unit);
+    d->unitOpen = false;
+    d->unitKeyframe = false;
+    d->unitCorrupted = false;
+    d->inFragment = false;
+}
+
+static void RTSPDepacketizerAppendNAL(RTSPRTPDepacketizerRef d, const uint8_t *nal, size_t length) {
+    if (length == 0) {
+        return;
+    }
+    int type = RTSPCodecNALType(d->config->codec, nal, length);
+    if (RTSPCodecNALIsConfig(d->config->codec, type)) {
+        RTSPCodecConfigObserveNAL(d->config, nal, length);
+        return;
+    }
+    if (RTSPCodecNALIsKeyframe(d->config->codec, type)) {
+        d->unitKeyframe = true;
+    }
+    RTSPByteBufferAppendU32(&d->unit, (uint32_t)length);
+    RTSPByteBufferAppend(&d->unit, nal, length);
+}
+
+static void RTSPDepacketizerAggregate(RTSPRTPDepacketizerRef d, const uint8_t *payload, size_t length, size_t headerLength) {
+    size_t offset = headerLength;
+    while (offset + 2 <= length) {
+        size_t size = ((size_t)payload[offset] << 8) | payload[offset + 1];
+        offset += 2;
+        if (size == 0 || offset + size > length) {
+            d->unitCorrupted = true;
+            return;
+        }
+        RTSPDepacketizerAppendNAL(d, payload + offset, size);
+        offset += size;
+    }
+}
+
+static void RTSPDepacketizerFragment(RTSPRTPDepacketizerRef d, const uint8_t *header, size_t headerLength,
+                                     int nalType, bool start, bool end,
+                                     const uint8_t *data, size_t length) {
+    if (start) {
+        if (d->inFragment) {
+            d->unitCorrupted = true;
+        }
+        if (RTSPCodecNALIsKeyframe(d->config->codec, nalType)) {
+            d->unitKeyframe = true;
+        }
+        d->fragmentOffset = d->unit.length;
+        d->inFragment = true;
+        RTSPByteBufferAppendU32(&d->unit, 0);
+        RTSPByteBufferAppend(&d->unit, header, headerLength);
+    } else if (!d->inFragment) {
+        // Lost the start of this NAL unit
+        d->unitCorrupted = true;
+        return;
+    }
+
+    RTSPByteBufferAppend(&d->unit, data, length);
+
+    if (end) {
+        size_t nalLength = d->unit.length - d->fragmentOffset - 4;
+        RTSPByteBufferPatchU32(&d->unit, d->fragmentOffset, (uint32_t)nalLength);
+        d->inFragment = false;
+
+        // Parameter sets are occasionally fragmented; pull them back out
+        const uint8_t *nal = d->unit.data + d->fragmentOffset + 4;
+        if (RTSPCodecNALIsConfig(d->config->codec, nalType)) {
+            RTSPCodecConfigObserveNAL(d->config, nal, nalLength);
+            d->unit.length = d->fragmentOffset;
+        }
+    }
+}
+
+static void RTSPDepacketizerPayloadH264(RTSPRTPDepacketizerRef d, const uint8_t *payload, size_t length) {
+    int type = payload[0] & 0x1F;
+    if (type >= 1 && type <= 23) {
+        RTSPDepacketizerAppendNAL(d, payload, length);
+    } else if (type == 24) {            // STAP-A
+        RTSPDepacketizerAggregate(d, payload, length, 1);
+    } else if (type == 28 && length > 2) { // FU-A
+        uint8_t fuHeader = payload[1];
+        uint8_t nalHeader = (payload[0] & 0xE0) | (fuHeader & 0x1F);
+        RTSPDepacketizerFragment(d, &nalHeader, 1, fuHeader & 0x1F,
+                                 (fuHeader & 0x80) != 0, (fuHeader & 0x40) != 0,
+                                 payload + 2, length - 2);
+    }
+}
+
+static void RTSPDepacketizerPayloadH265(RTSPRTPDepacketizerRef d, const uint8_t *payload, size_t length) {
+    if (length < 3) {
+        return;
+    }
+    int type = (payload[0] >> 1) & 0x3F;
+    if (type < 48) {
+        RTSPDepacketizerAppendNAL(d, payload, length);
+    } else if (type == 48) {            // Aggregation packet
+        RTSPDepacketizerAggregate(d, payload, length, 2);
+    } else if (type == 49 && length > 3) { // Fragmentation unit
+        uint8_t fuHeader = payload[2];
+        int fuType = fuHeader & 0x3F;
+        uint8_t nalHeader[2] = {(uint8_t)((payload[0] & 0x81) | (fuType << 1)), payload[1]};
+        RTSPDepacketizerFragment(d, nalHeader, 2, fuType,
+                                 (fuHeader & 0x80) != 0, (fuHeader & 0x40) != 0,
+                                 payload + 3, length - 3);
+    }
+}
+
+#pragma mark - Packets
+
+void RTSPRTPDepacketizerPush(RTSPRTPDepacketizerRef d, const uint8_t *packet, size_t length) {
+    if (!d || !packet || length < 12 || (packet[0] >> 6) != 2) {
+        return;
+    }
+
+    size_t headerLength = 12 + 4 * (size_t)(packet[0] & 0x0F);
+    if (packet[0] & 0x10) {
+        if (length < headerLength + 4) {
+            return;
+        }
+        size_t extensionWords = ((size_t)packet[headerLength + 2] << 8) | packet[headerLength + 3];
+        headerLength += 4 + extensionWords * 4;
+    }
+    size_t payloadLength = length > headerLength ? length - headerLength : 0;
+    if ((packet[0] & 0x20) && payloadLength > 0) {
+        size_t padding = packet[length - 1];
+        payloadLength = padding <= payloadLength ? payloadLength - padding : 0;
+    }
+    if (payloadLength == 0) {
+        return;
+    }
+
+    bool marker = (packet[1] & 0x80) != 0;
+    uint16_t sequence = (uint16_t)((packet[2] << 8) | packet[3]);
+    uint32_t timestamp32 = ((uint32_t)packet[4] << 24) | ((uint32_t)packet[5] << 16) |
+                           ((uint32_t)packet[6] << 8) | packet[7];
+
+    d->stats.packets++;
+    d->stats.bytes += length;
+
+    if (d->haveSequence && sequence != d->expectedSequence) {
+        uint16_t gap = (uint16_t)(sequence - d->expectedSequence);
+        if (gap < 0x8000) {
+            d->stats.lostPackets += gap;
+            d->unitCorrupted = d->unitOpen;
+            d->needKeyframe = true;
+        } else {
+            return; // Late or duplicate packet
+        }
+    }
+    d->haveSequence = true;
+    d->expectedSequence = (uint16_t)(sequence + 1);
+
+    // Unwrap the 32-bit timestamp
+    uint64_t timestamp;
+    if (!d->haveTimestamp) {
+        timestamp = timestamp32;
+        d->haveTimestamp = true;
+    } else {
+        int32_t delta = (int32_t)(timestamp32 - (uint32_t)d->lastTimestamp);
+        timestamp = (uint64_t)((int64_t)d->lastTimestamp + delta);
+    }
+    d->lastTimestamp = timestamp;
+
+    if (d->unitOpen && timestamp != d->unitTimestamp) {
+        RTSPDepacketizerFlush(d);
+    }
+    if (!d->unitOpen) {
+        d->unitOpen = true;
+        d->unitTimestamp = timestamp;
+    }
+
+    const uint8_t *payload = packet + headerLength;
+    if (d->config->codec == RTSPVideoCodecH265) {
+        RTSPDepacketizerPayloadH265(d, payload, payloadLength);
+    } else {
+        RTSPDepacketizerPayloadH264(d, payload, payloadLength);
+    }
+
+    if (marker) {
+        RTSPDepacketizerFlush(d);
+    }
+}
@@ -0,0 +1,54 @@
+//
+//  RTSPRTPDepacketizer.h
+//  RTSP Rotator
+//
+//  Reassembles H.264 (RFC 6184) and H.265 (RFC 7798) RTP payloads into
+//  access units in length-prefixed (AVCC / HVCC) form, ready to be copied
+//  into fMP4 samples without re-encoding.
+//
+
+#ifndef RTSPRTPDepacketizer_h
+#define RTSPRTPDepacketizer_h
+
+#include "RTSPCodecConfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    const uint8_t *data;        // 4-byte big-endian length prefixed NAL units
+    size_t length;
+    uint64_t timestamp;         // RTP timestamp, unwrapped to 64 bits (90 kHz)
+    bool keyframe;
+    uint32_t configGeneration;  // RTSPCodecConfig.generation when the unit completed
+} RTSPAccessUnit;
+
+typedef void (*RTSPAccessUnitCallback)(void *context, const RTSPAccessUnit *unit);
+
+typedef struct {
+    uint64_t packets;
+    uint64_t bytes;
+    uint64_t lostPackets;
+    uint64_t accessUnits;
+    uint64_t droppedUnits;      // Discarded after loss until the next keyframe
+} RTSPRTPStatistics;
+
+typedef struct RTSPRTPDepacketizer *RTSPRTPDepacketizerRef;
+
+/// `config` is updated in place as parameter sets arrive and must outlive the depacketizer
+RTSPRTPDepacketizerRef RTSPRTPDepacketizerCreate(RTSPCodecConfig *config,
+                                                 RTSPAccessUnitCallback callback,
+                                                 void *context);
+void RTSPRTPDepacketizerRelease(RTSPRTPDepacketizerRef depacketizer);
+
+/// Push one complete RTP packet (12 byte header onwards)
+void RTSPRTPDepacketizerPush(RTSPRTPDepacketizerRef depacketizer, const uint8_t *packet, size_t length);
+
+RTSPRTPStatistics RTSPRTPDepacketizerGetStatistics(RTSPRTPDepacketizerRef depacketizer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RTSPRTPDepacketizer_h */
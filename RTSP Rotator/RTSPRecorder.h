@@ -23,13 +23,13 @@ NS_ASSUME_NONNULL_BEGIN
 /// @param completion Completion handler with image or error
 - (void)takeSnapshotWithCompletion:(void (^)(NSImage * _Nullable image, NSError * _Nullable error))completion;
 
-/// Save snapshot to file
-/// @param filePath Destination file path
+/// Save snapshot to file, encoded and written off the main thread
+/// @param filePath Destination file path; .jpg, .heic or .png
 /// @param completion Completion handler with success status
 - (void)saveSnapshotToFile:(NSString *)filePath
                 completion:(void (^)(BOOL success, NSError * _Nullable error))completion;
 
-/// Take and save snapshot with auto-generated filename
+/// Take and save snapshot (JPEG) with auto-generated filename
 /// @param directory Directory to save snapshot
 /// @param completion Completion handler with file path or error
 - (void)autoSaveSnapshotToDirectory:(NSString *)directory
@@ -37,8 +37,12 @@ NS_ASSUME_NONNULL_BEGIN
 
 #pragma mark - Recording
 
-/// Start recording current stream
-/// @param filePath Output file path
+/// Start recording the current stream to a fragmented MP4 file. The
+/// camera's H.264 / H.265 is copied as sent, without re-encoding, so this
+/// needs a stream remuxed by RTSPFFmpegProxy. Recording stays with that
+/// camera until stopped, even if the player moves on. Main thread;
+/// isRecording is YES as soon as this returns, until the recording ends.
+/// @param filePath Output file path (.mp4)
 /// @param completion Completion handler with success status
 - (void)startRecordingToFile:(NSString *)filePath
                   completion:(void (^)(BOOL success, NSError * _Nullable error))completion;
@@ -46,6 +50,14 @@ NS_ASSUME_NONNULL_BEGIN
 /// Stop current recording
 - (void)stopRecording;
 
+/// Record a motion or alert clip of the current stream: the proxy's
+/// pre-roll (the seconds before the call), then its post-roll. Calling
+/// again while the clip runs extends it.
+/// @param filePath Output file path (.mp4)
+/// @param completion Called once the clip's file is closed, with its path or an error
+- (void)recordClipToFile:(NSString *)filePath
+              completion:(nullable void (^)(NSString * _Nullable filePath, NSError * _Nullable error))completion;
+
 /// Whether currently recording
 @property (nonatomic, assign, readonly) BOOL isRecording;
 
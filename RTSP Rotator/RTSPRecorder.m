@@ -7,17 +7,19 @@
 
 #import "RTSPRecorder.h"
 #import <AVKit/AVKit.h>
+#import "RTSPFrameBus.h"
+#import "RTSPFFmpegProxy.h"
+#import "RTSPSnapshotService.h"
 
 @interface RTSPRecorder ()
 @property (nonatomic, weak) AVPlayer *player;
 @property (nonatomic, strong) AVPlayerLayer *playerLayer;
 @property (nonatomic, strong) NSTimer *snapshotTimer;
 @property (nonatomic, strong) NSString *snapshotDirectory;
+@property (nonatomic, assign) BOOL scheduledSnapshotInFlight;
 @property (nonatomic, strong) NSDate *recordingStartTime;
 @property (nonatomic, strong) NSString *recordingFilePath;
-@property (nonatomic, strong) AVAssetWriter *assetWriter;
-@property (nonatomic, strong) AVAssetWriterInput *videoInput;
-@property (nonatomic, strong) AVAssetWriterInputPixelBufferAdaptor *pixelBufferAdaptor;
+@property (nonatomic, strong) NSURL *recordingURL;          // Stream being recorded, as the proxy knows it
 @end
 
 @implementation RTSPRecorder
@@ -45,92 +47,52 @@
         return;
     }
 
-    dispatch_async(dispatch_get_main_queue(), ^{
-        // Get current time
-        CMTime currentTime = self.player.currentTime;
+    if (!self.player.currentItem) {
+        NSError *error = [NSError errorWithDomain:@"RTSPRecorder"
+                                             code:1002
+                                         userInfo:@{NSLocalizedDescriptionKey: @"No current player item"}];
+        if (completion) completion(nil, error);
+        return;
+    }
 
-        // Create asset from current item
-        AVPlayerItem *currentItem = self.player.currentItem;
-        if (!currentItem) {
+    // Reuse the frame already decoded for display rather than seeking a new decoder
+    [[RTSPFrameBus busForPlayer:self.player] requestFrameWithMaximumAge:0.5 completion:^(RTSPDecodedFrame *frame) {
+        CGImageRef imageRef = [frame copyCGImage];
+        if (imageRef) {
+            NSImage *image = [[NSImage alloc] initWithCGImage:imageRef size:NSZeroSize];
+            CGImageRelease(imageRef);
+            NSLog(@"[INFO] Snapshot taken successfully");
+            if (completion) completion(image, nil);
+        } else {
             NSError *error = [NSError errorWithDomain:@"RTSPRecorder"
-                                                 code:1002
-                                             userInfo:@{NSLocalizedDescriptionKey: @"No current player item"}];
+                                                 code:1003
+                                             userInfo:@{NSLocalizedDescriptionKey: @"No decoded frame available"}];
+            NSLog(@"[ERROR] Failed to capture snapshot: %@", error.localizedDescription);
             if (completion) completion(nil, error);
-            return;
         }
-
-        AVAsset *asset = currentItem.asset;
-        AVAssetImageGenerator *generator = [AVAssetImageGenerator assetImageGeneratorWithAsset:asset];
-        generator.appliesPreferredTrackTransform = YES;
-        generator.requestedTimeToleranceBefore = kCMTimeZero;
-        generator.requestedTimeToleranceAfter = kCMTimeZero;
-
-        // Use modern async API
-        if (@available(macOS 13.0, *)) {
-            [generator generateCGImageAsynchronouslyForTime:currentTime completionHandler:^(CGImageRef _Nullable imageRef, CMTime actualTime, NSError * _Nullable error) {
-                if (imageRef) {
-                    NSImage *image = [[NSImage alloc] initWithCGImage:imageRef size:NSZeroSize];
-                    NSLog(@"[INFO] Snapshot taken successfully");
-                    if (completion) completion(image, nil);
-                } else {
-                    NSLog(@"[ERROR] Failed to capture snapshot: %@", error.localizedDescription);
-                    if (completion) completion(nil, error);
-                }
-            }];
-        } else {
-            // Fallback for macOS 11.0-14.x: use synchronous API
-            NSError *error = nil;
-            #pragma clang diagnostic push
-            #pragma clang diagnostic ignored "-Wdeprecated-declarations"
-            CGImageRef imageRef = [generator copyCGImageAtTime:currentTime actualTime:NULL error:&error];
-            #pragma clang diagnostic pop
-            if (imageRef) {
-                NSImage *image = [[NSImage alloc] initWithCGImage:imageRef size:NSZeroSize];
-                CGImageRelease(imageRef);
-                NSLog(@"[INFO] Snapshot taken successfully");
-                if (completion) completion(image, nil);
-            } else {
-                NSLog(@"[ERROR] Failed to capture snapshot: %@", error.localizedDescription);
-                if (completion) completion(nil, error);
-            }
-        }
-    });
+    }];
 }
 
 - (void)saveSnapshotToFile:(NSString *)filePath completion:(void (^)(BOOL, NSError * _Nullable))completion {
-    [self takeSnapshotWithCompletion:^(NSImage *image, NSError *error) {
-        if (error || !image) {
+    if (!self.player.currentItem) {
+        NSError *error = [NSError errorWithDomain:@"RTSPRecorder"
+                                             code:1002
+                                         userInfo:@{NSLocalizedDescriptionKey: @"No current player item"}];
+        if (completion) completion(NO, error);
+        return;
+    }
+
+    // Encoded from the decoded frame and written off the main thread
+    [[RTSPSnapshotService sharedService] saveSnapshotOfPlayer:self.player
+                                                       toFile:filePath
+                                                   completion:^(NSString *savedPath, NSError *error) {
+        if (savedPath) {
+            NSLog(@"[INFO] Snapshot saved to: %@", savedPath);
+            if (completion) completion(YES, nil);
+        } else {
+            NSLog(@"[ERROR] Failed to save snapshot to: %@", filePath);
             if (completion) completion(NO, error);
-            return;
         }
-
-        dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
-            // Ensure directory exists
-            NSString *directory = [filePath stringByDeletingLastPathComponent];
-            [[NSFileManager defaultManager] createDirectoryAtPath:directory
-                                      withIntermediateDirectories:YES
-                                                       attributes:nil
-                                                            error:nil];
-
-            // Convert NSImage to PNG data
-            CGImageRef cgImage = [image CGImageForProposedRect:NULL context:nil hints:nil];
-            NSBitmapImageRep *bitmapRep = [[NSBitmapImageRep alloc] initWithCGImage:cgImage];
-            NSData *pngData = [bitmapRep representationUsingType:NSBitmapImageFileTypePNG properties:@{}];
-
-            // Write to file
-            NSError *writeError = nil;
-            BOOL success = [pngData writeToFile:filePath options:NSDataWritingAtomic error:&writeError];
-
-            dispatch_async(dispatch_get_main_queue(), ^{
-                if (success) {
-                    NSLog(@"[INFO] Snapshot saved to: %@", filePath);
-                    if (completion) completion(YES, nil);
-                } else {
-                    NSLog(@"[ERROR] Failed to save snapshot to: %@", filePath);
-                    if (completion) completion(NO, writeError);
-                }
-            });
-        });
     }];
 }
 
@@ -139,7 +101,7 @@
     NSDateFormatter *formatter = [[NSDateFormatter alloc] init];
     formatter.dateFormat = @"yyyy-MM-dd_HH-mm-ss";
     NSString *timestamp = [formatter stringFromDate:[NSDate date]];
-    NSString *filename = [NSString stringWithFormat:@"rtsp_snapshot_%@.png", timestamp];
+    NSString *filename = [NSString stringWithFormat:@"rtsp_snapshot_%@.jpg", timestamp];
     NSString *filePath = [directory stringByAppendingPathComponent:filename];
 
     [self saveSnapshotToFile:filePath completion:^(BOOL success, NSError *error) {
@@ -153,8 +115,21 @@
 
 #pragma mark - Recording
 
+/// URL the player is playing; for proxied cameras the local HLS URL
+- (nullable NSURL *)currentStreamURL {
+    AVAsset *asset = self.player.currentItem.asset;
+    return [asset isKindOfClass:[AVURLAsset class]] ? ((AVURLAsset *)asset).URL : nil;
+}
+
+- (NSError *)notRecordableError {
+    return [NSError errorWithDomain:@"RTSPRecorder"
+                               code:1005
+                           userInfo:@{NSLocalizedDescriptionKey: @"Stream is not remuxed by the proxy or has not delivered video yet"}];
+}
+
 - (void)startRecordingToFile:(NSString *)filePath completion:(void (^)(BOOL, NSError * _Nullable))completion {
-    if (!self.player || !self.player.currentItem) {
+    NSURL *streamURL = [self currentStreamURL];
+    if (!streamURL) {
         NSError *error = [NSError errorWithDomain:@"RTSPRecorder"
                                              code:1004
                                          userInfo:@{NSLocalizedDescriptionKey: @"No media available for recording"}];
@@ -173,46 +148,100 @@
                                                attributes:nil
                                                     error:nil];
 
-    // Note: Recording live RTSP streams with AVAssetWriter is complex and requires
-    // capturing frames and writing them. For now, we'll log the intent.
-    // A full implementation would require AVAssetReaderOutput and AVAssetWriterInput coordination.
-
-    dispatch_async(dispatch_get_main_queue(), ^{
-        self.recordingFilePath = filePath;
-        self.recordingStartTime = [NSDate date];
+    // Set before the proxy starts: a recording that fails at once is
+    // finished on a later main-queue pass, which must find it
+    self.recordingURL = streamURL;
+    self.recordingFilePath = filePath;
+    self.recordingStartTime = [NSDate date];
+
+    // The proxy copies the camera's elementary stream into fMP4 on its own
+    // writer thread; nothing is decoded or re-encoded here
+    __weak typeof(self) weakSelf = self;
+    BOOL started = [[RTSPFFmpegProxy sharedProxy] startRecordingForURL:streamURL
+                                                                toFile:filePath
+                                                        includePreRoll:NO
+                                                            completion:^(NSString *path, NSTimeInterval duration, NSError *error) {
+        [weakSelf recordingToFile:filePath finishedWithDuration:duration error:error];
+    }];
+    if (!started) {
+        self.recordingURL = nil;
+        self.recordingFilePath = nil;
+        self.recordingStartTime = nil;
 
-        NSLog(@"[INFO] Recording started (frame capture mode) to: %@", filePath);
-        NSLog(@"[WARNING] Full video recording requires additional implementation with AVAssetWriter");
+        NSError *error = [self notRecordableError];
+        NSLog(@"[ERROR] Could not start recording to %@: %@", filePath, error.localizedDescription);
+        dispatch_async(dispatch_get_main_queue(), ^{
+            if (completion) completion(NO, error);
+        });
+        return;
+    }
 
-        // For basic implementation, we'll use periodic snapshots as a fallback
+    NSLog(@"[INFO] Recording started (stream copy) to: %@", filePath);
+    dispatch_async(dispatch_get_main_queue(), ^{
         if (completion) completion(YES, nil);
     });
 }
 
+/// Main queue. The file is closed: stopped, or ended by a write error or a
+/// codec change on the camera.
+- (void)recordingToFile:(NSString *)filePath finishedWithDuration:(NSTimeInterval)duration error:(nullable NSError *)error {
+    if (error) {
+        NSLog(@"[ERROR] Recording to %@ failed: %@", filePath, error.localizedDescription);
+    } else {
+        NSLog(@"[INFO] Recording finished: %.1f seconds in %@", duration, filePath);
+    }
+    if ([self.recordingFilePath isEqualToString:filePath]) {
+        self.recordingURL = nil;
+        self.recordingFilePath = nil;
+        self.recordingStartTime = nil;
+    }
+}
+
 - (void)stopRecording {
     if (!self.isRecording) {
         return;
     }
 
+    [[RTSPFFmpegProxy sharedProxy] stopRecordingForURL:self.recordingURL];
+
+    // A recording started right after this one keeps its state
+    NSString *filePath = self.recordingFilePath;
+    NSDate *startTime = self.recordingStartTime;
     dispatch_async(dispatch_get_main_queue(), ^{
-        NSTimeInterval duration = [[NSDate date] timeIntervalSinceDate:self.recordingStartTime];
-        NSLog(@"[INFO] Stopped recording. Duration: %.1f seconds. File: %@", duration, self.recordingFilePath);
-
-        // Clean up asset writer if it exists
-        if (self.assetWriter) {
-            [self.assetWriter finishWritingWithCompletionHandler:^{
-                NSLog(@"[INFO] Asset writer finished");
-            }];
-            self.assetWriter = nil;
-            self.videoInput = nil;
-            self.pixelBufferAdaptor = nil;
+        if (self.recordingStartTime != startTime) {
+            return;
         }
+        NSTimeInterval duration = [[NSDate date] timeIntervalSinceDate:self.recordingStartTime];
+        NSLog(@"[INFO] Stopped recording. Duration: %.1f seconds. File: %@", duration, filePath);
 
+        self.recordingURL = nil;
         self.recordingFilePath = nil;
         self.recordingStartTime = nil;
     });
 }
 
+- (void)recordClipToFile:(NSString *)filePath completion:(void (^)(NSString * _Nullable, NSError * _Nullable))completion {
+    NSString *directory = [filePath stringByDeletingLastPathComponent];
+    [[NSFileManager defaultManager] createDirectoryAtPath:directory
+                              withIntermediateDirectories:YES
+                                               attributes:nil
+                                                    error:nil];
+
+    NSURL *streamURL = [self currentStreamURL];
+    BOOL triggered = streamURL && [[RTSPFFmpegProxy sharedProxy] triggerClipForURL:streamURL
+                                                                            toFile:filePath
+                                                                        completion:^(NSString *path, NSTimeInterval duration, NSError *error) {
+        if (completion) completion(path, error);
+    }];
+    if (!triggered) {
+        NSError *error = [self notRecordableError];
+        NSLog(@"[ERROR] Could not record clip to %@: %@", filePath, error.localizedDescription);
+        dispatch_async(dispatch_get_main_queue(), ^{
+            if (completion) completion(nil, error);
+        });
+    }
+}
+
 - (BOOL)isRecording {
     return self.recordingFilePath != nil && self.recordingStartTime != nil;
 }
@@ -258,11 +287,16 @@
 }
 
 - (void)takeScheduledSnapshot {
-    if (!self.snapshotDirectory) {
+    // A tick that finds the previous snapshot still being written is skipped
+    // rather than queued behind it
+    if (!self.snapshotDirectory || self.scheduledSnapshotInFlight) {
         return;
     }
 
+    self.scheduledSnapshotInFlight = YES;
+    __weak typeof(self) weakSelf = self;
     [self autoSaveSnapshotToDirectory:self.snapshotDirectory completion:^(NSString *filePath, NSError *error) {
+        weakSelf.scheduledSnapshotInFlight = NO;
         if (error) {
             NSLog(@"[ERROR] Scheduled snapshot failed: %@", error.localizedDescription);
         }
@@ -275,7 +309,9 @@
 
 - (void)dealloc {
     [self stopScheduledSnapshots];
-    [self stopRecording];
+    if (_recordingURL) {
+        [[RTSPFFmpegProxy sharedProxy] stopRecordingForURL:_recordingURL];
+    }
 }
 
 @end
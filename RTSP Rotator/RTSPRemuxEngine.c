@@ -0,0 +1,960 @@
+//
+//  RTSPRemuxEngine.c
+//  RTSP Rotator
+//
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE     // pthread_setname_np
+#endif
+
+#include "RTSPRemuxEngine.h"
+#include "RTSPFMP4Writer.h"
+#include "RTSPProtocol.h"
+#include "RTSPRTPDepacketizer.h"
+#include "RTSPTransport.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RTSP_REMUX_READ_CHUNK 65536
+#define RTSP_REMUX_READ_BUDGET (512 * 1024)     // Per stream per loop pass, for fairness
+#define RTSP_REMUX_MAX_BACKOFF 30.0
+#define RTSP_REMUX_DEFAULT_FRAME_DURATION 3000  // 30 fps at 90 kHz
+
+typedef enum {
+    RTSPRemuxPhaseConnecting,
+    RTSPRemuxPhaseDescribe,
+    RTSPRemuxPhaseSetup,
+    RTSPRemuxPhasePlay,
+    RTSPRemuxPhasePlaying,
+    RTSPRemuxPhaseBackoff
+} RTSPRemuxPhase;
+
+typedef struct RTSPRemuxSession {
+    struct RTSPRemuxEngine *engine;
+    uint32_t identifier;
+    RTSPURL url;
+    RTSPRemuxSink sink;
+    void *context;
+    bool removeRequested;
+
+    // Connection
+    RTSPRemuxPhase phase;
+    RTSPTransportRef transport;
+    bool wantWrite;
+    RTSPByteBuffer input;
+    RTSPByteBuffer output;
+    int cseq;
+    int pendingCSeq;
+    RTSPAuthChallenge challenge;
+    bool authRetried;
+    char controlURL[1536];
+    char session[256];
+    double sessionTimeout;
+    double deadline;
+    double keepaliveAt;
+    double reconnectAt;
+    double backoff;
+
+    // Media
+    RTSPCodecConfig codecConfig;
+    RTSPRTPDepacketizerRef depacketizer;
+    RTSPRTPStatistics previousRTP;
+
+    // Segmenter
+    RTSPByteBuffer pending;         // Last access unit, held until its duration is known
+    uint64_t pendingTimestamp;
+    bool pendingKeyframe;
+    bool pendingValid;
+    uint32_t lastDuration;
+    RTSPByteBuffer payload;         // Samples of the open part
+    RTSPFMP4Sample *samples;
+    size_t sampleCount;
+    size_t sampleCapacity;
+    uint64_t partDuration;          // 90 kHz ticks
+    uint64_t partDecodeTime;
+    RTSPByteBuffer segment;         // Fragments of the open segment
+    uint64_t segmentDuration;       // 90 kHz ticks
+    uint32_t segmentParts;
+    bool segmentIndependent;
+    bool segmentDiscontinuity;
+    uint64_t decodeTime;            // Running decode time across reconnects
+    uint32_t fragmentSequence;
+    uint32_t initGeneration;
+    uint32_t initID;
+    uint32_t nextSequence;
+    bool discontinuity;
+
+    // Guarded by the engine lock
+    RTSPRemuxStreamStatistics statistics;
+    RTSPRemuxStreamStatistics local;
+
+    struct RTSPRemuxSession *next;
+} RTSPRemuxSession;
+
+struct RTSPRemuxEngine {
+    RTSPRemuxConfig config;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    int wakeup[2];
+    bool running;
+    uint32_t nextIdentifier;
+
+    RTSPRemuxSession *sessions;     // Owned by the loop; list edits happen under the lock
+    RTSPRemuxSession *added;        // Waiting to be adopted by the loop
+
+    // Loop thread scratch
+    RTSPMessage message;
+    RTSPByteBuffer fragment;
+    struct pollfd *pollfds;
+    RTSPRemuxSession **polled;
+    size_t pollCapacity;
+};
+
+static double RTSPRemuxNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+void RTSPRemuxConfigInit(RTSPRemuxConfig *config) {
+    config->targetSegmentDuration = 2.0;
+    config->partTargetDuration = 0.2;
+    config->responseTimeout = 10.0;
+    config->reconnectDelay = 2.0;
+    config->verifyCertificates = false;
+}
+
+static void RTSPRemuxSetState(RTSPRemuxSession *s, RTSPRemuxStreamState state, const char *message) {
+    bool changed = s->local.state != state;
+    s->local.state = state;
+    if ((changed || message) && s->sink.stateChanged && !s->removeRequested) {
+        s->sink.stateChanged(s->context, state, message);
+    }
+}
+
+#pragma mark - Segmenter
+
+static RTSPRemuxMediaInfo RTSPRemuxSegmentInfo(const RTSPRemuxSession *s, uint32_t part, uint64_t duration) {
+    return (RTSPRemuxMediaInfo){
+        .sequence = s->nextSequence,
+        .part = part,
+        .initID = s->initID,
+        .duration = (double)duration / RTSP_FMP4_TIMESCALE,
+        .independent = s->segmentIndependent,
+        .discontinuity = s->segmentDiscontinuity,
+    };
+}
+
+static void RTSPRemuxFlushPart(RTSPRemuxEngineRef engine, RTSPRemuxSession *s) {
+    if (s->sampleCount == 0) {
+        return;
+    }
+
+    RTSPByteBufferReset(&engine->fragment);
+    if (RTSPFMP4WriteFragment(++s->fragmentSequence, s->partDecodeTime, s->samples, s->sampleCount,
+                              s->payload.data, s->payload.length, &engine->fragment)) {
+        RTSPByteBufferAppend(&s->segment, engine->fragment.data, engine->fragment.length);
+        if (engine->config.partTargetDuration > 0 && s->sink.part && !s->removeRequested) {
+            RTSPRemuxMediaInfo info = RTSPRemuxSegmentInfo(s, s->segmentParts, s->partDuration);
+            info.independent = s->samples[0].keyframe;
+            s->sink.part(s->context, &info, engine->fragment.data, engine->fragment.length);
+        }
+        s->segmentParts++;
+    }
+
+    s->sampleCount = 0;
+    s->partDuration = 0;
+    RTSPByteBufferReset(&s->payload);
+}
+
+static void RTSPRemuxFinishSegment(RTSPRemuxEngineRef engine, RTSPRemuxSession *s) {
+    RTSPRemuxFlushPart(engine, s);
+    if (s->segmentParts == 0) {
+        return;
+    }
+
+    if (!s->segment.failed && s->sink.segment && !s->removeRequested) {
+        RTSPRemuxMediaInfo info = RTSPRemuxSegmentInfo(s, s->segmentParts, s->segmentDuration);
+        s->sink.segment(s->context, &info, s->segment.data, s->segment.length);
+    }
+    s->nextSequence++;
+    s->local.segments++;
+
+    s->segmentParts = 0;
+    s->segmentDuration = 0;
+    RTSPByteBufferReset(&s->segment);
+}
+
+static void RTSPRemuxAppendPending(RTSPRemuxEngineRef engine, RTSPRemuxSession *s, uint32_t duration) {
+    if (s->sampleCount == s->sampleCapacity) {
+        size_t capacity = s->sampleCapacity ? s->sampleCapacity * 2 : 128;
+        RTSPFMP4Sample *samples = realloc(s->samples, capacity * sizeof(*samples));
+        if (!samples) {
+            return;
+        }
+        s->samples = samples;
+        s->sampleCapacity = capacity;
+    }
+    if (s->segmentDuration == 0 && s->sampleCount == 0) {
+        s->segmentIndependent = s->pendingKeyframe;
+        s->segmentDiscontinuity = s->discontinuity;
+        s->discontinuity = false;
+    }
+    if (s->sampleCount == 0) {
+        s->partDecodeTime = s->decodeTime;
+    }
+    s->samples[s->sampleCount++] = (RTSPFMP4Sample){
+        .size = (uint32_t)s->pending.length,
+        .duration = duration,
+        .keyframe = s->pendingKeyframe,
+    };
+    RTSPByteBufferAppend(&s->payload, s->pending.data, s->pending.length);
+    s->partDuration += duration;
+    s->segmentDuration += duration;
+    s->decodeTime += duration;
+
+    // Close the part as soon as another frame of the same length would
+    // overflow the target, so every part is published without waiting
+    // for the next access unit and never exceeds PART-TARGET
+    double partTarget = engine->config.partTargetDuration * RTSP_FMP4_TIMESCALE;
+    if (partTarget > 0 && (double)(s->partDuration + duration) > partTarget) {
+        RTSPRemuxFlushPart(engine, s);
+    }
+}
+
+static void RTSPRemuxOnAccessUnit(void *context, const RTSPAccessUnit *unit) {
+    RTSPRemuxSession *s = context;
+    RTSPRemuxEngineRef engine = s->engine;
+
+    if (s->pendingValid) {
+        // RTP timestamps are presentation times; cameras do not use B-frames,
+        // so the delta to the next unit is the sample duration.
+        int64_t delta = (int64_t)(unit->timestamp - s->pendingTimestamp);
+        uint32_t duration = (delta > 0 && delta < 10 * RTSP_FMP4_TIMESCALE) ? (uint32_t)delta
+                          : (s->lastDuration ? s->lastDuration : RTSP_REMUX_DEFAULT_FRAME_DURATION);
+        s->lastDuration = duration;
+        RTSPRemuxAppendPending(engine, s, duration);
+        s->pendingValid = false;
+    }
+
+    bool configChanged = s->initID == 0 || unit->configGeneration != s->initGeneration;
+    if (unit->keyframe && s->segmentDuration > 0 &&
+        (configChanged || s->segmentDuration >= (uint64_t)(engine->config.targetSegmentDuration * RTSP_FMP4_TIMESCALE))) {
+        RTSPRemuxFinishSegment(engine, s);
+    }
+
+    if (unit->keyframe && configChanged) {
+        RTSPByteBufferReset(&engine->fragment);
+        if (RTSPFMP4WriteInitSegment(&s->codecConfig, &engine->fragment)) {
+            s->initID++;
+            s->initGeneration = unit->configGeneration;
+            s->discontinuity = s->initID > 1 || s->discontinuity;
+            if (s->sink.initSegment && !s->removeRequested) {
+                s->sink.initSegment(s->context, s->initID, engine->fragment.data, engine->fragment.length);
+            }
+            s->local.codec = s->codecConfig.codec;
+            s->local.width = s->codecConfig.width;
+            s->local.height = s->codecConfig.height;
+            RTSPCodecConfigCodecString(&s->codecConfig, s->local.codecString, sizeof(s->local.codecString));
+        }
+    }
+    if (s->initID == 0) {
+        return; // Nothing can be played before the first init segment
+    }
+
+    RTSPByteBufferReset(&s->pending);
+    RTSPByteBufferAppend(&s->pending, unit->data, unit->length);
+    s->pendingTimestamp = unit->timestamp;
+    s->pendingKeyframe = unit->keyframe;
+    s->pendingValid = !s->pending.failed;
+}
+
+#pragma mark - Connection
+
+static void RTSPRemuxCloseConnection(RTSPRemuxSession *s) {
+    if (s->transport) {
+        RTSPTransportRelease(s->transport);
+        s->transport = NULL;
+    }
+    if (s->depacketizer) {
+        RTSPRTPDepacketizerRelease(s->depacketizer);
+        s->depacketizer = NULL;
+    }
+    RTSPByteBufferReset(&s->input);
+    RTSPByteBufferReset(&s->output);
+    s->session[0] = '\0';
+    s->pendingCSeq = -1;
+    s->authRetried = false;
+    s->pendingValid = false;
+    s->wantWrite = false;
+    memset(&s->previousRTP, 0, sizeof(s->previousRTP));
+}
+
+static void RTSPRemuxFail(RTSPRemuxEngineRef engine, RTSPRemuxSession *s, const char *message) {
+    RTSPRemuxFinishSegment(engine, s);
+    RTSPRemuxCloseConnection(s);
+    s->discontinuity = true;
+    s->phase = RTSPRemuxPhaseBackoff;
+    s->reconnectAt = RTSPRemuxNow() + s->backoff;
+    s->backoff = fmin(s->backoff * 2, RTSP_REMUX_MAX_BACKOFF);
+    s->local.reconnects++;
+    RTSPRemuxSetState(s, RTSPRemuxStreamReconnecting, message);
+}
+
+static void RTSPRemuxConnect(RTSPRemuxEngineRef engine, RTSPRemuxSession *s) {
+    // Host names resolve off the loop; the lookup wakes it when done
+    s->transport = RTSPTransportConnect(s->url.host, s->url.port, s->url.secure,
+                                        engine->config.verifyCertificates, engine->wakeup[1]);
+    s->phase = RTSPRemuxPhaseConnecting;
+    s->wantWrite = true;
+    s->deadline = RTSPRemuxNow() + engine->config.responseTimeout;
+    RTSPRemuxSetState(s, RTSPRemuxStreamConnecting, NULL);
+    if (!s->transport) {
+        RTSPRemuxFail(engine, s, "Could not connect");
+    }
+}
+
+static void RTSPRemuxSendRequest(RTSPRemuxEngineRef engine, RTSPRemuxSession *s,
+                                 const char *method, const char *uri, const char *extraHeaders) {
+    RTSPByteBuffer *b = &s->output;
+    s->pendingCSeq = ++s->cseq;
+    RTSPByteBufferAppendFormat(b, "%s %s RTSP/1.0\r\nCSeq: %d\r\nUser-Agent: RTSP Rotator\r\n", method, uri, s->cseq);
+    if (s->challenge.valid) {
+        char authorization[1024];
+        if (RTSPAuthBuildHeader(&s->challenge, s->url.user, s->url.password, method, uri,
+                                authorization, sizeof(authorization))) {
+            RTSPByteBufferAppendFormat(b, "Authorization: %s\r\n", authorization);
+        }
+    }
+    if (s->session[0]) {
+        RTSPByteBufferAppendFormat(b, "Session: %s\r\n", s->session);
+    }
+    if (extraHeaders) {
+        RTSPByteBufferAppendString(b, extraHeaders);
+    }
+    RTSPByteBufferAppendString(b, "\r\n");
+    s->wantWrite = true;
+    s->deadline = RTSPRemuxNow() + engine->config.responseTimeout;
+}
+
+static void RTSPRemuxSendDescribe(RTSPRemuxEngineRef engine, RTSPRemuxSession *s) {
+    s->phase = RTSPRemuxPhaseDescribe;
+    RTSPRemuxSetState(s, RTSPRemuxStreamNegotiating, NULL);
+    RTSPRemuxSendRequest(engine, s, "DESCRIBE", s->url.sanitized, "Accept: application/sdp\r\n");
+}
+
+static bool RTSPRemuxRetryWithAuth(RTSPRemuxSession *s, const RTSPMessage *m) {
+    char header[512];
+    if (m->statusCode != 401 || s->authRetried || s->url.user[0] == '\0' ||
+        !RTSPMessageHeader(m, "WWW-Authenticate", header, sizeof(header))) {
+        return false;
+    }
+    s->authRetried = true;
+    return RTSPAuthParseChallenge(header, &s->challenge);
+}
+
+static void RTSPRemuxHandleResponse(RTSPRemuxEngineRef engine, RTSPRemuxSession *s, const RTSPMessage *m) {
+    if (m->cseq != s->pendingCSeq) {
+        return; // Keep-alive replies and anything we did not wait for
+    }
+    s->pendingCSeq = -1;
+    char error[96];
+
+    switch (s->phase) {
+        case RTSPRemuxPhaseDescribe: {
+            if (RTSPRemuxRetryWithAuth(s, m)) {
+                RTSPRemuxSendDescribe(engine, s);
+                return;
+            }
+            if (m->statusCode != 200) {
+                snprintf(error, sizeof(error), "DESCRIBE failed (%d)", m->statusCode);
+                RTSPRemuxFail(engine, s, error);
+                return;
+            }
+
+            RTSPSDPVideoTrack track;
+            RTSPCodecConfig config;
+            RTSPCodecConfigInit(&config, RTSPVideoCodecUnknown);
+            if (!RTSPSDPParseVideoTrack(m->body, &track, &config)) {
+                RTSPRemuxFail(engine, s, "No H.264 or H.265 video track");
+                return;
+            }
+            // Keep the previous configuration's generation so an unchanged
+            // camera does not force a new init segment after reconnecting.
+            uint32_t generation = s->codecConfig.generation;
+            bool sameCodec = s->codecConfig.codec == config.codec;
+            if (!sameCodec || memcmp(&s->codecConfig.sps, &config.sps, sizeof(config.sps)) != 0 ||
+                memcmp(&s->codecConfig.pps, &config.pps, sizeof(config.pps)) != 0 ||
+                memcmp(&s->codecConfig.vps, &config.vps, sizeof(config.vps)) != 0) {
+                config.generation = generation + 1;
+                s->codecConfig = config;
+            }
+
+            s->depacketizer = RTSPRTPDepacketizerCreate(&s->codecConfig, RTSPRemuxOnAccessUnit, s);
+            if (!s->depacketizer) {
+                RTSPRemuxFail(engine, s, "Out of memory");
+                return;
+            }
+
+            char base[1536];
+            if (!RTSPMessageHeader(m, "Content-Base", base, sizeof(base)) &&
+                !RTSPMessageHeader(m, "Content-Location", base, sizeof(base))) {
+                snprintf(base, sizeof(base), "%s", s->url.sanitized);
+            }
+            RTSPResolveControlURL(base, track.control, s->controlURL, sizeof(s->controlURL));
+
+            s->phase = RTSPRemuxPhaseSetup;
+            RTSPRemuxSendRequest(engine, s, "SETUP", s->controlURL,
+                                 "Transport: RTP/AVP/TCP;unicast;interleaved=0-1\r\n");
+            return;
+        }
+
+        case RTSPRemuxPhaseSetup: {
+            if (RTSPRemuxRetryWithAuth(s, m)) {
+                RTSPRemuxSendRequest(engine, s, "SETUP", s->controlURL,
+                                     "Transport: RTP/AVP/TCP;unicast;interleaved=0-1\r\n");
+                return;
+            }
+            char session[256];
+            if (m->statusCode != 200 || !RTSPMessageHeader(m, "Session", session, sizeof(session))) {
+                snprintf(error, sizeof(error), "SETUP failed (%d)", m->statusCode);
+                RTSPRemuxFail(engine, s, error);
+                return;
+            }
+            char *timeout = strstr(session, ";timeout=");
+            s->sessionTimeout = timeout ? atof(timeout + 9) : 60.0;
+            if (s->sessionTimeout < 10.0) {
+                s->sessionTimeout = 10.0;
+            }
+            char *separator = strchr(session, ';');
+            if (separator) {
+                *separator = '\0';
+            }
+            snprintf(s->session, sizeof(s->session), "%s", session);
+
+            s->phase = RTSPRemuxPhasePlay;
+            RTSPRemuxSendRequest(engine, s, "PLAY", s->url.sanitized, "Range: npt=0.000-\r\n");
+            return;
+        }
+
+        case RTSPRemuxPhasePlay:
+            if (m->statusCode != 200) {
+                snprintf(error, sizeof(error), "PLAY failed (%d)", m->statusCode);
+                RTSPRemuxFail(engine, s, error);
+                return;
+            }
+            s->phase = RTSPRemuxPhasePlaying;
+            s->backoff = engine->config.reconnectDelay;
+            s->keepaliveAt = RTSPRemuxNow() + s->sessionTimeout / 2;
+            s->deadline = RTSPRemuxNow() + engine->config.responseTimeout;
+            RTSPRemuxSetState(s, RTSPRemuxStreamPlaying, NULL);
+            return;
+
+        default:
+            return;
+    }
+}
+
+static void RTSPRemuxHandleInterleaved(RTSPRemuxEngineRef engine, RTSPRemuxSession *s, const RTSPMessage *m) {
+    if (m->channel != 0 || !s->depacketizer) {
+        return; // RTCP and anything unexpected
+    }
+    RTSPRTPDepacketizerPush(s->depacketizer, m->packet, m->packetLength);
+    s->deadline = RTSPRemuxNow() + engine->config.responseTimeout;
+}
+
+#pragma mark - I/O
+
+static bool RTSPRemuxFlushOutput(RTSPRemuxEngineRef engine, RTSPRemuxSession *s) {
+    while (s->output.length > 0) {
+        size_t written = 0;
+        RTSPTransportStatus status = RTSPTransportWrite(s->transport, s->output.data, s->output.length, &written);
+        if (status == RTSPTransportOK) {
+            RTSPByteBufferConsume(&s->output, written);
+        } else if (status == RTSPTransportWantWrite || status == RTSPTransportWantRead) {
+            s->wantWrite = true;
+            return true;
+        } else {
+            RTSPRemuxFail(engine, s, "Connection lost");
+            return false;
+        }
+    }
+    s->wantWrite = false;
+    return true;
+}
+
+static void RTSPRemuxReadInput(RTSPRemuxEngineRef engine, RTSPRemuxSession *s) {
+    size_t budget = RTSP_REMUX_READ_BUDGET;
+    while (budget > 0 && s->transport) {
+        if (!RTSPByteBufferReserve(&s->input, RTSP_REMUX_READ_CHUNK)) {
+            RTSPRemuxFail(engine, s, "Out of memory");
+            return;
+        }
+        size_t count = 0;
+        RTSPTransportStatus status = RTSPTransportRead(s->transport, s->input.data + s->input.length,
+                                                       RTSP_REMUX_READ_CHUNK, &count);
+        if (status == RTSPTransportWantRead || status == RTSPTransportWantWrite) {
+            break;
+        }
+        if (status != RTSPTransportOK) {
+            RTSPRemuxFail(engine, s, status == RTSPTransportClosed ? "Camera closed the connection" : "Connection lost");
+            return;
+        }
+        s->input.length += count;
+        s->local.bytesReceived += count;
+        budget = count < budget ? budget - count : 0;
+
+        size_t offset = 0;
+        for (;;) {
+            size_t consumed = 0;
+            RTSPParseResult result = RTSPMessageParse(s->input.data + offset, s->input.length - offset,
+                                                      &engine->message, &consumed);
+            if (result == RTSPParseNeedMore) {
+                break;
+            }
+            if (result == RTSPParseError) {
+                RTSPRemuxFail(engine, s, "Malformed RTSP message");
+                return;
+            }
+            if (result == RTSPParseInterleaved) {
+                RTSPRemuxHandleInterleaved(engine, s, &engine->message);
+            } else if (!engine->message.isRequest) {
+                RTSPRemuxHandleResponse(engine, s, &engine->message);
+            }
+            if (!s->transport) {
+                return; // Failed while handling
+            }
+            offset += consumed;
+        }
+        RTSPByteBufferConsume(&s->input, offset);
+    }
+}
+
+static void RTSPRemuxService(RTSPRemuxEngineRef engine, RTSPRemuxSession *s, short revents) {
+    if (!s->transport) {
+        return;
+    }
+
+    if (s->phase == RTSPRemuxPhaseConnecting) {
+        RTSPTransportStatus status = RTSPTransportHandshake(s->transport);
+        if (status == RTSPTransportOK) {
+            RTSPRemuxSendDescribe(engine, s);
+        } else if (status == RTSPTransportWantRead || status == RTSPTransportWantWrite) {
+            s->wantWrite = status == RTSPTransportWantWrite;
+            return;
+        } else {
+            RTSPRemuxFail(engine, s, RTSPTransportFailureReason(s->transport));
+            return;
+        }
+    }
+
+    if ((revents & (POLLIN | POLLHUP | POLLERR)) || RTSPTransportHasPendingInput(s->transport)) {
+        RTSPRemuxReadInput(engine, s);
+    }
+    if (s->transport && s->output.length > 0) {
+        RTSPRemuxFlushOutput(engine, s);
+    }
+}
+
+static void RTSPRemuxServiceTimers(RTSPRemuxEngineRef engine, RTSPRemuxSession *s, double now) {
+    if (s->phase == RTSPRemuxPhaseBackoff) {
+        if (now >= s->reconnectAt) {
+            RTSPRemuxConnect(engine, s);
+        }
+        return;
+    }
+    if (now >= s->deadline) {
+        RTSPRemuxFail(engine, s, s->phase == RTSPRemuxPhasePlaying ? "Stream stalled" :
+                                 RTSPTransportIsResolving(s->transport) ? "Timed out resolving host" : "Timed out");
+        return;
+    }
+    if (s->phase == RTSPRemuxPhaseConnecting) {
+        // Resolution and the per-address connect timeout advance on the clock too
+        RTSPRemuxService(engine, s, 0);
+        return;
+    }
+    if (s->phase == RTSPRemuxPhasePlaying && now >= s->keepaliveAt) {
+        s->keepaliveAt = now + s->sessionTimeout / 2;
+        double deadline = s->deadline;
+        RTSPRemuxSendRequest(engine, s, "OPTIONS", s->url.sanitized, NULL);
+        s->pendingCSeq = -1;
+        s->deadline = deadline; // Keep-alives are fire and forget; data drives the stall timer
+        RTSPRemuxFlushOutput(engine, s);
+    }
+}
+
+#pragma mark - Sessions
+
+static void RTSPRemuxSessionDestroy(RTSPRemuxSession *s) {
+    if (s->transport && s->session[0]) {
+        // Best-effort TEARDOWN so the camera frees the session immediately
+        RTSPByteBufferReset(&s->output);
+        RTSPByteBufferAppendFormat(&s->output, "TEARDOWN %s RTSP/1.0\r\nCSeq: %d\r\nSession: %s\r\n\r\n",
+                                   s->url.sanitized, s->cseq + 1, s->session);
+        size_t written = 0;
+        RTSPTransportWrite(s->transport, s->output.data, s->output.length, &written);
+    }
+    RTSPRemuxCloseConnection(s);
+    RTSPByteBufferFree(&s->input);
+    RTSPByteBufferFree(&s->output);
+    RTSPByteBufferFree(&s->pending);
+    RTSPByteBufferFree(&s->payload);
+    RTSPByteBufferFree(&s->segment);
+    free(s->samples);
+    free(s);
+}
+
+static void RTSPRemuxAdoptAndReap(RTSPRemuxEngineRef engine) {
+    RTSPRemuxSession *adopted = NULL;
+    RTSPRemuxSession *reaped = NULL;
+
+    pthread_mutex_lock(&engine->lock);
+    adopted = engine->added;
+    engine->added = NULL;
+
+    RTSPRemuxSession **link = &engine->sessions;
+    while (*link) {
+        RTSPRemuxSession *s = *link;
+        if (s->removeRequested) {
+            *link = s->next;
+            s->next = reaped;
+            reaped = s;
+        } else {
+            link = &s->next;
+        }
+    }
+    pthread_mutex_unlock(&engine->lock);
+
+    while (reaped) {
+        RTSPRemuxSession *next = reaped->next;
+        RTSPRemuxSessionDestroy(reaped);
+        reaped = next;
+    }
+
+    while (adopted) {
+        RTSPRemuxSession *next = adopted->next;
+        if (adopted->removeRequested) {
+            RTSPRemuxSessionDestroy(adopted);
+        } else {
+            RTSPRemuxConnect(engine, adopted);
+            pthread_mutex_lock(&engine->lock);
+            adopted->next = engine->sessions;
+            engine->sessions = adopted;
+            pthread_mutex_unlock(&engine->lock);
+        }
+        adopted = next;
+    }
+
+    pthread_mutex_lock(&engine->lock);
+    pthread_cond_broadcast(&engine->changed);
+    pthread_mutex_unlock(&engine->lock);
+}
+
+static void RTSPRemuxPublishStatistics(RTSPRemuxEngineRef engine) {
+    pthread_mutex_lock(&engine->lock);
+    for (RTSPRemuxSession *s = engine->sessions; s; s = s->next) {
+        if (s->depacketizer) {
+            RTSPRTPStatistics rtp = RTSPRTPDepacketizerGetStatistics(s->depacketizer);
+            s->local.packets += rtp.packets - s->previousRTP.packets;
+            s->local.lostPackets += rtp.lostPackets - s->previousRTP.lostPackets;
+            s->local.accessUnits += rtp.accessUnits - s->previousRTP.accessUnits;
+            s->previousRTP = rtp;
+        }
+        s->statistics = s->local;
+    }
+    pthread_mutex_unlock(&engine->lock);
+}
+
+#pragma mark - Event Loop
+
+static void *RTSPRemuxThread(void *argument) {
+    RTSPRemuxEngineRef engine = argument;
+#if defined(__APPLE__)
+    pthread_setname_np("com.rtsp.remux");
+#elif defined(__linux__)
+    pthread_setname_np(pthread_self(), "rtsp-remux");
+#endif
+
+    for (;;) {
+        pthread_mutex_lock(&engine->lock);
+        bool running = engine->running;
+        pthread_mutex_unlock(&engine->lock);
+        if (!running) {
+            break;
+        }
+
+        RTSPRemuxAdoptAndReap(engine);
+
+        size_t count = 1;
+        for (RTSPRemuxSession *s = engine->sessions; s; s = s->next) {
+            count++;
+        }
+        if (count > engine->pollCapacity) {
+            size_t capacity = count * 2;
+            struct pollfd *fds = realloc(engine->pollfds, capacity * sizeof(*fds));
+            RTSPRemuxSession **polled = realloc(engine->polled, capacity * sizeof(*polled));
+            if (fds) engine->pollfds = fds;
+            if (polled) engine->polled = polled;
+            if (!fds || !polled) {
+                usleep(10000);
+                continue;
+            }
+            engine->pollCapacity = capacity;
+        }
+
+        double now = RTSPRemuxNow();
+        double nextTimer = now + 1.0;
+        size_t nfds = 1;
+        engine->pollfds[0] = (struct pollfd){.fd = engine->wakeup[0], .events = POLLIN};
+        bool pendingInput = false;
+
+        for (RTSPRemuxSession *s = engine->sessions; s; s = s->next) {
+            double timer = s->phase == RTSPRemuxPhaseBackoff ? s->reconnectAt : s->deadline;
+            if (s->phase == RTSPRemuxPhasePlaying && s->keepaliveAt < timer) {
+                timer = s->keepaliveAt;
+            }
+            nextTimer = fmin(nextTimer, timer);
+            if (!s->transport) {
+                continue;
+            }
+            pendingInput = pendingInput || RTSPTransportHasPendingInput(s->transport);
+            engine->polled[nfds] = s;
+            engine->pollfds[nfds++] = (struct pollfd){
+                .fd = RTSPTransportGetFD(s->transport),
+                .events = (short)(POLLIN | (s->wantWrite ? POLLOUT : 0)),
+            };
+        }
+
+        int timeout = pendingInput ? 0 : (int)fmax(0, ceil((nextTimer - now) * 1000.0));
+        int ready = poll(engine->pollfds, (nfds_t)nfds, timeout);
+        if (ready < 0 && errno != EINTR) {
+            usleep(1000);
+            continue;
+        }
+
+        if (engine->pollfds[0].revents & POLLIN) {
+            char drain[64];
+            while (read(engine->wakeup[0], drain, sizeof(drain)) > 0) {
+            }
+        }
+
+        for (size_t i = 1; i < nfds; i++) {
+            RTSPRemuxSession *s = engine->polled[i];
+            if (engine->pollfds[i].revents || RTSPTransportHasPendingInput(s->transport)) {
+                RTSPRemuxService(engine, s, engine->pollfds[i].revents);
+            }
+        }
+
+        now = RTSPRemuxNow();
+        for (RTSPRemuxSession *s = engine->sessions; s; s = s->next) {
+            RTSPRemuxServiceTimers(engine, s, now);
+        }
+
+        RTSPRemuxPublishStatistics(engine);
+    }
+
+    return NULL;
+}
+
+static void RTSPRemuxWake(RTSPRemuxEngineRef engine) {
+    char byte = 1;
+    ssize_t result = write(engine->wakeup[1], &byte, 1);
+    (void)result; // A full pipe already guarantees a wakeup
+}
+
+#pragma mark - Public API
+
+RTSPRemuxEngineRef RTSPRemuxEngineCreate(const RTSPRemuxConfig *config) {
+    RTSPRemuxEngineRef engine = calloc(1, sizeof(*engine));
+    if (!engine) {
+        return NULL;
+    }
+    if (config) {
+        engine->config = *config;
+    } else {
+        RTSPRemuxConfigInit(&engine->config);
+    }
+    if (engine->config.targetSegmentDuration <= 0) {
+        engine->config.targetSegmentDuration = 2.0;
+    }
+    if (engine->config.partTargetDuration < 0 ||
+        engine->config.partTargetDuration >= engine->config.targetSegmentDuration) {
+        engine->config.partTargetDuration = 0;
+    }
+    if (engine->config.reconnectDelay <= 0) {
+        engine->config.reconnectDelay = 2.0;
+    }
+
+    if (pipe(engine->wakeup) != 0) {
+        free(engine);
+        return NULL;
+    }
+    for (int i = 0; i < 2; i++) {
+        fcntl(engine->wakeup[i], F_SETFL, fcntl(engine->wakeup[i], F_GETFL, 0) | O_NONBLOCK);
+        fcntl(engine->wakeup[i], F_SETFD, FD_CLOEXEC);
+    }
+
+    pthread_mutex_init(&engine->lock, NULL);
+    pthread_cond_init(&engine->changed, NULL);
+    RTSPByteBufferInit(&engine->fragment);
+    engine->running = true;
+    engine->nextIdentifier = 1;
+
+    if (pthread_create(&engine->thread, NULL, RTSPRemuxThread, engine) != 0) {
+        close(engine->wakeup[0]);
+        close(engine->wakeup[1]);
+        pthread_mutex_destroy(&engine->lock);
+        pthread_cond_destroy(&engine->changed);
+        free(engine);
+        return NULL;
+    }
+    return engine;
+}
+
+void RTSPRemuxEngineRelease(RTSPRemuxEngineRef engine) {
+    if (!engine) {
+        return;
+    }
+    pthread_mutex_lock(&engine->lock);
+    engine->running = false;
+    pthread_mutex_unlock(&engine->lock);
+    RTSPRemuxWake(engine);
+    pthread_join(engine->thread, NULL);
+
+    RTSPRemuxSession *lists[2] = {engine->sessions, engine->added};
+    for (int i = 0; i < 2; i++) {
+        RTSPRemuxSession *s = lists[i];
+        while (s) {
+            RTSPRemuxSession *next = s->next;
+            RTSPRemuxSessionDestroy(s);
+            s = next;
+        }
+    }
+
+    close(engine->wakeup[0]);
+    close(engine->wakeup[1]);
+    pthread_mutex_destroy(&engine->lock);
+    pthread_cond_destroy(&engine->changed);
+    RTSPByteBufferFree(&engine->fragment);
+    free(engine->pollfds);
+    free(engine->polled);
+    free(engine);
+}
+
+uint32_t RTSPRemuxEngineAddStream(RTSPRemuxEngineRef engine, const char *url,
+                                  const RTSPRemuxSink *sink, void *context) {
+    if (!engine || !url) {
+        return 0;
+    }
+    RTSPRemuxSession *s = calloc(1, sizeof(*s));
+    if (!s) {
+        return 0;
+    }
+    if (!RTSPURLParse(url, &s->url) || (s->url.secure && !RTSPTransportSupportsTLS())) {
+        free(s);
+        return 0;
+    }
+    if (sink) {
+        s->sink = *sink;
+    }
+    s->engine = engine;
+    s->context = context;
+    s->pendingCSeq = -1;
+    s->backoff = engine->config.reconnectDelay;
+    s->nextSequence = 1;
+    RTSPCodecConfigInit(&s->codecConfig, RTSPVideoCodecUnknown);
+    RTSPByteBufferInit(&s->input);
+    RTSPByteBufferInit(&s->output);
+    RTSPByteBufferInit(&s->pending);
+    RTSPByteBufferInit(&s->payload);
+    RTSPByteBufferInit(&s->segment);
+
+    pthread_mutex_lock(&engine->lock);
+    s->identifier = engine->nextIdentifier++;
+    s->next = engine->added;
+    engine->added = s;
+    uint32_t identifier = s->identifier;
+    pthread_mutex_unlock(&engine->lock);
+
+    RTSPRemuxWake(engine);
+    return identifier;
+}
+
+static RTSPRemuxSession *RTSPRemuxFind(RTSPRemuxSession *list, uint32_t identifier) {
+    for (RTSPRemuxSession *s = list; s; s = s->next) {
+        if (s->identifier == identifier) {
+            return s;
+        }
+    }
+    return NULL;
+}
+
+void RTSPRemuxEngineRemoveStream(RTSPRemuxEngineRef engine, uint32_t streamID) {
+    if (!engine || streamID == 0) {
+        return;
+    }
+    bool onLoop = pthread_equal(pthread_self(), engine->thread);
+
+    pthread_mutex_lock(&engine->lock);
+    RTSPRemuxSession *s = RTSPRemuxFind(engine->sessions, streamID);
+    if (!s) {
+        s = RTSPRemuxFind(engine->added, streamID);
+    }
+    if (s) {
+        s->removeRequested = true;
+    }
+    pthread_mutex_unlock(&engine->lock);
+    if (!s || onLoop) {
+        return; // On the loop thread the flag alone suppresses further callbacks
+    }
+
+    RTSPRemuxWake(engine);
+    pthread_mutex_lock(&engine->lock);
+    while (engine->running && (RTSPRemuxFind(engine->sessions, streamID) || RTSPRemuxFind(engine->added, streamID))) {
+        pthread_cond_wait(&engine->changed, &engine->lock);
+    }
+    pthread_mutex_unlock(&engine->lock);
+}
+
+bool RTSPRemuxEngineGetStatistics(RTSPRemuxEngineRef engine, uint32_t streamID,
+                                  RTSPRemuxStreamStatistics *statistics) {
+    if (!engine || !statistics) {
+        return false;
+    }
+    pthread_mutex_lock(&engine->lock);
+    RTSPRemuxSession *s = RTSPRemuxFind(engine->sessions, streamID);
+    if (!s) {
+        s = RTSPRemuxFind(engine->added, streamID);
+    }
+    if (s) {
+        *statistics = s->statistics;
+    }
+    pthread_mutex_unlock(&engine->lock);
+    return s != NULL;
+}
+
+size_t RTSPRemuxEngineStreamCount(RTSPRemuxEngineRef engine) {
+    if (!engine) {
+        return 0;
+    }
+    size_t count = 0;
+    pthread_mutex_lock(&engine->lock);
+    for (RTSPRemuxSession *s = engine->sessions; s; s = s->next) {
+        count += s->removeRequested ? 0 : 1;
+    }
+    for (RTSPRemuxSession *s = engine->added; s; s = s->next) {
+        count += s->removeRequested ? 0 : 1;
+    }
+    pthread_mutex_unlock(&engine->lock);
+    return count;
+}
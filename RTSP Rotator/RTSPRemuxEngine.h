@@ -0,0 +1,110 @@
+//
+//  RTSPRemuxEngine.h
+//  RTSP Rotator
+//
+//  In-process RTSP(S) to HLS/fMP4 remuxer. One event-loop thread terminates
+//  RTSP and TLS for every camera, reassembles RTP (interleaved over the
+//  RTSP connection) into access units and cuts stream-copied fMP4 segments
+//  at keyframes, optionally as a run of LL-HLS partial segments. No decoding
+//  or transcoding happens here; the output is what the cameras sent,
+//  repackaged. Playlists and the live window belong to the consumer
+//  (see RTSPHLSStore).
+//
+//  Replaces one ffmpeg process per RTSPS camera. Portable C so it can be
+//  benchmarked on Linux against the loopback server in Benchmarks/.
+//
+
+#ifndef RTSPRemuxEngine_h
+#define RTSPRemuxEngine_h
+
+#include "RTSPCodecConfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    double targetSegmentDuration;   // Seconds, segments are cut at the next keyframe after this. Default 2.0
+    double partTargetDuration;      // Seconds, upper bound for partial segments; 0 emits whole segments only. Default 0.2
+    double responseTimeout;         // Connect / RTSP reply / data stall timeout in seconds. Default 10
+    double reconnectDelay;          // Initial reconnect backoff in seconds, doubles up to 30. Default 2
+    bool verifyCertificates;        // Default false (UniFi and most NVRs use self-signed certificates)
+} RTSPRemuxConfig;
+
+void RTSPRemuxConfigInit(RTSPRemuxConfig *config);
+
+typedef enum {
+    RTSPRemuxStreamConnecting = 0,  // TCP connect, TLS handshake
+    RTSPRemuxStreamNegotiating,     // DESCRIBE / SETUP / PLAY
+    RTSPRemuxStreamPlaying,
+    RTSPRemuxStreamReconnecting     // Waiting out the backoff after a failure
+} RTSPRemuxStreamState;
+
+typedef struct {
+    RTSPRemuxStreamState state;
+    RTSPVideoCodec codec;
+    uint32_t width;
+    uint32_t height;
+    char codecString[32];           // RFC 6381, e.g. "avc1.64001f"
+    uint64_t bytesReceived;
+    uint64_t packets;
+    uint64_t lostPackets;
+    uint64_t accessUnits;
+    uint64_t segments;
+    uint32_t reconnects;
+} RTSPRemuxStreamStatistics;
+
+/// Describes one emitted part or segment
+typedef struct {
+    uint32_t sequence;              // Media sequence number of the (parent) segment
+    uint32_t part;                  // Part index within the segment; for a finished segment, its part count
+    uint32_t initID;                // Init segment the media is decoded with
+    double duration;                // Seconds
+    bool independent;               // Starts with a keyframe
+    bool discontinuity;             // First media after a reconnect or configuration change
+} RTSPRemuxMediaInfo;
+
+/// Output callbacks for one stream. All callbacks run on the engine thread
+/// and must not block; copy what is needed and return. Unused callbacks may be NULL.
+typedef struct {
+    /// New init segment; media emitted afterwards carries its ID
+    void (*initSegment)(void *context, uint32_t initID, const uint8_t *data, size_t length);
+
+    /// Partial segment (one moof + mdat), only when partTargetDuration > 0
+    void (*part)(void *context, const RTSPRemuxMediaInfo *info, const uint8_t *data, size_t length);
+
+    /// Finished media segment. With parts enabled its bytes are exactly the
+    /// concatenation of the parts already delivered for `info->sequence`.
+    void (*segment)(void *context, const RTSPRemuxMediaInfo *info, const uint8_t *data, size_t length);
+
+    /// Connection state change; `message` explains failures and may be NULL
+    void (*stateChanged)(void *context, RTSPRemuxStreamState state, const char *message);
+} RTSPRemuxSink;
+
+typedef struct RTSPRemuxEngine *RTSPRemuxEngineRef;
+
+/// Creates the engine and starts its thread. `config` may be NULL for defaults.
+RTSPRemuxEngineRef RTSPRemuxEngineCreate(const RTSPRemuxConfig *config);
+
+/// Stops every stream and joins the engine thread
+void RTSPRemuxEngineRelease(RTSPRemuxEngineRef engine);
+
+/// Start remuxing an rtsp:// or rtsps:// URL (credentials in the userinfo).
+/// Returns a stream ID, or 0 if the URL is invalid or TLS is unavailable.
+uint32_t RTSPRemuxEngineAddStream(RTSPRemuxEngineRef engine, const char *url,
+                                  const RTSPRemuxSink *sink, void *context);
+
+/// Stop a stream. Once this returns no further callbacks are made for it.
+void RTSPRemuxEngineRemoveStream(RTSPRemuxEngineRef engine, uint32_t streamID);
+
+/// Snapshot of a stream's counters. Returns false for unknown IDs.
+bool RTSPRemuxEngineGetStatistics(RTSPRemuxEngineRef engine, uint32_t streamID,
+                                  RTSPRemuxStreamStatistics *statistics);
+
+size_t RTSPRemuxEngineStreamCount(RTSPRemuxEngineRef engine);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RTSPRemuxEngine_h */
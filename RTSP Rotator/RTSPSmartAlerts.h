@@ -44,7 +44,7 @@ typedef NS_ENUM(NSInteger, RTSPAlertMode) {
 @property (nonatomic, weak) id<RTSPSmartAlertsDelegate> delegate;
 @property (nonatomic, assign) BOOL enabled;
 @property (nonatomic, assign) CGFloat confidenceThreshold; // 0.0-1.0, default: 0.5
-@property (nonatomic, assign) NSTimeInterval checkInterval; // default: 1.0
+@property (nonatomic, assign) NSTimeInterval checkInterval; // default: 1.0; with adaptive MLX inference, the longest gap between checks
 
 // MLX Integration
 @property (nonatomic, assign) BOOL useMLX; // Use MLX for detection (default: YES)
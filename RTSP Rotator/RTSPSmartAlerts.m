@@ -6,20 +6,27 @@
 //
 
 #import "RTSPSmartAlerts.h"
+#import "RTSPFFmpegProxy.h"
+#import "RTSPFrameBus.h"
+#import "RTSPMotionDetector.h"
 #import <UserNotifications/UserNotifications.h>
 #import <AppKit/AppKit.h>
+#import <QuartzCore/QuartzCore.h>
 
 @interface RTSPSmartAlerts () <RTSPObjectDetectorDelegate>
 
 @property (nonatomic, weak) AVPlayer *player;
 @property (nonatomic, copy) NSString *cameraID;
 @property (nonatomic, copy) NSString *cameraName;
-@property (nonatomic, strong) NSTimer *monitoringTimer;
+@property (nonatomic, strong) RTSPFrameBus *frameBus;
+@property (nonatomic, strong) id<NSObject> frameSubscription;
 @property (nonatomic, strong) RTSPObjectDetector *objectDetector;
+@property (nonatomic, strong) RTSPMotionDetector *motionDetector;             // Scores frames for adaptive inference
 @property (nonatomic, strong) NSMutableArray<RTSPDetectionEvent *> *alertHistoryList;
 @property (nonatomic, assign) NSInteger alertCount;
 @property (nonatomic, strong) NSDate *lastAlertTime;
 @property (nonatomic, strong) NSMutableDictionary<NSString *, NSDate *> *lastAlertByClass;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSDate *> *alertedTracks;    // trackingID -> last seen
 
 @end
 
@@ -57,6 +64,7 @@
     _alertCount = 0;
     _alertHistoryList = [NSMutableArray array];
     _lastAlertByClass = [NSMutableDictionary dictionary];
+    _alertedTracks = [NSMutableDictionary dictionary];
 
     if (_useMLX) {
         _objectDetector = [RTSPObjectDetector sharedDetector];
@@ -77,7 +85,7 @@
         return;
     }
 
-    if (self.monitoringTimer) {
+    if (self.frameSubscription) {
         NSLog(@"[SmartAlerts] Already monitoring");
         return;
     }
@@ -85,23 +93,38 @@
     if (self.useMLX) {
         // Enable MLX detection for this camera
         [self.objectDetector enableDetectionForCamera:self.cameraID zones:nil];
+        [self.objectDetector setFeedURL:[self feedURL] forCamera:self.cameraID];
     }
 
     if (self.player) {
-        // Start timer to extract and process frames
-        self.monitoringTimer = [NSTimer scheduledTimerWithTimeInterval:self.checkInterval
-                                                                target:self
-                                                              selector:@selector(analyzeFrame)
-                                                              userInfo:nil
-                                                               repeats:YES];
+        // With adaptive inference, frames come at the active rate and the
+        // processor skips most of them while the scene is still
+        double rate = 1.0 / MAX(self.checkInterval, 0.01);
+        RTSPMLXConfiguration *configuration = self.objectDetector.mlxProcessor.configuration;
+        if (self.useMLX && configuration.adaptiveInference) {
+            rate = MAX(rate, configuration.activeInferenceRate);
+            self.motionDetector = [[RTSPMotionDetector alloc] initWithPlayer:nil];
+        }
+
+        // Share the player's decoded frames instead of running our own decode
+        __weak typeof(self) weakSelf = self;
+        self.frameBus = [RTSPFrameBus busForPlayer:self.player];
+        self.frameSubscription = [self.frameBus addSubscriberWithRate:rate
+                                                                queue:nil
+                                                              handler:^(RTSPDecodedFrame *frame) {
+            [weakSelf analyzeFrame:frame];
+        }];
     }
 
     NSLog(@"[SmartAlerts] Started monitoring camera: %@", self.cameraName);
 }
 
 - (void)stopMonitoring {
-    [self.monitoringTimer invalidate];
-    self.monitoringTimer = nil;
+    if (self.frameSubscription) {
+        [self.frameBus removeSubscriber:self.frameSubscription];
+        self.frameSubscription = nil;
+    }
+    self.motionDetector = nil;
 
     if (self.useMLX) {
         [self.objectDetector disableDetectionForCamera:self.cameraID];
@@ -120,55 +143,39 @@
                                  name:self.cameraName];
 }
 
-- (void)analyzeFrame {
-    if (!self.player.currentItem) return;
-
-    // Get current frame from player
-    AVAssetImageGenerator *generator = [AVAssetImageGenerator assetImageGeneratorWithAsset:self.player.currentItem.asset];
-    generator.requestedTimeToleranceBefore = kCMTimeZero;
-    generator.requestedTimeToleranceAfter = kCMTimeZero;
-
-    CMTime currentTime = self.player.currentTime;
-
-    if (@available(macOS 13.0, *)) {
-        [generator generateCGImageAsynchronouslyForTime:currentTime completionHandler:^(CGImageRef imageRef, CMTime actualTime, NSError *error) {
-            if (imageRef) {
-                if (self.useMLX) {
-                    // Use MLX for detection
-                    [self.objectDetector.mlxProcessor processImage:imageRef completion:^(NSArray<RTSPDetection *> * _Nullable detections, NSError * _Nullable error) {
-                        if (detections && !error) {
-                            [self handleDetections:detections];
-                        }
-                    }];
-                } else {
-                    // Fallback to Vision framework
-                    [self performVisionAnalysis:imageRef];
-                }
+- (void)analyzeFrame:(RTSPDecodedFrame *)frame {
+    if (self.useMLX) {
+        RTSPMotionDetector *motionDetector = self.motionDetector;
+        float motionScore = motionDetector ? [motionDetector motionScoreForPixelBuffer:frame.pixelBuffer] : -1.0f;
+        [self.objectDetector.mlxProcessor processFrame:frame.pixelBuffer
+                                             forCamera:self.cameraID
+                                           motionScore:motionScore
+                                            captureTime:frame.hostTime
+                                            completion:^(NSArray<RTSPDetection *> * _Nullable detections, NSError * _Nullable error) {
+            if (detections && !error) {
+                [self handleDetections:detections];
             }
         }];
     } else {
-        // Fallback for macOS 11.0-12.x
-        NSError *error = nil;
-        CGImageRef imageRef = [generator copyCGImageAtTime:currentTime actualTime:NULL error:&error];
-        if (imageRef) {
-            if (self.useMLX) {
-                [self.objectDetector.mlxProcessor processImage:imageRef completion:^(NSArray<RTSPDetection *> * _Nullable detections, NSError * _Nullable error) {
-                    if (detections && !error) {
-                        [self handleDetections:detections];
-                    }
-                }];
-            } else {
-                [self performVisionAnalysis:imageRef];
-            }
-            CGImageRelease(imageRef);
-        }
+        // Fallback to Vision framework
+        [self performVisionAnalysis:frame.pixelBuffer];
     }
 }
 
 - (void)handleDetections:(NSArray<RTSPDetection *> *)detections {
     if (self.alertMode == RTSPAlertModeDisabled) return;
 
+    BOOL tracking = self.objectDetector.mlxProcessor.configuration.trackingEnabled;
+    [self pruneAlertedTracks];
+
     for (RTSPDetection *detection in detections) {
+        // Keep alerted tracks remembered while they are still in view
+        if (detection.isTracked && self.alertedTracks[detection.trackingID]) {
+            self.alertedTracks[detection.trackingID] = [NSDate date];
+            continue;
+        }
+        if (detection.isInterpolated) continue;
+
         // Check confidence threshold
         if (detection.confidence < self.confidenceThreshold) continue;
 
@@ -177,8 +184,14 @@
             continue;
         }
 
-        // Check cooldown
-        if ([self shouldCooldownForClass:detection.label]) {
+        if (detection.isTracked) {
+            // Tracked objects alert once, however long they stay in view
+            self.alertedTracks[detection.trackingID] = [NSDate date];
+        } else if (tracking) {
+            // Wait for the tracker to confirm it rather than alert on a blip
+            continue;
+        } else if ([self shouldCooldownForClass:detection.label]) {
+            // Check cooldown
             continue;
         }
 
@@ -187,6 +200,21 @@
     }
 }
 
+/// Forget tracks not seen for a minute; the tracker has ended them long before
+- (void)pruneAlertedTracks {
+    NSDate *cutoff = [NSDate dateWithTimeIntervalSinceNow:-60.0];
+    NSArray<NSString *> *stale = [self.alertedTracks keysOfEntriesPassingTest:^BOOL(NSString *key, NSDate *lastSeen, BOOL *stop) {
+        return [lastSeen compare:cutoff] == NSOrderedAscending;
+    }].allObjects;
+    [self.alertedTracks removeObjectsForKeys:stale];
+}
+
+/// URL the player streams from, which locates the camera's DVR recording
+- (nullable NSURL *)feedURL {
+    AVAsset *asset = self.player.currentItem.asset;
+    return [asset isKindOfClass:[AVURLAsset class]] ? ((AVURLAsset *)asset).URL : nil;
+}
+
 - (BOOL)shouldCooldownForClass:(NSString *)className {
     NSDate *lastAlert = self.lastAlertByClass[className];
     if (!lastAlert) return NO;
@@ -196,6 +224,8 @@
 }
 
 - (void)triggerAlertForDetection:(RTSPDetection *)detection {
+    CFTimeInterval dispatchStart = CACurrentMediaTime();
+
     // Create event
     RTSPDetectionEvent *event = [[RTSPDetectionEvent alloc] init];
     event.cameraID = self.cameraID;
@@ -203,6 +233,8 @@
     event.detection = detection;
     event.timestamp = [NSDate date];
     event.alertTriggered = YES;
+    NSURL *feedURL = [self feedURL];
+    NSDate *timestamp = event.timestamp;
 
     // Update statistics
     self.alertCount++;
@@ -230,26 +262,36 @@
         [self sendNotification:message detection:detection];
     }
 
-    // Notify delegate
-    dispatch_async(dispatch_get_main_queue(), ^{
-        if ([self.delegate respondsToSelector:@selector(smartAlerts:didTriggerAlert:forEvent:)]) {
-            [self.delegate smartAlerts:self didTriggerAlert:message forEvent:event];
-        }
+    // Notify delegate once the event points into the recording; the DVR
+    // lookup stays off the main thread, as in RTSPObjectDetector
+    dispatch_async(dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^{
+        RTSPDVRPosition *recording = feedURL ? [[RTSPFFmpegProxy sharedProxy] dvrPositionForURL:feedURL time:timestamp] : nil;
+        dispatch_async(dispatch_get_main_queue(), ^{
+            event.recording = recording;
 
-        if ([self.delegate respondsToSelector:@selector(smartAlerts:didDetectEvent:)]) {
-            [self.delegate smartAlerts:self didDetectEvent:event];
-        }
+            if ([self.delegate respondsToSelector:@selector(smartAlerts:didTriggerAlert:forEvent:)]) {
+                [self.delegate smartAlerts:self didTriggerAlert:message forEvent:event];
+            }
 
-        // Legacy delegate method
-        if ([self.delegate respondsToSelector:@selector(smartAlerts:didDetectObject:confidence:)]) {
-            RTSPDetectedObjectType type = [self objectTypeForClass:detection.label];
-            [self.delegate smartAlerts:self didDetectObject:type confidence:detection.confidence];
-        }
+            if ([self.delegate respondsToSelector:@selector(smartAlerts:didDetectEvent:)]) {
+                [self.delegate smartAlerts:self didDetectEvent:event];
+            }
+
+            // Legacy delegate method
+            if ([self.delegate respondsToSelector:@selector(smartAlerts:didDetectObject:confidence:)]) {
+                RTSPDetectedObjectType type = [self objectTypeForClass:detection.label];
+                [self.delegate smartAlerts:self didDetectObject:type confidence:detection.confidence];
+            }
+
+            [self.objectDetector.mlxProcessor recordLatency:CACurrentMediaTime() - dispatchStart
+                                                      stage:RTSPLatencyStageAlertDispatch
+                                                  forCamera:self.cameraID];
+        });
     });
 }
 
-- (void)performVisionAnalysis:(CGImageRef)imageRef {
-    VNImageRequestHandler *handler = [[VNImageRequestHandler alloc] initWithCGImage:imageRef options:@{}];
+- (void)performVisionAnalysis:(CVPixelBufferRef)pixelBuffer {
+    VNImageRequestHandler *handler = [[VNImageRequestHandler alloc] initWithCVPixelBuffer:pixelBuffer options:@{}];
 
     VNRecognizeAnimalsRequest *animalRequest = [[VNRecognizeAnimalsRequest alloc] initWithCompletionHandler:^(VNRequest *request, NSError *error) {
         if (error) return;
@@ -327,6 +369,7 @@
     self.alertCount = 0;
     self.lastAlertTime = nil;
     [self.lastAlertByClass removeAllObjects];
+    [self.alertedTracks removeAllObjects];
     [self.alertHistoryList removeAllObjects];
 
     NSLog(@"[SmartAlerts] Statistics reset");
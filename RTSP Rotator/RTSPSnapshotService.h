@@ -0,0 +1,66 @@
+//
+//  RTSPSnapshotService.h
+//  RTSP Rotator
+//
+//  Saves snapshots without touching the main thread. The frame comes from
+//  the camera's RTSPFrameBus (the one already decoded for display), is
+//  encoded straight from its NV12 planes by RTSPJPEGEncoder on a worker
+//  pool, and is written by RTSPSnapshotWriter, which makes a burst of files
+//  durable with shared syncs. Snapshotting every camera at once costs one
+//  encode per camera spread across the pool.
+//
+//  The format follows the file extension: .jpg / .jpeg through the NV12
+//  encoder; .heic and .png through ImageIO, still off the main thread. WebP
+//  is not offered: ImageIO reads it but cannot write it.
+//
+
+#import <Foundation/Foundation.h>
+#import <AVFoundation/AVFoundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef NS_ENUM(NSInteger, RTSPSnapshotError) {
+    RTSPSnapshotErrorNoFrame = 1001,        // The player has no decoded frame
+    RTSPSnapshotErrorUnsupportedFormat,     // Extension other than jpg, jpeg, heic, png
+    RTSPSnapshotErrorEncodeFailed,
+    RTSPSnapshotErrorBusy,                  // Writer queue full
+    RTSPSnapshotErrorTimedOut,              // No frame, or not written, within 5 s
+};
+
+@interface RTSPSnapshotService : NSObject
+
++ (instancetype)sharedService;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/// JPEG and HEIF quality, 0.0-1.0 (default: 0.8)
+@property (nonatomic, assign) double quality;
+
+/**
+ * Save the player's current frame. The file appears under its final name
+ * only once it is complete and on disk.
+ * @param completion Called once on the main queue with the path or an
+ *                   error; a camera that stalls fails with
+ *                   RTSPSnapshotErrorTimedOut
+ */
+- (void)saveSnapshotOfPlayer:(AVPlayer *)player
+                      toFile:(NSString *)filePath
+                  completion:(nullable void (^)(NSString * _Nullable filePath, NSError * _Nullable error))completion;
+
+/**
+ * Save the current frame of every camera being played (see
+ * +[RTSPFrameBus allBuses]) into a directory, as JPEG.
+ * @param completion Called once on the main queue when every camera has
+ *                   saved or failed; stalled cameras time out with an error
+ */
+- (void)saveSnapshotsOfAllCamerasToDirectory:(NSString *)directory
+                                  completion:(nullable void (^)(NSArray<NSString *> *filePaths,
+                                                                NSArray<NSError *> *errors))completion;
+
+/// Statistics: submitted, encoded, written, failed, rejected, syncs,
+/// largestSync, bytes, encodeMilliseconds
+- (NSDictionary<NSString *, NSNumber *> *)statistics;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,265 @@
+//
+//  RTSPSnapshotService.m
+//  RTSP Rotator
+//
+
+#import "RTSPSnapshotService.h"
+#import "RTSPFrameBus.h"
+#import "RTSPSnapshotWriter.h"
+#import <ImageIO/ImageIO.h>
+#import <UniformTypeIdentifiers/UniformTypeIdentifiers.h>
+
+static NSString * const kRTSPSnapshotErrorDomain = @"RTSPSnapshotService";
+static const NSTimeInterval kRTSPSnapshotMaximumFrameAge = 0.5;
+static const NSTimeInterval kRTSPSnapshotTimeout = 5.0;     // Frame, encode and write
+
+/// Owned by one writer job, from submit until its completion has run
+typedef struct {
+    CVPixelBufferRef pixelBuffer;   // Locked read-only while the writer reads it
+    CFTypeRef encoded;              // NSData for ImageIO formats
+    CFTypeRef completion;           // void (^)(NSString *, NSError *)
+} RTSPSnapshotContext;
+
+static void RTSPSnapshotRelease(void *context) {
+    RTSPSnapshotContext *snapshot = context;
+    if (snapshot->pixelBuffer) {
+        CVPixelBufferUnlockBaseAddress(snapshot->pixelBuffer, kCVPixelBufferLock_ReadOnly);
+        CVPixelBufferRelease(snapshot->pixelBuffer);
+        snapshot->pixelBuffer = NULL;
+    }
+    if (snapshot->encoded) {
+        CFRelease(snapshot->encoded);
+        snapshot->encoded = NULL;
+    }
+}
+
+static void RTSPSnapshotComplete(void *context, const char *path, int error) {
+    RTSPSnapshotContext *snapshot = context;
+    void (^completion)(NSString *, NSError *) = CFBridgingRelease(snapshot->completion);
+    free(snapshot);
+    NSString *filePath = [NSString stringWithUTF8String:path];
+    NSError *writeError = error ? [NSError errorWithDomain:NSPOSIXErrorDomain
+                                                      code:error
+                                                  userInfo:@{NSFilePathErrorKey: filePath}] : nil;
+    if (writeError) {
+        NSLog(@"[Snapshot] Failed to save %@: %s", filePath, strerror(error));
+    }
+    dispatch_async(dispatch_get_main_queue(), ^{
+        completion(writeError ? nil : filePath, writeError);
+    });
+}
+
+@implementation RTSPSnapshotService {
+    RTSPSnapshotWriterRef _writer;
+}
+
++ (instancetype)sharedService {
+    static RTSPSnapshotService *shared;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        shared = [[RTSPSnapshotService alloc] initService];
+    });
+    return shared;
+}
+
+- (instancetype)initService {
+    self = [super init];
+    if (self) {
+        _quality = 0.8;
+        RTSPSnapshotWriterConfig config;
+        RTSPSnapshotWriterConfigInit(&config);
+        _writer = RTSPSnapshotWriterCreate(&config);
+        if (!_writer) {
+            NSLog(@"[Snapshot] Could not start the snapshot writer");
+        }
+    }
+    return self;
+}
+
+- (void)dealloc {
+    RTSPSnapshotWriterRelease(_writer);
+}
+
+- (NSError *)errorWithCode:(RTSPSnapshotError)code description:(NSString *)description {
+    return [NSError errorWithDomain:kRTSPSnapshotErrorDomain code:code userInfo:@{NSLocalizedDescriptionKey: description}];
+}
+
+#pragma mark - Snapshots
+
+- (void)saveSnapshotOfPlayer:(AVPlayer *)player
+                      toFile:(NSString *)filePath
+                  completion:(void (^)(NSString * _Nullable, NSError * _Nullable))completion {
+    // Every path reaches finish on the main queue; the first one wins, so a
+    // stalled camera reports a timeout instead of holding up its caller
+    __block BOOL finished = NO;
+    void (^finish)(NSString *, NSError *) = ^(NSString *path, NSError *error) {
+        if (finished) {
+            return;
+        }
+        finished = YES;
+        if (completion) completion(path, error);
+    };
+    void (^fail)(NSError *) = ^(NSError *error) {
+        NSLog(@"[Snapshot] %@: %@", filePath.lastPathComponent, error.localizedDescription);
+        dispatch_async(dispatch_get_main_queue(), ^{
+            finish(nil, error);
+        });
+    };
+
+    NSString *extension = filePath.pathExtension.lowercaseString;
+    UTType *type = [UTType typeWithFilenameExtension:extension];
+    BOOL jpeg = [type conformsToType:UTTypeJPEG];
+    if (!jpeg && ![type conformsToType:UTTypeHEIC] && ![type conformsToType:UTTypePNG]) {
+        fail([self errorWithCode:RTSPSnapshotErrorUnsupportedFormat
+                     description:[NSString stringWithFormat:@"Snapshots cannot be saved as .%@", extension]]);
+        return;
+    }
+    [[NSFileManager defaultManager] createDirectoryAtPath:[filePath stringByDeletingLastPathComponent]
+                              withIntermediateDirectories:YES
+                                               attributes:nil
+                                                    error:nil];
+
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(kRTSPSnapshotTimeout * NSEC_PER_SEC)),
+                   dispatch_get_main_queue(), ^{
+        if (!finished) {
+            NSLog(@"[Snapshot] %@: timed out", filePath.lastPathComponent);
+            finish(nil, [self errorWithCode:RTSPSnapshotErrorTimedOut
+                                description:@"The camera did not provide a frame in time"]);
+        }
+    });
+
+    double quality = self.quality;
+    [[RTSPFrameBus busForPlayer:player] requestFrameWithMaximumAge:kRTSPSnapshotMaximumFrameAge
+                                                        completion:^(RTSPDecodedFrame *frame) {
+        if (!frame) {
+            fail([self errorWithCode:RTSPSnapshotErrorNoFrame description:@"No decoded frame available"]);
+            return;
+        }
+        OSType format = CVPixelBufferGetPixelFormatType(frame.pixelBuffer);
+        BOOL nv12 = format == kCVPixelFormatType_420YpCbCr8BiPlanarFullRange ||
+                    format == kCVPixelFormatType_420YpCbCr8BiPlanarVideoRange;
+        if (jpeg && nv12) {
+            // Encode straight from the decoder's planes; the writer unlocks them
+            RTSPSnapshotContext *context = calloc(1, sizeof(*context));
+            CVPixelBufferRef pixelBuffer = CVPixelBufferRetain(frame.pixelBuffer);
+            CVPixelBufferLockBaseAddress(pixelBuffer, kCVPixelBufferLock_ReadOnly);
+            context->pixelBuffer = pixelBuffer;
+            RTSPSnapshotJob job = {0};
+            job.image.luma = CVPixelBufferGetBaseAddressOfPlane(pixelBuffer, 0);
+            job.image.lumaBytesPerRow = CVPixelBufferGetBytesPerRowOfPlane(pixelBuffer, 0);
+            job.image.chroma = CVPixelBufferGetBaseAddressOfPlane(pixelBuffer, 1);
+            job.image.chromaBytesPerRow = CVPixelBufferGetBytesPerRowOfPlane(pixelBuffer, 1);
+            job.image.width = (uint32_t)CVPixelBufferGetWidth(pixelBuffer);
+            job.image.height = (uint32_t)CVPixelBufferGetHeight(pixelBuffer);
+            job.image.videoRange = format == kCVPixelFormatType_420YpCbCr8BiPlanarVideoRange;
+            job.quality = (uint32_t)lround(MIN(MAX(quality, 0.01), 1.0) * 100.0);
+            [self submitJob:&job context:context path:filePath completion:finish failure:fail];
+            return;
+        }
+        // HEIF and PNG (or a frame that is not NV12) go through ImageIO, off
+        // the bus queue, and are then written like any other
+        dispatch_async(dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+            NSData *data = [self encodedDataForFrame:frame type:(jpeg ? UTTypeJPEG : type) quality:quality];
+            if (!data) {
+                fail([self errorWithCode:RTSPSnapshotErrorEncodeFailed description:@"Could not encode the frame"]);
+                return;
+            }
+            RTSPSnapshotContext *context = calloc(1, sizeof(*context));
+            context->encoded = CFBridgingRetain(data);
+            RTSPSnapshotJob job = {0};
+            job.encoded = data.bytes;
+            job.encodedLength = data.length;
+            [self submitJob:&job context:context path:filePath completion:finish failure:fail];
+        });
+    }];
+}
+
+- (void)submitJob:(RTSPSnapshotJob *)job
+          context:(RTSPSnapshotContext *)context
+             path:(NSString *)filePath
+       completion:(void (^)(NSString *, NSError *))completion
+          failure:(void (^)(NSError *))failure {
+    context->completion = CFBridgingRetain([completion copy]);
+    job->path = filePath.fileSystemRepresentation;
+    job->release = RTSPSnapshotRelease;
+    job->completion = RTSPSnapshotComplete;
+    job->context = context;
+    if (!RTSPSnapshotWriterSubmit(_writer, job)) {
+        RTSPSnapshotRelease(context);
+        CFRelease(context->completion);
+        free(context);
+        failure([self errorWithCode:RTSPSnapshotErrorBusy description:@"Too many snapshots in progress"]);
+    }
+}
+
+- (nullable NSData *)encodedDataForFrame:(RTSPDecodedFrame *)frame type:(UTType *)type quality:(double)quality {
+    CGImageRef image = [frame copyCGImage];
+    if (!image) {
+        return nil;
+    }
+    NSMutableData *data = [NSMutableData data];
+    CGImageDestinationRef destination = CGImageDestinationCreateWithData((__bridge CFMutableDataRef)data,
+                                                                         (__bridge CFStringRef)type.identifier, 1, NULL);
+    BOOL encoded = NO;
+    if (destination) {
+        CGImageDestinationAddImage(destination, image,
+                                   (__bridge CFDictionaryRef)@{(id)kCGImageDestinationLossyCompressionQuality: @(quality)});
+        encoded = CGImageDestinationFinalize(destination);
+        CFRelease(destination);
+    }
+    CGImageRelease(image);
+    return encoded ? data : nil;
+}
+
+- (void)saveSnapshotsOfAllCamerasToDirectory:(NSString *)directory
+                                  completion:(void (^)(NSArray<NSString *> *, NSArray<NSError *> *))completion {
+    NSDateFormatter *formatter = [[NSDateFormatter alloc] init];
+    formatter.dateFormat = @"yyyy-MM-dd_HH-mm-ss";
+    NSString *timestamp = [formatter stringFromDate:[NSDate date]];
+
+    NSMutableArray<NSString *> *filePaths = [NSMutableArray array];
+    NSMutableArray<NSError *> *errors = [NSMutableArray array];
+    dispatch_group_t group = dispatch_group_create();
+    NSArray<RTSPFrameBus *> *buses = [RTSPFrameBus allBuses];
+    [buses enumerateObjectsUsingBlock:^(RTSPFrameBus *bus, NSUInteger index, BOOL *stop) {
+        AVPlayer *player = bus.player;
+        if (!player) {
+            return;
+        }
+        NSString *filename = [NSString stringWithFormat:@"rtsp_snapshot_%@_%02lu.jpg", timestamp, (unsigned long)index + 1];
+        dispatch_group_enter(group);
+        [self saveSnapshotOfPlayer:player
+                            toFile:[directory stringByAppendingPathComponent:filename]
+                        completion:^(NSString *filePath, NSError *error) {
+            // Main queue
+            if (filePath) {
+                [filePaths addObject:filePath];
+            } else {
+                [errors addObject:error];
+            }
+            dispatch_group_leave(group);
+        }];
+    }];
+    dispatch_group_notify(group, dispatch_get_main_queue(), ^{
+        NSLog(@"[Snapshot] Saved %lu of %lu cameras to %@", (unsigned long)filePaths.count,
+              (unsigned long)buses.count, directory);
+        if (completion) completion(filePaths, errors);
+    });
+}
+
+- (NSDictionary<NSString *, NSNumber *> *)statistics {
+    RTSPSnapshotWriterStatistics statistics = RTSPSnapshotWriterGetStatistics(_writer);
+    return @{
+        @"submitted": @(statistics.submitted),
+        @"encoded": @(statistics.encoded),
+        @"written": @(statistics.written),
+        @"failed": @(statistics.failed),
+        @"rejected": @(statistics.rejected),
+        @"syncs": @(statistics.syncs),
+        @"largestSync": @(statistics.largestSync),
+        @"bytes": @(statistics.bytes),
+        @"encodeMilliseconds": @(statistics.encodeSeconds * 1000.0),
+    };
+}
+
+@end
@@ -0,0 +1,478 @@
+//
+//  RTSPSnapshotWriter.c
+//  RTSP Rotator
+//
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE     // pthread_setname_np
+#endif
+
+#include "RTSPSnapshotWriter.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct RTSPSnapshotTask {
+    struct RTSPSnapshotTask *next;
+    RTSPSnapshotJob job;
+    char *path;                     // Owned; job.path points here
+    char *temporaryPath;
+    int fd;                         // Temporary file, open until the sync thread is done with it
+    int error;
+    size_t length;
+    bool encoded;                   // By a worker, for the statistics
+    double encodeSeconds;
+} RTSPSnapshotTask;
+
+typedef struct {
+    RTSPSnapshotWriterRef writer;
+    pthread_t thread;
+    bool started;
+    RTSPJPEGEncoderRef encoder;
+    RTSPByteBuffer output;          // Reused for every frame the worker encodes
+} RTSPSnapshotWorker;
+
+struct RTSPSnapshotWriter {
+    RTSPSnapshotWriterConfig config;
+
+    pthread_mutex_t lock;           // Guards everything below
+    pthread_cond_t changed;         // Job queued, file written, group completed, or stopping
+    bool running;
+    RTSPSnapshotTask *queueHead;    // Waiting for a worker
+    RTSPSnapshotTask *queueTail;
+    uint32_t queued;
+    uint32_t busy;                  // Workers encoding or writing
+    RTSPSnapshotTask *writtenHead;  // Waiting for the sync thread
+    RTSPSnapshotTask *writtenTail;
+    uint64_t accepted;
+    uint64_t completed;
+    RTSPSnapshotWriterStatistics statistics;
+
+    RTSPSnapshotWorker *workers;
+    pthread_t syncThread;
+    bool syncStarted;
+};
+
+static double RTSPSnapshotNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/// pthread_cond_timedwait takes a wall-clock deadline; only the length matters here
+static void RTSPSnapshotWait(RTSPSnapshotWriterRef writer, double seconds) {
+    if (seconds < 0) {
+        pthread_cond_wait(&writer->changed, &writer->lock);
+        return;
+    }
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    long long nanoseconds = deadline.tv_nsec + (long long)(seconds * 1e9);
+    deadline.tv_sec += (time_t)(nanoseconds / 1000000000);
+    deadline.tv_nsec = (long)(nanoseconds % 1000000000);
+    pthread_cond_timedwait(&writer->changed, &writer->lock, &deadline);
+}
+
+void RTSPSnapshotWriterConfigInit(RTSPSnapshotWriterConfig *config) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    config->workers = cpus < 2 ? 2 : cpus > 16 ? 16 : (uint32_t)cpus;
+    config->quality = 80;
+    config->maxQueued = 64;
+    config->syncFiles = true;
+    config->syncDelay = 0.02;
+    config->backend = RTSPJPEGEncoderBackendAuto;
+}
+
+static void RTSPSnapshotTaskFree(RTSPSnapshotTask *task) {
+    free(task->path);
+    free(task->temporaryPath);
+    free(task);
+}
+
+#pragma mark - Workers
+
+static bool RTSPSnapshotWriteAll(int fd, const uint8_t *data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        length -= (size_t)written;
+    }
+    return true;
+}
+
+/// Encodes if needed and writes the temporary file. Lock not held.
+static void RTSPSnapshotProcess(RTSPSnapshotWorker *worker, RTSPSnapshotTask *task) {
+    RTSPSnapshotJob *job = &task->job;
+    const uint8_t *data = job->encoded;
+    size_t length = job->encodedLength;
+    if (!data) {
+        RTSPJPEGEncoderSetQuality(worker->encoder, job->quality ? job->quality : worker->writer->config.quality);
+        RTSPByteBufferReset(&worker->output);
+        double start = RTSPSnapshotNow();
+        bool encoded = RTSPJPEGEncoderEncode(worker->encoder, &job->image, &worker->output);
+        task->encodeSeconds = RTSPSnapshotNow() - start;
+        task->encoded = encoded;
+        // The frame can go back to the decoder before the disk is touched
+        if (job->release) {
+            job->release(job->context);
+        }
+        if (!encoded) {
+            task->error = worker->output.failed ? ENOMEM : EINVAL;
+            return;
+        }
+        data = worker->output.data;
+        length = worker->output.length;
+    }
+
+    task->fd = open(task->temporaryPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (task->fd < 0) {
+        task->error = errno;
+    } else if (!RTSPSnapshotWriteAll(task->fd, data, length)) {
+        task->error = errno;
+        close(task->fd);
+        task->fd = -1;
+        unlink(task->temporaryPath);
+    } else {
+        task->length = length;
+    }
+    if (job->encoded && job->release) {
+        job->release(job->context);
+    }
+}
+
+static void *RTSPSnapshotWorkerThread(void *argument) {
+    RTSPSnapshotWorker *worker = argument;
+    RTSPSnapshotWriterRef writer = worker->writer;
+#if defined(__APPLE__)
+    pthread_setname_np("com.rtsp.snapshot");
+#elif defined(__linux__)
+    pthread_setname_np(pthread_self(), "rtsp-snapshot");
+#endif
+
+    pthread_mutex_lock(&writer->lock);
+    for (;;) {
+        while (writer->running && !writer->queueHead) {
+            RTSPSnapshotWait(writer, -1);
+        }
+        // Queued jobs are finished even when stopping
+        RTSPSnapshotTask *task = writer->queueHead;
+        if (!task) {
+            break;
+        }
+        writer->queueHead = task->next;
+        if (!writer->queueHead) {
+            writer->queueTail = NULL;
+        }
+        writer->queued--;
+        writer->busy++;
+        pthread_mutex_unlock(&writer->lock);
+
+        RTSPSnapshotProcess(worker, task);
+
+        pthread_mutex_lock(&writer->lock);
+        writer->busy--;
+        task->next = NULL;
+        if (writer->writtenTail) {
+            writer->writtenTail->next = task;
+        } else {
+            writer->writtenHead = task;
+        }
+        writer->writtenTail = task;
+        pthread_cond_broadcast(&writer->changed);
+    }
+    pthread_mutex_unlock(&writer->lock);
+    return NULL;
+}
+
+#pragma mark - Sync
+
+/// Length of the directory part of a path, 0 for none
+static size_t RTSPSnapshotDirectoryLength(const char *path) {
+    const char *slash = strrchr(path, '/');
+    return slash ? (size_t)(slash - path) + (slash == path) : 0;
+}
+
+static int RTSPSnapshotSyncDirectory(const char *path, size_t length) {
+    char directory[4096];
+    if (length == 0) {
+        directory[0] = '.';
+        length = 1;
+    } else if (length < sizeof(directory)) {
+        memcpy(directory, path, length);
+    } else {
+        return ENAMETOOLONG;
+    }
+    directory[length] = '\0';
+    int fd = open(directory, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return errno;
+    }
+    int error = fsync(fd) == 0 ? 0 : errno;
+    close(fd);
+    return error;
+}
+
+/// Makes one group durable: data, then names, then each directory once
+static void RTSPSnapshotSyncGroup(RTSPSnapshotWriterRef writer, RTSPSnapshotTask *group) {
+    bool sync = writer->config.syncFiles;
+    for (RTSPSnapshotTask *task = group; task; task = task->next) {
+        if (task->fd < 0) {
+            continue;
+        }
+        if (!task->error && sync && fsync(task->fd) != 0) {
+            task->error = errno;
+        }
+        close(task->fd);
+        task->fd = -1;
+        if (!task->error && rename(task->temporaryPath, task->path) != 0) {
+            task->error = errno;
+        }
+        if (task->error) {
+            unlink(task->temporaryPath);
+        }
+    }
+    if (!sync) {
+        return;
+    }
+    for (RTSPSnapshotTask *task = group; task; task = task->next) {
+        if (task->error) {
+            continue;
+        }
+        // Once per directory: skip it if an earlier file in the group shares it
+        size_t length = RTSPSnapshotDirectoryLength(task->path);
+        bool seen = false;
+        for (RTSPSnapshotTask *earlier = group; earlier != task && !seen; earlier = earlier->next) {
+            seen = !earlier->error && RTSPSnapshotDirectoryLength(earlier->path) == length &&
+                   memcmp(earlier->path, task->path, length) == 0;
+        }
+        if (seen) {
+            continue;
+        }
+        int error = RTSPSnapshotSyncDirectory(task->path, length);
+        if (error) {
+            for (RTSPSnapshotTask *other = task; other; other = other->next) {
+                if (!other->error && RTSPSnapshotDirectoryLength(other->path) == length &&
+                    memcmp(other->path, task->path, length) == 0) {
+                    other->error = error;
+                }
+            }
+        }
+    }
+}
+
+static void *RTSPSnapshotSyncThread(void *argument) {
+    RTSPSnapshotWriterRef writer = argument;
+#if defined(__APPLE__)
+    pthread_setname_np("com.rtsp.snapshot.sync");
+#elif defined(__linux__)
+    pthread_setname_np(pthread_self(), "rtsp-snapsync");
+#endif
+
+    pthread_mutex_lock(&writer->lock);
+    for (;;) {
+        while (!writer->writtenHead && (writer->running || writer->queueHead || writer->busy)) {
+            RTSPSnapshotWait(writer, -1);
+        }
+        if (!writer->writtenHead) {
+            break;
+        }
+        // Give files still being encoded a chance to join this group
+        if (writer->config.syncFiles && writer->config.syncDelay > 0) {
+            double deadline = RTSPSnapshotNow() + writer->config.syncDelay;
+            double now;
+            while ((writer->queueHead || writer->busy) && (now = RTSPSnapshotNow()) < deadline) {
+                RTSPSnapshotWait(writer, deadline - now);
+            }
+        }
+        RTSPSnapshotTask *group = writer->writtenHead;
+        writer->writtenHead = writer->writtenTail = NULL;
+        pthread_mutex_unlock(&writer->lock);
+
+        RTSPSnapshotSyncGroup(writer, group);
+
+        uint32_t count = 0;
+        pthread_mutex_lock(&writer->lock);
+        RTSPSnapshotWriterStatistics *statistics = &writer->statistics;
+        for (RTSPSnapshotTask *task = group; task; task = task->next) {
+            count++;
+            statistics->encoded += task->encoded;
+            statistics->encodeSeconds += task->encodeSeconds;
+            if (task->error) {
+                statistics->failed++;
+            } else {
+                statistics->written++;
+                statistics->bytes += task->length;
+            }
+        }
+        statistics->syncs++;
+        if (count > statistics->largestSync) {
+            statistics->largestSync = count;
+        }
+        pthread_mutex_unlock(&writer->lock);
+
+        while (group) {
+            RTSPSnapshotTask *next = group->next;
+            if (group->job.completion) {
+                group->job.completion(group->job.context, group->path, group->error);
+            }
+            RTSPSnapshotTaskFree(group);
+            group = next;
+        }
+
+        pthread_mutex_lock(&writer->lock);
+        writer->completed += count;
+        pthread_cond_broadcast(&writer->changed);
+    }
+    pthread_mutex_unlock(&writer->lock);
+    return NULL;
+}
+
+#pragma mark - Lifecycle
+
+RTSPSnapshotWriterRef RTSPSnapshotWriterCreate(const RTSPSnapshotWriterConfig *config) {
+    RTSPSnapshotWriterRef writer = calloc(1, sizeof(*writer));
+    if (!writer) {
+        return NULL;
+    }
+    if (config) {
+        writer->config = *config;
+    } else {
+        RTSPSnapshotWriterConfigInit(&writer->config);
+    }
+    RTSPSnapshotWriterConfig *c = &writer->config;
+    if (c->workers == 0) c->workers = 1;
+    if (c->maxQueued == 0) c->maxQueued = 1;
+
+    pthread_mutex_init(&writer->lock, NULL);
+    pthread_cond_init(&writer->changed, NULL);
+    writer->running = true;
+    writer->workers = calloc(c->workers, sizeof(*writer->workers));
+    bool ok = writer->workers != NULL;
+    RTSPJPEGEncoderConfig encoderConfig = {c->quality, c->backend};
+    for (uint32_t i = 0; ok && i < c->workers; i++) {
+        RTSPSnapshotWorker *worker = &writer->workers[i];
+        worker->writer = writer;
+        RTSPByteBufferInit(&worker->output);
+        worker->encoder = RTSPJPEGEncoderCreate(&encoderConfig);
+        ok = worker->encoder && pthread_create(&worker->thread, NULL, RTSPSnapshotWorkerThread, worker) == 0;
+        worker->started = ok;
+    }
+    if (ok) {
+        ok = pthread_create(&writer->syncThread, NULL, RTSPSnapshotSyncThread, writer) == 0;
+        writer->syncStarted = ok;
+    }
+    if (!ok) {
+        RTSPSnapshotWriterRelease(writer);
+        return NULL;
+    }
+    return writer;
+}
+
+void RTSPSnapshotWriterRelease(RTSPSnapshotWriterRef writer) {
+    if (!writer) {
+        return;
+    }
+    pthread_mutex_lock(&writer->lock);
+    writer->running = false;
+    pthread_cond_broadcast(&writer->changed);
+    pthread_mutex_unlock(&writer->lock);
+
+    for (uint32_t i = 0; writer->workers && i < writer->config.workers; i++) {
+        RTSPSnapshotWorker *worker = &writer->workers[i];
+        if (worker->started) {
+            pthread_join(worker->thread, NULL);
+        }
+        RTSPJPEGEncoderRelease(worker->encoder);
+        RTSPByteBufferFree(&worker->output);
+    }
+    if (writer->syncStarted) {
+        pthread_join(writer->syncThread, NULL);
+    }
+    pthread_cond_destroy(&writer->changed);
+    pthread_mutex_destroy(&writer->lock);
+    free(writer->workers);
+    free(writer);
+}
+
+#pragma mark - Jobs
+
+bool RTSPSnapshotWriterSubmit(RTSPSnapshotWriterRef writer, const RTSPSnapshotJob *job) {
+    if (!writer || !job || !job->path || (!job->encoded && (!job->image.luma || !job->image.chroma))) {
+        return false;
+    }
+    RTSPSnapshotTask *task = calloc(1, sizeof(*task));
+    size_t length = strlen(job->path);
+    if (task) {
+        task->path = malloc(length + 1);
+        task->temporaryPath = malloc(length + 5);
+    }
+    if (!task || !task->path || !task->temporaryPath) {
+        if (task) {
+            RTSPSnapshotTaskFree(task);
+        }
+        return false;
+    }
+    memcpy(task->path, job->path, length + 1);
+    memcpy(task->temporaryPath, job->path, length);
+    memcpy(task->temporaryPath + length, ".tmp", 5);
+    task->job = *job;
+    task->job.path = task->path;
+    task->fd = -1;
+
+    pthread_mutex_lock(&writer->lock);
+    bool accepted = writer->running && writer->queued < writer->config.maxQueued;
+    if (accepted) {
+        if (writer->queueTail) {
+            writer->queueTail->next = task;
+        } else {
+            writer->queueHead = task;
+        }
+        writer->queueTail = task;
+        writer->queued++;
+        writer->accepted++;
+        writer->statistics.submitted++;
+        pthread_cond_broadcast(&writer->changed);
+    } else {
+        writer->statistics.rejected++;
+    }
+    pthread_mutex_unlock(&writer->lock);
+    if (!accepted) {
+        RTSPSnapshotTaskFree(task);
+    }
+    return accepted;
+}
+
+void RTSPSnapshotWriterWait(RTSPSnapshotWriterRef writer) {
+    if (!writer) {
+        return;
+    }
+    pthread_mutex_lock(&writer->lock);
+    uint64_t target = writer->accepted;
+    while (writer->completed < target) {
+        RTSPSnapshotWait(writer, -1);
+    }
+    pthread_mutex_unlock(&writer->lock);
+}
+
+RTSPSnapshotWriterStatistics RTSPSnapshotWriterGetStatistics(RTSPSnapshotWriterRef writer) {
+    RTSPSnapshotWriterStatistics statistics = {0};
+    if (!writer) {
+        return statistics;
+    }
+    pthread_mutex_lock(&writer->lock);
+    statistics = writer->statistics;
+    pthread_mutex_unlock(&writer->lock);
+    return statistics;
+}
@@ -0,0 +1,90 @@
+//
+//  RTSPSnapshotWriter.h
+//  RTSP Rotator
+//
+//  Encodes and saves snapshots off the caller's thread. A pool of worker
+//  threads, each with its own RTSPJPEGEncoder, encodes NV12 frames (or
+//  takes bytes that are already encoded) and writes each to a temporary
+//  file. One sync thread then makes finished files durable in groups: it
+//  waits until the workers are idle or syncDelay has passed, fsyncs every
+//  file in the group, renames them into place and fsyncs each directory
+//  once, so a burst of snapshots (every camera at once) shares one round
+//  of directory syncs and nobody waits on a sync of their own.
+//
+//  Thread-safe: submit from any thread. See Benchmarks/snapshot_bench.c.
+//
+
+#ifndef RTSPSnapshotWriter_h
+#define RTSPSnapshotWriter_h
+
+#include "RTSPJPEGEncoder.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t workers;               // Encoding threads. Default: online CPUs, 2-16
+    uint32_t quality;               // JPEG quality for jobs that do not set one. Default 80
+    uint32_t maxQueued;             // Jobs waiting for a worker before Submit refuses more. Default 64
+    bool syncFiles;                 // fsync files and directories before completing. Default true
+    double syncDelay;               // Seconds a written file may wait for others to share its sync. Default 0.02
+    RTSPJPEGEncoderBackend backend; // Default Auto
+} RTSPSnapshotWriterConfig;
+
+void RTSPSnapshotWriterConfigInit(RTSPSnapshotWriterConfig *config);
+
+typedef struct {
+    RTSPJPEGImage image;            // Encoded as JPEG unless `encoded` is set
+    uint32_t quality;               // 0 = the writer's
+    const uint8_t *encoded;         // Bytes to write as they are (another format, or a cached JPEG)
+    size_t encodedLength;
+    const char *path;               // Copied. Written as <path>.tmp, renamed once durable
+    /// Called once the image planes or encoded bytes are no longer read,
+    /// on a worker thread. Optional.
+    void (*release)(void *context);
+    /// Called once per accepted job when its file is in place (error 0) or
+    /// has failed (an errno value), on the sync thread. Optional.
+    void (*completion)(void *context, const char *path, int error);
+    void *context;
+} RTSPSnapshotJob;
+
+typedef struct {
+    uint64_t submitted;
+    uint64_t encoded;               // JPEG encodes by the workers
+    uint64_t written;               // Files in place
+    uint64_t failed;
+    uint64_t rejected;              // Refused by Submit: queue full or writer stopping
+    uint64_t syncs;                 // Groups made durable together
+    uint32_t largestSync;           // Most files in one group
+    uint64_t bytes;                 // Written
+    double encodeSeconds;           // Worker time spent encoding
+} RTSPSnapshotWriterStatistics;
+
+typedef struct RTSPSnapshotWriter *RTSPSnapshotWriterRef;
+
+/// Starts the threads. `config` may be NULL for defaults. Returns NULL on
+/// allocation or thread failure.
+RTSPSnapshotWriterRef RTSPSnapshotWriterCreate(const RTSPSnapshotWriterConfig *config);
+
+/// Finishes every accepted job, then joins the threads
+void RTSPSnapshotWriterRelease(RTSPSnapshotWriterRef writer);
+
+/// Queues a job. False if it was not accepted; nothing is called then and
+/// the caller keeps its buffers.
+bool RTSPSnapshotWriterSubmit(RTSPSnapshotWriterRef writer, const RTSPSnapshotJob *job);
+
+/// Blocks until every job accepted so far has completed
+void RTSPSnapshotWriterWait(RTSPSnapshotWriterRef writer);
+
+RTSPSnapshotWriterStatistics RTSPSnapshotWriterGetStatistics(RTSPSnapshotWriterRef writer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RTSPSnapshotWriter_h */
@@ -9,6 +9,7 @@
 #import "RTSPPreferencesController.h"
 #import "RTSPWallpaperController.h"
 #import "RTSPUniFiProtectPreferences.h"
+#import "RTSPSnapshotService.h"
 #import <UserNotifications/UserNotifications.h>
 
 @interface RTSPStatusMenuController ()
@@ -178,18 +179,26 @@
 }
 
 - (void)takeSnapshot:(id)sender {
-    // Take snapshot to downloads folder
+    // Every camera on screen, to the Downloads folder
     NSString *downloadsPath = [NSSearchPathForDirectoriesInDomains(NSDownloadsDirectory, NSUserDomainMask, YES) firstObject];
 
-    NSDateFormatter *formatter = [[NSDateFormatter alloc] init];
-    formatter.dateFormat = @"yyyy-MM-dd_HH-mm-ss";
-    NSString *timestamp = [formatter stringFromDate:[NSDate date]];
-    NSString *filename = [NSString stringWithFormat:@"rtsp_snapshot_%@.png", timestamp];
-    NSString *filePath = [downloadsPath stringByAppendingPathComponent:filename];
-
-    // Note: Would need RTSPRecorder reference - simplified for now
-    NSLog(@"[INFO] Snapshot requested to: %@", filePath);
+    [[RTSPSnapshotService sharedService] saveSnapshotsOfAllCamerasToDirectory:downloadsPath
+                                                                   completion:^(NSArray<NSString *> *filePaths,
+                                                                                NSArray<NSError *> *errors) {
+        NSLog(@"[StatusMenu] Saved %lu snapshots to: %@", (unsigned long)filePaths.count, downloadsPath);
+        if (filePaths.count == 0 && errors.count == 0) {
+            return;
+        }
+        NSString *body = filePaths.count == 1 ? @"Snapshot saved to Downloads"
+                       : [NSString stringWithFormat:@"%lu snapshots saved to Downloads", (unsigned long)filePaths.count];
+        if (errors.count > 0) {
+            body = [body stringByAppendingFormat:@" (%lu failed)", (unsigned long)errors.count];
+        }
+        [self postNotificationWithBody:body];
+    }];
+}
 
+- (void)postNotificationWithBody:(NSString *)body {
     // Show notification using modern UserNotifications framework
     UNUserNotificationCenter *center = [UNUserNotificationCenter currentNotificationCenter];
 
@@ -199,7 +208,7 @@
         if (granted) {
             UNMutableNotificationContent *content = [[UNMutableNotificationContent alloc] init];
             content.title = @"RTSP Rotator";
-            content.body = @"Snapshot saved to Downloads";
+            content.body = body;
             content.sound = [UNNotificationSound defaultSound];
 
             UNNotificationRequest *request = [UNNotificationRequest requestWithIdentifier:[[NSUUID UUID] UUIDString]
@@ -5,6 +5,7 @@
 
 #import "RTSPThumbnailGrid.h"
 #import <AVFoundation/AVFoundation.h>
+#import "RTSPFrameBus.h"
 
 @implementation RTSPThumbnailCell
 
@@ -166,6 +167,17 @@
 }
 
 - (NSImage *)captureThumbnailForURL:(NSURL *)feedURL {
+    // A feed that is already playing has decoded frames on its bus
+    RTSPDecodedFrame *liveFrame = [[RTSPFrameBus activeBusForURL:feedURL] latestFrame];
+    if (liveFrame) {
+        CGImageRef imageRef = [liveFrame copyCGImage];
+        if (imageRef) {
+            NSImage *thumbnail = [[NSImage alloc] initWithCGImage:imageRef size:NSZeroSize];
+            CGImageRelease(imageRef);
+            return thumbnail;
+        }
+    }
+
     // Create temporary player to capture frame
     AVPlayer *player = [[AVPlayer alloc] init];
     AVPlayerItem *playerItem = [AVPlayerItem playerItemWithURL:feedURL];
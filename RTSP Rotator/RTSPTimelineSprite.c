@@ -0,0 +1,380 @@
+//
+//  RTSPTimelineSprite.c
+//  RTSP Rotator
+//
+
+#include "RTSPTimelineSprite.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define RTSP_SPRITE_MAGIC "RTSPSPR1"
+#define RTSP_SPRITE_VERSION 1
+#define RTSP_SPRITE_MAX_TILES (1u << 20)
+#define RTSP_SPRITE_MAX_SIDE 4096
+#define RTSP_SPRITE_PAGE 4096
+
+// Written in host byte order, like the DVR index
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t tileWidth;
+    uint32_t tileHeight;
+    uint32_t columns;
+    uint32_t tileCount;
+    uint32_t hand;                  // Clock hand: next tile considered for replacement
+    uint8_t reserved[32];
+} RTSPSpriteHeader;
+
+typedef struct {
+    uint64_t sequence;              // 0 = empty
+    uint64_t offset;
+    int64_t time;
+    uint64_t reserved;
+} RTSPSpriteTile;
+
+_Static_assert(sizeof(RTSPSpriteHeader) == 64, "sprite header layout");
+_Static_assert(sizeof(RTSPSpriteTile) == 32, "sprite tile layout");
+
+struct RTSPTimelineSprite {
+    RTSPTimelineSpriteConfig config;
+    pthread_mutex_t lock;
+    int fd;
+    uint8_t *map;
+    size_t mapLength;
+    RTSPSpriteHeader *header;
+    RTSPSpriteTile *tiles;
+    uint8_t *sheet;
+    size_t sheetBytesPerRow;
+
+    // In memory only: keyframe → tile + 1 (open addressing), and the clock's bits
+    int32_t *slots;
+    uint32_t slotMask;
+    uint8_t *referenced;
+
+    uint32_t used;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t replaced;
+};
+
+void RTSPTimelineSpriteConfigInit(RTSPTimelineSpriteConfig *config) {
+    config->tileWidth = 160;
+    config->tileHeight = 90;
+    config->columns = 16;
+    config->tileCount = 512;
+}
+
+#pragma mark - Table
+
+static uint32_t RTSPSpriteHash(uint64_t sequence, uint64_t offset) {
+    uint64_t x = sequence * 0x9E3779B97F4A7C15ull ^ offset;
+    x ^= x >> 31;
+    x *= 0xBF58476D1CE4E5B9ull;
+    x ^= x >> 29;
+    return (uint32_t)x;
+}
+
+static bool RTSPSpriteTileMatches(const RTSPSpriteTile *tile, const RTSPDVRSeekPoint *keyframe) {
+    return tile->sequence == keyframe->sequence && tile->offset == keyframe->offset && tile->time == keyframe->time;
+}
+
+/// Slot holding the keyframe's tile, or the empty slot where it would go
+static uint32_t RTSPSpriteFindSlot(RTSPTimelineSpriteRef sprite, const RTSPDVRSeekPoint *keyframe) {
+    uint32_t slot = RTSPSpriteHash(keyframe->sequence, keyframe->offset) & sprite->slotMask;
+    while (sprite->slots[slot] != 0 &&
+           !RTSPSpriteTileMatches(&sprite->tiles[sprite->slots[slot] - 1], keyframe)) {
+        slot = (slot + 1) & sprite->slotMask;
+    }
+    return slot;
+}
+
+/// Linear probing delete: shift later entries of the run back into the hole
+static void RTSPSpriteRemoveSlot(RTSPTimelineSpriteRef sprite, uint32_t hole) {
+    sprite->slots[hole] = 0;
+    uint32_t slot = (hole + 1) & sprite->slotMask;
+    while (sprite->slots[slot] != 0) {
+        const RTSPSpriteTile *tile = &sprite->tiles[sprite->slots[slot] - 1];
+        uint32_t home = RTSPSpriteHash(tile->sequence, tile->offset) & sprite->slotMask;
+        // Move it if its home is not cyclically in (hole, slot]
+        if (((slot - home) & sprite->slotMask) >= ((slot - hole) & sprite->slotMask)) {
+            sprite->slots[hole] = sprite->slots[slot];
+            sprite->slots[slot] = 0;
+            hole = slot;
+        }
+        slot = (slot + 1) & sprite->slotMask;
+    }
+}
+
+#pragma mark - Lifecycle
+
+static bool RTSPSpriteLoad(RTSPTimelineSpriteRef sprite, const char *path) {
+    const RTSPTimelineSpriteConfig *config = &sprite->config;
+    sprite->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (sprite->fd < 0) {
+        return false;
+    }
+    size_t tableLength = sizeof(RTSPSpriteHeader) + (size_t)config->tileCount * sizeof(RTSPSpriteTile);
+    size_t sheetOffset = (tableLength + RTSP_SPRITE_PAGE - 1) / RTSP_SPRITE_PAGE * RTSP_SPRITE_PAGE;
+    uint32_t rows = (config->tileCount + config->columns - 1) / config->columns;
+    sprite->sheetBytesPerRow = (size_t)config->columns * config->tileWidth * 4;
+    sprite->mapLength = sheetOffset + (size_t)rows * config->tileHeight * sprite->sheetBytesPerRow;
+
+    struct stat info;
+    if (fstat(sprite->fd, &info) != 0) {
+        return false;
+    }
+    // Sparse: pages are only backed once a tile is drawn into them
+    if ((size_t)info.st_size != sprite->mapLength &&
+        (ftruncate(sprite->fd, 0) != 0 || ftruncate(sprite->fd, (off_t)sprite->mapLength) != 0)) {
+        return false;
+    }
+    void *map = mmap(NULL, sprite->mapLength, PROT_READ | PROT_WRITE, MAP_SHARED, sprite->fd, 0);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    sprite->map = map;
+    sprite->header = map;
+    sprite->tiles = (RTSPSpriteTile *)(sprite->map + sizeof(RTSPSpriteHeader));
+    sprite->sheet = sprite->map + sheetOffset;
+
+    RTSPSpriteHeader *header = sprite->header;
+    if (memcmp(header->magic, RTSP_SPRITE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != RTSP_SPRITE_VERSION || header->tileWidth != config->tileWidth ||
+        header->tileHeight != config->tileHeight || header->columns != config->columns ||
+        header->tileCount != config->tileCount) {
+        memset(sprite->map, 0, tableLength);
+        memcpy(header->magic, RTSP_SPRITE_MAGIC, sizeof(header->magic));
+        header->version = RTSP_SPRITE_VERSION;
+        header->tileWidth = config->tileWidth;
+        header->tileHeight = config->tileHeight;
+        header->columns = config->columns;
+        header->tileCount = config->tileCount;
+    }
+    if (header->hand >= config->tileCount) {
+        header->hand = 0;
+    }
+
+    uint32_t capacity = 16;
+    while (capacity < config->tileCount * 2) {
+        capacity <<= 1;
+    }
+    sprite->slots = calloc(capacity, sizeof(int32_t));
+    sprite->referenced = calloc(config->tileCount, 1);
+    if (!sprite->slots || !sprite->referenced) {
+        return false;
+    }
+    sprite->slotMask = capacity - 1;
+    for (uint32_t i = 0; i < config->tileCount; i++) {
+        RTSPSpriteTile *tile = &sprite->tiles[i];
+        if (tile->sequence == 0) {
+            continue;
+        }
+        RTSPDVRSeekPoint keyframe = {tile->sequence, tile->offset, tile->time};
+        uint32_t slot = RTSPSpriteFindSlot(sprite, &keyframe);
+        if (sprite->slots[slot] != 0) {
+            // A duplicate from a crash mid-insert; keep the first
+            memset(tile, 0, sizeof(*tile));
+            continue;
+        }
+        sprite->slots[slot] = (int32_t)i + 1;
+        sprite->used++;
+    }
+    return true;
+}
+
+RTSPTimelineSpriteRef RTSPTimelineSpriteOpen(const char *path, const RTSPTimelineSpriteConfig *config) {
+    RTSPTimelineSpriteConfig defaults;
+    if (!config) {
+        RTSPTimelineSpriteConfigInit(&defaults);
+        config = &defaults;
+    }
+    if (!path || config->tileWidth == 0 || config->tileHeight == 0 || config->columns == 0 ||
+        config->tileCount == 0 || config->tileCount > RTSP_SPRITE_MAX_TILES ||
+        config->tileWidth > RTSP_SPRITE_MAX_SIDE || config->tileHeight > RTSP_SPRITE_MAX_SIDE ||
+        (uint64_t)config->columns * config->tileWidth > RTSP_SPRITE_MAX_SIDE * 4) {
+        errno = EINVAL;
+        return NULL;
+    }
+    RTSPTimelineSpriteRef sprite = calloc(1, sizeof(*sprite));
+    if (!sprite) {
+        return NULL;
+    }
+    sprite->config = *config;
+    sprite->fd = -1;
+    pthread_mutex_init(&sprite->lock, NULL);
+    if (!RTSPSpriteLoad(sprite, path)) {
+        int error = errno ? errno : EIO;
+        RTSPTimelineSpriteClose(sprite);
+        errno = error;
+        return NULL;
+    }
+    return sprite;
+}
+
+void RTSPTimelineSpriteClose(RTSPTimelineSpriteRef sprite) {
+    if (!sprite) {
+        return;
+    }
+    if (sprite->map) {
+        munmap(sprite->map, sprite->mapLength);
+    }
+    if (sprite->fd >= 0) {
+        close(sprite->fd);
+    }
+    free(sprite->slots);
+    free(sprite->referenced);
+    pthread_mutex_destroy(&sprite->lock);
+    free(sprite);
+}
+
+#pragma mark - Tiles
+
+static uint8_t *RTSPSpriteTilePixels(RTSPTimelineSpriteRef sprite, uint32_t tile) {
+    uint32_t column = tile % sprite->config.columns;
+    uint32_t row = tile / sprite->config.columns;
+    return sprite->sheet + (size_t)row * sprite->config.tileHeight * sprite->sheetBytesPerRow +
+           (size_t)column * sprite->config.tileWidth * 4;
+}
+
+int32_t RTSPTimelineSpriteLookup(RTSPTimelineSpriteRef sprite, const RTSPDVRSeekPoint *keyframe) {
+    if (!sprite || !keyframe || keyframe->sequence == 0) {
+        return -1;
+    }
+    pthread_mutex_lock(&sprite->lock);
+    int32_t tile = sprite->slots[RTSPSpriteFindSlot(sprite, keyframe)] - 1;
+    if (tile >= 0) {
+        sprite->referenced[tile] = 1;
+        sprite->hits++;
+    } else {
+        sprite->misses++;
+    }
+    pthread_mutex_unlock(&sprite->lock);
+    return tile;
+}
+
+/// Next tile for a new keyframe: an empty one while the sheet fills, then
+/// the first the clock hand finds not looked up since its last pass. Lock held.
+static uint32_t RTSPSpriteClaimTile(RTSPTimelineSpriteRef sprite) {
+    RTSPSpriteHeader *header = sprite->header;
+    for (;;) {
+        uint32_t tile = header->hand;
+        header->hand = (tile + 1) % sprite->config.tileCount;
+        RTSPSpriteTile *entry = &sprite->tiles[tile];
+        if (entry->sequence == 0) {
+            return tile;
+        }
+        if (sprite->used < sprite->config.tileCount) {
+            continue;
+        }
+        if (sprite->referenced[tile]) {
+            sprite->referenced[tile] = 0;
+            continue;
+        }
+        RTSPDVRSeekPoint old = {entry->sequence, entry->offset, entry->time};
+        RTSPSpriteRemoveSlot(sprite, RTSPSpriteFindSlot(sprite, &old));
+        memset(entry, 0, sizeof(*entry));
+        sprite->used--;
+        sprite->replaced++;
+        return tile;
+    }
+}
+
+int32_t RTSPTimelineSpriteInsert(RTSPTimelineSpriteRef sprite, const RTSPDVRSeekPoint *keyframe,
+                                 const uint8_t *pixels, size_t bytesPerRow) {
+    if (!sprite || !keyframe || keyframe->sequence == 0 || !pixels ||
+        bytesPerRow < (size_t)sprite->config.tileWidth * 4) {
+        return -1;
+    }
+    pthread_mutex_lock(&sprite->lock);
+    uint32_t slot = RTSPSpriteFindSlot(sprite, keyframe);
+    uint32_t tile;
+    if (sprite->slots[slot] != 0) {
+        tile = (uint32_t)sprite->slots[slot] - 1;
+    } else {
+        tile = RTSPSpriteClaimTile(sprite);
+        // Claiming may have shifted the table
+        slot = RTSPSpriteFindSlot(sprite, keyframe);
+        sprite->slots[slot] = (int32_t)tile + 1;
+        sprite->used++;
+    }
+
+    // Pixels first, then the table entry naming them
+    uint8_t *destination = RTSPSpriteTilePixels(sprite, tile);
+    size_t rowBytes = (size_t)sprite->config.tileWidth * 4;
+    for (uint32_t y = 0; y < sprite->config.tileHeight; y++) {
+        memcpy(destination + y * sprite->sheetBytesPerRow, pixels + y * bytesPerRow, rowBytes);
+    }
+    RTSPSpriteTile *entry = &sprite->tiles[tile];
+    entry->sequence = keyframe->sequence;
+    entry->offset = keyframe->offset;
+    entry->time = keyframe->time;
+    sprite->referenced[tile] = 1;
+    pthread_mutex_unlock(&sprite->lock);
+    return (int32_t)tile;
+}
+
+bool RTSPTimelineSpriteCopyTile(RTSPTimelineSpriteRef sprite, int32_t tile, const RTSPDVRSeekPoint *keyframe,
+                                uint8_t *pixels, size_t bytesPerRow) {
+    if (!sprite || !keyframe || !pixels || tile < 0 || (uint32_t)tile >= sprite->config.tileCount ||
+        bytesPerRow < (size_t)sprite->config.tileWidth * 4) {
+        return false;
+    }
+    pthread_mutex_lock(&sprite->lock);
+    bool held = RTSPSpriteTileMatches(&sprite->tiles[tile], keyframe);
+    if (held) {
+        const uint8_t *source = RTSPSpriteTilePixels(sprite, (uint32_t)tile);
+        size_t rowBytes = (size_t)sprite->config.tileWidth * 4;
+        for (uint32_t y = 0; y < sprite->config.tileHeight; y++) {
+            memcpy(pixels + y * bytesPerRow, source + y * sprite->sheetBytesPerRow, rowBytes);
+        }
+    }
+    pthread_mutex_unlock(&sprite->lock);
+    return held;
+}
+
+const uint8_t *RTSPTimelineSpriteSheet(RTSPTimelineSpriteRef sprite, uint32_t *width, uint32_t *height,
+                                       size_t *bytesPerRow) {
+    if (!sprite) {
+        return NULL;
+    }
+    const RTSPTimelineSpriteConfig *config = &sprite->config;
+    if (width) {
+        *width = config->columns * config->tileWidth;
+    }
+    if (height) {
+        *height = (config->tileCount + config->columns - 1) / config->columns * config->tileHeight;
+    }
+    if (bytesPerRow) {
+        *bytesPerRow = sprite->sheetBytesPerRow;
+    }
+    return sprite->sheet;
+}
+
+RTSPTimelineSpriteConfig RTSPTimelineSpriteGetConfig(RTSPTimelineSpriteRef sprite) {
+    RTSPTimelineSpriteConfig config = {0};
+    if (sprite) {
+        config = sprite->config;
+    }
+    return config;
+}
+
+RTSPTimelineSpriteStatistics RTSPTimelineSpriteGetStatistics(RTSPTimelineSpriteRef sprite) {
+    RTSPTimelineSpriteStatistics statistics = {0};
+    if (!sprite) {
+        return statistics;
+    }
+    pthread_mutex_lock(&sprite->lock);
+    statistics.tiles = sprite->used;
+    statistics.hits = sprite->hits;
+    statistics.misses = sprite->misses;
+    statistics.replaced = sprite->replaced;
+    pthread_mutex_unlock(&sprite->lock);
+    return statistics;
+}
@@ -0,0 +1,86 @@
+//
+//  RTSPTimelineSprite.h
+//  RTSP Rotator
+//
+//  Thumbnail cache for a camera's DVR timeline: one sprite sheet file of
+//  fixed-size BGRA tiles, one tile per recorded keyframe. Tiles are keyed by
+//  the DVR seek point they were decoded from, so every time that seeks to
+//  the same keyframe shares one tile and a timeline strip costs one decode
+//  per keyframe, ever, rather than one per scrub.
+//
+//  The file is a header, a tile table and the sheet: tileCount tiles laid
+//  out `columns` to a row, tile i at column i % columns, row i / columns,
+//  memory-mapped so a view can draw tiles straight from it. When the sheet
+//  is full the clock algorithm picks the tile to replace, sparing tiles
+//  looked up since the hand last passed. The table survives restarts.
+//
+//  Thread-safe: lookups, copies and inserts take an internal lock.
+//  See Benchmarks/timeline_bench.c.
+//
+
+#ifndef RTSPTimelineSprite_h
+#define RTSPTimelineSprite_h
+
+#include "RTSPDVRStore.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t tileWidth;             // Pixels. Default 160
+    uint32_t tileHeight;            // Default 90
+    uint32_t columns;               // Tiles per sheet row. Default 16
+    uint32_t tileCount;             // Tiles kept. Default 512 (29 MB at the default size)
+} RTSPTimelineSpriteConfig;
+
+void RTSPTimelineSpriteConfigInit(RTSPTimelineSpriteConfig *config);
+
+typedef struct {
+    uint32_t tiles;                 // Holding a thumbnail
+    uint64_t hits;                  // Since open
+    uint64_t misses;
+    uint64_t replaced;              // Tiles reused for another keyframe
+} RTSPTimelineSpriteStatistics;
+
+typedef struct RTSPTimelineSprite *RTSPTimelineSpriteRef;
+
+/// Opens or creates the sprite file at `path`. A file with other geometry
+/// is discarded. `config` may be NULL for defaults. Returns NULL with errno
+/// set on failure.
+RTSPTimelineSpriteRef RTSPTimelineSpriteOpen(const char *path, const RTSPTimelineSpriteConfig *config);
+
+void RTSPTimelineSpriteClose(RTSPTimelineSpriteRef sprite);
+
+/// Tile holding a keyframe's thumbnail, or -1. The keyframe's time is part
+/// of the key, so a DVR ring that started over does not match old tiles.
+int32_t RTSPTimelineSpriteLookup(RTSPTimelineSpriteRef sprite, const RTSPDVRSeekPoint *keyframe);
+
+/// Stores a tileWidth × tileHeight BGRA thumbnail for a keyframe, replacing
+/// its old one if any, and returns its tile (-1 for bad arguments)
+int32_t RTSPTimelineSpriteInsert(RTSPTimelineSpriteRef sprite, const RTSPDVRSeekPoint *keyframe,
+                                 const uint8_t *pixels, size_t bytesPerRow);
+
+/// Copies a tile's pixels if it still holds `keyframe`; false once it was
+/// replaced
+bool RTSPTimelineSpriteCopyTile(RTSPTimelineSpriteRef sprite, int32_t tile, const RTSPDVRSeekPoint *keyframe,
+                                uint8_t *pixels, size_t bytesPerRow);
+
+/// The mapped sheet, BGRA, valid until close. Tiles change under a reader
+/// when they are replaced.
+const uint8_t *RTSPTimelineSpriteSheet(RTSPTimelineSpriteRef sprite, uint32_t *width, uint32_t *height,
+                                       size_t *bytesPerRow);
+
+RTSPTimelineSpriteConfig RTSPTimelineSpriteGetConfig(RTSPTimelineSpriteRef sprite);
+
+RTSPTimelineSpriteStatistics RTSPTimelineSpriteGetStatistics(RTSPTimelineSpriteRef sprite);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RTSPTimelineSprite_h */
@@ -0,0 +1,821 @@
+//
+//  RTSPTracker.c
+//  RTSP Rotator
+//
+
+#include "RTSPTracker.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Boxes never shrink below this while coasting
+#define RTSP_TRACKER_MIN_SIZE 1e-4
+// Noise scales with the box height, floored for tiny boxes
+#define RTSP_TRACKER_MIN_SCALE 0.01
+
+/// One coordinate under a constant-velocity model: value, rate, and the 2x2
+/// covariance (symmetric, so three numbers)
+typedef struct {
+    double value;
+    double rate;
+    double p00, p01, p11;
+} RTSPTrackerAxis;
+
+enum { RTSPTrackerCentreX, RTSPTrackerCentreY, RTSPTrackerWidth, RTSPTrackerHeight, RTSPTrackerAxisCount };
+
+typedef struct {
+    RTSPTrack track;
+    RTSPTrackerAxis axes[RTSPTrackerAxisCount];
+    double zoneEntered[RTSP_TRACKER_MAX_ZONES];
+    bool matched;                   // This update
+} RTSPTrackerEntry;
+
+struct RTSPTracker {
+    RTSPTrackerConfig config;
+    RTSPTrackerEntry *tracks;
+    size_t trackCount;
+    size_t trackCapacity;
+    RTSPZoneIndexRef zoneIndex;     // NULL without zones
+    uint32_t zoneCount;
+    RTSPTrackEvent *events;
+    size_t eventCount;
+    size_t eventCapacity;
+    double lastTimestamp;
+    bool started;
+    uint64_t nextID;
+
+    // Association scratch, grown as needed
+    uint32_t *rows;                 // Track indices of a pass
+    uint32_t *columns;              // Detection indices of a pass
+    int32_t *assignment;            // Per row: column or -1
+    bool *detectionUsed;
+    double *iou;                    // rows x columns
+    double *cost;                   // Solver orientation (rows <= columns)
+    size_t detectionCapacity;
+    size_t matrixCapacity;
+    double *potentialRows;
+    double *potentialColumns;
+    double *minimum;
+    size_t *owner;
+    size_t *previous;
+    bool *visited;
+    int32_t *solution;              // Per solver row: column or -1
+    size_t solverCapacity;
+    int32_t *components;            // Grouping of rows and columns that share candidates
+
+    RTSPTrackerStatistics statistics;
+};
+
+void RTSPTrackerConfigInit(RTSPTrackerConfig *config) {
+    memset(config, 0, sizeof(*config));
+    config->highScore = 0.5f;
+    config->lowScore = 0.1f;
+    config->matchIoU = 0.3f;
+    config->lowMatchIoU = 0.5f;
+    config->matchBuffer = 0.3f;
+    config->minHits = 3;
+    config->maxAge = 1.0;
+    config->measurementNoise = 0.05f;
+    config->processNoise = 0.5f;
+}
+
+RTSPTrackerRef RTSPTrackerCreate(const RTSPTrackerConfig *config) {
+    RTSPTrackerRef tracker = calloc(1, sizeof(*tracker));
+    if (!tracker) {
+        return NULL;
+    }
+    if (config) {
+        tracker->config = *config;
+    } else {
+        RTSPTrackerConfigInit(&tracker->config);
+    }
+    if (tracker->config.minHits == 0) {
+        tracker->config.minHits = 1;
+    }
+    tracker->nextID = 1;
+    return tracker;
+}
+
+void RTSPTrackerRelease(RTSPTrackerRef tracker) {
+    if (!tracker) {
+        return;
+    }
+    free(tracker->tracks);
+    free(tracker->events);
+    free(tracker->rows);
+    free(tracker->columns);
+    free(tracker->assignment);
+    free(tracker->detectionUsed);
+    free(tracker->iou);
+    free(tracker->cost);
+    free(tracker->potentialRows);
+    free(tracker->potentialColumns);
+    free(tracker->minimum);
+    free(tracker->owner);
+    free(tracker->previous);
+    free(tracker->visited);
+    free(tracker->solution);
+    free(tracker->components);
+    RTSPZoneIndexRelease(tracker->zoneIndex);
+    free(tracker);
+}
+
+void RTSPTrackerReset(RTSPTrackerRef tracker) {
+    tracker->trackCount = 0;
+    tracker->eventCount = 0;
+    tracker->started = false;
+    tracker->statistics.activeTracks = 0;
+}
+
+bool RTSPTrackerSetZones(RTSPTrackerRef tracker, const float (*zones)[4], uint32_t count) {
+    if (count > RTSP_TRACKER_MAX_ZONES || (count > 0 && !zones)) {
+        return false;
+    }
+    RTSPZonePoint corners[RTSP_TRACKER_MAX_ZONES][4];
+    RTSPZonePolygon polygons[RTSP_TRACKER_MAX_ZONES];
+    for (uint32_t z = 0; z < count; z++) {
+        float x0 = zones[z][0], y0 = zones[z][1], x1 = x0 + zones[z][2], y1 = y0 + zones[z][3];
+        corners[z][0] = (RTSPZonePoint){x0, y0};
+        corners[z][1] = (RTSPZonePoint){x1, y0};
+        corners[z][2] = (RTSPZonePoint){x1, y1};
+        corners[z][3] = (RTSPZonePoint){x0, y1};
+        polygons[z] = (RTSPZonePolygon){corners[z], 4, 0.0f};
+    }
+    return RTSPTrackerSetZonePolygons(tracker, polygons, count);
+}
+
+bool RTSPTrackerSetZonePolygons(RTSPTrackerRef tracker, const RTSPZonePolygon *zones, uint32_t count) {
+    if (count > RTSP_TRACKER_MAX_ZONES || (count > 0 && !zones)) {
+        return false;
+    }
+    RTSPZoneIndexRef index = NULL;
+    if (count > 0 && !(index = RTSPZoneIndexCreate(zones, count, 0))) {
+        return false;
+    }
+    RTSPZoneIndexRelease(tracker->zoneIndex);
+    tracker->zoneIndex = index;
+    tracker->zoneCount = count;
+    for (size_t i = 0; i < tracker->trackCount; i++) {
+        tracker->tracks[i].track.zones = 0;
+    }
+    return true;
+}
+
+#pragma mark - Kalman filter
+
+static void RTSPTrackerAxisInit(RTSPTrackerAxis *axis, double value, double measurementVariance, double scale) {
+    axis->value = value;
+    axis->rate = 0;
+    axis->p00 = measurementVariance;
+    axis->p01 = 0;
+    axis->p11 = scale * scale;      // Unknown rate: about one box height per second
+}
+
+/// x += v dt; P = F P F' + Q for white-noise acceleration of density q
+static void RTSPTrackerAxisPredict(RTSPTrackerAxis *axis, double dt, double q) {
+    if (dt <= 0) {
+        return;
+    }
+    axis->value += axis->rate * dt;
+    double dt2 = dt * dt;
+    axis->p00 += 2 * dt * axis->p01 + dt2 * axis->p11 + q * dt2 * dt / 3;
+    axis->p01 += dt * axis->p11 + q * dt2 / 2;
+    axis->p11 += q * dt;
+}
+
+static void RTSPTrackerAxisCorrect(RTSPTrackerAxis *axis, double measurement, double r) {
+    double s = axis->p00 + r;
+    double k0 = axis->p00 / s;
+    double k1 = axis->p01 / s;
+    double residual = measurement - axis->value;
+    axis->value += k0 * residual;
+    axis->rate += k1 * residual;
+    double p00 = axis->p00, p01 = axis->p01;
+    axis->p00 = (1 - k0) * p00;
+    axis->p01 = (1 - k0) * p01;
+    axis->p11 -= k1 * p01;
+}
+
+static inline double RTSPTrackerScale(const RTSPTrackerEntry *entry) {
+    double height = entry->axes[RTSPTrackerHeight].value;
+    return height > RTSP_TRACKER_MIN_SCALE ? height : RTSP_TRACKER_MIN_SCALE;
+}
+
+/// Box and velocity from filter state into the public track
+static void RTSPTrackerPublish(RTSPTrack *track, const RTSPTrackerAxis *axes) {
+    double width = fmax(axes[RTSPTrackerWidth].value, RTSP_TRACKER_MIN_SIZE);
+    double height = fmax(axes[RTSPTrackerHeight].value, RTSP_TRACKER_MIN_SIZE);
+    track->x = (float)(axes[RTSPTrackerCentreX].value - width / 2);
+    track->y = (float)(axes[RTSPTrackerCentreY].value - height / 2);
+    track->width = (float)width;
+    track->height = (float)height;
+    track->velocityX = (float)axes[RTSPTrackerCentreX].rate;
+    track->velocityY = (float)axes[RTSPTrackerCentreY].rate;
+}
+
+static void RTSPTrackerPredictEntry(const RTSPTrackerConfig *config, RTSPTrackerEntry *entry, double dt) {
+    double scale = RTSPTrackerScale(entry);
+    double q = (double)config->processNoise * scale;
+    q *= q;
+    for (int a = 0; a < RTSPTrackerAxisCount; a++) {
+        RTSPTrackerAxisPredict(&entry->axes[a], dt, q);
+    }
+    // A shrinking box coasts at its last size rather than collapsing
+    for (int a = RTSPTrackerWidth; a <= RTSPTrackerHeight; a++) {
+        if (entry->axes[a].value < RTSP_TRACKER_MIN_SIZE) {
+            entry->axes[a].value = RTSP_TRACKER_MIN_SIZE;
+            entry->axes[a].rate = 0;
+        }
+    }
+}
+
+static void RTSPTrackerCorrectEntry(const RTSPTrackerConfig *config, RTSPTrackerEntry *entry, const RTSPTrackerDetection *detection) {
+    double r = (double)config->measurementNoise * RTSPTrackerScale(entry);
+    r *= r;
+    double measurements[RTSPTrackerAxisCount] = {
+        detection->x + detection->width / 2.0, detection->y + detection->height / 2.0, detection->width, detection->height
+    };
+    for (int a = 0; a < RTSPTrackerAxisCount; a++) {
+        RTSPTrackerAxisCorrect(&entry->axes[a], measurements[a], r);
+    }
+}
+
+#pragma mark - Association
+
+/// IoU of a track box (already buffered) and a detection box grown by
+/// `buffer` of its size plus the track's uncertainty margin on each side
+static inline double RTSPTrackerIoU(const double box[4], const RTSPTrackerDetection *detection, double buffer,
+                                    double uncertaintyX, double uncertaintyY) {
+    double dx = buffer * detection->width + uncertaintyX, dy = buffer * detection->height + uncertaintyY;
+    double detectionX = detection->x - dx, detectionY = detection->y - dy;
+    double detectionWidth = detection->width + 2 * dx, detectionHeight = detection->height + 2 * dy;
+    double left = fmax(box[0], detectionX);
+    double top = fmax(box[1], detectionY);
+    double right = fmin(box[0] + box[2], detectionX + detectionWidth);
+    double bottom = fmin(box[1] + box[3], detectionY + detectionHeight);
+    if (right <= left || bottom <= top) {
+        return 0;
+    }
+    double intersection = (right - left) * (bottom - top);
+    double unionArea = box[2] * box[3] + detectionWidth * detectionHeight - intersection;
+    return unionArea > 0 ? intersection / unionArea : 0;
+}
+
+static bool RTSPTrackerReserveSolver(RTSPTrackerRef tracker, size_t size) {
+    if (size <= tracker->solverCapacity) {
+        return true;
+    }
+    size_t capacity = tracker->solverCapacity ? tracker->solverCapacity : 32;
+    while (capacity < size) {
+        capacity *= 2;
+    }
+    double *potentialRows = realloc(tracker->potentialRows, capacity * sizeof(double));
+    if (potentialRows) tracker->potentialRows = potentialRows;
+    double *potentialColumns = realloc(tracker->potentialColumns, capacity * sizeof(double));
+    if (potentialColumns) tracker->potentialColumns = potentialColumns;
+    double *minimum = realloc(tracker->minimum, capacity * sizeof(double));
+    if (minimum) tracker->minimum = minimum;
+    size_t *owner = realloc(tracker->owner, capacity * sizeof(size_t));
+    if (owner) tracker->owner = owner;
+    size_t *previous = realloc(tracker->previous, capacity * sizeof(size_t));
+    if (previous) tracker->previous = previous;
+    bool *visited = realloc(tracker->visited, capacity * sizeof(bool));
+    if (visited) tracker->visited = visited;
+    int32_t *solution = realloc(tracker->solution, capacity * sizeof(int32_t));
+    if (solution) tracker->solution = solution;
+    if (!potentialRows || !potentialColumns || !minimum || !owner || !previous || !visited || !solution) {
+        return false;
+    }
+    tracker->solverCapacity = capacity;
+    return true;
+}
+
+/// Minimum-cost assignment of every row to a distinct column (rows <=
+/// columns) by shortest augmenting paths with potentials, O(rows^2 columns).
+/// Arrays are 1-based internally; column 0 is the virtual source.
+static void RTSPTrackerSolve(RTSPTrackerRef tracker, const double *cost, size_t rows, size_t columns, int32_t *rowAssignment) {
+    double *u = tracker->potentialRows;
+    double *v = tracker->potentialColumns;
+    double *minimum = tracker->minimum;
+    size_t *owner = tracker->owner;
+    size_t *previous = tracker->previous;
+    bool *visited = tracker->visited;
+    memset(u, 0, (rows + 1) * sizeof(double));
+    memset(v, 0, (columns + 1) * sizeof(double));
+    memset(owner, 0, (columns + 1) * sizeof(size_t));
+
+    for (size_t row = 1; row <= rows; row++) {
+        owner[0] = row;
+        size_t column = 0;
+        for (size_t j = 0; j <= columns; j++) {
+            minimum[j] = DBL_MAX;
+            visited[j] = false;
+        }
+        do {
+            visited[column] = true;
+            size_t current = owner[column];
+            double delta = DBL_MAX;
+            size_t next = 0;
+            const double *costRow = cost + (current - 1) * columns;
+            for (size_t j = 1; j <= columns; j++) {
+                if (visited[j]) {
+                    continue;
+                }
+                double reduced = costRow[j - 1] - u[current] - v[j];
+                if (reduced < minimum[j]) {
+                    minimum[j] = reduced;
+                    previous[j] = column;
+                }
+                if (minimum[j] < delta) {
+                    delta = minimum[j];
+                    next = j;
+                }
+            }
+            for (size_t j = 0; j <= columns; j++) {
+                if (visited[j]) {
+                    u[owner[j]] += delta;
+                    v[j] -= delta;
+                } else {
+                    minimum[j] -= delta;
+                }
+            }
+            column = next;
+        } while (owner[column] != 0);
+        do {
+            size_t back = previous[column];
+            owner[column] = owner[back];
+            column = back;
+        } while (column != 0);
+    }
+
+    for (size_t i = 0; i < rows; i++) {
+        rowAssignment[i] = -1;
+    }
+    for (size_t j = 1; j <= columns; j++) {
+        if (owner[j]) {
+            rowAssignment[owner[j] - 1] = (int32_t)(j - 1);
+        }
+    }
+}
+
+static int32_t RTSPTrackerFind(int32_t *parent, int32_t node) {
+    while (parent[node] != node) {
+        parent[node] = parent[parent[node]];
+        node = parent[node];
+    }
+    return node;
+}
+
+/// Match tracker->rows (track indices) to tracker->columns (detection
+/// indices), maximizing total IoU over pairs of one class with IoU at least
+/// `minIoU`. Fills tracker->assignment per row (column position or -1).
+static void RTSPTrackerAssociate(RTSPTrackerRef tracker, size_t rowCount, size_t columnCount,
+                                 const RTSPTrackerDetection *detections, double minIoU) {
+    int32_t *assignment = tracker->assignment;
+    for (size_t i = 0; i < rowCount; i++) {
+        assignment[i] = -1;
+    }
+    if (rowCount == 0 || columnCount == 0) {
+        return;
+    }
+
+    // IoU matrix, counting candidate pairs per row and column. When no row or
+    // column has two candidates the assignment is forced and needs no solver.
+    double *iou = tracker->iou;
+    bool contested = false;
+    size_t edges = 0;
+    bool *columnSeen = tracker->visited;
+    memset(columnSeen, 0, columnCount * sizeof(bool));
+    double buffer = tracker->config.matchBuffer;
+    for (size_t i = 0; i < rowCount; i++) {
+        const RTSPTrackerEntry *entry = &tracker->tracks[tracker->rows[i]];
+        const RTSPTrack *track = &entry->track;
+        // While a track coasts, both boxes also widen by two standard
+        // deviations of its position, so the gate follows its uncertainty
+        double uncertaintyX = 0, uncertaintyY = 0;
+        if (track->state == RTSPTrackStateLost) {
+            uncertaintyX = 2 * sqrt(entry->axes[RTSPTrackerCentreX].p00);
+            uncertaintyY = 2 * sqrt(entry->axes[RTSPTrackerCentreY].p00);
+        }
+        double marginX = buffer * track->width + uncertaintyX, marginY = buffer * track->height + uncertaintyY;
+        double box[4] = {track->x - marginX, track->y - marginY, track->width + 2 * marginX, track->height + 2 * marginY};
+        size_t rowEdges = 0;
+        for (size_t j = 0; j < columnCount; j++) {
+            const RTSPTrackerDetection *detection = &detections[tracker->columns[j]];
+            double value = detection->classID == track->classID ? RTSPTrackerIoU(box, detection, buffer, uncertaintyX, uncertaintyY) : 0;
+            if (value < minIoU) {
+                value = 0;
+            } else {
+                rowEdges++;
+                edges++;
+                contested |= columnSeen[j];
+                columnSeen[j] = true;
+                assignment[i] = (int32_t)j;
+            }
+            iou[i * columnCount + j] = value;
+        }
+        contested |= rowEdges > 1;
+    }
+    if (edges == 0 || !contested) {
+        return;
+    }
+
+    // Candidate pairs split the rows and columns into independent groups
+    // (objects that overlap each other); each is solved on its own, which
+    // keeps crowded frames far below the cost of one dense solve
+    size_t nodes = rowCount + columnCount;
+    int32_t *parent = tracker->components;
+    int32_t *head = parent + nodes;
+    int32_t *next = head + nodes;
+    int32_t *groupRows = next + nodes;
+    int32_t *groupColumns = groupRows + rowCount;
+    for (size_t k = 0; k < nodes; k++) {
+        parent[k] = (int32_t)k;
+        head[k] = -1;
+    }
+    for (size_t i = 0; i < rowCount; i++) {
+        for (size_t j = 0; j < columnCount; j++) {
+            if (iou[i * columnCount + j] > 0) {
+                int32_t a = RTSPTrackerFind(parent, (int32_t)i), b = RTSPTrackerFind(parent, (int32_t)(rowCount + j));
+                if (a != b) {
+                    parent[a < b ? b : a] = a < b ? a : b;
+                }
+            }
+        }
+    }
+    for (size_t k = nodes; k-- > 0;) {
+        int32_t root = RTSPTrackerFind(parent, (int32_t)k);
+        next[k] = head[root];
+        head[root] = (int32_t)k;
+    }
+
+    for (size_t root = 0; root < nodes; root++) {
+        size_t groupRowCount = 0, groupColumnCount = 0;
+        for (int32_t k = head[root]; k >= 0; k = next[k]) {
+            if ((size_t)k < rowCount) {
+                groupRows[groupRowCount++] = k;
+            } else {
+                groupColumns[groupColumnCount++] = k - (int32_t)rowCount;
+            }
+        }
+        if (groupRowCount == 0 || groupColumnCount == 0) {
+            continue;
+        }
+        if (groupRowCount == 1 && groupColumnCount == 1) {
+            assignment[groupRows[0]] = groupColumns[0];
+            continue;
+        }
+        for (size_t r = 0; r < groupRowCount; r++) {
+            assignment[groupRows[r]] = -1;
+        }
+
+        // Cost 1 - IoU; pairs below the gate cost 1 and are discarded afterwards
+        bool transpose = groupRowCount > groupColumnCount;
+        size_t rows = transpose ? groupColumnCount : groupRowCount;
+        size_t columns = transpose ? groupRowCount : groupColumnCount;
+        double *cost = tracker->cost;
+        for (size_t r = 0; r < groupRowCount; r++) {
+            for (size_t c = 0; c < groupColumnCount; c++) {
+                double value = 1.0 - iou[(size_t)groupRows[r] * columnCount + (size_t)groupColumns[c]];
+                if (transpose) {
+                    cost[c * groupRowCount + r] = value;
+                } else {
+                    cost[r * groupColumnCount + c] = value;
+                }
+            }
+        }
+        int32_t *solved = tracker->solution;
+        RTSPTrackerSolve(tracker, cost, rows, columns, solved);
+        for (size_t r = 0; r < rows; r++) {
+            if (solved[r] < 0) {
+                continue;
+            }
+            size_t row = (size_t)(transpose ? groupRows[solved[r]] : groupRows[r]);
+            size_t column = (size_t)(transpose ? groupColumns[r] : groupColumns[solved[r]]);
+            if (iou[row * columnCount + column] > 0) {
+                assignment[row] = (int32_t)column;
+            }
+        }
+    }
+}
+
+#pragma mark - Update
+
+static bool RTSPTrackerReserve(RTSPTrackerRef tracker, size_t detectionCount) {
+    size_t tracksNeeded = tracker->trackCount + detectionCount;
+    if (tracksNeeded > tracker->trackCapacity) {
+        size_t capacity = tracker->trackCapacity ? tracker->trackCapacity * 2 : 64;
+        while (capacity < tracksNeeded) {
+            capacity *= 2;
+        }
+        RTSPTrackerEntry *tracks = realloc(tracker->tracks, capacity * sizeof(*tracks));
+        if (!tracks) {
+            return false;
+        }
+        tracker->tracks = tracks;
+        tracker->trackCapacity = capacity;
+    }
+    // At most one lifecycle event and one event per zone for every track
+    size_t eventsNeeded = tracksNeeded * (1 + tracker->zoneCount);
+    if (eventsNeeded > tracker->eventCapacity) {
+        RTSPTrackEvent *events = realloc(tracker->events, eventsNeeded * sizeof(*events));
+        if (!events) {
+            return false;
+        }
+        tracker->events = events;
+        tracker->eventCapacity = eventsNeeded;
+    }
+    size_t lines = tracker->trackCount > detectionCount ? tracker->trackCount : detectionCount;
+    if (lines > tracker->detectionCapacity) {
+        size_t capacity = tracker->detectionCapacity ? tracker->detectionCapacity : 64;
+        while (capacity < lines) {
+            capacity *= 2;
+        }
+        uint32_t *rows = realloc(tracker->rows, capacity * sizeof(uint32_t));
+        if (rows) tracker->rows = rows;
+        uint32_t *columns = realloc(tracker->columns, capacity * sizeof(uint32_t));
+        if (columns) tracker->columns = columns;
+        int32_t *assignment = realloc(tracker->assignment, capacity * sizeof(int32_t));
+        if (assignment) tracker->assignment = assignment;
+        bool *used = realloc(tracker->detectionUsed, capacity * sizeof(bool));
+        if (used) tracker->detectionUsed = used;
+        int32_t *components = realloc(tracker->components, 8 * capacity * sizeof(int32_t));
+        if (components) tracker->components = components;
+        if (!rows || !columns || !assignment || !used || !components) {
+            return false;
+        }
+        tracker->detectionCapacity = capacity;
+    }
+    size_t cells = tracker->trackCount * detectionCount;
+    if (cells > tracker->matrixCapacity) {
+        double *iou = realloc(tracker->iou, cells * sizeof(double));
+        if (iou) tracker->iou = iou;
+        double *cost = realloc(tracker->cost, cells * sizeof(double));
+        if (cost) tracker->cost = cost;
+        if (!iou || !cost) {
+            return false;
+        }
+        tracker->matrixCapacity = cells;
+    }
+    return RTSPTrackerReserveSolver(tracker, lines + 1);
+}
+
+static RTSPTrackEvent *RTSPTrackerAddEvent(RTSPTrackerRef tracker, RTSPTrackEventType type, const RTSPTrack *track, double timestamp) {
+    RTSPTrackEvent *event = &tracker->events[tracker->eventCount++];
+    event->type = type;
+    event->trackID = track->trackID;
+    event->classID = track->classID;
+    event->zone = 0;
+    event->timestamp = timestamp;
+    event->duration = 0;
+    event->x = track->x;
+    event->y = track->y;
+    event->width = track->width;
+    event->height = track->height;
+    return event;
+}
+
+static void RTSPTrackerConfirm(RTSPTrackerRef tracker, RTSPTrackerEntry *entry, double timestamp) {
+    entry->track.state = RTSPTrackStateConfirmed;
+    tracker->statistics.tracksStarted++;
+    RTSPTrackerAddEvent(tracker, RTSPTrackEventStarted, &entry->track, timestamp);
+}
+
+static void RTSPTrackerMatch(RTSPTrackerRef tracker, RTSPTrackerEntry *entry, const RTSPTrackerDetection *detection, double timestamp) {
+    RTSPTrackerCorrectEntry(&tracker->config, entry, detection);
+    RTSPTrackerPublish(&entry->track, entry->axes);
+    entry->matched = true;
+    entry->track.score = detection->score;
+    entry->track.hits++;
+    entry->track.lastSeen = timestamp;
+}
+
+/// Run one association pass over the rows and columns already listed
+static void RTSPTrackerPass(RTSPTrackerRef tracker, size_t rowCount, size_t columnCount, const RTSPTrackerDetection *detections,
+                            double minIoU, double timestamp, uint64_t *trackIDs, bool lowScore) {
+    RTSPTrackerAssociate(tracker, rowCount, columnCount, detections, minIoU);
+    for (size_t i = 0; i < rowCount; i++) {
+        if (tracker->assignment[i] < 0) {
+            continue;
+        }
+        uint32_t d = tracker->columns[tracker->assignment[i]];
+        RTSPTrackerEntry *entry = &tracker->tracks[tracker->rows[i]];
+        RTSPTrackerMatch(tracker, entry, &detections[d], timestamp);
+        tracker->detectionUsed[d] = true;
+        if (trackIDs) {
+            trackIDs[d] = entry->track.trackID;
+        }
+        if (lowScore) {
+            tracker->statistics.lowScoreMatches++;
+        }
+        if (entry->track.state == RTSPTrackStateLost) {
+            entry->track.state = RTSPTrackStateConfirmed;
+        } else if (entry->track.state == RTSPTrackStateTentative && entry->track.hits >= tracker->config.minHits) {
+            RTSPTrackerConfirm(tracker, entry, timestamp);
+        }
+    }
+}
+
+static void RTSPTrackerUpdateZones(RTSPTrackerRef tracker, RTSPTrackerEntry *entry, double timestamp) {
+    RTSPTrack *track = &entry->track;
+    float footX = track->x + track->width / 2;
+    float footY = track->y + track->height;
+    RTSPZoneMask zones = RTSPZoneIndexZonesAtPoint(tracker->zoneIndex, footX, footY);
+    for (uint32_t z = 0; z < tracker->zoneCount; z++) {
+        bool inside = (zones >> z) & 1;
+        bool was = (track->zones >> z) & 1;
+        if (inside && !was) {
+            track->zones |= 1u << z;
+            entry->zoneEntered[z] = timestamp;
+            RTSPTrackerAddEvent(tracker, RTSPTrackEventZoneEntered, track, timestamp)->zone = z;
+        } else if (!inside && was) {
+            track->zones &= ~(1u << z);
+            RTSPTrackEvent *event = RTSPTrackerAddEvent(tracker, RTSPTrackEventZoneExited, track, timestamp);
+            event->zone = z;
+            event->duration = timestamp - entry->zoneEntered[z];
+        }
+    }
+}
+
+/// A confirmed track that went unseen too long: leave its zones, then end
+static void RTSPTrackerEnd(RTSPTrackerRef tracker, RTSPTrackerEntry *entry) {
+    RTSPTrack *track = &entry->track;
+    for (uint32_t z = 0; z < tracker->zoneCount; z++) {
+        if ((track->zones >> z) & 1) {
+            RTSPTrackEvent *event = RTSPTrackerAddEvent(tracker, RTSPTrackEventZoneExited, track, track->lastSeen);
+            event->zone = z;
+            event->duration = track->lastSeen - entry->zoneEntered[z];
+        }
+    }
+    track->zones = 0;
+    RTSPTrackEvent *event = RTSPTrackerAddEvent(tracker, RTSPTrackEventEnded, track, track->lastSeen);
+    event->duration = track->lastSeen - track->firstSeen;
+    tracker->statistics.tracksEnded++;
+}
+
+bool RTSPTrackerUpdate(RTSPTrackerRef tracker, double timestamp, const RTSPTrackerDetection *detections, size_t count,
+                       uint64_t *trackIDs) {
+    if (!tracker || (count > 0 && !detections) || (tracker->started && timestamp < tracker->lastTimestamp)) {
+        return false;
+    }
+    if (!RTSPTrackerReserve(tracker, count)) {
+        return false;
+    }
+    const RTSPTrackerConfig *config = &tracker->config;
+    double dt = tracker->started ? timestamp - tracker->lastTimestamp : 0;
+    tracker->eventCount = 0;
+
+    for (size_t t = 0; t < tracker->trackCount; t++) {
+        RTSPTrackerEntry *entry = &tracker->tracks[t];
+        RTSPTrackerPredictEntry(config, entry, dt);
+        RTSPTrackerPublish(&entry->track, entry->axes);
+        entry->matched = false;
+    }
+    for (size_t d = 0; d < count; d++) {
+        if (trackIDs) {
+            trackIDs[d] = 0;
+        }
+        // Unusable boxes are treated as already consumed
+        tracker->detectionUsed[d] = !(detections[d].width > 0 && detections[d].height > 0) || detections[d].score < config->lowScore;
+    }
+
+    // 1. Confident detections against established tracks (including lost ones)
+    size_t rowCount = 0, columnCount = 0;
+    for (size_t t = 0; t < tracker->trackCount; t++) {
+        if (tracker->tracks[t].track.state != RTSPTrackStateTentative) {
+            tracker->rows[rowCount++] = (uint32_t)t;
+        }
+    }
+    for (size_t d = 0; d < count; d++) {
+        if (!tracker->detectionUsed[d] && detections[d].score >= config->highScore) {
+            tracker->columns[columnCount++] = (uint32_t)d;
+        }
+    }
+    RTSPTrackerPass(tracker, rowCount, columnCount, detections, config->matchIoU, timestamp, trackIDs, false);
+
+    // 2. Low-confidence detections against tracks seen last frame and still unmatched
+    rowCount = columnCount = 0;
+    for (size_t t = 0; t < tracker->trackCount; t++) {
+        const RTSPTrackerEntry *entry = &tracker->tracks[t];
+        if (!entry->matched && entry->track.state == RTSPTrackStateConfirmed) {
+            tracker->rows[rowCount++] = (uint32_t)t;
+        }
+    }
+    for (size_t d = 0; d < count; d++) {
+        if (!tracker->detectionUsed[d] && detections[d].score < config->highScore) {
+            tracker->columns[columnCount++] = (uint32_t)d;
+        }
+    }
+    RTSPTrackerPass(tracker, rowCount, columnCount, detections, config->lowMatchIoU, timestamp, trackIDs, true);
+
+    // 3. Remaining confident detections against tentative tracks
+    rowCount = columnCount = 0;
+    for (size_t t = 0; t < tracker->trackCount; t++) {
+        if (tracker->tracks[t].track.state == RTSPTrackStateTentative) {
+            tracker->rows[rowCount++] = (uint32_t)t;
+        }
+    }
+    for (size_t d = 0; d < count; d++) {
+        if (!tracker->detectionUsed[d] && detections[d].score >= config->highScore) {
+            tracker->columns[columnCount++] = (uint32_t)d;
+        }
+    }
+    RTSPTrackerPass(tracker, rowCount, columnCount, detections, config->matchIoU, timestamp, trackIDs, false);
+
+    // Unmatched tracks: tentative ones are dropped, confirmed ones coast until maxAge
+    size_t kept = 0;
+    for (size_t t = 0; t < tracker->trackCount; t++) {
+        RTSPTrackerEntry *entry = &tracker->tracks[t];
+        if (!entry->matched) {
+            if (entry->track.state == RTSPTrackStateTentative) {
+                continue;
+            }
+            entry->track.state = RTSPTrackStateLost;
+            if (timestamp - entry->track.lastSeen > config->maxAge) {
+                RTSPTrackerEnd(tracker, entry);
+                continue;
+            }
+        } else if (entry->track.state == RTSPTrackStateConfirmed) {
+            RTSPTrackerUpdateZones(tracker, entry, timestamp);
+        }
+        if (kept != t) {
+            tracker->tracks[kept] = *entry;
+        }
+        kept++;
+    }
+    tracker->trackCount = kept;
+
+    // Unmatched confident detections start tentative tracks
+    for (size_t d = 0; d < count; d++) {
+        const RTSPTrackerDetection *detection = &detections[d];
+        if (tracker->detectionUsed[d] || detection->score < config->highScore) {
+            continue;
+        }
+        RTSPTrackerEntry *entry = &tracker->tracks[tracker->trackCount++];
+        memset(entry, 0, sizeof(*entry));
+        double scale = fmax(detection->height, RTSP_TRACKER_MIN_SCALE);
+        double r = (double)config->measurementNoise * scale;
+        r *= r;
+        RTSPTrackerAxisInit(&entry->axes[RTSPTrackerCentreX], detection->x + detection->width / 2.0, r, scale);
+        RTSPTrackerAxisInit(&entry->axes[RTSPTrackerCentreY], detection->y + detection->height / 2.0, r, scale);
+        RTSPTrackerAxisInit(&entry->axes[RTSPTrackerWidth], detection->width, r, scale);
+        RTSPTrackerAxisInit(&entry->axes[RTSPTrackerHeight], detection->height, r, scale);
+        entry->track.trackID = tracker->nextID++;
+        entry->track.classID = detection->classID;
+        entry->track.state = RTSPTrackStateTentative;
+        entry->track.score = detection->score;
+        entry->track.hits = 1;
+        entry->track.firstSeen = timestamp;
+        entry->track.lastSeen = timestamp;
+        entry->matched = true;
+        RTSPTrackerPublish(&entry->track, entry->axes);
+        if (trackIDs) {
+            trackIDs[d] = entry->track.trackID;
+        }
+        if (config->minHits <= 1) {
+            RTSPTrackerConfirm(tracker, entry, timestamp);
+            RTSPTrackerUpdateZones(tracker, entry, timestamp);
+        }
+    }
+
+    tracker->lastTimestamp = timestamp;
+    tracker->started = true;
+    tracker->statistics.updates++;
+    tracker->statistics.activeTracks = (uint32_t)tracker->trackCount;
+    return true;
+}
+
+const RTSPTrackEvent *RTSPTrackerEvents(RTSPTrackerRef tracker, size_t *count) {
+    *count = tracker->eventCount;
+    return tracker->events;
+}
+
+size_t RTSPTrackerGetTracks(RTSPTrackerRef tracker, double timestamp, RTSPTrack *tracks, size_t capacity) {
+    double dt = tracker->started ? timestamp - tracker->lastTimestamp : 0;
+    for (size_t t = 0; t < tracker->trackCount && t < capacity; t++) {
+        RTSPTrackerEntry entry = tracker->tracks[t];
+        RTSPTrackerPredictEntry(&tracker->config, &entry, dt);
+        RTSPTrackerPublish(&entry.track, entry.axes);
+        tracks[t] = entry.track;
+    }
+    return tracker->trackCount;
+}
+
+double RTSPTrackerZoneDwell(RTSPTrackerRef tracker, uint64_t trackID, uint32_t zone, double timestamp) {
+    if (zone >= tracker->zoneCount) {
+        return 0;
+    }
+    for (size_t t = 0; t < tracker->trackCount; t++) {
+        const RTSPTrackerEntry *entry = &tracker->tracks[t];
+        if (entry->track.trackID == trackID) {
+            return ((entry->track.zones >> zone) & 1) ? timestamp - entry->zoneEntered[zone] : 0;
+        }
+    }
+    return 0;
+}
+
+RTSPTrackerStatistics RTSPTrackerGetStatistics(RTSPTrackerRef tracker) {
+    return tracker->statistics;
+}
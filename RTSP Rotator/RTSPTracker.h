@@ -0,0 +1,149 @@
+//
+//  RTSPTracker.h
+//  RTSP Rotator
+//
+//  Multi-object tracker for one camera's detections (SORT / ByteTrack
+//  style). Each track carries a constant-velocity Kalman filter per box
+//  coordinate (centre x, centre y, width, height). Every update predicts
+//  all tracks to the frame time and associates detections by IoU with an
+//  optimal (Hungarian) assignment in three passes: confident detections
+//  against established tracks, then low-confidence detections against the
+//  tracks still unmatched (so partly occluded objects keep their ID), then
+//  the remaining confident detections against tentative tracks. Unmatched
+//  confident detections start tentative tracks. IoU is taken on buffered
+//  (enlarged) boxes, and a track coasting through an occlusion widens with
+//  its position uncertainty, so small or fast objects still overlap their
+//  prediction.
+//
+//  Tracks report lifecycle events (started once confirmed, ended after
+//  going unseen too long) and zone entry / exit with the dwell time, and
+//  can be queried between updates for predicted boxes, so inference can
+//  run on a subset of frames.
+//
+//  Coordinates are normalized (0.0 - 1.0), origin top-left; timestamps are
+//  seconds on any monotonic clock.
+//
+//  Plain C. Not thread-safe: one tracker per camera, used from one queue.
+//
+
+#ifndef RTSPTracker_h
+#define RTSPTracker_h
+
+#include "RTSPZoneIndex.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RTSP_TRACKER_MAX_ZONES 32
+
+typedef struct {
+    float highScore;                // Detections at or above start and keep tracks (default 0.5)
+    float lowScore;                 // Below highScore, only keep existing tracks alive; below this, ignored (default 0.1)
+    float matchIoU;                 // Minimum IoU for a confident match (default 0.3)
+    float lowMatchIoU;              // Minimum IoU for a low-confidence match (default 0.5)
+    float matchBuffer;              // Boxes grow by this fraction of their size on each side before IoU (default 0.3)
+    uint32_t minHits;               // Matches before a track is confirmed (default 3)
+    double maxAge;                  // Seconds unseen before a confirmed track ends (default 1.0)
+    float measurementNoise;         // Detection noise, fraction of box height (default 0.05)
+    float processNoise;             // Acceleration noise, box heights / s^2 (default 0.5)
+} RTSPTrackerConfig;
+
+typedef enum {
+    RTSPTrackStateTentative,        // Not yet matched minHits times
+    RTSPTrackStateConfirmed,        // Matched by the last update
+    RTSPTrackStateLost              // Confirmed, unmatched by the last update
+} RTSPTrackState;
+
+typedef struct {
+    float x, y, width, height;
+    float score;
+    uint32_t classID;               // Detections only match tracks of the same class
+} RTSPTrackerDetection;
+
+typedef struct {
+    uint64_t trackID;               // Unique per tracker, from 1
+    uint32_t classID;
+    RTSPTrackState state;
+    float x, y, width, height;      // Filtered box, or predicted when queried ahead
+    float velocityX, velocityY;     // Centre velocity per second
+    float score;                    // Last matched detection
+    uint32_t hits;
+    double firstSeen;
+    double lastSeen;
+    uint32_t zones;                 // Bit per zone the track's foot point is in
+} RTSPTrack;
+
+typedef enum {
+    RTSPTrackEventStarted,          // Track confirmed
+    RTSPTrackEventEnded,            // Confirmed track unseen for maxAge; duration = firstSeen to lastSeen
+    RTSPTrackEventZoneEntered,
+    RTSPTrackEventZoneExited        // duration = dwell in the zone
+} RTSPTrackEventType;
+
+typedef struct {
+    RTSPTrackEventType type;
+    uint64_t trackID;
+    uint32_t classID;
+    uint32_t zone;                  // Zone events
+    double timestamp;
+    double duration;
+    float x, y, width, height;
+} RTSPTrackEvent;
+
+typedef struct {
+    uint64_t updates;
+    uint64_t tracksStarted;
+    uint64_t tracksEnded;
+    uint64_t lowScoreMatches;       // Tracks kept alive by low-confidence detections
+    uint32_t activeTracks;
+} RTSPTrackerStatistics;
+
+typedef struct RTSPTracker *RTSPTrackerRef;
+
+void RTSPTrackerConfigInit(RTSPTrackerConfig *config);
+
+RTSPTrackerRef RTSPTrackerCreate(const RTSPTrackerConfig *config);
+void RTSPTrackerRelease(RTSPTrackerRef tracker);
+
+/// Drop every track (no events); IDs keep counting
+void RTSPTrackerReset(RTSPTrackerRef tracker);
+
+/// Zones as normalized rects (x, y, width, height per zone). A track is in
+/// a zone while the bottom centre of its box is. Replacing the zones clears
+/// membership without events.
+bool RTSPTrackerSetZones(RTSPTrackerRef tracker, const float (*zones)[4], uint32_t count);
+
+/// Zones as polygons (see RTSPZoneIndex.h; minOverlap is not used, only
+/// the foot point counts)
+bool RTSPTrackerSetZonePolygons(RTSPTrackerRef tracker, const RTSPZonePolygon *zones, uint32_t count);
+
+/// Advance to `timestamp` with a frame's detections. `trackIDs`, if given,
+/// receives a track ID per detection (0 for low-confidence detections that
+/// matched nothing). Returns false, changing nothing, if the timestamp is
+/// older than the previous update (a late frame) or on allocation failure.
+bool RTSPTrackerUpdate(RTSPTrackerRef tracker, double timestamp, const RTSPTrackerDetection *detections, size_t count,
+                       uint64_t *trackIDs);
+
+/// Events produced by the last update
+const RTSPTrackEvent *RTSPTrackerEvents(RTSPTrackerRef tracker, size_t *count);
+
+/// Copy up to `capacity` tracks with boxes predicted to `timestamp` (no
+/// earlier than the last update). Returns the number of tracks, which may
+/// exceed capacity. The tracker is not changed.
+size_t RTSPTrackerGetTracks(RTSPTrackerRef tracker, double timestamp, RTSPTrack *tracks, size_t capacity);
+
+/// Seconds a track has been in a zone as of `timestamp`; 0 when outside
+double RTSPTrackerZoneDwell(RTSPTrackerRef tracker, uint64_t trackID, uint32_t zone, double timestamp);
+
+RTSPTrackerStatistics RTSPTrackerGetStatistics(RTSPTrackerRef tracker);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RTSPTracker_h */
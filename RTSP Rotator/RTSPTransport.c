@@ -0,0 +1,623 @@
+//
+//  RTSPTransport.c
+//  RTSP Rotator
+//
+
+#include "RTSPTransport.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__APPLE__)
+#include <Security/SecureTransport.h>
+#define RTSP_TRANSPORT_SECURE_TRANSPORT 1
+#elif defined(RTSP_REMUX_USE_OPENSSL)
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#define RTSP_TRANSPORT_OPENSSL 1
+#endif
+
+#if RTSP_TRANSPORT_SECURE_TRANSPORT
+// SecureTransport is deprecated but remains the only TLS API that can be
+// driven from a poll() loop over a socket we own.
+#pragma clang diagnostic ignored "-Wdeprecated-declarations"
+#endif
+
+/// A host name lookup, shared by the transport and the thread doing it
+typedef struct {
+    pthread_mutex_t lock;
+    int references;
+    bool done;
+    int wakeFD;                     // -1 once the transport is gone
+    struct addrinfo *results;       // Handed over to the transport
+    char host[256];
+    char service[8];
+} RTSPTransportResolution;
+
+struct RTSPTransport {
+    int fd;                         // -1 while resolving or between attempts
+    bool secure;
+    bool connected;
+    bool handshakeDone;
+    bool verifyPeer;
+    char serverName[256];
+
+    // Connecting
+    RTSPTransportResolution *resolution;
+    struct addrinfo *addresses;
+    struct addrinfo *nextAddress;   // Tried when the current attempt fails
+    double attemptStarted;
+    int connectError;
+    bool resolveFailed;
+    bool tlsFailed;
+
+#if RTSP_TRANSPORT_SECURE_TRANSPORT
+    SSLContextRef ssl;
+#elif RTSP_TRANSPORT_OPENSSL
+    SSL *ssl;
+#endif
+};
+
+#pragma mark - Sockets
+
+static RTSPTransportResolver RTSPTransportResolve = getaddrinfo;
+
+void RTSPTransportSetResolver(RTSPTransportResolver resolver) {
+    RTSPTransportResolve = resolver ? resolver : getaddrinfo;
+}
+
+static double RTSPTransportNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void RTSPTransportHints(struct addrinfo *hints, int flags) {
+    memset(hints, 0, sizeof(*hints));
+    hints->ai_family = AF_UNSPEC;
+    hints->ai_socktype = SOCK_STREAM;
+    hints->ai_flags = AI_NUMERICSERV | flags;
+}
+
+/// Non-blocking socket with a connect in progress (or done), else -1 with errno set
+static int RTSPTransportOpenSocket(const struct addrinfo *ai) {
+    int fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (fd < 0) {
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+#ifdef SO_NOSIGPIPE
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+    if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0 || errno == EINPROGRESS) {
+        return fd;
+    }
+    int error = errno;
+    close(fd);
+    errno = error;
+    return -1;
+}
+
+#pragma mark - Resolution
+
+static void RTSPTransportResolutionRelease(RTSPTransportResolution *r) {
+    pthread_mutex_lock(&r->lock);
+    bool last = --r->references == 0;
+    pthread_mutex_unlock(&r->lock);
+    if (last) {
+        if (r->results) {
+            freeaddrinfo(r->results);
+        }
+        pthread_mutex_destroy(&r->lock);
+        free(r);
+    }
+}
+
+/// getaddrinfo has no timeout and no cancellation, so it runs here, where
+/// a dead DNS server stalls nobody; a transport released meanwhile just
+/// drops its reference
+static void *RTSPTransportResolveThread(void *argument) {
+    RTSPTransportResolution *r = argument;
+    struct addrinfo hints;
+    RTSPTransportHints(&hints, 0);
+    struct addrinfo *results = NULL;
+    if (RTSPTransportResolve(r->host, r->service, &hints, &results) != 0) {
+        results = NULL;
+    }
+
+    pthread_mutex_lock(&r->lock);
+    r->results = results;
+    r->done = true;
+    if (r->wakeFD >= 0) {
+        char byte = 1;
+        ssize_t result = write(r->wakeFD, &byte, 1);
+        (void)result; // A full pipe already guarantees a wakeup
+    }
+    pthread_mutex_unlock(&r->lock);
+    RTSPTransportResolutionRelease(r);
+    return NULL;
+}
+
+static bool RTSPTransportStartResolution(RTSPTransportRef t, const char *host, const char *service, int wakeFD) {
+    RTSPTransportResolution *r = calloc(1, sizeof(*r));
+    if (!r) {
+        return false;
+    }
+    pthread_mutex_init(&r->lock, NULL);
+    r->references = 2;
+    r->wakeFD = wakeFD;
+    snprintf(r->host, sizeof(r->host), "%s", host);
+    snprintf(r->service, sizeof(r->service), "%s", service);
+
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+    pthread_t thread;
+    int result = pthread_create(&thread, &attributes, RTSPTransportResolveThread, r);
+    pthread_attr_destroy(&attributes);
+    if (result != 0) {
+        pthread_mutex_destroy(&r->lock);
+        free(r);
+        return false;
+    }
+    t->resolution = r;
+    return true;
+}
+
+/// Close the current attempt and start the next address's. False when none is left.
+static bool RTSPTransportNextAttempt(RTSPTransportRef t) {
+    if (t->fd >= 0) {
+        close(t->fd);
+        t->fd = -1;
+    }
+    while (t->nextAddress) {
+        const struct addrinfo *ai = t->nextAddress;
+        t->nextAddress = ai->ai_next;
+        t->fd = RTSPTransportOpenSocket(ai);
+        if (t->fd >= 0) {
+            t->attemptStarted = RTSPTransportNow();
+            return true;
+        }
+        t->connectError = errno;
+    }
+    return false;
+}
+
+static RTSPTransportStatus RTSPTransportErrno(void) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+        return RTSPTransportWantRead;
+    }
+    return RTSPTransportError;
+}
+
+static ssize_t RTSPTransportSocketWrite(int fd, const void *buffer, size_t length) {
+#ifdef MSG_NOSIGNAL
+    return send(fd, buffer, length, MSG_NOSIGNAL);
+#else
+    return send(fd, buffer, length, 0);
+#endif
+}
+
+#pragma mark - SecureTransport
+
+#if RTSP_TRANSPORT_SECURE_TRANSPORT
+
+static OSStatus RTSPSecureTransportRead(SSLConnectionRef connection, void *data, size_t *length) {
+    const struct RTSPTransport *transport = connection;
+    size_t requested = *length;
+    size_t total = 0;
+    while (total < requested) {
+        ssize_t n = recv(transport->fd, (uint8_t *)data + total, requested - total, 0);
+        if (n > 0) {
+            total += (size_t)n;
+        } else if (n == 0) {
+            *length = total;
+            return errSSLClosedGraceful;
+        } else if (errno == EINTR) {
+            continue;
+        } else {
+            *length = total;
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? errSSLWouldBlock : errSSLClosedAbort;
+        }
+    }
+    *length = total;
+    return noErr;
+}
+
+static OSStatus RTSPSecureTransportWrite(SSLConnectionRef connection, const void *data, size_t *length) {
+    const struct RTSPTransport *transport = connection;
+    size_t requested = *length;
+    size_t total = 0;
+    while (total < requested) {
+        ssize_t n = RTSPTransportSocketWrite(transport->fd, (const uint8_t *)data + total, requested - total);
+        if (n > 0) {
+            total += (size_t)n;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else {
+            *length = total;
+            return (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) ? errSSLWouldBlock : errSSLClosedAbort;
+        }
+    }
+    *length = total;
+    return noErr;
+}
+
+static bool RTSPTransportStartTLS(RTSPTransportRef t) {
+    t->ssl = SSLCreateContext(kCFAllocatorDefault, kSSLClientSide, kSSLStreamType);
+    if (!t->ssl) {
+        return false;
+    }
+    SSLSetIOFuncs(t->ssl, RTSPSecureTransportRead, RTSPSecureTransportWrite);
+    SSLSetConnection(t->ssl, t);
+    SSLSetPeerDomainName(t->ssl, t->serverName, strlen(t->serverName));
+    SSLSetProtocolVersionMin(t->ssl, kTLSProtocol12);
+    if (!t->verifyPeer) {
+        SSLSetSessionOption(t->ssl, kSSLSessionOptionBreakOnServerAuth, true);
+    }
+    return true;
+}
+
+static RTSPTransportStatus RTSPTransportTLSHandshake(RTSPTransportRef t) {
+    for (;;) {
+        OSStatus status = SSLHandshake(t->ssl);
+        if (status == noErr) {
+            return RTSPTransportOK;
+        }
+        if (status == errSSLPeerAuthCompleted) {
+            continue; // Self-signed camera certificate accepted
+        }
+        if (status == errSSLWouldBlock) {
+            return RTSPTransportWantRead;
+        }
+        return RTSPTransportError;
+    }
+}
+
+static RTSPTransportStatus RTSPTransportTLSRead(RTSPTransportRef t, void *buffer, size_t length, size_t *count) {
+    size_t processed = 0;
+    OSStatus status = SSLRead(t->ssl, buffer, length, &processed);
+    *count = processed;
+    if (processed > 0) {
+        return RTSPTransportOK;
+    }
+    if (status == errSSLWouldBlock) {
+        return RTSPTransportWantRead;
+    }
+    return status == errSSLClosedGraceful || status == errSSLClosedNoNotify ? RTSPTransportClosed : RTSPTransportError;
+}
+
+static RTSPTransportStatus RTSPTransportTLSWrite(RTSPTransportRef t, const void *buffer, size_t length, size_t *count) {
+    size_t processed = 0;
+    OSStatus status = SSLWrite(t->ssl, buffer, length, &processed);
+    *count = processed;
+    if (processed > 0) {
+        return RTSPTransportOK;
+    }
+    return status == errSSLWouldBlock ? RTSPTransportWantWrite : RTSPTransportError;
+}
+
+static bool RTSPTransportTLSPending(RTSPTransportRef t) {
+    size_t buffered = 0;
+    return SSLGetBufferedReadSize(t->ssl, &buffered) == noErr && buffered > 0;
+}
+
+static void RTSPTransportTLSRelease(RTSPTransportRef t) {
+    if (t->ssl) {
+        SSLClose(t->ssl);
+        CFRelease(t->ssl);
+    }
+}
+
+#pragma mark - OpenSSL
+
+#elif RTSP_TRANSPORT_OPENSSL
+
+static SSL_CTX *gRTSPTransportContext;
+static pthread_once_t gRTSPTransportOnce = PTHREAD_ONCE_INIT;
+
+static void RTSPTransportCreateContext(void) {
+    gRTSPTransportContext = SSL_CTX_new(TLS_client_method());
+    if (gRTSPTransportContext) {
+        SSL_CTX_set_min_proto_version(gRTSPTransportContext, TLS1_2_VERSION);
+        SSL_CTX_set_default_verify_paths(gRTSPTransportContext);
+        SSL_CTX_set_mode(gRTSPTransportContext, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+    }
+}
+
+static bool RTSPTransportStartTLS(RTSPTransportRef t) {
+    pthread_once(&gRTSPTransportOnce, RTSPTransportCreateContext);
+    if (!gRTSPTransportContext) {
+        return false;
+    }
+    t->ssl = SSL_new(gRTSPTransportContext);
+    if (!t->ssl) {
+        return false;
+    }
+    SSL_set_fd(t->ssl, t->fd);
+    SSL_set_tlsext_host_name(t->ssl, t->serverName);
+    SSL_set_verify(t->ssl, t->verifyPeer ? SSL_VERIFY_PEER : SSL_VERIFY_NONE, NULL);
+    SSL_set_connect_state(t->ssl);
+    return true;
+}
+
+static RTSPTransportStatus RTSPTransportOpenSSLStatus(RTSPTransportRef t, int result) {
+    switch (SSL_get_error(t->ssl, result)) {
+        case SSL_ERROR_WANT_READ:
+            return RTSPTransportWantRead;
+        case SSL_ERROR_WANT_WRITE:
+            return RTSPTransportWantWrite;
+        case SSL_ERROR_ZERO_RETURN:
+            return RTSPTransportClosed;
+        default:
+            ERR_clear_error();
+            return RTSPTransportError;
+    }
+}
+
+static RTSPTransportStatus RTSPTransportTLSHandshake(RTSPTransportRef t) {
+    int result = SSL_do_handshake(t->ssl);
+    return result == 1 ? RTSPTransportOK : RTSPTransportOpenSSLStatus(t, result);
+}
+
+static RTSPTransportStatus RTSPTransportTLSRead(RTSPTransportRef t, void *buffer, size_t length, size_t *count) {
+    int result = SSL_read_ex(t->ssl, buffer, length, count);
+    return result == 1 ? RTSPTransportOK : RTSPTransportOpenSSLStatus(t, result);
+}
+
+static RTSPTransportStatus RTSPTransportTLSWrite(RTSPTransportRef t, const void *buffer, size_t length, size_t *count) {
+    int result = SSL_write_ex(t->ssl, buffer, length, count);
+    return result == 1 ? RTSPTransportOK : RTSPTransportOpenSSLStatus(t, result);
+}
+
+static bool RTSPTransportTLSPending(RTSPTransportRef t) {
+    return SSL_pending(t->ssl) > 0;
+}
+
+static void RTSPTransportTLSRelease(RTSPTransportRef t) {
+    if (t->ssl) {
+        SSL_free(t->ssl);
+    }
+}
+
+#endif
+
+#pragma mark - Transport
+
+bool RTSPTransportSupportsTLS(void) {
+#if RTSP_TRANSPORT_SECURE_TRANSPORT || RTSP_TRANSPORT_OPENSSL
+    return true;
+#else
+    return false;
+#endif
+}
+
+RTSPTransportRef RTSPTransportCreate(int fd, bool secure, const char *serverName, bool verifyPeer) {
+    if (fd < 0 || (secure && !RTSPTransportSupportsTLS())) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return NULL;
+    }
+    RTSPTransportRef transport = calloc(1, sizeof(*transport));
+    if (!transport) {
+        close(fd);
+        return NULL;
+    }
+    transport->fd = fd;
+    transport->secure = secure;
+    transport->verifyPeer = verifyPeer;
+    snprintf(transport->serverName, sizeof(transport->serverName), "%s", serverName ? serverName : "");
+    return transport;
+}
+
+RTSPTransportRef RTSPTransportConnect(const char *host, uint16_t port, bool secure, bool verifyPeer, int wakeFD) {
+    if (!host || (secure && !RTSPTransportSupportsTLS())) {
+        return NULL;
+    }
+    RTSPTransportRef transport = calloc(1, sizeof(*transport));
+    if (!transport) {
+        return NULL;
+    }
+    transport->fd = -1;
+    transport->secure = secure;
+    transport->verifyPeer = verifyPeer;
+    snprintf(transport->serverName, sizeof(transport->serverName), "%s", host);
+
+    char service[8];
+    snprintf(service, sizeof(service), "%u", port);
+    struct addrinfo hints;
+    RTSPTransportHints(&hints, AI_NUMERICHOST);
+    if (getaddrinfo(host, service, &hints, &transport->addresses) == 0 && transport->addresses) {
+        // An address needs no lookup
+        transport->nextAddress = transport->addresses;
+        RTSPTransportNextAttempt(transport);
+    } else {
+        transport->addresses = NULL;
+        transport->resolveFailed = !RTSPTransportStartResolution(transport, host, service, wakeFD);
+    }
+    return transport;
+}
+
+void RTSPTransportRelease(RTSPTransportRef transport) {
+    if (!transport) {
+        return;
+    }
+#if RTSP_TRANSPORT_SECURE_TRANSPORT || RTSP_TRANSPORT_OPENSSL
+    if (transport->secure) {
+        RTSPTransportTLSRelease(transport);
+    }
+#endif
+    if (transport->resolution) {
+        pthread_mutex_lock(&transport->resolution->lock);
+        transport->resolution->wakeFD = -1;
+        pthread_mutex_unlock(&transport->resolution->lock);
+        RTSPTransportResolutionRelease(transport->resolution);
+    }
+    if (transport->addresses) {
+        freeaddrinfo(transport->addresses);
+    }
+    if (transport->fd >= 0) {
+        close(transport->fd);
+    }
+    free(transport);
+}
+
+int RTSPTransportGetFD(RTSPTransportRef transport) {
+    return transport ? transport->fd : -1;
+}
+
+RTSPTransportStatus RTSPTransportHandshake(RTSPTransportRef t) {
+    if (t->handshakeDone) {
+        return RTSPTransportOK;
+    }
+
+    if (!t->connected) {
+        if (t->resolution) {
+            RTSPTransportResolution *r = t->resolution;
+            pthread_mutex_lock(&r->lock);
+            bool done = r->done;
+            if (done) {
+                t->addresses = r->results;
+                r->results = NULL;
+            }
+            pthread_mutex_unlock(&r->lock);
+            if (!done) {
+                return RTSPTransportWantWrite;
+            }
+            t->resolution = NULL;
+            RTSPTransportResolutionRelease(r);
+            t->resolveFailed = !t->addresses;
+            t->nextAddress = t->addresses;
+            return RTSPTransportNextAttempt(t) ? RTSPTransportWantWrite : RTSPTransportError;
+        }
+        if (t->fd < 0) {
+            return RTSPTransportError;   // Not resolved, or no address would take a connect
+        }
+
+        int error = 0;
+        socklen_t length = sizeof(error);
+        if (getsockopt(t->fd, SOL_SOCKET, SO_ERROR, &error, &length) != 0 || error != 0) {
+            t->connectError = error ? error : errno;
+            return RTSPTransportNextAttempt(t) ? RTSPTransportWantWrite : RTSPTransportError;
+        }
+        struct sockaddr_storage peer;
+        socklen_t peerLength = sizeof(peer);
+        if (getpeername(t->fd, (struct sockaddr *)&peer, &peerLength) != 0) {
+            if (errno != ENOTCONN) {
+                t->connectError = errno;
+                return RTSPTransportNextAttempt(t) ? RTSPTransportWantWrite : RTSPTransportError;
+            }
+            // A silent address (IPv6 without a route, say) gives way to the next
+            if (t->nextAddress && RTSPTransportNow() - t->attemptStarted >= RTSP_TRANSPORT_ATTEMPT_TIMEOUT) {
+                t->connectError = ETIMEDOUT;
+                return RTSPTransportNextAttempt(t) ? RTSPTransportWantWrite : RTSPTransportError;
+            }
+            return RTSPTransportWantWrite;
+        }
+        t->connected = true;
+        if (t->addresses) {
+            freeaddrinfo(t->addresses);
+            t->addresses = t->nextAddress = NULL;
+        }
+
+#if RTSP_TRANSPORT_SECURE_TRANSPORT || RTSP_TRANSPORT_OPENSSL
+        if (t->secure && !RTSPTransportStartTLS(t)) {
+            t->tlsFailed = true;
+            return RTSPTransportError;
+        }
+#endif
+    }
+
+#if RTSP_TRANSPORT_SECURE_TRANSPORT || RTSP_TRANSPORT_OPENSSL
+    if (t->secure) {
+        RTSPTransportStatus status = RTSPTransportTLSHandshake(t);
+        if (status != RTSPTransportOK) {
+            t->tlsFailed = status == RTSPTransportError || status == RTSPTransportClosed;
+            return status;
+        }
+    }
+#endif
+
+    t->handshakeDone = true;
+    return RTSPTransportOK;
+}
+
+bool RTSPTransportIsResolving(RTSPTransportRef t) {
+    return t && t->resolution;
+}
+
+const char *RTSPTransportFailureReason(RTSPTransportRef t) {
+    if (t->tlsFailed) {
+        return "TLS handshake failed";
+    }
+    if (t->resolveFailed) {
+        return "Could not resolve host";
+    }
+    switch (t->connectError) {
+        case 0:
+        case ECONNREFUSED:
+            return "Connection refused";
+        case ETIMEDOUT:
+            return "Connection timed out";
+        case ENETUNREACH:
+        case EHOSTUNREACH:
+            return "Host unreachable";
+        default:
+            return "Could not connect";
+    }
+}
+
+RTSPTransportStatus RTSPTransportRead(RTSPTransportRef t, void *buffer, size_t length, size_t *count) {
+    *count = 0;
+#if RTSP_TRANSPORT_SECURE_TRANSPORT || RTSP_TRANSPORT_OPENSSL
+    if (t->secure) {
+        return RTSPTransportTLSRead(t, buffer, length, count);
+    }
+#endif
+    ssize_t n = recv(t->fd, buffer, length, 0);
+    if (n > 0) {
+        *count = (size_t)n;
+        return RTSPTransportOK;
+    }
+    return n == 0 ? RTSPTransportClosed : RTSPTransportErrno();
+}
+
+RTSPTransportStatus RTSPTransportWrite(RTSPTransportRef t, const void *buffer, size_t length, size_t *count) {
+    *count = 0;
+#if RTSP_TRANSPORT_SECURE_TRANSPORT || RTSP_TRANSPORT_OPENSSL
+    if (t->secure) {
+        return RTSPTransportTLSWrite(t, buffer, length, count);
+    }
+#endif
+    ssize_t n = RTSPTransportSocketWrite(t->fd, buffer, length);
+    if (n >= 0) {
+        *count = (size_t)n;
+        return RTSPTransportOK;
+    }
+    RTSPTransportStatus status = RTSPTransportErrno();
+    return status == RTSPTransportWantRead ? RTSPTransportWantWrite : status;
+}
+
+bool RTSPTransportHasPendingInput(RTSPTransportRef t) {
+#if RTSP_TRANSPORT_SECURE_TRANSPORT || RTSP_TRANSPORT_OPENSSL
+    if (t->secure && t->ssl) {
+        return RTSPTransportTLSPending(t);
+    }
+#endif
+    (void)t;
+    return false;
+}
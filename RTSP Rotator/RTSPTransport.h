@@ -0,0 +1,89 @@
+//
+//  RTSPTransport.h
+//  RTSP Rotator
+//
+//  Non-blocking TCP / TLS client connection for the remux engine's event
+//  loop. TLS uses SecureTransport on Apple platforms and OpenSSL elsewhere
+//  (when built with RTSP_REMUX_USE_OPENSSL). Camera certificates are
+//  self-signed, so peer verification is optional.
+//
+//  Nothing here blocks the loop: host names resolve on a short-lived thread
+//  that wakes the loop when done, and each resolved address is tried in
+//  turn until one connects.
+//
+
+#ifndef RTSPTransport_h
+#define RTSPTransport_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+struct addrinfo;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    RTSPTransportOK = 0,
+    RTSPTransportWantRead,      // Retry when the socket is readable
+    RTSPTransportWantWrite,     // Retry when the socket is writable
+    RTSPTransportClosed,
+    RTSPTransportError
+} RTSPTransportStatus;
+
+typedef struct RTSPTransport *RTSPTransportRef;
+
+/// Start connecting to host:port without blocking. A numeric address
+/// connects at once; a name resolves on its own thread, which writes a byte
+/// to `wakeFD` (the loop's wake pipe) when done. Until then the transport
+/// has no socket (GetFD returns -1) and Handshake returns WantWrite. Returns
+/// NULL only if out of memory or TLS is unavailable.
+RTSPTransportRef RTSPTransportConnect(const char *host, uint16_t port, bool secure, bool verifyPeer, int wakeFD);
+
+/// Wrap a connected (or connecting) non-blocking socket. Takes ownership of `fd`.
+RTSPTransportRef RTSPTransportCreate(int fd, bool secure, const char *serverName, bool verifyPeer);
+void RTSPTransportRelease(RTSPTransportRef transport);
+
+int RTSPTransportGetFD(RTSPTransportRef transport);
+
+/// Whether TLS is compiled into this build
+bool RTSPTransportSupportsTLS(void);
+
+/// Finish resolution, the TCP connect and the TLS handshake. Returns OK
+/// when done. A connect that fails, or that has not completed within
+/// RTSP_TRANSPORT_ATTEMPT_TIMEOUT while other addresses remain, moves on to
+/// the next address. Call it when the socket is ready and on every timer
+/// pass while connecting, so resolution and attempt timeouts advance.
+RTSPTransportStatus RTSPTransportHandshake(RTSPTransportRef transport);
+
+#define RTSP_TRANSPORT_ATTEMPT_TIMEOUT 2.0
+
+/// Still waiting for the host name to resolve
+bool RTSPTransportIsResolving(RTSPTransportRef transport);
+
+/// Why Handshake returned Error, e.g. "Could not resolve host"
+const char *RTSPTransportFailureReason(RTSPTransportRef transport);
+
+/// Name resolver, getaddrinfo by default; results are freed with
+/// freeaddrinfo. Benchmarks install a slow one. Set it before any connect.
+typedef int (*RTSPTransportResolver)(const char *host, const char *service,
+                                     const struct addrinfo *hints, struct addrinfo **results);
+void RTSPTransportSetResolver(RTSPTransportResolver resolver);
+
+/// Read up to `length` bytes. `*count` is set on OK.
+RTSPTransportStatus RTSPTransportRead(RTSPTransportRef transport, void *buffer, size_t length, size_t *count);
+
+/// Write up to `length` bytes. `*count` is set on OK (may be short).
+RTSPTransportStatus RTSPTransportWrite(RTSPTransportRef transport, const void *buffer, size_t length, size_t *count);
+
+/// Whether decrypted bytes are buffered inside the TLS layer (poll() will not report them)
+bool RTSPTransportHasPendingInput(RTSPTransportRef transport);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RTSPTransport_h */
@@ -11,6 +11,10 @@
 
 NS_ASSUME_NONNULL_BEGIN
 
+/// Posted on the main queue when a feed starts playing.
+/// userInfo: @"index" (NSNumber), @"count" (NSNumber)
+extern NSString * const RTSPWallpaperControllerDidSwitchFeedNotification;
+
 /// Main controller for managing RTSP feed rotation and playback
 @interface RTSPWallpaperController : NSObject
 
@@ -0,0 +1,198 @@
+//
+//  RTSPWebSocket.c
+//  RTSP Rotator
+//
+
+#include "RTSPWebSocket.h"
+
+#include <string.h>
+
+#pragma mark - Handshake
+
+typedef struct {
+    uint32_t state[5];
+    uint64_t length;
+    uint8_t block[64];
+    size_t used;
+} RTSPSHA1Context;
+
+static uint32_t RTSPSHA1Rotate(uint32_t value, int bits) {
+    return (value << bits) | (value >> (32 - bits));
+}
+
+static void RTSPSHA1Transform(RTSPSHA1Context *context, const uint8_t block[64]) {
+    uint32_t w[80];
+    for (int i = 0; i < 16; i++) {
+        w[i] = (uint32_t)block[i * 4] << 24 | (uint32_t)block[i * 4 + 1] << 16 |
+               (uint32_t)block[i * 4 + 2] << 8 | (uint32_t)block[i * 4 + 3];
+    }
+    for (int i = 16; i < 80; i++) {
+        w[i] = RTSPSHA1Rotate(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+    uint32_t a = context->state[0], b = context->state[1], c = context->state[2];
+    uint32_t d = context->state[3], e = context->state[4];
+    for (int i = 0; i < 80; i++) {
+        uint32_t f, k;
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+        uint32_t temp = RTSPSHA1Rotate(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = RTSPSHA1Rotate(b, 30);
+        b = a;
+        a = temp;
+    }
+    context->state[0] += a;
+    context->state[1] += b;
+    context->state[2] += c;
+    context->state[3] += d;
+    context->state[4] += e;
+}
+
+static void RTSPSHA1Update(RTSPSHA1Context *context, const void *data, size_t length) {
+    const uint8_t *bytes = data;
+    context->length += length;
+    while (length > 0) {
+        size_t take = 64 - context->used;
+        if (take > length) {
+            take = length;
+        }
+        memcpy(context->block + context->used, bytes, take);
+        context->used += take;
+        bytes += take;
+        length -= take;
+        if (context->used == 64) {
+            RTSPSHA1Transform(context, context->block);
+            context->used = 0;
+        }
+    }
+}
+
+static void RTSPSHA1(const void *first, size_t firstLength, const void *second, size_t secondLength,
+                     uint8_t digest[20]) {
+    RTSPSHA1Context context = {
+        .state = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0},
+    };
+    RTSPSHA1Update(&context, first, firstLength);
+    RTSPSHA1Update(&context, second, secondLength);
+
+    uint64_t bits = context.length * 8;
+    uint8_t padding[72] = {0x80};
+    size_t padLength = (context.used < 56 ? 56 : 120) - context.used;
+    for (int i = 0; i < 8; i++) {
+        padding[padLength + i] = (uint8_t)(bits >> (56 - 8 * i));
+    }
+    RTSPSHA1Update(&context, padding, padLength + 8);
+
+    for (int i = 0; i < 5; i++) {
+        digest[i * 4] = (uint8_t)(context.state[i] >> 24);
+        digest[i * 4 + 1] = (uint8_t)(context.state[i] >> 16);
+        digest[i * 4 + 2] = (uint8_t)(context.state[i] >> 8);
+        digest[i * 4 + 3] = (uint8_t)context.state[i];
+    }
+}
+
+void RTSPWebSocketAcceptKey(const char *key, char accept[RTSP_WEBSOCKET_ACCEPT_LENGTH + 1]) {
+    static const char guid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    uint8_t digest[20];
+    RTSPSHA1(key, strlen(key), guid, sizeof(guid) - 1, digest);
+
+    char *out = accept;
+    for (int i = 0; i < 20; i += 3) {
+        uint32_t group = (uint32_t)digest[i] << 16;
+        if (i + 1 < 20) {
+            group |= (uint32_t)digest[i + 1] << 8;
+        }
+        if (i + 2 < 20) {
+            group |= digest[i + 2];
+        }
+        *out++ = alphabet[(group >> 18) & 0x3F];
+        *out++ = alphabet[(group >> 12) & 0x3F];
+        *out++ = i + 1 < 20 ? alphabet[(group >> 6) & 0x3F] : '=';
+        *out++ = i + 2 < 20 ? alphabet[group & 0x3F] : '=';
+    }
+    *out = '\0';
+}
+
+#pragma mark - Frames
+
+void RTSPWebSocketAppendFrame(RTSPByteBuffer *buffer, RTSPWebSocketOpcode opcode, const void *payload, size_t length) {
+    RTSPByteBufferAppendU8(buffer, (uint8_t)(0x80 | opcode));
+    if (length < 126) {
+        RTSPByteBufferAppendU8(buffer, (uint8_t)length);
+    } else if (length <= 0xFFFF) {
+        RTSPByteBufferAppendU8(buffer, 126);
+        RTSPByteBufferAppendU16(buffer, (uint16_t)length);
+    } else {
+        RTSPByteBufferAppendU8(buffer, 127);
+        RTSPByteBufferAppendU64(buffer, (uint64_t)length);
+    }
+    RTSPByteBufferAppend(buffer, payload, length);
+}
+
+RTSPWebSocketParseResult RTSPWebSocketParseFrame(uint8_t *data, size_t length, size_t maxPayload,
+                                                 RTSPWebSocketFrame *frame) {
+    if (length < 2) {
+        return RTSPWebSocketParseNeedMore;
+    }
+    bool final = (data[0] & 0x80) != 0;
+    uint8_t opcode = data[0] & 0x0F;
+    bool masked = (data[1] & 0x80) != 0;
+    uint64_t payloadLength = data[1] & 0x7F;
+    if ((data[0] & 0x70) != 0 || !masked) {
+        return RTSPWebSocketParseInvalid; // No extensions were negotiated; clients must mask
+    }
+    if (opcode >= RTSPWebSocketOpcodeClose && (!final || payloadLength > 125)) {
+        return RTSPWebSocketParseInvalid;
+    }
+
+    size_t offset = 2;
+    if (payloadLength == 126) {
+        if (length < 4) {
+            return RTSPWebSocketParseNeedMore;
+        }
+        payloadLength = (uint64_t)data[2] << 8 | data[3];
+        offset = 4;
+    } else if (payloadLength == 127) {
+        if (length < 10) {
+            return RTSPWebSocketParseNeedMore;
+        }
+        payloadLength = 0;
+        for (int i = 0; i < 8; i++) {
+            payloadLength = payloadLength << 8 | data[2 + i];
+        }
+        offset = 10;
+    }
+    if (payloadLength > maxPayload) {
+        return RTSPWebSocketParseInvalid;
+    }
+    if (length < offset + 4 + payloadLength) {
+        return RTSPWebSocketParseNeedMore;
+    }
+
+    const uint8_t *mask = data + offset;
+    uint8_t *payload = data + offset + 4;
+    for (size_t i = 0; i < payloadLength; i++) {
+        payload[i] ^= mask[i & 3];
+    }
+    *frame = (RTSPWebSocketFrame){
+        .opcode = (RTSPWebSocketOpcode)opcode,
+        .final = final,
+        .payload = payload,
+        .payloadLength = (size_t)payloadLength,
+        .frameLength = offset + 4 + (size_t)payloadLength,
+    };
+    return RTSPWebSocketParseComplete;
+}
@@ -0,0 +1,63 @@
+//
+//  RTSPWebSocket.h
+//  RTSP Rotator
+//
+//  RFC 6455 pieces needed by the embedded HTTP server: the opening
+//  handshake key, server frame encoding and client frame parsing. Only the
+//  server side is implemented; client frames must be masked.
+//
+
+#ifndef RTSPWebSocket_h
+#define RTSPWebSocket_h
+
+#include "RTSPByteBuffer.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    RTSPWebSocketOpcodeContinuation = 0x0,
+    RTSPWebSocketOpcodeText = 0x1,
+    RTSPWebSocketOpcodeBinary = 0x2,
+    RTSPWebSocketOpcodeClose = 0x8,
+    RTSPWebSocketOpcodePing = 0x9,
+    RTSPWebSocketOpcodePong = 0xA
+} RTSPWebSocketOpcode;
+
+#define RTSP_WEBSOCKET_ACCEPT_LENGTH 28
+
+/// Sec-WebSocket-Accept for a client's Sec-WebSocket-Key. `accept` receives
+/// RTSP_WEBSOCKET_ACCEPT_LENGTH characters plus a NUL.
+void RTSPWebSocketAcceptKey(const char *key, char accept[RTSP_WEBSOCKET_ACCEPT_LENGTH + 1]);
+
+/// Appends one unfragmented, unmasked server frame
+void RTSPWebSocketAppendFrame(RTSPByteBuffer *buffer, RTSPWebSocketOpcode opcode, const void *payload, size_t length);
+
+typedef struct {
+    RTSPWebSocketOpcode opcode;
+    bool final;
+    const uint8_t *payload;         // Unmasked in place
+    size_t payloadLength;
+    size_t frameLength;             // Bytes to consume from the input
+} RTSPWebSocketFrame;
+
+typedef enum {
+    RTSPWebSocketParseNeedMore = 0,
+    RTSPWebSocketParseComplete,
+    RTSPWebSocketParseInvalid       // Unmasked, oversized or malformed; close the connection
+} RTSPWebSocketParseResult;
+
+/// Parses the client frame at the start of `data`, unmasking its payload
+RTSPWebSocketParseResult RTSPWebSocketParseFrame(uint8_t *data, size_t length, size_t maxPayload,
+                                                 RTSPWebSocketFrame *frame);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RTSPWebSocket_h */
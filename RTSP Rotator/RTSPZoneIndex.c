@@ -0,0 +1,388 @@
+//
+//  RTSPZoneIndex.c
+//  RTSP Rotator
+//
+//  Overlap is computed exactly: the polygon is clipped to the box
+//  (Sutherland-Hodgman, which is exact in area for concave polygons too)
+//  and measured with the shoelace formula. Rectangles skip the clip.
+//
+
+#include "RTSPZoneIndex.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RTSP_ZONE_INDEX_DEFAULT_GRID 16
+#define RTSP_ZONE_INDEX_MAX_GRID 256
+// Clipping against one side of a box at most doubles a polygon's vertices
+#define RTSP_ZONE_CLIP_CAPACITY (RTSP_ZONE_INDEX_MAX_POINTS * 16)
+
+/// Polygon edge from (x0, y0) to (x1, y1)
+typedef struct {
+    float x0, y0;
+    float x1, y1;
+    float slope;                    // dx / dy, for the crossing test (0 when horizontal)
+} RTSPZoneEdge;
+
+typedef struct {
+    float minX, minY, maxX, maxY;   // Bounds
+    float minOverlap;
+    uint32_t first;                 // Into edges and points
+    uint32_t count;
+    bool rectangle;                 // Axis-aligned: overlap is a rect intersection
+} RTSPZoneEntry;
+
+struct RTSPZoneIndex {
+    uint32_t zoneCount;
+    RTSPZoneEntry zones[RTSP_ZONE_INDEX_MAX_ZONES];
+    RTSPZoneEdge *edges;
+    RTSPZonePoint *points;
+    uint32_t gridSize;
+    float gridX, gridY;             // Grid origin: the zones' joint bounds
+    float cellWidth, cellHeight;
+    float gridMaxX, gridMaxY;
+    RTSPZoneMask *inside;           // Per cell: zones covering all of it
+    RTSPZoneMask *boundary;         // Per cell: zones whose boundary touches it
+};
+
+#pragma mark - Geometry
+
+static bool RTSPZoneValid(const RTSPZonePolygon *zone) {
+    if (!zone->points || zone->pointCount < 3 || zone->pointCount > RTSP_ZONE_INDEX_MAX_POINTS ||
+        !(zone->minOverlap >= 0.0f && zone->minOverlap <= 1.0f)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < zone->pointCount; i++) {
+        if (!isfinite(zone->points[i].x) || !isfinite(zone->points[i].y)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void RTSPZoneBuildEdges(const RTSPZonePoint *points, uint32_t count, RTSPZoneEdge *edges) {
+    for (uint32_t i = 0; i < count; i++) {
+        RTSPZonePoint a = points[i], b = points[(i + 1) % count];
+        edges[i] = (RTSPZoneEdge){a.x, a.y, b.x, b.y, a.y != b.y ? (b.x - a.x) / (b.y - a.y) : 0.0f};
+    }
+}
+
+static void RTSPZoneBuildEntry(const RTSPZonePolygon *zone, uint32_t first, RTSPZoneEntry *entry) {
+    const RTSPZonePoint *points = zone->points;
+    *entry = (RTSPZoneEntry){points[0].x, points[0].y, points[0].x, points[0].y, zone->minOverlap, first,
+                             zone->pointCount, false};
+    for (uint32_t i = 1; i < zone->pointCount; i++) {
+        entry->minX = fminf(entry->minX, points[i].x);
+        entry->minY = fminf(entry->minY, points[i].y);
+        entry->maxX = fmaxf(entry->maxX, points[i].x);
+        entry->maxY = fmaxf(entry->maxY, points[i].y);
+    }
+    // Four corners of the bounds joined by axis-aligned edges
+    bool rectangle = zone->pointCount == 4;
+    for (uint32_t i = 0; rectangle && i < 4; i++) {
+        RTSPZonePoint a = points[i], b = points[(i + 1) % 4];
+        rectangle = (a.x == entry->minX || a.x == entry->maxX) && (a.y == entry->minY || a.y == entry->maxY) &&
+                    ((a.x == b.x) != (a.y == b.y));
+    }
+    entry->rectangle = rectangle;
+}
+
+/// Crossing test; half-open on the right and bottom like a rect
+static bool RTSPZoneContains(const RTSPZoneEdge *edges, uint32_t count, float x, float y) {
+    bool inside = false;
+    for (uint32_t i = 0; i < count; i++) {
+        const RTSPZoneEdge *edge = &edges[i];
+        if ((edge->y0 > y) != (edge->y1 > y) && x < edge->x0 + (y - edge->y0) * edge->slope) {
+            inside = !inside;
+        }
+    }
+    return inside;
+}
+
+/// Whether an edge touches a closed rect (Liang-Barsky)
+static bool RTSPZoneEdgeTouches(const RTSPZoneEdge *edge, float x0, float y0, float x1, float y1) {
+    float dx = edge->x1 - edge->x0, dy = edge->y1 - edge->y0;
+    float p[4] = {-dx, dx, -dy, dy};
+    float q[4] = {edge->x0 - x0, x1 - edge->x0, edge->y0 - y0, y1 - edge->y0};
+    float t0 = 0.0f, t1 = 1.0f;
+    for (int k = 0; k < 4; k++) {
+        if (p[k] == 0.0f) {
+            if (q[k] < 0.0f) {
+                return false;
+            }
+            continue;
+        }
+        float t = q[k] / p[k];
+        if (p[k] < 0.0f) {
+            if (t > t1) {
+                return false;
+            }
+            t0 = fmaxf(t0, t);
+        } else {
+            if (t < t0) {
+                return false;
+            }
+            t1 = fminf(t1, t);
+        }
+    }
+    return true;
+}
+
+/// Keep the part of a polygon on the inner side of one box side: 0 left,
+/// 1 right, 2 top, 3 bottom
+static uint32_t RTSPZoneClipSide(const RTSPZonePoint *input, uint32_t count, RTSPZonePoint *output, int side,
+                                 float bound) {
+    uint32_t written = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        RTSPZonePoint current = input[i], previous = input[(i + count - 1) % count];
+        float c = side < 2 ? current.x : current.y, p = side < 2 ? previous.x : previous.y;
+        bool currentIn = (side & 1) ? c <= bound : c >= bound;
+        bool previousIn = (side & 1) ? p <= bound : p >= bound;
+        if (currentIn != previousIn) {
+            float t = (bound - p) / (c - p);
+            RTSPZonePoint crossing = {previous.x + t * (current.x - previous.x), previous.y + t * (current.y - previous.y)};
+            if (side < 2) {
+                crossing.x = bound;
+            } else {
+                crossing.y = bound;
+            }
+            output[written++] = crossing;
+        }
+        if (currentIn) {
+            output[written++] = current;
+        }
+    }
+    return written;
+}
+
+/// Area of a polygon inside a box
+static double RTSPZoneClippedArea(const RTSPZonePoint *points, uint32_t count, float x0, float y0, float x1, float y1) {
+    RTSPZonePoint first[RTSP_ZONE_CLIP_CAPACITY], second[RTSP_ZONE_CLIP_CAPACITY];
+    const float bounds[4] = {x0, x1, y0, y1};
+    const RTSPZonePoint *input = points;
+    RTSPZonePoint *output = first;
+    for (int side = 0; side < 4 && count > 0; side++) {
+        count = RTSPZoneClipSide(input, count, output, side, bounds[side]);
+        input = output;
+        output = output == first ? second : first;
+    }
+    double area = 0.0;
+    for (uint32_t i = 0; i < count; i++) {
+        RTSPZonePoint a = input[i], b = input[(i + 1) % count];
+        area += (double)a.x * b.y - (double)b.x * a.y;
+    }
+    return fabs(area) * 0.5;
+}
+
+/// Fraction of a box (with positive area) inside a zone
+static float RTSPZoneEntryOverlap(const RTSPZoneEntry *entry, const RTSPZonePoint *points, float x, float y,
+                                  float width, float height) {
+    float x1 = x + width, y1 = y + height;
+    float iw = fminf(x1, entry->maxX) - fmaxf(x, entry->minX);
+    float ih = fminf(y1, entry->maxY) - fmaxf(y, entry->minY);
+    if (iw <= 0.0f || ih <= 0.0f) {
+        return 0.0f;
+    }
+    double area = entry->rectangle ? (double)iw * ih : RTSPZoneClippedArea(points, entry->count, x, y, x1, y1);
+    float fraction = (float)(area / ((double)width * height));
+    return fraction < 1.0f ? fraction : 1.0f;
+}
+
+static bool RTSPZoneMeets(const RTSPZoneEntry *entry, float fraction) {
+    return entry->minOverlap > 0.0f ? fraction >= entry->minOverlap : fraction > 0.0f;
+}
+
+float RTSPZonePolygonOverlap(const RTSPZonePolygon *zone, float x, float y, float width, float height) {
+    if (!zone || !RTSPZoneValid(zone)) {
+        return 0.0f;
+    }
+    RTSPZoneEntry entry;
+    RTSPZoneBuildEntry(zone, 0, &entry);
+    if (!(width > 0.0f) || !(height > 0.0f)) {
+        RTSPZoneEdge edges[RTSP_ZONE_INDEX_MAX_POINTS];
+        RTSPZoneBuildEdges(zone->points, zone->pointCount, edges);
+        return RTSPZoneContains(edges, zone->pointCount, x + width * 0.5f, y + height * 0.5f) ? 1.0f : 0.0f;
+    }
+    return RTSPZoneEntryOverlap(&entry, zone->points, x, y, width, height);
+}
+
+#pragma mark - Index
+
+RTSPZoneIndexRef RTSPZoneIndexCreate(const RTSPZonePolygon *zones, uint32_t count, uint32_t gridSize) {
+    if (count > RTSP_ZONE_INDEX_MAX_ZONES || (count > 0 && !zones) || gridSize > RTSP_ZONE_INDEX_MAX_GRID) {
+        return NULL;
+    }
+    uint32_t pointTotal = 0;
+    for (uint32_t z = 0; z < count; z++) {
+        if (!RTSPZoneValid(&zones[z])) {
+            return NULL;
+        }
+        pointTotal += zones[z].pointCount;
+    }
+    RTSPZoneIndexRef index = calloc(1, sizeof(*index));
+    if (!index) {
+        return NULL;
+    }
+    index->zoneCount = count;
+    index->gridSize = gridSize ? gridSize : RTSP_ZONE_INDEX_DEFAULT_GRID;
+    size_t cells = (size_t)index->gridSize * index->gridSize;
+    index->edges = malloc((pointTotal ? pointTotal : 1) * sizeof(*index->edges));
+    index->points = malloc((pointTotal ? pointTotal : 1) * sizeof(*index->points));
+    index->inside = calloc(cells, sizeof(*index->inside));
+    index->boundary = calloc(cells, sizeof(*index->boundary));
+    if (!index->edges || !index->points || !index->inside || !index->boundary) {
+        RTSPZoneIndexRelease(index);
+        return NULL;
+    }
+
+    float minX = INFINITY, minY = INFINITY, maxX = -INFINITY, maxY = -INFINITY;
+    uint32_t first = 0;
+    for (uint32_t z = 0; z < count; z++) {
+        RTSPZoneEntry *entry = &index->zones[z];
+        RTSPZoneBuildEntry(&zones[z], first, entry);
+        memcpy(index->points + first, zones[z].points, zones[z].pointCount * sizeof(RTSPZonePoint));
+        RTSPZoneBuildEdges(zones[z].points, zones[z].pointCount, index->edges + first);
+        first += zones[z].pointCount;
+        minX = fminf(minX, entry->minX);
+        minY = fminf(minY, entry->minY);
+        maxX = fmaxf(maxX, entry->maxX);
+        maxY = fmaxf(maxY, entry->maxY);
+    }
+    if (count == 0) {
+        minX = minY = 0.0f;
+        maxX = maxY = 1.0f;
+    }
+    index->gridX = minX;
+    index->gridY = minY;
+    index->gridMaxX = maxX;
+    index->gridMaxY = maxY;
+    index->cellWidth = fmaxf(maxX - minX, 1e-6f) / (float)index->gridSize;
+    index->cellHeight = fmaxf(maxY - minY, 1e-6f) / (float)index->gridSize;
+
+    // Classify the cells under each zone's bounds
+    uint32_t grid = index->gridSize;
+    for (uint32_t z = 0; z < count; z++) {
+        const RTSPZoneEntry *entry = &index->zones[z];
+        const RTSPZoneEdge *edges = index->edges + entry->first;
+        RTSPZoneMask bit = (RTSPZoneMask)1 << z;
+        uint32_t cx0 = (uint32_t)fminf(floorf((entry->minX - minX) / index->cellWidth), grid - 1);
+        uint32_t cx1 = (uint32_t)fminf(floorf((entry->maxX - minX) / index->cellWidth), grid - 1);
+        uint32_t cy0 = (uint32_t)fminf(floorf((entry->minY - minY) / index->cellHeight), grid - 1);
+        uint32_t cy1 = (uint32_t)fminf(floorf((entry->maxY - minY) / index->cellHeight), grid - 1);
+        for (uint32_t cy = cy0; cy <= cy1; cy++) {
+            float y0 = minY + cy * index->cellHeight, y1 = y0 + index->cellHeight;
+            for (uint32_t cx = cx0; cx <= cx1; cx++) {
+                float x0 = minX + cx * index->cellWidth, x1 = x0 + index->cellWidth;
+                bool touched = false;
+                for (uint32_t e = 0; e < entry->count && !touched; e++) {
+                    touched = RTSPZoneEdgeTouches(&edges[e], x0, y0, x1, y1);
+                }
+                size_t cell = (size_t)cy * grid + cx;
+                if (touched) {
+                    index->boundary[cell] |= bit;
+                } else if (RTSPZoneContains(edges, entry->count, (x0 + x1) * 0.5f, (y0 + y1) * 0.5f)) {
+                    index->inside[cell] |= bit;
+                }
+            }
+        }
+    }
+    return index;
+}
+
+void RTSPZoneIndexRelease(RTSPZoneIndexRef index) {
+    if (!index) {
+        return;
+    }
+    free(index->edges);
+    free(index->points);
+    free(index->inside);
+    free(index->boundary);
+    free(index);
+}
+
+uint32_t RTSPZoneIndexCount(RTSPZoneIndexRef index) {
+    return index ? index->zoneCount : 0;
+}
+
+static uint32_t RTSPZoneCellX(RTSPZoneIndexRef index, float x) {
+    float cell = floorf((x - index->gridX) / index->cellWidth);
+    return cell <= 0.0f ? 0 : cell >= (float)(index->gridSize - 1) ? index->gridSize - 1 : (uint32_t)cell;
+}
+
+static uint32_t RTSPZoneCellY(RTSPZoneIndexRef index, float y) {
+    float cell = floorf((y - index->gridY) / index->cellHeight);
+    return cell <= 0.0f ? 0 : cell >= (float)(index->gridSize - 1) ? index->gridSize - 1 : (uint32_t)cell;
+}
+
+RTSPZoneMask RTSPZoneIndexZonesAtPoint(RTSPZoneIndexRef index, float x, float y) {
+    if (!index || index->zoneCount == 0 || !(x >= index->gridX && x < index->gridMaxX && y >= index->gridY &&
+                                             y < index->gridMaxY)) {
+        return 0;
+    }
+    size_t cell = (size_t)RTSPZoneCellY(index, y) * index->gridSize + RTSPZoneCellX(index, x);
+    RTSPZoneMask mask = index->inside[cell];
+    for (RTSPZoneMask pending = index->boundary[cell]; pending; pending &= pending - 1) {
+        uint32_t z = (uint32_t)__builtin_ctzll(pending);
+        const RTSPZoneEntry *entry = &index->zones[z];
+        if (RTSPZoneContains(index->edges + entry->first, entry->count, x, y)) {
+            mask |= (RTSPZoneMask)1 << z;
+        }
+    }
+    return mask;
+}
+
+RTSPZoneMask RTSPZoneIndexMatchBox(RTSPZoneIndexRef index, float x, float y, float width, float height,
+                                   float *overlaps) {
+    uint32_t count = index ? index->zoneCount : 0;
+    if (overlaps) {
+        memset(overlaps, 0, count * sizeof(*overlaps));
+    }
+    if (count == 0) {
+        return 0;
+    }
+    if (!(width > 0.0f) || !(height > 0.0f)) {
+        // No area: a point, wholly inside the zones containing it
+        RTSPZoneMask mask = RTSPZoneIndexZonesAtPoint(index, x + width * 0.5f, y + height * 0.5f);
+        for (RTSPZoneMask pending = mask; overlaps && pending; pending &= pending - 1) {
+            overlaps[__builtin_ctzll(pending)] = 1.0f;
+        }
+        return mask;
+    }
+    float x1 = x + width, y1 = y + height;
+    if (x1 <= index->gridX || y1 <= index->gridY || x >= index->gridMaxX || y >= index->gridMaxY) {
+        return 0;
+    }
+
+    // Zones in the covered cells, and those covering every one of them
+    uint32_t cx0 = RTSPZoneCellX(index, x), cx1 = RTSPZoneCellX(index, x1);
+    uint32_t cy0 = RTSPZoneCellY(index, y), cy1 = RTSPZoneCellY(index, y1);
+    RTSPZoneMask candidates = 0, whole = ~(RTSPZoneMask)0;
+    for (uint32_t cy = cy0; cy <= cy1; cy++) {
+        const RTSPZoneMask *inside = index->inside + (size_t)cy * index->gridSize;
+        const RTSPZoneMask *boundary = index->boundary + (size_t)cy * index->gridSize;
+        for (uint32_t cx = cx0; cx <= cx1; cx++) {
+            candidates |= inside[cx] | boundary[cx];
+            whole &= inside[cx];
+        }
+    }
+    bool withinGrid = x >= index->gridX && y >= index->gridY && x1 <= index->gridMaxX && y1 <= index->gridMaxY;
+    if (!withinGrid) {
+        whole = 0;
+    }
+
+    RTSPZoneMask mask = 0;
+    for (RTSPZoneMask pending = candidates; pending; pending &= pending - 1) {
+        uint32_t z = (uint32_t)__builtin_ctzll(pending);
+        const RTSPZoneEntry *entry = &index->zones[z];
+        float fraction = ((whole >> z) & 1) ? 1.0f
+            : RTSPZoneEntryOverlap(entry, index->points + entry->first, x, y, width, height);
+        if (overlaps) {
+            overlaps[z] = fraction;
+        }
+        if (RTSPZoneMeets(entry, fraction)) {
+            mask |= (RTSPZoneMask)1 << z;
+        }
+    }
+    return mask;
+}
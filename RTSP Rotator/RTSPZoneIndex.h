@@ -0,0 +1,75 @@
+//
+//  RTSPZoneIndex.h
+//  RTSP Rotator
+//
+//  Matches detection boxes against a camera's zones. Zones are simple
+//  polygons (convex or not, either winding) in normalized coordinates with
+//  a minimum overlap: the fraction of a box's area that must lie inside the
+//  zone for the box to count as in it.
+//
+//  Each polygon is kept as an edge table. A uniform grid over the frame
+//  records, per cell, the zones that cover the cell entirely and the zones
+//  whose boundary crosses it, so a box only looks at zones in the cells it
+//  covers, a box in covered cells is wholly inside without any geometry,
+//  and only boxes on a boundary are clipped against the polygon for their
+//  exact overlap. Points (e.g. a track's foot point) are tested the same
+//  way.
+//
+//  Plain C, immutable once created: one index can be shared between
+//  threads. See Benchmarks/zone_index_bench.c.
+//
+
+#ifndef RTSPZoneIndex_h
+#define RTSPZoneIndex_h
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RTSP_ZONE_INDEX_MAX_ZONES 64
+#define RTSP_ZONE_INDEX_MAX_POINTS 64      // Vertices per polygon
+
+/// Bit per zone, in the order the zones were given
+typedef uint64_t RTSPZoneMask;
+
+typedef struct {
+    float x;
+    float y;
+} RTSPZonePoint;
+
+typedef struct {
+    const RTSPZonePoint *points;       // Normalized, top-left origin; copied at create
+    uint32_t pointCount;               // 3 - RTSP_ZONE_INDEX_MAX_POINTS
+    float minOverlap;                  // Fraction of a box inside to match; 0 = any overlap
+} RTSPZonePolygon;
+
+typedef struct RTSPZoneIndex *RTSPZoneIndexRef;
+
+/// Build an index over `count` zones with `gridSize` cells per side (0 =
+/// default 16). Returns NULL on invalid zones or allocation failure.
+RTSPZoneIndexRef RTSPZoneIndexCreate(const RTSPZonePolygon *zones, uint32_t count, uint32_t gridSize);
+void RTSPZoneIndexRelease(RTSPZoneIndexRef index);
+
+uint32_t RTSPZoneIndexCount(RTSPZoneIndexRef index);
+
+/// Zones a box (x, y, width, height) meets the overlap threshold of.
+/// `overlaps`, if given, receives every zone's overlap fraction (0 for
+/// zones the box misses).
+RTSPZoneMask RTSPZoneIndexMatchBox(RTSPZoneIndexRef index, float x, float y, float width, float height,
+                                   float *overlaps);
+
+/// Zones containing a point. Edges are half-open like rects: a point on a
+/// zone's left or top edge is inside, on its right or bottom edge outside.
+RTSPZoneMask RTSPZoneIndexZonesAtPoint(RTSPZoneIndexRef index, float x, float y);
+
+/// Fraction of a box inside one polygon, without an index
+float RTSPZonePolygonOverlap(const RTSPZonePolygon *zone, float x, float y, float width, float height);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RTSPZoneIndex_h */
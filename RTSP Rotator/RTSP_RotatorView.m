@@ -11,6 +11,9 @@
 #import "RTSPPreferencesController.h"
 #import "RTSPWallpaperController.h"
 #import "RTSPFFmpegProxy.h"
+#import "RTSPFrameBus.h"
+
+NSString * const RTSPWallpaperControllerDidSwitchFeedNotification = @"RTSPWallpaperControllerDidSwitchFeedNotification";
 
 /// Custom window class that allows the RTSP viewer to become key/main window
 /// This enables proper event handling while maintaining desktop-level display
@@ -40,6 +43,7 @@
 @property (nonatomic, assign) BOOL usingExternalView;
 @property (nonatomic, strong) NSArray<NSString *> *mutableFeeds;
 @property (nonatomic, weak) AVPlayerItem *currentObservedItem;
+@property (nonatomic, assign) NSUInteger playbackGeneration;  // Drops proxy completions for feeds we've moved past
 
 @end
 
@@ -220,6 +224,10 @@
         return;
     }
 
+    // Registers the player so snapshot and MJPEG endpoints can find it; the
+    // tap itself stays detached until something subscribes
+    [RTSPFrameBus busForPlayer:self.player];
+
     // Determine target view
     NSView *targetView = self.parentView ?: self.window.contentView;
     if (!targetView) {
@@ -293,6 +301,13 @@
           (unsigned long)self.feeds.count,
           feedURLString);
 
+    NSUInteger generation = ++self.playbackGeneration;
+
+    [[NSNotificationCenter defaultCenter] postNotificationName:RTSPWallpaperControllerDidSwitchFeedNotification
+                                                        object:self
+                                                      userInfo:@{@"index": @(self.currentIndex),
+                                                                 @"count": @(self.feeds.count)}];
+
     // Check if this is an RTSPS URL that needs proxying
     if ([feedURL.scheme isEqualToString:@"rtsps"]) {
         NSLog(@"[INFO] RTSPS URL detected - starting FFmpeg proxy");
@@ -300,20 +315,34 @@
         // Get camera name for logging (use index as fallback)
         NSString *cameraName = [NSString stringWithFormat:@"Camera %lu", (unsigned long)(self.currentIndex + 1)];
 
-        // Start FFmpeg proxy
+        // Start the proxy without blocking the main thread; playback begins
+        // as soon as the first playlist is written
         RTSPFFmpegProxy *proxy = [RTSPFFmpegProxy sharedProxy];
-        NSURL *localURL = [proxy startProxyForURL:feedURL cameraName:cameraName];
+        __weak typeof(self) weakSelf = self;
+        [proxy startProxyForURL:feedURL cameraName:cameraName completion:^(NSURL *localURL, NSError *error) {
+            typeof(self) strongSelf = weakSelf;
+            if (!strongSelf || strongSelf.playbackGeneration != generation) {
+                return; // Rotated away while the proxy was starting
+            }
 
-        if (localURL) {
-            NSLog(@"[INFO] Using FFmpeg proxy: %@ → %@", feedURLString, localURL.absoluteString);
-            feedURL = localURL; // Use local RTSP URL instead
-            feedURLString = localURL.absoluteString;
-        } else {
-            NSLog(@"[ERROR] Failed to start FFmpeg proxy for %@", feedURLString);
-            // Continue anyway, might work without proxy
-        }
+            if (localURL) {
+                NSLog(@"[INFO] Using FFmpeg proxy: %@ → %@", feedURLString, localURL.absoluteString);
+                [strongSelf playResolvedURL:localURL];
+            } else {
+                NSLog(@"[ERROR] Failed to start FFmpeg proxy for %@: %@", feedURLString, error.localizedDescription);
+                // Continue anyway, might work without proxy
+                [strongSelf playResolvedURL:feedURL];
+            }
+        }];
+        return;
     }
 
+    [self playResolvedURL:feedURL];
+}
+
+- (void)playResolvedURL:(NSURL *)feedURL {
+    NSString *feedURLString = feedURL.absoluteString;
+
     // Create AVPlayerItem with URL
     // For rtsps:// URLs with self-signed certs, use AVURLAsset with proper options
     AVPlayerItem *playerItem;
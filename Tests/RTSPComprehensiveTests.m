@@ -661,13 +661,23 @@
 
 @interface RTSPEventLoggerFunctionalTests : XCTestCase
 @property (nonatomic, strong) RTSPEventLogger *logger;
+@property (nonatomic, copy) NSString *storeDirectory;
 @end
 
 @implementation RTSPEventLoggerFunctionalTests
 
 - (void)setUp {
     [super setUp];
-    self.logger = [[RTSPEventLogger alloc] init];
+    // A fresh store per test, away from the user's event log
+    self.storeDirectory = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSUUID UUID].UUIDString];
+    self.logger = [[RTSPEventLogger alloc] initWithDirectory:self.storeDirectory];
+}
+
+- (void)tearDown {
+    [self.logger saveEvents];
+    self.logger = nil;
+    [[NSFileManager defaultManager] removeItemAtPath:self.storeDirectory error:nil];
+    [super tearDown];
 }
 
 - (void)testLogEventAddsToList {
@@ -867,7 +877,8 @@
 }
 
 - (void)testEventLoggingPerformance {
-    RTSPEventLogger *logger = [[RTSPEventLogger alloc] init];
+    NSString *directory = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSUUID UUID].UUIDString];
+    RTSPEventLogger *logger = [[RTSPEventLogger alloc] initWithDirectory:directory];
     logger.maxEventsInMemory = 10000;
 
     [self measureBlock:^{
@@ -878,6 +889,9 @@
                          feedURL:nil];
         }
     }];
+
+    [logger saveEvents];
+    [[NSFileManager defaultManager] removeItemAtPath:directory error:nil];
 }
 
 - (void)testTransitionNameLookupPerformance {